@@ -0,0 +1,283 @@
+/**
+	AmbientOcclusion.cpp
+
+	Purpose: AmbientOcclusion.cpp is the source file for the
+			AmbientOcclusion class. The AmbientOcclusion works out how
+			much of the ambient light reaches each pixel from the depth
+			pre-pass, at half the size of the scene, so the flat ambient
+			term darkens in corners and creases.
+
+	@author Nathan Nette
+*/
+#include "AmbientOcclusion.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	// The units the passes read the depth and the estimated occlusion
+	//	from, the ones full screen passes use.
+	static const unsigned int DEPTH_UNIT = 0;
+	static const unsigned int RAW_UNIT = 1;
+
+	AmbientOcclusion::AmbientOcclusion()
+		: m_rawFramebuffer(0),
+		m_rawTexture(0),
+		m_framebuffer(0),
+		m_texture(0),
+		m_vao(0),
+		m_width(0),
+		m_height(0),
+		m_renderWidth(0),
+		m_renderHeight(0),
+		m_targetWidth(0),
+		m_targetHeight(0),
+		m_radius(1.0f),
+		m_intensity(1.0f)
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffers and textures.
+	*/
+	AmbientOcclusion::~AmbientOcclusion()
+	{
+		destroy();
+	}
+
+	// Makes a render target, read only with texelFetch, and a
+	//	framebuffer drawing into it.
+	static unsigned int createTarget(unsigned int a_format, int a_width, int a_height, unsigned int* a_framebuffer)
+	{
+		unsigned int texture = 0;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, a_format, a_width, a_height);
+		GpuMemory::instance().trackTexture(texture, GpuMemory::getTextureBytes(a_format, a_width, a_height),
+			GpuMemory::RENDER_TARGETS, "AmbientOcclusion");
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glCreateFramebuffers(1, a_framebuffer);
+		glNamedFramebufferTexture(*a_framebuffer, GL_COLOR_ATTACHMENT0, texture, 0);
+		return texture;
+	}
+
+	/**
+		create makes the targets and loads the shaders.
+
+			@param1 a_width is the width of the window.
+
+			@param2 a_height is the height of the window.
+
+			@return false without GL 4.5 or the shaders, it is left
+					uncreated.
+	*/
+	bool AmbientOcclusion::create(int a_width, int a_height)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("AmbientOcclusion: ambient occlusion needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_occlusionShader.getHandle() == 0)
+		{
+			m_occlusionShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleUpsample.vert");
+			m_occlusionShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/ambientOcclusion.frag");
+			m_blurShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleUpsample.vert");
+			m_blurShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/ambientOcclusionBlur.frag");
+			aie::ShaderProgram* programs[] = { &m_occlusionShader, &m_blurShader };
+			if (aie::ShaderProgram::linkAll(programs, 2) == false)
+			{
+				for (aie::ShaderProgram* program : programs)
+				{
+					if (program->getHandle() == 0)
+						printf("Shader Error: %s\n", program->getLastError());
+				}
+				return false;
+			}
+		}
+
+		m_width = a_width > 1 ? a_width : 1;
+		m_height = a_height > 1 ? a_height : 1;
+		int targetWidth = (m_width + DIVISOR - 1) / DIVISOR;
+		int targetHeight = (m_height + DIVISOR - 1) / DIVISOR;
+
+		// The occlusion only needs half floats, the distance beside it is
+		//	only compared relative to its size.
+		m_rawTexture = createTarget(GL_RG16F, targetWidth, targetHeight, &m_rawFramebuffer);
+		m_texture = createTarget(GL_RG16F, targetWidth, targetHeight, &m_framebuffer);
+
+		unsigned int framebuffers[] = { m_rawFramebuffer, m_framebuffer };
+		for (unsigned int framebuffer : framebuffers)
+		{
+			if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			{
+				printf("AmbientOcclusion: the occlusion targets aren't complete.\n");
+				destroy();
+				return false;
+			}
+		}
+
+		glCreateVertexArrays(1, &m_vao);
+		return true;
+	}
+
+	/**
+		draw copies the depth under the viewport and works out the
+			occlusion from it, then binds the framebuffer and viewport
+			again.
+
+			@param1 a_projection is the camera's projection, used to turn
+					depth back into positions.
+
+			@param2 a_depthFramebuffer draws into a_depthTexture.
+
+			@param3 a_depthTexture is where the depth is copied, the
+					window's size and RenderState::getDepthFormat.
+	*/
+	void AmbientOcclusion::draw(const glm::mat4& a_projection, unsigned int a_depthFramebuffer,
+		unsigned int a_depthTexture)
+	{
+		static constexpr aie::UniformHandle DEPTH("Depth");
+		static constexpr aie::UniformHandle RAW("Raw");
+		static constexpr aie::UniformHandle DEPTH_RANGE("DepthRange");
+		static constexpr aie::UniformHandle CLEAR_DEPTH("ClearDepth");
+		static constexpr aie::UniformHandle NDC_TO_VIEW("NdcToView");
+		static constexpr aie::UniformHandle RENDER_SIZE("RenderSize");
+		static constexpr aie::UniformHandle RADIUS("Radius");
+		static constexpr aie::UniformHandle PIXEL_RADIUS("PixelRadius");
+		static constexpr aie::UniformHandle INTENSITY("Intensity");
+		static constexpr aie::UniformHandle LAST_TEXEL("LastTexel");
+
+		int previousFramebuffer = 0;
+		int previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+		m_renderWidth = std::min(std::max(previousViewport[2], 1), m_width);
+		m_renderHeight = std::min(std::max(previousViewport[3], 1), m_height);
+		m_targetWidth = (m_renderWidth + DIVISOR - 1) / DIVISOR;
+		m_targetHeight = (m_renderHeight + DIVISOR - 1) / DIVISOR;
+		glBlitNamedFramebuffer(previousFramebuffer, a_depthFramebuffer, previousViewport[0], previousViewport[1],
+			previousViewport[0] + m_renderWidth, previousViewport[1] + m_renderHeight,
+			0, 0, m_renderWidth, m_renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		// Depth to distance as the particle target turns it, see there.
+		RenderState& state = RenderState::instance();
+		glm::vec3 depthRange;
+		if (state.isReverseZ())
+			depthRange = glm::vec3(a_projection[3][2], 1.0f, a_projection[2][2]);
+		else
+			depthRange = glm::vec3(-a_projection[3][2], -2.0f, 1.0f - a_projection[2][2]);
+
+		// A view space position is (ndc + [2]) * distance / [0][0] and
+		//	[1][1], the off centre terms kept for a view's own frustum.
+		glm::vec4 ndcToView(a_projection[2][0], a_projection[2][1], 1.0f / a_projection[0][0], 1.0f / a_projection[1][1]);
+
+		state.setDepthTest(false);
+		state.bindTexture(DEPTH_UNIT, a_depthTexture);
+		m_occlusionShader.bind();
+		m_occlusionShader.bindUniform(DEPTH, (int)DEPTH_UNIT);
+		m_occlusionShader.bindUniform(DEPTH_RANGE, depthRange);
+		m_occlusionShader.bindUniform(CLEAR_DEPTH, state.isReverseZ() ? 0.0f : 1.0f);
+		m_occlusionShader.bindUniform(NDC_TO_VIEW, ndcToView);
+		m_occlusionShader.bindUniform(RENDER_SIZE, glm::vec2(m_renderWidth, m_renderHeight));
+		m_occlusionShader.bindUniform(RADIUS, m_radius);
+		m_occlusionShader.bindUniform(PIXEL_RADIUS, m_radius * a_projection[1][1] * 0.5f * (float)m_renderHeight);
+		m_occlusionShader.bindUniform(INTENSITY, m_intensity);
+		drawPass(m_rawFramebuffer);
+
+		state.bindTexture(RAW_UNIT, m_rawTexture);
+		m_blurShader.bind();
+		m_blurShader.bindUniform(RAW, (int)RAW_UNIT);
+		m_blurShader.bindUniform(LAST_TEXEL, glm::vec2(m_targetWidth - 1, m_targetHeight - 1));
+		drawPass(m_framebuffer);
+		state.setDepthTest(true);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	}
+
+	/**
+		drawPass draws one triangle over the part of a target this frame
+			covers, with the pass's shader bound.
+
+			@param1 a_framebuffer draws into the target.
+	*/
+	void AmbientOcclusion::drawPass(unsigned int a_framebuffer) const
+	{
+		RenderState& state = RenderState::instance();
+		glBindFramebuffer(GL_FRAMEBUFFER, a_framebuffer);
+		glViewport(0, 0, m_targetWidth, m_targetHeight);
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	/**
+		bind points a lighting shader at the occlusion.
+
+			@param1 a_shader is the shader, already bound.
+	*/
+	void AmbientOcclusion::bind(aie::ShaderProgram& a_shader) const
+	{
+		static constexpr aie::UniformHandle AMBIENT_OCCLUSION("AmbientOcclusion");
+
+		if (isCreated())
+			RenderState::instance().bindTexture(OCCLUSION_UNIT, m_texture);
+		a_shader.bindUniform(AMBIENT_OCCLUSION, (int)OCCLUSION_UNIT);
+	}
+
+	/**
+		getParameters returns what the shaders read the occlusion with:
+			how many texels a pixel is and the last texel drawn into,
+			with w 1.
+
+			@param1 a_width is the width of the viewport it is drawn
+					under.
+
+			@param2 a_height is its height.
+	*/
+	glm::vec4 AmbientOcclusion::getParameters(int a_width, int a_height) const
+	{
+		int renderWidth = std::min(std::max(a_width, 1), m_width);
+		int renderHeight = std::min(std::max(a_height, 1), m_height);
+		return glm::vec4(1.0f / (float)DIVISOR, (float)((renderWidth + DIVISOR - 1) / DIVISOR - 1),
+			(float)((renderHeight + DIVISOR - 1) / DIVISOR - 1), 1.0f);
+	}
+
+	/**
+		destroy deletes the framebuffers and textures.
+	*/
+	void AmbientOcclusion::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		unsigned int* textures[2] = { &m_rawTexture, &m_texture };
+		for (unsigned int* texture : textures)
+		{
+			if (*texture != 0)
+			{
+				glDeleteTextures(1, texture);
+				state.onTextureDeleted(*texture);
+				GpuMemory::instance().releaseTexture(*texture);
+				*texture = 0;
+			}
+		}
+		glDeleteFramebuffers(1, &m_rawFramebuffer);
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_rawFramebuffer = m_framebuffer = 0;
+
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			state.onVertexArrayDeleted(m_vao);
+			m_vao = 0;
+		}
+		m_width = m_height = 0;
+	}
+}
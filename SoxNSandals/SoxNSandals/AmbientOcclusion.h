@@ -0,0 +1,159 @@
+/**
+	AmbientOcclusion.h
+
+	Purpose: AmbientOcclusion.h is the header file for the
+			AmbientOcclusion class. The AmbientOcclusion works out how
+			much of the ambient light reaches each pixel from the depth
+			pre-pass, at half the size of the scene, so the flat ambient
+			term darkens in corners and creases.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace sns
+{
+	/**
+		The AmbientOcclusion class owns two targets at half the scene's
+			size. draw copies the depth laid down by the pre-pass into
+			a target it is given, then estimates the occlusion at every
+			other pixel from a few depth samples around it, rebuilding
+			the normal from the depth as well, and blurs it without
+			crossing edges in the depth.
+
+		Each texel keeps its distance from the camera with the
+			occlusion, so the shaders lighting the scene upsample it
+			themselves, weighting the four texels around a fragment by
+			how close their distance is to its own. There is no full
+			size pass, and what is drawn after the pre-pass, at a depth
+			nothing in the occlusion is near, isn't darkened.
+
+		The shaders find whether there is occlusion this frame and how
+			to read it from getParameters, put in the frame uniforms.
+
+		Everything needs GL 4.5, without it create fails and the
+			ambient is left flat.
+	*/
+	class AmbientOcclusion
+	{
+	public:
+		// The unit the lighting shaders read the occlusion from.
+		static const unsigned int OCCLUSION_UNIT = 15;
+
+		// How many times smaller the occlusion is than the scene.
+		static const int DIVISOR = 2;
+
+		AmbientOcclusion();
+
+		/**
+			The deconstructor deletes the framebuffers and textures.
+		*/
+		~AmbientOcclusion();
+
+		AmbientOcclusion(const AmbientOcclusion&) = delete;
+		AmbientOcclusion& operator=(const AmbientOcclusion&) = delete;
+
+		/**
+			create makes the targets and loads the shaders.
+
+				@param1 a_width is the width of the window.
+
+				@param2 a_height is the height of the window.
+
+				@return false without GL 4.5 or the shaders, it is left
+						uncreated.
+		*/
+		bool create(int a_width, int a_height);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_texture != 0; }
+
+		/**
+			draw copies the depth under the viewport and works out the
+				occlusion from it, then binds the framebuffer and
+				viewport again.
+
+				@param1 a_projection is the camera's projection, used to
+						turn depth back into positions.
+
+				@param2 a_depthFramebuffer draws into a_depthTexture.
+
+				@param3 a_depthTexture is where the depth is copied, the
+						window's size and RenderState::getDepthFormat.
+		*/
+		void draw(const glm::mat4& a_projection, unsigned int a_depthFramebuffer, unsigned int a_depthTexture);
+
+		/**
+			bind points a lighting shader at the occlusion.
+
+				@param1 a_shader is the shader, already bound.
+		*/
+		void bind(aie::ShaderProgram& a_shader) const;
+
+		/**
+			getParameters returns what the shaders read the occlusion
+				with: how many texels a pixel is and the last texel
+				drawn into, with w 1.
+
+				@param1 a_width is the width of the viewport it is drawn
+						under.
+
+				@param2 a_height is its height.
+		*/
+		glm::vec4 getParameters(int a_width, int a_height) const;
+
+		/**
+			setRadius changes how far around each pixel is looked at for
+				what occludes it.
+
+				@param1 a_radius is the distance, in world units.
+		*/
+		void setRadius(float a_radius) { m_radius = a_radius; }
+
+		/**
+			setIntensity changes how dark the occlusion gets.
+
+				@param1 a_intensity is 1 for the usual amount.
+		*/
+		void setIntensity(float a_intensity) { m_intensity = a_intensity; }
+
+	private:
+		// Deletes the framebuffers and textures.
+		void destroy();
+
+		// Draws the full screen triangle into a target.
+		void drawPass(unsigned int a_framebuffer) const;
+
+		// Estimates the occlusion from the depth, and blurs it.
+		aie::ShaderProgram m_occlusionShader;
+		aie::ShaderProgram m_blurShader;
+
+		// The occlusion with each texel's distance, as estimated and
+		//	once blurred.
+		unsigned int m_rawFramebuffer;
+		unsigned int m_rawTexture;
+		unsigned int m_framebuffer;
+		unsigned int m_texture;
+
+		// An empty vertex array for the full screen triangle.
+		unsigned int m_vao;
+
+		int m_width;
+		int m_height;
+
+		// How much of the window and of the targets this frame covers.
+		int m_renderWidth;
+		int m_renderHeight;
+		int m_targetWidth;
+		int m_targetHeight;
+
+		float m_radius;
+		float m_intensity;
+	};
+}
@@ -0,0 +1,182 @@
+/**
+	AnimationClip.cpp
+
+	Purpose: AnimationClip.cpp is the source file for the AnimationClip
+			class. The AnimationClip is one of a glTF model's
+			animations, keyframes of its joints' translations,
+			rotations and scales, sampled into a Pose at any time.
+
+	@author Nathan Nette
+*/
+#include "AnimationClip.h"
+#include "GltfFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	// The first stream of each part, and how many it has.
+	const sns::Pose::Stream PART_STREAMS[sns::Pose::PART_COUNT] = {
+		sns::Pose::TRANSLATION_X, sns::Pose::ROTATION_X, sns::Pose::SCALE_X
+	};
+	const unsigned int PART_COMPONENTS[sns::Pose::PART_COUNT] = { 3, 4, 3 };
+
+	int getInt(const sns::JsonValue& a_object, const char* a_name, int a_default)
+	{
+		const sns::JsonValue* value = a_object.find(a_name);
+		return value != nullptr && value->type == sns::JsonValue::NUMBER ? (int)value->number : a_default;
+	}
+
+	std::string getString(const sns::JsonValue& a_object, const char* a_name)
+	{
+		const sns::JsonValue* value = a_object.find(a_name);
+		return value != nullptr && value->type == sns::JsonValue::STRING ? value->string : std::string();
+	}
+}
+
+namespace sns
+{
+	AnimationClip::AnimationClip()
+		: m_duration(0.0f)
+	{
+	}
+
+	/**
+		load reads an animation from a model. Channels that move nodes
+			outside the skeleton, or move their weights, are left out.
+
+			@param1 a_file is the model.
+
+			@param2 a_animation is the animation's index.
+
+			@param3 a_skeleton is the skeleton it moves.
+
+			@return false if it can't be read, any error is printed.
+	*/
+	bool AnimationClip::load(const GltfFile& a_file, int a_animation, const Skeleton& a_skeleton)
+	{
+		m_tracks.clear();
+		m_duration = 0.0f;
+
+		const JsonValue* animation = a_file.getItem("animations", a_animation);
+		const JsonValue* channels = animation != nullptr ? animation->find("channels") : nullptr;
+		const JsonValue* samplers = animation != nullptr ? animation->find("samplers") : nullptr;
+		if (channels == nullptr || samplers == nullptr)
+		{
+			printf("%s: there is no animation %d\n", a_file.getFilename().c_str(), a_animation);
+			return false;
+		}
+		m_name = getString(*animation, "name");
+
+		for (const JsonValue& channel : channels->items)
+		{
+			const JsonValue* target = channel.find("target");
+			int sampler = getInt(channel, "sampler", -1);
+			if (target == nullptr || sampler < 0 || (size_t)sampler >= samplers->items.size())
+				continue;
+
+			int joint = a_skeleton.findJoint(getInt(*target, "node", -1));
+			std::string path = getString(*target, "path");
+			if (joint < 0)
+				continue;
+
+			Track track;
+			track.joint = (unsigned int)joint;
+			if (path == "translation")
+				track.part = Pose::TRANSLATION;
+			else if (path == "rotation")
+				track.part = Pose::ROTATION;
+			else if (path == "scale")
+				track.part = Pose::SCALE;
+			else
+				continue;
+
+			const JsonValue& value = samplers->items[sampler];
+			std::string interpolation = getString(value, "interpolation");
+			track.interpolation = interpolation == "STEP" ? STEP : interpolation == "CUBICSPLINE" ? CUBIC_SPLINE : LINEAR;
+
+			int input = getInt(value, "input", -1);
+			int output = getInt(value, "output", -1);
+			unsigned int keyCount = a_file.getAccessorCount(input);
+			unsigned int components = PART_COMPONENTS[track.part];
+			unsigned int valuesPerKey = track.interpolation == CUBIC_SPLINE ? 3 : 1;
+			std::vector<float> values((size_t)keyCount * valuesPerKey * components);
+			track.times.resize(keyCount);
+			if (keyCount == 0 || a_file.getAccessorCount(output) != keyCount * valuesPerKey ||
+				a_file.readFloats(input, 1, track.times.data()) == false ||
+				a_file.readFloats(output, components, values.data()) == false)
+			{
+				printf("%s: animation %d has a channel that can't be read\n", a_file.getFilename().c_str(), a_animation);
+				return false;
+			}
+
+			if (track.interpolation == CUBIC_SPLINE)
+			{
+				for (unsigned int k = 0; k < keyCount; ++k)
+				{
+					const float* key = values.data() + (k * 3 + 1) * components;
+					track.values.insert(track.values.end(), key, key + components);
+				}
+			}
+			else
+				track.values.swap(values);
+
+			m_duration = std::max(m_duration, track.times.back());
+			m_tracks.push_back(std::move(track));
+		}
+		return true;
+	}
+
+	/**
+		sample works out the pose at a time, wrapped into the clip.
+
+			@param1 a_time is the time in seconds.
+
+			@param2 a_rest is the rest pose, for the parts without tracks.
+
+			@param3 a_scratch is reused between calls.
+
+			@param4 a_pose is set to the pose.
+	*/
+	void AnimationClip::sample(float a_time, const Pose& a_rest, Scratch& a_scratch, Pose& a_pose) const
+	{
+		float time = m_duration > 0.0f ? std::fmod(a_time, m_duration) : 0.0f;
+		if (time < 0.0f)
+			time += m_duration;
+
+		// Parts without a track blend from the rest pose to itself.
+		unsigned int padded = a_rest.getPaddedCount();
+		a_scratch.from = a_rest;
+		a_scratch.to = a_rest;
+		a_scratch.weights.assign(Pose::PART_COUNT * padded, 0.0f);
+
+		for (const Track& track : m_tracks)
+		{
+			// The first keyframe after the time, the time is clamped to
+			//	the track's first and last.
+			unsigned int keyCount = (unsigned int)track.times.size();
+			unsigned int next = (unsigned int)(std::upper_bound(track.times.begin(), track.times.end(), time) -
+				track.times.begin());
+			unsigned int previous = next > 0 ? next - 1 : 0;
+			if (next >= keyCount)
+				next = keyCount - 1;
+
+			float weight = 0.0f;
+			float span = track.times[next] - track.times[previous];
+			if (track.interpolation != STEP && span > 0.0f)
+				weight = (time - track.times[previous]) / span;
+
+			unsigned int components = PART_COMPONENTS[track.part];
+			for (unsigned int c = 0; c < components; ++c)
+			{
+				Pose::Stream stream = (Pose::Stream)(PART_STREAMS[track.part] + c);
+				a_scratch.from.getStream(stream)[track.joint] = track.values[previous * components + c];
+				a_scratch.to.getStream(stream)[track.joint] = track.values[next * components + c];
+			}
+			a_scratch.weights[track.part * padded + track.joint] = weight;
+		}
+
+		Pose::blend(a_scratch.from, a_scratch.to, a_scratch.weights.data(), a_pose);
+	}
+}
@@ -0,0 +1,112 @@
+/**
+	AnimationClip.h
+
+	Purpose: AnimationClip.h is the header file for the AnimationClip
+			class. The AnimationClip is one of a glTF model's
+			animations, keyframes of its joints' translations,
+			rotations and scales, sampled into a Pose at any time.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Skeleton.h"
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	class GltfFile;
+
+	/**
+		The AnimationClip class holds a track of keyframes for each part
+			of a joint the animation moves. Parts it doesn't move keep
+			the rest pose.
+
+		sample finds the keyframes either side of the time for each
+			track, one joint at a time, and copies them into two poses
+			with how far between them the time is. Interpolating the
+			two is then a Pose::blend, four joints at once.
+
+		Step tracks hold their keyframe until the next. Cubic spline
+			tracks are read through their keyframes' values linearly,
+			leaving their tangents out.
+	*/
+	class AnimationClip
+	{
+	public:
+		/**
+			What sample works in, kept between calls so sampling doesn't
+				allocate once it has been done once.
+		*/
+		struct Scratch
+		{
+			Pose from;
+			Pose to;
+			std::vector<float> weights;
+		};
+
+		AnimationClip();
+
+		/**
+			load reads an animation from a model, keeping the tracks over
+				the skeleton's joints.
+
+				@param1 a_file is the model.
+
+				@param2 a_animation is the animation's index.
+
+				@param3 a_skeleton is the skeleton it moves.
+
+				@return false if it can't be read, any error is printed.
+		*/
+		bool load(const GltfFile& a_file, int a_animation, const Skeleton& a_skeleton);
+
+		/**
+			getName returns the animation's name in the model.
+		*/
+		const std::string& getName() const { return m_name; }
+
+		/**
+			getDuration returns the time of the last keyframe, in seconds.
+		*/
+		float getDuration() const { return m_duration; }
+
+		/**
+			sample works out the pose at a time, wrapped into the clip.
+
+				@param1 a_time is the time in seconds.
+
+				@param2 a_rest is the rest pose, for the parts without
+						tracks.
+
+				@param3 a_scratch is reused between calls.
+
+				@param4 a_pose is set to the pose.
+		*/
+		void sample(float a_time, const Pose& a_rest, Scratch& a_scratch, Pose& a_pose) const;
+
+	private:
+		enum Interpolation
+		{
+			LINEAR,
+			STEP,
+			CUBIC_SPLINE
+		};
+
+		// The keyframes of one part of a joint, a value of 3 or 4 floats
+		//	at each time. Cubic spline values are the middle of their
+		//	in tangent, value and out tangent.
+		struct Track
+		{
+			unsigned int joint;
+			Pose::Part part;
+			Interpolation interpolation;
+			std::vector<float> times;
+			std::vector<float> values;
+		};
+
+		std::string m_name;
+		std::vector<Track> m_tracks;
+		float m_duration;
+	};
+}
@@ -0,0 +1,336 @@
+/**
+	Animator.cpp
+
+	Purpose: Animator.cpp is the source file for the Animator class. The
+			Animator plays the animations of the scene's skinned
+			characters on the job system and skins them on the gpu, once
+			a frame for every pass that draws them.
+
+	@author Nathan Nette
+*/
+#include "Animator.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/common.hpp>
+#include <cstdio>
+
+namespace sns
+{
+	// The skinning shader's buffers.
+	static const unsigned int SOURCE_BINDING = 0;
+	static const unsigned int JOINT_BINDING = 1;
+	static const unsigned int SKINNED_BINDING = 2;
+
+	// The floats of one joint's skin matrix, its first three rows.
+	static const unsigned int JOINT_FLOATS = 12;
+
+	// How much wider a character's bounds are than the sphere around its
+	//	joints, which its skin reaches out past.
+	static const float BOUNDS_MARGIN = 1.5f;
+
+	Animator::Animator()
+		: m_jointBuffer(0),
+		m_jointCapacity(0),
+		m_posed(false),
+		m_dirty(false),
+		m_moved(false)
+	{
+	}
+
+	/**
+		The deconstructor waits for the jobs and deletes the buffers and
+			vertex arrays.
+	*/
+	Animator::~Animator()
+	{
+		JobSystem::instance().wait(m_jobs);
+		for (auto& character : m_characters)
+			destroy(*character);
+		if (m_jointBuffer != 0)
+		{
+			glDeleteBuffers(1, &m_jointBuffer);
+			RenderState::instance().onBufferDeleted(m_jointBuffer);
+			GpuMemory::instance().releaseBuffer(m_jointBuffer);
+		}
+	}
+
+	/**
+		create loads the skinning shader.
+
+			@return false without GL 4.5 or the shader, it is left
+					uncreated.
+	*/
+	bool Animator::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("Animator: skinning needs GL 4.5.\n");
+			return false;
+		}
+
+		m_shader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/skinning.comp");
+		if (m_shader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_shader.getLastError());
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		addCharacter places a character, loading its model unless a
+			character already has.
+
+			@param1 a_filename is the model, a .gltf or .glb.
+
+			@param2 a_transform places it in the scene.
+
+			@param3 a_clip is the name of the clip it plays, the model's
+					first if it is empty or not found.
+
+			@param4 a_blendClip is a clip to blend into it, or empty.
+
+			@param5 a_blend is how far towards a_blendClip it is blended,
+					0 to 1.
+
+			@param6 a_speed is how fast it plays, 1 as authored.
+
+			@return false if the model couldn't be loaded.
+	*/
+	bool Animator::addCharacter(const std::string& a_filename, const glm::mat4& a_transform, const std::string& a_clip,
+		const std::string& a_blendClip, float a_blend, float a_speed)
+	{
+		if (isCreated() == false)
+			return false;
+
+		// Nothing may be resized while the jobs are running.
+		JobSystem::instance().wait(m_jobs);
+
+		std::shared_ptr<SkinnedMesh> mesh;
+		for (const auto& loaded : m_meshes)
+		{
+			if (loaded->getFilename() == a_filename)
+				mesh = loaded;
+		}
+		if (mesh == nullptr)
+		{
+			mesh = std::make_shared<SkinnedMesh>();
+			if (mesh->load(a_filename.c_str()) == false)
+				return false;
+			m_meshes.push_back(mesh);
+		}
+
+		std::unique_ptr<Character> character(new Character());
+		character->mesh = mesh;
+		character->object = m_objects.add(a_transform);
+		character->clips[0] = mesh->findClip(a_clip);
+		if (character->clips[0] < 0 && mesh->getClips().empty() == false)
+			character->clips[0] = 0;
+		character->clips[1] = a_blendClip.empty() ? -1 : mesh->findClip(a_blendClip);
+		character->blend = glm::clamp(a_blend, 0.0f, 1.0f);
+		character->speed = a_speed;
+		character->time = 0.0f;
+		character->firstJoint = (unsigned int)(m_jointRows.size() / JOINT_FLOATS);
+
+		// Its skinned vertices are drawn through a vertex array of its
+		//	own, over the indices every character of the mesh shares.
+		size_t bytes = (size_t)mesh->getVertexCount() * sizeof(aie::OBJMesh::Vertex);
+		glCreateBuffers(1, &character->vertexBuffer);
+		glNamedBufferStorage(character->vertexBuffer, bytes, nullptr, 0);
+		GpuMemory::instance().trackBuffer(character->vertexBuffer, bytes, GpuMemory::MESHES, "Animator");
+
+		glCreateVertexArrays(1, &character->vao);
+		aie::OBJMesh::setVertexArrayFormat(character->vao, 0);
+		glVertexArrayVertexBuffer(character->vao, 0, character->vertexBuffer, 0, sizeof(aie::OBJMesh::Vertex));
+		glVertexArrayElementBuffer(character->vao, mesh->getIndexBuffer());
+
+		m_jointRows.resize(m_jointRows.size() + mesh->getSkeleton().getJointCount() * JOINT_FLOATS);
+		m_characters.push_back(std::move(character));
+		m_dirty = true;
+
+		// The joint buffer holds every character's matrices, and is made
+		//	again bigger when they outgrow it.
+		if (m_jointRows.size() > m_jointCapacity)
+		{
+			if (m_jointBuffer != 0)
+			{
+				glDeleteBuffers(1, &m_jointBuffer);
+				RenderState::instance().onBufferDeleted(m_jointBuffer);
+			}
+			m_jointCapacity = (unsigned int)m_jointRows.size() * 2;
+			glCreateBuffers(1, &m_jointBuffer);
+			glNamedBufferStorage(m_jointBuffer, m_jointCapacity * sizeof(float), nullptr, GL_DYNAMIC_STORAGE_BIT);
+			GpuMemory::instance().trackBuffer(m_jointBuffer, m_jointCapacity * sizeof(float), GpuMemory::MESHES, "Animator");
+		}
+		return true;
+	}
+
+	/**
+		restart sets every character back to the start of its clips.
+	*/
+	void Animator::restart()
+	{
+		JobSystem::instance().wait(m_jobs);
+		for (auto& character : m_characters)
+			character->time = 0.0f;
+		m_dirty = true;
+	}
+
+	/**
+		update starts the jobs that pose the characters, unless nothing
+			has changed since they were last posed. Each character is a
+			job of its own, writing only its own part of the matrices.
+
+			@param1 a_deltaTime is how far to play them, in seconds.
+	*/
+	void Animator::update(float a_deltaTime)
+	{
+		if (m_characters.empty() || (a_deltaTime == 0.0f && m_dirty == false))
+			return;
+
+		JobSystem& jobs = JobSystem::instance();
+		jobs.wait(m_jobs);
+		for (auto& character : m_characters)
+		{
+			character->time += a_deltaTime * character->speed;
+			Character* posed = character.get();
+			jobs.run([this, posed]() { animate(*posed); }, &m_jobs);
+		}
+		m_posed = true;
+		m_dirty = false;
+	}
+
+	/**
+		skin waits for the jobs update started and skins every character
+			it posed, into the buffers every pass draws.
+	*/
+	void Animator::skin()
+	{
+		m_objects.upload();
+		m_moved = m_posed;
+		if (m_posed == false)
+			return;
+		JobSystem::instance().wait(m_jobs);
+		m_posed = false;
+
+		static constexpr aie::UniformHandle VERTEX_COUNT("VertexCount");
+		static constexpr aie::UniformHandle FIRST_JOINT("FirstJoint");
+
+		glNamedBufferSubData(m_jointBuffer, 0, m_jointRows.size() * sizeof(float), m_jointRows.data());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, JOINT_BINDING, m_jointBuffer);
+
+		m_shader.bind();
+		for (const auto& character : m_characters)
+		{
+			unsigned int vertexCount = character->mesh->getVertexCount();
+			m_shader.bindUniform(VERTEX_COUNT, (int)vertexCount);
+			m_shader.bindUniform(FIRST_JOINT, (int)character->firstJoint);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SOURCE_BINDING, character->mesh->getSourceBuffer());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SKINNED_BINDING, character->vertexBuffer);
+			glDispatchCompute((vertexCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		}
+
+		// The skinned vertices are read as vertex attributes.
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+
+	/**
+		draw draws every skinned character with the program bound.
+	*/
+	void Animator::draw() const
+	{
+		RenderState& state = RenderState::instance();
+		m_objects.bind();
+		for (const auto& character : m_characters)
+		{
+			ObjectBuffer::select(character->object);
+			state.bindVertexArray(character->vao);
+			for (const SkinnedMesh::Primitive& primitive : character->mesh->getPrimitives())
+			{
+				aie::OBJMesh::bindMaterial(primitive.material);
+				state.countDraw();
+				glDrawElements(GL_TRIANGLES, primitive.indexCount, GL_UNSIGNED_INT,
+					(void*)(primitive.firstIndex * sizeof(unsigned int)));
+			}
+		}
+	}
+
+	/**
+		getBounds adds a world sphere around each character the last skin
+			moved.
+
+			@param1 a_bounds is added to.
+	*/
+	void Animator::getBounds(std::vector<glm::vec4>& a_bounds) const
+	{
+		if (m_moved == false)
+			return;
+		for (const auto& character : m_characters)
+			a_bounds.push_back(character->bounds);
+	}
+
+	/**
+		animate samples a character's clip, blends in the other one
+			if it has it, and works out its skin matrices. The clip
+			blended in is played at the same point through it, so two
+			cycles of different lengths stay in step.
+
+			@param1 a_character is the character.
+	*/
+	void Animator::animate(Character& a_character)
+	{
+		const SkinnedMesh& mesh = *a_character.mesh;
+		const Skeleton& skeleton = mesh.getSkeleton();
+		const std::vector<AnimationClip>& clips = mesh.getClips();
+		Pose& pose = a_character.poses[0];
+
+		if (a_character.clips[0] < 0)
+			pose = skeleton.getRestPose();
+		else
+			clips[a_character.clips[0]].sample(a_character.time, skeleton.getRestPose(), a_character.scratch, pose);
+
+		if (a_character.clips[1] >= 0 && a_character.blend > 0.0f)
+		{
+			const AnimationClip& blended = clips[a_character.clips[1]];
+			float duration = a_character.clips[0] >= 0 ? clips[a_character.clips[0]].getDuration() : 0.0f;
+			float time = duration > 0.0f ? a_character.time / duration * blended.getDuration() : a_character.time;
+			blended.sample(time, skeleton.getRestPose(), a_character.scratch, a_character.poses[1]);
+
+			a_character.weights.assign(Pose::PART_COUNT * pose.getPaddedCount(), a_character.blend);
+			Pose::blend(pose, a_character.poses[1], a_character.weights.data(), pose);
+		}
+
+		skeleton.getSkinMatrices(pose, a_character.matrices, m_jointRows.data() + a_character.firstJoint * JOINT_FLOATS);
+
+		// The joints' model matrices are the second half of the scratch.
+		const glm::mat4& model = m_objects.getObject(a_character.object).model;
+		const glm::mat4* joints = a_character.matrices.data() + a_character.matrices.size() / 2;
+		glm::vec3 minimum(model[3]);
+		glm::vec3 maximum(minimum);
+		for (unsigned int joint = 0; joint < skeleton.getJointCount(); ++joint)
+		{
+			glm::vec3 position(model * joints[joint][3]);
+			minimum = glm::min(minimum, position);
+			maximum = glm::max(maximum, position);
+		}
+		a_character.bounds = glm::vec4((minimum + maximum) * 0.5f, glm::length(maximum - minimum) * 0.5f * BOUNDS_MARGIN);
+	}
+
+	/**
+		destroy deletes a character's buffer and vertex array.
+
+			@param1 a_character is the character.
+	*/
+	void Animator::destroy(Character& a_character)
+	{
+		glDeleteVertexArrays(1, &a_character.vao);
+		RenderState::instance().onVertexArrayDeleted(a_character.vao);
+		glDeleteBuffers(1, &a_character.vertexBuffer);
+		RenderState::instance().onBufferDeleted(a_character.vertexBuffer);
+		GpuMemory::instance().releaseBuffer(a_character.vertexBuffer);
+		a_character.vao = a_character.vertexBuffer = 0;
+	}
+}
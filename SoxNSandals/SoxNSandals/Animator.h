@@ -0,0 +1,202 @@
+/**
+	Animator.h
+
+	Purpose: Animator.h is the header file for the Animator class. The
+			Animator plays the animations of the scene's skinned
+			characters on the job system and skins them on the gpu, once
+			a frame for every pass that draws them.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SkinnedMesh.h"
+#include "JobSystem.h"
+#include "ObjectBuffer.h"
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The Animator class holds the characters, each a SkinnedMesh placed
+			in the scene playing one of its clips, or blending two.
+			Characters of the same model share it, loaded once.
+
+		update starts a job for each character, which samples its clips
+			into poses, blends them and works out its skin matrices,
+			all in the Pose's streams four joints at a time. skin waits
+			for the jobs, uploads every character's matrices in one go
+			and runs the skinning shader over each character's vertices
+			into a buffer of its own.
+
+		Those buffers are OBJMesh::Vertex, so draw draws them with the
+			same programs as everything else. The shadow cascades and
+			every view draw the same skinned vertices, the skinning is
+			done once a frame however many passes there are, and not
+			at all while nothing moves.
+
+		Skinning needs GL 4.5, without it create fails and the characters
+			aren't drawn.
+	*/
+	class Animator
+	{
+	public:
+		// The skinning shader's work group size.
+		static const unsigned int GROUP_SIZE = 64;
+
+		Animator();
+
+		/**
+			The deconstructor waits for the jobs and deletes the buffers
+				and vertex arrays.
+		*/
+		~Animator();
+
+		Animator(const Animator&) = delete;
+		Animator& operator=(const Animator&) = delete;
+
+		/**
+			create loads the skinning shader.
+
+				@return false without GL 4.5 or the shader, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_shader.getHandle() != 0; }
+
+		/**
+			addCharacter places a character, loading its model unless a
+				character already has.
+
+				@param1 a_filename is the model, a .gltf or .glb.
+
+				@param2 a_transform places it in the scene.
+
+				@param3 a_clip is the name of the clip it plays, the
+						model's first if it is empty or not found.
+
+				@param4 a_blendClip is a clip to blend into it, or empty.
+
+				@param5 a_blend is how far towards a_blendClip it is
+						blended, 0 to 1.
+
+				@param6 a_speed is how fast it plays, 1 as authored.
+
+				@return false if the model couldn't be loaded.
+		*/
+		bool addCharacter(const std::string& a_filename, const glm::mat4& a_transform, const std::string& a_clip,
+			const std::string& a_blendClip, float a_blend, float a_speed);
+
+		/**
+			getCharacterCount returns how many characters there are.
+		*/
+		unsigned int getCharacterCount() const { return (unsigned int)m_characters.size(); }
+
+		/**
+			restart sets every character back to the start of its clips.
+		*/
+		void restart();
+
+		/**
+			update starts the jobs that pose the characters, unless
+				nothing has changed since they were last posed.
+
+				@param1 a_deltaTime is how far to play them, in seconds.
+		*/
+		void update(float a_deltaTime);
+
+		/**
+			skin waits for the jobs update started and skins every
+				character it posed. It must be called before the
+				characters are drawn into any pass.
+		*/
+		void skin();
+
+		/**
+			draw draws every skinned character. The program must already
+				be bound with its projection view, and read where each
+				is through object.glsl, the characters being placed by
+				an ObjectBuffer of their own. It is given each
+				primitive's colour as the lit shaders' material, where
+				it has them.
+		*/
+		void draw() const;
+
+		/**
+			getBounds adds a world sphere around each character the last
+				skin moved, for the shadows they may have changed.
+
+				@param1 a_bounds is added to, and left alone if the
+						characters didn't move.
+		*/
+		void getBounds(std::vector<glm::vec4>& a_bounds) const;
+
+	private:
+		// A placed character and what its job works in.
+		struct Character
+		{
+			std::shared_ptr<SkinnedMesh> mesh;
+
+			// Its index in m_objects, which places it.
+			unsigned int object;
+
+			int clips[2];
+			float blend;
+			float speed;
+			float time;
+
+			// Where its matrices start in m_jointRows, 12 floats a joint.
+			unsigned int firstJoint;
+
+			Pose poses[2];
+			AnimationClip::Scratch scratch;
+			std::vector<float> weights;
+			std::vector<glm::mat4> matrices;
+
+			// A world sphere around its posed joints, grown to hold its
+			//	skin.
+			glm::vec4 bounds;
+
+			// Its skinned vertices, and the vertex array drawing them
+			//	with the mesh's indices.
+			unsigned int vertexBuffer;
+			unsigned int vao;
+		};
+
+		// Poses one character and works out its skin matrices.
+		void animate(Character& a_character);
+
+		// Deletes a character's buffer and vertex array.
+		void destroy(Character& a_character);
+
+		aie::ShaderProgram m_shader;
+		std::vector<std::shared_ptr<SkinnedMesh>> m_meshes;
+		std::vector<std::unique_ptr<Character>> m_characters;
+
+		// Where each character is, written when one is added.
+		ObjectBuffer m_objects;
+
+		// Every character's skin matrices, as three rows each, and the
+		//	buffer they are uploaded to.
+		std::vector<float> m_jointRows;
+		unsigned int m_jointBuffer;
+		unsigned int m_jointCapacity;
+
+		JobCounter m_jobs;
+
+		// Whether the characters have been posed since they were last
+		//	skinned, whether they were ever posed at all, and whether the
+		//	last skin moved them.
+		bool m_posed;
+		bool m_dirty;
+		bool m_moved;
+	};
+}
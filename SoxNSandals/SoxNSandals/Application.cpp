@@ -12,6 +12,28 @@
 	@author Nathan Nette
 */
 #include "Application.h"
+#include "TextureCache.h"
+#include "FileSystem.h"
+#include "GpuMemory.h"
+#include "GpuReadback.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include "BenchmarkReport.h"
+#include "HeapTracker.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "ObjParser.h"
+#include "Gizmos.h"
+#include "EntitySystems.h"
+#include "Random.h"
+#include "RenderState.h"
+#include "SamplerCache.h"
+#include "StartupTimeline.h"
+#include "TextureAtlas.h"
+#include "UniformRing.h"
+#include "VertexArrays.h"
+#include <algorithm>
+#include <cfloat>
 
 /**
 	The Application Constructor creates the window for the application.
@@ -30,6 +52,8 @@ Application::Application(const glm::ivec2& a_resolution, const char* a_name)
 */
 Application::~Application()
 {
+	// The simulation thread uses the particle system, so it stops first.
+	m_pipeline.stop();
 	delete m_flyCam;
 }
 
@@ -39,18 +63,406 @@ Application::~Application()
 */
 int Application::run()
 {
-	// Initializes the application.
-	initialize();
+	// Initializes the application. Without a window there is nothing
+	//	to run.
+	int error = initialize();
+	if (error != 0)
+		return error;
 
 	// While the application window exists, run the application.
 	while (glfwWindowShouldClose(window) == false &&
-		glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS)
+		m_input.isKeyDown(GLFW_KEY_ESCAPE) == false)
 	{
+		// Sets the previous time to the current time.
+		m_previousTime = m_currentTime;
+
+		// Sets the current time variable to the actual current time.
+		m_currentTime = m_clock.now();
+
+		// How long it has been since the last frame.
+		auto duration = m_currentTime - m_previousTime;
+
+		// deltaTime = how long it has been since the last frame.
+		//	It is worked out before update, so update never sees the
+		//	previous frame's time.
+		m_deltaTime = duration.count() * NANO_TO_SECONDS;
+
 		update(m_deltaTime);
 	}
+
+	if (m_recordingStarted)
+		m_recording.write(m_recordingFile);
+
+	const sns::FramePacer::Stats& pacing = m_framePacer.getStats();
+	printf("Frame pacing over the last %u frames: %.2f ms average, %.2f ms jitter, %.2f ms worst, %u missed\n",
+		sns::FramePacer::HISTORY, pacing.averageMilliseconds, pacing.jitterMilliseconds,
+		pacing.worstMilliseconds, pacing.missed);
 	return 0;
 }
 
+/**
+	setConfig applies a run's settings, set before initialize. The
+		window's size is given to the constructor instead.
+
+		@param1 a_config is the settings, kept for as long as the
+				application as its scene file is read from it.
+*/
+void Application::setConfig(const sns::Config& a_config)
+{
+	if (a_config.sceneFile.empty() == false)
+		m_sceneFile = a_config.sceneFile.c_str();
+	if (a_config.telemetry.empty() == false)
+		m_telemetryAddress = a_config.telemetry.c_str();
+	m_antiAliasing = a_config.antiAliasing;
+	m_reflections.setQuality(a_config.reflections);
+	m_postProcess.getSettings().bloom = a_config.bloom;
+	m_benchmarkScene = a_config.benchmark.scene;
+	m_shadowResolution = a_config.shadowResolution;
+	m_particleBudget = a_config.particleBudget;
+	aie::OBJMesh::setLODScale(a_config.lodScale);
+	sns::SamplerCache::instance().setAnisotropy(a_config.anisotropy);
+}
+
+/**
+	benchmark flies the camera along a path instead of taking input,
+		timing a fixed amount of frames with vsync off once every
+		asset has loaded. Particles are updated with a fixed time step
+		so every run draws the same frames.
+
+		@param1 a_frameCount is how many frames to time.
+
+		@param2 a_output is the json file the results are written to.
+
+		@param3 a_pathFile is a camera path file, or nullptr to fly
+				the built in path through Sponza.
+
+		@param4 a_replayFile is a recording to replay instead of flying
+				a path. Its frames are run with the time steps and
+				settings they were recorded with, from the same start.
+
+		@return 0 if the benchmark ran and its results were written.
+*/
+int Application::benchmark(unsigned int a_frameCount, const char* a_output, const char* a_pathFile,
+	const char* a_replayFile)
+{
+	sns::CameraPath path;
+	if (a_pathFile == nullptr)
+		path.createSponza();
+	else if (path.load(a_pathFile) == false)
+		return -4;
+
+	sns::FrameRecording replay;
+	if (a_replayFile != nullptr)
+	{
+		if (replay.load(a_replayFile) == false)
+			return -4;
+		a_frameCount = replay.getFrameCount();
+		printf("Replaying %u frames of %s\n", a_frameCount, a_replayFile);
+	}
+
+	m_loadStanford = m_benchmarkScene == sns::BenchmarkScene::STANFORD;
+	int result = initialize();
+	if (result != 0)
+		return result;
+
+	beginBenchmark(path);
+	switchBenchmarkScene(m_benchmarkScene);
+	sns::BenchmarkReport report = timeFrames(a_frameCount, path, a_replayFile != nullptr ? &replay : nullptr);
+	m_cameraPath = nullptr;
+
+	return report.write(a_output) ? 0 : -5;
+}
+
+/**
+	regressionGate benchmarks every scene in turn along the built in
+		path, and compares them against a baseline. The scenes are run
+		in one window, one after the other, each from the same start.
+
+		@param1 a_baselineFile is the baseline to compare against.
+
+		@param2 a_frameCount is how many frames to time each scene.
+
+		@param3 a_updateBaseline writes this run's results over the
+				baseline instead of failing on it.
+
+		@return 0 if nothing regressed, 1 if something did, or less
+				than 0 if the scenes couldn't be run.
+*/
+int Application::regressionGate(const char* a_baselineFile, unsigned int a_frameCount, bool a_updateBaseline)
+{
+	sns::CameraPath path;
+	path.createSponza();
+
+	sns::RegressionGate gate;
+	if (a_updateBaseline == false && gate.loadBaseline(a_baselineFile) == false)
+		return -4;
+	// Updating keeps the tolerances a baseline was given, if it has one.
+	else if (a_updateBaseline)
+		gate.loadBaseline(a_baselineFile);
+
+	m_loadStanford = true;
+	int result = initialize();
+	if (result != 0)
+		return result;
+
+	beginBenchmark(path);
+
+	// Every scene's planets start where the first one's did.
+	sns::FrameRecording::Start first = captureStart();
+	for (int i = 0; i < (int)sns::BenchmarkScene::COUNT && glfwWindowShouldClose(window) == false; ++i)
+	{
+		sns::BenchmarkScene scene = (sns::BenchmarkScene)i;
+		printf("Scene %s\n", sns::RegressionGate::getSceneName(scene));
+		switchBenchmarkScene(scene);
+
+		glm::vec3 position;
+		glm::vec3 target;
+		path.sample(0.0f, position, target);
+		m_flyCam->setLookAt(position, target, glm::vec3(0, 1, 0));
+
+		sns::FrameRecording::Start start = captureStart();
+		start.orbitAngles = first.orbitAngles;
+		start.bodyStates = first.bodyStates;
+		restartSimulation(start);
+		for (unsigned int j = 0; j < BENCHMARK_WARM_UP_FRAMES; ++j)
+			update(BENCHMARK_TIME_STEP);
+
+		gate.addResult(scene, timeFrames(a_frameCount, path, nullptr));
+	}
+	m_cameraPath = nullptr;
+
+	if (a_updateBaseline)
+		return gate.writeBaseline(a_baselineFile) ? 0 : -5;
+	return gate.compare() == 0 ? 0 : 1;
+}
+
+/**
+	renderFrames draws frames along a path without showing a window, into
+		the frame capture's framebuffer, which reads each back and
+		writes it on its encoder threads. Loading and warming up are
+		drawn into the hidden window, only the frames asked for are
+		written.
+
+		@param1 a_frameCount is how many frames to write.
+
+		@param2 a_directory is the directory they are written into, which
+				must exist.
+
+		@param3 a_pathFile is a camera path file, or nullptr to fly the
+				built in path through Sponza.
+
+		@param4 a_encoderCount is how many threads encode the frames, 0
+				for one less than the number of cores.
+
+		@return 0 if every frame was written.
+*/
+int Application::renderFrames(unsigned int a_frameCount, const char* a_directory, const char* a_pathFile,
+	unsigned int a_encoderCount)
+{
+	sns::CameraPath path;
+	if (a_pathFile == nullptr)
+		path.createSponza();
+	else if (path.load(a_pathFile) == false)
+		return -4;
+
+	m_headless = true;
+	m_loadStanford = m_benchmarkScene == sns::BenchmarkScene::STANFORD;
+	int result = initialize();
+	if (result != 0)
+		return result;
+
+	beginBenchmark(path);
+	switchBenchmarkScene(m_benchmarkScene);
+	if (m_frameCapture.create(m_windowResolution.x, m_windowResolution.y, a_directory, a_encoderCount) == false)
+		return -5;
+
+	sns::time start = m_clock.now();
+	for (unsigned int i = 0; i < a_frameCount; ++i)
+	{
+		glm::vec3 position;
+		glm::vec3 target;
+		path.sample((float)i / a_frameCount, position, target);
+		m_flyCam->setLookAt(position, target, glm::vec3(0, 1, 0));
+		update(BENCHMARK_TIME_STEP);
+	}
+	m_frameCapture.finish();
+	double seconds = (m_clock.now() - start).count() * NANO_TO_SECONDS;
+	m_cameraPath = nullptr;
+
+	sns::FrameCapture::Stats stats = m_frameCapture.getStats();
+	printf("Wrote %u of %u frames in %.2f s, %.2f frames a second, %.2f ms encoding each, %u captures stalled\n",
+		stats.written, stats.captured, seconds, seconds > 0.0 ? stats.written / seconds : 0.0,
+		stats.written > 0 ? stats.encodeMilliseconds / stats.written : 0.0, stats.stalls);
+	m_frameCapture.destroy();
+	return stats.written == a_frameCount ? 0 : -5;
+}
+
+/**
+	beginBenchmark stops taking input and holds every frame to the
+		same work, then waits for everything to load with the camera
+		at the start of a path.
+
+		@param1 path is the path the camera will fly.
+*/
+void Application::beginBenchmark(sns::CameraPath& path)
+{
+	// Vsync would hold every frame to the monitor's refresh rate.
+	m_framePacer.setMode(sns::PresentMode::UNCAPPED);
+
+	// Every frame is drawn at the window's size, so each is timed
+	//	drawing the same pixels.
+	m_dynamicResolution.setEnabled(false);
+	bool deferred = m_deferredShading && m_deferred.isCreated() && m_sceneTarget.getSamples() == 1;
+	printf("Benchmarking %s shading%s%s%s%s, anti-aliased with %s%s\n", deferred ? "deferred" : "forward",
+		deferred == false && m_depthPrepass ? " with a depth pre-pass" : "",
+		isAmbientOcclusion(deferred) ? " and ambient occlusion" : "",
+		deferred && m_reflections.isEnabled() ? " and reflections" : "",
+		m_temporalUpsampling && isTemporalUpsampling() ? ", temporally upsampled" : "",
+		sns::PostProcess::getAntiAliasingName(m_antiAliasing),
+		m_postProcess.getSettings().bloom ? ", with bloom" : "");
+
+	m_cameraPath = &path;
+	glm::vec3 position;
+	glm::vec3 target;
+	path.sample(0.0f, position, target);
+	m_flyCam->setLookAt(position, target, glm::vec3(0, 1, 0));
+
+	// Loading isn't what is being timed, so wait for every upload,
+	//	then give the drivers a few frames to settle.
+	while (m_assetLoader.getPendingCount() > 0 && glfwWindowShouldClose(window) == false)
+		update(BENCHMARK_TIME_STEP);
+	for (unsigned int i = 0; i < BENCHMARK_WARM_UP_FRAMES; ++i)
+		update(BENCHMARK_TIME_STEP);
+}
+
+/**
+	timeFrames times frames flown along a path, or replayed. Each
+		frame's time on the gpu is read once every frame is done.
+
+		@param1 frameCount is how many frames to time.
+
+		@param2 path is the path flown, once around over the frames.
+
+		@param3 replay is a recording to replay instead, or nullptr.
+				Its frames are run with the time steps and settings
+				they were recorded with, from the same start.
+
+		@return each frame's timings.
+*/
+sns::BenchmarkReport Application::timeFrames(unsigned int frameCount, const sns::CameraPath& path,
+	const sns::FrameRecording* replay)
+{
+	// Each frame gets its own queries, so none are read until the end
+	//	and reading them never holds up a timed frame.
+	std::vector<GLuint> timestamps(frameCount * 2);
+	glGenQueries((GLsizei)timestamps.size(), timestamps.data());
+
+	std::vector<double> frameMilliseconds;
+	std::vector<unsigned int> drawCalls;
+	std::vector<unsigned long long> heapAllocations;
+	frameMilliseconds.reserve(frameCount);
+	drawCalls.reserve(frameCount);
+	heapAllocations.reserve(frameCount);
+	double shadedFragments = 0.0;
+
+	for (unsigned int i = 0; i < frameCount && glfwWindowShouldClose(window) == false; ++i)
+	{
+		// A replay sets the simulation back to where the recording
+		//	started once its first frame's camera is in place, as the
+		//	recording did.
+		double deltaTime = BENCHMARK_TIME_STEP;
+		if (replay != nullptr)
+		{
+			applyRenderSettings(replay->getFrame(i).settings);
+			m_flyCam->setWorldTransform(replay->getCameraTransform(i));
+			if (i == 0)
+				restartSimulation(replay->getStart());
+			deltaTime = replay->getFrame(i).deltaTime;
+		}
+		else
+		{
+			glm::vec3 position;
+			glm::vec3 target;
+			path.sample((float)i / frameCount, position, target);
+			m_flyCam->setLookAt(position, target, glm::vec3(0, 1, 0));
+		}
+
+		m_frameTimestamps = &timestamps[i * 2];
+		sns::time start = m_clock.now();
+		update(deltaTime);
+		frameMilliseconds.push_back((m_clock.now() - start).count() * NANO_TO_SECONDS * 1000.0);
+		drawCalls.push_back(m_renderQueueItems + m_sceneBatch.getStats().drawCalls);
+		heapAllocations.push_back(sns::HeapTracker::getFrame().allocations);
+		shadedFragments += (double)m_shadedFragments.getCount();
+	}
+	m_frameTimestamps = nullptr;
+
+	sns::BenchmarkReport report;
+	for (size_t i = 0; i < frameMilliseconds.size(); ++i)
+	{
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(timestamps[i * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(timestamps[i * 2 + 1], GL_QUERY_RESULT, &end);
+		report.addFrame(frameMilliseconds[i], (end - begin) * NANO_TO_SECONDS * 1000.0, drawCalls[i],
+			heapAllocations[i]);
+	}
+	glDeleteQueries((GLsizei)timestamps.size(), timestamps.data());
+
+	if (report.getFrameCount() < frameCount)
+		printf("Benchmark stopped after %u of %u frames\n", report.getFrameCount(), frameCount);
+
+	// Each frame's count is from a few frames before, the same frames
+	//	of the path give or take the first few.
+	if (report.getFrameCount() > 0)
+		printf("Normal mapped scene overdraw: %.2f fragments shaded per pixel\n",
+			shadedFragments / report.getFrameCount() / ((double)m_windowResolution.x * m_windowResolution.y));
+
+	return report;
+}
+
+/**
+	switchBenchmarkScene adds what a benchmark scene needs to the
+		courtyard and takes away what the last one added. Emitters
+		can only be added and removed between frames, so the
+		simulation is stopped while they are.
+
+		@param1 scene is the scene.
+*/
+void Application::switchBenchmarkScene(sns::BenchmarkScene scene)
+{
+	m_pipeline.stop();
+
+	// Nine more emitters in a line through the courtyard, above the
+	//	first, each with its own fixed seed.
+	const unsigned int STRESS_EMITTERS = 9;
+	if (scene == sns::BenchmarkScene::PARTICLES && m_stressEmitters.empty())
+	{
+		for (unsigned int i = 0; i < STRESS_EMITTERS; ++i)
+		{
+			ParticleEmitter* emitter = m_particleSystem->createEmitter(1000, 500,
+				0.1f, 1.0f,
+				1, 5,
+				1, 0.1f,
+				glm::vec4(1, 0, 0, 1), glm::vec4(1, 1, 0, 1), i + 1);
+			emitter->setPosition(glm::vec3(((float)i - 4.0f) * 200.0f, 100.0f, 0.0f));
+			m_stressEmitters.push_back(emitter);
+		}
+	}
+	else if (scene != sns::BenchmarkScene::PARTICLES)
+	{
+		for (ParticleEmitter* emitter : m_stressEmitters)
+			m_particleSystem->destroyEmitter(emitter);
+		m_stressEmitters.clear();
+	}
+
+	if (scene == sns::BenchmarkScene::STANFORD && m_stanfordTransforms[0].empty())
+		printf("The Stanford scans weren't loaded, the stanford scene is the courtyard\n");
+	m_benchmarkScene = scene;
+
+	m_pipeline.start([this](sns::FramePacket& packet) { simulate(packet); }, captureInput(0.0));
+}
+
 int Application::initialize()
 {
 	//----------------------------------------------------------------------
@@ -60,34 +472,115 @@ int Application::initialize()
 	m_previousTime = m_clock.now();
 	//----------------------------------------------------------------------
 
+	// The job system's first use marks the main thread, so start it here.
+	sns::JobSystem& jobs = sns::JobSystem::instance();
+	sns::StartupTimeline& timeline = sns::StartupTimeline::instance();
+
+	// The scene's description is read and its meshes start importing on
+	//	a worker while the window and context are made, as they need no
+	//	GL. The scene's textures start with only their smallest levels
+	//	and stream the rest in as they are seen.
+	aie::TextureCache::instance().setStreaming(true);
+	sns::JobCounter sceneLoad;
+	bool sceneLoaded = false;
+	jobs.run([this, &sceneLoaded]()
+	{
+		{
+			SNS_STARTUP_PHASE("Scene description");
+			sceneLoaded = m_scene.load(m_sceneFile);
+		}
+		if (sceneLoaded)
+		{
+			SNS_STARTUP_PHASE("Scene mesh requests");
+			InitSceneMeshes();
+		}
+	}, &sceneLoad);
+
+	// The job reads locals, so it is waited for before any return.
+	auto fail = [&jobs, &sceneLoad](int code)
+	{
+		jobs.wait(sceneLoad);
+		return code;
+	};
+
 	// Check to see if we have access to the GPU.
+	timeline.mark("GLFW");
 	if (glfwInit() == false)
 	{
 		// -1 is a failure code.
-		return -1;
+		return fail(-1);
+	}
+
+	// Gets the amount of displays the PC has and allocates it into Screens.
+	//	GLFW owns the array.
+	screens = glfwGetMonitors(&screenCount);
+
+	// Across every monitor, the window covers the desktop they make
+	//	together, without a border between them and the views.
+	glm::ivec4 desktop(0);
+	if (m_monitorViews && screenCount > 1)
+	{
+		desktop = sns::ViewLayout::getDesktopBounds(screens, screenCount);
+		if (desktop.z > 0)
+		{
+			m_windowResolution = glm::ivec2(desktop.z, desktop.w);
+			glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
+		}
 	}
 
 	// Initialize the application's window.
 	// Window x and y, name of window, which screen it's on, shared or exclusive
+	//	A headless run only needs the window for its context.
+	timeline.mark("Window");
+	if (m_headless)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 	window = glfwCreateWindow(m_windowResolution.x, m_windowResolution.y, m_windowName, nullptr, nullptr);
-
-	// Gets the amount of displays the PC has and allocates it into Screens.
-	screens = glfwGetMonitors(&screenCount);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
 
 	if (window == nullptr)
 	{
 		glfwTerminate();
-		return -2;
+		return fail(-2);
 	}
 
+	if (desktop.z > 0)
+		glfwSetWindowPos(window, desktop.x, desktop.y);
+
+	// A view on each monitor the window covers, or one of all of it.
+	m_viewLayout.create(desktop.z > 0 ? screens : nullptr, screenCount, m_windowResolution);
+	if (m_viewLayout.getViewCount() > 1)
+		printf("Drawing %u views, one per monitor\n", m_viewLayout.getViewCount());
+
 	// Makes the application's window the current window.
+	timeline.mark("GL context");
 	glfwMakeContextCurrent(window);
 
 	// If openGL doesn't load, terminate the program and throw error 3.
 	if (ogl_LoadFunctions() == ogl_LOAD_FAILED) {
 		glfwDestroyWindow(window);
 		glfwTerminate();
-		return -3;
+		return fail(-3);
+	}
+
+	// External profilers' gl zones need the functions loaded.
+	SNS_TRACE_GL_CONTEXT();
+
+	// Big meshes like the Stanford scans are copied to the gpu on a
+	//	context of their own, rather than in the middle of a frame.
+	if (m_assetLoader.startUploadThread(window))
+		printf("Uploading mesh buffers on a shared context\n");
+
+	// Compute work that doesn't feed the next pass runs on a context of
+	//	its own, which the driver can overlap with the context thread's.
+	if (m_asyncCompute.create(window))
+		printf("Running async compute on a shared context\n");
+
+	// The control panel draws with the main context's objects, so it
+	//	shares them too.
+	if (m_controlPanelEnabled && m_headless == false &&
+		m_controlPanel.create(window, "SoxNSandals control panel", CONTROL_PANEL_WIDTH, CONTROL_PANEL_HEIGHT, true))
+	{
+		printf("Drawing the hud in a control panel window\n");
 	}
 
 	// Getting the version of OpenGL.
@@ -95,651 +588,3473 @@ int Application::initialize()
 	auto minor = ogl_GetMinorVersion();
 	printf("GL: %i.%i\n", major, minor);
 
+	// Collect the keyboard and mouse from here on.
+	m_input.attach(window);
+
+	// Present however was asked, benchmarks change it to uncapped.
+	m_framePacer.setMode(m_presentMode, m_presentRate);
+	printf("Presenting %s", sns::FramePacer::getModeName(m_framePacer.getMode()));
+	if (m_framePacer.getMode() == sns::PresentMode::CAPPED)
+		printf(" at %.0f frames per second", m_presentRate);
+	printf("\n");
+
 	// Clears screen to grey.
+	timeline.mark("Render targets");
 	glClearColor(0.25f, 0.25f, 0.25, 1);
 
 	// Enables depth buffer.
-	glEnable(GL_DEPTH_TEST);
+	sns::RenderState::instance().setDepthTest(true);
 
-	
-	//-----------------------------Textured-------------------------------------
-
-	// Initialize the unlit texture shader.
-	InitTexture();
-
-	// Load in the soul spear mesh.
-	if (m_spearMesh.load("../models/soulspear/soulspear.obj",
-		true, true) == false) {
-		printf("Soulspear Mesh Error!\n");
-		return false;
+	// Reverse depth into a float buffer where there is GL 4.5, so depth
+	//	is about as precise far away as close and there is no far plane.
+	//	It must be set before anything makes a depth target.
+	if (ogl_IsVersionGEQ(4, 5) != 0)
+	{
+		sns::RenderState::instance().setReverseZ(true);
+		if (m_sceneTarget.create(m_windowResolution.x, m_windowResolution.y))
+			m_flyCam->setReverseZ(true);
+		else
+			sns::RenderState::instance().setReverseZ(false);
 	}
+	printf("Depth: %s\n", m_sceneTarget.isCreated() ? "reversed, float" : "GL's usual, 24 bit");
 
-	// Set the spear mesh's position.
-	m_spearTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
+	// Temporal upsampling reads the scene target's depth, so only works
+	//	with one.
+	if (m_sceneTarget.isCreated())
+	{
+		m_temporalUpsampler.create(m_windowResolution.x, m_windowResolution.y);
+		m_postProcess.create();
+	}
+	applyAntiAliasing();
+	m_ambientOcclusion.create(m_windowResolution.x, m_windowResolution.y);
+
+	// The scene gets the whole of a frame on the gpu, or a 60th of a
+	//	second uncapped. Only what is drawn into the scene target can
+	//	be scaled.
+	m_dynamicResolution.setBudget(m_framePacer.getPeriodMilliseconds());
+	m_dynamicResolution.setEnabled(m_sceneTarget.isCreated());
+	if (m_sceneTarget.isCreated())
+		printf("Dynamic resolution: %.1f ms of gpu time for the scene\n", m_dynamicResolution.getBudget());
+
+	printf("Texture streaming: %.0f MB budget\n", m_textureStreamer.getBudget() / (1024.0 * 1024.0));
+	printf("Anisotropic filtering: %.0fx\n", aie::Texture::getAnisotropy());
+	printf("Parallel shader compile: %s\n", aie::ShaderProgram::hasParallelCompile() ? "yes" : "no");
+
+	// Create the per-frame camera and light buffer.
+	m_frameUniforms.create();
+
+	// Create the ring the per-draw blocks are written to, and give the
+	//	material block its binding before any program links.
+	sns::UniformRing::instance().create();
+	aie::OBJMesh::registerMaterialBlock();
+
+	// What the scene is made of, its meshes, lights and emitters, read
+	//	while the above was made.
+	timeline.mark("Scene description wait");
+	jobs.wait(sceneLoad);
+	if (sceneLoaded == false)
+	{
+		// The shared contexts' threads go before their windows do.
+		m_controlPanel.destroy();
+		m_asyncCompute.destroy();
+		m_assetLoader.stopUploadThread();
+		m_input.detach();
+		glfwDestroyWindow(window);
+		window = nullptr;
+		glfwTerminate();
+		return -4;
+	}
 	//--------------------------PhongNormalMap----------------------------------
 	//
 	// Initialize the Phong normal map shader.
+	timeline.mark("Shaders");
 	InitNormalMap();
-	// Initialize the Phong normal map down shader.
-	InitNormalMapDown();
+	// Initialize the g-buffer shaders for deferred shading.
+	InitDeferred();
+	// Initialize the depth pre-pass shaders for forward shading.
+	InitDepthPrepass();
+	// Initialize the light's shadow cascades.
+	InitShadows();
+	// Scatter the point and spot lights over the courtyard.
+	InitLightClusters();
+	// Fill the view with fog, in froxels of the clusters.
+	if (m_lightClusters.isCreated())
+		m_volumetricFog.create();
+	// Draw the sky behind the scene, as the sun lights the air.
+	m_sky.create();
+	// Bake the sun and sky into the scene meshes with lightmaps, and
+	//	trace them into the scene's probes for what moves through it.
+	m_lightmapper.create();
+	const sns::SceneDescription::Probes& probes = m_scene.getProbes();
+	if (probes.spacing > 0.0f)
+		m_probeVolume.create(probes.min, probes.max, probes.spacing, probes.reflections, probes.reflectionCount);
 	//-------------------------Light---------------------------
-	// Setting up the light.
-	m_light.diffuse = { 1, 1, 1 };
-	m_light.specular = { 1, 1, 1 };
-	m_ambientLight = { 0.25f, 0.25f, 0.25f };
+	// Setting up the light from the scene's sun.
+	m_light.diffuse = m_scene.getSun().diffuse;
+	m_light.specular = m_scene.getSun().specular;
+	m_ambientLight = m_scene.getSun().ambient;
 	m_ambientDownLight = { 0.25f, 0.25f, 0.25f };
 
-	// Load in the Sponza Building mesh and assign it to the correct mesh.
-	if (m_sponzaBuildingMesh.load("../models/Sponza/SingleObjs/Building.obj",
-		true, true) == false) {
-		printf("Building Mesh Error!\n");
-		return false;
+	// Normal map down light init
+	m_downLight.diffuse = { 1, 1, 1 };
+	m_downLight.specular = { 1, 1, 1 };
+
+	// The scene's meshes are already loading in the background, and draw
+	//	as each is uploaded. What needs the context is made now.
+	timeline.mark("Scene");
+	InitScene();
+
+	// Compile the lit permutations every scene mesh can ask for now,
+	//	instead of when they are first drawn.
+	timeline.mark("Lit shaders");
+	InitLitShaders();
+	//--------------------------------------------------------------------------
+
+	//-----------------------------Instanced------------------------------------
+
+	// Load the rock and tree and place hundreds of copies of each. The
+	//	copies are scattered everywhere, so their textures stay whole.
+	timeline.mark("Instanced");
+	aie::TextureCache::instance().setStreaming(false);
+	InitInstanced();
+
+	// The Stanford scans are only loaded for the benchmarks that draw
+	//	them.
+	if (m_loadStanford)
+	{
+		timeline.mark("Stanford");
+		InitStanford();
 	}
+	//--------------------------------------------------------------------------
 
-	// Initialize the Sponza Building's transform.
-	m_sponzaBuildingTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
+	//-----------------------------Planets--------------------------------------
 
-	// Load in the Sponza Curtains mesh and assign it to the correct mesh.
-	if (m_sponzaCurtainsMesh.load("../models/Sponza/SingleObjs/Curtains.obj",
-		true, true) == false) {
-		printf("Curtains Mesh Error!\n");
-		return false;
+	// The planets are drawn as instanced gizmo spheres, the debug hud
+	//	as 2D triangles.
+	timeline.mark("Planets");
+	aie::Gizmos::create(10000, 10000, 0, 16384, 64);
+
+	// Build the solar system above the courtyard. Without GL 4.5 the
+	//	planets stay gizmo spheres.
+	InitPlanets();
+	m_planetRenderer.create();
+	if (m_planetTrails.create((unsigned int)m_trailPlanets.size(), sns::TrailRenderer::MAX_HISTORY))
+	{
+		m_planetTrails.setWidth(1.5f, 0.0f);
+		m_planetTrails.setColour(glm::vec4(0.6f, 0.8f, 1, 0.6f), glm::vec4(0.6f, 0.8f, 1, 0));
 	}
+	//--------------------------------------------------------------------------
 
-	// Initialize the Sponza Curtains' transform.
-	m_sponzaCurtainsTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
+	//-----------------------------Particles------------------------------------
 
-	// Load in the Sponza Fountain Plants mesh and assign it to the correct mesh.
-	if (m_sponzaFountainPlantsMesh.load("../models/Sponza/SingleObjs/FountainPlants.obj",
-		true, true) == false) {
-		printf("FountainPlants Mesh Error!\n");
-		return false;
+	// Load vertex shader from file.
+	timeline.mark("Particles");
+	m_particleShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleVertex.vert");
+
+	// Load fragment shader from file.
+	m_particleShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/particleFrag.frag");
+
+	// If the linking of the particle shader doesn't work, display error.
+	if (m_particleShader.link() == false)
+	{
+		printf("Shader Error: %s\n", m_particleShader.getLastError());
 	}
 
-	// Initialize the Sponza Plants' transform.
-	m_sponzaFountainPlantsTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
+	// The same particles written into the transparency target instead.
+	m_particleTransparentShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleVertex.vert");
+	m_particleTransparentShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/particleTransparent.frag");
+	if (m_particleTransparentShader.link() == false)
+	{
+		printf("Shader Error: %s\n", m_particleTransparentShader.getLastError());
+	}
+	
+	// Creating the particle system, its emitters are simulated on
+	//	worker threads while the rest of the frame is drawn.
+	m_particleSystem = new sns::ParticleSystem();
 
-	// Load in the Sponza LionHeads mesh and assign it to the correct mesh.
-	if (m_sponzaLionHeadsMesh.load("../models/Sponza/SingleObjs/LionHeads.obj",
-		true, true) == false) {
-		printf("Lion Heads Mesh Error!\n");
-		return false;
+	// Creating the scene's emitters with their starting values.
+	for (const sns::SceneDescription::Emitter& description : m_scene.getEmitters())
+	{
+		ParticleEmitter* emitter = m_particleSystem->createEmitter(description.maxParticles, description.emitRate,
+			description.lifetime.x, description.lifetime.y,
+			description.velocity.x, description.velocity.y,
+			description.size.x, description.size.y,
+			description.startColour, description.endColour, description.seed);
+		emitter->setPosition(description.position);
+
+		sns::ParticleForces forces;
+		forces.gravity = description.gravity;
+		forces.drag = description.drag;
+		forces.curlStrength = description.curlNoise.x;
+		forces.curlScale = description.curlNoise.y;
+		forces.curlSpeed = description.curlNoise.z;
+		if (forces.isActive())
+			emitter->setForces(forces);
+
+		// Fast-forwarded on the workers over the first few frames, so
+		//	it shows already running.
+		if (description.prewarm != 0.0f)
+			m_particleSystem->prewarm(emitter, glm::max(description.prewarm, 0.0f));
 	}
 
-	// Initialize the Sponza Lion Head's transform.
-	m_sponzaLionHeadsTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
+	// The particles are blended, so they are sorted back to front.
+	m_particleSystem->setSortBudget(4096);
 
-	// Load in the Sponza Plants mesh and assign it to the correct mesh.
-	if (m_sponzaPlantsMesh.load("../models/Sponza/SingleObjs/Plants.obj",
-		true, true) == false) {
-		printf("Plants Mesh Error!\n");
-		return false;
+	// However many emitters are spawned, this many particles at most.
+	m_particleSystem->setParticleBudget(m_particleBudget);
+
+	// Smoke is fill rate bound, so the particles start at half size.
+	if (m_particleTarget.create(m_windowResolution.x, m_windowResolution.y, m_particleDivisor) == false)
+		m_particleDivisor = 0;
+
+	// Transparency is weighted by default, as it costs little more than
+	//	blending, and the particles needn't be sorted under it.
+	if (m_transparencyTarget.create(m_windowResolution.x, m_windowResolution.y))
+	{
+		m_transparencyMethod = sns::TransparencyTarget::WEIGHTED;
+		m_particleSystem->setSortBudget(0);
 	}
 
-	// Initialize the Sponza Plants' transform.
-	m_sponzaPlantsTransform = {
+	// Initialize the particle emitter's transform.
+	m_particleTransform = {
 		1,0,0,0,
 		0,1,0,0,
 		0,0,1,0,
 		0,0,0,1
 	};
 
-	// Load in the Sponza Ribbons mesh and assign it to the correct mesh.
-	if (m_sponzaRibbonsMesh.load("../models/Sponza/SingleObjs/Ribbons.obj",
-		true, true) == false) {
-		printf("Ribbons Mesh Error!\n");
-		return false;
+	// Watch the shaders so edits show up without a restart. The ones
+	//	with uniforms that are only set once set them again.
+	timeline.mark("Shader watcher");
+	m_shaderWatcher.watch(m_litShaders);
+	m_shaderWatcher.watch(m_crowdShaders);
+	m_shaderWatcher.watch(m_phongInstancedShader);
+	m_shaderWatcher.watch(m_normalMapBatchedShader);
+	m_shaderWatcher.watch(m_gBufferShader);
+	m_shaderWatcher.watch(m_gBufferBatchedShader);
+	m_shaderWatcher.watch(m_depthPrepassShader);
+	m_shaderWatcher.watch(m_depthPrepassAlphaShader);
+	m_shaderWatcher.watch(m_depthPrepassBatchedShader);
+	m_shaderWatcher.watch(m_depthPrepassBatchedAlphaShader);
+	if (aie::ShaderProgram::hasMeshShaders())
+	{
+		m_shaderWatcher.watch(m_normalMapMeshShader);
+		m_shaderWatcher.watch(m_depthPrepassMeshShader);
+		m_shaderWatcher.watch(m_depthPrepassMeshAlphaShader);
 	}
+	m_shaderWatcher.watch(m_shadowShader, [this]() { m_shadowCascades.invalidate(); m_shadowAtlas.invalidate(); });
+	m_shaderWatcher.watch(m_shadowInstancedShader, [this]() { m_shadowCascades.invalidate(); m_shadowAtlas.invalidate(); });
+	m_shaderWatcher.watch(m_shadowBatchedShader, [this]() { m_shadowCascades.invalidate(); m_shadowAtlas.invalidate(); });
+	m_shaderWatcher.watch(m_crowdShadowShader);
+	m_shaderWatcher.watch(m_depthBatchedShader);
+	m_shaderWatcher.watch(m_particleShader);
+	m_shaderWatcher.watch(m_particleTransparentShader);
+	if (m_terrain.isCreated())
+		m_shaderWatcher.watch(m_terrain.getShader());
+	if (m_ocean.isCreated())
+		m_shaderWatcher.watch(m_ocean.getShader());
+	if (m_planetRenderer.isCreated())
+		m_shaderWatcher.watch(m_planetRenderer.getShader());
+	if (m_impostorShader.getHandle() != 0)
+		m_shaderWatcher.watch(m_impostorShader);
+	m_shaderWatcher.start();
+
+	// The batch copies its meshes' textures, so it copies them again.
+	m_assetWatcher.setOnTextureReload([this]()
+	{
+		if (m_sceneBatch.isBuilt())
+			m_sceneBatch.build();
+	});
+	m_assetWatcher.start();
+	timeline.mark(nullptr);
+
+	// Everything the hud draws with is made by now.
+	if (m_controlPanel.isCreated() && m_debugHud.isVisible() == false)
+		m_debugHud.toggle();
+
+	if (m_telemetryAddress != nullptr)
+		m_telemetry.create(m_telemetryAddress);
+	if (m_videoStreamFile != nullptr)
+		m_videoEncoder.create(m_windowResolution.x, m_windowResolution.y, m_videoStreamFile, m_videoStreamSettings);
+
+	// Start simulating the first frame on its own thread.
+	m_pipeline.start([this](sns::FramePacket& packet) { simulate(packet); }, captureInput(0.0));
+	return 0;
+}
 
-	// Initialize the Sponza Ribbon's transform.
-	m_sponzaRibbonsTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
+/**
+	update gets called every frame. Anything that needs to be
+		called every frame is in this function such as render
+		and any input checks.
 
-	// Normal map down light init
-	m_downLight.diffuse = { 1, 1, 1 };
-	m_downLight.specular = { 1, 1, 1 };
+	@param1 deltaTime is how long the last frame took, in seconds.
 
-	// Load in the Sponza Floor mesh and assign it to the correct mesh.
-	if (m_sponzaFloorMesh.load("../models/Sponza/SingleObjs/Floor.obj",
-		true, true) == false) {
-		printf("Floor Mesh Error!\n");
-		return false;
+	@return true to keep the application running.
+*/
+bool Application::update(double deltaTime)
+{
+	// Everything from here to the swap is one frame of the profiler.
+	sns::Profiler::beginFrame();
+	SNS_TRACE_FRAME();
+	SNS_TRACE_ZONE("Application::update");
+
+	// Start counting this frame's uniform lookups, streaming waits and
+	//	state changes.
+	aie::ShaderProgram::resetLookupStats();
+	sns::StreamingBuffer::resetStats();
+	sns::RenderState::instance().resetStats();
+	sns::VertexArrays::instance().resetStats();
+
+	// Take the input that arrived since the last frame, and move the
+	//	camera with it before anything is drawn, so what is seen is as
+	//	new as it can be. A benchmark moves the camera itself, so input
+	//	is ignored.
+	{
+		SNS_PROFILE_SCOPE("Input");
+		SNS_HEAP_SCOPE("Input");
+		m_input.beginFrame(m_idle ? IDLE_TIMEOUT : 0.0);
 	}
 
-	// Initialize the Sponza Floor's transform.
-	m_sponzaFloorTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
-	//--------------------------------------------------------------------------
+	// However long an idle frame waited isn't counted as frame time,
+	//	for the camera or the pacer's missed frames.
+	if (m_idle)
+	{
+		m_currentTime = m_clock.now();
+		m_framePacer.skipFrame();
+		++m_idleFrames;
+	}
+	if (m_cameraPath == nullptr)
+	{
+		SNS_PROFILE_SCOPE("Camera update");
+		m_flyCam->update(deltaTime, m_input);
+
+		// F1 switches between forward and deferred shading, or with
+		//	control held steps the deferred path's reflections' quality.
+		if (m_input.wasKeyPressed(GLFW_KEY_F1) && m_input.isKeyDown(GLFW_KEY_LEFT_CONTROL))
+		{
+			if (m_deferred.isCreated())
+			{
+				m_reflections.setQuality((sns::ReflectionQuality)(((int)m_reflections.getQuality() + 1) %
+					(int)sns::ReflectionQuality::COUNT));
+				if (m_reflections.getQuality() != sns::ReflectionQuality::OFF)
+					m_reflections.create(m_deferred.getWidth(), m_deferred.getHeight());
+				m_frameReuse.invalidate();
+				printf("Reflections %s\n", sns::ScreenSpaceReflections::getQualityName(m_reflections.getQuality()));
+			}
+		}
+		else if (m_input.wasKeyPressed(GLFW_KEY_F1) && m_deferred.isCreated() && m_viewLayout.getViewCount() == 1)
+		{
+			m_deferredShading = !m_deferredShading;
+			printf("%s shading\n", m_deferredShading ? "Deferred" : "Forward");
+		}
+
+		// F2 switches forward shading's depth pre-pass, or with control
+		//	held whether the scene batch is drawn with mesh shaders.
+		if (m_input.wasKeyPressed(GLFW_KEY_F2) && m_input.isKeyDown(GLFW_KEY_LEFT_CONTROL))
+		{
+			if (m_sceneBatch.isMeshShading())
+			{
+				m_meshShading = !m_meshShading;
+				printf("Mesh shading %s\n", m_meshShading ? "on" : "off");
+			}
+		}
+		else if (m_input.wasKeyPressed(GLFW_KEY_F2))
+		{
+			m_depthPrepass = !m_depthPrepass;
+			printf("Depth pre-pass %s\n", m_depthPrepass ? "on" : "off");
+		}
+
+		// F3 switches the particles between half, quarter and full size,
+		//	or with control held order independent transparency between
+		//	off, weighted blended and linked lists.
+		if (m_input.wasKeyPressed(GLFW_KEY_F3) && m_input.isKeyDown(GLFW_KEY_LEFT_CONTROL))
+		{
+			if (m_transparencyTarget.isCreated())
+			{
+				m_transparencyMethod = m_transparencyMethod + 1 < (int)sns::TransparencyTarget::METHOD_COUNT ?
+					m_transparencyMethod + 1 : -1;
+				m_particleSystem->setSortBudget(m_transparencyMethod < 0 ? 4096 : 0);
+				m_frameReuse.invalidate();
+				printf("Order independent transparency %s\n", m_transparencyMethod < 0 ? "off" :
+					sns::TransparencyTarget::getMethodName((sns::TransparencyTarget::Method)m_transparencyMethod));
+			}
+		}
+		else if (m_input.wasKeyPressed(GLFW_KEY_F3))
+		{
+			m_particleDivisor = m_particleDivisor == 2 ? 4 : m_particleDivisor == 4 ? 0 : 2;
+			if (m_particleDivisor != 0 &&
+				m_particleTarget.create(m_windowResolution.x, m_windowResolution.y, m_particleDivisor) == false)
+				m_particleDivisor = 0;
+			printf("Particles drawn at %s size\n",
+				m_particleDivisor == 2 ? "half" : m_particleDivisor == 4 ? "quarter" : "full");
+		}
+
+		// F4 switches dynamic resolution.
+		if (m_input.wasKeyPressed(GLFW_KEY_F4) && m_sceneTarget.isCreated())
+		{
+			m_dynamicResolution.setEnabled(!m_dynamicResolution.isEnabled());
+			m_frameReuse.invalidate();
+			printf("Dynamic resolution %s\n", m_dynamicResolution.isEnabled() ? "on" : "off");
+		}
+
+		// F6 picks the scene in the middle of the window, where the
+		//	camera looks with the cursor hidden.
+		if (m_input.wasKeyPressed(GLFW_KEY_F6))
+		{
+			sns::time start = m_clock.now();
+			m_hasPick = pick(glm::vec2(m_windowResolution) * 0.5f, m_pick);
+			double milliseconds = (m_clock.now() - start).count() * NANO_TO_SECONDS * 1000.0;
+			if (m_hasPick)
+				printf("Picked %s chunk %u triangle %u at %.1f in %.3f ms\n",
+					m_sceneMeshes[m_pick.sceneMesh].mesh->getFilename().c_str(), m_pick.chunk,
+					m_pick.triangle, m_pick.distance, milliseconds);
+			else
+				printf("Picked nothing in %.3f ms\n", milliseconds);
+			m_frameReuse.invalidate();
+		}
+
+		// F7 pauses the simulation. A recording keeps real time steps,
+		//	so it can't be paused while recording.
+		if (m_input.wasKeyPressed(GLFW_KEY_F7) && m_recordingFile == nullptr)
+		{
+			m_simulationPaused = !m_simulationPaused;
+			printf("Simulation %s\n", m_simulationPaused ? "paused" : "running");
+		}
+
+		// F8 switches temporal upsampling, starting from no history, or
+		//	with control held the sky.
+		if (m_input.wasKeyPressed(GLFW_KEY_F8) && m_input.isKeyDown(GLFW_KEY_LEFT_CONTROL))
+		{
+			if (m_sky.isCreated())
+			{
+				m_sky.setEnabled(!m_sky.isEnabled());
+				m_frameReuse.invalidate();
+				printf("Sky %s\n", m_sky.isEnabled() ? "on" : "off");
+			}
+		}
+		else if (m_input.wasKeyPressed(GLFW_KEY_F8) && m_temporalUpsampler.isCreated())
+		{
+			m_temporalUpsampling = !m_temporalUpsampling;
+			m_temporalUpsampler.reset();
+			printf("Temporal upsampling %s\n", m_temporalUpsampling ? "on" : "off");
+		}
+
+		// F9 switches ambient occlusion, drawn from the depth pre-pass,
+		//	or with control held the volumetric fog.
+		if (m_input.wasKeyPressed(GLFW_KEY_F9) && m_input.isKeyDown(GLFW_KEY_LEFT_CONTROL))
+		{
+			if (m_volumetricFog.isCreated())
+			{
+				m_volumetricFog.setEnabled(!m_volumetricFog.isEnabled());
+				m_frameReuse.invalidate();
+				printf("Volumetric fog %s\n", m_volumetricFog.isEnabled() ? "on" : "off");
+			}
+		}
+		else if (m_input.wasKeyPressed(GLFW_KEY_F9) && m_ambientOcclusion.isCreated())
+		{
+			m_ambientOcclusionEnabled = !m_ambientOcclusionEnabled;
+			printf("Ambient occlusion %s\n", m_ambientOcclusionEnabled ? "on" : "off");
+		}
+
+		// F10 steps through the anti-aliasing modes, or with control held
+		//	switches the bloom.
+		if (m_input.wasKeyPressed(GLFW_KEY_F10) && m_input.isKeyDown(GLFW_KEY_LEFT_CONTROL))
+		{
+			sns::PostProcess::Settings& settings = m_postProcess.getSettings();
+			settings.bloom = !settings.bloom;
+			m_frameReuse.invalidate();
+			printf("Bloom %s\n", settings.bloom ? "on" : "off");
+		}
+		else if (m_input.wasKeyPressed(GLFW_KEY_F10))
+		{
+			m_antiAliasing = (sns::AntiAliasing)(((int)m_antiAliasing + 1) % (int)sns::AntiAliasing::COUNT);
+			applyAntiAliasing();
+			printf("Anti-aliasing with %s\n", sns::PostProcess::getAntiAliasingName(m_antiAliasing));
+		}
+
+		// F11 switches the occlusion queries of the scene's large chunks,
+		//	or with control held the software occlusion culling.
+		if (m_input.wasKeyPressed(GLFW_KEY_F11))
+		{
+			if (m_input.isKeyDown(GLFW_KEY_LEFT_CONTROL))
+			{
+				m_softwareOcclusionEnabled = !m_softwareOcclusionEnabled;
+				printf("Software occlusion culling %s\n", m_softwareOcclusionEnabled ? "on" : "off");
+			}
+			else if (m_occlusionQueries.isCreated())
+			{
+				m_occlusionQueriesEnabled = !m_occlusionQueriesEnabled;
+				printf("Occlusion queries %s\n", m_occlusionQueriesEnabled ? "on" : "off");
+			}
+		}
+
+		// F12 switches the stanford scene's scans to point clouds,
+		//	loading them the first time.
+		if (m_input.wasKeyPressed(GLFW_KEY_F12) && m_benchmarkScene == sns::BenchmarkScene::STANFORD)
+		{
+			m_stanfordPointsEnabled = !m_stanfordPointsEnabled;
+			if (m_stanfordPointsLoading == false)
+				LoadStanfordPoints();
+			printf("Stanford point clouds %s\n", m_stanfordPointsEnabled ? "on" : "off");
+		}
+
+		// A recording starts once everything has loaded, from the
+		//	simulation set back to a start it keeps, and then keeps
+		//	what each frame was run with.
+		if (m_recordingFile != nullptr)
+		{
+			if (m_recordingStarted == false && m_assetLoader.getPendingCount() == 0)
+			{
+				m_recording.begin(captureStart());
+				restartSimulation(m_recording.getStart());
+				m_recordingStarted = true;
+				printf("Recording to %s\n", m_recordingFile);
+			}
+			if (m_recordingStarted)
+				m_recording.addFrame(deltaTime, m_flyCam->getWorldTransform(), getRenderSettings());
+		}
+	}
 
-	//-----------------------------Particles------------------------------------
+	// Upload any meshes and textures that have finished loading
+	//	in the background, spending at most 4ms of the frame on meshes
+	//	and the texture uploader's budget on textures. Once the last one
+	//	is in, report how much the texture cache saved.
+	{
+		SNS_PROFILE_SCOPE("Asset uploads");
+		SNS_HEAP_SCOPE("Asset uploads");
+		unsigned int uploads = m_assetLoader.processUploads(0.004);
+
+		const sns::TextureUploader::Stats& uploadStats = m_assetLoader.getTextureUploader().getStats();
+		sns::Profiler::setCounter("Texture upload MB", uploadStats.uploadedBytes / (1024.0 * 1024.0));
+		sns::Profiler::setCounter("Textures uploading", uploadStats.pending);
+
+		// Whatever was uploaded casts shadows the cached cascades lack,
+		//	and wasn't in the last frame.
+		if (uploads > 0)
+		{
+			m_shadowCascades.invalidate();
+			m_shadowAtlas.invalidate();
+			m_frameReuse.invalidate();
+		}
+
+		if (uploads > 0 && m_assetLoader.getPendingCount() == 0)
+		{
+			aie::TextureCache::instance().printReport();
+			printf("Texture atlas: %u textures in %u pages\n", sns::TextureAtlas::instance().getTextureCount(),
+				sns::TextureAtlas::instance().getPageCount());
+
+			sns::FileSystem::Stats files = sns::FileSystem::instance().getStats();
+			printf("Files: %u from %u archives, %u loose, %u not found, %.1f MB decompressed\n",
+				files.archiveOpens, sns::FileSystem::instance().getArchiveCount(), files.looseOpens,
+				files.failures, files.decompressedBytes / (1024.0 * 1024.0));
+
+			// Everything is on the gpu, so the scene can be packed together.
+			buildSceneBatch();
+			buildSceneBvh();
+			sns::GpuMemory::instance().printReport();
+		}
+	}
 
-	// Load vertex shader from file.
-	m_particleShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleVertex.vert");
+	// Load the scene's cells near the camera and unload those it has
+	//	left. Anything built over the loaded meshes is built again when
+	//	that changes them.
+	if (m_sceneStreamer.isCreated())
+	{
+		SNS_PROFILE_SCOPE("Scene streaming");
+		SNS_HEAP_SCOPE("Scene streaming");
+		const glm::mat4& camera = m_flyCam->getWorldTransform();
+		if (m_sceneStreamer.update(m_assetLoader, glm::vec3(camera[3]), -glm::normalize(glm::vec3(camera[2]))))
+		{
+			buildSceneBvh();
+			m_shadowCascades.invalidate();
+			m_shadowAtlas.invalidate();
+			m_frameReuse.invalidate();
+		}
+
+		const sns::SceneStreamer::Stats& sceneStats = m_sceneStreamer.getStats();
+		sns::Profiler::setCounter("Scene cells resident", sceneStats.residentCells);
+		sns::Profiler::setCounter("Scene cells loading", sceneStats.loadingCells);
+		sns::Profiler::setCounter("Scene resident MB", sceneStats.residentBytes / (1024.0 * 1024.0));
+		sns::Profiler::setCounter("Scene mesh loads", sceneStats.loads);
+		sns::Profiler::setCounter("Scene mesh unloads", sceneStats.unloads);
+	}
 
-	// Load fragment shader from file.
-	m_particleShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/particleFrag.frag");
+	// Move texture levels in and out for what was seen last frame,
+	//	before anything is drawn with their handles in this one.
+	{
+		SNS_PROFILE_SCOPE("Texture streaming");
+		SNS_HEAP_SCOPE("Texture streaming");
+		m_textureStreamer.update();
+
+		const sns::TextureStreamer::Stats& streamStats = m_textureStreamer.getStats();
+		sns::Profiler::setCounter("Texture resident MB", streamStats.residentBytes / (1024.0 * 1024.0));
+		sns::Profiler::setCounter("Texture streamed MB", streamStats.uploadedBytes / (1024.0 * 1024.0));
+		sns::Profiler::setCounter("Texture loads", streamStats.loads);
+		sns::Profiler::setCounter("Texture evictions", streamStats.evictions);
+		sns::Profiler::setCounter("Texture starved", streamStats.starved);
+		if (streamStats.loads > 0 || streamStats.evictions > 0)
+			m_frameReuse.invalidate();
+	}
+
+	// And the virtual textures' pages their thread has read since.
+	if (m_virtualTextures.isCreated())
+	{
+		SNS_PROFILE_SCOPE("Virtual textures");
+		m_virtualTextures.update();
+
+		const sns::VirtualTextureCache::Stats& virtualStats = m_virtualTextures.getStats();
+		sns::Profiler::setCounter("Virtual pages resident", virtualStats.residentPages);
+		sns::Profiler::setCounter("Virtual pages seen", virtualStats.feedbackPages);
+		sns::Profiler::setCounter("Virtual page uploads", virtualStats.uploads);
+		sns::Profiler::setCounter("Virtual page evictions", virtualStats.evictions);
+		sns::Profiler::setCounter("Virtual cache MB", virtualStats.committedBytes / (1024.0 * 1024.0));
+		if (virtualStats.uploads > 0 || virtualStats.evictions > 0)
+			m_frameReuse.invalidate();
+	}
+
+	// Run the jobs that need the gl context, queued since the last frame.
+	{
+		SNS_PROFILE_SCOPE("Main thread jobs");
+		SNS_HEAP_SCOPE("Main thread jobs");
+		if (sns::JobSystem::instance().runMainThreadJobs() > 0)
+			m_frameReuse.invalidate();
+	}
+
+	// Relink any shader edited since the last frame.
+	{
+		SNS_PROFILE_SCOPE("Shader reloads");
+		if (m_shaderWatcher.update() > 0)
+			m_frameReuse.invalidate();
+	}
+
+	// Swap in any mesh or texture edited and loaded again since.
+	{
+		SNS_PROFILE_SCOPE("Asset reloads");
+		SNS_HEAP_SCOPE("Asset reloads");
+		if (m_assetWatcher.update(m_assetLoader) > 0)
+			m_frameReuse.invalidate();
+	}
+
+	// Benchmark frames time everything the gpu does from here to the swap.
+	if (m_frameTimestamps != nullptr)
+		glQueryCounter(m_frameTimestamps[0], GL_TIMESTAMP);
+
+	// Query time since application started.
+	float time = glfwGetTime();
+
+	// Light looking up.
+	m_light.direction = glm::normalize(glm::vec3(0, 1, 0));
+
+	// Light looking down.
+	m_downLight.direction = glm::normalize(glm::vec3(0, 1, 0));
+
+	// Take the frame the simulation thread finished during the last
+	//	frame, and start it on the next one from the camera as it is now.
+	{
+		SNS_PROFILE_SCOPE("Simulation wait");
+		m_packet = &m_pipeline.advance(captureInput(m_simulationPaused ? 0.0 : deltaTime));
+	}
+
+	// Pose the characters on the job system while the rest of the frame
+	//	is set up, render skins them once they are.
+	{
+		SNS_PROFILE_SCOPE("Animation");
+		SNS_HEAP_SCOPE("Animation");
+		m_animator.update(m_simulationPaused ? 0.0f : (float)deltaTime);
+		for (auto& crowd : m_crowds)
+			crowd->update(m_simulationPaused ? 0.0f : (float)deltaTime);
+	}
+
+	{
+		SNS_PROFILE_SCOPE("Cloth");
+		UpdateCloth(m_simulationPaused ? 0.0f : (float)deltaTime);
+	}
+
+	// The waves are transformed once a frame, for every view to draw.
+	if (m_ocean.isCreated())
+	{
+		SNS_PROFILE_SCOPE("Ocean");
+		SNS_PROFILE_GPU_SCOPE("Ocean waves");
+		m_ocean.update(m_simulationPaused ? 0.0f : (float)deltaTime);
+	}
+
+	// Move the planets and add them to this frame's gizmos. Running,
+	//	they and the particles move every frame, so none is the same
+	//	as the last, unless there is nothing to move.
+	{
+		SNS_PROFILE_SCOPE("Planets");
+		UpdatePlanets(m_simulationPaused ? 0.0f : (float)deltaTime);
+		if (m_simulationPaused == false && isSimulating())
+			m_frameReuse.invalidate();
+		if (m_benchmarkScene == sns::BenchmarkScene::GIZMOS)
+			UpdateGizmoStress();
+		if (m_hasPick)
+		{
+			glm::vec4 colour(1, 1, 0, 1);
+			for (unsigned int i = 0; i < 3; ++i)
+				aie::Gizmos::addLine(m_pick.corners[i], m_pick.corners[(i + 1) % 3], colour);
+		}
+	}
+
+	// A frame the same as the last drawn one only copies the scene
+	//	target to the window again, or the upsampled frame once it has
+	//	every sample.
+	bool temporal = isTemporalUpsampling();
+	if (temporal && m_temporalUpsampler.isConverged() == false)
+		m_frameReuse.invalidate();
+
+	// Frames being captured are drawn into the capture's framebuffer
+	//	instead of the window's, every target ending in whatever was
+	//	bound before it.
+	if (m_frameCapture.isCreated())
+		m_frameCapture.bind();
+	bool reused = m_sceneTarget.isCreated() && m_frameReuse.canReuse(makeFrameKey());
+	if (reused)
+	{
+		SNS_PROFILE_SCOPE("Frame reuse");
+		presentScene(temporal, false);
+	}
+	else
+	{
+		// Draw into the scene target when there is one, it's copied to
+		//	the window after render. The gpu's time over it a few frames
+		//	ago decides how much of it to draw into.
+		if (m_sceneTarget.isCreated())
+		{
+			m_dynamicResolution.begin();
+			bool upsampled = temporal && m_temporalUpsampling;
+			m_sceneTarget.setScale(m_dynamicResolution.getScale() * (upsampled ? sns::TemporalUpsampler::SCALE : 1.0f));
+			m_sceneTarget.begin();
+		}
+
+		// Clearing buffer - colour and depth checks.
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// Call render to draw everything to the screen.
+		SNS_PROFILE_SCOPE("Render");
+		SNS_HEAP_SCOPE("Render");
+		render();
+		if (m_sceneTarget.isCreated())
+		{
+			m_dynamicResolution.end();
+			m_sceneTarget.end(false);
+		}
+		if (temporal)
+		{
+			SNS_PROFILE_GPU_SCOPE("Temporal resolve");
+			m_temporalUpsampler.resolve(m_sceneTarget.getColourTexture(), m_sceneTarget.getDepthTexture(),
+				m_sceneTarget.getRenderWidth(), m_sceneTarget.getRenderHeight(), m_packet->input.projectionView,
+				m_simulationPaused);
+		}
+		if (m_sceneTarget.isCreated())
+		{
+			SNS_PROFILE_GPU_SCOPE("Post process");
+			presentScene(temporal, true);
+		}
+		m_frameReuse.drawn(makeFrameKey());
+	}
+	sns::Profiler::setCounter("Frames reused", m_frameReuse.getStats().reused);
+	sns::Profiler::setCounter("Frames idle", m_idleFrames);
+
+	// The hud goes over the finished frame, at the window's resolution,
+	//	or into the control panel's next frame, after which whatever the
+	//	frame was drawn into is bound again.
+	if (m_controlPanel.isCreated())
+	{
+		SNS_PROFILE_SCOPE("Control panel");
+		SNS_HEAP_SCOPE("Debug hud");
+		m_controlPanel.begin();
+		glClear(GL_COLOR_BUFFER_BIT);
+		m_debugHud.draw(m_controlPanel.getWidth(), m_controlPanel.getHeight());
+		m_controlPanel.end();
+
+		if (m_frameCapture.isCreated())
+			m_frameCapture.bind();
+		else
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, m_windowResolution.x, m_windowResolution.y);
+		}
+	}
+	else
+	{
+		SNS_PROFILE_SCOPE("Debug hud");
+		SNS_HEAP_SCOPE("Debug hud");
+		m_debugHud.draw(m_windowResolution.x, m_windowResolution.y);
+	}
+
+	// The finished frame goes to the encoder before it is presented or
+	//	read back.
+	if (m_videoEncoder.isCreated())
+	{
+		m_videoEncoder.encode(m_frameCapture.isCreated() ? m_frameCapture.getFramebuffer() : 0);
+		sns::VideoEncoder::Stats videoStats = m_videoEncoder.getStats();
+		sns::Profiler::setCounter("Video frames", videoStats.frames);
+		sns::Profiler::setCounter("Video MB", videoStats.bytes / (1024.0 * 1024.0));
+		sns::Profiler::setCounter("Video encode ms", videoStats.lastMilliseconds);
+		sns::Profiler::setCounter("Video encode stalls", videoStats.stalls);
+	}
+
+	// The finished frame is read back to be written, and the window
+	//	bound again for anything that draws into it between frames.
+	if (m_frameCapture.isCreated())
+	{
+		m_frameCapture.capture();
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	if (m_frameTimestamps != nullptr)
+		glQueryCounter(m_frameTimestamps[1], GL_TIMESTAMP);
+
+#ifdef _DEBUG
+	// Uniform locations should all come from the tables built at link time,
+	//	so any GL query made during the frame is worth knowing about.
+	const aie::ShaderProgram::LookupStats& lookups = aie::ShaderProgram::getLookupStats();
+	if (lookups.glQueries > 0)
+		printf("Uniform locations: %u table lookups, %u GL queries this frame\n",
+			lookups.tableLookups, lookups.glQueries);
+
+	// Streaming buffers have a region per frame in flight, so waiting on
+	//	one means the gpu is more than that many frames behind.
+	const sns::StreamingBuffer::Stats& streaming = sns::StreamingBuffer::getStats();
+	if (streaming.stalls > 0)
+		printf("Streaming buffers: %u of %u writes stalled for %.3f ms this frame\n",
+			streaming.stalls, streaming.writes, streaming.stallMilliseconds);
+
+	// Everything goes through the render state, so it should never have
+	//	to ask the driver what is bound.
+	const sns::RenderState::Stats& state = sns::RenderState::instance().getStats();
+	if (state.queries > 0)
+		printf("Render state: %u GL queries this frame\n", state.queries);
+#endif
+
+	sns::Profiler::setCounter("GL state calls sent", sns::RenderState::instance().getStats().sent);
+	sns::Profiler::setCounter("GL state calls skipped", sns::RenderState::instance().getStats().skipped);
+	sns::Profiler::setCounter("Vertex buffers attached", sns::VertexArrays::instance().getStats().attached);
+	sns::Profiler::setCounter("Draw calls", sns::RenderState::instance().getStats().draws);
+	sns::GpuMemory::instance().update();
+	sns::GpuReadback::instance().update();
+	sns::Profiler::setCounter("GPU readbacks pending", sns::GpuReadback::instance().getStats().pending);
+	sns::Profiler::setCounter("Frame arena bytes", (double)m_packet->arena->getUsed());
+	sns::Profiler::setCounter("Particle emitters culled", m_packet->particles.culledCount);
+
+	unsigned int particles = 0;
+	for (unsigned int i = 0; i < m_packet->particles.emitterCount; ++i)
+		particles += m_packet->particles.counts[i];
+	sns::Profiler::setCounter("Particles drawn", particles);
+	sns::Profiler::setCounter("Input events dropped", m_input.getDroppedEvents());
+
+	// -1 for a frame the scale went down, 1 for up.
+	sns::DynamicResolution::Decision decision = m_dynamicResolution.getDecision();
+	sns::Profiler::setCounter("Render scale", m_dynamicResolution.getScale());
+	sns::Profiler::setCounter("Render scale decision", decision == sns::DynamicResolution::Decision::LOWER ? -1.0 :
+		decision == sns::DynamicResolution::Decision::RAISE ? 1.0 : 0.0);
+	sns::Profiler::setCounter("Render scale changes", m_dynamicResolution.getChanges());
+	sns::Profiler::setCounter("Scene gpu ms", m_dynamicResolution.getGpuMilliseconds());
+
+	// Hold the frame to the capped rate, if there is one.
+	{
+		SNS_PROFILE_SCOPE("Frame limiter");
+		m_framePacer.wait();
+	}
+
+	// The frame's blocks have all been drawn with, fence their region
+	//	before presenting.
+	{
+		sns::UniformRing& ring = sns::UniformRing::instance();
+		sns::Profiler::setCounter("Uniform blocks", ring.getStats().blocks);
+		sns::Profiler::setCounter("Uniform ring stalls", ring.getStats().stalls);
+		ring.resetStats();
+		ring.nextFrame();
+	}
+
+	// Swap buffers.
+	{
+		SNS_PROFILE_SCOPE("Swap");
+		glfwSwapBuffers(window);
+	}
+
+	// The startup timeline is printed once everything asked for while
+	//	starting has loaded, after the first frame.
+	sns::StartupTimeline& timeline = sns::StartupTimeline::instance();
+	if (timeline.isRecording())
+	{
+		timeline.markFirstFrame();
+		if (m_assetLoader.getPendingCount() == 0)
+			timeline.finish();
+	}
+	SNS_TRACE_GL_COLLECT();
+	m_framePacer.endFrame();
+
+	const sns::FramePacer::Stats& pacing = m_framePacer.getStats();
+	sns::Profiler::setCounter("Frame time average ms", pacing.averageMilliseconds);
+	sns::Profiler::setCounter("Frame time jitter ms", pacing.jitterMilliseconds);
+	sns::Profiler::setCounter("Frames missed", pacing.missed);
+	if (m_telemetry.isCreated())
+		sns::Profiler::setCounter("Telemetry frames dropped", (double)m_telemetry.getStats().framesDropped);
+
+	sns::HeapTracker::endFrame();
+	sns::Profiler::endFrame();
+
+	// The frame old enough for its gpu scopes to have been read.
+	if (m_telemetry.isCreated())
+		m_telemetry.submit(sns::Profiler::getFrame(sns::Profiler::GPU_LATENCY + 1));
+
+	// F5 shows the debug hud. It can turn the profiler on, so only
+	//	between frames. A closed control panel leaves it over the frame.
+	if (m_cameraPath == nullptr && m_input.wasKeyPressed(GLFW_KEY_F5))
+		m_debugHud.toggle();
+	if (m_controlPanel.shouldClose())
+	{
+		sns::SharedWindow::Stats panel = m_controlPanel.getStats();
+		printf("Control panel closed: %llu frames drawn, %llu presented, %llu dropped\n",
+			panel.drawn, panel.presented, panel.dropped);
+		m_controlPanel.destroy();
+	}
+
+	// A frame that drew nothing new, with no input and nothing loading,
+	//	makes the next one wait for input before it starts. The hud's
+	//	counters, a benchmark and a capture or stream all change every
+	//	frame, so never wait.
+	m_idle = m_idleWait && reused && m_input.hadEvents() == false && m_cameraPath == nullptr &&
+		m_debugHud.isVisible() == false && m_assetLoader.getPendingCount() == 0 &&
+		m_frameCapture.isCreated() == false && m_videoEncoder.isCreated() == false;
+	return true;
+}
+
+/**
+	isSimulating returns whether running the simulation moves anything:
+		the particles, planets, characters, crowds, cloth or sea.
+*/
+bool Application::isSimulating() const
+{
+	return m_particleSystem->getEmitterCount() > 0 || m_entities.orbits.size() > 0 ||
+		m_entities.gravity.getBodyCount() > 0 || m_animator.getCharacterCount() > 0 ||
+		m_crowds.empty() == false || m_sceneCloths.empty() == false || m_ocean.isCreated();
+}
+
+void Application::render()
+{
+	SNS_TRACE_ZONE("Application::render");
+	// Each view draws the same frame from its own turn of the camera,
+	//	into its own part of the scene. With one view that is the camera
+	//	as it is, over all of it.
+	unsigned int viewCount = m_viewLayout.getViewCount();
+	float scale = m_sceneTarget.isCreated() ? m_sceneTarget.getScale() : 1.0f;
+	for (unsigned int i = 0; i < viewCount; ++i)
+	{
+		sns::FrameInput& view = m_viewInputs[i];
+		view = m_packet->input;
+		m_viewLayout.makeCamera(i, m_packet->input.view, m_packet->input.projection, view.view, view.projection);
+
+		// Upsampled, each frame is drawn from a different point in its
+		//	pixels.
+		if (isTemporalUpsampling())
+		{
+			glm::ivec2 renderResolution = getRenderResolution();
+			sns::TemporalUpsampler::jitterProjection(view.projection,
+				m_temporalUpsampler.getJitter(renderResolution.x, renderResolution.y));
+		}
+		view.projectionView = view.projection * view.view;
+		m_viewports[i] = m_viewLayout.getViewport(i, scale);
+	}
+
+	// Deferred shading copies its g-buffer out to the bottom left of the
+	//	window, so only draws a single view, and can't copy it into
+	//	multisampled targets.
+	bool deferred = m_deferredShading && m_deferred.isCreated() && viewCount == 1 && m_sceneTarget.getSamples() == 1;
+
+	// Fit the light's cascades to the camera, or around every view
+	//	when there are several. Only cascades the camera has moved out
+	//	of draw the static casters again, the planets and characters
+	//	are drawn into every cascade each frame.
+	{
+		SNS_PROFILE_SCOPE("Skinning");
+		SNS_PROFILE_GPU_SCOPE("Skinning");
+		m_animator.skin();
+	}
+
+	// Only scene meshes placed or moved since last frame are written.
+	m_sceneObjects.upload();
+
+	// Foliage and scans whose meshes have loaded bake their impostors,
+	//	before any pass has a framebuffer bound.
+	m_foliage.prepare(m_impostorBaker);
+	if (m_loadStanford)
+	{
+		for (unsigned int i = 0; i < STANFORD_SCAN_COUNT; ++i)
+		{
+			if (m_stanfordImpostors[i].isCreated() == false && m_stanfordMeshes[i].isLoaded())
+				m_impostorBaker.bake(m_stanfordMeshes[i], false, m_stanfordImpostors[i]);
+		}
+	}
+
+	// Give the point and spot lights nearest to covering the screen their
+	//	tiles of the atlas. A tile is only drawn again when its light, or
+	//	a character or crowd in its reach, moved.
+	if (m_shadowAtlas.isCreated())
+	{
+		SNS_PROFILE_SCOPE("Shadow atlas");
+		SNS_PROFILE_GPU_SCOPE("Shadow atlas");
+		m_movedShadowCasters.clear();
+		m_animator.getBounds(m_movedShadowCasters);
+		if (m_simulationPaused == false)
+		{
+			for (auto& crowd : m_crowds)
+				crowd->getBounds(m_movedShadowCasters);
+		}
+		m_shadowAtlas.update(m_lightClusters.getLights(), m_packet->input.view,
+			m_viewLayout.makeBoundingProjection(m_packet->input.projection), getRenderResolution().y,
+			m_movedShadowCasters,
+			[this](const glm::mat4& lightProjectionView) { drawStaticShadowCasters(lightProjectionView); },
+			[this](const glm::mat4& lightProjectionView) { drawDynamicShadowCasters(lightProjectionView); });
+		sns::Profiler::setCounter("Shadow atlas lights", m_shadowAtlas.getShadowedCount());
+		sns::Profiler::setCounter("Shadow atlas redrawn", m_shadowAtlas.getDynamicDraws());
+	}
+
+	// With the lights given their atlas slots, a single view's are binned
+	//	on the async compute context, beside the cascades and the passes
+	//	up to the shading, which waits for them.
+	m_asyncClusters = 0;
+	if (m_asyncCompute.isCreated() && m_lightClusters.isCreated() && viewCount == 1 &&
+		(deferred == false || m_volumetricFog.isEnabled()))
+	{
+		SNS_PROFILE_SCOPE("Light clusters");
+		const sns::FrameInput& input = m_viewInputs[0];
+		m_lightClusters.prepare(input.view, input.projection, input.nearPlane, input.farPlane,
+			m_viewports[0].z, m_viewports[0].w);
+		m_asyncClusters = m_asyncCompute.submit("Light clusters async", [this]() { m_lightClusters.bin(); });
+	}
+
+	{
+		SNS_PROFILE_SCOPE("Shadow cascades");
+		SNS_PROFILE_GPU_SCOPE("Shadow cascades");
+		m_shadowCascades.update(m_light.direction, m_packet->input.view,
+			m_viewLayout.makeBoundingProjection(m_packet->input.projection),
+			m_packet->input.nearPlane, m_packet->input.farPlane,
+			[this](const glm::mat4& lightProjectionView) { drawStaticShadowCasters(lightProjectionView); },
+			[this](const glm::mat4& lightProjectionView)
+			{
+				aie::Gizmos::drawDepth(lightProjectionView);
+				drawDynamicShadowCasters(lightProjectionView);
+			});
+		sns::Profiler::setCounter("Shadow cascades redrawn", m_shadowCascades.getStaticDraws());
+	}
+
+	// Once every scene mesh that stays loaded and still has loaded, they
+	//	are gathered for the lightmaps and probes to be traced through.
+	if (m_traceScene.isBuilt() == false && (m_lightmapper.isCreated() || m_probeVolume.isCreated()) &&
+		std::all_of(m_sceneMeshes.begin(), m_sceneMeshes.end(), [](const SceneMesh& sceneMesh)
+		{
+			return sceneMesh.streamed || sceneMesh.cloth || sceneMesh.mesh->isLoaded();
+		}))
+	{
+		SNS_PROFILE_SCOPE("Trace scene");
+		m_traceScene.clear();
+		for (const auto& sceneMesh : m_sceneMeshes)
+		{
+			if (sceneMesh.streamed == false && sceneMesh.cloth == false)
+				m_traceScene.add(*sceneMesh.mesh, sceneMesh.transform);
+		}
+		m_traceScene.build();
+		m_lightmapper.clear();
+	}
+
+	// The lightmaps are then packed and either loaded from the last bake
+	//	of the scene or baked a pass a frame. They are drawn lit by their
+	//	lights until done.
+	if (m_lightmapper.isCreated() && m_traceScene.isBuilt())
+	{
+		SNS_PROFILE_SCOPE("Lightmap bake");
+		SNS_PROFILE_GPU_SCOPE("Lightmap bake");
+		if (m_lightmapper.isBuilt() == false)
+		{
+			std::vector<unsigned int> placed;
+			for (unsigned int i = 0; i < m_sceneMeshes.size(); ++i)
+			{
+				if (m_sceneMeshes[i].lightmapped)
+				{
+					m_lightmapper.add(*m_sceneMeshes[i].mesh, m_sceneMeshes[i].transform);
+					placed.push_back(i);
+				}
+			}
+			std::string filename = std::string(m_sceneFile) + ".lightmap";
+			if (m_lightmapper.build(m_traceScene, m_light.direction, m_light.diffuse, m_ambientLight, filename.c_str()))
+			{
+				for (unsigned int i = 0; i < placed.size(); ++i)
+					m_sceneObjects.setLightmapRect(m_sceneMeshes[placed[i]].object, m_lightmapper.getRect(i));
+				m_sceneObjects.upload();
+			}
+		}
+		m_lightmapper.update();
+		sns::Profiler::setCounter("Lightmap baked %", m_lightmapper.getProgress() * 100.0);
+	}
+
+	// A few of the probes are traced again each frame, lit as the
+	//	lightmaps are, for the characters and crowds to move through.
+	if (m_probeVolume.isCreated() && m_traceScene.isBuilt())
+	{
+		SNS_PROFILE_SCOPE("Probes");
+		SNS_PROFILE_GPU_SCOPE("Probes");
+		m_probeVolume.update(m_traceScene, m_light.direction, m_light.diffuse, m_ambientLight);
+		sns::Profiler::setCounter("Probes traced", m_probeVolume.getUpdatedCount());
+	}
+
+	// Deferred shading culls the point and spot lights per tile itself,
+	//	so only needs them uploaded, with the atlas slots they were just
+	//	given. Forward shading bins them into each view's clusters as it
+	//	draws it.
+	if (deferred && m_asyncClusters == 0)
+	{
+		SNS_PROFILE_SCOPE("Light clusters");
+		SNS_PROFILE_GPU_SCOPE("Light clusters");
+		m_lightClusters.upload();
+	}
+
+	// Submit every mesh once for all the views, then draw them sorted by
+	//	program, texture and vertex array so each state change happens
+	//	as few times as possible. Chunks are culled against each view
+	//	as they are submitted, using frustums in each mesh's local
+	//	space, and each view only draws the ones it can see.
+	sns::Frustum::resetStats();
+	m_renderQueueItems = 0;
+	{
+		SNS_PROFILE_SCOPE("Texture requests");
+		requestSceneTextures();
+	}
+	if (m_softwareOcclusionEnabled)
+		renderSoftwareOcclusion();
+	{
+		SNS_PROFILE_SCOPE("Render queue submit");
+		if (deferred)
+			submitSceneMeshes(m_sceneQueues[SCENE_PASS_SHADED], true, &m_gBufferShader, nullptr);
+		else
+		{
+			if (m_depthPrepass)
+				submitSceneMeshes(m_sceneQueues[SCENE_PASS_DEPTH], true, &m_depthPrepassShader, &m_depthPrepassAlphaShader);
+			submitSceneMeshes(m_sceneQueues[SCENE_PASS_SHADED], true, nullptr, nullptr);
+		}
+		submitSceneMeshes(m_sceneQueues[SCENE_PASS_OTHERS], false, nullptr, nullptr);
+		if (m_transparencyMethod >= 0)
+			submitSceneMeshes(m_sceneQueues[SCENE_PASS_TRANSPARENT], false, nullptr, nullptr, true);
+		for (sns::RenderQueue& queue : m_sceneQueues)
+			queue.sort();
+	}
+
+	// The first view's large chunks are given their queries, whose last
+	//	results its draws go by.
+	if (m_occlusionQueriesEnabled)
+	{
+		SNS_PROFILE_SCOPE("Occlusion queries");
+		const sns::FrameInput& input = m_viewInputs[0];
+		m_occlusionQueries.beginFrame();
+		m_occlusionQueries.assign(m_sceneQueues[SCENE_PASS_DEPTH], m_sceneObjects, 1u, input.cameraPosition,
+			input.nearPlane);
+		m_occlusionQueries.assign(m_sceneQueues[SCENE_PASS_SHADED], m_sceneObjects, 1u, input.cameraPosition,
+			input.nearPlane);
+	}
+
+	for (unsigned int i = 0; i < viewCount; ++i)
+		renderView(i, deferred);
+
+	for (sns::RenderQueue& queue : m_sceneQueues)
+		queue.clear();
+	glm::ivec2 renderResolution = getRenderResolution();
+	glViewport(0, 0, renderResolution.x, renderResolution.y);
+
+	// How many times each pixel of the first view was shaded by the
+	//	normal mapped scene, a few frames ago, 1 with no overdraw at all.
+	double shadedFragments = (double)m_shadedFragments.getCount();
+	sns::Profiler::setCounter("Shaded fragments", shadedFragments);
+	sns::Profiler::setCounter("Overdraw", shadedFragments / ((double)m_viewports[0].z * m_viewports[0].w));
+	sns::Profiler::setCounter("Views", viewCount);
+
+	// What the last view's graph ran, and what its transients would take
+	//	without sharing textures.
+	const sns::RenderGraph::Stats& graphStats = m_renderGraph.getStats();
+	sns::Profiler::setCounter("Render graph passes", graphStats.passes);
+	sns::Profiler::setCounter("Render graph passes culled", graphStats.culled);
+	sns::Profiler::setCounter("Render graph MB", graphStats.textureBytes / (1024.0 * 1024.0));
+	sns::Profiler::setCounter("Render graph unaliased MB", graphStats.transientBytes / (1024.0 * 1024.0));
+
+	const sns::MeshBatch::Stats& batchStats = m_sceneBatch.getStats();
+	sns::Profiler::setCounter("Meshlets visible", batchStats.clustersVisible);
+	sns::Profiler::setCounter("Meshlets occluded", batchStats.clustersOccluded);
+	if (m_occlusionQueriesEnabled)
+	{
+		sns::Profiler::setCounter("Chunks queried", m_occlusionQueries.getStats().issued);
+		sns::Profiler::setCounter("Chunks occluded", m_sceneQueues[SCENE_PASS_SHADED].getStats().occluded);
+	}
+	if (m_softwareOcclusionEnabled)
+	{
+		sns::SoftwareOcclusion::Stats occlusionStats = m_softwareOcclusion.getStats();
+		sns::Profiler::setCounter("Software occluder triangles", occlusionStats.triangles);
+		sns::Profiler::setCounter("Software chunks tested", occlusionStats.tested);
+		sns::Profiler::setCounter("Software chunks occluded", occlusionStats.occluded);
+	}
+}
+
+/**
+	renderView draws the frame from one view, into its part of the
+		window. The scene queues are already submitted and sorted, and
+		the passes are run through m_renderGraph.
+
+		@param1 view is the view's index in m_viewLayout.
+
+		@param2 deferred is whether the normal mapped scene is deferred
+				shaded.
+*/
+void Application::renderView(unsigned int view, bool deferred)
+{
+	m_currentView = view;
+	const sns::FrameInput& input = m_viewInputs[view];
+	const glm::ivec4& viewport = m_viewports[view];
+	glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+	unsigned int viewMask = 1u << view;
+	const glm::mat4& projectionView = input.projectionView;
+
+	// The passes are declared with what they read and write, then run
+	//	in that order by the graph, which culls any nothing uses. The
+	//	framebuffer the view is drawn into and what the classes keep
+	//	outlive it. The depth copies are only needed within their
+	//	passes, so share a texture.
+	sns::RenderGraph& graph = m_renderGraph;
+	typedef sns::RenderGraph::Resource Resource;
+	const Resource sceneColour = graph.importResource("Scene colour");
+	const Resource sceneDepth = graph.importResource("Scene depth");
+	const Resource lights = graph.importResource("Light clusters");
+	const Resource frameUniforms = graph.importResource("Frame uniforms");
+	const Resource fog = graph.importResource("Volumetric fog");
+	const Resource hiZ = graph.importResource("HiZ");
+	const Resource feedback = graph.importResource("Virtual texture feedback");
+	const Resource culled = graph.importResource("Culled draws");
+	const Resource ambientOcclusion = graph.importResource("Ambient occlusion");
+	const Resource gBuffer = graph.importResource("G-buffer");
+	const Resource queries = graph.importResource("Occlusion queries");
+	const sns::RenderGraph::TextureDesc depthCopy =
+		{ sns::RenderState::instance().getDepthFormat(), m_windowResolution.x, m_windowResolution.y };
+
+	// Bin the point and spot lights into this view's clusters, which the
+	//	frame uniforms tell the normal map shaders how to find. Deferred
+	//	shading bins its own, but the fog is lit through these. When they
+	//	were binned asynchronously, the gpu only waits for them here.
+	if (m_asyncClusters != 0)
+	{
+		graph.addPass("Light clusters wait", [&]()
+		{
+			SNS_PROFILE_SCOPE("Light clusters wait");
+			m_asyncCompute.wait(m_asyncClusters);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		}).write(lights);
+	}
+	else if (deferred == false || m_volumetricFog.isEnabled())
+	{
+		graph.addPass("Light clusters", [&]()
+		{
+			SNS_PROFILE_SCOPE("Light clusters");
+			SNS_PROFILE_GPU_SCOPE("Light clusters");
+			m_lightClusters.update(input.view, input.projection, input.nearPlane, input.farPlane, viewport.z, viewport.w);
+		}).write(lights);
+	}
+
+	// Write the camera and lights once for every program, and point the
+	//	lit shaders at the lights and shadows.
+	bool occlusion = isAmbientOcclusion(deferred);
+	graph.addPass("Frame uniforms", [&]()
+	{
+		{
+			SNS_PROFILE_SCOPE("Frame uniforms");
+			updateFrameUniforms(occlusion);
+		}
+		{
+			SNS_PROFILE_SCOPE("Normal map");
+			SNS_PROFILE_GPU_SCOPE("Normal map");
+			UpdateNormalMap();
+		}
+	}).read(lights).write(frameUniforms);
+
+	// Light the fog in this view's froxels, which only has last frame's
+	//	to blend in when it is the only view.
+	if (m_volumetricFog.isEnabled())
+	{
+		graph.addPass("Volumetric fog", [&]()
+		{
+			SNS_PROFILE_SCOPE("Volumetric fog");
+			SNS_PROFILE_GPU_SCOPE("Volumetric fog");
+			m_volumetricFog.update(m_lightClusters, m_shadowCascades, m_shadowAtlas, input.view, input.projection,
+				input.nearPlane, input.farPlane, m_viewLayout.getViewCount() == 1);
+		}).read(lights).write(fog);
+	}
+
+	// Draw the occluders into the HiZ buffer, then cull the batched scene
+	//	against it, so every pass after draws the same meshlets. Both
+	//	are done again for each view, from its own camera. The foliage
+	//	is culled against the same occluders.
+	bool occluders = m_hiZ.isCreated() && m_sceneBatch.isClusterCulling();
+	if (occluders)
+	{
+		graph.addPass("Occluder pass", [&]()
+		{
+			SNS_PROFILE_SCOPE("Occluder pass");
+			SNS_PROFILE_GPU_SCOPE("Occluder pass");
+			m_hiZ.begin();
+			m_depthBatchedShader.bind();
+			m_sceneBatch.drawOccluders();
+			m_hiZ.end();
+		}).write(hiZ);
+	}
+
+	// Draw which pages of the virtual textures the first view sees, which
+	//	is read back for the cache to load them. The other views draw
+	//	from what it loads.
+	if (view == 0)
+	{
+		graph.addPass("Virtual texture feedback", [&]()
+		{
+			if (m_virtualTextures.beginFeedback(viewport.w) == false)
+				return;
+
+			SNS_PROFILE_SCOPE("Virtual texture feedback");
+			SNS_PROFILE_GPU_SCOPE("Virtual texture feedback");
+			m_sceneObjects.bind();
+			for (const auto& sceneMesh : m_sceneMeshes)
+			{
+				if (sceneMesh.virtualTexture == sns::VirtualTextureCache::NO_TEXTURE || sceneMesh.mesh->isLoaded() == false)
+					continue;
+
+				sns::ObjectBuffer::select(sceneMesh.object);
+				sceneMesh.mesh->draw();
+			}
+			m_virtualTextures.endFeedback();
+		}).read(frameUniforms).write(feedback);
+	}
+
+	graph.addPass("Cull", [&]()
+	{
+		{
+			SNS_PROFILE_SCOPE("Scene batch cull");
+			SNS_PROFILE_GPU_SCOPE("Scene batch cull");
+			m_sceneBatch.cull(projectionView, input.cameraPosition, &m_hiZ);
+		}
+		if (m_foliage.getLayerCount() > 0)
+		{
+			SNS_PROFILE_SCOPE("Foliage cull");
+			SNS_PROFILE_GPU_SCOPE("Foliage cull");
+			m_foliage.cull(projectionView, input.cameraPosition, occluders ? &m_hiZ : nullptr);
+		}
+	}).read(hiZ).write(culled);
+
+	// Only the first view's fragments are counted, a query can't be
+	//	read back for several views in one frame. Its chunks are the
+	//	only ones tested with occlusion queries, for the same reason.
+	bool countFragments = view == 0;
+	const sns::OcclusionQueries* occlusionQueries =
+		view == 0 && m_occlusionQueriesEnabled ? &m_occlusionQueries : nullptr;
+
+	if (deferred)
+	{
+		// The normal mapped meshes, batched or not, fill the g-buffer.
+		graph.addPass("G-buffer", [&]()
+		{
+			SNS_PROFILE_SCOPE("G-buffer");
+			SNS_PROFILE_GPU_SCOPE("G-buffer");
+			m_deferred.begin();
+			m_shadedFragments.begin();
+			m_sceneQueues[SCENE_PASS_SHADED].draw(m_sceneObjects, viewMask, occlusionQueries);
+			m_renderQueueItems += m_sceneQueues[SCENE_PASS_SHADED].getStats().items;
+			m_sceneBatch.drawCulled(&m_gBufferBatchedShader);
+			m_shadedFragments.end();
+			m_deferred.end();
+		}).read(frameUniforms).read(culled).write(gBuffer);
+
+		// Light it, and copy it and its depth out for everything else
+		//	to draw over.
+		graph.addPass("Deferred lighting", [&]()
+		{
+			SNS_PROFILE_SCOPE("Deferred lighting");
+			SNS_PROFILE_GPU_SCOPE("Deferred lighting");
+			m_deferred.light(m_lightClusters, m_shadowCascades, m_shadowAtlas, m_volumetricFog, input.view,
+				input.projection);
+		}).read(gBuffer).read(lights).read(fog).write(gBuffer);
+		if (m_reflections.isEnabled())
+		{
+			graph.addPass("Reflections", [&]()
+			{
+				SNS_PROFILE_SCOPE("Reflections");
+				SNS_PROFILE_GPU_SCOPE("Reflections");
+				m_reflections.apply(m_deferred, m_sky, m_light.diffuse, input.view, input.projection, input.nearPlane,
+					m_viewLayout.getViewCount() == 1);
+			}).read(gBuffer).write(gBuffer);
+		}
+		graph.addPass("Deferred present", [&]()
+		{
+			m_deferred.present();
+		}).read(gBuffer).write(sceneColour).write(sceneDepth);
+	}
+	else
+	{
+		// The batch's meshlets skip the vertex pipeline when they can,
+		//	culled again per meshlet in the task stage.
+		bool meshShading = isMeshShading();
+
+		// Lay down the normal mapped scene's depth first, so shading it
+		//	after only lights the fragments that are seen. Plants cut
+		//	holes with their alpha, so their depth reads the texture.
+		if (m_depthPrepass)
+		{
+			graph.addPass("Depth pre-pass", [&]()
+			{
+				SNS_PROFILE_SCOPE("Depth pre-pass");
+				SNS_PROFILE_GPU_SCOPE("Depth pre-pass");
+				sns::RenderState::instance().setColourMask(false);
+				sns::RenderState::instance().setDepthMask(true);
+				m_sceneQueues[SCENE_PASS_DEPTH].draw(m_sceneObjects, viewMask, occlusionQueries);
+				m_renderQueueItems += m_sceneQueues[SCENE_PASS_DEPTH].getStats().items;
+				if (meshShading)
+					m_sceneBatch.drawMeshlets(m_depthPrepassMeshShader, &m_depthPrepassMeshAlphaShader);
+				else
+					m_sceneBatch.drawCulled(&m_depthPrepassBatchedShader, &m_depthPrepassBatchedAlphaShader);
+				sns::RenderState::instance().setColourMask(true);
+			}).read(frameUniforms).read(culled).write(sceneDepth);
+
+			// The ambient is occluded from the finished depth, before any
+			//	of it is shaded.
+			if (occlusion)
+			{
+				Resource occlusionDepth = graph.createTexture("Occlusion depth", depthCopy);
+				graph.addPass("Ambient occlusion", [&, occlusionDepth]()
+				{
+					SNS_PROFILE_SCOPE("Ambient occlusion");
+					SNS_PROFILE_GPU_SCOPE("Ambient occlusion");
+					m_ambientOcclusion.draw(input.projection, graph.getFramebuffer(occlusionDepth),
+						graph.getTexture(occlusionDepth));
+				}).read(sceneDepth).write(occlusionDepth).read(occlusionDepth).write(ambientOcclusion);
+			}
+		}
+
+		graph.addPass("Forward shading", [&]()
+		{
+			// The depth is final, only what matches it is shaded.
+			if (m_depthPrepass)
+			{
+				sns::RenderState::instance().setDepthMask(false);
+				sns::RenderState::instance().setDepthFunc(GL_EQUAL);
+			}
+
+			if (countFragments)
+				m_shadedFragments.begin();
+			{
+				SNS_PROFILE_SCOPE("Render queue execute");
+				SNS_PROFILE_GPU_SCOPE("Render queue execute");
+				m_sceneQueues[SCENE_PASS_SHADED].draw(m_sceneObjects, viewMask, occlusionQueries);
+				m_renderQueueItems += m_sceneQueues[SCENE_PASS_SHADED].getStats().items;
+			}
+			{
+				SNS_PROFILE_SCOPE("Scene batch");
+				SNS_PROFILE_GPU_SCOPE("Scene batch");
+				aie::ShaderProgram& batchShader = meshShading ? m_normalMapMeshShader : m_normalMapBatchedShader;
+				batchShader.bind();
+				bindFrameUniforms(batchShader, m_light, m_ambientLight);
+				m_lightClusters.bind(batchShader);
+				m_shadowCascades.bind(batchShader);
+				m_shadowAtlas.bind(batchShader);
+				m_volumetricFog.bind(batchShader);
+				m_ambientOcclusion.bind(batchShader);
+				if (meshShading)
+					m_sceneBatch.drawMeshlets(m_normalMapMeshShader);
+				else
+					m_sceneBatch.drawCulled();
+			}
+			if (countFragments)
+				m_shadedFragments.end();
+
+			if (m_depthPrepass)
+			{
+				sns::RenderState::instance().setDepthFunc(sns::RenderState::instance().getNearerDepthFunc());
+				sns::RenderState::instance().setDepthMask(true);
+			}
+		}).read(frameUniforms).read(culled).read(lights).read(fog).read(occlusion ? ambientOcclusion : sns::RenderGraph::NO_RESOURCE)
+			.write(sceneColour).write(sceneDepth);
+	}
+
+	// The scene's depth is finished, so the chunks due a query have
+	//	their boxes tested against it for the frames after.
+	if (occlusionQueries != nullptr)
+	{
+		graph.addPass("Occlusion queries", [&]()
+		{
+			SNS_PROFILE_GPU_SCOPE("Occlusion queries");
+			m_occlusionQueries.issue();
+		}).read(sceneDepth).write(queries);
+	}
+
+	// Everything else draws forward either way.
+	graph.addPass("Opaque", [&]()
+	{
+		// The rest of the render queue.
+		{
+			SNS_PROFILE_SCOPE("Render queue execute");
+			SNS_PROFILE_GPU_SCOPE("Render queue execute");
+			m_sceneQueues[SCENE_PASS_OTHERS].draw(m_sceneObjects, viewMask);
+			m_renderQueueItems += m_sceneQueues[SCENE_PASS_OTHERS].getStats().items;
+		}
+
+		// Draw the terrain, tessellated for this view's size.
+		if (m_terrain.isCreated())
+		{
+			SNS_PROFILE_SCOPE("Terrain");
+			SNS_PROFILE_GPU_SCOPE("Terrain");
+			aie::ShaderProgram& shader = m_terrain.getShader();
+			shader.bind();
+			m_lightClusters.bind(shader);
+			m_shadowCascades.bind(shader);
+			m_shadowAtlas.bind(shader);
+			m_volumetricFog.bind(shader);
+			m_ambientOcclusion.bind(shader);
+			m_terrain.draw(viewport.w);
+		}
+
+		// Draw the sea around this view's camera, over the terrain under it.
+		if (m_ocean.isCreated())
+		{
+			SNS_PROFILE_SCOPE("Ocean");
+			SNS_PROFILE_GPU_SCOPE("Ocean");
+			aie::ShaderProgram& shader = m_ocean.getShader();
+			shader.bind();
+			m_lightClusters.bind(shader);
+			m_shadowCascades.bind(shader);
+			m_shadowAtlas.bind(shader);
+			m_volumetricFog.bind(shader);
+			m_ocean.draw(input.cameraPosition, viewport.w);
+		}
+
+		// Draw the foliage the cull kept, meshes near and impostors far.
+		if (m_foliage.getLayerCount() > 0)
+		{
+			SNS_PROFILE_SCOPE("Foliage");
+			SNS_PROFILE_GPU_SCOPE("Foliage");
+			m_foliage.draw([this](aie::ShaderProgram& a_shader)
+			{
+				m_lightClusters.bind(a_shader);
+				m_shadowCascades.bind(a_shader);
+				m_shadowAtlas.bind(a_shader);
+				m_volumetricFog.bind(a_shader);
+				m_ambientOcclusion.bind(a_shader);
+			});
+		}
+
+		// Draw the characters skinned this frame, lit by one light.
+		if (m_animator.getCharacterCount() > 0)
+		{
+			SNS_PROFILE_SCOPE("Characters");
+			SNS_PROFILE_GPU_SCOPE("Characters");
+			aie::ShaderProgram* shader = m_litShaders.get(makeLitKey(LIT_ONE_LIGHT | LIT_PROBES, 0));
+			if (shader != nullptr)
+			{
+				shader->bind();
+				m_animator.draw();
+			}
+		}
+
+		// Draw the crowds from their baked frames, lit as the characters are.
+		if (m_crowds.empty() == false)
+		{
+			SNS_PROFILE_SCOPE("Crowds");
+			SNS_PROFILE_GPU_SCOPE("Crowds");
+			aie::ShaderProgram* shader = m_crowdShaders.get(makeLitKey(LIT_ONE_LIGHT | LIT_PROBES, 0));
+			if (shader != nullptr)
+			{
+				shader->bind();
+				m_probeVolume.bind(*shader);
+				unsigned int visible = 0;
+				for (auto& crowd : m_crowds)
+				{
+					crowd->draw(*shader, projectionView, input.cameraPosition);
+					visible += crowd->getStats().visible;
+				}
+				sns::Profiler::setCounter("Crowd copies drawn", visible);
+			}
+		}
+
+		// Draw every rock and tree, each mesh's copies in one draw per chunk.
+		{
+			SNS_PROFILE_SCOPE("Instanced");
+			SNS_PROFILE_GPU_SCOPE("Instanced");
+			UpdateInstanced(input.cameraPosition);
+		}
+
+		// Or the scans as points, picked and streamed in for this view.
+		if (m_stanfordPointsEnabled && m_stanfordPoints.isCreated() &&
+			m_benchmarkScene == sns::BenchmarkScene::STANFORD)
+		{
+			SNS_PROFILE_SCOPE("Point clouds");
+			SNS_PROFILE_GPU_SCOPE("Point clouds");
+			m_stanfordPoints.update(input.projection, input.view, (float)viewport.w);
+			m_stanfordPoints.draw(projectionView, viewport.z, viewport.w);
+			if (view == 0)
+				sns::Profiler::setCounter("Points drawn", (double)m_stanfordPoints.getStats().pointsDrawn);
+		}
+
+		// Draw the ground of the planets and moons, split for this view.
+		if (m_planetRenderer.isCreated())
+		{
+			SNS_PROFILE_SCOPE("Planets");
+			SNS_PROFILE_GPU_SCOPE("Planets");
+			const sns::TransformComponent* sun = m_entities.transforms.get(m_sunEntity);
+			m_planetRenderer.draw(input.cullProjectionView, input.cameraPosition,
+				sun != nullptr ? glm::vec3(m_entities.graph.getWorld(sun->node)[3]) : glm::vec3(0));
+			if (view == 0)
+				sns::Profiler::setCounter("Planet patches", (double)m_planetRenderer.getStats().patches);
+		}
+	}).read(frameUniforms).read(culled).read(lights).read(fog).read(occlusion ? ambientOcclusion : sns::RenderGraph::NO_RESOURCE)
+		.write(sceneColour).write(sceneDepth);
+
+	// The sky behind everything opaque, where the depth is still clear. Its
+	//	table is only built again when the sun moves, which the light
+	//	shines away from.
+	if (m_sky.isEnabled())
+	{
+		graph.addPass("Sky", [&]()
+		{
+			SNS_PROFILE_SCOPE("Sky");
+			SNS_PROFILE_GPU_SCOPE("Sky");
+			m_sky.update(-m_light.direction);
+			m_sky.draw(input.view, input.projection, m_light.diffuse);
+		}).read(sceneDepth).write(sceneColour);
+	}
+
+	// Draw the sun and the rocks, and the planets without a renderer,
+	//	then the planets' trails, blended over what is behind them.
+	graph.addPass("Gizmos", [&]()
+	{
+		{
+			SNS_PROFILE_SCOPE("Gizmos");
+			SNS_PROFILE_GPU_SCOPE("Gizmos");
+			aie::Gizmos::draw(projectionView);
+		}
+		if (m_planetTrails.isCreated())
+		{
+			SNS_PROFILE_SCOPE("Trails");
+			SNS_PROFILE_GPU_SCOPE("Trails");
+			m_planetTrails.draw(projectionView, input.cameraPosition);
+		}
+	}).write(sceneColour).write(sceneDepth);
+
+	// With order independent transparency, the transparent meshes and the
+	//	particles blend in order however they are drawn, so neither is
+	//	sorted, and the particles are drawn at the window's size.
+	if (m_transparencyMethod >= 0)
+	{
+		graph.addPass("Transparency", [&]()
+		{
+			SNS_PROFILE_SCOPE("Transparency");
+			SNS_PROFILE_GPU_SCOPE("Transparency");
+			m_transparencyTarget.begin((sns::TransparencyTarget::Method)m_transparencyMethod);
+			m_litShaders.forEach([this](aie::ShaderProgram& shader)
+			{
+				shader.bind();
+				m_transparencyTarget.bind(shader);
+			});
+			m_sceneQueues[SCENE_PASS_TRANSPARENT].draw(m_sceneObjects, viewMask);
+			m_renderQueueItems += m_sceneQueues[SCENE_PASS_TRANSPARENT].getStats().items;
+
+			m_particleTransparentShader.bind();
+			m_particleTransparentShader.bindUniform("ProjectionViewModel", projectionView * m_particleTransform);
+			m_transparencyTarget.bind(m_particleTransparentShader);
+			if (view == 0)
+				m_particleSystem->draw(m_packet->particles);
+			else
+				m_particleSystem->redraw();
+			m_transparencyTarget.end();
+		}).read(frameUniforms).read(sceneDepth).write(sceneColour);
+	}
+	else
+	{
+		// Draw the particles, blended over the scene without writing
+		//	depth. They are premultiplied by alpha, which the target
+		//	blends back over the window the same way. The target copies
+		//	the scene from the bottom left of the window, so several
+		//	views draw straight in.
+		bool lowResolution = m_particleDivisor != 0 && m_particleTarget.isCreated() &&
+			m_viewLayout.getViewCount() == 1;
+		Resource particleDepth = lowResolution ? graph.createTexture("Particle depth", depthCopy) :
+			sns::RenderGraph::NO_RESOURCE;
+		graph.addPass("Particles", [&, lowResolution, particleDepth]()
+		{
+			SNS_PROFILE_SCOPE("Particle draw");
+			SNS_PROFILE_GPU_SCOPE("Particle draw");
+
+			// Bind the particle shader and the particles' transform.
+			m_particleShader.bind();
+			m_particleShader.bindUniform("ProjectionViewModel", projectionView * m_particleTransform);
+
+			sns::RenderState& state = sns::RenderState::instance();
+			if (lowResolution)
+			{
+				m_particleTarget.begin(input.projection, graph.getFramebuffer(particleDepth),
+					graph.getTexture(particleDepth));
+				m_particleTarget.bind(m_particleShader, 0.5f);
+			}
+			else
+				m_particleShader.bindUniform("SoftDistance", 0.0f);
+
+			state.setBlend(true);
+			state.setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			state.setDepthMask(false);
+
+			// Copied once, the views after the first draw the same copy.
+			if (view == 0)
+				m_particleSystem->draw(m_packet->particles);
+			else
+				m_particleSystem->redraw();
+			if (lowResolution)
+				m_particleTarget.end();
+			state.setDepthMask(true);
+			state.setBlend(false);
+		}).read(sceneDepth).write(particleDepth).read(particleDepth).write(sceneColour);
+	}
+
+	graph.execute();
+}
+
+/**
+	captureInput copies what the simulation of a frame needs from the
+		main thread, so the simulation thread never reads the camera.
+
+		@param1 deltaTime is how long the last frame took, in seconds.
+
+		@return the input of the next frame.
+*/
+sns::FrameInput Application::captureInput(double deltaTime) const
+{
+	sns::FrameInput input;
+	input.deltaTime = deltaTime;
+	input.view = m_flyCam->getView();
+	input.projection = m_flyCam->getProjection();
+	input.projectionView = m_flyCam->getProjectionView();
+	input.cameraPosition = m_flyCam->getPosition();
+	input.nearPlane = m_flyCam->getNear();
+	input.farPlane = m_flyCam->getFar();
+	input.cullProjectionView = m_viewLayout.makeBoundingProjection(input.projection) * input.view;
+	return input;
+}
+
+/**
+	captureStart returns what a recording starts the simulation from,
+		the seed of every emitter, angle of every orbit and state of
+		every gravity body.
+*/
+sns::FrameRecording::Start Application::captureStart() const
+{
+	sns::FrameRecording::Start start;
+	for (unsigned int i = 0; i < m_particleSystem->getEmitterCount(); ++i)
+		start.emitterSeeds.push_back(m_particleSystem->getEmitter(i)->getSeed());
+	for (unsigned int i = 0; i < m_entities.orbits.size(); ++i)
+		start.orbitAngles.push_back(m_entities.orbits[i].angle);
+	m_entities.gravity.getState(start.bodyStates);
+	return start;
+}
+
+/**
+	restartSimulation sets the emitters, orbits and bodies back to a
+		start and simulates the next frame again from it. The frame
+		already simulated was simulated from before, so the pipeline
+		is stopped and started over with the camera as it is now.
+
+		@param1 start is what to set the simulation back to.
+*/
+void Application::restartSimulation(const sns::FrameRecording::Start& start)
+{
+	m_pipeline.stop();
+
+	unsigned int emitters = m_particleSystem->getEmitterCount();
+	unsigned int orbits = m_entities.orbits.size();
+	if (start.emitterSeeds.size() != emitters || start.orbitAngles.size() != orbits)
+		printf("Recording has %u emitters and %u orbits, the scene has %u and %u\n",
+			(unsigned int)start.emitterSeeds.size(), (unsigned int)start.orbitAngles.size(), emitters, orbits);
+
+	m_particleSystem->finishPrewarm();
+	for (unsigned int i = 0; i < emitters && i < start.emitterSeeds.size(); ++i)
+		m_particleSystem->getEmitter(i)->restart(start.emitterSeeds[i]);
+	for (unsigned int i = 0; i < orbits && i < start.orbitAngles.size(); ++i)
+		m_entities.orbits[i].angle = start.orbitAngles[i];
+	if (m_entities.gravity.setState(start.bodyStates) == false)
+		printf("Recording has %u gravity bodies, the scene has %u\n",
+			(unsigned int)(start.bodyStates.size() / sns::GravitySimulation::STATE_FLOATS),
+			m_entities.gravity.getBodyCount());
+	m_animator.restart();
+	m_simulationTime = 0.0;
+
+	// The planets jump back, so their trails start again from there.
+	m_planetTrails.clear();
+	m_trailTime = 0.0f;
+	m_trailTimer = 0.0f;
+
+	m_pipeline.start([this](sns::FramePacket& packet) { simulate(packet); }, captureInput(0.0));
+}
+
+/**
+	getRenderSettings returns the settings the keys switch, as
+		FrameRecording settings.
+*/
+uint32_t Application::getRenderSettings() const
+{
+	uint32_t settings = (uint32_t)m_particleDivisor << sns::FrameRecording::PARTICLE_DIVISOR_SHIFT;
+	if (m_deferredShading)
+		settings |= sns::FrameRecording::DEFERRED;
+	if (m_depthPrepass)
+		settings |= sns::FrameRecording::DEPTH_PREPASS;
+	if (m_temporalUpsampling)
+		settings |= sns::FrameRecording::TEMPORAL_UPSAMPLING;
+	if (m_ambientOcclusionEnabled)
+		settings |= sns::FrameRecording::AMBIENT_OCCLUSION;
+	if (m_postProcess.getSettings().bloom)
+		settings |= sns::FrameRecording::BLOOM;
+	settings |= (uint32_t)m_antiAliasing << sns::FrameRecording::ANTI_ALIASING_SHIFT;
+	return settings;
+}
+
+/**
+	applyRenderSettings switches to a recorded frame's settings, the
+		same way the keys would.
+
+		@param1 settings are the frame's FrameRecording settings.
+*/
+void Application::applyRenderSettings(uint32_t settings)
+{
+	m_deferredShading = (settings & sns::FrameRecording::DEFERRED) != 0 &&
+		m_deferred.isCreated() && m_viewLayout.getViewCount() == 1;
+	m_depthPrepass = (settings & sns::FrameRecording::DEPTH_PREPASS) != 0;
+	bool temporal = (settings & sns::FrameRecording::TEMPORAL_UPSAMPLING) != 0 && m_temporalUpsampler.isCreated();
+	if (temporal != m_temporalUpsampling)
+		m_temporalUpsampler.reset();
+	m_temporalUpsampling = temporal;
+	m_ambientOcclusionEnabled = (settings & sns::FrameRecording::AMBIENT_OCCLUSION) != 0 && m_ambientOcclusion.isCreated();
+	m_postProcess.getSettings().bloom = (settings & sns::FrameRecording::BLOOM) != 0;
+
+	sns::AntiAliasing antiAliasing = (sns::AntiAliasing)((settings >> sns::FrameRecording::ANTI_ALIASING_SHIFT) &
+		sns::FrameRecording::FIELD_MASK);
+	if (antiAliasing != m_antiAliasing && antiAliasing < sns::AntiAliasing::COUNT)
+	{
+		m_antiAliasing = antiAliasing;
+		applyAntiAliasing();
+	}
+
+	int divisor = (int)((settings >> sns::FrameRecording::PARTICLE_DIVISOR_SHIFT) & sns::FrameRecording::FIELD_MASK);
+	if (divisor != m_particleDivisor)
+	{
+		m_particleDivisor = divisor;
+		if (m_particleDivisor != 0 &&
+			m_particleTarget.create(m_windowResolution.x, m_windowResolution.y, m_particleDivisor) == false)
+			m_particleDivisor = 0;
+	}
+}
+
+/**
+	getRenderResolution returns the size the scene is drawn at this
+		frame, less than the window's when it is scaled down.
+*/
+glm::ivec2 Application::getRenderResolution() const
+{
+	if (m_sceneTarget.isCreated())
+		return glm::ivec2(m_sceneTarget.getRenderWidth(), m_sceneTarget.getRenderHeight());
+	return m_windowResolution;
+}
+
+/**
+	applyAntiAliasing sets up the scene target and post process for
+		m_antiAliasing. MSAA falls back to FXAA where the scene target
+		can't have samples, and the temporal history starts again, as
+		what it holds was anti-aliased some other way.
+*/
+void Application::applyAntiAliasing()
+{
+	bool multisampled = m_antiAliasing == sns::AntiAliasing::MSAA;
+	if (m_sceneTarget.isCreated() == false || m_sceneTarget.setSamples(multisampled ? MSAA_SAMPLES : 1) == false)
+	{
+		if (multisampled)
+			m_antiAliasing = sns::AntiAliasing::FXAA;
+	}
+	m_postProcess.getSettings().fxaa = m_antiAliasing == sns::AntiAliasing::FXAA;
+	m_temporalUpsampler.reset();
+	m_frameReuse.invalidate();
+}
+
+/**
+	presentScene takes the frame to the window. The post process reads
+		what of the scene target was drawn into, or the whole of the
+		upsampled frame, and stretches it over the window as it
+		tonemaps it. Without it the colour is copied out as it is.
+
+		@param1 temporal is whether the frame is temporally upsampled.
+
+		@param2 drawn is whether the frame was drawn rather than reused,
+				and its bloom is built again.
+*/
+void Application::presentScene(bool temporal, bool drawn)
+{
+	glm::vec2 window(m_windowResolution);
+	if (m_postProcess.isCreated() && temporal)
+		m_postProcess.draw(m_temporalUpsampler.getTexture(), window, window, drawn);
+	else if (m_postProcess.isCreated())
+		m_postProcess.draw(m_sceneTarget.getColourTexture(),
+			glm::vec2(m_sceneTarget.getRenderWidth(), m_sceneTarget.getRenderHeight()), window, drawn);
+	else if (temporal)
+		m_temporalUpsampler.present();
+	else
+		m_sceneTarget.present();
+}
+
+/**
+	makeFrameKey returns what this frame is drawn from besides the
+		scene: the camera it was simulated from, the window, the scale
+		the scene target draws at and the settings the keys switch.
+*/
+sns::FrameReuse::Key Application::makeFrameKey() const
+{
+	sns::FrameReuse::Key key;
+	key.view = m_packet->input.view;
+	key.projection = m_packet->input.projection;
+	key.target = glm::vec4(m_windowResolution.x, m_windowResolution.y,
+		m_sceneTarget.isCreated() ? m_sceneTarget.getScale() : 1.0f, (float)m_viewLayout.getViewCount());
+	key.settings = getRenderSettings();
+	return key;
+}
+
+/**
+	simulate fills in a frame packet on the simulation thread, while
+		the main thread draws the frame before it. It must not touch
+		opengl or anything the main thread writes, only the packet
+		and the particle emitters.
 
-	// If the linking of the particle shader doesn't work, display error.
-	if (m_particleShader.link() == false)
+		@param1 packet is the frame to simulate, its input already set.
+*/
+void Application::simulate(sns::FramePacket& packet)
+{
+	// The simulation runs in fixed steps, however often frames are drawn.
+	//	After a long frame it catches up by at most MAX_SIMULATION_STEPS
+	//	and drops the rest, so a slow frame can't make the next one slower.
+	unsigned int steps = 0;
+	m_simulationTime += packet.input.deltaTime;
+	while (m_simulationTime >= SIMULATION_STEP && steps < MAX_SIMULATION_STEPS)
 	{
-		printf("Shader Error: %s\n", m_particleShader.getLastError());
+		m_simulationTime -= SIMULATION_STEP;
+		++steps;
 	}
-	
-	// Creating a new particle emitter.
-	m_emitter = new ParticleEmitter();
+	if (m_simulationTime >= SIMULATION_STEP)
+		m_simulationTime = fmod(m_simulationTime, SIMULATION_STEP);
 
-	// Initializing the values of the new emitter.
-	m_emitter->initialise(1000, 500,
-		0.1f, 1.0f,
-		1, 5,
-		1, 0.1f,
-		glm::vec4(1, 0, 0, 1), glm::vec4(1, 1, 0, 1));
+	// The emitters are culled, scaled and sorted from the camera, in
+	//	their own space.
+	glm::vec4 cameraPosition = glm::inverse(m_particleTransform) * glm::vec4(packet.input.cameraPosition, 1);
+	m_particleSystem->setCamera(packet.input.cullProjectionView * m_particleTransform,
+		glm::vec3(cameraPosition), packet.input.projection[1][1]);
 
-	// Initialize the particle emitter's transform.
-	m_particleTransform = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,1,0,
-		0,0,0,1
-	};
-	return 0;
+	// The particles are drawn moved on by the time left over since the last step.
+	m_particleSystem->simulate((float)SIMULATION_STEP, steps, (float)m_simulationTime, packet.particles, *packet.arena);
 }
 
 /**
-	update gets called every frame. Anything that needs to be
-		called every frame is in this function such as render
-		and any input checks.
-
-	@param1 deltaTime is the current frame rate of the
-		application.
+	terminate calls any necessary functions that must be called
+		as the program is shutting down.
 
-	@return true to keep the application running.
+	@return returns 0 due to the program being shut down.
 */
-bool Application::update(double deltaTime)
+int Application::terminate()
 {
-	// Sets the previous time to the current time.
-	m_previousTime = m_currentTime;
+	m_pipeline.stop();
+	m_shaderWatcher.stop();
+	m_assetWatcher.stop();
+	sns::JobSystem::instance().wait(m_stanfordPointsJob);
+
+	// What to size the frame arenas to, for the scenes this was run with.
+	printf("Frame arena high watermark: %zu bytes\n", m_pipeline.getArenaHighWatermark());
+	delete m_particleSystem;
+	aie::Gizmos::destroy();
+	m_videoEncoder.destroy();
+	m_frameCapture.destroy();
+	sns::GpuReadback::instance().destroy();
+	sns::VertexArrays::instance().destroy();
+	sns::SamplerCache::instance().destroy();
+	sns::TextureAtlas::instance().destroy();
+	sns::UniformRing::instance().destroy();
+	m_telemetry.destroy();
+	sns::Profiler::destroy();
+	m_input.detach();
+	m_assetLoader.stopUploadThread();
+	m_asyncCompute.destroy();
+	m_controlPanel.destroy();
+	m_virtualTextures.destroy();
+	glfwDestroyWindow(window);
+	glfwTerminate();
 
-	// Sets the current time variable to the actual current time.
-	m_currentTime = m_clock.now();
+	// Write out what is still queued before the process exits.
+	sns::Log::instance().shutdown();
+	return 0;
+}
 
-	// How long it has been since the last frame.
-	auto duration = m_currentTime - m_previousTime;
+/**
+	InitNormalMap is a function that initializes a shader that
+		renders a model that is lit using phong lighting
+		and displays them with their texture and can use
+		a normal map.
+*/
+void Application::InitNormalMap()
+{
+	//-----------------------------Normal Map-----------------------------------
 
-	// deltaTime = how long it has been since the last frame.
-	m_deltaTime = duration.count() * NANO_TO_SECONDS;
+	// The lit shader's normal mapped shading for the scene batch, which
+	//	brings its own transforms.
+	m_normalMapBatchedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/normalmapBatched.vert");
+	m_normalMapBatchedShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/normalmapBatched.frag");
 
-	// Clearing buffer - colour and depth checks.
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// The scene batch's occluders are drawn depth only at half resolution,
+	//	which is plenty for culling meshlets against.
+	m_depthBatchedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/depthBatched.vert");
 
-	// Query time since application started.
-	float time = glfwGetTime();
+	// With mesh shaders the batch's meshlets can be drawn through them,
+	//	shaded by the same fragment shader.
+	bool meshShaders = aie::ShaderProgram::hasMeshShaders();
+	if (meshShaders)
+	{
+		m_normalMapMeshShader.loadShader(aie::eShaderStage::TASK, "../shaders/meshBatch.task");
+		m_normalMapMeshShader.loadShader(aie::eShaderStage::MESH, "../shaders/meshBatch.mesh");
+		m_normalMapMeshShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/normalmapBatched.frag");
+	}
 
-	// Light looking up.
-	m_light.direction = glm::normalize(glm::vec3(0, 1, 0));
+	aie::ShaderProgram* programs[] = { &m_normalMapBatchedShader, &m_depthBatchedShader, &m_normalMapMeshShader };
+	linkShaders(programs, meshShaders ? 3 : 2);
+	if (m_depthBatchedShader.getHandle() != 0)
+	{
+		m_hiZ.create(m_windowResolution.x / 2, m_windowResolution.y / 2);
+	}
+	m_occlusionQueries.create();
 
-	// Light looking down.
-	m_downLight.direction = glm::normalize(glm::vec3(0, 1, 0));
+	//--------------------------------------------------------------------------
+}
 
-	// Call the update function for the particles.
-	m_emitter->update(deltaTime, m_flyCam->getWorldTransform());
+/**
+	UpdateNormalMap is all of the logic that is needed to run
+		every frame in regards to the lit shaders.
+*/
+void Application::UpdateNormalMap()
+{
+	//-------------------------Normal---------------------------
+	// Every lit permutation compiled so far, including any compiled
+	//	for the first time last frame.
+	m_litShaders.forEach([this](aie::ShaderProgram& shader)
+	{
+		shader.bind();
+
+		// Bind light and camera, unless the program reads them from the
+		//	per-frame uniform buffer.
+		bindFrameUniforms(shader, m_light, m_ambientLight);
+
+		// Bind the clustered point and spot lights, the light's shadows
+		//	and the ambient occlusion.
+		m_lightClusters.bind(shader);
+		m_shadowCascades.bind(shader);
+		m_shadowAtlas.bind(shader);
+		m_volumetricFog.bind(shader);
+		m_ambientOcclusion.bind(shader);
+		m_lightmapper.bind(shader);
+		m_probeVolume.bind(shader);
+		if (m_virtualTextures.isCreated())
+			m_virtualTextures.bind(shader);
+	});
+}
 
-	// Call render to draw everything to the screen.
-	render();
+/**
+	linkShaders links programs all at once, so drivers that compile on
+		their own threads get through them side by side, and prints why
+		any failed.
 
-	// Call the camera's update to see everything in the scene.
-	m_flyCam->update(m_deltaTime, window);
+		@param1 programs are the programs, with their shaders loaded.
 
-	// Swap buffers.
-	glfwSwapBuffers(window);
+		@param2 count is how many there are.
 
-	// Checks whether any input has been done.
-	glfwPollEvents();
+		@return true if every one linked.
+*/
+bool Application::linkShaders(aie::ShaderProgram* const* programs, unsigned int count)
+{
+	if (aie::ShaderProgram::linkAll(programs, count))
+		return true;
 
-	return true;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (programs[i]->getHandle() == 0)
+			printf("Shader Error: %s\n", programs[i]->getLastError());
+	}
+	return false;
 }
 
-void Application::render()
+/**
+	InitLitShaders sets up the lit shader's permutations and compiles
+		the ones the scene meshes are drawn with. It is called after the
+		lights and shadows are created, as their features are only
+		compiled in when they are.
+*/
+void Application::InitLitShaders()
 {
-	// Texture Shader
-	UpdateTexture();
+	static const sns::ShaderPermutations::Feature features[] = {
+		{ "DIFFUSE_MAP", 0, 1 },
+		{ "NORMAL_MAP", 1, 1 },
+		{ "ALPHA_TEST", 2, 1 },
+		{ "SHADOWS", 3, 1 },
+		{ "CLUSTERED_LIGHTS", 4, 1 },
+		{ "PACKED_MAPS", 5, 1 },
+		{ "LIGHT_COUNT", LIT_LIGHT_COUNT_SHIFT, 2 },
+		{ "TRANSPARENT", 8, 1 },
+		{ "LIGHTMAP", 9, 1 },
+		{ "PROBES", 10, 1 },
+		{ "VIRTUAL_TEXTURE", 11, 1 },
+	};
+	m_litShaders.create("../shaders/lit.vert", "../shaders/lit.frag",
+		features, sizeof(features) / sizeof(features[0]));
+
+	// Every variant a mesh's materials could be, the ones no material
+	//	turns out to be are cheap to have, as they load from the binary
+	//	cache after the first run.
+	std::vector<unsigned int> keys;
+	for (const auto& sceneMesh : m_sceneMeshes)
+	{
+		for (unsigned int variant = 0; variant < aie::OBJMesh::MATERIAL_VARIANT_Count; ++variant)
+		{
+			unsigned int key = makeLitKey(sceneMesh.features, variant);
+			if (std::find(keys.begin(), keys.end(), key) == keys.end())
+				keys.push_back(key);
+
+			// And the one it blends with when transparency is on.
+			key |= LIT_TRANSPARENT;
+			if (sceneMesh.transparent && m_transparencyTarget.isCreated() &&
+				std::find(keys.begin(), keys.end(), key) == keys.end())
+				keys.push_back(key);
+
+			// And the one it switches to once its lightmap is baked.
+			key = (key & ~LIT_TRANSPARENT) | LIT_LIGHTMAP;
+			if (sceneMesh.lightmapped && m_lightmapper.isCreated() && (key >> LIT_LIGHT_COUNT_SHIFT & 3) != 0 &&
+				std::find(keys.begin(), keys.end(), key) == keys.end())
+				keys.push_back(key);
+		}
+	}
+	if (m_animator.getCharacterCount() > 0 &&
+		std::find(keys.begin(), keys.end(), makeLitKey(LIT_ONE_LIGHT | LIT_PROBES, 0)) == keys.end())
+		keys.push_back(makeLitKey(LIT_ONE_LIGHT | LIT_PROBES, 0));
+	unsigned int compiled = m_litShaders.prepare(keys.data(), (unsigned int)keys.size());
+	printf("Lit shaders: %u of %u permutations compiled\n", compiled, (unsigned int)keys.size());
+
+	// The crowds are lit as the characters are, in the one variant.
+	m_crowdShaders.create("../shaders/crowd.vert", "../shaders/lit.frag",
+		features, sizeof(features) / sizeof(features[0]));
+	if (m_crowds.empty() == false)
+	{
+		unsigned int crowdKey = makeLitKey(LIT_ONE_LIGHT | LIT_PROBES, 0);
+		m_crowdShaders.prepare(&crowdKey, 1);
+	}
 
-	//Do Normalmap
 	UpdateNormalMap();
+}
 
-	UpdateNormalMapDown();
+/**
+	makeLitKey returns the key of the lit permutation a chunk is drawn
+		with. The normal map and alpha test are only compiled in for
+		materials that have the maps for them, and packed maps for
+		those that have them and sample them, and shadows and the
+		clustered lights only for lit meshes, when they were created.
+		The lightmap is only read by lit meshes once it is baked, and the
+		probes by lit meshes that ask for them once they are created.
+		Virtual textures are read by any mesh that has one, while the
+		cache is created.
+
+		@param1 features are the LitFeature bits of its mesh.
+
+		@param2 variant is its material's OBJMesh::MaterialVariant.
+*/
+unsigned int Application::makeLitKey(unsigned int features, unsigned int variant) const
+{
+	unsigned int key = features & ~(LIT_NORMAL_MAP | LIT_ALPHA_TEST | LIT_PACKED_MAPS | LIT_LIGHTMAP | LIT_PROBES |
+		LIT_VIRTUAL_TEXTURE);
+	if ((features & LIT_VIRTUAL_TEXTURE) != 0 && m_virtualTextures.isCreated())
+		key |= LIT_VIRTUAL_TEXTURE;
+	if ((features & LIT_NORMAL_MAP) != 0 && (variant & aie::OBJMesh::MATERIAL_NORMAL_MAPPED) != 0)
+		key |= LIT_NORMAL_MAP;
+	if ((variant & aie::OBJMesh::MATERIAL_ALPHA_TESTED) != 0)
+		key |= LIT_ALPHA_TEST;
+	if ((variant & aie::OBJMesh::MATERIAL_PACKED_MAPS) != 0 && (key & (LIT_DIFFUSE_MAP | LIT_ALPHA_TEST)) != 0)
+		key |= LIT_PACKED_MAPS;
+
+	if ((features >> LIT_LIGHT_COUNT_SHIFT & 3) != 0)
+	{
+		if (m_shadowCascades.isCreated())
+			key |= LIT_SHADOWS;
+		if (m_lightClusters.isCreated())
+			key |= LIT_CLUSTERED_LIGHTS;
+		if ((features & LIT_LIGHTMAP) != 0 && m_lightmapper.isBaked())
+			key |= LIT_LIGHTMAP;
+		if ((features & LIT_PROBES) != 0 && m_probeVolume.isCreated())
+			key |= LIT_PROBES;
+	}
+	return key;
+}
 
-	// bind particle shader
+/**
+	InitLightClusters creates the light clusters and fills the courtyard
+		with coloured point and spot lights for the normal map shaders
+		to be lit by, and with the scene's decals.
+*/
+void Application::InitLightClusters()
+{
+	if (m_lightClusters.create() == false)
+		return;
 
-	// draw Spear
-	RenderSpear(&m_texturedShader);
+	std::vector<sns::LightClusters::Light>& lights = m_lightClusters.getLights();
+	for (const sns::SceneDescription::Light& description : m_scene.getLights())
+	{
+		sns::LightClusters::Light light;
+		light.positionRange = glm::vec4(description.position, description.range);
+		light.colour = glm::vec4(description.colour, 0);
+		light.spot = glm::vec4(description.direction, description.cosine);
+		lights.push_back(light);
+	}
 
-	// Draw Building
-	RenderSponzaBuilding(&m_normalMapShader);
+	// The scattered lights' fixed seed places them the same way every
+	//	run, so benchmarks stay comparable. Every spotEvery'th light is
+	//	a spot pointing down.
+	const sns::SceneDescription::LightScatter& scatter = m_scene.getLightScatter();
+	sns::Random random(scatter.seed);
+	for (unsigned int i = 0; i < scatter.count; ++i)
+	{
+		sns::LightClusters::Light light;
+		light.positionRange = glm::vec4(random.range(scatter.min.x, scatter.max.x), random.range(scatter.min.y, scatter.max.y),
+			random.range(scatter.min.z, scatter.max.z), random.range(scatter.range.x, scatter.range.y));
+		light.colour = glm::vec4(random.range(scatter.colour.x, scatter.colour.y), random.range(scatter.colour.x, scatter.colour.y),
+			random.range(scatter.colour.x, scatter.colour.y), 0) * 2.0f;
+		light.spot = glm::vec4(0, -1, 0, -1);
+		if (scatter.spotEvery > 0 && i % scatter.spotEvery == 0)
+		{
+			light.positionRange.w *= 2.0f;
+			light.spot.w = glm::cos(glm::radians(random.range(scatter.spotAngle.x, scatter.spotAngle.y)));
+		}
+		lights.push_back(light);
+	}
 
-	// Draw Curtains
-	RenderSponzaCurtains(&m_normalMapShader);
+	// Decals whose texture can't be loaded are left out.
+	if (m_scene.getDecals().empty() || m_decalAtlas.create() == false)
+		return;
+	m_lightClusters.setDecalAtlas(&m_decalAtlas);
+	std::vector<sns::LightClusters::Decal>& decals = m_lightClusters.getDecals();
+	for (const sns::SceneDescription::Decal& description : m_scene.getDecals())
+	{
+		int layer = m_decalAtlas.add(description.texture);
+		if (layer >= 0)
+			decals.push_back(sns::LightClusters::makeDecal(description.transform, layer, description.opacity));
+	}
+}
 
-	// Draw FountainPlants
-	RenderSponzaFountainPlants(&m_normalMapShader);
+/**
+	InitDeferred loads the g-buffer shaders and creates the deferred
+		renderer the normal mapped scene is drawn through when deferred
+		shading is on.
+*/
+void Application::InitDeferred()
+{
+	// The normal map vertex shaders feed the g-buffer ones, so the
+	//	meshes are drawn the same either way.
+	m_gBufferShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/lit.vert");
+	m_gBufferShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/gbuffer.frag");
+	m_gBufferBatchedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/normalmapBatched.vert");
+	m_gBufferBatchedShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/gbufferBatched.frag");
+
+	aie::ShaderProgram* programs[] = { &m_gBufferShader, &m_gBufferBatchedShader };
+	if (linkShaders(programs, 2) == false)
+		return;
+
+	m_deferred.create(m_windowResolution.x, m_windowResolution.y);
+
+	// Without the g-buffer there is nothing to trace, and a run started
+	//	without reflections only makes them when they are turned on.
+	if (m_deferred.isCreated() && m_reflections.getQuality() != sns::ReflectionQuality::OFF)
+		m_reflections.create(m_deferred.getWidth(), m_deferred.getHeight());
+}
 
-	// Draw LionHeads
-	RenderSponzaLionHeads(&m_normalMapShader);
+/**
+	InitDepthPrepass loads the programs forward shading's depth pre-pass
+		draws with. The opaque ones are just the normal map vertex
+		shaders, the alpha tested ones only discard where the diffuse
+		alpha is clear.
+*/
+void Application::InitDepthPrepass()
+{
+	m_depthPrepassShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/lit.vert");
 
-	// Draw Plants
-	RenderSponzaPlants(&m_normalMapShader);
+	m_depthPrepassAlphaShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/lit.vert");
+	m_depthPrepassAlphaShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/depthAlpha.frag");
 
-	// Draw Ribbons
-	RenderSponzaRibbons(&m_normalMapShader);
+	m_depthPrepassBatchedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/normalmapBatched.vert");
 
-	// Draw Floor
-	RenderSponzaFloor(&m_normalMapShader);
+	m_depthPrepassBatchedAlphaShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/normalmapBatched.vert");
+	m_depthPrepassBatchedAlphaShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/depthAlphaBatched.frag");
 
-	// Bind the particle shader.
-	m_particleShader.bind();
+	// The mesh shaded batch's, the same two over its task and mesh shaders.
+	bool meshShaders = aie::ShaderProgram::hasMeshShaders();
+	if (meshShaders)
+	{
+		m_depthPrepassMeshShader.loadShader(aie::eShaderStage::TASK, "../shaders/meshBatch.task");
+		m_depthPrepassMeshShader.loadShader(aie::eShaderStage::MESH, "../shaders/meshBatch.mesh");
 
-	// Bind particle transform
-	auto pvm = m_flyCam->getProjectionView() * m_particleTransform;
-	m_particleShader.bindUniform("ProjectionViewModel", pvm);
+		m_depthPrepassMeshAlphaShader.loadShader(aie::eShaderStage::TASK, "../shaders/meshBatch.task");
+		m_depthPrepassMeshAlphaShader.loadShader(aie::eShaderStage::MESH, "../shaders/meshBatch.mesh");
+		m_depthPrepassMeshAlphaShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/depthAlphaBatched.frag");
+	}
 
-	// Draw the particles.
-	m_emitter->draw();
+	aie::ShaderProgram* programs[] = { &m_depthPrepassShader, &m_depthPrepassAlphaShader,
+		&m_depthPrepassBatchedShader, &m_depthPrepassBatchedAlphaShader, &m_depthPrepassMeshShader,
+		&m_depthPrepassMeshAlphaShader };
+	linkShaders(programs, meshShaders ? 6 : 4);
 }
 
 /**
-	terminate calls any necessary functions that must be called
-		as the program is shutting down.
-
-	@return returns 0 due to the program being shut down.
+	InitShadows loads the programs shadow casters are drawn with and
+		creates the light's shadow cascades. They reuse the depth
+		pre-pass fragment shaders, so cut out leaves cast cut out
+		shadows.
 */
-int Application::terminate()
+void Application::InitShadows()
 {
-	delete m_emitter;
-	delete screens;
-	glfwDestroyWindow(window);
-	glfwTerminate();
-	return 0;
+	m_shadowShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/shadow.vert");
+	m_shadowShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/depthAlpha.frag");
+	m_shadowInstancedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/shadowInstanced.vert");
+	m_shadowInstancedShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/depthAlpha.frag");
+	m_shadowBatchedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/shadowBatched.vert");
+	m_shadowBatchedShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/depthAlphaBatched.frag");
+	m_crowdShadowShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/crowdShadow.vert");
+	m_crowdShadowShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/depthAlpha.frag");
+
+	aie::ShaderProgram* programs[] = { &m_shadowShader, &m_shadowInstancedShader, &m_shadowBatchedShader,
+		&m_crowdShadowShader };
+	linkShaders(programs, 4);
+
+	// Shadows reach as far as the camera sees, and casters anywhere in
+	//	the courtyard towards the light are drawn.
+	m_shadowCascades.create(1000.0f, 2500.0f, m_shadowResolution);
+
+	// The point and spot lights' tiles share an atlas twice as wide, up to
+	//	the atlas's own default.
+	m_shadowAtlas.create(std::min(m_shadowResolution * 2, (unsigned int)sns::ShadowAtlas::DEFAULT_RESOLUTION));
 }
 
 /**
-	InitTexture is a function that initializes a shader that
-		renders an unlit model with its texture.
+	drawStaticShadowCasters draws everything that never moves into a
+		shadow cascade. It is only called for cascades whose cache is
+		out of date, so nothing here is culled.
+
+		@param1 lightProjectionView is the cascade's projection view.
 */
-void Application::InitTexture()
+void Application::drawStaticShadowCasters(const glm::mat4& lightProjectionView)
 {
-	//-----------------------------Textured-------------------------------------
+	m_shadowBatchedShader.bind();
+	m_shadowBatchedShader.bindUniform("LightProjectionView", lightProjectionView);
+	m_sceneBatch.drawAll(&m_shadowBatchedShader);
+
+	m_shadowShader.bind();
+	m_shadowShader.bindUniform("LightProjectionView", lightProjectionView);
+	m_sceneObjects.bind();
+	for (const auto& sceneMesh : m_sceneMeshes)
+	{
+		if (sceneMesh.batched || sceneMesh.mesh->isLoaded() == false)
+			continue;
 
-	//load vertex shader from file
-	m_texturedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/textured.vert");
+		sns::ObjectBuffer::select(sceneMesh.object);
+		sceneMesh.mesh->draw();
+	}
 
-	// load fragment shader from file
-	m_texturedShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/textured.frag");
+	m_shadowInstancedShader.bind();
+	m_shadowInstancedShader.bindUniform("LightProjectionView", lightProjectionView);
+	if (m_rockMesh.isLoaded())
+		m_rockMesh.drawInstanced(m_rockTransforms.data(), (unsigned int)m_rockTransforms.size());
+	if (m_treeMesh.isLoaded())
+		m_treeMesh.drawInstanced(m_treeTransforms.data(), (unsigned int)m_treeTransforms.size());
 
-	if (m_texturedShader.link() == false)
+	if (m_benchmarkScene != sns::BenchmarkScene::STANFORD)
+		return;
+	for (unsigned int i = 0; i < STANFORD_SCAN_COUNT; ++i)
 	{
-		printf("Shader Error: %s\n", m_texturedShader.getLastError());
+		if (m_stanfordMeshes[i].isLoaded())
+			m_stanfordMeshes[i].drawInstanced(m_stanfordTransforms[i].data(), (unsigned int)m_stanfordTransforms[i].size());
 	}
-
-	//--------------------------------------------------------------------------
 }
 
 /**
-	UpdateTexture is all of the logic that is needed to run
-		every frame in regards to the texture shader.
+	drawDynamicShadowCasters draws the characters and the crowds into a
+		shadow cascade or a tile of the shadow atlas, every time either
+		is drawn again.
+
+		@param1 lightProjectionView is the cascade's or face's projection
+				view.
 */
-void Application::UpdateTexture()
+void Application::drawDynamicShadowCasters(const glm::mat4& lightProjectionView)
 {
-	// Bind shader.
-	m_texturedShader.bind();
-
-	// Bind texture location.
-	m_texturedShader.bindUniform("diffuseTexture", 0);
+	if (m_animator.getCharacterCount() > 0)
+	{
+		m_shadowShader.bind();
+		m_shadowShader.bindUniform("LightProjectionView", lightProjectionView);
+		m_animator.draw();
+	}
+	if (m_crowds.empty() == false)
+	{
+		m_crowdShadowShader.bind();
+		m_crowdShadowShader.bindUniform("LightProjectionView", lightProjectionView);
+		for (auto& crowd : m_crowds)
+			crowd->draw(m_crowdShadowShader, lightProjectionView, m_packet->input.cameraPosition);
+	}
 }
 
 /**
-	InitPhong is a function that initializes a shader that
-		renders a model that is lit using phong lighting.
+	InitInstanced loads the rock and tree meshes and scatters copies of
+		them around the courtyard.
 */
-void Application::InitPhong()
+void Application::InitInstanced()
 {
-	//-----------------------------Phong----------------------------------------
+	m_phongInstancedShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/phongInstanced.vert");
+	m_phongInstancedShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/phong.frag");
+	if (m_phongInstancedShader.link() == false)
+	{
+		printf("Shader Error: %s\n", m_phongInstancedShader.getLastError());
+	}
 
-	// Load vertex shader from file.
-	m_phongShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/phong.vert");
+	// They load in the background and draw once they have been uploaded.
+	//	Their texcoords are in 0 to 1, so the packed vertices lose nothing.
+	m_rockMesh.setVertexFormat(aie::OBJMesh::PACKED_VERTEX);
+	m_treeMesh.setVertexFormat(aie::OBJMesh::PACKED_VERTEX);
+	m_assetLoader.loadMesh(&m_rockMesh, "../models/Rocks/LargeStone.obj", true, true);
+	m_assetLoader.loadMesh(&m_treeMesh, "../models/Tree/Lowpoly_tree_sample.obj", true, true);
+
+	// A fixed seed places the copies the same way every run, so
+	//	benchmarks stay comparable.
+	sns::Random random(28);
+	auto scatter = [&random](std::vector<glm::mat4>& transforms, unsigned int count,
+		float minScale, float maxScale)
+	{
+		transforms.reserve(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			glm::vec3 position(random.range(-1100.0f, 1100.0f), 0, random.range(-450.0f, 450.0f));
+			glm::mat4 transform = glm::translate(glm::mat4(1), position);
+			transform = glm::rotate(transform, random.range(0.0f, glm::two_pi<float>()), glm::vec3(0, 1, 0));
+			transforms.push_back(glm::scale(transform, glm::vec3(random.range(minScale, maxScale))));
+		}
+	};
+	scatter(m_rockTransforms, 400, 40.0f, 120.0f);
+	scatter(m_treeTransforms, 200, 4.0f, 8.0f);
+}
 
-	// Load fragment shader from file.
-	m_phongShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/phong.frag");
+/**
+	UpdateInstanced draws every copy of the rock and the tree, one
+		instanced draw per chunk of each mesh, and the Stanford scans
+		far from the camera as impostors.
 
-	if (m_phongShader.link() == false)
+		@param1 cameraPosition is the view's camera.
+*/
+void Application::UpdateInstanced(const glm::vec3& cameraPosition)
+{
+	m_phongInstancedShader.bind();
+	bindFrameUniforms(m_phongInstancedShader, m_light, m_ambientLight);
+
+	if (m_rockMesh.isLoaded())
+		m_rockMesh.drawInstanced(m_rockTransforms.data(), (unsigned int)m_rockTransforms.size());
+	if (m_treeMesh.isLoaded())
+		m_treeMesh.drawInstanced(m_treeTransforms.data(), (unsigned int)m_treeTransforms.size());
+
+	if (m_benchmarkScene != sns::BenchmarkScene::STANFORD ||
+		(m_stanfordPointsEnabled && m_stanfordPoints.isCreated()))
+		return;
+
+	// Copies far enough away swap to the impostor outright, the rest
+	//	are drawn in full.
+	bool impostors = m_impostorShader.getHandle() != 0;
+	for (unsigned int i = 0; i < STANFORD_SCAN_COUNT; ++i)
 	{
-		printf("Shader Error: %s\n", m_phongShader.getLastError());
+		if (m_stanfordMeshes[i].isLoaded() == false)
+			continue;
+		if (impostors == false || m_stanfordImpostors[i].isCreated() == false)
+		{
+			m_phongInstancedShader.bind();
+			m_stanfordMeshes[i].drawInstanced(m_stanfordTransforms[i].data(), (unsigned int)m_stanfordTransforms[i].size());
+			continue;
+		}
+
+		m_nearTransforms.clear();
+		m_farTransforms.clear();
+		for (const glm::mat4& transform : m_stanfordTransforms[i])
+		{
+			const glm::vec4& sphere = m_stanfordImpostors[i].getSphere();
+			glm::vec3 centre(transform * glm::vec4(glm::vec3(sphere), 1));
+			bool far = glm::distance(centre, cameraPosition) > STANFORD_IMPOSTOR_DISTANCE;
+			(far ? m_farTransforms : m_nearTransforms).push_back(transform);
+		}
+
+		m_phongInstancedShader.bind();
+		m_stanfordMeshes[i].drawInstanced(m_nearTransforms.data(), (unsigned int)m_nearTransforms.size());
+		if (m_farTransforms.empty() == false)
+		{
+			m_impostorShader.bind();
+			m_lightClusters.bind(m_impostorShader);
+			m_shadowCascades.bind(m_impostorShader);
+			m_shadowAtlas.bind(m_impostorShader);
+			m_volumetricFog.bind(m_impostorShader);
+			m_ambientOcclusion.bind(m_impostorShader);
+			m_stanfordImpostors[i].bind(m_impostorShader);
+			m_stanfordImpostors[i].drawInstanced(m_farTransforms.data(), (unsigned int)m_farTransforms.size());
+		}
 	}
-
-	UpdatePhong();
-	//--------------------------------------------------------------------------
 }
 
+// The scans, in the order of m_stanfordMeshes.
+static const char* const STANFORD_FILES[] =
+{
+	"../stanford/Bunny.obj", "../stanford/Buddha.obj", "../stanford/Dragon.obj", "../stanford/Lucy.obj"
+};
+
 /**
-	UpdatePhong is all of the logic that is needed to run
-		every frame in regards to the phong shader.
+	InitStanford loads the four Stanford scans and lines copies of each
+		up in a row across the courtyard. The scans are a few hundred
+		thousand triangles each, so the scene is bound by vertices
+		rather than by pixels.
 */
-void Application::UpdatePhong()
+void Application::InitStanford()
 {
-	//-----------------------------Phong----------------------------------------
-	// bind phong shader program
-	m_phongShader.bind();
+	const unsigned int COPIES = 8;
 
-	// Bind light.
-	m_phongShader.bindUniform("Ia", m_ambientLight);
-	m_phongShader.bindUniform("Id", m_light.diffuse);
-	m_phongShader.bindUniform("Is", m_light.specular);
-	m_phongShader.bindUniform("LightDirection", m_light.direction);
+	// Distant copies are drawn as impostors, baked once each scan has
+	//	loaded. Without GL 4.5 every copy is drawn in full.
+	if (m_impostorBaker.create())
+	{
+		m_impostorShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/impostorInstanced.vert");
+		m_impostorShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/impostor.frag");
+		if (m_impostorShader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_impostorShader.getLastError());
+		}
+	}
 
-	// Send the camera's position
-	m_phongShader.bindUniform("cameraPosition", m_flyCam->getPosition());
-	//--------------------------------------------------------------------------
+	for (unsigned int i = 0; i < STANFORD_SCAN_COUNT; ++i)
+	{
+		if (m_mappedScans)
+			m_assetLoader.loadMappedMesh(&m_stanfordMeshes[i], STANFORD_FILES[i]);
+		else
+			m_assetLoader.loadMesh(&m_stanfordMeshes[i], STANFORD_FILES[i], false, false);
+
+		// Each scan stands on the floor about 150 units tall, a row
+		//	each from the back of the courtyard to the front.
+		m_stanfordTransforms[i].reserve(COPIES);
+		for (unsigned int j = 0; j < COPIES; ++j)
+		{
+			glm::vec3 position(((float)j - (COPIES - 1) * 0.5f) * 250.0f, 0, ((float)i - 1.5f) * 200.0f);
+			glm::mat4 transform = glm::translate(glm::mat4(1), position);
+			transform = glm::rotate(transform, j * glm::half_pi<float>(), glm::vec3(0, 1, 0));
+			m_stanfordTransforms[i].push_back(glm::scale(transform, glm::vec3(15.0f)));
+		}
+	}
 }
 
 /**
-	InitNormalMap is a function that initializes a shader that
-		renders a model that is lit using phong lighting
-		and displays them with their texture and can use
-		a normal map.
+	LoadStanfordPoints reads the Stanford scans' vertices into
+		m_stanfordPoints on a job, every copy of each a point cloud of
+		its own colour, and creates it once that is done. A scan that
+		can't be read is left out.
 */
-void Application::InitNormalMap()
+void Application::LoadStanfordPoints()
 {
-	//-----------------------------Normal Map-----------------------------------
-
-	// Load normal shader from file.
-	m_normalMapShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/normalmap.vert");
-
-	// Load fragment shader from file.
-	m_normalMapShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/normalmap.frag");
+	m_stanfordPointsLoading = true;
+	sns::JobSystem& jobs = sns::JobSystem::instance();
+	jobs.run([this]()
+	{
+		// RGBA8, red in the low byte.
+		const uint32_t COLOURS[STANFORD_SCAN_COUNT] = { 0xff80c0f0, 0xff60d0a0, 0xff5070e0, 0xffd09070 };
+
+		std::vector<sns::PointCloud::Point> points;
+		sns::ObjParser parser;
+		for (unsigned int i = 0; i < STANFORD_SCAN_COUNT; ++i)
+		{
+			if (parser.parse(STANFORD_FILES[i]) == false)
+			{
+				printf("Point cloud: %s\n", parser.getLastError().c_str());
+				continue;
+			}
+			for (const sns::ObjParser::Shape& shape : parser.getShapes())
+			{
+				for (const glm::mat4& transform : m_stanfordTransforms[i])
+				{
+					for (const aie::OBJMesh::Vertex& vertex : shape.vertices)
+						points.push_back({ glm::vec3(transform * glm::vec4(glm::vec3(vertex.position), 1)), COLOURS[i] });
+				}
+			}
+		}
+
+		unsigned int dropped = m_stanfordPoints.build(points);
+		printf("Point cloud: %u points in %u nodes, %u dropped\n", m_stanfordPoints.getPointCount(),
+			m_stanfordPoints.getNodeCount(), dropped);
+	}, &m_stanfordPointsJob);
+
+	// Made on the main thread, where the context is.
+	jobs.runAfter(m_stanfordPointsJob, [this]() { m_stanfordPoints.create(); }, nullptr,
+		sns::JobSystem::MAIN_THREAD);
+}
 
-	if (m_normalMapShader.link() == false)
+/**
+	UpdateGizmoStress adds the gizmos scene's gizmos to this frame, a
+		grid of each kind through the courtyard so the tessellated and
+		instanced paths are both measured.
+*/
+void Application::UpdateGizmoStress()
+{
+	const int GRID = 24;
+	for (int x = 0; x < GRID; ++x)
 	{
-		printf("Shader Error: %s\n", m_normalMapShader.getLastError());
+		for (int z = 0; z < GRID; ++z)
+		{
+			glm::vec3 center((x - GRID / 2) * 80.0f, 40.0f, (z - GRID / 2) * 35.0f);
+			glm::vec4 colour((float)x / GRID, 0.5f, (float)z / GRID, 1);
+
+			aie::Gizmos::addAABB(center, glm::vec3(10), colour);
+			aie::Gizmos::addSphere(center + glm::vec3(0, 30, 0), 8.0f, 8, 8, colour);
+			aie::Gizmos::addSphereInstanced(center + glm::vec3(0, 60, 0), 8.0f, colour);
+			aie::Gizmos::addAABBInstanced(center + glm::vec3(0, 90, 0), glm::vec3(8), colour);
+		}
 	}
-
-	UpdateNormalMap();
-	//--------------------------------------------------------------------------
 }
 
 /**
-	UpdateNormalMap is all of the logic that is needed to run
-		every frame in regards to the normal map shader.
+	InitPlanets builds a solar system of planets, moons and a belt of
+		rocks as entities. Each is a body of the gravity simulation,
+		started on a circle around its parent, and pulled by every
+		other body from then on.
 */
-void Application::UpdateNormalMap()
+void Application::InitPlanets()
 {
-	//-------------------------Normal---------------------------
-	// Bind phong shader program.
-	m_normalMapShader.bind();
+	sns::GravitySimulation& gravity = m_entities.gravity;
+
+	// Adds a sphere circling a parent body, at an angle around it, or
+	//	still where it is when it has no parent. Those with a height have
+	//	a surface, hills rising and sinking by that share of the radius.
+	auto addPlanet = [this, &gravity](unsigned int parent, float radius, const glm::vec4& colour,
+		float mass, float orbitRadius, float angle, bool retrograde, float height)
+	{
+		glm::vec3 offset(std::cos(angle) * orbitRadius, 0, -std::sin(angle) * orbitRadius);
+		glm::vec3 position = gravity.getPosition(parent) + offset;
+		unsigned int body = gravity.addBody(position, gravity.getOrbitalVelocity(parent, offset, mass, retrograde),
+			mass);
+
+		sns::Entity planet = m_entities.create();
+		m_entities.createTransform(planet, glm::translate(glm::mat4(1), position), planet);
+		m_entities.renderables.add(planet, { radius });
+		m_entities.colours.add(planet, { colour });
+		m_entities.bodies.add(planet, { body });
+		m_entities.colliders.add(planet, { sns::SweepAndPrune::NO_HANDLE });
+		if (height > 0.0f)
+		{
+			m_entities.surfaces.add(planet, { height, (float)planet });
+			m_trailPlanets.push_back(planet);
+		}
+		return body;
+	};
 
-	// Bind light.
-	m_normalMapShader.bindUniform("Ia", m_ambientLight);
-	m_normalMapShader.bindUniform("Id", m_light.diffuse);
-	m_normalMapShader.bindUniform("Is", m_light.specular);
-	m_normalMapShader.bindUniform("LightDirection", m_light.direction);
+	// The octree is over the courtyard and the sky above it, anything
+	//	further out is only kept in its root.
+	m_entities.octree.create(glm::vec3(-1500, -200, -1500), glm::vec3(1500, 1000, 1500));
+
+	// The sun sits above the courtyard, everything else circles it. The
+	//	masses give the planets about the periods they had on rails.
+	unsigned int sun = gravity.addBody(glm::vec3(0, 300, 0), glm::vec3(0), 360000.0f);
+	sns::Entity sunEntity = m_entities.create();
+	m_entities.createTransform(sunEntity, glm::translate(glm::mat4(1), glm::vec3(0, 300, 0)), sunEntity);
+	m_entities.renderables.add(sunEntity, { 20.0f });
+	m_entities.colours.add(sunEntity, { glm::vec4(1, 0.8f, 0.2f, 1) });
+	m_entities.bodies.add(sunEntity, { sun });
+	m_sunEntity = sunEntity;
+
+	addPlanet(sun, 5.0f, glm::vec4(0.7f, 0.4f, 0.3f, 1), 2000.0f, 50.0f, 0.0f, false, 0.04f);
+
+	// A planet with a moon, well inside the reach of its gravity.
+	unsigned int earth = addPlanet(sun, 8.0f, glm::vec4(0.2f, 0.4f, 1, 1), 21000.0f, 100.0f, 0.0f, false, 0.02f);
+	addPlanet(earth, 2.0f, glm::vec4(0.8f, 0.8f, 0.8f, 1), 100.0f, 12.0f, 0.0f, false, 0.05f);
+
+	// A larger outer planet with two moons, the far one going the other
+	//	way, as those further out only stay when they do.
+	unsigned int outer = addPlanet(sun, 14.0f, glm::vec4(0.9f, 0.6f, 0.4f, 1), 50000.0f, 170.0f, 0.0f, false,
+		0.015f);
+	addPlanet(outer, 3.0f, glm::vec4(0.6f, 0.6f, 0.5f, 1), 60.0f, 22.0f, 0.0f, false, 0.06f);
+	addPlanet(outer, 2.5f, glm::vec4(0.5f, 0.5f, 0.6f, 1), 40.0f, 32.0f, glm::pi<float>(), true, 0.06f);
+
+	// A belt of rocks beyond the outer planet's reach, enough of them
+	//	that the simulation sums through its octree. A fixed seed places
+	//	them the same way every run, so benchmarks stay comparable.
+	const unsigned int rocks = 1500;
+	sns::Random random(41);
+	for (unsigned int i = 0; i < rocks; ++i)
+	{
+		float shade = random.range(0.35f, 0.6f);
+		addPlanet(sun, random.range(0.5f, 1.2f), glm::vec4(shade, shade * 0.9f, shade * 0.8f, 1),
+			random.range(0.01f, 0.1f), random.range(250.0f, 300.0f), random.range(0.0f, glm::two_pi<float>()),
+			false, 0.0f);
+	}
 
-	// Send the camera's position.
-	m_normalMapShader.bindUniform("cameraPosition", m_flyCam->getPosition());
+	// Only the sun was still, the system as a whole stays put from here.
+	gravity.removeDrift();
 }
 
 /**
-	InitNormalMapDown is a function that initializes a shader that
-		renders a model that is lit using phong lighting
-		and displays them with their texture and can use
-		a normal map. However, this shader is so that the
-		ground in the sponza scene can be lit.
+	UpdatePlanets runs the entity systems, moving each planet along its
+		orbit and adding the planets to the gizmos.
+
+		@param1 deltaTime is how long the last frame took, in seconds.
 */
-void Application::InitNormalMapDown()
+void Application::UpdatePlanets(float deltaTime)
 {
-	//-----------------------------Normal Map-----------------------------------
+	aie::Gizmos::clear();
+
+	// Only the transforms that moved and their children are recomputed,
+	//	then the octree is brought up to date from them in one go.
+	sns::EntitySystems::updateOrbits(m_entities, deltaTime);
+	sns::EntitySystems::updateBodies(m_entities, deltaTime);
+	sns::EntitySystems::updateTransforms(m_entities);
+	sns::EntitySystems::updateBounds(m_entities);
+
+	// A point of the trails every quarter of a second, about an orbit
+	//	of the inner planet in the history.
+	if (m_planetTrails.isCreated() && deltaTime > 0.0f)
+	{
+		m_trailTime += deltaTime;
+		m_trailTimer += deltaTime;
+		bool advance = m_trailTimer >= 0.25f;
+		if (advance)
+			m_trailTimer = 0.0f;
+
+		m_trailPoints.resize(m_trailPlanets.size());
+		for (size_t i = 0; i < m_trailPlanets.size(); ++i)
+		{
+			const sns::TransformComponent* transform = m_entities.transforms.get(m_trailPlanets[i]);
+			m_trailPoints[i] = glm::vec4(glm::vec3(m_entities.graph.getWorld(transform->node)[3]), m_trailTime);
+		}
+		m_planetTrails.record(m_trailPoints.data(), (unsigned int)m_trailPoints.size(), m_trailTime, advance);
+	}
 
-	// Load normal shader from file.
-	m_normalMapShaderDown.loadShader(aie::eShaderStage::VERTEX, "../shaders/normalmap.vert");
+	// There is no narrowphase yet, the broadphase's pairs are only
+	//	counted.
+	sns::Profiler::setCounter("Collider pairs", sns::EntitySystems::updateColliders(m_entities));
 
-	// Load fragment shader from file.
-	m_normalMapShaderDown.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/normalmap.frag");
+	// The planet renderer splits the surfaces for each view as it draws
+	//	them, they aren't gizmos as well.
+	bool surfaces = m_planetRenderer.isCreated();
+	if (surfaces)
+		sns::EntitySystems::drawSurfaces(m_entities, m_planetRenderer);
 
-	if (m_normalMapShaderDown.link() == false)
+	// The planets are drawn into the shadow cascades as well as the
+	//	views, so they are culled against the cascades' last boxes too.
+	//	Before the cascades have been drawn once everything is drawn.
+	if (m_shadowCascades.getParameters().w == 0.0f)
 	{
-		printf("Shader Error: %s\n", m_normalMapShaderDown.getLastError());
+		sns::EntitySystems::drawRenderables(m_entities, nullptr, 0, surfaces);
+		return;
 	}
 
-	UpdateNormalMapDown();
-	//--------------------------------------------------------------------------
+	sns::Frustum frustums[1 + sns::ShadowCascades::CASCADE_COUNT];
+	frustums[0].setMatrix(m_packet->input.cullProjectionView);
+	for (unsigned int i = 0; i < sns::ShadowCascades::CASCADE_COUNT; ++i)
+		frustums[1 + i].setMatrix(m_shadowCascades.getProjectionView(i));
+	sns::EntitySystems::drawRenderables(m_entities, frustums, 1 + sns::ShadowCascades::CASCADE_COUNT, surfaces);
 }
 
 /**
-	UpdateNormalMapDown is all of the logic that is needed to run
-		every frame in regards to the normal map shader that
-		faces down.
+	UpdateCloth steps the scene meshes hung as cloth. Each mesh gets one
+		simulation, made the first update after it has loaded, however
+		many times it is placed. The scene is in centimetres, so is the
+		cloth.
+
+		@param1 deltaTime is how long the last frame took, in seconds.
 */
-void Application::UpdateNormalMapDown()
+void Application::UpdateCloth(float deltaTime)
 {
-	//-------------------------Normal---------------------------
-	// Bind phong shader program.
-	m_normalMapShaderDown.bind();
-
-	// Bind light.
-	m_normalMapShaderDown.bindUniform("Ia", m_ambientDownLight);
-	m_normalMapShaderDown.bindUniform("Id", m_downLight.diffuse);
-	m_normalMapShaderDown.bindUniform("Is", m_downLight.specular);
-	m_normalMapShaderDown.bindUniform("LightDirection", m_downLight.direction);
+	for (const SceneMesh& sceneMesh : m_sceneMeshes)
+	{
+		if (sceneMesh.cloth == false || sceneMesh.mesh->isLoaded() == false)
+			continue;
+
+		auto found = std::find_if(m_sceneCloths.begin(), m_sceneCloths.end(),
+			[&sceneMesh](const SceneCloth& cloth) { return cloth.mesh == sceneMesh.mesh; });
+		if (found != m_sceneCloths.end())
+			continue;
+
+		sns::ClothSimulation::Settings settings;
+		settings.gravity = glm::vec3(0, -980, 0);
+		settings.wind = glm::vec3(60, 0, 25);
+		settings.gust = 0.6f;
+		settings.gustScale = 150.0f;
+		settings.pinDistance = 5.0f;
+
+		// A mesh that can't be hung is drawn as it loaded, and isn't
+		//	tried again until it reloads.
+		SceneCloth cloth;
+		cloth.mesh = sceneMesh.mesh;
+		cloth.simulation.reset(new sns::ClothSimulation());
+		if (cloth.simulation->create(*sceneMesh.mesh, settings) == false)
+			printf("A scene mesh couldn't be hung as cloth, it is drawn still\n");
+		m_sceneCloths.push_back(std::move(cloth));
+	}
 
-	// Send the camera's position.
-	m_normalMapShaderDown.bindUniform("cameraPosition", m_flyCam->getPosition());
+	for (SceneCloth& cloth : m_sceneCloths)
+	{
+		if (cloth.simulation->isCreated())
+			cloth.simulation->update(deltaTime);
+	}
 }
 
 /**
-	Binds a shader to the spear and calls draw on the spear.
+	updateFrameUniforms writes the current view's camera and both
+		lights into the per-frame uniform buffer. This is the only
+		upload of them for programs that declare the block, once a
+		view.
 
-		@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+		@param1 occlusion is whether the view's ambient is occluded.
 */
-void Application::RenderSpear(aie::ShaderProgram* shaderType)
+void Application::updateFrameUniforms(bool occlusion)
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_spearTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
-	
-	m_spearMesh.draw();
+	const sns::FrameInput& input = m_viewInputs[m_currentView];
+	sns::FrameUniforms::Data data;
+	data.projection = input.projection;
+	data.view = input.view;
+	data.projectionView = input.projectionView;
+	data.cameraPosition = glm::vec4(input.cameraPosition, 1);
+
+	data.lights[0].ambient = glm::vec4(m_ambientLight, 1);
+	data.lights[0].diffuse = glm::vec4(m_light.diffuse, 1);
+	data.lights[0].specular = glm::vec4(m_light.specular, 1);
+	data.lights[0].direction = glm::vec4(m_light.direction, 0);
+
+	data.lights[1].ambient = glm::vec4(m_ambientDownLight, 1);
+	data.lights[1].diffuse = glm::vec4(m_downLight.diffuse, 1);
+	data.lights[1].specular = glm::vec4(m_downLight.specular, 1);
+	data.lights[1].direction = glm::vec4(m_downLight.direction, 0);
+
+	data.clusterScale = m_lightClusters.getScale();
+	data.clusterCount = m_lightClusters.getCount();
+
+	for (unsigned int i = 0; i < sns::FrameUniforms::MAX_CASCADES; ++i)
+		data.shadowMatrices[i] = m_shadowCascades.getMatrix(i);
+	data.shadowSplits = m_shadowCascades.getSplits();
+	data.shadowParameters = m_shadowCascades.getParameters();
+	data.viewOrigin = glm::vec4(m_viewports[m_currentView].x, m_viewports[m_currentView].y, 0, 0);
+	data.occlusionParameters = occlusion ?
+		m_ambientOcclusion.getParameters(m_viewports[m_currentView].z, m_viewports[m_currentView].w) : glm::vec4(0);
+	data.fogParameters = m_volumetricFog.getParameters();
+
+	m_frameUniforms.update(data);
 }
 
 /**
-	Binds a shader to the SponzaBuilding and calls draw on it.
+	bindFrameUniforms sends the light and camera as loose uniforms to
+		a program that doesn't declare the per-frame uniform block.
+		Programs that do read it from the buffer and are skipped.
+
+		@param1 shader is the program to send them to. It must be bound.
+
+		@param2 light is the light the program is lit by.
 
-	@param1 shaderType is a pointer to a shader.
-			This allows me to create any shader, get it
-			from memory and set it to this mesh.
+		@param3 ambient is the ambient light that goes with it.
 */
-void Application::RenderSponzaBuilding(aie::ShaderProgram* shaderType)
+void Application::bindFrameUniforms(aie::ShaderProgram& shader, const Light& light, const glm::vec3& ambient)
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_sponzaBuildingTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
+	if (shader.hasUniformBlock(sns::FrameUniforms::BLOCK_NAME))
+		return;
+
+	shader.bindUniform("Ia", ambient);
+	shader.bindUniform("Id", light.diffuse);
+	shader.bindUniform("Is", light.specular);
+	shader.bindUniform("LightDirection", light.direction);
+	shader.bindUniform("cameraPosition", m_packet->input.cameraPosition);
+}
 
-	// Bind transforms for lighting.
-	shaderType->bindUniform("NormalMatrix",
-		glm::inverseTranspose(glm::mat3(m_sponzaBuildingTransform)));
+/**
+	InitSceneMeshes starts loading every mesh of the scene description in
+		the background, each once, and adds an entry to the scene for
+		every object placing one. A mesh no object places isn't loaded,
+		and one only placed in cells is left to the scene streamer. It
+		makes no GL calls, and runs on a worker before the context
+		exists.
+*/
+void Application::InitSceneMeshes()
+{
+	m_sceneStreamer.create(m_scene);
 
-	// Send the camera's position.
-	shaderType->bindUniform("cameraPosition", m_flyCam->getPosition());
+	const std::vector<sns::SceneDescription::Mesh>& meshes = m_scene.getMeshes();
+	std::vector<aie::OBJMesh*> loaded(meshes.size(), nullptr);
+	for (const sns::SceneDescription::Object& object : m_scene.getObjects())
+	{
+		const sns::SceneDescription::Mesh& description = meshes[object.mesh];
+		aie::OBJMesh* streamed = m_sceneStreamer.getMesh(object.mesh);
+		if (streamed != nullptr)
+		{
+			loaded[object.mesh] = streamed;
+			streamed->setPickable(true);
+			streamed->setMergeMaterials(true);
+			streamed->setPackScalarMaps(true);
+			streamed->setAtlasTextures(true);
+		}
+		else if (loaded[object.mesh] == nullptr)
+		{
+			m_sceneOBJMeshes.emplace_back(new aie::OBJMesh());
+			loaded[object.mesh] = m_sceneOBJMeshes.back().get();
+			loaded[object.mesh]->setPickable(true);
+
+			// Scene meshes are a draw a material rather than a draw a
+			//	shape.
+			loaded[object.mesh]->setMergeMaterials(true);
+
+			// The scene batch copies its meshes' textures as it is built,
+			//	only the meshes it won't take can wait to be seen. Those
+			//	are only drawn by the lit shaders, which can read their
+			//	scalar maps packed and their small maps from the atlas.
+			if ((description.material & sns::SceneDescription::MATERIAL_NORMAL_MAP) == 0)
+			{
+				loaded[object.mesh]->setLazyTextures(true);
+				loaded[object.mesh]->setPackScalarMaps(true);
+				loaded[object.mesh]->setAtlasTextures(true);
+			}
+
+			// Meshes with a lightmap unwrap it as they import.
+			if (description.lightmapResolution > 0)
+				loaded[object.mesh]->setLightmapResolution(description.lightmapResolution);
+			m_assetLoader.loadMesh(loaded[object.mesh], description.filename.c_str(), true, true);
+
+			aie::OBJMesh* mesh = loaded[object.mesh];
+			m_assetWatcher.watch(*mesh, description.filename.c_str(), true, true,
+				[this, mesh]() { sceneMeshReloaded(mesh); });
+		}
+
+		// The description's material bits are the lit features by
+		//	another name, alpha testing is decided per material.
+		unsigned int features = 0;
+		if ((description.material & sns::SceneDescription::MATERIAL_DIFFUSE_MAP) != 0)
+			features |= LIT_DIFFUSE_MAP;
+		if ((description.material & sns::SceneDescription::MATERIAL_NORMAL_MAP) != 0)
+			features |= LIT_NORMAL_MAP;
+		features |= (description.material >> sns::SceneDescription::MATERIAL_LIGHT_COUNT_SHIFT) << LIT_LIGHT_COUNT_SHIFT;
+
+		addSceneMesh(loaded[object.mesh], features, object.transform,
+			(object.flags & sns::SceneDescription::OBJECT_OCCLUDER) != 0,
+			(description.material & sns::SceneDescription::MATERIAL_ALPHA_TESTED) != 0);
+		m_sceneMeshes.back().streamed = streamed != nullptr;
+
+		// A streamed mesh can unload under its cloth, so only the always
+		//	loaded ones are hung.
+		m_sceneMeshes.back().cloth = streamed == nullptr &&
+			(object.flags & sns::SceneDescription::OBJECT_CLOTH) != 0;
+		m_sceneMeshes.back().transparent = (object.flags & sns::SceneDescription::OBJECT_TRANSPARENT) != 0;
+
+		// Only meshes that stay loaded and still are baked.
+		if (loaded[object.mesh]->getLightmapResolution() > 0 && m_sceneMeshes.back().cloth == false)
+		{
+			m_sceneMeshes.back().lightmapped = true;
+			m_sceneMeshes.back().features |= LIT_LIGHTMAP;
+		}
+	}
 
-	m_sponzaBuildingMesh.draw();
+	// Scene meshes placing the same mesh are submitted by the same job.
+	m_sceneMeshOrder.resize(m_sceneMeshes.size());
+	for (unsigned int i = 0; i < m_sceneMeshOrder.size(); ++i)
+		m_sceneMeshOrder[i] = i;
+	std::stable_sort(m_sceneMeshOrder.begin(), m_sceneMeshOrder.end(), [this](unsigned int a, unsigned int b)
+	{
+		return std::less<const aie::OBJMesh*>()(m_sceneMeshes[a].mesh, m_sceneMeshes[b].mesh);
+	});
+	m_sceneMeshRuns.clear();
+	for (unsigned int i = 0; i < m_sceneMeshOrder.size(); ++i)
+	{
+		if (i == 0 || m_sceneMeshes[m_sceneMeshOrder[i]].mesh != m_sceneMeshes[m_sceneMeshOrder[i - 1]].mesh)
+			m_sceneMeshRuns.push_back(i);
+	}
+	m_sceneMeshRuns.push_back((unsigned int)m_sceneMeshOrder.size());
 }
 
 /**
-	Binds a shader to the SponzaCurtains and calls draw on it.
-
-	@param1 shaderType is a pointer to a shader.
-			This allows me to create any shader, get it
-			from memory and set it to this mesh.
+	InitScene loads the skinned characters into the animator, makes the
+		terrain, bakes the crowds, opens the virtual textures and
+		scatters the foliage, which all need the context.
 */
-void Application::RenderSponzaCurtains(aie::ShaderProgram* shaderType)
+void Application::InitScene()
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_sponzaCurtainsTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
+	// Characters load as they are placed, their models being small.
+	//	Without GL 4.5 there is no skinning, and they aren't drawn.
+	const std::vector<sns::SceneDescription::Character>& characters = m_scene.getCharacters();
+	if (characters.empty() == false && m_animator.create())
+	{
+		for (const sns::SceneDescription::Character& character : characters)
+		{
+			m_animator.addCharacter(character.filename, character.transform, character.clip,
+				character.blendClip, character.blend, character.speed);
+		}
+	}
 
-	// Bind transforms for lighting.
-	shaderType->bindUniform("NormalMatrix",
-		glm::inverseTranspose(glm::mat3(m_sponzaCurtainsTransform)));
+	// Without GL 4.5 there is no tessellation, and no terrain.
+	if (m_scene.getTerrain().size > 0)
+		m_terrain.create(m_scene.getTerrain());
 
-	// Send the camera's position.
-	shaderType->bindUniform("cameraPosition", m_flyCam->getPosition());
+	// Without GL 4.5 there are no compute shaders to move the waves, and
+	//	no ocean.
+	if (m_scene.getOcean().extent > 0)
+		m_ocean.create(m_scene.getOcean());
 
-	m_sponzaCurtainsMesh.draw();
+	// The crowds stand on the terrain too, each baking its clip as it is
+	//	made. Without GL 4.5 they aren't drawn.
+	for (const sns::SceneDescription::Crowd& description : m_scene.getCrowds())
+	{
+		sns::Crowd::HeightFunction height;
+		if (m_terrain.isCreated())
+			height = [this](float a_x, float a_z) { return m_terrain.getHeight(a_x, a_z); };
+		std::unique_ptr<sns::Crowd> crowd(new sns::Crowd());
+		if (crowd->create(description, height))
+			m_crowds.push_back(std::move(crowd));
+	}
+
+	// Meshes with virtual textures draw their diffuse colour from the
+	//	cache's pages instead. Without GL 4.5 they keep their diffuse
+	//	maps. The scene meshes are in the order of its objects.
+	const std::vector<sns::SceneDescription::Mesh>& meshes = m_scene.getMeshes();
+	const std::vector<sns::SceneDescription::Object>& objects = m_scene.getObjects();
+	bool virtualTextured = false;
+	for (const sns::SceneDescription::Mesh& mesh : meshes)
+		virtualTextured = virtualTextured || mesh.virtualTexture.empty() == false;
+	if (virtualTextured && m_virtualTextures.create(m_windowResolution.x, m_windowResolution.y))
+	{
+		for (unsigned int i = 0; i < objects.size() && i < m_sceneMeshes.size(); ++i)
+		{
+			const std::string& filename = meshes[objects[i].mesh].virtualTexture;
+			unsigned int texture = filename.empty() ? sns::VirtualTextureCache::NO_TEXTURE :
+				m_virtualTextures.add(filename.c_str());
+			if (texture == sns::VirtualTextureCache::NO_TEXTURE)
+				continue;
+
+			SceneMesh& sceneMesh = m_sceneMeshes[i];
+			sceneMesh.virtualTexture = texture;
+			sceneMesh.features |= LIT_DIFFUSE_MAP | LIT_VIRTUAL_TEXTURE;
+			m_sceneObjects.setVirtualTexture(sceneMesh.object, texture + 1);
+		}
+	}
+
+	// The foliage stands on the terrain, so it is scattered after it.
+	if (m_scene.getFoliage().empty() == false && m_impostorBaker.create() && m_foliage.create())
+	{
+		sns::Foliage::HeightFunction height;
+		if (m_terrain.isCreated())
+			height = [this](float a_x, float a_z) { return m_terrain.getHeight(a_x, a_z); };
+		for (const sns::SceneDescription::Foliage& layer : m_scene.getFoliage())
+		{
+			aie::OBJMesh* mesh = m_foliage.addLayer(layer, height);
+			if (mesh != nullptr)
+				m_assetLoader.loadMesh(mesh, layer.filename.c_str(), true, true);
+		}
+	}
 }
 
 /**
-	Binds a shader to the SponzaFountainPlants and calls
-		draw on it.
+	addSceneMesh adds a placed mesh to the scene, to be drawn through
+		the render queue once it has loaded.
+
+		@param1 mesh is the mesh, loading or loaded.
+
+		@param2 features are the LitFeature bits it is drawn with.
+
+		@param3 transform is where the mesh is placed in the world.
+
+		@param4 occluder is whether it is drawn into the HiZ buffer
+				to hide what is behind it.
+
+		@param5 alphaTested is whether its materials cut holes with their
+				diffuse alpha.
+*/
+void Application::addSceneMesh(aie::OBJMesh* mesh, unsigned int features,
+	const glm::mat4& transform, bool occluder, bool alphaTested)
+{
+	SceneMesh sceneMesh;
+	sceneMesh.mesh = mesh;
+	sceneMesh.features = features;
+	sceneMesh.transform = transform;
+	sceneMesh.object = m_sceneObjects.add(transform);
+	sceneMesh.batched = false;
+	sceneMesh.streamed = false;
+	sceneMesh.cloth = false;
+	sceneMesh.occluder = occluder;
+	sceneMesh.alphaTested = alphaTested;
+	sceneMesh.transparent = false;
+	sceneMesh.lightmapped = false;
+	sceneMesh.virtualTexture = sns::VirtualTextureCache::NO_TEXTURE;
+	m_sceneMeshes.push_back(sceneMesh);
+}
 
-	@param1 shaderType is a pointer to a shader.
-			This allows me to create any shader, get it
-			from memory and set it to this mesh.
+/**
+	requestSceneTextures asks the texture streamer for the mip levels the
+		unbatched scene meshes need from the camera, and loads the lazy
+		textures of the materials they submitted last frame. Batched
+		meshes draw copies of their textures, so ask for nothing.
 */
-void Application::RenderSponzaFountainPlants(aie::ShaderProgram * shaderType)
+void Application::requestSceneTextures()
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_sponzaFountainPlantsTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
+	// As with levels of detail, the camera's position suits every view.
+	for (auto& sceneMesh : m_sceneMeshes)
+	{
+		if (sceneMesh.batched || sceneMesh.mesh->isLoaded() == false)
+			continue;
 
-	// Bind transforms for lighting.
-	shaderType->bindUniform("NormalMatrix",
-		glm::inverseTranspose(glm::mat3(m_sponzaFountainPlantsTransform)));
+		sceneMesh.mesh->requestTextures(m_textureStreamer, m_packet->input.projection,
+			m_packet->input.view * sceneMesh.transform, (float)m_viewports[0].w);
+		sceneMesh.mesh->loadSeenTextures(m_assetLoader);
+	}
+}
 
-	// Send the camera's position.
-	shaderType->bindUniform("cameraPosition", m_flyCam->getPosition());
+/**
+	buildSceneBatch moves every loaded normal mapped scene mesh from the
+		render queue into the scene batch, where all of them are drawn
+		with a multi-draw per material. Cloth stays in the render queue,
+		the batch would draw a copy of its vertices as they loaded, and
+		so do transparent meshes, which are drawn in a pass of their own,
+		and lightmapped and virtually textured ones, which the lit
+		shaders draw.
+*/
+void Application::buildSceneBatch()
+{
+	for (auto& sceneMesh : m_sceneMeshes)
+	{
+		if (sceneMesh.batched || sceneMesh.streamed || sceneMesh.cloth || sceneMesh.transparent ||
+			sceneMesh.lightmapped || sceneMesh.virtualTexture != sns::VirtualTextureCache::NO_TEXTURE ||
+			(sceneMesh.features & LIT_NORMAL_MAP) == 0 || sceneMesh.mesh->isLoaded() == false)
+			continue;
+
+		m_sceneBatch.add(sceneMesh.mesh, &m_normalMapBatchedShader, sceneMesh.transform, sceneMesh.occluder,
+			sceneMesh.alphaTested);
+		sceneMesh.batched = true;
+	}
 
-	m_sponzaFountainPlantsMesh.draw();
+	if (m_sceneBatch.isBuilt() == false)
+		m_sceneBatch.build();
 }
 
 /**
-	Binds a shader to the SponzaLionHeads and calls draw on it.
+	sceneMeshReloaded builds the scene batch again if the mesh is in it,
+		as it draws copies, and the scene's bvh over the mesh's new
+		chunks. Its cloth is made again over the new vertices by the
+		next UpdateCloth, and the lightmaps and probes see it from the
+		next frame.
 
-	@param1 shaderType is a pointer to a shader.
-			This allows me to create any shader, get it
-			from memory and set it to this mesh.
+		@param1 mesh is the mesh that was replaced.
 */
-void Application::RenderSponzaLionHeads(aie::ShaderProgram * shaderType)
+void Application::sceneMeshReloaded(const aie::OBJMesh* mesh)
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_sponzaLionHeadsTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
+	m_sceneCloths.erase(std::remove_if(m_sceneCloths.begin(), m_sceneCloths.end(),
+		[mesh](const SceneCloth& cloth) { return cloth.mesh == mesh; }), m_sceneCloths.end());
+
+	for (auto& sceneMesh : m_sceneMeshes)
+	{
+		if (sceneMesh.mesh == mesh && sceneMesh.batched)
+		{
+			m_sceneBatch.build();
+			break;
+		}
+	}
 
-	// Bind transforms for lighting.
-	shaderType->bindUniform("NormalMatrix",
-		glm::inverseTranspose(glm::mat3(m_sponzaLionHeadsTransform)));
+	buildSceneBvh();
+	m_shadowCascades.invalidate();
+	m_shadowAtlas.invalidate();
 
-	// Send the camera's position.
-	shaderType->bindUniform("cameraPosition", m_flyCam->getPosition());
+	// The lightmaps and probes are traced through the new triangles,
+	//	the lightmaps packed and baked again unless nothing they see
+	//	changed.
+	m_traceScene.clear();
+	m_lightmapper.clear();
 
-	m_sponzaLionHeadsMesh.draw();
+	// The occluders are taken again from the new triangles.
+	m_softwareOcclusion.clearOccluders();
 }
 
 /**
-	Binds a shader to the SponzaPlants and calls draw on it.
-
-	@param1 shaderType is a pointer to a shader.
-		This allows me to create any shader, get it
-		from memory and set it to this mesh.
+	renderSoftwareOcclusion adds the loaded occluder scene meshes to the
+		software occlusion when there are new ones, then rasterises them
+		for the first view. Streamed meshes aren't occluders, they could
+		be unloaded while the triangles they gave were still hiding
+		chunks.
 */
-void Application::RenderSponzaPlants(aie::ShaderProgram * shaderType)
+void Application::renderSoftwareOcclusion()
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_sponzaPlantsTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
+	unsigned int occluders = 0;
+	for (const SceneMesh& sceneMesh : m_sceneMeshes)
+	{
+		if (sceneMesh.occluder && sceneMesh.streamed == false && sceneMesh.mesh->isLoaded() &&
+			sceneMesh.mesh->isPickable())
+			++occluders;
+	}
+	if (occluders != m_softwareOcclusion.getOccluderCount())
+	{
+		SNS_PROFILE_SCOPE("Software occluders");
+		m_softwareOcclusion.clearOccluders();
+		for (const SceneMesh& sceneMesh : m_sceneMeshes)
+		{
+			if (sceneMesh.occluder && sceneMesh.streamed == false && sceneMesh.mesh->isLoaded() &&
+				sceneMesh.mesh->isPickable())
+				m_softwareOcclusion.addOccluder(*sceneMesh.mesh, sceneMesh.transform);
+		}
+	}
 
-	// Bind transforms for lighting.
-	shaderType->bindUniform("NormalMatrix",
-		glm::inverseTranspose(glm::mat3(m_sponzaPlantsTransform)));
+	m_softwareOcclusion.render(m_viewInputs[0].projectionView);
+}
 
-	// Send the camera's position.
-	shaderType->bindUniform("cameraPosition", m_flyCam->getPosition());
+/**
+	buildSceneBvh builds the scene's bvh over the world bounds of every
+		chunk of every scene mesh. Each chunk's local box is turned into
+		the world box around its eight corners, and the sphere around a
+		mesh's boxes is its object's bounds.
+*/
+void Application::buildSceneBvh()
+{
+	sns::time start = m_clock.now();
+	std::vector<sns::Bvh::Box> boxes;
+	m_sceneChunks.clear();
+	for (unsigned int i = 0; i < m_sceneMeshes.size(); ++i)
+	{
+		const SceneMesh& sceneMesh = m_sceneMeshes[i];
+		if (sceneMesh.mesh->isLoaded() == false)
+			continue;
+
+		const sns::BoxList& bounds = sceneMesh.mesh->getChunkBounds();
+		glm::vec3 lowest(FLT_MAX), highest(-FLT_MAX);
+		for (unsigned int chunk = 0; chunk < bounds.size(); ++chunk)
+		{
+			glm::vec3 centre(bounds.centreX[chunk], bounds.centreY[chunk], bounds.centreZ[chunk]);
+			glm::vec3 extent(bounds.extentX[chunk], bounds.extentY[chunk], bounds.extentZ[chunk]);
+			sns::Bvh::Box box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+			for (unsigned int corner = 0; corner < 8; ++corner)
+			{
+				glm::vec3 sign((corner & 1) != 0 ? 1.0f : -1.0f, (corner & 2) != 0 ? 1.0f : -1.0f,
+					(corner & 4) != 0 ? 1.0f : -1.0f);
+				glm::vec3 world = glm::vec3(sceneMesh.transform * glm::vec4(centre + sign * extent, 1));
+				box.min = glm::min(box.min, world);
+				box.max = glm::max(box.max, world);
+			}
+			boxes.push_back(box);
+			m_sceneChunks.push_back({ i, chunk });
+			lowest = glm::min(lowest, box.min);
+			highest = glm::max(highest, box.max);
+		}
+		if (bounds.size() > 0)
+		{
+			m_sceneObjects.setBounds(sceneMesh.object,
+				glm::vec4((lowest + highest) * 0.5f, glm::length(highest - lowest) * 0.5f));
+		}
+	}
 
-	m_sponzaPlantsMesh.draw();
+	m_sceneBvh.build(boxes.data(), (unsigned int)boxes.size());
+	printf("Scene bvh: %u chunks in %u nodes, built in %.2f ms\n", m_sceneBvh.getPrimitiveCount(),
+		m_sceneBvh.getNodeCount(), (m_clock.now() - start).count() * NANO_TO_SECONDS * 1000.0);
 }
 
 /**
-	Binds a shader to the SponzaRibbons and calls draw on it.
+	pick finds the closest triangle of the static scene under a point on
+		the screen. The point is made a ray through the camera, which the
+		scene bvh takes to the chunks it could hit, and each chunk's own
+		bvh to the triangles.
+
+		@param1 a_point is the point in window pixels, y down.
 
-	@param1 shaderType is a pointer to a shader.
-			This allows me to create any shader, get it
-			from memory and set it to this mesh.
+		@param2 a_result is set to what was hit.
+
+		@return false if nothing was hit.
 */
-void Application::RenderSponzaRibbons(aie::ShaderProgram * shaderType)
+bool Application::pick(const glm::vec2& a_point, PickResult& a_result) const
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_sponzaRibbonsTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
-
-	// Bind transforms for lighting.
-	shaderType->bindUniform("NormalMatrix",
-		glm::inverseTranspose(glm::mat3(m_sponzaRibbonsTransform)));
+	if (m_sceneBvh.isBuilt() == false)
+		return false;
 
-	// Send the camera's position.
-	shaderType->bindUniform("cameraPosition", m_flyCam->getPosition());
+	// The point on the near plane and one further in, at a depth either
+	//	projection has in front of the camera.
+	glm::vec2 ndc(a_point.x / m_windowResolution.x * 2.0f - 1.0f, 1.0f - a_point.y / m_windowResolution.y * 2.0f);
+	bool reverseZ = sns::RenderState::instance().isReverseZ();
+	glm::mat4 unproject = glm::inverse(m_flyCam->getProjectionView());
+	glm::vec4 nearPoint = unproject * glm::vec4(ndc, reverseZ ? 1.0f : -1.0f, 1.0f);
+	glm::vec4 farPoint = unproject * glm::vec4(ndc, reverseZ ? 0.5f : 0.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+	// Each chunk is tested in its mesh's space. The direction isn't
+	//	normalised there, so the distances stay the world's.
+	unsigned int closestTriangle = 0;
+	sns::Bvh::Hit hit;
+	bool found = m_sceneBvh.intersectRay(origin, direction, FLT_MAX,
+		[&](unsigned int primitive, float maxDistance)
+	{
+		const SceneChunk& sceneChunk = m_sceneChunks[primitive];
+		const SceneMesh& sceneMesh = m_sceneMeshes[sceneChunk.sceneMesh];
+		glm::mat4 toLocal = glm::inverse(sceneMesh.transform);
+		glm::vec3 localOrigin = glm::vec3(toLocal * glm::vec4(origin, 1));
+		glm::vec3 localDirection = glm::vec3(toLocal * glm::vec4(direction, 0));
+
+		unsigned int triangle;
+		float distance;
+		if (sceneMesh.mesh->intersectChunk(sceneChunk.chunk, localOrigin, localDirection, maxDistance,
+			triangle, distance) == false)
+			return -1.0f;
+		closestTriangle = triangle;
+		return distance;
+	}, hit);
+	if (found == false)
+		return false;
 
-	m_sponzaRibbonsMesh.draw();
+	const SceneChunk& sceneChunk = m_sceneChunks[hit.primitive];
+	const SceneMesh& sceneMesh = m_sceneMeshes[sceneChunk.sceneMesh];
+	a_result.sceneMesh = sceneChunk.sceneMesh;
+	a_result.chunk = sceneChunk.chunk;
+	a_result.triangle = closestTriangle;
+	a_result.distance = hit.distance;
+	a_result.position = origin + direction * hit.distance;
+	sceneMesh.mesh->getTriangle(sceneChunk.chunk, closestTriangle, a_result.corners);
+	for (glm::vec3& corner : a_result.corners)
+		corner = glm::vec3(sceneMesh.transform * glm::vec4(corner, 1));
+	return true;
 }
 
 /**
-	Binds a shader to the SponzaFloor and calls draw on it.
+	submitSceneMeshes adds the unbatched scene meshes to a render queue,
+		culling their chunks against every view in each mesh's local
+		space as they go.
+
+		@param1 queue is the queue to add them to.
+
+		@param2 normalMapped is whether to add the normal mapped meshes,
+				or the rest.
 
-	@param1 shaderType is a pointer to a shader.
-			This allows me to create any shader, get it
-			from memory and set it to this mesh.
+		@param3 shader is the program they are drawn with, or nullptr
+				for each chunk's lit permutation.
+
+		@param4 alphaTestedShader is the program chunks with alpha tested
+				materials are drawn with, or nullptr for the same.
+
+		@param5 transparent is whether to add only the transparent
+				meshes, with their transparent lit permutations.
 */
-void Application::RenderSponzaFloor(aie::ShaderProgram * shaderType)
+void Application::submitSceneMeshes(sns::RenderQueue& queue, bool normalMapped, aie::ShaderProgram* shader,
+	aie::ShaderProgram* alphaTestedShader, bool transparent)
 {
-	// Bind transform.
-	auto pvm = m_flyCam->getProjectionView() * m_sponzaFloorTransform;
-	shaderType->bindUniform("ProjectionViewModel", pvm);
+	unsigned int viewCount = m_viewLayout.getViewCount();
+
+	// Once the scene's bvh is built, a mesh with no chunk in any view is
+	//	skipped whole, before its chunks are culled one by one.
+	bool bvhCulled = m_sceneBvh.isBuilt();
+	if (bvhCulled)
+	{
+		SNS_PROFILE_SCOPE("Scene bvh");
+		m_visibleSceneMeshes.assign(m_sceneMeshes.size(), 0);
+		for (unsigned int i = 0; i < viewCount; ++i)
+		{
+			m_sceneBvhResults.clear();
+			m_sceneBvh.queryFrustum(sns::Frustum(m_viewInputs[i].projectionView), m_sceneBvhResults);
+			for (unsigned int primitive : m_sceneBvhResults)
+				m_visibleSceneMeshes[m_sceneChunks[primitive].sceneMesh] = 1;
+		}
+	}
+
+	// The cheapest program for each of a mesh's materials, null for
+	//	meshes left out. Alpha testing is picked per material, so the
+	//	opaque chunks of a mesh with leaves don't pay for it.
+	//	Transparent meshes are left to their own pass while the
+	//	transparency target blends them.
+	const unsigned int variants = aie::OBJMesh::MATERIAL_VARIANT_Count;
+	bool separateTransparent = m_transparencyMethod >= 0;
+	m_sceneMeshShaders.assign(m_sceneMeshes.size() * variants, nullptr);
+	for (unsigned int mesh = 0; mesh < m_sceneMeshes.size(); ++mesh)
+	{
+		const SceneMesh& sceneMesh = m_sceneMeshes[mesh];
+		if (sceneMesh.batched || (sceneMesh.transparent && separateTransparent) != transparent)
+			continue;
+		if (transparent == false &&
+			((sceneMesh.features & LIT_NORMAL_MAP) != 0 && sceneMesh.lightmapped == false &&
+			sceneMesh.virtualTexture == sns::VirtualTextureCache::NO_TEXTURE) != normalMapped)
+			continue;
+		if (bvhCulled && m_visibleSceneMeshes[mesh] == 0)
+			continue;
+
+		aie::ShaderProgram** shaders = &m_sceneMeshShaders[mesh * variants];
+		for (unsigned int variant = 0; variant < variants; ++variant)
+		{
+			if (transparent)
+				shaders[variant] = m_litShaders.get(makeLitKey(sceneMesh.features, variant) | LIT_TRANSPARENT);
+			else if (shader == nullptr)
+				shaders[variant] = m_litShaders.get(makeLitKey(sceneMesh.features, variant));
+			else if ((variant & aie::OBJMesh::MATERIAL_ALPHA_TESTED) != 0 && alphaTestedShader != nullptr)
+				shaders[variant] = alphaTestedShader;
+			else
+				shaders[variant] = shader;
+		}
+	}
 
-	// Bind transforms for lighting.
-	shaderType->bindUniform("NormalMatrix",
-		glm::inverseTranspose(glm::mat3(m_sponzaFloorTransform)));
+	// Each job culls and submits whole runs of the meshes, about
+	//	SUBMIT_JOB_MESHES of them, into its own list.
+	// Only the first view's chunks are tested against the software
+	//	occluders, which are rendered for it.
+	const sns::SoftwareOcclusion* occlusion = m_softwareOcclusionEnabled ? &m_softwareOcclusion : nullptr;
+	auto submitRuns = [this, viewCount, occlusion](unsigned int a_firstRun, unsigned int a_lastRun,
+		sns::RenderQueue& a_list)
+	{
+		const unsigned int variants = aie::OBJMesh::MATERIAL_VARIANT_Count;
+		sns::Frustum frustums[sns::ViewLayout::MAX_VIEWS];
+		for (unsigned int i = m_sceneMeshRuns[a_firstRun]; i < m_sceneMeshRuns[a_lastRun]; ++i)
+		{
+			unsigned int mesh = m_sceneMeshOrder[i];
+			aie::ShaderProgram* const* shaders = &m_sceneMeshShaders[mesh * variants];
+			if (shaders[0] == nullptr)
+				continue;
+
+			const SceneMesh& sceneMesh = m_sceneMeshes[mesh];
+			for (unsigned int view = 0; view < viewCount; ++view)
+				frustums[view].setMatrix(m_viewInputs[view].projectionView * sceneMesh.transform);
+
+			// The views share the camera's position, so its levels of
+			//	detail suit all of them.
+			sceneMesh.mesh->selectLODs(m_packet->input.projection, m_packet->input.view * sceneMesh.transform,
+				(float)m_viewports[0].w);
+			sceneMesh.mesh->submit(a_list, shaders, sceneMesh.object, frustums, false, viewCount, occlusion,
+				sceneMesh.transform);
+		}
+	};
 
-	// Send the camera's position.
-	shaderType->bindUniform("cameraPosition", m_flyCam->getPosition());
+	unsigned int runCount = (unsigned int)m_sceneMeshRuns.size() - 1;
+	if (m_sceneMeshOrder.size() <= SUBMIT_JOB_MESHES)
+	{
+		submitRuns(0, runCount, queue);
+		return;
+	}
 
-	m_sponzaFloorMesh.draw();
+	// The lists are made before any job starts, so none moves under one.
+	std::vector<unsigned int> firstRuns;
+	for (unsigned int first = 0; first < runCount;)
+	{
+		firstRuns.push_back(first);
+		unsigned int last = first + 1;
+		while (last < runCount && m_sceneMeshRuns[last] - m_sceneMeshRuns[first] < SUBMIT_JOB_MESHES)
+			++last;
+		first = last;
+	}
+	firstRuns.push_back(runCount);
+	unsigned int listCount = (unsigned int)firstRuns.size() - 1;
+	if (m_submitLists.size() < listCount)
+		m_submitLists.resize(listCount);
+
+	sns::JobSystem& jobs = sns::JobSystem::instance();
+	sns::JobCounter counter;
+	for (unsigned int i = 0; i < listCount; ++i)
+	{
+		unsigned int first = firstRuns[i];
+		unsigned int last = firstRuns[i + 1];
+		sns::RenderQueue* list = &m_submitLists[i];
+		jobs.run([&submitRuns, first, last, list]() { submitRuns(first, last, *list); }, &counter);
+	}
+	jobs.wait(counter);
+	queue.merge(m_submitLists.data(), listCount);
 }
 
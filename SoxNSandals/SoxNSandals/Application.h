@@ -14,7 +14,70 @@
 #pragma once
 #include "soxCore.h"
 #include "FlyCamera.h"
-#include "ParticleEmitter.h"
+#include "ParticleSystem.h"
+#include "AssetLoader.h"
+#include "AsyncCompute.h"
+#include "FrameCapture.h"
+#include "VideoEncoder.h"
+#include "TelemetryStream.h"
+#include "VirtualTextureCache.h"
+#include "FrameUniforms.h"
+#include "RenderQueue.h"
+#include "RenderGraph.h"
+#include "CameraPath.h"
+#include "FrameRecording.h"
+#include "RegressionGate.h"
+#include "SceneDescription.h"
+#include "SceneStreamer.h"
+#include "Bvh.h"
+#include "FramePipeline.h"
+#include "EntityRegistry.h"
+#include "MeshBatch.h"
+#include "ObjectBuffer.h"
+#include "ShaderWatcher.h"
+#include "AssetWatcher.h"
+#include "ShaderPermutations.h"
+#include "LightClusters.h"
+#include "DecalAtlas.h"
+#include "VolumetricFog.h"
+#include "Sky.h"
+#include "ScreenSpaceReflections.h"
+#include "DeferredRenderer.h"
+#include "FragmentCounter.h"
+#include "OcclusionQueries.h"
+#include "SoftwareOcclusion.h"
+#include "ShadowAtlas.h"
+#include "Lightmapper.h"
+#include "ProbeVolume.h"
+#include "TraceScene.h"
+#include "ShadowCascades.h"
+#include "ParticleTarget.h"
+#include "TransparencyTarget.h"
+#include "SceneTarget.h"
+#include "Input.h"
+#include "FramePacer.h"
+#include "DynamicResolution.h"
+#include "FrameReuse.h"
+#include "TemporalUpsampler.h"
+#include "AmbientOcclusion.h"
+#include "PostProcess.h"
+#include "ViewLayout.h"
+#include "TextureStreamer.h"
+#include "DebugHud.h"
+#include "SharedWindow.h"
+#include "Animator.h"
+#include "Terrain.h"
+#include "Ocean.h"
+#include "Crowd.h"
+#include "Foliage.h"
+#include "ImpostorBaker.h"
+#include "PointCloud.h"
+#include "PlanetRenderer.h"
+#include "TrailRenderer.h"
+#include "ClothSimulation.h"
+#include "JobSystem.h"
+#include "Config.h"
+#include <vector>
 
 // Forward declarations
 class FlyCamera;
@@ -50,6 +113,266 @@ public:
 	*/
 	int run();
 
+	/**
+		setDeferredShading picks whether the normal mapped scene is
+			drawn into a g-buffer and lit afterwards, or shaded as it
+			is drawn. F1 switches between them while running.
+
+			@param1 a_deferred is whether to shade it deferred.
+	*/
+	void setDeferredShading(bool a_deferred) { m_deferredShading = a_deferred; }
+
+	/**
+		setDepthPrepass picks whether forward shading lays down the
+			normal mapped scene's depth before shading it, so nothing
+			hidden is shaded. F2 switches it while running.
+
+			@param1 a_prepass is whether to draw the pre-pass.
+	*/
+	void setDepthPrepass(bool a_prepass) { m_depthPrepass = a_prepass; }
+
+	/**
+		setTemporalUpsampling picks whether the scene is drawn at half
+			the window's width and height and built up to its size over
+			four frames. F8 switches it while running.
+
+			@param1 a_temporal is whether to upsample the scene.
+	*/
+	void setTemporalUpsampling(bool a_temporal) { m_temporalUpsampling = a_temporal; }
+
+	/**
+		setAmbientOcclusion picks whether forward shading with the depth
+			pre-pass darkens the ambient light where the scene occludes
+			it. F9 switches it while running.
+
+			@param1 a_occlusion is whether to occlude the ambient.
+	*/
+	void setAmbientOcclusion(bool a_occlusion) { m_ambientOcclusionEnabled = a_occlusion; }
+
+	/**
+		setAntiAliasing picks how the scene's edges are anti-aliased.
+			F10 steps through the modes while running.
+
+			@param1 a_mode is the mode.
+	*/
+	void setAntiAliasing(sns::AntiAliasing a_mode) { m_antiAliasing = a_mode; }
+
+	/**
+		setBloom picks whether the scene's brightest parts glow. Control
+			and F10 switch it while running.
+
+			@param1 a_bloom is whether they glow.
+	*/
+	void setBloom(bool a_bloom) { m_postProcess.getSettings().bloom = a_bloom; }
+
+	/**
+		setPresentMode picks how frames are presented, set before run.
+			A benchmark always runs uncapped.
+
+			@param1 a_mode is how frames are presented.
+
+			@param2 a_rate is the frames per second a capped mode holds
+					to.
+	*/
+	void setPresentMode(sns::PresentMode a_mode, double a_rate) { m_presentMode = a_mode; m_presentRate = a_rate; }
+
+	/**
+		setMonitorViews picks whether the window is opened across every
+			monitor with a view on each, set before run.
+
+			@param1 a_monitorViews is whether to draw a view per monitor.
+	*/
+	void setMonitorViews(bool a_monitorViews) { m_monitorViews = a_monitorViews; }
+
+	/**
+		setIdleWait picks whether the loop sleeps until there is input
+			while nothing on screen changes, for kiosks showing a still
+			scene. It still wakes every IDLE_TIMEOUT, so streaming and
+			reloads are seen to.
+
+			@param1 a_idleWait is whether to wait while idle.
+	*/
+	void setIdleWait(bool a_idleWait) { m_idleWait = a_idleWait; }
+
+	/**
+		setControlPanel picks whether the hud is drawn in a window of its
+			own beside the main one rather than over the frame, set
+			before run.
+
+			@param1 a_controlPanel is whether to open the control panel.
+	*/
+	void setControlPanel(bool a_controlPanel) { m_controlPanelEnabled = a_controlPanel; }
+
+	/**
+		setMappedScans picks whether the Stanford scans are parsed
+			straight into mapped GPU memory rather than imported, which
+			needs no copy of their vertices in memory but leaves them
+			without the cache, optimising or levels of detail. Set
+			before run.
+
+			@param1 a_mappedScans is whether to parse them into mapped
+					memory.
+	*/
+	void setMappedScans(bool a_mappedScans) { m_mappedScans = a_mappedScans; }
+
+	/**
+		setTextureBudget sets how much video memory the streamed scene
+			textures can take.
+
+			@param1 a_bytes is the budget, the streamer's default for 0.
+	*/
+	void setTextureBudget(size_t a_bytes) { m_textureStreamer.setBudget(a_bytes); }
+
+	/**
+		setRecording records every frame from once loading finishes,
+			and writes the recording when the window closes, set
+			before run.
+
+			@param1 a_filename is the recording to write.
+	*/
+	void setRecording(const char* a_filename) { m_recordingFile = a_filename; }
+
+	/**
+		setVideoStream encodes every frame on the gpu's video encoder
+			into a file or pipe as H.264, see sns::VideoEncoder, set
+			before run.
+
+			@param1 a_filename is the file or pipe to write the stream to.
+
+			@param2 a_settings is how it is encoded.
+	*/
+	void setVideoStream(const char* a_filename, const sns::VideoEncoder::Settings& a_settings)
+	{
+		m_videoStreamFile = a_filename;
+		m_videoStreamSettings = a_settings;
+	}
+
+	/**
+		setBenchmarkScene picks the scene benchmark times, set before
+			benchmark.
+
+			@param1 a_scene is the scene.
+	*/
+	void setBenchmarkScene(sns::BenchmarkScene a_scene) { m_benchmarkScene = a_scene; }
+
+	/**
+		setSceneFile picks the scene file loaded, set before initialize.
+
+			@param1 a_filename is a scene, as JSON or compiled.
+	*/
+	void setSceneFile(const char* a_filename) { m_sceneFile = a_filename; }
+
+	/**
+		setTelemetry streams what the profiler records of every frame
+			to a collector, see sns::TelemetryStream, set before run.
+
+			@param1 a_address is the collector's "host:port".
+	*/
+	void setTelemetry(const char* a_address) { m_telemetryAddress = a_address; }
+
+	/**
+		setHudFont draws the debug hud's text in a font file of
+			sns::SdfFont's instead of its block font.
+
+			@param1 a_filename is the font file.
+	*/
+	void setHudFont(const char* a_filename) { m_debugHud.setFont(a_filename); }
+
+	/**
+		setConfig applies a run's settings, set before initialize. The
+			window's size is given to the constructor instead.
+
+			@param1 a_config is the settings, kept for as long as the
+					application as its scene file is read from it.
+	*/
+	void setConfig(const sns::Config& a_config);
+
+	/**
+		benchmark flies the camera along a path instead of taking input,
+			timing a fixed amount of frames with vsync off once every
+			asset has loaded.
+
+			@param1 a_frameCount is how many frames to time.
+
+			@param2 a_output is the json file the results are written to.
+
+			@param3 a_pathFile is a camera path file, or nullptr to fly
+					the built in path through Sponza.
+
+			@param4 a_replayFile is a recording to replay instead of
+					flying a path, its frames instead of a_frameCount,
+					or nullptr.
+
+			@return 0 if the benchmark ran and its results were written.
+	*/
+	int benchmark(unsigned int a_frameCount, const char* a_output, const char* a_pathFile,
+		const char* a_replayFile = nullptr);
+
+	/**
+		regressionGate benchmarks every scene in turn along the built in
+			path, and compares them against a baseline.
+
+			@param1 a_baselineFile is the baseline to compare against.
+
+			@param2 a_frameCount is how many frames to time each scene.
+
+			@param3 a_updateBaseline writes this run's results over the
+					baseline instead of failing on it.
+
+			@return 0 if nothing regressed, 1 if something did, or
+					less than 0 if the scenes couldn't be run.
+	*/
+	int regressionGate(const char* a_baselineFile, unsigned int a_frameCount, bool a_updateBaseline);
+
+	/**
+		renderFrames draws frames along a path without showing a window,
+			into a framebuffer of its own, and writes each to disk. The
+			frames are stepped as a benchmark's are, so every run
+			writes the same ones.
+
+			@param1 a_frameCount is how many frames to write.
+
+			@param2 a_directory is the directory they are written into as
+					frame_00000.tga on, which must exist.
+
+			@param3 a_pathFile is a camera path file, or nullptr to fly
+					the built in path through Sponza.
+
+			@param4 a_encoderCount is how many threads encode the frames,
+					0 for one less than the number of cores.
+
+			@return 0 if every frame was written.
+	*/
+	int renderFrames(unsigned int a_frameCount, const char* a_directory, const char* a_pathFile,
+		unsigned int a_encoderCount = 0);
+
+	/**
+		What pick found, the scene mesh, its chunk and that chunk's
+			triangle, and where in the world it was hit.
+	*/
+	struct PickResult
+	{
+		unsigned int sceneMesh;
+		unsigned int chunk;
+		unsigned int triangle;
+		float distance;
+		glm::vec3 position;
+		glm::vec3 corners[3];
+	};
+
+	/**
+		pick finds the closest triangle of the static scene under a point
+			on the screen, once the scene has loaded.
+
+			@param1 a_point is the point in window pixels, y down, as
+					GLFW gives the cursor.
+
+			@param2 a_result is set to what was hit.
+
+			@return false if nothing was hit.
+	*/
+	bool pick(const glm::vec2& a_point, PickResult& a_result) const;
+
 protected:
 
 	/**
@@ -63,8 +386,7 @@ protected:
 			called every frame is in this function such as render
 			and any input checks.
 
-			@param1 deltaTime is the current frame rate of the 
-					application. 
+			@param1 deltaTime is how long the last frame took, in seconds.
 
 			@return true to keep the application running.
 	*/
@@ -77,6 +399,181 @@ protected:
 	*/
 	void render();
 
+	/**
+		renderView draws the frame from one view, into its part of the
+			window, its passes run through m_renderGraph.
+
+			@param1 view is the view's index in m_viewLayout.
+
+			@param2 deferred is whether the normal mapped scene is
+					deferred shaded.
+	*/
+	void renderView(unsigned int view, bool deferred);
+
+	/**
+		captureInput copies what the simulation of a frame needs from
+			the main thread.
+
+			@param1 deltaTime is how long the last frame took, in seconds.
+
+			@return the input of the next frame.
+	*/
+	sns::FrameInput captureInput(double deltaTime) const;
+
+	/**
+		beginBenchmark stops taking input and holds every frame to the
+			same work, then waits for everything to load with the
+			camera at the start of a path.
+
+			@param1 path is the path the camera will fly.
+	*/
+	void beginBenchmark(sns::CameraPath& path);
+
+	/**
+		timeFrames times frames flown along a path, or replayed.
+
+			@param1 frameCount is how many frames to time.
+
+			@param2 path is the path flown, once around over the frames.
+
+			@param3 replay is a recording to replay instead, or nullptr.
+
+			@return each frame's timings.
+	*/
+	sns::BenchmarkReport timeFrames(unsigned int frameCount, const sns::CameraPath& path,
+		const sns::FrameRecording* replay);
+
+	/**
+		switchBenchmarkScene adds what a benchmark scene needs to the
+			courtyard and takes away what the last one added, between
+			frames.
+
+			@param1 scene is the scene.
+	*/
+	void switchBenchmarkScene(sns::BenchmarkScene scene);
+
+	/**
+		InitStanford loads the Stanford scans and lines copies of them
+			up across the courtyard, for the stanford scene.
+	*/
+	void InitStanford();
+
+	/**
+		LoadStanfordPoints reads the Stanford scans' vertices into
+			m_stanfordPoints on a job, every copy of each a point cloud
+			of its own colour, and creates it once that is done.
+	*/
+	void LoadStanfordPoints();
+
+	/**
+		UpdateGizmoStress adds the gizmos scene's thousands of gizmos to
+			this frame.
+	*/
+	void UpdateGizmoStress();
+
+	/**
+		captureStart returns what a recording starts the simulation
+			from, the seed of every emitter, angle of every orbit and
+			state of every gravity body.
+	*/
+	sns::FrameRecording::Start captureStart() const;
+
+	/**
+		restartSimulation sets the emitters, orbits and bodies back to
+			a start and simulates the next frame again from it, so a
+			replay from the same start runs the same frames.
+
+			@param1 start is what to set the simulation back to.
+	*/
+	void restartSimulation(const sns::FrameRecording::Start& start);
+
+	/**
+		getRenderSettings returns the settings the keys switch, as
+			FrameRecording settings.
+	*/
+	uint32_t getRenderSettings() const;
+
+	/**
+		applyRenderSettings switches to a recorded frame's settings.
+
+			@param1 settings are the frame's FrameRecording settings.
+	*/
+	void applyRenderSettings(uint32_t settings);
+
+	/**
+		getRenderResolution returns the size the scene is drawn at this
+			frame, less than the window's when it is scaled down.
+	*/
+	glm::ivec2 getRenderResolution() const;
+
+	/**
+		makeFrameKey returns what this frame is drawn from besides the
+			scene, to tell whether the last frame can be shown again.
+	*/
+	sns::FrameReuse::Key makeFrameKey() const;
+
+	/**
+		presentScene takes the scene target, or the upsampled frame, to
+			the window, through the post process when there is one.
+
+			@param1 temporal is whether the frame is temporally upsampled.
+
+			@param2 drawn is whether the frame was drawn rather than
+					reused, and its bloom is built again.
+	*/
+	void presentScene(bool temporal, bool drawn);
+
+	/**
+		isTemporalUpsampling returns whether this frame is temporally
+			upsampled, or anti-aliased, which needs the scene target
+			without samples and a single view.
+	*/
+	bool isTemporalUpsampling() const
+	{
+		return (m_temporalUpsampling || m_antiAliasing == sns::AntiAliasing::TAA) &&
+			m_temporalUpsampler.isCreated() && m_sceneTarget.isCreated() && m_sceneTarget.getSamples() == 1 &&
+			m_viewLayout.getViewCount() == 1;
+	}
+
+	/**
+		applyAntiAliasing sets up the scene target and post process for
+			m_antiAliasing, falling back to FXAA if there can't be
+			samples.
+	*/
+	void applyAntiAliasing();
+
+	/**
+		isAmbientOcclusion returns whether this frame's ambient is
+			occluded, which needs forward shading with the pre-pass.
+
+			@param1 deferred is whether the scene is deferred shaded.
+	*/
+	bool isAmbientOcclusion(bool deferred) const
+	{
+		return m_ambientOcclusionEnabled && m_ambientOcclusion.isCreated() && deferred == false && m_depthPrepass &&
+			m_viewLayout.getViewCount() == 1;
+	}
+
+	/**
+		isMeshShading returns whether forward shading draws the scene
+			batch's meshlets through the task and mesh stages, which
+			needs the batch built for it and its programs linked.
+	*/
+	bool isMeshShading() const
+	{
+		return m_meshShading && m_sceneBatch.isMeshShading() && m_normalMapMeshShader.getHandle() != 0 &&
+			m_depthPrepassMeshShader.getHandle() != 0 && m_depthPrepassMeshAlphaShader.getHandle() != 0;
+	}
+
+	/**
+		simulate fills in a frame packet. It runs on the simulation
+			thread while the frame before it is drawn, so it must not
+			touch opengl.
+
+			@param1 packet is the frame to simulate, its input already set.
+	*/
+	void simulate(sns::FramePacket& packet);
+
 	/**
 		terminate calls any necessary functions that must be called
 			as the program is shutting down.
@@ -86,134 +583,262 @@ protected:
 	int terminate();
 
 	/**
-		InitTexture is a function that initializes a shader that
-			renders a model with its texture.
+		InitNormalMap is a function that initializes the shaders the
+			scene batch is drawn with, which are lit using phong
+			lighting and display their texture and normal map.
+	*/
+	void InitNormalMap();
+	/**
+		UpdateNormalMap is all of the logic that is needed to run
+		every frame in regards to the lit shaders.
 	*/
-	void InitTexture();
+	void UpdateNormalMap();
+
 	/**
-		UpdateTexture is all of the logic that is needed to run
-			every frame in regards to the texture shader.
+		linkShaders links programs all at once, so drivers that compile
+			on their own threads get through them side by side, and
+			prints why any failed.
+
+			@param1 programs are the programs, with their shaders loaded.
+
+			@param2 count is how many there are.
+
+			@return true if every one linked.
 	*/
-	void UpdateTexture();
+	bool linkShaders(aie::ShaderProgram* const* programs, unsigned int count);
 
 	/**
-		InitPhong is a function that initializes a shader that
-			renders a model that is lit using phong lighting.
+		InitLitShaders sets up the lit shader's permutations and
+			compiles the ones the scene meshes are drawn with, after
+			the lights and shadows it can use are created.
 	*/
-	void InitPhong();
+	void InitLitShaders();
+
 	/**
-		UpdatePhong is all of the logic that is needed to run
-			every frame in regards to the phong shader.
+		makeLitKey returns the key of the lit permutation a chunk is
+			drawn with, the cheapest one its material needs.
+
+			@param1 features are the LitFeature bits of its mesh.
+
+			@param2 variant is its material's OBJMesh::MaterialVariant.
 	*/
-	void UpdatePhong();
+	unsigned int makeLitKey(unsigned int features, unsigned int variant) const;
 
 	/**
-		InitNormalMap is a function that initializes a shader that
-			renders a model that is lit using phong lighting
-			and displays them with their texture and can use
-			a normal map.
+		InitLightClusters creates the light clusters and fills the
+			courtyard with coloured point and spot lights for the
+			normal map shaders to be lit by, and with the scene's
+			decals.
 	*/
-	void InitNormalMap();
+	void InitLightClusters();
+
 	/**
-		UpdateNormalMap is all of the logic that is needed to run
-		every frame in regards to the normal map shader.
+		InitDeferred loads the g-buffer shaders and creates the
+			deferred renderer the normal mapped scene is drawn
+			through when deferred shading is on.
 	*/
-	void UpdateNormalMap();
+	void InitDeferred();
+
+	/**
+		InitDepthPrepass loads the programs forward shading's depth
+			pre-pass draws with.
+	*/
+	void InitDepthPrepass();
 
 	/**
-		InitNormalMapDown is a function that initializes a shader that
-			renders a model that is lit using phong lighting
-			and displays them with their texture and can use
-			a normal map. However, this shader is so that the
-			ground in the sponza scene can be lit.
+		InitShadows loads the programs shadow casters are drawn with
+			and creates the light's shadow cascades.
 	*/
-	void InitNormalMapDown();
+	void InitShadows();
 
 	/**
-		UpdateNormalMapDown is all of the logic that is needed to run
-			every frame in regards to the normal map shader that
-			faces down.
+		drawStaticShadowCasters draws everything that never moves into
+			a shadow cascade: the scene batch, the loaded scene meshes
+			outside it, and every rock and tree.
+
+			@param1 lightProjectionView is the cascade's projection view.
 	*/
-	void UpdateNormalMapDown();
+	void drawStaticShadowCasters(const glm::mat4& lightProjectionView);
 
 	/**
-		Binds a shader to the spear and calls draw on the spear.
+		drawDynamicShadowCasters draws the characters and the crowds into
+			a shadow cascade or a tile of the shadow atlas.
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+			@param1 lightProjectionView is the cascade's or face's
+					projection view.
 	*/
-	void RenderSpear(aie::ShaderProgram* shaderType);
+	void drawDynamicShadowCasters(const glm::mat4& lightProjectionView);
 
 	/**
-		Binds a shader to the SponzaBuilding and calls draw on it.
+		InitPlanets builds a solar system of planets, moons and a belt
+			of rocks as entities, each a body of the gravity simulation.
+	*/
+	void InitPlanets();
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+	/**
+		InitInstanced loads the rock and tree meshes and scatters
+			copies of them around the courtyard.
 	*/
-	void RenderSponzaBuilding(aie::ShaderProgram* shaderType);
+	void InitInstanced();
 
 	/**
-		Binds a shader to the SponzaCurtains and calls draw on it.
+		UpdateInstanced draws every copy of the rock and the tree,
+			one instanced draw per chunk of each mesh, and the Stanford
+			scans far from the camera as impostors.
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+			@param1 cameraPosition is the view's camera.
 	*/
-	void RenderSponzaCurtains(aie::ShaderProgram * shaderType);
+	void UpdateInstanced(const glm::vec3& cameraPosition);
 
 	/**
-		Binds a shader to the SponzaFountainPlants and calls 
-			draw on it.
+		UpdatePlanets runs the entity systems, moving each planet under
+			the gravity of the rest and adding the planets to the gizmos.
+
+			@param1 deltaTime is how long the last frame took, in seconds.
+	*/
+	void UpdatePlanets(float deltaTime);
+
+	/**
+		UpdateCloth steps the scene meshes hung as cloth, making each
+			one's simulation once its mesh has loaded.
+
+			@param1 deltaTime is how long the last frame took, in seconds.
+	*/
+	void UpdateCloth(float deltaTime);
+
+	/**
+		updateFrameUniforms writes the current view's camera and both
+			lights into the per-frame uniform buffer, once a view.
+
+			@param1 occlusion is whether the view's ambient is occluded.
+	*/
+	void updateFrameUniforms(bool occlusion);
+
+	/**
+		InitSceneMeshes starts loading every mesh of the scene
+			description in the background, and places its objects.
+			It uses no GL, so it runs on a worker while the window
+			and context are made.
+	*/
+	void InitSceneMeshes();
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+	/**
+		InitScene makes the GL parts of the scene, its characters,
+			terrain, crowds and foliage, once the context exists.
 	*/
-	void RenderSponzaFountainPlants(aie::ShaderProgram * shaderType);
+	void InitScene();
 
 	/**
-		Binds a shader to the SponzaLionHeads and calls draw on it.
+		addSceneMesh adds a placed mesh to the scene, to be drawn
+			through the render queue once it has loaded.
+
+			@param1 mesh is the mesh, loading or loaded.
+
+			@param2 features are the LitFeature bits it is drawn with.
+					Its materials only get the normal map and alpha test
+					if they have the maps for them.
+
+			@param3 transform is where the mesh is placed in the world.
+
+			@param4 occluder is whether it is drawn into the HiZ buffer
+					to hide what is behind it.
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+			@param5 alphaTested is whether its materials cut holes with
+					their diffuse alpha.
 	*/
-	void RenderSponzaLionHeads(aie::ShaderProgram * shaderType);
+	void addSceneMesh(aie::OBJMesh* mesh, unsigned int features,
+		const glm::mat4& transform, bool occluder = false, bool alphaTested = false);
 
 	/**
-		Binds a shader to the SponzaPlants and calls draw on it.
+		buildSceneBatch moves every loaded normal mapped scene mesh
+			from the render queue into the scene batch.
+	*/
+	void buildSceneBatch();
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+	/**
+		buildSceneBvh builds the scene's bvh over the world bounds of
+			every chunk of every scene mesh, once they have all loaded.
 	*/
-	void RenderSponzaPlants(aie::ShaderProgram * shaderType);
+	void buildSceneBvh();
 
 	/**
-		Binds a shader to the SponzaRibbons and calls draw on it.
+		sceneMeshReloaded builds what is built over the scene meshes again
+			after the asset watcher replaced one.
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+			@param1 mesh is the mesh that was replaced.
 	*/
-	void RenderSponzaRibbons(aie::ShaderProgram * shaderType);
+	void sceneMeshReloaded(const aie::OBJMesh* mesh);
 
 	/**
-		Binds a shader to the SponzaFloor and calls draw on it.
+		renderSoftwareOcclusion adds the loaded occluder scene meshes to
+			the software occlusion when there are new ones, then
+			rasterises them for the first view.
+	*/
+	void renderSoftwareOcclusion();
 
-			@param1 shaderType is a pointer to a shader.
-				This allows me to create any shader, get it
-				from memory and set it to this mesh.
+	/**
+		submitSceneMeshes adds the unbatched scene meshes to a render
+			queue, culled against every view. The meshes are culled and
+			submitted by jobs, each into a list of its own, merged into
+			the queue once they have all finished.
+
+			@param1 queue is the queue to add them to.
+
+			@param2 normalMapped is whether to add the normal mapped
+					meshes, or the rest.
+
+			@param3 shader is the program they are drawn with, or
+					nullptr for each chunk's lit permutation.
+
+			@param4 alphaTestedShader is the program chunks with alpha
+					tested materials are drawn with, or nullptr for the
+					same.
+
+			@param5 transparent is whether to add only the transparent
+					meshes, normal mapped or not, with their transparent
+					lit permutations. They are only kept apart while
+					order independent transparency is on.
+	*/
+	void submitSceneMeshes(sns::RenderQueue& queue, bool normalMapped, aie::ShaderProgram* shader,
+		aie::ShaderProgram* alphaTestedShader, bool transparent = false);
+
+	/**
+		requestSceneTextures asks the texture streamer for the mip levels
+			the unbatched scene meshes need from the camera.
 	*/
-	void RenderSponzaFloor(aie::ShaderProgram * shaderType);
+	void requestSceneTextures();
 
 
 	// m_deltaTime stores the frame count of the application. It
 	//	gets passed into the update function.
 	double m_deltaTime;
 
+	// The length of one simulation step, 60 steps a second.
+	static constexpr double SIMULATION_STEP = 1.0 / 60.0;
+
+	// The most steps one frame simulates before it drops the rest.
+	static const unsigned int MAX_SIMULATION_STEPS = 5;
+
+	// The longest an idle frame waits for input, in seconds.
+	static constexpr double IDLE_TIMEOUT = 0.25;
+
+	// Whether to wait for input while idle, and whether the next frame
+	//	does, set at the end of each frame. See setIdleWait.
+	bool m_idleWait = false;
+	bool m_idle = false;
+	unsigned int m_idleFrames = 0;
+
+	/**
+		isSimulating returns whether running the simulation moves
+			anything: the particles, planets, characters, crowds, cloth
+			or sea.
+	*/
+	bool isSimulating() const;
+
+	// Time passed that hasn't been simulated yet, under one step.
+	//	Only the simulation thread uses it once the pipeline starts.
+	double m_simulationTime = 0.0;
+
 	// Stores the resolution for the application's window as an ivec2.
 	glm::ivec2 m_windowResolution;
 
@@ -250,29 +875,184 @@ protected:
 	// Creating a fly camera for the scene.
 	FlyCamera* m_flyCam;
 
-	// Particle emitter.
-	ParticleEmitter* m_emitter;
+	// The keyboard and mouse, drained once at the start of each frame.
+	sns::Input m_input;
+
+	// Sets the swap interval, holds capped frames to their rate and
+	//	measures how evenly frames are presented.
+	sns::FramePacer m_framePacer;
+	sns::PresentMode m_presentMode = sns::PresentMode::VSYNC;
+	double m_presentRate = 60.0;
+
+	// While benchmarking the camera follows this path instead of input.
+	sns::CameraPath* m_cameraPath = nullptr;
+
+	// Benchmarks update with a fixed time step so every run draws the
+	//	same frames, and settle for a few frames before any are timed.
+	static constexpr double BENCHMARK_TIME_STEP = 1.0 / 60.0;
+	static const unsigned int BENCHMARK_WARM_UP_FRAMES = 30;
+
+	// With a file to record to, every frame from once loading
+	//	finishes, which is when the recording starts.
+	const char* m_recordingFile = nullptr;
+	sns::FrameRecording m_recording;
+	bool m_recordingStarted = false;
+
+	// Frame times and what each pass cost, over the window while F5
+	//	has it shown.
+	sns::DebugHud m_debugHud;
+
+	// With m_controlPanelEnabled on, the hud is drawn in a window of its
+	//	own instead, which shows it from the start and presents on its
+	//	own thread. Once that window is closed the hud goes back over
+	//	the frame.
+	sns::SharedWindow m_controlPanel;
+	bool m_controlPanelEnabled = false;
+	static const int CONTROL_PANEL_WIDTH = 1280;
+	static const int CONTROL_PANEL_HEIGHT = 720;
+
+	// While benchmarking, two GL_TIMESTAMP queries written around the
+	//	frame's gl commands.
+	unsigned int* m_frameTimestamps = nullptr;
+
+	// Updates the scene's particle emitters on worker threads.
+	sns::ParticleSystem* m_particleSystem;
+	unsigned int m_particleBudget = 20000;
+
+	// Simulates the next frame while this one is drawn.
+	sns::FramePipeline m_pipeline;
+
+	// The frame being drawn, from the pipeline.
+	const sns::FramePacket* m_packet = nullptr;
 
 	//----------Shaders----------
 	//
-	// Regular shader that just draws basic rgba on mesh.
-	aie::ShaderProgram m_shader;
+	// What the lit shader's permutations can be compiled with, as bits of
+	//	their keys. The light count takes two.
+	enum LitFeature : unsigned int
+	{
+		LIT_DIFFUSE_MAP = 1 << 0,
+		LIT_NORMAL_MAP = 1 << 1,
+		LIT_ALPHA_TEST = 1 << 2,
+		LIT_SHADOWS = 1 << 3,
+		LIT_CLUSTERED_LIGHTS = 1 << 4,
+		LIT_PACKED_MAPS = 1 << 5,
+		LIT_LIGHT_COUNT_SHIFT = 6,
+		LIT_ONE_LIGHT = 1 << LIT_LIGHT_COUNT_SHIFT,
+		LIT_TWO_LIGHTS = 2 << LIT_LIGHT_COUNT_SHIFT,
+		LIT_TRANSPARENT = 1 << 8,
+		LIT_LIGHTMAP = 1 << 9,
+		LIT_PROBES = 1 << 10,
+		LIT_VIRTUAL_TEXTURE = 1 << 11
+	};
 
-	// Shader that allows textures to be drawn to a mesh, unlit.
-	aie::ShaderProgram m_texturedShader;
+	// One source for every lit and unlit mesh in the scene, compiled into
+	//	a program for each set of features a material needs, so none of
+	//	them pays for what it doesn't use.
+	sns::ShaderPermutations m_litShaders;
 
-	// Shader that supports phong lights. Doesn't draw textures.
-	aie::ShaderProgram m_phongShader;
+	// The same fragment shader's permutations over crowd.vert, for the
+	//	crowds' copies read from their baked frames.
+	sns::ShaderPermutations m_crowdShaders;
 
-	// Shader that supports phong lights, textures and, normal maps.
-	aie::ShaderProgram m_normalMapShader;
+	// The phong shader for instanced meshes, reading each instance's
+	//	model matrix from the mesh's instance buffer.
+	aie::ShaderProgram m_phongInstancedShader;
 
-	// Shader that supports phong lights, textures and, normal maps.
-	aie::ShaderProgram m_normalMapShaderDown;
+	// The normal map shader for meshes in the scene batch, reading each
+	//	draw's model matrix from the batch's transform buffer.
+	aie::ShaderProgram m_normalMapBatchedShader;
 
 	// Shader for the particles.
 	aie::ShaderProgram m_particleShader;
 
+	// Draws the particles at a fraction of the window's size, soft
+	//	where they meet the scene. m_particleDivisor is how many times
+	//	smaller, 0 draws them straight into the window without the fade.
+	sns::ParticleTarget m_particleTarget;
+	int m_particleDivisor = 2;
+
+	// Each view's passes, with the depth copies the ambient occlusion and
+	//	the particles make as transients sharing one texture.
+	sns::RenderGraph m_renderGraph;
+
+	// Blends the transparent scene meshes and the particles in order
+	//	without sorting them, by m_transparencyMethod, a
+	//	TransparencyTarget::Method or -1 to draw them as they were, the
+	//	meshes opaque and the particles sorted.
+	sns::TransparencyTarget m_transparencyTarget;
+	int m_transparencyMethod = -1;
+
+	// The particle shader drawing into the transparency target.
+	aie::ShaderProgram m_particleTransparentShader;
+
+	// What the scene is drawn into when depth is reversed, since the
+	//	window's depth can't be float. Uncreated, the scene is drawn
+	//	straight into the window with GL's usual depth.
+	sns::SceneTarget m_sceneTarget;
+
+	// Picks how much of the scene target the scene is drawn into from
+	//	how long the gpu took over it last time. F4 switches it on and
+	//	off, off draws at the window's size.
+	sns::DynamicResolution m_dynamicResolution;
+
+	// Shows the last frame again instead of drawing one the same, when
+	//	the camera hasn't moved and nothing in the scene has changed.
+	//	Only the scene target's copy can be shown again, the window's
+	//	back buffer isn't kept after a swap. F7 pauses the planets and
+	//	particles, which otherwise change every frame, so a still
+	//	display draws nothing at all.
+	sns::FrameReuse m_frameReuse;
+	bool m_simulationPaused = false;
+
+	// Shades the scene a quarter of the window's pixels a frame, each
+	//	frame a different quarter, and fills in the rest from the last
+	//	frames as the camera moved, when m_temporalUpsampling is on.
+	sns::TemporalUpsampler m_temporalUpsampler;
+	bool m_temporalUpsampling = false;
+
+	// Tonemaps the scene target's high dynamic range to the window,
+	//	with the grading and FXAA in the same pass.
+	sns::PostProcess m_postProcess;
+
+	// How the edges are anti-aliased. MSAA draws the scene target with
+	//	samples, which deferred shading and temporal upsampling can't
+	//	read, so they are off with it.
+	sns::AntiAliasing m_antiAliasing = sns::AntiAliasing::FXAA;
+	static const int MSAA_SAMPLES = 4;
+
+	// Brings the scene textures' finer mip levels onto the gpu as they
+	//	are seen up close, and drops them again to stay in its budget.
+	sns::TextureStreamer m_textureStreamer;
+
+	// A view per monitor when m_monitorViews is on, otherwise one of
+	//	the whole window. m_viewInputs are their cameras this frame,
+	//	m_viewports their parts of the scene and m_currentView the one
+	//	being drawn.
+	sns::ViewLayout m_viewLayout;
+	sns::FrameInput m_viewInputs[sns::ViewLayout::MAX_VIEWS];
+	glm::ivec4 m_viewports[sns::ViewLayout::MAX_VIEWS];
+	unsigned int m_currentView = 0;
+	bool m_monitorViews = false;
+
+	// Set by renderFrames, the window is never shown and every frame is
+	//	drawn into m_frameCapture, which writes them out.
+	bool m_headless = false;
+	sns::FrameCapture m_frameCapture;
+
+	// With a file to stream to, every finished frame goes through the
+	//	gpu's video encoder into it.
+	const char* m_videoStreamFile = nullptr;
+	sns::VideoEncoder::Settings m_videoStreamSettings;
+	sns::VideoEncoder m_videoEncoder;
+
+	// Relinks the shaders above when their files are edited.
+	sns::ShaderWatcher m_shaderWatcher;
+
+	// Loads the scene meshes and every texture again when their files are
+	//	edited.
+	sns::AssetWatcher m_assetWatcher;
+
 	// Transform for where the particle emitter will be in world space.
 	glm::mat4 m_particleTransform;
 
@@ -298,58 +1078,352 @@ protected:
 	// Strength of the light for m_downlight.
 	glm::vec3 m_ambientDownLight;
 
+	/**
+		bindFrameUniforms sends the light and camera as loose uniforms
+			to a program that doesn't declare the per-frame uniform block.
+
+			@param1 shader is the program to send them to. It must be bound.
+
+			@param2 light is the light the program is lit by.
+
+			@param3 ambient is the ambient light that goes with it.
+	*/
+	void bindFrameUniforms(aie::ShaderProgram& shader, const Light& light, const glm::vec3& ambient);
+
+	// Camera and lights shared by every program through one uniform buffer.
+	sns::FrameUniforms m_frameUniforms;
+
 
 	//----------Texture---------
 	aie::Texture m_gridTexture;
 
-	//----------OBJ-------------
-	// Creating an instance of a mesh for the Sould Spear to be loaded to.
-	aie::OBJMesh m_spearMesh;
-
-	// Creating a transform to store the location of the Soul Spear.
-	glm::mat4 m_spearTransform;
+	//------Scene Description---
+	// The file the scene is read from and what it is made of. Each of
+	//	its meshes is loaded once into its own OBJMesh, however many
+	//	objects place it. The meshes only placed in cells are the
+	//	streamer's, loaded and unloaded around the camera.
+	const char* m_sceneFile = "../scenes/sponza.json";
+
+	// With a collector to stream to, every frame the profiler finishes.
+	const char* m_telemetryAddress = nullptr;
+	sns::TelemetryStream m_telemetry;
+	sns::SceneDescription m_scene;
+	std::vector<std::unique_ptr<aie::OBJMesh>> m_sceneOBJMeshes;
+	sns::SceneStreamer m_sceneStreamer;
+
+
+	//------Instanced Meshes----
+	// Meshes placed many times, every copy drawn in one instanced draw.
+	aie::OBJMesh m_rockMesh;
+	aie::OBJMesh m_treeMesh;
+
+	// Where each copy of the rock and the tree is placed.
+	std::vector<glm::mat4> m_rockTransforms;
+	std::vector<glm::mat4> m_treeTransforms;
+
+	// The benchmark scene being drawn. The Stanford scans are only
+	//	loaded when a benchmark will draw them, and the particle
+	//	scene's emitters are added to the courtyard's.
+	sns::BenchmarkScene m_benchmarkScene = sns::BenchmarkScene::SPONZA;
+	bool m_loadStanford = false;
+	static const unsigned int STANFORD_SCAN_COUNT = 4;
+	aie::OBJMesh m_stanfordMeshes[STANFORD_SCAN_COUNT];
+
+	// Parses the scans into mapped memory, see setMappedScans.
+	bool m_mappedScans = false;
+	std::vector<glm::mat4> m_stanfordTransforms[STANFORD_SCAN_COUNT];
+
+	// Copies of a scan further from the camera than this are drawn as
+	//	its impostor, a card each, once it has been baked. Each view
+	//	splits the copies into the scratch lists again.
+	static constexpr float STANFORD_IMPOSTOR_DISTANCE = 1000.0f;
+	sns::Impostor m_stanfordImpostors[STANFORD_SCAN_COUNT];
+	aie::ShaderProgram m_impostorShader;
+	std::vector<glm::mat4> m_nearTransforms;
+	std::vector<glm::mat4> m_farTransforms;
+
+	// Every copy of the scans as one point cloud, drawn instead of their
+	//	meshes when m_stanfordPointsEnabled is on. It is built on a
+	//	job the first time F12 turns it on.
+	sns::PointCloud m_stanfordPoints;
+	sns::JobCounter m_stanfordPointsJob;
+	bool m_stanfordPointsLoading = false;
+	bool m_stanfordPointsEnabled = false;
+	std::vector<ParticleEmitter*> m_stressEmitters;
+
+	//------Scene---------------
+	/**
+		A mesh placed in the scene. Where it is goes into
+			m_sceneObjects when it is placed, so drawing it sends only
+			its index.
+	*/
+	struct SceneMesh
+	{
+		aie::OBJMesh* mesh;
 
-	//------Sponza Meshes-------
-	// Creating an instance of a mesh to store the Sponza Building Mesh.
-	aie::OBJMesh m_sponzaBuildingMesh;
+		// The LitFeature bits it is drawn with, normal mapped meshes are
+		//	the ones batched and deferred.
+		unsigned int features;
+		glm::mat4 transform;
 
-	// Creating a new transform matrix to store where the Sponza Building's position is.
-	glm::mat4 m_sponzaBuildingTransform;
+		// Its index in m_sceneObjects.
+		unsigned int object;
 
-	// Creating an instance of a mesh to store the Sponza Curtain Mesh.
-	aie::OBJMesh m_sponzaCurtainsMesh;
+		// Drawn by m_sceneBatch instead of the render queue.
+		bool batched;
 
-	// Creating a new transform matrix to store where the Sponza Curtain's position is.
-	glm::mat4 m_sponzaCurtainsTransform;
+		// Loaded and unloaded by m_sceneStreamer, so never batched, as
+		//	the batch keeps copies of what it draws.
+		bool streamed;
 
-	// Creating an instance of a mesh to store the Sponza Fountain Plants Mesh.
-	aie::OBJMesh m_sponzaFountainPlantsMesh;
+		// Large and solid enough to hide what is behind it.
+		bool occluder;
 
-	// Creating a new transform matrix to store where the Sponza Fountain Plants's position is.
-	glm::mat4 m_sponzaFountainPlantsTransform;
+		// Hung as cloth, so its vertices move and it is never batched.
+		bool cloth;
 
-	// Creating an instance of a mesh to store the Sponza Lion Heads Mesh.
-	aie::OBJMesh m_sponzaLionHeadsMesh;
+		// Cuts holes with its diffuse alpha, so its depth reads the texture
+		//	in the scene batch. Unbatched, each material's alpha map
+		//	decides instead.
+		bool alphaTested;
 
-	// Creating a new transform matrix to store where the Sponza Lion Head's position is.
-	glm::mat4 m_sponzaLionHeadsTransform;
+		// Blended by its materials' opacity through the transparency
+		//	target while order independent transparency is on, so never
+		//	batched.
+		bool transparent;
 
-	// Creating an instance of a mesh to store the Sponza Plants Mesh.
-	aie::OBJMesh m_sponzaPlantsMesh;
+		// Lit by its baked lightmap once m_lightmapper is done, so drawn
+		//	by the lit shaders, never batched or deferred.
+		bool lightmapped;
 
-	// Creating a new transform matrix to store where the Sponza Plants's position is.
-	glm::mat4 m_sponzaPlantsTransform;
+		// Its diffuse colour's texture in m_virtualTextures, or
+		//	NO_TEXTURE. Drawn by the lit shaders too, and into the
+		//	feedback pass.
+		unsigned int virtualTexture;
+	};
 
-	// Creating an instance of a mesh to store the Sponza Ribbons Mesh.
-	aie::OBJMesh m_sponzaRibbonsMesh;
+	// Every mesh drawn in the scene and where it is.
+	std::vector<SceneMesh> m_sceneMeshes;
 
-	// Creating a new transform matrix to store where the Sponza Ribbons's position is.
-	glm::mat4 m_sponzaRibbonsTransform;
+	// The scene meshes' matrices and bounds, read by lit.vert and
+	//	shadow.vert.
+	sns::ObjectBuffer m_sceneObjects;
 
-	// Creating an instance of a mesh to store the Sponza Floor Mesh.
-	aie::OBJMesh m_sponzaFloorMesh;
+	// Draws the normal mapped scene meshes with multi-draw indirect once
+	//	they have all loaded.
+	sns::MeshBatch m_sceneBatch;
 
-	// Creating a new transform matrix to store where the Sponza Floor's position is.
-	glm::mat4 m_sponzaFloorTransform;
+	// Each mesh hung as cloth that has loaded, with its simulation,
+	//	which is uncreated if the mesh couldn't be.
+	struct SceneCloth
+	{
+		const aie::OBJMesh* mesh;
+		std::unique_ptr<sns::ClothSimulation> simulation;
+	};
+	std::vector<SceneCloth> m_sceneCloths;
+
+	// Every chunk of the static scene in one bvh, built once it has all
+	//	loaded, with the scene mesh and chunk each primitive is. The
+	//	meshes the views can see are found from it each frame.
+	struct SceneChunk
+	{
+		unsigned int sceneMesh;
+		unsigned int chunk;
+	};
+	sns::Bvh m_sceneBvh;
+	std::vector<SceneChunk> m_sceneChunks;
+	std::vector<unsigned int> m_sceneBvhResults;
+	std::vector<unsigned char> m_visibleSceneMeshes;
+
+	// About how many scene meshes each submit job culls. Scenes of no
+	//	more are submitted on the main thread.
+	static const unsigned int SUBMIT_JOB_MESHES = 64;
+
+	// The scene meshes ordered so those placing the same OBJMesh are
+	//	next to each other, and where each run of them starts, with the
+	//	end last. A mesh culls into scratch of its own, so one job
+	//	submits all of a run.
+	std::vector<unsigned int> m_sceneMeshOrder;
+	std::vector<unsigned int> m_sceneMeshRuns;
+
+	// The programs each scene mesh is submitted with, one for each
+	//	material variant, found before the jobs start as finding
+	//	one may compile it.
+	std::vector<aie::ShaderProgram*> m_sceneMeshShaders;
+
+	// The list each submit job fills.
+	std::vector<sns::RenderQueue> m_submitLists;
+
+	// What F6 last picked, outlined every frame after.
+	PickResult m_pick;
+	bool m_hasPick = false;
+
+	// The depth of the scene's occluders, which the scene batch culls
+	//	meshlets against, and the program they are drawn into it with.
+	sns::HiZBuffer m_hiZ;
+	aie::ShaderProgram m_depthBatchedShader;
+
+	// Tests the large chunks of the unbatched scene's first view with
+	//	occlusion queries, skipping those last found hidden, when
+	//	m_occlusionQueriesEnabled is on.
+	sns::OcclusionQueries m_occlusionQueries;
+	bool m_occlusionQueriesEnabled = false;
+
+	// Rasterises the occluder scene meshes on the cpu, leaving chunks of
+	//	the unbatched scene they hide out of the first view as they are
+	//	submitted, when m_softwareOcclusionEnabled is on.
+	sns::SoftwareOcclusion m_softwareOcclusion;
+	bool m_softwareOcclusionEnabled = false;
+
+	// The scene's point and spot lights, binned each frame into the
+	//	clusters of the camera's view the normal map shaders loop over.
+	sns::LightClusters m_lightClusters;
+
+	// Bins the lights beside the shadow passes, for a single view. The
+	//	ticket of this frame's binning, 0 when it is binned in renderView.
+	sns::AsyncCompute m_asyncCompute;
+	unsigned long long m_asyncClusters = 0;
+
+	// Streams the pages of the scene meshes' virtual textures the first
+	//	view's feedback pass asks for, created if any mesh has one.
+	sns::VirtualTextureCache m_virtualTextures;
+
+	// The textures of the scene's decals, which are binned into the
+	//	clusters with the lights.
+	sns::DecalAtlas m_decalAtlas;
+
+	// Lights the air in froxels of the clusters' grid, which every
+	//	shaded pass fogs its fragments through while it is enabled.
+	sns::VolumetricFog m_volumetricFog;
+
+	// Draws the atmosphere behind the scene, lit by the sun, where the
+	//	clear colour was left.
+	sns::Sky m_sky;
+
+	// Draws the normal mapped scene into a g-buffer with these programs
+	//	and lights it a tile at a time, when m_deferredShading is on.
+	sns::DeferredRenderer m_deferred;
+
+	// Reflects the lit g-buffer in its glossy surfaces, between its
+	//	light and present.
+	sns::ScreenSpaceReflections m_reflections;
+	aie::ShaderProgram m_gBufferShader;
+	aie::ShaderProgram m_gBufferBatchedShader;
+	bool m_deferredShading = false;
+
+	// How many items the render queue drew this frame, over every execute.
+	unsigned int m_renderQueueItems = 0;
+
+	// The programs forward shading's depth pre-pass draws the normal
+	//	mapped scene with, when m_depthPrepass is on. They share the
+	//	normal map vertex shaders, so the shading matches their depth
+	//	exactly, and the alpha tested ones cut the same holes.
+	aie::ShaderProgram m_depthPrepassShader;
+	aie::ShaderProgram m_depthPrepassAlphaShader;
+	aie::ShaderProgram m_depthPrepassBatchedShader;
+	aie::ShaderProgram m_depthPrepassBatchedAlphaShader;
+	bool m_depthPrepass = false;
+
+	// The scene batch's programs for drawing its meshlets through the
+	//	task and mesh stages instead, when the driver has NV_mesh_shader
+	//	and m_meshShading is on. The pre-pass draws through the same
+	//	mesh shader as the shading, so their depth matches too.
+	aie::ShaderProgram m_normalMapMeshShader;
+	aie::ShaderProgram m_depthPrepassMeshShader;
+	aie::ShaderProgram m_depthPrepassMeshAlphaShader;
+	bool m_meshShading = true;
+
+	// Occludes the ambient light from the pre-pass's depth, when
+	//	m_ambientOcclusionEnabled is on. It only draws with the pre-pass
+	//	and a single view, as the particle target does.
+	sns::AmbientOcclusion m_ambientOcclusion;
+	bool m_ambientOcclusionEnabled = false;
+
+	// Counts the fragments the normal mapped scene shades, for overdraw.
+	sns::FragmentCounter m_shadedFragments;
+
+	// The shadows of m_light, with the programs the loose scene meshes,
+	//	the instanced meshes and the scene batch are drawn into them by.
+	//	Their cached static casters are drawn again when anything loads.
+	sns::ShadowCascades m_shadowCascades;
+	unsigned int m_shadowResolution = sns::ShadowCascades::DEFAULT_RESOLUTION;
+
+	// The point and spot lights' shadows, drawn with the same programs,
+	//	and the spheres around the casters that moved this frame.
+	sns::ShadowAtlas m_shadowAtlas;
+	std::vector<glm::vec4> m_movedShadowCasters;
+
+	// The static scene meshes as the lightmaps and probes trace them,
+	//	the sun and sky baked into the lightmapped ones, and the probes
+	//	lighting the characters and crowds.
+	sns::TraceScene m_traceScene;
+	sns::Lightmapper m_lightmapper;
+	sns::ProbeVolume m_probeVolume;
+	aie::ShaderProgram m_shadowShader;
+	aie::ShaderProgram m_shadowInstancedShader;
+	aie::ShaderProgram m_shadowBatchedShader;
+	aie::ShaderProgram m_crowdShadowShader;
+
+	// Plays the scene description's skinned characters and skins them
+	//	once a frame, before the shadows, for every pass to draw.
+	sns::Animator m_animator;
+
+	// The scene description's terrain, when it has one, drawn forward
+	//	after the render queue in every view.
+	sns::Terrain m_terrain;
+
+	// The scene description's ocean, when it has one, its waves moved on
+	//	once a frame and drawn forward after the terrain in every view.
+	sns::Ocean m_ocean;
+
+	// The scene description's crowds, each a clip baked once and played
+	//	by thousands of copies, drawn after the characters in every view
+	//	and into every cascade.
+	std::vector<std::unique_ptr<sns::Crowd>> m_crowds;
+
+	// The scene description's foliage layers, standing on the terrain
+	//	when there is one, culled and drawn forward after it.
+	sns::Foliage m_foliage;
+
+	// Bakes the foliage's and the Stanford scans' impostors once their
+	//	meshes have loaded.
+	sns::ImpostorBaker m_impostorBaker;
+
+	// Sorts the frame's draws to keep state changes to a minimum, a
+	//	queue for each pass over the unbatched scene. Each is submitted
+	//	once a frame and drawn by every view.
+	enum ScenePass
+	{
+		SCENE_PASS_DEPTH,
+		SCENE_PASS_SHADED,
+		SCENE_PASS_OTHERS,
+		SCENE_PASS_TRANSPARENT,
+		SCENE_PASS_COUNT
+	};
+	sns::RenderQueue m_sceneQueues[SCENE_PASS_COUNT];
+
+	//------Planets-------
+	// The planets and moons, as entities with their components.
+	sns::EntityRegistry m_entities;
+
+	// Draws the ground of the planets and moons instead of their gizmo
+	//	spheres, when it could be created. They are lit by the sun.
+	sns::PlanetRenderer m_planetRenderer;
+	sns::Entity m_sunEntity = 0;
+
+	// Ribbons behind the planets and moons, not the rocks, a point every
+	//	so often and the front one moved every frame in between.
+	sns::TrailRenderer m_planetTrails;
+	std::vector<sns::Entity> m_trailPlanets;
+	std::vector<glm::vec4> m_trailPoints;
+	float m_trailTime = 0.0f;
+	float m_trailTimer = 0.0f;
+
+
+	//------Asset Loading-------
+	// Loads the meshes and textures on worker threads. This is declared
+	//	after the meshes so that it is destroyed first, and no worker is
+	//	still writing into a mesh that has been destroyed.
+	sns::AssetLoader m_assetLoader;
 };
 
@@ -0,0 +1,422 @@
+/**
+	AssetLoader.cpp
+
+	Purpose: AssetLoader.cpp is the source file for the AssetLoader class.
+			The AssetLoader loads meshes and textures in the background
+			and queues the OpenGL uploads back to the context thread.
+
+	@author Nathan Nette
+*/
+#include "AssetLoader.h"
+#include "Input.h"
+#include "OBJMesh.h"
+#include "StartupTimeline.h"
+#include "Texture.h"
+#include "TextureCache.h"
+#include "VertexArrays.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace sns
+{
+	/**
+		The constructor starts the worker threads.
+
+			@param1 a_threadCount is the amount of worker threads.
+	*/
+	AssetLoader::AssetLoader(unsigned int a_threadCount)
+		: m_pendingCount(0),
+		m_uploadThreadStarted(false),
+		m_pool(a_threadCount)
+	{
+	}
+
+	/**
+		The deconstructor stops the workers. Anything still loading
+			is abandoned.
+	*/
+	AssetLoader::~AssetLoader()
+	{
+	}
+
+	/**
+		startUploadThread has meshes' buffers made and filled on an
+			UploadThread of their own from then on.
+
+			@param1 a_window is the window whose context is shared.
+
+			@return false without GL 4.5 or a shared context.
+	*/
+	bool AssetLoader::startUploadThread(GLFWwindow* a_window)
+	{
+		// The buffers are only shared by handle, see
+		//	aie::OBJMesh::uploadBuffers. Meshes may already be importing,
+		//	they only see the thread once it has started.
+		bool started = VertexArrays::isSupported() && m_uploadThread.create(a_window);
+		m_uploadThreadStarted.store(started, std::memory_order_release);
+		return started;
+	}
+
+	/**
+		loadMesh imports an OBJ on a worker thread then queues its upload.
+
+			@param1 a_mesh is the mesh to load into.
+
+			@param2 a_filename is the path of the OBJ.
+
+			@param3 a_loadTextures loads the material textures as well.
+
+			@param4 a_flipTextureV flips the V texture coordinate.
+
+			@return a handle to check on the request.
+	*/
+	AssetHandle AssetLoader::loadMesh(aie::OBJMesh* a_mesh, const char* a_filename,
+		bool a_loadTextures, bool a_flipTextureV)
+	{
+		auto promise = std::make_shared<std::promise<bool>>();
+		AssetHandle handle(promise->get_future().share());
+		std::string filename = a_filename;
+
+		// Meshes asked for while starting up are on its timeline.
+		StartupTimeline& timeline = StartupTimeline::instance();
+		double requested = timeline.isRecording() ? timeline.now() : -1.0;
+
+		++m_pendingCount;
+		m_pool.enqueue([this, a_mesh, filename, a_loadTextures, a_flipTextureV, promise, requested]()
+		{
+			importMesh(a_mesh, filename, a_loadTextures, a_flipTextureV, promise, requested);
+		});
+		return handle;
+	}
+
+	/**
+		loadMappedMesh parses an OBJ straight into a mapped buffer on the
+			upload thread, see aie::OBJMesh::importMapped, then queues
+			the rest of its upload. An OBJ that can't be read that way,
+			or any OBJ without the upload thread, is loaded by loadMesh
+			instead.
+
+			@param1 a_mesh is the mesh to load into.
+
+			@param2 a_filename is the path of the OBJ.
+
+			@param3 a_flipTextureV flips the V texture coordinate.
+
+			@return a handle to check on the request.
+	*/
+	AssetHandle AssetLoader::loadMappedMesh(aie::OBJMesh* a_mesh, const char* a_filename, bool a_flipTextureV)
+	{
+		if (m_uploadThreadStarted.load(std::memory_order_acquire) == false)
+			return loadMesh(a_mesh, a_filename, false, a_flipTextureV);
+
+		auto promise = std::make_shared<std::promise<bool>>();
+		AssetHandle handle(promise->get_future().share());
+		std::string filename = a_filename;
+
+		StartupTimeline& timeline = StartupTimeline::instance();
+		double requested = timeline.isRecording() ? timeline.now() : -1.0;
+
+		// When the parse finished, or -1 if the OBJ has to be imported.
+		//	Only read once the upload thread's work is done.
+		auto imported = std::make_shared<double>(-1.0);
+
+		++m_pendingCount;
+		m_uploadThread.queue([a_mesh, filename, a_flipTextureV, imported]()
+		{
+			if (a_mesh->importMapped(filename.c_str(), a_flipTextureV))
+				*imported = StartupTimeline::instance().now();
+		},
+		[this, a_mesh, filename, a_flipTextureV, promise, requested, imported]()
+		{
+			if (*imported < 0.0)
+			{
+				m_pool.enqueue([this, a_mesh, filename, a_flipTextureV, promise, requested]()
+				{
+					importMesh(a_mesh, filename, false, a_flipTextureV, promise, requested);
+				});
+				return;
+			}
+
+			promise->set_value(a_mesh->upload(&m_textureUploader));
+			--m_pendingCount;
+			if (requested >= 0.0)
+			{
+				StartupTimeline& timeline = StartupTimeline::instance();
+				timeline.addAsset(filename, requested, *imported, timeline.now());
+			}
+		});
+		return handle;
+	}
+
+	/**
+		importMesh imports an OBJ, on a worker thread, then queues its
+			upload and resolves the request once that has run.
+
+			@param1 a_mesh is the mesh to load into.
+
+			@param2 a_filename is the path of the OBJ.
+
+			@param3 a_loadTextures loads the material textures as well.
+
+			@param4 a_flipTextureV flips the V texture coordinate.
+
+			@param5 a_promise is the request's, given whether it loaded.
+
+			@param6 a_requested is when the startup timeline was asked for
+					it, or -1 if it isn't on it.
+	*/
+	void AssetLoader::importMesh(aie::OBJMesh* a_mesh, const std::string& a_filename, bool a_loadTextures,
+		bool a_flipTextureV, std::shared_ptr<std::promise<bool>> a_promise, double a_requested)
+	{
+		// Parse, generate tangents and decode textures off the GL thread.
+		if (a_mesh->import(a_filename.c_str(), a_loadTextures, a_flipTextureV) == false)
+		{
+			printf("Failed to load mesh %s\n", a_filename.c_str());
+			a_promise->set_value(false);
+			--m_pendingCount;
+			return;
+		}
+		double imported = StartupTimeline::instance().now();
+
+		// The textures follow through the uploader. With the upload
+		//	thread the buffers are made there, and the rest of the
+		//	upload waits for the GPU to have them.
+		std::string filename = a_filename;
+		auto upload = [this, a_mesh, a_promise, filename, a_requested, imported]()
+		{
+			a_promise->set_value(a_mesh->upload(&m_textureUploader));
+			--m_pendingCount;
+			if (a_requested >= 0.0)
+			{
+				StartupTimeline& timeline = StartupTimeline::instance();
+				timeline.addAsset(filename, a_requested, imported, timeline.now());
+			}
+		};
+		if (m_uploadThreadStarted.load(std::memory_order_acquire))
+			m_uploadThread.queue([a_mesh]() { a_mesh->uploadBuffers(); }, upload);
+		else
+			queueUpload(upload);
+	}
+
+	/**
+		loadTexture decodes an image on a worker thread then queues its upload.
+
+			@param1 a_texture is the texture to load into.
+
+			@param2 a_filename is the path of the image.
+
+			@return a handle to check on the request.
+	*/
+	AssetHandle AssetLoader::loadTexture(aie::Texture* a_texture, const char* a_filename)
+	{
+		auto promise = std::make_shared<std::promise<bool>>();
+		AssetHandle handle(promise->get_future().share());
+		std::string filename = a_filename;
+
+		++m_pendingCount;
+		m_pool.enqueue([this, a_texture, filename, promise]()
+		{
+			if (a_texture->decode(filename.c_str()) == false)
+			{
+				printf("Failed to load texture %s\n", filename.c_str());
+				promise->set_value(false);
+				--m_pendingCount;
+				return;
+			}
+
+			// Ready once the uploader has put all of it in use.
+			queueUpload([this, a_texture, promise]()
+			{
+				m_textureUploader.queue(a_texture, [this, promise](bool uploaded)
+				{
+					promise->set_value(uploaded);
+					--m_pendingCount;
+				});
+			});
+		});
+		return handle;
+	}
+
+	/**
+		loadPlaceholder decodes the file a placeholder stands in for on a
+			worker thread, then has the placeholder adopt it and queues
+			its upload.
+
+			@param1 a_texture is the placeholder.
+
+			@return a handle to check on the request.
+	*/
+	AssetHandle AssetLoader::loadPlaceholder(const std::shared_ptr<aie::Texture>& a_texture)
+	{
+		if (a_texture == nullptr || a_texture->isPlaceholder() == false ||
+			m_placeholders.insert(a_texture.get()).second == false)
+		{
+			return AssetHandle();
+		}
+
+		auto promise = std::make_shared<std::promise<bool>>();
+		AssetHandle handle(promise->get_future().share());
+		std::shared_ptr<aie::Texture> texture = a_texture;
+		std::string filename = a_texture->getFilename();
+		aie::Texture::Content content = a_texture->getContent();
+
+		++m_pendingCount;
+		m_pool.enqueue([this, texture, filename, content, promise]()
+		{
+			// Decoded apart from the placeholder, which is still drawn.
+			std::shared_ptr<aie::Texture> decoded = std::make_shared<aie::Texture>();
+			decoded->setContent(content);
+			if (decoded->decode(filename.c_str()) == false)
+			{
+				printf("Failed to load texture %s\n", filename.c_str());
+				promise->set_value(false);
+				--m_pendingCount;
+				return;
+			}
+
+			queueUpload([this, texture, decoded, promise]()
+			{
+				if (texture->adopt(*decoded) == false)
+				{
+					promise->set_value(false);
+					--m_pendingCount;
+					return;
+				}
+				m_placeholders.erase(texture.get());
+				aie::TextureCache::instance().placeholderLoaded(texture.get());
+
+				// The uploader holds it by pointer, the callback keeps it
+				//	alive should every material let go of it first.
+				m_textureUploader.queue(texture.get(), [this, texture, promise](bool uploaded)
+				{
+					promise->set_value(uploaded);
+					--m_pendingCount;
+				});
+			});
+		});
+		return handle;
+	}
+
+	/**
+		reloadTexture decodes a texture's file again on a worker thread,
+			then has the texture adopt it and queues its upload.
+
+			@param1 a_texture is the texture.
+
+			@return a handle to check on the request.
+	*/
+	AssetHandle AssetLoader::reloadTexture(const std::shared_ptr<aie::Texture>& a_texture)
+	{
+		// Atlas pages are packed once, a texture there can't change size.
+		if (a_texture == nullptr || a_texture->isPlaceholder() || a_texture->isInAtlas() ||
+			m_placeholders.count(a_texture.get()) > 0)
+		{
+			return AssetHandle();
+		}
+
+		auto promise = std::make_shared<std::promise<bool>>();
+		AssetHandle handle(promise->get_future().share());
+		std::shared_ptr<aie::Texture> texture = a_texture;
+		std::string filename = a_texture->getFilename();
+		aie::Texture::Content content = a_texture->getContent();
+
+		++m_pendingCount;
+		m_pool.enqueue([this, texture, filename, content, promise]()
+		{
+			std::shared_ptr<aie::Texture> decoded = std::make_shared<aie::Texture>();
+			decoded->setContent(content);
+			if (decoded->decode(filename.c_str()) == false)
+			{
+				printf("Failed to reload texture %s\n", filename.c_str());
+				promise->set_value(false);
+				--m_pendingCount;
+				return;
+			}
+
+			queueUpload([this, texture, decoded, promise]()
+			{
+				// Still uploading the last time it changed.
+				if (texture->adopt(*decoded) == false)
+				{
+					promise->set_value(false);
+					--m_pendingCount;
+					return;
+				}
+
+				m_textureUploader.queue(texture.get(), [this, texture, promise](bool uploaded)
+				{
+					promise->set_value(uploaded);
+					--m_pendingCount;
+				});
+			});
+		});
+		return handle;
+	}
+
+	/**
+		processUploads runs queued GL uploads.
+
+			@param1 a_budgetSeconds is roughly how long to spend uploading.
+
+			@return the amount of uploads that were run.
+	*/
+	unsigned int AssetLoader::processUploads(double a_budgetSeconds)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		unsigned int count = 0;
+
+		for (;;)
+		{
+			std::function<void()> upload;
+			{
+				std::lock_guard<std::mutex> lock(m_uploadMutex);
+				if (m_uploads.empty())
+					break;
+				upload = std::move(m_uploads.front());
+				m_uploads.pop_front();
+			}
+
+			upload();
+			++count;
+
+			// Stop once the budget has been used up.
+			std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+			if (elapsed.count() >= a_budgetSeconds)
+				break;
+		}
+
+		// Meshes whose buffers the GPU has, then textures, which have
+		//	their own budget in bytes.
+		count += m_uploadThread.process();
+		count += m_textureUploader.process();
+		return count;
+	}
+
+	/**
+		waitAll blocks until every request has finished, running
+			uploads while it waits.
+	*/
+	void AssetLoader::waitAll()
+	{
+		while (getPendingCount() > 0)
+		{
+			if (processUploads(1.0) == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	/**
+		queueUpload adds a function to be run on the GL thread.
+	*/
+	void AssetLoader::queueUpload(std::function<void()> a_upload)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_uploadMutex);
+			m_uploads.push_back(std::move(a_upload));
+		}
+
+		// An idle main thread is waiting for input, give it the upload now.
+		Input::wake();
+	}
+}
@@ -0,0 +1,272 @@
+/**
+	AssetLoader.h
+
+	Purpose: AssetLoader.h is the header file for the AssetLoader class.
+			The AssetLoader loads meshes and textures in the background.
+			The slow CPU work (parsing, tangents, image decoding) runs on
+			worker threads, and only the final OpenGL upload is queued
+			back to the thread that owns the context.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "ThreadPool.h"
+#include "TextureUploader.h"
+#include "UploadThread.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+namespace aie
+{
+	class OBJMesh;
+	class Texture;
+}
+
+namespace sns
+{
+	/**
+		An AssetHandle is returned for every asset that is requested.
+			It can be used to check if the asset has finished loading
+			and whether it loaded successfully.
+	*/
+	class AssetHandle
+	{
+	public:
+		AssetHandle() {}
+		AssetHandle(std::shared_future<bool> a_future) : m_future(a_future) {}
+
+		/**
+			isValid returns whether this handle refers to a request.
+		*/
+		bool isValid() const { return m_future.valid(); }
+
+		/**
+			isReady returns true once the asset has been uploaded or has failed.
+		*/
+		bool isReady() const
+		{
+			return m_future.valid() &&
+				m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+		/**
+			succeeded returns true if the asset is ready and loaded without errors.
+		*/
+		bool succeeded() const { return isReady() && m_future.get(); }
+
+	private:
+
+		// Becomes ready when the asset has finished loading.
+		std::shared_future<bool> m_future;
+	};
+
+	/**
+		The AssetLoader class runs asset imports on a thread pool and
+			keeps a queue of uploads that must run on the GL thread.
+	*/
+	class AssetLoader
+	{
+	public:
+		/**
+			The constructor starts the worker threads.
+
+				@param1 a_threadCount is the amount of worker threads.
+						0 picks a count based on the amount of cores.
+		*/
+		AssetLoader(unsigned int a_threadCount = 0);
+
+		/**
+			The deconstructor stops the workers. Anything still loading
+				is abandoned.
+		*/
+		~AssetLoader();
+
+		/**
+			startUploadThread has meshes' buffers made and filled on an
+				UploadThread of their own from then on, so the context
+				thread only adopts them once the GPU has copied them.
+				Must be called on the main thread, before any mesh is
+				loaded.
+
+				@param1 a_window is the window whose context is shared.
+
+				@return false without GL 4.5 or a shared context, meshes
+						are then uploaded on the context thread.
+		*/
+		bool startUploadThread(GLFWwindow* a_window);
+
+		/**
+			stopUploadThread stops the upload thread, before GLFW is
+				terminated. Meshes whose buffers haven't been adopted
+				never finish loading.
+		*/
+		void stopUploadThread() { m_uploadThreadStarted = false; m_uploadThread.destroy(); }
+
+		/**
+			loadMesh imports an OBJ on a worker thread then queues its
+				upload. The mesh becomes drawable once the upload has run.
+
+				@param1 a_mesh is the mesh to load into. It must stay alive
+						until the handle is ready.
+
+				@param2 a_filename is the path of the OBJ.
+
+				@param3 a_loadTextures loads the material textures as well.
+
+				@param4 a_flipTextureV flips the V texture coordinate.
+
+				@return a handle to check on the request.
+		*/
+		AssetHandle loadMesh(aie::OBJMesh* a_mesh, const char* a_filename,
+			bool a_loadTextures = true, bool a_flipTextureV = false);
+
+		/**
+			loadMappedMesh parses an OBJ on the upload thread straight
+				into mapped GPU memory, without its textures, so big
+				scans never have their vertices in memory. OBJs that
+				can't be parsed that way, and every OBJ without the
+				upload thread, go through loadMesh instead.
+
+				@param1 a_mesh is the mesh to load into. It must stay alive
+						until the handle is ready.
+
+				@param2 a_filename is the path of the OBJ.
+
+				@param3 a_flipTextureV flips the V texture coordinate.
+
+				@return a handle to check on the request.
+		*/
+		AssetHandle loadMappedMesh(aie::OBJMesh* a_mesh, const char* a_filename, bool a_flipTextureV = false);
+
+		/**
+			loadTexture decodes an image on a worker thread then queues
+				its upload.
+
+				@param1 a_texture is the texture to load into. It must
+						stay alive until the handle is ready.
+
+				@param2 a_filename is the path of the image.
+
+				@return a handle to check on the request.
+		*/
+		AssetHandle loadTexture(aie::Texture* a_texture, const char* a_filename);
+
+		/**
+			loadPlaceholder decodes the file a placeholder stands in for
+				on a worker thread, see aie::Texture::setPlaceholder, then
+				has the placeholder adopt it and queues its upload. The
+				placeholder is drawn until then. Must be called on the GL
+				thread.
+
+				@param1 a_texture is the placeholder, kept alive until it
+						has loaded.
+
+				@return a handle to check on the request, an invalid one
+						if it isn't a placeholder or is already loading.
+						One that fails to decode stays a placeholder and
+						isn't tried again.
+		*/
+		AssetHandle loadPlaceholder(const std::shared_ptr<aie::Texture>& a_texture);
+
+		/**
+			reloadTexture decodes a texture's file again on a worker
+				thread, then has the texture adopt it and queues its
+				upload, as loadPlaceholder does. The old image is drawn
+				until the new one has uploaded. Must be called on the GL
+				thread.
+
+				@param1 a_texture is the texture, kept alive until it has
+						reloaded.
+
+				@return a handle to check on the request, an invalid one
+						for placeholders and textures in an atlas page.
+						One that fails to decode keeps its old image.
+		*/
+		AssetHandle reloadTexture(const std::shared_ptr<aie::Texture>& a_texture);
+
+		/**
+			setTextureUploadBudget sets how many bytes of texture data go
+				to the gpu each processUploads, set before the first.
+
+				@param1 a_bytes is the budget.
+		*/
+		void setTextureUploadBudget(unsigned int a_bytes) { m_textureUploader.setFrameBytes(a_bytes); }
+
+		/**
+			processUploads runs queued GL uploads. This must be called
+				on the thread that owns the GL context, usually once a frame.
+				Textures then go through the texture uploader, as much of
+				them as its budget allows.
+
+				@param1 a_budgetSeconds is roughly how long to spend uploading.
+						At least one upload runs every call so loading
+						always makes progress.
+
+				@return the amount of uploads that were run, and textures
+						finished.
+		*/
+		unsigned int processUploads(double a_budgetSeconds);
+
+		/**
+			waitAll blocks until every request has finished, running
+				uploads while it waits. Must be called on the GL thread.
+		*/
+		void waitAll();
+
+		/**
+			getPendingCount returns how many requests haven't finished,
+				and textures that are still uploading.
+		*/
+		unsigned int getPendingCount() const { return m_pendingCount + m_textureUploader.getPendingCount(); }
+
+		/**
+			getTextureUploader returns the uploader textures go through.
+		*/
+		const TextureUploader& getTextureUploader() const { return m_textureUploader; }
+
+	private:
+
+		/**
+			queueUpload adds a function to be run on the GL thread.
+		*/
+		void queueUpload(std::function<void()> a_upload);
+
+		/**
+			importMesh imports an OBJ on the calling worker, then queues
+				its upload and resolves its request.
+		*/
+		void importMesh(aie::OBJMesh* a_mesh, const std::string& a_filename, bool a_loadTextures,
+			bool a_flipTextureV, std::shared_ptr<std::promise<bool>> a_promise, double a_requested);
+
+		// Guards the upload queue.
+		std::mutex m_uploadMutex;
+
+		// Uploads waiting for the GL thread.
+		std::deque<std::function<void()>> m_uploads;
+
+		// Requests that haven't finished.
+		std::atomic<unsigned int> m_pendingCount;
+
+		// Placeholders loading, or that failed to. Only used on the GL
+		//	thread.
+		std::unordered_set<const aie::Texture*> m_placeholders;
+
+		// Copies decoded textures to the gpu a few megabytes a frame.
+		//	Only used on the GL thread.
+		TextureUploader m_textureUploader;
+
+		// Makes meshes' buffers, once started.
+		UploadThread m_uploadThread;
+
+		// Set once the upload thread has started, for the workers to
+		//	read without touching it before then.
+		std::atomic<bool> m_uploadThreadStarted;
+
+		// Worker threads for the CPU side of loading. Declared last so the
+		//	workers are stopped before the upload queue is destroyed.
+		ThreadPool m_pool;
+	};
+}
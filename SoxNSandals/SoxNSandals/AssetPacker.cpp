@@ -0,0 +1,281 @@
+/**
+	AssetPacker.cpp
+
+	Purpose: AssetPacker.cpp is the source file for the AssetPacker class.
+			The AssetPacker is an offline tool that packs asset files
+			into one archive for the FileSystem to mount.
+
+	@author Nathan Nette
+*/
+#include "AssetPacker.h"
+#include "FileSystem.h"
+#include "Lz4.h"
+#include "MappedFile.h"
+#include "OBJMesh.h"
+#include "SceneDescription.h"
+#include "TextureConverter.h"
+#include "tiny_obj_loader.h"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+namespace sns
+{
+	/**
+		hasObjExtension returns whether a path ends in ".obj", in any
+			case.
+	*/
+	static bool hasObjExtension(const std::string& a_filename)
+	{
+		if (a_filename.size() < 4)
+			return false;
+		std::string extension = a_filename.substr(a_filename.size() - 4);
+		for (char& c : extension)
+			c = (char)tolower((unsigned char)c);
+		return extension == ".obj";
+	}
+
+	/**
+		hasSceneExtension returns whether a path is a scene, ".json" or
+			".snsscene".
+	*/
+	static bool hasSceneExtension(const std::string& a_filename)
+	{
+		size_t dot = a_filename.find_last_of('.');
+		return dot != std::string::npos &&
+			(a_filename.compare(dot, std::string::npos, ".json") == 0 ||
+			a_filename.compare(dot, std::string::npos, ".snsscene") == 0);
+	}
+
+	/**
+		addIfExists adds a file to the list if it's on the disk.
+	*/
+	static void addIfExists(const std::string& a_filename, std::vector<std::string>& a_files)
+	{
+		unsigned long long size = 0;
+		long long modifiedTime = 0;
+		if (MappedFile::getFileStamp(a_filename.c_str(), size, modifiedTime))
+			a_files.push_back(a_filename);
+	}
+
+	/**
+		gatherFiles adds a file to a list to pack, and for an OBJ or a
+			scene everything it loads along with it.
+
+			@param1 a_filename is the path of the file.
+
+			@param2 a_files is the list it is added to.
+	*/
+	void AssetPacker::gatherFiles(const std::string& a_filename, std::vector<std::string>& a_files)
+	{
+		a_files.push_back(a_filename);
+
+		// A scene brings every mesh it places.
+		if (hasSceneExtension(a_filename))
+		{
+			SceneDescription scene;
+			if (scene.load(a_filename.c_str()))
+			{
+				for (const SceneDescription::Mesh& mesh : scene.getMeshes())
+					gatherFiles(mesh.filename, a_files);
+				for (const SceneDescription::Foliage& layer : scene.getFoliage())
+				{
+					gatherFiles(layer.filename, a_files);
+					if (layer.densityMap.empty() == false)
+						addIfExists(layer.densityMap, a_files);
+				}
+				if (scene.getTerrain().heightmap.empty() == false)
+					addIfExists(scene.getTerrain().heightmap, a_files);
+			}
+			return;
+		}
+
+		if (hasObjExtension(a_filename) == false)
+			return;
+
+		// Packed with the OBJ's stamp, so the cache is still used.
+		addIfExists(a_filename + aie::OBJMesh::getCacheExtension(), a_files);
+
+		MappedFile obj;
+		if (obj.open(a_filename.c_str()) == false)
+			return;
+
+		// The mtl files, one a line as ObjParser reads them.
+		std::string folder = a_filename.substr(0, a_filename.find_last_of('/') + 1);
+		std::vector<std::string> libraries;
+		const char* p = (const char*)obj.getData();
+		const char* end = p + obj.getSize();
+		while (p < end)
+		{
+			const char* lineEnd = p;
+			while (lineEnd < end && *lineEnd != '\n')
+				++lineEnd;
+
+			while (p < lineEnd && (*p == ' ' || *p == '\t'))
+				++p;
+			if (lineEnd - p > 7 && memcmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+			{
+				const char* first = p + 7;
+				const char* last = lineEnd;
+				while (first < last && (*first == ' ' || *first == '\t'))
+					++first;
+				while (last > first && isspace((unsigned char)last[-1]))
+					--last;
+				if (last > first)
+					libraries.push_back(std::string(first, last));
+			}
+			p = lineEnd + 1;
+		}
+
+		for (auto& library : libraries)
+		{
+			std::string path = folder + library;
+			MappedFile mtl;
+			if (mtl.open(path.c_str()) == false)
+			{
+				printf("AssetPacker: material file %s not found\n", path.c_str());
+				continue;
+			}
+			a_files.push_back(path);
+
+			std::vector<tinyobj::material_t> materials;
+			std::map<std::string, int> materialMap;
+			std::istringstream stream(std::string((const char*)mtl.getData(), mtl.getSize()));
+			tinyobj::LoadMtl(materialMap, materials, stream);
+
+			// Whichever of the image and its dds OBJMesh ends up loading.
+			for (auto& m : materials)
+			{
+				const std::string* names[] = { &m.alpha_texname, &m.ambient_texname, &m.diffuse_texname,
+					&m.specular_texname, &m.specular_highlight_texname, &m.bump_texname, &m.displacement_texname };
+				for (auto name : names)
+				{
+					if (name->empty())
+						continue;
+					std::string texture = folder + *name;
+					std::string compressed = TextureConverter::getCompressedName(texture);
+					addIfExists(texture, a_files);
+					if (compressed != texture)
+						addIfExists(compressed, a_files);
+				}
+			}
+		}
+	}
+
+	/**
+		pack writes an archive.
+
+			@param1 a_output is the path of the archive to write.
+
+			@param2 a_files are the paths of the files to pack.
+
+			@param3 a_compress is whether files can be compressed.
+
+			@return true if every file was packed.
+	*/
+	bool AssetPacker::pack(const char* a_output, const std::vector<std::string>& a_files, bool a_compress)
+	{
+		// The entries and names are laid out first, so only files that
+		//	are there, and not already packed, are kept.
+		std::unordered_set<std::string> packed;
+		std::vector<std::string> files;
+		std::vector<FileSystem::ArchiveEntry> entries;
+		std::string names;
+		unsigned int skipped = 0;
+		for (auto& filename : a_files)
+		{
+			std::string key = FileSystem::canonicalise(filename);
+			if (packed.insert(key).second == false)
+				continue;
+
+			FileSystem::ArchiveEntry entry = {};
+			if (MappedFile::getFileStamp(filename.c_str(), entry.size, entry.modifiedTime) == false || entry.size == 0)
+			{
+				printf("AssetPacker: skipping %s, it's missing or empty\n", filename.c_str());
+				++skipped;
+				continue;
+			}
+			entry.nameOffset = (unsigned int)names.size();
+			entry.nameLength = (unsigned int)key.size();
+			names += key;
+			files.push_back(filename);
+			entries.push_back(entry);
+		}
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_output, "wb");
+		if (file == nullptr)
+		{
+			printf("AssetPacker: can't write %s\n", a_output);
+			return false;
+		}
+
+		FileSystem::ArchiveHeader header = { FileSystem::ARCHIVE_MAGIC, FileSystem::ARCHIVE_VERSION,
+			(unsigned int)entries.size(), (unsigned int)names.size() };
+		fwrite(&header, sizeof(header), 1, file);
+		if (entries.empty() == false)
+			fwrite(entries.data(), sizeof(FileSystem::ArchiveEntry), entries.size(), file);
+		fwrite(names.data(), 1, names.size(), file);
+
+		// Each file starts aligned, after the padding following the last.
+		static const char padding[FileSystem::ARCHIVE_ALIGNMENT] = {};
+		unsigned long long offset = sizeof(header) + entries.size() * sizeof(FileSystem::ArchiveEntry) + names.size();
+		unsigned long long totalSize = 0;
+		std::vector<unsigned char> compressed;
+		bool success = true;
+		for (size_t i = 0; i < files.size(); ++i)
+		{
+			unsigned long long aligned = (offset + FileSystem::ARCHIVE_ALIGNMENT - 1) & ~(unsigned long long)(FileSystem::ARCHIVE_ALIGNMENT - 1);
+			fwrite(padding, 1, (size_t)(aligned - offset), file);
+			offset = aligned;
+
+			MappedFile input;
+			if (input.open(files[i].c_str()) == false || input.getSize() != entries[i].size)
+			{
+				printf("AssetPacker: %s changed while packing\n", files[i].c_str());
+				success = false;
+				break;
+			}
+
+			// Only kept when it saves enough to be worth decompressing.
+			const unsigned char* data = input.getData();
+			size_t size = input.getSize();
+			entries[i].compressed = 0;
+			if (a_compress)
+			{
+				Lz4::compress(data, size, compressed);
+				if (compressed.size() + size / 8 <= size)
+				{
+					data = compressed.data();
+					size = compressed.size();
+					entries[i].compressed = 1;
+				}
+			}
+			entries[i].offset = offset;
+			entries[i].storedSize = size;
+			fwrite(data, 1, size, file);
+			offset += size;
+			totalSize += entries[i].size;
+		}
+
+		// Now that every offset is known.
+		fseek(file, sizeof(header), SEEK_SET);
+		if (entries.empty() == false)
+			fwrite(entries.data(), sizeof(FileSystem::ArchiveEntry), entries.size(), file);
+		success = success && ferror(file) == 0;
+		fclose(file);
+
+		if (success == false)
+		{
+			remove(a_output);
+			printf("AssetPacker: %s wasn't written\n", a_output);
+			return false;
+		}
+		printf("Packed %u files, %.1f MB, into %s, %.1f MB\n", (unsigned int)files.size(),
+			totalSize / (1024.0 * 1024.0), a_output, offset / (1024.0 * 1024.0));
+		return skipped == 0;
+	}
+}
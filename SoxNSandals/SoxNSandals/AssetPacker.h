@@ -0,0 +1,54 @@
+/**
+	AssetPacker.h
+
+	Purpose: AssetPacker.h is the header file for the AssetPacker class.
+			The AssetPacker is an offline tool that packs asset files
+			into one archive for the FileSystem to mount, so a run opens
+			one file instead of hundreds.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The AssetPacker class writes archives in the FileSystem's layout.
+			Each file is compressed as an LZ4 block when that saves an
+			eighth of it or more, images that are already compressed are
+			mostly stored as they are.
+	*/
+	class AssetPacker
+	{
+	public:
+		/**
+			gatherFiles adds a file to a list to pack. An OBJ brings its
+				mesh cache, its mtl files and every texture they name,
+				with the dds made by the TextureConverter for each one
+				that has it. A scene brings every mesh it places.
+
+				@param1 a_filename is the path of the file.
+
+				@param2 a_files is the list it is added to.
+		*/
+		static void gatherFiles(const std::string& a_filename, std::vector<std::string>& a_files);
+
+		/**
+			pack writes an archive.
+
+				@param1 a_output is the path of the archive to write.
+
+				@param2 a_files are the paths of the files to pack, as they
+						will be opened at run time. Paths that are the same
+						once canonicalised are only packed once.
+
+				@param3 a_compress is whether files can be compressed.
+
+				@return true if every file was packed. Missing ones are
+						left out of an archive that is still written.
+		*/
+		static bool pack(const char* a_output, const std::vector<std::string>& a_files, bool a_compress);
+	};
+}
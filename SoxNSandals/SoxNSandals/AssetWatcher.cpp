@@ -0,0 +1,273 @@
+/**
+	AssetWatcher.cpp
+
+	Purpose: AssetWatcher.cpp is the source file for the AssetWatcher
+			class. The AssetWatcher loads meshes and textures again when
+			their files change while the application runs, so models and
+			images can be tuned without restarting.
+
+	@author Nathan Nette
+*/
+#include "AssetWatcher.h"
+#include "MappedFile.h"
+#include "OBJMesh.h"
+#include "TextureCache.h"
+#include <chrono>
+#include <cstdio>
+
+namespace sns
+{
+	/**
+		The deconstructor stops the thread. A mesh still loading to replace
+			another is left to the loader, which may yet write to it.
+	*/
+	AssetWatcher::~AssetWatcher()
+	{
+		stop();
+	}
+
+	/**
+		watch adds a mesh, before start.
+
+			@param1 a_mesh is the mesh.
+
+			@param2 a_filename is the OBJ it is loaded from.
+
+			@param3 a_loadTextures is whether it loads its textures.
+
+			@param4 a_flipTextureV is whether it flips the V texture
+					coordinate.
+
+			@param5 a_onReload is called after it is replaced.
+	*/
+	void AssetWatcher::watch(aie::OBJMesh& a_mesh, const char* a_filename, bool a_loadTextures,
+		bool a_flipTextureV, ReloadFunction a_onReload)
+	{
+		Mesh mesh;
+		mesh.mesh = &a_mesh;
+		mesh.filename = a_filename;
+		mesh.loadTextures = a_loadTextures;
+		mesh.flipTextureV = a_flipTextureV;
+		mesh.onReload = a_onReload;
+		mesh.stamp = { 0, 0 };
+		mesh.changed = false;
+		mesh.replacement = nullptr;
+		checkStamp(mesh.filename, mesh.stamp);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_meshes.push_back(std::move(mesh));
+	}
+
+	/**
+		start starts checking the files.
+	*/
+	void AssetWatcher::start()
+	{
+		if (m_thread.joinable())
+			return;
+
+		m_stopping = false;
+		m_thread = std::thread(&AssetWatcher::run, this);
+	}
+
+	/**
+		stop stops checking the files and waits for the thread.
+	*/
+	void AssetWatcher::stop()
+	{
+		if (m_thread.joinable() == false)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_stopCondition.notify_all();
+		m_thread.join();
+	}
+
+	/**
+		update starts loading every asset with a changed file, and replaces
+			those that have finished. It must be called on the gl context
+			thread, once a frame.
+
+			@param1 a_loader is the loader the assets load through.
+
+			@return how many assets were replaced.
+	*/
+	unsigned int AssetWatcher::update(AssetLoader& a_loader)
+	{
+		std::vector<Mesh*> changedMeshes;
+		std::vector<std::string> changedTextures;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (Mesh& mesh : m_meshes)
+			{
+				// One still loading, the first time or again, is started
+				//	once it has finished.
+				if (mesh.changed && mesh.replacement == nullptr && mesh.mesh->isLoaded())
+				{
+					changedMeshes.push_back(&mesh);
+					mesh.changed = false;
+				}
+			}
+			changedTextures.swap(m_changedTextures);
+		}
+
+		// Meshes are only added before start, so they stay valid unlocked.
+		for (Mesh* mesh : changedMeshes)
+		{
+			aie::OBJMesh* replacement = new aie::OBJMesh();
+			replacement->setPickable(mesh->mesh->isPickable());
+			replacement->setEmissionSurface(mesh->mesh->hasEmissionSurface());
+			replacement->setMergeMaterials(mesh->mesh->isMergingMaterials());
+			replacement->setLazyTextures(mesh->mesh->hasLazyTextures());
+			replacement->setPackScalarMaps(mesh->mesh->isPackingScalarMaps());
+			replacement->setAtlasTextures(mesh->mesh->isAtlasingTextures());
+			mesh->replacement = replacement;
+			mesh->handle = a_loader.loadMesh(replacement, mesh->filename.c_str(), mesh->loadTextures,
+				mesh->flipTextureV);
+		}
+
+		for (auto& filename : changedTextures)
+		{
+			// Saved again while it decodes, it is decoded again after.
+			bool reloading = false;
+			for (auto& reload : m_textureReloads)
+				reloading = reloading || reload.filename == filename;
+			if (reloading)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_changedTextures.push_back(filename);
+				continue;
+			}
+
+			// Only held here, the loader keeps it alive while it reloads.
+			AssetHandle handle = a_loader.reloadTexture(aie::TextureCache::instance().find(filename));
+			if (handle.isValid())
+				m_textureReloads.push_back({ filename, handle });
+		}
+
+		unsigned int replaced = 0;
+		for (Mesh& mesh : m_meshes)
+		{
+			if (mesh.replacement == nullptr || mesh.handle.isReady() == false)
+				continue;
+
+			if (mesh.handle.succeeded())
+			{
+				// The old chunks are deleted here, between frames, and the
+				//	mesh is drawn whole from its new ones.
+				*mesh.mesh = std::move(*mesh.replacement);
+				printf("Reloaded %s\n", mesh.filename.c_str());
+				if (mesh.onReload)
+					mesh.onReload();
+				++replaced;
+			}
+			else
+			{
+				printf("Asset Error: %s kept its last mesh.\n", mesh.filename.c_str());
+			}
+			delete mesh.replacement;
+			mesh.replacement = nullptr;
+			mesh.handle = AssetHandle();
+		}
+
+		unsigned int texturesReplaced = 0;
+		for (unsigned int i = 0; i < (unsigned int)m_textureReloads.size();)
+		{
+			TextureReload& reload = m_textureReloads[i];
+			if (reload.handle.isReady() == false)
+			{
+				++i;
+				continue;
+			}
+
+			if (reload.handle.succeeded())
+			{
+				printf("Reloaded %s\n", reload.filename.c_str());
+				++texturesReplaced;
+			}
+			else
+			{
+				printf("Asset Error: %s kept its last image.\n", reload.filename.c_str());
+			}
+			m_textureReloads[i] = m_textureReloads.back();
+			m_textureReloads.pop_back();
+		}
+		if (texturesReplaced > 0 && m_onTextureReload)
+			m_onTextureReload();
+
+		return replaced + texturesReplaced;
+	}
+
+	/**
+		checkStamp updates a file's stamp.
+
+			@param1 a_filename is the file.
+
+			@param2 a_stamp is its stamp as of the last check.
+
+			@return whether it changed.
+	*/
+	bool AssetWatcher::checkStamp(const std::string& a_filename, Stamp& a_stamp)
+	{
+		unsigned long long size = 0;
+		long long modifiedTime = 0;
+		if (MappedFile::getFileStamp(a_filename.c_str(), size, modifiedTime) == false)
+			return false;
+
+		bool changed = size != a_stamp.size || modifiedTime != a_stamp.modifiedTime;
+		a_stamp.size = size;
+		a_stamp.modifiedTime = modifiedTime;
+		return changed;
+	}
+
+	/**
+		run checks every mesh's file, and every cached texture's, until
+			stopped, marking those that changed.
+	*/
+	void AssetWatcher::run()
+	{
+		std::vector<std::string> textureFiles;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_stopping == false)
+		{
+			for (Mesh& mesh : m_meshes)
+			{
+				if (checkStamp(mesh.filename, mesh.stamp))
+					mesh.changed = true;
+			}
+
+			// The cache is listed unlocked, so the texture cache's lock is
+			//	never taken inside this one's.
+			lock.unlock();
+			aie::TextureCache::instance().getFilenames(textureFiles);
+			lock.lock();
+
+			// Textures since released are forgotten, and those new since
+			//	the last check are stamped without counting as changed.
+			std::unordered_map<std::string, Stamp> stamps;
+			for (auto& filename : textureFiles)
+			{
+				auto found = m_textureStamps.find(filename);
+				if (found == m_textureStamps.end())
+				{
+					Stamp stamp = { 0, 0 };
+					checkStamp(filename, stamp);
+					stamps.emplace(filename, stamp);
+					continue;
+				}
+
+				Stamp stamp = found->second;
+				if (checkStamp(filename, stamp))
+					m_changedTextures.push_back(filename);
+				stamps.emplace(filename, stamp);
+			}
+			m_textureStamps.swap(stamps);
+
+			m_stopCondition.wait_for(lock, std::chrono::milliseconds(POLL_MILLISECONDS),
+				[this]() { return m_stopping; });
+		}
+	}
+}
@@ -0,0 +1,172 @@
+/**
+	AssetWatcher.h
+
+	Purpose: AssetWatcher.h is the header file for the AssetWatcher
+			class. The AssetWatcher loads meshes and textures again when
+			their files change while the application runs, so models and
+			images can be tuned without restarting.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "AssetLoader.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	/**
+		The AssetWatcher class keeps the file of every mesh it is given,
+			and of every texture alive in the texture cache, and a thread
+			checks their modified times a couple of times a second.
+
+		A changed mesh is loaded again through the AssetLoader into a mesh
+			of its own, on the workers like any other, while the old one
+			still draws. update moves the new mesh into the old once it
+			has uploaded, at the start of a frame, so nothing ever draws
+			half of either. Its textures come through the texture cache,
+			so only those that changed are decoded again.
+
+		A changed texture is decoded again on the workers and adopted by
+			the texture everyone shares, see AssetLoader::reloadTexture.
+
+		Only the files themselves are watched. A mesh's material library
+			isn't, and textures packed into an atlas page aren't
+			reloaded.
+	*/
+	class AssetWatcher
+	{
+	public:
+		typedef std::function<void()> ReloadFunction;
+
+		// How long the thread sleeps between checks, in milliseconds.
+		static const unsigned int POLL_MILLISECONDS = 500;
+
+		AssetWatcher() = default;
+
+		/**
+			The deconstructor stops the thread.
+		*/
+		~AssetWatcher();
+
+		AssetWatcher(const AssetWatcher&) = delete;
+		AssetWatcher& operator=(const AssetWatcher&) = delete;
+
+		/**
+			watch adds a mesh, before start, loaded or still loading. The
+				mesh must outlive the watcher.
+
+				@param1 a_mesh is the mesh.
+
+				@param2 a_filename is the OBJ it is loaded from.
+
+				@param3 a_loadTextures is whether it loads its textures.
+
+				@param4 a_flipTextureV is whether it flips the V texture
+						coordinate.
+
+				@param5 a_onReload is called after it is replaced, to
+						rebuild anything built over it.
+		*/
+		void watch(aie::OBJMesh& a_mesh, const char* a_filename, bool a_loadTextures = true,
+			bool a_flipTextureV = false, ReloadFunction a_onReload = ReloadFunction());
+
+		/**
+			setOnTextureReload sets what is called after textures reload,
+				once for every frame where any did.
+
+				@param1 a_onReload is the function.
+		*/
+		void setOnTextureReload(ReloadFunction a_onReload) { m_onTextureReload = a_onReload; }
+
+		/**
+			start starts checking the files.
+		*/
+		void start();
+
+		/**
+			stop stops checking the files and waits for the thread.
+		*/
+		void stop();
+
+		/**
+			update starts loading every asset with a changed file, and
+				replaces those that have finished. It must be called on
+				the gl context thread, once a frame.
+
+				@param1 a_loader is the loader the assets load through.
+
+				@return how many assets were replaced.
+		*/
+		unsigned int update(AssetLoader& a_loader);
+
+	private:
+		/**
+			The size and time a file had last check.
+		*/
+		struct Stamp
+		{
+			unsigned long long size;
+			long long modifiedTime;
+		};
+
+		/**
+			A watched mesh.
+		*/
+		struct Mesh
+		{
+			aie::OBJMesh* mesh;
+			std::string filename;
+			bool loadTextures;
+			bool flipTextureV;
+			ReloadFunction onReload;
+			Stamp stamp;
+			bool changed;
+
+			// The mesh loading to replace it, and its request. Only used
+			//	on the gl thread.
+			aie::OBJMesh* replacement;
+			AssetHandle handle;
+		};
+
+		/**
+			A texture decoding again.
+		*/
+		struct TextureReload
+		{
+			std::string filename;
+			AssetHandle handle;
+		};
+
+		// Updates a stamp, returning whether the file changed. Files that
+		//	can't be read, such as those in archives, never change.
+		static bool checkStamp(const std::string& a_filename, Stamp& a_stamp);
+
+		// The thread, checking the files until stopped.
+		void run();
+
+		std::vector<Mesh> m_meshes;
+		std::vector<TextureReload> m_textureReloads;
+		ReloadFunction m_onTextureReload;
+		std::thread m_thread;
+
+		std::mutex m_mutex;
+		std::condition_variable m_stopCondition;
+		bool m_stopping = false;
+
+		// Every cached texture's file as of the last check, and those that
+		//	changed since update last ran. Guarded by m_mutex.
+		std::unordered_map<std::string, Stamp> m_textureStamps;
+		std::vector<std::string> m_changedTextures;
+	};
+}
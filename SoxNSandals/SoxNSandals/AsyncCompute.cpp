@@ -0,0 +1,226 @@
+/**
+	AsyncCompute.cpp
+
+	Purpose: AsyncCompute.cpp is the source file for the AsyncCompute
+			class. The AsyncCompute runs compute work on a context of
+			its own, so the gpu can overlap it with the passes the
+			context thread draws meanwhile.
+
+	@author Nathan Nette
+*/
+#include "AsyncCompute.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+#include <utility>
+
+namespace sns
+{
+	AsyncCompute::AsyncCompute()
+		: m_release(nullptr),
+		m_releasedTicket(0),
+		m_nextTicket(1)
+	{
+	}
+
+	/**
+		The deconstructor stops the thread, see destroy.
+	*/
+	AsyncCompute::~AsyncCompute()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the shared context and starts the thread.
+
+			@param1 a_shared is the window whose context is shared.
+
+			@return false without GL 4.3 or if the context can't be made.
+	*/
+	bool AsyncCompute::create(GLFWwindow* a_shared)
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("AsyncCompute: compute shaders need GL 4.3.\n");
+			return false;
+		}
+
+		m_releasedTicket = 0;
+		m_nextTicket = 1;
+
+		// The timings' queries belong to the compute context, so they
+		//	are deleted on its thread.
+		SharedContext::Loop loop;
+		loop.isReady = [this]() { return m_jobs.empty() == false; };
+		loop.step = [this](std::unique_lock<std::mutex>& a_lock) { step(a_lock); };
+		loop.end = [this]()
+		{
+			for (Timing& timing : m_timings)
+				glDeleteQueries(2, timing.queries);
+			m_timings.clear();
+		};
+		if (m_context.create(a_shared, "SoxNSandals async compute", 1, 1, false, m_mutex, std::move(loop)) == false)
+		{
+			printf("AsyncCompute: the shared context couldn't be made.\n");
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		submit fences the context thread's commands and queues work to run
+			after them on the compute context. The fence is flushed here,
+			as a wait on the compute context can only flush its own
+			commands.
+
+			@param1 a_name is the job's profiler scope.
+
+			@param2 a_work dispatches the compute work.
+
+			@return the job's ticket for wait.
+	*/
+	unsigned long long AsyncCompute::submit(const char* a_name, std::function<void()> a_work)
+	{
+		GLsync acquire = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		unsigned long long ticket;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			ticket = m_nextTicket++;
+			m_jobs.push_back({ ticket, a_name, acquire, std::move(a_work) });
+		}
+		m_context.wake();
+		return ticket;
+	}
+
+	/**
+		wait makes the context thread's gpu commands after it wait for a
+			job to finish. Jobs finish in order, so the fence after the
+			last one issued covers every job before it. The cpu only
+			waits for the thread to have issued the job.
+
+			@param1 a_ticket is what submit returned.
+	*/
+	void AsyncCompute::wait(unsigned long long a_ticket)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_issued.wait(lock, [this, a_ticket]() { return m_context.isStopping() || m_releasedTicket >= a_ticket; });
+
+		// Waited on under the lock, so the thread can't delete the
+		//	fence before the wait holds on to it.
+		if (m_release != nullptr)
+			glWaitSync((GLsync)m_release, 0, GL_TIMEOUT_IGNORED);
+	}
+
+	/**
+		destroy stops the thread and deletes the context.
+	*/
+	void AsyncCompute::destroy()
+	{
+		if (isCreated() == false)
+			return;
+
+		m_context.stop();
+		m_issued.notify_all();
+
+		// The fences are shared, so they can be deleted from here.
+		for (const Job& job : m_jobs)
+			glDeleteSync((GLsync)job.acquire);
+		m_jobs.clear();
+		if (m_release != nullptr)
+			glDeleteSync((GLsync)m_release);
+		m_release = nullptr;
+
+		m_context.destroy();
+	}
+
+	/**
+		step runs the next job on the compute context, with the mutex
+			unlocked. It waits on the gpu for its acquire fence, runs
+			between two timestamps, and is followed by its release fence.
+
+			@param1 a_lock is the mutex's lock, held before and after.
+	*/
+	void AsyncCompute::step(std::unique_lock<std::mutex>& a_lock)
+	{
+		Job job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		a_lock.unlock();
+
+		collectTimings();
+		glWaitSync((GLsync)job.acquire, 0, GL_TIMEOUT_IGNORED);
+		glDeleteSync((GLsync)job.acquire);
+
+		// The two clocks are read together, so the timestamps can be
+		//	moved onto the profiler's.
+		bool timed = Profiler::isEnabled() && m_timings.size() < MAX_TIMED_JOBS;
+		Timing timing = {};
+		if (timed)
+		{
+			timing.name = job.name;
+			glGenQueries(2, timing.queries);
+			timing.cpuTime = Profiler::now();
+			GLint64 gpuTime = 0;
+			glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+			timing.gpuTime = gpuTime;
+			glQueryCounter(timing.queries[0], GL_TIMESTAMP);
+		}
+		{
+			SNS_TRACE_ZONE("AsyncCompute::work");
+			ProfileScope scope(job.name);
+			job.work();
+		}
+		if (timed)
+		{
+			glQueryCounter(timing.queries[1], GL_TIMESTAMP);
+			m_timings.push_back(timing);
+		}
+
+		GLsync release = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		a_lock.lock();
+		GLsync previous = (GLsync)m_release;
+		m_release = release;
+		m_releasedTicket = job.ticket;
+		m_issued.notify_all();
+		if (previous != nullptr)
+		{
+			a_lock.unlock();
+			glDeleteSync(previous);
+			a_lock.lock();
+		}
+	}
+
+	/**
+		collectTimings hands the jobs whose timestamps are in to the
+			Profiler, oldest first, stopping at the first that isn't.
+	*/
+	void AsyncCompute::collectTimings()
+	{
+		while (m_timings.empty() == false)
+		{
+			Timing& timing = m_timings.front();
+			int available = 0;
+			glGetQueryObjectiv(timing.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == 0)
+				break;
+
+			GLuint64 start = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(timing.queries[0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(timing.queries[1], GL_QUERY_RESULT, &end);
+			glDeleteQueries(2, timing.queries);
+
+			// Nanoseconds on the gpu's clock to microseconds on the cpu's.
+			double startTime = timing.cpuTime + ((long long)start - timing.gpuTime) * 0.001;
+			Profiler::addGpuEvent(timing.name, startTime, (end - start) * 0.001, Profiler::ASYNC_COMPUTE_THREAD);
+			m_timings.pop_front();
+		}
+	}
+}
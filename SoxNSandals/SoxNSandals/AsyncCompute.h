@@ -0,0 +1,152 @@
+/**
+	AsyncCompute.h
+
+	Purpose: AsyncCompute.h is the header file for the AsyncCompute
+			class. The AsyncCompute runs compute work on a context of
+			its own, so the gpu can overlap it with the passes the
+			context thread draws meanwhile.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SharedContext.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+struct GLFWwindow;
+
+namespace sns
+{
+	/**
+		The AsyncCompute class owns a hidden SharedContext, like the
+			UploadThread, whose thread keeps a context sharing objects
+			with the main one current. Drivers give each context its own
+			command stream, so work dispatched on it can run beside the
+			shadow and depth passes instead of between them.
+
+		Both directions are synchronised on the gpu with fences. submit
+			fences what the context thread has issued so far, and the
+			job waits for it before it starts, so everything it reads was
+			written and nothing it writes is still being read. wait makes
+			the context thread's later commands wait for the job's own
+			fence. Neither blocks the cpu, except wait until the thread
+			has issued the job.
+
+		Each job is timed with GL_TIMESTAMP queries on its context, read
+			once they are available, and given to the Profiler on its
+			ASYNC_COMPUTE_THREAD track, placed on the cpu's clock so it
+			shows where it ran against the frame.
+
+		Work runs without the RenderState, which only knows the main
+			context, so it must use programs and bind buffers itself.
+			Programs' uniforms are set on the context thread before
+			submit, with glProgramUniform.
+	*/
+	class AsyncCompute
+	{
+	public:
+		// How many jobs' timestamps can be waiting to be read, older
+		//	ones are dropped.
+		static const unsigned int MAX_TIMED_JOBS = 16;
+
+		AsyncCompute();
+
+		/**
+			The deconstructor stops the thread, see destroy.
+		*/
+		~AsyncCompute();
+
+		AsyncCompute(const AsyncCompute&) = delete;
+		AsyncCompute& operator=(const AsyncCompute&) = delete;
+
+		/**
+			create makes the shared context and starts the thread. Must
+				be called on the main thread with a_shared's context
+				current.
+
+				@param1 a_shared is the window whose context is shared.
+
+				@return false without GL 4.3 or if the context can't be
+						made.
+		*/
+		bool create(GLFWwindow* a_shared);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_context.isCreated(); }
+
+		/**
+			submit fences the context thread's commands and queues work
+				to run after them on the compute context. Only on the
+				context thread.
+
+				@param1 a_name is the job's profiler scope, a string
+						literal.
+
+				@param2 a_work dispatches the compute work.
+
+				@return the job's ticket for wait, never 0.
+		*/
+		unsigned long long submit(const char* a_name, std::function<void()> a_work);
+
+		/**
+			wait makes the context thread's gpu commands after it wait
+				for a job to finish. Only on the context thread.
+
+				@param1 a_ticket is what submit returned.
+		*/
+		void wait(unsigned long long a_ticket);
+
+		/**
+			destroy stops the thread and deletes the context. Must be
+				called on the main thread before GLFW is terminated.
+		*/
+		void destroy();
+
+	private:
+		struct Job
+		{
+			unsigned long long ticket;
+			const char* name;
+
+			// The GLsync of the context thread's commands before it.
+			void* acquire;
+			std::function<void()> work;
+		};
+
+		// A job's timestamps, and the two clocks together when it was
+		//	issued.
+		struct Timing
+		{
+			const char* name;
+			unsigned int queries[2];
+			double cpuTime;
+			long long gpuTime;
+		};
+
+		// What the thread runs for each job, with the mutex locked.
+		void step(std::unique_lock<std::mutex>& a_lock);
+
+		// Hands the timings whose queries are in to the Profiler. Only on
+		//	the compute thread.
+		void collectTimings();
+
+		SharedContext m_context;
+
+		// Guards everything below but the timings.
+		std::mutex m_mutex;
+		std::condition_variable m_issued;
+		std::deque<Job> m_jobs;
+
+		// The fence after the last job issued, and its ticket.
+		void* m_release;
+		unsigned long long m_releasedTicket;
+		unsigned long long m_nextTicket;
+
+		// Only touched by the compute thread.
+		std::deque<Timing> m_timings;
+	};
+}
@@ -0,0 +1,137 @@
+/**
+	BenchmarkReport.cpp
+
+	Purpose: BenchmarkReport.cpp is the source file for the BenchmarkReport
+			class. The BenchmarkReport collects the timings of every
+			benchmark frame and sums them up as JSON, so runs of
+			different builds can be compared.
+
+	@author Nathan Nette
+*/
+#include "BenchmarkReport.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	/**
+		addFrame records one frame.
+
+			@param1 a_frameMilliseconds is the cpu time from the start of
+					the frame to after the swap.
+
+			@param2 a_gpuMilliseconds is how long the gpu spent drawing
+					the frame.
+
+			@param3 a_drawCalls is how many draws the frame made.
+
+			@param4 a_heapAllocations is how many times the frame allocated
+					from the heap, see HeapTracker.
+	*/
+	void BenchmarkReport::addFrame(double a_frameMilliseconds, double a_gpuMilliseconds, unsigned int a_drawCalls,
+		unsigned long long a_heapAllocations)
+	{
+		m_frameMilliseconds.push_back(a_frameMilliseconds);
+		m_gpuMilliseconds.push_back(a_gpuMilliseconds);
+		m_drawCalls.push_back(a_drawCalls);
+		m_heapAllocations.push_back((double)a_heapAllocations);
+	}
+
+	/**
+		write prints a summary and writes every statistic as JSON.
+
+			@param1 a_filename is the json file to write, or nullptr to
+					only print.
+
+			@return false if the file couldn't be written.
+	*/
+	bool BenchmarkReport::write(const char* a_filename) const
+	{
+		Summary frame = getSummary(FRAME_MILLISECONDS);
+		Summary gpu = getSummary(GPU_MILLISECONDS);
+		Summary draws = getSummary(DRAW_CALLS);
+		Summary heap = getSummary(HEAP_ALLOCATIONS);
+
+		printf("Benchmark: %u frames\n", getFrameCount());
+		printf("  frame  min %.3f ms, avg %.3f ms, p99 %.3f ms\n", frame.min, frame.average, frame.p99);
+		printf("  gpu    min %.3f ms, avg %.3f ms, p99 %.3f ms\n", gpu.min, gpu.average, gpu.p99);
+		printf("  draws  avg %.1f, max %.0f\n", draws.average, draws.max);
+		printf("  heap   avg %.1f, max %.0f allocations\n", heap.average, heap.max);
+
+		if (a_filename == nullptr)
+			return true;
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_filename, "w");
+		if (file == nullptr)
+		{
+			printf("Failed to write %s\n", a_filename);
+			return false;
+		}
+
+		const char* names[] = { "frameMs", "gpuMs", "drawCalls", "heapAllocations" };
+		const Summary* summaries[] = { &frame, &gpu, &draws, &heap };
+
+		fprintf(file, "{\n\t\"frames\": %u", getFrameCount());
+		for (unsigned int i = 0; i < VALUE_COUNT; ++i)
+		{
+			fprintf(file, ",\n\t\"%s\": { \"min\": %.4f, \"avg\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+				names[i], summaries[i]->min, summaries[i]->average, summaries[i]->p99, summaries[i]->max);
+		}
+		fprintf(file, "\n}\n");
+
+		bool written = ferror(file) == 0;
+		fclose(file);
+		if (!written)
+			printf("Failed to write %s\n", a_filename);
+		return written;
+	}
+
+	/**
+		getSummary sums up one value across every frame.
+
+			@param1 a_value is the value.
+	*/
+	BenchmarkReport::Summary BenchmarkReport::getSummary(Value a_value) const
+	{
+		switch (a_value)
+		{
+		case GPU_MILLISECONDS:
+			return summarise(m_gpuMilliseconds);
+		case DRAW_CALLS:
+			return summarise(m_drawCalls);
+		case HEAP_ALLOCATIONS:
+			return summarise(m_heapAllocations);
+		default:
+			return summarise(m_frameMilliseconds);
+		}
+	}
+
+	/**
+		summarise sums up one value across every frame.
+
+			@param1 a_values is every frame's value, copied so it can be
+					sorted.
+	*/
+	BenchmarkReport::Summary BenchmarkReport::summarise(std::vector<double> a_values)
+	{
+		Summary summary = {};
+		if (a_values.empty())
+			return summary;
+
+		std::sort(a_values.begin(), a_values.end());
+
+		double total = 0.0;
+		for (double value : a_values)
+			total += value;
+
+		// The nearest rank, so 100 frames give the second slowest.
+		size_t rank = (a_values.size() * 99 + 99) / 100;
+
+		summary.min = a_values.front();
+		summary.max = a_values.back();
+		summary.average = total / a_values.size();
+		summary.p99 = a_values[rank - 1];
+		return summary;
+	}
+}
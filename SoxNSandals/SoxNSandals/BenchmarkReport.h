@@ -0,0 +1,94 @@
+/**
+	BenchmarkReport.h
+
+	Purpose: BenchmarkReport.h is the header file for the BenchmarkReport
+			class. The BenchmarkReport collects the timings of every
+			benchmark frame and sums them up as JSON, so runs of
+			different builds can be compared.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <vector>
+
+namespace sns
+{
+	/**
+		The BenchmarkReport class keeps every frame it is given and
+			reports the minimum, average and 99th percentile of each.
+	*/
+	class BenchmarkReport
+	{
+	public:
+		/**
+			The values recorded for each frame.
+		*/
+		enum Value
+		{
+			FRAME_MILLISECONDS,
+			GPU_MILLISECONDS,
+			DRAW_CALLS,
+			HEAP_ALLOCATIONS,
+			VALUE_COUNT
+		};
+
+		/**
+			The minimum, average, 99th percentile and maximum of one value.
+		*/
+		struct Summary
+		{
+			double min;
+			double average;
+			double p99;
+			double max;
+		};
+
+		/**
+			addFrame records one frame.
+
+				@param1 a_frameMilliseconds is the cpu time from the start
+						of the frame to after the swap.
+
+				@param2 a_gpuMilliseconds is how long the gpu spent
+						drawing the frame.
+
+				@param3 a_drawCalls is how many draws the frame made.
+
+				@param4 a_heapAllocations is how many times the frame
+						allocated from the heap, see HeapTracker.
+		*/
+		void addFrame(double a_frameMilliseconds, double a_gpuMilliseconds, unsigned int a_drawCalls,
+			unsigned long long a_heapAllocations);
+
+		/**
+			write prints a summary and writes every statistic as JSON.
+
+				@param1 a_filename is the json file to write, or nullptr
+						to only print.
+
+				@return false if the file couldn't be written.
+		*/
+		bool write(const char* a_filename) const;
+
+		/**
+			getFrameCount returns how many frames were recorded.
+		*/
+		unsigned int getFrameCount() const { return (unsigned int)m_frameMilliseconds.size(); }
+
+		/**
+			getSummary sums up one value across every frame.
+
+				@param1 a_value is the value.
+		*/
+		Summary getSummary(Value a_value) const;
+
+	private:
+		// Sums up one value across every frame.
+		static Summary summarise(std::vector<double> a_values);
+
+		std::vector<double> m_frameMilliseconds;
+		std::vector<double> m_gpuMilliseconds;
+		std::vector<double> m_drawCalls;
+		std::vector<double> m_heapAllocations;
+	};
+}
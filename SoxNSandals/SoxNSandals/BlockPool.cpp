@@ -0,0 +1,106 @@
+/**
+	BlockPool.cpp
+
+	Purpose: BlockPool.cpp is the source file for the BlockPool class.
+			A BlockPool hands out blocks of one size from slabs it keeps,
+			so things made and destroyed often don't go to the heap
+			each time.
+
+	@author Nathan Nette
+*/
+#include "BlockPool.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace sns
+{
+	/**
+		The constructor makes an empty pool, the first slab is
+			allocated with the first block.
+
+			@param1 a_blockSize is the size of a block in bytes.
+
+			@param2 a_blocksPerSlab is how many blocks each slab holds.
+	*/
+	BlockPool::BlockPool(size_t a_blockSize, unsigned int a_blocksPerSlab)
+		: m_free(nullptr),
+		m_blockSize((std::max(a_blockSize, sizeof(FreeBlock)) + ALIGNMENT - 1) & ~(ALIGNMENT - 1)),
+		m_blocksPerSlab(a_blocksPerSlab > 0 ? a_blocksPerSlab : 1),
+		m_blocksInUse(0)
+	{
+	}
+
+	/**
+		The deconstructor frees every slab. Blocks still in use
+			are freed with them and nothing is destructed.
+	*/
+	BlockPool::~BlockPool()
+	{
+		for (unsigned char* slab : m_slabs)
+			delete[] slab;
+	}
+
+	/**
+		allocate returns a block, adding a slab if none are free.
+	*/
+	void* BlockPool::allocate()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_free == nullptr)
+		{
+			// Padded so the first block can be aligned.
+			unsigned char* slab = new unsigned char[m_blockSize * m_blocksPerSlab + ALIGNMENT - 1];
+			m_slabs.push_back(slab);
+
+			uintptr_t first = ((uintptr_t)slab + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1);
+			// Linked last to first, so blocks are handed out in address order.
+			for (unsigned int i = m_blocksPerSlab; i-- > 0;)
+			{
+				FreeBlock* block = (FreeBlock*)(first + i * m_blockSize);
+				block->next = m_free;
+				m_free = block;
+			}
+		}
+
+		FreeBlock* block = m_free;
+		m_free = block->next;
+		++m_blocksInUse;
+		return block;
+	}
+
+	/**
+		free gives a block back to the pool.
+
+			@param1 a_block is a block from allocate, or null.
+	*/
+	void BlockPool::free(void* a_block)
+	{
+		if (a_block == nullptr)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		FreeBlock* block = (FreeBlock*)a_block;
+		block->next = m_free;
+		m_free = block;
+		--m_blocksInUse;
+	}
+
+	/**
+		getSlabCount returns how many slabs have been allocated.
+	*/
+	unsigned int BlockPool::getSlabCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return (unsigned int)m_slabs.size();
+	}
+
+	/**
+		getBlocksInUse returns how many blocks are allocated and
+			not yet freed.
+	*/
+	unsigned int BlockPool::getBlocksInUse() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_blocksInUse;
+	}
+}
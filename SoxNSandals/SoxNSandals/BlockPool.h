@@ -0,0 +1,127 @@
+/**
+	BlockPool.h
+
+	Purpose: BlockPool.h is the header file for the BlockPool class.
+			A BlockPool hands out blocks of one size from slabs it keeps,
+			so things made and destroyed often don't go to the heap
+			each time.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cassert>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The BlockPool class carves slabs into blocks of a fixed size.
+			A freed block goes on a free list and is the next one handed
+			out, and slabs are only freed with the pool, so once a pool
+			has grown to what a scene uses it never allocates again.
+
+		Blocks are aligned to ALIGNMENT. Allocating and freeing take a
+			lock, so a pool can be shared between threads.
+	*/
+	class BlockPool
+	{
+	public:
+		// What every block is aligned to, enough for SSE.
+		static const size_t ALIGNMENT = 16;
+
+		/**
+			The constructor makes an empty pool, the first slab is
+				allocated with the first block.
+
+				@param1 a_blockSize is the size of a block in bytes.
+
+				@param2 a_blocksPerSlab is how many blocks each slab holds.
+		*/
+		BlockPool(size_t a_blockSize, unsigned int a_blocksPerSlab);
+
+		/**
+			The deconstructor frees every slab. Blocks still in use
+				are freed with them and nothing is destructed.
+		*/
+		~BlockPool();
+
+		BlockPool(const BlockPool&) = delete;
+		BlockPool& operator=(const BlockPool&) = delete;
+
+		/**
+			allocate returns a block, adding a slab if none are free.
+		*/
+		void* allocate();
+
+		/**
+			free gives a block back to the pool.
+
+				@param1 a_block is a block from allocate, or null.
+		*/
+		void free(void* a_block);
+
+		/**
+			create constructs an object in a block.
+
+				@param1 a_arguments are passed to the constructor.
+		*/
+		template <typename T, typename... Arguments>
+		T* create(Arguments&&... a_arguments)
+		{
+			assert(sizeof(T) <= m_blockSize && alignof(T) <= ALIGNMENT);
+			return new (allocate()) T(std::forward<Arguments>(a_arguments)...);
+		}
+
+		/**
+			destroy destructs an object from create and frees its block.
+
+				@param1 a_object is the object, or null.
+		*/
+		template <typename T>
+		void destroy(T* a_object)
+		{
+			if (a_object == nullptr)
+				return;
+			a_object->~T();
+			free(a_object);
+		}
+
+		/**
+			getBlockSize returns the size of a block in bytes.
+		*/
+		size_t getBlockSize() const { return m_blockSize; }
+
+		/**
+			getSlabCount returns how many slabs have been allocated.
+		*/
+		unsigned int getSlabCount() const;
+
+		/**
+			getBlocksInUse returns how many blocks are allocated and
+				not yet freed.
+		*/
+		unsigned int getBlocksInUse() const;
+
+	private:
+		// A free block holds the next free block.
+		struct FreeBlock
+		{
+			FreeBlock* next;
+		};
+
+		mutable std::mutex m_mutex;
+
+		// The slabs as allocated, before aligning.
+		std::vector<unsigned char*> m_slabs;
+
+		FreeBlock* m_free;
+
+		// The block size rounded up to ALIGNMENT.
+		size_t m_blockSize;
+		unsigned int m_blocksPerSlab;
+		unsigned int m_blocksInUse;
+	};
+}
@@ -0,0 +1,204 @@
+/**
+	Bloom.cpp
+
+	Purpose: Bloom.cpp is the source file for the Bloom class. The Bloom
+			blurs what is brighter than a threshold in the scene into a
+			glow, wide and soft without costing much, for the post
+			process to add to the scene before it tonemaps it.
+
+	@author Nathan Nette
+*/
+#include "Bloom.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "SamplerCache.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+
+namespace sns
+{
+	// The width and height of the prefilter's and upsample's groups.
+	static const int GROUP_SIZE = 8;
+
+	// The units the shaders read from, and the image they write.
+	static const unsigned int SOURCE_UNIT = 0;
+	static const unsigned int COARSE_UNIT = 1;
+	static const unsigned int DESTINATION_IMAGE = 0;
+
+	// The levels are only ever filtered, so a little precision is worth
+	//	the bandwidth it saves.
+	static const unsigned int FORMAT = GL_R11F_G11F_B10F;
+
+	// How far under the threshold the knee starts to let the scene
+	//	glow, as a part of the threshold.
+	static const float KNEE = 0.5f;
+
+	Bloom::Bloom()
+		: m_width(0),
+		m_height(0),
+		m_levelCount(0),
+		m_sampler(0)
+	{
+	}
+
+	/**
+		create loads the shaders and the downsampler's.
+
+			@return false without GL 4.3 or the shaders, it is left
+					uncreated.
+	*/
+	bool Bloom::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("Bloom: the bloom pyramid needs GL 4.3.\n");
+			return false;
+		}
+		if (m_downsampler.create(FORMAT, MipDownsampler::AVERAGE) == false)
+			return false;
+
+		m_prefilterShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/bloomPrefilter.comp");
+		if (m_prefilterShader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_prefilterShader.getLastError());
+			return false;
+		}
+		m_upsampleShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/bloomUpsample.comp");
+		if (m_upsampleShader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_upsampleShader.getLastError());
+			return false;
+		}
+
+		// Nearest between levels, each is read at a level of its own.
+		m_sampler = SamplerCache::instance().get({ GL_LINEAR_MIPMAP_NEAREST, GL_LINEAR, GL_CLAMP_TO_EDGE,
+			GL_CLAMP_TO_EDGE, false });
+		return true;
+	}
+
+	/**
+		build blurs a texture's brightest parts into the glow. The
+			prefilter reads it into the first level, the downsampler
+			averages that down, and each level from the second
+			smallest up adds the tent of the one below it.
+
+			@param1 a_source is the texture, in linear high dynamic range.
+
+			@param2 a_sourceSize is how much of it, in texels, was drawn
+					into.
+
+			@param3 a_textureSize is its size.
+
+			@param4 a_exposure is what the scene is multiplied by before
+					it is tonemapped, which the threshold is after.
+
+			@param5 a_threshold is how bright the exposed scene is before
+					it glows.
+	*/
+	void Bloom::build(unsigned int a_source, const glm::vec2& a_sourceSize, const glm::vec2& a_textureSize,
+		float a_exposure, float a_threshold)
+	{
+		static constexpr aie::UniformHandle SOURCE("Source");
+		static constexpr aie::UniformHandle PYRAMID_TEXEL("PyramidTexel");
+		static constexpr aie::UniformHandle SOURCE_MAX("SourceMax");
+		static constexpr aie::UniformHandle EXPOSURE("Exposure");
+		static constexpr aie::UniformHandle THRESHOLD("Threshold");
+		static constexpr aie::UniformHandle KNEE_WIDTH("Knee");
+		static constexpr aie::UniformHandle COARSE("Coarse");
+		static constexpr aie::UniformHandle FINE("Fine");
+		static constexpr aie::UniformHandle COARSE_LEVEL("CoarseLevel");
+		static constexpr aie::UniformHandle FINE_LEVEL("FineLevel");
+
+		if (isCreated() == false)
+			return;
+		resize((int)a_textureSize.x / 2, (int)a_textureSize.y / 2);
+		if (m_levelCount < 2)
+			return;
+
+		// The pyramid's first level spans what of the source was drawn
+		//	into, so a scene drawn smaller still fills it.
+		glm::vec2 sourceScale = a_sourceSize / a_textureSize;
+		glm::vec2 pyramidTexel = sourceScale / glm::vec2(m_width, m_height);
+		glm::vec2 sourceMax = (a_sourceSize - 0.5f) / a_textureSize;
+
+		RenderState& state = RenderState::instance();
+		state.bindTexture(SOURCE_UNIT, a_source, SamplerCache::instance().get({ GL_LINEAR, GL_LINEAR,
+			GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, false }));
+		m_prefilterShader.bind();
+		m_prefilterShader.bindUniform(SOURCE, (int)SOURCE_UNIT);
+		m_prefilterShader.bindUniform(PYRAMID_TEXEL, pyramidTexel);
+		m_prefilterShader.bindUniform(SOURCE_MAX, sourceMax);
+		m_prefilterShader.bindUniform(EXPOSURE, a_exposure);
+		m_prefilterShader.bindUniform(THRESHOLD, a_threshold);
+		m_prefilterShader.bindUniform(KNEE_WIDTH, a_threshold * KNEE);
+		glBindImageTexture(DESTINATION_IMAGE, m_pyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute((m_width + GROUP_SIZE - 1) / GROUP_SIZE, (m_height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		m_downsampler.downsample(m_pyramid, m_width, m_height, m_levelCount);
+
+		// The smallest level is the first coarse one, and after it each
+		//	level of the glow is the next one's.
+		m_upsampleShader.bind();
+		m_upsampleShader.bindUniform(FINE, (int)SOURCE_UNIT);
+		m_upsampleShader.bindUniform(COARSE, (int)COARSE_UNIT);
+		state.bindTexture(SOURCE_UNIT, m_pyramid, m_sampler);
+		for (int level = m_levelCount - 2; level >= 0; --level)
+		{
+			bool smallest = level == m_levelCount - 2;
+			state.bindTexture(COARSE_UNIT, smallest ? m_pyramid : m_upsampled, m_sampler);
+			m_upsampleShader.bindUniform(COARSE_LEVEL, level + 1);
+			m_upsampleShader.bindUniform(FINE_LEVEL, level);
+			glBindImageTexture(DESTINATION_IMAGE, m_upsampled, level, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+
+			int width = m_width >> level > 1 ? m_width >> level : 1;
+			int height = m_height >> level > 1 ? m_height >> level : 1;
+			glDispatchCompute((width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		}
+
+		state.bindTexture(SOURCE_UNIT, 0);
+		state.bindTexture(COARSE_UNIT, 0);
+	}
+
+	/**
+		resize makes the pyramid and glow for a texture's size, as many
+			levels as halve to at least a texel, up to MAX_LEVELS. It
+			does nothing when they already are that size.
+
+			@param1 a_width is the width of the first level.
+
+			@param2 a_height is the height of the first level.
+	*/
+	void Bloom::resize(int a_width, int a_height)
+	{
+		if (a_width == m_width && a_height == m_height)
+			return;
+		m_width = a_width;
+		m_height = a_height;
+		m_levelCount = 0;
+		m_pyramid.reset();
+		m_upsampled.reset();
+		if (a_width < 1 || a_height < 1)
+			return;
+
+		int smallest = a_width < a_height ? a_width : a_height;
+		while (m_levelCount < MAX_LEVELS && smallest >> m_levelCount > 0)
+			++m_levelCount;
+		if (m_levelCount < 2)
+			return;
+
+		GpuMemory& memory = GpuMemory::instance();
+		glCreateTextures(GL_TEXTURE_2D, 1, m_pyramid.put());
+		glTextureStorage2D(m_pyramid, m_levelCount, FORMAT, m_width, m_height);
+		memory.trackTexture(m_pyramid, GpuMemory::getTextureBytes(FORMAT, m_width, m_height, 1, m_levelCount),
+			GpuMemory::RENDER_TARGETS, "Bloom");
+
+		glCreateTextures(GL_TEXTURE_2D, 1, m_upsampled.put());
+		glTextureStorage2D(m_upsampled, m_levelCount - 1, FORMAT, m_width, m_height);
+		memory.trackTexture(m_upsampled, GpuMemory::getTextureBytes(FORMAT, m_width, m_height, 1, m_levelCount - 1),
+			GpuMemory::RENDER_TARGETS, "Bloom");
+	}
+}
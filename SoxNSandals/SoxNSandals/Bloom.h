@@ -0,0 +1,117 @@
+/**
+	Bloom.h
+
+	Purpose: Bloom.h is the header file for the Bloom class. The Bloom
+			blurs what is brighter than a threshold in the scene into a
+			glow, wide and soft without costing much, for the post
+			process to add to the scene before it tonemaps it.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "MipDownsampler.h"
+#include "Shader.h"
+#include <glm/vec2.hpp>
+
+namespace sns
+{
+	/**
+		The Bloom class builds its glow from a pyramid of half sized
+			levels, all of it in compute.
+
+		A prefilter reads the scene at half the size of its texture,
+			four bilinear taps a texel each weighted by how bright it
+			is, so a single bright pixel doesn't flicker as it moves,
+			and keeps what is over the threshold with a soft knee. The
+			MipDownsampler averages that down through the rest of the
+			levels in one dispatch.
+
+		The glow is built back up from the smallest level. Each level
+			adds a 3 by 3 tent of the one below it, stretched over it,
+			to its own texels, so by the first level every size of blur
+			has been added together. That is one dispatch a level, of
+			levels a quarter of the texels of the last.
+
+		The pyramid is only as large as it needs to be for the texture,
+			and is made again when that changes. Needs GL 4.3, without
+			it create fails and the scene should be drawn without.
+	*/
+	class Bloom
+	{
+	public:
+		// The most levels of the pyramid, the smallest a thirty second
+		//	of the size the scene is read at.
+		static const int MAX_LEVELS = 6;
+
+		Bloom();
+
+		Bloom(const Bloom&) = delete;
+		Bloom& operator=(const Bloom&) = delete;
+
+		/**
+			create loads the shaders.
+
+				@return false without GL 4.3 or the shaders, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_upsampleShader.getHandle() != 0; }
+
+		/**
+			build blurs a texture's brightest parts into the glow.
+
+				@param1 a_source is the texture, in linear high dynamic
+						range.
+
+				@param2 a_sourceSize is how much of it, in texels, was
+						drawn into.
+
+				@param3 a_textureSize is its size.
+
+				@param4 a_exposure is what the scene is multiplied by
+						before it is tonemapped, which the threshold
+						is after.
+
+				@param5 a_threshold is how bright the exposed scene is
+						before it glows.
+		*/
+		void build(unsigned int a_source, const glm::vec2& a_sourceSize, const glm::vec2& a_textureSize,
+			float a_exposure, float a_threshold);
+
+		/**
+			getTexture returns the glow, over what of the source was
+				drawn into, or 0 before a build.
+		*/
+		unsigned int getTexture() const { return m_upsampled; }
+
+		/**
+			getLevelCount returns how many levels were added into the
+				glow, which it is that many times as bright as.
+		*/
+		int getLevelCount() const { return m_levelCount; }
+
+	private:
+		// Makes the pyramid and glow for a texture's size.
+		void resize(int a_width, int a_height);
+
+		aie::ShaderProgram m_prefilterShader;
+		aie::ShaderProgram m_upsampleShader;
+		MipDownsampler m_downsampler;
+
+		// The thresholded and averaged levels, and the glow built back
+		//	up from them, a level fewer as the smallest isn't.
+		TextureHandle m_pyramid;
+		TextureHandle m_upsampled;
+		int m_width;
+		int m_height;
+		int m_levelCount;
+
+		// Linear filtering inside a level, and clamped to its edges.
+		unsigned int m_sampler;
+	};
+}
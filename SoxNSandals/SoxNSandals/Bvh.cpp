@@ -0,0 +1,799 @@
+/**
+	Bvh.cpp
+
+	Purpose: Bvh.cpp is the source file for the Bvh class. The Bvh is a
+			bounding volume hierarchy over boxes, so the few near a
+			frustum, a ray or a box are found without testing all of
+			them.
+
+	@author Nathan Nette
+*/
+#include "Bvh.h"
+#include "Frustum.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	typedef sns::Bvh::Box Box;
+
+	// The centroids are split into this many bins along each axis, and
+	//	the split between two bins with the lowest cost taken.
+	const unsigned int SAH_BINS = 16;
+
+	// Below this depth ranges are split at their median instead, so a run
+	//	of lopsided splits can't make the tree too deep to traverse.
+	const unsigned int MAX_SAH_DEPTH = 48;
+
+	// Each node visited pushes at most four, so this is deeper than any
+	//	tree of nodes of four the builder makes.
+	const int STACK_SIZE = 256;
+
+	Box emptyBox()
+	{
+		return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	}
+
+	void grow(Box& a_box, const Box& a_other)
+	{
+		a_box.min = glm::min(a_box.min, a_other.min);
+		a_box.max = glm::max(a_box.max, a_other.max);
+	}
+
+	// Half the surface area, which is all the heuristic compares.
+	float halfArea(const Box& a_box)
+	{
+		glm::vec3 size = glm::max(a_box.max - a_box.min, glm::vec3(0));
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	/**
+		A node of the binary tree the flattened one is made from. A node
+			with a count is a leaf of m_primitives[first, first + count).
+	*/
+	struct BuildNode
+	{
+		Box box;
+		uint32_t first;
+		uint32_t count;
+		int32_t left;
+		int32_t right;
+	};
+
+	/**
+		Builds the binary tree over a range of the primitives, reordering
+			them so each leaf's are together.
+	*/
+	struct BinaryBuilder
+	{
+		const Box* boxes;
+		std::vector<glm::vec3> centroids;
+		std::vector<uint32_t>& primitives;
+		std::vector<BuildNode> nodes;
+
+		BinaryBuilder(const Box* a_boxes, std::vector<uint32_t>& a_primitives)
+			: boxes(a_boxes), primitives(a_primitives) {}
+
+		int32_t build(uint32_t a_first, uint32_t a_count, unsigned int a_depth)
+		{
+			int32_t index = (int32_t)nodes.size();
+			nodes.push_back({ emptyBox(), a_first, a_count, -1, -1 });
+
+			Box centroidBox = emptyBox();
+			for (uint32_t i = a_first; i < a_first + a_count; ++i)
+			{
+				grow(nodes[index].box, boxes[primitives[i]]);
+				const glm::vec3& centroid = centroids[primitives[i]];
+				grow(centroidBox, { centroid, centroid });
+			}
+			if (a_count <= sns::Bvh::MAX_LEAF_SIZE)
+				return index;
+
+			uint32_t split = a_depth < MAX_SAH_DEPTH ?
+				findSplit(a_first, a_count, centroidBox) : splitMedian(a_first, a_count, centroidBox);
+			nodes[index].count = 0;
+			int32_t left = build(a_first, split - a_first, a_depth + 1);
+			int32_t right = build(split, a_first + a_count - split, a_depth + 1);
+			nodes[index].left = left;
+			nodes[index].right = right;
+			return index;
+		}
+
+		/**
+			findSplit bins the centroids along each axis and partitions the
+				range at the cheapest split, the one where the two sides'
+				areas times their counts is least. Centroids all in one
+				place are split down the middle.
+
+				@return the first primitive of the right side.
+		*/
+		uint32_t findSplit(uint32_t a_first, uint32_t a_count, const Box& a_centroidBox)
+		{
+			glm::vec3 extent = a_centroidBox.max - a_centroidBox.min;
+			float bestCost = FLT_MAX;
+			int bestAxis = -1;
+			unsigned int bestBin = 0;
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (extent[axis] <= 0.0f)
+					continue;
+
+				Box binBoxes[SAH_BINS];
+				uint32_t binCounts[SAH_BINS] = {};
+				for (Box& box : binBoxes)
+					box = emptyBox();
+
+				float scale = SAH_BINS / extent[axis];
+				for (uint32_t i = a_first; i < a_first + a_count; ++i)
+				{
+					unsigned int bin = binOf(centroids[primitives[i]][axis], a_centroidBox.min[axis], scale);
+					grow(binBoxes[bin], boxes[primitives[i]]);
+					++binCounts[bin];
+				}
+
+				// The costs of every split from the right, then sweep from
+				//	the left to add the other side.
+				float rightCosts[SAH_BINS];
+				Box right = emptyBox();
+				uint32_t rightCount = 0;
+				for (unsigned int bin = SAH_BINS - 1; bin > 0; --bin)
+				{
+					grow(right, binBoxes[bin]);
+					rightCount += binCounts[bin];
+					rightCosts[bin] = rightCount > 0 ? halfArea(right) * rightCount : 0.0f;
+				}
+
+				Box left = emptyBox();
+				uint32_t leftCount = 0;
+				for (unsigned int bin = 1; bin < SAH_BINS; ++bin)
+				{
+					grow(left, binBoxes[bin - 1]);
+					leftCount += binCounts[bin - 1];
+					float cost = (leftCount > 0 ? halfArea(left) * leftCount : 0.0f) + rightCosts[bin];
+					if (leftCount > 0 && leftCount < a_count && cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = bin;
+					}
+				}
+			}
+
+			if (bestAxis < 0)
+				return splitMedian(a_first, a_count, a_centroidBox);
+
+			uint32_t* begin = primitives.data() + a_first;
+			uint32_t* end = begin + a_count;
+			float scale = SAH_BINS / extent[bestAxis];
+			float origin = a_centroidBox.min[bestAxis];
+			uint32_t* middle = std::partition(begin, end, [&](uint32_t a_primitive)
+			{
+				return binOf(centroids[a_primitive][bestAxis], origin, scale) < bestBin;
+			});
+			return a_first + (uint32_t)(middle - begin);
+		}
+
+		/**
+			splitMedian splits a range in half along the longest axis of its
+				centroids.
+
+				@return the first primitive of the right side.
+		*/
+		uint32_t splitMedian(uint32_t a_first, uint32_t a_count, const Box& a_centroidBox)
+		{
+			glm::vec3 extent = a_centroidBox.max - a_centroidBox.min;
+			int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			uint32_t* begin = primitives.data() + a_first;
+			std::nth_element(begin, begin + a_count / 2, begin + a_count, [&](uint32_t a_left, uint32_t a_right)
+			{
+				return centroids[a_left][axis] < centroids[a_right][axis];
+			});
+			return a_first + a_count / 2;
+		}
+
+		static unsigned int binOf(float a_value, float a_origin, float a_scale)
+		{
+			int bin = (int)((a_value - a_origin) * a_scale);
+			return (unsigned int)std::min(std::max(bin, 0), (int)SAH_BINS - 1);
+		}
+	};
+
+	/**
+		The planes' components broadcast once a query, as the node tests
+			use them.
+	*/
+	struct Planes
+	{
+		glm::vec4 planes[6];
+		glm::vec3 absolute[6];
+
+		explicit Planes(const sns::Frustum& a_frustum)
+		{
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				planes[i] = a_frustum.getPlane(i);
+				absolute[i] = glm::abs(glm::vec3(planes[i]));
+			}
+		}
+	};
+}
+
+namespace sns
+{
+	Bvh::Bvh()
+	{
+	}
+
+	/**
+		build builds a binary tree split by the surface area heuristic,
+			then collapses it four children to a node, expanding the
+			child with the largest area until a node has four.
+
+			@param1 a_boxes is every primitive's bounds.
+
+			@param2 a_count is how many there are.
+	*/
+	void Bvh::build(const Box* a_boxes, unsigned int a_count)
+	{
+		clear();
+		if (a_count == 0)
+			return;
+
+		m_boxes.assign(a_boxes, a_boxes + a_count);
+		m_primitives.resize(a_count);
+		m_leafOf.resize(a_count);
+		for (unsigned int i = 0; i < a_count; ++i)
+			m_primitives[i] = i;
+
+		BinaryBuilder builder(m_boxes.data(), m_primitives);
+		builder.centroids.resize(a_count);
+		for (unsigned int i = 0; i < a_count; ++i)
+			builder.centroids[i] = (m_boxes[i].min + m_boxes[i].max) * 0.5f;
+		builder.nodes.reserve(a_count / 2 + 1);
+		builder.build(0, a_count, 0);
+
+		// Each wide node is made before its children, so a parent always
+		//	comes before them and the stack holds what still needs a node.
+		struct Pending
+		{
+			int32_t binary;
+			Parent parent;
+		};
+		std::vector<Pending> pending;
+		pending.push_back({ 0, { EMPTY, 0 } });
+		m_nodes.reserve(builder.nodes.size() / 3 + 1);
+
+		while (pending.empty() == false)
+		{
+			Pending next = pending.back();
+			pending.pop_back();
+
+			// Open the largest inner child until there are four, a leaf
+			//	at the root is the only child of one node.
+			int32_t children[4] = { next.binary, EMPTY, EMPTY, EMPTY };
+			unsigned int childCount = 1;
+			if (builder.nodes[next.binary].count == 0)
+			{
+				children[0] = builder.nodes[next.binary].left;
+				children[1] = builder.nodes[next.binary].right;
+				childCount = 2;
+			}
+			while (childCount < 4)
+			{
+				int largest = -1;
+				float largestArea = -1.0f;
+				for (unsigned int i = 0; i < childCount; ++i)
+				{
+					const BuildNode& child = builder.nodes[children[i]];
+					float area = halfArea(child.box);
+					if (child.count == 0 && area > largestArea)
+					{
+						largest = (int)i;
+						largestArea = area;
+					}
+				}
+				if (largest < 0)
+					break;
+
+				const BuildNode& opened = builder.nodes[children[largest]];
+				children[childCount++] = opened.right;
+				children[largest] = opened.left;
+			}
+
+			int32_t index = (int32_t)m_nodes.size();
+			m_nodes.emplace_back();
+			m_parents.push_back(next.parent);
+			if (next.parent.node != EMPTY)
+				m_nodes[next.parent.node].first[next.parent.slot] = index;
+
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				if (slot >= childCount)
+				{
+					clearSlot(m_nodes[index], slot);
+					continue;
+				}
+
+				const BuildNode& child = builder.nodes[children[slot]];
+				setSlot(m_nodes[index], slot, child.box);
+				m_nodes[index].count[slot] = child.count;
+				m_nodes[index].first[slot] = (int32_t)child.first;
+				if (child.count > 0)
+				{
+					for (uint32_t i = child.first; i < child.first + child.count; ++i)
+						m_leafOf[m_primitives[i]] = (uint32_t)index * 4 + slot;
+				}
+				else
+					pending.push_back({ children[slot], { index, slot } });
+			}
+		}
+	}
+
+	/**
+		clear empties the tree.
+	*/
+	void Bvh::clear()
+	{
+		m_nodes.clear();
+		m_parents.clear();
+		m_primitives.clear();
+		m_leafOf.clear();
+		m_boxes.clear();
+		m_dirtyLeaves.clear();
+	}
+
+	/**
+		update changes a primitive's bounds, and marks its leaf to be
+			refit.
+
+			@param1 a_primitive is the primitive's index.
+
+			@param2 a_box is its new bounds.
+	*/
+	void Bvh::update(unsigned int a_primitive, const Box& a_box)
+	{
+		m_boxes[a_primitive] = a_box;
+		m_dirtyLeaves.push_back(m_leafOf[a_primitive]);
+	}
+
+	/**
+		refit refits the nodes above every primitive updated since the
+			last refit. Each leaf's slot is set to its primitives' bounds,
+			then each node's slot in its parent to its children's, until
+			a slot doesn't change.
+	*/
+	void Bvh::refit()
+	{
+		std::sort(m_dirtyLeaves.begin(), m_dirtyLeaves.end());
+		m_dirtyLeaves.erase(std::unique(m_dirtyLeaves.begin(), m_dirtyLeaves.end()), m_dirtyLeaves.end());
+
+		for (uint32_t leaf : m_dirtyLeaves)
+		{
+			int32_t node = (int32_t)(leaf / 4);
+			unsigned int slot = leaf % 4;
+			Node& leafNode = m_nodes[node];
+			setSlot(leafNode, slot, getLeafBox((uint32_t)leafNode.first[slot], leafNode.count[slot]));
+
+			for (Parent parent = m_parents[node]; parent.node != EMPTY; parent = m_parents[node])
+			{
+				Box box = getNodeBox(m_nodes[node]);
+				Node& parentNode = m_nodes[parent.node];
+				if (parentNode.minX[parent.slot] == box.min.x && parentNode.minY[parent.slot] == box.min.y &&
+					parentNode.minZ[parent.slot] == box.min.z && parentNode.maxX[parent.slot] == box.max.x &&
+					parentNode.maxY[parent.slot] == box.max.y && parentNode.maxZ[parent.slot] == box.max.z)
+					break;
+
+				setSlot(parentNode, parent.slot, box);
+				node = parent.node;
+			}
+		}
+		m_dirtyLeaves.clear();
+	}
+
+	/**
+		queryFrustum finds every primitive whose box is at least partly
+			inside a frustum. A node's four children are tested against
+			each plane at once, both for being outside it and for
+			reaching across it, so children entirely inside are added
+			whole.
+
+			@param1 a_frustum is the frustum.
+
+			@param2 a_primitives has the primitives found added.
+
+			@return how many were found.
+	*/
+	unsigned int Bvh::queryFrustum(const Frustum& a_frustum, std::vector<unsigned int>& a_primitives) const
+	{
+		if (m_nodes.empty())
+			return 0;
+
+		size_t start = a_primitives.size();
+		Planes planes(a_frustum);
+		int32_t stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0)
+		{
+			const Node& node = m_nodes[stack[--top]];
+			int outside = 0;
+			int crossing = 0;
+
+#ifdef SNS_BVH_SSE
+			const __m128 half = _mm_set1_ps(0.5f);
+			__m128 minX = _mm_load_ps(node.minX), maxX = _mm_load_ps(node.maxX);
+			__m128 minY = _mm_load_ps(node.minY), maxY = _mm_load_ps(node.maxY);
+			__m128 minZ = _mm_load_ps(node.minZ), maxZ = _mm_load_ps(node.maxZ);
+			__m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+			__m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+			__m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+			__m128 ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+			__m128 ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+			__m128 ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+			__m128 outsideMask = _mm_setzero_ps();
+			__m128 crossingMask = _mm_setzero_ps();
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				const glm::vec4& plane = planes.planes[i];
+				const glm::vec3& absolute = planes.absolute[i];
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx),
+					_mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(absolute.x), ex),
+					_mm_mul_ps(_mm_set1_ps(absolute.y), ey)), _mm_mul_ps(_mm_set1_ps(absolute.z), ez));
+
+				outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+				crossingMask = _mm_or_ps(crossingMask, _mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+			}
+			outside = _mm_movemask_ps(outsideMask);
+			crossing = _mm_movemask_ps(crossingMask);
+#else
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				glm::vec3 centre = glm::vec3(node.minX[slot] + node.maxX[slot], node.minY[slot] + node.maxY[slot],
+					node.minZ[slot] + node.maxZ[slot]) * 0.5f;
+				glm::vec3 extent = glm::vec3(node.maxX[slot] - node.minX[slot], node.maxY[slot] - node.minY[slot],
+					node.maxZ[slot] - node.minZ[slot]) * 0.5f;
+				for (unsigned int i = 0; i < 6; ++i)
+				{
+					float distance = glm::dot(glm::vec3(planes.planes[i]), centre) + planes.planes[i].w;
+					float radius = glm::dot(planes.absolute[i], extent);
+					outside |= distance + radius < 0.0f ? 1 << slot : 0;
+					crossing |= distance - radius < 0.0f ? 1 << slot : 0;
+				}
+			}
+#endif
+
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				if (node.first[slot] == EMPTY || (outside & (1 << slot)) != 0)
+					continue;
+
+				bool inside = (crossing & (1 << slot)) == 0;
+				if (node.count[slot] == 0)
+				{
+					if (inside)
+						addSubtree(node.first[slot], a_primitives);
+					else
+						stack[top++] = node.first[slot];
+					continue;
+				}
+
+				// A leaf reaching across a plane has each of its boxes
+				//	tested on its own.
+				for (uint32_t i = (uint32_t)node.first[slot]; i < (uint32_t)node.first[slot] + node.count[slot]; ++i)
+				{
+					const Box& box = m_boxes[m_primitives[i]];
+					if (inside || a_frustum.isBoxVisible((box.min + box.max) * 0.5f, (box.max - box.min) * 0.5f))
+						a_primitives.push_back(m_primitives[i]);
+				}
+			}
+		}
+		return (unsigned int)(a_primitives.size() - start);
+	}
+
+	/**
+		queryBox finds every primitive whose box overlaps a box, testing
+			a node's four children at once.
+
+			@param1 a_box is the box.
+
+			@param2 a_primitives has the primitives found added.
+
+			@return how many were found.
+	*/
+	unsigned int Bvh::queryBox(const Box& a_box, std::vector<unsigned int>& a_primitives) const
+	{
+		if (m_nodes.empty())
+			return 0;
+
+		size_t start = a_primitives.size();
+		int32_t stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0)
+		{
+			const Node& node = m_nodes[stack[--top]];
+
+#ifdef SNS_BVH_SSE
+			__m128 overlap = _mm_and_ps(
+				_mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), _mm_set1_ps(a_box.max.x)),
+					_mm_cmpge_ps(_mm_load_ps(node.maxX), _mm_set1_ps(a_box.min.x))),
+				_mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), _mm_set1_ps(a_box.max.y)),
+					_mm_cmpge_ps(_mm_load_ps(node.maxY), _mm_set1_ps(a_box.min.y))));
+			overlap = _mm_and_ps(overlap,
+				_mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), _mm_set1_ps(a_box.max.z)),
+					_mm_cmpge_ps(_mm_load_ps(node.maxZ), _mm_set1_ps(a_box.min.z))));
+			int overlapping = _mm_movemask_ps(overlap);
+#else
+			int overlapping = 0;
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				if (node.minX[slot] <= a_box.max.x && node.maxX[slot] >= a_box.min.x &&
+					node.minY[slot] <= a_box.max.y && node.maxY[slot] >= a_box.min.y &&
+					node.minZ[slot] <= a_box.max.z && node.maxZ[slot] >= a_box.min.z)
+					overlapping |= 1 << slot;
+			}
+#endif
+
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				if (node.first[slot] == EMPTY || (overlapping & (1 << slot)) == 0)
+					continue;
+
+				if (node.count[slot] == 0)
+				{
+					stack[top++] = node.first[slot];
+					continue;
+				}
+
+				for (uint32_t i = (uint32_t)node.first[slot]; i < (uint32_t)node.first[slot] + node.count[slot]; ++i)
+				{
+					const Box& box = m_boxes[m_primitives[i]];
+					if (glm::all(glm::lessThanEqual(box.min, a_box.max)) && glm::all(glm::greaterThanEqual(box.max, a_box.min)))
+						a_primitives.push_back(m_primitives[i]);
+				}
+			}
+		}
+		return (unsigned int)(a_primitives.size() - start);
+	}
+
+	/**
+		intersectRay finds the closest primitive a ray hits. Each node's
+			four children are slab tested at once, and the ones hit are
+			pushed furthest first so the nearest is visited next. A
+			child entered further than the closest hit is skipped.
+
+			@param1 a_origin is where the ray starts.
+
+			@param2 a_direction is the way it goes.
+
+			@param3 a_maxDistance is how far along it to look.
+
+			@param4 a_intersect tests a primitive, or an empty function
+					to hit the primitives' boxes.
+
+			@param5 a_hit is set to the closest hit.
+
+			@return false if nothing was hit.
+	*/
+	bool Bvh::intersectRay(const glm::vec3& a_origin, const glm::vec3& a_direction, float a_maxDistance,
+		const IntersectFunction& a_intersect, Hit& a_hit) const
+	{
+		if (m_nodes.empty())
+			return false;
+
+		// A direction along an axis would divide by 0, which a tiny one
+		//	of the same sign gets close enough to without the nans.
+		glm::vec3 inverse;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float d = a_direction[axis];
+			inverse[axis] = 1.0f / (fabsf(d) > 1e-20f ? d : (d < 0.0f ? -1e-20f : 1e-20f));
+		}
+
+		float closest = a_maxDistance;
+		bool hit = false;
+
+		struct Entry
+		{
+			int32_t node;
+			float distance;
+		};
+		Entry stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = { 0, 0.0f };
+
+		while (top > 0)
+		{
+			Entry entry = stack[--top];
+			if (entry.distance > closest)
+				continue;
+
+			const Node& node = m_nodes[entry.node];
+			float entries[4];
+			int hits = 0;
+
+#ifdef SNS_BVH_SSE
+			__m128 ox = _mm_set1_ps(a_origin.x), oy = _mm_set1_ps(a_origin.y), oz = _mm_set1_ps(a_origin.z);
+			__m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+			__m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+			__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+			__m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+			__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+			__m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+			__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+
+			__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+				_mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+			__m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+				_mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(closest)));
+			hits = _mm_movemask_ps(_mm_cmple_ps(enter, leave));
+			_mm_storeu_ps(entries, enter);
+#else
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				glm::vec3 t0 = (glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]) - a_origin) * inverse;
+				glm::vec3 t1 = (glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]) - a_origin) * inverse;
+				glm::vec3 lower = glm::min(t0, t1);
+				glm::vec3 upper = glm::max(t0, t1);
+				entries[slot] = std::max(std::max(lower.x, lower.y), std::max(lower.z, 0.0f));
+				float leave = std::min(std::min(upper.x, upper.y), std::min(upper.z, closest));
+				hits |= entries[slot] <= leave ? 1 << slot : 0;
+			}
+#endif
+
+			// The children hit, nearest first.
+			unsigned int order[4];
+			unsigned int orderCount = 0;
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				if (node.first[slot] == EMPTY || (hits & (1 << slot)) == 0)
+					continue;
+				unsigned int i = orderCount++;
+				for (; i > 0 && entries[order[i - 1]] > entries[slot]; --i)
+					order[i] = order[i - 1];
+				order[i] = slot;
+			}
+
+			// Leaves are tested now, nearest first, so the closest hit is
+			//	as close as it can be before the nodes are pushed.
+			for (unsigned int i = 0; i < orderCount; ++i)
+			{
+				unsigned int slot = order[i];
+				if (node.count[slot] == 0 || entries[slot] > closest)
+					continue;
+
+				for (uint32_t j = (uint32_t)node.first[slot]; j < (uint32_t)node.first[slot] + node.count[slot]; ++j)
+				{
+					uint32_t primitive = m_primitives[j];
+					float distance;
+					if (a_intersect)
+						distance = a_intersect(primitive, closest);
+					else
+					{
+						const Box& box = m_boxes[primitive];
+						glm::vec3 t0 = (box.min - a_origin) * inverse;
+						glm::vec3 t1 = (box.max - a_origin) * inverse;
+						glm::vec3 lower = glm::min(t0, t1);
+						glm::vec3 upper = glm::max(t0, t1);
+						distance = std::max(std::max(lower.x, lower.y), std::max(lower.z, 0.0f));
+						if (distance > std::min(std::min(upper.x, upper.y), upper.z))
+							distance = -1.0f;
+					}
+
+					if (distance >= 0.0f && distance <= closest)
+					{
+						closest = distance;
+						a_hit = { primitive, distance };
+						hit = true;
+					}
+				}
+			}
+
+			for (unsigned int i = orderCount; i > 0; --i)
+			{
+				unsigned int slot = order[i - 1];
+				if (node.count[slot] == 0 && entries[slot] <= closest)
+					stack[top++] = { node.first[slot], entries[slot] };
+			}
+		}
+		return hit;
+	}
+
+	/**
+		getBounds returns the bounds of every primitive, the root's.
+	*/
+	Bvh::Box Bvh::getBounds() const
+	{
+		return m_nodes.empty() ? Box{ glm::vec3(0), glm::vec3(0) } : getNodeBox(m_nodes[0]);
+	}
+
+	/**
+		setSlot sets a node's slot to a box.
+	*/
+	void Bvh::setSlot(Node& a_node, unsigned int a_slot, const Box& a_box)
+	{
+		a_node.minX[a_slot] = a_box.min.x;
+		a_node.minY[a_slot] = a_box.min.y;
+		a_node.minZ[a_slot] = a_box.min.z;
+		a_node.maxX[a_slot] = a_box.max.x;
+		a_node.maxY[a_slot] = a_box.max.y;
+		a_node.maxZ[a_slot] = a_box.max.z;
+	}
+
+	/**
+		clearSlot empties a node's slot. Its bounds are inside out, so
+			they are never overlapped, nor counted in a union.
+	*/
+	void Bvh::clearSlot(Node& a_node, unsigned int a_slot)
+	{
+		setSlot(a_node, a_slot, emptyBox());
+		a_node.first[a_slot] = EMPTY;
+		a_node.count[a_slot] = 0;
+	}
+
+	/**
+		getNodeBox returns the union of a node's children.
+	*/
+	Bvh::Box Bvh::getNodeBox(const Node& a_node) const
+	{
+		Box box = emptyBox();
+		for (unsigned int slot = 0; slot < 4; ++slot)
+		{
+			if (a_node.first[slot] == EMPTY)
+				continue;
+			grow(box, { glm::vec3(a_node.minX[slot], a_node.minY[slot], a_node.minZ[slot]),
+				glm::vec3(a_node.maxX[slot], a_node.maxY[slot], a_node.maxZ[slot]) });
+		}
+		return box;
+	}
+
+	/**
+		getLeafBox returns the union of a leaf's primitives.
+	*/
+	Bvh::Box Bvh::getLeafBox(uint32_t a_first, uint32_t a_count) const
+	{
+		Box box = emptyBox();
+		for (uint32_t i = a_first; i < a_first + a_count; ++i)
+			grow(box, m_boxes[m_primitives[i]]);
+		return box;
+	}
+
+	/**
+		addSubtree adds every primitive below a node, without testing
+			them, for nodes entirely inside a query.
+	*/
+	void Bvh::addSubtree(int32_t a_node, std::vector<unsigned int>& a_primitives) const
+	{
+		int32_t stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = a_node;
+		while (top > 0)
+		{
+			const Node& node = m_nodes[stack[--top]];
+			for (unsigned int slot = 0; slot < 4; ++slot)
+			{
+				if (node.first[slot] == EMPTY)
+					continue;
+				if (node.count[slot] == 0)
+				{
+					stack[top++] = node.first[slot];
+					continue;
+				}
+				for (uint32_t i = (uint32_t)node.first[slot]; i < (uint32_t)node.first[slot] + node.count[slot]; ++i)
+					a_primitives.push_back(m_primitives[i]);
+			}
+		}
+	}
+}
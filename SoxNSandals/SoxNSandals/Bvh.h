@@ -0,0 +1,240 @@
+/**
+	Bvh.h
+
+	Purpose: Bvh.h is the header file for the Bvh class. The Bvh is a
+			bounding volume hierarchy over boxes, so the few near a
+			frustum, a ray or a box are found without testing all of
+			them.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace sns
+{
+	class Frustum;
+
+	/**
+		The Bvh class is built over a list of boxes, each a primitive the
+			caller knows by its index in the list, such as a mesh chunk
+			or a triangle.
+
+		It is built as a binary tree split by the surface area heuristic,
+			then flattened into nodes of four children in depth first
+			order. Each node holds its children's bounds as structure of
+			arrays, so a query tests all four against a plane or a ray
+			at once with SSE, and a node is two cache lines.
+
+		Boxes that move are updated in place and refit, which grows or
+			shrinks only the nodes above them. The tree isn't rebuilt,
+			so objects that move far from where they were built get
+			slower to find, until build is called again.
+	*/
+	class Bvh
+	{
+	public:
+		/**
+			An axis aligned box.
+		*/
+		struct Box
+		{
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+
+		/**
+			A ray query's hit, the primitive and how far along the ray.
+		*/
+		struct Hit
+		{
+			unsigned int primitive;
+			float distance;
+		};
+
+		/**
+			Tests a primitive against a ray, returning how far along it
+				the primitive is hit, or a negative number for a miss. It
+				is given the closest hit so far, so it can stop early.
+		*/
+		typedef std::function<float(unsigned int a_primitive, float a_maxDistance)> IntersectFunction;
+
+		// Primitives a leaf holds at most. Four keeps a leaf to one SSE
+		//	test after its node's.
+		static const unsigned int MAX_LEAF_SIZE = 4;
+
+		// The child slot of a node that has nothing in it.
+		static const int32_t EMPTY = -1;
+
+		/**
+			Four children's bounds, then what each is. A child with a count
+				is a leaf, first indexing the leaf order, otherwise first
+				is a node, or EMPTY, with inside out bounds. The layout is
+				std430's for four vec4s of each bound then an ivec4 and a
+				uvec4, so shaders can walk the nodes as they are.
+		*/
+		struct alignas(16) Node
+		{
+			float minX[4], minY[4], minZ[4];
+			float maxX[4], maxY[4], maxZ[4];
+			int32_t first[4];
+			uint32_t count[4];
+		};
+
+		Bvh();
+
+		/**
+			build builds the tree over a list of boxes. The list is
+				copied, so update can refit it later.
+
+				@param1 a_boxes is every primitive's bounds.
+
+				@param2 a_count is how many there are.
+		*/
+		void build(const Box* a_boxes, unsigned int a_count);
+
+		/**
+			clear empties the tree.
+		*/
+		void clear();
+
+		/**
+			update changes a primitive's bounds. The nodes above it are
+				only refit on the next refit.
+
+				@param1 a_primitive is the primitive's index.
+
+				@param2 a_box is its new bounds.
+		*/
+		void update(unsigned int a_primitive, const Box& a_box);
+
+		/**
+			refit refits the nodes above every primitive updated since the
+				last refit, from its leaf up to the root, stopping early
+				where a node's bounds didn't change.
+		*/
+		void refit();
+
+		/**
+			queryFrustum finds every primitive whose box is at least
+				partly inside a frustum. The children of a node entirely
+				inside it are added without being tested.
+
+				@param1 a_frustum is the frustum.
+
+				@param2 a_primitives has the primitives found added.
+
+				@return how many were found.
+		*/
+		unsigned int queryFrustum(const Frustum& a_frustum, std::vector<unsigned int>& a_primitives) const;
+
+		/**
+			queryBox finds every primitive whose box overlaps a box.
+
+				@param1 a_box is the box.
+
+				@param2 a_primitives has the primitives found added.
+
+				@return how many were found.
+		*/
+		unsigned int queryBox(const Box& a_box, std::vector<unsigned int>& a_primitives) const;
+
+		/**
+			intersectRay finds the closest primitive a ray hits. Nodes
+				are visited nearest first, and any further than the
+				closest hit so far are skipped.
+
+				@param1 a_origin is where the ray starts.
+
+				@param2 a_direction is the way it goes, which needn't be
+						unit length, distances are in lengths of it.
+
+				@param3 a_maxDistance is how far along it to look.
+
+				@param4 a_intersect tests a primitive, or an empty
+						function to hit the primitives' boxes.
+
+				@param5 a_hit is set to the closest hit.
+
+				@return false if nothing was hit.
+		*/
+		bool intersectRay(const glm::vec3& a_origin, const glm::vec3& a_direction, float a_maxDistance,
+			const IntersectFunction& a_intersect, Hit& a_hit) const;
+
+		/**
+			getBounds returns the bounds of every primitive.
+		*/
+		Box getBounds() const;
+
+		/**
+			getPrimitiveBox returns a primitive's bounds, as last built or
+				updated.
+		*/
+		const Box& getPrimitiveBox(unsigned int a_primitive) const { return m_boxes[a_primitive]; }
+
+		/**
+			getNodeCount returns how many nodes of four the tree has.
+		*/
+		unsigned int getNodeCount() const { return (unsigned int)m_nodes.size(); }
+
+		/**
+			getPrimitiveCount returns how many primitives it was built over.
+		*/
+		unsigned int getPrimitiveCount() const { return (unsigned int)m_boxes.size(); }
+
+		/**
+			isBuilt returns whether the tree has anything in it.
+		*/
+		bool isBuilt() const { return m_nodes.empty() == false; }
+
+		/**
+			getNodes returns the nodes, the root first, for walking the
+				tree somewhere else, such as a shader.
+		*/
+		const std::vector<Node>& getNodes() const { return m_nodes; }
+
+		/**
+			getLeafPrimitives returns the primitives in leaf order, which
+				the leaves' first and count index.
+		*/
+		const std::vector<uint32_t>& getLeafPrimitives() const { return m_primitives; }
+
+	private:
+
+		/**
+			Where each node and leaf hangs from, for refitting upwards.
+		*/
+		struct Parent
+		{
+			int32_t node;
+			uint32_t slot;
+		};
+
+		// Sets a node's slot to a box, or empties it.
+		static void setSlot(Node& a_node, unsigned int a_slot, const Box& a_box);
+		static void clearSlot(Node& a_node, unsigned int a_slot);
+
+		// The union of a node's children, or a leaf's primitives.
+		Box getNodeBox(const Node& a_node) const;
+		Box getLeafBox(uint32_t a_first, uint32_t a_count) const;
+
+		// Every primitive below a node, for nodes entirely inside.
+		void addSubtree(int32_t a_node, std::vector<unsigned int>& a_primitives) const;
+
+		std::vector<Node> m_nodes;
+		std::vector<Parent> m_parents;
+
+		// The primitives in leaf order, and each primitive's place in it.
+		std::vector<uint32_t> m_primitives;
+		std::vector<uint32_t> m_leafOf;
+
+		// Each primitive's bounds, in its own order.
+		std::vector<Box> m_boxes;
+
+		// The leaves updated since the last refit, as node * 4 + slot.
+		std::vector<uint32_t> m_dirtyLeaves;
+	};
+}
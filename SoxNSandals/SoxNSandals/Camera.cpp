@@ -14,6 +14,7 @@
 	Constructor that initializes the variables to default values.
 */
 Camera::Camera()
+	: version(0), reverseZ(false)
 {
 	// Assigning all of the variables to have default values.
 	//	If it is a matrix, set it as an identity matrix.
@@ -39,12 +40,19 @@ Camera::~Camera()
 /**
 	updateProjectionViewTransform creates the projectionViewTransform.
 		this must be called any time there are any changes to the
-		projectionViewTransform to recalculate it.
+		projectionViewTransform to recalculate it. It also updates the
+		frustum and position and bumps the version.
 */
 void Camera::updateProjectionViewTransform()
 {
 	// Calculate the Projection View Matrix.
 	projectionViewTransform = projectionTransform * viewTransform;
+
+	// Work out everything else from it now, once, rather than every
+	//	time something asks.
+	frustum.setMatrix(projectionViewTransform);
+	position = glm::vec3(worldTransform[3]);
+	++version;
 }
 
 /**
@@ -61,13 +69,63 @@ void Camera::updateProjectionViewTransform()
 */
 void Camera::setPerspective(const float &fieldOfView, const float &aspectRatio, const float &fnear, const float &ffar)
 {
+	// Keep what it was set with, so it can be made again reversed.
+	this->fieldOfView = fieldOfView;
+	this->aspectRatio = aspectRatio;
+	nearPlane = fnear;
+	farPlane = ffar;
+
 	// Calculate the projection transform.
-	projectionTransform = glm::perspective(fieldOfView, aspectRatio, fnear, ffar);
+	if (reverseZ)
+	{
+		// Clip z is the near plane and w the view depth, so depth is
+		//	near / depth, 1 at the near plane and 0 at infinity.
+		float focalLength = 1.0f / std::tan(fieldOfView * 0.5f);
+		projectionTransform = glm::mat4(0);
+		projectionTransform[0][0] = focalLength / aspectRatio;
+		projectionTransform[1][1] = focalLength;
+		projectionTransform[2][3] = -1.0f;
+		projectionTransform[3][2] = fnear;
+	}
+	else
+		projectionTransform = glm::perspective(fieldOfView, aspectRatio, fnear, ffar);
 
 	// Update it so that the new version of it is applied.
 	updateProjectionViewTransform();
 }
 
+/**
+	setReverseZ switches the projection between GL's usual one and a
+		reversed, infinite one.
+
+		@param1 reverseZ is whether the projection is reversed.
+*/
+void Camera::setReverseZ(bool reverseZ)
+{
+	this->reverseZ = reverseZ;
+	setPerspective(fieldOfView, aspectRatio, nearPlane, farPlane);
+}
+
+/**
+	getNear returns the near plane the perspective was set with.
+
+		@return nearPlane is the distance to the near plane.
+*/
+float Camera::getNear() const
+{
+	return nearPlane;
+}
+
+/**
+	getFar returns the far plane the perspective was set with.
+
+		@return farPlane is the distance to the far plane.
+*/
+float Camera::getFar() const
+{
+	return farPlane;
+}
+
 /**
 	setLookAt sets what the camera is looking at using multiple vec3s from, to and up.
 
@@ -82,8 +140,9 @@ void Camera::setLookAt(const glm::vec3 &from, const glm::vec3 &to, const glm::ve
 	// Calculates the view transform.
 	viewTransform = glm::lookAt(from, to, up);
 
-	// The world transform is the inverse of the view transform.
-	worldTransform = glm::inverse(viewTransform);
+	// The world transform is the inverse of the view transform. It's only
+	//	rotation and translation, so the affine inverse is enough.
+	worldTransform = glm::affineInverse(viewTransform);
 
 	// Update it to apply it to the scene.
 	updateProjectionViewTransform();
@@ -100,7 +159,24 @@ void Camera::setPos(const glm::vec3 &position)
 	worldTransform[3] = glm::vec4(position, worldTransform[3][3]);
 
 	// Calculates the view transform which is the inverse of the world transform.
-	viewTransform = glm::inverse(worldTransform);
+	viewTransform = glm::affineInverse(worldTransform);
+
+	// Update it to apply it to the scene.
+	updateProjectionViewTransform();
+}
+
+/**
+	setWorldTransform places the camera, for a replay.
+
+		@param1 transform is the camera's new place in world space,
+			only rotation and translation.
+*/
+void Camera::setWorldTransform(const glm::mat4 &transform)
+{
+	worldTransform = transform;
+
+	// Calculates the view transform which is the inverse of the world transform.
+	viewTransform = glm::affineInverse(worldTransform);
 
 	// Update it to apply it to the scene.
 	updateProjectionViewTransform();
@@ -111,7 +187,7 @@ void Camera::setPos(const glm::vec3 &position)
 
 		@return worldTransform is the camera's current place in world space.
 */
-glm::mat4 Camera::getWorldTransform() const
+const glm::mat4& Camera::getWorldTransform() const
 {
 	return worldTransform;
 }
@@ -121,7 +197,7 @@ glm::mat4 Camera::getWorldTransform() const
 
 		@return viewTransform of the camera.
 */
-glm::mat4 Camera::getView() const
+const glm::mat4& Camera::getView() const
 {
 	return viewTransform;
 }
@@ -132,7 +208,7 @@ glm::mat4 Camera::getView() const
 		@return projectionTransform which is the current projection transform
 			of camera.
 */
-glm::mat4 Camera::getProjection() const
+const glm::mat4& Camera::getProjection() const
 {
 	return projectionTransform;
 }
@@ -143,27 +219,39 @@ glm::mat4 Camera::getProjection() const
 		@return projectionViewTransform is the current projection view
 			transform of the camera.
 */
-glm::mat4 Camera::getProjectionView() const
+const glm::mat4& Camera::getProjectionView() const
 {
 	return projectionViewTransform;
 }
 
 /**
-	getPosition extracts the current position of the camera from the
-		worldTransform then returns it.
+	getPosition returns the position of the camera, extracted from the
+		worldTransform when it last changed.
 
-	@return tempv3 is the position xyz of the camera.
+	@return position is the position xyz of the camera.
 */
-glm::vec3 Camera::getPosition() const
+const glm::vec3& Camera::getPosition() const
 {
-	// Create a temporary vec3.
-	glm::vec3 tempv3;
+	return position;
+}
+
+/**
+	getFrustum returns the planes of the projection view, in world space.
+
+		@return frustum is the camera's current frustum.
+*/
+const sns::Frustum& Camera::getFrustum() const
+{
+	return frustum;
+}
 
-	// Extract the position from the camera's world transform.
-	tempv3.x = worldTransform[3].x;
-	tempv3.y = worldTransform[3].y;
-	tempv3.z = worldTransform[3].z;
+/**
+	getVersion returns a count that goes up every time the camera's
+		transforms change.
 
-	// return it as a vec3.
-	return tempv3;
+		@return version is the current version of the camera.
+*/
+unsigned int Camera::getVersion() const
+{
+	return version;
 }
@@ -9,11 +9,19 @@
 */
 #pragma once
 #include "soxCore.h"
+#include "Frustum.h"
+#include "Input.h"
 
 /**
 	The Camera class allows creation of a camera for the scene.
 		It allows you to set position, the direction of what it's looking at,
 		set the perspective.
+
+	Everything worked out from the transforms, the projection view, the
+		frustum and the position, is kept up to date whenever they change,
+		so the getters hand out references and never recalculate. The
+		version goes up with every change, so anything built from the
+		camera can check it and skip rebuilding when it hasn't moved.
 */
 class Camera
 {
@@ -34,10 +42,10 @@ public:
 
 			@param1 deltaTime is a double that the current frame rate.
 
-			@param2 a_glfwWindow is a pointer to get the memory address of the application's
-				window.
+			@param2 a_input is the keyboard and mouse, as they were at the
+				start of the frame.
 	*/
-	virtual void update(double deltaTime, GLFWwindow* a_glfwWindow) = 0;
+	virtual void update(double deltaTime, const sns::Input& a_input) = 0;
 
 	/**
 		SetPerspective takes in all of the necessary values needed to calculate the perpective.
@@ -53,6 +61,34 @@ public:
 	*/
 	void setPerspective(const float &fieldOfView, const float &aspectRatio, const float &fnear, const float &ffar);
 
+	/**
+		setReverseZ switches the projection between GL's usual one and a
+			reversed one, made for depth from 0 to 1 in clip space, that
+			puts the near plane at 1 and infinity at 0. Reversed there
+			is no far plane, so nothing is clipped by distance, but the
+			far plane is still kept for getFar.
+
+			@param1 reverseZ is whether the projection is reversed, which
+					must match sns::RenderState::isReverseZ.
+	*/
+	void setReverseZ(bool reverseZ);
+
+	/**
+		getNear returns the near plane the perspective was set with.
+
+			@return nearPlane is the distance to the near plane.
+	*/
+	float getNear() const;
+
+	/**
+		getFar returns the far plane the perspective was set with. A
+			reversed projection doesn't clip there, but it is still how
+			far the lights are clustered and shadowed out to.
+
+			@return farPlane is the distance to the far plane.
+	*/
+	float getFar() const;
+
 	/**
 		setLookAt sets what the camera is looking at using multiple vec3s from, to and up.
 
@@ -71,19 +107,27 @@ public:
 	*/
 	void setPos(const glm::vec3 &position);
 
+	/**
+		setWorldTransform places the camera, for a replay.
+
+			@param1 transform is the camera's new place in world space,
+				only rotation and translation.
+	*/
+	void setWorldTransform(const glm::mat4 &transform);
+
 	/**
 		getWorldTransform returns the current world transform of the camera.
 
 			@return worldTransform is the camera's current place in world space.
 	*/
-	glm::mat4 getWorldTransform() const;
+	const glm::mat4& getWorldTransform() const;
 
 	/**
 		getView returns the view transform of the camera.
 
 			@return viewTransform of the camera.
 	*/
-	glm::mat4 getView() const;
+	const glm::mat4& getView() const;
 
 	/**
 		getProjection returns the current projection transform of the camera.
@@ -91,7 +135,7 @@ public:
 			@return projectionTransform which is the current projection transform
 					of camera.
 	*/
-	glm::mat4 getProjection() const;
+	const glm::mat4& getProjection() const;
 
 	/**
 		getProjectionView gets the current projectionView of the camera.
@@ -99,22 +143,38 @@ public:
 			@return projectionViewTransform is the current projection view 
 				transform of the camera.
 	*/
-	glm::mat4 getProjectionView() const;
+	const glm::mat4& getProjectionView() const;
+
+	/**
+		getPosition returns the position of the camera, extracted from the
+			worldTransform when it last changed.
+
+			@return position is the position xyz of the camera.
+	*/
+	const glm::vec3& getPosition() const;
+
+	/**
+		getFrustum returns the planes of the projection view, in world space.
+
+			@return frustum is the camera's current frustum.
+	*/
+	const sns::Frustum& getFrustum() const;
 
 	/**
-		getPosition extracts the current position of the camera from the 
-			worldTransform then returns it.
+		getVersion returns a count that goes up every time the camera's
+			transforms change.
 
-			@return tempv3 is the position xyz of the camera.
+			@return version is the current version of the camera.
 	*/
-	glm::vec3 getPosition() const;
+	unsigned int getVersion() const;
 
 protected:
 
 	/**
 		updateProjectionViewTransform creates the projectionViewTransform.
 			this must be called any time there are any changes to the 
-			projectionViewTransform to recalculate it.
+			projectionViewTransform to recalculate it. It also updates the
+			frustum and position and bumps the version.
 	*/
 	void updateProjectionViewTransform();
 
@@ -130,5 +190,22 @@ protected:
 	// The projectionViewTransform of the camera.
 	glm::mat4 projectionViewTransform;
 
+	// The planes of the projectionViewTransform.
+	sns::Frustum frustum;
+
+	// The position of the camera, out of the worldTransform.
+	glm::vec3 position;
+
+	// Goes up every time updateProjectionViewTransform is called.
+	unsigned int version;
+
+	// What the perspective was last set with.
+	float fieldOfView;
+	float aspectRatio;
+	float nearPlane;
+	float farPlane;
+
+	// Whether the projection is reversed.
+	bool reverseZ;
 
 };
\ No newline at end of file
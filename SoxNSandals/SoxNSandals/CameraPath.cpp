@@ -0,0 +1,124 @@
+/**
+	CameraPath.cpp
+
+	Purpose: CameraPath.cpp is the source file for the CameraPath class.
+			The CameraPath is a looping spline of camera positions and
+			targets, so a camera can fly the same route every run.
+
+	@author Nathan Nette
+*/
+#include "CameraPath.h"
+#include <glm/gtx/spline.hpp>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	/**
+		load reads a path from a text file. Each line is a point, six
+			numbers for its position and target. Empty lines and lines
+			starting with # are skipped.
+
+			@param1 a_filename is the path file.
+
+			@return false if the file couldn't be read or has fewer
+					than 2 points.
+	*/
+	bool CameraPath::load(const char* a_filename)
+	{
+		FILE* file = nullptr;
+		fopen_s(&file, a_filename, "r");
+		if (file == nullptr)
+		{
+			printf("Failed to read camera path %s\n", a_filename);
+			return false;
+		}
+
+		m_points.clear();
+		char line[256];
+		unsigned int lineNumber = 0;
+		while (fgets(line, sizeof(line), file) != nullptr)
+		{
+			++lineNumber;
+
+			Point point;
+			int read = sscanf_s(line, "%f %f %f %f %f %f",
+				&point.position.x, &point.position.y, &point.position.z,
+				&point.target.x, &point.target.y, &point.target.z);
+
+			if (read == 6)
+				m_points.push_back(point);
+			else if (read > 0)
+				printf("%s(%u): expected a position and a target\n", a_filename, lineNumber);
+		}
+		fclose(file);
+
+		if (m_points.size() < 2)
+		{
+			printf("Camera path %s needs at least 2 points\n", a_filename);
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		createSponza makes a loop through the ground floor of the Sponza
+			atrium, then up past the upper galleries, looking across
+			the middle of the building.
+	*/
+	void CameraPath::createSponza()
+	{
+		m_points.clear();
+		addPoint(glm::vec3(-380, 40, 0), glm::vec3(0, 80, 0));
+		addPoint(glm::vec3(-150, 60, -100), glm::vec3(150, 80, -100));
+		addPoint(glm::vec3(150, 60, -100), glm::vec3(380, 60, 0));
+		addPoint(glm::vec3(380, 120, 0), glm::vec3(0, 150, 0));
+		addPoint(glm::vec3(150, 220, 100), glm::vec3(-150, 100, 100));
+		addPoint(glm::vec3(-150, 60, 100), glm::vec3(-380, 60, 0));
+	}
+
+	/**
+		addPoint adds a point to the end of the path.
+
+			@param1 a_position is where the camera is.
+
+			@param2 a_target is what the camera looks at.
+	*/
+	void CameraPath::addPoint(const glm::vec3& a_position, const glm::vec3& a_target)
+	{
+		Point point;
+		point.position = a_position;
+		point.target = a_target;
+		m_points.push_back(point);
+	}
+
+	/**
+		sample finds where on the path the camera is. The path loops,
+			so the last point curves back into the first.
+
+			@param1 a_time is how far around the path, 0 to 1. Larger
+					values wrap around.
+
+			@param2 a_position receives the camera's position.
+
+			@param3 a_target receives what the camera looks at.
+	*/
+	void CameraPath::sample(float a_time, glm::vec3& a_position, glm::vec3& a_target) const
+	{
+		if (m_points.empty())
+			return;
+
+		unsigned int count = (unsigned int)m_points.size();
+		float segment = (a_time - std::floor(a_time)) * count;
+		unsigned int index = (unsigned int)segment % count;
+		float t = segment - std::floor(segment);
+
+		const Point& p0 = m_points[(index + count - 1) % count];
+		const Point& p1 = m_points[index];
+		const Point& p2 = m_points[(index + 1) % count];
+		const Point& p3 = m_points[(index + 2) % count];
+
+		a_position = glm::catmullRom(p0.position, p1.position, p2.position, p3.position, t);
+		a_target = glm::catmullRom(p0.target, p1.target, p2.target, p3.target, t);
+	}
+}
@@ -0,0 +1,76 @@
+/**
+	CameraPath.h
+
+	Purpose: CameraPath.h is the header file for the CameraPath class.
+			The CameraPath is a looping spline of camera positions and
+			targets, so a camera can fly the same route every run.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The CameraPath class goes through its points on a closed
+			Catmull-Rom spline, spending the same time between each
+			pair of points.
+	*/
+	class CameraPath
+	{
+	public:
+		/**
+			A point of the path, where the camera is and what it looks at.
+		*/
+		struct Point
+		{
+			glm::vec3 position;
+			glm::vec3 target;
+		};
+
+		/**
+			load reads a path from a text file. Each line is a point,
+				six numbers for its position and target. Empty lines
+				and lines starting with # are skipped.
+
+				@param1 a_filename is the path file.
+
+				@return false if the file couldn't be read or has
+						fewer than 2 points.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			createSponza makes the path the benchmark flies through the
+				Sponza atrium when no path file is given.
+		*/
+		void createSponza();
+
+		/**
+			addPoint adds a point to the end of the path.
+		*/
+		void addPoint(const glm::vec3& a_position, const glm::vec3& a_target);
+
+		/**
+			sample finds where on the path the camera is.
+
+				@param1 a_time is how far around the path, 0 to 1.
+						Larger values wrap around.
+
+				@param2 a_position receives the camera's position.
+
+				@param3 a_target receives what the camera looks at.
+		*/
+		void sample(float a_time, glm::vec3& a_position, glm::vec3& a_target) const;
+
+		/**
+			getPointCount returns how many points the path has.
+		*/
+		unsigned int getPointCount() const { return (unsigned int)m_points.size(); }
+
+	private:
+		std::vector<Point> m_points;
+	};
+}
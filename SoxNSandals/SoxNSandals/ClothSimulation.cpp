@@ -0,0 +1,549 @@
+/**
+	ClothSimulation.cpp
+
+	Purpose: ClothSimulation.cpp is the source file for the ClothSimulation
+			class. The ClothSimulation moves a mesh's vertices as cloth
+			hanging from its top edge, such as the curtains and ribbons
+			of the courtyard, in compute shaders.
+
+	@author Nathan Nette
+*/
+#include "ClothSimulation.h"
+#include "GpuMemory.h"
+#include "OBJMesh.h"
+#include "gl_core_4_5.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	// Must match local_size_x in the shader.
+	const unsigned int GROUP_SIZE = 256;
+
+	// The buffer bindings the shader reads and writes.
+	const unsigned int POSITION_BINDING = 0;
+	const unsigned int PREDICTED_BINDING = 1;
+	const unsigned int VELOCITY_BINDING = 2;
+	const unsigned int CONSTRAINT_BINDING = 3;
+	const unsigned int VERTEX_BINDING = 4;
+	const unsigned int TRIANGLE_BINDING = 5;
+	const unsigned int ADJACENCY_BINDING = 6;
+	const unsigned int MESH_BINDING = 7;
+
+	// What each pass of the shader does.
+	const int PASS_PREDICT = 0;
+	const int PASS_SOLVE = 1;
+	const int PASS_FINISH = 2;
+	const int PASS_WRITE = 3;
+
+	// The kinds of constraint.
+	const unsigned int STRETCH = 0;
+	const unsigned int BEND = 1;
+
+	const unsigned int NO_PARTICLE = 0xffffffffu;
+
+	/**
+		A constraint keeping two particles a distance apart, as the
+			shader reads it.
+	*/
+	struct Constraint
+	{
+		unsigned int a;
+		unsigned int b;
+		float restLength;
+		unsigned int kind;
+	};
+
+	/**
+		A vertex as the shader reads it. normalSign flips the normal the
+			triangles give to the side the mesh's faced.
+	*/
+	struct ClothVertex
+	{
+		glm::vec2 texcoord;
+		unsigned int particle;
+		float normalSign;
+	};
+
+	/**
+		Hashes a position by its bits, so only vertices in exactly the
+			same place are welded.
+	*/
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& a_position) const
+		{
+			unsigned int bits[3];
+			memcpy(bits, &a_position, sizeof(bits));
+			return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+		}
+	};
+
+	/**
+		createStorage makes a buffer for the shader, and tracks it.
+
+			@param1 a_buffer receives the buffer.
+
+			@param2 a_bytes is how big it is, at least 4.
+
+			@param3 a_data is what it starts as, or nullptr.
+	*/
+	void createStorage(sns::BufferHandle& a_buffer, size_t a_bytes, const void* a_data)
+	{
+		a_bytes = a_bytes < 4 ? 4 : a_bytes;
+		glCreateBuffers(1, a_buffer.put());
+		glNamedBufferStorage(a_buffer, a_bytes, a_data, 0);
+		sns::GpuMemory::instance().trackBuffer(a_buffer, a_bytes, sns::GpuMemory::MESHES, "ClothSimulation");
+	}
+
+	/**
+		findPiece returns the first particle of the piece of cloth a
+			particle is in, shortening the path to it on the way.
+
+			@param1 a_pieces is each particle's parent.
+
+			@param2 a_particle is the particle.
+	*/
+	unsigned int findPiece(std::vector<unsigned int>& a_pieces, unsigned int a_particle)
+	{
+		while (a_pieces[a_particle] != a_particle)
+		{
+			a_pieces[a_particle] = a_pieces[a_pieces[a_particle]];
+			a_particle = a_pieces[a_particle];
+		}
+		return a_particle;
+	}
+}
+
+namespace sns
+{
+	/**
+		The constructor makes light cloth in metres, hanging still from
+			its top 2cm, stepped 60 times a second.
+	*/
+	ClothSimulation::Settings::Settings()
+		: gravity(0, -9.81f, 0),
+		wind(0),
+		gust(0.5f),
+		gustScale(2.0f),
+		damping(0.5f),
+		stretchStiffness(1.0f),
+		bendStiffness(0.1f),
+		pinDistance(0.02f),
+		iterations(8),
+		timeStep(1.0f / 60.0f)
+	{
+	}
+
+	ClothSimulation::ClothSimulation()
+		: m_mesh(nullptr),
+		m_particleCount(0),
+		m_vertexCount(0),
+		m_accumulator(0),
+		m_time(0)
+	{
+	}
+
+	/**
+		create reads the mesh's vertices and full detail triangles back
+			from its buffers, which waits for the gpu once. Vertices in
+			the same place are welded into a particle, and the pieces
+			of cloth found from the triangles joining them, each pinned
+			within the pin distance of its highest particle. Every
+			edge is a stretch constraint, and the two corners across
+			an edge a bend constraint. The constraints are greedily
+			coloured, each taking the first colour neither of its
+			particles has yet.
+
+			@param1 a_mesh is the mesh, uploaded.
+
+			@param2 a_settings is what the cloth is like.
+
+			@return false without GL 4.5, the shader, or a full vertex
+					mesh with triangles.
+	*/
+	bool ClothSimulation::create(aie::OBJMesh& a_mesh, const Settings& a_settings)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("ClothSimulation: simulating cloth needs GL 4.5.\n");
+			return false;
+		}
+		if (a_mesh.isLoaded() == false || a_mesh.getVertexFormat() != aie::OBJMesh::FULL_VERTEX)
+		{
+			printf("ClothSimulation: %s isn't loaded with full vertices.\n", a_mesh.getFilename().c_str());
+			return false;
+		}
+		if (m_shader.getHandle() == 0)
+		{
+			m_shader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/cloth.comp");
+			if (m_shader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_shader.getLastError());
+				return false;
+			}
+		}
+
+		// Every chunk's vertices one after another, and their triangles.
+		std::vector<aie::OBJMesh::Vertex> meshVertices;
+		std::vector<glm::uvec4> triangles;
+		std::vector<unsigned char> indices;
+		for (unsigned int c = 0; c < a_mesh.getChunkCount(); ++c)
+		{
+			const aie::OBJMesh::MeshChunk& chunk = a_mesh.getChunk(c);
+			unsigned int first = (unsigned int)meshVertices.size();
+			m_chunkFirstVertex.push_back(first);
+			meshVertices.resize(first + chunk.vertexCount);
+			glGetNamedBufferSubData(chunk.vbo, 0, chunk.vertexCount * sizeof(aie::OBJMesh::Vertex),
+				meshVertices.data() + first);
+
+			unsigned int indexSize = aie::OBJMesh::getIndexSize(chunk.indexType);
+			indices.resize((size_t)chunk.lodIndexCount[0] * indexSize);
+			glGetNamedBufferSubData(chunk.ibo, (GLintptr)chunk.lodFirstIndex[0] * indexSize, indices.size(),
+				indices.data());
+			for (unsigned int i = 0; i + 2 < chunk.lodIndexCount[0]; i += 3)
+			{
+				glm::uvec4 triangle(0);
+				for (unsigned int corner = 0; corner < 3; ++corner)
+				{
+					if (indexSize == 2)
+						triangle[corner] = ((const unsigned short*)indices.data())[i + corner] + first;
+					else
+						triangle[corner] = ((const unsigned int*)indices.data())[i + corner] + first;
+				}
+				triangles.push_back(triangle);
+			}
+		}
+		m_chunkFirstVertex.push_back((unsigned int)meshVertices.size());
+		m_vertexCount = (unsigned int)meshVertices.size();
+		if (triangles.empty())
+		{
+			destroy();
+			return false;
+		}
+
+		// Weld the vertices split along seams back together.
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> welded;
+		std::vector<glm::vec4> positions;
+		std::vector<ClothVertex> vertices(m_vertexCount);
+		for (unsigned int v = 0; v < m_vertexCount; ++v)
+		{
+			glm::vec3 position(meshVertices[v].position);
+			auto found = welded.emplace(position, (unsigned int)positions.size());
+			if (found.second)
+				positions.push_back(glm::vec4(position, 1));
+			vertices[v] = { meshVertices[v].texcoord, found.first->second, 1.0f };
+		}
+		m_particleCount = (unsigned int)positions.size();
+
+		// Join the particles of each triangle into pieces of cloth, and
+		//	turn each vertex's normal to the side its own faced.
+		std::vector<unsigned int> pieces(m_particleCount);
+		for (unsigned int p = 0; p < m_particleCount; ++p)
+			pieces[p] = p;
+		std::vector<glm::vec3> particleNormals(m_particleCount, glm::vec3(0));
+		for (const glm::uvec4& triangle : triangles)
+		{
+			unsigned int a = vertices[triangle.x].particle;
+			unsigned int b = vertices[triangle.y].particle;
+			unsigned int c = vertices[triangle.z].particle;
+			pieces[findPiece(pieces, b)] = findPiece(pieces, a);
+			pieces[findPiece(pieces, c)] = findPiece(pieces, a);
+
+			glm::vec3 normal = glm::cross(glm::vec3(positions[b] - positions[a]), glm::vec3(positions[c] - positions[a]));
+			particleNormals[a] += normal;
+			particleNormals[b] += normal;
+			particleNormals[c] += normal;
+		}
+		for (unsigned int v = 0; v < m_vertexCount; ++v)
+		{
+			if (glm::dot(particleNormals[vertices[v].particle], glm::vec3(meshVertices[v].normal)) < 0.0f)
+				vertices[v].normalSign = -1.0f;
+		}
+
+		std::vector<float> pieceTops(m_particleCount, -FLT_MAX);
+		for (unsigned int p = 0; p < m_particleCount; ++p)
+		{
+			float& top = pieceTops[findPiece(pieces, p)];
+			top = glm::max(top, positions[p].y);
+		}
+		for (unsigned int p = 0; p < m_particleCount; ++p)
+		{
+			if (positions[p].y >= pieceTops[findPiece(pieces, p)] - a_settings.pinDistance)
+				positions[p].w = 0;
+		}
+
+		// An edge's first triangle leaves its far corner for the second
+		//	to bend against.
+		std::vector<Constraint> constraints;
+		std::unordered_map<unsigned long long, unsigned int> edges;
+		for (const glm::uvec4& triangle : triangles)
+		{
+			unsigned int corners[3] = { vertices[triangle.x].particle, vertices[triangle.y].particle,
+				vertices[triangle.z].particle };
+			for (unsigned int e = 0; e < 3; ++e)
+			{
+				unsigned int a = corners[e];
+				unsigned int b = corners[(e + 1) % 3];
+				unsigned int opposite = corners[(e + 2) % 3];
+				if (a == b || a == opposite || b == opposite)
+					continue;
+
+				unsigned long long key = ((unsigned long long)glm::min(a, b) << 32) | glm::max(a, b);
+				auto found = edges.emplace(key, opposite);
+				if (found.second)
+				{
+					constraints.push_back({ a, b, glm::distance(glm::vec3(positions[a]), glm::vec3(positions[b])), STRETCH });
+				}
+				else if (found.first->second != NO_PARTICLE && found.first->second != opposite)
+				{
+					unsigned int other = found.first->second;
+					constraints.push_back({ other, opposite,
+						glm::distance(glm::vec3(positions[other]), glm::vec3(positions[opposite])), BEND });
+					found.first->second = NO_PARTICLE;
+				}
+			}
+		}
+
+		// Colour them, leaving out the ones between pinned particles,
+		//	then sort them by colour.
+		std::vector<unsigned long long> used(m_particleCount, 0);
+		std::vector<unsigned int> colours(constraints.size(), MAX_COLOURS);
+		std::vector<unsigned int> colourCounts(MAX_COLOURS, 0);
+		unsigned int dropped = 0;
+		for (size_t i = 0; i < constraints.size(); ++i)
+		{
+			const Constraint& constraint = constraints[i];
+			if (positions[constraint.a].w == 0 && positions[constraint.b].w == 0)
+				continue;
+
+			unsigned long long taken = used[constraint.a] | used[constraint.b];
+			unsigned int colour = 0;
+			while (colour < MAX_COLOURS && (taken & (1ull << colour)) != 0)
+				++colour;
+			if (colour == MAX_COLOURS)
+			{
+				++dropped;
+				continue;
+			}
+			used[constraint.a] |= 1ull << colour;
+			used[constraint.b] |= 1ull << colour;
+			colours[i] = colour;
+			++colourCounts[colour];
+		}
+		if (dropped > 0)
+			printf("ClothSimulation: %u constraints of %s had no colour free.\n", dropped, a_mesh.getFilename().c_str());
+
+		unsigned int first = 0;
+		for (unsigned int colour = 0; colour < MAX_COLOURS && colourCounts[colour] > 0; ++colour)
+		{
+			m_colours.push_back({ first, colourCounts[colour] });
+			first += colourCounts[colour];
+		}
+		std::vector<Constraint> sorted(first);
+		std::vector<unsigned int> next(MAX_COLOURS, 0);
+		for (unsigned int colour = 0; colour < m_colours.size(); ++colour)
+			next[colour] = m_colours[colour].first;
+		for (size_t i = 0; i < constraints.size(); ++i)
+		{
+			if (colours[i] < MAX_COLOURS)
+				sorted[next[colours[i]]++] = constraints[i];
+		}
+
+		// The triangles around each particle, then around each vertex.
+		//	Each run's start is where it is in the same buffer.
+		unsigned int triangleCount = (unsigned int)triangles.size();
+		unsigned int startCount = m_particleCount + 1 + m_vertexCount + 1;
+		std::vector<unsigned int> adjacency(startCount + triangleCount * 6, 0);
+		unsigned int* particleStarts = adjacency.data();
+		unsigned int* vertexStarts = adjacency.data() + m_particleCount + 1;
+		for (const glm::uvec4& triangle : triangles)
+		{
+			for (unsigned int corner = 0; corner < 3; ++corner)
+			{
+				++particleStarts[vertices[triangle[corner]].particle + 1];
+				++vertexStarts[triangle[corner] + 1];
+			}
+		}
+		particleStarts[0] = startCount;
+		for (unsigned int p = 0; p < m_particleCount; ++p)
+			particleStarts[p + 1] += particleStarts[p];
+		vertexStarts[0] = particleStarts[m_particleCount];
+		for (unsigned int v = 0; v < m_vertexCount; ++v)
+			vertexStarts[v + 1] += vertexStarts[v];
+
+		std::vector<unsigned int> particleNext(particleStarts, particleStarts + m_particleCount);
+		std::vector<unsigned int> vertexNext(vertexStarts, vertexStarts + m_vertexCount);
+		for (unsigned int t = 0; t < triangleCount; ++t)
+		{
+			for (unsigned int corner = 0; corner < 3; ++corner)
+			{
+				adjacency[particleNext[vertices[triangles[t][corner]].particle]++] = t;
+				adjacency[vertexNext[triangles[t][corner]]++] = t;
+			}
+		}
+
+		std::vector<glm::vec4> zeros(m_particleCount, glm::vec4(0));
+		createStorage(m_positions, positions.size() * sizeof(glm::vec4), positions.data());
+		createStorage(m_predicted, positions.size() * sizeof(glm::vec4), positions.data());
+		createStorage(m_velocities, zeros.size() * sizeof(glm::vec4), zeros.data());
+		createStorage(m_constraints, sorted.size() * sizeof(Constraint), sorted.data());
+		createStorage(m_vertices, vertices.size() * sizeof(ClothVertex), vertices.data());
+		createStorage(m_triangles, triangles.size() * sizeof(glm::uvec4), triangles.data());
+		createStorage(m_adjacency, adjacency.size() * sizeof(unsigned int), adjacency.data());
+
+		m_mesh = &a_mesh;
+		m_settings = a_settings;
+		m_accumulator = 0;
+		m_time = 0;
+		return true;
+	}
+
+	/**
+		destroy deletes the buffers.
+	*/
+	void ClothSimulation::destroy()
+	{
+		m_adjacency.reset();
+		m_triangles.reset();
+		m_vertices.reset();
+		m_constraints.reset();
+		m_velocities.reset();
+		m_predicted.reset();
+		m_positions.reset();
+		m_colours.clear();
+		m_chunkFirstVertex.clear();
+		m_mesh = nullptr;
+		m_particleCount = 0;
+		m_vertexCount = 0;
+	}
+
+	/**
+		update steps the cloth on by however many whole steps fit in the
+			time. Past MAX_STEPS the rest is dropped, the cloth moves
+			slower rather than the frames. The vertices are only
+			written when it moved.
+
+			@param1 a_deltaTime is the time since the last update.
+	*/
+	void ClothSimulation::update(float a_deltaTime)
+	{
+		if (isCreated() == false || m_settings.timeStep <= 0.0f)
+			return;
+
+		m_accumulator += a_deltaTime;
+		unsigned int steps = 0;
+		while (m_accumulator >= m_settings.timeStep && steps < MAX_STEPS)
+		{
+			step();
+			m_accumulator -= m_settings.timeStep;
+			m_time += m_settings.timeStep;
+			++steps;
+		}
+		if (steps == MAX_STEPS)
+			m_accumulator = glm::min(m_accumulator, m_settings.timeStep);
+		if (steps > 0)
+			writeVertices();
+	}
+
+	/**
+		step predicts where every free particle is heading from its
+			velocity and the forces, pulls the predictions back
+			together colour by colour, then takes the velocity from how
+			far each moved. The stiffnesses are scaled so the cloth is
+			as stiff however many iterations it is solved in.
+	*/
+	void ClothSimulation::step()
+	{
+		static constexpr aie::UniformHandle PASS("Pass");
+		static constexpr aie::UniformHandle COUNT("Count");
+		static constexpr aie::UniformHandle FIRST("First");
+		static constexpr aie::UniformHandle DELTA_TIME("DeltaTime");
+		static constexpr aie::UniformHandle GRAVITY("Gravity");
+		static constexpr aie::UniformHandle WIND("Wind");
+		static constexpr aie::UniformHandle GUST("Gust");
+		static constexpr aie::UniformHandle TIME("Time");
+		static constexpr aie::UniformHandle DAMPING("Damping");
+		static constexpr aie::UniformHandle STIFFNESS("Stiffness");
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, m_positions);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PREDICTED_BINDING, m_predicted);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VELOCITY_BINDING, m_velocities);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CONSTRAINT_BINDING, m_constraints);
+
+		unsigned int iterations = glm::max(m_settings.iterations, 1u);
+		float rootIterations = 1.0f / iterations;
+		glm::vec2 stiffness(1.0f - std::pow(1.0f - glm::clamp(m_settings.stretchStiffness, 0.0f, 1.0f), rootIterations),
+			1.0f - std::pow(1.0f - glm::clamp(m_settings.bendStiffness, 0.0f, 1.0f), rootIterations));
+		unsigned int particleGroups = (m_particleCount + GROUP_SIZE - 1) / GROUP_SIZE;
+
+		m_shader.bind();
+		m_shader.bindUniform(PASS, PASS_PREDICT);
+		m_shader.bindUniform(COUNT, (int)m_particleCount);
+		m_shader.bindUniform(DELTA_TIME, m_settings.timeStep);
+		m_shader.bindUniform(GRAVITY, m_settings.gravity);
+		m_shader.bindUniform(WIND, m_settings.wind);
+		m_shader.bindUniform(GUST, glm::vec2(m_settings.gust, m_settings.gustScale));
+		m_shader.bindUniform(TIME, m_time);
+		m_shader.bindUniform(DAMPING, m_settings.damping);
+		m_shader.bindUniform(STIFFNESS, stiffness);
+		glDispatchCompute(particleGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		m_shader.bindUniform(PASS, PASS_SOLVE);
+		for (unsigned int iteration = 0; iteration < iterations; ++iteration)
+		{
+			for (const ColourRange& colour : m_colours)
+			{
+				m_shader.bindUniform(FIRST, (int)colour.first);
+				m_shader.bindUniform(COUNT, (int)colour.count);
+				glDispatchCompute((colour.count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			}
+		}
+
+		m_shader.bindUniform(PASS, PASS_FINISH);
+		m_shader.bindUniform(COUNT, (int)m_particleCount);
+		glDispatchCompute(particleGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	/**
+		writeVertices writes every chunk's vertices from the particles,
+			with normals and tangents from the triangles around them,
+			one dispatch a chunk into its own vertex buffer. The draws
+			after wait for the writes.
+	*/
+	void ClothSimulation::writeVertices()
+	{
+		static constexpr aie::UniformHandle PASS("Pass");
+		static constexpr aie::UniformHandle COUNT("Count");
+		static constexpr aie::UniformHandle FIRST("First");
+		static constexpr aie::UniformHandle VERTEX_STARTS("VertexStarts");
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, m_positions);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_BINDING, m_vertices);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRIANGLE_BINDING, m_triangles);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ADJACENCY_BINDING, m_adjacency);
+
+		m_shader.bind();
+		m_shader.bindUniform(PASS, PASS_WRITE);
+		m_shader.bindUniform(VERTEX_STARTS, (int)m_particleCount + 1);
+		for (unsigned int c = 0; c < m_mesh->getChunkCount(); ++c)
+		{
+			unsigned int count = m_chunkFirstVertex[c + 1] - m_chunkFirstVertex[c];
+			if (count == 0)
+				continue;
+
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, m_mesh->getChunk(c).vbo);
+			m_shader.bindUniform(FIRST, (int)m_chunkFirstVertex[c]);
+			m_shader.bindUniform(COUNT, (int)count);
+			glDispatchCompute((count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		}
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+}
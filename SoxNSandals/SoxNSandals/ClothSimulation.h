@@ -0,0 +1,212 @@
+/**
+	ClothSimulation.h
+
+	Purpose: ClothSimulation.h is the header file for the ClothSimulation
+			class. The ClothSimulation moves a mesh's vertices as cloth
+			hanging from its top edge, such as the curtains and ribbons
+			of the courtyard, in compute shaders.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	/**
+		The ClothSimulation class runs position based dynamics over an
+			OBJMesh, writing straight into the vertex buffers its chunks
+			are drawn from, so the mesh draws the cloth as it draws
+			anything else.
+
+		The vertices split along texture seams are welded back into one
+			particle each, and every edge of the triangles is kept at
+			its length, with a softer constraint across every pair of
+			triangles to keep the cloth from folding flat. Constraints
+			are coloured so no two of a colour share a particle, and
+			each colour is solved in one dispatch with no atomics.
+
+		Once moved, each vertex's normal comes from the triangles around
+			its particle and its tangent from the triangles around the
+			vertex itself, so the normal map follows the folds. Each
+			piece of cloth hangs from the particles near its highest
+			point. The vertices, chunk bounds and picking triangles
+			the mesh keeps on the cpu are left as they were loaded.
+
+		Only meshes of OBJMesh::FULL_VERTEX can be simulated, the buffers
+			are made with GL 4.5 and the shader needs GL 4.3.
+	*/
+	class ClothSimulation
+	{
+	public:
+		// The most steps update takes, so a slow frame can't make the
+		//	next one slower still.
+		static const unsigned int MAX_STEPS = 2;
+
+		// The most colours the constraints are split into. A constraint
+		//	that finds none free is left out.
+		static const unsigned int MAX_COLOURS = 64;
+
+		/**
+			What the cloth is like, in the mesh's space.
+		*/
+		struct Settings
+		{
+			glm::vec3 gravity;
+
+			// The wind's push, and how much of it comes and goes in
+			//	gusts across a distance of gustScale.
+			glm::vec3 wind;
+			float gust;
+			float gustScale;
+
+			// The share of the speed lost each second.
+			float damping;
+
+			// How much each solve puts the edges back to length, and the
+			//	pairs of triangles back to their fold, 0 to 1.
+			float stretchStiffness;
+			float bendStiffness;
+
+			// How far below its highest point a piece hangs from.
+			float pinDistance;
+
+			unsigned int iterations;
+			float timeStep;
+
+			/**
+				The constructor makes light cloth in metres, hanging
+					still.
+			*/
+			Settings();
+		};
+
+		ClothSimulation();
+
+		ClothSimulation(const ClothSimulation&) = delete;
+		ClothSimulation& operator=(const ClothSimulation&) = delete;
+
+		/**
+			create reads the mesh's vertices back from its buffers and
+				builds the particles and constraints over them.
+
+				@param1 a_mesh is the mesh, uploaded. It must outlive the
+						simulation, and the simulation must be made
+						again if the mesh is loaded again.
+
+				@param2 a_settings is what the cloth is like.
+
+				@return false without GL 4.5, the shader, or a full
+						vertex mesh with triangles.
+		*/
+		bool create(aie::OBJMesh& a_mesh, const Settings& a_settings);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_mesh != nullptr; }
+
+		/**
+			destroy deletes the buffers. The mesh's vertices stay where
+				the cloth left them.
+		*/
+		void destroy();
+
+		/**
+			update steps the cloth on by however many whole steps fit in
+				the time, carrying the rest over to the next update,
+				then writes the vertices.
+
+				@param1 a_deltaTime is the time since the last update.
+		*/
+		void update(float a_deltaTime);
+
+		/**
+			setSettings changes what the cloth is like. The pin distance
+				only applies to the next create.
+
+				@param1 a_settings is what the cloth is like.
+		*/
+		void setSettings(const Settings& a_settings) { m_settings = a_settings; }
+
+		/**
+			getSettings returns what the cloth is like.
+		*/
+		const Settings& getSettings() const { return m_settings; }
+
+		/**
+			getMesh returns the mesh being simulated, or nullptr.
+		*/
+		const aie::OBJMesh* getMesh() const { return m_mesh; }
+
+		/**
+			getParticleCount returns how many particles the vertices were
+				welded into.
+		*/
+		unsigned int getParticleCount() const { return m_particleCount; }
+
+	private:
+		/**
+			A run of the constraints sharing a colour.
+		*/
+		struct ColourRange
+		{
+			unsigned int first;
+			unsigned int count;
+		};
+
+		/**
+			step moves the particles once, solving every colour of
+				constraint the settings' iterations times.
+		*/
+		void step();
+
+		/**
+			writeVertices works out the normals and tangents and writes
+				every chunk's vertices.
+		*/
+		void writeVertices();
+
+		aie::ShaderProgram m_shader;
+		aie::OBJMesh* m_mesh;
+
+		// Each particle's position, w its inverse mass, 0 when pinned,
+		//	where it is heading this step, and its velocity.
+		BufferHandle m_positions;
+		BufferHandle m_predicted;
+		BufferHandle m_velocities;
+
+		BufferHandle m_constraints;
+		std::vector<ColourRange> m_colours;
+
+		// Each vertex's particle and texcoord, and the triangles as
+		//	vertices.
+		BufferHandle m_vertices;
+		BufferHandle m_triangles;
+
+		// The triangles around each particle then each vertex, as where
+		//	each one's run starts, then the runs, all in one buffer so
+		//	the shader needs no more than 8 bindings.
+		BufferHandle m_adjacency;
+
+		// Where each chunk's vertices start in m_vertices.
+		std::vector<unsigned int> m_chunkFirstVertex;
+
+		Settings m_settings;
+		unsigned int m_particleCount;
+		unsigned int m_vertexCount;
+
+		// The time left over from the last update, and the time the
+		//	gusts move with.
+		float m_accumulator;
+		float m_time;
+	};
+}
@@ -0,0 +1,102 @@
+/**
+	CommandList.cpp
+
+	Purpose: CommandList.cpp is the source file for the CommandList
+			class. A CommandList records draws without touching GL, so
+			it can be filled on any thread, and replays them on the
+			context thread.
+
+	@author Nathan Nette
+*/
+#include "CommandList.h"
+#include "OBJMesh.h"
+#include "ObjectBuffer.h"
+#include "Shader.h"
+#include "gl_core_4_5.h"
+
+namespace sns
+{
+	/**
+		bindProgram records a program change.
+
+			@param1 a_program is the program the draws after it use.
+	*/
+	void CommandList::bindProgram(aie::ShaderProgram* a_program)
+	{
+		Command command = {};
+		command.op = Op::PROGRAM;
+		command.program = a_program;
+		m_commands.push_back(command);
+	}
+
+	/**
+		selectObject records an ObjectBuffer index change.
+
+			@param1 a_object is the index the draws after it use.
+	*/
+	void CommandList::selectObject(unsigned int a_object)
+	{
+		Command command = {};
+		command.op = Op::OBJECT;
+		command.value = a_object;
+		m_commands.push_back(command);
+	}
+
+	/**
+		drawChunk records a draw of one chunk of a mesh with its material.
+
+			@param1 a_mesh is the mesh.
+
+			@param2 a_chunk is the chunk.
+
+			@param3 a_usePatches draws it with GL_PATCHES.
+
+			@param4 a_lod is its level of detail.
+
+			@param5 a_query is an occlusion query it is drawn on the result
+					of, 0 for none.
+	*/
+	void CommandList::drawChunk(const aie::OBJMesh* a_mesh, unsigned int a_chunk, bool a_usePatches,
+		unsigned int a_lod, unsigned int a_query)
+	{
+		Command command = {};
+		command.op = Op::DRAW;
+		command.usePatches = a_usePatches;
+		command.lod = (unsigned short)a_lod;
+		command.chunk = a_chunk;
+		command.value = a_query;
+		command.mesh = a_mesh;
+		m_commands.push_back(command);
+	}
+
+	/**
+		execute makes the commands GL calls, in the order they were
+			recorded. A draw on a query is skipped by the gpu if the
+			query is in by the time it gets there, and drawn if not.
+	*/
+	void CommandList::execute() const
+	{
+		for (const Command& command : m_commands)
+		{
+			switch (command.op)
+			{
+			case Op::PROGRAM:
+				command.program->bind();
+				break;
+			case Op::OBJECT:
+				ObjectBuffer::select(command.value);
+				break;
+			case Op::DRAW:
+				if (command.value != 0)
+				{
+					glBeginConditionalRender(command.value, GL_QUERY_NO_WAIT);
+					command.mesh->drawChunk(command.chunk, command.usePatches, command.lod);
+					glEndConditionalRender();
+				}
+				else
+					command.mesh->drawChunk(command.chunk, command.usePatches, command.lod);
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,117 @@
+/**
+	CommandList.h
+
+	Purpose: CommandList.h is the header file for the CommandList class.
+			A CommandList records draws without touching GL, so it can
+			be filled on any thread, and replays them on the context
+			thread.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+	class ShaderProgram;
+}
+
+namespace sns
+{
+	/**
+		The CommandList class is a list of the commands a pass's draws
+			are made of: programs, ObjectBuffer indices and mesh chunks,
+			each chunk drawn with its material and optionally on an
+			occlusion query. Recording only writes to the list, so a
+			list can be recorded by any one thread at a time while the
+			context thread executes others.
+
+		execute is where the commands become GL. It is the one place a
+			list is made into calls of a graphics api, so another
+			backend would replay the same lists its own way.
+	*/
+	class CommandList
+	{
+	public:
+		/**
+			bindProgram records a program change.
+
+				@param1 a_program is the program the draws after it use.
+		*/
+		void bindProgram(aie::ShaderProgram* a_program);
+
+		/**
+			selectObject records an ObjectBuffer index change.
+
+				@param1 a_object is the index the draws after it use.
+		*/
+		void selectObject(unsigned int a_object);
+
+		/**
+			drawChunk records a draw of one chunk of a mesh with its
+				material.
+
+				@param1 a_mesh is the mesh, which must outlive the list's
+						next execute.
+
+				@param2 a_chunk is the chunk.
+
+				@param3 a_usePatches draws it with GL_PATCHES.
+
+				@param4 a_lod is its level of detail.
+
+				@param5 a_query is an occlusion query it is drawn on the
+						result of, 0 to draw it whatever the result.
+		*/
+		void drawChunk(const aie::OBJMesh* a_mesh, unsigned int a_chunk, bool a_usePatches, unsigned int a_lod,
+			unsigned int a_query = 0);
+
+		/**
+			execute makes the commands GL calls, in the order they were
+				recorded, keeping them. Only on the context thread.
+		*/
+		void execute() const;
+
+		/**
+			clear throws the commands away, keeping their memory.
+		*/
+		void clear() { m_commands.clear(); }
+
+		/**
+			isEmpty returns whether nothing is recorded.
+		*/
+		bool isEmpty() const { return m_commands.empty(); }
+
+	private:
+		/**
+			What a command does.
+		*/
+		enum class Op : unsigned char
+		{
+			PROGRAM,
+			OBJECT,
+			DRAW
+		};
+
+		/**
+			A recorded command. program is only used by PROGRAM, and
+				value is the object of OBJECT and the query of DRAW.
+		*/
+		struct Command
+		{
+			Op op;
+			bool usePatches;
+			unsigned short lod;
+			unsigned int chunk;
+			unsigned int value;
+			union
+			{
+				aie::ShaderProgram* program;
+				const aie::OBJMesh* mesh;
+			};
+		};
+
+		std::vector<Command> m_commands;
+	};
+}
@@ -0,0 +1,121 @@
+/**
+	ComponentArray.h
+
+	Purpose: ComponentArray.h is the header file for the ComponentArray
+			class. A ComponentArray stores one kind of component for
+			many entities, packed together so systems can walk them
+			without skipping over anything.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <vector>
+
+namespace sns
+{
+	typedef unsigned int Entity;
+
+	/**
+		The ComponentArray class is a sparse set. The components are kept
+			dense, in the order they were added, next to the entity each
+			belongs to. A second array, indexed by entity, says where an
+			entity's component is, so lookups don't search.
+
+		Removing a component moves the last one into its place, so the
+			order only holds for as long as nothing is removed.
+	*/
+	template <typename T>
+	class ComponentArray
+	{
+	public:
+		/**
+			add gives an entity a component, replacing any it had.
+
+				@param1 a_entity is the entity.
+
+				@param2 a_component is the component.
+
+				@return the stored component.
+		*/
+		T& add(Entity a_entity, const T& a_component)
+		{
+			if (a_entity >= m_indices.size())
+				m_indices.resize(a_entity + 1, NO_INDEX);
+
+			unsigned int& index = m_indices[a_entity];
+			if (index != NO_INDEX)
+				return m_components[index] = a_component;
+
+			index = (unsigned int)m_components.size();
+			m_components.push_back(a_component);
+			m_entities.push_back(a_entity);
+			return m_components.back();
+		}
+
+		/**
+			remove takes an entity's component away, if it has one.
+
+				@param1 a_entity is the entity.
+		*/
+		void remove(Entity a_entity)
+		{
+			if (has(a_entity) == false)
+				return;
+
+			// The last component fills the gap, so the array stays dense.
+			unsigned int index = m_indices[a_entity];
+			Entity last = m_entities.back();
+			m_components[index] = m_components.back();
+			m_entities[index] = last;
+			m_indices[last] = index;
+
+			m_components.pop_back();
+			m_entities.pop_back();
+			m_indices[a_entity] = NO_INDEX;
+		}
+
+		/**
+			has returns whether an entity has a component.
+		*/
+		bool has(Entity a_entity) const
+		{
+			return a_entity < m_indices.size() && m_indices[a_entity] != NO_INDEX;
+		}
+
+		/**
+			get returns an entity's component, or nullptr if it has none.
+		*/
+		T* get(Entity a_entity) { return has(a_entity) ? &m_components[m_indices[a_entity]] : nullptr; }
+		const T* get(Entity a_entity) const { return has(a_entity) ? &m_components[m_indices[a_entity]] : nullptr; }
+
+		/**
+			clear removes every component.
+		*/
+		void clear()
+		{
+			m_components.clear();
+			m_entities.clear();
+			m_indices.clear();
+		}
+
+		// The dense components, for systems to walk.
+		unsigned int size() const { return (unsigned int)m_components.size(); }
+		T& operator[](unsigned int a_index) { return m_components[a_index]; }
+		const T& operator[](unsigned int a_index) const { return m_components[a_index]; }
+
+		// The entity the component at a dense index belongs to.
+		Entity getEntity(unsigned int a_index) const { return m_entities[a_index]; }
+
+	private:
+		static const unsigned int NO_INDEX = ~0u;
+
+		std::vector<T> m_components;
+		std::vector<Entity> m_entities;
+
+		// Where each entity's component is, NO_INDEX if it has none.
+		std::vector<unsigned int> m_indices;
+	};
+
+	template <typename T>
+	const unsigned int ComponentArray<T>::NO_INDEX;
+}
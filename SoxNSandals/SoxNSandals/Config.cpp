@@ -0,0 +1,215 @@
+/**
+	Config.cpp
+
+	Purpose: Config.cpp is the source file for the Config struct. The
+			Config is what a run is set up with, the window, the scene
+			and how much each part of the frame may cost, read from a
+			file and the command line so the same build can be tuned to
+			the machine it runs on.
+
+	@author Nathan Nette
+*/
+#include "Config.h"
+#include "FileSystem.h"
+#include "Json.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// Each preset's costs, in the order of sns::Quality.
+	struct Preset
+	{
+		const char* name;
+		float lodScale;
+		unsigned int shadowResolution;
+		unsigned int particleBudget;
+		float anisotropy;
+		sns::AntiAliasing antiAliasing;
+		bool bloom;
+		sns::ReflectionQuality reflections;
+	};
+
+	const Preset PRESETS[(int)sns::Quality::COUNT] =
+	{
+		{ "low", 2.0f, 1024, 5000, 2.0f, sns::AntiAliasing::NONE, false,
+			sns::ReflectionQuality::OFF },
+		{ "medium", 1.5f, 1024, 10000, 4.0f, sns::AntiAliasing::FXAA, true, sns::ReflectionQuality::LOW },
+		{ "high", 1.0f, 2048, 20000, 8.0f, sns::AntiAliasing::FXAA, true, sns::ReflectionQuality::MEDIUM },
+		{ "ultra", 0.5f, 4096, 50000, 16.0f, sns::AntiAliasing::TAA, true, sns::ReflectionQuality::HIGH },
+	};
+}
+
+namespace sns
+{
+	/**
+		The constructor makes the HIGH preset in a 1280 by 720 window,
+			with no benchmark.
+	*/
+	Config::Config()
+		: resolution(1280, 720),
+		quality(Quality::HIGH),
+		lodScale(1.0f),
+		shadowResolution(2048),
+		particleBudget(20000),
+		anisotropy(8.0f),
+		antiAliasing(AntiAliasing::FXAA),
+		bloom(true),
+		reflections(ReflectionQuality::MEDIUM),
+		benchmark({ false, 1000, "benchmark.json", std::string(), BenchmarkScene::SPONZA })
+	{
+		setQuality(Quality::HIGH);
+	}
+
+	/**
+		setQuality sets every cost to a preset's.
+
+			@param1 a_quality is the preset.
+	*/
+	void Config::setQuality(Quality a_quality)
+	{
+		const Preset& preset = PRESETS[(int)a_quality];
+		quality = a_quality;
+		lodScale = preset.lodScale;
+		shadowResolution = preset.shadowResolution;
+		particleBudget = preset.particleBudget;
+		anisotropy = preset.anisotropy;
+		antiAliasing = preset.antiAliasing;
+		bloom = preset.bloom;
+		reflections = preset.reflections;
+	}
+
+	/**
+		load reads a file over the settings.
+
+			@param1 a_filename is the file.
+
+			@return false if it can't be read or isn't an object, the
+					settings are left as they were.
+	*/
+	bool Config::load(const char* a_filename)
+	{
+		FileView file;
+		if (FileSystem::instance().open(a_filename, file) == false)
+		{
+			printf("Failed to read config %s\n", a_filename);
+			return false;
+		}
+
+		JsonValue root;
+		JsonReader reader((const char*)file.getData(), file.getSize());
+		if (reader.read(root) == false)
+		{
+			printf("%s(%u): %s\n", a_filename, reader.getLine(), reader.getError().c_str());
+			return false;
+		}
+		if (root.type != JsonValue::OBJECT)
+		{
+			printf("%s: a config is an object\n", a_filename);
+			return false;
+		}
+
+		// Anything missing or of the wrong type is left as it was.
+		auto number = [](const JsonValue& a_object, const char* a_name) -> const JsonValue*
+		{
+			const JsonValue* value = a_object.find(a_name);
+			return value != nullptr && value->type == JsonValue::NUMBER ? value : nullptr;
+		};
+		auto string = [](const JsonValue& a_object, const char* a_name) -> const JsonValue*
+		{
+			const JsonValue* value = a_object.find(a_name);
+			return value != nullptr && value->type == JsonValue::STRING ? value : nullptr;
+		};
+
+		const JsonValue* value = root.find("resolution");
+		if (value != nullptr && value->type == JsonValue::ARRAY && value->items.size() == 2 &&
+			value->items[0].type == JsonValue::NUMBER && value->items[1].type == JsonValue::NUMBER)
+		{
+			resolution = glm::ivec2((int)value->items[0].number, (int)value->items[1].number);
+		}
+		if ((value = string(root, "scene")) != nullptr)
+			sceneFile = value->string;
+		if ((value = string(root, "telemetry")) != nullptr)
+			telemetry = value->string;
+
+		// The preset first, so the costs after it change only part of it.
+		if ((value = string(root, "quality")) != nullptr)
+		{
+			Quality preset;
+			if (findQuality(value->string.c_str(), preset))
+				setQuality(preset);
+			else
+				printf("%s: unknown quality %s\n", a_filename, value->string.c_str());
+		}
+		if ((value = number(root, "lodScale")) != nullptr && value->number > 0.0)
+			lodScale = (float)value->number;
+		if ((value = number(root, "shadowResolution")) != nullptr && value->number >= 1.0)
+			shadowResolution = (unsigned int)value->number;
+		if ((value = number(root, "particleBudget")) != nullptr && value->number >= 0.0)
+			particleBudget = (unsigned int)value->number;
+		if ((value = number(root, "anisotropy")) != nullptr && value->number >= 1.0)
+			anisotropy = (float)value->number;
+		if ((value = string(root, "antiAliasing")) != nullptr &&
+			PostProcess::findAntiAliasing(value->string.c_str(), antiAliasing) == false)
+		{
+			printf("%s: unknown anti-aliasing %s\n", a_filename, value->string.c_str());
+		}
+		if ((value = root.find("bloom")) != nullptr && value->type == JsonValue::BOOLEAN)
+			bloom = value->boolean;
+		if ((value = string(root, "reflections")) != nullptr &&
+			ScreenSpaceReflections::findQuality(value->string.c_str(), reflections) == false)
+		{
+			printf("%s: unknown reflections %s\n", a_filename, value->string.c_str());
+		}
+
+		const JsonValue* run = root.find("benchmark");
+		if (run != nullptr && run->type == JsonValue::OBJECT)
+		{
+			benchmark.enabled = true;
+			if ((value = number(*run, "frames")) != nullptr && value->number >= 1.0)
+				benchmark.frames = (unsigned int)value->number;
+			if ((value = string(*run, "output")) != nullptr)
+				benchmark.output = value->string;
+			if ((value = string(*run, "path")) != nullptr)
+				benchmark.path = value->string;
+			if ((value = string(*run, "scene")) != nullptr &&
+				RegressionGate::findScene(value->string.c_str(), benchmark.scene) == false)
+			{
+				printf("%s: unknown scene %s\n", a_filename, value->string.c_str());
+			}
+		}
+		return true;
+	}
+
+	/**
+		findQuality finds a preset from its name.
+
+			@param1 a_name is the name, "low", "medium", "high" or "ultra".
+
+			@param2 a_quality is set to the preset.
+
+			@return false if no preset has the name.
+	*/
+	bool Config::findQuality(const char* a_name, Quality& a_quality)
+	{
+		for (int i = 0; i < (int)Quality::COUNT; ++i)
+		{
+			if (strcmp(a_name, PRESETS[i].name) == 0)
+			{
+				a_quality = (Quality)i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+		getQualityName returns a preset's name.
+
+			@param1 a_quality is the preset.
+	*/
+	const char* Config::getQualityName(Quality a_quality)
+	{
+		return PRESETS[(int)a_quality].name;
+	}
+}
@@ -0,0 +1,158 @@
+/**
+	Config.h
+
+	Purpose: Config.h is the header file for the Config struct. The
+			Config is what a run is set up with, the window, the scene
+			and how much each part of the frame may cost, read from a
+			file and the command line so the same build can be tuned to
+			the machine it runs on.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "PostProcess.h"
+#include "RegressionGate.h"
+#include "ScreenSpaceReflections.h"
+#include <glm/vec2.hpp>
+#include <string>
+
+namespace sns
+{
+	/**
+		The quality presets, each a set of costs for a tier of hardware.
+	*/
+	enum class Quality
+	{
+		// Coarse levels of detail near the camera, small shadow maps,
+		//	few particles and no anti-aliasing or bloom.
+		LOW,
+
+		// Between the two.
+		MEDIUM,
+
+		// What the engine has always drawn.
+		HIGH,
+
+		// Fine detail further away, large shadow maps, many particles
+		//	and temporal anti-aliasing.
+		ULTRA,
+
+		COUNT
+	};
+
+	/**
+		The Config struct holds a run's settings. It starts as the HIGH
+			preset in a 1280 by 720 window. A file sets what it names and
+			leaves the rest, setQuality sets every cost at once, and the
+			command line's flags are applied last.
+
+		A file is a JSON object with any of
+			"resolution": [1920, 1080],
+			"scene": "../scenes/sponza.json",
+			"quality": "low", "medium", "high" or "ultra",
+			"lodScale", "shadowResolution", "particleBudget",
+				"anisotropy", "antiAliasing", "bloom", true or false,
+				and "reflections", "off" to "high", to change one of the
+				preset's costs,
+			"benchmark": { "frames": 1000, "output": "benchmark.json",
+				"path": "path.txt", "scene": "stanford" },
+				which benchmarks instead of opening the window to fly,
+			"telemetry": "host:port", a collector to stream the
+				profiler's frames to, see TelemetryStream.
+		The quality is read before the costs, so a file can start from a
+			preset and change some of it.
+	*/
+	struct Config
+	{
+		// The window's width and height.
+		glm::ivec2 resolution;
+
+		// The scene description drawn, or empty for the default.
+		std::string sceneFile;
+
+		// The preset the costs below started from.
+		Quality quality;
+
+		// See aie::OBJMesh::setLODScale.
+		float lodScale;
+
+		// The width and height of each of the light's shadow cascades.
+		unsigned int shadowResolution;
+
+		// The most particles alive at once, see
+		//	ParticleSystem::setParticleBudget.
+		unsigned int particleBudget;
+
+		// How many samples textures are filtered with, see
+		//	SamplerCache::setAnisotropy.
+		float anisotropy;
+
+		AntiAliasing antiAliasing;
+
+		// Whether the scene's brightest parts glow, see Bloom.
+		bool bloom;
+
+		// How much the glossy surfaces' reflections may cost, see
+		//	ScreenSpaceReflections.
+		ReflectionQuality reflections;
+
+		/**
+			A benchmark to run instead of flying the camera, as
+				"--benchmark frames output path" runs.
+		*/
+		struct Benchmark
+		{
+			bool enabled;
+			unsigned int frames;
+			std::string output;
+			std::string path;
+			BenchmarkScene scene;
+		};
+		Benchmark benchmark;
+
+		// The collector telemetry is streamed to, or empty for none.
+		std::string telemetry;
+
+		/**
+			The constructor makes the HIGH preset in a 1280 by 720 window,
+				with no benchmark.
+		*/
+		Config();
+
+		/**
+			setQuality sets every cost to a preset's.
+
+				@param1 a_quality is the preset.
+		*/
+		void setQuality(Quality a_quality);
+
+		/**
+			load reads a file over the settings.
+
+				@param1 a_filename is the file.
+
+				@return false if it can't be read or isn't an object, the
+						settings are left as they were.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			findQuality finds a preset from its name.
+
+				@param1 a_name is the name, "low", "medium", "high" or
+						"ultra".
+
+				@param2 a_quality is set to the preset.
+
+				@return false if no preset has the name.
+		*/
+		static bool findQuality(const char* a_name, Quality& a_quality);
+
+		/**
+			getQualityName returns a preset's name.
+
+				@param1 a_quality is the preset.
+		*/
+		static const char* getQualityName(Quality a_quality);
+	};
+}
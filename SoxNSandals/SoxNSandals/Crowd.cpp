@@ -0,0 +1,376 @@
+/**
+	Crowd.cpp
+
+	Purpose: Crowd.cpp is the source file for the Crowd class. The Crowd
+			draws thousands of copies of a skinned character, too many to
+			pose one by one, from one of its clips baked into textures.
+
+	@author Nathan Nette
+*/
+#include "Crowd.h"
+#include "Frustum.h"
+#include "GpuMemory.h"
+#include "Random.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// The baking shader's buffers.
+	static const unsigned int SOURCE_BINDING = 0;
+	static const unsigned int JOINT_BINDING = 1;
+	static const unsigned int BOUNDS_BINDING = 2;
+
+	// Must match local_size in crowdBake.comp.
+	static const unsigned int GROUP_SIZE = 64;
+
+	// The floats of one joint's skin matrix, its first three rows.
+	static const unsigned int JOINT_FLOATS = 12;
+
+	// The units the vertex shaders read the frames from, past every unit
+	//	a material or the frame's lighting binds.
+	static const unsigned int POSITION_UNIT = 16;
+	static const unsigned int NORMAL_UNIT = 17;
+
+	// How many seconds the crowd takes to come back to how it started,
+	//	each copy's speed rounded to a whole number of plays in it.
+	static const float REPEAT_TIME = 600.0f;
+
+	Crowd::Crowd()
+		: m_crowd(),
+		m_boundsCentre(0),
+		m_boundsRadius(0),
+		m_frameCount(0),
+		m_time(0),
+		m_stats()
+	{
+	}
+
+	/**
+		create loads the character, bakes its clip and scatters the
+			copies.
+
+			@param1 a_crowd is the scene's crowd.
+
+			@param2 a_height gives the ground's height under each copy,
+					or is empty to stand them at the crowd's height.
+
+			@return false without GL 4.5, the shader, or a model with a
+					clip, it is left uncreated.
+	*/
+	bool Crowd::create(const SceneDescription::Crowd& a_crowd, const HeightFunction& a_height)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("Crowd: baking the animation needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_bakeShader.getHandle() == 0)
+		{
+			m_bakeShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/crowdBake.comp");
+			if (m_bakeShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_bakeShader.getLastError());
+				return false;
+			}
+		}
+
+		if (m_mesh.isLoaded() == false || m_mesh.getFilename() != a_crowd.filename)
+		{
+			if (m_mesh.load(a_crowd.filename.c_str()) == false)
+				return false;
+		}
+		int clip = m_mesh.findClip(a_crowd.clip);
+		if (clip < 0 && m_mesh.getClips().empty() == false)
+			clip = 0;
+		if (clip < 0 || m_mesh.getClips()[clip].getDuration() <= 0.0f)
+		{
+			printf("Crowd: %s has no clip to play.\n", a_crowd.filename.c_str());
+			return false;
+		}
+
+		m_crowd = a_crowd;
+		m_frameCount = glm::clamp(m_crowd.frames, 2u, (uint32_t)MAX_FRAMES);
+		m_time = 0;
+		bake(m_mesh.getClips()[clip]);
+		scatter(a_height, m_mesh.getClips()[clip].getDuration());
+
+		// The copies are the only vertex buffer, each vertex is read from
+		//	the frames by its index.
+		size_t bytes = m_members.size() * sizeof(Member);
+		glCreateBuffers(1, m_instances.put());
+		glNamedBufferStorage(m_instances, std::max(bytes, sizeof(Member)), m_members.data(), 0);
+		GpuMemory::instance().trackBuffer(m_instances, bytes, GpuMemory::MESHES, "Crowd");
+
+		glCreateVertexArrays(1, m_vao.put());
+		for (unsigned int column = 0; column < 5; ++column)
+		{
+			unsigned int attribute = aie::OBJMesh::INSTANCE_ATTRIBUTE + column;
+			glEnableVertexArrayAttrib(m_vao, attribute);
+			glVertexArrayAttribFormat(m_vao, attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * column);
+			glVertexArrayAttribBinding(m_vao, attribute, 0);
+		}
+		glVertexArrayBindingDivisor(m_vao, 0, 1);
+		glVertexArrayVertexBuffer(m_vao, 0, m_instances, 0, sizeof(Member));
+		glVertexArrayElementBuffer(m_vao, m_mesh.getIndexBuffer());
+		return true;
+	}
+
+	/**
+		destroy deletes the textures, buffers and vertex array. The
+			model stays loaded, for the next create to use again.
+	*/
+	void Crowd::destroy()
+	{
+		m_vao.reset();
+		m_instances.reset();
+		m_positions.reset();
+		m_normals.reset();
+		m_members.clear();
+		m_cells.clear();
+		m_stats = {};
+	}
+
+	/**
+		update moves every copy on through its clip.
+
+			@param1 a_deltaTime is the time since the last update.
+	*/
+	void Crowd::update(float a_deltaTime)
+	{
+		m_time = fmodf(m_time + a_deltaTime, REPEAT_TIME);
+	}
+
+	/**
+		draw draws every copy in a cell inside the view, each cell one
+			instanced draw per primitive.
+
+			@param1 a_shader is the program.
+
+			@param2 a_cullProjectionView is the view the cells are culled
+					against.
+
+			@param3 a_cameraPosition is where the draw distance is
+					measured from.
+	*/
+	void Crowd::draw(aie::ShaderProgram& a_shader, const glm::mat4& a_cullProjectionView,
+		const glm::vec3& a_cameraPosition)
+	{
+		static constexpr aie::UniformHandle POSITIONS("CrowdPositions");
+		static constexpr aie::UniformHandle NORMALS("CrowdNormals");
+		static constexpr aie::UniformHandle FRAMES("CrowdFrames");
+		static constexpr aie::UniformHandle TIME("CrowdTime");
+
+		m_stats = {};
+		if (isCreated() == false)
+			return;
+
+		Frustum frustum(a_cullProjectionView);
+		unsigned int visible[CELLS * CELLS];
+		unsigned int visibleCount = 0;
+		for (unsigned int i = 0; i < (unsigned int)m_cells.size(); ++i)
+		{
+			const Cell& cell = m_cells[i];
+			if (cell.count == 0)
+				continue;
+
+			glm::vec3 nearest = glm::clamp(a_cameraPosition, cell.min, cell.max);
+			if (glm::length(nearest - a_cameraPosition) > m_crowd.drawDistance ||
+				frustum.isBoxVisible((cell.min + cell.max) * 0.5f, (cell.max - cell.min) * 0.5f) == false)
+			{
+				m_stats.culled += cell.count;
+				continue;
+			}
+			visible[visibleCount++] = i;
+			m_stats.visible += cell.count;
+		}
+		if (visibleCount == 0)
+			return;
+
+		// Array textures, which the render state doesn't cache.
+		glBindTextureUnit(POSITION_UNIT, m_positions);
+		glBindTextureUnit(NORMAL_UNIT, m_normals);
+		a_shader.bindUniform(POSITIONS, (int)POSITION_UNIT);
+		a_shader.bindUniform(NORMALS, (int)NORMAL_UNIT);
+		a_shader.bindUniform(FRAMES, (int)m_frameCount);
+		a_shader.bindUniform(TIME, m_time);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SOURCE_BINDING, m_mesh.getSourceBuffer());
+
+		RenderState& state = RenderState::instance();
+		state.bindVertexArray(m_vao);
+		for (const SkinnedMesh::Primitive& primitive : m_mesh.getPrimitives())
+		{
+			aie::OBJMesh::bindMaterial(primitive.material);
+			for (unsigned int i = 0; i < visibleCount; ++i)
+			{
+				const Cell& cell = m_cells[visible[i]];
+				state.countDraw();
+				glDrawElementsInstancedBaseInstance(GL_TRIANGLES, primitive.indexCount, GL_UNSIGNED_INT,
+					(void*)(primitive.firstIndex * sizeof(unsigned int)), cell.count, cell.first);
+				++m_stats.draws;
+			}
+		}
+	}
+
+	/**
+		getBounds adds a world sphere around each cell with copies in it.
+
+			@param1 a_bounds is added to.
+	*/
+	void Crowd::getBounds(std::vector<glm::vec4>& a_bounds) const
+	{
+		for (const Cell& cell : m_cells)
+		{
+			if (cell.count != 0)
+				a_bounds.push_back(glm::vec4((cell.min + cell.max) * 0.5f, glm::length(cell.max - cell.min) * 0.5f));
+		}
+	}
+
+	/**
+		bake poses the clip at every frame and skins the vertices into the
+			textures. The frames are evenly spaced through the clip
+			without its end, which is where it loops back to the first.
+
+			@param1 a_clip is the clip.
+	*/
+	void Crowd::bake(const AnimationClip& a_clip)
+	{
+		static constexpr aie::UniformHandle VERTEX_COUNT("VertexCount");
+		static constexpr aie::UniformHandle JOINT_COUNT("JointCount");
+		static constexpr aie::UniformHandle TEXTURE_WIDTH_UNIFORM("TextureWidth");
+
+		const Skeleton& skeleton = m_mesh.getSkeleton();
+		unsigned int jointCount = skeleton.getJointCount();
+		unsigned int vertexCount = m_mesh.getVertexCount();
+		unsigned int rows = (vertexCount + TEXTURE_WIDTH - 1) / TEXTURE_WIDTH;
+
+		std::vector<float> jointRows((size_t)m_frameCount * jointCount * JOINT_FLOATS);
+		Pose pose;
+		AnimationClip::Scratch scratch;
+		std::vector<glm::mat4> matrices;
+		for (unsigned int frame = 0; frame < m_frameCount; ++frame)
+		{
+			float time = a_clip.getDuration() * frame / m_frameCount;
+			a_clip.sample(time, skeleton.getRestPose(), scratch, pose);
+			skeleton.getSkinMatrices(pose, matrices, jointRows.data() + (size_t)frame * jointCount * JOINT_FLOATS);
+		}
+
+		GpuMemory& memory = GpuMemory::instance();
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, m_positions.put());
+		glTextureStorage3D(m_positions, 1, GL_RGBA32F, TEXTURE_WIDTH, rows, m_frameCount);
+		memory.trackTexture(m_positions, GpuMemory::getTextureBytes(GL_RGBA32F, TEXTURE_WIDTH, rows, m_frameCount),
+			GpuMemory::MESHES, "Crowd");
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, m_normals.put());
+		glTextureStorage3D(m_normals, 1, GL_RGBA16F, TEXTURE_WIDTH, rows, m_frameCount);
+		memory.trackTexture(m_normals, GpuMemory::getTextureBytes(GL_RGBA16F, TEXTURE_WIDTH, rows, m_frameCount),
+			GpuMemory::MESHES, "Crowd");
+
+		// The box starts inside out, every vertex grows it.
+		const uint32_t emptyBounds[6] = { ~0u, ~0u, ~0u, 0, 0, 0 };
+		BufferHandle joints;
+		BufferHandle bounds;
+		glCreateBuffers(1, joints.put());
+		glNamedBufferStorage(joints, jointRows.size() * sizeof(float), jointRows.data(), 0);
+		glCreateBuffers(1, bounds.put());
+		glNamedBufferStorage(bounds, sizeof(emptyBounds), emptyBounds, 0);
+
+		m_bakeShader.bind();
+		m_bakeShader.bindUniform(VERTEX_COUNT, (int)vertexCount);
+		m_bakeShader.bindUniform(JOINT_COUNT, (int)jointCount);
+		m_bakeShader.bindUniform(TEXTURE_WIDTH_UNIFORM, (int)TEXTURE_WIDTH);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SOURCE_BINDING, m_mesh.getSourceBuffer());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, JOINT_BINDING, joints);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, bounds);
+		glBindImageTexture(0, m_positions, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		glBindImageTexture(1, m_normals, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glDispatchCompute((vertexCount + GROUP_SIZE - 1) / GROUP_SIZE, m_frameCount, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		// The uints are turned back into the floats they sort as.
+		uint32_t sorted[6];
+		glGetNamedBufferSubData(bounds, 0, sizeof(sorted), sorted);
+		float corners[6];
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			uint32_t bits = (sorted[i] & 0x80000000u) != 0 ? sorted[i] & 0x7fffffffu : ~sorted[i];
+			memcpy(&corners[i], &bits, sizeof(float));
+		}
+		glm::vec3 minimum(corners[0], corners[1], corners[2]);
+		glm::vec3 maximum(corners[3], corners[4], corners[5]);
+		m_boundsCentre = (minimum + maximum) * 0.5f;
+		m_boundsRadius = glm::length(maximum - minimum) * 0.5f;
+	}
+
+	/**
+		scatter places the copies over the square, each facing its own
+			way at its own point in the clip, then sorts them into the
+			cells they stand in and boxes each cell.
+
+			@param1 a_height gives the ground's height, or is empty.
+
+			@param2 a_duration is how long the clip is.
+	*/
+	void Crowd::scatter(const HeightFunction& a_height, float a_duration)
+	{
+		// The same seed places the same copies every run.
+		Random random(m_crowd.seed);
+		std::vector<unsigned int> cellOf(m_crowd.count);
+		std::vector<Member> placed(m_crowd.count);
+		std::vector<float> radii(m_crowd.count);
+		m_cells.assign(CELLS * CELLS, { 0, 0, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) });
+		for (uint32_t i = 0; i < m_crowd.count; ++i)
+		{
+			float u = random.nextFloat();
+			float v = random.nextFloat();
+			glm::vec2 offset = (glm::vec2(u, v) - 0.5f) * m_crowd.size;
+			float x = m_crowd.position.x + offset.x;
+			float z = m_crowd.position.z + offset.y;
+			float y = a_height ? a_height(x, z) : m_crowd.position.y;
+			float angle = random.range(0.0f, glm::two_pi<float>());
+			float scale = random.range(m_crowd.scale.x, m_crowd.scale.y);
+
+			glm::mat4 transform = glm::translate(glm::mat4(1), glm::vec3(x, y, z));
+			transform = glm::rotate(transform, angle, glm::vec3(0, 1, 0));
+			transform = glm::scale(transform, glm::vec3(scale));
+
+			// Each copy plays a whole number of times in the repeat, so
+			//	wrapping the time doesn't make any of them jump.
+			float plays = random.range(m_crowd.speed.x, m_crowd.speed.y) / a_duration * REPEAT_TIME;
+			float rate = std::max(roundf(plays), 1.0f) / REPEAT_TIME;
+			placed[i] = { transform, glm::vec4(random.nextFloat(), rate, 0, 0) };
+			radii[i] = m_boundsRadius * scale;
+
+			unsigned int column = std::min((unsigned int)(u * CELLS), CELLS - 1);
+			unsigned int row = std::min((unsigned int)(v * CELLS), CELLS - 1);
+			cellOf[i] = row * CELLS + column;
+			++m_cells[cellOf[i]].count;
+		}
+
+		unsigned int first = 0;
+		for (Cell& cell : m_cells)
+		{
+			cell.first = first;
+			first += cell.count;
+			cell.count = 0;
+		}
+		m_members.resize(m_crowd.count);
+		for (uint32_t i = 0; i < m_crowd.count; ++i)
+		{
+			Cell& cell = m_cells[cellOf[i]];
+			m_members[cell.first + cell.count++] = placed[i];
+
+			glm::vec3 centre = glm::vec3(placed[i].transform * glm::vec4(m_boundsCentre, 1));
+			cell.min = glm::min(cell.min, centre - radii[i]);
+			cell.max = glm::max(cell.max, centre + radii[i]);
+		}
+	}
+}
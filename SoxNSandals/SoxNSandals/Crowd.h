@@ -0,0 +1,206 @@
+/**
+	Crowd.h
+
+	Purpose: Crowd.h is the header file for the Crowd class. The Crowd
+			draws thousands of copies of a skinned character, too many to
+			pose one by one, from one of its clips baked into textures.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "SceneDescription.h"
+#include "Shader.h"
+#include "SkinnedMesh.h"
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The Crowd class bakes a vertex animation: the clip is posed on the
+			cpu at evenly spaced frames through it, and a compute shader
+			skins every vertex at every frame, as the Animator's does,
+			into two array textures a layer a frame, the positions in
+			floats and the normals in halves. Nothing is posed or
+			skinned again after that.
+
+		Each copy is a transform and the point it starts at in the clip,
+			and how fast it plays it, in one buffer written once. Its
+			vertex shader finds its frame from the time, reads the two
+			frames either side of it by the vertex's index and blends
+			between them, with the texcoords read from the mesh's
+			source buffer. crowd.glsl does this for both the lit and
+			shadow vertex shaders.
+
+		The copies are put into cells of a CELLS by CELLS grid over the
+			square, each a run of the buffer, and every cell that isn't
+			culled is one instanced draw per primitive, so the crowd
+			can be drawn into any number of passes a frame without
+			being written again.
+
+		The tangents the vertices are drawn with aren't skinned, as a
+			SkinnedMesh's materials have no normal maps to need them.
+			Baking needs GL 4.5, without it create fails.
+	*/
+	class Crowd
+	{
+	public:
+		// The cells across each side of the square, and the texels in each
+		//	row of a frame.
+		static const unsigned int CELLS = 8;
+		static const unsigned int TEXTURE_WIDTH = 1024;
+
+		// The most frames a clip is baked into.
+		static const unsigned int MAX_FRAMES = 256;
+
+		// Where copies stand, and how high the ground is there.
+		typedef std::function<float(float, float)> HeightFunction;
+
+		/**
+			What the last draw did.
+		*/
+		struct Stats
+		{
+			unsigned int visible;
+			unsigned int culled;
+			unsigned int draws;
+		};
+
+		Crowd();
+
+		Crowd(const Crowd&) = delete;
+		Crowd& operator=(const Crowd&) = delete;
+
+		/**
+			create loads the character, bakes its clip and scatters the
+				copies.
+
+				@param1 a_crowd is the scene's crowd.
+
+				@param2 a_height gives the ground's height under each
+						copy, or is empty to stand them at the crowd's
+						height.
+
+				@return false without GL 4.5, the shader, or a model with
+						a clip, it is left uncreated.
+		*/
+		bool create(const SceneDescription::Crowd& a_crowd, const HeightFunction& a_height);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_positions != 0; }
+
+		/**
+			destroy deletes the textures, buffers and vertex array. The
+				model stays loaded, for the next create to use again.
+		*/
+		void destroy();
+
+		/**
+			update moves every copy on through its clip.
+
+				@param1 a_deltaTime is the time since the last update.
+		*/
+		void update(float a_deltaTime);
+
+		/**
+			draw draws every copy in a cell inside the view, with a
+				program made from crowd.glsl that must already be bound.
+
+				@param1 a_shader is the program.
+
+				@param2 a_cullProjectionView is the view the cells are
+						culled against.
+
+				@param3 a_cameraPosition is where the draw distance is
+						measured from.
+		*/
+		void draw(aie::ShaderProgram& a_shader, const glm::mat4& a_cullProjectionView,
+			const glm::vec3& a_cameraPosition);
+
+		/**
+			getCount returns how many copies there are.
+		*/
+		unsigned int getCount() const { return (unsigned int)m_members.size(); }
+
+		/**
+			getStats returns what the last draw did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+		/**
+			getBounds adds a world sphere around each cell with copies in
+				it, every one of which moves whenever the crowd plays.
+
+				@param1 a_bounds is added to.
+		*/
+		void getBounds(std::vector<glm::vec4>& a_bounds) const;
+
+	private:
+		/**
+			A copy, as the vertex shaders read it.
+		*/
+		struct Member
+		{
+			glm::mat4 transform;
+
+			// Where it starts in the clip and how many times a second it
+			//	plays it, both in whole clips, then nothing.
+			glm::vec4 timing;
+		};
+
+		/**
+			A cell's run of the copies, and a box around them.
+		*/
+		struct Cell
+		{
+			unsigned int first;
+			unsigned int count;
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+
+		/**
+			bake poses the clip at every frame and skins the vertices into
+				the textures.
+
+				@param1 a_clip is the clip.
+		*/
+		void bake(const AnimationClip& a_clip);
+
+		/**
+			scatter places the copies, sorted into their cells.
+
+				@param1 a_height gives the ground's height, or is empty.
+
+				@param2 a_duration is how long the clip is.
+		*/
+		void scatter(const HeightFunction& a_height, float a_duration);
+
+		aie::ShaderProgram m_bakeShader;
+		SceneDescription::Crowd m_crowd;
+		SkinnedMesh m_mesh;
+
+		// Every frame's positions and normals, a layer a frame.
+		TextureHandle m_positions;
+		TextureHandle m_normals;
+
+		BufferHandle m_instances;
+		VertexArrayHandle m_vao;
+
+		std::vector<Member> m_members;
+		std::vector<Cell> m_cells;
+
+		// The middle of the baked vertices and how far they reach from
+		//	it in any frame, before a copy's transform.
+		glm::vec3 m_boundsCentre;
+		float m_boundsRadius;
+
+		unsigned int m_frameCount;
+		float m_time;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,471 @@
+/**
+	DebugHud.cpp
+
+	Purpose: DebugHud.cpp is the source file for the DebugHud class. The
+			DebugHud draws the profiler's last frames over the window,
+			as frame time graphs, a table of what each pass cost and
+			every counter the frame set.
+
+	@author Nathan Nette
+*/
+#include "DebugHud.h"
+#include "GpuMemory.h"
+#include "Profiler.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/geometric.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// The font is 3 by 5 cells, each SCALE pixels square, with a cell
+	//	between characters and two between lines.
+	const float SCALE = 2.0f;
+	const float ADVANCE = 4 * SCALE;
+	const float LINE_HEIGHT = 7 * SCALE;
+	const float GLYPH_HEIGHT = 5 * SCALE;
+
+	// Between the window's edge and a panel, and the panels and what
+	//	is drawn in them.
+	const float MARGIN = 8.0f;
+	const float PADDING = 6.0f;
+
+	// A pixel a frame, the height covering twice a 60Hz frame.
+	const float GRAPH_WIDTH = (float)sns::Profiler::HISTORY_SIZE * 2.0f;
+	const float GRAPH_HEIGHT = 80.0f;
+	const double GRAPH_MILLISECONDS = 1000.0 / 30.0;
+
+	const glm::vec4 TEXT_COLOUR(0.9f, 0.9f, 0.9f, 1);
+	const glm::vec4 HEADING_COLOUR(1.0f, 0.85f, 0.4f, 1);
+	const glm::vec4 CPU_COLOUR(0.4f, 0.9f, 0.4f, 1);
+	const glm::vec4 GPU_COLOUR(1.0f, 0.55f, 0.2f, 1);
+	const glm::vec4 GUIDE_COLOUR(0.5f, 0.5f, 0.5f, 1);
+	const glm::vec4 PANEL_COLOUR(0, 0, 0, 0.6f);
+
+	// The glyphs of ' ' to '_', a row of 3 bits each from the top, the
+	//	left most cell in the highest bit.
+	const unsigned short FONT[64] =
+	{
+		0x0000, 0x2482, 0x5a00, 0x5f7d, 0x3c9e, 0x52a5, 0x2aab, 0x2400,
+		0x1491, 0x4494, 0x0aa8, 0x05d0, 0x0014, 0x01c0, 0x0002, 0x12a4,
+		0x7b6f, 0x2c97, 0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249,
+		0x7bef, 0x7bcf, 0x0410, 0x0414, 0x1511, 0x0e38, 0x4454, 0x7282,
+		0x2be3, 0x2bed, 0x6bae, 0x3923, 0x6b6e, 0x79a7, 0x79a4, 0x396b,
+		0x5bed, 0x7497, 0x126a, 0x5bad, 0x4927, 0x5fed, 0x6b6d, 0x2b6a,
+		0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492, 0x5b6f, 0x5b6a, 0x5bfd,
+		0x5aad, 0x5a92, 0x72a7, 0x3493, 0x4889, 0x6496, 0x2a00, 0x0007,
+	};
+
+	// Each glyph's 3 by 5 texels in a row, a texel apart.
+	const int FONT_WIDTH = 64 * 4;
+	const int FONT_HEIGHT = 5;
+
+	// Panels go under the lines and text drawn over them.
+	const unsigned int PANEL_LAYER = 0;
+	const unsigned int CONTENT_LAYER = 1;
+
+	/**
+		formatCount writes a count in as few characters as it takes, with
+			K or M for thousands and millions.
+	*/
+	void formatCount(char* a_buffer, size_t a_size, double a_count)
+	{
+		if (a_count >= 1000000.0)
+			snprintf(a_buffer, a_size, "%.1fM", a_count / 1000000.0);
+		else if (a_count >= 10000.0)
+			snprintf(a_buffer, a_size, "%.1fK", a_count / 1000.0);
+		else
+			snprintf(a_buffer, a_size, "%.0f", a_count);
+	}
+}
+
+namespace sns
+{
+	DebugHud::DebugHud()
+		: m_visible(false),
+		m_enabledProfiler(false),
+		m_passes(),
+		m_font(0),
+		m_fontFile(nullptr)
+	{
+	}
+
+	/**
+		The deconstructor deletes the font's texture.
+	*/
+	DebugHud::~DebugHud()
+	{
+		if (m_font != 0)
+		{
+			glDeleteTextures(1, &m_font);
+			RenderState::instance().onTextureDeleted(m_font);
+			GpuMemory::instance().releaseTexture(m_font);
+		}
+	}
+
+	/**
+		create makes the sprite batch and the font's texture, a texel a
+			cell, the glyphs' rows from the bottom so a quad's bottom is
+			the bottom of its glyph.
+
+			@return false if the sprite batch can't be made.
+	*/
+	bool DebugHud::create()
+	{
+		if (m_sprites.create() == false)
+			return false;
+		if (m_fontFile != nullptr && m_textFont.isLoaded() == false)
+		{
+			m_textFont.load(m_fontFile);
+			m_fontFile = nullptr;
+		}
+		if (m_font != 0)
+			return true;
+
+		unsigned char texels[FONT_HEIGHT][FONT_WIDTH] = {};
+		for (unsigned int glyph = 0; glyph < 64; ++glyph)
+		{
+			for (unsigned int row = 0; row < 5; ++row)
+			{
+				unsigned int bits = (FONT[glyph] >> ((4 - row) * 3)) & 7;
+				for (unsigned int column = 0; column < 3; ++column)
+					texels[4 - row][glyph * 4 + column] = (bits & (4 >> column)) != 0 ? 255 : 0;
+			}
+		}
+
+		// White with the cells as alpha, so sprites tint it. Nearest, as
+		//	the cells are drawn SCALE pixels square.
+		const GLint SWIZZLE[4] = { GL_ONE, GL_ONE, GL_ONE, GL_RED };
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_font);
+		glTextureStorage2D(m_font, 1, GL_R8, FONT_WIDTH, FONT_HEIGHT);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(m_font, 0, 0, 0, FONT_WIDTH, FONT_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, texels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTextureParameteri(m_font, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_font, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteriv(m_font, GL_TEXTURE_SWIZZLE_RGBA, SWIZZLE);
+		GpuMemory::instance().trackTexture(m_font, GpuMemory::getTextureBytes(GL_R8, FONT_WIDTH, FONT_HEIGHT),
+			GpuMemory::TEXTURES, "DebugHud");
+		return true;
+	}
+
+	/**
+		toggle shows or hides the hud, and turns the profiler on while it
+			is shown if it wasn't already.
+	*/
+	void DebugHud::toggle()
+	{
+		if (m_visible == false && create() == false)
+		{
+			printf("DebugHud: the hud needs GL 4.5.\n");
+			return;
+		}
+
+		m_visible = !m_visible;
+		if (m_visible && Profiler::isEnabled() == false)
+		{
+			Profiler::setEnabled(true);
+			m_enabledProfiler = true;
+		}
+		else if (m_visible == false && m_enabledProfiler)
+		{
+			Profiler::setEnabled(false);
+			m_enabledProfiler = false;
+		}
+	}
+
+	/**
+		draw draws the hud over whatever is bound, the graphs and passes
+			down the left and the counters down the right.
+
+			@param1 a_width is the width of the target in pixels.
+
+			@param2 a_height is its height.
+	*/
+	void DebugHud::draw(unsigned int a_width, unsigned int a_height)
+	{
+		if (m_visible == false)
+			return;
+
+		float top = (float)a_height - MARGIN;
+		float graphBottom = addGraph(glm::vec2(MARGIN, top));
+		addPasses(glm::vec2(MARGIN, graphBottom - MARGIN));
+		addCounters(glm::vec2((float)a_width - MARGIN, top));
+
+		// Over everything, whatever the depth buffer holds.
+		RenderState& state = RenderState::instance();
+		state.setDepthTest(false);
+		m_sprites.draw((float)a_width, (float)a_height);
+		state.setDepthTest(true);
+	}
+
+	/**
+		addGraph adds the cpu and gpu frame time graphs, newest on the
+			right, with their averages above them. The gpu time is the
+			sum of the gpu scopes, and only known GPU_LATENCY frames on.
+
+			@param1 a_position is the top left of the graph's panel.
+
+			@return the bottom of the panel.
+	*/
+	float DebugHud::addGraph(const glm::vec2& a_position)
+	{
+		glm::vec2 size(GRAPH_WIDTH + PADDING * 2, LINE_HEIGHT * 2 + GRAPH_HEIGHT + PADDING * 2);
+		addPanel(a_position, size);
+
+		glm::vec2 origin(a_position.x + PADDING, a_position.y - size.y + PADDING);
+		float sixtyHertz = origin.y + (float)(1000.0 / 60.0 / GRAPH_MILLISECONDS) * GRAPH_HEIGHT;
+		addLine(glm::vec2(origin.x, sixtyHertz), glm::vec2(origin.x + GRAPH_WIDTH, sixtyHertz), GUIDE_COLOUR);
+
+		double cpuTotal = 0.0;
+		double gpuTotal = 0.0;
+		unsigned int cpuFrames = 0;
+		unsigned int gpuFrames = 0;
+		glm::vec2 lastCpu, lastGpu;
+		bool hadGpu = false;
+		for (unsigned int age = 0; age < Profiler::HISTORY_SIZE; ++age)
+		{
+			const Profiler::Frame* frame = Profiler::getFrame(age);
+			if (frame == nullptr)
+				break;
+
+			double gpu = 0.0;
+			bool hasGpu = false;
+			for (const Profiler::Event& event : frame->events)
+			{
+				if (event.thread == Profiler::GPU_THREAD)
+				{
+					gpu += event.duration;
+					hasGpu = true;
+				}
+			}
+
+			float x = origin.x + GRAPH_WIDTH - age * (GRAPH_WIDTH / Profiler::HISTORY_SIZE);
+			double cpuMilliseconds = frame->duration * 0.001;
+			glm::vec2 cpuPoint(x, origin.y + (float)(std::fmin(cpuMilliseconds, GRAPH_MILLISECONDS) / GRAPH_MILLISECONDS) * GRAPH_HEIGHT);
+			if (cpuFrames > 0)
+				addLine(lastCpu, cpuPoint, CPU_COLOUR);
+			lastCpu = cpuPoint;
+			cpuTotal += cpuMilliseconds;
+			++cpuFrames;
+
+			// The newest frames' queries haven't been read yet.
+			if (hasGpu)
+			{
+				double gpuMilliseconds = gpu * 0.001;
+				glm::vec2 gpuPoint(x, origin.y + (float)(std::fmin(gpuMilliseconds, GRAPH_MILLISECONDS) / GRAPH_MILLISECONDS) * GRAPH_HEIGHT);
+				if (hadGpu)
+					addLine(lastGpu, gpuPoint, GPU_COLOUR);
+				lastGpu = gpuPoint;
+				gpuTotal += gpuMilliseconds;
+				++gpuFrames;
+			}
+			hadGpu = hasGpu;
+		}
+
+		char line[64];
+		glm::vec2 text(a_position.x + PADDING, a_position.y - PADDING);
+		snprintf(line, sizeof(line), "CPU %6.2f MS   %5.0f FPS", cpuFrames > 0 ? cpuTotal / cpuFrames : 0.0,
+			cpuTotal > 0.0 ? cpuFrames * 1000.0 / cpuTotal : 0.0);
+		addText(text, line, CPU_COLOUR);
+		snprintf(line, sizeof(line), "GPU %6.2f MS   LINE AT 60HZ", gpuFrames > 0 ? gpuTotal / gpuFrames : 0.0);
+		addText(text - glm::vec2(0, LINE_HEIGHT), line, GPU_COLOUR);
+
+		return a_position.y - size.y;
+	}
+
+	/**
+		addPasses adds the pass table, each gpu scope averaged across the
+			last PASS_FRAMES frames its queries were read for, along with
+			the cpu scope of the same name.
+
+			@param1 a_position is the top left of the table's panel.
+	*/
+	void DebugHud::addPasses(const glm::vec2& a_position)
+	{
+		m_passes.clear();
+		unsigned int frames = 0;
+		for (unsigned int age = 0; age < Profiler::HISTORY_SIZE && frames < PASS_FRAMES; ++age)
+		{
+			const Profiler::Frame* frame = Profiler::getFrame(age);
+			if (frame == nullptr)
+				break;
+
+			// Rows come from the gpu scopes, in the order the newest frame
+			//	drew them.
+			bool hasGpu = false;
+			for (const Profiler::Event& event : frame->events)
+			{
+				if (event.thread != Profiler::GPU_THREAD)
+					continue;
+
+				hasGpu = true;
+				Pass* pass = nullptr;
+				for (Pass& p : m_passes)
+				{
+					if (p.name == event.name || std::strcmp(p.name, event.name) == 0)
+					{
+						pass = &p;
+						break;
+					}
+				}
+				if (pass == nullptr)
+				{
+					m_passes.push_back({ event.name, 0.0, 0.0, 0, 0, 0 });
+					pass = &m_passes.back();
+				}
+				pass->gpuMicroseconds += event.duration;
+				pass->draws += event.draws;
+				pass->stateChanges += event.stateChanges;
+				pass->primitives += event.primitives;
+			}
+			if (hasGpu == false)
+				continue;
+			++frames;
+
+			for (const Profiler::Event& event : frame->events)
+			{
+				if (Profiler::isGpuThread(event.thread))
+					continue;
+
+				for (Pass& p : m_passes)
+				{
+					if (p.name == event.name || std::strcmp(p.name, event.name) == 0)
+					{
+						p.cpuMicroseconds += event.duration;
+						break;
+					}
+				}
+			}
+		}
+
+		unsigned int lines = (unsigned int)m_passes.size() + 2;
+		addPanel(a_position, glm::vec2(54 * ADVANCE + PADDING * 2, lines * LINE_HEIGHT - (LINE_HEIGHT - GLYPH_HEIGHT) + PADDING * 2));
+
+		glm::vec2 text(a_position.x + PADDING, a_position.y - PADDING);
+		addText(text, "PASS                 GPU MS CPU MS DRAWS STATE   PRIMS", HEADING_COLOUR);
+
+		Pass total = { "TOTAL", 0.0, 0.0, 0, 0, 0 };
+		double scale = frames > 0 ? 1.0 / frames : 0.0;
+		char line[96];
+		char primitives[16];
+		for (unsigned int i = 0; i <= m_passes.size(); ++i)
+		{
+			bool isTotal = i == m_passes.size();
+			const Pass& pass = isTotal ? total : m_passes[i];
+			formatCount(primitives, sizeof(primitives), pass.primitives * scale);
+			snprintf(line, sizeof(line), "%-20.20s %6.2f %6.2f %5.0f %5.0f %7s", pass.name,
+				pass.gpuMicroseconds * scale * 0.001, pass.cpuMicroseconds * scale * 0.001,
+				pass.draws * scale, pass.stateChanges * scale, primitives);
+			addText(text - glm::vec2(0, LINE_HEIGHT * (i + 1)), line, isTotal ? HEADING_COLOUR : TEXT_COLOUR);
+
+			total.gpuMicroseconds += pass.gpuMicroseconds;
+			total.cpuMicroseconds += pass.cpuMicroseconds;
+			total.draws += pass.draws;
+			total.stateChanges += pass.stateChanges;
+			total.primitives += pass.primitives;
+		}
+	}
+
+	/**
+		addCounters adds every counter the last frame set, in the order
+			it set them.
+
+			@param1 a_position is the top right of the counters' panel.
+	*/
+	void DebugHud::addCounters(const glm::vec2& a_position)
+	{
+		const Profiler::Frame* frame = Profiler::getFrame(0);
+		if (frame == nullptr || frame->counters.empty())
+			return;
+
+		const unsigned int columns = 39;
+		unsigned int lines = (unsigned int)frame->counters.size();
+		glm::vec2 size(columns * ADVANCE + PADDING * 2, lines * LINE_HEIGHT - (LINE_HEIGHT - GLYPH_HEIGHT) + PADDING * 2);
+		glm::vec2 topLeft(a_position.x - size.x, a_position.y);
+		addPanel(topLeft, size);
+
+		char line[64];
+		char value[16];
+		glm::vec2 text(topLeft.x + PADDING, topLeft.y - PADDING);
+		for (const Profiler::Counter& counter : frame->counters)
+		{
+			if (counter.value == std::floor(counter.value) && std::fabs(counter.value) < 1e9)
+				snprintf(value, sizeof(value), "%.0f", counter.value);
+			else
+				snprintf(value, sizeof(value), "%.2f", counter.value);
+			snprintf(line, sizeof(line), "%-28.28s %10s", counter.name, value);
+			addText(text, line, TEXT_COLOUR);
+			text.y -= LINE_HEIGHT;
+		}
+	}
+
+	/**
+		addText adds a line of text, a quad of the font a character. With
+			an SdfFont the line is the glyphs' height again, centred on
+			them, and kept to the block font's columns.
+
+			@param1 a_position is the top left of the first character.
+
+			@param2 a_text is the text.
+
+			@param3 a_colour is its colour.
+	*/
+	void DebugHud::addText(const glm::vec2& a_position, const char* a_text, const glm::vec4& a_colour)
+	{
+		if (m_textFont.isLoaded())
+		{
+			glm::vec2 top(a_position.x, a_position.y + (LINE_HEIGHT - GLYPH_HEIGHT) * 0.5f);
+			m_textFont.addText(m_sprites, top, a_text, LINE_HEIGHT, a_colour, CONTENT_LAYER, ADVANCE);
+			return;
+		}
+
+		glm::vec2 size(3 * SCALE, GLYPH_HEIGHT);
+		glm::vec2 centre(a_position.x + size.x * 0.5f, a_position.y - size.y * 0.5f);
+		for (const char* c = a_text; *c != '\0'; ++c, centre.x += ADVANCE)
+		{
+			int character = *c >= 'a' && *c <= 'z' ? *c - 'a' + 'A' : *c;
+			if (character <= ' ' || character > '_')
+				continue;
+
+			float u = (float)((character - ' ') * 4) / FONT_WIDTH;
+			glm::vec4 texCoords(u, 0, u + 3.0f / FONT_WIDTH, 1);
+			m_sprites.add(m_font, centre, size, a_colour, texCoords, 0.0f, CONTENT_LAYER);
+		}
+	}
+
+	/**
+		addPanel adds the translucent background a block is drawn over.
+
+			@param1 a_position is the panel's top left.
+
+			@param2 a_size is its width and height in pixels.
+	*/
+	void DebugHud::addPanel(const glm::vec2& a_position, const glm::vec2& a_size)
+	{
+		glm::vec2 centre(a_position.x + a_size.x * 0.5f, a_position.y - a_size.y * 0.5f);
+		m_sprites.addRect(centre, a_size, PANEL_COLOUR, PANEL_LAYER);
+	}
+
+	/**
+		addLine adds a line as a thin quad turned along it.
+
+			@param1 a_start is where it starts.
+
+			@param2 a_end is where it ends.
+
+			@param3 a_colour is its colour.
+	*/
+	void DebugHud::addLine(const glm::vec2& a_start, const glm::vec2& a_end, const glm::vec4& a_colour)
+	{
+		glm::vec2 direction = a_end - a_start;
+		float length = glm::length(direction);
+		if (length <= 0.0f)
+			return;
+
+		m_sprites.add(0, (a_start + a_end) * 0.5f, glm::vec2(length, 1.5f), a_colour, glm::vec4(0, 0, 1, 1),
+			std::atan2(direction.y, direction.x), CONTENT_LAYER);
+	}
+}
@@ -0,0 +1,176 @@
+/**
+	DebugHud.h
+
+	Purpose: DebugHud.h is the header file for the DebugHud class. The
+			DebugHud draws the profiler's last frames over the window,
+			as frame time graphs, a table of what each pass cost and
+			every counter the frame set.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SdfFont.h"
+#include "SpriteBatch.h"
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The DebugHud class is drawn with a SpriteBatch of its own, its
+			text in a small block font it makes a texture of, a quad a
+			character, so the whole hud is a draw or two. Given an
+			SdfFont its text is drawn in that instead, in the same
+			columns.
+
+		Everything it shows comes from the Profiler's history. Passes are
+			the gpu scopes, with the time, draw calls, state changes and
+			primitives each one recorded, so a pass shows up as soon as
+			it has a SNS_PROFILE_GPU_SCOPE. While it is shown it turns the
+			profiler on if nothing else has, and off again once hidden,
+			so hidden it costs what the disabled scopes do.
+	*/
+	class DebugHud
+	{
+	public:
+		// How many of the last frames the pass table is averaged over.
+		static const unsigned int PASS_FRAMES = 30;
+
+		DebugHud();
+
+		/**
+			The deconstructor deletes the font's texture.
+		*/
+		~DebugHud();
+
+		DebugHud(const DebugHud&) = delete;
+		DebugHud& operator=(const DebugHud&) = delete;
+
+		/**
+			toggle shows or hides the hud. Only call it between frames, as
+				it can turn the profiler on or off. The first time it is
+				shown it makes its sprites and font, and stays hidden
+				without GL 4.5.
+		*/
+		void toggle();
+
+		/**
+			setFont draws the hud's text in a font file of SdfFont's
+				instead of the block font, from the next time it is
+				shown. A monospaced one suits its tables best.
+
+				@param1 a_filename is the font file.
+		*/
+		void setFont(const char* a_filename) { m_fontFile = a_filename; }
+
+		/**
+			isVisible returns whether the hud is shown.
+		*/
+		bool isVisible() const { return m_visible; }
+
+		/**
+			draw draws the hud over whatever is bound, a pixel to a unit.
+				Nothing is drawn while it is hidden.
+
+				@param1 a_width is the width of the target in pixels.
+
+				@param2 a_height is its height.
+		*/
+		void draw(unsigned int a_width, unsigned int a_height);
+
+	private:
+		/**
+			A row of the pass table, its totals across the frames read.
+		*/
+		struct Pass
+		{
+			const char* name;
+			double gpuMicroseconds;
+			double cpuMicroseconds;
+			unsigned long long draws;
+			unsigned long long stateChanges;
+			unsigned long long primitives;
+		};
+
+		/**
+			addGraph adds the cpu and gpu frame time graphs, with their
+				averages above them.
+
+				@param1 a_position is the top left of the graph's panel.
+
+				@return the bottom of the panel.
+		*/
+		float addGraph(const glm::vec2& a_position);
+
+		/**
+			addPasses adds the pass table.
+
+				@param1 a_position is the top left of the table's panel.
+		*/
+		void addPasses(const glm::vec2& a_position);
+
+		/**
+			addCounters adds every counter the last frame set.
+
+				@param1 a_position is the top right of the counters' panel.
+		*/
+		void addCounters(const glm::vec2& a_position);
+
+		/**
+			addText adds a line of text. Lowercase letters are drawn as
+				uppercase and anything the font lacks as a space.
+
+				@param1 a_position is the top left of the first character.
+
+				@param2 a_text is the text.
+
+				@param3 a_colour is its colour.
+		*/
+		void addText(const glm::vec2& a_position, const char* a_text, const glm::vec4& a_colour);
+
+		/**
+			addPanel adds the translucent background a block is drawn over.
+
+				@param1 a_position is the panel's top left.
+
+				@param2 a_size is its width and height in pixels.
+		*/
+		void addPanel(const glm::vec2& a_position, const glm::vec2& a_size);
+
+		/**
+			addLine adds a line as a thin quad turned along it.
+
+				@param1 a_start is where it starts.
+
+				@param2 a_end is where it ends.
+
+				@param3 a_colour is its colour.
+		*/
+		void addLine(const glm::vec2& a_start, const glm::vec2& a_end, const glm::vec4& a_colour);
+
+		/**
+			create makes the sprite batch and the font's texture.
+
+				@return false if the sprite batch can't be made.
+		*/
+		bool create();
+
+		bool m_visible;
+
+		// Whether showing the hud turned the profiler on, so hiding it
+		//	only turns off what it turned on.
+		bool m_enabledProfiler;
+
+		// Kept between frames so reading the passes doesn't allocate.
+		std::vector<Pass> m_passes;
+
+		// Everything the hud draws, and the font's glyphs in a row.
+		SpriteBatch m_sprites;
+		unsigned int m_font;
+
+		// The font given by setFont, loaded once it is shown.
+		const char* m_fontFile;
+		SdfFont m_textFont;
+	};
+}
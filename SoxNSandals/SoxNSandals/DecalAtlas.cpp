@@ -0,0 +1,119 @@
+/**
+	DecalAtlas.cpp
+
+	Purpose: DecalAtlas.cpp is the source file for the DecalAtlas class.
+			The DecalAtlas gathers the textures of the scene's decals
+			into one texture array, so every decal a fragment is
+			covered by is sampled without binding anything.
+
+	@author Nathan Nette
+*/
+#include "DecalAtlas.h"
+#include "GpuMemory.h"
+#include "SamplerCache.h"
+#include "Texture.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+
+namespace sns
+{
+	// What every layer is stored as.
+	static const unsigned int DECAL_FORMAT = GL_RGBA8;
+
+	DecalAtlas::DecalAtlas()
+		: m_sampler(0),
+		m_levels(0),
+		m_layerCount(0)
+	{
+	}
+
+	/**
+		The deconstructor lets the handle delete the array. The sampler
+			belongs to the SamplerCache.
+	*/
+	DecalAtlas::~DecalAtlas()
+	{
+	}
+
+	/**
+		create makes the array, with every layer's mip chain.
+
+			@return false without GL 4.5.
+	*/
+	bool DecalAtlas::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("DecalAtlas: decals need GL 4.5.\n");
+			return false;
+		}
+
+		m_levels = 1;
+		while ((RESOLUTION >> m_levels) != 0)
+			++m_levels;
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, m_texture.put());
+		glTextureStorage3D(m_texture, m_levels, DECAL_FORMAT, RESOLUTION, RESOLUTION, MAX_TEXTURES);
+		GpuMemory::instance().trackTexture(m_texture, GpuMemory::getTextureBytes(DECAL_FORMAT, RESOLUTION, RESOLUTION,
+			MAX_TEXTURES, m_levels), GpuMemory::TEXTURES, "DecalAtlas");
+		m_sampler = SamplerCache::instance().get({ GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE,
+			GL_CLAMP_TO_EDGE, true });
+		m_layerCount = 0;
+		m_layers.clear();
+		return true;
+	}
+
+	/**
+		add loads a texture and blits it into the next layer, scaled to
+			fill it, then makes the array's mips again.
+
+			@param1 a_filename is an uncompressed image.
+
+			@return its layer, -1 if it couldn't be loaded, was block
+					compressed or the array is full.
+	*/
+	int DecalAtlas::add(const std::string& a_filename)
+	{
+		if (isCreated() == false)
+			return -1;
+		auto found = m_layers.find(a_filename);
+		if (found != m_layers.end())
+			return found->second;
+
+		int layer = -1;
+		aie::Texture texture;
+		if (m_layerCount == MAX_TEXTURES)
+			printf("DecalAtlas: only %u decal textures fit, %s is left out.\n", MAX_TEXTURES, a_filename.c_str());
+		else if (texture.load(a_filename.c_str()) == false)
+			printf("DecalAtlas: failed to load %s.\n", a_filename.c_str());
+		else if (texture.isCompressed())
+			printf("DecalAtlas: %s is block compressed and can't be blitted.\n", a_filename.c_str());
+		else
+		{
+			// Blitting scales the texture to the layer, whatever its size,
+			//	and gives it alpha if it had none.
+			unsigned int framebuffers[2];
+			glCreateFramebuffers(2, framebuffers);
+			glNamedFramebufferTexture(framebuffers[0], GL_COLOR_ATTACHMENT0, texture.getHandle(), 0);
+			glNamedFramebufferTextureLayer(framebuffers[1], GL_COLOR_ATTACHMENT0, m_texture, 0, m_layerCount);
+			glBlitNamedFramebuffer(framebuffers[0], framebuffers[1], 0, 0, texture.getWidth(), texture.getHeight(),
+				0, 0, RESOLUTION, RESOLUTION, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glDeleteFramebuffers(2, framebuffers);
+			glGenerateTextureMipmap(m_texture);
+			layer = (int)m_layerCount++;
+		}
+
+		m_layers.emplace(a_filename, layer);
+		return layer;
+	}
+
+	/**
+		bind binds the array to UNIT with its sampler.
+	*/
+	void DecalAtlas::bind() const
+	{
+		glBindTextureUnit(UNIT, m_texture);
+		glBindSampler(UNIT, m_sampler);
+	}
+}
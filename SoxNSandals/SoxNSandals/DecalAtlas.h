@@ -0,0 +1,96 @@
+/**
+	DecalAtlas.h
+
+	Purpose: DecalAtlas.h is the header file for the DecalAtlas class.
+			The DecalAtlas gathers the textures of the scene's decals
+			into one texture array, so every decal a fragment is
+			covered by is sampled without binding anything.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include <string>
+#include <unordered_map>
+
+namespace sns
+{
+	/**
+		The DecalAtlas class gives each decal texture added to it a layer
+			of a RESOLUTION square GL_TEXTURE_2D_ARRAY of RGBA8 with a
+			full mip chain. Textures of any size are scaled into their
+			layer on the gpu by a blit, so signage and dirt of different
+			sizes share the array, and their mips are made again after
+			each one.
+
+		The LightClusters bin each decal with its layer, and the lit
+			shaders read the array at UNIT, see lighting.glsl. Textures
+			are kept by filename, so decals sharing one share its layer.
+			Needs GL 4.5, without it create fails and decals are left
+			unbinned.
+	*/
+	class DecalAtlas
+	{
+	public:
+		// The width and height of every layer.
+		static const unsigned int RESOLUTION = 256;
+
+		// The most textures the decals can have between them.
+		static const unsigned int MAX_TEXTURES = 32;
+
+		// The texture unit the lit shaders read the array from, clear of
+		//	every unit another pass binds.
+		static const unsigned int UNIT = 25;
+
+		DecalAtlas();
+		~DecalAtlas();
+
+		DecalAtlas(const DecalAtlas&) = delete;
+		DecalAtlas& operator=(const DecalAtlas&) = delete;
+
+		/**
+			create makes the array.
+
+				@return false without GL 4.5.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_texture != 0; }
+
+		/**
+			add loads a texture into the next layer, or finds the layer it
+				was given before.
+
+				@param1 a_filename is an uncompressed image.
+
+				@return its layer, -1 if it couldn't be loaded, was block
+						compressed or the array is full.
+		*/
+		int add(const std::string& a_filename);
+
+		/**
+			getLayerCount returns how many layers are in use.
+		*/
+		unsigned int getLayerCount() const { return m_layerCount; }
+
+		/**
+			getTexture returns the array, 0 before create.
+		*/
+		unsigned int getTexture() const { return m_texture; }
+
+		/**
+			bind binds the array to UNIT with its sampler.
+		*/
+		void bind() const;
+
+	private:
+		TextureHandle m_texture;
+		unsigned int m_sampler;
+		unsigned int m_levels;
+		unsigned int m_layerCount;
+		std::unordered_map<std::string, int> m_layers;
+	};
+}
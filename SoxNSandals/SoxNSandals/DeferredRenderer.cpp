@@ -0,0 +1,286 @@
+/**
+	DeferredRenderer.cpp
+
+	Purpose: DeferredRenderer.cpp is the source file for the
+			DeferredRenderer class. The DeferredRenderer draws the
+			scene's materials into a g-buffer once and lights it
+			afterwards, so the cost of lights no longer grows with the
+			triangles they fall on.
+
+	@author Nathan Nette
+*/
+#include "DeferredRenderer.h"
+#include "GpuMemory.h"
+#include "LightClusters.h"
+#include "ShadowAtlas.h"
+#include "ShadowCascades.h"
+#include "VolumetricFog.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	// The buffer binding the lighting shader reads the lights from.
+	static const unsigned int LIGHT_BINDING = 0;
+
+	// The units the lighting shader reads the g-buffer from.
+	static const unsigned int DEPTH_UNIT = 0;
+	static const unsigned int ALBEDO_UNIT = 1;
+	static const unsigned int NORMAL_UNIT = 2;
+	static const unsigned int SPECULAR_UNIT = 3;
+
+	DeferredRenderer::DeferredRenderer()
+		: m_gBuffer(0),
+		m_albedoTexture(0),
+		m_normalTexture(0),
+		m_specularTexture(0),
+		m_depthTexture(0),
+		m_litFramebuffer(0),
+		m_litTexture(0),
+		m_width(0),
+		m_height(0),
+		m_renderWidth(0),
+		m_renderHeight(0),
+		m_previousFramebuffer(0),
+		m_previousViewport()
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffers and textures.
+	*/
+	DeferredRenderer::~DeferredRenderer()
+	{
+		destroy();
+	}
+
+	// Makes a render target, read only with texelFetch.
+	static unsigned int createTarget(unsigned int a_format, int a_width, int a_height)
+	{
+		unsigned int texture = 0;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, a_format, a_width, a_height);
+		GpuMemory::instance().trackTexture(texture, GpuMemory::getTextureBytes(a_format, a_width, a_height),
+			GpuMemory::RENDER_TARGETS, "DeferredRenderer");
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		return texture;
+	}
+
+	/**
+		create makes the g-buffer and lit texture and loads the lighting
+			shader.
+
+			@param1 a_width is the width the scene is drawn at.
+
+			@param2 a_height is the height it is drawn at.
+
+			@return false without GL 4.3 or the shader, the renderer is
+					left uncreated.
+	*/
+	bool DeferredRenderer::create(int a_width, int a_height)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("DeferredRenderer: deferred shading needs GL 4.3.\n");
+			return false;
+		}
+
+		if (m_lightingShader.getHandle() == 0)
+		{
+			m_lightingShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/deferredLighting.comp");
+			if (m_lightingShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_lightingShader.getLastError());
+				return false;
+			}
+		}
+
+		m_width = a_width > 1 ? a_width : 1;
+		m_height = a_height > 1 ? a_height : 1;
+
+		// The depth matches the scene's, the window's or the scene
+		//	target's, so it can be blitted into it.
+		m_albedoTexture = createTarget(GL_RGBA8, m_width, m_height);
+		m_normalTexture = createTarget(GL_RG16, m_width, m_height);
+		m_specularTexture = createTarget(GL_RG8, m_width, m_height);
+		m_depthTexture = createTarget(RenderState::instance().getDepthFormat(), m_width, m_height);
+
+		const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+		glCreateFramebuffers(1, &m_gBuffer);
+		glNamedFramebufferTexture(m_gBuffer, GL_COLOR_ATTACHMENT0, m_albedoTexture, 0);
+		glNamedFramebufferTexture(m_gBuffer, GL_COLOR_ATTACHMENT1, m_normalTexture, 0);
+		glNamedFramebufferTexture(m_gBuffer, GL_COLOR_ATTACHMENT2, m_specularTexture, 0);
+		glNamedFramebufferTexture(m_gBuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_depthTexture, 0);
+		glNamedFramebufferDrawBuffers(m_gBuffer, 3, drawBuffers);
+		bool complete = glCheckNamedFramebufferStatus(m_gBuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+		m_litTexture = createTarget(GL_RGBA16F, m_width, m_height);
+		glCreateFramebuffers(1, &m_litFramebuffer);
+		glNamedFramebufferTexture(m_litFramebuffer, GL_COLOR_ATTACHMENT0, m_litTexture, 0);
+		glNamedFramebufferReadBuffer(m_litFramebuffer, GL_COLOR_ATTACHMENT0);
+		complete = complete && glCheckNamedFramebufferStatus(m_litFramebuffer, GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+		if (complete == false)
+		{
+			printf("DeferredRenderer: the g-buffer isn't complete.\n");
+			destroy();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		begin binds and clears the g-buffer, and draws into as much of it
+			as the viewport bound before covers. The scene is drawn after
+			it with the g-buffer shaders.
+	*/
+	void DeferredRenderer::begin()
+	{
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+		m_renderWidth = std::min(std::max(m_previousViewport[2], 1), m_width);
+		m_renderHeight = std::min(std::max(m_previousViewport[3], 1), m_height);
+
+		// Nothing reads the colour where nothing was drawn, only the depth.
+		glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer);
+		glViewport(0, 0, m_renderWidth, m_renderHeight);
+		RenderState::instance().setDepthMask(true);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	/**
+		end puts back the framebuffer and viewport begin replaced.
+	*/
+	void DeferredRenderer::end()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+		glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+	}
+
+	/**
+		light lights the g-buffer into the lit texture.
+
+			@param1 a_lights holds the point and spot lights, already
+					uploaded this frame.
+
+			@param2 a_shadows holds the directional light's shadows,
+					already updated this frame.
+
+			@param3 a_atlas holds the point and spot lights' shadows,
+					already updated this frame.
+
+			@param4 a_fog holds the volumetric fog, already updated for
+					the view when it is on.
+
+			@param5 a_view is the camera's view.
+
+			@param6 a_projection is the camera's projection.
+	*/
+	void DeferredRenderer::light(const LightClusters& a_lights, const ShadowCascades& a_shadows,
+		const ShadowAtlas& a_atlas, const VolumetricFog& a_fog, const glm::mat4& a_view, const glm::mat4& a_projection)
+	{
+		static constexpr aie::UniformHandle GBUFFER_DEPTH("GBufferDepth");
+		static constexpr aie::UniformHandle GBUFFER_ALBEDO("GBufferAlbedo");
+		static constexpr aie::UniformHandle GBUFFER_NORMAL("GBufferNormal");
+		static constexpr aie::UniformHandle GBUFFER_SPECULAR("GBufferSpecular");
+		static constexpr aie::UniformHandle LIT("Lit");
+		static constexpr aie::UniformHandle INVERSE_PROJECTION("InverseProjection");
+		static constexpr aie::UniformHandle INVERSE_VIEW("InverseView");
+		static constexpr aie::UniformHandle LIGHT_COUNT("LightCount");
+		static constexpr aie::UniformHandle BACKGROUND("Background");
+		static constexpr aie::UniformHandle DEPTH_TO_NDC("DepthToNdc");
+		static constexpr aie::UniformHandle FAR_DEPTH("FarDepth");
+		static constexpr aie::UniformHandle RENDER_SIZE("RenderSize");
+
+		if (isCreated() == false)
+			return;
+
+		// The g-buffer was just drawn to.
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		glm::vec4 background;
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, &background[0]);
+
+		m_lightingShader.bind();
+		m_lightingShader.bindUniform(GBUFFER_DEPTH, (int)DEPTH_UNIT);
+		m_lightingShader.bindUniform(GBUFFER_ALBEDO, (int)ALBEDO_UNIT);
+		m_lightingShader.bindUniform(GBUFFER_NORMAL, (int)NORMAL_UNIT);
+		m_lightingShader.bindUniform(GBUFFER_SPECULAR, (int)SPECULAR_UNIT);
+		m_lightingShader.bindUniform(LIT, 0);
+		m_lightingShader.bindUniform(INVERSE_PROJECTION, glm::inverse(a_projection));
+		m_lightingShader.bindUniform(INVERSE_VIEW, glm::inverse(a_view));
+		m_lightingShader.bindUniform(LIGHT_COUNT, (int)a_lights.getLightCount());
+		m_lightingShader.bindUniform(BACKGROUND, background);
+		m_lightingShader.bindUniform(RENDER_SIZE, glm::vec2(m_renderWidth, m_renderHeight));
+		a_shadows.bind(m_lightingShader);
+		a_atlas.bind(m_lightingShader);
+		a_fog.bind(m_lightingShader);
+
+		// Reversed depth is already clip space z, GL's usual depth is
+		//	moved from 0 to 1 back out to -1 to 1.
+		RenderState& state = RenderState::instance();
+		m_lightingShader.bindUniform(DEPTH_TO_NDC, state.isReverseZ() ? glm::vec2(1, 0) : glm::vec2(2, -1));
+		m_lightingShader.bindUniform(FAR_DEPTH, state.getFarDepth());
+		state.bindTexture(DEPTH_UNIT, m_depthTexture);
+		state.bindTexture(ALBEDO_UNIT, m_albedoTexture);
+		state.bindTexture(NORMAL_UNIT, m_normalTexture);
+		state.bindTexture(SPECULAR_UNIT, m_specularTexture);
+		glBindImageTexture(0, m_litTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, a_lights.getLightBuffer());
+
+		glDispatchCompute((m_renderWidth + TILE_SIZE - 1) / TILE_SIZE, (m_renderHeight + TILE_SIZE - 1) / TILE_SIZE, 1);
+
+		// present blits the result.
+		glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+		// Materials bind these units next, the render state must not
+		//	think the g-buffer is still on them.
+		state.bindTexture(DEPTH_UNIT, 0);
+		state.bindTexture(ALBEDO_UNIT, 0);
+		state.bindTexture(NORMAL_UNIT, 0);
+		state.bindTexture(SPECULAR_UNIT, 0);
+	}
+
+	/**
+		present copies the lit scene and its depth into the framebuffer
+			that was bound at begin.
+	*/
+	void DeferredRenderer::present()
+	{
+		if (isCreated() == false)
+			return;
+
+		glBlitNamedFramebuffer(m_litFramebuffer, m_previousFramebuffer, 0, 0, m_renderWidth, m_renderHeight,
+			0, 0, m_renderWidth, m_renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBlitNamedFramebuffer(m_gBuffer, m_previousFramebuffer, 0, 0, m_renderWidth, m_renderHeight,
+			0, 0, m_renderWidth, m_renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+
+	/**
+		destroy deletes the framebuffers and textures.
+	*/
+	void DeferredRenderer::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		unsigned int* textures[5] = { &m_albedoTexture, &m_normalTexture, &m_specularTexture, &m_depthTexture, &m_litTexture };
+		for (unsigned int* texture : textures)
+		{
+			if (*texture != 0)
+			{
+				glDeleteTextures(1, texture);
+				state.onTextureDeleted(*texture);
+				GpuMemory::instance().releaseTexture(*texture);
+				*texture = 0;
+			}
+		}
+		glDeleteFramebuffers(1, &m_gBuffer);
+		glDeleteFramebuffers(1, &m_litFramebuffer);
+		m_gBuffer = m_litFramebuffer = 0;
+		m_width = m_height = 0;
+	}
+}
@@ -0,0 +1,172 @@
+/**
+	DeferredRenderer.h
+
+	Purpose: DeferredRenderer.h is the header file for the
+			DeferredRenderer class. The DeferredRenderer draws the
+			scene's materials into a g-buffer once and lights it
+			afterwards, so the cost of lights no longer grows with the
+			triangles they fall on.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+
+namespace sns
+{
+	class LightClusters;
+	class ShadowAtlas;
+	class ShadowCascades;
+	class VolumetricFog;
+
+	/**
+		The DeferredRenderer class owns a g-buffer of three small render
+			targets and a depth buffer. Between begin and end the scene
+			is drawn with the g-buffer shaders, which write:
+
+			0	RGBA8	diffuse colour, and how strong the ambient is
+			1	RG16	the world normal, octahedral encoded
+			2	RG8		specular strength, and the log of its power
+
+		light then runs a compute shader over 16 by 16 pixel tiles. Each
+			tile culls every light against its depth range and edges
+			once, and its pixels are lit by the directional light and
+			the lights left into an RGBA16F texture. present copies that
+			and the depth into the framebuffer bound at begin, so the
+			forward passes after it draw over the lit scene as before.
+
+		The scene is drawn at the size of the viewport bound at begin, up
+			to the size the renderer was made at, so a scene drawn into
+			part of a target is lit and copied back at that size.
+
+		Ka and Ks are kept as strengths, so coloured ambients and
+			speculars come out grey. Sponza's are grey already.
+
+		Both need GL 4.3, without it create fails and the scene should
+			stay forward shaded.
+	*/
+	class DeferredRenderer
+	{
+	public:
+		// Must match the defines in the lighting shader.
+		static const unsigned int TILE_SIZE = 16;
+		static const unsigned int MAX_TILE_LIGHTS = 256;
+
+		DeferredRenderer();
+
+		/**
+			The deconstructor deletes the framebuffers and textures.
+		*/
+		~DeferredRenderer();
+
+		DeferredRenderer(const DeferredRenderer&) = delete;
+		DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+		/**
+			create makes the g-buffer and lit texture and loads the
+				lighting shader.
+
+				@param1 a_width is the width the scene is drawn at.
+
+				@param2 a_height is the height it is drawn at.
+
+				@return false without GL 4.3 or the shader, the renderer
+						is left uncreated.
+		*/
+		bool create(int a_width, int a_height);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_litTexture != 0; }
+
+		/**
+			begin binds and clears the g-buffer, and draws into as much of
+				it as the viewport bound before covers. The scene is
+				drawn after it with the g-buffer shaders.
+		*/
+		void begin();
+
+		/**
+			end puts back the framebuffer and viewport begin replaced.
+		*/
+		void end();
+
+		/**
+			light lights the g-buffer into the lit texture.
+
+				@param1 a_lights holds the point and spot lights, already
+						uploaded this frame.
+
+				@param2 a_shadows holds the directional light's shadows,
+						already updated this frame.
+
+				@param3 a_atlas holds the point and spot lights' shadows,
+						already updated this frame.
+
+				@param4 a_fog holds the volumetric fog, already updated
+						for the view when it is on.
+
+				@param5 a_view is the camera's view.
+
+				@param6 a_projection is the camera's projection.
+		*/
+		void light(const LightClusters& a_lights, const ShadowCascades& a_shadows, const ShadowAtlas& a_atlas,
+			const VolumetricFog& a_fog, const glm::mat4& a_view, const glm::mat4& a_projection);
+
+		/**
+			present copies the lit scene and its depth into the
+				framebuffer that was bound at begin.
+		*/
+		void present();
+
+		int getWidth() const { return m_width; }
+		int getHeight() const { return m_height; }
+
+		/**
+			getDepthTexture, getNormalTexture and getSpecularTexture
+				return the g-buffer's targets, and getLitTexture what
+				light lit it into, for passes between light and present.
+		*/
+		unsigned int getDepthTexture() const { return m_depthTexture; }
+		unsigned int getNormalTexture() const { return m_normalTexture; }
+		unsigned int getSpecularTexture() const { return m_specularTexture; }
+		unsigned int getLitTexture() const { return m_litTexture; }
+
+		/**
+			getRenderWidth and getRenderHeight return how much of the
+				g-buffer this frame was drawn into.
+		*/
+		int getRenderWidth() const { return m_renderWidth; }
+		int getRenderHeight() const { return m_renderHeight; }
+
+	private:
+		// Deletes the framebuffers and textures.
+		void destroy();
+
+		// Lights the g-buffer a tile at a time.
+		aie::ShaderProgram m_lightingShader;
+
+		unsigned int m_gBuffer;
+		unsigned int m_albedoTexture;
+		unsigned int m_normalTexture;
+		unsigned int m_specularTexture;
+		unsigned int m_depthTexture;
+
+		// The lit scene, and the framebuffer present copies it out of.
+		unsigned int m_litFramebuffer;
+		unsigned int m_litTexture;
+
+		int m_width;
+		int m_height;
+
+		// How much of the g-buffer this frame is drawn into.
+		int m_renderWidth;
+		int m_renderHeight;
+
+		// The framebuffer and viewport bound before begin.
+		int m_previousFramebuffer;
+		int m_previousViewport[4];
+	};
+}
@@ -0,0 +1,159 @@
+/**
+	DynamicResolution.cpp
+
+	Purpose: DynamicResolution.cpp is the source file for the
+			DynamicResolution class. The DynamicResolution class times
+			the scene on the gpu and picks how large a part of the scene
+			target to draw it at, to keep it inside the frame's budget.
+
+	@author Nathan Nette
+*/
+#include "DynamicResolution.h"
+#include "soxCore.h"
+#include "gl_core_4_5.h"
+#include <cmath>
+
+namespace sns
+{
+	// How much of the budget a lowered scale aims for, leaving room for
+	//	the time to wander without going straight back over.
+	static const double HEADROOM = 0.9;
+
+	// How far under the budget the time must be before the scale climbs.
+	static const double RAISE_BELOW = 0.8;
+
+	// How many times at a scale are smoothed before deciding on it.
+	static const unsigned int SETTLE_SAMPLES = 4;
+
+	// How much of each new time goes into the smoothed one.
+	static const double SMOOTHING = 0.25;
+
+	DynamicResolution::DynamicResolution()
+		: m_queries(),
+		m_frame(0),
+		m_budget(1000.0 / 60.0),
+		m_enabled(true),
+		m_steps(STEPS),
+		m_gpuMilliseconds(0.0),
+		m_decision(Decision::HOLD),
+		m_changes(0),
+		m_framesSinceChange(0),
+		m_samples(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the queries.
+	*/
+	DynamicResolution::~DynamicResolution()
+	{
+		if (m_queries[0] != 0)
+			glDeleteQueries(LATENCY * 2, m_queries);
+	}
+
+	/**
+		setBudget sets how long the scene should take on the gpu.
+
+			@param1 a_milliseconds is the budget, in milliseconds.
+	*/
+	void DynamicResolution::setBudget(double a_milliseconds)
+	{
+		m_budget = a_milliseconds > 0.0 ? a_milliseconds : 1000.0 / 60.0;
+	}
+
+	/**
+		setEnabled sets whether the scale follows the gpu time. When off
+			it goes straight back to 1.
+
+			@param1 a_enabled is whether the scale follows the time.
+	*/
+	void DynamicResolution::setEnabled(bool a_enabled)
+	{
+		m_enabled = a_enabled;
+		if (m_enabled == false && m_steps != STEPS)
+		{
+			m_steps = STEPS;
+			m_framesSinceChange = m_samples = 0;
+			++m_changes;
+		}
+	}
+
+	/**
+		begin reads this frame's queries from LATENCY frames ago, decides
+			the scale from them, then stamps the start of the scene.
+	*/
+	void DynamicResolution::begin()
+	{
+		if (m_queries[0] == 0)
+			glGenQueries(LATENCY * 2, m_queries);
+
+		m_decision = Decision::HOLD;
+		unsigned int* queries = &m_queries[(m_frame % LATENCY) * 2];
+		if (m_frame >= LATENCY)
+		{
+			GLuint64 start = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+
+			// Times from before the last change are of the old scale.
+			if (m_framesSinceChange >= LATENCY)
+				decide((end - start) * NANO_TO_SECONDS * 1000.0);
+		}
+		++m_framesSinceChange;
+
+		glQueryCounter(queries[0], GL_TIMESTAMP);
+	}
+
+	/**
+		end stamps the end of the scene.
+	*/
+	void DynamicResolution::end()
+	{
+		glQueryCounter(m_queries[(m_frame % LATENCY) * 2 + 1], GL_TIMESTAMP);
+		++m_frame;
+	}
+
+	/**
+		decide smooths in a time just read and moves the scale for it.
+
+			@param1 a_milliseconds is the scene's gpu time, in
+					milliseconds.
+	*/
+	void DynamicResolution::decide(double a_milliseconds)
+	{
+		++m_samples;
+		if (m_samples == 1)
+			m_gpuMilliseconds = a_milliseconds;
+		else
+			m_gpuMilliseconds += (a_milliseconds - m_gpuMilliseconds) * SMOOTHING;
+
+		if (m_enabled == false || m_samples < SETTLE_SAMPLES)
+			return;
+
+		unsigned int steps = m_steps;
+		if (m_gpuMilliseconds > m_budget)
+		{
+			// As many steps down as it looks to need, in one go.
+			double wanted = m_steps * std::sqrt(m_budget * HEADROOM / m_gpuMilliseconds);
+			steps = (unsigned int)std::floor(wanted);
+			if (steps < MIN_STEPS)
+				steps = MIN_STEPS;
+		}
+		else if (m_gpuMilliseconds < m_budget * RAISE_BELOW && m_steps < STEPS)
+		{
+			// One step up, if the time it would take still fits.
+			double growth = (double)(m_steps + 1) / m_steps;
+			if (m_gpuMilliseconds * growth * growth < m_budget * HEADROOM)
+				steps = m_steps + 1;
+		}
+
+		if (steps == m_steps)
+			return;
+
+		m_decision = steps < m_steps ? Decision::LOWER : Decision::RAISE;
+		m_steps = steps;
+		m_framesSinceChange = m_samples = 0;
+		++m_changes;
+	}
+}
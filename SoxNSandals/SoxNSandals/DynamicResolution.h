@@ -0,0 +1,146 @@
+/**
+	DynamicResolution.h
+
+	Purpose: DynamicResolution.h is the header file for the
+			DynamicResolution class. The DynamicResolution class times
+			the scene on the gpu and picks how large a part of the scene
+			target to draw it at, to keep it inside the frame's budget.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+namespace sns
+{
+	/**
+		The DynamicResolution class puts a GL_TIMESTAMP query either side
+			of the scene each frame, one pair per frame in flight, and
+			reads a frame's pair back LATENCY frames later so reading
+			never waits.
+
+		The times are smoothed, and when they go over the budget the
+			scale drops by as much as the square root of how far over
+			they are, since the cost of the scene goes with the pixels
+			drawn and those go with the square of the scale. Under the
+			budget by enough it climbs back a little at a time, so it
+			doesn't flip between two scales. After each change it waits
+			for the frames drawn at the new scale to be read back before
+			deciding again.
+
+		Scales are whole steps of 1 / STEPS, from MIN_STEPS of them up to
+			1.
+	*/
+	class DynamicResolution
+	{
+	public:
+		// How many frames old a time is when it is read.
+		static const unsigned int LATENCY = 3;
+
+		// How many steps from 0 to 1 the scale moves in.
+		static const unsigned int STEPS = 32;
+
+		// The smallest scale, as a count of steps.
+		static const unsigned int MIN_STEPS = STEPS / 2;
+
+		/**
+			What the scale did on a frame.
+		*/
+		enum class Decision
+		{
+			HOLD,
+			LOWER,
+			RAISE
+		};
+
+		DynamicResolution();
+
+		/**
+			The deconstructor deletes the queries.
+		*/
+		~DynamicResolution();
+
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+		/**
+			setBudget sets how long the scene should take on the gpu.
+
+				@param1 a_milliseconds is the budget, in milliseconds.
+		*/
+		void setBudget(double a_milliseconds);
+
+		/**
+			getBudget returns how long the scene should take on the gpu,
+				in milliseconds.
+		*/
+		double getBudget() const { return m_budget; }
+
+		/**
+			setEnabled sets whether the scale follows the gpu time. When
+				off it goes straight back to 1.
+
+				@param1 a_enabled is whether the scale follows the time.
+		*/
+		void setEnabled(bool a_enabled);
+
+		/**
+			isEnabled returns whether the scale follows the gpu time.
+		*/
+		bool isEnabled() const { return m_enabled; }
+
+		/**
+			begin reads this frame's queries from LATENCY frames ago,
+				decides the scale from them, then stamps the start of
+				the scene. Call it before getScale and the scene.
+		*/
+		void begin();
+
+		/**
+			end stamps the end of the scene.
+		*/
+		void end();
+
+		/**
+			getScale returns how much of the width and height of the
+				scene target to draw this frame, a half to 1.
+		*/
+		float getScale() const { return (float)m_steps / STEPS; }
+
+		/**
+			getGpuMilliseconds returns the smoothed gpu time of the
+				scene, in milliseconds.
+		*/
+		double getGpuMilliseconds() const { return m_gpuMilliseconds; }
+
+		/**
+			getDecision returns what begin did to the scale this frame.
+		*/
+		Decision getDecision() const { return m_decision; }
+
+		/**
+			getChanges returns how many times the scale has changed.
+		*/
+		unsigned int getChanges() const { return m_changes; }
+
+	private:
+		// Smooths in a time just read and moves the scale for it.
+		void decide(double a_milliseconds);
+
+		// A start and an end query per frame in flight.
+		unsigned int m_queries[LATENCY * 2];
+		unsigned int m_frame;
+
+		double m_budget;
+		bool m_enabled;
+
+		unsigned int m_steps;
+		double m_gpuMilliseconds;
+		Decision m_decision;
+		unsigned int m_changes;
+
+		// Frames begun since the scale last changed, and how many times
+		//	read since then were of frames drawn at the new scale.
+		unsigned int m_framesSinceChange;
+		unsigned int m_samples;
+	};
+}
@@ -0,0 +1,55 @@
+/**
+	EntityRegistry.cpp
+
+	Purpose: EntityRegistry.cpp is the source file for the EntityRegistry
+			class. The EntityRegistry hands out entities and holds every
+			kind of component they can have, each in its own dense array.
+
+	@author Nathan Nette
+*/
+#include "EntityRegistry.h"
+
+namespace sns
+{
+	/**
+		createTransform gives an entity a node in the scene graph,
+			beneath its parent's node.
+
+			@param1 a_entity is the entity.
+
+			@param2 a_local is where it is relative to its parent.
+
+			@param3 a_parent is an entity with a transform, or the entity
+					itself for none.
+
+			@return the entity's transform.
+	*/
+	TransformComponent& EntityRegistry::createTransform(Entity a_entity, const glm::mat4& a_local, Entity a_parent)
+	{
+		const TransformComponent* parent = a_parent != a_entity ? transforms.get(a_parent) : nullptr;
+
+		TransformComponent transform;
+		transform.node = graph.create(a_local, parent != nullptr ? parent->node : SceneGraph::NO_PARENT);
+		return transforms.add(a_entity, transform);
+	}
+
+	/**
+		clear removes every entity and component.
+	*/
+	void EntityRegistry::clear()
+	{
+		transforms.clear();
+		renderables.clear();
+		colours.clear();
+		orbits.clear();
+		bounds.clear();
+		bodies.clear();
+		surfaces.clear();
+		colliders.clear();
+		graph.clear();
+		octree.clear();
+		gravity.clear();
+		broadphase.clear();
+		m_entityCount = 0;
+	}
+}
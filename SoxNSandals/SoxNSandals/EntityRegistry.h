@@ -0,0 +1,168 @@
+/**
+	EntityRegistry.h
+
+	Purpose: EntityRegistry.h is the header file for the EntityRegistry
+			class. The EntityRegistry hands out entities and holds every
+			kind of component they can have, each in its own dense array.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "ComponentArray.h"
+#include "SceneGraph.h"
+#include "LooseOctree.h"
+#include "GravitySimulation.h"
+#include "SweepAndPrune.h"
+#include <glm/glm.hpp>
+
+namespace sns
+{
+	/**
+		Where an entity is, as a node of the registry's scene graph.
+	*/
+	struct TransformComponent
+	{
+		SceneGraph::Node node;
+	};
+
+	/**
+		An entity drawn as an instanced gizmo sphere at its transform.
+	*/
+	struct RenderableComponent
+	{
+		float radius;
+	};
+
+	/**
+		The colour an entity is drawn in.
+	*/
+	struct ColourComponent
+	{
+		glm::vec4 colour;
+	};
+
+	/**
+		An entity's sphere in the registry's octree, given to renderables
+			by the bounds system.
+	*/
+	struct BoundsComponent
+	{
+		LooseOctree::Handle handle;
+	};
+
+	/**
+		An entity circling its transform's parent. The orbit system sets
+			the transform's local matrix from it, speeds are in radians
+			per second.
+	*/
+	struct OrbitComponent
+	{
+		float radius;
+		float speed;
+		float angle;
+	};
+
+	/**
+		An entity moved by the registry's gravity simulation. The body
+			system sets the transform's local matrix to the body's
+			position, so it should have no parent.
+	*/
+	struct BodyComponent
+	{
+		unsigned int body;
+	};
+
+	/**
+		An entity drawn as a planet's ground, the size of its renderable,
+			by a PlanetRenderer rather than as a gizmo sphere.
+	*/
+	struct SurfaceComponent
+	{
+		// How far the ground rises and sinks, as a share of the radius.
+		float height;
+
+		// Picks the planet's hills.
+		float seed;
+	};
+
+	/**
+		An entity that collides, as the box around its renderable's
+			sphere in the registry's broadphase. It is added with
+			SweepAndPrune::NO_HANDLE and the collider system inserts
+			it.
+	*/
+	struct ColliderComponent
+	{
+		SweepAndPrune::Handle handle;
+	};
+
+	/**
+		The EntityRegistry class holds a scene made of entities. An entity
+			is only a number, everything about it is in the components
+			it has been given. Systems walk one array at a time, looking
+			up any other component an entity has by its number.
+	*/
+	class EntityRegistry
+	{
+	public:
+		EntityRegistry() = default;
+
+		EntityRegistry(const EntityRegistry&) = delete;
+		EntityRegistry& operator=(const EntityRegistry&) = delete;
+
+		/**
+			create returns a new entity without any components.
+		*/
+		Entity create() { return m_entityCount++; }
+
+		/**
+			createTransform gives an entity a node in the scene graph,
+				beneath its parent's node.
+
+				@param1 a_entity is the entity.
+
+				@param2 a_local is where it is relative to its parent.
+
+				@param3 a_parent is an entity with a transform, or the
+						entity itself for none.
+
+				@return the entity's transform.
+		*/
+		TransformComponent& createTransform(Entity a_entity, const glm::mat4& a_local, Entity a_parent);
+
+		/**
+			clear removes every entity and component.
+		*/
+		void clear();
+
+		/**
+			getEntityCount returns how many entities have been created.
+		*/
+		unsigned int getEntityCount() const { return m_entityCount; }
+
+		ComponentArray<TransformComponent> transforms;
+		ComponentArray<RenderableComponent> renderables;
+		ComponentArray<ColourComponent> colours;
+		ComponentArray<OrbitComponent> orbits;
+		ComponentArray<BoundsComponent> bounds;
+		ComponentArray<BodyComponent> bodies;
+		ComponentArray<SurfaceComponent> surfaces;
+		ComponentArray<ColliderComponent> colliders;
+
+		// Every transform's matrices, parents before their children.
+		SceneGraph graph;
+
+		// Where every renderable is, for culling and finding what is
+		//	near. It is only used once it has been created.
+		LooseOctree octree;
+
+		// What moves the entities with bodies.
+		GravitySimulation gravity;
+
+		// Which colliders' boxes overlap, the pairs named by entity.
+		SweepAndPrune broadphase;
+
+	private:
+		Entity m_entityCount = 0;
+	};
+}
@@ -0,0 +1,348 @@
+/**
+	EntitySystems.cpp
+
+	Purpose: EntitySystems.cpp is the source file for the EntitySystems
+			class. The EntitySystems are what moves and draws the
+			entities of a registry, each walking one dense array of
+			components from front to back.
+
+	@author Nathan Nette
+*/
+#include "EntitySystems.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Gizmos.h"
+#include "Frustum.h"
+#include "PlanetRenderer.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace sns
+{
+	/**
+		updateOrbits moves every orbiting entity along its orbit and sets
+			its transform's local matrix to match. Each chunk of orbits
+			is a job, they only write their own orbits and nodes.
+
+			@param1 a_registry is the scene.
+
+			@param2 a_deltaTime is how long to move them for, in seconds.
+	*/
+	void EntitySystems::updateOrbits(EntityRegistry& a_registry, float a_deltaTime)
+	{
+		SNS_PROFILE_SCOPE("Orbit system");
+
+		unsigned int count = a_registry.orbits.size();
+		auto updateChunk = [&a_registry, a_deltaTime](unsigned int a_first, unsigned int a_last)
+		{
+			for (unsigned int i = a_first; i < a_last; ++i)
+			{
+				OrbitComponent& orbit = a_registry.orbits[i];
+				const TransformComponent* transform = a_registry.transforms.get(a_registry.orbits.getEntity(i));
+				if (transform == nullptr)
+					continue;
+
+				// A rotation about y followed by the orbit's distance along x.
+				orbit.angle = std::fmod(orbit.angle + orbit.speed * a_deltaTime, glm::two_pi<float>());
+				float c = std::cos(orbit.angle);
+				float s = std::sin(orbit.angle);
+				glm::mat4 local(
+					c, 0, -s, 0,
+					0, 1, 0, 0,
+					s, 0, c, 0,
+					c * orbit.radius, 0, -s * orbit.radius, 1);
+				a_registry.graph.setLocal(transform->node, local);
+			}
+		};
+
+		// A small scene isn't worth handing to the workers.
+		if (count <= CHUNK_SIZE)
+		{
+			updateChunk(0, count);
+			return;
+		}
+
+		JobSystem& jobs = JobSystem::instance();
+		JobCounter counter;
+		for (unsigned int first = 0; first < count; first += CHUNK_SIZE)
+		{
+			unsigned int last = std::min(first + CHUNK_SIZE, count);
+			jobs.run([&updateChunk, first, last]() { updateChunk(first, last); }, &counter);
+		}
+		jobs.wait(counter);
+	}
+
+	/**
+		updateBodies steps the registry's gravity simulation, which sums
+			on the job system itself, then sets the local matrix of every
+			entity with a body to the body's position. Only those that
+			moved are set, so a paused simulation dirties nothing.
+
+			@param1 a_registry is the scene.
+
+			@param2 a_deltaTime is how long to move them for, in seconds.
+	*/
+	void EntitySystems::updateBodies(EntityRegistry& a_registry, float a_deltaTime)
+	{
+		SNS_PROFILE_SCOPE("Body system");
+
+		if (a_deltaTime <= 0.0f)
+			return;
+
+		GravitySimulation& gravity = a_registry.gravity;
+		gravity.step(a_deltaTime);
+		Profiler::setCounter("Gravity bodies", gravity.getBodyCount());
+		Profiler::setCounter("Gravity interactions", (double)gravity.getStats().interactions);
+
+		for (unsigned int i = 0; i < a_registry.bodies.size(); ++i)
+		{
+			const TransformComponent* transform = a_registry.transforms.get(a_registry.bodies.getEntity(i));
+			if (transform == nullptr)
+				continue;
+
+			glm::mat4 local(1);
+			local[3] = glm::vec4(gravity.getPosition(a_registry.bodies[i].body), 1);
+			a_registry.graph.setLocal(transform->node, local);
+		}
+	}
+
+	/**
+		updateTransforms brings every world matrix up to date, after the
+			systems that move entities have run.
+
+			@param1 a_registry is the scene.
+
+			@return how many transforms were recomputed.
+	*/
+	unsigned int EntitySystems::updateTransforms(EntityRegistry& a_registry)
+	{
+		SNS_PROFILE_SCOPE("Transform system");
+		return a_registry.graph.update();
+	}
+
+	/**
+		updateBounds moves every renderable's sphere in the registry's
+			octree to its world matrix. New renderables are inserted
+			first, as inserting changes the tree, then each chunk of
+			the rest is moved as a job, which only writes their own
+			objects, and the octree relinks what changed cell at the
+			end.
+
+			@param1 a_registry is the scene.
+
+			@return how many spheres changed cell.
+	*/
+	unsigned int EntitySystems::updateBounds(EntityRegistry& a_registry)
+	{
+		SNS_PROFILE_SCOPE("Bounds system");
+
+		LooseOctree& octree = a_registry.octree;
+		if (octree.isCreated() == false)
+			return 0;
+
+		// The sphere a renderable's world matrix scales its radius to.
+		auto getSphere = [&a_registry](unsigned int a_index, const TransformComponent& a_transform)
+		{
+			const glm::mat4& world = a_registry.graph.getWorld(a_transform.node);
+			float scale = std::max(glm::length(glm::vec3(world[0])),
+				std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+			return glm::vec4(glm::vec3(world[3]), a_registry.renderables[a_index].radius * scale);
+		};
+
+		unsigned int count = a_registry.renderables.size();
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			Entity entity = a_registry.renderables.getEntity(i);
+			const TransformComponent* transform = a_registry.transforms.get(entity);
+			if (transform == nullptr || a_registry.bounds.has(entity))
+				continue;
+
+			glm::vec4 sphere = getSphere(i, *transform);
+			a_registry.bounds.add(entity, { octree.insert(glm::vec3(sphere), sphere.w, entity) });
+		}
+
+		auto updateChunk = [&a_registry, &octree, &getSphere](unsigned int a_first, unsigned int a_last)
+		{
+			for (unsigned int i = a_first; i < a_last; ++i)
+			{
+				Entity entity = a_registry.renderables.getEntity(i);
+				const TransformComponent* transform = a_registry.transforms.get(entity);
+				const BoundsComponent* bounds = a_registry.bounds.get(entity);
+				if (transform == nullptr || bounds == nullptr)
+					continue;
+
+				glm::vec4 sphere = getSphere(i, *transform);
+				octree.move(bounds->handle, glm::vec3(sphere), sphere.w);
+			}
+		};
+
+		if (count <= CHUNK_SIZE)
+			updateChunk(0, count);
+		else
+		{
+			JobSystem& jobs = JobSystem::instance();
+			JobCounter counter;
+			for (unsigned int first = 0; first < count; first += CHUNK_SIZE)
+			{
+				unsigned int last = std::min(first + CHUNK_SIZE, count);
+				jobs.run([&updateChunk, first, last]() { updateChunk(first, last); }, &counter);
+			}
+			jobs.wait(counter);
+		}
+
+		return octree.update();
+	}
+
+	/**
+		updateColliders moves every collider's box in the registry's
+			broadphase to its renderable's sphere at its world matrix.
+			New colliders are inserted first, then each chunk of the
+			rest is moved as a job, which only writes their own boxes,
+			and the broadphase sorts and sweeps them at the end.
+
+			@param1 a_registry is the scene.
+
+			@return how many pairs overlap.
+	*/
+	unsigned int EntitySystems::updateColliders(EntityRegistry& a_registry)
+	{
+		SNS_PROFILE_SCOPE("Collider system");
+
+		SweepAndPrune& broadphase = a_registry.broadphase;
+
+		// The box around the sphere a renderable's world matrix scales
+		//	its radius to, or false for colliders without both.
+		auto getBox = [&a_registry](Entity a_entity, glm::vec3& a_min, glm::vec3& a_max)
+		{
+			const TransformComponent* transform = a_registry.transforms.get(a_entity);
+			const RenderableComponent* renderable = a_registry.renderables.get(a_entity);
+			if (transform == nullptr || renderable == nullptr)
+				return false;
+
+			const glm::mat4& world = a_registry.graph.getWorld(transform->node);
+			float scale = std::max(glm::length(glm::vec3(world[0])),
+				std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+			glm::vec3 centre(world[3]);
+			a_min = centre - renderable->radius * scale;
+			a_max = centre + renderable->radius * scale;
+			return true;
+		};
+
+		unsigned int count = a_registry.colliders.size();
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			ColliderComponent& collider = a_registry.colliders[i];
+			glm::vec3 low, high;
+			Entity entity = a_registry.colliders.getEntity(i);
+			if (collider.handle == SweepAndPrune::NO_HANDLE && getBox(entity, low, high))
+				collider.handle = broadphase.insert(low, high, entity);
+		}
+
+		auto updateChunk = [&a_registry, &broadphase, &getBox](unsigned int a_first, unsigned int a_last)
+		{
+			for (unsigned int i = a_first; i < a_last; ++i)
+			{
+				const ColliderComponent& collider = a_registry.colliders[i];
+				glm::vec3 low, high;
+				if (collider.handle != SweepAndPrune::NO_HANDLE && getBox(a_registry.colliders.getEntity(i), low, high))
+					broadphase.move(collider.handle, low, high);
+			}
+		};
+
+		if (count <= CHUNK_SIZE)
+			updateChunk(0, count);
+		else
+		{
+			JobSystem& jobs = JobSystem::instance();
+			JobCounter counter;
+			for (unsigned int first = 0; first < count; first += CHUNK_SIZE)
+			{
+				unsigned int last = std::min(first + CHUNK_SIZE, count);
+				jobs.run([&updateChunk, first, last]() { updateChunk(first, last); }, &counter);
+			}
+			jobs.wait(counter);
+		}
+
+		return broadphase.update();
+	}
+
+	/**
+		drawRenderables adds every renderable entity with a transform to
+			the gizmos, in its colour or white. Given frustums and a
+			created octree, only the entities the octree finds in them
+			are drawn.
+
+			@param1 a_registry is the scene.
+
+			@param2 a_frustums are the frustums to cull against, or
+					nullptr for none.
+
+			@param3 a_frustumCount is how many frustums there are.
+
+			@param4 a_skipSurfaces is whether those with surfaces are left
+					for a PlanetRenderer.
+	*/
+	void EntitySystems::drawRenderables(const EntityRegistry& a_registry, const Frustum* a_frustums,
+		unsigned int a_frustumCount, bool a_skipSurfaces)
+	{
+		SNS_PROFILE_SCOPE("Render system");
+
+		const glm::vec4 white(1);
+		auto draw = [&a_registry, &white, a_skipSurfaces](Entity a_entity)
+		{
+			const TransformComponent* transform = a_registry.transforms.get(a_entity);
+			const RenderableComponent* renderable = a_registry.renderables.get(a_entity);
+			if (transform == nullptr || renderable == nullptr)
+				return;
+			if (a_skipSurfaces && a_registry.surfaces.has(a_entity))
+				return;
+
+			const ColourComponent* colour = a_registry.colours.get(a_entity);
+			aie::Gizmos::addSphereInstanced(glm::vec3(0), renderable->radius,
+				colour != nullptr ? colour->colour : white, &a_registry.graph.getWorld(transform->node));
+		};
+
+		if (a_frustums != nullptr && a_registry.octree.isCreated())
+		{
+			// Kept between frames, so a frame's query doesn't allocate.
+			static thread_local std::vector<uint32_t> t_visible;
+			t_visible.clear();
+			a_registry.octree.queryFrustum(a_frustums, a_frustumCount, t_visible);
+			for (uint32_t entity : t_visible)
+				draw(entity);
+			Profiler::setCounter("Renderables culled", double(a_registry.renderables.size() - t_visible.size()));
+			return;
+		}
+
+		for (unsigned int i = 0; i < a_registry.renderables.size(); ++i)
+			draw(a_registry.renderables.getEntity(i));
+	}
+
+	/**
+		drawSurfaces gives a PlanetRenderer every renderable entity with a
+			surface and a transform for this frame, at its world matrix,
+			in its colour or white.
+
+			@param1 a_registry is the scene.
+
+			@param2 a_renderer is the renderer, cleared first.
+	*/
+	void EntitySystems::drawSurfaces(const EntityRegistry& a_registry, PlanetRenderer& a_renderer)
+	{
+		a_renderer.clear();
+		for (unsigned int i = 0; i < a_registry.surfaces.size(); ++i)
+		{
+			Entity entity = a_registry.surfaces.getEntity(i);
+			const TransformComponent* transform = a_registry.transforms.get(entity);
+			const RenderableComponent* renderable = a_registry.renderables.get(entity);
+			if (transform == nullptr || renderable == nullptr)
+				continue;
+
+			const SurfaceComponent& surface = a_registry.surfaces[i];
+			const ColourComponent* colour = a_registry.colours.get(entity);
+			a_renderer.addPlanet(glm::vec3(a_registry.graph.getWorld(transform->node)[3]), renderable->radius,
+				colour != nullptr ? colour->colour : glm::vec4(1), surface.height, surface.seed);
+		}
+	}
+}
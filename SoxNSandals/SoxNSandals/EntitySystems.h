@@ -0,0 +1,115 @@
+/**
+	EntitySystems.h
+
+	Purpose: EntitySystems.h is the header file for the EntitySystems
+			class. The EntitySystems are what moves and draws the
+			entities of a registry, each walking one dense array of
+			components from front to back.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "EntityRegistry.h"
+
+namespace sns
+{
+	class PlanetRenderer;
+
+	/**
+		The EntitySystems class runs the systems of an EntityRegistry.
+			Systems over many components split the array into chunks
+			and run one job per chunk on the job system.
+	*/
+	class EntitySystems
+	{
+	public:
+		// How many components one job works through.
+		static const unsigned int CHUNK_SIZE = 4096;
+
+		/**
+			updateOrbits moves every orbiting entity along its orbit and
+				sets its transform's local matrix to match.
+
+				@param1 a_registry is the scene.
+
+				@param2 a_deltaTime is how long to move them for, in seconds.
+		*/
+		static void updateOrbits(EntityRegistry& a_registry, float a_deltaTime);
+
+		/**
+			updateBodies steps the registry's gravity simulation and sets
+				the local matrix of every entity with a body to the
+				body's position.
+
+				@param1 a_registry is the scene.
+
+				@param2 a_deltaTime is how long to move them for, in seconds.
+		*/
+		static void updateBodies(EntityRegistry& a_registry, float a_deltaTime);
+
+		/**
+			updateTransforms brings every world matrix up to date, after
+				the systems that move entities have run.
+
+				@param1 a_registry is the scene.
+
+				@return how many transforms were recomputed.
+		*/
+		static unsigned int updateTransforms(EntityRegistry& a_registry);
+
+		/**
+			updateBounds moves every renderable's sphere in the registry's
+				octree to its world matrix, adding the ones that aren't
+				in it yet. It runs after updateTransforms, and does
+				nothing until the octree is created.
+
+				@param1 a_registry is the scene.
+
+				@return how many spheres changed cell.
+		*/
+		static unsigned int updateBounds(EntityRegistry& a_registry);
+
+		/**
+			updateColliders moves every collider's box in the registry's
+				broadphase to its renderable's sphere at its world
+				matrix, inserting the ones that aren't in it yet, then
+				finds the pairs that overlap. It runs after
+				updateTransforms.
+
+				@param1 a_registry is the scene.
+
+				@return how many pairs overlap, see
+						SweepAndPrune::getPairs.
+		*/
+		static unsigned int updateColliders(EntityRegistry& a_registry);
+
+		/**
+			drawRenderables adds every renderable entity with a transform
+				to the gizmos, in its colour or white.
+
+				@param1 a_registry is the scene.
+
+				@param2 a_frustums are frustums to cull against through
+						the octree, drawing what is in any of them, or
+						nullptr to draw everything.
+
+				@param3 a_frustumCount is how many frustums there are.
+
+				@param4 a_skipSurfaces is whether those with surfaces are
+						left for a PlanetRenderer.
+		*/
+		static void drawRenderables(const EntityRegistry& a_registry, const Frustum* a_frustums = nullptr,
+			unsigned int a_frustumCount = 0, bool a_skipSurfaces = false);
+
+		/**
+			drawSurfaces gives a PlanetRenderer every renderable entity with
+				a surface and a transform for this frame, at its world
+				matrix, in its colour or white.
+
+				@param1 a_registry is the scene.
+
+				@param2 a_renderer is the renderer, cleared first.
+		*/
+		static void drawSurfaces(const EntityRegistry& a_registry, PlanetRenderer& a_renderer);
+	};
+}
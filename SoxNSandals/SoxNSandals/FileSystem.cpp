@@ -0,0 +1,269 @@
+/**
+	FileSystem.cpp
+
+	Purpose: FileSystem.cpp is the source file for the FileSystem class.
+			The FileSystem opens asset files out of packed archives that
+			are mapped into memory once, and from the disk for anything
+			that isn't in one.
+
+	@author Nathan Nette
+*/
+#include "FileSystem.h"
+#include "Lz4.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+namespace sns
+{
+	FileView::FileView()
+		: m_data(nullptr),
+		m_size(0),
+		m_file(),
+		m_buffer()
+	{
+	}
+
+	/**
+		close lets go of the file.
+	*/
+	void FileView::close()
+	{
+		m_file.close();
+		std::vector<unsigned char>().swap(m_buffer);
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	/**
+		instance returns the file system.
+	*/
+	FileSystem& FileSystem::instance()
+	{
+		static FileSystem fileSystem;
+		return fileSystem;
+	}
+
+	FileSystem::FileSystem()
+		: m_archives(),
+		m_entries(),
+		m_archiveOpens(0),
+		m_looseOpens(0),
+		m_failures(0),
+		m_decompressedBytes(0)
+	{
+	}
+
+	/**
+		mount maps an archive and adds its files, over any with the same
+			paths mounted before it.
+
+			@param1 a_filename is the path of the archive.
+
+			@return false if it can't be read.
+	*/
+	bool FileSystem::mount(const char* a_filename)
+	{
+		std::unique_ptr<Archive> archive(new Archive());
+		if (archive->file.open(a_filename) == false)
+		{
+			printf("FileSystem: can't open archive %s\n", a_filename);
+			return false;
+		}
+
+		const unsigned char* data = archive->file.getData();
+		size_t size = archive->file.getSize();
+		ArchiveHeader header = {};
+		if (size >= sizeof(ArchiveHeader))
+			header = *(const ArchiveHeader*)data;
+
+		size_t entriesEnd = sizeof(ArchiveHeader) + (size_t)header.entryCount * sizeof(ArchiveEntry);
+		if (header.magic != ARCHIVE_MAGIC || header.version != ARCHIVE_VERSION ||
+			entriesEnd + header.namesSize > size)
+		{
+			printf("FileSystem: %s isn't an archive this version can read\n", a_filename);
+			return false;
+		}
+
+		// Everything is checked before any of it is added, so a damaged
+		//	archive adds nothing.
+		archive->entries = (const ArchiveEntry*)(data + sizeof(ArchiveHeader));
+		archive->entryCount = header.entryCount;
+		const char* names = (const char*)data + entriesEnd;
+		for (unsigned int i = 0; i < archive->entryCount; ++i)
+		{
+			const ArchiveEntry& entry = archive->entries[i];
+			if ((unsigned long long)entry.nameOffset + entry.nameLength > header.namesSize ||
+				entry.offset + entry.storedSize > size || (entry.compressed == 0 && entry.storedSize != entry.size))
+			{
+				printf("FileSystem: %s is damaged\n", a_filename);
+				return false;
+			}
+		}
+
+		archive->filename = a_filename;
+		for (unsigned int i = 0; i < archive->entryCount; ++i)
+		{
+			const ArchiveEntry& entry = archive->entries[i];
+			std::string key = canonicalise(std::string(names + entry.nameOffset, entry.nameLength));
+			m_entries[key] = { archive.get(), &entry };
+		}
+		printf("FileSystem: mounted %s, %u files\n", a_filename, archive->entryCount);
+		m_archives.push_back(std::move(archive));
+		return true;
+	}
+
+	/**
+		unmountAll drops every archive.
+	*/
+	void FileSystem::unmountAll()
+	{
+		m_entries.clear();
+		m_archives.clear();
+	}
+
+	/**
+		open opens a file from the archives, or from the disk.
+
+			@param1 a_filename is the path of the file.
+
+			@param2 a_view is set to the file.
+
+			@return false if it isn't anywhere.
+	*/
+	bool FileSystem::open(const char* a_filename, FileView& a_view)
+	{
+		a_view.close();
+
+		auto found = m_entries.empty() ? m_entries.end() : m_entries.find(canonicalise(a_filename));
+		if (found == m_entries.end())
+		{
+			if (a_view.m_file.open(a_filename) == false)
+			{
+				++m_failures;
+				return false;
+			}
+			a_view.m_data = a_view.m_file.getData();
+			a_view.m_size = a_view.m_file.getSize();
+			++m_looseOpens;
+			return true;
+		}
+
+		const ArchiveEntry& entry = *found->second.entry;
+		const unsigned char* stored = found->second.archive->file.getData() + entry.offset;
+		if (entry.compressed != 0)
+		{
+			a_view.m_buffer.resize((size_t)entry.size);
+			if (Lz4::decompress(stored, (size_t)entry.storedSize, a_view.m_buffer.data(), (size_t)entry.size) == false)
+			{
+				printf("FileSystem: %s is damaged in %s\n", a_filename, found->second.archive->filename.c_str());
+				a_view.close();
+				++m_failures;
+				return false;
+			}
+			a_view.m_data = a_view.m_buffer.data();
+			m_decompressedBytes += entry.size;
+		}
+		else
+			a_view.m_data = stored;
+		a_view.m_size = (size_t)entry.size;
+		++m_archiveOpens;
+		return true;
+	}
+
+	/**
+		getFileStamp reads the size and last modified time of a file.
+
+			@param1 a_filename is the path of the file.
+
+			@param2 a_size is where the size is written.
+
+			@param3 a_modifiedTime is where the last write time is written.
+
+			@return true if the file exists.
+	*/
+	bool FileSystem::getFileStamp(const char* a_filename, unsigned long long& a_size, long long& a_modifiedTime) const
+	{
+		auto found = m_entries.empty() ? m_entries.end() : m_entries.find(canonicalise(a_filename));
+		if (found == m_entries.end())
+			return MappedFile::getFileStamp(a_filename, a_size, a_modifiedTime);
+
+		a_size = found->second.entry->size;
+		a_modifiedTime = found->second.entry->modifiedTime;
+		return true;
+	}
+
+	/**
+		exists returns whether a file is in an archive or on disk.
+
+			@param1 a_filename is the path of the file.
+	*/
+	bool FileSystem::exists(const char* a_filename) const
+	{
+		unsigned long long size = 0;
+		long long modifiedTime = 0;
+		return getFileStamp(a_filename, size, modifiedTime);
+	}
+
+	/**
+		canonicalise makes the key a path is found by.
+
+			@param1 a_filename is the path.
+	*/
+	std::string FileSystem::canonicalise(const std::string& a_filename)
+	{
+		std::string path = a_filename;
+		std::replace(path.begin(), path.end(), '\\', '/');
+
+#ifdef _WIN32
+		std::transform(path.begin(), path.end(), path.begin(),
+			[](char c) { return (char)tolower((unsigned char)c); });
+#endif
+
+		// Split into parts and resolve "." and "..".
+		bool absolute = path.empty() == false && path[0] == '/';
+		std::vector<std::string> parts;
+		size_t start = 0;
+		while (start <= path.size())
+		{
+			size_t end = path.find('/', start);
+			if (end == std::string::npos)
+				end = path.size();
+			std::string part = path.substr(start, end - start);
+
+			if (part == "..")
+			{
+				if (parts.empty() == false && parts.back() != "..")
+					parts.pop_back();
+				else if (absolute == false)
+					parts.push_back(part);
+			}
+			else if (part.empty() == false && part != ".")
+				parts.push_back(part);
+
+			start = end + 1;
+		}
+
+		std::string result = absolute ? "/" : "";
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			if (i > 0)
+				result += '/';
+			result += parts[i];
+		}
+		return result;
+	}
+
+	/**
+		getStats returns how files have been opened.
+	*/
+	FileSystem::Stats FileSystem::getStats() const
+	{
+		Stats stats;
+		stats.archiveOpens = m_archiveOpens;
+		stats.looseOpens = m_looseOpens;
+		stats.failures = m_failures;
+		stats.decompressedBytes = m_decompressedBytes;
+		return stats;
+	}
+}
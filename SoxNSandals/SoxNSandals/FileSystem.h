@@ -0,0 +1,248 @@
+/**
+	FileSystem.h
+
+	Purpose: FileSystem.h is the header file for the FileSystem class.
+			The FileSystem opens asset files out of packed archives that
+			are mapped into memory once, and from the disk for anything
+			that isn't in one.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "MappedFile.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The FileView class is a read-only view of a file opened through
+			the FileSystem. Files stored as they are in an archive point
+			straight into its mapping, compressed ones are decompressed
+			into the view and loose files are mapped by it.
+	*/
+	class FileView
+	{
+	public:
+		FileView();
+
+		// A view can own a mapping, so it can't be copied.
+		FileView(const FileView&) = delete;
+		FileView& operator=(const FileView&) = delete;
+
+		/**
+			close lets go of the file.
+		*/
+		void close();
+
+		/**
+			getData returns the file's bytes, or nullptr if nothing is open.
+				They stay valid until the view is closed, or the archive
+				they are in is unmounted.
+		*/
+		const unsigned char* getData() const { return m_data; }
+
+		/**
+			getSize returns the size of the file in bytes.
+		*/
+		size_t getSize() const { return m_size; }
+
+		/**
+			isOpen returns whether a file is open.
+		*/
+		bool isOpen() const { return m_data != nullptr; }
+
+	private:
+		friend class FileSystem;
+
+		const unsigned char* m_data;
+		size_t m_size;
+
+		// Only one of these is used, for a loose file or a compressed one.
+		MappedFile m_file;
+		std::vector<unsigned char> m_buffer;
+	};
+
+	/**
+		The FileSystem class finds files by path in the archives that are
+			mounted, the last mounted first, then on the disk, so
+			anything that wasn't packed still loads. Paths are matched
+			once canonicalised, so "../models/a/../b.obj" finds
+			"../models/b.obj".
+
+		Archives are written by the AssetPacker. Each file in one is
+			stored with the size and time it had on the disk, which
+			getFileStamp returns so caches checked against their source
+			still match inside an archive.
+
+		Archives must be mounted before anything is loaded, after that
+			any thread can open files at once.
+	*/
+	class FileSystem
+	{
+	public:
+		// "SNSA", and the version of the layout below.
+		static const unsigned int ARCHIVE_MAGIC = 0x41534e53;
+		static const unsigned int ARCHIVE_VERSION = 1;
+
+		// Where each file starts in an archive is aligned to this, so
+		//	data read straight from the mapping is aligned as it was
+		//	in its own file.
+		static const unsigned int ARCHIVE_ALIGNMENT = 64;
+
+		/**
+			An archive starts with the header, then the entries, then
+				their names one after another, then the files.
+		*/
+		struct ArchiveHeader
+		{
+			unsigned int magic;
+			unsigned int version;
+			unsigned int entryCount;
+			unsigned int namesSize;
+		};
+
+		/**
+			Where a file is in an archive.
+		*/
+		struct ArchiveEntry
+		{
+			// From the start of the archive, and how many bytes it takes
+			//	there.
+			unsigned long long offset;
+			unsigned long long storedSize;
+
+			// Its size once decompressed, the same as storedSize if it
+			//	isn't.
+			unsigned long long size;
+			long long modifiedTime;
+
+			// Its canonical path, from the start of the names.
+			unsigned int nameOffset;
+			unsigned int nameLength;
+
+			// Set when it is an LZ4 block.
+			unsigned int compressed;
+			unsigned int padding;
+		};
+
+		/**
+			How files have been opened.
+		*/
+		struct Stats
+		{
+			unsigned int archiveOpens;
+			unsigned int looseOpens;
+			unsigned int failures;
+			unsigned long long decompressedBytes;
+		};
+
+		static FileSystem& instance();
+
+		FileSystem(const FileSystem&) = delete;
+		FileSystem& operator=(const FileSystem&) = delete;
+
+		/**
+			mount maps an archive and adds its files, over any with the
+				same paths mounted before it.
+
+				@param1 a_filename is the path of the archive.
+
+				@return false if it can't be read.
+		*/
+		bool mount(const char* a_filename);
+
+		/**
+			unmountAll drops every archive. Views into them are left
+				pointing at nothing, close them first.
+		*/
+		void unmountAll();
+
+		/**
+			open opens a file from the archives, or from the disk.
+
+				@param1 a_filename is the path of the file.
+
+				@param2 a_view is set to the file.
+
+				@return false if it isn't anywhere.
+		*/
+		bool open(const char* a_filename, FileView& a_view);
+
+		/**
+			getFileStamp reads the size and last modified time of a file,
+				as MappedFile::getFileStamp does. For a file in an archive
+				they are what it had when it was packed.
+
+				@param1 a_filename is the path of the file.
+
+				@param2 a_size is where the size is written.
+
+				@param3 a_modifiedTime is where the last write time is
+						written.
+
+				@return true if the file exists.
+		*/
+		bool getFileStamp(const char* a_filename, unsigned long long& a_size, long long& a_modifiedTime) const;
+
+		/**
+			exists returns whether a file is in an archive or on disk.
+
+				@param1 a_filename is the path of the file.
+		*/
+		bool exists(const char* a_filename) const;
+
+		/**
+			canonicalise makes the key a path is found by. Slashes are
+				made forward, "." and ".." are resolved and on windows it
+				is lowercased, as paths there aren't case sensitive.
+
+				@param1 a_filename is the path.
+		*/
+		static std::string canonicalise(const std::string& a_filename);
+
+		/**
+			getArchiveCount returns how many archives are mounted.
+		*/
+		unsigned int getArchiveCount() const { return (unsigned int)m_archives.size(); }
+
+		/**
+			getStats returns how files have been opened.
+		*/
+		Stats getStats() const;
+
+	private:
+		FileSystem();
+
+		/**
+			A mounted archive.
+		*/
+		struct Archive
+		{
+			std::string filename;
+			MappedFile file;
+			const ArchiveEntry* entries;
+			unsigned int entryCount;
+		};
+
+		/**
+			Where a path was found.
+		*/
+		struct Location
+		{
+			const Archive* archive;
+			const ArchiveEntry* entry;
+		};
+
+		std::vector<std::unique_ptr<Archive>> m_archives;
+		std::unordered_map<std::string, Location> m_entries;
+
+		std::atomic<unsigned int> m_archiveOpens;
+		std::atomic<unsigned int> m_looseOpens;
+		std::atomic<unsigned int> m_failures;
+		std::atomic<unsigned long long> m_decompressedBytes;
+	};
+}
@@ -0,0 +1,372 @@
+/**
+	FluidSimulation.cpp
+
+	Purpose: FluidSimulation.cpp is the source file for the FluidSimulation
+			class. The FluidSimulation runs a body of water as smoothed
+			particle hydrodynamics in compute shaders, for fountains and
+			pools, and draws it as particles.
+
+	@author Nathan Nette
+*/
+#include "FluidSimulation.h"
+#include "GpuMemory.h"
+#include "ParticleEmitter.h"
+#include "Random.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	// Must match local_size_x in the grid and solve shaders.
+	const unsigned int GROUP_SIZE = 256;
+
+	// How many values each group of the scan shader sums, 4 a thread.
+	const unsigned int SCAN_BLOCK = 1024;
+
+	// The buffer bindings the shaders read and write.
+	const unsigned int PARTICLE_BINDING = 0;
+	const unsigned int SORTED_BINDING = 1;
+	const unsigned int CELL_RANK_BINDING = 2;
+	const unsigned int DENSITY_BINDING = 3;
+	const unsigned int CELL_COUNT_BINDING = 4;
+	const unsigned int CELL_START_BINDING = 5;
+	const unsigned int BLOCK_SUM_BINDING = 6;
+	const unsigned int INSTANCE_BINDING = 7;
+
+	const float PI = 3.14159265f;
+
+	/**
+		A particle as the shaders read it, w unused.
+	*/
+	struct FluidParticle
+	{
+		glm::vec4 position;
+		glm::vec4 velocity;
+	};
+
+	/**
+		createStorage makes a buffer only the shaders write, and tracks it.
+
+			@param1 a_buffer receives the buffer.
+
+			@param2 a_bytes is how big it is.
+
+			@param3 a_data is what it starts as, or nullptr.
+	*/
+	void createStorage(sns::BufferHandle& a_buffer, unsigned long long a_bytes, const void* a_data)
+	{
+		glCreateBuffers(1, a_buffer.put());
+		glNamedBufferStorage(a_buffer, a_bytes, a_data, GL_DYNAMIC_STORAGE_BIT);
+		sns::GpuMemory::instance().trackBuffer(a_buffer, a_bytes, sns::GpuMemory::PARTICLES, "FluidSimulation");
+	}
+
+	/**
+		loadCompute loads and links a compute shader.
+
+			@param1 a_shader is the program.
+
+			@param2 a_path is the shader's file.
+
+			@return false if it didn't link.
+	*/
+	bool loadCompute(aie::ShaderProgram& a_shader, const char* a_path)
+	{
+		if (a_shader.getHandle() != 0)
+			return true;
+
+		a_shader.loadShader(aie::eShaderStage::COMPUTE, a_path);
+		if (a_shader.link() == false)
+		{
+			printf("Shader Error: %s\n", a_shader.getLastError());
+			return false;
+		}
+		return true;
+	}
+}
+
+namespace sns
+{
+	/**
+		The constructor makes water in metres, a smoothing radius of 10cm
+			in a 2m box, stepped 240 times a second.
+	*/
+	FluidSimulation::Settings::Settings()
+		: smoothingRadius(0.1f),
+		restDensity(1000.0f),
+		stiffness(200.0f),
+		viscosity(0.2f),
+		gravity(0, -9.81f, 0),
+		boundsMin(-1, 0, -1),
+		boundsMax(1, 2, 1),
+		bounce(0.2f),
+		timeStep(1.0f / 240.0f),
+		size(0.06f),
+		stillColour(0.1f, 0.3f, 0.8f, 0.8f),
+		fastColour(0.8f, 0.9f, 1.0f, 0.8f),
+		fastSpeed(3.0f)
+	{
+	}
+
+	FluidSimulation::FluidSimulation()
+		: m_particleCount(0),
+		m_cellCount(0),
+		m_particleMass(0),
+		m_cellSize(0),
+		m_accumulator(0)
+	{
+	}
+
+	/**
+		create loads the shaders and makes the buffers, with the particles
+			stacked in a block half a smoothing radius apart, nudged
+			a little so they don't fall in perfect columns. There are
+			twice as many cells as particles, rounded up to a whole
+			power of two of the scan's blocks, so few particles share
+			a cell with a far away one.
+
+			@param1 a_particleCount is how many particles there are, at
+					most half of SCAN_BLOCK squared.
+
+			@param2 a_settings is what the fluid is like.
+
+			@param3 a_blockMin is the lowest corner of the block.
+
+			@return false without GL 4.5 or the shaders.
+	*/
+	bool FluidSimulation::create(unsigned int a_particleCount, const Settings& a_settings, const glm::vec3& a_blockMin)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("FluidSimulation: simulating fluid needs GL 4.5.\n");
+			return false;
+		}
+		if (a_particleCount == 0 || a_particleCount > SCAN_BLOCK * SCAN_BLOCK / 2 ||
+			loadCompute(m_gridShader, "../shaders/fluidGrid.comp") == false ||
+			loadCompute(m_scanShader, "../shaders/fluidScan.comp") == false ||
+			loadCompute(m_solveShader, "../shaders/fluidSolve.comp") == false)
+			return false;
+
+		m_settings = a_settings;
+		m_particleCount = a_particleCount;
+		m_cellSize = a_settings.smoothingRadius;
+		m_cellCount = SCAN_BLOCK;
+		while (m_cellCount < a_particleCount * 2)
+			m_cellCount *= 2;
+		m_accumulator = 0;
+
+		// Half a radius apart, each particle's share of a cube of fluid
+		//	at the rest density.
+		float spacing = a_settings.smoothingRadius * 0.5f;
+		m_particleMass = a_settings.restDensity * spacing * spacing * spacing;
+
+		glm::vec3 room = glm::max(a_settings.boundsMax - a_blockMin, glm::vec3(spacing));
+		unsigned int columns = glm::max((unsigned int)(room.x / spacing), 1u);
+		unsigned int rows = glm::max((unsigned int)(room.z / spacing), 1u);
+
+		Random random(a_particleCount);
+		std::vector<FluidParticle> particles(a_particleCount);
+		for (unsigned int i = 0; i < a_particleCount; ++i)
+		{
+			glm::vec3 cell((float)(i % columns), (float)(i / (columns * rows)), (float)(i / columns % rows));
+			glm::vec3 jitter(random.range(-0.05f, 0.05f), 0, random.range(-0.05f, 0.05f));
+			particles[i].position = glm::vec4(a_blockMin + (cell + 0.5f + jitter) * spacing, 0);
+			particles[i].velocity = glm::vec4(0);
+		}
+
+		unsigned long long particleBytes = (unsigned long long)a_particleCount * sizeof(FluidParticle);
+		createStorage(m_particles, particleBytes, particles.data());
+		createStorage(m_sorted, particleBytes, nullptr);
+		createStorage(m_cellRanks, (unsigned long long)a_particleCount * sizeof(glm::uvec2), nullptr);
+		createStorage(m_densities, (unsigned long long)a_particleCount * sizeof(glm::vec2), nullptr);
+		createStorage(m_cellCounts, (unsigned long long)m_cellCount * sizeof(unsigned int), nullptr);
+		createStorage(m_cellStarts, (unsigned long long)m_cellCount * sizeof(unsigned int), nullptr);
+		createStorage(m_blockSums, (unsigned long long)(m_cellCount / SCAN_BLOCK) * sizeof(unsigned int), nullptr);
+		createStorage(m_instances, (unsigned long long)a_particleCount * sizeof(ParticleEmitter::ParticleInstance),
+			nullptr);
+
+		m_vao.reset(ParticleEmitter::createVertexArray(m_instances));
+
+		// The instances are written by the last step, so there is one
+		//	before the first update.
+		step();
+		return true;
+	}
+
+	/**
+		destroy deletes the buffers.
+	*/
+	void FluidSimulation::destroy()
+	{
+		m_vao.reset();
+		m_instances.reset();
+		m_blockSums.reset();
+		m_cellStarts.reset();
+		m_cellCounts.reset();
+		m_densities.reset();
+		m_cellRanks.reset();
+		m_sorted.reset();
+		m_particles.reset();
+		m_particleCount = 0;
+	}
+
+	/**
+		update steps the fluid on by however many whole steps fit in the
+			time. Past MAX_STEPS the rest is dropped, the fluid runs
+			slower rather than the frames.
+
+			@param1 a_deltaTime is the time since the last update.
+	*/
+	void FluidSimulation::update(float a_deltaTime)
+	{
+		if (isCreated() == false || m_settings.timeStep <= 0.0f)
+			return;
+
+		m_accumulator += a_deltaTime;
+		unsigned int steps = 0;
+		while (m_accumulator >= m_settings.timeStep && steps < MAX_STEPS)
+		{
+			step();
+			m_accumulator -= m_settings.timeStep;
+			++steps;
+		}
+		if (steps == MAX_STEPS)
+			m_accumulator = glm::min(m_accumulator, m_settings.timeStep);
+	}
+
+	/**
+		step hashes the particles into the cells, sums the counts into
+			where each cell starts, copies the particles there, then
+			works out every particle's density before moving any of
+			them by it. Each dispatch waits for the writes of the one
+			before.
+	*/
+	void FluidSimulation::step()
+	{
+		static constexpr aie::UniformHandle PASS("Pass");
+		static constexpr aie::UniformHandle PARTICLE_COUNT("ParticleCount");
+		static constexpr aie::UniformHandle CELL_COUNT("CellCount");
+		static constexpr aie::UniformHandle CELL_SIZE("CellSize");
+		static constexpr aie::UniformHandle SCAN_COUNT("ScanCount");
+		static constexpr aie::UniformHandle SMOOTHING_RADIUS("SmoothingRadius");
+		static constexpr aie::UniformHandle KERNELS("Kernels");
+		static constexpr aie::UniformHandle MASS("Mass");
+		static constexpr aie::UniformHandle REST_DENSITY("RestDensity");
+		static constexpr aie::UniformHandle STIFFNESS("Stiffness");
+		static constexpr aie::UniformHandle VISCOSITY("Viscosity");
+		static constexpr aie::UniformHandle GRAVITY("Gravity");
+		static constexpr aie::UniformHandle BOUNDS_MIN("BoundsMin");
+		static constexpr aie::UniformHandle BOUNDS_MAX("BoundsMax");
+		static constexpr aie::UniformHandle BOUNCE("Bounce");
+		static constexpr aie::UniformHandle DELTA_TIME("DeltaTime");
+		static constexpr aie::UniformHandle SIZE("Size");
+		static constexpr aie::UniformHandle STILL_COLOUR("StillColour");
+		static constexpr aie::UniformHandle FAST_COLOUR("FastColour");
+		static constexpr aie::UniformHandle FAST_SPEED("FastSpeed");
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_BINDING, m_particles);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORTED_BINDING, m_sorted);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CELL_RANK_BINDING, m_cellRanks);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DENSITY_BINDING, m_densities);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CELL_COUNT_BINDING, m_cellCounts);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CELL_START_BINDING, m_cellStarts);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BLOCK_SUM_BINDING, m_blockSums);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, m_instances);
+
+		unsigned int particleGroups = (m_particleCount + GROUP_SIZE - 1) / GROUP_SIZE;
+		unsigned int blockCount = m_cellCount / SCAN_BLOCK;
+
+		// Count the particles into their cells, each keeping its place.
+		glClearNamedBufferData(m_cellCounts, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		m_gridShader.bind();
+		m_gridShader.bindUniform(PASS, 0);
+		m_gridShader.bindUniform(PARTICLE_COUNT, (int)m_particleCount);
+		m_gridShader.bindUniform(CELL_COUNT, (int)m_cellCount);
+		m_gridShader.bindUniform(CELL_SIZE, m_cellSize);
+		glDispatchCompute(particleGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		// Sum each block of counts, then the blocks' totals, then add
+		//	each block's start back onto its cells.
+		m_scanShader.bind();
+		m_scanShader.bindUniform(SCAN_COUNT, (int)m_cellCount);
+		for (int pass = 0; pass < 3; ++pass)
+		{
+			m_scanShader.bindUniform(PASS, pass);
+			glDispatchCompute(pass == 1 ? 1 : blockCount, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+
+		// Copy each particle to its cell's start plus its place.
+		m_gridShader.bind();
+		m_gridShader.bindUniform(PASS, 1);
+		glDispatchCompute(particleGroups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		// The poly6 kernel for the density, the spiky kernel's gradient
+		//	for the pressure and the viscosity kernel's laplacian.
+		float h = m_settings.smoothingRadius;
+		float h3 = h * h * h;
+		float h6 = h3 * h3;
+		glm::vec3 kernels(315.0f / (64.0f * PI * h6 * h3), -45.0f / (PI * h6), 45.0f / (PI * h6));
+
+		m_solveShader.bind();
+		m_solveShader.bindUniform(PARTICLE_COUNT, (int)m_particleCount);
+		m_solveShader.bindUniform(CELL_COUNT, (int)m_cellCount);
+		m_solveShader.bindUniform(CELL_SIZE, m_cellSize);
+		m_solveShader.bindUniform(SMOOTHING_RADIUS, h);
+		m_solveShader.bindUniform(KERNELS, kernels);
+		m_solveShader.bindUniform(MASS, m_particleMass);
+		m_solveShader.bindUniform(REST_DENSITY, m_settings.restDensity);
+		m_solveShader.bindUniform(STIFFNESS, m_settings.stiffness);
+		m_solveShader.bindUniform(VISCOSITY, m_settings.viscosity);
+		m_solveShader.bindUniform(GRAVITY, m_settings.gravity);
+		m_solveShader.bindUniform(BOUNDS_MIN, m_settings.boundsMin);
+		m_solveShader.bindUniform(BOUNDS_MAX, m_settings.boundsMax);
+		m_solveShader.bindUniform(BOUNCE, m_settings.bounce);
+		m_solveShader.bindUniform(DELTA_TIME, m_settings.timeStep);
+		m_solveShader.bindUniform(SIZE, m_settings.size);
+		m_solveShader.bindUniform(STILL_COLOUR, m_settings.stillColour);
+		m_solveShader.bindUniform(FAST_COLOUR, m_settings.fastColour);
+		m_solveShader.bindUniform(FAST_SPEED, m_settings.fastSpeed);
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			m_solveShader.bindUniform(PASS, pass);
+			glDispatchCompute(particleGroups, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+	}
+
+	/**
+		draw draws every particle from the instances the last step wrote.
+
+			The particle shader must already be bound.
+	*/
+	void FluidSimulation::draw()
+	{
+		if (isCreated() == false)
+			return;
+
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		ParticleEmitter::bindVertexArray(m_vao, m_instances);
+		RenderState::instance().countDraw();
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_particleCount);
+	}
+
+	/**
+		setSettings changes what the fluid is like. The smoothing radius
+			is kept within the cells it was created with, so the 27
+			cells around a particle still hold every neighbour.
+
+			@param1 a_settings is what the fluid is like.
+	*/
+	void FluidSimulation::setSettings(const Settings& a_settings)
+	{
+		m_settings = a_settings;
+		if (isCreated())
+			m_settings.smoothingRadius = glm::min(m_settings.smoothingRadius, m_cellSize);
+	}
+}
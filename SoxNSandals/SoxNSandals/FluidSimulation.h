@@ -0,0 +1,186 @@
+/**
+	FluidSimulation.h
+
+	Purpose: FluidSimulation.h is the header file for the FluidSimulation
+			class. The FluidSimulation runs a body of water as smoothed
+			particle hydrodynamics in compute shaders, for fountains and
+			pools, and draws it as particles.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+
+namespace sns
+{
+	/**
+		The FluidSimulation class moves every particle by the pressure
+			and viscosity of the ones within a smoothing radius of it,
+			all on the gpu. The particles never leave video memory, and
+			are drawn with the particle shader into the instances the
+			last step wrote, as the GPUParticleEmitter's are.
+
+		Each step finds the neighbours with a spatial hash. The particles
+			are counted into hashed cells a smoothing radius across,
+			the counts are prefix summed into where each cell starts,
+			and the particles are copied there, so a particle only
+			looks through the 27 cells around it, and the particles it
+			reads lie together in memory.
+
+		The particles are kept in a box, and bounce off its sides. The
+			buffers are made with GL 4.5 and the shaders need GL 4.3,
+			without them create fails.
+	*/
+	class FluidSimulation
+	{
+	public:
+		// The most steps update takes, so a slow frame can't make the
+		//	next one slower still.
+		static const unsigned int MAX_STEPS = 4;
+
+		/**
+			What the fluid is like. The particles' mass is worked out
+				so that they start at the rest density, half a
+				smoothing radius apart.
+		*/
+		struct Settings
+		{
+			// How far each particle reaches its neighbours.
+			float smoothingRadius;
+
+			// The density the pressure pushes the fluid back to, and how
+			//	hard.
+			float restDensity;
+			float stiffness;
+
+			// How much the particles drag each other along.
+			float viscosity;
+
+			glm::vec3 gravity;
+
+			// The box the fluid is kept in, and how much of the speed
+			//	into a side is kept coming off it.
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			float bounce;
+
+			// The length of each step. Stiffer fluids need shorter ones.
+			float timeStep;
+
+			// How the particles are drawn, from still to fastSpeed.
+			float size;
+			glm::vec4 stillColour;
+			glm::vec4 fastColour;
+			float fastSpeed;
+
+			/**
+				The constructor makes water in metres.
+			*/
+			Settings();
+		};
+
+		FluidSimulation();
+
+		FluidSimulation(const FluidSimulation&) = delete;
+		FluidSimulation& operator=(const FluidSimulation&) = delete;
+
+		/**
+			create loads the shaders and makes the buffers, with the
+				particles stacked in a block, still.
+
+				@param1 a_particleCount is how many particles there are.
+
+				@param2 a_settings is what the fluid is like.
+
+				@param3 a_blockMin is the lowest corner of the block,
+						which grows along x, then z, then up.
+
+				@return false without GL 4.5 or the shaders, it is left
+						uncreated.
+		*/
+		bool create(unsigned int a_particleCount, const Settings& a_settings, const glm::vec3& a_blockMin);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_particles != 0; }
+
+		/**
+			destroy deletes the buffers.
+		*/
+		void destroy();
+
+		/**
+			update steps the fluid on by however many whole steps fit in
+				the time, carrying the rest over to the next update.
+
+				@param1 a_deltaTime is the time since the last update.
+		*/
+		void update(float a_deltaTime);
+
+		/**
+			draw draws every particle. The particle shader must already
+				be bound, with blending set up as for the emitters.
+		*/
+		void draw();
+
+		/**
+			setSettings changes what the fluid is like, but not the
+				particles' mass. The smoothing radius must not grow past
+				what it was created with, the cells are that size.
+
+				@param1 a_settings is what the fluid is like.
+		*/
+		void setSettings(const Settings& a_settings);
+
+		/**
+			getSettings returns what the fluid is like.
+		*/
+		const Settings& getSettings() const { return m_settings; }
+
+		/**
+			getParticleCount returns how many particles there are.
+		*/
+		unsigned int getParticleCount() const { return m_particleCount; }
+
+	private:
+		/**
+			step runs one step, from hashing the particles to moving them.
+		*/
+		void step();
+
+		aie::ShaderProgram m_gridShader;
+		aie::ShaderProgram m_scanShader;
+		aie::ShaderProgram m_solveShader;
+
+		// The particles, and the same particles in cell order, which the
+		//	solve reads and writes back over the first.
+		BufferHandle m_particles;
+		BufferHandle m_sorted;
+
+		// Each particle's cell and its place in it, then each sorted
+		//	particle's density and pressure.
+		BufferHandle m_cellRanks;
+		BufferHandle m_densities;
+
+		// How many particles each cell holds, where each starts in the
+		//	sorted particles, and each block of the prefix sum's total.
+		BufferHandle m_cellCounts;
+		BufferHandle m_cellStarts;
+		BufferHandle m_blockSums;
+
+		BufferHandle m_instances;
+		VertexArrayHandle m_vao;
+
+		Settings m_settings;
+		unsigned int m_particleCount;
+		unsigned int m_cellCount;
+		float m_particleMass;
+		float m_cellSize;
+
+		// The time left over from the last update.
+		float m_accumulator;
+	};
+}
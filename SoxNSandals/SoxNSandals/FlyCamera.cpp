@@ -19,9 +19,6 @@
 FlyCamera::FlyCamera()
 {
 	// Assigning some default values.
-	m_dMouseX = 0.0f;
-	m_dMouseY = 0.0f;
-
 	deltaMouseX = 0.0f;
 	deltaMouseY = 0.0f;
 
@@ -45,16 +42,20 @@ FlyCamera::~FlyCamera()
 
 		@param1 deltaTime is the current frame rate.
 
-		@param2 a_GLWindow is a pointer to get the address of
-				the application's window.
+		@param2 a_input is the keyboard and mouse, as they were at
+				the start of the frame.
 */
-void FlyCamera::update(double deltaTime, GLFWwindow* a_GLWindow)
+void FlyCamera::update(double deltaTime, const sns::Input& a_input)
 {
-	// Calculate the mouse's delta x and y.
-	glfwGetCursorPos(a_GLWindow, &m_dMouseX, &m_dMouseY);
-
-	// Calculate relative world up.
-	glm::vec4 up = glm::inverse(worldTransform) * glm::vec4(0, 1, 0, 0);
+	// Radians to degrees. The cursor is disabled, so it moves as far
+	//	as the mouse does and never needs putting back in the middle.
+	//	It is read before turning, so the turn is this frame's.
+	deltaMouseX = -a_input.getCursorDelta().x * 0.0174533;
+	deltaMouseY = -a_input.getCursorDelta().y * 0.0174533;
+
+	// Calculate relative world up. The view transform is already the
+	//	inverse of the world transform, so there's nothing to invert.
+	glm::vec4 up = viewTransform * glm::vec4(0, 1, 0, 0);
 	glm::mat4 rotMat(1);
 
 	// If deltaMouseX is 0, when glm rotate is used, rotMat results in NaN which breaks the application.
@@ -69,46 +70,37 @@ void FlyCamera::update(double deltaTime, GLFWwindow* a_GLWindow)
 	rotMat = glm::rotate((float(-deltaMouseY) * fMouseSensitivity)* float(deltaTime), glm::vec3(1, 0, 0));
 	viewTransform = rotMat * viewTransform;
 
-	// Radians to degrees.
-	deltaMouseX = ((1280 / 2 - m_dMouseX) * 0.0174533);
-	deltaMouseY = ((720 / 2 - m_dMouseY) * 0.0174533);
-
-	// Keep mouse locked to screen.
-	glfwSetCursorPos(a_GLWindow, 1280 / 2, 720 / 2);
-
-	// Hide the mouse.
-	glfwSetInputMode(a_GLWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// Update world transform.
-	worldTransform = glm::inverse(viewTransform);
+	// Update world transform, it's only rotation and translation so the
+	//	affine inverse is enough.
+	worldTransform = glm::affineInverse(viewTransform);
 
 	//-----------------Keyboard input-----------------------------
 	// Move fowards, on the camera's z axis.
-	if (glfwGetKey(a_GLWindow, GLFW_KEY_W) == GLFW_PRESS)
+	if (a_input.isKeyDown(GLFW_KEY_W))
 	{
 		worldTransform[3] += worldTransform[2] * deltaTime * -fCurrentSpeed;
 	}
 
 	// Move backwards, on the camera's z axis.
-	if (glfwGetKey(a_GLWindow, GLFW_KEY_S) == GLFW_PRESS)
+	if (a_input.isKeyDown(GLFW_KEY_S))
 	{
 		worldTransform[3] += worldTransform[2] * deltaTime * fCurrentSpeed;
 	}
 
 	// Strafe left.
-	if (glfwGetKey(a_GLWindow, GLFW_KEY_A) == GLFW_PRESS)
+	if (a_input.isKeyDown(GLFW_KEY_A))
 	{
 		worldTransform[3] += worldTransform[0] * deltaTime * -fCurrentSpeed;
 	}
 
 	// Strafe right.
-	if (glfwGetKey(a_GLWindow, GLFW_KEY_D) == GLFW_PRESS)
+	if (a_input.isKeyDown(GLFW_KEY_D))
 	{
 		worldTransform[3] += worldTransform[0] * deltaTime * fCurrentSpeed;
 	}
 
 	// Hold shift to go 3 times as fast(similar to sprint in games).
-	if (glfwGetKey(a_GLWindow, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+	if (a_input.isKeyDown(GLFW_KEY_LEFT_SHIFT))
 	{
 		fCurrentSpeed = fSprintSpeed;
 	}
@@ -118,7 +110,7 @@ void FlyCamera::update(double deltaTime, GLFWwindow* a_GLWindow)
 	}
 
 	// Debug set pos to centre of world.
-	if (glfwGetKey(a_GLWindow, GLFW_KEY_SPACE) == GLFW_PRESS)
+	if (a_input.isKeyDown(GLFW_KEY_SPACE))
 	{
 		setPos(glm::vec3(0, 0, 0));
 	}
@@ -129,6 +121,6 @@ void FlyCamera::update(double deltaTime, GLFWwindow* a_GLWindow)
 	worldTransform[3][3] = 1.0f;
 
 	// Update the view transform then the projection view.
-	viewTransform = glm::inverse(worldTransform);
+	viewTransform = glm::affineInverse(worldTransform);
 	updateProjectionViewTransform();
 }
\ No newline at end of file
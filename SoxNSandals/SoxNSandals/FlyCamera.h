@@ -39,20 +39,13 @@ public:
 
 			@param1 deltaTime is the current frame rate.
 
-			@param2 a_GLWindow is a pointer to get the address of 
-					the application's window.
+			@param2 a_input is the keyboard and mouse, as they were at
+					the start of the frame.
 	*/
-	void update(double deltaTime, GLFWwindow * a_GLWindow);
+	void update(double deltaTime, const sns::Input& a_input);
 
-	// A double to store the mouse's X value.
-	double m_dMouseX;
-
-	// A double to store the mouse's Y value.
-	double m_dMouseY;
-
-	// A double to store the mouse's X value in screen space.
+	// How far the mouse moved this frame, in radians.
 	double deltaMouseX;
-	// A double to store the mouse's Y value in screen space.
 	double deltaMouseY;
 
 	// A float that is the sensitivity of the mouse.
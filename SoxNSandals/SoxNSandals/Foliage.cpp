@@ -0,0 +1,475 @@
+/**
+	Foliage.cpp
+
+	Purpose: Foliage.cpp is the source file for the Foliage class. The
+			Foliage scatters thousands of copies of a plant or tree over
+			the ground, culls them on the gpu and draws the near ones as
+			meshes and the far ones as impostor cards, with indirect
+			instanced draws the cpu never fills in.
+
+	@author Nathan Nette
+*/
+#include "Foliage.h"
+#include "ImpostorBaker.h"
+#include "OBJMesh.h"
+#include "FileSystem.h"
+#include "Frustum.h"
+#include "GpuMemory.h"
+#include "Random.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include "stb_image.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// The buffers the cull shader and the draws read, and the units the
+	//	HiZ pyramid and the impostors are read from.
+	static const unsigned int INSTANCE_BINDING = 0;
+	static const unsigned int VISIBLE_BINDING = 1;
+	static const unsigned int COUNT_BINDING = 2;
+	static const unsigned int HIZ_UNIT = 7;
+
+	Foliage::Foliage()
+		: m_stats()
+	{
+	}
+
+	/**
+		The deconstructor deletes every layer's buffers.
+	*/
+	Foliage::~Foliage()
+	{
+		for (std::unique_ptr<Layer>& layer : m_layers)
+			destroy(*layer);
+	}
+
+	/**
+		create loads the cull and draw shaders.
+
+			@return false without GL 4.5 or the shaders, it is left
+					uncreated.
+	*/
+	bool Foliage::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("Foliage: culling the foliage needs GL 4.5.\n");
+			return false;
+		}
+
+		m_cullShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/foliageCull.comp");
+		m_meshShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/foliage.vert", "#define IMPOSTOR 0\n");
+		m_meshShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/foliage.frag");
+		m_impostorShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/foliage.vert", "#define IMPOSTOR 1\n");
+		m_impostorShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/impostor.frag");
+		aie::ShaderProgram* programs[] = { &m_cullShader, &m_meshShader, &m_impostorShader };
+		if (aie::ShaderProgram::linkAll(programs, 3) == false)
+		{
+			for (aie::ShaderProgram* program : programs)
+			{
+				if (program->getHandle() == 0)
+					printf("Shader Error: %s\n", program->getLastError());
+			}
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		addLayer scatters a layer's copies and uploads them. Its mesh is
+			made but not loaded.
+
+			@param1 a_layer is the scene's layer.
+
+			@param2 a_height is the ground the copies stand on, or empty
+					for the layer's height.
+
+			@return the layer's mesh, for the caller to load with its
+					textures, or null if the density map can't be read
+					or no copies were kept, the layer is left out.
+	*/
+	aie::OBJMesh* Foliage::addLayer(const SceneDescription::Foliage& a_layer, const HeightFunction& a_height)
+	{
+		if (isCreated() == false)
+			return nullptr;
+
+		std::unique_ptr<Layer> layer(new Layer());
+		layer->settings = a_layer;
+		layer->ready = false;
+		if (scatter(*layer, a_height) == false)
+		{
+			printf("Foliage: couldn't read the density map %s.\n", a_layer.densityMap.c_str());
+			return nullptr;
+		}
+		if (layer->instances.empty())
+		{
+			printf("Foliage: no copies of %s were kept.\n", a_layer.filename.c_str());
+			return nullptr;
+		}
+
+		// The lists have room for every copy twice, once as a mesh and
+		//	once as an impostor.
+		unsigned int count = (unsigned int)layer->instances.size();
+		GpuMemory& memory = GpuMemory::instance();
+		glCreateBuffers(1, &layer->instanceBuffer);
+		glNamedBufferStorage(layer->instanceBuffer, count * sizeof(Instance), layer->instances.data(), 0);
+		memory.trackBuffer(layer->instanceBuffer, count * sizeof(Instance), GpuMemory::MESHES, "Foliage");
+		glCreateBuffers(1, &layer->visibleBuffer);
+		glNamedBufferStorage(layer->visibleBuffer, count * 2 * sizeof(unsigned int), nullptr, 0);
+		memory.trackBuffer(layer->visibleBuffer, count * 2 * sizeof(unsigned int), GpuMemory::CULLING, "Foliage");
+		glCreateBuffers(1, &layer->countBuffer);
+		glNamedBufferStorage(layer->countBuffer, 2 * sizeof(unsigned int), nullptr, 0);
+		memory.trackBuffer(layer->countBuffer, 2 * sizeof(unsigned int), GpuMemory::CULLING, "Foliage");
+		layer->commandBuffer = 0;
+		layer->vao = 0;
+
+		layer->mesh.reset(new aie::OBJMesh());
+		m_stats.layers = (unsigned int)m_layers.size() + 1;
+		m_stats.instances += count;
+		m_layers.push_back(std::move(layer));
+		return m_layers.back()->mesh.get();
+	}
+
+	/**
+		prepare gets every layer whose mesh has loaded since it was last
+			called ready to draw, working out its bounds and baking its
+			impostor. It must be called outside of any pass, the baker
+			draws into a framebuffer of its own.
+
+			@param1 a_baker bakes the impostors.
+	*/
+	void Foliage::prepare(ImpostorBaker& a_baker)
+	{
+		for (std::unique_ptr<Layer>& layer : m_layers)
+		{
+			if (layer->ready || layer->mesh->isLoaded() == false)
+				continue;
+
+			// The impostor is baked once, so it waits for the textures.
+			bool texturesReady = true;
+			for (size_t i = 0; i < layer->mesh->getMaterialCount(); ++i)
+			{
+				const aie::OBJMesh::Material& material = layer->mesh->getMaterial(i);
+				if (material.diffuseTexture != nullptr && material.diffuseTexture->getHandle() == 0)
+					texturesReady = false;
+			}
+			if (texturesReady && prepareLayer(*layer, a_baker) == false)
+				printf("Foliage: couldn't bake an impostor of %s.\n", layer->settings.filename.c_str());
+		}
+	}
+
+	/**
+		cull finds the copies of every ready layer to draw this view.
+
+			@param1 a_projectionView is the camera's projection view.
+
+			@param2 a_cameraPosition is where the camera is.
+
+			@param3 a_hiZ holds the depth of the occluders, seen with the
+					same projection view, or null to not test against it.
+	*/
+	void Foliage::cull(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition, const HiZBuffer* a_hiZ)
+	{
+		static constexpr aie::UniformHandle INSTANCE_COUNT("InstanceCount");
+		static constexpr aie::UniformHandle SPHERE("Sphere");
+		static constexpr aie::UniformHandle DISTANCES("Distances");
+		static constexpr aie::UniformHandle FRUSTUM_PLANES("FrustumPlanes");
+		static constexpr aie::UniformHandle CAMERA_POSITION("ViewPosition");
+		static constexpr aie::UniformHandle PROJECTION_VIEW("ProjectionView");
+		static constexpr aie::UniformHandle HIZ("HiZ");
+		static constexpr aie::UniformHandle HIZ_LEVELS("HiZLevels");
+		static constexpr aie::UniformHandle REVERSE_Z("ReverseZ");
+
+		if (isCreated() == false)
+			return;
+
+		Frustum frustum(a_projectionView);
+		glm::vec4 planes[6];
+		for (unsigned int p = 0; p < 6; ++p)
+			planes[p] = frustum.getPlane(p);
+
+		m_cullShader.bind();
+		m_cullShader.bindUniform(FRUSTUM_PLANES, 6, planes);
+		m_cullShader.bindUniform(CAMERA_POSITION, a_cameraPosition);
+		m_cullShader.bindUniform(PROJECTION_VIEW, a_projectionView);
+
+		bool occlusion = a_hiZ != nullptr && a_hiZ->isCreated();
+		m_cullShader.bindUniform(HIZ_LEVELS, occlusion ? a_hiZ->getLevelCount() : 0);
+		m_cullShader.bindUniform(REVERSE_Z, RenderState::instance().isReverseZ() ? 1 : 0);
+		if (occlusion)
+		{
+			a_hiZ->bind(HIZ_UNIT);
+			m_cullShader.bindUniform(HIZ, (int)HIZ_UNIT);
+		}
+
+		bool culled = false;
+		for (std::unique_ptr<Layer>& layer : m_layers)
+		{
+			if (layer->ready == false)
+				continue;
+
+			const SceneDescription::Foliage& settings = layer->settings;
+			unsigned int count = (unsigned int)layer->instances.size();
+			m_cullShader.bindUniform(INSTANCE_COUNT, (int)count);
+			m_cullShader.bindUniform(SPHERE, layer->sphere);
+			m_cullShader.bindUniform(DISTANCES, glm::vec3(settings.fadeStart, settings.fadeEnd, settings.drawDistance));
+
+			glClearNamedBufferData(layer->countBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, layer->instanceBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, layer->visibleBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, layer->countBuffer);
+			glDispatchCompute((count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+			culled = true;
+		}
+		if (culled == false)
+			return;
+
+		// The counts become the commands' instance counts, a copy for
+		//	each chunk's command and one for the impostors'.
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		for (std::unique_ptr<Layer>& layer : m_layers)
+		{
+			if (layer->ready == false)
+				continue;
+
+			unsigned int chunkCount = (unsigned int)layer->mesh->getChunkCount();
+			for (unsigned int i = 0; i < chunkCount; ++i)
+			{
+				glCopyNamedBufferSubData(layer->countBuffer, layer->commandBuffer, 0,
+					i * sizeof(ElementsCommand) + offsetof(ElementsCommand, instanceCount), sizeof(unsigned int));
+			}
+			glCopyNamedBufferSubData(layer->countBuffer, layer->commandBuffer, sizeof(unsigned int),
+				chunkCount * sizeof(ElementsCommand) + offsetof(ArraysCommand, instanceCount), sizeof(unsigned int));
+		}
+
+		// The lists are read by the vertex shaders, the commands as draws.
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	}
+
+	/**
+		draw draws what the last cull kept, the meshes and then the
+			impostors.
+
+			@param1 a_lighting binds the frame's lighting to each program
+					before it draws.
+	*/
+	void Foliage::draw(const LightingFunction& a_lighting)
+	{
+		static constexpr aie::UniformHandle FIRST_VISIBLE("FirstVisible");
+		static constexpr aie::UniformHandle FADE_RANGE("FadeRange");
+		static constexpr aie::UniformHandle DIFFUSE_MAPPED("DiffuseMapped");
+
+		RenderState& state = RenderState::instance();
+		bool lit[2] = { false, false };
+		for (std::unique_ptr<Layer>& layer : m_layers)
+		{
+			if (layer->ready == false)
+				continue;
+
+			const SceneDescription::Foliage& settings = layer->settings;
+			glm::vec2 fadeRange(settings.fadeStart, std::max(settings.fadeEnd, settings.fadeStart + 0.001f));
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, layer->instanceBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, layer->visibleBuffer);
+			state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, layer->commandBuffer);
+
+			// Each chunk with its material, through the layer's vertex
+			//	array with the chunk's buffers attached.
+			m_meshShader.bind();
+			if (lit[0] == false)
+			{
+				a_lighting(m_meshShader);
+				lit[0] = true;
+			}
+			m_meshShader.bindUniform(FIRST_VISIBLE, 0);
+			m_meshShader.bindUniform(FADE_RANGE, fadeRange);
+			const aie::OBJMesh& mesh = *layer->mesh;
+			unsigned int vertexSize = aie::OBJMesh::getVertexSize(mesh.getVertexFormat());
+			state.bindVertexArray(layer->vao);
+			for (unsigned int i = 0; i < (unsigned int)mesh.getChunkCount(); ++i)
+			{
+				const aie::OBJMesh::MeshChunk& chunk = mesh.getChunk(i);
+				glVertexArrayVertexBuffer(layer->vao, 0, chunk.vbo, 0, vertexSize);
+				glVertexArrayElementBuffer(layer->vao, chunk.ibo);
+				bool mapped = false;
+				if (chunk.materialID >= 0)
+				{
+					const aie::OBJMesh::Material& material = mesh.getMaterial(chunk.materialID);
+					aie::OBJMesh::bindMaterial(material);
+					mapped = material.diffuseTexture != nullptr;
+				}
+				m_meshShader.bindUniform(DIFFUSE_MAPPED, mapped ? 1 : 0);
+				state.countDraw();
+				glDrawElementsIndirect(GL_TRIANGLES, chunk.indexType, (void*)(i * sizeof(ElementsCommand)));
+			}
+
+			// The impostors, six vertices each made into a card.
+			m_impostorShader.bind();
+			if (lit[1] == false)
+			{
+				a_lighting(m_impostorShader);
+				lit[1] = true;
+			}
+			m_impostorShader.bindUniform(FIRST_VISIBLE, (int)layer->instances.size());
+			m_impostorShader.bindUniform(FADE_RANGE, fadeRange);
+			layer->impostor.bind(m_impostorShader);
+			state.countDraw();
+			glDrawArraysIndirect(GL_TRIANGLES, (void*)(mesh.getChunkCount() * sizeof(ElementsCommand)));
+		}
+		state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	/**
+		scatter places a layer's copies, trying its count of positions
+			across the square and keeping each with the density map's
+			brightness there. The map's top row is the square's -Z edge.
+
+			@param1 a_layer is the layer, its settings filled in.
+
+			@param2 a_height is the ground, or empty.
+
+			@return false if the density map can't be read.
+	*/
+	bool Foliage::scatter(Layer& a_layer, const HeightFunction& a_height)
+	{
+		const SceneDescription::Foliage& settings = a_layer.settings;
+		int width = 0, height = 0, channels = 0;
+		unsigned char* density = nullptr;
+		if (settings.densityMap.empty() == false)
+		{
+			FileView file;
+			if (FileSystem::instance().open(settings.densityMap.c_str(), file) == false)
+				return false;
+			density = stbi_load_from_memory(file.getData(), (int)file.getSize(), &width, &height, &channels, STBI_grey);
+			if (density == nullptr)
+				return false;
+		}
+
+		// The same seed places the same copies every run.
+		Random random(settings.seed);
+		a_layer.instances.reserve(settings.count);
+		for (uint32_t i = 0; i < settings.count; ++i)
+		{
+			float u = random.nextFloat();
+			float v = random.nextFloat();
+			float keep = random.nextFloat();
+			glm::vec2 offset = (glm::vec2(u, v) - 0.5f) * settings.size;
+			if (glm::length(offset) < settings.innerRadius)
+				continue;
+			if (density != nullptr)
+			{
+				int x = std::min((int)(u * width), width - 1);
+				int y = std::min((int)(v * height), height - 1);
+				if (keep * 255.0f >= (float)density[y * width + x])
+					continue;
+			}
+
+			float x = settings.position.x + offset.x;
+			float z = settings.position.z + offset.y;
+			float y = a_height ? a_height(x, z) : settings.position.y;
+			float angle = random.range(0.0f, glm::two_pi<float>());
+			Instance instance;
+			instance.positionScale = glm::vec4(x, y, z, random.range(settings.scale.x, settings.scale.y));
+			instance.rotation = glm::vec4(cosf(angle), sinf(angle), 0, 0);
+			a_layer.instances.push_back(instance);
+		}
+
+		if (density != nullptr)
+			stbi_image_free(density);
+		return true;
+	}
+
+	/**
+		prepareLayer works out a loaded layer's bounds, writes its
+			commands and bakes its impostor.
+
+			@param1 a_layer is the layer.
+
+			@param2 a_baker bakes the impostor.
+
+			@return false if the impostor can't be baked, the layer is
+					left unready.
+	*/
+	bool Foliage::prepareLayer(Layer& a_layer, ImpostorBaker& a_baker)
+	{
+		// Copies stand on the ground, so they are never seen from below.
+		const aie::OBJMesh& mesh = *a_layer.mesh;
+		if (a_baker.bake(mesh, true, a_layer.impostor) == false)
+			return false;
+
+		const BoxList& bounds = mesh.getChunkBounds();
+		glm::vec3 lowest(0), highest(0);
+		for (size_t i = 0; i < bounds.centreX.size(); ++i)
+		{
+			glm::vec3 centre(bounds.centreX[i], bounds.centreY[i], bounds.centreZ[i]);
+			glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+			lowest = i == 0 ? centre - extent : glm::min(lowest, centre - extent);
+			highest = i == 0 ? centre + extent : glm::max(highest, centre + extent);
+		}
+
+		// Centred on the axis the copies turn about, so it holds however
+		//	a copy is turned.
+		glm::vec2 across = glm::max(glm::abs(glm::vec2(lowest.x, lowest.z)), glm::abs(glm::vec2(highest.x, highest.z)));
+		float halfWidth = glm::length(across);
+		float halfHeight = (highest.y - lowest.y) * 0.5f;
+		float middle = (highest.y + lowest.y) * 0.5f;
+		a_layer.sphere = glm::vec4(0, middle, 0, sqrtf(halfWidth * halfWidth + halfHeight * halfHeight));
+
+		// The instance counts are filled in by every cull.
+		std::vector<unsigned char> commands(mesh.getChunkCount() * sizeof(ElementsCommand) + sizeof(ArraysCommand));
+		ElementsCommand* elements = (ElementsCommand*)commands.data();
+		for (unsigned int i = 0; i < (unsigned int)mesh.getChunkCount(); ++i)
+		{
+			const aie::OBJMesh::MeshChunk& chunk = mesh.getChunk(i);
+			elements[i] = { chunk.indexCount, 0, chunk.lodFirstIndex[0], 0, 0 };
+		}
+		ArraysCommand impostor = { 6, 0, 0, 0 };
+		memcpy(commands.data() + mesh.getChunkCount() * sizeof(ElementsCommand), &impostor, sizeof(ArraysCommand));
+		glCreateBuffers(1, &a_layer.commandBuffer);
+		glNamedBufferStorage(a_layer.commandBuffer, commands.size(), commands.data(), 0);
+		GpuMemory::instance().trackBuffer(a_layer.commandBuffer, commands.size(), GpuMemory::CULLING, "Foliage");
+
+		glCreateVertexArrays(1, &a_layer.vao);
+		aie::OBJMesh::setVertexArrayFormat(a_layer.vao, 0, mesh.getVertexFormat());
+
+		a_layer.ready = true;
+		return true;
+	}
+
+	/**
+		destroy deletes a layer's buffers, vertex array and impostor.
+
+			@param1 a_layer is the layer.
+	*/
+	void Foliage::destroy(Layer& a_layer)
+	{
+		RenderState& state = RenderState::instance();
+		GpuMemory& memory = GpuMemory::instance();
+		unsigned int* buffers[4] = { &a_layer.instanceBuffer, &a_layer.visibleBuffer, &a_layer.countBuffer,
+			&a_layer.commandBuffer };
+		for (unsigned int* buffer : buffers)
+		{
+			if (*buffer != 0)
+			{
+				glDeleteBuffers(1, buffer);
+				state.onBufferDeleted(*buffer);
+				memory.releaseBuffer(*buffer);
+				*buffer = 0;
+			}
+		}
+		if (a_layer.vao != 0)
+		{
+			glDeleteVertexArrays(1, &a_layer.vao);
+			state.onVertexArrayDeleted(a_layer.vao);
+			a_layer.vao = 0;
+		}
+		a_layer.impostor.destroy();
+	}
+}
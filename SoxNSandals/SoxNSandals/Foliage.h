@@ -0,0 +1,239 @@
+/**
+	Foliage.h
+
+	Purpose: Foliage.h is the header file for the Foliage class. The
+			Foliage scatters thousands of copies of a plant or tree over
+			the ground, culls them on the gpu and draws the near ones as
+			meshes and the far ones as impostor cards, with indirect
+			instanced draws the cpu never fills in.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SceneDescription.h"
+#include "HiZBuffer.h"
+#include "Impostor.h"
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	class ImpostorBaker;
+
+	/**
+		The Foliage class holds layers, each the copies of one mesh
+			scattered from a SceneDescription::Foliage. Copies are
+			placed once, on the cpu, by trying the layer's count of
+			random positions and keeping each with the brightness of
+			the density map under it. They are uploaded as a position,
+			scale and turn about Y each, and never move.
+
+		cull runs a compute shader over every copy of every layer. A copy
+			outside the frustum, behind the HiZBuffer's occluders or
+			past the draw distance is dropped, the others are appended
+			to the list of copies drawn as meshes, as impostors, or both
+			while they are between the fade distances. The counts are
+			copied into each layer's indirect commands on the gpu, so
+			draw is an instanced draw per chunk and one for the
+			impostors, whatever was kept.
+
+		A copy between the fade distances is drawn both ways, dithered
+			so its mesh gives way to its impostor as it gets further,
+			with no blending. The impostor is a card facing the camera,
+			showing the view of the mesh nearest it from an octahedral
+			atlas over the upper hemisphere, baked once the mesh has
+			loaded.
+
+		Culling needs GL 4.3 for its compute shader and the impostors GL
+			4.5, without them create fails and there is no foliage. The
+			foliage is lit and shadowed by the first light, but doesn't
+			cast shadows itself.
+	*/
+	class Foliage
+	{
+	public:
+		// The cull shader's work group size.
+		static const unsigned int GROUP_SIZE = 64;
+
+		// Returns the height of the ground at a world X and Z.
+		typedef std::function<float(float, float)> HeightFunction;
+
+		// Points a program at the frame's lights and shadows before the
+		//	foliage is drawn with it.
+		typedef std::function<void(aie::ShaderProgram&)> LightingFunction;
+
+		/**
+			Counts of the layers and the copies placed in them.
+		*/
+		struct Stats
+		{
+			unsigned int layers;
+			unsigned int instances;
+		};
+
+		Foliage();
+
+		/**
+			The deconstructor deletes every layer's buffers.
+		*/
+		~Foliage();
+
+		Foliage(const Foliage&) = delete;
+		Foliage& operator=(const Foliage&) = delete;
+
+		/**
+			create loads the cull and draw shaders.
+
+				@return false without GL 4.5 or the shaders, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_cullShader.getHandle() != 0; }
+
+		/**
+			addLayer scatters a layer's copies and uploads them. Its mesh
+				is made but not loaded.
+
+				@param1 a_layer is the scene's layer.
+
+				@param2 a_height is the ground the copies stand on, or
+						empty for the layer's height.
+
+				@return the layer's mesh, for the caller to load with
+						its textures, or null if the density map can't
+						be read or no copies were kept, the layer is
+						left out.
+		*/
+		aie::OBJMesh* addLayer(const SceneDescription::Foliage& a_layer, const HeightFunction& a_height);
+
+		/**
+			getLayerCount returns how many layers were added.
+		*/
+		unsigned int getLayerCount() const { return (unsigned int)m_layers.size(); }
+
+		/**
+			prepare gets every layer whose mesh has loaded since it was
+				last called ready to draw, working out its bounds and
+				baking its impostor. It must be called outside of any
+				pass, the baker draws into a framebuffer of its own.
+
+				@param1 a_baker bakes the impostors.
+		*/
+		void prepare(ImpostorBaker& a_baker);
+
+		/**
+			cull finds the copies of every ready layer to draw this view.
+
+				@param1 a_projectionView is the camera's projection view.
+
+				@param2 a_cameraPosition is where the camera is.
+
+				@param3 a_hiZ holds the depth of the occluders, seen with
+						the same projection view, or null to not test
+						against it.
+		*/
+		void cull(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition,
+			const HiZBuffer* a_hiZ = nullptr);
+
+		/**
+			draw draws what the last cull kept, the meshes and then the
+				impostors.
+
+				@param1 a_lighting binds the frame's lighting to each
+						program before it draws.
+		*/
+		void draw(const LightingFunction& a_lighting);
+
+		/**
+			getStats returns the counts of what was placed.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		// A copy as the shaders read it, 32 bytes in std430.
+		struct Instance
+		{
+			glm::vec4 positionScale;
+			glm::vec4 rotation;
+		};
+
+		// The layouts glDrawElementsIndirect and glDrawArraysIndirect read.
+		struct ElementsCommand
+		{
+			unsigned int count;
+			unsigned int instanceCount;
+			unsigned int firstIndex;
+			int baseVertex;
+			unsigned int baseInstance;
+		};
+		struct ArraysCommand
+		{
+			unsigned int count;
+			unsigned int instanceCount;
+			unsigned int first;
+			unsigned int baseInstance;
+		};
+
+		// A layer's copies and what draws them.
+		struct Layer
+		{
+			SceneDescription::Foliage settings;
+			std::unique_ptr<aie::OBJMesh> mesh;
+			std::vector<Instance> instances;
+
+			// Whether prepare has made it ready to draw.
+			bool ready;
+
+			// The mesh's bounds around its origin at a scale of 1, as a
+			//	sphere centred on the axis copies are turned about, for
+			//	culling.
+			glm::vec4 sphere;
+			Impostor impostor;
+
+			// The copies, the lists cull keeps them in with the meshes'
+			//	first, and how many each list has.
+			unsigned int instanceBuffer;
+			unsigned int visibleBuffer;
+			unsigned int countBuffer;
+
+			// A command per chunk, then the impostors' command after
+			//	them.
+			unsigned int commandBuffer;
+
+			// The vertex array the chunks' buffers are attached to in
+			//	turn.
+			unsigned int vao;
+		};
+
+		// Scatters a layer's copies, false if the density map can't be
+		//	read.
+		bool scatter(Layer& a_layer, const HeightFunction& a_height);
+
+		// Works out a loaded layer's bounds, writes its commands and
+		//	bakes its impostor, false if it can't be baked.
+		bool prepareLayer(Layer& a_layer, ImpostorBaker& a_baker);
+
+		// Deletes a layer's buffers, vertex array and impostor.
+		void destroy(Layer& a_layer);
+
+		aie::ShaderProgram m_cullShader;
+		aie::ShaderProgram m_meshShader;
+		aie::ShaderProgram m_impostorShader;
+
+		std::vector<std::unique_ptr<Layer>> m_layers;
+
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,59 @@
+/**
+	FragmentCounter.cpp
+
+	Purpose: FragmentCounter.cpp is the source file for the
+			FragmentCounter class. The FragmentCounter counts the
+			fragments a pass shades each frame, to show how much of it
+			is overdraw.
+
+	@author Nathan Nette
+*/
+#include "FragmentCounter.h"
+#include "gl_core_4_5.h"
+
+namespace sns
+{
+	FragmentCounter::FragmentCounter()
+		: m_queries(),
+		m_frame(0),
+		m_count(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the queries.
+	*/
+	FragmentCounter::~FragmentCounter()
+	{
+		if (m_queries[0] != 0)
+			glDeleteQueries(LATENCY, m_queries);
+	}
+
+	/**
+		begin reads this frame's query from LATENCY frames ago, then
+			starts counting into it.
+	*/
+	void FragmentCounter::begin()
+	{
+		if (m_queries[0] == 0)
+			glGenQueries(LATENCY, m_queries);
+
+		unsigned int query = m_queries[m_frame % LATENCY];
+		if (m_frame >= LATENCY)
+		{
+			GLuint64 count = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &count);
+			m_count = count;
+		}
+		glBeginQuery(GL_SAMPLES_PASSED, query);
+	}
+
+	/**
+		end stops counting for the frame.
+	*/
+	void FragmentCounter::end()
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		++m_frame;
+	}
+}
@@ -0,0 +1,60 @@
+/**
+	FragmentCounter.h
+
+	Purpose: FragmentCounter.h is the header file for the FragmentCounter
+			class. The FragmentCounter counts the fragments a pass
+			shades each frame, to show how much of it is overdraw.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+namespace sns
+{
+	/**
+		The FragmentCounter class wraps a GL_SAMPLES_PASSED query per
+			frame in flight. A frame's count is read back LATENCY frames
+			later, when the gpu is long done with it, so reading it
+			never waits.
+
+		Only one can count at a time, queries of a target don't nest.
+	*/
+	class FragmentCounter
+	{
+	public:
+		// How many frames old the count is when it is read.
+		static const unsigned int LATENCY = 3;
+
+		FragmentCounter();
+
+		/**
+			The deconstructor deletes the queries.
+		*/
+		~FragmentCounter();
+
+		FragmentCounter(const FragmentCounter&) = delete;
+		FragmentCounter& operator=(const FragmentCounter&) = delete;
+
+		/**
+			begin reads this frame's query from LATENCY frames ago, then
+				starts counting into it.
+		*/
+		void begin();
+
+		/**
+			end stops counting for the frame.
+		*/
+		void end();
+
+		/**
+			getCount returns how many fragments passed the depth test
+				between begin and end, LATENCY frames ago.
+		*/
+		unsigned long long getCount() const { return m_count; }
+
+	private:
+		unsigned int m_queries[LATENCY];
+		unsigned int m_frame;
+		unsigned long long m_count;
+	};
+}
@@ -0,0 +1,147 @@
+/**
+	FrameArena.cpp
+
+	Purpose: FrameArena.cpp is the source file for the FrameArena and
+			DoubleFrameArena classes. A FrameArena hands out memory for
+			a single frame by moving a pointer along one block, and
+			takes it all back at once when the frame is over.
+
+	@author Nathan Nette
+*/
+#include "FrameArena.h"
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace sns
+{
+	/**
+		The constructor allocates the block.
+
+			@param1 a_capacity is the size of the block in bytes.
+	*/
+	FrameArena::FrameArena(size_t a_capacity)
+		: m_block(allocateBlock(a_capacity)), m_capacity(a_capacity), m_offset(0),
+		m_overflowBytes(0), m_highWatermark(0), m_overflowCount(0)
+	{
+	}
+
+	/**
+		The deconstructor frees the block and any overflow.
+	*/
+	FrameArena::~FrameArena()
+	{
+		for (unsigned char* overflow : m_overflow)
+			delete[] overflow;
+		delete[] m_block;
+	}
+
+	/**
+		allocate returns memory that stays valid until reset.
+
+			@param1 a_size is the size in bytes.
+
+			@param2 a_alignment is what the address must be a multiple
+					of, a power of two.
+
+			@return the memory, or null when a_size is 0.
+	*/
+	void* FrameArena::allocate(size_t a_size, size_t a_alignment)
+	{
+		assert(a_alignment != 0 && (a_alignment & (a_alignment - 1)) == 0);
+		if (a_size == 0)
+			return nullptr;
+
+		// The block starts max_align_t aligned, so aligning the offset
+		//	aligns the address for anything up to that.
+		size_t offset = (m_offset + a_alignment - 1) & ~(a_alignment - 1);
+		if (a_alignment <= alignof(std::max_align_t) && offset + a_size <= m_capacity)
+		{
+			m_offset = offset + a_size;
+			return m_block + offset;
+		}
+
+		// Overflow gets a block of its own, padded for the alignment.
+		unsigned char* overflow = allocateBlock(a_size + a_alignment);
+		m_overflow.push_back(overflow);
+		m_overflowBytes += a_size;
+
+		size_t address = (reinterpret_cast<size_t>(overflow) + a_alignment - 1) & ~(a_alignment - 1);
+		return reinterpret_cast<void*>(address);
+	}
+
+	/**
+		reset frees everything allocated since the last reset, and
+			grows the block if the frame overflowed it.
+	*/
+	void FrameArena::reset()
+	{
+		size_t used = getUsed();
+		m_highWatermark = std::max(m_highWatermark, used);
+
+		if (m_overflow.empty() == false)
+		{
+			for (unsigned char* overflow : m_overflow)
+				delete[] overflow;
+			m_overflow.clear();
+			m_overflowBytes = 0;
+			++m_overflowCount;
+
+			// Alignment padding is counted too, so a frame like the last
+			//	one fits with a little to spare.
+			delete[] m_block;
+			m_capacity = m_highWatermark + m_highWatermark / 8;
+			m_block = allocateBlock(m_capacity);
+		}
+
+		m_offset = 0;
+	}
+
+	/**
+		getHighWatermark returns the most bytes any frame has used.
+	*/
+	size_t FrameArena::getHighWatermark() const
+	{
+		return std::max(m_highWatermark, getUsed());
+	}
+
+	/**
+		allocateBlock allocates a block aligned to max_align_t, which
+			new of unsigned char always is.
+
+			@param1 a_size is the size in bytes.
+	*/
+	unsigned char* FrameArena::allocateBlock(size_t a_size)
+	{
+		return new unsigned char[a_size > 0 ? a_size : 1];
+	}
+
+	/**
+		The constructor allocates both blocks.
+
+			@param1 a_capacity is the size of each block in bytes.
+	*/
+	DoubleFrameArena::DoubleFrameArena(size_t a_capacity)
+		: m_first(a_capacity), m_second(a_capacity), m_writing(&m_first), m_reading(&m_second)
+	{
+	}
+
+	/**
+		flip makes the arena being written the one being read, and
+			resets the other to be written next.
+	*/
+	void DoubleFrameArena::flip()
+	{
+		std::swap(m_writing, m_reading);
+		m_writing->reset();
+	}
+
+	/**
+		getHighWatermark returns the most bytes either arena has used
+			in a frame.
+	*/
+	size_t DoubleFrameArena::getHighWatermark() const
+	{
+		return std::max(m_first.getHighWatermark(), m_second.getHighWatermark());
+	}
+}
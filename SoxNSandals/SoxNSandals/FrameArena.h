@@ -0,0 +1,171 @@
+/**
+	FrameArena.h
+
+	Purpose: FrameArena.h is the header file for the FrameArena and
+			DoubleFrameArena classes. A FrameArena hands out memory for
+			a single frame by moving a pointer along one block, and
+			takes it all back at once when the frame is over.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The FrameArena class allocates by rounding its offset up to the
+			alignment and moving it past the allocation, and reset
+			frees everything by moving it back to the start. Nothing is
+			destructed, so only trivially destructible types can go in.
+
+		When a frame needs more than the block holds, the rest comes
+			from overflow blocks on the heap. The next reset frees them
+			and grows the block to the most any frame has used, so an
+			arena sized too small only allocates on the frames it
+			grows. getHighWatermark is what to size it to up front.
+
+		An arena belongs to one thread at a time.
+	*/
+	class FrameArena
+	{
+	public:
+		// The size of the block when none is given.
+		static const size_t DEFAULT_CAPACITY = 1024 * 1024;
+
+		/**
+			The constructor allocates the block.
+
+				@param1 a_capacity is the size of the block in bytes.
+		*/
+		explicit FrameArena(size_t a_capacity = DEFAULT_CAPACITY);
+
+		/**
+			The deconstructor frees the block and any overflow.
+		*/
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		/**
+			allocate returns memory that stays valid until reset.
+
+				@param1 a_size is the size in bytes.
+
+				@param2 a_alignment is what the address must be a multiple
+						of, a power of two.
+
+				@return the memory, or null when a_size is 0.
+		*/
+		void* allocate(size_t a_size, size_t a_alignment = alignof(std::max_align_t));
+
+		/**
+			allocateArray returns room for a_count elements, which are
+				left uninitialised.
+
+				@param1 a_count is how many elements.
+		*/
+		template <typename T>
+		T* allocateArray(size_t a_count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value,
+				"A FrameArena never runs destructors.");
+			return static_cast<T*>(allocate(a_count * sizeof(T), alignof(T)));
+		}
+
+		/**
+			reset frees everything allocated since the last reset, and
+				grows the block if the frame overflowed it.
+		*/
+		void reset();
+
+		/**
+			getUsed returns how many bytes have been allocated since
+				the last reset, overflow included.
+		*/
+		size_t getUsed() const { return m_offset + m_overflowBytes; }
+
+		/**
+			getCapacity returns the size of the block in bytes.
+		*/
+		size_t getCapacity() const { return m_capacity; }
+
+		/**
+			getHighWatermark returns the most bytes any frame has used.
+		*/
+		size_t getHighWatermark() const;
+
+		/**
+			getOverflowCount returns how many frames have needed more
+				than the block held.
+		*/
+		unsigned int getOverflowCount() const { return m_overflowCount; }
+
+	private:
+		// Allocates a block of at least a_size bytes aligned to
+		//	max_align_t.
+		static unsigned char* allocateBlock(size_t a_size);
+
+		unsigned char* m_block;
+		size_t m_capacity;
+		size_t m_offset;
+
+		// Allocations that didn't fit the block, freed by reset.
+		std::vector<unsigned char*> m_overflow;
+		size_t m_overflowBytes;
+
+		size_t m_highWatermark;
+		unsigned int m_overflowCount;
+	};
+
+	/**
+		The DoubleFrameArena class keeps two FrameArenas, one being
+			written for the next frame while the other is read by the
+			frame being drawn. flip resets the one being read and swaps
+			them over, so data written on one thread survives until
+			the frame after has been handed over.
+	*/
+	class DoubleFrameArena
+	{
+	public:
+		/**
+			The constructor allocates both blocks.
+
+				@param1 a_capacity is the size of each block in bytes.
+		*/
+		explicit DoubleFrameArena(size_t a_capacity = FrameArena::DEFAULT_CAPACITY);
+
+		/**
+			getWriting returns the arena the next frame is written to.
+		*/
+		FrameArena& getWriting() { return *m_writing; }
+
+		/**
+			getReading returns the arena of the frame being drawn.
+		*/
+		const FrameArena& getReading() const { return *m_reading; }
+
+		/**
+			flip makes the arena being written the one being read, and
+				resets the other to be written next.
+		*/
+		void flip();
+
+		/**
+			getHighWatermark returns the most bytes either arena has used
+				in a frame.
+		*/
+		size_t getHighWatermark() const;
+
+	private:
+		FrameArena m_first;
+		FrameArena m_second;
+
+		// Which of the two is being written and which read.
+		FrameArena* m_writing;
+		FrameArena* m_reading;
+	};
+}
@@ -0,0 +1,351 @@
+/**
+	FrameCapture.cpp
+
+	Purpose: FrameCapture.cpp is the source file for the FrameCapture
+			class. The FrameCapture is what frames are drawn into when
+			nothing is on screen, reading each back through the
+			GpuReadback and writing it to disk on a pool of encoder
+			threads.
+
+	@author Nathan Nette
+*/
+#include "FrameCapture.h"
+#include "GpuMemory.h"
+#include "GpuReadback.h"
+#include "Profiler.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// A TGA packet covers 128 pixels at most, its count less one in the
+	//	low seven bits of its header, with the top bit set for a run.
+	static const int MAX_PACKET_PIXELS = 128;
+	static const unsigned char RUN_PACKET = 0x80;
+
+	// How long capture sleeps at a time while every frame in flight is.
+	static const int STALL_MILLISECONDS = 1;
+
+	FrameCapture::FrameCapture()
+		: m_framebuffer(0),
+		m_colour(0),
+		m_depth(0),
+		m_width(0),
+		m_height(0),
+		m_nextFrame(0),
+		m_inFlight(0),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor waits for the frames captured and deletes the
+			framebuffer, see destroy.
+	*/
+	FrameCapture::~FrameCapture()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the framebuffer and starts the encoders. Its depth has
+			a stencil as the window's does.
+
+			@param1 a_width is the width of the frames.
+
+			@param2 a_height is their height.
+
+			@param3 a_directory is the directory the frames are written
+					into, which must exist.
+
+			@param4 a_encoderCount is how many encoder threads there are,
+					0 for one less than the number of cores.
+
+			@return false without GL 4.5, or if the framebuffer isn't
+					complete.
+	*/
+	bool FrameCapture::create(int a_width, int a_height, const char* a_directory, unsigned int a_encoderCount)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("FrameCapture: capturing frames needs GL 4.5.\n");
+			return false;
+		}
+
+		m_width = a_width;
+		m_height = a_height;
+		m_directory = a_directory;
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_colour);
+		glTextureStorage2D(m_colour, 1, GL_RGBA8, m_width, m_height);
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_depth);
+		glTextureStorage2D(m_depth, 1, GL_DEPTH24_STENCIL8, m_width, m_height);
+		GpuMemory& memory = GpuMemory::instance();
+		memory.trackTexture(m_colour, GpuMemory::getTextureBytes(GL_RGBA8, m_width, m_height),
+			GpuMemory::RENDER_TARGETS, "FrameCapture");
+		memory.trackTexture(m_depth, GpuMemory::getTextureBytes(GL_DEPTH24_STENCIL8, m_width, m_height),
+			GpuMemory::RENDER_TARGETS, "FrameCapture");
+
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_colour, 0);
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_depth, 0);
+		glNamedFramebufferDrawBuffer(m_framebuffer, GL_COLOR_ATTACHMENT0);
+		glNamedFramebufferReadBuffer(m_framebuffer, GL_COLOR_ATTACHMENT0);
+		if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("FrameCapture: the framebuffer isn't complete.\n");
+			destroy();
+			return false;
+		}
+
+		m_encoders.reset(new ThreadPool(a_encoderCount));
+		m_nextFrame = 0;
+		m_stats = {};
+		printf("Capturing %ix%i frames into %s on %u encoders\n", m_width, m_height, a_directory,
+			m_encoders->getThreadCount());
+		return true;
+	}
+
+	/**
+		bind binds the framebuffer to be drawn into, in place of the
+			window's, and sets the viewport to all of it.
+	*/
+	void FrameCapture::bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glViewport(0, 0, m_width, m_height);
+	}
+
+	/**
+		capture reads the frame drawn into the framebuffer back, to be
+			written as the next frame. While MAX_IN_FLIGHT frames are
+			already read back or being, readbacks that have finished
+			are handed over while it waits for an encoder to catch up.
+	*/
+	void FrameCapture::capture()
+	{
+		if (isCreated() == false)
+			return;
+
+		SNS_PROFILE_SCOPE("Frame capture");
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_inFlight >= MAX_IN_FLIGHT)
+				++m_stats.stalls;
+			while (m_inFlight >= MAX_IN_FLIGHT)
+			{
+				lock.unlock();
+				GpuReadback::instance().update();
+				lock.lock();
+				m_written.wait_for(lock, std::chrono::milliseconds(STALL_MILLISECONDS));
+			}
+			++m_inFlight;
+			++m_stats.captured;
+		}
+
+		unsigned int frame = m_nextFrame++;
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+		GpuReadback::instance().readPixels(0, 0, m_width, m_height, GL_BGRA, GL_UNSIGNED_BYTE,
+			(size_t)m_width * m_height * 4, [this, frame](const void* a_data, size_t a_size)
+		{
+			onReadback(frame, a_data, a_size);
+		});
+	}
+
+	/**
+		onReadback copies a frame's pixels out of its staging buffer, which
+			is only valid during the call, into a buffer of the pool's
+			and queues it for an encoder.
+
+			@param1 a_frame is the frame's number.
+
+			@param2 a_data is its pixels.
+
+			@param3 a_size is how many bytes they take.
+	*/
+	void FrameCapture::onReadback(unsigned int a_frame, const void* a_data, size_t a_size)
+	{
+		std::vector<unsigned char> pixels;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_buffers.empty() == false)
+			{
+				pixels = std::move(m_buffers.back());
+				m_buffers.pop_back();
+			}
+		}
+		pixels.resize(a_size);
+		memcpy(pixels.data(), a_data, a_size);
+
+		// The vector is moved into the task, which std::function can only
+		//	hold copyable, so it goes by a shared pointer.
+		std::shared_ptr<std::vector<unsigned char>> shared =
+			std::make_shared<std::vector<unsigned char>>(std::move(pixels));
+		m_encoders->enqueue([this, a_frame, shared]() { encode(a_frame, std::move(*shared)); });
+	}
+
+	/**
+		encode writes a frame as frame_00000.tga in the directory, numbered
+			from the first capture, and gives its buffer back.
+
+			@param1 a_frame is the frame's number.
+
+			@param2 a_pixels is its pixels, BGRA bottom row first.
+	*/
+	void FrameCapture::encode(unsigned int a_frame, std::vector<unsigned char> a_pixels)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<unsigned char> tga;
+		encodeTga(a_pixels.data(), m_width, m_height, tga);
+
+		char filename[512];
+		snprintf(filename, sizeof(filename), "%s/frame_%05u.tga", m_directory.c_str(), a_frame);
+		FILE* file = nullptr;
+		fopen_s(&file, filename, "wb");
+		bool written = file != nullptr && fwrite(tga.data(), 1, tga.size(), file) == tga.size();
+		if (file != nullptr)
+			fclose(file);
+		if (written == false)
+			printf("FrameCapture: %s couldn't be written.\n", filename);
+
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_buffers.push_back(std::move(a_pixels));
+			--m_inFlight;
+			if (written)
+				++m_stats.written;
+			else
+				++m_stats.failed;
+			m_stats.encodeMilliseconds += milliseconds;
+		}
+		m_written.notify_all();
+	}
+
+	/**
+		encodeTga encodes BGRA pixels, bottom row first, as an RLE
+			compressed TGA. A run packet is started wherever two pixels
+			in a row are the same, raw packets hold the rest.
+
+			@param1 a_pixels is the pixels, their alpha written to 255 as
+					the frame's alpha is whatever was blended last.
+
+			@param2 a_width is their width.
+
+			@param3 a_height is their height.
+
+			@param4 a_output is cleared and given the file.
+	*/
+	void FrameCapture::encodeTga(unsigned char* a_pixels, int a_width, int a_height,
+		std::vector<unsigned char>& a_output)
+	{
+		unsigned int* pixels = (unsigned int*)a_pixels;
+		size_t count = (size_t)a_width * a_height;
+		for (size_t i = 0; i < count; ++i)
+			pixels[i] |= 0xff000000;
+
+		// Run length encoded true colour, 32 bits with 8 of alpha, from
+		//	the bottom left.
+		unsigned char header[18] = {};
+		header[2] = 10;
+		header[12] = (unsigned char)(a_width & 0xff);
+		header[13] = (unsigned char)(a_width >> 8);
+		header[14] = (unsigned char)(a_height & 0xff);
+		header[15] = (unsigned char)(a_height >> 8);
+		header[16] = 32;
+		header[17] = 8;
+
+		a_output.clear();
+		a_output.reserve(sizeof(header) + count * 4 + count / MAX_PACKET_PIXELS + a_height);
+		a_output.insert(a_output.end(), header, header + sizeof(header));
+		for (int y = 0; y < a_height; ++y)
+		{
+			const unsigned int* row = pixels + (size_t)y * a_width;
+			int x = 0;
+			while (x < a_width)
+			{
+				int run = 1;
+				while (x + run < a_width && run < MAX_PACKET_PIXELS && row[x + run] == row[x])
+					++run;
+				if (run > 1)
+				{
+					a_output.push_back((unsigned char)(RUN_PACKET | (run - 1)));
+					const unsigned char* pixel = (const unsigned char*)&row[x];
+					a_output.insert(a_output.end(), pixel, pixel + 4);
+					x += run;
+					continue;
+				}
+
+				// Raw up to where the next run starts.
+				int raw = 1;
+				while (x + raw < a_width && raw < MAX_PACKET_PIXELS &&
+					(x + raw + 1 >= a_width || row[x + raw] != row[x + raw + 1]))
+					++raw;
+				a_output.push_back((unsigned char)(raw - 1));
+				const unsigned char* first = (const unsigned char*)&row[x];
+				a_output.insert(a_output.end(), first, first + raw * 4);
+				x += raw;
+			}
+		}
+	}
+
+	/**
+		finish waits for every frame captured to be read back and written.
+			The gpu is finished first, so every readback's fence has
+			passed by the next update.
+	*/
+	void FrameCapture::finish()
+	{
+		if (m_encoders == nullptr)
+			return;
+
+		glFinish();
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_inFlight > 0)
+		{
+			lock.unlock();
+			GpuReadback::instance().update();
+			lock.lock();
+			m_written.wait_for(lock, std::chrono::milliseconds(STALL_MILLISECONDS));
+		}
+		lock.unlock();
+		m_encoders->waitIdle();
+	}
+
+	/**
+		destroy waits for the frames captured, then stops the encoders and
+			deletes the framebuffer.
+	*/
+	void FrameCapture::destroy()
+	{
+		finish();
+		m_encoders.reset();
+		m_buffers.clear();
+
+		unsigned int textures[] = { m_colour, m_depth };
+		for (unsigned int texture : textures)
+		{
+			if (texture == 0)
+				continue;
+			glDeleteTextures(1, &texture);
+			RenderState::instance().onTextureDeleted(texture);
+			GpuMemory::instance().releaseTexture(texture);
+		}
+		if (m_framebuffer != 0)
+			glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = m_colour = m_depth = 0;
+	}
+
+	/**
+		getStats returns what has been captured and written.
+	*/
+	FrameCapture::Stats FrameCapture::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+}
@@ -0,0 +1,168 @@
+/**
+	FrameCapture.h
+
+	Purpose: FrameCapture.h is the header file for the FrameCapture class.
+			The FrameCapture is what frames are drawn into when nothing
+			is on screen, reading each back through the GpuReadback and
+			writing it to disk on a pool of encoder threads.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The FrameCapture class owns a framebuffer the size of the window,
+			bound in place of the window's for a frame to be drawn into.
+			Every target that draws into whatever was bound before it
+			ends up drawing into it instead, so nothing else has to know
+			there is no window to show.
+
+		capture reads the frame back without waiting, its pixels handed
+			over a few frames later for an encoder thread to write as an
+			RLE compressed TGA, which is stored bottom row first as GL
+			reads it. Frames already read back or being encoded are
+			limited to MAX_IN_FLIGHT, so a slow disk holds capture up
+			rather than filling memory.
+	*/
+	class FrameCapture
+	{
+	public:
+		// Frames read back, waiting for an encoder or being encoded at
+		//	most.
+		static const unsigned int MAX_IN_FLIGHT = 8;
+
+		/**
+			What has been captured and written so far.
+		*/
+		struct Stats
+		{
+			unsigned int captured;
+			unsigned int written;
+			unsigned int failed;
+
+			// captures that waited for an encoder to catch up.
+			unsigned int stalls;
+			double encodeMilliseconds;
+		};
+
+		FrameCapture();
+
+		/**
+			The deconstructor waits for the frames captured and deletes
+				the framebuffer, see destroy.
+		*/
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+
+		/**
+			create makes the framebuffer and starts the encoders.
+
+				@param1 a_width is the width of the frames.
+
+				@param2 a_height is their height.
+
+				@param3 a_directory is the directory the frames are written
+						into, which must exist.
+
+				@param4 a_encoderCount is how many encoder threads there
+						are, 0 for one less than the number of cores.
+
+				@return false without GL 4.5, or if the framebuffer isn't
+						complete.
+		*/
+		bool create(int a_width, int a_height, const char* a_directory, unsigned int a_encoderCount = 0);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_framebuffer != 0; }
+
+		/**
+			getFramebuffer returns the framebuffer frames are drawn into.
+		*/
+		unsigned int getFramebuffer() const { return m_framebuffer; }
+
+		/**
+			bind binds the framebuffer to be drawn into, in place of the
+				window's, and sets the viewport to all of it.
+		*/
+		void bind() const;
+
+		/**
+			capture reads the frame drawn into the framebuffer back, to be
+				written as the next frame. It only waits if MAX_IN_FLIGHT
+				frames are already read back or being.
+		*/
+		void capture();
+
+		/**
+			finish waits for every frame captured to be read back and
+				written.
+		*/
+		void finish();
+
+		/**
+			destroy waits for the frames captured, then stops the
+				encoders and deletes the framebuffer.
+		*/
+		void destroy();
+
+		/**
+			getStats returns what has been captured and written.
+		*/
+		Stats getStats() const;
+
+	private:
+		// Hands a frame's pixels to an encoder, on the main thread in
+		//	GpuReadback::update.
+		void onReadback(unsigned int a_frame, const void* a_data, size_t a_size);
+
+		// Writes a frame, on an encoder thread.
+		void encode(unsigned int a_frame, std::vector<unsigned char> a_pixels);
+
+		/**
+			encodeTga encodes BGRA pixels, bottom row first, as an RLE
+				compressed TGA. Its packets never cross a row.
+
+				@param1 a_pixels is the pixels, their alpha written to 255.
+
+				@param2 a_width is their width.
+
+				@param3 a_height is their height.
+
+				@param4 a_output is cleared and given the file.
+		*/
+		static void encodeTga(unsigned char* a_pixels, int a_width, int a_height, std::vector<unsigned char>& a_output);
+
+		unsigned int m_framebuffer;
+		unsigned int m_colour;
+		unsigned int m_depth;
+		int m_width;
+		int m_height;
+		std::string m_directory;
+		unsigned int m_nextFrame;
+
+		std::unique_ptr<ThreadPool> m_encoders;
+
+		// Guards everything below.
+		mutable std::mutex m_mutex;
+		std::condition_variable m_written;
+
+		// Captured and not yet written, read back or not.
+		unsigned int m_inFlight;
+
+		// Pixel buffers to be read into again.
+		std::vector<std::vector<unsigned char>> m_buffers;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,194 @@
+/**
+	FramePacer.cpp
+
+	Purpose: FramePacer.cpp is the source file for the FramePacer class.
+			The FramePacer picks how frames are presented, with vsync,
+			adaptive vsync, uncapped or capped to a rate, and keeps
+			statistics on how evenly they are.
+
+	@author Nathan Nette
+*/
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace sns
+{
+	// How long each sleep asks for. Short, so the last one ends close to
+	//	where spinning takes over.
+	static const nanoseconds SLEEP_STEP = std::chrono::milliseconds(1);
+
+	// How many standard deviations of lateness past the average a sleep
+	//	is allowed for before spinning instead.
+	static const double SLEEP_LATE_MARGIN = 3.0;
+
+	FramePacer::FramePacer()
+		: m_mode(PresentMode::VSYNC),
+		m_period(0),
+		m_deadline(),
+		m_sleepLateMean(0.001),
+		m_sleepLateVariance(0.0),
+		m_history(),
+		m_historyCount(0),
+		m_historyNext(0),
+		m_lastSwap(),
+		m_swapped(false),
+		m_stats()
+	{
+	}
+
+	/**
+		setMode sets the swap interval of the current context, and the
+			rate a capped mode holds frames to.
+
+			@param1 a_mode is how frames are presented.
+
+			@param2 a_rate is the frames per second CAPPED holds to.
+	*/
+	void FramePacer::setMode(PresentMode a_mode, double a_rate)
+	{
+		// Tearing late frames needs the driver's swap control tear.
+		if (a_mode == PresentMode::ADAPTIVE && glfwExtensionSupported("WGL_EXT_swap_control_tear") == GLFW_FALSE &&
+			glfwExtensionSupported("GLX_EXT_swap_control_tear") == GLFW_FALSE)
+		{
+			printf("FramePacer: adaptive vsync isn't supported, using vsync.\n");
+			a_mode = PresentMode::VSYNC;
+		}
+		m_mode = a_mode;
+
+		switch (m_mode)
+		{
+		case PresentMode::VSYNC:
+			glfwSwapInterval(1);
+			break;
+		case PresentMode::ADAPTIVE:
+			glfwSwapInterval(-1);
+			break;
+		case PresentMode::UNCAPPED:
+		case PresentMode::CAPPED:
+			glfwSwapInterval(0);
+			break;
+		}
+
+		// What a frame should take, so late ones can be counted. With
+		//	vsync that is the monitor's refresh.
+		double rate = 0.0;
+		if (m_mode == PresentMode::CAPPED)
+			rate = a_rate;
+		else if (m_mode != PresentMode::UNCAPPED)
+		{
+			const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+			rate = videoMode != nullptr ? videoMode->refreshRate : 60.0;
+		}
+		m_period = nanoseconds(rate > 0.0 ? (long long)(NANO_IN_SECONDS / rate) : 0);
+
+		m_deadline = sns::clock::now() + m_period;
+		m_historyCount = m_historyNext = 0;
+		m_swapped = false;
+		m_stats = {};
+	}
+
+	/**
+		wait waits until the frame should be swapped when capped, and
+			returns straight away otherwise.
+	*/
+	void FramePacer::wait()
+	{
+		if (m_mode != PresentMode::CAPPED)
+			return;
+
+		// Sleep while even a late wake would leave time to spare.
+		for (;;)
+		{
+			double remaining = (m_deadline - sns::clock::now()).count() * NANO_TO_SECONDS;
+			double allowance = SLEEP_STEP.count() * NANO_TO_SECONDS + m_sleepLateMean +
+				SLEEP_LATE_MARGIN * std::sqrt(m_sleepLateVariance);
+			if (remaining <= allowance)
+				break;
+
+			sns::time before = sns::clock::now();
+			std::this_thread::sleep_for(SLEEP_STEP);
+			double late = (sns::clock::now() - before - SLEEP_STEP).count() * NANO_TO_SECONDS;
+
+			// An exponential moving average, so it follows the system's
+			//	timer as it changes.
+			double difference = late - m_sleepLateMean;
+			m_sleepLateMean += difference * 0.1;
+			m_sleepLateVariance = (m_sleepLateVariance + difference * difference * 0.1) * 0.9;
+		}
+
+		// Then spin the rest.
+		while (sns::clock::now() < m_deadline)
+			std::this_thread::yield();
+
+		// A frame that ran over starts the next from now, rather than
+		//	rushing the ones after to catch up.
+		sns::time now = sns::clock::now();
+		m_deadline += m_period;
+		if (m_deadline < now)
+			m_deadline = now + m_period;
+	}
+
+	/**
+		endFrame records how long it has been since the last swap.
+	*/
+	void FramePacer::endFrame()
+	{
+		sns::time now = sns::clock::now();
+		if (m_swapped)
+		{
+			m_history[m_historyNext] = (now - m_lastSwap).count() * NANO_TO_SECONDS * 1000.0;
+			m_historyNext = (m_historyNext + 1) % HISTORY;
+			m_historyCount = std::min(m_historyCount + 1, HISTORY);
+			updateStats();
+		}
+		m_lastSwap = now;
+		m_swapped = true;
+	}
+
+	/**
+		getModeName returns a mode's name for printing.
+
+			@param1 a_mode is the mode.
+	*/
+	const char* FramePacer::getModeName(PresentMode a_mode)
+	{
+		switch (a_mode)
+		{
+		case PresentMode::VSYNC: return "vsync";
+		case PresentMode::ADAPTIVE: return "adaptive vsync";
+		case PresentMode::UNCAPPED: return "uncapped";
+		case PresentMode::CAPPED: return "capped";
+		}
+		return "unknown";
+	}
+
+	/**
+		updateStats works out the statistics from the history.
+	*/
+	void FramePacer::updateStats()
+	{
+		double periodMilliseconds = getPeriodMilliseconds();
+
+		double total = 0.0;
+		m_stats.worstMilliseconds = 0.0;
+		m_stats.missed = 0;
+		for (unsigned int i = 0; i < m_historyCount; ++i)
+		{
+			total += m_history[i];
+			m_stats.worstMilliseconds = std::max(m_stats.worstMilliseconds, m_history[i]);
+			if (periodMilliseconds > 0.0 && m_history[i] > periodMilliseconds * 1.5)
+				++m_stats.missed;
+		}
+		m_stats.averageMilliseconds = total / m_historyCount;
+
+		double variance = 0.0;
+		for (unsigned int i = 0; i < m_historyCount; ++i)
+		{
+			double difference = m_history[i] - m_stats.averageMilliseconds;
+			variance += difference * difference;
+		}
+		m_stats.jitterMilliseconds = std::sqrt(variance / m_historyCount);
+	}
+}
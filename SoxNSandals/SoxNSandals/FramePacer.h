@@ -0,0 +1,151 @@
+/**
+	FramePacer.h
+
+	Purpose: FramePacer.h is the header file for the FramePacer class.
+			The FramePacer picks how frames are presented, with vsync,
+			adaptive vsync, uncapped or capped to a rate, and keeps
+			statistics on how evenly they are.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "soxCore.h"
+
+namespace sns
+{
+	/**
+		How frames are presented.
+	*/
+	enum class PresentMode
+	{
+		// Swaps wait for the monitor's refresh.
+		VSYNC,
+
+		// Swaps wait for the refresh unless the frame is already late,
+		//	then tear instead of waiting a whole refresh more. Falls
+		//	back to VSYNC where the driver can't.
+		ADAPTIVE,
+
+		// Swaps never wait, for benchmarks.
+		UNCAPPED,
+
+		// Swaps never wait, frames are held to a rate by the pacer.
+		CAPPED
+	};
+
+	/**
+		The FramePacer class sets the swap interval for a present mode
+			and, when capped, waits out the rest of each frame before
+			the swap. It sleeps while there is time enough to, then
+			spins the last part, since a sleep can wake well after it
+			was asked to. How late sleeps wake is measured as it goes,
+			so it spins only as long as it has to.
+
+		Either way it records the time between swaps over the last
+			HISTORY frames, their average, how far they stray from it,
+			the longest, and how many were late enough to have missed
+			a refresh or the capped rate.
+	*/
+	class FramePacer
+	{
+	public:
+		// How many frames the statistics are over.
+		static const unsigned int HISTORY = 120;
+
+		/**
+			How evenly frames have been presented, in milliseconds.
+		*/
+		struct Stats
+		{
+			double averageMilliseconds;
+
+			// The standard deviation of the frame times.
+			double jitterMilliseconds;
+			double worstMilliseconds;
+
+			// Frames that took more than half as long again as they
+			//	should have.
+			unsigned int missed;
+		};
+
+		FramePacer();
+
+		/**
+			setMode sets the swap interval of the current context, and
+				the rate a capped mode holds frames to.
+
+				@param1 a_mode is how frames are presented.
+
+				@param2 a_rate is the frames per second CAPPED holds to.
+		*/
+		void setMode(PresentMode a_mode, double a_rate = 60.0);
+
+		/**
+			getMode returns the mode frames are presented with, VSYNC
+				when ADAPTIVE was asked for and isn't supported.
+		*/
+		PresentMode getMode() const { return m_mode; }
+
+		/**
+			getPeriodMilliseconds returns how long a frame should take,
+				in milliseconds, 0 when uncapped.
+		*/
+		double getPeriodMilliseconds() const { return m_period.count() * NANO_TO_SECONDS * 1000.0; }
+
+		/**
+			wait waits until the frame should be swapped when capped,
+				and returns straight away otherwise. Call it just
+				before swapping.
+		*/
+		void wait();
+
+		/**
+			endFrame records how long it has been since the last swap.
+				Call it just after swapping.
+		*/
+		void endFrame();
+
+		/**
+			skipFrame leaves the frame being drawn out of the stats, for
+				one that waited on purpose. Call it before swapping.
+		*/
+		void skipFrame() { m_swapped = false; }
+
+		/**
+			getStats returns the statistics of the last HISTORY frames.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+		/**
+			getModeName returns a mode's name for printing.
+
+				@param1 a_mode is the mode.
+		*/
+		static const char* getModeName(PresentMode a_mode);
+
+	private:
+		// Works out m_stats from the history.
+		void updateStats();
+
+		PresentMode m_mode;
+
+		// How long a frame should take, 0 when uncapped.
+		nanoseconds m_period;
+
+		// When the frame being drawn should be swapped, when capped.
+		sns::time m_deadline;
+
+		// How late sleeps wake, as a running average and variance.
+		double m_sleepLateMean;
+		double m_sleepLateVariance;
+
+		// The times between the last HISTORY swaps, in milliseconds.
+		double m_history[HISTORY];
+		unsigned int m_historyCount;
+		unsigned int m_historyNext;
+		sns::time m_lastSwap;
+		bool m_swapped;
+
+		Stats m_stats;
+	};
+}
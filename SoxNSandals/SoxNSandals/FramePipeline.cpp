@@ -0,0 +1,122 @@
+/**
+	FramePipeline.cpp
+
+	Purpose: FramePipeline.cpp is the source file for the FramePipeline
+			class. The FramePipeline simulates the next frame on its own
+			thread while the current one is drawn, handing each frame
+			over as a packet the drawing side only reads.
+
+	@author Nathan Nette
+*/
+#include "FramePipeline.h"
+#include "Profiler.h"
+
+namespace sns
+{
+	/**
+		The deconstructor stops the simulation thread.
+	*/
+	FramePipeline::~FramePipeline()
+	{
+		stop();
+	}
+
+	/**
+		start creates the simulation thread and starts simulating the
+			first frame.
+
+			@param1 a_simulate fills in a packet from its input. It runs
+					on the simulation thread, so it must not touch opengl.
+
+			@param2 a_input is what the first frame starts from.
+	*/
+	void FramePipeline::start(const SimulateFunction& a_simulate, const FrameInput& a_input)
+	{
+		if (isRunning())
+			return;
+
+		m_simulate = a_simulate;
+		m_simulating = 0;
+		m_packets[0].number = 1;
+		m_packets[0].input = a_input;
+		m_packets[0].arena = &m_arenas.getWriting();
+		m_pending = true;
+		m_stopping = false;
+		m_thread = std::thread(&FramePipeline::run, this);
+	}
+
+	/**
+		advance waits for the frame being simulated, then starts
+			simulating the one after it.
+
+			@param1 a_input is what the next frame starts from.
+
+			@return the frame to draw, valid until the next advance.
+	*/
+	const FramePacket& FramePipeline::advance(const FrameInput& a_input)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneCondition.wait(lock, [this]() { return m_pending == false; });
+
+		// The finished packet is drawn, the one drawn last frame is free,
+		//	and so is its arena.
+		unsigned int drawing = m_simulating;
+		m_simulating = 1 - m_simulating;
+		m_arenaHighWatermark = m_arenas.getHighWatermark();
+		m_arenas.flip();
+
+		FramePacket& next = m_packets[m_simulating];
+		next.number = m_packets[drawing].number + 1;
+		next.input = a_input;
+		next.arena = &m_arenas.getWriting();
+
+		m_pending = true;
+		m_startCondition.notify_one();
+		return m_packets[drawing];
+	}
+
+	/**
+		stop waits for the frame being simulated, then ends the
+			simulation thread.
+	*/
+	void FramePipeline::stop()
+	{
+		if (isRunning() == false)
+			return;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_doneCondition.wait(lock, [this]() { return m_pending == false; });
+			m_stopping = true;
+		}
+		m_startCondition.notify_one();
+		m_thread.join();
+	}
+
+	/**
+		run is the simulation thread. It simulates each packet advance
+			hands it, until stop is called.
+	*/
+	void FramePipeline::run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_startCondition.wait(lock, [this]() { return m_pending || m_stopping; });
+			if (m_stopping)
+				return;
+
+			// Only this thread touches the packet until m_pending is cleared.
+			FramePacket& packet = m_packets[m_simulating];
+			lock.unlock();
+			{
+				SNS_PROFILE_SCOPE("Simulate");
+				m_simulate(packet);
+			}
+			lock.lock();
+
+			m_pending = false;
+			m_doneCondition.notify_all();
+		}
+	}
+}
@@ -0,0 +1,151 @@
+/**
+	FramePipeline.h
+
+	Purpose: FramePipeline.h is the header file for the FramePipeline
+			class. The FramePipeline simulates the next frame on its own
+			thread while the current one is drawn, handing each frame
+			over as a packet the drawing side only reads.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "FrameArena.h"
+#include "ParticleSystem.h"
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace sns
+{
+	/**
+		What the simulation of a frame starts from, captured on the main
+			thread when the frame is handed to the simulation thread.
+	*/
+	struct FrameInput
+	{
+		// How long the frame before it took, in seconds.
+		double deltaTime = 0.0;
+
+		glm::mat4 view = glm::mat4(1);
+		glm::mat4 projection = glm::mat4(1);
+		glm::mat4 projectionView = glm::mat4(1);
+		glm::vec3 cameraPosition = glm::vec3(0);
+
+		// What the simulation culls against, the projection view, or
+		//	with several views one that holds all of them.
+		glm::mat4 cullProjectionView = glm::mat4(1);
+
+		// The planes the projection was made with. A reversed projection
+		//	has no far plane, but this is still how far lights are
+		//	clustered and shadowed out to.
+		float nearPlane = 0.1f;
+		float farPlane = 1000.0f;
+	};
+
+	/**
+		Everything one frame is drawn from. The simulation thread fills
+			it in, then it is only read until the frame is drawn.
+	*/
+	struct FramePacket
+	{
+		unsigned long long number = 0;
+		FrameInput input;
+
+		// Where the simulation allocates what the frame is drawn from.
+		//	It is reset when the packet is simulated again, so nothing
+		//	in it needs freeing.
+		FrameArena* arena = nullptr;
+
+		ParticleSystem::Snapshot particles;
+	};
+
+	/**
+		The FramePipeline class keeps two packets, one being drawn and
+			one being simulated. advance waits for the simulated one,
+			swaps them over and starts simulating the next, so the
+			simulation of frame N + 1 overlaps the drawing of frame N.
+
+		Each packet has its half of a DoubleFrameArena, flipped along
+			with the packets.
+	*/
+	class FramePipeline
+	{
+	public:
+		typedef std::function<void(FramePacket&)> SimulateFunction;
+
+		// The size of each packet's arena to start with. It grows to
+		//	fit the largest frame if it has to.
+		static const size_t ARENA_CAPACITY = 4 * 1024 * 1024;
+
+		FramePipeline() = default;
+
+		/**
+			The deconstructor stops the simulation thread.
+		*/
+		~FramePipeline();
+
+		FramePipeline(const FramePipeline&) = delete;
+		FramePipeline& operator=(const FramePipeline&) = delete;
+
+		/**
+			start creates the simulation thread and starts simulating the
+				first frame.
+
+				@param1 a_simulate fills in a packet from its input. It
+						runs on the simulation thread, so it must not
+						touch opengl.
+
+				@param2 a_input is what the first frame starts from.
+		*/
+		void start(const SimulateFunction& a_simulate, const FrameInput& a_input);
+
+		/**
+			advance waits for the frame being simulated, then starts
+				simulating the one after it.
+
+				@param1 a_input is what the next frame starts from.
+
+				@return the frame to draw, valid until the next advance.
+		*/
+		const FramePacket& advance(const FrameInput& a_input);
+
+		/**
+			stop waits for the frame being simulated, then ends the
+				simulation thread.
+		*/
+		void stop();
+
+		/**
+			isRunning returns whether start has been called without stop.
+		*/
+		bool isRunning() const { return m_thread.joinable(); }
+
+		/**
+			getArenaHighWatermark returns the most any frame has allocated
+				from its arena, as of the last advance.
+		*/
+		size_t getArenaHighWatermark() const { return m_arenaHighWatermark; }
+
+	private:
+		// The simulation thread, simulating a packet whenever one is given.
+		void run();
+
+		SimulateFunction m_simulate;
+		std::thread m_thread;
+
+		FramePacket m_packets[2];
+		DoubleFrameArena m_arenas{ ARENA_CAPACITY };
+		size_t m_arenaHighWatermark = 0;
+
+		// The packet being simulated, the other is being drawn.
+		unsigned int m_simulating = 0;
+
+		std::mutex m_mutex;
+		std::condition_variable m_startCondition;
+		std::condition_variable m_doneCondition;
+		bool m_pending = false;
+		bool m_stopping = false;
+	};
+}
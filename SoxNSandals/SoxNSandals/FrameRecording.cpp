@@ -0,0 +1,148 @@
+/**
+	FrameRecording.cpp
+
+	Purpose: FrameRecording.cpp is the source file for the FrameRecording
+			class. The FrameRecording is a log of what each frame of a
+			session was run with, so the benchmark can run the same
+			frames again.
+
+	@author Nathan Nette
+*/
+#include "FrameRecording.h"
+#include "Lz4.h"
+#include <cstdio>
+
+namespace sns
+{
+	/**
+		begin clears the recording and starts it from a start.
+
+			@param1 a_start is what the simulation was set back to.
+	*/
+	void FrameRecording::begin(const Start& a_start)
+	{
+		m_start = a_start;
+		m_frames.clear();
+	}
+
+	/**
+		addFrame adds a frame to the end. The camera's transform is only
+			rotation and translation, so it's kept as a quaternion and a
+			position rather than 16 floats.
+
+			@param1 a_deltaTime is the frame's update time step.
+
+			@param2 a_cameraTransform is the camera's world transform.
+
+			@param3 a_settings is the frame's render settings.
+	*/
+	void FrameRecording::addFrame(double a_deltaTime, const glm::mat4& a_cameraTransform, uint32_t a_settings)
+	{
+		Frame frame;
+		frame.deltaTime = a_deltaTime;
+		frame.position = glm::vec3(a_cameraTransform[3]);
+		frame.rotation = glm::quat_cast(glm::mat3(a_cameraTransform));
+		frame.settings = a_settings;
+		m_frames.push_back(frame);
+	}
+
+	/**
+		getCameraTransform returns a frame's camera as a world transform.
+
+			@param1 a_index is the frame, from 0.
+	*/
+	glm::mat4 FrameRecording::getCameraTransform(unsigned int a_index) const
+	{
+		const Frame& frame = m_frames[a_index];
+		glm::mat4 transform = glm::mat4_cast(frame.rotation);
+		transform[3] = glm::vec4(frame.position, 1);
+		return transform;
+	}
+
+	/**
+		write writes the recording to a file.
+
+			@param1 a_filename is the file to write.
+
+			@return false if the file couldn't be written.
+	*/
+	bool FrameRecording::write(const char* a_filename) const
+	{
+		std::vector<unsigned char> compressed;
+		Lz4::compress((const unsigned char*)m_frames.data(), m_frames.size() * sizeof(Frame), compressed);
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_filename, "wb");
+		if (file == nullptr)
+		{
+			printf("Failed to write recording %s\n", a_filename);
+			return false;
+		}
+
+		Header header = { MAGIC, VERSION, (uint32_t)m_start.emitterSeeds.size(), (uint32_t)m_start.orbitAngles.size(),
+			(uint32_t)m_start.bodyStates.size(), (uint32_t)m_frames.size(), (uint32_t)compressed.size() };
+		bool written = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+			fwrite(m_start.emitterSeeds.data(), sizeof(uint32_t), m_start.emitterSeeds.size(), file) == m_start.emitterSeeds.size() &&
+			fwrite(m_start.orbitAngles.data(), sizeof(float), m_start.orbitAngles.size(), file) == m_start.orbitAngles.size() &&
+			fwrite(m_start.bodyStates.data(), sizeof(float), m_start.bodyStates.size(), file) == m_start.bodyStates.size() &&
+			fwrite(compressed.data(), 1, compressed.size(), file) == compressed.size();
+		fclose(file);
+
+		if (written == false)
+		{
+			printf("Failed to write recording %s\n", a_filename);
+			return false;
+		}
+		printf("Recorded %u frames to %s, %.1f KB\n", getFrameCount(), a_filename,
+			(sizeof(Header) + compressed.size()) / 1024.0);
+		return true;
+	}
+
+	/**
+		load reads a recording written by write.
+
+			@param1 a_filename is the file to read.
+
+			@return false if the file couldn't be read or isn't a
+					recording of this version.
+	*/
+	bool FrameRecording::load(const char* a_filename)
+	{
+		FILE* file = nullptr;
+		fopen_s(&file, a_filename, "rb");
+		if (file == nullptr)
+		{
+			printf("Failed to read recording %s\n", a_filename);
+			return false;
+		}
+
+		Header header = {};
+		bool read = fread(&header, sizeof(Header), 1, file) == 1 &&
+			header.magic == MAGIC && header.version == VERSION;
+
+		std::vector<unsigned char> compressed;
+		if (read)
+		{
+			m_start.emitterSeeds.resize(header.emitterCount);
+			m_start.orbitAngles.resize(header.orbitCount);
+			m_start.bodyStates.resize(header.bodyStateCount);
+			m_frames.resize(header.frameCount);
+			compressed.resize(header.compressedSize);
+			read = fread(m_start.emitterSeeds.data(), sizeof(uint32_t), header.emitterCount, file) == header.emitterCount &&
+				fread(m_start.orbitAngles.data(), sizeof(float), header.orbitCount, file) == header.orbitCount &&
+				fread(m_start.bodyStates.data(), sizeof(float), header.bodyStateCount, file) == header.bodyStateCount &&
+				fread(compressed.data(), 1, compressed.size(), file) == compressed.size() &&
+				(header.frameCount == 0 || Lz4::decompress(compressed.data(), compressed.size(),
+					(unsigned char*)m_frames.data(), m_frames.size() * sizeof(Frame)));
+		}
+		fclose(file);
+
+		if (read == false)
+		{
+			printf("%s isn't a version %u recording\n", a_filename, VERSION);
+			begin(Start());
+			return false;
+		}
+		return true;
+	}
+}
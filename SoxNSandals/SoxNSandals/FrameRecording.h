@@ -0,0 +1,163 @@
+/**
+	FrameRecording.h
+
+	Purpose: FrameRecording.h is the header file for the FrameRecording
+			class. The FrameRecording is a log of what each frame of a
+			session was run with, so the benchmark can run the same
+			frames again.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The FrameRecording class keeps the start of a session, the seed of
+			every particle emitter, the angle of every orbit and the state
+			of every gravity body, and then per frame the time step,
+			where the camera was and the render settings. Everything
+			else a frame does follows from those, so a replay from the
+			same start draws the same frames.
+
+		The file is a small header, the start, then every frame compressed
+			as one LZ4 block. Frames are fixed size and change little from
+			one to the next, so a session packs down well.
+	*/
+	class FrameRecording
+	{
+	public:
+		static const unsigned int MAGIC = 0x52534e53; // "SNSR"
+		static const unsigned int VERSION = 2;
+
+		// The render settings a frame was drawn with, as Frame::settings.
+		static const uint32_t DEFERRED = 1 << 0;
+		static const uint32_t DEPTH_PREPASS = 1 << 1;
+		static const uint32_t TEMPORAL_UPSAMPLING = 1 << 2;
+		static const uint32_t AMBIENT_OCCLUSION = 1 << 3;
+		static const uint32_t PARTICLE_DIVISOR_SHIFT = 4;
+
+		// The anti-aliasing mode is a field of its own above the
+		//	divisor, and each field is FIELD_MASK wide.
+		static const uint32_t ANTI_ALIASING_SHIFT = 8;
+		static const uint32_t FIELD_MASK = 0xf;
+
+		// Whether the bloom was on, above the anti-aliasing.
+		static const uint32_t BLOOM = 1 << 12;
+
+		/**
+			What one frame was run with.
+		*/
+		struct Frame
+		{
+			// The update's delta time, kept as the double it was.
+			double deltaTime;
+
+			// The camera's world transform, without scale.
+			glm::vec3 position;
+			glm::quat rotation;
+
+			// DEFERRED, DEPTH_PREPASS, TEMPORAL_UPSAMPLING,
+			//	AMBIENT_OCCLUSION and BLOOM, with the particle divisor
+			//	over PARTICLE_DIVISOR_SHIFT and the anti-aliasing over
+			//	ANTI_ALIASING_SHIFT.
+			uint32_t settings;
+		};
+
+		/**
+			What the simulation was set back to when the recording started.
+		*/
+		struct Start
+		{
+			std::vector<uint32_t> emitterSeeds;
+			std::vector<float> orbitAngles;
+
+			// Every gravity body's position and velocity, see
+			//	GravitySimulation::getState.
+			std::vector<float> bodyStates;
+		};
+
+		/**
+			begin clears the recording and starts it from a start.
+
+				@param1 a_start is what the simulation was set back to.
+		*/
+		void begin(const Start& a_start);
+
+		/**
+			addFrame adds a frame to the end.
+
+				@param1 a_deltaTime is the frame's update time step.
+
+				@param2 a_cameraTransform is the camera's world transform.
+
+				@param3 a_settings is the frame's render settings.
+		*/
+		void addFrame(double a_deltaTime, const glm::mat4& a_cameraTransform, uint32_t a_settings);
+
+		/**
+			write writes the recording to a file.
+
+				@param1 a_filename is the file to write.
+
+				@return false if the file couldn't be written.
+		*/
+		bool write(const char* a_filename) const;
+
+		/**
+			load reads a recording written by write.
+
+				@param1 a_filename is the file to read.
+
+				@return false if the file couldn't be read or isn't a
+						recording of this version.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			getStart returns what the simulation is set back to first.
+		*/
+		const Start& getStart() const { return m_start; }
+
+		/**
+			getFrameCount returns how many frames were recorded.
+		*/
+		unsigned int getFrameCount() const { return (unsigned int)m_frames.size(); }
+
+		/**
+			getFrame returns a recorded frame.
+
+				@param1 a_index is the frame, from 0.
+		*/
+		const Frame& getFrame(unsigned int a_index) const { return m_frames[a_index]; }
+
+		/**
+			getCameraTransform returns a frame's camera as a world transform.
+
+				@param1 a_index is the frame, from 0.
+		*/
+		glm::mat4 getCameraTransform(unsigned int a_index) const;
+
+	private:
+		/**
+			The start of the file, before the seeds and angles.
+		*/
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t emitterCount;
+			uint32_t orbitCount;
+			uint32_t bodyStateCount;
+			uint32_t frameCount;
+			uint32_t compressedSize;
+		};
+
+		Start m_start;
+		std::vector<Frame> m_frames;
+	};
+}
@@ -0,0 +1,59 @@
+/**
+	FrameReuse.cpp
+
+	Purpose: FrameReuse.cpp is the source file for the FrameReuse class.
+			The FrameReuse class tells when a frame would draw exactly
+			what the last one did, so the last one can be shown again
+			instead, which on a still display saves nearly all of the
+			gpu's work and power.
+
+	@author Nathan Nette
+*/
+#include "FrameReuse.h"
+
+namespace sns
+{
+	FrameReuse::FrameReuse()
+		: m_key(), m_valid(false), m_enabled(true), m_stats()
+	{
+	}
+
+	/**
+		setEnabled switches reuse on or off.
+
+			@param1 a_enabled is whether frames can be reused.
+	*/
+	void FrameReuse::setEnabled(bool a_enabled)
+	{
+		m_enabled = a_enabled;
+		m_valid = false;
+	}
+
+	/**
+		canReuse returns whether a frame would draw the same as the last
+			drawn frame. The matrices are compared exactly, a camera
+			that hasn't moved makes the same ones every frame.
+
+			@param1 a_key is what the frame is drawn from.
+	*/
+	bool FrameReuse::canReuse(const Key& a_key)
+	{
+		bool same = m_enabled && m_valid && a_key.view == m_key.view && a_key.projection == m_key.projection &&
+			a_key.target == m_key.target && a_key.settings == m_key.settings;
+		if (same)
+			++m_stats.reused;
+		return same;
+	}
+
+	/**
+		drawn keeps what a frame was drawn from, once it is drawn.
+
+			@param1 a_key is what it was drawn from.
+	*/
+	void FrameReuse::drawn(const Key& a_key)
+	{
+		m_key = a_key;
+		m_valid = true;
+		++m_stats.drawn;
+	}
+}
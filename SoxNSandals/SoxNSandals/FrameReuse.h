@@ -0,0 +1,97 @@
+/**
+	FrameReuse.h
+
+	Purpose: FrameReuse.h is the header file for the FrameReuse class.
+			The FrameReuse class tells when a frame would draw exactly
+			what the last one did, so the last one can be shown again
+			instead, which on a still display saves nearly all of the
+			gpu's work and power.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace sns
+{
+	/**
+		The FrameReuse class keeps what the last drawn frame was drawn
+			from, the camera, the target and the settings, as a Key.
+			A frame with the same key can be reused, unless something
+			in the scene changed since, which whatever changed it says
+			with invalidate, as with the shadow cascades' cache.
+	*/
+	class FrameReuse
+	{
+	public:
+		/**
+			What a frame is drawn from that isn't the scene.
+		*/
+		struct Key
+		{
+			glm::mat4 view;
+			glm::mat4 projection;
+
+			// The window's width and height, the scale the scene is
+			//	drawn at and how many views it is drawn from.
+			glm::vec4 target;
+
+			// The settings the keys switch, as FrameRecording settings.
+			uint32_t settings;
+		};
+
+		/**
+			How many frames were drawn and reused since the start.
+		*/
+		struct Stats
+		{
+			unsigned int drawn;
+			unsigned int reused;
+		};
+
+		FrameReuse();
+
+		/**
+			setEnabled switches reuse on or off. Off, every frame is
+				drawn.
+
+				@param1 a_enabled is whether frames can be reused.
+		*/
+		void setEnabled(bool a_enabled);
+
+		/**
+			isEnabled returns whether frames can be reused.
+		*/
+		bool isEnabled() const { return m_enabled; }
+
+		/**
+			canReuse returns whether a frame would draw the same as the
+				last drawn frame, and counts it as reused if so.
+
+				@param1 a_key is what the frame is drawn from.
+		*/
+		bool canReuse(const Key& a_key);
+
+		/**
+			drawn keeps what a frame was drawn from, once it is drawn.
+
+				@param1 a_key is what it was drawn from.
+		*/
+		void drawn(const Key& a_key);
+
+		/**
+			invalidate makes the next frame be drawn, for when the scene
+				has changed.
+		*/
+		void invalidate() { m_valid = false; }
+
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		Key m_key;
+		bool m_valid;
+		bool m_enabled;
+		Stats m_stats;
+	};
+}
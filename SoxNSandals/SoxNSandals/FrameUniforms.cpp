@@ -0,0 +1,110 @@
+/**
+	FrameUniforms.cpp
+
+	Purpose: FrameUniforms.cpp is the source file for the FrameUniforms
+			class. The FrameUniforms class owns the std140 uniform buffer
+			holding the camera and lights for the frame.
+
+	@author Nathan Nette
+*/
+#include "FrameUniforms.h"
+#include "GpuMemory.h"
+#include "gl_core_4_5.h"
+#include "Shader.h"
+#include "UniformBlock.h"
+
+namespace sns
+{
+	// Data is copied into the block as is, so each member must be where
+	//	frameData.glsl's std140 layout puts it.
+	SNS_STD140_MEMBER(FrameUniforms::Data, projection, 0);
+	SNS_STD140_MEMBER(FrameUniforms::Data, view, 64);
+	SNS_STD140_MEMBER(FrameUniforms::Data, projectionView, 128);
+	SNS_STD140_MEMBER(FrameUniforms::Data, cameraPosition, 192);
+	SNS_STD140_MEMBER(FrameUniforms::Data, lights, 208);
+	SNS_STD140_MEMBER(FrameUniforms::Data, clusterScale, 336);
+	SNS_STD140_MEMBER(FrameUniforms::Data, clusterCount, 352);
+	SNS_STD140_MEMBER(FrameUniforms::Data, shadowMatrices, 368);
+	SNS_STD140_MEMBER(FrameUniforms::Data, shadowSplits, 624);
+	SNS_STD140_MEMBER(FrameUniforms::Data, shadowParameters, 640);
+	SNS_STD140_MEMBER(FrameUniforms::Data, viewOrigin, 656);
+	SNS_STD140_MEMBER(FrameUniforms::Data, occlusionParameters, 672);
+	SNS_STD140_MEMBER(FrameUniforms::Data, fogParameters, 688);
+	SNS_BLOCK_SIZE(FrameUniforms::Data, 704);
+
+	const char* const FrameUniforms::BLOCK_NAME = "FrameData";
+
+	/**
+		The constructor registers the block's binding point.
+	*/
+	FrameUniforms::FrameUniforms() : m_buffer(0)
+	{
+		aie::ShaderProgram::setUniformBlockBinding(BLOCK_NAME, BINDING);
+	}
+
+	/**
+		The deconstructor deletes the buffer.
+	*/
+	FrameUniforms::~FrameUniforms()
+	{
+		if (m_buffer != 0)
+		{
+			glDeleteBuffers(1, &m_buffer);
+			GpuMemory::instance().releaseBuffer(m_buffer);
+		}
+	}
+
+	/**
+		create makes the buffer.
+	*/
+	void FrameUniforms::create()
+	{
+		if (m_buffer != 0)
+			return;
+
+		glCreateBuffers(1, &m_buffer);
+		glNamedBufferStorage(m_buffer, sizeof(Data), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		GpuMemory::instance().trackBuffer(m_buffer, sizeof(Data), GpuMemory::UNIFORMS, "FrameUniforms");
+		glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_buffer);
+	}
+
+	/**
+		update writes the frame's data and binds the buffer.
+
+			@param1 a_data is this frame's camera and lights.
+	*/
+	void FrameUniforms::update(const Data& a_data)
+	{
+		glNamedBufferSubData(m_buffer, 0, sizeof(Data), &a_data);
+		glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_buffer);
+	}
+
+	/**
+		getBlockSource returns the GLSL declaration of the block.
+	*/
+	const char* FrameUniforms::getBlockSource()
+	{
+		return
+			"struct FrameLight {\n"
+			"	vec4 Ia;\n"
+			"	vec4 Id;\n"
+			"	vec4 Is;\n"
+			"	vec4 LightDirection;\n"
+			"};\n"
+			"layout(std140) uniform FrameData {\n"
+			"	mat4 Projection;\n"
+			"	mat4 View;\n"
+			"	mat4 ProjectionView;\n"
+			"	vec4 CameraPosition;\n"
+			"	FrameLight Lights[2];\n"
+			"	vec4 ClusterScale;\n"
+			"	vec4 ClusterCount;\n"
+			"	mat4 ShadowMatrices[4];\n"
+			"	vec4 ShadowSplits;\n"
+			"	vec4 ShadowParameters;\n"
+			"	vec4 ViewOrigin;\n"
+			"	vec4 OcclusionParameters;\n"
+			"	vec4 FogParameters;\n"
+			"};\n";
+	}
+}
@@ -0,0 +1,125 @@
+/**
+	FrameUniforms.h
+
+	Purpose: FrameUniforms.h is the header file for the FrameUniforms class.
+			The FrameUniforms class owns a std140 uniform buffer holding
+			the camera and lights for the frame. It is written once a
+			frame and bound to a fixed binding point that every shader
+			program shares, instead of each program being sent the same
+			values as loose uniforms.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace sns
+{
+	/**
+		The FrameUniforms class wraps the per-frame uniform buffer.
+			Shaders read it by declaring the block returned by
+			getBlockSource. Programs are bound to it when they link.
+	*/
+	class FrameUniforms
+	{
+	public:
+		// The binding point the buffer is always bound to.
+		static const unsigned int BINDING = 0;
+
+		// The name of the uniform block in GLSL.
+		static const char* const BLOCK_NAME;
+
+		// The amount of lights in the block.
+		static const unsigned int MAX_LIGHTS = 2;
+
+		// The amount of shadow cascades in the block, as many as
+		//	ShadowCascades has.
+		static const unsigned int MAX_CASCADES = 4;
+
+		/**
+			A light as laid out in the block. Everything is a vec4 so
+				the std140 layout matches the C++ one without padding.
+		*/
+		struct Light
+		{
+			glm::vec4 ambient;
+			glm::vec4 diffuse;
+			glm::vec4 specular;
+			glm::vec4 direction;
+		};
+
+		/**
+			The contents of the block, in std140 layout.
+		*/
+		struct Data
+		{
+			glm::mat4 projection;
+			glm::mat4 view;
+			glm::mat4 projectionView;
+			glm::vec4 cameraPosition;
+			Light lights[MAX_LIGHTS];
+
+			// What LightClusters::getScale and getCount return, so the
+			//	fragment shaders can find their cluster.
+			glm::vec4 clusterScale;
+			glm::vec4 clusterCount;
+
+			// What ShadowCascades::getMatrix, getSplits and getParameters
+			//	return, so the fragment shaders can find their shadow.
+			glm::mat4 shadowMatrices[MAX_CASCADES];
+			glm::vec4 shadowSplits;
+			glm::vec4 shadowParameters;
+
+			// The window pixel the view's viewport starts at, so the
+			//	fragment shaders find their cluster in the view.
+			glm::vec4 viewOrigin;
+
+			// What AmbientOcclusion::getParameters returns, or 0 without
+			//	occlusion this frame.
+			glm::vec4 occlusionParameters;
+
+			// What VolumetricFog::getParameters returns, so the fragment
+			//	shaders can find their froxel.
+			glm::vec4 fogParameters;
+		};
+
+		/**
+			The constructor registers the block's binding point with
+				ShaderProgram, so it must exist before programs link.
+		*/
+		FrameUniforms();
+
+		/**
+			The deconstructor deletes the buffer.
+		*/
+		~FrameUniforms();
+
+		FrameUniforms(const FrameUniforms&) = delete;
+		FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+		/**
+			create makes the buffer. Must be called once a GL context exists.
+		*/
+		void create();
+
+		/**
+			update writes the frame's data in a single call and binds the
+				buffer to its binding point.
+
+				@param1 a_data is this frame's camera and lights.
+		*/
+		void update(const Data& a_data);
+
+		/**
+			getBlockSource returns the GLSL declaration of the block so
+				shaders can be written against it.
+		*/
+		static const char* getBlockSource();
+
+	private:
+
+		// The GL handle of the uniform buffer.
+		unsigned int m_buffer;
+	};
+}
@@ -0,0 +1,197 @@
+/**
+	Frustum.cpp
+
+	Purpose: Frustum.cpp is the source file for the Frustum class.
+			The Frustum class holds the six planes of a camera's view
+			and tests bounding boxes against them.
+
+	@author Nathan Nette
+*/
+#include "Frustum.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace sns
+{
+	Frustum::Stats Frustum::s_stats = {};
+
+	/**
+		add appends a box.
+
+			@param1 a_min is the smallest corner.
+
+			@param2 a_max is the largest corner.
+	*/
+	void BoxList::add(const glm::vec3& a_min, const glm::vec3& a_max)
+	{
+		glm::vec3 centre = (a_min + a_max) * 0.5f;
+		glm::vec3 extent = (a_max - a_min) * 0.5f;
+		centreX.push_back(centre.x);
+		centreY.push_back(centre.y);
+		centreZ.push_back(centre.z);
+		extentX.push_back(extent.x);
+		extentY.push_back(extent.y);
+		extentZ.push_back(extent.z);
+	}
+
+	/**
+		clear removes every box.
+	*/
+	void BoxList::clear()
+	{
+		centreX.clear();
+		centreY.clear();
+		centreZ.clear();
+		extentX.clear();
+		extentY.clear();
+		extentZ.clear();
+	}
+
+	/**
+		The constructor makes a frustum that contains everything.
+	*/
+	Frustum::Frustum()
+	{
+		for (auto& plane : m_planes)
+			plane = glm::vec4(0, 0, 0, 1);
+	}
+
+	/**
+		Constructor that extracts the planes from a matrix.
+
+			@param1 a_projectionView is the combined matrix.
+	*/
+	Frustum::Frustum(const glm::mat4& a_projectionView)
+	{
+		setMatrix(a_projectionView);
+	}
+
+	/**
+		setMatrix extracts the planes from a matrix. Each plane is a sum
+			or difference of the matrix's last row and one of the others,
+			which works for any GL style -w to w clip space.
+
+			@param1 a_projectionView is the combined matrix.
+	*/
+	void Frustum::setMatrix(const glm::mat4& a_projectionView)
+	{
+		// glm is column major, so pull the rows out first.
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; ++r)
+			rows[r] = glm::vec4(a_projectionView[0][r], a_projectionView[1][r],
+				a_projectionView[2][r], a_projectionView[3][r]);
+
+		m_planes[0] = rows[3] + rows[0];
+		m_planes[1] = rows[3] - rows[0];
+		m_planes[2] = rows[3] + rows[1];
+		m_planes[3] = rows[3] - rows[1];
+		m_planes[4] = rows[3] + rows[2];
+		m_planes[5] = rows[3] - rows[2];
+
+		// Normalise so distances are in world units.
+		for (auto& plane : m_planes)
+		{
+			float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			if (length > 0.0f)
+				plane /= length;
+		}
+	}
+
+	/**
+		isBoxVisible tests a single box.
+
+			@param1 a_centre is the centre of the box.
+
+			@param2 a_extent is half the size of the box.
+
+			@return false if the box is completely outside a plane.
+	*/
+	bool Frustum::isBoxVisible(const glm::vec3& a_centre, const glm::vec3& a_extent) const
+	{
+		for (auto& plane : m_planes)
+		{
+			// The distance of the centre, plus how far the box reaches
+			//	towards the plane.
+			float distance = plane.x * a_centre.x + plane.y * a_centre.y + plane.z * a_centre.z + plane.w;
+			float radius = fabsf(plane.x) * a_extent.x + fabsf(plane.y) * a_extent.y + fabsf(plane.z) * a_extent.z;
+			if (distance + radius < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	/**
+		cull tests every box in a list.
+
+			@param1 a_boxes is the list of boxes.
+
+			@param2 a_visible is set to 1 for visible boxes and 0 for
+					culled ones.
+
+			@return the amount of visible boxes.
+	*/
+	unsigned int Frustum::cull(const BoxList& a_boxes, std::vector<unsigned char>& a_visible) const
+	{
+		size_t count = a_boxes.size();
+		a_visible.resize(count);
+		unsigned int visibleCount = 0;
+		size_t i = 0;
+
+#ifdef SNS_FRUSTUM_SSE
+		// Four boxes against each plane at a time.
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&a_boxes.centreX[i]);
+			__m128 cy = _mm_loadu_ps(&a_boxes.centreY[i]);
+			__m128 cz = _mm_loadu_ps(&a_boxes.centreZ[i]);
+			__m128 ex = _mm_loadu_ps(&a_boxes.extentX[i]);
+			__m128 ey = _mm_loadu_ps(&a_boxes.extentY[i]);
+			__m128 ez = _mm_loadu_ps(&a_boxes.extentZ[i]);
+
+			__m128 outside = _mm_setzero_ps();
+			for (auto& plane : m_planes)
+			{
+				__m128 px = _mm_set1_ps(plane.x);
+				__m128 py = _mm_set1_ps(plane.y);
+				__m128 pz = _mm_set1_ps(plane.z);
+
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+					_mm_add_ps(_mm_mul_ps(pz, cz), _mm_set1_ps(plane.w)));
+				__m128 radius = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_andnot_ps(signMask, px), ex),
+					_mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+					_mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+
+			int mask = _mm_movemask_ps(outside);
+			for (int b = 0; b < 4; ++b)
+			{
+				unsigned char visible = (mask & (1 << b)) == 0 ? 1 : 0;
+				a_visible[i + b] = visible;
+				visibleCount += visible;
+			}
+		}
+#endif
+
+		// Whatever is left over, or everything without SSE.
+		for (; i < count; ++i)
+		{
+			bool visible = isBoxVisible(
+				glm::vec3(a_boxes.centreX[i], a_boxes.centreY[i], a_boxes.centreZ[i]),
+				glm::vec3(a_boxes.extentX[i], a_boxes.extentY[i], a_boxes.extentZ[i]));
+			a_visible[i] = visible ? 1 : 0;
+			visibleCount += visible ? 1 : 0;
+		}
+
+		s_stats.visible += visibleCount;
+		s_stats.culled += (unsigned int)count - visibleCount;
+		return visibleCount;
+	}
+}
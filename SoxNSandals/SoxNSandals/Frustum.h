@@ -0,0 +1,135 @@
+/**
+	Frustum.h
+
+	Purpose: Frustum.h is the header file for the Frustum class.
+			The Frustum class holds the six planes of a camera's view
+			and tests bounding boxes against them, so anything outside
+			the view can be skipped before it is drawn.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		A list of axis aligned boxes stored as structure of arrays, so
+			four boxes can be tested against a plane at once.
+	*/
+	struct BoxList
+	{
+		std::vector<float> centreX, centreY, centreZ;
+		std::vector<float> extentX, extentY, extentZ;
+
+		/**
+			add appends a box.
+
+				@param1 a_min is the smallest corner.
+
+				@param2 a_max is the largest corner.
+		*/
+		void add(const glm::vec3& a_min, const glm::vec3& a_max);
+
+		/**
+			clear removes every box.
+		*/
+		void clear();
+
+		/**
+			size returns the amount of boxes.
+		*/
+		size_t size() const { return centreX.size(); }
+	};
+
+	/**
+		The Frustum class tests boxes against the planes of a view.
+	*/
+	class Frustum
+	{
+	public:
+		/**
+			Counts of the boxes tested, across every frustum, since the
+				last resetStats.
+		*/
+		struct Stats
+		{
+			unsigned int visible;
+			unsigned int culled;
+		};
+
+		/**
+			The constructor makes a frustum that contains everything.
+		*/
+		Frustum();
+
+		/**
+			Constructor that extracts the planes from a matrix.
+
+				@param1 a_projectionView is the camera's projection view.
+						Passing a projection view model instead gives
+						planes in that model's local space.
+		*/
+		Frustum(const glm::mat4& a_projectionView);
+
+		/**
+			setMatrix extracts the planes from a matrix.
+
+				@param1 a_projectionView is the combined matrix.
+		*/
+		void setMatrix(const glm::mat4& a_projectionView);
+
+		/**
+			isBoxVisible tests a single box.
+
+				@param1 a_centre is the centre of the box.
+
+				@param2 a_extent is half the size of the box.
+
+				@return false if the box is completely outside a plane.
+		*/
+		bool isBoxVisible(const glm::vec3& a_centre, const glm::vec3& a_extent) const;
+
+		/**
+			cull tests every box in a list. This uses SSE to test four
+				boxes at a time when it is available.
+
+				@param1 a_boxes is the list of boxes.
+
+				@param2 a_visible is resized to the amount of boxes and set
+						to 1 for visible boxes and 0 for culled ones.
+
+				@return the amount of visible boxes.
+		*/
+		unsigned int cull(const BoxList& a_boxes, std::vector<unsigned char>& a_visible) const;
+
+		/**
+			getPlane returns one of the planes. The xyz is the normal
+				pointing inwards and w is the distance.
+
+				@param1 a_index is left, right, bottom, top, near then far.
+		*/
+		const glm::vec4& getPlane(unsigned int a_index) const { return m_planes[a_index]; }
+
+		/**
+			getStats returns the visible and culled counts.
+		*/
+		static const Stats& getStats() { return s_stats; }
+
+		/**
+			resetStats sets the counts back to zero, usually once a frame.
+		*/
+		static void resetStats() { s_stats = {}; }
+
+	private:
+
+		// Left, right, bottom, top, near and far.
+		glm::vec4 m_planes[6];
+
+		// Counts across every frustum.
+		static Stats s_stats;
+	};
+}
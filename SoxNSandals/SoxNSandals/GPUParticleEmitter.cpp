@@ -0,0 +1,489 @@
+/**
+	GPUParticleEmitter.cpp
+
+	Purpose: GPUParticleEmitter.cpp is the source file for the
+			GPUParticleEmitter class. The GPU Particle Emitter runs the
+			particle simulation in a compute shader, so the particles
+			never leave video memory.
+
+	@author Nathan Nette
+*/
+#include "GPUParticleEmitter.h"
+#include "GpuMemory.h"
+#include "ParticleTarget.h"
+#include "RenderState.h"
+#include "SurfaceSampler.h"
+#include "TrailRenderer.h"
+#include "VectorField.h"
+#include <algorithm>
+
+// Must match local_size_x in the compute shader.
+static const unsigned int GROUP_SIZE = 256;
+
+// The buffer bindings the compute shader reads and writes.
+static const unsigned int PARTICLE_BINDING = 0;
+static const unsigned int INSTANCE_BINDING = 1;
+static const unsigned int COMMAND_BINDING = 2;
+static const unsigned int KEY_BINDING = 3;
+static const unsigned int SURFACE_BINDING = 5;
+
+// The scene's depth is read from the unit the particle target reads it
+//	from.
+static const unsigned int DEPTH_UNIT = sns::ParticleTarget::SCENE_DEPTH_UNIT;
+
+// The vector field is read from a unit nothing else binds.
+static const unsigned int FIELD_UNIT = 13;
+
+/**
+	The draw command as glDrawArraysIndirect reads it, plus the
+		counter the compute shader uses to limit how many spawn.
+*/
+struct ParticleDrawCommand
+{
+	unsigned int vertexCount;
+	unsigned int instanceCount;
+	unsigned int firstVertex;
+	unsigned int baseInstance;
+	unsigned int spawned;
+};
+
+/**
+	The GPU Particle Emitter constructor assigns the values to 0
+		as default.
+*/
+GPUParticleEmitter::GPUParticleEmitter()
+	: m_keyBuffer(0),
+	m_sortCapacity(0),
+	m_particleBuffer(0),
+	m_instanceBuffer(0),
+	m_commandBuffer(0),
+	m_collisionDepth(0),
+	m_collisionProjectionView(1),
+	m_collisionDepthSize(0),
+	m_bounce(0.3f),
+	m_friction(0.2f),
+	m_thickness(1.0f),
+	m_trails(nullptr),
+	m_trailInterval(0),
+	m_trailTimer(0),
+	m_trailTime(0),
+	m_frame(0),
+	m_useCompute(false)
+{
+}
+
+/**
+	The GPU Particle Emitter deconstructor deletes the buffers
+		the compute shader works on.
+*/
+GPUParticleEmitter::~GPUParticleEmitter()
+{
+	glDeleteBuffers(1, &m_particleBuffer);
+	sns::RenderState::instance().onBufferDeleted(m_particleBuffer);
+	glDeleteBuffers(1, &m_instanceBuffer);
+	sns::RenderState::instance().onBufferDeleted(m_instanceBuffer);
+	glDeleteBuffers(1, &m_commandBuffer);
+	sns::RenderState::instance().onBufferDeleted(m_commandBuffer);
+	glDeleteBuffers(1, &m_keyBuffer);
+	sns::RenderState::instance().onBufferDeleted(m_keyBuffer);
+
+	sns::GpuMemory& memory = sns::GpuMemory::instance();
+	memory.releaseBuffer(m_particleBuffer);
+	memory.releaseBuffer(m_instanceBuffer);
+	memory.releaseBuffer(m_commandBuffer);
+	memory.releaseBuffer(m_keyBuffer);
+}
+
+/**
+	createBuffers loads the compute shader and makes the buffers
+		it works on. If GL 4.3 or the shader isn't available it
+		makes the cpu buffers instead.
+*/
+void GPUParticleEmitter::createBuffers()
+{
+	m_useCompute = false;
+	if (ogl_IsVersionGEQ(4, 3) == 0)
+	{
+		printf("Compute shaders need GL 4.3, simulating particles on the cpu.\n");
+		ParticleEmitter::createBuffers();
+		return;
+	}
+
+	m_updateShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/particleUpdate.comp");
+	if (m_updateShader.link() == false)
+	{
+		printf("Shader Error: %s\n", m_updateShader.getLastError());
+		ParticleEmitter::createBuffers();
+		return;
+	}
+	m_useCompute = true;
+
+	// Every particle starts zeroed, which the shader treats as dead.
+	glGenBuffers(1, &m_particleBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_particleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_maxParticles * 2 * sizeof(glm::vec4),
+		nullptr, GL_DYNAMIC_COPY);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+
+	glGenBuffers(1, &m_commandBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ParticleDrawCommand), nullptr, GL_DYNAMIC_DRAW);
+
+	// Sorting is optional, so the emitter still runs without the shader.
+	//	The bitonic sort needs a power of two of instances to work on.
+	m_sortShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/particleSort.comp");
+	if (m_sortShader.link())
+	{
+		m_sortCapacity = 1;
+		while (m_sortCapacity < m_maxParticles)
+			m_sortCapacity *= 2;
+
+		glGenBuffers(1, &m_keyBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_keyBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_sortCapacity * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+	}
+	else
+	{
+		printf("Shader Error: %s\n", m_sortShader.getLastError());
+		m_sortCapacity = 0;
+	}
+
+	// The instances are only ever written by the compute shaders.
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(m_maxParticles, m_sortCapacity) * sizeof(ParticleInstance),
+		nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	sns::GpuMemory& memory = sns::GpuMemory::instance();
+	memory.trackBuffer(m_particleBuffer, m_maxParticles * 2 * sizeof(glm::vec4), sns::GpuMemory::PARTICLES, "GPUParticleEmitter");
+	memory.trackBuffer(m_commandBuffer, sizeof(ParticleDrawCommand), sns::GpuMemory::PARTICLES, "GPUParticleEmitter");
+	memory.trackBuffer(m_keyBuffer, m_sortCapacity * sizeof(float), sns::GpuMemory::PARTICLES, "GPUParticleEmitter");
+	memory.trackBuffer(m_instanceBuffer, std::max(m_maxParticles, m_sortCapacity) * sizeof(ParticleInstance),
+		sns::GpuMemory::PARTICLES, "GPUParticleEmitter");
+
+	m_vao.reset(createVertexArray(m_instanceBuffer));
+}
+
+/**
+	update dispatches the compute shader that simulates every
+		particle and packs the live ones for the particle shader.
+
+		@param1 a_deltaTime is the time since the last update.
+*/
+void GPUParticleEmitter::update(float a_deltaTime)
+{
+	if (m_useCompute == false)
+	{
+		ParticleEmitter::update(a_deltaTime);
+		return;
+	}
+
+	static constexpr aie::UniformHandle MAX_PARTICLES("MaxParticles");
+	static constexpr aie::UniformHandle LIVE_LIMIT("LiveLimit");
+	static constexpr aie::UniformHandle SPAWN_COUNT("SpawnCount");
+	static constexpr aie::UniformHandle SEED("Seed");
+	static constexpr aie::UniformHandle DELTA_TIME("DeltaTime");
+	static constexpr aie::UniformHandle EMITTER_POSITION("EmitterPosition");
+	static constexpr aie::UniformHandle LIFESPAN("Lifespan");
+	static constexpr aie::UniformHandle VELOCITY("Velocity");
+	static constexpr aie::UniformHandle SIZE("Size");
+	static constexpr aie::UniformHandle START_COLOUR("StartColour");
+	static constexpr aie::UniformHandle END_COLOUR("EndColour");
+	static constexpr aie::UniformHandle COLLIDE("Collide");
+	static constexpr aie::UniformHandle SCENE_DEPTH("SceneDepth");
+	static constexpr aie::UniformHandle DEPTH_PROJECTION_VIEW("DepthProjectionView");
+	static constexpr aie::UniformHandle DEPTH_INVERSE_PROJECTION_VIEW("DepthInverseProjectionView");
+	static constexpr aie::UniformHandle DEPTH_SIZE("DepthSize");
+	static constexpr aie::UniformHandle COLLISION_RESPONSE("CollisionResponse");
+	static constexpr aie::UniformHandle GRAVITY("Gravity");
+	static constexpr aie::UniformHandle DRAG("Drag");
+	static constexpr aie::UniformHandle ATTRACTOR_COUNT("AttractorCount");
+	static constexpr aie::UniformHandle ATTRACTORS("Attractors");
+	static constexpr aie::UniformHandle CURL("Curl");
+	static constexpr aie::UniformHandle CURL_ROTATIONS("CurlRotations");
+	static constexpr aie::UniformHandle FORCE_TIME("ForceTime");
+	static constexpr aie::UniformHandle USE_FIELD("UseField");
+	static constexpr aie::UniformHandle VECTOR_FIELD("VectorField");
+	static constexpr aie::UniformHandle FIELD_MIN("FieldMin");
+	static constexpr aie::UniformHandle FIELD_MAX("FieldMax");
+	static constexpr aie::UniformHandle FIELD_STRENGTH("FieldStrength");
+	static constexpr aie::UniformHandle TRAIL_COUNT("TrailCount");
+	static constexpr aie::UniformHandle TRAIL_FIRST("TrailFirst");
+	static constexpr aie::UniformHandle SURFACE_COUNT("SurfaceCount");
+	static constexpr aie::UniformHandle SURFACE_TRANSFORM("SurfaceTransform");
+	static constexpr aie::UniformHandle SURFACE_NORMALS("SurfaceNormals");
+
+	// Work out how many particles the emit rate allows this frame,
+	//	the shader hands them out to dead particles.
+	m_emitTimer += a_deltaTime * m_emitScale;
+	int spawnCount = 0;
+	while (m_emitTimer > m_emitRate)
+	{
+		++spawnCount;
+		m_emitTimer -= m_emitRate;
+	}
+
+	// Reset the draw command, the shader adds an instance per live particle.
+	ParticleDrawCommand command = { 4, 0, 0, 0, 0 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(command), &command);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_updateShader.bind();
+	m_updateShader.bindUniform(MAX_PARTICLES, (int)m_maxParticles);
+	m_updateShader.bindUniform(LIVE_LIMIT, (int)m_liveLimit);
+	m_updateShader.bindUniform(SPAWN_COUNT, spawnCount);
+	m_updateShader.bindUniform(SEED, (int)((m_frame++ * 2654435761u) ^ (m_seed * 0x85ebca6bu)));
+	m_updateShader.bindUniform(DELTA_TIME, a_deltaTime);
+	m_updateShader.bindUniform(EMITTER_POSITION, m_position);
+	m_updateShader.bindUniform(LIFESPAN, glm::vec2(m_lifespanMin, m_lifespanMax));
+	m_updateShader.bindUniform(VELOCITY, glm::vec2(m_velocityMin, m_velocityMax));
+	m_updateShader.bindUniform(SIZE, glm::vec2(m_startSize, m_endSize));
+	m_updateShader.bindUniform(START_COLOUR, m_startColour);
+	m_updateShader.bindUniform(END_COLOUR, m_endColour);
+
+	bool collide = m_collisionDepth != 0;
+	m_updateShader.bindUniform(COLLIDE, collide ? 1 : 0);
+	if (collide)
+	{
+		sns::RenderState::instance().bindTexture(DEPTH_UNIT, m_collisionDepth);
+		m_updateShader.bindUniform(SCENE_DEPTH, (int)DEPTH_UNIT);
+		m_updateShader.bindUniform(DEPTH_PROJECTION_VIEW, m_collisionProjectionView);
+		m_updateShader.bindUniform(DEPTH_INVERSE_PROJECTION_VIEW, glm::inverse(m_collisionProjectionView));
+		m_updateShader.bindUniform(DEPTH_SIZE, glm::vec2(m_collisionDepthSize));
+		m_updateShader.bindUniform(COLLISION_RESPONSE, glm::vec3(m_bounce, m_friction, m_thickness));
+	}
+
+	// The same forces the cpu particles are pushed by. Each attractor
+	//	is its position and strength, then its radius.
+	if (m_forces.isActive())
+		m_forceTime += a_deltaTime;
+	m_updateShader.bindUniform(GRAVITY, m_forces.gravity);
+	m_updateShader.bindUniform(DRAG, m_forces.drag);
+	m_updateShader.bindUniform(ATTRACTOR_COUNT, (int)m_forces.attractorCount);
+	if (m_forces.attractorCount > 0)
+	{
+		glm::vec4 attractors[sns::ParticleForces::MAX_ATTRACTORS * 2];
+		for (unsigned int i = 0; i < m_forces.attractorCount; ++i)
+		{
+			const sns::ParticleForces::Attractor& attractor = m_forces.attractors[i];
+			attractors[i * 2] = glm::vec4(attractor.position, attractor.strength);
+			attractors[i * 2 + 1] = glm::vec4(attractor.radius, 0, 0, 0);
+		}
+		m_updateShader.bindUniform(ATTRACTORS, (int)m_forces.attractorCount * 2, attractors);
+	}
+	m_updateShader.bindUniform(CURL, glm::vec3(m_forces.curlStrength, m_forces.curlScale, m_forces.curlSpeed));
+	if (m_forces.curlStrength != 0.0f)
+	{
+		glm::mat3 rotations[sns::ParticleForces::CURL_OCTAVES];
+		for (unsigned int i = 0; i < sns::ParticleForces::CURL_OCTAVES; ++i)
+			rotations[i] = sns::ParticleForces::getCurlRotation(i);
+		m_updateShader.bindUniform(CURL_ROTATIONS, (int)sns::ParticleForces::CURL_OCTAVES, rotations);
+		m_updateShader.bindUniform(FORCE_TIME, m_forceTime);
+	}
+
+	const sns::VectorField* field = m_forces.field;
+	bool useField = field != nullptr && field->getTexture() != 0 && m_forces.fieldStrength != 0.0f;
+	m_updateShader.bindUniform(USE_FIELD, useField ? 1 : 0);
+	if (useField)
+	{
+		sns::RenderState::instance().bindTexture(FIELD_UNIT, field->getTexture());
+		m_updateShader.bindUniform(VECTOR_FIELD, (int)FIELD_UNIT);
+		m_updateShader.bindUniform(FIELD_MIN, field->getMin());
+		m_updateShader.bindUniform(FIELD_MAX, field->getMax());
+		m_updateShader.bindUniform(FIELD_STRENGTH, m_forces.fieldStrength);
+	}
+
+	// Each particle writes its point into the trails' next slot, or the
+	//	front one again between intervals.
+	bool trails = m_trails != nullptr && m_trails->isCreated();
+	m_updateShader.bindUniform(TRAIL_COUNT, trails ? (int)std::min(m_trails->getMaxTrails(), m_maxParticles) : 0);
+	if (trails)
+	{
+		m_trailTime += a_deltaTime;
+		m_trailTimer += a_deltaTime;
+		bool advance = m_trailTimer >= m_trailInterval;
+		if (advance)
+			m_trailTimer = 0;
+		m_updateShader.bindUniform(TRAIL_FIRST, (int)m_trails->beginRecord(m_trailTime, advance));
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, sns::TrailRenderer::POINT_BINDING, m_trails->getBuffer());
+	}
+
+	// The surface's alias table, sampled as the cpu samples it. A
+	//	surface not uploaded yet spawns at the position until it is.
+	bool surface = m_surface != nullptr && m_surface->getBuffer() != 0;
+	m_updateShader.bindUniform(SURFACE_COUNT, surface ? (int)m_surface->getTriangleCount() : 0);
+	if (surface)
+	{
+		m_updateShader.bindUniform(SURFACE_TRANSFORM, m_surfaceTransform);
+		m_updateShader.bindUniform(SURFACE_NORMALS, m_surfaceNormals);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SURFACE_BINDING, m_surface->getBuffer());
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_BINDING, m_particleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, m_instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_commandBuffer);
+
+	glDispatchCompute((m_maxParticles + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+	// The next update resets the command buffer from the cpu, and the
+	//	shader's writes have to land before that.
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	if (m_sortBudget > 0 && m_sortCapacity > 0 && m_sortCapacity <= m_sortBudget)
+		sort();
+}
+
+/**
+	setCollision makes the updates collide the particles with the scene
+		in a depth buffer. The depth is read the frame after it is
+		drawn, with the matrices it was drawn with.
+
+		@param1 a_depthTexture is the scene's depth, or 0 to stop
+				colliding.
+
+		@param2 a_projectionView takes the emitter's space to the clip
+				space the depth was drawn in.
+
+		@param3 a_depthSize is the part of the texture the depth was
+				drawn into, in texels from its bottom left.
+*/
+void GPUParticleEmitter::setCollision(unsigned int a_depthTexture, const glm::mat4& a_projectionView,
+	const glm::ivec2& a_depthSize)
+{
+	m_collisionDepth = a_depthTexture;
+	m_collisionProjectionView = a_projectionView;
+	m_collisionDepthSize = a_depthSize;
+}
+
+/**
+	setCollisionResponse changes how particles come off what they hit.
+
+		@param1 a_bounce is how much of the speed into the surface is
+				kept going out of it, 0 to 1.
+
+		@param2 a_friction is how much of the speed along the surface is
+				lost, 0 to 1.
+
+		@param3 a_thickness is how far behind the surface a particle can
+				be and still hit it.
+*/
+void GPUParticleEmitter::setCollisionResponse(float a_bounce, float a_friction, float a_thickness)
+{
+	m_bounce = glm::clamp(a_bounce, 0.0f, 1.0f);
+	m_friction = glm::clamp(a_friction, 0.0f, 1.0f);
+	m_thickness = std::max(a_thickness, 0.0f);
+}
+
+/**
+	setTrails makes the updates record where each particle is into a
+		TrailRenderer's ring buffer. A dead particle records no trail,
+		and one spawned into its slot starts a new one.
+
+		@param1 a_trails are the trails, or nullptr to stop recording.
+
+		@param2 a_interval is how long between new points.
+*/
+void GPUParticleEmitter::setTrails(sns::TrailRenderer* a_trails, float a_interval)
+{
+	m_trails = a_trails;
+	m_trailInterval = std::max(a_interval, 0.0f);
+	m_trailTimer = 0;
+	if (m_trails != nullptr)
+		m_trails->clear();
+}
+
+/**
+	prewarm dispatches the compute shader in large steps, one after
+		another. Nothing is read back, so the cpu only records the
+		dispatches and the gpu works through them behind the frame.
+		The sort and the trails are only wanted for what is drawn, and
+		are left out until it is done.
+
+		@param1 a_duration is how long to run it for.
+
+		@param2 a_timeStep is the longest step to take.
+*/
+void GPUParticleEmitter::prewarm(float a_duration, float a_timeStep)
+{
+	if (m_useCompute == false)
+	{
+		ParticleEmitter::prewarm(a_duration, a_timeStep);
+		return;
+	}
+	if (a_duration <= 0.0f || a_timeStep <= 0.0f)
+		return;
+
+	unsigned int sortBudget = m_sortBudget;
+	sns::TrailRenderer* trails = m_trails;
+	m_sortBudget = 0;
+	m_trails = nullptr;
+
+	unsigned int stepCount = (unsigned int)glm::ceil(a_duration / a_timeStep);
+	float timeStep = a_duration / stepCount;
+	for (unsigned int step = 0; step < stepCount; ++step)
+		update(timeStep);
+
+	m_sortBudget = sortBudget;
+	m_trails = trails;
+}
+
+/**
+	sort bitonic sorts the instances the update packed, furthest
+		from the sort position first, one dispatch per step.
+*/
+void GPUParticleEmitter::sort()
+{
+	static constexpr aie::UniformHandle SORT_COUNT("SortCount");
+	static constexpr aie::UniformHandle STAGE("Stage");
+	static constexpr aie::UniformHandle STEP("Step");
+	static constexpr aie::UniformHandle SORT_POSITION("SortPosition");
+
+	m_sortShader.bind();
+	m_sortShader.bindUniform(SORT_COUNT, (int)m_sortCapacity);
+	m_sortShader.bindUniform(SORT_POSITION, m_sortPosition);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, m_instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEY_BINDING, m_keyBuffer);
+
+	// Every dispatch reads what the one before it wrote. Step 0 works
+	//	out the keys, the rest compare and swap pairs a step apart.
+	unsigned int groups = (m_sortCapacity + GROUP_SIZE - 1) / GROUP_SIZE;
+	m_sortShader.bindUniform(STAGE, 0);
+	m_sortShader.bindUniform(STEP, 0);
+	glDispatchCompute(groups, 1, 1);
+	for (unsigned int stage = 2; stage <= m_sortCapacity; stage *= 2)
+	{
+		m_sortShader.bindUniform(STAGE, (int)stage);
+		for (unsigned int step = stage / 2; step > 0; step /= 2)
+		{
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			m_sortShader.bindUniform(STEP, (int)step);
+			glDispatchCompute(groups, 1, 1);
+		}
+	}
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/**
+	draw waits for the compute shader to finish and draws however
+		many particles it packed.
+*/
+void GPUParticleEmitter::draw()
+{
+	if (m_useCompute == false)
+	{
+		ParticleEmitter::draw();
+		return;
+	}
+
+	// The instances are read as vertex attributes and the instance
+	//	count as a draw command.
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	bindVertexArray(m_vao, m_instanceBuffer);
+	sns::RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	sns::RenderState::instance().countDraw();
+	glDrawArraysIndirect(GL_TRIANGLE_STRIP, nullptr);
+}
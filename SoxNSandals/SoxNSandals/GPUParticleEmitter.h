@@ -0,0 +1,182 @@
+/**
+	GPUParticleEmitter.h
+
+	Purpose: GPUParticleEmitter.h is the header file for the
+			GPUParticleEmitter class. The GPU Particle Emitter runs the
+			particle simulation in a compute shader, so the particles
+			never leave video memory.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "ParticleEmitter.h"
+
+namespace sns
+{
+	class TrailRenderer;
+}
+
+/**
+	The GPU Particle Emitter spawns, moves and kills its particles in a
+		compute shader and draws them with a draw command the shader
+		writes itself. It is set up with the same initialise as the
+		Particle Emitter, and falls back to it when compute shaders
+		aren't available.
+*/
+class GPUParticleEmitter : public ParticleEmitter
+{
+public:
+	/**
+		The GPU Particle Emitter constructor assigns the values to 0
+			as default.
+	*/
+	GPUParticleEmitter();
+
+	/**
+		The GPU Particle Emitter deconstructor deletes the buffers
+			the compute shader works on.
+	*/
+	virtual ~GPUParticleEmitter();
+
+	/**
+		update dispatches the compute shader that simulates every
+			particle and packs the live ones for the particle shader.
+
+			@param1 a_deltaTime is the time since the last update.
+	*/
+	virtual void update(float a_deltaTime) override;
+
+	/**
+		prewarm dispatches the compute shader in large steps, without
+			sorting, recording trails or drawing.
+
+			@param1 a_duration is how long to run it for.
+
+			@param2 a_timeStep is the longest step to take.
+	*/
+	virtual void prewarm(float a_duration, float a_timeStep = PREWARM_TIME_STEP) override;
+
+	/**
+		draw waits for the compute shader to finish and draws however
+			many particles it packed.
+	*/
+	virtual void draw() override;
+
+	/**
+		isUsingCompute returns false if the emitter fell back to
+			simulating on the cpu.
+	*/
+	bool isUsingCompute() const { return m_useCompute; }
+
+	/**
+		setCollision makes the updates collide the particles with the
+			scene in a depth buffer, such as the depth pre-pass. Each
+			particle is projected into it, and one that has gone
+			behind the surface there, by less than the thickness, is
+			put back on it and bounced off the normal rebuilt from the
+			depths around it. Only what the view sees is collided with.
+
+			@param1 a_depthTexture is the scene's depth, or 0 to stop
+					colliding.
+
+			@param2 a_projectionView takes the emitter's space to the
+					clip space the depth was drawn in.
+
+			@param3 a_depthSize is the part of the texture the depth was
+					drawn into, in texels from its bottom left.
+	*/
+	void setCollision(unsigned int a_depthTexture, const glm::mat4& a_projectionView, const glm::ivec2& a_depthSize);
+
+	/**
+		setCollisionResponse changes how particles come off what they hit.
+
+			@param1 a_bounce is how much of the speed into the surface is
+					kept going out of it, 0 to 1.
+
+			@param2 a_friction is how much of the speed along the surface
+					is lost, 0 to 1. With no bounce and full friction the
+					particles stick where they hit.
+
+			@param3 a_thickness is how far behind the surface a particle
+					can be and still hit it, in the emitter's units.
+					Those further behind are taken to be behind the
+					surface, not in it.
+	*/
+	void setCollisionResponse(float a_bounce, float a_friction, float a_thickness);
+
+	/**
+		setTrails makes the updates record where each particle is into a
+			TrailRenderer's ring buffer, so it draws a ribbon behind
+			every one. A particle keeps its slot in the buffer all its
+			life, so its trail does too, and trails past
+			getMaxParticles are left empty.
+
+			@param1 a_trails are the trails, not owned, or nullptr to
+					stop recording.
+
+			@param2 a_interval is how long between new points, the
+					updates between move the front point.
+	*/
+	void setTrails(sns::TrailRenderer* a_trails, float a_interval);
+
+protected:
+	/**
+		createBuffers loads the compute shader and makes the buffers
+			it works on. If GL 4.3 or the shader isn't available it
+			makes the cpu buffers instead.
+	*/
+	virtual void createBuffers() override;
+
+	/**
+		sort bitonic sorts the instances the update packed, furthest
+			from the sort position first, one dispatch per step.
+	*/
+	void sort();
+
+	// The compute shader that updates the particles.
+	aie::ShaderProgram m_updateShader;
+
+	// The compute shader that sorts the instances.
+	aie::ShaderProgram m_sortShader;
+
+	// The distance of each instance being sorted, or -1 for slots
+	//	past the live ones.
+	unsigned int m_keyBuffer;
+
+	// m_maxParticles rounded up to a power of two, how many instances
+	//	the bitonic sort works on. 0 if the sort shader didn't load.
+	unsigned int m_sortCapacity;
+
+	// The buffer holding every particle, dead or alive.
+	unsigned int m_particleBuffer;
+
+	// The buffer holding the live particles' instances, written by the
+	//	compute shader.
+	unsigned int m_instanceBuffer;
+
+	// The buffer holding the draw command, written by the compute shader.
+	unsigned int m_commandBuffer;
+
+	// The depth the particles collide with, 0 for none, what takes them
+	//	into it, and how much of it was drawn into.
+	unsigned int m_collisionDepth;
+	glm::mat4 m_collisionProjectionView;
+	glm::ivec2 m_collisionDepthSize;
+
+	float m_bounce;
+	float m_friction;
+	float m_thickness;
+
+	// The trails the particles are recorded into, how long between new
+	//	points and how long since the last, then the updates' clock.
+	sns::TrailRenderer* m_trails;
+	float m_trailInterval;
+	float m_trailTimer;
+	float m_trailTime;
+
+	// Counts the updates, so each one spawns with a different seed.
+	unsigned int m_frame;
+
+	// Whether the compute shader is running the particles.
+	bool m_useCompute;
+};
@@ -1,29 +1,168 @@
 #include "Gizmos.h"
 #include "gl_core_4_5.h"
+#include "GpuMemory.h"
+#include "Primitives.h"
+#include "RadixSort.h"
+#include "RenderState.h"
+#include "Trace.h"
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <vector>
 
 namespace aie {
 
 Gizmos* Gizmos::sm_singleton = nullptr;
+unsigned int Gizmos::sm_generation = 0;
+
+constexpr sns::VertexLayout Gizmos::VERTEX_LAYOUT;
+constexpr sns::VertexLayout Gizmos::INSTANCE_LAYOUT;
+
+// points a vertex array at the attributes of a stream, used again whenever a stream grows
+static void bindStreamAttributes(unsigned int vao, unsigned int buffer, const sns::VertexLayout& layout,
+								 unsigned int divisor) {
+	sns::RenderState::instance().bindVertexArray(vao);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, buffer);
+	sns::setVertexAttributes(layout, 0, divisor);
+	sns::RenderState::instance().bindVertexArray(0);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+template <typename Vertex>
+static void setVertex(Vertex& vertex, float x, float y, float z, const glm::vec4& colour) {
+	vertex.x = x;
+	vertex.y = y;
+	vertex.z = z;
+	vertex.w = 1;
+	vertex.r = colour.r;
+	vertex.g = colour.g;
+	vertex.b = colour.b;
+	vertex.a = colour.a;
+}
+
+// compiles and links a gizmo shader, attributes are bound to locations in order,
+// a nullptr leaves a location unbound
+static unsigned int createGizmoProgram(const char* vsSource, const char* fsSource,
+									   const char* const* attributes, unsigned int attributeCount) {
+	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vs, 1, (const char**)&vsSource, 0);
+	glCompileShader(vs);
+
+	glShaderSource(fs, 1, (const char**)&fsSource, 0);
+	glCompileShader(fs);
+
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	for (unsigned int i = 0; i < attributeCount; ++i) {
+		if (attributes[i] != nullptr)
+			glBindAttribLocation(program, i, attributes[i]);
+	}
+	glLinkProgram(program);
+
+	int success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE) {
+		int infoLogLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+		char* infoLog = new char[infoLogLength + 1];
+
+		glGetProgramInfoLog(program, infoLogLength, 0, infoLog);
+		printf("Error: Failed to link Gizmo shader program!\n%s\n", infoLog);
+		delete[] infoLog;
+	}
+
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+	return program;
+}
+
+struct PrimitiveVertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+};
+
+static constexpr sns::VertexLayout PRIMITIVE_LAYOUT = sns::makeVertexLayout<PrimitiveVertex>(
+	SNS_VERTEX_ATTRIBUTE(PrimitiveVertex, position, 0, FLOAT3),
+	SNS_VERTEX_ATTRIBUTE(PrimitiveVertex, normal, 1, FLOAT3));
+static_assert(sns::isValidLayout(PRIMITIVE_LAYOUT), "PrimitiveVertex layout is invalid");
+
+static void addPrimitiveTri(std::vector<PrimitiveVertex>& vertices,
+							const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+							const glm::vec3& n0, const glm::vec3& n1, const glm::vec3& n2) {
+	vertices.push_back({ v0, n0 });
+	vertices.push_back({ v1, n1 });
+	vertices.push_back({ v2, n2 });
+}
+
+// appends one of sns::Primitives' indexed shapes as the plain triangles
+// the instanced draws take
+static void addIndexedPrimitive(std::vector<PrimitiveVertex>& vertices,
+								const std::vector<Mesh::Vertex>& meshVertices,
+								const std::vector<unsigned int>& indices) {
+	for (unsigned int i : indices)
+		vertices.push_back({ glm::vec3(meshVertices[i].position), glm::vec3(meshVertices[i].normal) });
+}
+
+// builds the unit sphere, cylinder, box and disk as counter-clockwise triangles,
+// the sphere and disk have a radius of 1 and the cylinder and box reach from -1 to 1.
+// all but the disk are sns::Primitives' shapes at the same sizes
+static void buildPrimitives(std::vector<PrimitiveVertex>& vertices,
+							unsigned int* first, unsigned int* count) {
+	const unsigned int rows = 16, columns = 24, segments = 24;
+	const float pi = glm::pi<float>();
+	std::vector<Mesh::Vertex> meshVertices;
+	std::vector<unsigned int> indices;
+
+	// sphere
+	first[0] = (unsigned int)vertices.size();
+	sns::Primitives::buildSphere(rows, columns, meshVertices, indices);
+	addIndexedPrimitive(vertices, meshVertices, indices);
+	count[0] = (unsigned int)vertices.size() - first[0];
+
+	// cylinder
+	first[1] = (unsigned int)vertices.size();
+	sns::Primitives::buildCylinder(segments, meshVertices, indices);
+	addIndexedPrimitive(vertices, meshVertices, indices);
+	count[1] = (unsigned int)vertices.size() - first[1];
+
+	// box
+	first[2] = (unsigned int)vertices.size();
+	sns::Primitives::buildBox(meshVertices, indices);
+	addIndexedPrimitive(vertices, meshVertices, indices);
+	count[2] = (unsigned int)vertices.size() - first[2];
+
+	// disk, double-sided in the XZ axis
+	first[3] = (unsigned int)vertices.size();
+	glm::vec3 centre(0), up(0, 1, 0);
+	for (unsigned int i = 0; i < segments; ++i) {
+		float a0 = 2 * pi * i / segments;
+		float a1 = 2 * pi * (i + 1) / segments;
+		glm::vec3 p0(sinf(a0), 0, cosf(a0));
+		glm::vec3 p1(sinf(a1), 0, cosf(a1));
+
+		addPrimitiveTri(vertices, centre, p0, p1, up, up, up);
+		addPrimitiveTri(vertices, centre, p1, p0, -up, -up, -up);
+	}
+	count[3] = (unsigned int)vertices.size() - first[3];
+}
 
 Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
-			   unsigned int max2DLines, unsigned int max2DTris)
+			   unsigned int max2DLines, unsigned int max2DTris,
+			   unsigned int maxInstances)
 	: m_maxLines(maxLines),
-	m_lineCount(0),
-	m_lines(new GizmoLine[maxLines]),
 	m_maxTris(maxTris),
-	m_triCount(0),
-	m_tris(new GizmoTri[maxTris]),
-	m_transparentTriCount(0),
-	m_transparentTris(new GizmoTri[maxTris]),
+	m_maxTransparentTris(maxTris),
 	m_max2DLines(max2DLines),
-	m_2DlineCount(0),
-	m_2Dlines(new GizmoLine[max2DLines]),
 	m_max2DTris(max2DTris),
-	m_2DtriCount(0),
-	m_2Dtris(new GizmoTri[max2DTris]) {
+	m_maxInstances(maxInstances),
+	m_instancesWritten(false),
+	m_generation(++sm_generation),
+	m_overflowCount(0) {
 
 	// create shaders
 	const char* vsSource = "#version 150\n \
@@ -39,125 +178,81 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 					 void main()	{ FragColor = vColour; }";
     
     
-	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
-	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+	const char* attributes[] = { "Position", "Colour" };
+	m_shader = createGizmoProgram(vsSource, fsSource, attributes, 2);
+	m_projectionViewUniform = glGetUniformLocation(m_shader, "ProjectionView");
 
-	glShaderSource(vs, 1, (const char**)&vsSource, 0);
-	glCompileShader(vs);
-
-	glShaderSource(fs, 1, (const char**)&fsSource, 0);
-	glCompileShader(fs);
-
-	m_shader = glCreateProgram();
-	glAttachShader(m_shader, vs);
-	glAttachShader(m_shader, fs);
-	glBindAttribLocation(m_shader, 0, "Position");
-	glBindAttribLocation(m_shader, 1, "Colour");
-	glLinkProgram(m_shader);
-    
-	int success = GL_FALSE;
-    glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-		char* infoLog = new char[infoLogLength + 1];
-        
-		glGetProgramInfoLog(m_shader, infoLogLength, 0, infoLog);
-		printf("Error: Failed to link Gizmo shader program!\n%s\n", infoLog);
-		delete[] infoLog;
-	}
-
-	glDeleteShader(vs);
-	glDeleteShader(fs);
+	// the instanced shader reads a transform per instance, the mat4 takes locations 2 to 5,
+	// and shades by a fixed light since the primitives have no outlines
+	const char* instanceVsSource = "#version 150\n \
+					 in vec4 Position; \
+					 in vec4 Normal; \
+					 in mat4 Transform; \
+					 in vec4 Colour; \
+					 out vec4 vColour; \
+					 uniform mat4 ProjectionView; \
+					 void main() { \
+						vec3 N = normalize(mat3(Transform) * Normal.xyz); \
+						float shade = 0.55 + 0.45 * max(dot(N, normalize(vec3(0.3, 1.0, 0.5))), 0.0); \
+						vColour = vec4(Colour.rgb * shade, Colour.a); \
+						gl_Position = ProjectionView * Transform * Position; }";
+
+	const char* instanceAttributes[] = { "Position", "Normal", "Transform", nullptr, nullptr, nullptr, "Colour" };
+	m_instanceShader = createGizmoProgram(instanceVsSource, fsSource, instanceAttributes, 7);
+	m_instanceProjectionViewUniform = glGetUniformLocation(m_instanceShader, "ProjectionView");
     
-    // create VBOs
-	glGenBuffers( 1, &m_lineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxLines * sizeof(GizmoLine), m_lines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_triVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_tris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_transparentTriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_transparentTris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DlineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DLines * sizeof(GizmoLine), m_2Dlines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DtriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DTris * sizeof(GizmoTri), m_2Dtris, GL_DYNAMIC_DRAW);
-
-	glGenVertexArrays(1, &m_lineVAO);
-	glBindVertexArray(m_lineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glGenVertexArrays(1, &m_triVAO);
-	glBindVertexArray(m_triVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glGenVertexArrays(1, &m_transparentTriVAO);
-	glBindVertexArray(m_transparentTriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glGenVertexArrays(1, &m_2DlineVAO);
-	glBindVertexArray(m_2DlineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glGenVertexArrays(1, &m_2DtriVAO);
-	glBindVertexArray(m_2DtriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // create the persistently mapped vertex pools, each frame's vertices go in the next region
+	// so drawing never waits on the gpu still reading the last frame
+	glGenVertexArrays(1, &m_vertexPoolVAO);
+	glGenVertexArrays(1, &m_2DVertexPoolVAO);
+	reservePool(m_vertexPool, m_vertexPoolVAO, m_maxLines * 2 + (m_maxTris + m_maxTransparentTris) * 3);
+	reservePool(m_2DVertexPool, m_2DVertexPoolVAO, m_max2DLines * 2 + m_max2DTris * 3);
+
+	// the unit primitives never change, so they go in a static buffer
+	std::vector<PrimitiveVertex> primitiveVertices;
+	buildPrimitives(primitiveVertices, m_primitiveFirst, m_primitiveVertexCount);
+
+	glGenBuffers(1, &m_primitiveVBO);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_primitiveVBO);
+	glBufferData(GL_ARRAY_BUFFER, primitiveVertices.size() * sizeof(PrimitiveVertex),
+				 primitiveVertices.data(), GL_STATIC_DRAW);
+	sns::GpuMemory::instance().trackBuffer(m_primitiveVBO, primitiveVertices.size() * sizeof(PrimitiveVertex),
+										   sns::GpuMemory::GIZMOS, "Gizmos");
+
+	m_instanceStream.create(sizeof(GizmoInstance), m_maxInstances, "Gizmos");
+
+	glGenVertexArrays(1, &m_instanceVAO);
+	sns::RenderState::instance().bindVertexArray(m_instanceVAO);
+	sns::setVertexAttributes(PRIMITIVE_LAYOUT);
+
+	bindStreamAttributes(m_instanceVAO, m_instanceStream.getHandle(), INSTANCE_LAYOUT, 1);
 }
 
 Gizmos::~Gizmos() {
-	delete[] m_lines;
-	delete[] m_tris;
-	delete[] m_transparentTris;
-	glDeleteBuffers( 1, &m_lineVBO );
-	glDeleteBuffers( 1, &m_triVBO );
-	glDeleteBuffers( 1, &m_transparentTriVBO );
-	glDeleteVertexArrays( 1, &m_lineVAO );
-	glDeleteVertexArrays( 1, &m_triVAO );
-	glDeleteVertexArrays( 1, &m_transparentTriVAO );
-	delete[] m_2Dlines;
-	delete[] m_2Dtris;
-	glDeleteBuffers( 1, &m_2DlineVBO );
-	glDeleteBuffers( 1, &m_2DtriVBO );
-	glDeleteVertexArrays( 1, &m_2DlineVAO );
-	glDeleteVertexArrays( 1, &m_2DtriVAO );
+	for (CommandBuffer* buffer : m_commandBuffers)
+		delete buffer;
+	for (Layer& layer : m_layers)
+		releaseLayer(layer);
+	glDeleteVertexArrays( 1, &m_vertexPoolVAO );
+	sns::RenderState::instance().onVertexArrayDeleted(m_vertexPoolVAO);
+	glDeleteVertexArrays( 1, &m_2DVertexPoolVAO );
+	sns::RenderState::instance().onVertexArrayDeleted(m_2DVertexPoolVAO);
+	glDeleteVertexArrays( 1, &m_instanceVAO );
+	sns::RenderState::instance().onVertexArrayDeleted(m_instanceVAO);
+	glDeleteBuffers( 1, &m_primitiveVBO );
+	sns::RenderState::instance().onBufferDeleted(m_primitiveVBO);
+	sns::GpuMemory::instance().releaseBuffer(m_primitiveVBO);
 	glDeleteProgram(m_shader);
+	glDeleteProgram(m_instanceShader);
+	sns::RenderState::instance().onProgramDeleted(m_shader);
+	sns::RenderState::instance().onProgramDeleted(m_instanceShader);
 }
 
 void Gizmos::create(unsigned int maxLines, unsigned int maxTris,
-					unsigned int max2DLines, unsigned int max2DTris) {
+					unsigned int max2DLines, unsigned int max2DTris,
+					unsigned int maxInstances) {
 	if (sm_singleton == nullptr)
-		sm_singleton = new Gizmos(maxLines,maxTris,max2DLines,max2DTris);
+		sm_singleton = new Gizmos(maxLines,maxTris,max2DLines,max2DTris,maxInstances);
 }
 
 void Gizmos::destroy() {
@@ -166,11 +261,227 @@ void Gizmos::destroy() {
 }
 
 void Gizmos::clear() {
-	sm_singleton->m_lineCount = 0;
-	sm_singleton->m_triCount = 0;
-	sm_singleton->m_transparentTriCount = 0;
-	sm_singleton->m_2DlineCount = 0;
-	sm_singleton->m_2DtriCount = 0;
+	for (CommandBuffer* buffer : sm_singleton->m_commandBuffers) {
+		buffer->lines.clear();
+		buffer->tris.clear();
+		buffer->transparentTris.clear();
+		buffer->lines2D.clear();
+		buffer->tris2D.clear();
+		buffer->instances.clear();
+		buffer->instanceBatches.clear();
+	}
+	sm_singleton->m_instancesWritten = false;
+}
+
+unsigned int Gizmos::getOverflowCount() {
+	return sm_singleton != nullptr ? sm_singleton->m_overflowCount : 0;
+}
+
+sns::BlockPool& Gizmos::chunkPool() {
+	static sns::BlockPool pool(CHUNK_BYTES, 16);
+	return pool;
+}
+
+Gizmos::CommandBuffer* Gizmos::commands() {
+	// the buffer stays owned by the singleton, so a thread exiting never loses what it added
+	thread_local CommandBuffer* buffer = nullptr;
+	thread_local unsigned int generation = 0;
+
+	if (sm_singleton == nullptr)
+		return nullptr;
+	if (recordingLayer() != nullptr)
+		return recordingLayer();
+
+	if (generation != sm_singleton->m_generation) {
+		buffer = new CommandBuffer();
+		generation = sm_singleton->m_generation;
+
+		std::lock_guard<std::mutex> lock(sm_singleton->m_commandMutex);
+		sm_singleton->m_commandBuffers.push_back(buffer);
+	}
+	return buffer;
+}
+
+Gizmos::CommandBuffer*& Gizmos::recordingLayer() {
+	thread_local CommandBuffer* layer = nullptr;
+	return layer;
+}
+
+unsigned int Gizmos::createLayer() {
+	if (sm_singleton == nullptr)
+		return 0;
+
+	Layer layer = {};
+	layer.visible = true;
+	layer.used = true;
+	std::vector<Layer>& layers = sm_singleton->m_layers;
+	for (unsigned int i = 0; i < (unsigned int)layers.size(); ++i) {
+		if (layers[i].used == false) {
+			layers[i] = layer;
+			return i;
+		}
+	}
+	layers.push_back(layer);
+	return (unsigned int)layers.size() - 1;
+}
+
+void Gizmos::destroyLayer(unsigned int layer) {
+	if (sm_singleton == nullptr || layer >= sm_singleton->m_layers.size())
+		return;
+	releaseLayer(sm_singleton->m_layers[layer]);
+	sm_singleton->m_layers[layer].used = false;
+}
+
+void Gizmos::beginLayer(unsigned int layer) {
+	if (sm_singleton == nullptr || layer >= sm_singleton->m_layers.size() || recordingLayer() != nullptr)
+		return;
+
+	// a recording no draw has uploaded yet is recorded over
+	Layer& recorded = sm_singleton->m_layers[layer];
+	if (recorded.recorded == nullptr)
+		recorded.recorded = new CommandBuffer();
+	else {
+		recorded.recorded->lines.clear();
+		recorded.recorded->tris.clear();
+		recorded.recorded->transparentTris.clear();
+	}
+	recorded.recording = true;
+	recordingLayer() = recorded.recorded;
+}
+
+void Gizmos::endLayer() {
+	CommandBuffer* buffer = recordingLayer();
+	if (sm_singleton == nullptr || buffer == nullptr)
+		return;
+
+	for (Layer& layer : sm_singleton->m_layers) {
+		if (layer.recorded == buffer)
+			layer.recording = false;
+	}
+	recordingLayer() = nullptr;
+}
+
+void Gizmos::setLayerVisible(unsigned int layer, bool visible) {
+	if (sm_singleton != nullptr && layer < sm_singleton->m_layers.size())
+		sm_singleton->m_layers[layer].visible = visible;
+}
+
+bool Gizmos::isLayerVisible(unsigned int layer) {
+	return sm_singleton != nullptr && layer < sm_singleton->m_layers.size() && sm_singleton->m_layers[layer].visible;
+}
+
+void Gizmos::uploadLayers() {
+	for (Layer& layer : m_layers) {
+		if (layer.recorded == nullptr || layer.recording)
+			continue;
+
+		CommandBuffer* recorded = layer.recorded;
+		layer.recorded = nullptr;
+		releaseLayer(layer);
+		layer.lineCount = recorded->lines.size();
+		layer.triCount = recorded->tris.size();
+		layer.transparentTriCount = recorded->transparentTris.size();
+
+		unsigned int vertexCount = layer.lineCount * 2 + (layer.triCount + layer.transparentTriCount) * 3;
+		if (vertexCount > 0) {
+			std::vector<GizmoVertex> vertices(vertexCount);
+			GizmoVertex* dst = vertices.data();
+			recorded->lines.copyTo((GizmoLine*)dst);
+			recorded->tris.copyTo((GizmoTri*)(dst + layer.lineCount * 2));
+			recorded->transparentTris.copyTo((GizmoTri*)(dst + layer.lineCount * 2 + layer.triCount * 3));
+
+			glGenBuffers(1, &layer.vbo);
+			sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+			glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(GizmoVertex), vertices.data(), GL_STATIC_DRAW);
+			sns::GpuMemory::instance().trackBuffer(layer.vbo, vertexCount * sizeof(GizmoVertex),
+												   sns::GpuMemory::GIZMOS, "Gizmos");
+			glGenVertexArrays(1, &layer.vao);
+			bindStreamAttributes(layer.vao, layer.vbo, VERTEX_LAYOUT, 0);
+		}
+		delete recorded;
+	}
+}
+
+void Gizmos::releaseLayer(Layer& layer) {
+	if (layer.vao != 0) {
+		glDeleteVertexArrays(1, &layer.vao);
+		sns::RenderState::instance().onVertexArrayDeleted(layer.vao);
+		glDeleteBuffers(1, &layer.vbo);
+		sns::RenderState::instance().onBufferDeleted(layer.vbo);
+		sns::GpuMemory::instance().releaseBuffer(layer.vbo);
+	}
+	delete layer.recorded;
+	layer.recorded = nullptr;
+	layer.vao = layer.vbo = 0;
+	layer.lineCount = layer.triCount = layer.transparentTriCount = 0;
+}
+
+template <typename T>
+unsigned int Gizmos::count(ChunkedArray<T> CommandBuffer::*array) const {
+	unsigned int total = 0;
+	for (CommandBuffer* buffer : m_commandBuffers)
+		total += (buffer->*array).size();
+	return total;
+}
+
+void Gizmos::reserveCategory(unsigned int& capacity, unsigned int count) {
+	if (count > capacity) {
+		m_overflowCount += count - capacity;
+		capacity = count > capacity * 2 ? count : capacity * 2;
+	}
+}
+
+void Gizmos::reservePool(sns::StreamingBuffer& pool, unsigned int vao, unsigned int vertexCount) {
+	if (pool.getHandle() == 0 || vertexCount > pool.getElementCount()) {
+		pool.create(sizeof(GizmoVertex), vertexCount, "Gizmos");
+		bindStreamAttributes(vao, pool.getHandle(), VERTEX_LAYOUT, 0);
+	}
+}
+
+template <typename T>
+T* Gizmos::copyPrimitives(ChunkedArray<T> CommandBuffer::*array, T* dst) const {
+	for (CommandBuffer* buffer : m_commandBuffers) {
+		(buffer->*array).copyTo(dst);
+		dst += (buffer->*array).size();
+	}
+	return dst;
+}
+
+void Gizmos::writeSortedTransparentTris(const glm::mat4& projectionView, unsigned int count, GizmoTri* dst) {
+	m_sortTris.resize(count);
+	m_sortKeys.resize(count);
+	m_sortIndices.resize(count);
+	m_sortScratch.resize(count * 2);
+
+	copyPrimitives(&CommandBuffer::transparentTris, m_sortTris.data());
+
+	// a perspective projection's clip w is the view depth, which grows with distance
+	// whichever way depth is stored. an orthographic one's w is always 1, so its clip
+	// z is used instead, which shrinks with distance while depth is reversed. the sum
+	// of the corners sorts the same as their centre
+	glm::vec4 depthRow(projectionView[0][3], projectionView[1][3], projectionView[2][3], projectionView[3][3]);
+	if (depthRow.x == 0 && depthRow.y == 0 && depthRow.z == 0) {
+		depthRow = glm::vec4(projectionView[0][2], projectionView[1][2], projectionView[2][2], projectionView[3][2]);
+		if (sns::RenderState::instance().isReverseZ())
+			depthRow = -depthRow;
+	}
+	for (unsigned int i = 0; i < count; ++i) {
+		const GizmoTri& tri = m_sortTris[i];
+		float depth = depthRow.x * (tri.v0.x + tri.v1.x + tri.v2.x) +
+					  depthRow.y * (tri.v0.y + tri.v1.y + tri.v2.y) +
+					  depthRow.z * (tri.v0.z + tri.v1.z + tri.v2.z) +
+					  depthRow.w * 3;
+
+		// inverted so the furthest sorts first
+		m_sortKeys[i] = ~sns::floatToSortable(depth);
+		m_sortIndices[i] = i;
+	}
+
+	sns::radixSort(m_sortKeys.data(), m_sortIndices.data(),
+				   m_sortScratch.data(), m_sortScratch.data() + count, count);
+
+	for (unsigned int i = 0; i < count; ++i)
+		dst[i] = m_sortTris[m_sortIndices[i]];
 }
 
 // Adds 3 unit-length lines (red,green,blue) representing the 3 axis of a transform, 
@@ -535,8 +846,10 @@ void Gizmos::addSphere(const glm::vec3& center, float radius, int rows, int colu
 	float latitiudinalRange = (latMax - latMin) * DEG2RAD;
 	float longitudinalRange = (longMax - longMin) * DEG2RAD;
 
-	// for each row of the mesh
-	glm::vec3* v4Array = new glm::vec3[rows*columns + columns];
+	// for each row of the mesh, in scratch kept by the thread so adding spheres doesn't allocate
+	thread_local std::vector<glm::vec3> scratch;
+	scratch.resize(rows*columns + columns);
+	glm::vec3* v4Array = scratch.data();
 
 	for (int row = 0; row <= rows; ++row) {
 		// y ordinates this may be a little confusing but here we are navigating around the xAxis in GL
@@ -576,8 +889,6 @@ void Gizmos::addSphere(const glm::vec3& center, float radius, int rows, int colu
 		addTri(tempCenter + v4Array[iNextFace+columns], tempCenter + v4Array[face], tempCenter + v4Array[iNextFace], fillColour);
 		addTri(tempCenter + v4Array[iNextFace+columns], tempCenter + v4Array[face+columns], tempCenter + v4Array[face], fillColour);
 	}
-
-	delete[] v4Array;	
 }
 
 void Gizmos::addCapsule(const glm::vec3& center, float height, float radius,
@@ -609,8 +920,10 @@ void Gizmos::addCapsule(const glm::vec3& center, float height, float radius,
 	float latitiudinalRange = (latMax - latMin) * DEG2RAD;
 	float longitudinalRange = (longMax - longMin) * DEG2RAD;
 
-	// for each row of the mesh
-	glm::vec3* v4Array = new glm::vec3[rows*cols + cols];
+	// for each row of the mesh, in scratch kept by the thread so adding capsules doesn't allocate
+	thread_local std::vector<glm::vec3> scratch;
+	scratch.resize(rows*cols + cols);
+	glm::vec3* v4Array = scratch.data();
 
 	for (int row = 0; row <= (rows); ++row) {
 		// y ordinates this may be a little confusing but here we are navigating around the xAxis in GL
@@ -656,8 +969,6 @@ void Gizmos::addCapsule(const glm::vec3& center, float height, float radius,
 		addTri(tempCenter + v4Array[iNextFace + cols], tempCenter + v4Array[face + cols], tempCenter + v4Array[face], fillColour);
 	}
 
-	delete[] v4Array;
-
 	for (int i = 0; i < cols; ++i) {
 		float x = (float)i / (float)cols;
 		float x1 = (float)(i+1) / (float)cols;
@@ -681,6 +992,100 @@ void Gizmos::addCapsule(const glm::vec3& center, float height, float radius,
 	}
 }
 
+void Gizmos::addSphereInstanced(const glm::vec3& center, float radius, const glm::vec4& fillColour,
+								const glm::mat4* transform) {
+	addInstance(SPHERE, center, glm::vec3(radius), fillColour, transform);
+}
+
+void Gizmos::addCylinderInstanced(const glm::vec3& center, float radius, float halfLength,
+								  const glm::vec4& fillColour, const glm::mat4* transform) {
+	addInstance(CYLINDER, center, glm::vec3(radius, halfLength, radius), fillColour, transform);
+}
+
+void Gizmos::addAABBInstanced(const glm::vec3& center, const glm::vec3& extents,
+							  const glm::vec4& fillColour, const glm::mat4* transform) {
+	addInstance(BOX, center, extents, fillColour, transform);
+}
+
+void Gizmos::addDiskInstanced(const glm::vec3& center, float radius,
+							  const glm::vec4& fillColour, const glm::mat4* transform) {
+	addInstance(DISK, center, glm::vec3(radius, 1, radius), fillColour, transform);
+}
+
+void Gizmos::addInstance(Primitive primitive, const glm::vec3& center, const glm::vec3& scale,
+						 const glm::vec4& colour, const glm::mat4* transform) {
+	CommandBuffer* buffer = commands();
+	if (buffer == nullptr)
+		return;
+
+	// the same as the tessellated gizmos, transform rotates and center is added to its translation
+	glm::mat4 model(1);
+	if (transform != nullptr)
+		model = *transform;
+	model[3] = glm::vec4(glm::vec3(model[3]) + center, 1);
+	model[0] *= scale.x;
+	model[1] *= scale.y;
+	model[2] *= scale.z;
+
+	GizmoInstance& instance = buffer->instances.push();
+	memcpy(instance.transform, glm::value_ptr(model), sizeof(instance.transform));
+	instance.r = colour.r;
+	instance.g = colour.g;
+	instance.b = colour.b;
+	instance.a = colour.a;
+
+	buffer->instanceBatches.push() = (unsigned char)(colour.w == 1 ? primitive : primitive + PRIMITIVE_COUNT);
+}
+
+void Gizmos::writeInstances(unsigned int instanceCount) {
+	if (instanceCount > m_maxInstances) {
+		m_overflowCount += instanceCount - m_maxInstances;
+		m_maxInstances = instanceCount > m_maxInstances * 2 ? instanceCount : m_maxInstances * 2;
+		m_instanceStream.create(sizeof(GizmoInstance), m_maxInstances, "Gizmos");
+		bindStreamAttributes(m_instanceVAO, m_instanceStream.getHandle(), INSTANCE_LAYOUT, 1);
+	}
+
+	// a counting sort by batch, written straight into this frame's region
+	unsigned int cursor[BATCH_COUNT] = {};
+	for (CommandBuffer* buffer : m_commandBuffers) {
+		for (unsigned int i = 0; i < buffer->instanceBatches.size(); ++i)
+			++cursor[buffer->instanceBatches[i]];
+	}
+
+	unsigned int offset = 0;
+	for (unsigned int batch = 0; batch < BATCH_COUNT; ++batch) {
+		m_batchCount[batch] = cursor[batch];
+		cursor[batch] = offset;
+		offset += m_batchCount[batch];
+	}
+
+	GizmoInstance* region = (GizmoInstance*)m_instanceStream.beginWrite();
+	for (CommandBuffer* buffer : m_commandBuffers) {
+		for (unsigned int i = 0; i < buffer->instances.size(); ++i)
+			region[cursor[buffer->instanceBatches[i]]++] = buffer->instances[i];
+	}
+	unsigned int first = m_instanceStream.endWrite(instanceCount);
+
+	for (unsigned int batch = 0; batch < BATCH_COUNT; ++batch)
+		m_batchFirst[batch] = first + cursor[batch] - m_batchCount[batch];
+}
+
+void Gizmos::drawInstances(const glm::mat4& projectionView, unsigned int firstBatch, unsigned int lastBatch) {
+	sns::RenderState::instance().useProgram(m_instanceShader);
+	glUniformMatrix4fv(m_instanceProjectionViewUniform, 1, false, glm::value_ptr(projectionView));
+
+	sns::RenderState::instance().bindVertexArray(m_instanceVAO);
+	for (unsigned int batch = firstBatch; batch < lastBatch; ++batch) {
+		if (m_batchCount[batch] == 0)
+			continue;
+
+		unsigned int primitive = batch % PRIMITIVE_COUNT;
+		sns::RenderState::instance().countDraw();
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, m_primitiveFirst[primitive], m_primitiveVertexCount[primitive],
+										  m_batchCount[batch], m_batchFirst[batch]);
+	}
+}
+
 void Gizmos::addHermiteSpline(const glm::vec3& start, const glm::vec3& end,
 	const glm::vec3& tangentStart, const glm::vec3& tangentEnd, unsigned int segments, const glm::vec4& colour) {
 
@@ -709,95 +1114,105 @@ void Gizmos::addLine(const glm::vec3& v0,  const glm::vec3& v1, const glm::vec4&
 }
 
 void Gizmos::addLine(const glm::vec3& v0, const glm::vec3& v1, const glm::vec4& colour0, const glm::vec4& colour1) {
-
-	if (sm_singleton != nullptr &&
-		sm_singleton->m_lineCount < sm_singleton->m_maxLines) {
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.x = v0.x;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.y = v0.y;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.z = v0.z;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.w = 1;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.r = colour0.r;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.g = colour0.g;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.b = colour0.b;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.a = colour0.a;
-
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.x = v1.x;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.y = v1.y;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.z = v1.z;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.w = 1;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.r = colour1.r;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.g = colour1.g;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.b = colour1.b;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.a = colour1.a;
-
-		sm_singleton->m_lineCount++;
+	CommandBuffer* buffer = commands();
+	if (buffer != nullptr) {
+		GizmoLine& line = buffer->lines.push();
+		setVertex(line.v0, v0.x, v0.y, v0.z, colour0);
+		setVertex(line.v1, v1.x, v1.y, v1.z, colour1);
 	}
 }
 
 void Gizmos::addTri(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const glm::vec4& colour) {
-	if (sm_singleton != nullptr) {
-		if (colour.w == 1) {
-			if (sm_singleton->m_triCount < sm_singleton->m_maxTris) {
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.x = v0.x;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.y = v0.y;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.z = v0.z;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.w = 1;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.x = v1.x;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.y = v1.y;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.z = v1.z;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.w = 1;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.x = v2.x;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.y = v2.y;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.z = v2.z;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.w = 1;
-
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.r = colour.r;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.g = colour.g;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.b = colour.b;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.a = colour.a;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.r = colour.r;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.g = colour.g;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.b = colour.b;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.a = colour.a;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.r = colour.r;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.g = colour.g;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.b = colour.b;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.a = colour.a;
-
-				sm_singleton->m_triCount++;
-			}
+	CommandBuffer* buffer = commands();
+	if (buffer != nullptr) {
+		GizmoTri& tri = colour.w == 1 ? buffer->tris.push() : buffer->transparentTris.push();
+		setVertex(tri.v0, v0.x, v0.y, v0.z, colour);
+		setVertex(tri.v1, v1.x, v1.y, v1.z, colour);
+		setVertex(tri.v2, v2.x, v2.y, v2.z, colour);
+	}
+}
+
+void Gizmos::addLines(const glm::vec3* points, unsigned int count, const glm::vec4& colour) {
+	CommandBuffer* buffer = commands();
+	if (buffer == nullptr)
+		return;
+
+	// every vertex starts as a copy of one with the colour, only its position differs
+	GizmoVertex vertex;
+	setVertex(vertex, 0, 0, 0, colour);
+	while (count > 0) {
+		unsigned int run = count;
+		GizmoLine* lines = buffer->lines.pushRun(run);
+		for (unsigned int i = 0; i < run; ++i, points += 2) {
+			lines[i].v0 = vertex;
+			lines[i].v1 = vertex;
+			memcpy(&lines[i].v0.x, &points[0].x, sizeof(float) * 3);
+			memcpy(&lines[i].v1.x, &points[1].x, sizeof(float) * 3);
 		}
-		else {
-			if (sm_singleton->m_transparentTriCount < sm_singleton->m_maxTris) {
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.x = v0.x;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.y = v0.y;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.z = v0.z;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.w = 1;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.x = v1.x;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.y = v1.y;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.z = v1.z;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.w = 1;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.x = v2.x;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.y = v2.y;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.z = v2.z;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.w = 1;
-
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.r = colour.r;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.g = colour.g;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.b = colour.b;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.a = colour.a;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.r = colour.r;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.g = colour.g;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.b = colour.b;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.a = colour.a;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.r = colour.r;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.g = colour.g;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.b = colour.b;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.a = colour.a;
-
-				sm_singleton->m_transparentTriCount++;
-			}
+		count -= run;
+	}
+}
+
+void Gizmos::addLines(const glm::vec3* points, const glm::vec4* colours, unsigned int count) {
+	CommandBuffer* buffer = commands();
+	if (buffer == nullptr)
+		return;
+
+	while (count > 0) {
+		unsigned int run = count;
+		GizmoLine* lines = buffer->lines.pushRun(run);
+		for (unsigned int i = 0; i < run; ++i, points += 2, colours += 2) {
+			setVertex(lines[i].v0, points[0].x, points[0].y, points[0].z, colours[0]);
+			setVertex(lines[i].v1, points[1].x, points[1].y, points[1].z, colours[1]);
+		}
+		count -= run;
+	}
+}
+
+void Gizmos::addTris(const glm::vec3* points, unsigned int count, const glm::vec4& colour) {
+	CommandBuffer* buffer = commands();
+	if (buffer == nullptr)
+		return;
+
+	ChunkedArray<GizmoTri>& tris = colour.w == 1 ? buffer->tris : buffer->transparentTris;
+	GizmoVertex vertex;
+	setVertex(vertex, 0, 0, 0, colour);
+	while (count > 0) {
+		unsigned int run = count;
+		GizmoTri* dst = tris.pushRun(run);
+		for (unsigned int i = 0; i < run; ++i, points += 3) {
+			dst[i].v0 = vertex;
+			dst[i].v1 = vertex;
+			dst[i].v2 = vertex;
+			memcpy(&dst[i].v0.x, &points[0].x, sizeof(float) * 3);
+			memcpy(&dst[i].v1.x, &points[1].x, sizeof(float) * 3);
+			memcpy(&dst[i].v2.x, &points[2].x, sizeof(float) * 3);
+		}
+		count -= run;
+	}
+}
+
+void Gizmos::addTris(const glm::vec3* positions, const unsigned int* indices, unsigned int count,
+					 const glm::vec4& colour) {
+	CommandBuffer* buffer = commands();
+	if (buffer == nullptr)
+		return;
+
+	ChunkedArray<GizmoTri>& tris = colour.w == 1 ? buffer->tris : buffer->transparentTris;
+	GizmoVertex vertex;
+	setVertex(vertex, 0, 0, 0, colour);
+	while (count > 0) {
+		unsigned int run = count;
+		GizmoTri* dst = tris.pushRun(run);
+		for (unsigned int i = 0; i < run; ++i, indices += 3) {
+			dst[i].v0 = vertex;
+			dst[i].v1 = vertex;
+			dst[i].v2 = vertex;
+			memcpy(&dst[i].v0.x, &positions[indices[0]].x, sizeof(float) * 3);
+			memcpy(&dst[i].v1.x, &positions[indices[1]].x, sizeof(float) * 3);
+			memcpy(&dst[i].v2.x, &positions[indices[2]].x, sizeof(float) * 3);
 		}
+		count -= run;
 	}
 }
 
@@ -872,59 +1287,21 @@ void Gizmos::add2DLine(const glm::vec2& rv0,  const glm::vec2& rv1, const glm::v
 }
 
 void Gizmos::add2DLine(const glm::vec2& rv0, const glm::vec2& rv1, const glm::vec4& colour0, const glm::vec4& colour1) {
-	if (sm_singleton != nullptr &&
-		sm_singleton->m_2DlineCount < sm_singleton->m_max2DLines) {
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.x = rv0.x;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.y = rv0.y;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.z = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.w = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.r = colour0.r;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.g = colour0.g;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.b = colour0.b;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.a = colour0.a;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.x = rv1.x;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.y = rv1.y;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.z = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.w = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.r = colour1.r;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.g = colour1.g;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.b = colour1.b;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.a = colour1.a;
-
-		sm_singleton->m_2DlineCount++;
+	CommandBuffer* buffer = commands();
+	if (buffer != nullptr) {
+		GizmoLine& line = buffer->lines2D.push();
+		setVertex(line.v0, rv0.x, rv0.y, 1, colour0);
+		setVertex(line.v1, rv1.x, rv1.y, 1, colour1);
 	}
 }
 
 void Gizmos::add2DTri(const glm::vec2& rv0, const glm::vec2& rv1, const glm::vec2& rv2, const glm::vec4& colour) {
-	if (sm_singleton != nullptr) {
-		if (sm_singleton->m_2DtriCount < sm_singleton->m_max2DTris) {
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.x = rv0.x;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.y = rv0.y;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.z = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.w = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.x = rv1.x;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.y = rv1.y;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.z = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.w = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.x = rv2.x;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.y = rv2.y;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.z = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.w = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.r = colour.r;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.g = colour.g;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.b = colour.b;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.a = colour.a;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.r = colour.r;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.g = colour.g;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.b = colour.b;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.a = colour.a;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.r = colour.r;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.g = colour.g;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.b = colour.b;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.a = colour.a;
-
-			sm_singleton->m_2DtriCount++;
-		}
+	CommandBuffer* buffer = commands();
+	if (buffer != nullptr) {
+		GizmoTri& tri = buffer->tris2D.push();
+		setVertex(tri.v0, rv0.x, rv0.y, 1, colour);
+		setVertex(tri.v1, rv1.x, rv1.y, 1, colour);
+		setVertex(tri.v2, rv2.x, rv2.y, 1, colour);
 	}
 }
 
@@ -933,123 +1310,241 @@ void Gizmos::draw(const glm::mat4& projection, const glm::mat4& view) {
 }
 
 void Gizmos::draw(const glm::mat4& projectionView) {
-	if ( sm_singleton != nullptr && 
-		(sm_singleton->m_lineCount > 0 || 
-		 sm_singleton->m_triCount > 0 || 
-		 sm_singleton->m_transparentTriCount > 0)) {
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
-
-		glUseProgram(sm_singleton->m_shader);
-		
-		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
-		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projectionView));
+	SNS_TRACE_GL_ZONE("Gizmos::draw");
+	if (sm_singleton == nullptr)
+		return;
+
+	// every thread's gizmos are merged here, so nothing may be adding while drawing
+	unsigned int lineCount = sm_singleton->count(&CommandBuffer::lines);
+	unsigned int triCount = sm_singleton->count(&CommandBuffer::tris);
+	unsigned int transparentTriCount = sm_singleton->count(&CommandBuffer::transparentTris);
+	unsigned int instanceCount = sm_singleton->count(&CommandBuffer::instances);
+
+	// the retained layers are drawn before the frame's own gizmos
+	sm_singleton->uploadLayers();
+	bool layers = false;
+	bool transparentLayers = false;
+	for (const Layer& layer : sm_singleton->m_layers) {
+		if (layer.visible && layer.vao != 0) {
+			layers = layers || layer.lineCount + layer.triCount > 0;
+			transparentLayers = transparentLayers || layer.transparentTriCount > 0;
+		}
+	}
+
+	if (lineCount > 0 || 
+		triCount > 0 || 
+		transparentTriCount > 0 ||
+		instanceCount > 0 ||
+		layers ||
+		transparentLayers) {
+		// state goes through the render state, so reading it back never waits on the driver
+		sns::RenderState& state = sns::RenderState::instance();
+		unsigned int shader = state.getProgram();
+
+		state.useProgram(sm_singleton->m_shader);
+		glUniformMatrix4fv(sm_singleton->m_projectionViewUniform, 1, false, glm::value_ptr(projectionView));
+
+		// every category is written straight into one region of the pool, lines then
+		// triangles then the sorted transparent triangles, and fenced once after the last draw
+		unsigned int firstLine = 0;
+		unsigned int firstTri = lineCount * 2;
+		unsigned int firstTransparentTri = firstTri + triCount * 3;
+		unsigned int vertexCount = firstTransparentTri + transparentTriCount * 3;
+		if (vertexCount > 0) {
+			sm_singleton->reserveCategory(sm_singleton->m_maxLines, lineCount);
+			sm_singleton->reserveCategory(sm_singleton->m_maxTris, triCount);
+			sm_singleton->reserveCategory(sm_singleton->m_maxTransparentTris, transparentTriCount);
+			sm_singleton->reservePool(sm_singleton->m_vertexPool, sm_singleton->m_vertexPoolVAO,
+				sm_singleton->m_maxLines * 2 + (sm_singleton->m_maxTris + sm_singleton->m_maxTransparentTris) * 3);
+
+			GizmoVertex* region = (GizmoVertex*)sm_singleton->m_vertexPool.beginWrite();
+			sm_singleton->copyPrimitives(&CommandBuffer::lines, (GizmoLine*)(region + firstLine));
+			sm_singleton->copyPrimitives(&CommandBuffer::tris, (GizmoTri*)(region + firstTri));
+			if (transparentTriCount > 0)
+				sm_singleton->writeSortedTransparentTris(projectionView, transparentTriCount,
+					(GizmoTri*)(region + firstTransparentTri));
+			unsigned int first = sm_singleton->m_vertexPool.endWrite(vertexCount);
+			firstLine += first;
+			firstTri += first;
+			firstTransparentTri += first;
+		}
+
+		for (unsigned int i = 0; layers && i < (unsigned int)sm_singleton->m_layers.size(); ++i) {
+			const Layer& layer = sm_singleton->m_layers[i];
+			if (layer.visible == false || layer.vao == 0)
+				continue;
+			state.bindVertexArray(layer.vao);
+			if (layer.lineCount > 0) {
+				state.countDraw();
+				glDrawArrays(GL_LINES, 0, layer.lineCount * 2);
+			}
+			if (layer.triCount > 0) {
+				state.countDraw();
+				glDrawArrays(GL_TRIANGLES, layer.lineCount * 2, layer.triCount * 3);
+			}
+		}
 
-		if (sm_singleton->m_lineCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_lineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_lineCount * sizeof(GizmoLine), sm_singleton->m_lines);
+		if (lineCount > 0) {
+			state.bindVertexArray(sm_singleton->m_vertexPoolVAO);
+			state.countDraw();
+			glDrawArrays(GL_LINES, firstLine, lineCount * 2);
+		}
 
-			glBindVertexArray(sm_singleton->m_lineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_lineCount * 2);
+		if (triCount > 0) {
+			state.bindVertexArray(sm_singleton->m_vertexPoolVAO);
+			state.countDraw();
+			glDrawArrays(GL_TRIANGLES, firstTri, triCount * 3);
 		}
 
-		if (sm_singleton->m_triCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_triVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_triCount * sizeof(GizmoTri), sm_singleton->m_tris);
+		bool transparentInstances = false;
+		bool instancesWritten = sm_singleton->m_instancesWritten;
+		if (instanceCount > 0) {
+			if (instancesWritten == false)
+				sm_singleton->writeInstances(instanceCount);
+			sm_singleton->drawInstances(projectionView, 0, PRIMITIVE_COUNT);
 
-			glBindVertexArray(sm_singleton->m_triVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_triCount * 3);
+			for (unsigned int batch = PRIMITIVE_COUNT; batch < BATCH_COUNT; ++batch)
+				transparentInstances = transparentInstances || sm_singleton->m_batchCount[batch] > 0;
 		}
 		
-		if (sm_singleton->m_transparentTriCount > 0) {
-			// not ideal to store these, but Gizmos must work stand-alone
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
+		if (transparentTriCount > 0 || transparentInstances || transparentLayers) {
+			// Gizmos must work stand-alone, so put back whatever was set before
+			bool blendEnabled = state.isBlendEnabled();
+			bool depthMask = state.getDepthMask();
+			unsigned int src, dst;
+			state.getBlendFunc(src, dst);
 			
 			// setup blend states
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
-			
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glDepthMask(GL_FALSE);
+			state.setBlend(true);
+			state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			state.setDepthMask(false);
+
+			// a layer's transparent triangles were sorted by nothing, so they go under the frame's
+			if (transparentLayers) {
+				state.useProgram(sm_singleton->m_shader);
+				for (const Layer& layer : sm_singleton->m_layers) {
+					if (layer.visible == false || layer.vao == 0 || layer.transparentTriCount == 0)
+						continue;
+					state.bindVertexArray(layer.vao);
+					state.countDraw();
+					glDrawArrays(GL_TRIANGLES, layer.lineCount * 2 + layer.triCount * 3, layer.transparentTriCount * 3);
+				}
+			}
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_transparentTriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_transparentTriCount * sizeof(GizmoTri), sm_singleton->m_transparentTris);
+			if (transparentTriCount > 0) {
+				state.useProgram(sm_singleton->m_shader);
+				state.bindVertexArray(sm_singleton->m_vertexPoolVAO);
+				state.countDraw();
+				glDrawArrays(GL_TRIANGLES, firstTransparentTri, transparentTriCount * 3);
+			}
 
-			glBindVertexArray(sm_singleton->m_transparentTriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_transparentTriCount * 3);
+			if (transparentInstances)
+				sm_singleton->drawInstances(projectionView, PRIMITIVE_COUNT, BATCH_COUNT);
 
 			// reset state
-			glDepthMask(depthMask);
-			glBlendFunc(src, dst);
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
+			state.setDepthMask(depthMask);
+			state.setBlendFunc(src, dst);
+			state.setBlend(blendEnabled);
 		}
 
-		glUseProgram(shader);
-	}
-}
-
-void Gizmos::draw2D(float screenWidth, float screenHeight) {
-	draw2D(glm::ortho(0.f, screenWidth, 0.f, screenHeight));
-}
+		if (vertexCount > 0)
+			sm_singleton->m_vertexPool.fence();
 
-void Gizmos::draw2D(const glm::mat4& projection) {
-	if ( sm_singleton != nullptr && 
-		(sm_singleton->m_2DlineCount > 0 || 
-		 sm_singleton->m_2DtriCount > 0)) {
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
-
-		glUseProgram(sm_singleton->m_shader);
-		
-		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
-		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projection));
+		// a region drawDepth already fenced has its fence moved after these draws instead
+		if (instanceCount > 0) {
+			if (instancesWritten)
+				sm_singleton->m_instanceStream.refence();
+			else
+				sm_singleton->m_instanceStream.fence();
+			sm_singleton->m_instancesWritten = true;
+		}
 
-		if (sm_singleton->m_2DlineCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DlineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DlineCount * sizeof(GizmoLine), sm_singleton->m_2Dlines);
+		state.useProgram(shader);
+	}
+}
 
-			glBindVertexArray(sm_singleton->m_2DlineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_2DlineCount * 2);
-		}
+void Gizmos::drawDepth(const glm::mat4& projectionView) {
+	if (sm_singleton == nullptr)
+		return;
 
-		if (sm_singleton->m_2DtriCount > 0) {
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+	unsigned int instanceCount = sm_singleton->count(&CommandBuffer::instances);
+	if (instanceCount == 0)
+		return;
 
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	sns::RenderState& state = sns::RenderState::instance();
+	unsigned int shader = state.getProgram();
 
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
+	bool instancesWritten = sm_singleton->m_instancesWritten;
+	if (instancesWritten == false)
+		sm_singleton->writeInstances(instanceCount);
+	sm_singleton->drawInstances(projectionView, 0, PRIMITIVE_COUNT);
 
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
+	if (instancesWritten)
+		sm_singleton->m_instanceStream.refence();
+	else
+		sm_singleton->m_instanceStream.fence();
+	sm_singleton->m_instancesWritten = true;
 
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	state.useProgram(shader);
+}
 
-			glDepthMask(GL_FALSE);
+void Gizmos::draw2D(float screenWidth, float screenHeight) {
+	draw2D(glm::ortho(0.f, screenWidth, 0.f, screenHeight));
+}
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DtriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DtriCount * sizeof(GizmoTri), sm_singleton->m_2Dtris);
+void Gizmos::draw2D(const glm::mat4& projection) {
+	SNS_TRACE_GL_ZONE("Gizmos::draw2D");
+	if (sm_singleton == nullptr)
+		return;
+
+	unsigned int lineCount = sm_singleton->count(&CommandBuffer::lines2D);
+	unsigned int triCount = sm_singleton->count(&CommandBuffer::tris2D);
+
+	if (lineCount > 0 || 
+		triCount > 0) {
+		sns::RenderState& state = sns::RenderState::instance();
+		unsigned int shader = state.getProgram();
+
+		state.useProgram(sm_singleton->m_shader);
+		glUniformMatrix4fv(sm_singleton->m_projectionViewUniform, 1, false, glm::value_ptr(projection));
+
+		// the lines then the triangles, written and fenced once
+		sm_singleton->reserveCategory(sm_singleton->m_max2DLines, lineCount);
+		sm_singleton->reserveCategory(sm_singleton->m_max2DTris, triCount);
+		sm_singleton->reservePool(sm_singleton->m_2DVertexPool, sm_singleton->m_2DVertexPoolVAO,
+			sm_singleton->m_max2DLines * 2 + sm_singleton->m_max2DTris * 3);
+
+		GizmoVertex* region = (GizmoVertex*)sm_singleton->m_2DVertexPool.beginWrite();
+		sm_singleton->copyPrimitives(&CommandBuffer::lines2D, (GizmoLine*)region);
+		sm_singleton->copyPrimitives(&CommandBuffer::tris2D, (GizmoTri*)(region + lineCount * 2));
+		unsigned int first = sm_singleton->m_2DVertexPool.endWrite(lineCount * 2 + triCount * 3);
+
+		state.bindVertexArray(sm_singleton->m_2DVertexPoolVAO);
+		if (lineCount > 0) {
+			state.countDraw();
+			glDrawArrays(GL_LINES, first, lineCount * 2);
+		}
 
-			glBindVertexArray(sm_singleton->m_2DtriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_2DtriCount * 3);
+		if (triCount > 0) {
+			bool blendEnabled = state.isBlendEnabled();
+			bool depthMask = state.getDepthMask();
+			unsigned int src, dst;
+			state.getBlendFunc(src, dst);
 
-			glDepthMask(depthMask);
+			state.setBlend(true);
+			state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			state.setDepthMask(false);
 
-			glBlendFunc(src, dst);
+			state.countDraw();
+			glDrawArrays(GL_TRIANGLES, first + lineCount * 2, triCount * 3);
 
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
+			state.setDepthMask(depthMask);
+			state.setBlendFunc(src, dst);
+			state.setBlend(blendEnabled);
 		}
+		sm_singleton->m_2DVertexPool.fence();
 
-		glUseProgram(shader);
+		state.useProgram(shader);
 	}
 }
 
@@ -1,23 +1,57 @@
 #pragma once
 
 #include <glm/fwd.hpp>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "BlockPool.h"
+#include "StreamingBuffer.h"
+#include "VertexLayout.h"
 
 namespace aie {
 
-// a singleton class for rendering immediate-mode 3-D primitives
+// a singleton class for rendering immediate-mode 3-D primitives.
+// gizmos can be added from any thread, but not while clear or draw are running.
+// the max sizes are only where the buffers start, they grow to fit whatever is added
 class Gizmos {
 public:
 
+	// maxInstances is how many instanced primitives are expected each frame
 	static void		create(unsigned int maxLines, unsigned int maxTris,
-						   unsigned int max2DLines, unsigned int max2DTris);
+						   unsigned int max2DLines, unsigned int max2DTris,
+						   unsigned int maxInstances = 1024);
 	static void		destroy();
 
 	// removes all Gizmos
 	static void		clear();
 
+	// how many primitives went past the sizes given to create, so a buffer had to grow
+	static unsigned int	getOverflowCount();
+
+	// a retained layer keeps lines and triangles in a static buffer of its own, drawn by every
+	// draw while visible and kept through clear, so debug geometry that doesn't change, like a
+	// grid, is added and uploaded once rather than every frame. between beginLayer and endLayer
+	// whatever the calling thread adds goes into the layer instead of the frame, replacing what
+	// it held. only lines and 3-D triangles are kept, transparent ones drawn unsorted, and the
+	// instanced and 2-D gizmos added while recording are dropped. the next draw uploads it.
+	// layers are created and destroyed on the context thread, never while one is recording
+	static unsigned int	createLayer();
+	static void		destroyLayer(unsigned int layer);
+	static void		beginLayer(unsigned int layer);
+	static void		endLayer();
+
+	// hidden layers keep their buffers, they are only skipped by draw. layers start visible
+	static void		setLayerVisible(unsigned int layer, bool visible);
+	static bool		isLayerVisible(unsigned int layer);
+
 	// draws current Gizmo buffers, either using a combined (projection * view) matrix, or separate matrices
 	static void		draw(const glm::mat4& projectionView);
 	static void		draw(const glm::mat4& projection, const glm::mat4& view);
+
+	// draws only the opaque instanced primitives, for depth passes like shadow maps. nothing may be
+	// added between it and draw, the instances it writes are reused by every draw until clear
+	static void		drawDepth(const glm::mat4& projectionView);
 	
 	// the projection matrix here should ideally be orthographic with a near of -1 and far of 1
 	static void		draw2D(const glm::mat4& projection);
@@ -32,6 +66,21 @@ public:
 	// adds a triangle
 	static void		addTri(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const glm::vec4& colour);
 
+	// adds count lines at once from pairs of points, taking the thread's buffer and making
+	// room for them once rather than per line, for drawing thousands like a navmesh's edges
+	static void		addLines(const glm::vec3* points, unsigned int count, const glm::vec4& colour);
+
+	// as above with a colour per point
+	static void		addLines(const glm::vec3* points, const glm::vec4* colours, unsigned int count);
+
+	// adds count triangles at once from triples of points. they are all opaque, or all
+	// sorted as transparent, by the colour's alpha as addTri does
+	static void		addTris(const glm::vec3* points, unsigned int count, const glm::vec4& colour);
+
+	// as above with each triangle's corners picked from positions by three indices
+	static void		addTris(const glm::vec3* positions, const unsigned int* indices, unsigned int count,
+							const glm::vec4& colour);
+
 	// adds 3 unit-length lines (red,green,blue) representing the 3 axis of a transform, 
 	// at the transform's translation. Optional scale available
 	static void		addTransform(const glm::mat4& transform, float scale = 1.0f);
@@ -82,6 +131,19 @@ public:
 	static void		addHermiteSpline(const glm::vec3& start, const glm::vec3& end,
 									 const glm::vec3& tangentStart, const glm::vec3& tangentEnd, unsigned int segments, const glm::vec4& colour);
 
+	// instanced primitives are drawn from unit meshes built once in create, so adding
+	// one only stores a transform and colour, and every primitive of a type is one draw call.
+	// they are lit by a fixed light instead of outlined, and use the same optional transform
+	// for rotation as the tessellated versions above
+	static void		addSphereInstanced(const glm::vec3& center, float radius, const glm::vec4& fillColour,
+									   const glm::mat4* transform = nullptr);
+	static void		addCylinderInstanced(const glm::vec3& center, float radius, float halfLength,
+										 const glm::vec4& fillColour, const glm::mat4* transform = nullptr);
+	static void		addAABBInstanced(const glm::vec3& center, const glm::vec3& extents,
+									 const glm::vec4& fillColour, const glm::mat4* transform = nullptr);
+	static void		addDiskInstanced(const glm::vec3& center, float radius,
+									 const glm::vec4& fillColour, const glm::mat4* transform = nullptr);
+
 	// 2-dimensional gizmos
 	static void		add2DLine(const glm::vec2& start, const glm::vec2& end, const glm::vec4& colour);
 	static void		add2DLine(const glm::vec2& start, const glm::vec2& end, const glm::vec4& colour0, const glm::vec4& colour1);	
@@ -93,9 +155,30 @@ public:
 private:
 
 	Gizmos(unsigned int maxLines, unsigned int maxTris,
-		   unsigned int max2DLines, unsigned int max2DTris);
+		   unsigned int max2DLines, unsigned int max2DTris,
+		   unsigned int maxInstances);
 	~Gizmos();
 
+	// the unit meshes instanced primitives are drawn from
+	enum Primitive {
+		SPHERE,
+		CYLINDER,
+		BOX,
+		DISK,
+		PRIMITIVE_COUNT
+	};
+
+	// transparent instances are drawn in batches after the opaque ones
+	static const unsigned int BATCH_COUNT = PRIMITIVE_COUNT * 2;
+
+	// scale is applied before transform, which only rotates and moves the primitive
+	static void		addInstance(Primitive primitive, const glm::vec3& center, const glm::vec3& scale,
+								const glm::vec4& colour, const glm::mat4* transform);
+
+	// sorts the instances into batches in the instance stream
+	void			writeInstances(unsigned int instanceCount);
+	void			drawInstances(const glm::mat4& projectionView, unsigned int firstBatch, unsigned int lastBatch);
+
 	struct GizmoVertex {
 		float x, y, z, w;
 		float r, g, b, a;
@@ -112,45 +195,191 @@ private:
 		GizmoVertex v2;
 	};
 
-	unsigned int	m_shader;
+	struct GizmoInstance {
+		float transform[16];
+		float r, g, b, a;
+	};
 
-	// line data
-	unsigned int	m_maxLines;
-	unsigned int	m_lineCount;
-	GizmoLine*		m_lines;
+	// where each attrib of a vertex and an instance is, vertices at locations
+	// 0 and 1, instances at 2 to 6
+	static constexpr sns::VertexLayout VERTEX_LAYOUT = sns::makeVertexLayout<GizmoVertex>(
+		SNS_VERTEX_ATTRIBUTE(GizmoVertex, x, 0, FLOAT4),
+		SNS_VERTEX_ATTRIBUTE(GizmoVertex, r, 1, FLOAT4));
+	static constexpr sns::VertexLayout INSTANCE_LAYOUT = sns::makeVertexLayout<GizmoInstance>(
+		SNS_VERTEX_ATTRIBUTE(GizmoInstance, transform, 2, MAT4),
+		SNS_VERTEX_ATTRIBUTE(GizmoInstance, r, 6, FLOAT4));
+	static_assert(sns::isValidLayout(VERTEX_LAYOUT), "GizmoVertex layout is invalid");
+	static_assert(sns::isValidLayout(INSTANCE_LAYOUT), "GizmoInstance layout is invalid");
+
+	// the size of a chunk of a ChunkedArray, whatever it holds
+	static const unsigned int CHUNK_BYTES = 64 * 1024;
+
+	// the pool every chunk comes from, which outlives the singleton
+	static sns::BlockPool&	chunkPool();
+
+	// grows a chunk at a time, so adding never moves what is already stored,
+	// and the chunks are kept after clear for the next frame. chunks come from
+	// one pool, so command buffers of earlier singletons hand theirs on
+	template <typename T>
+	class ChunkedArray {
+	public:
+		static const unsigned int CHUNK_SIZE = CHUNK_BYTES / sizeof(T);
+
+		ChunkedArray() : m_count(0) {}
+		~ChunkedArray() { for (T* chunk : m_chunks) chunkPool().free(chunk); }
+		ChunkedArray(const ChunkedArray&) = delete;
+		ChunkedArray& operator=(const ChunkedArray&) = delete;
+
+		T& push() {
+			if (m_count == m_chunks.size() * CHUNK_SIZE)
+				m_chunks.push_back(static_cast<T*>(chunkPool().allocate()));
+			unsigned int index = m_count++;
+			return m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE];
+		}
+
+		// adds up to count elements as one run inside a chunk, returning the first, and
+		// lowers count to how many fit. called again for the rest
+		T* pushRun(unsigned int& count) {
+			if (m_count == m_chunks.size() * CHUNK_SIZE)
+				m_chunks.push_back(static_cast<T*>(chunkPool().allocate()));
+			unsigned int index = m_count;
+			unsigned int room = CHUNK_SIZE - index % CHUNK_SIZE;
+			if (count > room)
+				count = room;
+			m_count += count;
+			return &m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE];
+		}
+
+		const T& operator[](unsigned int index) const { return m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]; }
+
+		// copies every element into dst, which needs room for size() elements
+		void copyTo(T* dst) const {
+			for (unsigned int first = 0; first < m_count; first += CHUNK_SIZE) {
+				unsigned int count = m_count - first < CHUNK_SIZE ? m_count - first : CHUNK_SIZE;
+				memcpy(dst + first, m_chunks[first / CHUNK_SIZE], count * sizeof(T));
+			}
+		}
+
+		void			clear() { m_count = 0; }
+		unsigned int	size() const { return m_count; }
+
+	private:
+		std::vector<T*>	m_chunks;
+		unsigned int	m_count;
+	};
+
+	// everything one thread has added since the last clear. each thread adds to its own,
+	// so only the first add on a thread takes a lock
+	struct CommandBuffer {
+		ChunkedArray<GizmoLine>		lines;
+		ChunkedArray<GizmoTri>		tris;
+		ChunkedArray<GizmoTri>		transparentTris;
+		ChunkedArray<GizmoLine>		lines2D;
+		ChunkedArray<GizmoTri>		tris2D;
+		ChunkedArray<GizmoInstance>	instances;
+		ChunkedArray<unsigned char>	instanceBatches;
+	};
+
+	// returns the calling thread's command buffer, or nullptr without a singleton. while the
+	// thread records a layer it is the layer's
+	static CommandBuffer*	commands();
+
+	// the layer the calling thread is recording, or nullptr
+	static CommandBuffer*&	recordingLayer();
+
+	// a retained layer's static buffer, its lines then triangles then transparent triangles,
+	// and what was recorded for it until draw uploads it
+	struct Layer {
+		unsigned int	vao, vbo;
+		unsigned int	lineCount, triCount, transparentTriCount;
+		CommandBuffer*	recorded;
+		bool			recording;
+		bool			visible;
+		bool			used;
+	};
 
-	unsigned int	m_lineVAO;
-	unsigned int 	m_lineVBO;
+	// uploads the layers recorded since the last draw, replacing their buffers
+	void			uploadLayers();
 
-	// triangle data
+	// frees a layer's buffers
+	static void		releaseLayer(Layer& layer);
+
+	// the total of one kind of primitive across every thread
+	template <typename T>
+	unsigned int	count(ChunkedArray<T> CommandBuffer::*array) const;
+
+	// grows one category's share of a vertex pool to fit count primitives, counting any overflow
+	void			reserveCategory(unsigned int& capacity, unsigned int count);
+
+	// recreates a vertex pool if a frame's region holds fewer than vertexCount vertices
+	void			reservePool(sns::StreamingBuffer& pool, unsigned int vao, unsigned int vertexCount);
+
+	// copies one kind of primitive from every thread to dst, returns the end of what was copied
+	template <typename T>
+	T*				copyPrimitives(ChunkedArray<T> CommandBuffer::*array, T* dst) const;
+
+	// writes the transparent triangles to dst furthest first, radix sorted on the depth of their centres
+	void			writeSortedTransparentTris(const glm::mat4& projectionView, unsigned int count, GizmoTri* dst);
+
+	unsigned int	m_shader;
+	int				m_projectionViewUniform;
+
+	// lines, triangles and transparent triangles share one pool of vertices. a frame's region
+	// holds the lines, then the triangles, then the sorted transparent triangles, so they are
+	// written and fenced once however many categories are drawn
+	unsigned int	m_maxLines;
 	unsigned int	m_maxTris;
-	unsigned int	m_triCount;
-	GizmoTri*		m_tris;
+	unsigned int	m_maxTransparentTris;
 
-	unsigned int	m_triVAO;
-	unsigned int 	m_triVBO;
-	
-	unsigned int	m_transparentTriCount;
-	GizmoTri*		m_transparentTris;
+	unsigned int	m_vertexPoolVAO;
+	sns::StreamingBuffer	m_vertexPool;
 
-	unsigned int	m_transparentTriVAO;
-	unsigned int 	m_transparentTriVBO;
+	// the transparent triangles of every thread and their sort keys, kept between frames
+	std::vector<GizmoTri>	m_sortTris;
+	std::vector<uint32_t>	m_sortKeys;
+	std::vector<uint32_t>	m_sortIndices;
+	std::vector<uint32_t>	m_sortScratch;
 	
-	// 2D line data
+	// 2D lines then triangles share another pool, drawn later with their own projection
 	unsigned int	m_max2DLines;
-	unsigned int	m_2DlineCount;
-	GizmoLine*		m_2Dlines;
+	unsigned int	m_max2DTris;
 
-	unsigned int	m_2DlineVAO;
-	unsigned int 	m_2DlineVBO;
+	unsigned int	m_2DVertexPoolVAO;
+	sns::StreamingBuffer	m_2DVertexPool;
 
-	// 2D triangle data
-	unsigned int	m_max2DTris;
-	unsigned int	m_2DtriCount;
-	GizmoTri*		m_2Dtris;
+	// instanced primitive data
+	unsigned int	m_instanceShader;
+	int				m_instanceProjectionViewUniform;
+
+	unsigned int	m_maxInstances;
+
+	unsigned int	m_primitiveVBO;
+	unsigned int	m_primitiveFirst[PRIMITIVE_COUNT];
+	unsigned int	m_primitiveVertexCount[PRIMITIVE_COUNT];
+
+	unsigned int	m_instanceVAO;
+	sns::StreamingBuffer	m_instanceStream;
+
+	// where each batch starts in the stream this frame
+	unsigned int	m_batchFirst[BATCH_COUNT];
+	unsigned int	m_batchCount[BATCH_COUNT];
+
+	// whether this frame's instances are in the stream already, since the last clear
+	bool			m_instancesWritten;
+
+	// the retained layers, a destroyed one's slot is reused by the next created
+	std::vector<Layer>	m_layers;
+
+	// every thread's command buffer, the mutex is only held while a thread registers
+	std::vector<CommandBuffer*>	m_commandBuffers;
+	std::mutex		m_commandMutex;
+
+	// the command buffers a thread registered belong to the singleton of this generation
+	unsigned int	m_generation;
+	static unsigned int	sm_generation;
 
-	unsigned int	m_2DtriVAO;
-	unsigned int 	m_2DtriVBO;
+	// primitives that didn't fit the sizes given to create and made a stream grow
+	unsigned int	m_overflowCount;
 
 	static Gizmos*	sm_singleton;
 };
@@ -0,0 +1,627 @@
+/**
+	GltfFile.cpp
+
+	Purpose: GltfFile.cpp is the source file for the GltfFile class. The
+			GltfFile reads a glTF 2.0 model, either the .gltf JSON with
+			its buffers beside it or a single .glb, and reads the
+			arrays its accessors describe out of the buffers.
+
+	@author Nathan Nette
+*/
+#include "GltfFile.h"
+#include "MeshCodec.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// The start of a .glb, "glTF", and its two kinds of chunk.
+	const uint32_t GLB_MAGIC = 0x46546c67;
+	const uint32_t GLB_JSON = 0x4e4f534a;
+	const uint32_t GLB_BINARY = 0x004e4942;
+
+	int getInt(const sns::JsonValue& a_object, const char* a_name, int a_default)
+	{
+		const sns::JsonValue* value = a_object.find(a_name);
+		return value != nullptr && value->type == sns::JsonValue::NUMBER ? (int)value->number : a_default;
+	}
+
+	// The extensions a model can require and still be read.
+	const char* const SUPPORTED_EXTENSIONS[] = {
+		"EXT_meshopt_compression", "KHR_meshopt_compression"
+	};
+
+	// A buffer or buffer view's meshopt compression, from either name.
+	const sns::JsonValue* findMeshopt(const sns::JsonValue& a_object)
+	{
+		const sns::JsonValue* extensions = a_object.find("extensions");
+		if (extensions == nullptr)
+			return nullptr;
+		const sns::JsonValue* meshopt = extensions->find("EXT_meshopt_compression");
+		return meshopt != nullptr ? meshopt : extensions->find("KHR_meshopt_compression");
+	}
+
+	unsigned int getComponentSize(unsigned int a_type)
+	{
+		switch (a_type)
+		{
+		case sns::GltfFile::BYTE:
+		case sns::GltfFile::UNSIGNED_BYTE:
+			return 1;
+		case sns::GltfFile::SHORT:
+		case sns::GltfFile::UNSIGNED_SHORT:
+			return 2;
+		case sns::GltfFile::UNSIGNED_INT:
+		case sns::GltfFile::FLOAT:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	unsigned int getComponentCount(const std::string& a_type)
+	{
+		static const struct { const char* name; unsigned int count; } types[] = {
+			{ "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 },
+			{ "MAT2", 4 }, { "MAT3", 9 }, { "MAT4", 16 }
+		};
+		for (const auto& type : types)
+		{
+			if (a_type == type.name)
+				return type.count;
+		}
+		return 0;
+	}
+
+	// Reads one component, which the buffer needn't align.
+	template <typename T>
+	T readAs(const unsigned char* a_data)
+	{
+		T value;
+		memcpy(&value, a_data, sizeof(T));
+		return value;
+	}
+
+	float readFloat(const unsigned char* a_data, unsigned int a_type, bool a_normalised)
+	{
+		switch (a_type)
+		{
+		case sns::GltfFile::BYTE:
+		{
+			float value = (float)readAs<int8_t>(a_data);
+			return a_normalised ? (value / 127.0f < -1.0f ? -1.0f : value / 127.0f) : value;
+		}
+		case sns::GltfFile::UNSIGNED_BYTE:
+			return a_normalised ? readAs<uint8_t>(a_data) / 255.0f : (float)readAs<uint8_t>(a_data);
+		case sns::GltfFile::SHORT:
+		{
+			float value = (float)readAs<int16_t>(a_data);
+			return a_normalised ? (value / 32767.0f < -1.0f ? -1.0f : value / 32767.0f) : value;
+		}
+		case sns::GltfFile::UNSIGNED_SHORT:
+			return a_normalised ? readAs<uint16_t>(a_data) / 65535.0f : (float)readAs<uint16_t>(a_data);
+		case sns::GltfFile::UNSIGNED_INT:
+			return (float)readAs<uint32_t>(a_data);
+		default:
+			return readAs<float>(a_data);
+		}
+	}
+}
+
+namespace sns
+{
+	GltfFile::GltfFile()
+	{
+	}
+
+	/**
+		load reads a model through the FileSystem, a .glb if the file
+			starts with its magic and the JSON form otherwise.
+
+			@param1 a_filename is the model.
+
+			@return false if it or a buffer couldn't be read, any error
+					is printed.
+	*/
+	bool GltfFile::load(const char* a_filename)
+	{
+		m_filename = a_filename;
+		m_root = JsonValue();
+		m_bufferFiles.clear();
+		m_bufferPaths.clear();
+		m_buffers.clear();
+		m_decodedViews.clear();
+
+		if (FileSystem::instance().open(a_filename, m_file) == false)
+		{
+			printf("Failed to read model %s\n", a_filename);
+			return false;
+		}
+
+		uint32_t magic = 0;
+		if (m_file.getSize() >= sizeof(magic))
+			memcpy(&magic, m_file.getData(), sizeof(magic));
+
+		bool read = magic == GLB_MAGIC ?
+			readGlb(m_file.getData(), m_file.getSize()) :
+			readJson((const char*)m_file.getData(), m_file.getSize()) && openBuffers(nullptr, 0);
+		if (read == false || decodeViews() == false)
+		{
+			m_file.close();
+			m_bufferFiles.clear();
+			m_buffers.clear();
+			m_decodedViews.clear();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		getItem returns an object from one of the model's top level
+			arrays, such as "nodes" or "accessors".
+
+			@param1 a_array is the array's name.
+
+			@param2 a_index is the object's index in it.
+
+			@return the object, or nullptr if there isn't one.
+	*/
+	const JsonValue* GltfFile::getItem(const char* a_array, int a_index) const
+	{
+		const JsonValue* array = m_root.find(a_array);
+		if (array == nullptr || a_index < 0 || (size_t)a_index >= array->items.size())
+			return nullptr;
+		return &array->items[a_index];
+	}
+
+	/**
+		getCount returns how many objects one of the model's top level
+			arrays holds.
+
+			@param1 a_array is the array's name.
+	*/
+	unsigned int GltfFile::getCount(const char* a_array) const
+	{
+		const JsonValue* array = m_root.find(a_array);
+		return array != nullptr ? (unsigned int)array->items.size() : 0;
+	}
+
+	/**
+		getAccessorCount returns how many elements an accessor has.
+
+			@param1 a_accessor is the accessor's index.
+
+			@return 0 if there is no such accessor.
+	*/
+	unsigned int GltfFile::getAccessorCount(int a_accessor) const
+	{
+		const JsonValue* accessor = getItem("accessors", a_accessor);
+		return accessor != nullptr ? (unsigned int)getInt(*accessor, "count", 0) : 0;
+	}
+
+	/**
+		readFloats reads an accessor as floats. Normalised integers are
+			scaled into 0 to 1, or -1 to 1, and the rest are converted
+			as they are.
+
+			@param1 a_accessor is the accessor's index.
+
+			@param2 a_components is how many floats each element is read
+					into. Components the accessor lacks are left as they
+					are, ones it has past these are skipped.
+
+			@param3 a_floats is where they are written, room for
+					getAccessorCount elements.
+
+			@return false if the accessor can't be read.
+	*/
+	bool GltfFile::readFloats(int a_accessor, unsigned int a_components, float* a_floats) const
+	{
+		Accessor accessor;
+		if (findAccessor(a_accessor, accessor) == false)
+			return false;
+
+		unsigned int components = accessor.components < a_components ? accessor.components : a_components;
+		unsigned int size = getComponentSize(accessor.componentType);
+		for (unsigned int i = 0; i < accessor.count; ++i)
+		{
+			float* element = a_floats + (size_t)i * a_components;
+			const unsigned char* data = accessor.data != nullptr ? accessor.data + i * accessor.stride : nullptr;
+			for (unsigned int c = 0; c < components; ++c)
+				element[c] = data != nullptr ? readFloat(data + c * size, accessor.componentType, accessor.normalised) : 0.0f;
+		}
+		return true;
+	}
+
+	/**
+		readUnsigned reads an accessor of integers, as indices and joints
+			are stored.
+
+			@param1 a_accessor is the accessor's index.
+
+			@param2 a_components is how many values each element is read
+					into, as in readFloats.
+
+			@param3 a_values is where they are written.
+
+			@return false if the accessor can't be read or isn't
+					integers.
+	*/
+	bool GltfFile::readUnsigned(int a_accessor, unsigned int a_components, unsigned int* a_values) const
+	{
+		Accessor accessor;
+		if (findAccessor(a_accessor, accessor) == false)
+			return false;
+		if (accessor.componentType != UNSIGNED_BYTE && accessor.componentType != UNSIGNED_SHORT &&
+			accessor.componentType != UNSIGNED_INT)
+		{
+			printf("%s: accessor %d isn't unsigned integers\n", m_filename.c_str(), a_accessor);
+			return false;
+		}
+
+		unsigned int components = accessor.components < a_components ? accessor.components : a_components;
+		unsigned int size = getComponentSize(accessor.componentType);
+		for (unsigned int i = 0; i < accessor.count; ++i)
+		{
+			unsigned int* element = a_values + (size_t)i * a_components;
+			const unsigned char* data = accessor.data != nullptr ? accessor.data + i * accessor.stride : nullptr;
+			for (unsigned int c = 0; c < components; ++c)
+			{
+				if (data == nullptr)
+					element[c] = 0;
+				else if (size == 1)
+					element[c] = readAs<uint8_t>(data + c);
+				else if (size == 2)
+					element[c] = readAs<uint16_t>(data + c * 2);
+				else
+					element[c] = readAs<uint32_t>(data + c * 4);
+			}
+		}
+		return true;
+	}
+
+	/**
+		readNodeTransform reads a node's transform relative to its parent,
+			given as a matrix or as its parts.
+
+			@param1 a_node is the node.
+
+			@param2 a_translation, a_rotation and a_scale are set to it.
+	*/
+	void GltfFile::readNodeTransform(const JsonValue& a_node, glm::vec3& a_translation, glm::quat& a_rotation,
+		glm::vec3& a_scale)
+	{
+		auto readFloats = [&a_node](const char* a_name, float* a_floats, unsigned int a_count)
+		{
+			const JsonValue* value = a_node.find(a_name);
+			if (value == nullptr || value->type != JsonValue::ARRAY || value->items.size() < a_count)
+				return false;
+			for (unsigned int i = 0; i < a_count; ++i)
+				a_floats[i] = (float)value->items[i].number;
+			return true;
+		};
+
+		glm::mat4 matrix;
+		if (readFloats("matrix", &matrix[0][0], 16))
+		{
+			glm::vec3 skew;
+			glm::vec4 perspective;
+			glm::decompose(matrix, a_scale, a_rotation, a_translation, skew, perspective);
+			return;
+		}
+
+		// glTF's rotations are x, y, z then w, glm's constructor takes w first.
+		float rotation[4] = { 0, 0, 0, 1 };
+		a_translation = glm::vec3(0);
+		a_scale = glm::vec3(1);
+		readFloats("translation", &a_translation[0], 3);
+		readFloats("rotation", rotation, 4);
+		readFloats("scale", &a_scale[0], 3);
+		a_rotation = glm::quat(rotation[3], rotation[0], rotation[1], rotation[2]);
+	}
+
+	/**
+		readNodeMatrix reads a node's transform relative to its parent as
+			a matrix.
+
+			@param1 a_node is the node.
+	*/
+	glm::mat4 GltfFile::readNodeMatrix(const JsonValue& a_node)
+	{
+		const JsonValue* value = a_node.find("matrix");
+		if (value != nullptr && value->type == JsonValue::ARRAY && value->items.size() >= 16)
+		{
+			glm::mat4 matrix;
+			for (unsigned int i = 0; i < 16; ++i)
+				matrix[i / 4][i % 4] = (float)value->items[i].number;
+			return matrix;
+		}
+
+		glm::vec3 translation, scale;
+		glm::quat rotation;
+		readNodeTransform(a_node, translation, rotation, scale);
+		return glm::scale(glm::translate(glm::mat4(1), translation) * glm::mat4_cast(rotation), scale);
+	}
+
+	/**
+		readGlb reads a .glb: its header, the JSON chunk and the binary
+			chunk after it, which is the first buffer.
+
+			@param1 a_data is the file.
+
+			@param2 a_size is its size in bytes.
+	*/
+	bool GltfFile::readGlb(const unsigned char* a_data, size_t a_size)
+	{
+		uint32_t header[3] = {};
+		if (a_size >= sizeof(header))
+			memcpy(header, a_data, sizeof(header));
+		if (header[1] != 2 || header[2] > a_size)
+		{
+			printf("%s isn't a version 2 .glb\n", m_filename.c_str());
+			return false;
+		}
+
+		const unsigned char* json = nullptr;
+		const unsigned char* binary = nullptr;
+		size_t jsonSize = 0;
+		size_t binarySize = 0;
+		size_t offset = sizeof(header);
+		while (offset + 8 <= header[2])
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, a_data + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			if (chunk[0] > header[2] - offset)
+				break;
+
+			if (chunk[1] == GLB_JSON && json == nullptr)
+			{
+				json = a_data + offset;
+				jsonSize = chunk[0];
+			}
+			else if (chunk[1] == GLB_BINARY && binary == nullptr)
+			{
+				binary = a_data + offset;
+				binarySize = chunk[0];
+			}
+			offset += chunk[0];
+		}
+
+		if (json == nullptr)
+		{
+			printf("%s has no JSON chunk\n", m_filename.c_str());
+			return false;
+		}
+		return readJson((const char*)json, jsonSize) && openBuffers(binary, binarySize);
+	}
+
+	/**
+		readJson reads the model's JSON.
+
+			@param1 a_text is the JSON.
+
+			@param2 a_size is its size in bytes.
+	*/
+	bool GltfFile::readJson(const char* a_text, size_t a_size)
+	{
+		JsonReader reader(a_text, a_size);
+		if (reader.read(m_root) == false)
+		{
+			printf("%s(%u): %s\n", m_filename.c_str(), reader.getLine(), reader.getError().c_str());
+			return false;
+		}
+		if (m_root.type != JsonValue::OBJECT)
+		{
+			printf("%s isn't a glTF model\n", m_filename.c_str());
+			return false;
+		}
+
+		// A required extension changes what the model means, so one that
+		//	isn't known can't be ignored.
+		const JsonValue* required = m_root.find("extensionsRequired");
+		for (size_t i = 0; required != nullptr && i < required->items.size(); ++i)
+		{
+			bool supported = false;
+			for (const char* extension : SUPPORTED_EXTENSIONS)
+				supported |= required->items[i].string == extension;
+			if (supported == false)
+			{
+				printf("%s requires %s, which isn't supported\n", m_filename.c_str(), required->items[i].string.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+		openBuffers finds every buffer the JSON names. Those with a uri
+			are opened beside the model, the one without is the .glb's
+			binary chunk.
+
+			A buffer marked as a meshopt fallback is left empty if it
+			has no uri, its views are all decoded from other buffers.
+
+			@param1 a_binary is the binary chunk, or nullptr.
+
+			@param2 a_binarySize is its size in bytes.
+	*/
+	bool GltfFile::openBuffers(const unsigned char* a_binary, size_t a_binarySize)
+	{
+		std::string directory = m_filename.substr(0, m_filename.find_last_of("/\\") + 1);
+
+		for (unsigned int i = 0; i < getCount("buffers"); ++i)
+		{
+			const JsonValue& value = *getItem("buffers", i);
+			const JsonValue* uri = value.find("uri");
+			size_t size = (size_t)getInt(value, "byteLength", 0);
+
+			Buffer buffer = { a_binary, a_binarySize };
+			const JsonValue* meshopt = findMeshopt(value);
+			const JsonValue* fallback = meshopt != nullptr ? meshopt->find("fallback") : nullptr;
+			if (uri == nullptr && fallback != nullptr && fallback->boolean)
+			{
+				m_buffers.push_back({ nullptr, 0 });
+				continue;
+			}
+
+			if (uri != nullptr && uri->type == JsonValue::STRING)
+			{
+				if (uri->string.compare(0, 5, "data:") == 0)
+				{
+					printf("%s: buffer %u is a data uri, which isn't read\n", m_filename.c_str(), i);
+					return false;
+				}
+
+				std::string path = directory + uri->string;
+				m_bufferPaths.push_back(path);
+				m_bufferFiles.emplace_back(new FileView());
+				if (FileSystem::instance().open(path.c_str(), *m_bufferFiles.back()) == false)
+				{
+					printf("%s: failed to read buffer %s\n", m_filename.c_str(), path.c_str());
+					return false;
+				}
+				buffer.data = m_bufferFiles.back()->getData();
+				buffer.size = m_bufferFiles.back()->getSize();
+			}
+
+			if (buffer.data == nullptr || buffer.size < size)
+			{
+				printf("%s: buffer %u is missing or shorter than %u bytes\n", m_filename.c_str(), i,
+					(unsigned int)size);
+				return false;
+			}
+			m_buffers.push_back(buffer);
+		}
+		return true;
+	}
+
+	/**
+		decodeViews decodes every buffer view compressed with
+			EXT_meshopt_compression, from the buffer its extension names
+			into a copy of the view's size, then undoes its filter.
+	*/
+	bool GltfFile::decodeViews()
+	{
+		m_decodedViews.resize(getCount("bufferViews"));
+		for (unsigned int i = 0; i < m_decodedViews.size(); ++i)
+		{
+			const JsonValue* meshopt = findMeshopt(*getItem("bufferViews", i));
+			if (meshopt == nullptr)
+				continue;
+
+			int buffer = getInt(*meshopt, "buffer", -1);
+			size_t offset = (size_t)getInt(*meshopt, "byteOffset", 0);
+			size_t size = (size_t)getInt(*meshopt, "byteLength", 0);
+			size_t stride = (size_t)getInt(*meshopt, "byteStride", 0);
+			size_t count = (size_t)getInt(*meshopt, "count", 0);
+			const JsonValue* mode = meshopt->find("mode");
+			const JsonValue* filter = meshopt->find("filter");
+			if (buffer < 0 || (size_t)buffer >= m_buffers.size() || m_buffers[buffer].data == nullptr ||
+				offset + size > m_buffers[buffer].size || stride == 0 || mode == nullptr)
+			{
+				printf("%s: compressed buffer view %u is outside its buffer\n", m_filename.c_str(), i);
+				return false;
+			}
+
+			std::vector<unsigned char>& decoded = m_decodedViews[i];
+			decoded.resize(count * stride);
+			const unsigned char* data = m_buffers[buffer].data + offset;
+			bool read = false;
+			if (mode->string == "ATTRIBUTES")
+			{
+				MeshCodec::Filter type = MeshCodec::FILTER_NONE;
+				if (filter != nullptr && filter->string == "OCTAHEDRAL")
+					type = MeshCodec::FILTER_OCTAHEDRAL;
+				else if (filter != nullptr && filter->string == "QUATERNION")
+					type = MeshCodec::FILTER_QUATERNION;
+				else if (filter != nullptr && filter->string == "EXPONENTIAL")
+					type = MeshCodec::FILTER_EXPONENTIAL;
+				read = MeshCodec::decodeVertexBuffer(decoded.data(), count, stride, data, size) &&
+					MeshCodec::decodeFilter(type, decoded.data(), count, stride);
+			}
+			else if (mode->string == "TRIANGLES")
+				read = MeshCodec::decodeIndexBuffer(decoded.data(), count, stride, data, size);
+			else if (mode->string == "INDICES")
+				read = MeshCodec::decodeIndexSequence(decoded.data(), count, stride, data, size);
+
+			if (read == false)
+			{
+				printf("%s: compressed buffer view %u can't be decoded\n", m_filename.c_str(), i);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+		findAccessor finds an accessor's elements. Its last element must
+			end inside its view, and the view inside its buffer.
+
+			@param1 a_accessor is the accessor's index.
+
+			@param2 a_found is set to where its elements are, with data
+					nullptr if it has no view and is all zeros.
+	*/
+	bool GltfFile::findAccessor(int a_accessor, Accessor& a_found) const
+	{
+		const JsonValue* accessor = getItem("accessors", a_accessor);
+		if (accessor == nullptr)
+		{
+			printf("%s: there is no accessor %d\n", m_filename.c_str(), a_accessor);
+			return false;
+		}
+
+		const JsonValue* type = accessor->find("type");
+		a_found.data = nullptr;
+		a_found.count = (unsigned int)getInt(*accessor, "count", 0);
+		a_found.components = type != nullptr ? getComponentCount(type->string) : 0;
+		a_found.componentType = (unsigned int)getInt(*accessor, "componentType", 0);
+		const JsonValue* normalised = accessor->find("normalized");
+		a_found.normalised = normalised != nullptr && normalised->boolean;
+
+		unsigned int size = getComponentSize(a_found.componentType);
+		if (a_found.components == 0 || size == 0 || accessor->find("sparse") != nullptr)
+		{
+			printf("%s: accessor %d isn't a type that is read\n", m_filename.c_str(), a_accessor);
+			return false;
+		}
+
+		a_found.stride = a_found.components * size;
+		int viewIndex = getInt(*accessor, "bufferView", -1);
+		const JsonValue* view = getItem("bufferViews", viewIndex);
+		if (view == nullptr)
+			return true;
+
+		int buffer = getInt(*view, "buffer", -1);
+		size_t viewOffset = (size_t)getInt(*view, "byteOffset", 0);
+		size_t viewSize = (size_t)getInt(*view, "byteLength", 0);
+		size_t offset = (size_t)getInt(*accessor, "byteOffset", 0);
+		a_found.stride = (size_t)getInt(*view, "byteStride", (int)a_found.stride);
+
+		size_t end = a_found.count == 0 ? 0 : offset + (a_found.count - 1) * a_found.stride + a_found.components * size;
+		const std::vector<unsigned char>& decoded = m_decodedViews[viewIndex];
+		if (findMeshopt(*view) != nullptr)
+		{
+			if (end > decoded.size())
+			{
+				printf("%s: accessor %d is outside its view\n", m_filename.c_str(), a_accessor);
+				return false;
+			}
+			a_found.data = decoded.data() + offset;
+			return true;
+		}
+
+		if (buffer < 0 || (size_t)buffer >= m_buffers.size() || viewOffset + viewSize > m_buffers[buffer].size ||
+			end > viewSize)
+		{
+			printf("%s: accessor %d is outside its buffer\n", m_filename.c_str(), a_accessor);
+			return false;
+		}
+		a_found.data = m_buffers[buffer].data + viewOffset + offset;
+		return true;
+	}
+}
@@ -0,0 +1,220 @@
+/**
+	GltfFile.h
+
+	Purpose: GltfFile.h is the header file for the GltfFile class. The
+			GltfFile reads a glTF 2.0 model, either the .gltf JSON with
+			its buffers beside it or a single .glb, and reads the
+			arrays its accessors describe out of the buffers.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "FileSystem.h"
+#include "Json.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The GltfFile class holds a glTF model's JSON and its buffers,
+			which stay where the FileSystem opened them: a .glb's binary
+			chunk and any .bin beside a .gltf are read in place rather
+			than copied.
+
+		What the model is made of, its meshes, skins and animations, is
+			left to whoever reads it. They find the objects in the JSON
+			with getItem and read the accessors those objects name into
+			arrays of floats or unsigned ints, whatever the components
+			are stored as.
+
+		Buffer views compressed with EXT_meshopt_compression are the
+			exception, they are decoded by the MeshCodec as the model
+			loads and their accessors read from the decoded copy. The
+			fallback buffers such models carry in their place needn't
+			be there.
+
+		Buffers given as data: URIs and sparse accessors aren't read.
+	*/
+	class GltfFile
+	{
+	public:
+		// glTF's component types, as an accessor's componentType.
+		enum ComponentType
+		{
+			BYTE = 5120,
+			UNSIGNED_BYTE = 5121,
+			SHORT = 5122,
+			UNSIGNED_SHORT = 5123,
+			UNSIGNED_INT = 5125,
+			FLOAT = 5126
+		};
+
+		GltfFile();
+
+		GltfFile(const GltfFile&) = delete;
+		GltfFile& operator=(const GltfFile&) = delete;
+
+		/**
+			load reads a model through the FileSystem, a .glb if the file
+				starts with its magic and the JSON form otherwise.
+
+				@param1 a_filename is the model.
+
+				@return false if it or a buffer couldn't be read, any
+						error is printed.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			getRoot returns the model's JSON.
+		*/
+		const JsonValue& getRoot() const { return m_root; }
+
+		/**
+			getItem returns an object from one of the model's top level
+				arrays, such as "nodes" or "accessors".
+
+				@param1 a_array is the array's name.
+
+				@param2 a_index is the object's index in it.
+
+				@return the object, or nullptr if there isn't one.
+		*/
+		const JsonValue* getItem(const char* a_array, int a_index) const;
+
+		/**
+			getCount returns how many objects one of the model's top level
+				arrays holds.
+
+				@param1 a_array is the array's name.
+		*/
+		unsigned int getCount(const char* a_array) const;
+
+		/**
+			getAccessorCount returns how many elements an accessor has.
+
+				@param1 a_accessor is the accessor's index.
+
+				@return 0 if there is no such accessor.
+		*/
+		unsigned int getAccessorCount(int a_accessor) const;
+
+		/**
+			readFloats reads an accessor as floats. Normalised integers
+				are scaled into 0 to 1, or -1 to 1, and the rest are
+				converted as they are.
+
+				@param1 a_accessor is the accessor's index.
+
+				@param2 a_components is how many floats each element is
+						read into. Components the accessor lacks are
+						left as they are, ones it has past these are
+						skipped.
+
+				@param3 a_floats is where they are written, room for
+						getAccessorCount elements.
+
+				@return false if the accessor can't be read.
+		*/
+		bool readFloats(int a_accessor, unsigned int a_components, float* a_floats) const;
+
+		/**
+			readUnsigned reads an accessor of integers, as indices and
+				joints are stored.
+
+				@param1 a_accessor is the accessor's index.
+
+				@param2 a_components is how many values each element is
+						read into, as in readFloats.
+
+				@param3 a_values is where they are written.
+
+				@return false if the accessor can't be read or isn't
+						integers.
+		*/
+		bool readUnsigned(int a_accessor, unsigned int a_components, unsigned int* a_values) const;
+
+		/**
+			readNodeTransform reads a node's transform relative to its
+				parent, given as a matrix or as its parts.
+
+				@param1 a_node is the node.
+
+				@param2 a_translation, a_rotation and a_scale are set to
+						it.
+		*/
+		static void readNodeTransform(const JsonValue& a_node, glm::vec3& a_translation, glm::quat& a_rotation,
+			glm::vec3& a_scale);
+
+		/**
+			readNodeMatrix reads a node's transform relative to its parent
+				as a matrix.
+
+				@param1 a_node is the node.
+		*/
+		static glm::mat4 readNodeMatrix(const JsonValue& a_node);
+
+		/**
+			getFilename returns the file the model was loaded from.
+		*/
+		const std::string& getFilename() const { return m_filename; }
+
+		/**
+			getBufferPaths returns the path of each file beside the model
+				its buffers were read from, like a .gltf's .bin files.
+		*/
+		const std::vector<std::string>& getBufferPaths() const { return m_bufferPaths; }
+
+	private:
+		// Where an accessor's elements are in the buffers.
+		struct Accessor
+		{
+			const unsigned char* data;
+			size_t stride;
+			unsigned int count;
+			unsigned int components;
+			unsigned int componentType;
+			bool normalised;
+		};
+
+		// A buffer's bytes, in the file they were opened in.
+		struct Buffer
+		{
+			const unsigned char* data;
+			size_t size;
+		};
+
+		// Reads each form, from the whole of the file.
+		bool readGlb(const unsigned char* a_data, size_t a_size);
+		bool readJson(const char* a_text, size_t a_size);
+
+		// Opens the buffers the JSON names, the first can be a .glb's
+		//	binary chunk.
+		bool openBuffers(const unsigned char* a_binary, size_t a_binarySize);
+
+		// Decodes the buffer views compressed with EXT_meshopt_compression.
+		bool decodeViews();
+
+		// Finds an accessor's elements, checking they are in its buffer.
+		bool findAccessor(int a_accessor, Accessor& a_found) const;
+
+		std::string m_filename;
+		JsonValue m_root;
+		FileView m_file;
+
+		// The .bin files beside a .gltf, each buffer points into one
+		//	of them or m_file.
+		std::vector<std::unique_ptr<FileView>> m_bufferFiles;
+		std::vector<std::string> m_bufferPaths;
+		std::vector<Buffer> m_buffers;
+
+		// Each buffer view's decoded bytes, empty for views that weren't
+		//	compressed.
+		std::vector<std::vector<unsigned char>> m_decodedViews;
+	};
+}
@@ -0,0 +1,316 @@
+/**
+	GltfImporter.cpp
+
+	Purpose: GltfImporter.cpp is the source file for the GltfImporter
+			class. The GltfImporter reads the static meshes of a glTF
+			model into the shapes and materials OBJMesh imports, so a
+			.glb loads as an OBJ would, without its tangents being
+			worked out again.
+
+	@author Nathan Nette
+*/
+#include "GltfImporter.h"
+#include "GltfFile.h"
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cstdio>
+
+namespace
+{
+	// Scenes deeper than this are taken to loop back on themselves.
+	const unsigned int MAX_NODE_DEPTH = 64;
+
+	int getInt(const sns::JsonValue* a_object, const char* a_name, int a_default)
+	{
+		const sns::JsonValue* value = a_object != nullptr ? a_object->find(a_name) : nullptr;
+		return value != nullptr && value->type == sns::JsonValue::NUMBER ? (int)value->number : a_default;
+	}
+
+	float getFloat(const sns::JsonValue* a_object, const char* a_name, float a_default)
+	{
+		const sns::JsonValue* value = a_object != nullptr ? a_object->find(a_name) : nullptr;
+		return value != nullptr && value->type == sns::JsonValue::NUMBER ? (float)value->number : a_default;
+	}
+
+	void getFloats(const sns::JsonValue* a_object, const char* a_name, float* a_floats, unsigned int a_count)
+	{
+		const sns::JsonValue* value = a_object != nullptr ? a_object->find(a_name) : nullptr;
+		for (unsigned int i = 0; value != nullptr && i < a_count && i < value->items.size(); ++i)
+			a_floats[i] = (float)value->items[i].number;
+	}
+
+	// The file a material's texture reference names, or nothing if its
+	//	image is in a buffer.
+	std::string getImageUri(const sns::GltfFile& a_file, const sns::JsonValue* a_textureInfo)
+	{
+		const sns::JsonValue* texture = a_file.getItem("textures", getInt(a_textureInfo, "index", -1));
+		const sns::JsonValue* image = a_file.getItem("images", getInt(texture, "source", -1));
+		const sns::JsonValue* uri = image != nullptr ? image->find("uri") : nullptr;
+		if (uri == nullptr || uri->type != sns::JsonValue::STRING || uri->string.compare(0, 5, "data:") == 0)
+			return std::string();
+		return uri->string;
+	}
+}
+
+namespace sns
+{
+	GltfImporter::GltfImporter()
+	{
+	}
+
+	/**
+		parse reads a model's static meshes, replacing anything read
+			before.
+
+			@param1 a_filename is the model, a .gltf or .glb.
+
+			@param2 a_flipTextureV flips the V texture coordinate, as it
+					would an OBJ's.
+
+			@return false if the model or a primitive can't be read.
+	*/
+	bool GltfImporter::parse(const char* a_filename, bool a_flipTextureV)
+	{
+		m_shapes.clear();
+		m_materials.clear();
+		m_bufferPaths.clear();
+		m_lastError.clear();
+
+		GltfFile file;
+		if (file.load(a_filename) == false)
+		{
+			m_lastError = std::string("Failed to import model ") + a_filename;
+			return false;
+		}
+		m_bufferPaths = file.getBufferPaths();
+
+		// Shapes name their materials, so two with one name get the
+		//	second its index too.
+		m_materials.resize(file.getCount("materials"));
+		for (unsigned int i = 0; i < m_materials.size(); ++i)
+		{
+			readMaterial(file, (int)i, m_materials[i]);
+			bool taken = m_materials[i].name.empty();
+			for (unsigned int j = 0; j < i && taken == false; ++j)
+				taken = m_materials[j].name == m_materials[i].name;
+			if (taken)
+				m_materials[i].name += "#" + std::to_string(i);
+		}
+
+		// The scene's root nodes, or every node no other has as a child if
+		//	the model has no scene.
+		std::vector<int> roots;
+		const JsonValue* scene = file.getItem("scenes", getInt(&file.getRoot(), "scene", 0));
+		const JsonValue* nodes = scene != nullptr ? scene->find("nodes") : nullptr;
+		if (nodes != nullptr)
+		{
+			for (const JsonValue& node : nodes->items)
+				roots.push_back((int)node.number);
+		}
+		else
+		{
+			std::vector<bool> children(file.getCount("nodes"), false);
+			for (unsigned int i = 0; i < children.size(); ++i)
+			{
+				const JsonValue* list = file.getItem("nodes", i)->find("children");
+				for (size_t j = 0; list != nullptr && j < list->items.size(); ++j)
+				{
+					int child = (int)list->items[j].number;
+					if (child >= 0 && (size_t)child < children.size())
+						children[child] = true;
+				}
+			}
+			for (unsigned int i = 0; i < children.size(); ++i)
+			{
+				if (children[i] == false)
+					roots.push_back((int)i);
+			}
+		}
+
+		for (int root : roots)
+		{
+			if (readNode(file, root, glm::mat4(1), a_flipTextureV, 0) == false)
+				return false;
+		}
+		if (m_shapes.empty())
+		{
+			m_lastError = std::string(a_filename) + " has no triangles";
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		readMaterial reads one of a model's materials.
+
+			@param1 a_file is the model.
+
+			@param2 a_material is the material's index, anything that
+					isn't one reads glTF's default material.
+
+			@param3 a_result is the material.
+	*/
+	void GltfImporter::readMaterial(const GltfFile& a_file, int a_material, Material& a_result)
+	{
+		const JsonValue* material = a_file.getItem("materials", a_material);
+		const JsonValue* pbr = material != nullptr ? material->find("pbrMetallicRoughness") : nullptr;
+		const JsonValue* name = material != nullptr ? material->find("name") : nullptr;
+		const JsonValue* alphaMode = material != nullptr ? material->find("alphaMode") : nullptr;
+
+		float base[4] = { 1, 1, 1, 1 };
+		getFloats(pbr, "baseColorFactor", base, 4);
+		glm::vec3 colour(base[0], base[1], base[2]);
+		float metallic = getFloat(pbr, "metallicFactor", 1.0f);
+		float roughness = glm::max(getFloat(pbr, "roughnessFactor", 1.0f), 0.05f);
+
+		a_result.name = name != nullptr ? name->string : std::string();
+		a_result.ambient = colour;
+		a_result.diffuse = colour * (1.0f - metallic);
+		a_result.specular = glm::mix(glm::vec3(0.04f), colour, metallic);
+		a_result.specularPower = glm::clamp(2.0f / (roughness * roughness * roughness * roughness) - 2.0f, 1.0f, 256.0f);
+		a_result.emissive = glm::vec3(0);
+		getFloats(material, "emissiveFactor", &a_result.emissive[0], 3);
+		a_result.opacity = alphaMode != nullptr && alphaMode->string == "BLEND" ? base[3] : 1.0f;
+		a_result.alphaTested = alphaMode != nullptr && alphaMode->string == "MASK";
+
+		a_result.diffuseTexture = getImageUri(a_file, pbr != nullptr ? pbr->find("baseColorTexture") : nullptr);
+		a_result.normalTexture = getImageUri(a_file, material != nullptr ? material->find("normalTexture") : nullptr);
+	}
+
+	/**
+		readNode reads a node's primitives and those of its children.
+
+			@param1 a_file is the model.
+
+			@param2 a_node is the node.
+
+			@param3 a_parent is its parent's transform in the model.
+
+			@param4 a_flipTextureV flips the V texture coordinate, as it
+					would an OBJ's.
+
+			@param5 a_depth is how many nodes are above it.
+	*/
+	bool GltfImporter::readNode(const GltfFile& a_file, int a_node, const glm::mat4& a_parent, bool a_flipTextureV,
+		unsigned int a_depth)
+	{
+		const JsonValue* node = a_file.getItem("nodes", a_node);
+		if (node == nullptr || a_depth >= MAX_NODE_DEPTH)
+		{
+			m_lastError = a_file.getFilename() + " has a node that isn't there or loops";
+			return false;
+		}
+
+		glm::mat4 transform = a_parent * GltfFile::readNodeMatrix(*node);
+		const JsonValue* mesh = a_file.getItem("meshes", getInt(node, "mesh", -1));
+		const JsonValue* primitives = mesh != nullptr ? mesh->find("primitives") : nullptr;
+		for (size_t i = 0; primitives != nullptr && i < primitives->items.size(); ++i)
+		{
+			if (readPrimitive(a_file, primitives->items[i], transform, a_flipTextureV) == false)
+				return false;
+		}
+
+		const JsonValue* children = node->find("children");
+		for (size_t i = 0; children != nullptr && i < children->items.size(); ++i)
+		{
+			if (readNode(a_file, (int)children->items[i].number, transform, a_flipTextureV, a_depth + 1) == false)
+				return false;
+		}
+		return true;
+	}
+
+	/**
+		readPrimitive reads one triangle primitive into a shape, its
+			vertices moved into the model's space. Primitives that aren't
+			triangles are skipped.
+
+			@param1 a_file is the model.
+
+			@param2 a_primitive is the primitive.
+
+			@param3 a_transform is the transform of the node placing it.
+
+			@param4 a_flipTextureV flips the V texture coordinate, as it
+					would an OBJ's.
+	*/
+	bool GltfImporter::readPrimitive(const GltfFile& a_file, const JsonValue& a_primitive, const glm::mat4& a_transform,
+		bool a_flipTextureV)
+	{
+		const JsonValue* attributes = a_primitive.find("attributes");
+		int position = getInt(attributes, "POSITION", -1);
+		unsigned int count = a_file.getAccessorCount(position);
+		if (getInt(&a_primitive, "mode", 4) != 4 || count == 0)
+			return true;
+
+		int normal = getInt(attributes, "NORMAL", -1);
+		int texcoord = getInt(attributes, "TEXCOORD_0", -1);
+		int tangent = getInt(attributes, "TANGENT", -1);
+		std::vector<glm::vec4> positions(count, glm::vec4(0, 0, 0, 1));
+		std::vector<glm::vec4> normals(count, glm::vec4(0));
+		std::vector<glm::vec2> texcoords(count, glm::vec2(0));
+		std::vector<glm::vec4> tangents(count, glm::vec4(0));
+
+		auto matches = [&a_file, count](int a_accessor) { return a_accessor < 0 || a_file.getAccessorCount(a_accessor) == count; };
+		bool read = matches(normal) && matches(texcoord) && matches(tangent) &&
+			a_file.readFloats(position, 3, &positions[0][0]) &&
+			(normal < 0 || a_file.readFloats(normal, 3, &normals[0][0])) &&
+			(texcoord < 0 || a_file.readFloats(texcoord, 2, &texcoords[0][0])) &&
+			(tangent < 0 || a_file.readFloats(tangent, 4, &tangents[0][0]));
+
+		ObjParser::Shape shape;
+		int indices = getInt(&a_primitive, "indices", -1);
+		if (read && indices >= 0)
+		{
+			shape.indices.resize(a_file.getAccessorCount(indices));
+			read = shape.indices.empty() == false && a_file.readUnsigned(indices, 1, shape.indices.data());
+		}
+		else if (read)
+		{
+			for (unsigned int i = 0; i < count; ++i)
+				shape.indices.push_back(i);
+		}
+		shape.indices.resize(shape.indices.size() - shape.indices.size() % 3);
+		for (unsigned int index : shape.indices)
+			read &= index < count;
+		if (read == false)
+		{
+			m_lastError = a_file.getFilename() + ": a primitive can't be read";
+			return false;
+		}
+
+		// A mirroring transform turns the triangles inside out, and the
+		//	tangent frames with them.
+		glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(a_transform));
+		bool mirrored = glm::determinant(glm::mat3(a_transform)) < 0.0f;
+		if (mirrored)
+		{
+			for (size_t i = 0; i < shape.indices.size(); i += 3)
+				std::swap(shape.indices[i + 1], shape.indices[i + 2]);
+		}
+
+		shape.vertices.resize(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			aie::OBJMesh::Vertex& vertex = shape.vertices[i];
+			vertex.position = a_transform * glm::vec4(glm::vec3(positions[i]), 1);
+			glm::vec3 n = normalMatrix * glm::vec3(normals[i]);
+			vertex.normal = glm::vec4(normal >= 0 && glm::dot(n, n) > 0.0f ? glm::normalize(n) : n, 0);
+			vertex.texcoord = glm::vec2(texcoords[i].x, a_flipTextureV ? texcoords[i].y : 1.0f - texcoords[i].y);
+			glm::vec3 t = glm::mat3(a_transform) * glm::vec3(tangents[i]);
+			vertex.tangent = glm::vec4(glm::dot(t, t) > 0.0f ? glm::normalize(t) : t,
+				mirrored ? -tangents[i].w : tangents[i].w);
+		}
+
+		const JsonValue* material = a_primitive.find("material");
+		int materialIndex = material != nullptr ? (int)material->number : -1;
+		if (materialIndex >= 0 && (size_t)materialIndex < m_materials.size())
+			shape.material = m_materials[materialIndex].name;
+		shape.hasNormals = normal >= 0;
+		shape.hasTexcoords = texcoord >= 0;
+		shape.hasTangents = tangent >= 0 && normal >= 0;
+		m_shapes.push_back(std::move(shape));
+		return true;
+	}
+}
@@ -0,0 +1,132 @@
+/**
+	GltfImporter.h
+
+	Purpose: GltfImporter.h is the header file for the GltfImporter
+			class. The GltfImporter reads the static meshes of a glTF
+			model into the shapes and materials OBJMesh imports, so a
+			.glb loads as an OBJ would, without its tangents being
+			worked out again.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "ObjParser.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	class GltfFile;
+	struct JsonValue;
+
+	/**
+		The GltfImporter class walks the nodes of a glTF model's scene
+			and makes a shape of every triangle primitive of every mesh
+			a node places, with the node's transform baked into its
+			vertices. The shapes come out as the ObjParser makes them,
+			a material named on each, and with the model's tangents
+			whenever it has them.
+
+		glTF's metallic roughness materials are turned into the phong
+			ones the lit shaders take. Metals reflect their own colour
+			rather than diffusing it, and rough surfaces spread their
+			highlight. A masked material is alpha tested through its
+			base colour texture's alpha, as the shaders read it.
+
+		Only textures stored as files beside the model are named,
+			images inside a .glb are skipped.
+	*/
+	class GltfImporter
+	{
+	public:
+		/**
+			A material as the lit shaders take it, with the textures it
+				names beside the model.
+		*/
+		struct Material
+		{
+			std::string name;
+			glm::vec3 ambient;
+			glm::vec3 diffuse;
+			glm::vec3 specular;
+			glm::vec3 emissive;
+			float specularPower;
+			float opacity;
+			std::string diffuseTexture;
+			std::string normalTexture;
+			bool alphaTested;
+		};
+
+		GltfImporter();
+
+		GltfImporter(const GltfImporter&) = delete;
+		GltfImporter& operator=(const GltfImporter&) = delete;
+
+		/**
+			parse reads a model's static meshes, replacing anything read
+				before.
+
+				@param1 a_filename is the model, a .gltf or .glb.
+
+				@param2 a_flipTextureV flips the V texture coordinate, as
+						it would an OBJ's. glTF's already start at the top
+						of the image as flipped ones do, so they are only
+						flipped when an OBJ's wouldn't be.
+
+				@return false if the model or a primitive can't be read.
+		*/
+		bool parse(const char* a_filename, bool a_flipTextureV = false);
+
+		/**
+			getShapes returns a shape for each primitive, in the order the
+				scene places them. They can be moved out of.
+		*/
+		std::vector<ObjParser::Shape>& getShapes() { return m_shapes; }
+
+		/**
+			getMaterials returns the model's materials, each with a name
+				no other has, as the shapes name them.
+		*/
+		const std::vector<Material>& getMaterials() const { return m_materials; }
+
+		/**
+			getLastError returns why parse last failed.
+		*/
+		const std::string& getLastError() const { return m_lastError; }
+
+		/**
+			getBufferPaths returns the files beside the model that parse
+				read its buffers from, so a cache of it can be checked
+				against them too.
+		*/
+		const std::vector<std::string>& getBufferPaths() const { return m_bufferPaths; }
+
+		/**
+			readMaterial reads one of a model's materials.
+
+				@param1 a_file is the model.
+
+				@param2 a_material is the material's index, anything that
+						isn't one reads glTF's default material.
+
+				@param3 a_result is the material.
+		*/
+		static void readMaterial(const GltfFile& a_file, int a_material, Material& a_result);
+
+	private:
+		// Reads a node's primitives and those of its children.
+		bool readNode(const GltfFile& a_file, int a_node, const glm::mat4& a_parent, bool a_flipTextureV,
+			unsigned int a_depth);
+
+		// Reads one triangle primitive into a shape.
+		bool readPrimitive(const GltfFile& a_file, const JsonValue& a_primitive, const glm::mat4& a_transform,
+			bool a_flipTextureV);
+
+		std::vector<ObjParser::Shape> m_shapes;
+		std::vector<Material> m_materials;
+		std::vector<std::string> m_bufferPaths;
+		std::string m_lastError;
+	};
+}
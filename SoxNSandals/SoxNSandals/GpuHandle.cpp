@@ -0,0 +1,43 @@
+/**
+	GpuHandle.cpp
+
+	Purpose: GpuHandle.cpp is the source file for the GpuHandle class.
+			The GpuHandle owns the name of a GL object and deletes it
+			when it goes, so the objects holding GL names can be moved
+			into containers without leaking, or deleting, them.
+
+	@author Nathan Nette
+*/
+#include "GpuHandle.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+
+namespace sns
+{
+	void BufferTraits::destroy(unsigned int a_handle)
+	{
+		glDeleteBuffers(1, &a_handle);
+		RenderState::instance().onBufferDeleted(a_handle);
+		GpuMemory::instance().releaseBuffer(a_handle);
+	}
+
+	void VertexArrayTraits::destroy(unsigned int a_handle)
+	{
+		glDeleteVertexArrays(1, &a_handle);
+		RenderState::instance().onVertexArrayDeleted(a_handle);
+	}
+
+	void TextureTraits::destroy(unsigned int a_handle)
+	{
+		glDeleteTextures(1, &a_handle);
+		RenderState::instance().onTextureDeleted(a_handle);
+		GpuMemory::instance().releaseTexture(a_handle);
+	}
+
+	void ProgramTraits::destroy(unsigned int a_handle)
+	{
+		glDeleteProgram(a_handle);
+		RenderState::instance().onProgramDeleted(a_handle);
+	}
+}
@@ -0,0 +1,141 @@
+/**
+	GpuHandle.h
+
+	Purpose: GpuHandle.h is the header file for the GpuHandle class.
+			The GpuHandle owns the name of a GL object and deletes it
+			when it goes, so the objects holding GL names can be moved
+			into containers without leaking, or deleting, them.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+namespace sns
+{
+	/**
+		The GpuHandle class owns one GL name, deleting it with its
+			Traits' destroy when it is destroyed, reset or moved onto.
+			It can't be copied, as two owners would delete the name
+			twice, but it can be moved, leaving the one moved from
+			with 0.
+
+		It converts to the name, so it is passed to GL as it is, and
+			put hands glCreate* and glGen* the address to write a new
+			name to after deleting the old.
+
+		Names are deleted on whichever thread the handle goes on, so
+			handles must be destroyed on the context thread, as
+			everything the RenderState and GpuMemory are told is.
+	*/
+	template<typename Traits>
+	class GpuHandle
+	{
+	public:
+		GpuHandle() : m_handle(0) {}
+
+		/**
+			Takes ownership of a name.
+
+				@param1 a_handle is the GL name, or 0.
+		*/
+		explicit GpuHandle(unsigned int a_handle) : m_handle(a_handle) {}
+
+		/**
+			The deconstructor deletes the name, see reset.
+		*/
+		~GpuHandle() { reset(); }
+
+		GpuHandle(const GpuHandle&) = delete;
+		GpuHandle& operator=(const GpuHandle&) = delete;
+
+		GpuHandle(GpuHandle&& a_other) noexcept : m_handle(a_other.release()) {}
+
+		GpuHandle& operator=(GpuHandle&& a_other) noexcept
+		{
+			if (this != &a_other)
+				reset(a_other.release());
+			return *this;
+		}
+
+		/**
+			get returns the name, 0 if there is none.
+		*/
+		unsigned int get() const { return m_handle; }
+
+		operator unsigned int() const { return m_handle; }
+
+		/**
+			reset deletes the name and takes ownership of another.
+
+				@param1 a_handle is the GL name, or 0.
+		*/
+		void reset(unsigned int a_handle = 0)
+		{
+			if (m_handle != 0 && m_handle != a_handle)
+				Traits::destroy(m_handle);
+			m_handle = a_handle;
+		}
+
+		/**
+			release gives up ownership of the name without deleting it.
+
+				@return the name.
+		*/
+		unsigned int release()
+		{
+			unsigned int handle = m_handle;
+			m_handle = 0;
+			return handle;
+		}
+
+		/**
+			put deletes the name and returns where a new one is to be
+				written, for glCreate* and glGen*.
+		*/
+		unsigned int* put()
+		{
+			reset();
+			return &m_handle;
+		}
+
+	private:
+		unsigned int m_handle;
+	};
+
+	/**
+		Deletes a buffer, telling the RenderState and GpuMemory.
+	*/
+	struct BufferTraits
+	{
+		static void destroy(unsigned int a_handle);
+	};
+
+	/**
+		Deletes a vertex array, telling the RenderState.
+	*/
+	struct VertexArrayTraits
+	{
+		static void destroy(unsigned int a_handle);
+	};
+
+	/**
+		Deletes a texture, telling the RenderState and GpuMemory.
+	*/
+	struct TextureTraits
+	{
+		static void destroy(unsigned int a_handle);
+	};
+
+	/**
+		Deletes a program, telling the RenderState.
+	*/
+	struct ProgramTraits
+	{
+		static void destroy(unsigned int a_handle);
+	};
+
+	typedef GpuHandle<BufferTraits> BufferHandle;
+	typedef GpuHandle<VertexArrayTraits> VertexArrayHandle;
+	typedef GpuHandle<TextureTraits> TextureHandle;
+	typedef GpuHandle<ProgramTraits> ProgramHandle;
+}
@@ -0,0 +1,324 @@
+/**
+	GpuMemory.cpp
+
+	Purpose: GpuMemory.cpp is the source file for the GpuMemory class.
+			The GpuMemory class keeps a record of every buffer and
+			texture the engine allocates on the gpu.
+
+	@author Nathan Nette
+*/
+#include "GpuMemory.h"
+#include "Profiler.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace
+{
+	// Shown in the report, and as the profiler's counters. Counter names
+	//	must outlive the profiler, so they are literals too.
+	const char* const CATEGORY_NAMES[sns::GpuMemory::CATEGORY_COUNT] =
+	{
+		"Meshes", "Textures", "Render targets", "Particles", "Streaming",
+		"Lighting", "Culling", "Gizmos", "Uniforms"
+	};
+	const char* const CATEGORY_COUNTERS[sns::GpuMemory::CATEGORY_COUNT] =
+	{
+		"GPU MB meshes", "GPU MB textures", "GPU MB render targets", "GPU MB particles", "GPU MB streaming",
+		"GPU MB lighting", "GPU MB culling", "GPU MB gizmos", "GPU MB uniforms"
+	};
+
+	const double MEGABYTE = 1024.0 * 1024.0;
+
+	// Textures' handles are kept apart from buffers' above this bit.
+	const unsigned long long TEXTURE_KEY = 1ull << 32;
+}
+
+namespace sns
+{
+	/**
+		instance returns the record of the GL context's allocations.
+	*/
+	GpuMemory& GpuMemory::instance()
+	{
+		static GpuMemory memory;
+		return memory;
+	}
+
+	GpuMemory::GpuMemory()
+		: m_allocations(),
+		m_categoryBytes(),
+		m_total(0),
+		m_peak(0),
+		m_budget(0),
+		m_overBudget(false)
+	{
+	}
+
+	/**
+		trackBuffer records a buffer's storage.
+
+			@param1 a_buffer is the GL handle of the buffer.
+
+			@param2 a_bytes is the size of its storage.
+
+			@param3 a_category is what it is for.
+
+			@param4 a_owner is the class that made it.
+	*/
+	void GpuMemory::trackBuffer(unsigned int a_buffer, unsigned long long a_bytes, Category a_category, const char* a_owner)
+	{
+		track(a_buffer, a_bytes, a_category, a_owner);
+	}
+
+	/**
+		trackTexture records a texture's storage.
+
+			@param1 a_texture is the GL handle of the texture.
+
+			@param2 a_bytes is the size of its storage.
+
+			@param3 a_category is what it is for.
+
+			@param4 a_owner is the class that made it.
+	*/
+	void GpuMemory::trackTexture(unsigned int a_texture, unsigned long long a_bytes, Category a_category, const char* a_owner)
+	{
+		track(TEXTURE_KEY | a_texture, a_bytes, a_category, a_owner);
+	}
+
+	/**
+		releaseBuffer forgets a buffer.
+
+			@param1 a_buffer is the GL handle of the buffer.
+	*/
+	void GpuMemory::releaseBuffer(unsigned int a_buffer)
+	{
+		release(a_buffer);
+	}
+
+	/**
+		releaseTexture forgets a texture.
+
+			@param1 a_texture is the GL handle of the texture.
+	*/
+	void GpuMemory::releaseTexture(unsigned int a_texture)
+	{
+		release(TEXTURE_KEY | a_texture);
+	}
+
+	/**
+		track records an allocation, taking off the one it replaces.
+			Handle 0 is never an object, so it's ignored.
+	*/
+	void GpuMemory::track(unsigned long long a_key, unsigned long long a_bytes, Category a_category, const char* a_owner)
+	{
+		if ((a_key & ~TEXTURE_KEY) == 0)
+			return;
+
+		release(a_key);
+		m_allocations[a_key] = { a_bytes, a_category, a_owner };
+		m_categoryBytes[a_category] += a_bytes;
+		m_total += a_bytes;
+		if (m_total > m_peak)
+			m_peak = m_total;
+	}
+
+	/**
+		release forgets an allocation, if there is one.
+	*/
+	void GpuMemory::release(unsigned long long a_key)
+	{
+		auto found = m_allocations.find(a_key);
+		if (found == m_allocations.end())
+			return;
+
+		m_categoryBytes[found->second.category] -= found->second.bytes;
+		m_total -= found->second.bytes;
+		m_allocations.erase(found);
+	}
+
+	/**
+		getCategoryName returns the name a category is shown with.
+
+			@param1 a_category is the category.
+	*/
+	const char* GpuMemory::getCategoryName(Category a_category)
+	{
+		return a_category < CATEGORY_COUNT ? CATEGORY_NAMES[a_category] : "Unknown";
+	}
+
+	/**
+		update sends the totals to the profiler, and warns once each time
+			the total goes over the budget.
+	*/
+	void GpuMemory::update()
+	{
+		Profiler::setCounter("GPU MB total", m_total / MEGABYTE);
+		for (unsigned int i = 0; i < CATEGORY_COUNT; ++i)
+			Profiler::setCounter(CATEGORY_COUNTERS[i], m_categoryBytes[i] / MEGABYTE);
+
+		bool overBudget = m_budget != 0 && m_total > m_budget;
+		if (overBudget && m_overBudget == false)
+		{
+			printf("GPU memory: %.1f MB is over the %.1f MB budget\n", m_total / MEGABYTE, m_budget / MEGABYTE);
+			printReport();
+		}
+		m_overBudget = overBudget;
+	}
+
+	/**
+		printReport prints the totals of every category, then of every
+			owner in each.
+	*/
+	void GpuMemory::printReport() const
+	{
+		// Owners are few, so a list is quicker than a map.
+		struct OwnerTotal
+		{
+			Category category;
+			const char* owner;
+			unsigned long long bytes;
+			unsigned int count;
+		};
+		std::vector<OwnerTotal> owners;
+		for (auto& allocation : m_allocations)
+		{
+			const Allocation& a = allocation.second;
+			OwnerTotal* total = nullptr;
+			for (OwnerTotal& o : owners)
+			{
+				if (o.category == a.category && std::strcmp(o.owner, a.owner) == 0)
+				{
+					total = &o;
+					break;
+				}
+			}
+			if (total == nullptr)
+			{
+				owners.push_back({ a.category, a.owner, 0, 0 });
+				total = &owners.back();
+			}
+			total->bytes += a.bytes;
+			++total->count;
+		}
+
+		printf("GPU memory: %.1f MB in %u allocations, %.1f MB at most\n", m_total / MEGABYTE,
+			(unsigned int)m_allocations.size(), m_peak / MEGABYTE);
+		for (unsigned int i = 0; i < CATEGORY_COUNT; ++i)
+		{
+			if (m_categoryBytes[i] == 0)
+				continue;
+
+			printf("  %-16s %9.2f MB\n", CATEGORY_NAMES[i], m_categoryBytes[i] / MEGABYTE);
+			for (const OwnerTotal& o : owners)
+			{
+				if (o.category == (Category)i)
+					printf("    %-22s %9.2f MB in %u\n", o.owner, o.bytes / MEGABYTE, o.count);
+			}
+		}
+	}
+
+	/**
+		getTextureBytes returns the size of a texture's storage, each
+			level half the size of the last down to 1 texel.
+
+			@param1 a_internalFormat is its sized internal format.
+
+			@param2 a_width is the width of its first level.
+
+			@param3 a_height is the height of its first level.
+
+			@param4 a_layers is how many layers it has.
+
+			@param5 a_levels is how many mip levels it has.
+
+			@return the bytes, or 0 for a format it doesn't know.
+	*/
+	unsigned long long GpuMemory::getTextureBytes(unsigned int a_internalFormat, unsigned int a_width,
+		unsigned int a_height, unsigned int a_layers, unsigned int a_levels)
+	{
+		// Block compressed formats are 4 by 4 texel blocks.
+		unsigned int texelBytes = 0;
+		unsigned int blockBytes = 0;
+		switch (a_internalFormat)
+		{
+		case GL_R8:
+			texelBytes = 1;
+			break;
+		case GL_RG8:
+		case GL_R16:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:
+			texelBytes = 2;
+			break;
+		case GL_RGB8:
+			texelBytes = 3;
+			break;
+		case GL_RGBA8:
+		case GL_RGBA8UI:
+		case GL_SRGB8_ALPHA8:
+		case GL_RG16:
+		case GL_RG16F:
+		case GL_RGB10_A2:
+		case GL_R11F_G11F_B10F:
+		case GL_R32F:
+		case GL_R32UI:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F:
+		case GL_DEPTH24_STENCIL8:
+			texelBytes = 4;
+			break;
+		// Depth and stencil are kept apart, so it's padded out to 8.
+		case GL_DEPTH32F_STENCIL8:
+		case GL_RGBA16F:
+		case GL_RG32F:
+			texelBytes = 8;
+			break;
+		case GL_RGBA32F:
+			texelBytes = 16;
+			break;
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+			blockBytes = 8;
+			break;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			blockBytes = 16;
+			break;
+		default:
+			return 0;
+		}
+
+		unsigned long long bytes = 0;
+		unsigned int width = a_width;
+		unsigned int height = a_height;
+		for (unsigned int i = 0; i < a_levels; ++i)
+		{
+			if (blockBytes != 0)
+				bytes += (unsigned long long)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+			else
+				bytes += (unsigned long long)width * height * texelBytes;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		return bytes * a_layers;
+	}
+}
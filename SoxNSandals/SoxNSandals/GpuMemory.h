@@ -0,0 +1,195 @@
+/**
+	GpuMemory.h
+
+	Purpose: GpuMemory.h is the header file for the GpuMemory class. The
+			GpuMemory class keeps a record of every buffer and texture
+			the engine allocates on the gpu, so how much video memory a
+			scene takes can be seen and kept inside a budget.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <unordered_map>
+
+namespace sns
+{
+	/**
+		The GpuMemory class is told the size of each buffer and texture
+			when its storage is made, and when it is deleted. GL has no
+			portable way to ask, so the sizes are what the storage
+			holds, not whatever the driver pads it to.
+
+		Each allocation has a category, what it is for, and an owner,
+			the class that made it. Totals are kept for both and sent
+			to the profiler once a frame, and crossing the budget is
+			printed once each time it happens.
+
+		Only the thread with the GL context may use it, as that is the
+			only thread that makes or deletes gl objects.
+	*/
+	class GpuMemory
+	{
+	public:
+		/**
+			What an allocation is for.
+		*/
+		enum Category
+		{
+			MESHES,
+			TEXTURES,
+			RENDER_TARGETS,
+			PARTICLES,
+			STREAMING,
+			LIGHTING,
+			CULLING,
+			GIZMOS,
+			UNIFORMS,
+			CATEGORY_COUNT
+		};
+
+		static GpuMemory& instance();
+
+		GpuMemory(const GpuMemory&) = delete;
+		GpuMemory& operator=(const GpuMemory&) = delete;
+
+		/**
+			trackBuffer records a buffer's storage, replacing whatever it
+				had if it was made again.
+
+				@param1 a_buffer is the GL handle of the buffer.
+
+				@param2 a_bytes is the size of its storage.
+
+				@param3 a_category is what it is for.
+
+				@param4 a_owner is the class that made it, a string literal.
+		*/
+		void trackBuffer(unsigned int a_buffer, unsigned long long a_bytes, Category a_category, const char* a_owner);
+
+		/**
+			trackTexture records a texture's storage, as trackBuffer does.
+
+				@param1 a_texture is the GL handle of the texture.
+
+				@param2 a_bytes is the size of its storage, see getTextureBytes.
+
+				@param3 a_category is what it is for.
+
+				@param4 a_owner is the class that made it, a string literal.
+		*/
+		void trackTexture(unsigned int a_texture, unsigned long long a_bytes, Category a_category, const char* a_owner);
+
+		/**
+			releaseBuffer forgets a buffer, call it beside glDeleteBuffers.
+				Buffers that were never tracked are ignored.
+
+				@param1 a_buffer is the GL handle of the buffer.
+		*/
+		void releaseBuffer(unsigned int a_buffer);
+
+		/**
+			releaseTexture forgets a texture, call it beside
+				glDeleteTextures.
+
+				@param1 a_texture is the GL handle of the texture.
+		*/
+		void releaseTexture(unsigned int a_texture);
+
+		/**
+			setBudget sets how many bytes can be allocated before a warning
+				is printed, 0 for no budget.
+
+				@param1 a_bytes is the budget.
+		*/
+		void setBudget(unsigned long long a_bytes) { m_budget = a_bytes; }
+
+		/**
+			getBudget returns the budget in bytes, 0 if there isn't one.
+		*/
+		unsigned long long getBudget() const { return m_budget; }
+
+		/**
+			getTotal returns how many bytes are allocated.
+		*/
+		unsigned long long getTotal() const { return m_total; }
+
+		/**
+			getPeak returns the most bytes that have been allocated at once.
+		*/
+		unsigned long long getPeak() const { return m_peak; }
+
+		/**
+			getCategoryTotal returns how many bytes a category has.
+
+				@param1 a_category is the category.
+		*/
+		unsigned long long getCategoryTotal(Category a_category) const { return m_categoryBytes[a_category]; }
+
+		/**
+			getCategoryName returns the name a category is shown with.
+
+				@param1 a_category is the category.
+		*/
+		static const char* getCategoryName(Category a_category);
+
+		/**
+			update sends the totals to the profiler as counters, and warns
+				if the total has gone over the budget since the last time.
+				Call it once a frame.
+		*/
+		void update();
+
+		/**
+			printReport prints the totals of every category and owner.
+		*/
+		void printReport() const;
+
+		/**
+			getTextureBytes returns the size of a texture's storage.
+
+				@param1 a_internalFormat is its sized internal format.
+
+				@param2 a_width is the width of its first level.
+
+				@param3 a_height is the height of its first level.
+
+				@param4 a_layers is how many layers it has, 1 for 2D.
+
+				@param5 a_levels is how many mip levels it has.
+
+				@return the bytes, or 0 for a format it doesn't know.
+		*/
+		static unsigned long long getTextureBytes(unsigned int a_internalFormat, unsigned int a_width,
+			unsigned int a_height, unsigned int a_layers = 1, unsigned int a_levels = 1);
+
+	private:
+		GpuMemory();
+
+		/**
+			One buffer or texture's storage.
+		*/
+		struct Allocation
+		{
+			unsigned long long bytes;
+			Category category;
+			const char* owner;
+		};
+
+		/**
+			track and release are trackBuffer and releaseBuffer for either
+				kind of object. Buffers and textures have their own
+				handles, so the kind is kept in the key's high bits.
+		*/
+		void track(unsigned long long a_key, unsigned long long a_bytes, Category a_category, const char* a_owner);
+		void release(unsigned long long a_key);
+
+		std::unordered_map<unsigned long long, Allocation> m_allocations;
+
+		unsigned long long m_categoryBytes[CATEGORY_COUNT];
+		unsigned long long m_total;
+		unsigned long long m_peak;
+
+		unsigned long long m_budget;
+		bool m_overBudget;
+	};
+}
@@ -0,0 +1,200 @@
+/**
+	GpuReadback.cpp
+
+	Purpose: GpuReadback.cpp is the source file for the GpuReadback
+			class. The GpuReadback copies what is asked of the gpu into
+			staging buffers and hands it to a callback frames later,
+			once a fence has passed, so reading it back never waits.
+
+	@author Nathan Nette
+*/
+#include "GpuReadback.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+
+namespace sns
+{
+	/**
+		instance returns the readback service of the GL context.
+	*/
+	GpuReadback& GpuReadback::instance()
+	{
+		static GpuReadback readback;
+		return readback;
+	}
+
+	/**
+		readBuffer reads part of a buffer back.
+
+			@param1 a_buffer is the GL handle of the buffer.
+
+			@param2 a_offset is where in it to start, in bytes.
+
+			@param3 a_size is how many bytes to read.
+
+			@param4 a_callback is given them once the gpu is done.
+	*/
+	void GpuReadback::readBuffer(unsigned int a_buffer, size_t a_offset, size_t a_size, Callback a_callback)
+	{
+		unsigned int staging = acquire(a_size);
+		glCopyNamedBufferSubData(a_buffer, m_staging[staging].buffer, a_offset, 0, a_size);
+		m_pending.push_back({ staging, a_size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(a_callback) });
+	}
+
+	/**
+		readPixels reads pixels of the bound read framebuffer back.
+
+			@param1 a_x is the left of the rectangle.
+
+			@param2 a_y is the bottom of the rectangle.
+
+			@param3 a_width is the rectangle's width.
+
+			@param4 a_height is the rectangle's height.
+
+			@param5 a_format is the format of the pixels.
+
+			@param6 a_type is the type of the pixels.
+
+			@param7 a_size is how many bytes the pixels take.
+
+			@param8 a_callback is given them once the gpu is done.
+	*/
+	void GpuReadback::readPixels(int a_x, int a_y, int a_width, int a_height, unsigned int a_format,
+		unsigned int a_type, size_t a_size, Callback a_callback)
+	{
+		// With a pack buffer bound glReadPixels writes into it, and
+		//	returns without waiting for the frame to finish.
+		unsigned int staging = acquire(a_size);
+		RenderState::instance().bindBuffer(GL_PIXEL_PACK_BUFFER, m_staging[staging].buffer);
+		glReadPixels(a_x, a_y, a_width, a_height, a_format, a_type, nullptr);
+		RenderState::instance().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		m_pending.push_back({ staging, a_size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(a_callback) });
+	}
+
+	/**
+		readQuery reads a query's result back once it is available.
+
+			@param1 a_query is the GL handle of the ended query.
+
+			@param2 a_callback is given its result.
+	*/
+	void GpuReadback::readQuery(unsigned int a_query, QueryCallback a_callback)
+	{
+		m_queries.push_back({ a_query, std::move(a_callback) });
+	}
+
+	/**
+		update hands over everything the gpu has finished, without
+			waiting for anything it hasn't.
+	*/
+	void GpuReadback::update()
+	{
+		// Each poll flushes, so a fence still in the driver's queue gets
+		//	to the gpu instead of never passing. A callback can ask for
+		//	more readbacks, which go on the end, so nothing is held by
+		//	reference across one.
+		size_t done = 0;
+		for (; done < m_pending.size(); ++done)
+		{
+			GLsync fence = (GLsync)m_pending[done].fence;
+			GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+				break;
+			glDeleteSync(fence);
+
+			Pending pending = std::move(m_pending[done]);
+			unsigned int buffer = m_staging[pending.staging].buffer;
+			const void* data = glMapNamedBufferRange(buffer, 0, pending.size, GL_MAP_READ_BIT);
+			if (data != nullptr)
+			{
+				pending.callback(data, pending.size);
+				glUnmapNamedBuffer(buffer);
+			}
+			m_staging[pending.staging].busy = false;
+			++m_stats.completed;
+			m_stats.bytes += pending.size;
+		}
+		m_pending.erase(m_pending.begin(), m_pending.begin() + done);
+
+		// Queries asked for by a callback wait for the next update, after
+		//	those still waiting.
+		std::vector<PendingQuery> queries;
+		std::vector<PendingQuery> waiting;
+		queries.swap(m_queries);
+		for (PendingQuery& pending : queries)
+		{
+			unsigned int available = 0;
+			glGetQueryObjectuiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == 0)
+			{
+				waiting.push_back(std::move(pending));
+				continue;
+			}
+
+			GLuint64 result = 0;
+			glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &result);
+			pending.callback(result);
+			++m_stats.completed;
+		}
+		waiting.insert(waiting.end(), m_queries.begin(), m_queries.end());
+		m_queries.swap(waiting);
+		m_stats.pending = getPendingCount();
+	}
+
+	/**
+		destroy throws away what is pending and deletes the staging
+			buffers, before the context is.
+	*/
+	void GpuReadback::destroy()
+	{
+		for (Pending& pending : m_pending)
+			glDeleteSync((GLsync)pending.fence);
+		m_pending.clear();
+		m_queries.clear();
+
+		for (Staging& staging : m_staging)
+		{
+			glDeleteBuffers(1, &staging.buffer);
+			RenderState::instance().onBufferDeleted(staging.buffer);
+			GpuMemory::instance().releaseBuffer(staging.buffer);
+		}
+		m_staging.clear();
+	}
+
+	/**
+		acquire finds a free staging buffer of at least a size, making one
+			if none is, and marks it busy.
+
+			@param1 a_size is the size in bytes.
+
+			@return its index in m_staging.
+	*/
+	unsigned int GpuReadback::acquire(size_t a_size)
+	{
+		// The smallest that fits, so small readbacks leave the large
+		//	buffers for large ones.
+		unsigned int best = ~0u;
+		for (unsigned int i = 0; i < (unsigned int)m_staging.size(); ++i)
+		{
+			const Staging& staging = m_staging[i];
+			if (staging.busy == false && staging.capacity >= a_size &&
+				(best == ~0u || staging.capacity < m_staging[best].capacity))
+				best = i;
+		}
+
+		if (best == ~0u)
+		{
+			// Read by the cpu, written only by the gpu's copies.
+			Staging staging = { 0, a_size, false };
+			glCreateBuffers(1, &staging.buffer);
+			glNamedBufferStorage(staging.buffer, a_size, nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+			GpuMemory::instance().trackBuffer(staging.buffer, a_size, GpuMemory::STREAMING, "GpuReadback");
+			best = (unsigned int)m_staging.size();
+			m_staging.push_back(staging);
+		}
+		m_staging[best].busy = true;
+		return best;
+	}
+}
@@ -0,0 +1,183 @@
+/**
+	GpuReadback.h
+
+	Purpose: GpuReadback.h is the header file for the GpuReadback
+			class. The GpuReadback copies what is asked of the gpu,
+			buffers, pixels and query results, into staging buffers
+			and hands it to a callback frames later, once a fence has
+			passed, so reading it back never waits for the gpu.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <functional>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The GpuReadback class is the GL context's readback service. A
+			buffer or pixel readback is a copy into a staging buffer
+			followed by a fence. update polls the fences without
+			waiting, once a frame, and maps the staging buffers of
+			those that have passed for their callbacks. Fences pass in
+			order, so polling stops at the first that hasn't.
+
+		Query results are polled with GL_QUERY_RESULT_AVAILABLE instead,
+			each handed over as soon as it is.
+
+		Staging buffers are kept and reused by size, so readbacks made
+			every frame don't allocate. Everything must be called on
+			the main thread, and callbacks are run there, inside update.
+	*/
+	class GpuReadback
+	{
+	public:
+		/**
+			Given the data read back. It is only valid during the call.
+		*/
+		typedef std::function<void(const void* a_data, size_t a_size)> Callback;
+
+		/**
+			Given a query's result.
+		*/
+		typedef std::function<void(unsigned long long a_result)> QueryCallback;
+
+		/**
+			Counts of what has been read back since the last resetStats.
+		*/
+		struct Stats
+		{
+			unsigned int completed;
+			unsigned long long bytes;
+
+			// Readbacks still in flight when update last ran.
+			unsigned int pending;
+		};
+
+		/**
+			instance returns the readback service of the GL context.
+		*/
+		static GpuReadback& instance();
+
+		/**
+			readBuffer reads part of a buffer back.
+
+				@param1 a_buffer is the GL handle of the buffer.
+
+				@param2 a_offset is where in it to start, in bytes.
+
+				@param3 a_size is how many bytes to read.
+
+				@param4 a_callback is given them once the gpu is done.
+		*/
+		void readBuffer(unsigned int a_buffer, size_t a_offset, size_t a_size, Callback a_callback);
+
+		/**
+			readPixels reads pixels of the bound read framebuffer back,
+				as glReadPixels would with the pack state as it is.
+
+				@param1 a_x is the left of the rectangle.
+
+				@param2 a_y is the bottom of the rectangle.
+
+				@param3 a_width is the rectangle's width.
+
+				@param4 a_height is the rectangle's height.
+
+				@param5 a_format is the format of the pixels, like GL_BGRA.
+
+				@param6 a_type is the type of the pixels, like
+						GL_UNSIGNED_BYTE.
+
+				@param7 a_size is how many bytes the pixels take.
+
+				@param8 a_callback is given them once the gpu is done.
+		*/
+		void readPixels(int a_x, int a_y, int a_width, int a_height, unsigned int a_format, unsigned int a_type,
+			size_t a_size, Callback a_callback);
+
+		/**
+			readQuery reads a query's result back once it is available.
+				The query must not be begun again until then.
+
+				@param1 a_query is the GL handle of the ended query.
+
+				@param2 a_callback is given its result.
+		*/
+		void readQuery(unsigned int a_query, QueryCallback a_callback);
+
+		/**
+			update hands over everything the gpu has finished, without
+				waiting for anything it hasn't. Called once a frame.
+		*/
+		void update();
+
+		/**
+			getPendingCount returns how many readbacks haven't finished.
+		*/
+		unsigned int getPendingCount() const
+		{
+			return (unsigned int)(m_pending.size() + m_queries.size());
+		}
+
+		/**
+			destroy throws away what is pending and deletes the staging
+				buffers, before the context is.
+		*/
+		void destroy();
+
+		/**
+			getStats returns what has been read back since resetStats.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+		/**
+			resetStats sets the counts back to zero.
+		*/
+		void resetStats() { m_stats = {}; }
+
+	private:
+		// A staging buffer, free unless a readback is using it.
+		struct Staging
+		{
+			unsigned int buffer;
+			size_t capacity;
+			bool busy;
+		};
+
+		// A buffer or pixel readback waiting on its fence.
+		struct Pending
+		{
+			unsigned int staging;
+			size_t size;
+			void* fence;
+			Callback callback;
+		};
+
+		// A query waiting on its result.
+		struct PendingQuery
+		{
+			unsigned int query;
+			QueryCallback callback;
+		};
+
+		GpuReadback() : m_stats() {}
+
+		GpuReadback(const GpuReadback&) = delete;
+		GpuReadback& operator=(const GpuReadback&) = delete;
+
+		// Finds a free staging buffer of at least a size, making one if
+		//	none is, and marks it busy.
+		unsigned int acquire(size_t a_size);
+
+		std::vector<Staging> m_staging;
+
+		// In the order they were fenced.
+		std::vector<Pending> m_pending;
+
+		std::vector<PendingQuery> m_queries;
+
+		Stats m_stats;
+	};
+}
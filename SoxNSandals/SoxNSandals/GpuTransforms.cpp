@@ -0,0 +1,258 @@
+/**
+	GpuTransforms.cpp
+
+	Purpose: GpuTransforms.cpp is the source file for the GpuTransforms
+			class. The GpuTransforms works out a SceneGraph's world
+			matrices in a compute shader, a level of the hierarchy at a
+			time, for graphs too large to walk on the cpu every frame.
+
+	@author Nathan Nette
+*/
+#include "GpuTransforms.h"
+#include "GpuMemory.h"
+#include "ObjectBuffer.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	// How many nodes the buffers have room for at first.
+	static const unsigned int FIRST_CAPACITY = 1024;
+
+	GpuTransforms::GpuTransforms()
+		: m_capacity(0),
+		m_nodeCount(0),
+		m_structureVersion(0),
+		m_objectsChanged(false),
+		m_objectBuffer(0),
+		m_stats()
+	{
+	}
+
+	/**
+		create loads the compute shader and makes the buffers.
+
+			@return false without GL 4.5 or the shader, it is left
+					uncreated.
+	*/
+	bool GpuTransforms::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("GpuTransforms: updating transforms on the gpu needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_shader.getHandle() == 0)
+		{
+			m_shader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/transformUpdate.comp");
+			if (m_shader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_shader.getLastError());
+				return false;
+			}
+		}
+
+		reserve(FIRST_CAPACITY);
+		return true;
+	}
+
+	/**
+		destroy deletes the buffers and forgets the hierarchy.
+	*/
+	void GpuTransforms::destroy()
+	{
+		BufferHandle* buffers[5] = { &m_parents, &m_locals, &m_worlds, &m_orderBuffer, &m_nodeObjects };
+		for (BufferHandle* buffer : buffers)
+			buffer->reset();
+		m_capacity = 0;
+		m_nodeCount = 0;
+		m_order.clear();
+		m_depthFirst.clear();
+		m_objectOfNode.clear();
+		m_objectBuffer = 0;
+	}
+
+	/**
+		setObject gives a node an object its world matrix is written to.
+
+			@param1 a_node is the node.
+
+			@param2 a_object is the object, or NO_OBJECT for none.
+	*/
+	void GpuTransforms::setObject(SceneGraph::Node a_node, unsigned int a_object)
+	{
+		if (a_node >= m_objectOfNode.size())
+			m_objectOfNode.resize(a_node + 1, NO_OBJECT);
+		m_objectOfNode[a_node] = a_object;
+		m_objectsChanged = true;
+	}
+
+	/**
+		update recomputes the world matrices of every node moved since the
+			graph's last update and every node after it, and of their
+			objects. A changed hierarchy, or a new object buffer, is
+			recomputed whole.
+
+			@param1 a_graph is the graph.
+
+			@param2 a_objects are the objects nodes were given, or nullptr
+					to write none.
+
+			@return how many nodes were recomputed.
+	*/
+	unsigned int GpuTransforms::update(const SceneGraph& a_graph, const ObjectBuffer* a_objects)
+	{
+		static constexpr aie::UniformHandle FIRST("First");
+		static constexpr aie::UniformHandle COUNT("Count");
+		static constexpr aie::UniformHandle WRITE_OBJECTS("WriteObjects");
+
+		m_stats = {};
+		unsigned int count = a_graph.getNodeCount();
+		if (isCreated() == false || count == 0)
+			return 0;
+
+		unsigned int first = std::min(a_graph.getFirstDirty(), count);
+		if (count != m_nodeCount || a_graph.getStructureVersion() != m_structureVersion)
+		{
+			rebuild(a_graph);
+			first = 0;
+		}
+		else if (first < count)
+		{
+			glNamedBufferSubData(m_locals, first * sizeof(glm::mat4), (count - first) * sizeof(glm::mat4),
+				&a_graph.getLocal(first));
+		}
+
+		if (m_objectsChanged)
+		{
+			if (m_objectOfNode.size() < count)
+				m_objectOfNode.resize(count, NO_OBJECT);
+			glNamedBufferSubData(m_nodeObjects, 0, count * sizeof(unsigned int), m_objectOfNode.data());
+			m_objectsChanged = false;
+			first = 0;
+		}
+
+		unsigned int objectBuffer = a_objects != nullptr ? a_objects->getHandle() : 0;
+		if (objectBuffer != m_objectBuffer)
+		{
+			m_objectBuffer = objectBuffer;
+			first = 0;
+		}
+		if (first >= count)
+			return 0;
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARENT_BINDING, m_parents);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOCAL_BINDING, m_locals);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WORLD_BINDING, m_worlds);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ORDER_BINDING, m_orderBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_OBJECT_BINDING, m_nodeObjects);
+		if (objectBuffer != 0)
+			a_objects->bind();
+
+		m_shader.bind();
+		m_shader.bindUniform(WRITE_OBJECTS, objectBuffer != 0 ? 1 : 0);
+
+		// Within a depth the nodes are in order, so those before the first
+		//	moved are skipped with a search.
+		for (unsigned int depth = 0; depth + 1 < (unsigned int)m_depthFirst.size(); ++depth)
+		{
+			auto begin = m_order.begin() + m_depthFirst[depth];
+			auto end = m_order.begin() + m_depthFirst[depth + 1];
+			begin = std::lower_bound(begin, end, first);
+			unsigned int nodes = (unsigned int)(end - begin);
+			if (nodes == 0)
+				continue;
+
+			if (m_stats.dispatches > 0)
+				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			m_shader.bindUniform(FIRST, (int)(begin - m_order.begin()));
+			m_shader.bindUniform(COUNT, (int)nodes);
+			glDispatchCompute((nodes + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+			m_stats.nodes += nodes;
+			++m_stats.dispatches;
+		}
+
+		// The worlds and objects are read as storage by the draws, or as
+		//	instance attributes.
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		return m_stats.nodes;
+	}
+
+	/**
+		rebuild sorts the nodes by depth and sends the whole hierarchy.
+			Parents come before their children, so one pass finds every
+			depth, and a counting sort keeps each depth in order.
+
+			@param1 a_graph is the graph.
+	*/
+	void GpuTransforms::rebuild(const SceneGraph& a_graph)
+	{
+		unsigned int count = a_graph.getNodeCount();
+		if (count > m_capacity)
+			reserve(std::max(count, m_capacity * 2));
+
+		std::vector<unsigned int> parents(count);
+		std::vector<unsigned int> depths(count);
+		unsigned int depthCount = 0;
+		for (SceneGraph::Node node = 0; node < count; ++node)
+		{
+			SceneGraph::Node parent = a_graph.getParent(node);
+			parents[node] = parent;
+			depths[node] = parent == SceneGraph::NO_PARENT ? 0 : depths[parent] + 1;
+			depthCount = std::max(depthCount, depths[node] + 1);
+		}
+
+		m_depthFirst.assign(depthCount + 1, 0);
+		for (unsigned int depth : depths)
+			++m_depthFirst[depth + 1];
+		for (unsigned int depth = 0; depth < depthCount; ++depth)
+			m_depthFirst[depth + 1] += m_depthFirst[depth];
+
+		std::vector<unsigned int> next(m_depthFirst.begin(), m_depthFirst.end() - 1);
+		m_order.resize(count);
+		for (SceneGraph::Node node = 0; node < count; ++node)
+			m_order[next[depths[node]]++] = node;
+
+		// Every node's object is sent again with the new count.
+		m_objectsChanged = true;
+
+		glNamedBufferSubData(m_parents, 0, count * sizeof(unsigned int), parents.data());
+		glNamedBufferSubData(m_orderBuffer, 0, count * sizeof(unsigned int), m_order.data());
+		glNamedBufferSubData(m_locals, 0, count * sizeof(glm::mat4), &a_graph.getLocal(0));
+
+		m_nodeCount = count;
+		m_structureVersion = a_graph.getStructureVersion();
+		m_stats.rebuilt = true;
+	}
+
+	/**
+		reserve makes the buffers again with room for a node count. What
+			they held is sent again by the rebuild that follows.
+
+			@param1 a_count is how many nodes.
+	*/
+	void GpuTransforms::reserve(unsigned int a_count)
+	{
+		struct Buffer
+		{
+			BufferHandle* handle;
+			unsigned int elementSize;
+		};
+		Buffer buffers[5] = { { &m_parents, sizeof(unsigned int) }, { &m_locals, sizeof(glm::mat4) },
+			{ &m_worlds, sizeof(glm::mat4) }, { &m_orderBuffer, sizeof(unsigned int) },
+			{ &m_nodeObjects, sizeof(unsigned int) } };
+		for (Buffer& buffer : buffers)
+		{
+			unsigned long long bytes = (unsigned long long)a_count * buffer.elementSize;
+			glCreateBuffers(1, buffer.handle->put());
+			glNamedBufferStorage(*buffer.handle, bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+			GpuMemory::instance().trackBuffer(*buffer.handle, bytes, GpuMemory::MESHES, "GpuTransforms");
+		}
+		m_capacity = a_count;
+		m_nodeCount = 0;
+	}
+}
@@ -0,0 +1,170 @@
+/**
+	GpuTransforms.h
+
+	Purpose: GpuTransforms.h is the header file for the GpuTransforms
+			class. The GpuTransforms works out a SceneGraph's world
+			matrices in a compute shader, a level of the hierarchy at a
+			time, for graphs too large to walk on the cpu every frame.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "SceneGraph.h"
+#include "Shader.h"
+#include <vector>
+
+namespace sns
+{
+	class ObjectBuffer;
+
+	/**
+		The GpuTransforms class keeps a copy of a SceneGraph's parents and
+			local matrices in storage buffers, and a world matrix for
+			every node.
+
+		The nodes are sorted by how deep they are, roots first, and each
+			depth is one dispatch, every node in it multiplying its
+			parent's world matrix by its local matrix at once. A barrier
+			between dispatches makes each level see the one above. Like
+			SceneGraph::update, only the nodes from the first one moved
+			on are recomputed, and only their local matrices are sent.
+
+		A node can be given an object of an ObjectBuffer, whose model and
+			normal matrices are then written straight from the world
+			matrix, so instanced and indirect draws read it without the
+			matrices ever coming back to the cpu. Those objects must
+			not be moved on the cpu as well, the buffer's next upload
+			would write over them.
+
+		The graph's own world matrices aren't touched. update reads which
+			nodes moved, so it goes before SceneGraph::update, or graphs
+			only drawn from the gpu can skip that.
+
+		Storage buffers are made with GL 4.5, without it create fails.
+	*/
+	class GpuTransforms
+	{
+	public:
+		// Nodes a work group updates.
+		static const unsigned int GROUP_SIZE = 64;
+
+		// The storage bindings of the buffers. The objects are bound to
+		//	ObjectBuffer::BINDING.
+		static const unsigned int PARENT_BINDING = 0;
+		static const unsigned int LOCAL_BINDING = 1;
+		static const unsigned int WORLD_BINDING = 2;
+		static const unsigned int ORDER_BINDING = 3;
+		static const unsigned int NODE_OBJECT_BINDING = 4;
+
+		// The object of a node without one.
+		static const unsigned int NO_OBJECT = ~0u;
+
+		/**
+			What the last update did.
+		*/
+		struct Stats
+		{
+			unsigned int nodes;
+			unsigned int dispatches;
+
+			// Whether the hierarchy was sent again.
+			bool rebuilt;
+		};
+
+		GpuTransforms();
+
+		GpuTransforms(const GpuTransforms&) = delete;
+		GpuTransforms& operator=(const GpuTransforms&) = delete;
+
+		/**
+			create loads the compute shader and makes the buffers.
+
+				@return false without GL 4.5 or the shader, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_worlds != 0; }
+
+		/**
+			destroy deletes the buffers and forgets the hierarchy.
+		*/
+		void destroy();
+
+		/**
+			setObject gives a node an object its world matrix is written
+				to.
+
+				@param1 a_node is the node.
+
+				@param2 a_object is the object, or NO_OBJECT for none.
+		*/
+		void setObject(SceneGraph::Node a_node, unsigned int a_object);
+
+		/**
+			update recomputes the world matrices of every node moved since
+				the graph's last update and every node after it, and of
+				their objects. It goes before SceneGraph::update, and
+				after the ObjectBuffer's upload.
+
+				@param1 a_graph is the graph.
+
+				@param2 a_objects are the objects nodes were given, or
+						nullptr to write none.
+
+				@return how many nodes were recomputed.
+		*/
+		unsigned int update(const SceneGraph& a_graph, const ObjectBuffer* a_objects = nullptr);
+
+		/**
+			getWorldBuffer returns the storage buffer of every node's world
+				matrix, a mat4 a node.
+		*/
+		unsigned int getWorldBuffer() const { return m_worlds; }
+
+		/**
+			getStats returns what the last update did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		// Sorts the nodes by depth and sends the whole hierarchy.
+		void rebuild(const SceneGraph& a_graph);
+
+		// Makes the buffers again with room for a node count.
+		void reserve(unsigned int a_count);
+
+		aie::ShaderProgram m_shader;
+
+		BufferHandle m_parents;
+		BufferHandle m_locals;
+		BufferHandle m_worlds;
+		BufferHandle m_orderBuffer;
+		BufferHandle m_nodeObjects;
+
+		// How many nodes the buffers have room for.
+		unsigned int m_capacity;
+
+		// The graph as of the last rebuild.
+		unsigned int m_nodeCount;
+		unsigned int m_structureVersion;
+
+		// Every node sorted by depth, in order within each depth, and
+		//	where each depth starts, with the count at the end.
+		std::vector<unsigned int> m_order;
+		std::vector<unsigned int> m_depthFirst;
+
+		// Each node's object, and whether it changed since it was sent.
+		std::vector<unsigned int> m_objectOfNode;
+		bool m_objectsChanged;
+
+		// The object buffer written last, written whole when it changes.
+		unsigned int m_objectBuffer;
+
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,536 @@
+/**
+	GravitySimulation.cpp
+
+	Purpose: GravitySimulation.cpp is the source file for the
+			GravitySimulation class. The GravitySimulation moves bodies
+			under the gravity of every other body, summing each pair
+			directly when there are few and through a Barnes-Hut octree
+			when there are many.
+
+	@author Nathan Nette
+*/
+#include "GravitySimulation.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <xmmintrin.h>
+
+namespace sns
+{
+	// The deepest an octree walk's stack gets, every level pushing at most
+	//	eight children after popping one.
+	static const unsigned int MAX_STACK = GravitySimulation::MAX_DEPTH * 7 + 8;
+
+	/**
+		sumLanes returns the four floats of a register added together.
+	*/
+	static float sumLanes(__m128 a_value)
+	{
+		__m128 swapped = _mm_shuffle_ps(a_value, a_value, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(a_value, swapped);
+		swapped = _mm_movehl_ps(swapped, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, swapped));
+	}
+
+	GravitySimulation::GravitySimulation()
+		: m_count(0),
+		m_accelerationsValid(false),
+		m_gravity(1.0f),
+		m_softening(0.5f),
+		m_theta(0.5f),
+		m_maxStep(1.0f / 240.0f),
+		m_stats()
+	{
+	}
+
+	/**
+		addBody adds a body.
+
+			@param1 a_position is where it starts.
+
+			@param2 a_velocity is how fast it starts moving.
+
+			@param3 a_mass is its mass.
+
+			@return the body.
+	*/
+	unsigned int GravitySimulation::addBody(const glm::vec3& a_position, const glm::vec3& a_velocity, float a_mass)
+	{
+		unsigned int body = m_count;
+		resize(m_count + 1);
+		m_positionX[body] = a_position.x;
+		m_positionY[body] = a_position.y;
+		m_positionZ[body] = a_position.z;
+		m_velocityX[body] = a_velocity.x;
+		m_velocityY[body] = a_velocity.y;
+		m_velocityZ[body] = a_velocity.z;
+		m_mass[body] = a_mass;
+		m_accelerationsValid = false;
+		return body;
+	}
+
+	/**
+		getOrbitalVelocity returns the velocity a body needs to circle
+			another at a distance.
+
+			@param1 a_parent is the body circled.
+
+			@param2 a_offset is where the circling body is from it.
+
+			@param3 a_mass is the circling body's mass.
+
+			@param4 a_retrograde is whether it goes clockwise.
+	*/
+	glm::vec3 GravitySimulation::getOrbitalVelocity(unsigned int a_parent, const glm::vec3& a_offset, float a_mass,
+		bool a_retrograde) const
+	{
+		float distance = glm::length(a_offset);
+		if (distance == 0.0f)
+			return getVelocity(a_parent);
+
+		// As the orbit system circles, the angle growing towards -z from x.
+		//	Both bodies circle their centre of mass, at this speed apart.
+		float speed = std::sqrt(m_gravity * (m_mass[a_parent] + a_mass) / distance);
+		glm::vec3 direction = glm::normalize(glm::cross(glm::vec3(0, 1, 0), a_offset));
+		return getVelocity(a_parent) + direction * (a_retrograde ? -speed : speed);
+	}
+
+	/**
+		removeDrift takes the velocity of the bodies' centre of mass from
+			each of them.
+	*/
+	void GravitySimulation::removeDrift()
+	{
+		glm::vec3 momentum(0);
+		float mass = 0.0f;
+		for (unsigned int i = 0; i < m_count; ++i)
+		{
+			momentum += getVelocity(i) * m_mass[i];
+			mass += m_mass[i];
+		}
+		if (mass == 0.0f)
+			return;
+
+		glm::vec3 drift = momentum / mass;
+		for (unsigned int i = 0; i < m_count; ++i)
+		{
+			m_velocityX[i] -= drift.x;
+			m_velocityY[i] -= drift.y;
+			m_velocityZ[i] -= drift.z;
+		}
+	}
+
+	/**
+		clear removes every body.
+	*/
+	void GravitySimulation::clear()
+	{
+		m_count = 0;
+		resize(0);
+		m_nodes.clear();
+		m_accelerationsValid = false;
+		m_stats = Stats();
+	}
+
+	/**
+		step moves every body, in as many equal steps of at most the max
+			step as it takes.
+
+			@param1 a_deltaTime is how long to move them for, in seconds.
+	*/
+	void GravitySimulation::step(float a_deltaTime)
+	{
+		SNS_PROFILE_SCOPE("Gravity");
+
+		m_stats.steps = 0;
+		m_stats.interactions = 0;
+		if (m_count == 0 || a_deltaTime <= 0.0f)
+			return;
+
+		if (m_accelerationsValid == false)
+			computeAccelerations();
+
+		unsigned int steps = std::max(1u, (unsigned int)std::ceil(a_deltaTime / m_maxStep));
+		float stepTime = a_deltaTime / steps;
+		float halfStep = stepTime * 0.5f;
+
+		// The bodies past the count have no velocity or acceleration, so
+		//	every array is walked whole.
+		unsigned int padded = (unsigned int)m_mass.size();
+		for (unsigned int s = 0; s < steps; ++s)
+		{
+			for (unsigned int i = 0; i < padded; ++i)
+			{
+				m_velocityX[i] += m_accelerationX[i] * halfStep;
+				m_velocityY[i] += m_accelerationY[i] * halfStep;
+				m_velocityZ[i] += m_accelerationZ[i] * halfStep;
+				m_positionX[i] += m_velocityX[i] * stepTime;
+				m_positionY[i] += m_velocityY[i] * stepTime;
+				m_positionZ[i] += m_velocityZ[i] * stepTime;
+			}
+
+			computeAccelerations();
+
+			for (unsigned int i = 0; i < padded; ++i)
+			{
+				m_velocityX[i] += m_accelerationX[i] * halfStep;
+				m_velocityY[i] += m_accelerationY[i] * halfStep;
+				m_velocityZ[i] += m_accelerationZ[i] * halfStep;
+			}
+		}
+		m_stats.steps = steps;
+	}
+
+	/**
+		getState writes every body's position and velocity.
+
+			@param1 a_state is set to the state.
+	*/
+	void GravitySimulation::getState(std::vector<float>& a_state) const
+	{
+		a_state.resize(m_count * STATE_FLOATS);
+		for (unsigned int i = 0; i < m_count; ++i)
+		{
+			float* state = &a_state[i * STATE_FLOATS];
+			state[0] = m_positionX[i];
+			state[1] = m_positionY[i];
+			state[2] = m_positionZ[i];
+			state[3] = m_velocityX[i];
+			state[4] = m_velocityY[i];
+			state[5] = m_velocityZ[i];
+		}
+	}
+
+	/**
+		setState sets every body back to a state getState wrote.
+
+			@param1 a_state is the state.
+
+			@return false if it isn't of as many bodies as there are.
+	*/
+	bool GravitySimulation::setState(const std::vector<float>& a_state)
+	{
+		if (a_state.size() != m_count * STATE_FLOATS)
+			return false;
+
+		for (unsigned int i = 0; i < m_count; ++i)
+		{
+			const float* state = &a_state[i * STATE_FLOATS];
+			m_positionX[i] = state[0];
+			m_positionY[i] = state[1];
+			m_positionZ[i] = state[2];
+			m_velocityX[i] = state[3];
+			m_velocityY[i] = state[4];
+			m_velocityZ[i] = state[5];
+		}
+		m_accelerationsValid = false;
+		return true;
+	}
+
+	/**
+		computeAccelerations works out every body's acceleration from where
+			they are now, directly or through the octree.
+	*/
+	void GravitySimulation::computeAccelerations()
+	{
+		if (m_count <= DIRECT_LIMIT)
+		{
+			m_stats.nodes = 0;
+			m_stats.interactions += sumChunks([this](unsigned int a_first, unsigned int a_last)
+			{
+				return sumDirect(a_first, a_last);
+			});
+		}
+		else
+		{
+			buildTree();
+			m_stats.nodes = (unsigned int)m_nodes.size();
+			m_stats.interactions += sumChunks([this](unsigned int a_first, unsigned int a_last)
+			{
+				return sumTree(a_first, a_last);
+			});
+		}
+		m_accelerationsValid = true;
+	}
+
+	/**
+		sumDirect sums the pull of every body on a range of them, four
+			bodies pulling at a time. The bodies past the count are
+			summed too, they have no mass.
+
+			@param1 a_first is the first body.
+
+			@param2 a_last is one past the last.
+
+			@return how many pairs were summed.
+	*/
+	unsigned long long GravitySimulation::sumDirect(unsigned int a_first, unsigned int a_last)
+	{
+		const __m128 softening = _mm_set1_ps(m_softening * m_softening);
+		const __m128 one = _mm_set1_ps(1.0f);
+		unsigned int padded = (unsigned int)m_mass.size();
+
+		for (unsigned int i = a_first; i < a_last; ++i)
+		{
+			__m128 x = _mm_set1_ps(m_positionX[i]);
+			__m128 y = _mm_set1_ps(m_positionY[i]);
+			__m128 z = _mm_set1_ps(m_positionZ[i]);
+			__m128 ax = _mm_setzero_ps();
+			__m128 ay = _mm_setzero_ps();
+			__m128 az = _mm_setzero_ps();
+
+			for (unsigned int j = 0; j < padded; j += 4)
+			{
+				__m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_positionX[j]), x);
+				__m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_positionY[j]), y);
+				__m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_positionZ[j]), z);
+				__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+					_mm_add_ps(_mm_mul_ps(dz, dz), softening));
+
+				// A full divide rather than _mm_rsqrt_ps, whose result differs
+				//	between processors and is too rough for orbits.
+				__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(distance2));
+				__m128 pull = _mm_mul_ps(_mm_loadu_ps(&m_mass[j]), _mm_mul_ps(inverse, _mm_mul_ps(inverse, inverse)));
+				ax = _mm_add_ps(ax, _mm_mul_ps(dx, pull));
+				ay = _mm_add_ps(ay, _mm_mul_ps(dy, pull));
+				az = _mm_add_ps(az, _mm_mul_ps(dz, pull));
+			}
+
+			m_accelerationX[i] = sumLanes(ax) * m_gravity;
+			m_accelerationY[i] = sumLanes(ay) * m_gravity;
+			m_accelerationZ[i] = sumLanes(az) * m_gravity;
+		}
+		return (unsigned long long)(a_last - a_first) * m_count;
+	}
+
+	/**
+		buildTree builds the octree over every body, in the cube around
+			them all.
+	*/
+	void GravitySimulation::buildTree()
+	{
+		glm::vec3 lowest(FLT_MAX), highest(-FLT_MAX);
+		for (unsigned int i = 0; i < m_count; ++i)
+		{
+			glm::vec3 position = getPosition(i);
+			lowest = glm::min(lowest, position);
+			highest = glm::max(highest, position);
+		}
+		glm::vec3 extent = (highest - lowest) * 0.5f;
+
+		m_order.resize(m_count);
+		std::iota(m_order.begin(), m_order.end(), 0u);
+		m_scratch.resize(m_count);
+
+		// A little larger, so the bodies on its faces are inside.
+		m_nodes.clear();
+		m_nodes.push_back(Node());
+		buildNode(0, 0, m_count, (lowest + highest) * 0.5f,
+			std::max(extent.x, std::max(extent.y, extent.z)) * 1.001f + 0.001f, 0);
+	}
+
+	/**
+		buildNode builds a node over a range of m_order. Its bodies are
+			sorted into the octants of its cube, and each octant with
+			any bodies is a child, built after every node there is.
+
+			@param1 a_node is the node, already in m_nodes.
+
+			@param2 a_first is its first body in m_order.
+
+			@param3 a_last is one past its last.
+
+			@param4 a_centre is the centre of its cube.
+
+			@param5 a_halfSize is half the width of its cube.
+
+			@param6 a_depth is how many nodes are above it.
+	*/
+	void GravitySimulation::buildNode(unsigned int a_node, unsigned int a_first, unsigned int a_last,
+		const glm::vec3& a_centre, float a_halfSize, unsigned int a_depth)
+	{
+		// Nodes aren't kept by reference, building the children moves them.
+		Node node;
+		node.centre = a_centre;
+		node.halfSize = a_halfSize;
+		node.firstChild = 0;
+		node.childCount = 0;
+		node.firstBody = a_first;
+		node.bodyCount = a_last - a_first;
+		node.mass = 0.0f;
+		node.centreOfMass = glm::vec3(0);
+
+		if (node.bodyCount <= LEAF_SIZE || a_depth == MAX_DEPTH)
+		{
+			for (unsigned int i = a_first; i < a_last; ++i)
+			{
+				unsigned int body = m_order[i];
+				node.mass += m_mass[body];
+				node.centreOfMass += getPosition(body) * m_mass[body];
+			}
+			node.centreOfMass = node.mass > 0.0f ? node.centreOfMass / node.mass : a_centre;
+			m_nodes[a_node] = node;
+			return;
+		}
+
+		// Sorts the bodies by octant, x the lowest bit, in one pass.
+		auto getOctant = [this, &a_centre](unsigned int a_body)
+		{
+			return (m_positionX[a_body] >= a_centre.x ? 1u : 0u) | (m_positionY[a_body] >= a_centre.y ? 2u : 0u) |
+				(m_positionZ[a_body] >= a_centre.z ? 4u : 0u);
+		};
+		unsigned int starts[9] = {};
+		for (unsigned int i = a_first; i < a_last; ++i)
+			++starts[getOctant(m_order[i]) + 1];
+		for (unsigned int octant = 0; octant < 8; ++octant)
+			starts[octant + 1] += starts[octant];
+
+		unsigned int next[8];
+		std::copy(starts, starts + 8, next);
+		for (unsigned int i = a_first; i < a_last; ++i)
+			m_scratch[a_first + next[getOctant(m_order[i])]++] = m_order[i];
+		std::copy(m_scratch.begin() + a_first, m_scratch.begin() + a_last, m_order.begin() + a_first);
+
+		node.firstChild = (unsigned int)m_nodes.size();
+		for (unsigned int octant = 0; octant < 8; ++octant)
+			node.childCount += starts[octant + 1] > starts[octant] ? 1 : 0;
+		m_nodes.resize(m_nodes.size() + node.childCount);
+
+		float childHalf = a_halfSize * 0.5f;
+		unsigned int child = node.firstChild;
+		for (unsigned int octant = 0; octant < 8; ++octant)
+		{
+			if (starts[octant + 1] == starts[octant])
+				continue;
+
+			glm::vec3 sign((octant & 1) != 0 ? 1.0f : -1.0f, (octant & 2) != 0 ? 1.0f : -1.0f,
+				(octant & 4) != 0 ? 1.0f : -1.0f);
+			buildNode(child, a_first + starts[octant], a_first + starts[octant + 1], a_centre + sign * childHalf,
+				childHalf, a_depth + 1);
+			node.mass += m_nodes[child].mass;
+			node.centreOfMass += m_nodes[child].centreOfMass * m_nodes[child].mass;
+			++child;
+		}
+		node.centreOfMass = node.mass > 0.0f ? node.centreOfMass / node.mass : a_centre;
+		m_nodes[a_node] = node;
+	}
+
+	/**
+		sumTree sums the pull of the octree on a range of bodies. A node
+			whose cube is small enough for how far its centre of mass is
+			pulls as one body, a leaf that isn't pulls by each of its
+			bodies, and any other node by its children.
+
+			@param1 a_first is the first body.
+
+			@param2 a_last is one past the last.
+
+			@return how many bodies and nodes were summed.
+	*/
+	unsigned long long GravitySimulation::sumTree(unsigned int a_first, unsigned int a_last)
+	{
+		float softening = m_softening * m_softening;
+		float theta2 = m_theta * m_theta;
+		unsigned long long interactions = 0;
+		unsigned int stack[MAX_STACK];
+
+		for (unsigned int i = a_first; i < a_last; ++i)
+		{
+			glm::vec3 position = getPosition(i);
+			glm::vec3 acceleration(0);
+
+			unsigned int depth = 0;
+			stack[depth++] = 0;
+			while (depth > 0)
+			{
+				const Node& node = m_nodes[stack[--depth]];
+				glm::vec3 offset = node.centreOfMass - position;
+				float distance2 = glm::dot(offset, offset);
+				float size = node.halfSize * 2.0f;
+
+				if (node.childCount > 0 && size * size >= theta2 * distance2)
+				{
+					for (unsigned int child = 0; child < node.childCount; ++child)
+						stack[depth++] = node.firstChild + child;
+					continue;
+				}
+
+				if (node.childCount > 0)
+				{
+					float inverse = 1.0f / std::sqrt(distance2 + softening);
+					acceleration += offset * (node.mass * inverse * inverse * inverse);
+					++interactions;
+					continue;
+				}
+
+				// Its own leaf pulls it too, by nothing, as its offset is 0.
+				for (unsigned int b = node.firstBody; b < node.firstBody + node.bodyCount; ++b)
+				{
+					unsigned int body = m_order[b];
+					glm::vec3 bodyOffset = getPosition(body) - position;
+					float inverse = 1.0f / std::sqrt(glm::dot(bodyOffset, bodyOffset) + softening);
+					acceleration += bodyOffset * (m_mass[body] * inverse * inverse * inverse);
+				}
+				interactions += node.bodyCount;
+			}
+
+			m_accelerationX[i] = acceleration.x * m_gravity;
+			m_accelerationY[i] = acceleration.y * m_gravity;
+			m_accelerationZ[i] = acceleration.z * m_gravity;
+		}
+		return interactions;
+	}
+
+	/**
+		sumChunks runs a sum over every body, a chunk of CHUNK_SIZE bodies
+			a job, or on the calling thread if there is only one chunk.
+			Each chunk only writes its own bodies' accelerations.
+
+			@param1 a_sum sums a range of bodies, returning how many
+					interactions it summed.
+
+			@return how many interactions every chunk summed.
+	*/
+	template <typename Sum>
+	unsigned long long GravitySimulation::sumChunks(Sum a_sum)
+	{
+		if (m_count <= CHUNK_SIZE)
+			return a_sum(0, m_count);
+
+		std::atomic<unsigned long long> interactions(0);
+		JobSystem& jobs = JobSystem::instance();
+		JobCounter counter;
+		for (unsigned int first = 0; first < m_count; first += CHUNK_SIZE)
+		{
+			unsigned int last = std::min(first + CHUNK_SIZE, m_count);
+			jobs.run([&a_sum, &interactions, first, last]()
+			{
+				interactions.fetch_add(a_sum(first, last), std::memory_order_relaxed);
+			}, &counter);
+		}
+		jobs.wait(counter);
+		return interactions.load(std::memory_order_relaxed);
+	}
+
+	/**
+		resize sizes every array to hold a body count rounded up to four.
+			The bodies past the count are zeroed, with no mass.
+
+			@param1 a_count is the body count.
+	*/
+	void GravitySimulation::resize(unsigned int a_count)
+	{
+		unsigned int padded = (a_count + 3) & ~3u;
+		for (std::vector<float>* values : { &m_positionX, &m_positionY, &m_positionZ, &m_velocityX, &m_velocityY,
+			&m_velocityZ, &m_accelerationX, &m_accelerationY, &m_accelerationZ, &m_mass })
+		{
+			values->resize(padded, 0.0f);
+			std::fill(values->begin() + std::min(a_count, padded), values->end(), 0.0f);
+		}
+		m_count = a_count;
+	}
+}
@@ -0,0 +1,277 @@
+/**
+	GravitySimulation.h
+
+	Purpose: GravitySimulation.h is the header file for the
+			GravitySimulation class. The GravitySimulation moves bodies
+			under the gravity of every other body, summing each pair
+			directly when there are few and through a Barnes-Hut octree
+			when there are many.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The GravitySimulation class keeps every body's position, velocity,
+			acceleration and mass in arrays of their own, one float per
+			body in each, so four bodies at a time load straight into
+			SSE registers.
+
+		Each step is a leapfrog, half a kick of velocity, a drift of
+			position, new accelerations, then the other half kick, which
+			keeps orbits closed over long runs where a plain Euler step
+			spirals them outwards.
+
+		Up to DIRECT_LIMIT bodies, every body sums the pull of every other,
+			four at a time. Past it, an octree is built over the bodies
+			each step and a body sums a far enough node's mass at its
+			centre of mass instead of each body in it, which is
+			n log n rather than n squared. Either way the bodies are
+			split into chunks summed as jobs, each only writing its own
+			accelerations.
+
+		The softening is added to every squared distance, so bodies
+			passing close slingshot rather than fly apart, and a body's
+			pull on itself is nothing without a branch.
+	*/
+	class GravitySimulation
+	{
+	public:
+		// The most bodies summed pair by pair, more use the octree.
+		static const unsigned int DIRECT_LIMIT = 256;
+
+		// How many bodies one job sums the accelerations of.
+		static const unsigned int CHUNK_SIZE = 128;
+
+		// The most bodies in an octree leaf, and the deepest it splits.
+		static const unsigned int LEAF_SIZE = 8;
+		static const unsigned int MAX_DEPTH = 20;
+
+		// How many floats getState writes a body as.
+		static const unsigned int STATE_FLOATS = 6;
+
+		/**
+			What the last step did.
+		*/
+		struct Stats
+		{
+			// How many steps the last call to step was split into.
+			unsigned int steps;
+
+			// The octree's nodes, 0 when summed directly.
+			unsigned int nodes;
+
+			// Bodies and nodes each body summed the pull of, over every
+			//	step.
+			unsigned long long interactions;
+		};
+
+		GravitySimulation();
+
+		GravitySimulation(const GravitySimulation&) = delete;
+		GravitySimulation& operator=(const GravitySimulation&) = delete;
+
+		/**
+			addBody adds a body.
+
+				@param1 a_position is where it starts.
+
+				@param2 a_velocity is how fast it starts moving.
+
+				@param3 a_mass is its mass, 0 for one pulled without
+						pulling anything.
+
+				@return the body.
+		*/
+		unsigned int addBody(const glm::vec3& a_position, const glm::vec3& a_velocity, float a_mass);
+
+		/**
+			getOrbitalVelocity returns the velocity a body needs to circle
+				another at a distance, going anticlockwise around y, or
+				clockwise if retrograde.
+
+				@param1 a_parent is the body circled.
+
+				@param2 a_offset is where the circling body is from it,
+						in the plane of the orbit.
+
+				@param3 a_mass is the circling body's mass.
+
+				@param4 a_retrograde is whether it goes clockwise.
+		*/
+		glm::vec3 getOrbitalVelocity(unsigned int a_parent, const glm::vec3& a_offset, float a_mass,
+			bool a_retrograde = false) const;
+
+		/**
+			removeDrift takes the velocity of the bodies' centre of mass
+				from each of them, so the system as a whole stays where
+				it is. Bodies added circling still parents leave it
+				drifting otherwise.
+		*/
+		void removeDrift();
+
+		/**
+			clear removes every body.
+		*/
+		void clear();
+
+		/**
+			setGravity sets the gravitational constant, 1 by default.
+
+				@param1 a_gravity is the constant.
+		*/
+		void setGravity(float a_gravity) { m_gravity = a_gravity; m_accelerationsValid = false; }
+
+		/**
+			setSoftening sets the distance added to every pair's, 0.5 by
+				default.
+
+				@param1 a_softening is the distance.
+		*/
+		void setSoftening(float a_softening) { m_softening = a_softening; m_accelerationsValid = false; }
+
+		/**
+			setTheta sets how far a node must be to be summed whole, its
+				size over its distance, 0.5 by default. Smaller is more
+				accurate and slower.
+
+				@param1 a_theta is the ratio.
+		*/
+		void setTheta(float a_theta) { m_theta = a_theta; m_accelerationsValid = false; }
+
+		/**
+			setMaxStep sets the longest step a call to step takes at once,
+				1/240 of a second by default.
+
+				@param1 a_seconds is the step.
+		*/
+		void setMaxStep(float a_seconds) { m_maxStep = a_seconds; }
+
+		/**
+			step moves every body, in as many equal steps of at most the
+				max step as it takes. The same time steps from the same
+				state always move the bodies to the same place.
+
+				@param1 a_deltaTime is how long to move them for, in
+						seconds.
+		*/
+		void step(float a_deltaTime);
+
+		/**
+			getBodyCount returns how many bodies there are.
+		*/
+		unsigned int getBodyCount() const { return m_count; }
+
+		glm::vec3 getPosition(unsigned int a_body) const
+		{
+			return glm::vec3(m_positionX[a_body], m_positionY[a_body], m_positionZ[a_body]);
+		}
+
+		glm::vec3 getVelocity(unsigned int a_body) const
+		{
+			return glm::vec3(m_velocityX[a_body], m_velocityY[a_body], m_velocityZ[a_body]);
+		}
+
+		float getMass(unsigned int a_body) const { return m_mass[a_body]; }
+
+		/**
+			getState writes every body's position and velocity,
+				STATE_FLOATS a body.
+
+				@param1 a_state is set to the state.
+		*/
+		void getState(std::vector<float>& a_state) const;
+
+		/**
+			setState sets every body back to a state getState wrote.
+
+				@param1 a_state is the state.
+
+				@return false, changing nothing, if it isn't of as many
+						bodies as there are.
+		*/
+		bool setState(const std::vector<float>& a_state);
+
+		/**
+			getStats returns what the last step did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		/**
+			A node of the octree. Its children are next to each other, and
+				its bodies are a range of m_order, its children's ranges
+				one after another.
+		*/
+		struct Node
+		{
+			glm::vec3 centreOfMass;
+			float mass;
+
+			// The cube the node covers, for how far it is.
+			glm::vec3 centre;
+			float halfSize;
+
+			// 0 children for a leaf, the root is never a child.
+			unsigned int firstChild;
+			unsigned int childCount;
+
+			unsigned int firstBody;
+			unsigned int bodyCount;
+		};
+
+		// Works out every body's acceleration from where they are now.
+		void computeAccelerations();
+
+		// Sums the pull of every body on a range of them, four at a time.
+		//	Returns how many pairs were summed.
+		unsigned long long sumDirect(unsigned int a_first, unsigned int a_last);
+
+		// Builds the octree over every body.
+		void buildTree();
+
+		// Builds a node, already in m_nodes, over a range of m_order, and
+		//	its children after every node there is.
+		void buildNode(unsigned int a_node, unsigned int a_first, unsigned int a_last, const glm::vec3& a_centre,
+			float a_halfSize, unsigned int a_depth);
+
+		// Sums the pull of the octree on a range of bodies. Returns how
+		//	many bodies and nodes were summed.
+		unsigned long long sumTree(unsigned int a_first, unsigned int a_last);
+
+		// Runs a sum over every body, a chunk a job.
+		template <typename Sum>
+		unsigned long long sumChunks(Sum a_sum);
+
+		// Sizes every array to hold a body count rounded up to four, the
+		//	bodies past the count have no mass.
+		void resize(unsigned int a_count);
+
+		unsigned int m_count;
+
+		std::vector<float> m_positionX, m_positionY, m_positionZ;
+		std::vector<float> m_velocityX, m_velocityY, m_velocityZ;
+		std::vector<float> m_accelerationX, m_accelerationY, m_accelerationZ;
+		std::vector<float> m_mass;
+
+		// Whether the accelerations are of where the bodies are now.
+		bool m_accelerationsValid;
+
+		// The octree, rebuilt every step, and every body sorted into its
+		//	leaves. Kept to save allocating them again.
+		std::vector<Node> m_nodes;
+		std::vector<unsigned int> m_order;
+		std::vector<unsigned int> m_scratch;
+
+		float m_gravity;
+		float m_softening;
+		float m_theta;
+		float m_maxStep;
+
+		Stats m_stats;
+	};
+}
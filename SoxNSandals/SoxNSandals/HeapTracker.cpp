@@ -0,0 +1,282 @@
+/**
+	HeapTracker.cpp
+
+	Purpose: HeapTracker.cpp is the source file for the HeapTracker class,
+			and replaces the global operator new and delete. Every
+			allocation is counted by the category of code that made it,
+			so the frame can be kept free of heap allocations and a
+			change that adds some is caught.
+
+	@author Nathan Nette
+*/
+#include "HeapTracker.h"
+#include "Profiler.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace
+{
+	// How many threads get a slot of their own. Any more share the last,
+	//	which counts with atomic adds instead.
+	const unsigned int MAX_THREADS = 64;
+
+	/**
+		What one thread has counted since it started. Only the thread
+			writes its slot, endFrame reads every one.
+	*/
+	struct alignas(64) ThreadCounts
+	{
+		std::atomic<unsigned long long> allocations[sns::HeapTracker::MAX_CATEGORIES];
+		std::atomic<unsigned long long> bytes[sns::HeapTracker::MAX_CATEGORIES];
+		std::atomic<unsigned long long> frees;
+	};
+
+	// Zero initialised before anything runs, as operator new may be
+	//	called before any constructor is.
+	ThreadCounts s_threads[MAX_THREADS];
+	std::atomic<unsigned int> s_threadCount;
+
+	// Plain thread locals, so they need no constructor either. The slot
+	//	is 1 more than the index, 0 until the thread first allocates.
+	thread_local unsigned int t_slot = 0;
+	thread_local unsigned int t_category = sns::HeapTracker::OTHER;
+
+	std::mutex s_categoryMutex;
+	std::atomic<unsigned int> s_categoryCount(1);
+	const char* s_categoryNames[sns::HeapTracker::MAX_CATEGORIES] = { "Other" };
+
+	// The profiler counter of each category's allocations, made once with
+	//	the category so they outlive the profiler.
+	char s_counterNames[sns::HeapTracker::MAX_CATEGORIES][64] = { "Heap allocations/Other" };
+
+	// What every thread had counted at the last endFrame, and the frame
+	//	that ended there.
+	unsigned long long s_lastAllocations[sns::HeapTracker::MAX_CATEGORIES];
+	unsigned long long s_lastBytes[sns::HeapTracker::MAX_CATEGORIES];
+	unsigned long long s_lastFrees;
+	sns::HeapTracker::Frame s_frame;
+
+	ThreadCounts& getThreadCounts(bool& a_shared)
+	{
+		if (t_slot == 0)
+		{
+			unsigned int index = s_threadCount.fetch_add(1, std::memory_order_relaxed);
+			t_slot = (index < MAX_THREADS ? index : MAX_THREADS - 1) + 1;
+		}
+		a_shared = t_slot == MAX_THREADS;
+		return s_threads[t_slot - 1];
+	}
+
+	// Adds to a count of the calling thread's slot. Other threads only
+	//	read it, so a load and a store do, unless the slot is shared.
+	void add(std::atomic<unsigned long long>& a_count, unsigned long long a_value, bool a_shared)
+	{
+		if (a_shared)
+			a_count.fetch_add(a_value, std::memory_order_relaxed);
+		else
+			a_count.store(a_count.load(std::memory_order_relaxed) + a_value, std::memory_order_relaxed);
+	}
+
+	void* allocate(size_t a_size)
+	{
+		bool shared;
+		ThreadCounts& counts = getThreadCounts(shared);
+		add(counts.allocations[t_category], 1, shared);
+		add(counts.bytes[t_category], a_size, shared);
+
+		if (a_size == 0)
+			a_size = 1;
+		for (;;)
+		{
+			void* memory = malloc(a_size);
+			if (memory != nullptr)
+				return memory;
+
+			std::new_handler handler = std::get_new_handler();
+			if (handler == nullptr)
+				throw std::bad_alloc();
+			handler();
+		}
+	}
+
+	void deallocate(void* a_memory)
+	{
+		if (a_memory == nullptr)
+			return;
+
+		bool shared;
+		ThreadCounts& counts = getThreadCounts(shared);
+		add(counts.frees, 1, shared);
+		free(a_memory);
+	}
+}
+
+namespace sns
+{
+	/**
+		getCategory returns the category of a name, adding it the first
+			time.
+
+			@param1 a_name is the category's name, a string literal.
+	*/
+	unsigned int HeapTracker::getCategory(const char* a_name)
+	{
+		std::lock_guard<std::mutex> lock(s_categoryMutex);
+		unsigned int count = s_categoryCount.load(std::memory_order_relaxed);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			if (strcmp(s_categoryNames[i], a_name) == 0)
+				return i;
+		}
+		if (count == MAX_CATEGORIES)
+			return OTHER;
+
+		s_categoryNames[count] = a_name;
+		snprintf(s_counterNames[count], sizeof(s_counterNames[count]), "Heap allocations/%s", a_name);
+		s_categoryCount.store(count + 1, std::memory_order_release);
+		return count;
+	}
+
+	/**
+		endFrame works out what the frame allocated, and sets it as
+			profiler counters.
+	*/
+	void HeapTracker::endFrame()
+	{
+		unsigned long long allocations[MAX_CATEGORIES] = {};
+		unsigned long long bytes[MAX_CATEGORIES] = {};
+		unsigned long long frees = 0;
+
+		unsigned int threadCount = s_threadCount.load(std::memory_order_relaxed);
+		if (threadCount > MAX_THREADS)
+			threadCount = MAX_THREADS;
+		for (unsigned int t = 0; t < threadCount; ++t)
+		{
+			const ThreadCounts& counts = s_threads[t];
+			for (unsigned int c = 0; c < MAX_CATEGORIES; ++c)
+			{
+				allocations[c] += counts.allocations[c].load(std::memory_order_relaxed);
+				bytes[c] += counts.bytes[c].load(std::memory_order_relaxed);
+			}
+			frees += counts.frees.load(std::memory_order_relaxed);
+		}
+
+		s_frame.allocations = 0;
+		s_frame.bytes = 0;
+		s_frame.frees = frees - s_lastFrees;
+		s_frame.categoryCount = s_categoryCount.load(std::memory_order_acquire);
+		for (unsigned int c = 0; c < s_frame.categoryCount; ++c)
+		{
+			Category& category = s_frame.categories[c];
+			category.name = s_categoryNames[c];
+			category.allocations = allocations[c] - s_lastAllocations[c];
+			category.bytes = bytes[c] - s_lastBytes[c];
+			s_frame.allocations += category.allocations;
+			s_frame.bytes += category.bytes;
+		}
+		memcpy(s_lastAllocations, allocations, sizeof(allocations));
+		memcpy(s_lastBytes, bytes, sizeof(bytes));
+		s_lastFrees = frees;
+
+		// Setting the counters can allocate, which is counted in the frame
+		//	after, and only while the profiler records.
+		Profiler::setCounter("Heap allocations", (double)s_frame.allocations);
+		Profiler::setCounter("Heap KB", s_frame.bytes / 1024.0);
+		Profiler::setCounter("Heap frees", (double)s_frame.frees);
+		for (unsigned int c = 0; c < s_frame.categoryCount; ++c)
+		{
+			if (s_frame.categories[c].allocations > 0)
+				Profiler::setCounter(s_counterNames[c], (double)s_frame.categories[c].allocations);
+		}
+	}
+
+	/**
+		getFrame returns what the last frame endFrame finished allocated.
+	*/
+	const HeapTracker::Frame& HeapTracker::getFrame()
+	{
+		return s_frame;
+	}
+
+	/**
+		setCategory sets the category of the calling thread's allocations.
+
+			@param1 a_category is the category.
+
+			@return the category the thread was in.
+	*/
+	unsigned int HeapTracker::setCategory(unsigned int a_category)
+	{
+		unsigned int previous = t_category;
+		t_category = a_category < MAX_CATEGORIES ? a_category : OTHER;
+		return previous;
+	}
+}
+
+void* operator new(size_t a_size)
+{
+	return allocate(a_size);
+}
+
+void* operator new[](size_t a_size)
+{
+	return allocate(a_size);
+}
+
+void* operator new(size_t a_size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return allocate(a_size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t a_size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return allocate(a_size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void operator delete(void* a_memory) noexcept
+{
+	deallocate(a_memory);
+}
+
+void operator delete[](void* a_memory) noexcept
+{
+	deallocate(a_memory);
+}
+
+void operator delete(void* a_memory, size_t) noexcept
+{
+	deallocate(a_memory);
+}
+
+void operator delete[](void* a_memory, size_t) noexcept
+{
+	deallocate(a_memory);
+}
+
+void operator delete(void* a_memory, const std::nothrow_t&) noexcept
+{
+	deallocate(a_memory);
+}
+
+void operator delete[](void* a_memory, const std::nothrow_t&) noexcept
+{
+	deallocate(a_memory);
+}
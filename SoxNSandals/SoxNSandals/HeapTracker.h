@@ -0,0 +1,124 @@
+/**
+	HeapTracker.h
+
+	Purpose: HeapTracker.h is the header file for the HeapTracker class.
+			The HeapTracker counts every operator new and delete of each
+			frame, by the category of code that made them, so the frame
+			can be kept free of heap allocations and a change that adds
+			some is caught.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+// Counts the heap allocations of the rest of the enclosing block on the
+//	calling thread under a category, a string literal.
+#define SNS_HEAP_SCOPE(name) \
+	static const unsigned int SNS_HEAP_JOIN(heapCategory, __LINE__) = sns::HeapTracker::getCategory(name); \
+	sns::HeapScope SNS_HEAP_JOIN(heapScope, __LINE__)(SNS_HEAP_JOIN(heapCategory, __LINE__))
+
+#define SNS_HEAP_JOIN(a, b) SNS_HEAP_JOIN_EXPAND(a, b)
+#define SNS_HEAP_JOIN_EXPAND(a, b) a##b
+
+namespace sns
+{
+	/**
+		The HeapTracker class replaces the global operator new and delete
+			with ones that count before calling malloc and free. Each
+			thread counts into a slot of its own, with plain stores to a
+			thread local slot, so counting costs no locks and no shared
+			cache lines.
+
+		Allocations are counted under the category the thread is in,
+			set with SNS_HEAP_SCOPE, or OTHER outside every scope. Frees
+			are counted without one, as what frees memory is often far
+			from what allocated it.
+
+		endFrame adds up every thread's slot once a frame, and the
+			difference from the last frame is what getFrame returns.
+
+		Only operator new and delete are counted. malloc called directly,
+			by the CRT or libraries in C, can't be replaced portably
+			and isn't.
+	*/
+	class HeapTracker
+	{
+	public:
+		// How many categories there can be, OTHER included.
+		static const unsigned int MAX_CATEGORIES = 32;
+
+		// The category of allocations outside every scope.
+		static const unsigned int OTHER = 0;
+
+		/**
+			The allocations of one category in a frame.
+		*/
+		struct Category
+		{
+			const char* name;
+			unsigned long long allocations;
+			unsigned long long bytes;
+		};
+
+		/**
+			Everything counted in one frame.
+		*/
+		struct Frame
+		{
+			unsigned long long allocations;
+			unsigned long long bytes;
+			unsigned long long frees;
+
+			unsigned int categoryCount;
+			Category categories[MAX_CATEGORIES];
+		};
+
+		/**
+			getCategory returns the category of a name, adding it the first
+				time. Past MAX_CATEGORIES names are counted as OTHER.
+
+				@param1 a_name is the category's name, a string literal.
+		*/
+		static unsigned int getCategory(const char* a_name);
+
+		/**
+			endFrame works out what the frame allocated, and sets it as
+				profiler counters. Call it once a frame, on one thread.
+		*/
+		static void endFrame();
+
+		/**
+			getFrame returns what the last frame endFrame finished
+				allocated.
+		*/
+		static const Frame& getFrame();
+
+		/**
+			setCategory sets the category of the calling thread's
+				allocations. Use SNS_HEAP_SCOPE rather than calling it
+				directly.
+
+				@param1 a_category is the category.
+
+				@return the category the thread was in.
+		*/
+		static unsigned int setCategory(unsigned int a_category);
+	};
+
+	/**
+		The HeapScope class counts the calling thread's allocations under
+			a category while it exists, see SNS_HEAP_SCOPE.
+	*/
+	class HeapScope
+	{
+	public:
+		explicit HeapScope(unsigned int a_category) : m_previous(HeapTracker::setCategory(a_category)) {}
+		~HeapScope() { HeapTracker::setCategory(m_previous); }
+
+		HeapScope(const HeapScope&) = delete;
+		HeapScope& operator=(const HeapScope&) = delete;
+
+	private:
+		unsigned int m_previous;
+	};
+}
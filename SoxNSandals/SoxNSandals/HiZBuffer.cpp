@@ -0,0 +1,214 @@
+/**
+	HiZBuffer.cpp
+
+	Purpose: HiZBuffer.cpp is the source file for the HiZBuffer class.
+			The HiZBuffer holds the depth of the scene's large occluders
+			as a mip pyramid, so anything behind them can be culled
+			before it is drawn.
+
+	@author Nathan Nette
+*/
+#include "HiZBuffer.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+
+namespace sns
+{
+	// Must match local_size_x and local_size_y in the reduce shader.
+	static const int REDUCE_GROUP_SIZE = 8;
+
+	// The unit the reduce shader reads its source level from.
+	static const unsigned int SOURCE_UNIT = 0;
+
+	/**
+		nearestPowerOfTwo rounds a size to the power of two nearest it.
+
+			@param1 a_size is the size, at least 1.
+	*/
+	static int nearestPowerOfTwo(int a_size)
+	{
+		int power = 1;
+		while (power * 2 <= a_size)
+			power *= 2;
+		return a_size - power < power * 2 - a_size ? power : power * 2;
+	}
+
+	HiZBuffer::HiZBuffer()
+		: m_framebuffer(0),
+		m_depthTexture(0),
+		m_pyramid(0),
+		m_width(0),
+		m_height(0),
+		m_levelCount(0),
+		m_previousFramebuffer(0),
+		m_previousViewport()
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffer and textures.
+	*/
+	HiZBuffer::~HiZBuffer()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the framebuffer and pyramid and loads the reduce
+			shader.
+
+			@param1 a_width is about the width the occluders are drawn
+					at, rounded to a power of two.
+
+			@param2 a_height is about the height they are drawn at,
+					rounded the same way.
+
+			@return false without GL 4.3 or the shader, the buffer is
+					left uncreated.
+	*/
+	bool HiZBuffer::create(int a_width, int a_height)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("HiZBuffer: occlusion culling needs GL 4.3.\n");
+			return false;
+		}
+
+		if (m_reduceShader.getHandle() == 0)
+		{
+			m_reduceShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/hizReduce.comp");
+			if (m_reduceShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_reduceShader.getLastError());
+				return false;
+			}
+		}
+
+		// Depth is reversed or not for the whole run, so the furthest is
+		//	the smallest or largest from the start.
+		if (m_downsampler.isCreated() == false && m_downsampler.create(GL_R32F,
+			RenderState::instance().isReverseZ() ? MipDownsampler::MIN : MipDownsampler::MAX) == false)
+			return false;
+
+		m_width = nearestPowerOfTwo(a_width > 1 ? a_width : 1);
+		m_height = nearestPowerOfTwo(a_height > 1 ? a_height : 1);
+		m_levelCount = 1;
+		for (int size = m_width > m_height ? m_width : m_height; size > 1; size /= 2)
+			++m_levelCount;
+
+		// The depth is only ever read with texelFetch, so no filtering
+		//	or mips are needed for it to be complete. Everything is made
+		//	without being bound, so the render state stays right.
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_depthTexture);
+		glTextureStorage2D(m_depthTexture, 1, GL_DEPTH_COMPONENT32F, m_width, m_height);
+		glTextureParameteri(m_depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_pyramid);
+		glTextureStorage2D(m_pyramid, m_levelCount, GL_R32F, m_width, m_height);
+		GpuMemory& memory = GpuMemory::instance();
+		memory.trackTexture(m_depthTexture, GpuMemory::getTextureBytes(GL_DEPTH_COMPONENT32F, m_width, m_height),
+			GpuMemory::CULLING, "HiZBuffer");
+		memory.trackTexture(m_pyramid, GpuMemory::getTextureBytes(GL_R32F, m_width, m_height, 1, m_levelCount),
+			GpuMemory::CULLING, "HiZBuffer");
+		glTextureParameteri(m_pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(m_pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+		glNamedFramebufferDrawBuffer(m_framebuffer, GL_NONE);
+		glNamedFramebufferReadBuffer(m_framebuffer, GL_NONE);
+		bool complete = glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+		if (complete == false)
+		{
+			printf("HiZBuffer: the depth framebuffer isn't complete.\n");
+			destroy();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		begin binds and clears the depth framebuffer. The occluders are
+			drawn after it, with depth writes on.
+	*/
+	void HiZBuffer::begin()
+	{
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glViewport(0, 0, m_width, m_height);
+		RenderState::instance().setDepthMask(true);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	/**
+		end puts back the framebuffer and viewport begin replaced and
+			builds the pyramid from what was drawn. The first level copies
+			the depth, and the downsampler builds every level after,
+			keeping the furthest of the texels below each.
+	*/
+	void HiZBuffer::end()
+	{
+		static constexpr aie::UniformHandle SOURCE("Source");
+		static constexpr aie::UniformHandle SOURCE_LEVEL("SourceLevel");
+		static constexpr aie::UniformHandle REVERSE_Z("ReverseZ");
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+		glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+
+		RenderState& state = RenderState::instance();
+		m_reduceShader.bind();
+		m_reduceShader.bindUniform(SOURCE, (int)SOURCE_UNIT);
+		m_reduceShader.bindUniform(REVERSE_Z, state.isReverseZ() ? 1 : 0);
+
+		state.bindTexture(SOURCE_UNIT, m_depthTexture);
+		m_reduceShader.bindUniform(SOURCE_LEVEL, 0);
+		glBindImageTexture(0, m_pyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((m_width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+			(m_height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+		state.bindTexture(SOURCE_UNIT, 0);
+
+		// The levels below read the copy.
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		m_downsampler.downsample(m_pyramid, m_width, m_height, m_levelCount);
+	}
+
+	/**
+		bind binds the pyramid to a texture unit.
+
+			@param1 a_unit is the texture unit.
+	*/
+	void HiZBuffer::bind(unsigned int a_unit) const
+	{
+		RenderState::instance().bindTexture(a_unit, m_pyramid);
+	}
+
+	/**
+		destroy deletes the framebuffer and textures.
+	*/
+	void HiZBuffer::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		if (m_depthTexture != 0)
+		{
+			glDeleteTextures(1, &m_depthTexture);
+			state.onTextureDeleted(m_depthTexture);
+			GpuMemory::instance().releaseTexture(m_depthTexture);
+		}
+		if (m_pyramid != 0)
+		{
+			glDeleteTextures(1, &m_pyramid);
+			state.onTextureDeleted(m_pyramid);
+			GpuMemory::instance().releaseTexture(m_pyramid);
+		}
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = m_depthTexture = m_pyramid = 0;
+		m_width = m_height = m_levelCount = 0;
+	}
+}
@@ -0,0 +1,116 @@
+/**
+	HiZBuffer.h
+
+	Purpose: HiZBuffer.h is the header file for the HiZBuffer class. The
+			HiZBuffer holds the depth of the scene's large occluders as
+			a mip pyramid, so anything behind them can be culled before
+			it is drawn.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "MipDownsampler.h"
+#include "Shader.h"
+
+namespace sns
+{
+	/**
+		The HiZBuffer class owns a depth only framebuffer and an R32F
+			texture with a full mip chain, both rounded to the nearest
+			power of two in each direction so every level halves the one
+			above exactly. The occluders are drawn into the framebuffer
+			between begin and end, then end copies the depth into the
+			first level and the MipDownsampler builds the rest in one
+			dispatch, each texel keeping the furthest depth of the four
+			below it. A texel of any level is then at least as far away
+			as everything the occluders covered there.
+
+		Culling reads the pyramid with texelFetch at the level where a
+			box's screen rectangle is two texels wide at most, so four
+			reads cover it whatever its size.
+	*/
+	class HiZBuffer
+	{
+	public:
+		HiZBuffer();
+
+		/**
+			The deconstructor deletes the framebuffer and textures.
+		*/
+		~HiZBuffer();
+
+		HiZBuffer(const HiZBuffer&) = delete;
+		HiZBuffer& operator=(const HiZBuffer&) = delete;
+
+		/**
+			create makes the framebuffer and pyramid and loads the reduce
+				shader.
+
+				@param1 a_width is about the width the occluders are
+						drawn at.
+
+				@param2 a_height is about the height they are drawn at.
+
+				@return false without GL 4.3 or the shader, the buffer
+						is left uncreated.
+		*/
+		bool create(int a_width, int a_height);
+
+		/**
+			begin binds and clears the depth framebuffer. The occluders
+				are drawn after it, with depth writes on.
+		*/
+		void begin();
+
+		/**
+			end puts back the framebuffer and viewport begin replaced and
+				builds the pyramid from what was drawn.
+		*/
+		void end();
+
+		/**
+			bind binds the pyramid to a texture unit.
+
+				@param1 a_unit is the texture unit.
+		*/
+		void bind(unsigned int a_unit) const;
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_pyramid != 0; }
+
+		/**
+			getWidth and getHeight return the size of the pyramid's
+				first level.
+		*/
+		int getWidth() const { return m_width; }
+		int getHeight() const { return m_height; }
+
+		/**
+			getLevelCount returns how many levels the pyramid has.
+		*/
+		int getLevelCount() const { return m_levelCount; }
+
+	private:
+		// Deletes the framebuffer and textures.
+		void destroy();
+
+		// Copies the depth into the first level, and the levels below it
+		//	keep the furthest depth of the texels under each texel.
+		aie::ShaderProgram m_reduceShader;
+		MipDownsampler m_downsampler;
+
+		unsigned int m_framebuffer;
+		unsigned int m_depthTexture;
+		unsigned int m_pyramid;
+
+		int m_width;
+		int m_height;
+		int m_levelCount;
+
+		// The framebuffer and viewport bound before begin.
+		int m_previousFramebuffer;
+		int m_previousViewport[4];
+	};
+}
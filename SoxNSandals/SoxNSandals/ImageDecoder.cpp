@@ -0,0 +1,175 @@
+/**
+	ImageDecoder.cpp
+
+	Purpose: ImageDecoder.cpp is the source file for the ImageDecoder
+			class. The ImageDecoder is how an image file's bytes are
+			turned into pixels, so formats can be decoded by whichever
+			library does them fastest.
+
+	@author Nathan Nette
+*/
+#include "ImageDecoder.h"
+#include "stb_image.h"
+#include <cstdlib>
+#include <vector>
+
+#ifdef SNS_TURBOJPEG
+#include <turbojpeg.h>
+#pragma comment(lib, "turbojpeg.lib")
+#endif
+
+namespace sns
+{
+	namespace
+	{
+		/**
+			Decodes every format stb_image knows, jpg, png, bmp, tga,
+				psd, gif, hdr, pic and pnm.
+		*/
+		class StbDecoder : public ImageDecoder
+		{
+		public:
+			const char* getName() const override { return "stb_image"; }
+
+			bool accepts(const unsigned char* a_data, size_t a_size) const override
+			{
+				int x = 0, y = 0, comp = 0;
+				return stbi_info_from_memory(a_data, (int)a_size, &x, &y, &comp) != 0;
+			}
+
+			unsigned char* decode(const unsigned char* a_data, size_t a_size, Info& a_info) const override
+			{
+				int x = 0, y = 0, comp = 0;
+				unsigned char* pixels = stbi_load_from_memory(a_data, (int)a_size, &x, &y, &comp, STBI_default);
+				a_info = { (unsigned int)x, (unsigned int)y, (unsigned int)comp };
+				return pixels;
+			}
+		};
+
+#ifdef SNS_TURBOJPEG
+		/**
+			Decodes baseline and progressive JPEGs in grey or colour with
+				libjpeg-turbo. CMYK ones are left to stb_image.
+		*/
+		class TurboJpegDecoder : public ImageDecoder
+		{
+		public:
+			const char* getName() const override { return "libjpeg-turbo"; }
+
+			bool accepts(const unsigned char* a_data, size_t a_size) const override
+			{
+				return a_size >= 3 && a_data[0] == 0xff && a_data[1] == 0xd8 && a_data[2] == 0xff;
+			}
+
+			unsigned char* decode(const unsigned char* a_data, size_t a_size, Info& a_info) const override
+			{
+				// A decompressor a thread, as they can't be shared.
+				struct Handle
+				{
+					tjhandle handle = tjInitDecompress();
+					~Handle() { if (handle != nullptr) tjDestroy(handle); }
+				};
+				static thread_local Handle t_decompressor;
+				tjhandle handle = t_decompressor.handle;
+
+				int width = 0, height = 0, subsampling = 0, colourspace = 0;
+				if (handle == nullptr || tjDecompressHeader3(handle, a_data, (unsigned long)a_size, &width, &height,
+					&subsampling, &colourspace) != 0 || colourspace == TJCS_CMYK || colourspace == TJCS_YCCK)
+				{
+					return nullptr;
+				}
+
+				bool grey = colourspace == TJCS_GRAY;
+				unsigned int channels = grey ? 1 : 3;
+				unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * channels);
+				if (pixels == nullptr || tjDecompress2(handle, a_data, (unsigned long)a_size, pixels, width, 0, height,
+					grey ? TJPF_GRAY : TJPF_RGB, 0) != 0)
+				{
+					free(pixels);
+					return nullptr;
+				}
+				a_info = { (unsigned int)width, (unsigned int)height, channels };
+				return pixels;
+			}
+		};
+#endif
+
+		const StbDecoder STB_DECODER;
+
+		// In the order they are tried, stb_image last.
+		std::vector<const ImageDecoder*>& getDecoders()
+		{
+			static std::vector<const ImageDecoder*> decoders = []()
+			{
+				std::vector<const ImageDecoder*> builtIn;
+#ifdef SNS_TURBOJPEG
+				static const TurboJpegDecoder TURBO_JPEG_DECODER;
+				builtIn.push_back(&TURBO_JPEG_DECODER);
+#endif
+				builtIn.push_back(&STB_DECODER);
+				return builtIn;
+			}();
+			return decoders;
+		}
+	}
+
+	/**
+		add puts a decoder ahead of those already added.
+
+			@param1 a_decoder is the decoder, which must outlive every
+					decode.
+	*/
+	void ImageDecoder::add(const ImageDecoder* a_decoder)
+	{
+		std::vector<const ImageDecoder*>& decoders = getDecoders();
+		decoders.insert(decoders.begin(), a_decoder);
+	}
+
+	/**
+		decodeImage decodes a file with the first decoder that takes it,
+			then with stb_image should that one fail.
+
+			@param1 a_data is the file.
+
+			@param2 a_size is how many bytes it has.
+
+			@param3 a_info is set to the image's size and channels.
+
+			@return the pixels, to be freed with free, or null if no
+					decoder can decode it.
+	*/
+	unsigned char* ImageDecoder::decodeImage(const unsigned char* a_data, size_t a_size, Info& a_info)
+	{
+		a_info = {};
+		for (const ImageDecoder* decoder : getDecoders())
+		{
+			if (decoder != &STB_DECODER && decoder->accepts(a_data, a_size))
+			{
+				unsigned char* pixels = decoder->decode(a_data, a_size, a_info);
+				if (pixels != nullptr)
+					return pixels;
+				break;
+			}
+		}
+		return STB_DECODER.decode(a_data, a_size, a_info);
+	}
+
+	/**
+		getDecoderCount returns how many decoders there are, the
+			stb_image one included.
+	*/
+	unsigned int ImageDecoder::getDecoderCount()
+	{
+		return (unsigned int)getDecoders().size();
+	}
+
+	/**
+		getDecoder returns a decoder, 0 being the first tried.
+
+			@param1 a_index is below getDecoderCount.
+	*/
+	const ImageDecoder* ImageDecoder::getDecoder(unsigned int a_index)
+	{
+		return getDecoders()[a_index];
+	}
+}
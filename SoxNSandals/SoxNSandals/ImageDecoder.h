@@ -0,0 +1,116 @@
+/**
+	ImageDecoder.h
+
+	Purpose: ImageDecoder.h is the header file for the ImageDecoder
+			class. The ImageDecoder is how an image file's bytes are
+			turned into pixels, so formats can be decoded by whichever
+			library does them fastest.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstddef>
+
+namespace sns
+{
+	/**
+		The ImageDecoder class is the interface every image decoder
+			implements. Decoders are tried from the last added to the
+			first, and a file is decoded by the first that accepts its
+			first bytes. stb_image is always there at the end and takes
+			every format it knows, so a decoder that fails to decode a
+			file it accepted is followed by stb_image.
+
+		Building with SNS_TURBOJPEG adds libjpeg-turbo ahead of
+			stb_image for JPEGs, whose SIMD IDCT, upsampling and colour
+			conversion decode Sponza's large textures much faster. It needs turbojpeg.h on the include path and
+			turbojpeg.lib on the library path.
+
+		Pixels are decoded at eight bits a channel, the top row first,
+			into memory allocated with malloc so that they can be freed
+			with stbi_image_free like stb_image's own. add must be called
+			before any decoding starts, everything else is thread-safe.
+	*/
+	class ImageDecoder
+	{
+	public:
+		/**
+			The size and channels of an image.
+		*/
+		struct Info
+		{
+			unsigned int width;
+			unsigned int height;
+
+			// 1 for grey, 2 for grey and alpha, 3 for RGB and 4 for RGBA.
+			unsigned int channels;
+		};
+
+		virtual ~ImageDecoder() {}
+
+		/**
+			getName returns the name of the decoder, for reports.
+		*/
+		virtual const char* getName() const = 0;
+
+		/**
+			accepts returns whether the decoder takes a file, by its first
+				bytes.
+
+				@param1 a_data is the file.
+
+				@param2 a_size is how many bytes it has.
+		*/
+		virtual bool accepts(const unsigned char* a_data, size_t a_size) const = 0;
+
+		/**
+			decode decodes a file.
+
+				@param1 a_data is the file.
+
+				@param2 a_size is how many bytes it has.
+
+				@param3 a_info is set to the image's size and channels.
+
+				@return the pixels, to be freed with free, or null if the
+						file can't be decoded.
+		*/
+		virtual unsigned char* decode(const unsigned char* a_data, size_t a_size, Info& a_info) const = 0;
+
+		/**
+			add puts a decoder ahead of those already added.
+
+				@param1 a_decoder is the decoder, which must outlive
+						every decode.
+		*/
+		static void add(const ImageDecoder* a_decoder);
+
+		/**
+			decodeImage decodes a file with the first decoder that takes
+				it, then with stb_image should that one fail.
+
+				@param1 a_data is the file.
+
+				@param2 a_size is how many bytes it has.
+
+				@param3 a_info is set to the image's size and channels.
+
+				@return the pixels, to be freed with free, or null if no
+						decoder can decode it.
+		*/
+		static unsigned char* decodeImage(const unsigned char* a_data, size_t a_size, Info& a_info);
+
+		/**
+			getDecoderCount returns how many decoders there are, the
+				stb_image one included.
+		*/
+		static unsigned int getDecoderCount();
+
+		/**
+			getDecoder returns a decoder, 0 being the first tried.
+
+				@param1 a_index is below getDecoderCount.
+		*/
+		static const ImageDecoder* getDecoder(unsigned int a_index);
+	};
+}
@@ -0,0 +1,185 @@
+/**
+	Impostor.cpp
+
+	Purpose: Impostor.cpp is the source file for the Impostor class. An
+			Impostor holds a mesh baked into an octahedral atlas of
+			views, and draws copies of it as single cards showing the
+			view nearest the camera, for copies too far away for their
+			triangles to be worth drawing.
+
+	@author Nathan Nette
+*/
+#include "Impostor.h"
+#include "GpuMemory.h"
+#include "OBJMesh.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstring>
+
+namespace sns
+{
+	Impostor::Impostor()
+		: m_albedo(0),
+		m_normalDepth(0),
+		m_frames(0),
+		m_frameResolution(0),
+		m_hemisphere(false),
+		m_sphere(0),
+		m_vao(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the textures and the instance buffer.
+	*/
+	Impostor::~Impostor()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the atlas's textures, to be baked into. Any made
+			before are deleted.
+
+			@param1 a_frames is how many frames along each side.
+
+			@param2 a_frameResolution is how many texels along each side
+					of a frame, a power of two so the frames stay apart in
+					every mip level.
+
+			@param3 a_hemisphere is whether only the upper half is seen.
+
+			@param4 a_sphere is the mesh's bounding sphere in its own
+					space, the centre and radius.
+	*/
+	void Impostor::create(unsigned int a_frames, unsigned int a_frameResolution, bool a_hemisphere,
+		const glm::vec4& a_sphere)
+	{
+		destroy();
+		m_frames = a_frames;
+		m_frameResolution = a_frameResolution;
+		m_hemisphere = a_hemisphere;
+		m_sphere = a_sphere;
+
+		// Mipped down to a texel a frame and no further, past that
+		//	frames would be filtered into each other.
+		unsigned int size = a_frames * a_frameResolution;
+		unsigned int levels = 1;
+		while ((a_frameResolution >> levels) != 0)
+			++levels;
+		unsigned int* textures[2] = { &m_albedo, &m_normalDepth };
+		for (unsigned int* texture : textures)
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, texture);
+			glTextureStorage2D(*texture, levels, GL_RGBA8, size, size);
+			glTextureParameteri(*texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_MAX_LEVEL, levels - 1);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GpuMemory::instance().trackTexture(*texture, GpuMemory::getTextureBytes(GL_RGBA8, size, size, 1, levels),
+				GpuMemory::TEXTURES, "Impostor");
+		}
+	}
+
+	/**
+		destroy deletes the textures and the instance buffer.
+	*/
+	void Impostor::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		unsigned int* textures[2] = { &m_albedo, &m_normalDepth };
+		for (unsigned int* texture : textures)
+		{
+			if (*texture != 0)
+			{
+				glDeleteTextures(1, texture);
+				state.onTextureDeleted(*texture);
+				GpuMemory::instance().releaseTexture(*texture);
+				*texture = 0;
+			}
+		}
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			state.onVertexArrayDeleted(m_vao);
+			m_vao = 0;
+		}
+		m_instances.reset();
+	}
+
+	/**
+		bind binds the textures and points a program at them and the
+			atlas's layout.
+
+			@param1 a_shader is the program, already bound.
+	*/
+	void Impostor::bind(aie::ShaderProgram& a_shader) const
+	{
+		static constexpr aie::UniformHandle IMPOSTOR_ALBEDO("ImpostorAlbedo");
+		static constexpr aie::UniformHandle IMPOSTOR_NORMAL_DEPTH("ImpostorNormalDepth");
+		static constexpr aie::UniformHandle IMPOSTOR_FRAMES("ImpostorFrames");
+		static constexpr aie::UniformHandle IMPOSTOR_HEMISPHERE("ImpostorHemisphere");
+		static constexpr aie::UniformHandle IMPOSTOR_SPHERE("ImpostorSphere");
+		static constexpr aie::UniformHandle REVERSE_Z("ReverseZ");
+
+		RenderState& state = RenderState::instance();
+		state.bindTexture(ALBEDO_UNIT, m_albedo);
+		state.bindTexture(NORMAL_DEPTH_UNIT, m_normalDepth);
+		a_shader.bindUniform(IMPOSTOR_ALBEDO, (int)ALBEDO_UNIT);
+		a_shader.bindUniform(IMPOSTOR_NORMAL_DEPTH, (int)NORMAL_DEPTH_UNIT);
+		a_shader.bindUniform(IMPOSTOR_FRAMES, (int)m_frames);
+		a_shader.bindUniform(IMPOSTOR_HEMISPHERE, m_hemisphere ? 1 : 0);
+		a_shader.bindUniform(IMPOSTOR_SPHERE, m_sphere);
+		a_shader.bindUniform(REVERSE_Z, state.isReverseZ() ? 1 : 0);
+	}
+
+	/**
+		drawInstanced draws a card for each copy, with a program made
+			from impostorInstanced.vert and impostor.frag bound and bind
+			called.
+
+			@param1 a_transforms is each copy's model matrix, turned and
+					uniformly scaled only.
+
+			@param2 a_count is how many copies.
+	*/
+	void Impostor::drawInstanced(const glm::mat4* a_transforms, unsigned int a_count)
+	{
+		if (a_count == 0 || isCreated() == false)
+			return;
+
+		// Grown to twice what is needed, as OBJMesh's instances are, and
+		//	read through a vertex array of its own as the cards have no
+		//	vertices.
+		if (m_instances == nullptr || m_instances->getElementCount() < a_count)
+		{
+			if (m_instances == nullptr)
+				m_instances.reset(new StreamingBuffer());
+			m_instances->create(sizeof(glm::mat4), a_count * 2, "Impostor");
+			if (m_vao == 0)
+			{
+				glCreateVertexArrays(1, &m_vao);
+				for (unsigned int column = 0; column < 4; ++column)
+				{
+					unsigned int attribute = aie::OBJMesh::INSTANCE_ATTRIBUTE + column;
+					glEnableVertexArrayAttrib(m_vao, attribute);
+					glVertexArrayAttribFormat(m_vao, attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * column);
+					glVertexArrayAttribBinding(m_vao, attribute, 0);
+				}
+				glVertexArrayBindingDivisor(m_vao, 0, 1);
+			}
+			glVertexArrayVertexBuffer(m_vao, 0, m_instances->getHandle(), 0, sizeof(glm::mat4));
+		}
+
+		glm::mat4* region = (glm::mat4*)m_instances->beginWrite();
+		memcpy(region, a_transforms, a_count * sizeof(glm::mat4));
+		unsigned int firstInstance = m_instances->endWrite(a_count);
+
+		RenderState& state = RenderState::instance();
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, a_count, firstInstance);
+		m_instances->fence();
+	}
+}
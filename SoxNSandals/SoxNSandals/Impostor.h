@@ -0,0 +1,153 @@
+/**
+	Impostor.h
+
+	Purpose: Impostor.h is the header file for the Impostor class. An
+			Impostor holds a mesh baked into an octahedral atlas of
+			views, and draws copies of it as single cards showing the
+			view nearest the camera, for copies too far away for their
+			triangles to be worth drawing.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include "StreamingBuffer.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <memory>
+
+namespace sns
+{
+	/**
+		The Impostor class holds the two textures of an atlas,
+			frames by frames views of a mesh each from a direction across
+			the sphere around it, or only its upper half for meshes never
+			seen from below. The directions are laid out octahedrally, so
+			neighbouring frames are neighbouring directions and the frame
+			to show is found from the direction to the camera without a
+			search.
+
+		The albedo is the mesh's unlit colour, its alpha where the mesh
+			was drawn. The normal and depth holds the mesh's normal in its
+			own space and how far towards the frame's camera its surface
+			is across its bounding sphere, so a card can be lit and pushed
+			back to where the mesh was when it is drawn, meeting the ground
+			and other meshes as the mesh would.
+
+		ImpostorBaker fills it. It is drawn by a program with
+			impostor.glsl and impostor.frag, either drawInstanced's with
+			impostorInstanced.vert or one reading copies of its own, with
+			bind called first.
+	*/
+	class Impostor
+	{
+	public:
+		// The units bind puts the textures on.
+		static const unsigned int ALBEDO_UNIT = 0;
+		static const unsigned int NORMAL_DEPTH_UNIT = 1;
+
+		Impostor();
+
+		/**
+			The deconstructor deletes the textures and the instance
+				buffer.
+		*/
+		~Impostor();
+
+		Impostor(const Impostor&) = delete;
+		Impostor& operator=(const Impostor&) = delete;
+
+		/**
+			create makes the atlas's textures, to be baked into. Any made
+				before are deleted.
+
+				@param1 a_frames is how many frames along each side.
+
+				@param2 a_frameResolution is how many texels along each
+						side of a frame, a power of two so the frames stay
+						apart in every mip level.
+
+				@param3 a_hemisphere is whether only the upper half is seen.
+
+				@param4 a_sphere is the mesh's bounding sphere in its own
+						space, the centre and radius.
+		*/
+		void create(unsigned int a_frames, unsigned int a_frameResolution, bool a_hemisphere,
+			const glm::vec4& a_sphere);
+
+		/**
+			isCreated returns whether create was called.
+		*/
+		bool isCreated() const { return m_albedo != 0; }
+
+		/**
+			destroy deletes the textures and the instance buffer.
+		*/
+		void destroy();
+
+		/**
+			bind binds the textures and points a program at them and the
+				atlas's layout.
+
+				@param1 a_shader is the program, already bound.
+		*/
+		void bind(aie::ShaderProgram& a_shader) const;
+
+		/**
+			drawInstanced draws a card for each copy, with a program made
+				from impostorInstanced.vert and impostor.frag bound and
+				bind called.
+
+				@param1 a_transforms is each copy's model matrix, turned
+						and uniformly scaled only.
+
+				@param2 a_count is how many copies.
+		*/
+		void drawInstanced(const glm::mat4* a_transforms, unsigned int a_count);
+
+		/**
+			getAlbedo returns the colour texture, to bake into.
+		*/
+		unsigned int getAlbedo() const { return m_albedo; }
+
+		/**
+			getNormalDepth returns the normal and depth texture, to bake
+				into.
+		*/
+		unsigned int getNormalDepth() const { return m_normalDepth; }
+
+		/**
+			getFrames returns how many frames along each side.
+		*/
+		unsigned int getFrames() const { return m_frames; }
+
+		/**
+			getFrameResolution returns how many texels along each side of
+				a frame.
+		*/
+		unsigned int getFrameResolution() const { return m_frameResolution; }
+
+		/**
+			isHemisphere returns whether only the upper half is seen.
+		*/
+		bool isHemisphere() const { return m_hemisphere; }
+
+		/**
+			getSphere returns the mesh's bounding sphere in its own space.
+		*/
+		const glm::vec4& getSphere() const { return m_sphere; }
+
+	private:
+		unsigned int m_albedo;
+		unsigned int m_normalDepth;
+		unsigned int m_frames;
+		unsigned int m_frameResolution;
+		bool m_hemisphere;
+		glm::vec4 m_sphere;
+
+		// The transforms drawInstanced streams and the vertex array
+		//	reading them, made on first use.
+		std::unique_ptr<StreamingBuffer> m_instances;
+		unsigned int m_vao;
+	};
+}
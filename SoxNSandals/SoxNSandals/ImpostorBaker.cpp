@@ -0,0 +1,269 @@
+/**
+	ImpostorBaker.cpp
+
+	Purpose: ImpostorBaker.cpp is the source file for the ImpostorBaker
+			class. The ImpostorBaker draws a loaded mesh from every
+			direction of an octahedral layout into an Impostor's atlas,
+			its colour, normals and depth, once, so distant copies of it
+			can be drawn as cards.
+
+	@author Nathan Nette
+*/
+#include "ImpostorBaker.h"
+#include "OBJMesh.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	ImpostorBaker::ImpostorBaker()
+		: m_framebuffer(0),
+		m_depth(0),
+		m_depthSize(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffer and its depth.
+	*/
+	ImpostorBaker::~ImpostorBaker()
+	{
+		if (m_depth != 0)
+		{
+			glDeleteTextures(1, &m_depth);
+			RenderState::instance().onTextureDeleted(m_depth);
+			GpuMemory::instance().releaseTexture(m_depth);
+		}
+		glDeleteFramebuffers(1, &m_framebuffer);
+	}
+
+	/**
+		create loads the bake program and makes the framebuffer.
+
+			@return false without GL 4.5 or the program, it is left
+					uncreated.
+	*/
+	bool ImpostorBaker::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("ImpostorBaker: baking impostors needs GL 4.5.\n");
+			return false;
+		}
+
+		m_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/impostorBake.vert");
+		m_shader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/impostorBake.frag");
+		if (m_shader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_shader.getLastError());
+			return false;
+		}
+
+		m_downsampler.create(GL_RGBA8, MipDownsampler::AVERAGE);
+
+		glCreateFramebuffers(1, &m_framebuffer);
+		const unsigned int drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glNamedFramebufferDrawBuffers(m_framebuffer, 2, drawBuffers);
+		return true;
+	}
+
+	/**
+		bake draws a mesh into an impostor. It must be called outside of
+			any pass, it draws into a framebuffer of its own.
+
+			@param1 a_mesh is the mesh, loaded with its textures uploaded.
+
+			@param2 a_hemisphere is whether only the upper half is seen,
+					for a mesh standing on the ground.
+
+			@param3 a_impostor is created and baked into.
+
+			@param4 a_frames is how many frames along each side.
+
+			@return false if it isn't created or the mesh isn't loaded.
+	*/
+	bool ImpostorBaker::bake(const aie::OBJMesh& a_mesh, bool a_hemisphere, Impostor& a_impostor,
+		unsigned int a_frames)
+	{
+		static constexpr aie::UniformHandle BAKE_MATRIX("BakeMatrix");
+		static constexpr aie::UniformHandle IMPOSTOR_SPHERE("ImpostorSphere");
+		static constexpr aie::UniformHandle DIRECTION("Direction");
+		static constexpr aie::UniformHandle DIFFUSE_MAPPED("DiffuseMapped");
+
+		if (isCreated() == false || a_mesh.isLoaded() == false || a_mesh.getChunkCount() == 0)
+			return false;
+
+		// The sphere around the chunks' boxes, every frame is the same
+		//	size whichever way the mesh is seen.
+		const BoxList& bounds = a_mesh.getChunkBounds();
+		glm::vec3 lowest(0), highest(0);
+		for (size_t i = 0; i < bounds.centreX.size(); ++i)
+		{
+			glm::vec3 centre(bounds.centreX[i], bounds.centreY[i], bounds.centreZ[i]);
+			glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+			lowest = i == 0 ? centre - extent : glm::min(lowest, centre - extent);
+			highest = i == 0 ? centre + extent : glm::max(highest, centre + extent);
+		}
+		glm::vec3 centre = (lowest + highest) * 0.5f;
+		float radius = std::max(glm::length(highest - lowest) * 0.5f, 0.001f);
+		a_frames = std::max(a_frames, 1u);
+		a_impostor.create(a_frames, FRAME_RESOLUTION, a_hemisphere, glm::vec4(centre, radius));
+
+		unsigned int size = a_frames * FRAME_RESOLUTION;
+		GpuMemory& memory = GpuMemory::instance();
+		RenderState& state = RenderState::instance();
+		if (m_depthSize < size)
+		{
+			if (m_depth != 0)
+			{
+				glDeleteTextures(1, &m_depth);
+				state.onTextureDeleted(m_depth);
+				memory.releaseTexture(m_depth);
+			}
+			glCreateTextures(GL_TEXTURE_2D, 1, &m_depth);
+			glTextureStorage2D(m_depth, 1, GL_DEPTH_COMPONENT32F, size, size);
+			memory.trackTexture(m_depth, GpuMemory::getTextureBytes(GL_DEPTH_COMPONENT32F, size, size),
+				GpuMemory::RENDER_TARGETS, "ImpostorBaker");
+			glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_depth, 0);
+			m_depthSize = size;
+		}
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, a_impostor.getAlbedo(), 0);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT1, a_impostor.getNormalDepth(), 0);
+
+		int previousFramebuffer = 0;
+		int previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+		bool depthMask = state.getDepthMask();
+		bool blend = state.isBlendEnabled();
+		state.setDepthMask(true);
+		state.setBlend(false);
+		state.setDepthFunc(GL_LESS);
+
+		// Empty texels have no alpha, and a normal pointing up so the
+		//	mips along the edges still light sensibly.
+		const float clearAlbedo[4] = { 0, 0, 0, 0 };
+		const float clearNormalDepth[4] = { 0.5f, 1, 0.5f, 0 };
+		const float farDepth = 1.0f;
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, 0, clearAlbedo);
+		glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, 1, clearNormalDepth);
+		glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+
+		// The chunks' buffers are attached in turn to a vertex array of
+		//	the mesh's format, made for the bake.
+		unsigned int vao = 0;
+		glCreateVertexArrays(1, &vao);
+		aie::OBJMesh::setVertexArrayFormat(vao, 0, a_mesh.getVertexFormat());
+		unsigned int vertexSize = aie::OBJMesh::getVertexSize(a_mesh.getVertexFormat());
+		state.bindVertexArray(vao);
+
+		// With reversed depth clip z goes from 0 to 1, as the shadow
+		//	cascades move it.
+		const glm::mat4 zeroToOne(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0.5f, 0, 0, 0, 0.5f, 1);
+		const glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, radius * 2);
+		m_shader.bind();
+		m_shader.bindUniform(IMPOSTOR_SPHERE, glm::vec4(centre, radius));
+		for (unsigned int y = 0; y < a_frames; ++y)
+		{
+			for (unsigned int x = 0; x < a_frames; ++x)
+			{
+				// The same right and up impostor.glsl turns the card to.
+				glm::vec3 direction = getFrameDirection(x, y, a_frames, a_hemisphere);
+				glm::vec3 right = fabsf(direction.y) > 0.999f ? glm::vec3(1, 0, 0) :
+					glm::normalize(glm::cross(glm::vec3(0, 1, 0), direction));
+				glm::vec3 up = glm::cross(direction, right);
+				glm::mat4 bake = projection * glm::lookAt(centre + direction * radius, centre, up);
+				if (state.isReverseZ())
+					bake = zeroToOne * bake;
+				m_shader.bindUniform(BAKE_MATRIX, bake);
+				m_shader.bindUniform(DIRECTION, direction);
+				glViewport(x * FRAME_RESOLUTION, y * FRAME_RESOLUTION, FRAME_RESOLUTION, FRAME_RESOLUTION);
+
+				for (unsigned int i = 0; i < (unsigned int)a_mesh.getChunkCount(); ++i)
+				{
+					const aie::OBJMesh::MeshChunk& chunk = a_mesh.getChunk(i);
+					glVertexArrayVertexBuffer(vao, 0, chunk.vbo, 0, vertexSize);
+					glVertexArrayElementBuffer(vao, chunk.ibo);
+					bool mapped = false;
+					if (chunk.materialID >= 0)
+					{
+						const aie::OBJMesh::Material& material = a_mesh.getMaterial(chunk.materialID);
+						aie::OBJMesh::bindMaterial(material);
+						mapped = material.diffuseTexture != nullptr;
+					}
+					m_shader.bindUniform(DIFFUSE_MAPPED, mapped ? 1 : 0);
+					state.countDraw();
+					glDrawElements(GL_TRIANGLES, chunk.indexCount, chunk.indexType,
+						(void*)((size_t)chunk.lodFirstIndex[0] * aie::OBJMesh::getIndexSize(chunk.indexType)));
+				}
+			}
+		}
+
+		glDeleteVertexArrays(1, &vao);
+		state.onVertexArrayDeleted(vao);
+		state.setDepthMask(depthMask);
+		state.setBlend(blend);
+		state.setDepthFunc(state.getNearerDepthFunc());
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		if (m_downsampler.isCreated())
+		{
+			// The atlas is mipped down to a texel a frame, as Impostor
+			//	made it.
+			int size = (int)(a_impostor.getFrames() * a_impostor.getFrameResolution());
+			int levels = 1;
+			while ((a_impostor.getFrameResolution() >> levels) != 0)
+				++levels;
+			m_downsampler.downsample(a_impostor.getAlbedo(), size, size, levels);
+			m_downsampler.downsample(a_impostor.getNormalDepth(), size, size, levels);
+		}
+		else
+		{
+			glGenerateTextureMipmap(a_impostor.getAlbedo());
+			glGenerateTextureMipmap(a_impostor.getNormalDepth());
+		}
+		return true;
+	}
+
+	/**
+		getFrameDirection returns the direction a frame of an atlas is
+			seen from, as impostor.glsl decodes it.
+
+			@param1 a_x is the frame's column.
+
+			@param2 a_y is the frame's row.
+
+			@param3 a_frames is how many frames along each side.
+
+			@param4 a_hemisphere is whether only the upper half is seen.
+	*/
+	glm::vec3 ImpostorBaker::getFrameDirection(unsigned int a_x, unsigned int a_y, unsigned int a_frames,
+		bool a_hemisphere)
+	{
+		glm::vec2 v = (glm::vec2(a_x + 0.5f, a_y + 0.5f) / (float)a_frames) * 2.0f - 1.0f;
+		if (a_hemisphere)
+		{
+			glm::vec2 xz = glm::vec2(v.x + v.y, v.x - v.y) * 0.5f;
+			return glm::normalize(glm::vec3(xz.x, 1 - fabsf(xz.x) - fabsf(xz.y), xz.y));
+		}
+
+		// The lower half is folded out into the corners.
+		glm::vec3 n(v.x, 1 - fabsf(v.x) - fabsf(v.y), v.y);
+		if (n.y < 0)
+		{
+			glm::vec2 folded((1 - fabsf(n.z)) * (n.x >= 0 ? 1 : -1), (1 - fabsf(n.x)) * (n.z >= 0 ? 1 : -1));
+			n.x = folded.x;
+			n.z = folded.y;
+		}
+		return glm::normalize(n);
+	}
+}
@@ -0,0 +1,120 @@
+/**
+	ImpostorBaker.h
+
+	Purpose: ImpostorBaker.h is the header file for the ImpostorBaker
+			class. The ImpostorBaker draws a loaded mesh from every
+			direction of an octahedral layout into an Impostor's atlas,
+			its colour, normals and depth, once, so distant copies of it
+			can be drawn as cards.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Impostor.h"
+#include "MipDownsampler.h"
+#include "Shader.h"
+#include <glm/vec3.hpp>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	/**
+		The ImpostorBaker class holds the program and framebuffer that
+			impostors are baked with. Each frame of an atlas is the mesh's
+			bounding sphere seen orthographically from the direction the
+			centre of its cell decodes to, as impostor.glsl decodes it,
+			the mesh drawn unlit and with its alpha tested. The atlas is
+			mipped once every frame is drawn.
+
+		A bake is a few draws per frame of a mesh already on the gpu,
+			done once when the mesh and its textures have loaded, between
+			the passes of a frame rather than ahead of time, so nothing is
+			written to disk and a changed mesh is baked again when it is
+			next loaded.
+
+		Baking needs GL 4.5, without it create fails and nothing can be
+			baked.
+	*/
+	class ImpostorBaker
+	{
+	public:
+		// How many frames along each side of an atlas by default, and how
+		//	many texels along each side of a frame.
+		static const unsigned int DEFAULT_FRAMES = 8;
+		static const unsigned int FRAME_RESOLUTION = 128;
+
+		ImpostorBaker();
+
+		/**
+			The deconstructor deletes the framebuffer and its depth.
+		*/
+		~ImpostorBaker();
+
+		ImpostorBaker(const ImpostorBaker&) = delete;
+		ImpostorBaker& operator=(const ImpostorBaker&) = delete;
+
+		/**
+			create loads the bake program and makes the framebuffer.
+
+				@return false without GL 4.5 or the program, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_framebuffer != 0; }
+
+		/**
+			bake draws a mesh into an impostor. It must be called outside
+				of any pass, it draws into a framebuffer of its own.
+
+				@param1 a_mesh is the mesh, loaded with its textures
+						uploaded.
+
+				@param2 a_hemisphere is whether only the upper half is
+						seen, for a mesh standing on the ground.
+
+				@param3 a_impostor is created and baked into.
+
+				@param4 a_frames is how many frames along each side.
+
+				@return false if it isn't created or the mesh isn't loaded.
+		*/
+		bool bake(const aie::OBJMesh& a_mesh, bool a_hemisphere, Impostor& a_impostor,
+			unsigned int a_frames = DEFAULT_FRAMES);
+
+		/**
+			getFrameDirection returns the direction a frame of an atlas
+				is seen from, as impostor.glsl decodes it.
+
+				@param1 a_x is the frame's column.
+
+				@param2 a_y is the frame's row.
+
+				@param3 a_frames is how many frames along each side.
+
+				@param4 a_hemisphere is whether only the upper half is seen.
+		*/
+		static glm::vec3 getFrameDirection(unsigned int a_x, unsigned int a_y, unsigned int a_frames,
+			bool a_hemisphere);
+
+	private:
+		aie::ShaderProgram m_shader;
+		unsigned int m_framebuffer;
+
+		// Averages the atlases' mips, or glGenerateTextureMipmap does
+		//	without it.
+		MipDownsampler m_downsampler;
+
+		// The depth the frames are tested against, as large as the
+		//	largest atlas baked so far.
+		unsigned int m_depth;
+		unsigned int m_depthSize;
+	};
+}
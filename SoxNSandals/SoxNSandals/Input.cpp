@@ -0,0 +1,220 @@
+/**
+	Input.cpp
+
+	Purpose: Input.cpp is the source file for the Input class. The Input
+			class collects the window's keyboard and mouse events as
+			they arrive and turns them into the state each frame reads,
+			so nothing polls GLFW in the middle of a frame.
+
+	@author Nathan Nette
+*/
+#include "Input.h"
+#include "gl_core_4_5.h"
+#include <glfw3.h>
+#include <algorithm>
+
+namespace sns
+{
+	static_assert(GLFW_KEY_LAST < 349 && GLFW_MOUSE_BUTTON_LAST < 8, "Input's key and button counts are too small");
+
+	Input::Input()
+		: m_window(nullptr),
+		m_events(),
+		m_head(0),
+		m_tail(0),
+		m_dropped(0),
+		m_cursorDelta(0),
+		m_droppedEvents(0),
+		m_hadEvents(false),
+		m_cursorX(0),
+		m_cursorY(0),
+		m_hasCursor(false)
+	{
+		std::fill(m_keys, m_keys + KEY_COUNT, false);
+		std::fill(m_keysPressed, m_keysPressed + KEY_COUNT, false);
+		std::fill(m_buttons, m_buttons + BUTTON_COUNT, false);
+	}
+
+	/**
+		The deconstructor takes the callbacks off the window.
+	*/
+	Input::~Input()
+	{
+		detach();
+	}
+
+	/**
+		attach installs the callbacks on a window and disables its
+			cursor.
+
+			@param1 a_window is the window.
+	*/
+	void Input::attach(GLFWwindow* a_window)
+	{
+		detach();
+		m_window = a_window;
+		m_hasCursor = false;
+
+		glfwSetWindowUserPointer(m_window, this);
+		glfwSetKeyCallback(m_window, onKey);
+		glfwSetMouseButtonCallback(m_window, onButton);
+		glfwSetCursorPosCallback(m_window, onCursor);
+
+		// Once, rather than every frame.
+		glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
+
+	/**
+		detach takes the callbacks off the window again.
+	*/
+	void Input::detach()
+	{
+		if (m_window == nullptr)
+			return;
+
+		glfwSetKeyCallback(m_window, nullptr);
+		glfwSetMouseButtonCallback(m_window, nullptr);
+		glfwSetCursorPosCallback(m_window, nullptr);
+		glfwSetWindowUserPointer(m_window, nullptr);
+		m_window = nullptr;
+	}
+
+	/**
+		beginFrame polls the window's events and drains the queue into
+			the keys, buttons and cursor the frame reads.
+
+			@param1 a_timeout waits up to this many seconds for an event
+					first, for a frame with nothing else to do, 0 to only
+					poll.
+	*/
+	void Input::beginFrame(double a_timeout)
+	{
+		if (a_timeout > 0.0)
+			glfwWaitEventsTimeout(a_timeout);
+		else
+			glfwPollEvents();
+
+		std::fill(m_keysPressed, m_keysPressed + KEY_COUNT, false);
+		m_cursorDelta = glm::vec2(0);
+
+		// Acquire, so the events the tail counts past are written.
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		unsigned int tail = m_tail.load(std::memory_order_acquire);
+		m_hadEvents = head != tail;
+		for (; head != tail; ++head)
+		{
+			const Event& event = m_events[head % QUEUE_CAPACITY];
+			switch (event.type)
+			{
+			case EventType::KEY:
+				if (event.action == GLFW_PRESS)
+				{
+					m_keys[event.code] = true;
+					m_keysPressed[event.code] = true;
+				}
+				else if (event.action == GLFW_RELEASE)
+					m_keys[event.code] = false;
+				break;
+
+			case EventType::BUTTON:
+				if (event.action != GLFW_REPEAT)
+					m_buttons[event.code] = event.action == GLFW_PRESS;
+				break;
+
+			case EventType::CURSOR:
+				if (m_hasCursor)
+					m_cursorDelta += glm::vec2((float)(event.x - m_cursorX), (float)(event.y - m_cursorY));
+				m_cursorX = event.x;
+				m_cursorY = event.y;
+				m_hasCursor = true;
+				break;
+			}
+		}
+
+		// Release, so the writer only reuses events once they're read.
+		m_head.store(head, std::memory_order_release);
+		m_droppedEvents = m_dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	/**
+		wake makes a beginFrame waiting for events return, from any
+			thread.
+	*/
+	void Input::wake()
+	{
+		glfwPostEmptyEvent();
+	}
+
+	/**
+		isKeyDown returns whether a key is held.
+
+			@param1 a_key is a GLFW_KEY_ value.
+	*/
+	bool Input::isKeyDown(int a_key) const
+	{
+		return a_key >= 0 && a_key < KEY_COUNT && m_keys[a_key];
+	}
+
+	/**
+		wasKeyPressed returns whether a key went down since the last
+			frame.
+
+			@param1 a_key is a GLFW_KEY_ value.
+	*/
+	bool Input::wasKeyPressed(int a_key) const
+	{
+		return a_key >= 0 && a_key < KEY_COUNT && m_keysPressed[a_key];
+	}
+
+	/**
+		isButtonDown returns whether a mouse button is held.
+
+			@param1 a_button is a GLFW_MOUSE_BUTTON_ value.
+	*/
+	bool Input::isButtonDown(int a_button) const
+	{
+		return a_button >= 0 && a_button < BUTTON_COUNT && m_buttons[a_button];
+	}
+
+	/**
+		push adds an event to the queue, or counts it as dropped if the
+			queue is full.
+
+			@param1 a_event is the event.
+	*/
+	void Input::push(const Event& a_event)
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= QUEUE_CAPACITY)
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		m_events[tail % QUEUE_CAPACITY] = a_event;
+		m_tail.store(tail + 1, std::memory_order_release);
+	}
+
+	// The callbacks find their Input from the window's user pointer.
+	void Input::onKey(GLFWwindow* a_window, int a_key, int, int a_action, int)
+	{
+		Input* input = (Input*)glfwGetWindowUserPointer(a_window);
+		// Keys GLFW doesn't know are GLFW_KEY_UNKNOWN.
+		if (input != nullptr && a_key >= 0 && a_key < KEY_COUNT)
+			input->push({ EventType::KEY, a_key, a_action, 0.0, 0.0 });
+	}
+
+	void Input::onButton(GLFWwindow* a_window, int a_button, int a_action, int)
+	{
+		Input* input = (Input*)glfwGetWindowUserPointer(a_window);
+		if (input != nullptr && a_button >= 0 && a_button < BUTTON_COUNT)
+			input->push({ EventType::BUTTON, a_button, a_action, 0.0, 0.0 });
+	}
+
+	void Input::onCursor(GLFWwindow* a_window, double a_x, double a_y)
+	{
+		Input* input = (Input*)glfwGetWindowUserPointer(a_window);
+		if (input != nullptr)
+			input->push({ EventType::CURSOR, 0, 0, a_x, a_y });
+	}
+}
@@ -0,0 +1,180 @@
+/**
+	Input.h
+
+	Purpose: Input.h is the header file for the Input class. The Input
+			class collects the window's keyboard and mouse events as
+			they arrive and turns them into the state each frame reads,
+			so nothing polls GLFW in the middle of a frame.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/vec2.hpp>
+#include <atomic>
+
+struct GLFWwindow;
+
+namespace sns
+{
+	/**
+		The Input class installs GLFW callbacks on a window that push
+			every key, mouse button and cursor event into a queue.
+			beginFrame drains the queue once at the start of a frame,
+			and everything the frame asks after that is answered from
+			what was drained, so the whole frame sees the same input.
+
+		The queue is a ring with one writer, the callbacks, and one
+			reader, beginFrame, so neither ever takes a lock. The
+			callbacks run inside glfwPollEvents, which could be on
+			another thread from the one reading once rendering has its
+			own. If a frame takes so long the ring fills, the events
+			after are dropped and counted.
+
+		The cursor is disabled once on attach, which hides it and gives
+			unlimited movement, so nothing has to move it back to the
+			middle of the window each frame.
+	*/
+	class Input
+	{
+	public:
+		// How many events fit between two frames.
+		static const unsigned int QUEUE_CAPACITY = 1024;
+
+		Input();
+
+		/**
+			The deconstructor takes the callbacks off the window.
+		*/
+		~Input();
+
+		Input(const Input&) = delete;
+		Input& operator=(const Input&) = delete;
+
+		/**
+			attach installs the callbacks on a window and disables its
+				cursor. A window has one Input at most.
+
+				@param1 a_window is the window.
+		*/
+		void attach(GLFWwindow* a_window);
+
+		/**
+			detach takes the callbacks off the window again.
+		*/
+		void detach();
+
+		/**
+			beginFrame polls the window's events and drains the queue
+				into the keys, buttons and cursor the frame reads.
+
+				@param1 a_timeout waits up to this many seconds for an
+						event first, for a frame with nothing else to do,
+						0 to only poll.
+		*/
+		void beginFrame(double a_timeout = 0.0);
+
+		/**
+			isKeyDown returns whether a key is held.
+
+				@param1 a_key is a GLFW_KEY_ value.
+		*/
+		bool isKeyDown(int a_key) const;
+
+		/**
+			wasKeyPressed returns whether a key went down since the last
+				frame, so holding it only counts once.
+
+				@param1 a_key is a GLFW_KEY_ value.
+		*/
+		bool wasKeyPressed(int a_key) const;
+
+		/**
+			isButtonDown returns whether a mouse button is held.
+
+				@param1 a_button is a GLFW_MOUSE_BUTTON_ value.
+		*/
+		bool isButtonDown(int a_button) const;
+
+		/**
+			getCursorDelta returns how far the cursor moved since the
+				last frame in pixels, y down.
+		*/
+		const glm::vec2& getCursorDelta() const { return m_cursorDelta; }
+
+		/**
+			getDroppedEvents returns how many events didn't fit in the
+				queue since the last frame.
+		*/
+		unsigned int getDroppedEvents() const { return m_droppedEvents; }
+
+		/**
+			hadEvents returns whether any key, button or cursor event
+				arrived since the last frame.
+		*/
+		bool hadEvents() const { return m_hadEvents; }
+
+		/**
+			wake makes a beginFrame waiting for events return, from any
+				thread.
+		*/
+		static void wake();
+
+	private:
+		// The keys and buttons GLFW numbers, GLFW_KEY_LAST and
+		//	GLFW_MOUSE_BUTTON_LAST plus one.
+		static const int KEY_COUNT = 349;
+		static const int BUTTON_COUNT = 8;
+
+		enum class EventType : unsigned char
+		{
+			KEY,
+			BUTTON,
+			CURSOR
+		};
+
+		struct Event
+		{
+			EventType type;
+
+			// The key or button and GLFW_PRESS, GLFW_RELEASE or
+			//	GLFW_REPEAT.
+			int code;
+			int action;
+
+			// Where the cursor moved to.
+			double x;
+			double y;
+		};
+
+		// Adds an event to the queue, or counts it as dropped if the
+		//	queue is full. Only the callbacks call it.
+		void push(const Event& a_event);
+
+		static void onKey(GLFWwindow* a_window, int a_key, int a_scancode, int a_action, int a_mods);
+		static void onButton(GLFWwindow* a_window, int a_button, int a_action, int a_mods);
+		static void onCursor(GLFWwindow* a_window, double a_x, double a_y);
+
+		GLFWwindow* m_window;
+
+		// The ring. m_head is only written by the reader and m_tail only
+		//	by the writer, each counting up forever and wrapping into it.
+		Event m_events[QUEUE_CAPACITY];
+		std::atomic<unsigned int> m_head;
+		std::atomic<unsigned int> m_tail;
+		std::atomic<unsigned int> m_dropped;
+
+		// What the frame reads, from the events drained at its start.
+		bool m_keys[KEY_COUNT];
+		bool m_keysPressed[KEY_COUNT];
+		bool m_buttons[BUTTON_COUNT];
+		glm::vec2 m_cursorDelta;
+		unsigned int m_droppedEvents;
+		bool m_hadEvents;
+
+		// Where the cursor last was, and whether it has been anywhere
+		//	yet, so the first move isn't the whole way from 0.
+		double m_cursorX;
+		double m_cursorY;
+		bool m_hasCursor;
+	};
+}
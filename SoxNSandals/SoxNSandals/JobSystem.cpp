@@ -0,0 +1,425 @@
+/**
+	JobSystem.cpp
+
+	Purpose: JobSystem.cpp is the source file for the JobSystem class. The
+			JobSystem runs short jobs on a worker per core, with each
+			worker stealing from the others when it runs out, so work
+			split into many jobs spreads itself across the machine.
+
+	@author Nathan Nette
+*/
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include <chrono>
+
+namespace
+{
+	// The worker the calling thread is, -1 for threads that aren't workers.
+	thread_local int t_workerIndex = -1;
+
+	long long nowNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+namespace sns
+{
+	/**
+		instance returns the job system, starting its workers on the
+			first call. That call marks the main thread, so it must be
+			made from it.
+	*/
+	JobSystem& JobSystem::instance()
+	{
+		static JobSystem system;
+		return system;
+	}
+
+	/**
+		The constructor starts a worker for every core but the main
+			thread's.
+	*/
+	JobSystem::JobSystem()
+		: m_mainThread(std::this_thread::get_id()),
+		m_queued(0),
+		m_nextWorker(0),
+		m_mainQueued(0),
+		m_stopping(false),
+		m_statsStart(nowNanoseconds())
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		unsigned int workerCount = cores > 1 ? cores - 1 : 1;
+
+		// Every worker exists before any starts, since they steal from each other.
+		m_workers.reserve(workerCount);
+		for (unsigned int i = 0; i < workerCount; ++i)
+		{
+			std::unique_ptr<Worker> worker(new Worker());
+			worker->jobCount = 0;
+			worker->stealCount = 0;
+			worker->busyNanoseconds = 0;
+			m_workers.push_back(std::move(worker));
+		}
+
+		for (unsigned int i = 0; i < workerCount; ++i)
+			m_workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+	}
+
+	/**
+		The deconstructor throws away jobs that haven't started and waits
+			for the running ones.
+	*/
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stopping = true;
+		}
+		m_workCondition.notify_all();
+		m_doneCondition.notify_all();
+
+		for (auto& worker : m_workers)
+			worker->thread.join();
+	}
+
+	/**
+		run adds a job.
+
+			@param1 a_job is the function to run.
+
+			@param2 a_counter, if given, counts the job until it has
+					finished.
+
+			@param3 a_affinity is which threads may run it.
+	*/
+	void JobSystem::run(Job a_job, JobCounter* a_counter, Affinity a_affinity)
+	{
+		if (a_counter != nullptr)
+			a_counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+		schedule({ std::move(a_job), a_counter }, a_affinity == MAIN_THREAD);
+	}
+
+	/**
+		runAfter adds a job once every job counted by a dependency has
+			finished, straight away if they already have.
+
+			@param1 a_dependency is the counter to wait for.
+
+			@param2 a_job is the function to run.
+
+			@param3 a_counter, if given, counts the job from now until it
+					has finished.
+
+			@param4 a_affinity is which threads may run it.
+	*/
+	void JobSystem::runAfter(JobCounter& a_dependency, Job a_job, JobCounter* a_counter, Affinity a_affinity)
+	{
+		if (a_counter != nullptr)
+			a_counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+		{
+			// finish empties the continuations under the same lock, so the
+			//	job is either seen by it or sees the counter at zero.
+			std::lock_guard<std::mutex> lock(a_dependency.m_mutex);
+			if (a_dependency.isDone() == false)
+			{
+				a_dependency.m_continuations.push_back({ std::move(a_job), a_counter, a_affinity == MAIN_THREAD });
+				return;
+			}
+		}
+
+		schedule({ std::move(a_job), a_counter }, a_affinity == MAIN_THREAD);
+	}
+
+	/**
+		wait blocks until a counter reaches zero, running other jobs in
+			the meantime. On the main thread that includes the main
+			thread jobs.
+
+			@param1 a_counter is the counter to wait for.
+	*/
+	void JobSystem::wait(JobCounter& a_counter)
+	{
+		bool mainThread = isMainThread();
+		while (a_counter.isDone() == false)
+		{
+			Entry entry;
+			if ((mainThread && findMainThreadJob(entry)) || findJob(t_workerIndex, entry))
+			{
+				execute(entry);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_doneCondition.wait(lock, [&]()
+			{
+				return a_counter.isDone() || m_stopping || m_queued.load() > 0 ||
+					(mainThread && m_mainQueued.load() > 0);
+			});
+			if (m_stopping)
+				return;
+		}
+
+		// The last job may still hold the counter's lock as it finishes.
+		std::lock_guard<std::mutex> lock(a_counter.m_mutex);
+	}
+
+	/**
+		runMainThreadJobs runs every main thread job added so far. Jobs
+			those jobs add are left for the next call.
+
+			@return how many jobs were run.
+	*/
+	unsigned int JobSystem::runMainThreadJobs()
+	{
+		unsigned int available = m_mainQueued.load();
+		unsigned int count = 0;
+
+		Entry entry;
+		while (count < available && findMainThreadJob(entry))
+		{
+			execute(entry);
+			++count;
+		}
+		return count;
+	}
+
+	/**
+		getWorkerStats returns how busy a worker has been since the last
+			resetStats.
+
+			@param1 a_worker is the worker, below getWorkerCount.
+	*/
+	JobSystem::WorkerStats JobSystem::getWorkerStats(unsigned int a_worker) const
+	{
+		const Worker& worker = *m_workers[a_worker];
+		double elapsed = (nowNanoseconds() - m_statsStart.load()) * 1e-9;
+
+		WorkerStats stats;
+		stats.jobs = worker.jobCount.load();
+		stats.steals = worker.stealCount.load();
+		stats.busySeconds = worker.busyNanoseconds.load() * 1e-9;
+		stats.utilisation = elapsed > 0.0 ? stats.busySeconds / elapsed : 0.0;
+		return stats;
+	}
+
+	/**
+		resetStats starts counting every worker's stats again.
+	*/
+	void JobSystem::resetStats()
+	{
+		for (auto& worker : m_workers)
+		{
+			worker->jobCount = 0;
+			worker->stealCount = 0;
+			worker->busyNanoseconds = 0;
+		}
+		m_statsStart = nowNanoseconds();
+	}
+
+	/**
+		schedule puts a job in a queue. A worker adding a job keeps it in
+			its own deque, where it is likely still in cache. Anyone else
+			spreads their jobs between the workers.
+
+			@param1 a_entry is the job, its counter already counting it.
+
+			@param2 a_mainThread puts it with the main thread jobs.
+	*/
+	void JobSystem::schedule(Entry a_entry, bool a_mainThread)
+	{
+		if (a_mainThread)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mainMutex);
+				m_mainJobs.push_back(std::move(a_entry));
+			}
+			m_mainQueued.fetch_add(1);
+			notify(false);
+			return;
+		}
+
+		unsigned int index = t_workerIndex >= 0 ? (unsigned int)t_workerIndex :
+			m_nextWorker.fetch_add(1, std::memory_order_relaxed) % getWorkerCount();
+
+		Worker& worker = *m_workers[index];
+		{
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.jobs.push_back(std::move(a_entry));
+		}
+		m_queued.fetch_add(1);
+		notify(true);
+	}
+
+	/**
+		findJob takes a job, the worker's own newest or else the oldest
+			of another worker.
+
+			@param1 a_worker is the worker looking, -1 for other threads,
+					which only steal.
+
+			@param2 a_entry receives the job.
+
+			@return false if every deque was empty.
+	*/
+	bool JobSystem::findJob(int a_worker, Entry& a_entry)
+	{
+		if (m_queued.load() == 0)
+			return false;
+
+		if (a_worker >= 0)
+		{
+			Worker& own = *m_workers[a_worker];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (own.jobs.empty() == false)
+			{
+				a_entry = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				m_queued.fetch_sub(1);
+				return true;
+			}
+		}
+
+		unsigned int count = getWorkerCount();
+		unsigned int start = a_worker >= 0 ? (unsigned int)a_worker + 1 : 0;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			unsigned int victim = (start + i) % count;
+			if ((int)victim == a_worker)
+				continue;
+
+			Worker& other = *m_workers[victim];
+			std::lock_guard<std::mutex> lock(other.mutex);
+			if (other.jobs.empty() == false)
+			{
+				a_entry = std::move(other.jobs.front());
+				other.jobs.pop_front();
+				m_queued.fetch_sub(1);
+				if (a_worker >= 0)
+					++m_workers[a_worker]->stealCount;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+		findMainThreadJob takes the oldest main thread job.
+
+			@param1 a_entry receives the job.
+
+			@return false if there were none.
+	*/
+	bool JobSystem::findMainThreadJob(Entry& a_entry)
+	{
+		if (m_mainQueued.load() == 0)
+			return false;
+
+		std::lock_guard<std::mutex> lock(m_mainMutex);
+		if (m_mainJobs.empty())
+			return false;
+
+		a_entry = std::move(m_mainJobs.front());
+		m_mainJobs.pop_front();
+		m_mainQueued.fetch_sub(1);
+		return true;
+	}
+
+	/**
+		execute runs a job and finishes its counter. On a worker the time
+			it took is added to the worker's stats.
+
+			@param1 a_entry is the job.
+	*/
+	void JobSystem::execute(Entry& a_entry)
+	{
+		long long start = nowNanoseconds();
+		{
+			SNS_PROFILE_SCOPE("Job");
+			a_entry.job();
+		}
+
+		if (t_workerIndex >= 0)
+		{
+			Worker& worker = *m_workers[t_workerIndex];
+			worker.busyNanoseconds += (unsigned long long)(nowNanoseconds() - start);
+			++worker.jobCount;
+		}
+
+		// The job's captures are released before anyone waiting is woken.
+		a_entry.job = nullptr;
+		finish(a_entry.counter);
+	}
+
+	/**
+		finish counts a job as finished. When its counter reaches zero,
+			the jobs waiting for it are started and waits are woken.
+
+			@param1 a_counter is the job's counter, may be nullptr.
+	*/
+	void JobSystem::finish(JobCounter* a_counter)
+	{
+		if (a_counter == nullptr)
+			return;
+
+		std::vector<JobCounter::Continuation> continuations;
+		{
+			std::lock_guard<std::mutex> lock(a_counter->m_mutex);
+			if (a_counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			continuations.swap(a_counter->m_continuations);
+		}
+
+		for (auto& continuation : continuations)
+			schedule({ std::move(continuation.job), continuation.counter }, continuation.mainThread);
+
+		notify(false);
+	}
+
+	/**
+		notify wakes whoever may now have something to do.
+
+			@param1 a_work wakes a sleeping worker as well, for a new job.
+	*/
+	void JobSystem::notify(bool a_work)
+	{
+		// Taking the lock means nobody is between checking and sleeping.
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		if (a_work)
+			m_workCondition.notify_one();
+		m_doneCondition.notify_all();
+	}
+
+	/**
+		workerLoop is what each worker thread runs. It runs jobs until
+			there are none left anywhere, then sleeps until one is added.
+
+			@param1 a_index is the worker's index.
+	*/
+	void JobSystem::workerLoop(unsigned int a_index)
+	{
+		SNS_TRACE_THREAD("Job worker");
+		t_workerIndex = (int)a_index;
+
+		for (;;)
+		{
+			Entry entry;
+			if (findJob((int)a_index, entry))
+			{
+				execute(entry);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_workCondition.wait(lock, [this]() { return m_stopping || m_queued.load() > 0; });
+			if (m_stopping)
+				return;
+		}
+	}
+}
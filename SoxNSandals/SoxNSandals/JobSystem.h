@@ -0,0 +1,252 @@
+/**
+	JobSystem.h
+
+	Purpose: JobSystem.h is the header file for the JobSystem class. The
+			JobSystem runs short jobs on a worker per core, with each
+			worker stealing from the others when it runs out, so work
+			split into many jobs spreads itself across the machine.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sns
+{
+	class JobSystem;
+
+	/**
+		The JobCounter class counts the jobs of a group that haven't
+			finished. Jobs can be made to wait for a counter, and
+			JobSystem::wait waits for one to reach zero.
+	*/
+	class JobCounter
+	{
+	public:
+		JobCounter() : m_pending(0) {}
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		/**
+			isDone returns whether every job counted by it has finished.
+		*/
+		bool isDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		// A job waiting for this counter to reach zero.
+		struct Continuation
+		{
+			std::function<void()> job;
+			JobCounter* counter;
+			bool mainThread;
+		};
+
+		std::atomic<unsigned int> m_pending;
+
+		// Guards the continuations, so a job can't be added as they are started.
+		std::mutex m_mutex;
+		std::vector<Continuation> m_continuations;
+	};
+
+	/**
+		The JobSystem class is the engine's shared pool of workers. Each
+			worker has its own deque of jobs, running the newest of its
+			own and stealing the oldest of another's when it is empty.
+
+		Jobs that must run on the main thread, like anything using
+			opengl, are kept apart and only run when the main thread
+			calls runMainThreadJobs or waits.
+	*/
+	class JobSystem
+	{
+	public:
+		typedef std::function<void()> Job;
+
+		/**
+			Which threads a job may run on.
+		*/
+		enum Affinity
+		{
+			ANY_THREAD,
+			MAIN_THREAD
+		};
+
+		/**
+			How busy one worker has been since the last resetStats.
+		*/
+		struct WorkerStats
+		{
+			unsigned long long jobs;
+			unsigned long long steals;
+			double busySeconds;
+
+			// The part of the time since resetStats spent running jobs.
+			double utilisation;
+		};
+
+		/**
+			instance returns the job system, starting its workers on the
+				first call. That call marks the main thread, so it must
+				be made from it.
+		*/
+		static JobSystem& instance();
+
+		/**
+			The deconstructor throws away jobs that haven't started and
+				waits for the running ones.
+		*/
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		/**
+			run adds a job.
+
+				@param1 a_job is the function to run.
+
+				@param2 a_counter, if given, counts the job until it
+						has finished.
+
+				@param3 a_affinity is which threads may run it.
+		*/
+		void run(Job a_job, JobCounter* a_counter = nullptr, Affinity a_affinity = ANY_THREAD);
+
+		/**
+			runAfter adds a job once every job counted by a dependency
+				has finished, straight away if they already have.
+
+				@param1 a_dependency is the counter to wait for.
+
+				@param2 a_job is the function to run.
+
+				@param3 a_counter, if given, counts the job from now
+						until it has finished.
+
+				@param4 a_affinity is which threads may run it.
+		*/
+		void runAfter(JobCounter& a_dependency, Job a_job, JobCounter* a_counter = nullptr,
+			Affinity a_affinity = ANY_THREAD);
+
+		/**
+			wait blocks until a counter reaches zero, running other jobs
+				in the meantime. On the main thread that includes the
+				main thread jobs. A counter must not be destroyed while
+				its jobs are running unless wait on it has returned.
+
+				@param1 a_counter is the counter to wait for.
+		*/
+		void wait(JobCounter& a_counter);
+
+		/**
+			runMainThreadJobs runs every main thread job added so far.
+				Only the main thread may call it, usually once a frame.
+
+				@return how many jobs were run.
+		*/
+		unsigned int runMainThreadJobs();
+
+		/**
+			isMainThread returns whether the calling thread is the main one.
+		*/
+		bool isMainThread() const { return std::this_thread::get_id() == m_mainThread; }
+
+		/**
+			getWorkerCount returns how many worker threads there are.
+		*/
+		unsigned int getWorkerCount() const { return (unsigned int)m_workers.size(); }
+
+		/**
+			getWorkerStats returns how busy a worker has been since the
+				last resetStats.
+
+				@param1 a_worker is the worker, below getWorkerCount.
+		*/
+		WorkerStats getWorkerStats(unsigned int a_worker) const;
+
+		/**
+			resetStats starts counting every worker's stats again.
+		*/
+		void resetStats();
+
+	private:
+		// A queued job and the counter it finishes.
+		struct Entry
+		{
+			Job job;
+			JobCounter* counter;
+		};
+
+		// A worker thread and its own jobs.
+		struct Worker
+		{
+			std::thread thread;
+			std::mutex mutex;
+			std::deque<Entry> jobs;
+
+			std::atomic<unsigned long long> jobCount;
+			std::atomic<unsigned long long> stealCount;
+			std::atomic<unsigned long long> busyNanoseconds;
+		};
+
+		/**
+			The constructor starts a worker for every core but the main
+				thread's.
+		*/
+		JobSystem();
+
+		// Puts a job in a queue, its counter already counting it.
+		void schedule(Entry a_entry, bool a_mainThread);
+
+		// Takes a job, the worker's own newest or else another's oldest.
+		bool findJob(int a_worker, Entry& a_entry);
+
+		// Takes the oldest main thread job.
+		bool findMainThreadJob(Entry& a_entry);
+
+		// Runs a job and finishes its counter.
+		void execute(Entry& a_entry);
+
+		// Counts a job as finished, starting what waited for its counter.
+		void finish(JobCounter* a_counter);
+
+		// Wakes the workers and waiters after a job is added or a
+		//	counter reaches zero.
+		void notify(bool a_work);
+
+		// What each worker thread runs.
+		void workerLoop(unsigned int a_index);
+
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		std::thread::id m_mainThread;
+
+		// How many jobs are in the workers' deques.
+		std::atomic<unsigned int> m_queued;
+
+		// Spreads jobs added from outside the workers between them.
+		std::atomic<unsigned int> m_nextWorker;
+
+		std::mutex m_mainMutex;
+		std::deque<Entry> m_mainJobs;
+		std::atomic<unsigned int> m_mainQueued;
+
+		// Workers sleep on m_workCondition, waits on m_doneCondition.
+		std::mutex m_sleepMutex;
+		std::condition_variable m_workCondition;
+		std::condition_variable m_doneCondition;
+		bool m_stopping;
+
+		// When the stats were last reset, in nanoseconds of the clock.
+		std::atomic<long long> m_statsStart;
+	};
+}
@@ -0,0 +1,201 @@
+/**
+	Json.cpp
+
+	Purpose: Json.cpp is the source file for the JsonValue and JsonReader
+			classes. They read the JSON documents the engine's content
+			is authored in, scenes and glTF models, whole into memory.
+
+	@author Nathan Nette
+*/
+#include "Json.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace sns
+{
+	/**
+		find finds a member of an object.
+
+			@param1 a_name is the member's name.
+
+			@return the member, or nullptr if there isn't one.
+	*/
+	const JsonValue* JsonValue::find(const char* a_name) const
+	{
+		for (const auto& member : members)
+		{
+			if (member.first == a_name)
+				return &member.second;
+		}
+		return nullptr;
+	}
+
+	JsonReader::JsonReader(const char* a_text, size_t a_size)
+		: m_text(a_text),
+		m_end(a_text + a_size),
+		m_line(1)
+	{
+	}
+
+	/**
+		read reads the whole document.
+
+			@param1 a_value is set to the document's value.
+
+			@return false at the first error, see getError.
+	*/
+	bool JsonReader::read(JsonValue& a_value)
+	{
+		if (readValue(a_value) == false)
+			return false;
+		skipSpace();
+		return m_text == m_end || fail("expected the end of the file");
+	}
+
+	bool JsonReader::fail(const char* a_error)
+	{
+		if (m_error.empty())
+			m_error = a_error;
+		return false;
+	}
+
+	void JsonReader::skipSpace()
+	{
+		while (m_text < m_end && (*m_text == ' ' || *m_text == '\t' || *m_text == '\r' || *m_text == '\n'))
+		{
+			if (*m_text == '\n')
+				++m_line;
+			++m_text;
+		}
+	}
+
+	bool JsonReader::match(const char* a_word)
+	{
+		size_t length = strlen(a_word);
+		if ((size_t)(m_end - m_text) < length || strncmp(m_text, a_word, length) != 0)
+			return false;
+		m_text += length;
+		return true;
+	}
+
+	bool JsonReader::readValue(JsonValue& a_value)
+	{
+		skipSpace();
+		if (m_text == m_end)
+			return fail("expected a value");
+
+		switch (*m_text)
+		{
+		case '{':
+			return readObject(a_value);
+		case '[':
+			return readArray(a_value);
+		case '"':
+			a_value.type = JsonValue::STRING;
+			return readString(a_value.string);
+		default:
+			break;
+		}
+
+		if (match("true") || match("false"))
+		{
+			a_value.type = JsonValue::BOOLEAN;
+			a_value.boolean = m_text[-1] == 'e' && m_text[-2] == 'u'; // "true", not "false"
+			return true;
+		}
+		if (match("null"))
+		{
+			a_value.type = JsonValue::NUL;
+			return true;
+		}
+
+		// strtod stops at the end of the number, the text past the end
+		//	of the document is never reached as it ends with } or ].
+		char* end = nullptr;
+		a_value.type = JsonValue::NUMBER;
+		a_value.number = strtod(m_text, &end);
+		if (end == m_text || end > m_end)
+			return fail("expected a value");
+		m_text = end;
+		return true;
+	}
+
+	bool JsonReader::readString(std::string& a_string)
+	{
+		++m_text;
+		while (m_text < m_end && *m_text != '"')
+		{
+			// Names and paths only need the simple escapes.
+			if (*m_text == '\\' && m_text + 1 < m_end)
+			{
+				++m_text;
+				switch (*m_text)
+				{
+				case 'n': a_string += '\n'; break;
+				case 't': a_string += '\t'; break;
+				default: a_string += *m_text; break;
+				}
+			}
+			else if (*m_text == '\n')
+				return fail("strings can't span lines");
+			else
+				a_string += *m_text;
+			++m_text;
+		}
+		if (m_text == m_end)
+			return fail("expected the end of a string");
+		++m_text;
+		return true;
+	}
+
+	bool JsonReader::readArray(JsonValue& a_value)
+	{
+		a_value.type = JsonValue::ARRAY;
+		++m_text;
+		skipSpace();
+		if (match("]"))
+			return true;
+
+		while (true)
+		{
+			a_value.items.emplace_back();
+			if (readValue(a_value.items.back()) == false)
+				return false;
+			skipSpace();
+			if (match("]"))
+				return true;
+			if (match(",") == false)
+				return fail("expected , or ]");
+		}
+	}
+
+	bool JsonReader::readObject(JsonValue& a_value)
+	{
+		a_value.type = JsonValue::OBJECT;
+		++m_text;
+		skipSpace();
+		if (match("}"))
+			return true;
+
+		while (true)
+		{
+			skipSpace();
+			a_value.members.emplace_back();
+			auto& member = a_value.members.back();
+			if (m_text == m_end || *m_text != '"')
+				return fail("expected a name");
+			if (readString(member.first) == false)
+				return false;
+			skipSpace();
+			if (match(":") == false)
+				return fail("expected :");
+			if (readValue(member.second) == false)
+				return false;
+			skipSpace();
+			if (match("}"))
+				return true;
+			if (match(",") == false)
+				return fail("expected , or }");
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/**
+	Json.h
+
+	Purpose: Json.h is the header file for the JsonValue and JsonReader
+			classes. They read the JSON documents the engine's content
+			is authored in, scenes and glTF models, whole into memory.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sns
+{
+	/**
+		A JSON value. The documents read with it are small enough to
+			hold whole before they are turned into what they describe,
+			the bulk of a model is in its binary buffers.
+	*/
+	struct JsonValue
+	{
+		enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+		Type type = NUL;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<JsonValue> items;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		/**
+			find finds a member of an object.
+
+				@param1 a_name is the member's name.
+
+				@return the member, or nullptr if there isn't one.
+		*/
+		const JsonValue* find(const char* a_name) const;
+	};
+
+	/**
+		The JsonReader reads a JSON document into a JsonValue, stopping at
+			the first error with the line it was on.
+	*/
+	class JsonReader
+	{
+	public:
+		/**
+			The document must end with its closing } or ], anything after
+				it but spaces is an error.
+
+				@param1 a_text is the document, which needn't end with a 0.
+
+				@param2 a_size is its size in bytes.
+		*/
+		JsonReader(const char* a_text, size_t a_size);
+
+		/**
+			read reads the whole document.
+
+				@param1 a_value is set to the document's value.
+
+				@return false at the first error, see getError.
+		*/
+		bool read(JsonValue& a_value);
+
+		const std::string& getError() const { return m_error; }
+		unsigned int getLine() const { return m_line; }
+
+	private:
+		bool fail(const char* a_error);
+		void skipSpace();
+		bool match(const char* a_word);
+		bool readValue(JsonValue& a_value);
+		bool readString(std::string& a_string);
+		bool readArray(JsonValue& a_value);
+		bool readObject(JsonValue& a_value);
+
+		const char* m_text;
+		const char* m_end;
+		unsigned int m_line;
+		std::string m_error;
+	};
+}
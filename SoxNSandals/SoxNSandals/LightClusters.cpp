@@ -0,0 +1,356 @@
+/**
+	LightClusters.cpp
+
+	Purpose: LightClusters.cpp is the source file for the LightClusters
+			class. The LightClusters bin the scene's point and spot
+			lights, and its decals, into froxels of the camera's view,
+			so each fragment only loops over the few that can reach it.
+
+	@author Nathan Nette
+*/
+#include "LightClusters.h"
+#include "DecalAtlas.h"
+#include "GpuMemory.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	// Must match local_size_x in the binning shader.
+	static const unsigned int BIN_GROUP_SIZE = 64;
+
+	// The buffer bindings the binning shader reads and writes.
+	static const unsigned int LIGHT_BINDING = 0;
+	static const unsigned int GRID_BINDING = 1;
+	static const unsigned int INDEX_BINDING = 2;
+	static const unsigned int DECAL_BINDING = 3;
+
+	// Each cluster's slots in the index list, its lights' then its
+	//	decals'.
+	static const unsigned int CLUSTER_INDICES = LightClusters::MAX_LIGHTS_PER_CLUSTER +
+		LightClusters::MAX_DECALS_PER_CLUSTER;
+
+	LightClusters::LightClusters()
+		: m_decalAtlas(nullptr),
+		m_lightBuffer(0),
+		m_gridBuffer(0),
+		m_indexBuffer(0),
+		m_lightTexture(0),
+		m_gridTexture(0),
+		m_indexTexture(0),
+		m_decalBuffer(0),
+		m_decalTexture(0),
+		m_lightCount(0),
+		m_decalCount(0),
+		m_scale(0.0f)
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffers.
+	*/
+	LightClusters::~LightClusters()
+	{
+		destroy();
+	}
+
+	/**
+		makeDecal lays out a decal, moving the box from -0.5 to 0.5 into 0
+			to 1 so its x and y are the texture coordinates.
+
+			@param1 a_transform places the box.
+
+			@param2 a_layer is the DecalAtlas layer it shows.
+
+			@param3 a_opacity is how opaque it is at most.
+
+			@return the decal.
+	*/
+	LightClusters::Decal LightClusters::makeDecal(const glm::mat4& a_transform, int a_layer, float a_opacity)
+	{
+		glm::mat4 projection = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::inverse(a_transform);
+
+		// Half the box's diagonal, for the placements getTransform makes,
+		//	whose sides are at right angles.
+		float radius = 0.5f * std::sqrt(glm::dot(a_transform[0], a_transform[0]) +
+			glm::dot(a_transform[1], a_transform[1]) + glm::dot(a_transform[2], a_transform[2]));
+
+		Decal decal;
+		decal.sphere = glm::vec4(glm::vec3(a_transform[3]), radius);
+		for (int i = 0; i < 3; ++i)
+			decal.projection[i] = glm::row(projection, i);
+		decal.parameters = glm::vec4((float)a_layer, a_opacity, 0.0f, 0.0f);
+		return decal;
+	}
+
+	/**
+		create makes the buffers and loads the binning shader.
+
+			@return false without GL 4.3 or the shader.
+	*/
+	bool LightClusters::create()
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("LightClusters: clustered lights need GL 4.3.\n");
+			return false;
+		}
+
+		// Every cluster has room for MAX_LIGHTS_PER_CLUSTER light and
+		//	MAX_DECALS_PER_CLUSTER decal indices, more texels than the
+		//	least a texture buffer must hold.
+		int maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		if ((unsigned int)maxTexels < CLUSTER_COUNT * CLUSTER_INDICES)
+		{
+			printf("LightClusters: texture buffers hold %d texels, %u are needed.\n",
+				maxTexels, CLUSTER_COUNT * CLUSTER_INDICES);
+			return false;
+		}
+
+		if (m_binShader.getHandle() == 0)
+		{
+			m_binShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/clusterLights.comp");
+			if (m_binShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_binShader.getLastError());
+				return false;
+			}
+		}
+
+		glCreateBuffers(1, &m_lightBuffer);
+		glNamedBufferStorage(m_lightBuffer, MAX_LIGHTS * sizeof(Light), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers(1, &m_decalBuffer);
+		glNamedBufferStorage(m_decalBuffer, MAX_DECALS * sizeof(Decal), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers(1, &m_gridBuffer);
+		glNamedBufferStorage(m_gridBuffer, CLUSTER_COUNT * 4 * sizeof(unsigned int), nullptr, 0);
+		glCreateBuffers(1, &m_indexBuffer);
+		glNamedBufferStorage(m_indexBuffer, CLUSTER_COUNT * CLUSTER_INDICES * sizeof(unsigned int), nullptr, 0);
+
+		GpuMemory& memory = GpuMemory::instance();
+		memory.trackBuffer(m_lightBuffer, MAX_LIGHTS * sizeof(Light), GpuMemory::LIGHTING, "LightClusters");
+		memory.trackBuffer(m_decalBuffer, MAX_DECALS * sizeof(Decal), GpuMemory::LIGHTING, "LightClusters");
+		memory.trackBuffer(m_gridBuffer, CLUSTER_COUNT * 4 * sizeof(unsigned int), GpuMemory::LIGHTING, "LightClusters");
+		memory.trackBuffer(m_indexBuffer, CLUSTER_COUNT * CLUSTER_INDICES * sizeof(unsigned int),
+			GpuMemory::LIGHTING, "LightClusters");
+
+		glCreateTextures(GL_TEXTURE_BUFFER, 1, &m_lightTexture);
+		glTextureBuffer(m_lightTexture, GL_RGBA32F, m_lightBuffer);
+		glCreateTextures(GL_TEXTURE_BUFFER, 1, &m_decalTexture);
+		glTextureBuffer(m_decalTexture, GL_RGBA32F, m_decalBuffer);
+		glCreateTextures(GL_TEXTURE_BUFFER, 1, &m_indexTexture);
+		glTextureBuffer(m_indexTexture, GL_R32UI, m_indexBuffer);
+		glCreateTextures(GL_TEXTURE_BUFFER, 1, &m_gridTexture);
+		glTextureBuffer(m_gridTexture, GL_RGBA32UI, m_gridBuffer);
+		return true;
+	}
+
+	/**
+		upload copies the lights and decals to their buffers, without
+			binning them.
+	*/
+	void LightClusters::upload()
+	{
+		if (isCreated() == false)
+			return;
+
+		m_lightCount = (unsigned int)m_lights.size();
+		if (m_lightCount > MAX_LIGHTS)
+			m_lightCount = MAX_LIGHTS;
+		if (m_lightCount > 0)
+			glNamedBufferSubData(m_lightBuffer, 0, m_lightCount * sizeof(Light), m_lights.data());
+
+		m_decalCount = (unsigned int)m_decals.size();
+		if (m_decalCount > MAX_DECALS)
+			m_decalCount = MAX_DECALS;
+		if (m_decalCount > 0)
+			glNamedBufferSubData(m_decalBuffer, 0, m_decalCount * sizeof(Decal), m_decals.data());
+	}
+
+	/**
+		update uploads the lights and decals and bins them for a camera.
+
+			@param1 a_view is the camera's view.
+
+			@param2 a_projection is the camera's perspective projection.
+
+			@param3 a_nearPlane is the near plane it was made with.
+
+			@param4 a_farPlane is how far out lights are clustered, the
+					far plane it was made with.
+
+			@param5 a_width is the viewport's width in pixels.
+
+			@param6 a_height is the viewport's height in pixels.
+	*/
+	void LightClusters::update(const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, float a_farPlane,
+		int a_width, int a_height)
+	{
+		if (isCreated() == false)
+			return;
+
+		prepare(a_view, a_projection, a_nearPlane, a_farPlane, a_width, a_height);
+		m_binShader.bind();
+		dispatch();
+
+		// The grid and indices are read by fragment shaders as texels.
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	/**
+		prepare uploads the lights and decals and sets the binning
+			shader's uniforms, without binning them. The uniforms are
+			set on the program, not through whichever is bound, so they
+			are there for bin on any context.
+
+			@param1 a_view is the camera's view.
+
+			@param2 a_projection is the camera's perspective projection.
+
+			@param3 a_nearPlane is the near plane it was made with.
+
+			@param4 a_farPlane is how far out lights are clustered, the
+					far plane it was made with.
+
+			@param5 a_width is the viewport's width in pixels.
+
+			@param6 a_height is the viewport's height in pixels.
+	*/
+	void LightClusters::prepare(const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, float a_farPlane,
+		int a_width, int a_height)
+	{
+		if (isCreated() == false)
+			return;
+
+		upload();
+
+		// The planes are passed in rather than worked out from the
+		//	projection, since a reversed one has no far plane.
+		float nearPlane = a_nearPlane;
+		float farPlane = a_farPlane;
+
+		// A fragment's slice is log(depth) * z + w, the inverse of the
+		//	slices' exponential spacing in the binning shader.
+		float sliceScale = CLUSTERS_Z / std::log(farPlane / nearPlane);
+		m_scale = glm::vec4(CLUSTERS_X / (float)(a_width > 1 ? a_width : 1),
+			CLUSTERS_Y / (float)(a_height > 1 ? a_height : 1),
+			sliceScale, -std::log(nearPlane) * sliceScale);
+
+		static constexpr aie::UniformHandle VIEW("View");
+		static constexpr aie::UniformHandle INVERSE_PROJECTION("InverseProjection");
+		static constexpr aie::UniformHandle LIGHT_COUNT("LightCount");
+		static constexpr aie::UniformHandle DECAL_COUNT("DecalCount");
+		static constexpr aie::UniformHandle NEAR_PLANE("Near");
+		static constexpr aie::UniformHandle FAR_PLANE("Far");
+
+		glm::mat4 inverseProjection = glm::inverse(a_projection);
+		unsigned int program = m_binShader.getHandle();
+		glProgramUniformMatrix4fv(program, m_binShader.getUniform(VIEW), 1, GL_FALSE, &a_view[0][0]);
+		glProgramUniformMatrix4fv(program, m_binShader.getUniform(INVERSE_PROJECTION), 1, GL_FALSE,
+			&inverseProjection[0][0]);
+		glProgramUniform1i(program, m_binShader.getUniform(LIGHT_COUNT), (int)m_lightCount);
+		glProgramUniform1i(program, m_binShader.getUniform(DECAL_COUNT), (int)m_decalCount);
+		glProgramUniform1f(program, m_binShader.getUniform(NEAR_PLANE), nearPlane);
+		glProgramUniform1f(program, m_binShader.getUniform(FAR_PLANE), farPlane);
+	}
+
+	/**
+		bin bins what prepare uploaded on the calling thread's context,
+			using the program directly. The fence the AsyncCompute puts
+			after it makes the writes visible to the context thread, so
+			no barrier is needed here.
+	*/
+	void LightClusters::bin() const
+	{
+		if (isCreated() == false)
+			return;
+
+		glUseProgram(m_binShader.getHandle());
+		dispatch();
+		glUseProgram(0);
+	}
+
+	/**
+		dispatch binds the lights, decals, grid and indices and bins them
+			with the bound binning shader.
+	*/
+	void LightClusters::dispatch() const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, m_lightBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GRID_BINDING, m_gridBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, m_indexBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DECAL_BINDING, m_decalBuffer);
+		glDispatchCompute((CLUSTER_COUNT + BIN_GROUP_SIZE - 1) / BIN_GROUP_SIZE, 1, 1);
+	}
+
+	/**
+		getCount returns the clusters across, down and deep, with w 1 once
+			update has run and 0 before.
+	*/
+	glm::vec4 LightClusters::getCount() const
+	{
+		return glm::vec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, m_scale.z != 0.0f ? 1.0f : 0.0f);
+	}
+
+	/**
+		bind binds the buffers and the decal atlas to their texture units,
+			and points a program's samplers at them if it has them.
+
+			@param1 a_program is the program, which must be bound.
+	*/
+	void LightClusters::bind(aie::ShaderProgram& a_program) const
+	{
+		static constexpr aie::UniformHandle CLUSTER_LIGHTS("ClusterLights");
+		static constexpr aie::UniformHandle CLUSTER_GRID("ClusterGrid");
+		static constexpr aie::UniformHandle CLUSTER_INDICES("ClusterIndices");
+		static constexpr aie::UniformHandle CLUSTER_DECALS("ClusterDecals");
+		static constexpr aie::UniformHandle DECAL_ATLAS("DecalAtlas");
+
+		// The samplers are pointed at their units even without clusters,
+		//	as buffer samplers left on a material's unit can't be drawn with.
+		if (isCreated())
+		{
+			glBindTextureUnit(LIGHT_UNIT, m_lightTexture);
+			glBindTextureUnit(GRID_UNIT, m_gridTexture);
+			glBindTextureUnit(INDEX_UNIT, m_indexTexture);
+			glBindTextureUnit(DECAL_UNIT, m_decalTexture);
+		}
+		if (m_decalAtlas != nullptr && m_decalAtlas->isCreated())
+			m_decalAtlas->bind();
+		a_program.bindUniform(CLUSTER_LIGHTS, (int)LIGHT_UNIT);
+		a_program.bindUniform(CLUSTER_GRID, (int)GRID_UNIT);
+		a_program.bindUniform(CLUSTER_INDICES, (int)INDEX_UNIT);
+		a_program.bindUniform(CLUSTER_DECALS, (int)DECAL_UNIT);
+		a_program.bindUniform(DECAL_ATLAS, (int)DecalAtlas::UNIT);
+	}
+
+	/**
+		destroy deletes the buffers and textures.
+	*/
+	void LightClusters::destroy()
+	{
+		glDeleteTextures(1, &m_lightTexture);
+		glDeleteTextures(1, &m_gridTexture);
+		glDeleteTextures(1, &m_indexTexture);
+		glDeleteTextures(1, &m_decalTexture);
+		glDeleteBuffers(1, &m_lightBuffer);
+		glDeleteBuffers(1, &m_gridBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+		glDeleteBuffers(1, &m_decalBuffer);
+		GpuMemory& memory = GpuMemory::instance();
+		memory.releaseBuffer(m_lightBuffer);
+		memory.releaseBuffer(m_gridBuffer);
+		memory.releaseBuffer(m_indexBuffer);
+		memory.releaseBuffer(m_decalBuffer);
+		m_lightTexture = m_gridTexture = m_indexTexture = m_decalTexture = 0;
+		m_lightBuffer = m_gridBuffer = m_indexBuffer = m_decalBuffer = 0;
+		m_lightCount = 0;
+		m_decalCount = 0;
+		m_scale = glm::vec4(0.0f);
+	}
+}
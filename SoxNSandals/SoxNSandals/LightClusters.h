@@ -0,0 +1,269 @@
+/**
+	LightClusters.h
+
+	Purpose: LightClusters.h is the header file for the LightClusters
+			class. The LightClusters bin the scene's point and spot
+			lights, and its decals, into froxels of the camera's view,
+			so each fragment only loops over the few that can reach it.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace sns
+{
+	class DecalAtlas;
+
+	/**
+		The LightClusters class splits the view into CLUSTERS_X by
+			CLUSTERS_Y tiles on screen and CLUSTERS_Z slices in depth,
+			the slices spaced exponentially so each is about as deep
+			as it is wide. A compute shader tests every light's sphere
+			against every cluster's view space box and writes the
+			lights that touch it.
+
+		Decals are boxes projecting a layer of a DecalAtlas onto what is
+			inside them, binned the same way by the sphere around the
+			box into the index list after each cluster's lights. The
+			lit shaders blend them into the diffuse colour before
+			lighting it, so hundreds of decals cost a few texel reads
+			where they are and no draws at all.
+
+		Fragment shaders read the results through texture buffers,
+			so they stay GLSL 4.1. The lights are three RGBA32F texels
+			each and the decals five, the grid an RGBA32UI texel per
+			cluster of where its lights start in the index list and
+			how many there are, then the same for its decals.
+
+		Binning needs GL 4.3, without it create fails and shaders see
+			no clustered lights.
+	*/
+	class LightClusters
+	{
+	public:
+		// Must match the defines in the binning shader.
+		static const unsigned int CLUSTERS_X = 16;
+		static const unsigned int CLUSTERS_Y = 9;
+		static const unsigned int CLUSTERS_Z = 24;
+		static const unsigned int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+		static const unsigned int MAX_LIGHTS_PER_CLUSTER = 64;
+		static const unsigned int MAX_DECALS_PER_CLUSTER = 32;
+
+		// The most lights and decals there can be.
+		static const unsigned int MAX_LIGHTS = 1024;
+		static const unsigned int MAX_DECALS = 1024;
+
+		// The texture units fragment shaders read the buffers from,
+		//	clear of the units materials use.
+		static const unsigned int LIGHT_UNIT = 8;
+		static const unsigned int GRID_UNIT = 9;
+		static const unsigned int INDEX_UNIT = 10;
+		static const unsigned int DECAL_UNIT = 24;
+
+		/**
+			A light as laid out in the buffer.
+		*/
+		struct Light
+		{
+			// World space position, and the distance it reaches to.
+			glm::vec4 positionRange;
+
+			// The colour it adds, already scaled by its brightness, and
+			//	its ShadowAtlas slot plus one, 0 when it isn't shadowed.
+			glm::vec4 colour;
+
+			// The direction a spot light points, and the cosine of the
+			//	angle its cone fades out at. Point lights use -1.
+			glm::vec4 spot;
+		};
+
+		/**
+			A decal as laid out in the buffer, see makeDecal.
+		*/
+		struct Decal
+		{
+			// World space centre of the box, and the radius of the
+			//	sphere around it.
+			glm::vec4 sphere;
+
+			// The rows of the matrix from world space into the box, 0 to
+			//	1 along each side. x and y are the texture coordinates
+			//	and it is projected along z.
+			glm::vec4 projection[3];
+
+			// The DecalAtlas layer, how opaque it is at most, and two
+			//	unused.
+			glm::vec4 parameters;
+		};
+
+		/**
+			makeDecal lays out a decal.
+
+				@param1 a_transform places the box from -0.5 to 0.5 on
+						each side, as a mesh is placed, projected along
+						its z.
+
+				@param2 a_layer is the DecalAtlas layer it shows.
+
+				@param3 a_opacity is how opaque it is at most.
+
+				@return the decal.
+		*/
+		static Decal makeDecal(const glm::mat4& a_transform, int a_layer, float a_opacity);
+
+		LightClusters();
+
+		/**
+			The deconstructor deletes the buffers.
+		*/
+		~LightClusters();
+
+		LightClusters(const LightClusters&) = delete;
+		LightClusters& operator=(const LightClusters&) = delete;
+
+		/**
+			create makes the buffers and loads the binning shader.
+
+				@return false without GL 4.3 or the shader.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_gridTexture != 0; }
+
+		/**
+			getLights returns the lights, to add to or change. Anything
+				past MAX_LIGHTS is ignored.
+		*/
+		std::vector<Light>& getLights() { return m_lights; }
+
+		/**
+			getDecals returns the decals, to add to or change. Anything
+				past MAX_DECALS is ignored.
+		*/
+		std::vector<Decal>& getDecals() { return m_decals; }
+
+		/**
+			setDecalAtlas sets the atlas the decals' layers are in, which
+				bind binds with the buffers.
+
+				@param1 a_atlas is the atlas, which must outlive the
+						clusters, or null for none.
+		*/
+		void setDecalAtlas(const DecalAtlas* a_atlas) { m_decalAtlas = a_atlas; }
+
+		/**
+			upload copies the lights and decals to their buffers, without
+				binning them. update does this itself.
+		*/
+		void upload();
+
+		/**
+			getLightBuffer returns the buffer of uploaded lights, for other
+				passes to read in the same layout.
+		*/
+		unsigned int getLightBuffer() const { return m_lightBuffer; }
+
+		/**
+			getLightCount returns how many lights were last uploaded.
+		*/
+		unsigned int getLightCount() const { return m_lightCount; }
+
+		/**
+			getDecalCount returns how many decals were last uploaded.
+		*/
+		unsigned int getDecalCount() const { return m_decalCount; }
+
+		/**
+			update uploads the lights and decals and bins them for a
+				camera.
+
+				@param1 a_view is the camera's view.
+
+				@param2 a_projection is the camera's perspective projection.
+
+				@param3 a_nearPlane is the near plane it was made with.
+
+				@param4 a_farPlane is how far out lights are clustered, the
+						far plane it was made with.
+
+				@param5 a_width is the viewport's width in pixels.
+
+				@param6 a_height is the viewport's height in pixels.
+		*/
+		void update(const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, float a_farPlane,
+			int a_width, int a_height);
+
+		/**
+			prepare is update without the binning, for bin to do on
+				another context. It uploads the lights and decals and
+				sets the binning shader's uniforms, on the context
+				thread. Takes the same parameters as update.
+		*/
+		void prepare(const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, float a_farPlane,
+			int a_width, int a_height);
+
+		/**
+			bin bins what prepare uploaded, using the program and
+				binding the buffers itself without the RenderState, so
+				it can run on an AsyncCompute context. The context
+				thread must wait for it before the clusters are read.
+		*/
+		void bin() const;
+
+		/**
+			getScale returns what a fragment scales its position by to
+				find its cluster. x and y turn pixels into a column and
+				row, z and w turn the log of the view depth into a slice.
+				It is all 0 until update has run.
+		*/
+		const glm::vec4& getScale() const { return m_scale; }
+
+		/**
+			getCount returns the clusters across, down and deep, with w
+				1 once update has run and 0 before.
+		*/
+		glm::vec4 getCount() const;
+
+		/**
+			bind binds the buffers and the decal atlas to their texture
+				units, and points a program's samplers at them if it
+				has them.
+
+				@param1 a_program is the program, which must be bound.
+		*/
+		void bind(aie::ShaderProgram& a_program) const;
+
+	private:
+		// Binds the buffers and dispatches the bound binning shader.
+		void dispatch() const;
+
+		// Deletes the buffers and textures.
+		void destroy();
+
+		std::vector<Light> m_lights;
+		std::vector<Decal> m_decals;
+		const DecalAtlas* m_decalAtlas;
+
+		aie::ShaderProgram m_binShader;
+
+		unsigned int m_lightBuffer;
+		unsigned int m_gridBuffer;
+		unsigned int m_indexBuffer;
+		unsigned int m_lightTexture;
+		unsigned int m_gridTexture;
+		unsigned int m_indexTexture;
+		unsigned int m_decalBuffer;
+		unsigned int m_decalTexture;
+		unsigned int m_lightCount;
+		unsigned int m_decalCount;
+
+		glm::vec4 m_scale;
+	};
+}
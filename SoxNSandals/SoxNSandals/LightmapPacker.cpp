@@ -0,0 +1,313 @@
+/**
+	LightmapPacker.cpp
+
+	Purpose: LightmapPacker.cpp is the source file for the LightmapPacker
+			class. The LightmapPacker cuts an imported mesh into flat
+			charts and packs them into one square for its lightmap.
+
+	@author Nathan Nette
+*/
+#include "LightmapPacker.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace sns
+{
+	// How closely a triangle has to face the way its chart's first one
+	//	does to join it, about 35 degrees.
+	static const float CHART_COSINE = 0.82f;
+
+	// How much of the lightmap the first layout tries to fill with the
+	//	charts' boxes, and how much smaller each later try is, when a
+	//	layout doesn't fit.
+	static const float TARGET_FILL = 0.7f;
+	static const float SHRINK = 0.9f;
+	static const unsigned int MAX_LAYOUTS = 64;
+
+	// The chart of a vertex or triangle not in one yet.
+	static const unsigned int NO_CHART = 0xffffffff;
+
+	/**
+		The bits of a position, so vertices split only by their normals or
+			texcoords are welded when finding the edges triangles share.
+	*/
+	struct PositionKey
+	{
+		uint32_t bits[3];
+
+		bool operator==(const PositionKey& a_other) const
+		{
+			return bits[0] == a_other.bits[0] && bits[1] == a_other.bits[1] && bits[2] == a_other.bits[2];
+		}
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const PositionKey& a_key) const
+		{
+			return (size_t)(a_key.bits[0] * 73856093u ^ a_key.bits[1] * 19349663u ^ a_key.bits[2] * 83492791u);
+		}
+	};
+
+	/**
+		The constructor starts a lightmap with no charts.
+
+			@param1 a_resolution is the width and height the charts are
+					packed into, in texels.
+	*/
+	LightmapPacker::LightmapPacker(unsigned int a_resolution)
+		: m_resolution(a_resolution),
+		m_verticesBefore(0),
+		m_verticesAfter(0),
+		m_scale(0.0f)
+	{
+	}
+
+	/**
+		addChunk cuts a chunk's triangles into charts, growing each from
+			the biggest triangle left over the edges it shares, and
+			copies the vertices on the seams between them.
+
+			@param1 a_vertices are the chunk's vertices, added to.
+
+			@param2 a_indices are the chunk's triangles, rewritten.
+	*/
+	void LightmapPacker::addChunk(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		unsigned int triangleCount = (unsigned int)a_indices.size() / 3;
+		m_verticesBefore += (unsigned int)a_vertices.size();
+
+		// Every vertex is welded to the first with its position.
+		std::unordered_map<PositionKey, unsigned int, PositionHash> welded;
+		std::vector<unsigned int> weldOf(a_vertices.size());
+		for (unsigned int v = 0; v < (unsigned int)a_vertices.size(); ++v)
+		{
+			PositionKey key;
+			memcpy(key.bits, &a_vertices[v].position, sizeof(key.bits));
+			weldOf[v] = welded.emplace(key, v).first->second;
+		}
+
+		std::vector<glm::vec3> normals(triangleCount);
+		std::vector<float> areas(triangleCount);
+		for (unsigned int t = 0; t < triangleCount; ++t)
+		{
+			glm::vec3 p0(a_vertices[a_indices[t * 3]].position);
+			glm::vec3 p1(a_vertices[a_indices[t * 3 + 1]].position);
+			glm::vec3 p2(a_vertices[a_indices[t * 3 + 2]].position);
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(cross);
+			areas[t] = length * 0.5f;
+			normals[t] = length > 0.0f ? cross / length : glm::vec3(0, 1, 0);
+		}
+
+		// Each triangle's neighbour across each of its edges, by welded
+		//	position. An edge more than two triangles share only joins
+		//	the first two.
+		std::vector<unsigned int> neighbours(triangleCount * 3, NO_CHART);
+		std::unordered_map<uint64_t, unsigned int> edges;
+		edges.reserve(a_indices.size());
+		for (unsigned int t = 0; t < triangleCount; ++t)
+		{
+			for (unsigned int e = 0; e < 3; ++e)
+			{
+				uint64_t a = weldOf[a_indices[t * 3 + e]];
+				uint64_t b = weldOf[a_indices[t * 3 + (e + 1) % 3]];
+				if (a == b)
+					continue;
+				uint64_t key = a < b ? (a << 32) | b : (b << 32) | a;
+				auto found = edges.emplace(key, t * 3 + e);
+				if (found.second == false && found.first->second != NO_CHART)
+				{
+					unsigned int other = found.first->second;
+					neighbours[t * 3 + e] = other / 3;
+					neighbours[other] = t;
+					found.first->second = NO_CHART;
+				}
+			}
+		}
+
+		std::vector<unsigned int> order(triangleCount);
+		for (unsigned int t = 0; t < triangleCount; ++t)
+			order[t] = t;
+		std::stable_sort(order.begin(), order.end(), [&areas](unsigned int a, unsigned int b) { return areas[a] > areas[b]; });
+
+		Chunk chunk;
+		chunk.charts.assign(a_vertices.size(), NO_CHART);
+		chunk.flattened.resize(a_vertices.size());
+
+		// The copy of each vertex a chart other than its own needs.
+		std::unordered_map<uint64_t, unsigned int> copies;
+		std::vector<unsigned int> triangleCharts(triangleCount, NO_CHART);
+		std::vector<unsigned int> stack;
+		for (unsigned int seed : order)
+		{
+			if (triangleCharts[seed] != NO_CHART)
+				continue;
+
+			unsigned int chartIndex = (unsigned int)m_charts.size();
+			glm::vec3 normal = normals[seed];
+			glm::vec3 tangent = glm::normalize(glm::cross(normal, fabsf(normal.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0)));
+			glm::vec3 bitangent = glm::cross(normal, tangent);
+
+			Chart chart = { glm::vec2(FLT_MAX), glm::vec2(-FLT_MAX), 0.0f, glm::vec2(0) };
+			triangleCharts[seed] = chartIndex;
+			stack.push_back(seed);
+			while (stack.empty() == false)
+			{
+				unsigned int t = stack.back();
+				stack.pop_back();
+				chart.area += areas[t];
+
+				for (unsigned int corner = 0; corner < 3; ++corner)
+				{
+					unsigned int v = a_indices[t * 3 + corner];
+					if (chunk.charts[v] != chartIndex && chunk.charts[v] != NO_CHART)
+					{
+						uint64_t key = ((uint64_t)v << 32) | chartIndex;
+						auto found = copies.find(key);
+						if (found == copies.end())
+						{
+							found = copies.emplace(key, (unsigned int)a_vertices.size()).first;
+							a_vertices.push_back(a_vertices[v]);
+							chunk.charts.push_back(NO_CHART);
+							chunk.flattened.push_back(glm::vec2(0));
+						}
+						v = found->second;
+						a_indices[t * 3 + corner] = v;
+					}
+					if (chunk.charts[v] == NO_CHART)
+					{
+						glm::vec3 position(a_vertices[v].position);
+						glm::vec2 flat(glm::dot(position, tangent), glm::dot(position, bitangent));
+						chunk.charts[v] = chartIndex;
+						chunk.flattened[v] = flat;
+						chart.min = glm::min(chart.min, flat);
+						chart.max = glm::max(chart.max, flat);
+					}
+
+					unsigned int neighbour = neighbours[t * 3 + corner];
+					if (neighbour != NO_CHART && triangleCharts[neighbour] == NO_CHART &&
+						glm::dot(normals[neighbour], normal) > CHART_COSINE)
+					{
+						triangleCharts[neighbour] = chartIndex;
+						stack.push_back(neighbour);
+					}
+				}
+			}
+			m_charts.push_back(chart);
+		}
+
+		m_verticesAfter += (unsigned int)a_vertices.size();
+		m_chunks.push_back(std::move(chunk));
+	}
+
+	/**
+		pack lays out the charts of every chunk added, starting at a scale
+			their boxes would fill TARGET_FILL of the lightmap at and
+			shrinking it until they fit.
+
+			@return how many charts there were, the vertices added for the
+					seams and how much of the lightmap is used.
+	*/
+	LightmapPacker::Stats LightmapPacker::pack()
+	{
+		Stats stats = {};
+		stats.charts = (unsigned int)m_charts.size();
+		stats.verticesBefore = m_verticesBefore;
+		stats.verticesAfter = m_verticesAfter;
+
+		double boxArea = 0.0, area = 0.0;
+		for (const Chart& chart : m_charts)
+		{
+			glm::vec2 size = chart.max - chart.min;
+			boxArea += (double)size.x * size.y;
+			area += chart.area;
+		}
+		if (m_charts.empty())
+			return stats;
+
+		float texels = (float)m_resolution * m_resolution;
+		float scale = boxArea > 0.0 ? sqrtf(TARGET_FILL * texels / (float)boxArea) : 1.0f;
+		for (unsigned int attempt = 0; attempt < MAX_LAYOUTS && layout(scale) == false; ++attempt)
+			scale *= SHRINK;
+		m_scale = scale;
+		stats.coverage = (float)(area * scale * scale / texels);
+		return stats;
+	}
+
+	/**
+		layout lays the charts out in shelves across the lightmap, the
+			tallest first, each its box at a scale and PADDING texels
+			either side.
+
+			@param1 a_scale is the texels per unit.
+
+			@return false if they run off the bottom.
+	*/
+	bool LightmapPacker::layout(float a_scale)
+	{
+		std::vector<unsigned int> order(m_charts.size());
+		for (unsigned int i = 0; i < (unsigned int)order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+		{
+			return m_charts[a].max.y - m_charts[a].min.y > m_charts[b].max.y - m_charts[b].min.y;
+		});
+
+		unsigned int x = 0, y = 0, shelf = 0;
+		for (unsigned int i : order)
+		{
+			Chart& chart = m_charts[i];
+			glm::vec2 size = (chart.max - chart.min) * a_scale;
+			unsigned int width = (unsigned int)ceilf(size.x) + PADDING * 2;
+			unsigned int height = (unsigned int)ceilf(size.y) + PADDING * 2;
+			if (width > m_resolution)
+				return false;
+			if (x + width > m_resolution)
+			{
+				x = 0;
+				y += shelf;
+				shelf = 0;
+			}
+			if (y + height > m_resolution)
+				return false;
+
+			chart.offset = glm::vec2((float)(x + PADDING), (float)(y + PADDING));
+			x += width;
+			shelf = std::max(shelf, height);
+		}
+		return true;
+	}
+
+	/**
+		getTexcoords returns where each vertex of a chunk is in the
+			lightmap, its place on its chart's plane moved to where the
+			chart was packed.
+
+			@param1 a_chunk is the chunk.
+
+			@param2 a_texcoords is set to a texcoord per vertex.
+	*/
+	void LightmapPacker::getTexcoords(unsigned int a_chunk, std::vector<glm::vec2>& a_texcoords) const
+	{
+		const Chunk& chunk = m_chunks[a_chunk];
+		a_texcoords.resize(chunk.flattened.size());
+		float inverse = 1.0f / m_resolution;
+		for (size_t v = 0; v < chunk.flattened.size(); ++v)
+		{
+			// A vertex no triangle uses is in no chart.
+			if (chunk.charts[v] == NO_CHART)
+			{
+				a_texcoords[v] = glm::vec2(0);
+				continue;
+			}
+			const Chart& chart = m_charts[chunk.charts[v]];
+			a_texcoords[v] = ((chunk.flattened[v] - chart.min) * m_scale + chart.offset) * inverse;
+		}
+	}
+}
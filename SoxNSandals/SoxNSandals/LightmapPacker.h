@@ -0,0 +1,132 @@
+/**
+	LightmapPacker.h
+
+	Purpose: LightmapPacker.h is the header file for the LightmapPacker
+			class. The LightmapPacker gives a mesh a second set of
+			texcoords for its lightmap, cutting its triangles into flat
+			charts and packing them into one square without overlaps,
+			while it is imported.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "OBJMesh.h"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The LightmapPacker class unwraps every chunk of a mesh into one
+			lightmap. Each chunk is cut into charts as it is added: the
+			biggest triangle left starts a chart, which grows over the
+			edges it shares with its neighbours, welded by position,
+			while they face within CHART_COSINE of the one it started
+			from. A chart is flattened onto the plane that triangle
+			faces, so none of it folds over itself, and a vertex the
+			charts on either side of a seam share is copied, one for
+			each.
+
+		pack then lays the charts' boxes out in shelves, tallest first,
+			at a scale that fills as much of the lightmap as it can, with
+			PADDING texels around each one so filtering a chart's edge
+			never reaches the next. Every chart is at the same scale, so
+			the lightmap's texels are the same size all over the mesh.
+	*/
+	class LightmapPacker
+	{
+	public:
+		// The texels left empty around each chart.
+		static const unsigned int PADDING = 2;
+
+		/**
+			What pack did to a mesh.
+		*/
+		struct Stats
+		{
+			unsigned int charts;
+			unsigned int verticesBefore;
+			unsigned int verticesAfter;
+
+			// How much of the lightmap the triangles cover, 0 to 1.
+			float coverage;
+		};
+
+		/**
+			The constructor starts a lightmap with no charts.
+
+				@param1 a_resolution is the width and height the charts
+						are packed into, in texels.
+		*/
+		explicit LightmapPacker(unsigned int a_resolution);
+
+		LightmapPacker(const LightmapPacker&) = delete;
+		LightmapPacker& operator=(const LightmapPacker&) = delete;
+
+		/**
+			addChunk cuts a chunk's triangles into charts.
+
+				@param1 a_vertices are the chunk's vertices, with a copy
+						added of each one on a seam between charts.
+
+				@param2 a_indices are the chunk's triangles, pointed at
+						the copies where their charts need them.
+		*/
+		void addChunk(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+
+		/**
+			pack lays out the charts of every chunk added.
+
+				@return how many charts there were, the vertices added for
+						the seams and how much of the lightmap is used.
+		*/
+		Stats pack();
+
+		/**
+			getTexcoords returns where each vertex of a chunk is in the
+				lightmap, once packed.
+
+				@param1 a_chunk is the chunk, in the order they were added.
+
+				@param2 a_texcoords is set to a texcoord per vertex, 0 to 1
+						across the lightmap.
+		*/
+		void getTexcoords(unsigned int a_chunk, std::vector<glm::vec2>& a_texcoords) const;
+
+	private:
+		/**
+			A flat piece of a chunk, its box on the plane it is flattened
+				onto, and where the box is packed.
+		*/
+		struct Chart
+		{
+			glm::vec2 min;
+			glm::vec2 max;
+			float area;
+			glm::vec2 offset;
+		};
+
+		/**
+			A chunk's vertices flattened onto their charts' planes, and
+				the chart of each.
+		*/
+		struct Chunk
+		{
+			std::vector<glm::vec2> flattened;
+			std::vector<unsigned int> charts;
+		};
+
+		// Lays the charts out at a scale, false if they don't fit.
+		bool layout(float a_scale);
+
+		unsigned int m_resolution;
+		std::vector<Chart> m_charts;
+		std::vector<Chunk> m_chunks;
+		unsigned int m_verticesBefore;
+		unsigned int m_verticesAfter;
+
+		// The texels per unit the charts were laid out at.
+		float m_scale;
+	};
+}
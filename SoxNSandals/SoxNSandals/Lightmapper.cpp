@@ -0,0 +1,565 @@
+/**
+	Lightmapper.cpp
+
+	Purpose: Lightmapper.cpp is the source file for the Lightmapper
+			class. The Lightmapper bakes the static scene's lighting into
+			its meshes' lightmaps with a path tracer in a compute shader.
+
+	@author Nathan Nette
+*/
+#include "Lightmapper.h"
+#include "FileSystem.h"
+#include "GpuMemory.h"
+#include "OBJMesh.h"
+#include "RenderState.h"
+#include "SamplerCache.h"
+#include "TraceScene.h"
+#include "gl_core_4_5.h"
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// The texels' buffer, clear of the TraceScene's, and the images the
+	//	shaders write.
+	static const unsigned int TEXEL_BINDING = 0;
+	static const unsigned int ACCUMULATOR_IMAGE = 0;
+	static const unsigned int LIGHTMAP_IMAGE = 1;
+
+	// Must match local_size in the shaders.
+	static const unsigned int BAKE_GROUP_SIZE = 64;
+	static const unsigned int RESOLVE_GROUP_SIZE = 8;
+
+	// The sums of many paths need their precision, what is drawn doesn't.
+	static const unsigned int ACCUMULATOR_FORMAT = GL_RGBA32F;
+	static const unsigned int LIGHTMAP_FORMAT = GL_RGBA16F;
+
+	// A saved bake, the header then the lightmap's half float texels.
+	static const unsigned int FILE_MAGIC = 0x4c4e5353; // "SSNL"
+	static const unsigned int FILE_VERSION = 1;
+
+	// A texel no triangle has covered yet.
+	static const unsigned int NO_TEXEL = 0xffffffff;
+
+	struct FileHeader
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned int resolution;
+		unsigned int key;
+	};
+
+	/**
+		A texel to trace from as the bake reads it, its world position
+			and its normal, the texel's x and y in the position's w.
+	*/
+	struct BakeTexel
+	{
+		glm::vec4 position;
+		glm::vec4 normal;
+	};
+
+	/**
+		mortonDecode splits the bits of an index along a Morton curve
+			into its x and y.
+
+			@param1 a_index is the index.
+	*/
+	static glm::uvec2 mortonDecode(unsigned int a_index)
+	{
+		glm::uvec2 position(0);
+		for (unsigned int bit = 0; bit < 16; ++bit)
+		{
+			position.x |= ((a_index >> (bit * 2)) & 1u) << bit;
+			position.y |= ((a_index >> (bit * 2 + 1)) & 1u) << bit;
+		}
+		return position;
+	}
+
+	/**
+		hashBytes adds bytes to an FNV-1a hash.
+
+			@param1 a_hash is the hash so far.
+
+			@param2 a_data is the bytes.
+
+			@param3 a_size is how many there are.
+	*/
+	static unsigned int hashBytes(unsigned int a_hash, const void* a_data, size_t a_size)
+	{
+		const unsigned char* bytes = (const unsigned char*)a_data;
+		for (size_t i = 0; i < a_size; ++i)
+		{
+			a_hash ^= bytes[i];
+			a_hash *= 16777619u;
+		}
+		return a_hash;
+	}
+
+	Lightmapper::Lightmapper()
+		: m_resolution(0),
+		m_scene(nullptr),
+		m_sunDirection(0.0f, -1.0f, 0.0f),
+		m_sunColour(1.0f),
+		m_skyColour(0.0f),
+		m_key(0),
+		m_texelCount(0),
+		m_sampler(0),
+		m_pass(0),
+		m_passCount(0),
+		m_built(false),
+		m_baked(false)
+	{
+	}
+
+	/**
+		The deconstructor lets the handles delete the buffers and
+			textures. The sampler belongs to the SamplerCache.
+	*/
+	Lightmapper::~Lightmapper()
+	{
+	}
+
+	/**
+		create loads the bake and resolve programs and makes the lightmap.
+
+			@param1 a_resolution is the width and height of the atlas.
+
+			@return false without GL 4.5 or the programs, it is left
+					uncreated.
+	*/
+	bool Lightmapper::create(unsigned int a_resolution)
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("Lightmapper: baking lightmaps needs GL 4.5.\n");
+			return false;
+		}
+
+		m_bakeShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/lightmapBake.comp");
+		m_resolveShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/lightmapResolve.comp");
+		aie::ShaderProgram* programs[] = { &m_bakeShader, &m_resolveShader };
+		for (aie::ShaderProgram* program : programs)
+		{
+			if (program->link() == false)
+			{
+				printf("Shader Error: %s\n", program->getLastError());
+				return false;
+			}
+		}
+
+		glCreateTextures(GL_TEXTURE_2D, 1, m_lightmap.put());
+		glTextureStorage2D(m_lightmap, 1, LIGHTMAP_FORMAT, a_resolution, a_resolution);
+		GpuMemory::instance().trackTexture(m_lightmap, GpuMemory::getTextureBytes(LIGHTMAP_FORMAT, a_resolution, a_resolution),
+			GpuMemory::LIGHTING, "Lightmapper");
+		m_sampler = SamplerCache::instance().get({ GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, false });
+		m_resolution = a_resolution;
+		return true;
+	}
+
+	/**
+		clear forgets every placement and the bake, for a scene that
+			changed.
+	*/
+	void Lightmapper::clear()
+	{
+		m_placements.clear();
+		m_scene = nullptr;
+		m_texels.reset();
+		m_accumulator.reset();
+		m_texelCount = 0;
+		m_pass = 0;
+		m_passCount = 0;
+		m_built = false;
+		m_baked = false;
+	}
+
+	/**
+		add places a mesh's lightmap in the scene, until the next clear.
+
+			@param1 a_mesh is the mesh, pickable and with a lightmap.
+
+			@param2 a_transform is where it is placed.
+
+			@return the placement's index, for getRect.
+	*/
+	unsigned int Lightmapper::add(const aie::OBJMesh& a_mesh, const glm::mat4& a_transform)
+	{
+		Placement placement = { &a_mesh, a_transform, 0, glm::vec4(0) };
+		m_placements.push_back(placement);
+		return (unsigned int)m_placements.size() - 1;
+	}
+
+	/**
+		build packs the placements and either loads their lightmap from a
+			file baked by the same scene and lights, or starts a bake. The
+			file is known by a hash of the meshes, where they are, the
+			scene they are traced through, the lights and the atlas.
+
+			@param1 a_scene is what the paths are traced through.
+
+			@param2 a_sunDirection is the way the sun's light travels.
+
+			@param3 a_sunColour is the colour it lights a surface facing it.
+
+			@param4 a_skyColour is the colour the sky lights a surface open
+					to all of it.
+
+			@param5 a_filename is the file the bake is saved to and loaded
+					from, or null to always bake.
+
+			@return false if it isn't created, nothing was placed or the
+					scene is empty.
+	*/
+	bool Lightmapper::build(const TraceScene& a_scene, const glm::vec3& a_sunDirection, const glm::vec3& a_sunColour,
+		const glm::vec3& a_skyColour, const char* a_filename)
+	{
+		m_built = true;
+		m_baked = false;
+		if (isCreated() == false || m_placements.empty() || a_scene.isEmpty())
+			return false;
+
+		m_scene = &a_scene;
+		m_sunDirection = glm::normalize(a_sunDirection);
+		m_sunColour = a_sunColour;
+		m_skyColour = a_skyColour;
+		m_filename = a_filename != nullptr ? a_filename : "";
+		pack();
+
+		unsigned int key = 2166136261u;
+		unsigned int settings[] = { m_resolution, SAMPLES_PER_TEXEL, MAX_BOUNCES, a_scene.getKey() };
+		key = hashBytes(key, settings, sizeof(settings));
+		key = hashBytes(key, &m_sunDirection, sizeof(glm::vec3));
+		key = hashBytes(key, &m_sunColour, sizeof(glm::vec3));
+		key = hashBytes(key, &m_skyColour, sizeof(glm::vec3));
+		for (const Placement& placement : m_placements)
+		{
+			const std::string& filename = placement.mesh->getFilename();
+			unsigned int resolution = placement.mesh->getLightmapResolution();
+			key = hashBytes(key, filename.data(), filename.size());
+			key = hashBytes(key, &resolution, sizeof(resolution));
+			key = hashBytes(key, &placement.transform, sizeof(glm::mat4));
+		}
+		m_key = key;
+
+		if (m_filename.empty() == false && load())
+		{
+			printf("Lightmapper: loaded %s\n", m_filename.c_str());
+			m_baked = true;
+			return true;
+		}
+
+		prepare();
+		return true;
+	}
+
+	/**
+		pack gives each placement a power of two square, as wide as its
+			mesh's lightmap, halving every one still wider than MIN_SIZE
+			while together they cover more than the atlas. Placed largest
+			first along a Morton curve each lands on a multiple of its
+			own width, with no gaps before the last.
+	*/
+	void Lightmapper::pack()
+	{
+		unsigned long long area = 0;
+		for (Placement& placement : m_placements)
+		{
+			unsigned int size = MIN_SIZE;
+			unsigned int wanted = std::min(placement.mesh->getLightmapResolution(), m_resolution);
+			while (size < wanted)
+				size *= 2;
+			placement.size = size;
+			area += (unsigned long long)size * size;
+		}
+
+		unsigned long long atlasArea = (unsigned long long)m_resolution * m_resolution;
+		bool halved = true;
+		while (area > atlasArea && halved)
+		{
+			halved = false;
+			area = 0;
+			for (Placement& placement : m_placements)
+			{
+				if (placement.size > MIN_SIZE)
+				{
+					placement.size /= 2;
+					halved = true;
+				}
+				area += (unsigned long long)placement.size * placement.size;
+			}
+		}
+
+		std::vector<unsigned int> order(m_placements.size());
+		for (unsigned int i = 0; i < (unsigned int)order.size(); ++i)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+		{
+			return m_placements[a].size > m_placements[b].size;
+		});
+
+		// Those left over once it is full aren't lit, and read the
+		//	atlas's first texel.
+		unsigned long long offset = 0;
+		float inverse = 1.0f / m_resolution;
+		for (unsigned int i : order)
+		{
+			Placement& placement = m_placements[i];
+			unsigned long long tiles = (unsigned long long)placement.size * placement.size;
+			if (offset + tiles > atlasArea)
+			{
+				printf("Lightmapper: no room for %s's lightmap, it is left unlit.\n",
+					placement.mesh->getFilename().c_str());
+				placement.size = 0;
+				placement.rect = glm::vec4(0);
+				continue;
+			}
+			glm::uvec2 origin = mortonDecode((unsigned int)offset);
+			placement.rect = glm::vec4(glm::vec2((float)placement.size * inverse), glm::vec2(origin) * inverse);
+			offset += tiles;
+		}
+	}
+
+	/**
+		prepare finds the texels every placement's triangles cover, the
+			first triangle over a texel's centre giving it its position
+			and normal, and uploads them.
+	*/
+	void Lightmapper::prepare()
+	{
+		std::vector<BakeTexel> texels;
+		std::vector<unsigned int> covered((size_t)m_resolution * m_resolution, NO_TEXEL);
+
+		for (const Placement& placement : m_placements)
+		{
+			// Left off the atlas, it only shades the others.
+			if (placement.size == 0)
+				continue;
+
+			const aie::OBJMesh& mesh = *placement.mesh;
+			glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(placement.transform));
+			glm::vec2 scale = glm::vec2(placement.rect.x, placement.rect.y) * (float)m_resolution;
+			glm::vec2 offset = glm::vec2(placement.rect.z, placement.rect.w) * (float)m_resolution;
+
+			for (unsigned int c = 0; c < (unsigned int)mesh.getChunkCount(); ++c)
+			{
+				for (unsigned int t = 0; t < mesh.getTriangleCount(c); ++t)
+				{
+					glm::vec3 corners[3], normals[3];
+					glm::vec2 texcoords[3];
+					if (mesh.getLightmapTriangle(c, t, corners, normals, texcoords) == false)
+						break;
+
+					glm::vec3 world[3];
+					for (unsigned int i = 0; i < 3; ++i)
+					{
+						world[i] = glm::vec3(placement.transform * glm::vec4(corners[i], 1.0f));
+						normals[i] = normalMatrix * normals[i];
+						texcoords[i] = texcoords[i] * scale + offset;
+					}
+
+					// The texel centres inside the triangle's texcoords.
+					glm::vec2 a = texcoords[0], b = texcoords[1], d = texcoords[2];
+					float area = (b.x - a.x) * (d.y - a.y) - (b.y - a.y) * (d.x - a.x);
+					if (fabsf(area) < 1e-8f)
+						continue;
+					glm::vec2 low = glm::max(glm::floor(glm::min(a, glm::min(b, d))), glm::vec2(0.0f));
+					glm::vec2 high = glm::min(glm::ceil(glm::max(a, glm::max(b, d))), glm::vec2((float)m_resolution - 1.0f));
+					for (float y = low.y; y <= high.y; ++y)
+					{
+						for (float x = low.x; x <= high.x; ++x)
+						{
+							glm::vec2 p(x + 0.5f, y + 0.5f);
+							float w0 = ((b.x - p.x) * (d.y - p.y) - (b.y - p.y) * (d.x - p.x)) / area;
+							float w1 = ((d.x - p.x) * (a.y - p.y) - (d.y - p.y) * (a.x - p.x)) / area;
+							float w2 = 1.0f - w0 - w1;
+							if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+								continue;
+							unsigned int tx = (unsigned int)x, ty = (unsigned int)y;
+							unsigned int& texel = covered[(size_t)ty * m_resolution + tx];
+							if (texel != NO_TEXEL)
+								continue;
+							texel = (unsigned int)texels.size();
+
+							unsigned int packed = tx | (ty << 16);
+							float packedBits;
+							memcpy(&packedBits, &packed, sizeof(float));
+							glm::vec3 position = world[0] * w0 + world[1] * w1 + world[2] * w2;
+							glm::vec3 normal = normals[0] * w0 + normals[1] * w1 + normals[2] * w2;
+							float length = glm::length(normal);
+							normal = length > 0.0f ? normal / length : glm::normalize(glm::cross(world[1] - world[0], world[2] - world[0]));
+							BakeTexel bakeTexel = { glm::vec4(position, packedBits), glm::vec4(normal, 0.0f) };
+							texels.push_back(bakeTexel);
+						}
+					}
+				}
+			}
+		}
+
+		m_texelCount = (unsigned int)texels.size();
+		if (m_texelCount == 0)
+		{
+			printf("Lightmapper: the lightmapped meshes cover no texels.\n");
+			return;
+		}
+
+		GpuMemory& memory = GpuMemory::instance();
+		size_t texelBytes = texels.size() * sizeof(BakeTexel);
+		glCreateBuffers(1, m_texels.put());
+		glNamedBufferStorage(m_texels, texelBytes, texels.data(), 0);
+		memory.trackBuffer(m_texels, texelBytes, GpuMemory::LIGHTING, "Lightmapper");
+
+		glCreateTextures(GL_TEXTURE_2D, 1, m_accumulator.put());
+		glTextureStorage2D(m_accumulator, 1, ACCUMULATOR_FORMAT, m_resolution, m_resolution);
+		memory.trackTexture(m_accumulator, GpuMemory::getTextureBytes(ACCUMULATOR_FORMAT, m_resolution, m_resolution),
+			GpuMemory::LIGHTING, "Lightmapper");
+		glClearTexImage(m_accumulator, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+		unsigned int passesPerRound = (m_texelCount + TEXELS_PER_PASS - 1) / TEXELS_PER_PASS;
+		m_passCount = passesPerRound * (SAMPLES_PER_TEXEL / SAMPLES_PER_PASS);
+		m_pass = 0;
+		printf("Lightmapper: baking %u texels over %u triangles in %u passes\n", m_texelCount,
+			m_scene->getTriangleCount(), m_passCount);
+	}
+
+	/**
+		getProgress returns how far the bake is, 0 to 1.
+	*/
+	float Lightmapper::getProgress() const
+	{
+		if (m_baked)
+			return 1.0f;
+		return m_passCount > 0 ? (float)m_pass / m_passCount : 0.0f;
+	}
+
+	/**
+		update traces the next pass of a bake. The passes go through the
+			texels TEXELS_PER_PASS at a time, then start again with the
+			next SAMPLES_PER_PASS paths of each, and once every texel has
+			all of them the bake is resolved.
+	*/
+	void Lightmapper::update()
+	{
+		static constexpr aie::UniformHandle FIRST_TEXEL("FirstTexel");
+		static constexpr aie::UniformHandle TEXEL_COUNT("TexelCount");
+		static constexpr aie::UniformHandle FIRST_SAMPLE("FirstSample");
+		static constexpr aie::UniformHandle SUN_DIRECTION("SunDirection");
+		static constexpr aie::UniformHandle SUN_COLOUR("SunColour");
+		static constexpr aie::UniformHandle SKY_COLOUR("SkyColour");
+		static constexpr aie::UniformHandle RAY_BIAS("RayBias");
+
+		if (m_baked || m_passCount == 0)
+			return;
+
+		unsigned int passesPerRound = (m_texelCount + TEXELS_PER_PASS - 1) / TEXELS_PER_PASS;
+		unsigned int firstTexel = (m_pass % passesPerRound) * TEXELS_PER_PASS;
+		unsigned int texelCount = std::min(TEXELS_PER_PASS, m_texelCount - firstTexel);
+
+		// The shader is given the way to the sun, not the way its light goes.
+		m_bakeShader.bind();
+		m_bakeShader.bindUniform(FIRST_TEXEL, (int)firstTexel);
+		m_bakeShader.bindUniform(TEXEL_COUNT, (int)texelCount);
+		m_bakeShader.bindUniform(FIRST_SAMPLE, (int)((m_pass / passesPerRound) * SAMPLES_PER_PASS));
+		m_bakeShader.bindUniform(SUN_DIRECTION, -m_sunDirection);
+		m_bakeShader.bindUniform(SUN_COLOUR, m_sunColour);
+		m_bakeShader.bindUniform(SKY_COLOUR, m_skyColour);
+		m_bakeShader.bindUniform(RAY_BIAS, m_scene->getRayBias());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TEXEL_BINDING, m_texels);
+		m_scene->bind();
+		glBindImageTexture(ACCUMULATOR_IMAGE, m_accumulator, 0, GL_FALSE, 0, GL_READ_WRITE, ACCUMULATOR_FORMAT);
+		glDispatchCompute((texelCount + BAKE_GROUP_SIZE - 1) / BAKE_GROUP_SIZE, 1, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		if (++m_pass == m_passCount)
+			resolve();
+	}
+
+	/**
+		resolve averages the accumulator into the lightmap, spreading the
+			texels at the edge of every chart a texel into the gaps so
+			filtering them never reads one the bake didn't cover. The
+			lightmap is read back once to be saved, and the texels and
+			accumulator are let go.
+	*/
+	void Lightmapper::resolve()
+	{
+		m_resolveShader.bind();
+		glBindImageTexture(ACCUMULATOR_IMAGE, m_accumulator, 0, GL_FALSE, 0, GL_READ_ONLY, ACCUMULATOR_FORMAT);
+		glBindImageTexture(LIGHTMAP_IMAGE, m_lightmap, 0, GL_FALSE, 0, GL_WRITE_ONLY, LIGHTMAP_FORMAT);
+		unsigned int groups = (m_resolution + RESOLVE_GROUP_SIZE - 1) / RESOLVE_GROUP_SIZE;
+		glDispatchCompute(groups, groups, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+		m_baked = true;
+
+		if (m_filename.empty() == false)
+		{
+			std::vector<unsigned short> halves((size_t)m_resolution * m_resolution * 4);
+			glGetTextureImage(m_lightmap, 0, GL_RGBA, GL_HALF_FLOAT, (int)(halves.size() * sizeof(unsigned short)),
+				halves.data());
+
+			FileHeader header = { FILE_MAGIC, FILE_VERSION, m_resolution, m_key };
+			FILE* file = nullptr;
+			fopen_s(&file, m_filename.c_str(), "wb");
+			bool written = file != nullptr &&
+				fwrite(&header, sizeof(FileHeader), 1, file) == 1 &&
+				fwrite(halves.data(), sizeof(unsigned short), halves.size(), file) == halves.size();
+			if (file != nullptr)
+				fclose(file);
+			if (written)
+				printf("Lightmapper: baked %s\n", m_filename.c_str());
+			else
+				printf("Lightmapper: failed to write %s\n", m_filename.c_str());
+		}
+
+		m_texels.reset();
+		m_accumulator.reset();
+	}
+
+	/**
+		load reads a saved bake into the lightmap, if it was baked from
+			the same scene, lights and atlas as this one.
+
+			@return false if there isn't one, or it is another's.
+	*/
+	bool Lightmapper::load()
+	{
+		FileView view;
+		if (FileSystem::instance().open(m_filename.c_str(), view) == false)
+			return false;
+
+		size_t bytes = (size_t)m_resolution * m_resolution * 4 * sizeof(unsigned short);
+		FileHeader header;
+		if (view.getSize() != sizeof(FileHeader) + bytes)
+			return false;
+		memcpy(&header, view.getData(), sizeof(FileHeader));
+		if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.resolution != m_resolution ||
+			header.key != m_key)
+			return false;
+
+		glTextureSubImage2D(m_lightmap, 0, 0, 0, m_resolution, m_resolution, GL_RGBA, GL_HALF_FLOAT,
+			view.getData() + sizeof(FileHeader));
+		return true;
+	}
+
+	/**
+		bind binds the lightmap to LIGHTMAP_UNIT and points a program's
+			sampler at it.
+
+			@param1 a_program is the program, which must be bound.
+	*/
+	void Lightmapper::bind(aie::ShaderProgram& a_program) const
+	{
+		static constexpr aie::UniformHandle LIGHTMAP("Lightmap");
+
+		if (isCreated() == false)
+			return;
+		RenderState::instance().bindTexture(LIGHTMAP_UNIT, m_lightmap, m_sampler);
+		a_program.bindUniform(LIGHTMAP, (int)LIGHTMAP_UNIT);
+	}
+}
@@ -0,0 +1,246 @@
+/**
+	Lightmapper.h
+
+	Purpose: Lightmapper.h is the header file for the Lightmapper class.
+			The Lightmapper bakes how the sun, the sky and the light they
+			bounce off the static scene light every texel of its meshes'
+			lightmaps, with a path tracer in a compute shader, so drawing
+			them is one texture read instead of their lights.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <string>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	class TraceScene;
+
+	/**
+		The Lightmapper class packs the lightmap of every placed mesh with
+			one, see OBJMesh::setLightmapResolution, into one atlas, each
+			a power of two square, largest first along a Morton curve,
+			and all of them halved until they fit. Each placement's
+			rect is where its mesh's lightmap texcoords are scaled and
+			moved to, see ObjectBuffer::setLightmapRect.
+
+		build then finds the world position and normal of every texel the
+			placements' triangles cover, on the cpu, and uploads them.
+			Each update traces SAMPLES_PER_PASS paths from
+			TEXELS_PER_PASS of the texels in turn through a TraceScene,
+			which should hold the placed meshes as well as whatever else
+			shadows them, adding them to an accumulator, so a bake is
+			spread over frames rather than stalling one. A path bounces
+			up to MAX_BOUNCES times off the triangles' flat diffuse
+			colours, is lit by the sun at every bounce through a shadow
+			ray, and sees the sky where it leaves the scene.
+
+		The texels hold what the lit shaders' diffuse colour is scaled by,
+			in the units the lights are, the sun's colour times its
+			cosine and the sky's colour around every unshadowed normal.
+			Once every texel has SAMPLES_PER_TEXEL paths the accumulator is
+			averaged into the lightmap, spread a texel into the gaps
+			around the charts so filtering never reads black, and saved
+			to a file, which a later build with the same scene and
+			lights loads instead of baking. Needs GL 4.5, without it
+			create fails and nothing is lightmapped.
+	*/
+	class Lightmapper
+	{
+	public:
+		// The width and height of the atlas unless create is given another.
+		static const unsigned int DEFAULT_RESOLUTION = 2048;
+
+		// The texels each update traces, how many paths each, and how many
+		//	a texel is done at.
+		static const unsigned int TEXELS_PER_PASS = 16384;
+		static const unsigned int SAMPLES_PER_PASS = 4;
+		static const unsigned int SAMPLES_PER_TEXEL = 256;
+
+		// Must match lightmapBake.comp.
+		static const unsigned int MAX_BOUNCES = 3;
+
+		// The texture unit the lit shaders read the lightmap from, clear
+		//	of every unit another pass binds.
+		static const unsigned int LIGHTMAP_UNIT = 21;
+
+		// The narrowest a placement's lightmap is halved to.
+		static const unsigned int MIN_SIZE = 16;
+
+		Lightmapper();
+		~Lightmapper();
+
+		Lightmapper(const Lightmapper&) = delete;
+		Lightmapper& operator=(const Lightmapper&) = delete;
+
+		/**
+			create loads the bake and resolve programs.
+
+				@param1 a_resolution is the width and height of the atlas.
+
+				@return false without GL 4.5 or the programs, it is left
+						uncreated.
+		*/
+		bool create(unsigned int a_resolution = DEFAULT_RESOLUTION);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_resolution != 0; }
+
+		/**
+			clear forgets every placement and the bake, for a scene that
+				changed.
+		*/
+		void clear();
+
+		/**
+			add places a mesh's lightmap in the scene, until the next clear.
+
+				@param1 a_mesh is the mesh, pickable and with a lightmap,
+						which must stay loaded while the placement is baked.
+
+				@param2 a_transform is where it is placed.
+
+				@return the placement's index, for getRect.
+		*/
+		unsigned int add(const aie::OBJMesh& a_mesh, const glm::mat4& a_transform);
+
+		/**
+			build packs the placements and either loads their lightmap from
+				a file baked by the same scene and lights, or starts a bake.
+
+				@param1 a_scene is what the paths are traced through, built,
+						which must stay so until the bake is done.
+
+				@param2 a_sunDirection is the way the sun's light travels,
+						as the lights' direction is.
+
+				@param3 a_sunColour is the colour it lights a surface facing
+						it.
+
+				@param4 a_skyColour is the colour the sky lights a surface
+						open to all of it.
+
+				@param5 a_filename is the file the bake is saved to and
+						loaded from, or null to always bake.
+
+				@return false if it isn't created, nothing was placed or the
+						scene is empty.
+		*/
+		bool build(const TraceScene& a_scene, const glm::vec3& a_sunDirection, const glm::vec3& a_sunColour,
+			const glm::vec3& a_skyColour, const char* a_filename);
+
+		/**
+			isBuilt returns whether build has run since the last clear.
+		*/
+		bool isBuilt() const { return m_built; }
+
+		/**
+			isBaked returns whether the lightmap is done, and can be drawn.
+		*/
+		bool isBaked() const { return m_baked; }
+
+		/**
+			getProgress returns how far the bake is, 0 to 1.
+		*/
+		float getProgress() const;
+
+		/**
+			getRect returns where a placement's lightmap is in the atlas,
+				once built.
+
+				@param1 a_placement is its index.
+
+				@return the scale in xy and the offset in zw, 0 to 1
+						across the atlas.
+		*/
+		glm::vec4 getRect(unsigned int a_placement) const { return m_placements[a_placement].rect; }
+
+		/**
+			getTexelCount returns how many texels the placements cover.
+		*/
+		unsigned int getTexelCount() const { return m_texelCount; }
+
+		/**
+			update traces the next pass of a bake, finishing it once every
+				texel has all its paths. It does nothing once baked.
+		*/
+		void update();
+
+		/**
+			bind binds the lightmap to LIGHTMAP_UNIT and points a program's
+				sampler at it, if it has one.
+
+				@param1 a_program is the program, which must be bound.
+		*/
+		void bind(aie::ShaderProgram& a_program) const;
+
+	private:
+		/**
+			A placed mesh, its lightmap's width and where it is.
+		*/
+		struct Placement
+		{
+			const aie::OBJMesh* mesh;
+			glm::mat4 transform;
+			unsigned int size;
+			glm::vec4 rect;
+		};
+
+		// Packs the placements into the atlas, halving them until they fit.
+		void pack();
+
+		// Finds the texels the placements cover and uploads what the bake
+		//	traces.
+		void prepare();
+
+		// Averages the accumulator into the lightmap and saves it.
+		void resolve();
+
+		// Loads a saved bake, false if it isn't this one's.
+		bool load();
+
+		unsigned int m_resolution;
+		std::vector<Placement> m_placements;
+
+		// The programs, what the bake is traced through and what it is
+		//	lit by.
+		aie::ShaderProgram m_bakeShader;
+		aie::ShaderProgram m_resolveShader;
+		const TraceScene* m_scene;
+		glm::vec3 m_sunDirection;
+		glm::vec3 m_sunColour;
+		glm::vec3 m_skyColour;
+
+		// The file the bake is saved to, and a hash of everything it was
+		//	baked from.
+		std::string m_filename;
+		unsigned int m_key;
+
+		// The texels to trace from.
+		BufferHandle m_texels;
+		unsigned int m_texelCount;
+
+		// The sums of the paths traced, and the lightmap they make.
+		TextureHandle m_accumulator;
+		TextureHandle m_lightmap;
+		unsigned int m_sampler;
+
+		unsigned int m_pass;
+		unsigned int m_passCount;
+		bool m_built;
+		bool m_baked;
+	};
+}
@@ -0,0 +1,347 @@
+/**
+	Log.cpp
+
+	Purpose: Log.cpp is the source file for the Log class. Messages are
+			queued without locking and written out on a thread of their
+			own, and each place that logs is rate limited, so a message
+			hit every frame costs the frame an atomic or two rather than
+			a console write.
+
+	@author Nathan Nette
+*/
+#include "Log.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// How long the thread sleeps when the queue is empty.
+	static const std::chrono::milliseconds DRAIN_INTERVAL(5);
+
+	static const char* const LEVEL_NAMES[] = { "Verbose", "Info", "Warning", "Error" };
+
+	/**
+		The constructor makes a site with nothing written yet.
+
+			@param1 a_file is the file it is in.
+
+			@param2 a_line is its line.
+
+			@param3 a_level is how serious its messages are.
+	*/
+	LogSite::LogSite(const char* a_file, int a_line, LogLevel a_level)
+		: file(a_file),
+		line(a_line),
+		level(a_level),
+		window(0),
+		count(0),
+		suppressed(0),
+		nextRecent(0)
+	{
+		for (unsigned int i = 0; i < RECENT_COUNT; ++i)
+		{
+			recent[i] = 0;
+			recentTimes[i] = 0;
+		}
+	}
+
+	Log& Log::instance()
+	{
+		static Log log;
+		return log;
+	}
+
+	Log::Log()
+		: m_entries(new Entry[QUEUE_SIZE]),
+		m_head(0),
+		m_tail(0),
+		m_level(0),
+		m_running(true),
+		m_popping(false),
+		m_start(std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count()),
+		m_written(0),
+		m_suppressed(0),
+		m_dropped(0)
+	{
+		// Each entry's sequence is the position it is next written at.
+		for (unsigned int i = 0; i < QUEUE_SIZE; ++i)
+			m_entries[i].sequence = i;
+		m_thread = std::thread(&Log::run, this);
+	}
+
+	/**
+		The deconstructor writes what is queued, see shutdown.
+	*/
+	Log::~Log()
+	{
+		shutdown();
+		delete[] m_entries;
+	}
+
+	/**
+		write logs a message from a site, unless it is below the level or
+			the site's limits leave it out.
+
+			@param1 a_site is where it is logged from.
+
+			@param2 a_format is a printf format.
+	*/
+	void Log::write(LogSite& a_site, const char* a_format, ...)
+	{
+		if (isEnabled(a_site.level) == false)
+			return;
+
+		// The rate limit is checked before formatting, so a flooding
+		//	site costs no more than the check.
+		unsigned int now = getSeconds();
+		if (allow(a_site, now) == false)
+			return;
+
+		char text[MAX_MESSAGE];
+		va_list args;
+		va_start(args, a_format);
+		vsnprintf(text, sizeof(text), a_format, args);
+		va_end(args);
+
+		// FNV-1a, repeats only need telling apart from each other.
+		unsigned int hash = 2166136261u;
+		for (const char* c = text; *c != '\0'; ++c)
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+		if (isRepeat(a_site, hash, now))
+		{
+			++a_site.suppressed;
+			++m_suppressed;
+			return;
+		}
+
+		unsigned int suppressed = a_site.suppressed.exchange(0);
+		if (m_running == false)
+		{
+			print(a_site.level, suppressed, a_site.file, a_site.line, text);
+			++m_written;
+		}
+		else if (push(a_site, suppressed, text) == false)
+			++m_dropped;
+	}
+
+	/**
+		flush writes every queued message on the calling thread, before
+			returning.
+	*/
+	void Log::flush()
+	{
+		bool popping = false;
+		while (m_popping.compare_exchange_weak(popping, true) == false)
+		{
+			popping = false;
+			std::this_thread::yield();
+		}
+		while (pop())
+		{
+		}
+		m_popping = false;
+		fflush(stdout);
+	}
+
+	/**
+		shutdown writes every queued message and stops the thread.
+	*/
+	void Log::shutdown()
+	{
+		if (m_running.exchange(false) == false)
+			return;
+
+		if (m_thread.joinable())
+			m_thread.join();
+		flush();
+	}
+
+	/**
+		getStats returns the counts since the log started.
+	*/
+	Log::Stats Log::getStats() const
+	{
+		Stats stats;
+		stats.written = m_written;
+		stats.suppressed = m_suppressed;
+		stats.dropped = m_dropped;
+		return stats;
+	}
+
+	/**
+		allow returns whether a site's limits let a message through,
+			counting it as suppressed if not.
+
+			@param1 a_site is the site.
+
+			@param2 a_now is the second it is written in.
+	*/
+	bool Log::allow(LogSite& a_site, unsigned int a_now)
+	{
+		// The first message of a new second starts its count. Two
+		//	threads moving the window at once can let a message or two
+		//	more through, which is fine for a limit.
+		unsigned int window = a_site.window;
+		if (window != a_now && a_site.window.compare_exchange_strong(window, a_now))
+			a_site.count = 0;
+
+		if (a_site.count.fetch_add(1) < MAX_PER_SECOND)
+			return true;
+
+		++a_site.suppressed;
+		++m_suppressed;
+		return false;
+	}
+
+	/**
+		isRepeat returns whether a message was written by a site in the
+			last REPEAT_SECONDS, remembering it if not.
+
+			@param1 a_site is the site.
+
+			@param2 a_hash is the hash of the message.
+
+			@param3 a_now is the second it is written in.
+	*/
+	bool Log::isRepeat(LogSite& a_site, unsigned int a_hash, unsigned int a_now)
+	{
+		for (unsigned int i = 0; i < LogSite::RECENT_COUNT; ++i)
+		{
+			if (a_site.recent[i] == a_hash && a_now - a_site.recentTimes[i] < REPEAT_SECONDS)
+				return true;
+		}
+
+		// The oldest is forgotten, so a site cycling through more than
+		//	RECENT_COUNT messages is only held back by the rate limit.
+		unsigned int slot = a_site.nextRecent.fetch_add(1) % LogSite::RECENT_COUNT;
+		a_site.recent[slot] = a_hash;
+		a_site.recentTimes[slot] = a_now;
+		return false;
+	}
+
+	/**
+		push adds a message to the queue.
+
+			@param1 a_site is where it is logged from.
+
+			@param2 a_suppressed is how many of the site's messages were
+					left out before it.
+
+			@param3 a_text is the formatted message.
+
+			@return false if the queue is full.
+	*/
+	bool Log::push(const LogSite& a_site, unsigned int a_suppressed, const char* a_text)
+	{
+		// A bounded queue for many writers and one reader. An entry is
+		//	free to write at position p when its sequence is p, and
+		//	written when it is p + 1.
+		unsigned int position = m_head.load(std::memory_order_relaxed);
+		Entry* entry;
+		for (;;)
+		{
+			entry = &m_entries[position % QUEUE_SIZE];
+			unsigned int sequence = entry->sequence.load(std::memory_order_acquire);
+			int difference = (int)(sequence - position);
+			if (difference == 0)
+			{
+				if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+				return false;
+			else
+				position = m_head.load(std::memory_order_relaxed);
+		}
+
+		entry->level = a_site.level;
+		entry->suppressed = a_suppressed;
+		entry->file = a_site.file;
+		entry->line = a_site.line;
+		strncpy(entry->text, a_text, MAX_MESSAGE - 1);
+		entry->text[MAX_MESSAGE - 1] = '\0';
+		entry->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+		pop writes the next queued message. Only one thread pops at once,
+			see m_popping.
+
+			@return false if there is none.
+	*/
+	bool Log::pop()
+	{
+		unsigned int position = m_tail.load(std::memory_order_relaxed);
+		Entry& entry = m_entries[position % QUEUE_SIZE];
+		if (entry.sequence.load(std::memory_order_acquire) != position + 1)
+			return false;
+
+		print(entry.level, entry.suppressed, entry.file, entry.line, entry.text);
+		++m_written;
+
+		// Free for the writer that comes round to it a lap later.
+		m_tail.store(position + 1, std::memory_order_relaxed);
+		entry.sequence.store(position + QUEUE_SIZE, std::memory_order_release);
+		return true;
+	}
+
+	/**
+		print writes a message to stdout.
+
+			@param1 a_level is how serious it is.
+
+			@param2 a_suppressed is how many messages of its site were left
+					out before it.
+
+			@param3 a_file is the file it was logged from.
+
+			@param4 a_line is the line it was logged from.
+
+			@param5 a_text is the message.
+	*/
+	void Log::print(LogLevel a_level, unsigned int a_suppressed,
+		const char* a_file, int a_line, const char* a_text)
+	{
+		if (a_suppressed > 0)
+		{
+			// Only the file name, the path is the build machine's.
+			const char* name = a_file;
+			for (const char* c = a_file; *c != '\0'; ++c)
+			{
+				if (*c == '/' || *c == '\\')
+					name = c + 1;
+			}
+			printf("%s: %s (%u more from %s:%d left out)\n",
+				LEVEL_NAMES[(unsigned int)a_level], a_text, a_suppressed, name, a_line);
+		}
+		else
+			printf("%s: %s\n", LEVEL_NAMES[(unsigned int)a_level], a_text);
+	}
+
+	/**
+		getSeconds returns the seconds since the log started.
+	*/
+	unsigned int Log::getSeconds() const
+	{
+		long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		return (unsigned int)((now - m_start) / 1000);
+	}
+
+	/**
+		run takes messages off the queue until shutdown, sleeping while
+			there are none.
+	*/
+	void Log::run()
+	{
+		while (m_running)
+		{
+			flush();
+			std::this_thread::sleep_for(DRAIN_INTERVAL);
+		}
+	}
+}
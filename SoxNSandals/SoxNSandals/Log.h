@@ -0,0 +1,269 @@
+/**
+	Log.h
+
+	Purpose: Log.h is the header file for the Log class and the logging
+			macros. Messages are queued without locking and written out
+			on a thread of their own, and each place that logs is rate
+			limited, so a message hit every frame costs the frame an
+			atomic or two rather than a console write.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <atomic>
+#include <thread>
+
+/*
+	Messages below SNS_LOG_MIN_LEVEL are compiled out, arguments and all.
+		It defaults to 0, VERBOSE, and to 1, INFO, in release builds. It
+		can be defined for the whole project to leave out more.
+*/
+#if !defined(SNS_LOG_MIN_LEVEL)
+#if defined(NDEBUG)
+#define SNS_LOG_MIN_LEVEL 1
+#else
+#define SNS_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+namespace sns
+{
+	/**
+		How serious a message is, least first.
+	*/
+	enum class LogLevel : unsigned int
+	{
+		VERBOSE,
+		INFO,
+		WARNING,
+		SEVERE
+	};
+
+	/**
+		The LogSite struct is one place a message is logged from, made by
+			the logging macros as a static. It keeps what the rate limit
+			and the deduplication need, all atomic, so sites can be hit
+			from any thread.
+	*/
+	struct LogSite
+	{
+		// How many recent messages of a site are remembered.
+		static const unsigned int RECENT_COUNT = 8;
+
+		const char* file;
+		int line;
+		LogLevel level;
+
+		// The second the site's count is of and how many messages it
+		//	has written in it.
+		std::atomic<unsigned int> window;
+		std::atomic<unsigned int> count;
+
+		// Messages left out since the site last wrote one.
+		std::atomic<unsigned int> suppressed;
+
+		// The hashes of recent messages and the seconds they were
+		//	written, so a repeat of one is left out.
+		std::atomic<unsigned int> recent[RECENT_COUNT];
+		std::atomic<unsigned int> recentTimes[RECENT_COUNT];
+		std::atomic<unsigned int> nextRecent;
+
+		LogSite(const char* a_file, int a_line, LogLevel a_level);
+
+		LogSite(const LogSite&) = delete;
+		LogSite& operator=(const LogSite&) = delete;
+	};
+
+	/**
+		The Log class writes messages to stdout on its own thread.
+
+		write formats a message into a fixed size entry of a bounded
+			queue that many threads can add to without locking, and the
+			thread takes entries out every few milliseconds. A full
+			queue drops the message and counts it, rather than making
+			the caller wait.
+
+		Each site writes at most MAX_PER_SECOND messages a second, and
+			leaves out one it wrote in the last REPEAT_SECONDS. Left
+			out messages are counted and reported with the site's next
+			one, so the console shows that a site is flooding without
+			being flooded.
+
+		Messages are best logged with the SNS_LOG macros, which make the
+			site and leave the call out below SNS_LOG_MIN_LEVEL.
+	*/
+	class Log
+	{
+	public:
+		// How many messages a site writes in a second at most.
+		static const unsigned int MAX_PER_SECOND = 4;
+
+		// How long a message is left out for after it is written.
+		static const unsigned int REPEAT_SECONDS = 10;
+
+		// How many messages can wait to be written.
+		static const unsigned int QUEUE_SIZE = 1024;
+
+		// The longest message, longer ones are cut short.
+		static const unsigned int MAX_MESSAGE = 256;
+
+		/**
+			Counts since the log started.
+		*/
+		struct Stats
+		{
+			unsigned int written;
+
+			// Left out by the rate limit or as repeats.
+			unsigned int suppressed;
+
+			// Dropped as the queue was full.
+			unsigned int dropped;
+		};
+
+		/**
+			instance returns the log, starting its thread the first
+				time.
+		*/
+		static Log& instance();
+
+		/**
+			The deconstructor writes what is queued, see shutdown.
+		*/
+		~Log();
+
+		Log(const Log&) = delete;
+		Log& operator=(const Log&) = delete;
+
+		/**
+			write logs a message from a site, unless it is below the
+				level or the site's limits leave it out.
+
+				@param1 a_site is where it is logged from.
+
+				@param2 a_format is a printf format.
+		*/
+		void write(LogSite& a_site, const char* a_format, ...);
+
+		/**
+			setLevel leaves out messages below a level from now on, on
+				top of SNS_LOG_MIN_LEVEL.
+
+				@param1 a_level is the least serious level written.
+		*/
+		void setLevel(LogLevel a_level) { m_level = (unsigned int)a_level; }
+
+		/**
+			isEnabled returns whether messages of a level are written.
+
+				@param1 a_level is the level.
+		*/
+		bool isEnabled(LogLevel a_level) const { return (unsigned int)a_level >= m_level; }
+
+		/**
+			flush writes every queued message on the calling thread,
+				before returning.
+		*/
+		void flush();
+
+		/**
+			shutdown writes every queued message and stops the thread.
+				Messages written after it go straight to stdout.
+		*/
+		void shutdown();
+
+		/**
+			getStats returns the counts since the log started.
+		*/
+		Stats getStats() const;
+
+	private:
+		Log();
+
+		/**
+			A message waiting to be written. sequence is what the queue
+				marks it with, see push and pop.
+		*/
+		struct Entry
+		{
+			std::atomic<unsigned int> sequence;
+			LogLevel level;
+			unsigned int suppressed;
+			const char* file;
+			int line;
+			char text[MAX_MESSAGE];
+		};
+
+		// Returns whether a site's limits let a message through, counting
+		//	it as suppressed if not.
+		bool allow(LogSite& a_site, unsigned int a_now);
+
+		// Returns whether a message hashing to a_hash was written by the
+		//	site in the last REPEAT_SECONDS, remembering it if not.
+		bool isRepeat(LogSite& a_site, unsigned int a_hash, unsigned int a_now);
+
+		// Adds a message to the queue, returning false if it is full.
+		bool push(const LogSite& a_site, unsigned int a_suppressed, const char* a_text);
+
+		// Writes the next queued message, returning false if there is none.
+		bool pop();
+
+		// Writes a message to stdout.
+		static void print(LogLevel a_level, unsigned int a_suppressed,
+			const char* a_file, int a_line, const char* a_text);
+
+		// Returns the seconds since the log started.
+		unsigned int getSeconds() const;
+
+		void run();
+
+		Entry* m_entries;
+
+		// Where the next message is added and taken from, counting up
+		//	for good rather than wrapping.
+		std::atomic<unsigned int> m_head;
+		std::atomic<unsigned int> m_tail;
+
+		std::atomic<unsigned int> m_level;
+		std::atomic<bool> m_running;
+		std::thread m_thread;
+
+		// So flush and the thread don't take entries at once.
+		std::atomic<bool> m_popping;
+
+		long long m_start;
+
+		std::atomic<unsigned int> m_written;
+		std::atomic<unsigned int> m_suppressed;
+		std::atomic<unsigned int> m_dropped;
+	};
+}
+
+// Logs a message of a level from here, made a site of its own. The format
+//	and arguments are as printf's, without the newline.
+#define SNS_LOG(level, ...) \
+	do \
+	{ \
+		static sns::LogSite snsLogSite(__FILE__, __LINE__, level); \
+		sns::Log::instance().write(snsLogSite, __VA_ARGS__); \
+	} while (false)
+
+#if SNS_LOG_MIN_LEVEL <= 0
+#define SNS_LOG_VERBOSE(...) SNS_LOG(sns::LogLevel::VERBOSE, __VA_ARGS__)
+#else
+#define SNS_LOG_VERBOSE(...) ((void)0)
+#endif
+
+#if SNS_LOG_MIN_LEVEL <= 1
+#define SNS_LOG_INFO(...) SNS_LOG(sns::LogLevel::INFO, __VA_ARGS__)
+#else
+#define SNS_LOG_INFO(...) ((void)0)
+#endif
+
+#if SNS_LOG_MIN_LEVEL <= 2
+#define SNS_LOG_WARNING(...) SNS_LOG(sns::LogLevel::WARNING, __VA_ARGS__)
+#else
+#define SNS_LOG_WARNING(...) ((void)0)
+#endif
+
+#define SNS_LOG_SEVERE(...) SNS_LOG(sns::LogLevel::SEVERE, __VA_ARGS__)
@@ -0,0 +1,491 @@
+/**
+	LooseOctree.cpp
+
+	Purpose: LooseOctree.cpp is the source file for the LooseOctree class.
+			The LooseOctree finds the moving objects near a frustum or a
+			point, where a bvh would need rebuilding as they move.
+
+	@author Nathan Nette
+*/
+#include "LooseOctree.h"
+#include "Frustum.h"
+#include <algorithm>
+
+namespace sns
+{
+	namespace
+	{
+		// Cells a query has waiting at most. Each cell popped pushes up
+		//	to eight, so a walk down MAX_DEPTH levels needs fewer.
+		const unsigned int STACK_SIZE = 64;
+
+		/**
+			A frustum's planes made unit length, so spheres are tested
+				by their radius alone, with each normal's absolute for
+				the boxes.
+		*/
+		struct Planes
+		{
+			glm::vec4 planes[6];
+			glm::vec3 absolute[6];
+
+			void set(const Frustum& a_frustum)
+			{
+				for (unsigned int i = 0; i < 6; ++i)
+				{
+					glm::vec4 plane = a_frustum.getPlane(i);
+					float length = glm::length(glm::vec3(plane));
+					planes[i] = length > 0.0f ? plane / length : plane;
+					absolute[i] = glm::abs(glm::vec3(planes[i]));
+				}
+			}
+		};
+
+		// How a box is to a frustum.
+		enum Side
+		{
+			OUTSIDE,
+			INTERSECTING,
+			INSIDE
+		};
+
+		Side classifyBox(const Planes& a_planes, const glm::vec3& a_centre, float a_extent)
+		{
+			Side side = INSIDE;
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				float distance = glm::dot(glm::vec3(a_planes.planes[i]), a_centre) + a_planes.planes[i].w;
+				float radius = a_extent * (a_planes.absolute[i].x + a_planes.absolute[i].y + a_planes.absolute[i].z);
+				if (distance < -radius)
+					return OUTSIDE;
+				if (distance < radius)
+					side = INTERSECTING;
+			}
+			return side;
+		}
+
+		bool isSphereVisible(const Planes& a_planes, const glm::vec4& a_sphere)
+		{
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				if (glm::dot(glm::vec3(a_planes.planes[i]), glm::vec3(a_sphere)) + a_planes.planes[i].w < -a_sphere.w)
+					return false;
+			}
+			return true;
+		}
+	}
+
+	LooseOctree::LooseOctree()
+		: m_min(0),
+		m_size(1.0f),
+		m_depth(0),
+		m_objectCount(0)
+	{
+		std::fill(m_levelStart, m_levelStart + MAX_DEPTH + 1, 0);
+	}
+
+	/**
+		create allocates the cells over a box, emptying the tree. The box
+			is made a cube of its longest side. Objects outside it are
+			kept in the root and always tested.
+
+			@param1 a_min is the box's lower corner.
+
+			@param2 a_max is its upper corner.
+
+			@param3 a_depth is how many levels there are, up to MAX_DEPTH.
+	*/
+	void LooseOctree::create(const glm::vec3& a_min, const glm::vec3& a_max, unsigned int a_depth)
+	{
+		glm::vec3 size = a_max - a_min;
+		m_min = a_min;
+		m_size = std::max(std::max(size.x, size.y), std::max(size.z, 1e-3f));
+		m_depth = std::max(1u, std::min(a_depth, (unsigned int)MAX_DEPTH));
+
+		// Each level has eight times the cells of the one above it.
+		m_levelStart[0] = 0;
+		for (unsigned int level = 0; level < m_depth; ++level)
+			m_levelStart[level + 1] = m_levelStart[level] + (1u << (level * 3));
+
+		m_cells.clear();
+		m_cells.resize(m_levelStart[m_depth]);
+		clear();
+	}
+
+	/**
+		clear removes every object, keeping the cells.
+	*/
+	void LooseOctree::clear()
+	{
+		for (Cell& cell : m_cells)
+		{
+			cell.entries.clear();
+			cell.count = 0;
+		}
+		m_objects.clear();
+		m_pendingCells.clear();
+		m_freeHandles.clear();
+		m_objectCount = 0;
+	}
+
+	/**
+		insert adds a sphere to the tree.
+
+			@param1 a_centre is its centre.
+
+			@param2 a_radius is its radius.
+
+			@param3 a_user is what queries return for it.
+
+			@return its handle, or NO_HANDLE if the tree wasn't created.
+	*/
+	LooseOctree::Handle LooseOctree::insert(const glm::vec3& a_centre, float a_radius, uint32_t a_user)
+	{
+		if (isCreated() == false)
+			return NO_HANDLE;
+
+		Handle handle;
+		if (m_freeHandles.empty() == false)
+		{
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+		}
+		else
+		{
+			handle = (Handle)m_objects.size();
+			m_objects.emplace_back();
+			m_pendingCells.emplace_back();
+		}
+
+		uint32_t cell = findCell(a_centre, a_radius);
+		m_pendingCells[handle] = cell;
+		link(Entry{ glm::vec4(a_centre, a_radius), handle, a_user }, cell);
+		++m_objectCount;
+		return handle;
+	}
+
+	/**
+		remove takes an object out of the tree. Its handle may be given
+			to the next insert.
+
+			@param1 a_handle is the object.
+	*/
+	void LooseOctree::remove(Handle a_handle)
+	{
+		if (a_handle >= m_objects.size() || m_objects[a_handle].cell == NO_CELL)
+			return;
+
+		unlink(a_handle);
+		m_pendingCells[a_handle] = NO_CELL;
+		m_freeHandles.push_back(a_handle);
+		--m_objectCount;
+	}
+
+	/**
+		move changes an object's sphere and works out the cell it now
+			belongs in, without touching the cells. update moves it
+			there.
+
+			@param1 a_handle is the object.
+
+			@param2 a_centre is its new centre.
+
+			@param3 a_radius is its new radius.
+	*/
+	void LooseOctree::move(Handle a_handle, const glm::vec3& a_centre, float a_radius)
+	{
+		const Object& object = m_objects[a_handle];
+		m_cells[object.cell].entries[object.slot].sphere = glm::vec4(a_centre, a_radius);
+		m_pendingCells[a_handle] = findCell(a_centre, a_radius);
+	}
+
+	/**
+		update moves every object whose cell move changed into it. Most
+			objects move a little each frame and stay in their cell, so
+			this is mostly a walk over one array.
+
+			@return how many objects changed cell.
+	*/
+	unsigned int LooseOctree::update()
+	{
+		unsigned int moved = 0;
+		for (Handle handle = 0; handle < (Handle)m_pendingCells.size(); ++handle)
+		{
+			uint32_t cell = m_pendingCells[handle];
+			if (cell == m_objects[handle].cell)
+				continue;
+
+			link(unlink(handle), cell);
+			++moved;
+		}
+		return moved;
+	}
+
+	/**
+		queryFrustum finds every object at least partly inside any of a
+			list of frustums, each once. A cell is only tested against
+			the frustums its parent intersected, and everything below a
+			cell inside any of them is added without testing.
+
+			@param1 a_frustums are the frustums.
+
+			@param2 a_count is how many, up to MAX_FRUSTUMS.
+
+			@param3 a_users has the objects' user values added.
+
+			@return how many were found.
+	*/
+	unsigned int LooseOctree::queryFrustum(const Frustum* a_frustums, unsigned int a_count,
+		std::vector<uint32_t>& a_users) const
+	{
+		if (isCreated() == false || a_count == 0)
+			return 0;
+
+		size_t before = a_users.size();
+		unsigned int count = std::min(a_count, (unsigned int)MAX_FRUSTUMS);
+		Planes planes[MAX_FRUSTUMS];
+		for (unsigned int i = 0; i < count; ++i)
+			planes[i].set(a_frustums[i]);
+
+		struct Visit
+		{
+			Place place;
+
+			// The frustums the cell's parent intersected, as bits.
+			uint32_t frustums;
+		};
+		Visit stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = { Place{ 0, 0, 0, 0, 0 }, count == 32 ? 0xffffffffu : (1u << count) - 1 };
+
+		while (top > 0)
+		{
+			Visit visit = stack[--top];
+			const Place& place = visit.place;
+			const Cell& cell = m_cells[place.cell];
+
+			// The root holds what is outside the cube as well, so its box
+			//	isn't tested, only its objects.
+			uint32_t frustums = visit.frustums;
+			if (place.level > 0)
+			{
+				glm::vec3 centre;
+				float extent;
+				getLooseBox(place, centre, extent);
+
+				uint32_t intersecting = 0;
+				bool inside = false;
+				for (unsigned int i = 0; i < count && inside == false; ++i)
+				{
+					if ((frustums & (1u << i)) == 0)
+						continue;
+					Side side = classifyBox(planes[i], centre, extent);
+					inside = side == INSIDE;
+					intersecting |= side == INTERSECTING ? 1u << i : 0;
+				}
+
+				if (inside)
+				{
+					addSubtree(place, a_users);
+					continue;
+				}
+				if (intersecting == 0)
+					continue;
+				frustums = intersecting;
+			}
+
+			for (const Entry& object : cell.entries)
+			{
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					if ((frustums & (1u << i)) != 0 && isSphereVisible(planes[i], object.sphere))
+					{
+						a_users.push_back(object.user);
+						break;
+					}
+				}
+			}
+
+			if (place.level + 1 >= m_depth)
+				continue;
+			for (unsigned int child = 0; child < 8; ++child)
+			{
+				Place childPlace = getChild(place, child);
+				if (m_cells[childPlace.cell].count > 0)
+					stack[top++] = { childPlace, frustums };
+			}
+		}
+		return (unsigned int)(a_users.size() - before);
+	}
+
+	/**
+		querySphere finds every object overlapping a sphere.
+
+			@param1 a_centre is the sphere's centre.
+
+			@param2 a_radius is its radius.
+
+			@param3 a_users has the objects' user values added.
+
+			@return how many were found.
+	*/
+	unsigned int LooseOctree::querySphere(const glm::vec3& a_centre, float a_radius,
+		std::vector<uint32_t>& a_users) const
+	{
+		if (isCreated() == false)
+			return 0;
+
+		size_t before = a_users.size();
+		Place stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = Place{ 0, 0, 0, 0, 0 };
+
+		while (top > 0)
+		{
+			Place place = stack[--top];
+			const Cell& cell = m_cells[place.cell];
+
+			// As with frustums, the root's box isn't tested.
+			if (place.level > 0)
+			{
+				glm::vec3 centre;
+				float extent;
+				getLooseBox(place, centre, extent);
+				glm::vec3 outside = glm::max(glm::abs(a_centre - centre) - glm::vec3(extent), glm::vec3(0));
+				if (glm::dot(outside, outside) > a_radius * a_radius)
+					continue;
+			}
+
+			for (const Entry& object : cell.entries)
+			{
+				glm::vec3 offset = glm::vec3(object.sphere) - a_centre;
+				float reach = a_radius + object.sphere.w;
+				if (glm::dot(offset, offset) <= reach * reach)
+					a_users.push_back(object.user);
+			}
+
+			if (place.level + 1 >= m_depth)
+				continue;
+			for (unsigned int child = 0; child < 8; ++child)
+			{
+				Place childPlace = getChild(place, child);
+				if (m_cells[childPlace.cell].count > 0)
+					stack[top++] = childPlace;
+			}
+		}
+		return (unsigned int)(a_users.size() - before);
+	}
+
+	/**
+		findCell finds the smallest cell whose loose bounds hold a sphere
+			centred in it, which is the deepest whose size is at least
+			the sphere's diameter. What the cube doesn't hold goes in
+			the root.
+	*/
+	uint32_t LooseOctree::findCell(const glm::vec3& a_centre, float a_radius) const
+	{
+		glm::vec3 local = (a_centre - m_min) / m_size;
+		if (local.x < 0.0f || local.y < 0.0f || local.z < 0.0f ||
+			local.x > 1.0f || local.y > 1.0f || local.z > 1.0f || a_radius > m_size * 0.5f)
+			return 0;
+
+		// A level's cells are the cube over 2 to the level across, and the
+		//	next is deep enough while the radius is half a cell or less.
+		unsigned int level = 0;
+		while (level + 1 < m_depth && a_radius <= m_size / float(4u << level))
+			++level;
+
+		uint32_t cells = 1u << level;
+		uint32_t x = std::min((uint32_t)(local.x * cells), cells - 1);
+		uint32_t y = std::min((uint32_t)(local.y * cells), cells - 1);
+		uint32_t z = std::min((uint32_t)(local.z * cells), cells - 1);
+		return m_levelStart[level] + x + (y + z * cells) * cells;
+	}
+
+	void LooseOctree::link(const Entry& a_entry, uint32_t a_cell)
+	{
+		Cell& cell = m_cells[a_cell];
+		Object& object = m_objects[a_entry.handle];
+		object.cell = a_cell;
+		object.slot = (uint32_t)cell.entries.size();
+		cell.entries.push_back(a_entry);
+		addCount(a_cell, 1);
+	}
+
+	LooseOctree::Entry LooseOctree::unlink(Handle a_handle)
+	{
+		Object& object = m_objects[a_handle];
+		std::vector<Entry>& entries = m_cells[object.cell].entries;
+		Entry entry = entries[object.slot];
+
+		// The last entry fills the gap, so the cell stays packed.
+		entries[object.slot] = entries.back();
+		m_objects[entries[object.slot].handle].slot = object.slot;
+		entries.pop_back();
+
+		addCount(object.cell, -1);
+		object.cell = NO_CELL;
+		return entry;
+	}
+
+	void LooseOctree::addCount(uint32_t a_cell, int a_amount)
+	{
+		// Which level the cell is on and where in it, then up a level at
+		//	a time by halving where.
+		unsigned int level = 0;
+		while (a_cell >= m_levelStart[level + 1])
+			++level;
+
+		uint32_t cells = 1u << level;
+		uint32_t local = a_cell - m_levelStart[level];
+		uint32_t x = local % cells, y = (local / cells) % cells, z = local / (cells * cells);
+		for (;;)
+		{
+			m_cells[m_levelStart[level] + x + (y + z * cells) * cells].count += a_amount;
+			if (level == 0)
+				break;
+			--level;
+			cells >>= 1;
+			x >>= 1;
+			y >>= 1;
+			z >>= 1;
+		}
+	}
+
+	LooseOctree::Place LooseOctree::getChild(const Place& a_place, unsigned int a_child) const
+	{
+		Place child;
+		child.level = a_place.level + 1;
+		child.x = a_place.x * 2 + (a_child & 1);
+		child.y = a_place.y * 2 + ((a_child >> 1) & 1);
+		child.z = a_place.z * 2 + (a_child >> 2);
+
+		uint32_t cells = 1u << child.level;
+		child.cell = m_levelStart[child.level] + child.x + (child.y + child.z * cells) * cells;
+		return child;
+	}
+
+	void LooseOctree::getLooseBox(const Place& a_place, glm::vec3& a_centre, float& a_extent) const
+	{
+		// Loose bounds are twice the cell, so reach a whole cell out from
+		//	its centre.
+		float side = m_size / float(1u << a_place.level);
+		a_centre = m_min + (glm::vec3(a_place.x, a_place.y, a_place.z) + 0.5f) * side;
+		a_extent = side;
+	}
+
+	void LooseOctree::addSubtree(const Place& a_place, std::vector<uint32_t>& a_users) const
+	{
+		for (const Entry& object : m_cells[a_place.cell].entries)
+			a_users.push_back(object.user);
+
+		if (a_place.level + 1 >= m_depth)
+			return;
+		for (unsigned int child = 0; child < 8; ++child)
+		{
+			Place childPlace = getChild(a_place, child);
+			if (m_cells[childPlace.cell].count > 0)
+				addSubtree(childPlace, a_users);
+		}
+	}
+}
@@ -0,0 +1,241 @@
+/**
+	LooseOctree.h
+
+	Purpose: LooseOctree.h is the header file for the LooseOctree class.
+			The LooseOctree finds the moving objects near a frustum or a
+			point, where a bvh would need rebuilding as they move.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sns
+{
+	class Frustum;
+
+	/**
+		The LooseOctree class holds spheres in a fixed octree over a cube,
+			every level allocated up front, so a cell is found from a
+			position and radius with arithmetic alone. Each cell's
+			bounds are loose, twice its size, so an object only needs
+			its centre in a cell as small as its radius allows.
+
+		Moving an object is done in two halves. move works out its new
+			cell and only writes that object, so the objects can be
+			moved from many jobs at once. update then relinks the ones
+			whose cell changed, once a frame, each in constant time.
+
+		A cell counts the objects under it, so queries skip the empty
+			parts of the tree, and a cell entirely inside a frustum adds
+			everything under it without testing.
+	*/
+	class LooseOctree
+	{
+	public:
+		typedef uint32_t Handle;
+		static const Handle NO_HANDLE = 0xffffffff;
+
+		// Levels the tree has at most, and by default. Six levels is
+		//	37449 cells, the smallest a 32nd of the cube across.
+		static const unsigned int MAX_DEPTH = 8;
+		static const unsigned int DEFAULT_DEPTH = 6;
+
+		// Frustums one query tests against at most.
+		static const unsigned int MAX_FRUSTUMS = 32;
+
+		LooseOctree();
+
+		/**
+			create allocates the cells over a box, emptying the tree.
+				The box is made a cube of its longest side. Objects
+				outside it are kept in the root and always tested.
+
+				@param1 a_min is the box's lower corner.
+
+				@param2 a_max is its upper corner.
+
+				@param3 a_depth is how many levels there are, up to
+						MAX_DEPTH.
+		*/
+		void create(const glm::vec3& a_min, const glm::vec3& a_max, unsigned int a_depth = DEFAULT_DEPTH);
+
+		/**
+			clear removes every object, keeping the cells.
+		*/
+		void clear();
+
+		/**
+			insert adds a sphere to the tree.
+
+				@param1 a_centre is its centre.
+
+				@param2 a_radius is its radius.
+
+				@param3 a_user is what queries return for it.
+
+				@return its handle, or NO_HANDLE if the tree wasn't
+						created.
+		*/
+		Handle insert(const glm::vec3& a_centre, float a_radius, uint32_t a_user);
+
+		/**
+			remove takes an object out of the tree. Its handle may be
+				given to the next insert.
+
+				@param1 a_handle is the object.
+		*/
+		void remove(Handle a_handle);
+
+		/**
+			move changes an object's sphere. Queries see the new sphere
+				at once, but the object stays in its old cell until the
+				next update. Different objects can be moved at once from
+				different threads.
+
+				@param1 a_handle is the object.
+
+				@param2 a_centre is its new centre.
+
+				@param3 a_radius is its new radius.
+		*/
+		void move(Handle a_handle, const glm::vec3& a_centre, float a_radius);
+
+		/**
+			update moves every object whose cell move changed into it.
+
+				@return how many objects changed cell.
+		*/
+		unsigned int update();
+
+		/**
+			queryFrustum finds every object at least partly inside any of
+				a list of frustums, each once.
+
+				@param1 a_frustums are the frustums.
+
+				@param2 a_count is how many, up to MAX_FRUSTUMS.
+
+				@param3 a_users has the objects' user values added.
+
+				@return how many were found.
+		*/
+		unsigned int queryFrustum(const Frustum* a_frustums, unsigned int a_count, std::vector<uint32_t>& a_users) const;
+
+		/**
+			querySphere finds every object overlapping a sphere.
+
+				@param1 a_centre is the sphere's centre.
+
+				@param2 a_radius is its radius.
+
+				@param3 a_users has the objects' user values added.
+
+				@return how many were found.
+		*/
+		unsigned int querySphere(const glm::vec3& a_centre, float a_radius, std::vector<uint32_t>& a_users) const;
+
+		/**
+			isCreated returns whether create has been called.
+		*/
+		bool isCreated() const { return m_cells.empty() == false; }
+
+		/**
+			getObjectCount returns how many objects are in the tree.
+		*/
+		unsigned int getObjectCount() const { return m_objectCount; }
+
+		/**
+			getCellCount returns how many cells every level has between
+				them.
+		*/
+		unsigned int getCellCount() const { return (unsigned int)m_cells.size(); }
+
+	private:
+		// The cell of an object not in the tree.
+		static const uint32_t NO_CELL = 0xffffffff;
+
+		/**
+			An object as its cell holds it, its sphere, centre and radius,
+				with its handle and user value.
+		*/
+		struct Entry
+		{
+			glm::vec4 sphere;
+			Handle handle;
+			uint32_t user;
+		};
+
+		/**
+			A cell's objects packed together, so a query reads them in
+				order, and how many objects are in it and every cell
+				below it. An object leaving moves the last into its
+				place.
+		*/
+		struct Cell
+		{
+			std::vector<Entry> entries;
+			uint32_t count;
+		};
+
+		/**
+			Where an object's entry is.
+		*/
+		struct Object
+		{
+			uint32_t cell;
+			uint32_t slot;
+		};
+
+		/**
+			A cell's place in the tree, for walking down from the root.
+		*/
+		struct Place
+		{
+			uint32_t cell;
+			uint32_t level;
+			uint32_t x, y, z;
+		};
+
+		// The cell a sphere belongs in.
+		uint32_t findCell(const glm::vec3& a_centre, float a_radius) const;
+
+		// Adds an entry to the end of a cell, or takes an object's out
+		//	of its cell.
+		void link(const Entry& a_entry, uint32_t a_cell);
+		Entry unlink(Handle a_handle);
+
+		// Adds to the count of a cell and every cell above it.
+		void addCount(uint32_t a_cell, int a_amount);
+
+		// The place of a cell's child, from 0 to 7 as x, y and z bits.
+		Place getChild(const Place& a_place, unsigned int a_child) const;
+
+		// The loose bounds of a cell, its centre and half its size.
+		void getLooseBox(const Place& a_place, glm::vec3& a_centre, float& a_extent) const;
+
+		// Adds every object in a cell and below it.
+		void addSubtree(const Place& a_place, std::vector<uint32_t>& a_users) const;
+
+		// The cube's lower corner and side, and how many levels it has.
+		glm::vec3 m_min;
+		float m_size;
+		unsigned int m_depth;
+
+		// Every level's cells one after another, each level x fastest
+		//	then y then z, and where each level starts.
+		std::vector<Cell> m_cells;
+		uint32_t m_levelStart[MAX_DEPTH + 1];
+
+		// Where every object is, and the cell move found for each, apart
+		//	so update compares them in order.
+		std::vector<Object> m_objects;
+		std::vector<uint32_t> m_pendingCells;
+
+		// Handles freed by remove, to be given out again.
+		std::vector<Handle> m_freeHandles;
+		unsigned int m_objectCount;
+	};
+}
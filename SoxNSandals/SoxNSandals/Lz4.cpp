@@ -0,0 +1,212 @@
+/**
+	Lz4.cpp
+
+	Purpose: Lz4.cpp is the source file for the Lz4 class. The Lz4 class
+			compresses and decompresses blocks in the LZ4 block format.
+
+	@author Nathan Nette
+*/
+#include "Lz4.h"
+#include <cstring>
+
+namespace sns
+{
+	// Bits of the hash of four bytes, the table has this many to the
+	//	power of two positions.
+	static const unsigned int HASH_BITS = 16;
+
+	// The format's shortest match, and the farthest back one can be.
+	static const size_t MIN_MATCH = 4;
+	static const size_t MAX_OFFSET = 65535;
+
+	// A block ends with at least this many literals, and no match starts
+	//	closer to its end than the limit, so decompressors can copy in
+	//	wide steps.
+	static const size_t LAST_LITERALS = 5;
+	static const size_t MATCH_LIMIT = 12;
+
+	/**
+		read32 reads four bytes that may not be aligned.
+	*/
+	static unsigned int read32(const unsigned char* a_data)
+	{
+		unsigned int value;
+		memcpy(&value, a_data, sizeof(value));
+		return value;
+	}
+
+	/**
+		writeLength writes what is left of a length past its token's 15,
+			in bytes of 255 then the remainder.
+	*/
+	static void writeLength(std::vector<unsigned char>& a_output, size_t a_length)
+	{
+		for (; a_length >= 255; a_length -= 255)
+			a_output.push_back(255);
+		a_output.push_back((unsigned char)a_length);
+	}
+
+	/**
+		writeSequence writes literals followed by a match, or only the
+			literals at the end of a block.
+
+			@param1 a_output is the block being written.
+
+			@param2 a_literals are the bytes since the last match.
+
+			@param3 a_literalCount is how many there are.
+
+			@param4 a_offset is how far back the match is.
+
+			@param5 a_matchLength is its length, 0 for the last literals.
+	*/
+	static void writeSequence(std::vector<unsigned char>& a_output, const unsigned char* a_literals,
+		size_t a_literalCount, size_t a_offset, size_t a_matchLength)
+	{
+		size_t matchCode = a_matchLength > 0 ? a_matchLength - MIN_MATCH : 0;
+		unsigned char token = (unsigned char)((a_literalCount < 15 ? a_literalCount : 15) << 4);
+		if (a_matchLength > 0)
+			token |= (unsigned char)(matchCode < 15 ? matchCode : 15);
+		a_output.push_back(token);
+
+		if (a_literalCount >= 15)
+			writeLength(a_output, a_literalCount - 15);
+		a_output.insert(a_output.end(), a_literals, a_literals + a_literalCount);
+
+		if (a_matchLength == 0)
+			return;
+		a_output.push_back((unsigned char)(a_offset & 0xff));
+		a_output.push_back((unsigned char)(a_offset >> 8));
+		if (matchCode >= 15)
+			writeLength(a_output, matchCode - 15);
+	}
+
+	/**
+		compress compresses a block.
+
+			@param1 a_source is the bytes to compress.
+
+			@param2 a_size is how many there are.
+
+			@param3 a_output is set to the compressed block.
+	*/
+	void Lz4::compress(const unsigned char* a_source, size_t a_size, std::vector<unsigned char>& a_output)
+	{
+		a_output.clear();
+		a_output.reserve(a_size + a_size / 255 + 16);
+
+		// Positions plus one, so 0 is empty.
+		std::vector<unsigned int> table((size_t)1 << HASH_BITS, 0);
+
+		size_t anchor = 0;
+		size_t position = 0;
+		size_t matchStartLimit = a_size > MATCH_LIMIT ? a_size - MATCH_LIMIT : 0;
+		size_t matchEndLimit = a_size > LAST_LITERALS ? a_size - LAST_LITERALS : 0;
+		while (position < matchStartLimit)
+		{
+			unsigned int sequence = read32(a_source + position);
+			unsigned int hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			size_t candidate = table[hash];
+			table[hash] = (unsigned int)(position + 1);
+
+			if (candidate == 0 || position + 1 - candidate > MAX_OFFSET ||
+				read32(a_source + candidate - 1) != sequence)
+			{
+				++position;
+				continue;
+			}
+			--candidate;
+
+			size_t length = MIN_MATCH;
+			while (position + length < matchEndLimit && a_source[candidate + length] == a_source[position + length])
+				++length;
+
+			writeSequence(a_output, a_source + anchor, position - anchor, position - candidate, length);
+			position += length;
+			anchor = position;
+		}
+		writeSequence(a_output, a_source + anchor, a_size - anchor, 0, 0);
+	}
+
+	/**
+		decompress decompresses a block into a buffer of its size.
+
+			@param1 a_source is the compressed block.
+
+			@param2 a_sourceSize is its size.
+
+			@param3 a_output is where it is decompressed to.
+
+			@param4 a_outputSize is how large it is once decompressed.
+
+			@return false if the block is damaged or isn't that size.
+	*/
+	bool Lz4::decompress(const unsigned char* a_source, size_t a_sourceSize,
+		unsigned char* a_output, size_t a_outputSize)
+	{
+		size_t in = 0;
+		size_t out = 0;
+		while (in < a_sourceSize)
+		{
+			unsigned char token = a_source[in++];
+
+			size_t literals = token >> 4;
+			if (literals == 15)
+			{
+				unsigned char byte = 255;
+				while (byte == 255)
+				{
+					if (in >= a_sourceSize)
+						return false;
+					byte = a_source[in++];
+					literals += byte;
+				}
+			}
+			if (in + literals > a_sourceSize || out + literals > a_outputSize)
+				return false;
+			memcpy(a_output + out, a_source + in, literals);
+			in += literals;
+			out += literals;
+
+			// The last sequence has no match.
+			if (in == a_sourceSize)
+				break;
+
+			if (in + 2 > a_sourceSize)
+				return false;
+			size_t offset = a_source[in] | ((size_t)a_source[in + 1] << 8);
+			in += 2;
+			if (offset == 0 || offset > out)
+				return false;
+
+			size_t length = token & 15;
+			if (length == 15)
+			{
+				unsigned char byte = 255;
+				while (byte == 255)
+				{
+					if (in >= a_sourceSize)
+						return false;
+					byte = a_source[in++];
+					length += byte;
+				}
+			}
+			length += MIN_MATCH;
+			if (out + length > a_outputSize)
+				return false;
+
+			// Matches closer than their length repeat what they copy, so
+			//	those go a byte at a time.
+			const unsigned char* match = a_output + out - offset;
+			if (offset >= length)
+				memcpy(a_output + out, match, length);
+			else
+			{
+				for (size_t i = 0; i < length; ++i)
+					a_output[out + i] = match[i];
+			}
+			out += length;
+		}
+		return out == a_outputSize;
+	}
+}
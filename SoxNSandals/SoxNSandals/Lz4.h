@@ -0,0 +1,53 @@
+/**
+	Lz4.h
+
+	Purpose: Lz4.h is the header file for the Lz4 class. The Lz4 class
+			compresses and decompresses blocks in the LZ4 block format,
+			which decompresses about as fast as memory can be copied.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The Lz4 class reads and writes single LZ4 blocks, without the
+			frame format around them. The compressor is greedy with one
+			candidate a hash, which is quick and compresses a bit less
+			than the reference one. Anything the reference compressor
+			writes decompresses.
+	*/
+	class Lz4
+	{
+	public:
+		/**
+			compress compresses a block.
+
+				@param1 a_source is the bytes to compress.
+
+				@param2 a_size is how many there are.
+
+				@param3 a_output is set to the compressed block.
+		*/
+		static void compress(const unsigned char* a_source, size_t a_size, std::vector<unsigned char>& a_output);
+
+		/**
+			decompress decompresses a block into a buffer of its size.
+
+				@param1 a_source is the compressed block.
+
+				@param2 a_sourceSize is its size.
+
+				@param3 a_output is where it is decompressed to.
+
+				@param4 a_outputSize is how large it is once decompressed.
+
+				@return false if the block is damaged or isn't that size.
+		*/
+		static bool decompress(const unsigned char* a_source, size_t a_sourceSize,
+			unsigned char* a_output, size_t a_outputSize);
+	};
+}
@@ -0,0 +1,169 @@
+/**
+	MappedFile.cpp
+
+	Purpose: MappedFile.cpp is the source file for the MappedFile class.
+			The MappedFile class maps a file on disk into the address
+			space of the application as read-only memory.
+
+	@author Nathan Nette
+*/
+#include "MappedFile.h"
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace sns
+{
+	/**
+		Constructor that sets the mapping to empty.
+	*/
+	MappedFile::MappedFile()
+		: m_data(nullptr),
+		m_size(0),
+#ifdef _WIN32
+		m_file(nullptr),
+		m_mapping(nullptr)
+#else
+		m_fd(-1)
+#endif
+	{
+	}
+
+	/**
+		The deconstructor unmaps the file if it is still open.
+	*/
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	/**
+		open maps a file into memory.
+
+			@param1 a_filename is the path of the file to map.
+
+			@return true if the file was mapped.
+	*/
+	bool MappedFile::open(const char* a_filename)
+	{
+		// Only one file can be mapped at a time.
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(a_filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		m_file = file;
+		m_mapping = mapping;
+		m_data = (const unsigned char*)view;
+		m_size = (size_t)size.QuadPart;
+#else
+		int fd = ::open(a_filename, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			::close(fd);
+			return false;
+		}
+
+		m_fd = fd;
+		m_data = (const unsigned char*)view;
+		m_size = (size_t)info.st_size;
+#endif
+		return true;
+	}
+
+	/**
+		close unmaps the file and releases the OS handles.
+	*/
+	void MappedFile::close()
+	{
+#ifdef _WIN32
+		if (m_data != nullptr)
+			UnmapViewOfFile(m_data);
+		if (m_mapping != nullptr)
+			CloseHandle((HANDLE)m_mapping);
+		if (m_file != nullptr)
+			CloseHandle((HANDLE)m_file);
+		m_mapping = nullptr;
+		m_file = nullptr;
+#else
+		if (m_data != nullptr)
+			munmap((void*)m_data, m_size);
+		if (m_fd >= 0)
+			::close(m_fd);
+		m_fd = -1;
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	/**
+		getFileStamp reads the size and last modified time of a file.
+
+			@param1 a_filename is the path of the file.
+
+			@param2 a_size is where the size of the file gets written.
+
+			@param3 a_modifiedTime is where the last write time gets written.
+
+			@return true if the file exists.
+	*/
+	bool MappedFile::getFileStamp(const char* a_filename, unsigned long long& a_size, long long& a_modifiedTime)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if (_stat64(a_filename, &info) != 0)
+			return false;
+#else
+		struct stat info;
+		if (stat(a_filename, &info) != 0)
+			return false;
+#endif
+		a_size = (unsigned long long)info.st_size;
+		a_modifiedTime = (long long)info.st_mtime;
+		return true;
+	}
+}
@@ -0,0 +1,103 @@
+/**
+	MappedFile.h
+
+	Purpose: MappedFile.h is the header file for the MappedFile class.
+			The MappedFile class maps a file on disk into the address
+			space of the application as read-only memory. This lets
+			loaders read straight out of the file without copying it
+			into a buffer first.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstddef>
+
+namespace sns
+{
+	/**
+		The MappedFile class opens a file and maps the whole thing into
+			memory. The data stays valid until close is called or the
+			MappedFile is destroyed.
+	*/
+	class MappedFile
+	{
+	public:
+		/**
+			Constructor that sets the mapping to empty.
+		*/
+		MappedFile();
+
+		/**
+			The deconstructor unmaps the file if it is still open.
+		*/
+		~MappedFile();
+
+		// A mapping owns OS handles, so it can't be copied.
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+			open maps a file into memory.
+
+				@param1 a_filename is the path of the file to map.
+
+				@return true if the file was mapped.
+		*/
+		bool open(const char* a_filename);
+
+		/**
+			close unmaps the file and releases the OS handles.
+		*/
+		void close();
+
+		/**
+			getData returns a pointer to the start of the mapped file.
+
+				@return the mapped bytes, or nullptr if nothing is open.
+		*/
+		const unsigned char* getData() const { return m_data; }
+
+		/**
+			getSize returns the size of the mapped file in bytes.
+		*/
+		size_t getSize() const { return m_size; }
+
+		/**
+			isOpen returns whether a file is currently mapped.
+		*/
+		bool isOpen() const { return m_data != nullptr; }
+
+		/**
+			getFileStamp reads the size and last modified time of a file.
+				Loaders use this to check if a cached file is out of date.
+
+				@param1 a_filename is the path of the file.
+
+				@param2 a_size is where the size of the file gets written.
+
+				@param3 a_modifiedTime is where the last write time gets written.
+
+				@return true if the file exists.
+		*/
+		static bool getFileStamp(const char* a_filename, unsigned long long& a_size, long long& a_modifiedTime);
+
+	private:
+
+		// Pointer to the start of the mapped file.
+		const unsigned char* m_data;
+
+		// Size of the mapping in bytes.
+		size_t m_size;
+
+#ifdef _WIN32
+		// The windows file handle.
+		void* m_file;
+
+		// The windows file mapping handle.
+		void* m_mapping;
+#else
+		// The posix file descriptor.
+		int m_fd;
+#endif
+	};
+}
@@ -0,0 +1,201 @@
+/**
+	MaterialTable.cpp
+
+	Purpose: MaterialTable.cpp is the source file for the MaterialTable
+			class. The MaterialTable packs the materials of many meshes
+			into one storage buffer of small parameter blocks, each
+			material once however many meshes and chunks use it, so
+			a draw picks its material by index.
+
+	@author Nathan Nette
+*/
+#include "MaterialTable.h"
+#include "GpuMemory.h"
+#include "OBJMesh.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sns
+{
+	MaterialTable::MaterialTable()
+		: m_buffer(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffer.
+	*/
+	MaterialTable::~MaterialTable()
+	{
+		clear();
+	}
+
+	/**
+		add finds the id of a mesh's material, adding it if no material
+			like it has been added.
+
+			@param1 a_mesh is the mesh.
+
+			@param2 a_materialID is the material in the mesh, or -1 for
+					the white, untextured one.
+
+			@param3 a_textures is where the material's textures are given
+					their layers.
+
+			@return the material's id.
+	*/
+	unsigned int MaterialTable::add(const aie::OBJMesh& a_mesh, int a_materialID, TextureArrays& a_textures)
+	{
+		Material material = { { glm::vec4(1), glm::vec4(1), glm::vec4(0, 0, 0, 1), glm::ivec4(-1) }, { -1, -1, -1 } };
+		if (a_materialID >= 0 && a_materialID < (int)a_mesh.getMaterialCount())
+		{
+			const aie::OBJMesh::Material& source = a_mesh.getMaterial(a_materialID);
+			material.block.ambient = glm::vec4(source.ambient, source.specularPower);
+			material.block.diffuse = glm::vec4(source.diffuse, source.opacity);
+			material.block.specular = glm::vec4(source.specular, 1);
+
+			aie::Texture* textures[TEXTURE_SLOTS] = { source.diffuseTexture.get(), source.specularTexture.get(),
+				source.normalTexture.get() };
+			for (unsigned int slot = 0; slot < TEXTURE_SLOTS; ++slot)
+			{
+				TextureArrays::Location location = a_textures.add(textures[slot]);
+				material.block.layers[slot] = location.layer;
+				material.arrays[slot] = location.array;
+			}
+		}
+
+		size_t key = hash(material);
+		auto range = m_lookup.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (isSame(m_materials[it->second], material))
+				return it->second;
+		}
+
+		unsigned int id = (unsigned int)m_materials.size();
+		m_materials.push_back(material);
+		m_lookup.emplace(key, id);
+		return id;
+	}
+
+	/**
+		sort orders the materials by their texture arrays, layers and
+			colours, giving them new ids.
+
+			@param1 a_remap is set to each old id's new one.
+	*/
+	void MaterialTable::sort(std::vector<unsigned int>& a_remap)
+	{
+		std::vector<unsigned int> order(m_materials.size());
+		for (unsigned int i = 0; i < (unsigned int)order.size(); ++i)
+			order[i] = i;
+
+		// The arrays are all that matters for batching, the layers and
+		//	colours after them keep materials like each other together.
+		std::sort(order.begin(), order.end(), [this](unsigned int a_a, unsigned int a_b)
+		{
+			const Material& a = m_materials[a_a];
+			const Material& b = m_materials[a_b];
+			for (unsigned int slot = 0; slot < TEXTURE_SLOTS; ++slot)
+			{
+				if (a.arrays[slot] != b.arrays[slot])
+					return a.arrays[slot] < b.arrays[slot];
+			}
+			for (unsigned int slot = 0; slot < TEXTURE_SLOTS; ++slot)
+			{
+				if (a.block.layers[slot] != b.block.layers[slot])
+					return a.block.layers[slot] < b.block.layers[slot];
+			}
+			return memcmp(&a.block, &b.block, sizeof(glm::vec4) * 3) < 0;
+		});
+
+		std::vector<Material> sorted;
+		sorted.reserve(m_materials.size());
+		a_remap.assign(m_materials.size(), 0);
+		m_lookup.clear();
+		for (unsigned int i = 0; i < (unsigned int)order.size(); ++i)
+		{
+			a_remap[order[i]] = i;
+			sorted.push_back(m_materials[order[i]]);
+			m_lookup.emplace(hash(sorted.back()), i);
+		}
+		m_materials.swap(sorted);
+	}
+
+	/**
+		upload writes the blocks to the storage buffer, replacing what was
+			there.
+	*/
+	void MaterialTable::upload()
+	{
+		if (m_buffer != 0)
+		{
+			glDeleteBuffers(1, &m_buffer);
+			RenderState::instance().onBufferDeleted(m_buffer);
+			GpuMemory::instance().releaseBuffer(m_buffer);
+			m_buffer = 0;
+		}
+		if (m_materials.empty())
+			return;
+
+		std::vector<Block> blocks;
+		blocks.reserve(m_materials.size());
+		for (const Material& material : m_materials)
+			blocks.push_back(material.block);
+
+		glGenBuffers(1, &m_buffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, blocks.size() * sizeof(Block), blocks.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		GpuMemory::instance().trackBuffer(m_buffer, blocks.size() * sizeof(Block), GpuMemory::MESHES, "MaterialTable");
+	}
+
+	/**
+		bind binds the storage buffer.
+
+			@param1 a_binding is the shader storage binding.
+	*/
+	void MaterialTable::bind(unsigned int a_binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, a_binding, m_buffer);
+	}
+
+	/**
+		clear deletes the buffer and forgets every material.
+	*/
+	void MaterialTable::clear()
+	{
+		if (m_buffer != 0)
+		{
+			glDeleteBuffers(1, &m_buffer);
+			RenderState::instance().onBufferDeleted(m_buffer);
+			GpuMemory::instance().releaseBuffer(m_buffer);
+			m_buffer = 0;
+		}
+		m_materials.clear();
+		m_lookup.clear();
+	}
+
+	/**
+		isSame returns whether two materials are the same, compared as
+			bytes.
+	*/
+	bool MaterialTable::isSame(const Material& a_a, const Material& a_b)
+	{
+		return memcmp(&a_a, &a_b, sizeof(Material)) == 0;
+	}
+
+	/**
+		hash returns an FNV-1a hash of a material's bytes.
+	*/
+	size_t MaterialTable::hash(const Material& a_material)
+	{
+		const unsigned char* bytes = (const unsigned char*)&a_material;
+		unsigned long long hash = 14695981039346656037ull;
+		for (size_t i = 0; i < sizeof(Material); ++i)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return (size_t)hash;
+	}
+}
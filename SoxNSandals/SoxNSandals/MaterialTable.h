@@ -0,0 +1,158 @@
+/**
+	MaterialTable.h
+
+	Purpose: MaterialTable.h is the header file for the MaterialTable
+			class. The MaterialTable packs the materials of many meshes
+			into one storage buffer of small parameter blocks, each
+			material once however many meshes and chunks use it, so
+			a draw picks its material by index.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "TextureArrays.h"
+#include <glm/vec4.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	/**
+		The MaterialTable class gives every distinct material added to it
+			an id. A material is its colours and the texture array layers
+			of its diffuse, specular and normal textures, so two meshes
+			loading the same material file share one, and chunks drawn
+			with it differ only by their instance's id.
+
+		sort orders the ids by texture arrays, then layers, then colours,
+			so materials sharing arrays are next to each other and a run
+			of ids can be drawn without rebinding anything. upload writes
+			the blocks to a std430 storage buffer, read as
+
+			struct Material
+			{
+				vec4 ambient;	// Ka and specular power
+				vec4 diffuse;	// Kd and opacity
+				vec4 specular;	// Ks
+				ivec4 layers;	// the texture layers, -1 for none
+			};
+
+			which needs GL 4.3, as the MeshBatch's multi-draws do.
+	*/
+	class MaterialTable
+	{
+	public:
+		// The texture slots a material has, diffuse, specular and normal.
+		static const unsigned int TEXTURE_SLOTS = 3;
+
+		/**
+			A material's parameters as the shaders read them, 64 bytes.
+		*/
+		struct Block
+		{
+			glm::vec4 ambient;
+			glm::vec4 diffuse;
+			glm::vec4 specular;
+			glm::ivec4 layers;
+		};
+
+		MaterialTable();
+
+		/**
+			The deconstructor deletes the buffer.
+		*/
+		~MaterialTable();
+
+		MaterialTable(const MaterialTable&) = delete;
+		MaterialTable& operator=(const MaterialTable&) = delete;
+
+		/**
+			add finds the id of a mesh's material, adding it if no
+				material like it has been added.
+
+				@param1 a_mesh is the mesh.
+
+				@param2 a_materialID is the material in the mesh, or -1 for
+						the white, untextured one chunks without a
+						material draw with.
+
+				@param3 a_textures is where the material's textures are
+						given their layers.
+
+				@return the material's id.
+		*/
+		unsigned int add(const aie::OBJMesh& a_mesh, int a_materialID, TextureArrays& a_textures);
+
+		/**
+			sort orders the materials by their texture arrays, layers and
+				colours, giving them new ids.
+
+				@param1 a_remap is set to each old id's new one.
+		*/
+		void sort(std::vector<unsigned int>& a_remap);
+
+		/**
+			upload writes the blocks to the storage buffer, replacing what
+				was there.
+		*/
+		void upload();
+
+		/**
+			bind binds the storage buffer.
+
+				@param1 a_binding is the shader storage binding.
+		*/
+		void bind(unsigned int a_binding) const;
+
+		/**
+			getArrays returns the texture arrays of a material's slots, -1
+				for none.
+
+				@param1 a_id is the material.
+		*/
+		const int* getArrays(unsigned int a_id) const { return m_materials[a_id].arrays; }
+
+		/**
+			getBlock returns a material's parameters.
+
+				@param1 a_id is the material.
+		*/
+		const Block& getBlock(unsigned int a_id) const { return m_materials[a_id].block; }
+
+		/**
+			getCount returns how many distinct materials were added.
+		*/
+		unsigned int getCount() const { return (unsigned int)m_materials.size(); }
+
+		/**
+			clear deletes the buffer and forgets every material.
+		*/
+		void clear();
+
+	private:
+		// A material, its block and the arrays its layers are in.
+		struct Material
+		{
+			Block block;
+			int arrays[TEXTURE_SLOTS];
+		};
+
+		// Whether two materials are the same, compared as bytes.
+		static bool isSame(const Material& a_a, const Material& a_b);
+
+		// A hash of a material's bytes.
+		static size_t hash(const Material& a_material);
+
+		std::vector<Material> m_materials;
+
+		// The ids of the materials with each hash.
+		std::unordered_multimap<size_t, unsigned int> m_lookup;
+
+		unsigned int m_buffer;
+	};
+}
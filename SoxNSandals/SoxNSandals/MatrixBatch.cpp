@@ -0,0 +1,389 @@
+/**
+	MatrixBatch.cpp
+
+	Purpose: MatrixBatch.cpp is the source file for the batch matrix
+			functions. They multiply, invert and transform by whole
+			arrays of glm matrices at once with SSE, or AVX when it is
+			built for, rather than one glm operation at a time.
+
+	@author Nathan Nette
+*/
+#include "MatrixBatch.h"
+#include <glm/matrix.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_MATRIX_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(SNS_MATRIX_SSE) && defined(__AVX__)
+#define SNS_MATRIX_AVX
+#include <immintrin.h>
+#endif
+
+// The kernels read and write glm's matrices as packed floats.
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "glm::mat4 isn't 16 packed floats");
+static_assert(sizeof(glm::mat3) == 9 * sizeof(float), "glm::mat3 isn't 9 packed floats");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 isn't 3 packed floats");
+
+namespace sns
+{
+#ifdef SNS_MATRIX_SSE
+	// Multiplies a matrix's columns, already loaded, by one on its right.
+	static inline void multiply(const __m128 a_left[4], const float* a_right, float* a_result)
+	{
+#ifdef SNS_MATRIX_AVX
+		// Two columns of the product at a time, each half of the register
+		//	a column of the right matrix's.
+		__m256 left[4];
+		for (int k = 0; k < 4; ++k)
+		{
+			left[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(a_left[k]), a_left[k], 1);
+		}
+
+		__m256 right0 = _mm256_loadu_ps(a_right);
+		__m256 right1 = _mm256_loadu_ps(a_right + 8);
+
+		__m256 result0 = _mm256_mul_ps(left[0], _mm256_permute_ps(right0, 0x00));
+		result0 = _mm256_add_ps(result0, _mm256_mul_ps(left[1], _mm256_permute_ps(right0, 0x55)));
+		result0 = _mm256_add_ps(result0, _mm256_mul_ps(left[2], _mm256_permute_ps(right0, 0xaa)));
+		result0 = _mm256_add_ps(result0, _mm256_mul_ps(left[3], _mm256_permute_ps(right0, 0xff)));
+
+		__m256 result1 = _mm256_mul_ps(left[0], _mm256_permute_ps(right1, 0x00));
+		result1 = _mm256_add_ps(result1, _mm256_mul_ps(left[1], _mm256_permute_ps(right1, 0x55)));
+		result1 = _mm256_add_ps(result1, _mm256_mul_ps(left[2], _mm256_permute_ps(right1, 0xaa)));
+		result1 = _mm256_add_ps(result1, _mm256_mul_ps(left[3], _mm256_permute_ps(right1, 0xff)));
+
+		_mm256_storeu_ps(a_result, result0);
+		_mm256_storeu_ps(a_result + 8, result1);
+#else
+		// Every column of the product is the left matrix's columns
+		//	weighted by a column of the right's.
+		__m128 columns[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			__m128 right = _mm_loadu_ps(a_right + j * 4);
+			__m128 column = _mm_mul_ps(a_left[0], _mm_shuffle_ps(right, right, _MM_SHUFFLE(0, 0, 0, 0)));
+			column = _mm_add_ps(column, _mm_mul_ps(a_left[1], _mm_shuffle_ps(right, right, _MM_SHUFFLE(1, 1, 1, 1))));
+			column = _mm_add_ps(column, _mm_mul_ps(a_left[2], _mm_shuffle_ps(right, right, _MM_SHUFFLE(2, 2, 2, 2))));
+			column = _mm_add_ps(column, _mm_mul_ps(a_left[3], _mm_shuffle_ps(right, right, _MM_SHUFFLE(3, 3, 3, 3))));
+			columns[j] = column;
+		}
+
+		// Stored after every column is read, so the result can be the
+		//	right matrix.
+		for (int j = 0; j < 4; ++j)
+		{
+			_mm_storeu_ps(a_result + j * 4, columns[j]);
+		}
+#endif
+	}
+
+	// Loads the columns of four matrices' 3 by 3 parts and transposes
+	//	them, so a_x[c] has the four matrices' column c x, a_y[c] the y
+	//	and a_z[c] the z. a_w[c] is the columns' w, for the translation.
+	static inline void loadTransposed(const glm::mat4* a_matrices, __m128 a_x[4], __m128 a_y[4], __m128 a_z[4],
+		__m128 a_w[4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			__m128 m0 = _mm_loadu_ps(&a_matrices[0][c][0]);
+			__m128 m1 = _mm_loadu_ps(&a_matrices[1][c][0]);
+			__m128 m2 = _mm_loadu_ps(&a_matrices[2][c][0]);
+			__m128 m3 = _mm_loadu_ps(&a_matrices[3][c][0]);
+			_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+			a_x[c] = m0;
+			a_y[c] = m1;
+			a_z[c] = m2;
+			a_w[c] = m3;
+		}
+	}
+
+	// Finds the rows of four 3 by 3 inverses, row r's components in
+	//	a_row[r][0..2], by the cross products of the columns over the
+	//	determinant.
+	static inline void invert3x3(const __m128 a_x[4], const __m128 a_y[4], const __m128 a_z[4], __m128 a_row[3][3])
+	{
+		// c1 x c2, c2 x c0 and c0 x c1.
+		for (int r = 0; r < 3; ++r)
+		{
+			int a = (r + 1) % 3;
+			int b = (r + 2) % 3;
+			a_row[r][0] = _mm_sub_ps(_mm_mul_ps(a_y[a], a_z[b]), _mm_mul_ps(a_z[a], a_y[b]));
+			a_row[r][1] = _mm_sub_ps(_mm_mul_ps(a_z[a], a_x[b]), _mm_mul_ps(a_x[a], a_z[b]));
+			a_row[r][2] = _mm_sub_ps(_mm_mul_ps(a_x[a], a_y[b]), _mm_mul_ps(a_y[a], a_x[b]));
+		}
+
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a_x[0], a_row[0][0]),
+			_mm_mul_ps(a_y[0], a_row[0][1])), _mm_mul_ps(a_z[0], a_row[0][2]));
+		__m128 reciprocal = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				a_row[r][i] = _mm_mul_ps(a_row[r][i], reciprocal);
+			}
+		}
+	}
+#endif
+
+	/**
+		multiplyMatrices multiplies matrices pair by pair, a_result[i] =
+			a_left[i] * a_right[i].
+
+			@param1 a_left is the matrices on the left.
+
+			@param2 a_right is the matrices on the right.
+
+			@param3 a_result is given the products.
+
+			@param4 a_count is how many pairs there are.
+	*/
+	void multiplyMatrices(const glm::mat4* a_left, const glm::mat4* a_right, glm::mat4* a_result, size_t a_count)
+	{
+#ifdef SNS_MATRIX_SSE
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			__m128 left[4];
+			for (int k = 0; k < 4; ++k)
+			{
+				left[k] = _mm_loadu_ps(&a_left[i][k][0]);
+			}
+			multiply(left, &a_right[i][0][0], &a_result[i][0][0]);
+		}
+#else
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			a_result[i] = a_left[i] * a_right[i];
+		}
+#endif
+	}
+
+	/**
+		multiplyMatrices multiplies an array of matrices by one on their
+			left, a_result[i] = a_left * a_right[i], like a projection
+			view by every model.
+
+			@param1 a_left is the matrix on the left.
+
+			@param2 a_right is the matrices on the right.
+
+			@param3 a_result is given the products.
+
+			@param4 a_count is how many there are.
+	*/
+	void multiplyMatrices(const glm::mat4& a_left, const glm::mat4* a_right, glm::mat4* a_result, size_t a_count)
+	{
+#ifdef SNS_MATRIX_SSE
+		// The left matrix is loaded once, and may be one of the results.
+		__m128 left[4];
+		for (int k = 0; k < 4; ++k)
+		{
+			left[k] = _mm_loadu_ps(&a_left[k][0]);
+		}
+
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			multiply(left, &a_right[i][0][0], &a_result[i][0][0]);
+		}
+#else
+		glm::mat4 left = a_left;
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			a_result[i] = left * a_right[i];
+		}
+#endif
+	}
+
+	/**
+		invertAffine inverts matrices whose bottom row is 0, 0, 0, 1, four
+			at a time, faster than glm::inverse as only the 3 by 3 part
+			needs inverting.
+
+			@param1 a_matrices is the matrices.
+
+			@param2 a_result is given their inverses.
+
+			@param3 a_count is how many there are.
+	*/
+	void invertAffine(const glm::mat4* a_matrices, glm::mat4* a_result, size_t a_count)
+	{
+		size_t i = 0;
+
+#ifdef SNS_MATRIX_SSE
+		for (; i + 4 <= a_count; i += 4)
+		{
+			__m128 x[4], y[4], z[4], w[4];
+			loadTransposed(&a_matrices[i], x, y, z, w);
+
+			__m128 row[3][3];
+			invert3x3(x, y, z, row);
+
+			// The inverse's translation is the inverse 3 by 3 by the
+			//	translation, negated.
+			__m128 translation[3];
+			for (int r = 0; r < 3; ++r)
+			{
+				translation[r] = _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(row[r][0], x[3]), _mm_mul_ps(row[r][1], y[3])), _mm_mul_ps(row[r][2], z[3])));
+			}
+
+			// Each matrix's column c of the inverse is the c'th component
+			//	of its rows, (row0[c], row1[c], row2[c], 0), transposed
+			//	back from the four matrices' lanes.
+			__m128 zero = _mm_setzero_ps();
+			__m128 one = _mm_set1_ps(1.0f);
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 m0 = c < 3 ? row[0][c] : translation[0];
+				__m128 m1 = c < 3 ? row[1][c] : translation[1];
+				__m128 m2 = c < 3 ? row[2][c] : translation[2];
+				__m128 m3 = c < 3 ? zero : one;
+				_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+				_mm_storeu_ps(&a_result[i + 0][c][0], m0);
+				_mm_storeu_ps(&a_result[i + 1][c][0], m1);
+				_mm_storeu_ps(&a_result[i + 2][c][0], m2);
+				_mm_storeu_ps(&a_result[i + 3][c][0], m3);
+			}
+		}
+#endif
+
+		// Whatever is left over, or everything without SSE.
+		for (; i < a_count; ++i)
+		{
+			glm::mat3 inverse = glm::inverse(glm::mat3(a_matrices[i]));
+			glm::vec3 translation = -(inverse * glm::vec3(a_matrices[i][3]));
+			a_result[i] = glm::mat4(inverse);
+			a_result[i][3] = glm::vec4(translation, 1.0f);
+		}
+	}
+
+	/**
+		computeNormalMatrices finds the matrix each model's normals are
+			transformed by, the inverse transpose of its 3 by 3 part,
+			four at a time.
+
+			@param1 a_models is the models.
+
+			@param2 a_result is given their normal matrices.
+
+			@param3 a_count is how many there are.
+	*/
+	void computeNormalMatrices(const glm::mat4* a_models, glm::mat3* a_result, size_t a_count)
+	{
+		size_t i = 0;
+
+#ifdef SNS_MATRIX_SSE
+		for (; i + 4 <= a_count; i += 4)
+		{
+			__m128 x[4], y[4], z[4], w[4];
+			loadTransposed(&a_models[i], x, y, z, w);
+
+			__m128 row[3][3];
+			invert3x3(x, y, z, row);
+
+			// The inverse's transpose has the inverse's rows as its
+			//	columns. A column is 3 floats, so each is stored through
+			//	a temporary rather than writing past the matrix.
+			__m128 zero = _mm_setzero_ps();
+			for (int c = 0; c < 3; ++c)
+			{
+				__m128 m0 = row[c][0];
+				__m128 m1 = row[c][1];
+				__m128 m2 = row[c][2];
+				__m128 m3 = zero;
+				_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+
+				float columns[4][4];
+				_mm_storeu_ps(columns[0], m0);
+				_mm_storeu_ps(columns[1], m1);
+				_mm_storeu_ps(columns[2], m2);
+				_mm_storeu_ps(columns[3], m3);
+				for (int m = 0; m < 4; ++m)
+				{
+					a_result[i + m][c] = glm::vec3(columns[m][0], columns[m][1], columns[m][2]);
+				}
+			}
+		}
+#endif
+
+		for (; i < a_count; ++i)
+		{
+			a_result[i] = glm::transpose(glm::inverse(glm::mat3(a_models[i])));
+		}
+	}
+
+	/**
+		transformPoints transforms points by an affine matrix, four at a
+			time.
+
+			@param1 a_matrix is the matrix, its bottom row 0, 0, 0, 1.
+
+			@param2 a_points is the points.
+
+			@param3 a_result is given the transformed points.
+
+			@param4 a_count is how many there are.
+	*/
+	void transformPoints(const glm::mat4& a_matrix, const glm::vec3* a_points, glm::vec3* a_result, size_t a_count)
+	{
+		size_t i = 0;
+
+#ifdef SNS_MATRIX_SSE
+		__m128 m[4][3];
+		for (int c = 0; c < 4; ++c)
+		{
+			for (int r = 0; r < 3; ++r)
+			{
+				m[c][r] = _mm_set1_ps(a_matrix[c][r]);
+			}
+		}
+
+		for (; i + 4 <= a_count; i += 4)
+		{
+			// Four points are 12 floats, x0 y0 z0 x1 | y1 z1 x2 y2 |
+			//	z2 x3 y3 z3, shuffled into the xs, ys and zs.
+			const float* points = &a_points[i].x;
+			__m128 v0 = _mm_loadu_ps(points);
+			__m128 v1 = _mm_loadu_ps(points + 4);
+			__m128 v2 = _mm_loadu_ps(points + 8);
+
+			__m128 x0x1y1y2 = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 0, 3, 0));
+			__m128 x2y2x3y3 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 1, 3, 2));
+			__m128 x = _mm_shuffle_ps(x0x1y1y2, x2y2x3y3, _MM_SHUFFLE(2, 0, 1, 0));
+			__m128 y0y0y1y1 = _mm_shuffle_ps(v0, x0x1y1y2, _MM_SHUFFLE(2, 2, 1, 1));
+			__m128 y = _mm_shuffle_ps(y0y0y1y1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+			__m128 z0z0z1z1 = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2));
+			__m128 z2z2z3z3 = _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 0, 0));
+			__m128 z = _mm_shuffle_ps(z0z0z1z1, z2z2z3z3, _MM_SHUFFLE(2, 0, 2, 0));
+
+			__m128 out[3];
+			for (int r = 0; r < 3; ++r)
+			{
+				out[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][r], x), _mm_mul_ps(m[1][r], y)),
+					_mm_add_ps(_mm_mul_ps(m[2][r], z), m[3][r]));
+			}
+
+			// And back again.
+			const int pick = _MM_SHUFFLE(2, 0, 2, 0);
+			__m128 o0 = _mm_shuffle_ps(_mm_shuffle_ps(out[0], out[1], _MM_SHUFFLE(0, 0, 0, 0)),
+				_mm_shuffle_ps(out[2], out[0], _MM_SHUFFLE(1, 1, 0, 0)), pick);
+			__m128 o1 = _mm_shuffle_ps(_mm_shuffle_ps(out[1], out[2], _MM_SHUFFLE(1, 1, 1, 1)),
+				_mm_shuffle_ps(out[0], out[1], _MM_SHUFFLE(2, 2, 2, 2)), pick);
+			__m128 o2 = _mm_shuffle_ps(_mm_shuffle_ps(out[2], out[0], _MM_SHUFFLE(3, 3, 2, 2)),
+				_mm_shuffle_ps(out[1], out[2], _MM_SHUFFLE(3, 3, 3, 3)), pick);
+
+			float* result = &a_result[i].x;
+			_mm_storeu_ps(result, o0);
+			_mm_storeu_ps(result + 4, o1);
+			_mm_storeu_ps(result + 8, o2);
+		}
+#endif
+
+		for (; i < a_count; ++i)
+		{
+			a_result[i] = glm::vec3(a_matrix * glm::vec4(a_points[i], 1.0f));
+		}
+	}
+}
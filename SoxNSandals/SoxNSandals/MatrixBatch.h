@@ -0,0 +1,96 @@
+/**
+	MatrixBatch.h
+
+	Purpose: MatrixBatch.h is the header file for the batch matrix
+			functions. They multiply, invert and transform by whole
+			arrays of glm matrices at once with SSE, or AVX when it is
+			built for, rather than one glm operation at a time.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <cstddef>
+
+/*
+	Without SSE every function is glm's scalar code. Products use AVX,
+		two columns of a product an instruction, when the project is
+		built with /arch:AVX or /arch:AVX2, which define __AVX__.
+
+	Results may be the same array as an input, but must not overlap it
+		any other way.
+*/
+
+namespace sns
+{
+	/**
+		multiplyMatrices multiplies matrices pair by pair, a_result[i] =
+			a_left[i] * a_right[i].
+
+			@param1 a_left is the matrices on the left.
+
+			@param2 a_right is the matrices on the right.
+
+			@param3 a_result is given the products.
+
+			@param4 a_count is how many pairs there are.
+	*/
+	void multiplyMatrices(const glm::mat4* a_left, const glm::mat4* a_right, glm::mat4* a_result, size_t a_count);
+
+	/**
+		multiplyMatrices multiplies an array of matrices by one on their
+			left, a_result[i] = a_left * a_right[i], like a projection
+			view by every model.
+
+			@param1 a_left is the matrix on the left.
+
+			@param2 a_right is the matrices on the right.
+
+			@param3 a_result is given the products.
+
+			@param4 a_count is how many there are.
+	*/
+	void multiplyMatrices(const glm::mat4& a_left, const glm::mat4* a_right, glm::mat4* a_result, size_t a_count);
+
+	/**
+		invertAffine inverts matrices whose bottom row is 0, 0, 0, 1, four
+			at a time, faster than glm::inverse as only the 3 by 3 part
+			needs inverting.
+
+			@param1 a_matrices is the matrices.
+
+			@param2 a_result is given their inverses.
+
+			@param3 a_count is how many there are.
+	*/
+	void invertAffine(const glm::mat4* a_matrices, glm::mat4* a_result, size_t a_count);
+
+	/**
+		computeNormalMatrices finds the matrix each model's normals are
+			transformed by, the inverse transpose of its 3 by 3 part,
+			four at a time.
+
+			@param1 a_models is the models.
+
+			@param2 a_result is given their normal matrices.
+
+			@param3 a_count is how many there are.
+	*/
+	void computeNormalMatrices(const glm::mat4* a_models, glm::mat3* a_result, size_t a_count);
+
+	/**
+		transformPoints transforms points by an affine matrix, four at a
+			time.
+
+			@param1 a_matrix is the matrix, its bottom row 0, 0, 0, 1.
+
+			@param2 a_points is the points.
+
+			@param3 a_result is given the transformed points.
+
+			@param4 a_count is how many there are.
+	*/
+	void transformPoints(const glm::mat4& a_matrix, const glm::vec3* a_points, glm::vec3* a_result, size_t a_count);
+}
@@ -1,14 +1,29 @@
 #include "Mesh.h"
+#include "GpuMemory.h"
+#include "Primitives.h"
+#include "RenderState.h"
+#include "VertexArrays.h"
+#include "VertexLayout.h"
 #include "gl_core_4_5.h"
 #include <vector>
 
 
+// the handles delete the vertex array and buffers
 Mesh::~Mesh()
 {
+}
+
+// where each part of a vertex is, for both ways of setting up a vertex array
+static constexpr sns::VertexLayout VERTEX_LAYOUT = sns::makeVertexLayout<Mesh::Vertex>(
+	SNS_VERTEX_ATTRIBUTE(Mesh::Vertex, position, 0, FLOAT4),
+	SNS_VERTEX_ATTRIBUTE(Mesh::Vertex, normal, 1, FLOAT4),
+	SNS_VERTEX_ATTRIBUTE(Mesh::Vertex, texCoord, 2, FLOAT2));
+static_assert(sns::isValidLayout(VERTEX_LAYOUT), "Mesh::Vertex layout is invalid");
 
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &ibo);
+// the format of the vertex array every mesh shares
+static void meshVertexFormat(unsigned int vao)
+{
+	sns::setVertexArrayFormat(vao, sns::VertexArrays::VERTEX_BINDING, VERTEX_LAYOUT);
 }
 
 void Mesh::initialise(unsigned int vertexCount,
@@ -18,55 +33,76 @@ void Mesh::initialise(unsigned int vertexCount,
 {
 	assert(vao == 0);
 
+	// halve the indices when the vertices fit 16 bits
+	std::vector<unsigned short> shortIndices;
+	const void* indexData = indices;
+	size_t indexSize = sizeof(unsigned int);
+	if (indexCount != 0)
+	{
+		indexType = GL_UNSIGNED_INT;
+		if (vertexCount <= 65536)
+		{
+			shortIndices.assign(indices, indices + indexCount);
+			indexData = shortIndices.data();
+			indexSize = sizeof(unsigned short);
+			indexType = GL_UNSIGNED_SHORT;
+		}
+		triCount = indexCount / 3;
+	}
+	else
+		triCount = vertexCount / 3;
+
+	// gl 4.5 fills immutable buffers by handle, so nothing has to be
+	// bound, and the mesh is drawn through the shared vertex array
+	// instead of making its own
+	if (sns::VertexArrays::isSupported())
+	{
+		glCreateBuffers(1, vbo.put());
+		glNamedBufferStorage(vbo, vertexCount * sizeof(Vertex), vertices, 0);
+
+		if (indexCount != 0)
+		{
+			glCreateBuffers(1, ibo.put());
+			glNamedBufferStorage(ibo, indexCount * indexSize, indexData, 0);
+		}
+		sns::GpuMemory::instance().trackBuffer(vbo, vertexCount * sizeof(Vertex), sns::GpuMemory::MESHES, "Mesh");
+		sns::GpuMemory::instance().trackBuffer(ibo, indexCount * indexSize, sns::GpuMemory::MESHES, "Mesh");
+		return;
+	}
+
 	// generate buffers
-	glGenBuffers(1, &vbo);
-	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, vbo.put());
+	glGenVertexArrays(1, vao.put());
 
 	// bind vertex array aka a mesh wrapper
-	glBindVertexArray(vao);
+	sns::RenderState::instance().bindVertexArray(vao);
 
 	// bind vertex buffer
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, vbo);
 
 	// fill vertex buffer
 	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex),
 		vertices, GL_STATIC_DRAW);
 
-	// enable first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE,
-		sizeof(Vertex), 0);
-
-	// enable second element as normal
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE,
-		sizeof(Vertex), (void*)16);
-
-	// enable third element as texture
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-		sizeof(Vertex), (void*)32);
+	// enable the position, normal and texture coordinate
+	sns::setVertexAttributes(VERTEX_LAYOUT);
 
 	// bind indices if there are any
 	if (indexCount != 0)
 	{
-		glGenBuffers(1, &ibo);
-		// bind vertex buffer
-
+		glGenBuffers(1, ibo.put());
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-		// fill vertex buffer
-
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-			indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
-		triCount = indexCount / 3;
+			indexCount * indexSize, indexData, GL_STATIC_DRAW);
 	}
-	else
-		triCount = vertexCount / 3;
 
 	// unbind buffers
-	glBindVertexArray(0);
+	sns::RenderState::instance().bindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+
+	sns::GpuMemory::instance().trackBuffer(vbo, vertexCount * sizeof(Vertex), sns::GpuMemory::MESHES, "Mesh");
+	sns::GpuMemory::instance().trackBuffer(ibo, indexCount * indexSize, sns::GpuMemory::MESHES, "Mesh");
 }
 
 void Mesh::initialiseQuad()
@@ -74,16 +110,6 @@ void Mesh::initialiseQuad()
 	// check that the mesh is not initialized already
 	assert(vao == 0);
 
-	// generate buffers
-	glGenBuffers(1, &vbo);
-	glGenVertexArrays(1, &vao);
-
-	// bind vertex array aka a mesh wrapper
-	glBindVertexArray(vao);
-
-	// bind vertex buffer
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
 	// define 6 vertices for 2 triangles
 	Vertex vertices[6];
 	vertices[0].position = { -0.5f, 0, 0.5f, 1 };
@@ -108,111 +134,64 @@ void Mesh::initialiseQuad()
 	vertices[4].normal = { 0, 1, 0, 0, };
 	vertices[5].normal = { 0, 1, 0, 0, };
 
+	// the quad's 2 triangles go through the same path as any other mesh
+	initialise(6, vertices);
+}
 
-	// fill vertex buffer
-	glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(Vertex),
-		vertices, GL_STATIC_DRAW);
-
-	// enable first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE,
-		sizeof(Vertex), 0);
-
-	// enable second element as normal
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE,
-		sizeof(Vertex), (void*)16);
+// the primitives are built into vectors, then go through initialise
+void Mesh::initialisePlane(unsigned int columns, unsigned int rows)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	sns::Primitives::buildPlane(columns, rows, vertices, indices);
+	initialise((unsigned int)vertices.size(), vertices.data(), (unsigned int)indices.size(), indices.data());
+}
 
-	// enable third element as texture
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-		sizeof(Vertex), (void*)32);
+void Mesh::initialiseSphere(unsigned int rows, unsigned int columns)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	sns::Primitives::buildSphere(rows, columns, vertices, indices);
+	initialise((unsigned int)vertices.size(), vertices.data(), (unsigned int)indices.size(), indices.data());
+}
 
-	// unbind buffers
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+void Mesh::initialiseCylinder(unsigned int segments)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	sns::Primitives::buildCylinder(segments, vertices, indices);
+	initialise((unsigned int)vertices.size(), vertices.data(), (unsigned int)indices.size(), indices.data());
+}
 
-	// quad has 2 triangles
-	triCount = 2;
+void Mesh::initialiseTorus(float tubeRadius, unsigned int rings, unsigned int sides)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	sns::Primitives::buildTorus(tubeRadius, rings, sides, vertices, indices);
+	initialise((unsigned int)vertices.size(), vertices.data(), (unsigned int)indices.size(), indices.data());
 }
 
-//void Mesh::initialiseCircle(const glm::vec3 & center, float radius, unsigned int segments)
-//{
-//	// ensure that I have put in a transform.
-//	//assert(transform != nullptr);
-//
-//	assert(&center != nullptr);
-//	assert(radius != 0);
-//	assert(segments != 0);
-//
-//
-//	float segmentSize = (2 * glm::pi<float>()) / segments;
-//	unsigned int vertexCount = segments + 1;
-//	std::vector<Vertex> vertVec;
-//	Vertex midPoint;
-//	midPoint.position = glm::vec4(center.x, center.y, 0.0f, 0.0f);
-//	vertVec.push_back(midPoint);
-//
-//	float angle = 0;
-//	for (int i = 0;i < segmentSize; angle += segmentSize, i++)
-//	{
-//		glm::vec4 segmentDirection = glm::vec4(sinf(i * segmentSize), 0, cosf(i * segmentSize), 0);
-//
-//		Vertex vert;
-//		vert.position = glm::vec4(center, 1) + (segmentDirection * radius);
-//		vertVec.push_back(vert);
-//
-//
-//		// calculates the two outer verts
-//		//glm::vec2 outerVec1(sinf(i * segmentSize) * radius, cosf(i * segmentSize) * radius);
-//		//glm::vec2 outerVec2(sinf((i + 1) * segmentSize) * radius, cosf((i + 1) * segmentSize) * radius);
-//		//
-//		//// if transform is not nullptr
-//		//if (transform != nullptr)
-//		//{
-//		//	
-//		//	outerVec1 = glm::vec2((*transform * glm::vec4(outerVec1, 0, 0)));
-//		//	outerVec2 = glm::vec2((*transform * glm::vec4(outerVec2, 0, 0)));
-//		//}
-//		//
-//		//// assigns the vertices into the vector.
-//		//vertVec[i].position = glm::vec4(outerVec1.x, outerVec1.y, 0.0f, 0.0f);
-//		//vertVec[i+1].position = glm::vec4(outerVec2.x, outerVec2.y, 0.0f, 0.0f);
-//	}
-//
-//	// todo: figure out how to get the vertices into an array so that i can use them in the index buffer.
-//
-//	// use a vector.data for the size of the indices
-//
-//	std::vector<unsigned int> indices;
-//
-//	for (unsigned int i = 1; i < segments; i++)
-//	{
-//		// 012, 023, 034, 045, 056.
-//		indices.push_back(0);
-//		indices.push_back(i);
-//		indices.push_back(i + 1);
-//	}
-//
-//	initialise(vertexCount, vertVec.data(), segments, indices.data());
-//
-//}
-
-//void Mesh::initialiseCylinder(glm::vec3 & center, float radius, float height, unsigned int segments, glm::mat4* transform)
-//{
-//	glm::vec3 tmpCenter = transform != nullptr ? glm::vec3((*transform)[3]) + center : center;
-//
-//
-//}
+void Mesh::initialiseBox()
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	sns::Primitives::buildBox(vertices, indices);
+	initialise((unsigned int)vertices.size(), vertices.data(), (unsigned int)indices.size(), indices.data());
+}
 
 void Mesh::draw()
 {
-	glBindVertexArray(vao);
+	// without a vertex array of its own the buffers go on the shared one
+	if (vao != 0)
+		sns::RenderState::instance().bindVertexArray(vao);
+	else
+		sns::VertexArrays::instance().bind(meshVertexFormat, vbo, sizeof(Vertex), ibo);
 
 	// using indices or just vertices?
+	sns::RenderState::instance().countDraw();
 	if (ibo != 0)
 		glDrawElements(GL_TRIANGLES, 3 * triCount,
-			GL_UNSIGNED_INT, 0);
+			indexType, 0);
 	else
 		glDrawArrays(GL_TRIANGLES, 0, 3 * triCount);
 }
\ No newline at end of file
@@ -6,15 +6,22 @@
 */
 #pragma once
 #include "soxCore.h"
+#include "GpuHandle.h"
 #include <glm.hpp>
 
 class Mesh
 {
 public:
 
-	Mesh() : triCount(0), vao(0), vbo(0), ibo(0) {}
+	Mesh() : triCount(0), indexType(0) {}
 	virtual ~Mesh();
 
+	// the handles delete the gl objects, so a mesh is moved instead of copied
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+
 	struct Vertex
 	{
 		glm::vec4 position;
@@ -27,18 +34,27 @@ public:
 		unsigned int* indices = nullptr);
 
 	void initialiseQuad();
-	//void initialiseCircle(const glm::vec3 & center, float radius, unsigned int segments);
-	//void initialiseCylinder(glm::vec3& center, float radius, float height, unsigned int segments, glm::mat4* transform);
-	
+
+	// the shapes sns::Primitives builds, at its unit sizes. meshes wanted
+	// more than once are better shared through sns::Primitives::instance()
+	void initialisePlane(unsigned int columns, unsigned int rows);
+	void initialiseSphere(unsigned int rows, unsigned int columns);
+	void initialiseCylinder(unsigned int segments);
+	void initialiseTorus(float tubeRadius, unsigned int rings, unsigned int sides);
+	void initialiseBox();
+
 
 	virtual void draw();
 
 protected:
 
 	unsigned int triCount;
-	unsigned int vao;
-	unsigned int vbo;
-	unsigned int ibo;
+	sns::VertexArrayHandle vao;
+	sns::BufferHandle vbo;
+	sns::BufferHandle ibo;
+
+	// GL_UNSIGNED_SHORT when every vertex fits in 16 bits, else GL_UNSIGNED_INT
+	unsigned int indexType;
 
 	Vertex* vertices = nullptr;
 };
\ No newline at end of file
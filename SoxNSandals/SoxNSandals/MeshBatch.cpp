@@ -0,0 +1,942 @@
+/**
+	MeshBatch.cpp
+
+	Purpose: MeshBatch.cpp is the source file for the MeshBatch class.
+			The MeshBatch packs many static meshes into one vertex and
+			index buffer and draws all of them with a few multi-draw
+			indirect calls, instead of a draw per chunk.
+
+	@author Nathan Nette
+*/
+#include "MeshBatch.h"
+#include "GpuMemory.h"
+#include "GpuReadback.h"
+#include "MatrixBatch.h"
+#include "MeshOptimiser.h"
+#include "OBJMesh.h"
+#include "RenderState.h"
+#include <glfw3.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// Must match local_size_x in the cull shader.
+	static const unsigned int CLUSTER_GROUP_SIZE = 64;
+
+	// The buffer bindings the cull shader reads and writes.
+	static const unsigned int CLUSTER_BINDING = 0;
+	static const unsigned int INSTANCE_BINDING = 1;
+	static const unsigned int COMMAND_BINDING = 2;
+	static const unsigned int COUNTER_BINDING = 3;
+
+	// The unit the cull shader reads the HiZBuffer from, above every unit
+	//	OBJMesh binds materials to.
+	static const unsigned int HIZ_UNIT = 7;
+
+	// Must match local_size_x in the task shader, and the meshlets each
+	//	of its workgroups can keep.
+	static const unsigned int TASK_GROUP_SIZE = 32;
+
+	// The buffer bindings the mesh shader reads as well as the clusters
+	//	and instances, clear of the material blocks and the ObjectBuffer.
+	static const unsigned int MESHLET_BINDING = 2;
+	static const unsigned int MESHLET_VERTEX_BINDING = 3;
+	static const unsigned int MESHLET_TRIANGLE_BINDING = 6;
+	static const unsigned int VERTEX_BINDING = 7;
+
+	// glDrawMeshTasksNV, which gl_core_4_5 doesn't load.
+	typedef void (CODEGEN_FUNCPTR* DrawMeshTasksFunction)(GLuint first, GLuint count);
+	static DrawMeshTasksFunction s_drawMeshTasks = nullptr;
+
+	MeshBatch::MeshBatch()
+		: m_vao(0),
+		m_vertexBuffer(0),
+		m_indexBuffer(0),
+		m_indexType(0),
+		m_instanceBuffer(0),
+		m_clusterBuffer(0),
+		m_clusterCommands(0),
+		m_clusterCount(0),
+		m_clusterCulling(true),
+		m_meshletBuffer(0),
+		m_meshletVertices(0),
+		m_meshletTriangles(0),
+		m_meshShading(true),
+		m_cullProjectionView(1.0f),
+		m_cullPlanes(),
+		m_cullPosition(0.0f),
+		m_cullHiZ(nullptr),
+		m_counterBuffer(0),
+		m_clusterCounts(),
+		m_occluderCommands(0),
+		m_occluderCount(0),
+		m_chunkCommands(0),
+		m_firstCommand(0),
+		m_culled(false),
+		m_fenced(false),
+		m_built(false),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffers.
+	*/
+	MeshBatch::~MeshBatch()
+	{
+		destroy();
+	}
+
+	/**
+		add places a mesh in the batch. Nothing is copied until build.
+
+			@param1 a_mesh is an uploaded mesh, it must outlive the batch.
+					Meshes in a different vertex format to the first
+					one added are refused.
+
+			@param2 a_shader is the program to draw it with.
+
+			@param3 a_transform is where it is placed in the world.
+
+			@param4 a_occluder is whether drawOccluders draws it.
+
+			@param5 a_alphaTested is whether its materials cut holes with
+					the diffuse alpha.
+	*/
+	void MeshBatch::add(const aie::OBJMesh* a_mesh, aie::ShaderProgram* a_shader, const glm::mat4& a_transform,
+		bool a_occluder, bool a_alphaTested)
+	{
+		// One vertex array reads the shared buffer, so it has one layout.
+		if (m_entries.empty() == false && a_mesh->getVertexFormat() != m_entries[0].mesh->getVertexFormat())
+		{
+			printf("MeshBatch: %s has a different vertex format to the batch\n", a_mesh->getFilename().c_str());
+			return;
+		}
+
+		m_entries.push_back({ a_mesh, a_shader, a_transform, a_occluder, a_alphaTested });
+		m_built = false;
+	}
+
+	/**
+		build copies every added mesh into the shared buffers on the gpu,
+			packs their textures into arrays and works out the draw groups.
+
+			@return false if nothing had been added.
+	*/
+	bool MeshBatch::build()
+	{
+		destroy();
+		m_chunks.clear();
+		m_groups.clear();
+		m_textures.clear();
+		m_materials.clear();
+		if (m_entries.empty())
+			return false;
+
+		// Every chunk keeps its own indices, the base vertex moves them
+		//	to where its vertices were copied.
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+		for (unsigned int e = 0; e < (unsigned int)m_entries.size(); ++e)
+		{
+			const aie::OBJMesh* mesh = m_entries[e].mesh;
+			for (unsigned int c = 0; c < (unsigned int)mesh->getChunkCount(); ++c)
+			{
+				// Chunks without a material draw with no textures.
+				const aie::OBJMesh::MeshChunk& chunk = mesh->getChunk(c);
+				unsigned int material = m_materials.add(*mesh, chunk.materialID, m_textures);
+				m_chunks.push_back({ e, c, (unsigned int)indexCount, (int)vertexCount, chunk.indexCount, material });
+				vertexCount += chunk.vertexCount;
+				indexCount += chunk.indexCount;
+			}
+		}
+		m_textures.build();
+
+		// Sorted materials have the ids of those sharing arrays next to
+		//	each other, so ordering by id orders by arrays too.
+		std::vector<unsigned int> remap;
+		m_materials.sort(remap);
+		m_materials.upload();
+		for (Chunk& chunk : m_chunks)
+			chunk.material = remap[chunk.material];
+
+		// Chunks drawn with the same program and arrays go next to each
+		//	other, so each group is one multi-draw whatever their materials,
+		//	and within it chunks of a material are drawn together.
+		std::stable_sort(m_chunks.begin(), m_chunks.end(), [this](const Chunk& a, const Chunk& b)
+		{
+			const Entry& entryA = m_entries[a.entry];
+			const Entry& entryB = m_entries[b.entry];
+			if (entryA.shader != entryB.shader)
+				return entryA.shader->getHandle() < entryB.shader->getHandle();
+			if (entryA.alphaTested != entryB.alphaTested)
+				return entryB.alphaTested;
+			return a.material < b.material;
+		});
+
+		for (unsigned int i = 0; i < (unsigned int)m_chunks.size(); ++i)
+		{
+			const Chunk& chunk = m_chunks[i];
+			aie::ShaderProgram* shader = m_entries[chunk.entry].shader;
+			bool alphaTested = m_entries[chunk.entry].alphaTested;
+
+			if (m_groups.empty() == false)
+			{
+				Group& last = m_groups.back();
+				const int* arrays = m_materials.getArrays(chunk.material);
+				bool sameArrays = true;
+				for (unsigned int slot = 0; slot < TEXTURE_SLOTS; ++slot)
+					sameArrays = sameArrays && last.arrays[slot] == arrays[slot];
+
+				if (last.shader == shader && last.alphaTested == alphaTested && sameArrays)
+				{
+					++last.chunkCount;
+					continue;
+				}
+			}
+
+			Group group = { shader, alphaTested, {}, i, 1, 0, 0 };
+			for (unsigned int slot = 0; slot < TEXTURE_SLOTS; ++slot)
+				group.arrays[slot] = m_materials.getArrays(chunk.material)[slot];
+			m_groups.push_back(group);
+		}
+
+		for (const Group& group : m_groups)
+			bindSamplers(*group.shader);
+
+		aie::OBJMesh::VertexFormat format = m_entries[0].mesh->getVertexFormat();
+		size_t vertexSize = aie::OBJMesh::getVertexSize(format);
+
+		glGenBuffers(1, &m_vertexBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, vertexCount * vertexSize, nullptr, GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_vertexBuffer, vertexCount * vertexSize, GpuMemory::MESHES, "MeshBatch");
+
+		// The chunks are already on the gpu, so they are copied buffer to buffer.
+		for (const Chunk& chunk : m_chunks)
+		{
+			const aie::OBJMesh::MeshChunk& source = m_entries[chunk.entry].mesh->getChunk(chunk.chunk);
+			glBindBuffer(GL_COPY_READ_BUFFER, source.vbo);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+				chunk.baseVertex * vertexSize, source.vertexCount * vertexSize);
+		}
+
+		// The indices are relative to each chunk's base vertex, so 16 bits
+		//	are enough when every chunk has 16 bit indices.
+		m_indexType = GL_UNSIGNED_SHORT;
+		for (const Chunk& chunk : m_chunks)
+		{
+			if (m_entries[chunk.entry].mesh->getChunk(chunk.chunk).indexType != GL_UNSIGNED_SHORT)
+				m_indexType = GL_UNSIGNED_INT;
+		}
+		size_t indexSize = aie::OBJMesh::getIndexSize(m_indexType);
+
+		glGenBuffers(1, &m_indexBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_indexBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, indexCount * indexSize, nullptr, GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_indexBuffer, indexCount * indexSize, GpuMemory::MESHES, "MeshBatch");
+		std::vector<unsigned short> shortIndices;
+		std::vector<unsigned int> widened;
+		for (const Chunk& chunk : m_chunks)
+		{
+			const aie::OBJMesh::MeshChunk& source = m_entries[chunk.entry].mesh->getChunk(chunk.chunk);
+			glBindBuffer(GL_COPY_READ_BUFFER, source.ibo);
+			if (source.indexType == m_indexType)
+			{
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+					chunk.firstIndex * indexSize, source.indexCount * indexSize);
+				continue;
+			}
+
+			// A 16 bit chunk among 32 bit ones is read back and widened.
+			shortIndices.resize(source.indexCount);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, source.indexCount * sizeof(unsigned short), shortIndices.data());
+			widened.assign(shortIndices.begin(), shortIndices.end());
+			glBufferSubData(GL_COPY_WRITE_BUFFER, chunk.firstIndex * indexSize, source.indexCount * indexSize, widened.data());
+		}
+
+		// One instance per chunk, in sorted order, so a chunk's base
+		//	instance is its index. The material is only its id.
+		std::vector<Instance> instances;
+		instances.reserve(m_chunks.size());
+		for (const Chunk& chunk : m_chunks)
+			instances.push_back({ m_entries[chunk.entry].transform, chunk.material, {} });
+
+		glGenBuffers(1, &m_instanceBuffer);
+		RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_instanceBuffer, instances.size() * sizeof(Instance), GpuMemory::MESHES, "MeshBatch");
+
+		// One vertex array for the one vertex format, plus the instances'
+		//	model matrix and material id stepping once per instance.
+		glGenVertexArrays(1, &m_vao);
+		RenderState::instance().bindVertexArray(m_vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+		RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+		aie::OBJMesh::setVertexAttributes(0, format);
+
+		static constexpr VertexLayout INSTANCE_LAYOUT = makeVertexLayout<Instance>(
+			SNS_VERTEX_ATTRIBUTE(Instance, transform, aie::OBJMesh::INSTANCE_ATTRIBUTE, MAT4),
+			SNS_VERTEX_ATTRIBUTE(Instance, material, aie::OBJMesh::INSTANCE_ATTRIBUTE + 4, UINT));
+		static_assert(isValidLayout(INSTANCE_LAYOUT), "MeshBatch::Instance layout is invalid");
+
+		RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		setVertexAttributes(INSTANCE_LAYOUT, 0, 1);
+
+		RenderState::instance().bindVertexArray(0);
+		RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		m_commands.create(sizeof(DrawCommand), (unsigned int)m_chunks.size());
+
+		// The occluders never change, so their commands are made once.
+		std::vector<DrawCommand> occluders;
+		for (unsigned int i = 0; i < (unsigned int)m_chunks.size(); ++i)
+		{
+			const Chunk& chunk = m_chunks[i];
+			if (m_entries[chunk.entry].occluder)
+				occluders.push_back({ chunk.indexCount, 1, chunk.firstIndex, chunk.baseVertex, i });
+		}
+		if (occluders.empty() == false)
+		{
+			glGenBuffers(1, &m_occluderCommands);
+			RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_occluderCommands);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, occluders.size() * sizeof(DrawCommand), occluders.data(), GL_STATIC_DRAW);
+			GpuMemory::instance().trackBuffer(m_occluderCommands, occluders.size() * sizeof(DrawCommand), GpuMemory::CULLING, "MeshBatch");
+			RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			m_occluderCount = (unsigned int)occluders.size();
+		}
+
+		// So are every chunk's, for drawAll.
+		std::vector<DrawCommand> chunks;
+		chunks.reserve(m_chunks.size());
+		for (unsigned int i = 0; i < (unsigned int)m_chunks.size(); ++i)
+			chunks.push_back({ m_chunks[i].indexCount, 1, m_chunks[i].firstIndex, m_chunks[i].baseVertex, i });
+		glGenBuffers(1, &m_chunkCommands);
+		RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_chunkCommands);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, chunks.size() * sizeof(DrawCommand), chunks.data(), GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_chunkCommands, chunks.size() * sizeof(DrawCommand), GpuMemory::CULLING, "MeshBatch");
+		RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		if (m_clusterCulling)
+			buildClusters();
+
+		m_built = true;
+		return true;
+	}
+
+	/**
+		buildClusters loads the cull shader and fills the cluster buffer
+			with every chunk's meshlets in group order, so a group's
+			commands are next to each other. Without GL 4.3 or the
+			shader, m_clusterCount is left 0 and draw culls chunks.
+	*/
+	void MeshBatch::buildClusters()
+	{
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("MeshBatch: meshlet culling needs GL 4.3, culling chunks on the cpu.\n");
+			m_clusterCulling = false;
+			return;
+		}
+
+		if (m_cullShader.getHandle() == 0)
+		{
+			m_cullShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/clusterCull.comp");
+			if (m_cullShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_cullShader.getLastError());
+				m_clusterCulling = false;
+				return;
+			}
+		}
+
+		std::vector<Cluster> clusters;
+		for (Group& group : m_groups)
+		{
+			group.firstCluster = (unsigned int)clusters.size();
+			for (unsigned int i = group.firstChunk; i < group.firstChunk + group.chunkCount; ++i)
+			{
+				const Chunk& chunk = m_chunks[i];
+				const aie::OBJMesh* mesh = m_entries[chunk.entry].mesh;
+				const aie::OBJMesh::MeshChunk& source = mesh->getChunk(chunk.chunk);
+				for (unsigned int m = source.firstMeshlet; m < source.firstMeshlet + source.meshletCount; ++m)
+				{
+					const aie::OBJMesh::Meshlet& meshlet = mesh->getMeshlets()[m];
+					clusters.push_back({ meshlet.sphere, meshlet.cone, chunk.firstIndex + meshlet.firstIndex,
+						meshlet.indexCount, chunk.baseVertex, i });
+				}
+			}
+			group.clusterCount = (unsigned int)clusters.size() - group.firstCluster;
+		}
+		if (clusters.empty())
+			return;
+
+		glGenBuffers(1, &m_clusterBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, clusters.size() * sizeof(Cluster), clusters.data(), GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_clusterBuffer, clusters.size() * sizeof(Cluster), GpuMemory::CULLING, "MeshBatch");
+
+		// The commands are only ever written by the cull shader.
+		glGenBuffers(1, &m_clusterCommands);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterCommands);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, clusters.size() * sizeof(DrawCommand), nullptr, GL_DYNAMIC_COPY);
+		GpuMemory::instance().trackBuffer(m_clusterCommands, clusters.size() * sizeof(DrawCommand), GpuMemory::CULLING, "MeshBatch");
+
+		// The visible and occluded counts, reset before each cull.
+		const unsigned int counts[2] = {};
+		glGenBuffers(1, &m_counterBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counts), counts, GL_DYNAMIC_COPY);
+		GpuMemory::instance().trackBuffer(m_counterBuffer, sizeof(counts), GpuMemory::CULLING, "MeshBatch");
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_clusterCounts[0] = m_clusterCounts[1] = 0;
+
+		m_clusterCount = (unsigned int)clusters.size();
+		if (m_meshShading)
+			buildMeshlets(clusters);
+	}
+
+	/**
+		buildMeshlets splits every cluster's run of the index buffer into
+			its distinct vertices and its triangles of them, which is what
+			a mesh shader workgroup reads. MeshOptimiser::buildMeshlets
+			kept each within the mesh shader's limits. Without
+			NV_mesh_shader or the full vertex format, m_meshletBuffer is
+			left 0 and the meshlets are drawn as commands.
+
+			@param1 a_clusters are the clusters, in the buffer's order.
+	*/
+	void MeshBatch::buildMeshlets(const std::vector<Cluster>& a_clusters)
+	{
+		if (aie::ShaderProgram::hasMeshShaders() == false)
+			return;
+		if (m_entries[0].mesh->getVertexFormat() != aie::OBJMesh::FULL_VERTEX)
+		{
+			printf("MeshBatch: mesh shading only reads full vertices, drawing meshlets as commands.\n");
+			return;
+		}
+		if (s_drawMeshTasks == nullptr)
+			s_drawMeshTasks = (DrawMeshTasksFunction)glfwGetProcAddress("glDrawMeshTasksNV");
+		if (s_drawMeshTasks == nullptr)
+			return;
+
+		// The indices are only on the gpu, so they are read back once.
+		size_t indexCount = 0;
+		for (const Chunk& chunk : m_chunks)
+			indexCount = std::max(indexCount, (size_t)chunk.firstIndex + chunk.indexCount);
+		std::vector<unsigned int> indices(indexCount);
+		glBindBuffer(GL_COPY_READ_BUFFER, m_indexBuffer);
+		if (m_indexType == GL_UNSIGNED_SHORT)
+		{
+			std::vector<unsigned short> shortIndices(indexCount);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indexCount * sizeof(unsigned short), shortIndices.data());
+			indices.assign(shortIndices.begin(), shortIndices.end());
+		}
+		else
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indexCount * sizeof(unsigned int), indices.data());
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		// A meshlet's vertices are found by searching the few it has so
+		//	far, each triangle's corners are their places in that list.
+		std::vector<Meshlet> meshlets;
+		std::vector<unsigned int> vertices;
+		std::vector<unsigned int> triangles;
+		meshlets.reserve(a_clusters.size());
+		for (const Cluster& cluster : a_clusters)
+		{
+			Meshlet meshlet = { (unsigned int)vertices.size(), 0, (unsigned int)triangles.size(),
+				cluster.indexCount / 3 };
+			if (meshlet.triangleCount > MeshOptimiser::MESHLET_TRIANGLES)
+			{
+				printf("MeshBatch: a meshlet has %u triangles, too many to mesh shade.\n", meshlet.triangleCount);
+				return;
+			}
+
+			for (unsigned int t = 0; t < meshlet.triangleCount; ++t)
+			{
+				unsigned int corners = 0;
+				for (unsigned int c = 0; c < 3; ++c)
+				{
+					unsigned int vertex = cluster.baseVertex + indices[cluster.firstIndex + t * 3 + c];
+					unsigned int slot = meshlet.firstVertex;
+					while (slot < (unsigned int)vertices.size() && vertices[slot] != vertex)
+						++slot;
+					if (slot == (unsigned int)vertices.size())
+					{
+						if (slot - meshlet.firstVertex == MeshOptimiser::MESHLET_VERTICES)
+						{
+							printf("MeshBatch: a meshlet has too many vertices to mesh shade.\n");
+							return;
+						}
+						vertices.push_back(vertex);
+					}
+					corners |= (slot - meshlet.firstVertex) << (c * 8);
+				}
+				triangles.push_back(corners);
+			}
+			meshlet.vertexCount = (unsigned int)vertices.size() - meshlet.firstVertex;
+			meshlets.push_back(meshlet);
+		}
+
+		glGenBuffers(1, &m_meshletBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_meshletBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * sizeof(Meshlet), meshlets.data(), GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_meshletBuffer, meshlets.size() * sizeof(Meshlet), GpuMemory::MESHES, "MeshBatch");
+
+		glGenBuffers(1, &m_meshletVertices);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_meshletVertices);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, vertices.size() * sizeof(unsigned int), vertices.data(), GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_meshletVertices, vertices.size() * sizeof(unsigned int), GpuMemory::MESHES, "MeshBatch");
+
+		glGenBuffers(1, &m_meshletTriangles);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_meshletTriangles);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, triangles.size() * sizeof(unsigned int), triangles.data(), GL_STATIC_DRAW);
+		GpuMemory::instance().trackBuffer(m_meshletTriangles, triangles.size() * sizeof(unsigned int), GpuMemory::MESHES, "MeshBatch");
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	/**
+		bindGroup binds a group's program and texture arrays. The program,
+			and the material blocks with it, are only bound when it isn't
+			the current one.
+
+			@param1 a_group is the group about to be drawn.
+
+			@param2 a_currentShader is the bound program, updated.
+
+			@param3 a_shader draws every group, or null for their own.
+	*/
+	void MeshBatch::bindGroup(const Group& a_group, aie::ShaderProgram*& a_currentShader,
+		aie::ShaderProgram* a_shader)
+	{
+		aie::ShaderProgram* shader = a_shader != nullptr ? a_shader : a_group.shader;
+		if (shader != a_currentShader)
+		{
+			// The binding may have been taken since the last group's draw.
+			a_currentShader = shader;
+			a_currentShader->bind();
+			m_materials.bind(MATERIAL_BINDING);
+		}
+
+		const unsigned int units[TEXTURE_SLOTS] = { 0, 3, 5 };
+		for (unsigned int slot = 0; slot < TEXTURE_SLOTS; ++slot)
+		{
+			if (a_group.arrays[slot] >= 0)
+				m_textures.bind(a_group.arrays[slot], units[slot]);
+		}
+	}
+
+	/**
+		draw culls each chunk or meshlet against the camera and draws the
+			rest, a multi-draw per group with anything left in it.
+			Materials are only the instances' ids into the material
+			blocks, so between groups just the program and texture
+			arrays change.
+
+			@param1 a_projectionView is the camera's projection view.
+
+			@param2 a_cameraPosition is where the camera is, for the
+					meshlets' back face test.
+
+			@param3 a_hiZ holds the depth of the occluders, seen with the
+					same projection view, or null to not test against it.
+
+			@param4 a_shader draws every group instead of their own
+					programs, or null for theirs.
+	*/
+	void MeshBatch::draw(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition,
+		const HiZBuffer* a_hiZ, aie::ShaderProgram* a_shader)
+	{
+		cull(a_projectionView, a_cameraPosition, a_hiZ);
+		drawCulled(a_shader);
+	}
+
+	/**
+		cull culls each chunk or meshlet against the camera and writes the
+			draws of the rest, for drawCulled to draw as many times as the
+			frame needs.
+
+			@param1 a_projectionView is the camera's projection view.
+
+			@param2 a_cameraPosition is where the camera is, for the
+					meshlets' back face test.
+
+			@param3 a_hiZ holds the depth of the occluders, seen with the
+					same projection view, or null to not test against it.
+	*/
+	void MeshBatch::cull(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition,
+		const HiZBuffer* a_hiZ)
+	{
+		m_stats = {};
+		m_culled = false;
+		if (m_built == false)
+			return;
+
+		m_culled = true;
+		m_fenced = false;
+		m_stats.textureArrays = m_textures.getArrayCount();
+		m_stats.materials = m_materials.getCount();
+		if (m_clusterCount > 0)
+		{
+			static constexpr aie::UniformHandle CLUSTER_COUNT("ClusterCount");
+			static constexpr aie::UniformHandle FRUSTUM_PLANES("FrustumPlanes");
+			static constexpr aie::UniformHandle CAMERA_POSITION("ViewPosition");
+			static constexpr aie::UniformHandle PROJECTION_VIEW("ProjectionView");
+			static constexpr aie::UniformHandle HIZ("HiZ");
+			static constexpr aie::UniformHandle HIZ_LEVELS("HiZLevels");
+			static constexpr aie::UniformHandle REVERSE_Z("ReverseZ");
+
+			// The planes are in world space, the shader moves each meshlet there.
+			Frustum frustum(a_projectionView);
+			glm::vec4 planes[6];
+			for (unsigned int p = 0; p < 6; ++p)
+				planes[p] = frustum.getPlane(p);
+
+			// drawMeshlets' task shader culls against the same.
+			m_cullProjectionView = a_projectionView;
+			for (unsigned int p = 0; p < 6; ++p)
+				m_cullPlanes[p] = planes[p];
+			m_cullPosition = a_cameraPosition;
+			m_cullHiZ = a_hiZ != nullptr && a_hiZ->isCreated() ? a_hiZ : nullptr;
+
+			m_cullShader.bind();
+			m_cullShader.bindUniform(CLUSTER_COUNT, (int)m_clusterCount);
+			m_cullShader.bindUniform(FRUSTUM_PLANES, 6, planes);
+			m_cullShader.bindUniform(CAMERA_POSITION, a_cameraPosition);
+			m_cullShader.bindUniform(PROJECTION_VIEW, a_projectionView);
+
+			bool occlusion = a_hiZ != nullptr && a_hiZ->isCreated();
+			m_cullShader.bindUniform(HIZ_LEVELS, occlusion ? a_hiZ->getLevelCount() : 0);
+			m_cullShader.bindUniform(REVERSE_Z, RenderState::instance().isReverseZ() ? 1 : 0);
+			if (occlusion)
+			{
+				a_hiZ->bind(HIZ_UNIT);
+				m_cullShader.bindUniform(HIZ, (int)HIZ_UNIT);
+			}
+
+			// The counts last read back, the buffer is zeroed after the
+			//	copy of the last cull's, which the gpu makes first.
+			m_stats.clustersVisible = m_clusterCounts[0];
+			m_stats.clustersOccluded = m_clusterCounts[1];
+			const unsigned int counts[2] = {};
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), counts);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, m_clusterBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, m_instanceBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_clusterCommands);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, m_counterBuffer);
+			glDispatchCompute((m_clusterCount + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE, 1, 1);
+
+			// The commands are read straight back as draws, and the counts
+			//	copied out for the cpu once the gpu gets to them.
+			glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+			GpuReadback::instance().readBuffer(m_counterBuffer, 0, sizeof(counts),
+				[this](const void* a_data, size_t a_size)
+				{
+					memcpy(m_clusterCounts, a_data, a_size);
+				});
+
+			m_stats.commands = m_clusterCount;
+			m_stats.clusters = m_clusterCount;
+			return;
+		}
+
+		// Cull every entry's chunks in its own local space, as the
+		//	render queue does.
+		m_visibility.resize(m_entries.size());
+		m_entryMatrices.resize(m_entries.size());
+		for (unsigned int e = 0; e < (unsigned int)m_entries.size(); ++e)
+			m_entryMatrices[e] = m_entries[e].transform;
+		multiplyMatrices(a_projectionView, m_entryMatrices.data(), m_entryMatrices.data(), m_entryMatrices.size());
+
+		for (unsigned int e = 0; e < (unsigned int)m_entries.size(); ++e)
+		{
+			Frustum frustum(m_entryMatrices[e]);
+			frustum.cull(m_entries[e].mesh->getChunkBounds(), m_visibility[e]);
+		}
+
+		// Write the visible chunks' commands, remembering how many each
+		//	group kept.
+		DrawCommand* commands = (DrawCommand*)m_commands.beginWrite();
+		m_groupCounts.assign(m_groups.size(), 0);
+		unsigned int commandCount = 0;
+		for (unsigned int g = 0; g < (unsigned int)m_groups.size(); ++g)
+		{
+			const Group& group = m_groups[g];
+			for (unsigned int i = group.firstChunk; i < group.firstChunk + group.chunkCount; ++i)
+			{
+				const Chunk& chunk = m_chunks[i];
+				if (m_visibility[chunk.entry][chunk.chunk] == 0)
+					continue;
+
+				commands[commandCount++] = { chunk.indexCount, 1, chunk.firstIndex, chunk.baseVertex, i };
+				++m_groupCounts[g];
+			}
+		}
+		m_firstCommand = m_commands.endWrite(commandCount);
+		m_stats.commands = commandCount;
+	}
+
+	/**
+		drawCulled draws what the last cull kept, a multi-draw per group
+			with anything left in it.
+
+			@param1 a_shader draws every group instead of their own
+					programs, or null for theirs.
+
+			@param2 a_alphaTestedShader draws the groups of alpha tested
+					meshes instead, or null for a_shader.
+	*/
+	void MeshBatch::drawCulled(aie::ShaderProgram* a_shader, aie::ShaderProgram* a_alphaTestedShader)
+	{
+		if (m_culled == false)
+			return;
+
+		if (a_alphaTestedShader == nullptr)
+			a_alphaTestedShader = a_shader;
+		if (a_shader != nullptr)
+			bindSamplers(*a_shader);
+		if (a_alphaTestedShader != nullptr && a_alphaTestedShader != a_shader)
+			bindSamplers(*a_alphaTestedShader);
+
+		aie::ShaderProgram* currentShader = nullptr;
+		RenderState::instance().bindVertexArray(m_vao);
+		if (m_clusterCount > 0)
+		{
+			RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_clusterCommands);
+			for (const Group& group : m_groups)
+			{
+				if (group.clusterCount == 0)
+					continue;
+
+				bindGroup(group, currentShader, group.alphaTested ? a_alphaTestedShader : a_shader);
+				RenderState::instance().countDraw();
+				glMultiDrawElementsIndirect(GL_TRIANGLES, m_indexType,
+					(void*)(group.firstCluster * sizeof(DrawCommand)), group.clusterCount, 0);
+				++m_stats.drawCalls;
+			}
+			return;
+		}
+
+		RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands.getHandle());
+		size_t offset = m_firstCommand * sizeof(DrawCommand);
+		for (unsigned int g = 0; g < (unsigned int)m_groups.size(); ++g)
+		{
+			if (m_groupCounts[g] == 0)
+				continue;
+
+			bindGroup(m_groups[g], currentShader, m_groups[g].alphaTested ? a_alphaTestedShader : a_shader);
+			RenderState::instance().countDraw();
+			glMultiDrawElementsIndirect(GL_TRIANGLES, m_indexType, (void*)offset, m_groupCounts[g], 0);
+			offset += m_groupCounts[g] * sizeof(DrawCommand);
+			++m_stats.drawCalls;
+		}
+
+		// The region's fence goes after the last pass that reads it.
+		if (m_fenced)
+			m_commands.refence();
+		else
+			m_commands.fence();
+		m_fenced = true;
+	}
+
+	/**
+		bindSamplers points a program's samplers at the units bindGroup
+			binds the texture arrays to, the ones OBJMesh binds the same
+			textures to.
+
+			@param1 a_shader is the program.
+	*/
+	void MeshBatch::bindSamplers(aie::ShaderProgram& a_shader)
+	{
+		unsigned int program = a_shader.getHandle();
+		glProgramUniform1i(program, a_shader.getUniform("diffuseTexture"), 0);
+		glProgramUniform1i(program, a_shader.getUniform("specularTexture"), 3);
+		glProgramUniform1i(program, a_shader.getUniform("normalTexture"), 5);
+	}
+
+	/**
+		drawOccluders draws every chunk of the meshes added as occluders
+			in one multi-draw, with nothing but the bound program, to fill
+			a HiZBuffer. They aren't culled, there are few of them and
+			they are mostly on screen.
+	*/
+	void MeshBatch::drawOccluders()
+	{
+		if (m_built == false || m_occluderCount == 0)
+			return;
+
+		RenderState::instance().bindVertexArray(m_vao);
+		RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_occluderCommands);
+		RenderState::instance().countDraw();
+		glMultiDrawElementsIndirect(GL_TRIANGLES, m_indexType, nullptr, m_occluderCount, 0);
+	}
+
+	/**
+		drawAll draws every chunk without culling, a multi-draw per group,
+			for passes that see most of the batch and are seldom drawn.
+			Its commands never change, so it leaves what cull wrote for
+			drawCulled.
+
+			@param1 a_shader draws every group instead of their own
+					programs, or null for theirs.
+
+			@param2 a_alphaTestedShader draws the groups of alpha tested
+					meshes instead, or null for a_shader.
+	*/
+	void MeshBatch::drawAll(aie::ShaderProgram* a_shader, aie::ShaderProgram* a_alphaTestedShader)
+	{
+		if (m_built == false || m_chunkCommands == 0)
+			return;
+
+		if (a_alphaTestedShader == nullptr)
+			a_alphaTestedShader = a_shader;
+		if (a_shader != nullptr)
+			bindSamplers(*a_shader);
+		if (a_alphaTestedShader != nullptr && a_alphaTestedShader != a_shader)
+			bindSamplers(*a_alphaTestedShader);
+
+		aie::ShaderProgram* currentShader = nullptr;
+		RenderState::instance().bindVertexArray(m_vao);
+		RenderState::instance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_chunkCommands);
+		for (const Group& group : m_groups)
+		{
+			bindGroup(group, currentShader, group.alphaTested ? a_alphaTestedShader : a_shader);
+			RenderState::instance().countDraw();
+			glMultiDrawElementsIndirect(GL_TRIANGLES, m_indexType,
+				(void*)(group.firstChunk * sizeof(DrawCommand)), group.chunkCount, 0);
+		}
+	}
+
+	/**
+		drawMeshlets draws every group's meshlets through the task and mesh
+			stages. Each task workgroup culls 32 of a group's meshlets
+			against what the last cull was given and launches a mesh
+			workgroup for each one kept, so nothing the cull shader wrote
+			is read and the vertex array is never bound.
+
+			@param1 a_shader draws every group.
+
+			@param2 a_alphaTestedShader draws the groups of alpha tested
+					meshes instead, or null for a_shader.
+	*/
+	void MeshBatch::drawMeshlets(aie::ShaderProgram& a_shader, aie::ShaderProgram* a_alphaTestedShader)
+	{
+		if (m_culled == false || m_meshletBuffer == 0)
+			return;
+
+		static constexpr aie::UniformHandle FIRST_CLUSTER("FirstCluster");
+		static constexpr aie::UniformHandle CLUSTER_COUNT("ClusterCount");
+		static constexpr aie::UniformHandle FRUSTUM_PLANES("FrustumPlanes");
+		static constexpr aie::UniformHandle CAMERA_POSITION("ViewPosition");
+		static constexpr aie::UniformHandle PROJECTION_VIEW("ProjectionView");
+		static constexpr aie::UniformHandle HIZ("HiZ");
+		static constexpr aie::UniformHandle HIZ_LEVELS("HiZLevels");
+		static constexpr aie::UniformHandle REVERSE_Z("ReverseZ");
+
+		if (a_alphaTestedShader == nullptr)
+			a_alphaTestedShader = &a_shader;
+		bindSamplers(a_shader);
+		if (a_alphaTestedShader != &a_shader)
+			bindSamplers(*a_alphaTestedShader);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, m_clusterBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, m_instanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_BINDING, m_meshletBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_VERTEX_BINDING, m_meshletVertices);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_TRIANGLE_BINDING, m_meshletTriangles);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_BINDING, m_vertexBuffer);
+		if (m_cullHiZ != nullptr)
+			m_cullHiZ->bind(HIZ_UNIT);
+
+		aie::ShaderProgram* currentShader = nullptr;
+		aie::ShaderProgram* culledShader = nullptr;
+		for (const Group& group : m_groups)
+		{
+			if (group.clusterCount == 0)
+				continue;
+
+			bindGroup(group, currentShader, group.alphaTested ? a_alphaTestedShader : &a_shader);
+
+			// The culling is the same for every group, only sent when the
+			//	program changes.
+			if (currentShader != culledShader)
+			{
+				culledShader = currentShader;
+				culledShader->bindUniform(FRUSTUM_PLANES, 6, m_cullPlanes);
+				culledShader->bindUniform(CAMERA_POSITION, m_cullPosition);
+				culledShader->bindUniform(PROJECTION_VIEW, m_cullProjectionView);
+				culledShader->bindUniform(HIZ_LEVELS, m_cullHiZ != nullptr ? m_cullHiZ->getLevelCount() : 0);
+				culledShader->bindUniform(REVERSE_Z, RenderState::instance().isReverseZ() ? 1 : 0);
+				if (m_cullHiZ != nullptr)
+					culledShader->bindUniform(HIZ, (int)HIZ_UNIT);
+			}
+
+			culledShader->bindUniform(FIRST_CLUSTER, (int)group.firstCluster);
+			culledShader->bindUniform(CLUSTER_COUNT, (int)group.clusterCount);
+			RenderState::instance().countDraw();
+			s_drawMeshTasks(0, (group.clusterCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE);
+			++m_stats.drawCalls;
+		}
+	}
+
+	/**
+		destroy deletes the shared buffers and vertex array.
+	*/
+	void MeshBatch::destroy()
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		RenderState::instance().onVertexArrayDeleted(m_vao);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		RenderState::instance().onBufferDeleted(m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+		RenderState::instance().onBufferDeleted(m_indexBuffer);
+		glDeleteBuffers(1, &m_instanceBuffer);
+		RenderState::instance().onBufferDeleted(m_instanceBuffer);
+		glDeleteBuffers(1, &m_clusterBuffer);
+		RenderState::instance().onBufferDeleted(m_clusterBuffer);
+		glDeleteBuffers(1, &m_clusterCommands);
+		RenderState::instance().onBufferDeleted(m_clusterCommands);
+		glDeleteBuffers(1, &m_meshletBuffer);
+		RenderState::instance().onBufferDeleted(m_meshletBuffer);
+		glDeleteBuffers(1, &m_meshletVertices);
+		RenderState::instance().onBufferDeleted(m_meshletVertices);
+		glDeleteBuffers(1, &m_meshletTriangles);
+		RenderState::instance().onBufferDeleted(m_meshletTriangles);
+		GpuMemory& memory = GpuMemory::instance();
+		memory.releaseBuffer(m_vertexBuffer);
+		memory.releaseBuffer(m_indexBuffer);
+		memory.releaseBuffer(m_instanceBuffer);
+		memory.releaseBuffer(m_clusterBuffer);
+		memory.releaseBuffer(m_clusterCommands);
+		memory.releaseBuffer(m_meshletBuffer);
+		memory.releaseBuffer(m_meshletVertices);
+		memory.releaseBuffer(m_meshletTriangles);
+		memory.releaseBuffer(m_occluderCommands);
+		memory.releaseBuffer(m_chunkCommands);
+		m_vao = m_vertexBuffer = m_indexBuffer = m_instanceBuffer = 0;
+		m_clusterBuffer = m_clusterCommands = m_clusterCount = 0;
+		m_meshletBuffer = m_meshletVertices = m_meshletTriangles = 0;
+		glDeleteBuffers(1, &m_counterBuffer);
+		RenderState::instance().onBufferDeleted(m_counterBuffer);
+		glDeleteBuffers(1, &m_occluderCommands);
+		RenderState::instance().onBufferDeleted(m_occluderCommands);
+		glDeleteBuffers(1, &m_chunkCommands);
+		RenderState::instance().onBufferDeleted(m_chunkCommands);
+		memory.releaseBuffer(m_counterBuffer);
+		m_counterBuffer = 0;
+		m_occluderCommands = m_occluderCount = 0;
+		m_chunkCommands = 0;
+		m_commands.destroy();
+		m_built = false;
+		m_culled = false;
+	}
+}
@@ -0,0 +1,433 @@
+/**
+	MeshBatch.h
+
+	Purpose: MeshBatch.h is the header file for the MeshBatch class. The
+			MeshBatch packs many static meshes into one vertex and index
+			buffer and draws all of them with a few multi-draw indirect
+			calls, instead of a draw per chunk.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "StreamingBuffer.h"
+#include "TextureArrays.h"
+#include "MaterialTable.h"
+#include "Frustum.h"
+#include "Shader.h"
+#include "HiZBuffer.h"
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	/**
+		The MeshBatch class copies the chunks of every mesh added to it
+			into shared buffers, with one vertex array for the OBJMesh
+			vertex format. Each frame the visible chunks are written as
+			indirect commands into a streaming buffer. Chunks sharing a
+			program and the same texture arrays are drawn together by a
+			single glMultiDrawElementsIndirect.
+
+		Every chunk has an instance picked by its command's base instance:
+			the mesh's transform at locations 4 to 7, then its material's
+			id at 8, an unsigned integer. The materials of every mesh are
+			kept once each in a MaterialTable, bound as a storage buffer
+			at MATERIAL_BINDING, and sorted so chunks of a group have a
+			run of ids. The textures are bound as arrays on units 0, 3
+			and 5, the units OBJMesh binds them to, so the programs it
+			draws with must read all of this from there, as
+			meshBatch.glsl does.
+
+		With GL 4.3 the chunks are culled as meshlets instead, on the
+			gpu. A compute shader tests every meshlet's sphere against the
+			frustum and its normal cone against the camera, and writes its
+			command with an instance count of 0 when it is culled. Each
+			group is then one multi-draw over all of its meshlets, so the
+			cpu does no per chunk work at all. Given a HiZBuffer the shader
+			also culls meshlets hidden behind whatever was drawn into it,
+			usually the batch's own occluders from drawOccluders.
+
+		With NV_mesh_shader the meshlets can skip the vertex pipeline too.
+			Each one's distinct vertices and its triangles of them are
+			kept beside the cluster buffer, and drawMeshlets launches a
+			task shader per 32 meshlets of a group that culls them as the
+			cull shader does and hands the rest to a mesh shader, which
+			reads the vertices from the shared buffer itself. Only the
+			full OBJMesh vertex format is read that way.
+	*/
+	class MeshBatch
+	{
+	public:
+		/**
+			Counts from the last draw.
+		*/
+		struct Stats
+		{
+			// The chunks drawn, one indirect command each.
+			unsigned int commands;
+
+			// The glMultiDrawElementsIndirect calls they took, or the
+			//	glDrawMeshTasksNV calls of drawMeshlets.
+			unsigned int drawCalls;
+
+			// The texture arrays the materials were packed into, and the
+			//	distinct materials the chunks share.
+			unsigned int textureArrays;
+			unsigned int materials;
+
+			// The meshlets the cull shader tested, 0 when the chunks were
+			//	culled on the cpu.
+			unsigned int clusters;
+
+			// How many of them it kept, and how many it culled as hidden
+			//	by the HiZBuffer. The gpu counts these, so they are from
+			//	the last cull GpuReadback has handed back, a few frames
+			//	ago.
+			unsigned int clustersVisible;
+			unsigned int clustersOccluded;
+		};
+
+		// The shader storage binding the material blocks are read from,
+		//	above every binding the cull shader uses.
+		static const unsigned int MATERIAL_BINDING = 4;
+
+		MeshBatch();
+
+		/**
+			The deconstructor deletes the buffers.
+		*/
+		~MeshBatch();
+
+		MeshBatch(const MeshBatch&) = delete;
+		MeshBatch& operator=(const MeshBatch&) = delete;
+
+		/**
+			add places a mesh in the batch. Nothing is copied until build.
+
+				@param1 a_mesh is an uploaded mesh, it must outlive the batch.
+						Meshes in a different vertex format to the first
+						one added are refused.
+
+				@param2 a_shader is the program to draw it with.
+
+				@param3 a_transform is where it is placed in the world.
+
+				@param4 a_occluder is whether drawOccluders draws it.
+
+				@param5 a_alphaTested is whether its materials cut holes
+						with the diffuse alpha, so a depth pass has to
+						read its textures too.
+		*/
+		void add(const aie::OBJMesh* a_mesh, aie::ShaderProgram* a_shader, const glm::mat4& a_transform,
+			bool a_occluder = false, bool a_alphaTested = false);
+
+		/**
+			build copies every added mesh into the shared buffers on the
+				gpu, packs their textures into arrays and works out the
+				draw groups. Meshes added after build aren't drawn until
+				it is called again.
+
+				@return false if nothing had been added.
+		*/
+		bool build();
+
+		/**
+			draw culls each chunk or meshlet against the camera and draws
+				the rest.
+
+				@param1 a_projectionView is the camera's projection view.
+
+				@param2 a_cameraPosition is where the camera is, for the
+						meshlets' back face test.
+
+				@param3 a_hiZ holds the depth of the occluders, seen with
+						the same projection view, or null to not test
+						against it. Only meshlets are tested.
+
+				@param4 a_shader draws every group instead of their own
+						programs, or null for theirs. It must read the
+						same instance attributes as they do.
+		*/
+		void draw(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition,
+			const HiZBuffer* a_hiZ = nullptr, aie::ShaderProgram* a_shader = nullptr);
+
+		/**
+			cull culls each chunk or meshlet against the camera and writes
+				the draws of the rest, for drawCulled to draw as many
+				times as the frame needs, like a depth pass and then the
+				shading. draw is cull then drawCulled.
+
+				@param1 a_projectionView is the camera's projection view.
+
+				@param2 a_cameraPosition is where the camera is.
+
+				@param3 a_hiZ holds the depth of the occluders, or null.
+		*/
+		void cull(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition,
+			const HiZBuffer* a_hiZ = nullptr);
+
+		/**
+			drawCulled draws what the last cull kept, a multi-draw per
+				group with anything left in it.
+
+				@param1 a_shader draws every group instead of their own
+						programs, or null for theirs.
+
+				@param2 a_alphaTestedShader draws the groups of alpha
+						tested meshes instead, or null for a_shader.
+		*/
+		void drawCulled(aie::ShaderProgram* a_shader = nullptr, aie::ShaderProgram* a_alphaTestedShader = nullptr);
+
+		/**
+			drawOccluders draws every chunk of the meshes added as
+				occluders in one multi-draw, with nothing but the bound
+				program, to fill a HiZBuffer. The program must take its
+				model matrix from locations 4 to 7 like the batch's own.
+		*/
+		void drawOccluders();
+
+		/**
+			drawAll draws every chunk without culling, a multi-draw per
+				group, for passes that see most of the batch at once and
+				are seldom drawn, like a cached shadow map. It doesn't
+				touch what cull wrote.
+
+				@param1 a_shader draws every group instead of their own
+						programs, or null for theirs.
+
+				@param2 a_alphaTestedShader draws the groups of alpha
+						tested meshes instead, or null for a_shader.
+		*/
+		void drawAll(aie::ShaderProgram* a_shader = nullptr, aie::ShaderProgram* a_alphaTestedShader = nullptr);
+
+		/**
+			drawMeshlets draws every group's meshlets through the task and
+				mesh stages, culling them in the task shader against the
+				camera and HiZBuffer the last cull was given. Does nothing
+				unless isMeshShading.
+
+				@param1 a_shader draws every group, linked from
+						meshBatch.task, meshBatch.mesh and a batched
+						fragment shader.
+
+				@param2 a_alphaTestedShader draws the groups of alpha
+						tested meshes instead, or null for a_shader.
+		*/
+		void drawMeshlets(aie::ShaderProgram& a_shader, aie::ShaderProgram* a_alphaTestedShader = nullptr);
+
+		/**
+			setClusterCulling picks whether the next build culls meshlets
+				on the gpu, when GL 4.3 is there to. It is on by default.
+
+				@param1 a_enabled is whether to cull meshlets.
+		*/
+		void setClusterCulling(bool a_enabled) { m_clusterCulling = a_enabled; m_built = false; }
+
+		/**
+			isClusterCulling returns whether the batch was built to cull
+				meshlets on the gpu.
+		*/
+		bool isClusterCulling() const { return m_clusterCount > 0; }
+
+		/**
+			setMeshShading picks whether the next build keeps what the
+				mesh shader reads, when the meshlets are culled on the gpu
+				and the driver has NV_mesh_shader. It is on by default.
+
+				@param1 a_enabled is whether to keep it.
+		*/
+		void setMeshShading(bool a_enabled) { m_meshShading = a_enabled; m_built = false; }
+
+		/**
+			isMeshShading returns whether the batch was built for
+				drawMeshlets.
+		*/
+		bool isMeshShading() const { return m_meshletBuffer != 0; }
+
+		/**
+			isBuilt returns whether build has been called since the last add.
+		*/
+		bool isBuilt() const { return m_built; }
+
+		/**
+			getStats returns the counts from the last draw.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		// The layout glMultiDrawElementsIndirect reads.
+		struct DrawCommand
+		{
+			unsigned int count;
+			unsigned int instanceCount;
+			unsigned int firstIndex;
+			int baseVertex;
+			unsigned int baseInstance;
+		};
+
+		// What each chunk's base instance picks, attributes 4 to 8, five
+		//	vec4s as the cull shader reads them.
+		struct Instance
+		{
+			glm::mat4 transform;
+			unsigned int material;
+			unsigned int padding[3];
+		};
+
+		// A meshlet as the cull shader reads it, 48 bytes in std430.
+		struct Cluster
+		{
+			glm::vec4 sphere;
+			glm::vec4 cone;
+			unsigned int firstIndex;
+			unsigned int indexCount;
+			int baseVertex;
+			unsigned int instance;
+		};
+
+		// A meshlet's runs of the meshlet vertex and triangle buffers, as
+		//	the mesh shader reads them beside its Cluster.
+		struct Meshlet
+		{
+			unsigned int firstVertex;
+			unsigned int vertexCount;
+			unsigned int firstTriangle;
+			unsigned int triangleCount;
+		};
+
+		// The texture slots the batch packs, diffuse, specular and normal.
+		static const unsigned int TEXTURE_SLOTS = MaterialTable::TEXTURE_SLOTS;
+
+		// A mesh added to the batch.
+		struct Entry
+		{
+			const aie::OBJMesh* mesh;
+			aie::ShaderProgram* shader;
+			glm::mat4 transform;
+			bool occluder;
+			bool alphaTested;
+		};
+
+		// One chunk in the shared buffers.
+		struct Chunk
+		{
+			unsigned int entry;
+			unsigned int chunk;
+			unsigned int firstIndex;
+			int baseVertex;
+			unsigned int indexCount;
+			unsigned int material;
+		};
+
+		// Chunks sharing a program and texture arrays, next to each other
+		//	in m_chunks, and their meshlets, next to each other in the
+		//	cluster buffer.
+		struct Group
+		{
+			aie::ShaderProgram* shader;
+			bool alphaTested;
+			int arrays[TEXTURE_SLOTS];
+			unsigned int firstChunk;
+			unsigned int chunkCount;
+			unsigned int firstCluster;
+			unsigned int clusterCount;
+		};
+
+		// Deletes the shared buffers and vertex array.
+		void destroy();
+
+		// Loads the cull shader and fills the cluster buffer from the
+		//	sorted chunks, leaving m_clusterCount 0 if it can't.
+		void buildClusters();
+
+		// Reads back the indices of every cluster and fills the meshlet
+		//	buffers from them, leaving m_meshletBuffer 0 if it can't.
+		void buildMeshlets(const std::vector<Cluster>& a_clusters);
+
+		// Binds a group's program, or the one drawing every group, and
+		//	its texture arrays, if they changed.
+		void bindGroup(const Group& a_group, aie::ShaderProgram*& a_currentShader,
+			aie::ShaderProgram* a_shader);
+
+		// Points a program's samplers at the units the arrays are bound to.
+		static void bindSamplers(aie::ShaderProgram& a_shader);
+
+		std::vector<Entry> m_entries;
+		std::vector<Chunk> m_chunks;
+		std::vector<Group> m_groups;
+
+		unsigned int m_vao;
+		unsigned int m_vertexBuffer;
+		unsigned int m_indexBuffer;
+
+		// GL_UNSIGNED_SHORT unless a chunk needed 32 bit indices.
+		unsigned int m_indexType;
+
+		// Every chunk's Instance, read one per draw through the base instance.
+		unsigned int m_instanceBuffer;
+
+		// The materials' textures, one layer each, and the materials.
+		TextureArrays m_textures;
+		MaterialTable m_materials;
+
+		// The frame's commands, in group order.
+		StreamingBuffer m_commands;
+
+		// The meshlets in group order, the commands the cull shader writes
+		//	for them, and the shader.
+		unsigned int m_clusterBuffer;
+		unsigned int m_clusterCommands;
+		unsigned int m_clusterCount;
+		aie::ShaderProgram m_cullShader;
+		bool m_clusterCulling;
+
+		// Every cluster's Meshlet, each one's vertex indices, and its
+		//	triangles with three 8 bit corners each, for the mesh shader.
+		unsigned int m_meshletBuffer;
+		unsigned int m_meshletVertices;
+		unsigned int m_meshletTriangles;
+		bool m_meshShading;
+
+		// What the last cull culled against, for drawMeshlets' task
+		//	shader to cull the same.
+		glm::mat4 m_cullProjectionView;
+		glm::vec4 m_cullPlanes[6];
+		glm::vec3 m_cullPosition;
+		const HiZBuffer* m_cullHiZ;
+
+		// The cull shader's counts, and the last read back from it.
+		//	The batch must outlive the GpuReadback's pending reads.
+		unsigned int m_counterBuffer;
+		unsigned int m_clusterCounts[2];
+
+		// A command for every occluder chunk, drawn by drawOccluders.
+		unsigned int m_occluderCommands;
+		unsigned int m_occluderCount;
+
+		// A command for every chunk in group order, drawn by drawAll.
+		unsigned int m_chunkCommands;
+
+		// Scratch space for culling each entry's chunks, and how many
+		//	chunks of each group were left.
+		std::vector<std::vector<unsigned char>> m_visibility;
+		std::vector<unsigned int> m_groupCounts;
+
+		// Scratch space for each entry's projection view times its
+		//	transform, multiplied as a batch.
+		std::vector<glm::mat4> m_entryMatrices;
+
+		// Where the last cull's chunk commands start in m_commands, whether
+		//	there is a cull to draw, and whether drawCulled fenced it yet.
+		unsigned int m_firstCommand;
+		bool m_culled;
+		bool m_fenced;
+
+		bool m_built;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,818 @@
+/**
+	MeshCodec.cpp
+
+	Purpose: MeshCodec.cpp is the source file for the MeshCodec class. The
+			MeshCodec decodes vertex and index data compressed the way
+			meshoptimizer compresses it, as glTF models carry it in
+			buffer views with EXT_meshopt_compression.
+
+	@author Nathan Nette
+*/
+#include "MeshCodec.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SNS_CODEC_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// The first byte of each format, its high half, the low half is
+	//	the version.
+	const unsigned char VERTEX_HEADER = 0xa0;
+	const unsigned char INDEX_HEADER = 0xe0;
+	const unsigned char SEQUENCE_HEADER = 0xd0;
+
+	// Vertex blocks are at most this many bytes and vertices, and their
+	//	bytes are stored in groups this long.
+	const size_t VERTEX_BLOCK_BYTES = 8192;
+	const size_t VERTEX_BLOCK_MAX = 256;
+	const size_t BYTE_GROUP_SIZE = 16;
+
+	// The most a byte group can take, 8 bits of each and one extra byte.
+	const size_t BYTE_GROUP_DECODE_LIMIT = 24;
+
+	// The vertex data ends with the first vertex, padded to at least this.
+	const size_t VERTEX_TAIL_MIN = 32;
+
+	// The arrangements of new and reused vertices the encoder puts in the
+	//	triangle data's table, as meshoptimizer's does. The last two
+	//	codes aren't table entries.
+	const unsigned char INDEX_TABLE[16] = {
+		0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00
+	};
+
+	size_t getVertexBlockSize(size_t a_vertexSize)
+	{
+		size_t size = (VERTEX_BLOCK_BYTES / a_vertexSize) & ~(BYTE_GROUP_SIZE - 1);
+		return size < VERTEX_BLOCK_MAX ? size : VERTEX_BLOCK_MAX;
+	}
+
+	unsigned char unzigzag8(unsigned char a_value)
+	{
+		return (unsigned char)(-(a_value & 1) ^ (a_value >> 1));
+	}
+
+	unsigned char zigzag8(unsigned char a_value)
+	{
+		return (unsigned char)((a_value << 1) ^ ((signed char)a_value >> 7));
+	}
+
+	// Decodes one group of 16 bytes, each a_bits wide, with the ones that
+	//	don't fit following the packed bits.
+	const unsigned char* decodeBytesGroup(const unsigned char* a_data, unsigned char* a_bytes, int a_bitsLog2)
+	{
+		switch (a_bitsLog2)
+		{
+		case 0:
+			memset(a_bytes, 0, BYTE_GROUP_SIZE);
+			return a_data;
+		case 3:
+			memcpy(a_bytes, a_data, BYTE_GROUP_SIZE);
+			return a_data + BYTE_GROUP_SIZE;
+		default:
+		{
+			// Packed high bits first. The largest value marks a byte that
+			//	is read whole from after the packed ones.
+			unsigned int bits = a_bitsLog2 == 1 ? 2 : 4;
+			unsigned int sentinel = (1u << bits) - 1;
+			const unsigned char* extra = a_data + BYTE_GROUP_SIZE * bits / 8;
+			for (size_t i = 0; i < BYTE_GROUP_SIZE; ++i)
+			{
+				size_t bit = i * bits;
+				unsigned int value = (a_data[bit / 8] >> (8 - bits - bit % 8)) & sentinel;
+				a_bytes[i] = value == sentinel ? *extra++ : (unsigned char)value;
+			}
+			return extra;
+		}
+		}
+	}
+
+	// Decodes one byte of every vertex in a block, a_count rounded up to
+	//	whole groups. Every 4 groups share a byte of 2 bit widths.
+	const unsigned char* decodeBytes(const unsigned char* a_data, const unsigned char* a_end, unsigned char* a_bytes,
+		size_t a_count)
+	{
+		size_t headerSize = (a_count / BYTE_GROUP_SIZE + 3) / 4;
+		if ((size_t)(a_end - a_data) < headerSize)
+			return nullptr;
+		const unsigned char* header = a_data;
+		a_data += headerSize;
+
+		for (size_t i = 0; i < a_count; i += BYTE_GROUP_SIZE)
+		{
+			if ((size_t)(a_end - a_data) < BYTE_GROUP_DECODE_LIMIT)
+				return nullptr;
+			size_t group = i / BYTE_GROUP_SIZE;
+			int bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+			a_data = decodeBytesGroup(a_data, a_bytes + i, bitsLog2);
+		}
+		return a_data;
+	}
+
+	// Decodes a block of vertices, each byte the change from the same
+	//	byte of the vertex before, starting from the last block's last.
+	const unsigned char* decodeVertexBlock(const unsigned char* a_data, const unsigned char* a_end,
+		unsigned char* a_vertices, size_t a_count, size_t a_size, unsigned char* a_last)
+	{
+		unsigned char bytes[VERTEX_BLOCK_MAX];
+		size_t aligned = (a_count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+		for (size_t k = 0; k < a_size; ++k)
+		{
+			a_data = decodeBytes(a_data, a_end, bytes, aligned);
+			if (a_data == nullptr)
+				return nullptr;
+
+			unsigned char previous = a_last[k];
+			size_t i = 0;
+#ifdef SNS_CODEC_SSE
+			// Each group is unzigzagged at once and summed in four steps,
+			//	each adding the bytes 1, 2, 4 then 8 before it.
+			const __m128i ones = _mm_set1_epi8(1);
+			const __m128i low = _mm_set1_epi8(0x7f);
+			for (; i + BYTE_GROUP_SIZE <= a_count; i += BYTE_GROUP_SIZE)
+			{
+				__m128i delta = _mm_loadu_si128((const __m128i*)(bytes + i));
+				__m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(delta, ones));
+				delta = _mm_xor_si128(sign, _mm_and_si128(_mm_srli_epi16(delta, 1), low));
+				delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 1));
+				delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 2));
+				delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 4));
+				delta = _mm_add_epi8(delta, _mm_slli_si128(delta, 8));
+				delta = _mm_add_epi8(delta, _mm_set1_epi8((char)previous));
+
+				unsigned char values[BYTE_GROUP_SIZE];
+				_mm_storeu_si128((__m128i*)values, delta);
+				for (size_t j = 0; j < BYTE_GROUP_SIZE; ++j)
+					a_vertices[(i + j) * a_size + k] = values[j];
+				previous = values[BYTE_GROUP_SIZE - 1];
+			}
+#endif
+			for (; i < a_count; ++i)
+			{
+				previous = (unsigned char)(unzigzag8(bytes[i]) + previous);
+				a_vertices[i * a_size + k] = previous;
+			}
+		}
+		memcpy(a_last, a_vertices + (a_count - 1) * a_size, a_size);
+		return a_data;
+	}
+
+	// Adds a group of 16 bytes at the width decodeBytesGroup reads.
+	void encodeBytesGroup(std::vector<unsigned char>& a_result, const unsigned char* a_bytes, int a_bitsLog2)
+	{
+		if (a_bitsLog2 == 0)
+			return;
+		if (a_bitsLog2 == 3)
+		{
+			a_result.insert(a_result.end(), a_bytes, a_bytes + BYTE_GROUP_SIZE);
+			return;
+		}
+
+		unsigned int bits = a_bitsLog2 == 1 ? 2 : 4;
+		unsigned int sentinel = (1u << bits) - 1;
+		size_t packed = a_result.size();
+		a_result.resize(packed + BYTE_GROUP_SIZE * bits / 8, 0);
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; ++i)
+		{
+			size_t bit = i * bits;
+			unsigned int value = a_bytes[i] < sentinel ? a_bytes[i] : sentinel;
+			a_result[packed + bit / 8] |= (unsigned char)(value << (8 - bits - bit % 8));
+		}
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; ++i)
+		{
+			if (a_bytes[i] >= sentinel)
+				a_result.push_back(a_bytes[i]);
+		}
+	}
+
+	// Adds one byte of every vertex in a block, each group at whichever
+	//	width takes the fewest bytes.
+	void encodeBytes(std::vector<unsigned char>& a_result, const unsigned char* a_bytes, size_t a_count)
+	{
+		size_t header = a_result.size();
+		a_result.resize(header + (a_count / BYTE_GROUP_SIZE + 3) / 4, 0);
+
+		for (size_t i = 0; i < a_count; i += BYTE_GROUP_SIZE)
+		{
+			size_t sizes[4] = { 0, BYTE_GROUP_SIZE / 4, BYTE_GROUP_SIZE / 2, BYTE_GROUP_SIZE };
+			for (size_t j = 0; j < BYTE_GROUP_SIZE; ++j)
+			{
+				unsigned char value = a_bytes[i + j];
+				sizes[0] += value != 0 ? BYTE_GROUP_SIZE * 2 : 0;
+				sizes[1] += value >= 3 ? 1 : 0;
+				sizes[2] += value >= 15 ? 1 : 0;
+			}
+			int best = 0;
+			for (int bits = 1; bits < 4; ++bits)
+				best = sizes[bits] < sizes[best] ? bits : best;
+
+			size_t group = i / BYTE_GROUP_SIZE;
+			a_result[header + group / 4] |= (unsigned char)(best << ((group % 4) * 2));
+			encodeBytesGroup(a_result, a_bytes + i, best);
+		}
+	}
+
+	void encodeVByte(std::vector<unsigned char>& a_result, unsigned int a_value)
+	{
+		while (a_value >= 128)
+		{
+			a_result.push_back((unsigned char)((a_value & 127) | 128));
+			a_value >>= 7;
+		}
+		a_result.push_back((unsigned char)a_value);
+	}
+
+	void encodeIndex(std::vector<unsigned char>& a_result, unsigned int a_index, unsigned int a_last)
+	{
+		unsigned int delta = a_index - a_last;
+		encodeVByte(a_result, (delta << 1) ^ (unsigned int)((int)delta >> 31));
+	}
+
+	unsigned int decodeVByte(const unsigned char*& a_data)
+	{
+		unsigned char lead = *a_data++;
+		if (lead < 128)
+			return lead;
+
+		// Seven bits a byte, low first, while the top bit is set.
+		unsigned int result = lead & 127;
+		unsigned int shift = 7;
+		for (int i = 0; i < 4; ++i)
+		{
+			unsigned char group = *a_data++;
+			result |= (unsigned int)(group & 127) << shift;
+			shift += 7;
+			if (group < 128)
+				break;
+		}
+		return result;
+	}
+
+	unsigned int decodeIndex(const unsigned char*& a_data, unsigned int a_last)
+	{
+		unsigned int value = decodeVByte(a_data);
+		unsigned int delta = (value >> 1) ^ (0u - (value & 1));
+		return a_last + delta;
+	}
+
+	void writeIndex(void* a_destination, size_t a_offset, size_t a_indexSize, unsigned int a_index)
+	{
+		if (a_indexSize == 2)
+			((uint16_t*)a_destination)[a_offset] = (uint16_t)a_index;
+		else
+			((uint32_t*)a_destination)[a_offset] = a_index;
+	}
+
+	// The last 16 edges and vertices the triangle decoder has seen.
+	struct IndexFifos
+	{
+		unsigned int edges[16][2];
+		unsigned int vertices[16];
+		size_t edgeOffset;
+		size_t vertexOffset;
+
+		void pushEdge(unsigned int a_a, unsigned int a_b)
+		{
+			edges[edgeOffset][0] = a_a;
+			edges[edgeOffset][1] = a_b;
+			edgeOffset = (edgeOffset + 1) & 15;
+		}
+
+		void pushVertex(unsigned int a_vertex, bool a_push = true)
+		{
+			vertices[vertexOffset] = a_vertex;
+			vertexOffset = (vertexOffset + (a_push ? 1 : 0)) & 15;
+		}
+
+		// The edge a triangle's first two corners make, counted back
+		//	from the last pushed, or -1. The 16th can't be named, its
+		//	codes are those of triangles sharing no edge.
+		int findEdge(unsigned int a_a, unsigned int a_b) const
+		{
+			for (int i = 0; i < 15; ++i)
+			{
+				const unsigned int* edge = edges[(edgeOffset - 1 - i) & 15];
+				if (edge[0] == a_a && edge[1] == a_b)
+					return i;
+			}
+			return -1;
+		}
+
+		// The vertex a_skip or more back from the next to be pushed, up to
+		//	a_limit, or 0 if it isn't there.
+		int findVertex(unsigned int a_vertex, int a_skip, int a_limit) const
+		{
+			for (int i = a_skip; i < a_limit; ++i)
+			{
+				if (vertices[(vertexOffset - i) & 15] == a_vertex)
+					return i;
+			}
+			return 0;
+		}
+	};
+
+	// Rebuilds octahedral normals, x and y with z as the length they are
+	//	encoded against, into unit vectors at the same precision.
+	template <typename T>
+	void decodeOctahedral(T* a_data, size_t a_count)
+	{
+		const float max = (float)((1 << (sizeof(T) * 8 - 1)) - 1);
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			T* element = a_data + i * 4;
+			float x = (float)element[0];
+			float y = (float)element[1];
+			float z = (float)element[2] - std::fabs(x) - std::fabs(y);
+
+			// The lower half of the octahedron is folded over the upper.
+			float t = z >= 0.0f ? 0.0f : z;
+			x += x >= 0.0f ? t : -t;
+			y += y >= 0.0f ? t : -t;
+
+			float scale = max / std::sqrt(x * x + y * y + z * z);
+			element[0] = (T)(int)(x * scale + (x >= 0.0f ? 0.5f : -0.5f));
+			element[1] = (T)(int)(y * scale + (y >= 0.0f ? 0.5f : -0.5f));
+			element[2] = (T)(int)(z * scale + (z >= 0.0f ? 0.5f : -0.5f));
+		}
+	}
+
+	// Rebuilds quaternions from the three smallest components, scaled by
+	//	the range in the fourth, whose low 2 bits say which was dropped.
+	void decodeQuaternion(int16_t* a_data, size_t a_count)
+	{
+		const float scale = 1.0f / std::sqrt(2.0f);
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			int16_t* element = a_data + i * 4;
+			float range = scale / (float)(element[3] | 3);
+			float x = element[0] * range;
+			float y = element[1] * range;
+			float z = element[2] * range;
+			float ww = 1.0f - x * x - y * y - z * z;
+			float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+
+			int dropped = element[3] & 3;
+			int16_t values[4] = {
+				(int16_t)(int)(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f)),
+				(int16_t)(int)(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f)),
+				(int16_t)(int)(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f)),
+				(int16_t)(int)(w * 32767.0f + 0.5f)
+			};
+			element[(dropped + 1) & 3] = values[0];
+			element[(dropped + 2) & 3] = values[1];
+			element[(dropped + 3) & 3] = values[2];
+			element[dropped] = values[3];
+		}
+	}
+
+	// Rebuilds floats stored as a 24 bit mantissa under an 8 bit exponent.
+	void decodeExponential(uint32_t* a_data, size_t a_count)
+	{
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			int32_t mantissa = (int32_t)(a_data[i] << 8) >> 8;
+			int32_t exponent = (int32_t)a_data[i] >> 24;
+			float value = std::ldexp((float)mantissa, exponent);
+			memcpy(&a_data[i], &value, sizeof(value));
+		}
+	}
+}
+
+namespace sns
+{
+	/**
+		encodeVertexBuffer compresses vertices as decodeVertexBuffer reads
+			them.
+
+			@param1 a_result has the compressed data added to its end.
+
+			@param2 a_vertices are the vertices.
+
+			@param3 a_count is how many there are.
+
+			@param4 a_size is the bytes of a vertex, a multiple of 4 up to
+					256.
+	*/
+	void MeshCodec::encodeVertexBuffer(std::vector<unsigned char>& a_result, const void* a_vertices, size_t a_count,
+		size_t a_size)
+	{
+		const unsigned char* vertices = (const unsigned char*)a_vertices;
+		a_result.push_back(VERTEX_HEADER);
+
+		unsigned char first[256] = {};
+		if (a_count > 0)
+			memcpy(first, vertices, a_size);
+		unsigned char last[256];
+		memcpy(last, first, a_size);
+
+		size_t blockSize = getVertexBlockSize(a_size);
+		for (size_t offset = 0; offset < a_count; offset += blockSize)
+		{
+			size_t count = a_count - offset < blockSize ? a_count - offset : blockSize;
+			size_t aligned = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+			const unsigned char* block = vertices + offset * a_size;
+			for (size_t k = 0; k < a_size; ++k)
+			{
+				unsigned char bytes[VERTEX_BLOCK_MAX] = {};
+				unsigned char previous = last[k];
+				for (size_t i = 0; i < count; ++i)
+				{
+					bytes[i] = zigzag8((unsigned char)(block[i * a_size + k] - previous));
+					previous = block[i * a_size + k];
+				}
+				encodeBytes(a_result, bytes, aligned);
+			}
+			memcpy(last, block + (count - 1) * a_size, a_size);
+		}
+
+		size_t tailSize = a_size < VERTEX_TAIL_MIN ? VERTEX_TAIL_MIN : a_size;
+		a_result.insert(a_result.end(), tailSize - a_size, 0);
+		a_result.insert(a_result.end(), first, first + a_size);
+	}
+
+	/**
+		encodeIndexBuffer compresses a triangle list as decodeIndexBuffer
+			reads it. Each triangle is turned to start on an edge it
+			shares with one of the last 16, or failing that on the next
+			new vertex, so most take a single byte.
+
+			@param1 a_result has the compressed data added to its end.
+
+			@param2 a_indices are the triangles' indices.
+
+			@param3 a_count is how many there are, a multiple of 3.
+	*/
+	void MeshCodec::encodeIndexBuffer(std::vector<unsigned char>& a_result, const unsigned int* a_indices,
+		size_t a_count)
+	{
+		a_result.push_back(INDEX_HEADER | 1);
+		size_t codes = a_result.size();
+		a_result.resize(codes + a_count / 3);
+		std::vector<unsigned char> data;
+
+		IndexFifos fifos;
+		memset(fifos.edges, 0xff, sizeof(fifos.edges));
+		memset(fifos.vertices, 0xff, sizeof(fifos.vertices));
+		fifos.edgeOffset = fifos.vertexOffset = 0;
+		unsigned int next = 0;
+		unsigned int last = 0;
+
+		for (size_t i = 0; i + 2 < a_count; i += 3)
+		{
+			const unsigned int* triangle = a_indices + i;
+			int edge = -1;
+			int rotation = 0;
+			for (int r = 0; r < 3 && edge < 0; ++r)
+			{
+				edge = fifos.findEdge(triangle[r], triangle[(r + 1) % 3]);
+				rotation = r;
+			}
+
+			if (edge >= 0)
+			{
+				unsigned int a = triangle[rotation];
+				unsigned int b = triangle[(rotation + 1) % 3];
+				unsigned int c = triangle[(rotation + 2) % 3];
+
+				// The third corner is new, reused or free, as the decoder
+				//	reads it.
+				int third = 0;
+				if (c == next)
+				{
+					++next;
+					fifos.pushVertex(c);
+				}
+				else if ((third = fifos.findVertex(c, 2, 14)) != 0)
+				{
+					--third;
+					fifos.pushVertex(c, false);
+				}
+				else
+				{
+					third = c == last - 1 ? 13 : c == last + 1 ? 14 : 15;
+					if (third == 15)
+						encodeIndex(data, c, last);
+					last = c;
+					fifos.pushVertex(c);
+				}
+				fifos.pushEdge(c, b);
+				fifos.pushEdge(a, c);
+				a_result[codes + i / 3] = (unsigned char)((edge << 4) | third);
+				continue;
+			}
+
+			// No edge is shared, so start on the next new vertex if the
+			//	triangle has it.
+			rotation = triangle[1] == next ? 1 : triangle[2] == next ? 2 : 0;
+			unsigned int corners[3] = { triangle[rotation], triangle[(rotation + 1) % 3], triangle[(rotation + 2) % 3] };
+			int first = corners[0] == next ? 0 : 15;
+			unsigned int counter = next + (first == 0 ? 1 : 0);
+			int found[2];
+			for (int corner = 1; corner < 3; ++corner)
+			{
+				if (corners[corner] == counter)
+				{
+					found[corner - 1] = 0;
+					++counter;
+				}
+				else
+				{
+					int reused = fifos.findVertex(corners[corner], 1, 15);
+					found[corner - 1] = reused != 0 ? reused : 15;
+				}
+			}
+			next = counter;
+
+			unsigned char arrangement = (unsigned char)((found[0] << 4) | found[1]);
+			int entry = -1;
+			for (int t = 0; t < 14 && first == 0 && entry < 0; ++t)
+				entry = INDEX_TABLE[t] == arrangement ? t : -1;
+			if (entry >= 0)
+				a_result[codes + i / 3] = (unsigned char)(0xf0 | entry);
+			else
+			{
+				a_result[codes + i / 3] = first == 0 ? 0xfe : 0xff;
+				data.push_back(arrangement);
+			}
+
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				if ((corner == 0 ? first : found[corner - 1]) == 15)
+				{
+					encodeIndex(data, corners[corner], last);
+					last = corners[corner];
+				}
+			}
+			fifos.pushVertex(corners[0]);
+			fifos.pushVertex(corners[1], found[0] == 0 || found[0] == 15);
+			fifos.pushVertex(corners[2], found[1] == 0 || found[1] == 15);
+			fifos.pushEdge(corners[1], corners[0]);
+			fifos.pushEdge(corners[2], corners[1]);
+			fifos.pushEdge(corners[0], corners[2]);
+		}
+
+		a_result.insert(a_result.end(), data.begin(), data.end());
+		a_result.insert(a_result.end(), INDEX_TABLE, INDEX_TABLE + 16);
+	}
+
+	/**
+		decodeVertexBuffer decodes vertices, the ATTRIBUTES mode.
+
+			@param1 a_destination is room for a_count vertices.
+
+			@param2 a_count is how many vertices there are.
+
+			@param3 a_size is the bytes of a vertex, a multiple of 4 up
+					to 256.
+
+			@param4 a_buffer is the compressed data.
+
+			@param5 a_bufferSize is its size in bytes.
+
+			@return false if the data isn't vertices of that size.
+	*/
+	bool MeshCodec::decodeVertexBuffer(void* a_destination, size_t a_count, size_t a_size,
+		const unsigned char* a_buffer, size_t a_bufferSize)
+	{
+		if (a_size == 0 || a_size > 256 || a_size % 4 != 0 || a_bufferSize < 1 + a_size)
+			return false;
+		if ((a_buffer[0] & 0xf0) != VERTEX_HEADER || (a_buffer[0] & 0x0f) != 0)
+			return false;
+
+		const unsigned char* data = a_buffer + 1;
+		const unsigned char* end = a_buffer + a_bufferSize;
+		size_t tailSize = a_size < VERTEX_TAIL_MIN ? VERTEX_TAIL_MIN : a_size;
+		if ((size_t)(end - data) < tailSize)
+			return false;
+
+		// The first block's changes are from the vertex at the very end.
+		//	The tail is also what lets a group near the end be read
+		//	before its width is checked.
+		unsigned char last[256];
+		memcpy(last, end - a_size, a_size);
+
+		unsigned char* vertices = (unsigned char*)a_destination;
+		size_t blockSize = getVertexBlockSize(a_size);
+		for (size_t offset = 0; offset < a_count; offset += blockSize)
+		{
+			size_t count = a_count - offset < blockSize ? a_count - offset : blockSize;
+			data = decodeVertexBlock(data, end, vertices + offset * a_size, count, a_size, last);
+			if (data == nullptr)
+				return false;
+		}
+		return (size_t)(end - data) == tailSize;
+	}
+
+	/**
+		decodeIndexBuffer decodes a triangle list, the TRIANGLES mode.
+
+			@param1 a_destination is room for a_count indices.
+
+			@param2 a_count is how many indices there are, a multiple of 3.
+
+			@param3 a_indexSize is 2 or 4, the bytes of an index.
+
+			@param4 a_buffer is the compressed data.
+
+			@param5 a_bufferSize is its size in bytes.
+
+			@return false if the data isn't a triangle list.
+	*/
+	bool MeshCodec::decodeIndexBuffer(void* a_destination, size_t a_count, size_t a_indexSize,
+		const unsigned char* a_buffer, size_t a_bufferSize)
+	{
+		// A byte per triangle and the 16 byte table of common codes at
+		//	the end, at least.
+		if (a_count % 3 != 0 || (a_indexSize != 2 && a_indexSize != 4) || a_bufferSize < 1 + a_count / 3 + 16)
+			return false;
+		int version = a_buffer[0] & 0x0f;
+		if ((a_buffer[0] & 0xf0) != INDEX_HEADER || version > 1)
+			return false;
+
+		IndexFifos fifos;
+		memset(fifos.edges, 0xff, sizeof(fifos.edges));
+		memset(fifos.vertices, 0xff, sizeof(fifos.vertices));
+		fifos.edgeOffset = fifos.vertexOffset = 0;
+		unsigned int next = 0;
+		unsigned int last = 0;
+
+		// Version 1 spends codes 13 and 14 on the last free index plus
+		//	or minus one.
+		int reusedLimit = version >= 1 ? 13 : 15;
+
+		const unsigned char* codes = a_buffer + 1;
+		const unsigned char* data = codes + a_count / 3;
+		const unsigned char* end = a_buffer + a_bufferSize - 16;
+		const unsigned char* table = end;
+
+		for (size_t i = 0; i < a_count; i += 3)
+		{
+			if (data > end)
+				return false;
+			unsigned char code = *codes++;
+			unsigned int a, b, c;
+
+			if (code < 0xf0)
+			{
+				// An edge from the fifo, and a third vertex that is new,
+				//	from the fifo or free.
+				const unsigned int* edge = fifos.edges[(fifos.edgeOffset - 1 - (code >> 4)) & 15];
+				a = edge[0];
+				b = edge[1];
+				int third = code & 15;
+				if (third < reusedLimit)
+				{
+					c = third == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - 1 - third) & 15];
+					fifos.pushVertex(c, third == 0);
+				}
+				else
+				{
+					c = last = third != 15 ? last + (third == 13 ? 0u - 1u : 1u) : decodeIndex(data, last);
+					fifos.pushVertex(c);
+				}
+				fifos.pushEdge(c, b);
+				fifos.pushEdge(a, c);
+			}
+			else
+			{
+				// No edge is reused. The common arrangements are in the
+				//	table, the rest spend a byte on it.
+				int first, second, third;
+				unsigned char arrangement;
+				if (code < 0xfe)
+				{
+					arrangement = table[code & 15];
+					first = 0;
+				}
+				else
+				{
+					arrangement = *data++;
+					first = code == 0xfe ? 0 : 15;
+					if (arrangement == 0)
+						next = 0;
+				}
+				second = arrangement >> 4;
+				third = arrangement & 15;
+
+				// next moves on for every new vertex before any free one
+				//	is read, as the encoder did.
+				a = first == 0 ? next++ : 0;
+				b = second == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - second) & 15];
+				c = third == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - third) & 15];
+				if (first == 15)
+					last = a = decodeIndex(data, last);
+				if (second == 15)
+					last = b = decodeIndex(data, last);
+				if (third == 15)
+					last = c = decodeIndex(data, last);
+
+				fifos.pushVertex(a);
+				fifos.pushVertex(b, second == 0 || second == 15);
+				fifos.pushVertex(c, third == 0 || third == 15);
+				fifos.pushEdge(b, a);
+				fifos.pushEdge(c, b);
+				fifos.pushEdge(a, c);
+			}
+
+			writeIndex(a_destination, i, a_indexSize, a);
+			writeIndex(a_destination, i + 1, a_indexSize, b);
+			writeIndex(a_destination, i + 2, a_indexSize, c);
+		}
+
+		// Every byte up to the table is read, or the data is wrong.
+		return data == end;
+	}
+
+	/**
+		decodeIndexSequence decodes any other list of indices, the
+			INDICES mode.
+
+			@param1 a_destination is room for a_count indices.
+
+			@param2 a_count is how many indices there are.
+
+			@param3 a_indexSize is 2 or 4, the bytes of an index.
+
+			@param4 a_buffer is the compressed data.
+
+			@param5 a_bufferSize is its size in bytes.
+
+			@return false if the data isn't an index list.
+	*/
+	bool MeshCodec::decodeIndexSequence(void* a_destination, size_t a_count, size_t a_indexSize,
+		const unsigned char* a_buffer, size_t a_bufferSize)
+	{
+		// A byte per index and a 4 byte tail, at least.
+		if ((a_indexSize != 2 && a_indexSize != 4) || a_bufferSize < 1 + a_count + 4)
+			return false;
+		if ((a_buffer[0] & 0xf0) != SEQUENCE_HEADER || (a_buffer[0] & 0x0f) > 1)
+			return false;
+
+		const unsigned char* data = a_buffer + 1;
+		const unsigned char* end = a_buffer + a_bufferSize - 4;
+
+		// Each index is a change from one of the last two, the low bit
+		//	saying which, so two interleaved runs both stay small.
+		unsigned int last[2] = {};
+		for (size_t i = 0; i < a_count; ++i)
+		{
+			if (data >= end)
+				return false;
+			unsigned int value = decodeVByte(data);
+			unsigned int& baseline = last[value & 1];
+			value >>= 1;
+			baseline += (value >> 1) ^ (0u - (value & 1));
+			writeIndex(a_destination, i, a_indexSize, baseline);
+		}
+		return data == end;
+	}
+
+	/**
+		decodeFilter undoes a filter in place, once the vertices are
+			decoded.
+
+			@param1 a_filter is the filter.
+
+			@param2 a_data is the decoded vertices.
+
+			@param3 a_count is how many there are.
+
+			@param4 a_size is the bytes of a vertex. Octahedral takes 4
+					or 8, quaternions 8 and exponents any multiple of 4.
+
+			@return false if the filter doesn't take vertices of that
+					size.
+	*/
+	bool MeshCodec::decodeFilter(Filter a_filter, void* a_data, size_t a_count, size_t a_size)
+	{
+		switch (a_filter)
+		{
+		case FILTER_NONE:
+			return true;
+		case FILTER_OCTAHEDRAL:
+			if (a_size == 4)
+				decodeOctahedral((int8_t*)a_data, a_count);
+			else if (a_size == 8)
+				decodeOctahedral((int16_t*)a_data, a_count);
+			else
+				return false;
+			return true;
+		case FILTER_QUATERNION:
+			if (a_size != 8)
+				return false;
+			decodeQuaternion((int16_t*)a_data, a_count);
+			return true;
+		case FILTER_EXPONENTIAL:
+			if (a_size % 4 != 0)
+				return false;
+			decodeExponential((uint32_t*)a_data, a_count * a_size / 4);
+			return true;
+		default:
+			return false;
+		}
+	}
+}
@@ -0,0 +1,163 @@
+/**
+	MeshCodec.h
+
+	Purpose: MeshCodec.h is the header file for the MeshCodec class. The
+			MeshCodec decodes vertex and index data compressed the way
+			meshoptimizer compresses it, as glTF models carry it in
+			buffer views with EXT_meshopt_compression.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The MeshCodec class reads the three meshoptimizer formats and its
+			filters, bit for bit as meshoptimizer writes them:
+
+		Vertices are cut into blocks of up to 256, and each byte of the
+			vertex is stored for a whole block at a time, as the change
+			from the vertex before, zigzagged so small changes either
+			way are small numbers. Each 16 of those take 0, 2, 4 or 8
+			bits, the few that don't fit following as whole bytes.
+
+		Triangles are stored a byte each, naming which of the last 16
+			edges and vertices they reuse, with any index not reused
+			following as a varint. Other index lists are varint changes
+			from one of the last two indices.
+
+		The filters undo what was done to the vertices before they were
+			compressed: octahedral normals, quaternions with their
+			largest component dropped and floats with a shared exponent.
+
+		Every decode checks its input, and returns false rather than
+			read past it or write past the output. The vertex decode
+			undoes the changes from vertex to vertex 16 at a time with
+			SSE2, where there is SSE2.
+
+		The encoders write the same formats, for the binary mesh cache.
+			The vertices compress best laid out so neighbours are
+			alike, and the triangles once ordered for the vertex cache,
+			as MeshOptimiser leaves them.
+	*/
+	class MeshCodec
+	{
+	public:
+		// How an EXT_meshopt_compression buffer view was filtered.
+		enum Filter
+		{
+			FILTER_NONE = 0,
+			FILTER_OCTAHEDRAL,
+			FILTER_QUATERNION,
+			FILTER_EXPONENTIAL
+		};
+
+		/**
+			encodeVertexBuffer compresses vertices as decodeVertexBuffer
+				reads them.
+
+				@param1 a_result has the compressed data added to its end.
+
+				@param2 a_vertices are the vertices.
+
+				@param3 a_count is how many there are.
+
+				@param4 a_size is the bytes of a vertex, a multiple of 4
+						up to 256.
+		*/
+		static void encodeVertexBuffer(std::vector<unsigned char>& a_result, const void* a_vertices, size_t a_count,
+			size_t a_size);
+
+		/**
+			encodeIndexBuffer compresses a triangle list as
+				decodeIndexBuffer reads it.
+
+				@param1 a_result has the compressed data added to its end.
+
+				@param2 a_indices are the triangles' indices.
+
+				@param3 a_count is how many there are, a multiple of 3.
+		*/
+		static void encodeIndexBuffer(std::vector<unsigned char>& a_result, const unsigned int* a_indices,
+			size_t a_count);
+
+		/**
+			decodeVertexBuffer decodes vertices, the ATTRIBUTES mode.
+
+				@param1 a_destination is room for a_count vertices.
+
+				@param2 a_count is how many vertices there are.
+
+				@param3 a_size is the bytes of a vertex, a multiple of 4
+						up to 256.
+
+				@param4 a_buffer is the compressed data.
+
+				@param5 a_bufferSize is its size in bytes.
+
+				@return false if the data isn't vertices of that size.
+		*/
+		static bool decodeVertexBuffer(void* a_destination, size_t a_count, size_t a_size,
+			const unsigned char* a_buffer, size_t a_bufferSize);
+
+		/**
+			decodeIndexBuffer decodes a triangle list, the TRIANGLES mode.
+
+				@param1 a_destination is room for a_count indices.
+
+				@param2 a_count is how many indices there are, a multiple
+						of 3.
+
+				@param3 a_indexSize is 2 or 4, the bytes of an index.
+
+				@param4 a_buffer is the compressed data.
+
+				@param5 a_bufferSize is its size in bytes.
+
+				@return false if the data isn't a triangle list.
+		*/
+		static bool decodeIndexBuffer(void* a_destination, size_t a_count, size_t a_indexSize,
+			const unsigned char* a_buffer, size_t a_bufferSize);
+
+		/**
+			decodeIndexSequence decodes any other list of indices, the
+				INDICES mode.
+
+				@param1 a_destination is room for a_count indices.
+
+				@param2 a_count is how many indices there are.
+
+				@param3 a_indexSize is 2 or 4, the bytes of an index.
+
+				@param4 a_buffer is the compressed data.
+
+				@param5 a_bufferSize is its size in bytes.
+
+				@return false if the data isn't an index list.
+		*/
+		static bool decodeIndexSequence(void* a_destination, size_t a_count, size_t a_indexSize,
+			const unsigned char* a_buffer, size_t a_bufferSize);
+
+		/**
+			decodeFilter undoes a filter in place, once the vertices are
+				decoded.
+
+				@param1 a_filter is the filter.
+
+				@param2 a_data is the decoded vertices.
+
+				@param3 a_count is how many there are.
+
+				@param4 a_size is the bytes of a vertex. Octahedral takes
+						4 or 8, quaternions 8 and exponents any multiple
+						of 4.
+
+				@return false if the filter doesn't take vertices of that
+						size.
+		*/
+		static bool decodeFilter(Filter a_filter, void* a_data, size_t a_count, size_t a_size);
+	};
+}
@@ -0,0 +1,705 @@
+/**
+	MeshOptimiser.cpp
+
+	Purpose: MeshOptimiser.cpp is the source file for the MeshOptimiser
+			class. The MeshOptimiser welds and reorders the vertices and
+			triangles of an imported mesh so the gpu fetches and shades
+			each vertex as few times as it can.
+
+	@author Nathan Nette
+*/
+#include "MeshOptimiser.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+namespace sns
+{
+	/**
+		optimise runs every pass over one chunk.
+
+			@param1 a_vertices are the chunk's vertices, replaced by the
+					welded and reordered ones.
+
+			@param2 a_indices are the chunk's triangles, rewritten to match.
+
+			@return the vertex count and cache miss ratio before and after.
+	*/
+	MeshOptimiser::Stats MeshOptimiser::optimise(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		Stats stats;
+		stats.verticesBefore = (unsigned int)a_vertices.size();
+		stats.acmrBefore = calculateACMR(a_indices, stats.verticesBefore);
+
+		weld(a_vertices, a_indices);
+		optimiseVertexCache(a_indices, (unsigned int)a_vertices.size());
+		optimiseVertexFetch(a_vertices, a_indices);
+
+		stats.verticesAfter = (unsigned int)a_vertices.size();
+		stats.acmrAfter = calculateACMR(a_indices, stats.verticesAfter);
+		return stats;
+	}
+
+	/**
+		weld merges vertices that are exactly the same.
+
+			@param1 a_vertices are the vertices, left with only one of each.
+
+			@param2 a_indices are the triangles, pointed at the ones kept.
+	*/
+	void MeshOptimiser::weld(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		typedef aie::OBJMesh::Vertex Vertex;
+		const unsigned int EMPTY = 0xffffffff;
+
+		unsigned int vertexCount = (unsigned int)a_vertices.size();
+		if (vertexCount == 0)
+			return;
+
+		// An open addressed table of kept vertices, at most half full.
+		unsigned int tableSize = 1;
+		while (tableSize < vertexCount * 2)
+			tableSize *= 2;
+		std::vector<unsigned int> table(tableSize, EMPTY);
+
+		std::vector<unsigned int> remap(vertexCount);
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < vertexCount; ++i)
+		{
+			// FNV-1a over the vertex's bytes.
+			const unsigned char* bytes = (const unsigned char*)&a_vertices[i];
+			unsigned int hash = 2166136261u;
+			for (size_t b = 0; b < sizeof(Vertex); ++b)
+			{
+				hash ^= bytes[b];
+				hash *= 16777619u;
+			}
+
+			unsigned int slot = hash & (tableSize - 1);
+			while (table[slot] != EMPTY && memcmp(&a_vertices[table[slot]], &a_vertices[i], sizeof(Vertex)) != 0)
+				slot = (slot + 1) & (tableSize - 1);
+
+			if (table[slot] == EMPTY)
+			{
+				// Kept vertices move down over the merged ones, never past
+				//	a vertex still to be read.
+				a_vertices[kept] = a_vertices[i];
+				table[slot] = kept++;
+			}
+			remap[i] = table[slot];
+		}
+
+		a_vertices.resize(kept);
+		for (unsigned int& index : a_indices)
+			index = remap[index];
+	}
+
+	/**
+		optimiseVertexCache reorders triangles for the post-transform
+			cache with Tipsify, linear in the triangle count. It fans
+			around one vertex at a time, then moves to the vertex
+			already in the cache with the most triangles left, falling
+			back to recently used vertices at a dead end.
+
+			@param1 a_indices are the triangles, reordered in place.
+
+			@param2 a_vertexCount is how many vertices they index.
+	*/
+	void MeshOptimiser::optimiseVertexCache(std::vector<unsigned int>& a_indices, unsigned int a_vertexCount)
+	{
+		unsigned int triangleCount = (unsigned int)a_indices.size() / 3;
+		if (triangleCount == 0 || a_vertexCount == 0)
+			return;
+
+		// Every vertex's triangles, packed one vertex after another.
+		std::vector<unsigned int> live(a_vertexCount, 0);
+		for (unsigned int i = 0; i < triangleCount * 3; ++i)
+			++live[a_indices[i]];
+
+		std::vector<unsigned int> offsets(a_vertexCount + 1, 0);
+		for (unsigned int v = 0; v < a_vertexCount; ++v)
+			offsets[v + 1] = offsets[v] + live[v];
+
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (unsigned int i = 0; i < triangleCount * 3; ++i)
+			adjacency[fill[a_indices[i]]++] = i / 3;
+
+		// A vertex is in the cache while time - cacheTime is under CACHE_SIZE.
+		std::vector<unsigned int> cacheTime(a_vertexCount, 0);
+		std::vector<unsigned char> emitted(triangleCount, 0);
+		std::vector<unsigned int> deadEnd;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> output;
+		output.reserve(a_indices.size());
+
+		unsigned int time = CACHE_SIZE + 1;
+		unsigned int cursor = 0;
+		int fanning = 0;
+		while (fanning >= 0)
+		{
+			candidates.clear();
+			for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; ++a)
+			{
+				unsigned int triangle = adjacency[a];
+				if (emitted[triangle] != 0)
+					continue;
+
+				for (unsigned int corner = 0; corner < 3; ++corner)
+				{
+					unsigned int v = a_indices[triangle * 3 + corner];
+					output.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					--live[v];
+					if (time - cacheTime[v] > CACHE_SIZE)
+						cacheTime[v] = time++;
+				}
+				emitted[triangle] = 1;
+			}
+
+			// The candidate that will still be cached once its triangles
+			//	are emitted, and has been cached the longest.
+			int next = -1;
+			int bestPriority = -1;
+			for (unsigned int v : candidates)
+			{
+				if (live[v] == 0)
+					continue;
+
+				int priority = 0;
+				if (time - cacheTime[v] + 2 * live[v] <= CACHE_SIZE)
+					priority = (int)(time - cacheTime[v]);
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = (int)v;
+				}
+			}
+
+			// Otherwise the most recent vertex with triangles left, then
+			//	the next one in index order.
+			while (next < 0 && deadEnd.empty() == false)
+			{
+				unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					next = (int)v;
+			}
+			while (next < 0 && cursor < a_vertexCount)
+			{
+				if (live[cursor] > 0)
+					next = (int)cursor;
+				++cursor;
+			}
+			fanning = next;
+		}
+
+		a_indices.swap(output);
+	}
+
+	/**
+		optimiseVertexFetch reorders vertices into the order the
+			triangles first use them, dropping any that are unused.
+
+			@param1 a_vertices are the vertices, reordered.
+
+			@param2 a_indices are the triangles, pointed at the new order.
+	*/
+	void MeshOptimiser::optimiseVertexFetch(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		const unsigned int UNUSED = 0xffffffff;
+
+		std::vector<unsigned int> remap(a_vertices.size(), UNUSED);
+		std::vector<aie::OBJMesh::Vertex> ordered;
+		ordered.reserve(a_vertices.size());
+		for (unsigned int& index : a_indices)
+		{
+			if (remap[index] == UNUSED)
+			{
+				remap[index] = (unsigned int)ordered.size();
+				ordered.push_back(a_vertices[index]);
+			}
+			index = remap[index];
+		}
+		a_vertices.swap(ordered);
+	}
+
+	/**
+		calculateACMR simulates a FIFO post-transform cache.
+
+			@param1 a_indices are the triangles.
+
+			@param2 a_vertexCount is how many vertices they index.
+
+			@return the vertices shaded per triangle.
+	*/
+	float MeshOptimiser::calculateACMR(const std::vector<unsigned int>& a_indices, unsigned int a_vertexCount)
+	{
+		unsigned int triangleCount = (unsigned int)a_indices.size() / 3;
+		if (triangleCount == 0)
+			return 0.0f;
+
+		// A miss pushes the vertex in at the current time, it stays for
+		//	the next CACHE_SIZE misses.
+		std::vector<unsigned int> cacheTime(a_vertexCount, 0);
+		unsigned int time = CACHE_SIZE + 1;
+		unsigned int misses = 0;
+		for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		{
+			unsigned int v = a_indices[i];
+			if (time - cacheTime[v] > CACHE_SIZE)
+			{
+				cacheTime[v] = time++;
+				++misses;
+			}
+		}
+		return (float)misses / triangleCount;
+	}
+
+	/**
+		split cuts a chunk into pieces of at most a_maxVertices, walking
+			the triangles in order so that after optimise each piece is
+			a connected patch. Vertices on a cut are copied into both
+			pieces.
+
+			@param1 a_vertices are the chunk's vertices.
+
+			@param2 a_indices are the chunk's triangles.
+
+			@param3 a_maxVertices is the most vertices a piece can have.
+
+			@param4 a_pieceVertices receives each piece's vertices.
+
+			@param5 a_pieceIndices receives each piece's triangles,
+					indexing its own vertices.
+	*/
+	void MeshOptimiser::split(const std::vector<aie::OBJMesh::Vertex>& a_vertices, const std::vector<unsigned int>& a_indices,
+		unsigned int a_maxVertices, std::vector<std::vector<aie::OBJMesh::Vertex>>& a_pieceVertices,
+		std::vector<std::vector<unsigned int>>& a_pieceIndices)
+	{
+		a_pieceVertices.clear();
+		a_pieceIndices.clear();
+
+		// Where each vertex went in the current piece, valid while its
+		//	stamp is the piece's.
+		std::vector<unsigned int> local(a_vertices.size(), 0);
+		std::vector<unsigned int> stamp(a_vertices.size(), 0);
+		unsigned int piece = 0;
+
+		for (unsigned int i = 0; i + 2 < (unsigned int)a_indices.size(); i += 3)
+		{
+			// A triangle can bring up to three new vertices.
+			if (a_pieceVertices.empty() || a_pieceVertices.back().size() + 3 > a_maxVertices)
+			{
+				a_pieceVertices.emplace_back();
+				a_pieceIndices.emplace_back();
+				++piece;
+			}
+
+			std::vector<aie::OBJMesh::Vertex>& vertices = a_pieceVertices.back();
+			std::vector<unsigned int>& indices = a_pieceIndices.back();
+			for (unsigned int corner = 0; corner < 3; ++corner)
+			{
+				unsigned int v = a_indices[i + corner];
+				if (stamp[v] != piece)
+				{
+					stamp[v] = piece;
+					local[v] = (unsigned int)vertices.size();
+					vertices.push_back(a_vertices[v]);
+				}
+				indices.push_back(local[v]);
+			}
+		}
+	}
+
+	/**
+		simplify collapses edges by quadric error until the triangles are
+			down to a target or the next collapse would move the surface
+			further than an error limit. Each pass sorts every possible
+			collapse by cost and takes the cheapest ones whose neighbours
+			are untouched so far in the pass, skipping any that would flip
+			a triangle.
+
+			@param1 a_vertices are the chunk's vertices.
+
+			@param2 a_indices are the triangles to simplify.
+
+			@param3 a_targetIndexCount is how many indices to aim for.
+
+			@param4 a_maxError is the furthest the surface may move, in
+					the mesh's units.
+
+			@param5 a_result receives the simplified triangles.
+	*/
+	void MeshOptimiser::simplify(const std::vector<aie::OBJMesh::Vertex>& a_vertices, const std::vector<unsigned int>& a_indices,
+		unsigned int a_targetIndexCount, float a_maxError, std::vector<unsigned int>& a_result)
+	{
+		// The sum of squared distances to a set of planes, as the
+		//	symmetric 4x4 matrix of their plane equations.
+		struct Quadric
+		{
+			double a00, a01, a02, a11, a12, a22, b0, b1, b2, c;
+
+			void addPlane(const glm::dvec3& a_normal, double a_distance)
+			{
+				a00 += a_normal.x * a_normal.x; a01 += a_normal.x * a_normal.y; a02 += a_normal.x * a_normal.z;
+				a11 += a_normal.y * a_normal.y; a12 += a_normal.y * a_normal.z; a22 += a_normal.z * a_normal.z;
+				b0 += a_normal.x * a_distance; b1 += a_normal.y * a_distance; b2 += a_normal.z * a_distance;
+				c += a_distance * a_distance;
+			}
+
+			void add(const Quadric& a_other)
+			{
+				a00 += a_other.a00; a01 += a_other.a01; a02 += a_other.a02;
+				a11 += a_other.a11; a12 += a_other.a12; a22 += a_other.a22;
+				b0 += a_other.b0; b1 += a_other.b1; b2 += a_other.b2;
+				c += a_other.c;
+			}
+
+			double error(const glm::dvec3& a_point) const
+			{
+				const glm::dvec3& p = a_point;
+				return a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z +
+					a11 * p.y * p.y + 2 * a12 * p.y * p.z + a22 * p.z * p.z +
+					2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+			}
+		};
+
+		// A collapse moving one vertex onto another.
+		struct Collapse
+		{
+			double cost;
+			unsigned int from;
+			unsigned int to;
+		};
+
+		unsigned int vertexCount = (unsigned int)a_vertices.size();
+		a_result = a_indices;
+		if (a_result.size() <= a_targetIndexCount || vertexCount == 0)
+			return;
+
+		std::vector<glm::dvec3> positions(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; ++v)
+			positions[v] = glm::dvec3(a_vertices[v].position);
+
+		// Every vertex's triangles, rebuilt each pass from a_result.
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> adjacency;
+		auto buildAdjacency = [&]()
+		{
+			offsets.assign(vertexCount + 1, 0);
+			for (unsigned int index : a_result)
+				++offsets[index + 1];
+			for (unsigned int v = 0; v < vertexCount; ++v)
+				offsets[v + 1] += offsets[v];
+
+			adjacency.resize(a_result.size());
+			std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+			for (unsigned int i = 0; i < (unsigned int)a_result.size(); ++i)
+				adjacency[fill[a_result[i]]++] = i / 3;
+		};
+		buildAdjacency();
+
+		// Vertices sharing a position with another vertex are on a seam.
+		std::vector<unsigned char> locked(vertexCount, 0);
+		{
+			std::vector<unsigned int> order(vertexCount);
+			for (unsigned int v = 0; v < vertexCount; ++v)
+				order[v] = v;
+			std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+			{
+				const glm::vec4& pa = a_vertices[a].position;
+				const glm::vec4& pb = a_vertices[b].position;
+				if (pa.x != pb.x)
+					return pa.x < pb.x;
+				if (pa.y != pb.y)
+					return pa.y < pb.y;
+				return pa.z < pb.z;
+			});
+			for (unsigned int i = 1; i < vertexCount; ++i)
+			{
+				if (glm::vec3(a_vertices[order[i]].position) == glm::vec3(a_vertices[order[i - 1]].position))
+					locked[order[i]] = locked[order[i - 1]] = 1;
+			}
+		}
+
+		// An edge only one triangle uses is on a boundary.
+		for (unsigned int a = 0; a < vertexCount; ++a)
+		{
+			for (unsigned int t = offsets[a]; t < offsets[a + 1] && locked[a] == 0; ++t)
+			{
+				const unsigned int* triangle = &a_result[adjacency[t] * 3];
+				for (unsigned int corner = 0; corner < 3; ++corner)
+				{
+					unsigned int b = triangle[corner];
+					if (b == a)
+						continue;
+
+					unsigned int shared = 0;
+					for (unsigned int u = offsets[a]; u < offsets[a + 1]; ++u)
+					{
+						const unsigned int* other = &a_result[adjacency[u] * 3];
+						if (other[0] == b || other[1] == b || other[2] == b)
+							++shared;
+					}
+					if (shared == 1)
+						locked[a] = locked[b] = 1;
+				}
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount, Quadric());
+		for (unsigned int i = 0; i + 2 < (unsigned int)a_result.size(); i += 3)
+		{
+			const glm::dvec3& p0 = positions[a_result[i]];
+			glm::dvec3 normal = glm::cross(positions[a_result[i + 1]] - p0, positions[a_result[i + 2]] - p0);
+			double length = glm::length(normal);
+			if (length == 0)
+				continue;
+
+			normal /= length;
+			for (unsigned int corner = 0; corner < 3; ++corner)
+				quadrics[a_result[i + corner]].addPlane(normal, -glm::dot(normal, p0));
+		}
+
+		double maxCost = (double)a_maxError * a_maxError;
+		std::vector<Collapse> collapses;
+		std::vector<unsigned int> remap(vertexCount);
+		std::vector<unsigned char> touched(vertexCount);
+		while (a_result.size() > a_targetIndexCount)
+		{
+			// Each edge collapses toward its cheaper end, if either can move.
+			collapses.clear();
+			for (unsigned int i = 0; i < (unsigned int)a_result.size(); ++i)
+			{
+				unsigned int a = a_result[i];
+				unsigned int b = a_result[i - i % 3 + (i + 1) % 3];
+
+				Quadric sum = quadrics[a];
+				sum.add(quadrics[b]);
+				double costAB = locked[a] == 0 ? sum.error(positions[b]) : DBL_MAX;
+				double costBA = locked[b] == 0 ? sum.error(positions[a]) : DBL_MAX;
+
+				if (costAB <= costBA && costAB <= maxCost)
+					collapses.push_back({ costAB, a, b });
+				else if (costBA < costAB && costBA <= maxCost)
+					collapses.push_back({ costBA, b, a });
+			}
+			if (collapses.empty())
+				break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+			{
+				return a.cost < b.cost;
+			});
+
+			for (unsigned int v = 0; v < vertexCount; ++v)
+				remap[v] = v;
+			std::fill(touched.begin(), touched.end(), 0);
+
+			// Each collapse removes about two triangles.
+			unsigned int wanted = ((unsigned int)a_result.size() - a_targetIndexCount) / 6 + 1;
+			unsigned int collapsed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapsed >= wanted)
+					break;
+				if (touched[collapse.from] != 0 || touched[collapse.to] != 0)
+					continue;
+
+				// Moving the vertex mustn't turn any of its triangles over,
+				//	or stand one on its edge.
+				bool flips = false;
+				for (unsigned int t = offsets[collapse.from]; t < offsets[collapse.from + 1] && flips == false; ++t)
+				{
+					const unsigned int* triangle = &a_result[adjacency[t] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+						continue;
+
+					glm::dvec3 before[3];
+					glm::dvec3 after[3];
+					for (unsigned int corner = 0; corner < 3; ++corner)
+					{
+						before[corner] = positions[triangle[corner]];
+						after[corner] = triangle[corner] == collapse.from ? positions[collapse.to] : before[corner];
+					}
+					glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+					glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+					double lengths = glm::length(normalBefore) * glm::length(normalAfter);
+					flips = lengths == 0 || glm::dot(normalBefore, normalAfter) < 0.25 * lengths;
+				}
+				if (flips)
+					continue;
+
+				// The vertex's whole ring sits out the rest of the pass so
+				//	the adjacency stays true.
+				for (unsigned int t = offsets[collapse.from]; t < offsets[collapse.from + 1]; ++t)
+				{
+					const unsigned int* triangle = &a_result[adjacency[t] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				++collapsed;
+			}
+			if (collapsed == 0)
+				break;
+
+			// Triangles that lost a corner are gone.
+			unsigned int kept = 0;
+			for (unsigned int i = 0; i + 2 < (unsigned int)a_result.size(); i += 3)
+			{
+				unsigned int a = remap[a_result[i]];
+				unsigned int b = remap[a_result[i + 1]];
+				unsigned int c = remap[a_result[i + 2]];
+				if (a == b || b == c || c == a)
+					continue;
+				a_result[kept++] = a;
+				a_result[kept++] = b;
+				a_result[kept++] = c;
+			}
+			a_result.resize(kept);
+			buildAdjacency();
+		}
+	}
+
+	/**
+		boundMeshlet works out the bounding sphere and normal cone of a
+			run of triangles.
+
+			@param1 a_vertices are the chunk's vertices.
+
+			@param2 a_indices are the chunk's triangles.
+
+			@param3 a_firstIndex is where the run starts.
+
+			@param4 a_indexCount is how long it is.
+
+			@return the meshlet.
+	*/
+	static aie::OBJMesh::Meshlet boundMeshlet(const aie::OBJMesh::Vertex* a_vertices, const unsigned int* a_indices,
+		unsigned int a_firstIndex, unsigned int a_indexCount)
+	{
+		const unsigned int* indices = a_indices + a_firstIndex;
+
+		// The sphere is around the box, a little looser than the smallest.
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (unsigned int i = 0; i < a_indexCount; ++i)
+		{
+			glm::vec3 position(a_vertices[indices[i]].position);
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+		glm::vec3 centre = (boundsMin + boundsMax) * 0.5f;
+		float radius = 0;
+		for (unsigned int i = 0; i < a_indexCount; ++i)
+			radius = glm::max(radius, glm::distance(centre, glm::vec3(a_vertices[indices[i]].position)));
+
+		// The cone's axis is the average face normal, and it is as wide as
+		//	the normal furthest from it.
+		std::vector<glm::vec3> normals;
+		normals.reserve(a_indexCount / 3);
+		glm::vec3 axis(0);
+		for (unsigned int i = 0; i < a_indexCount; i += 3)
+		{
+			glm::vec3 a(a_vertices[indices[i]].position);
+			glm::vec3 normal = glm::cross(glm::vec3(a_vertices[indices[i + 1]].position) - a,
+				glm::vec3(a_vertices[indices[i + 2]].position) - a);
+			float length = glm::length(normal);
+			if (length > 0)
+			{
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+		float axisLength = glm::length(axis);
+		float minDot = -1;
+		if (axisLength > 0)
+		{
+			axis /= axisLength;
+			minDot = 1;
+			for (const glm::vec3& normal : normals)
+				minDot = glm::min(minDot, glm::dot(axis, normal));
+		}
+
+		// Every triangle faces away once the view direction is closer to
+		//	the axis than 90 degrees less the cone's angle, so the cutoff is
+		//	the sine of that angle. A cone 90 degrees or wider never culls.
+		float cutoff = minDot > 0 ? sqrtf(1 - minDot * minDot) : 1.0f;
+
+		aie::OBJMesh::Meshlet meshlet;
+		meshlet.sphere = glm::vec4(centre, radius);
+		meshlet.cone = glm::vec4(axis, cutoff);
+		meshlet.firstIndex = a_firstIndex;
+		meshlet.indexCount = a_indexCount;
+		return meshlet;
+	}
+
+	/**
+		buildMeshlets cuts triangles into meshlets of at most
+			MESHLET_VERTICES and MESHLET_TRIANGLES, walking them in order
+			so after optimiseVertexCache each is a small connected patch.
+			The triangles aren't moved, a meshlet is a run of the index
+			buffer.
+
+			@param1 a_vertices are the chunk's vertices.
+
+			@param2 a_vertexCount is how many there are.
+
+			@param3 a_indices are the triangles.
+
+			@param4 a_indexCount is how many indices to cut up.
+
+			@param5 a_meshlets receives the meshlets and their bounds.
+	*/
+	void MeshOptimiser::buildMeshlets(const aie::OBJMesh::Vertex* a_vertices, unsigned int a_vertexCount,
+		const unsigned int* a_indices, unsigned int a_indexCount, std::vector<aie::OBJMesh::Meshlet>& a_meshlets)
+	{
+		a_meshlets.clear();
+		a_indexCount -= a_indexCount % 3;
+
+		// The meshlet each vertex was last counted in, so shared ones
+		//	are only counted once.
+		std::vector<unsigned int> counted(a_vertexCount, UINT_MAX);
+		unsigned int meshlet = 0;
+		unsigned int firstIndex = 0;
+		unsigned int vertexCount = 0;
+
+		for (unsigned int i = 0; i < a_indexCount; i += 3)
+		{
+			unsigned int added = 0;
+			for (unsigned int k = 0; k < 3; ++k)
+				added += counted[a_indices[i + k]] != meshlet ? 1 : 0;
+
+			// Start a new meshlet when this triangle doesn't fit, or when
+			//	it jumps somewhere else and the meshlet is already a fair
+			//	size, which keeps the spheres tight.
+			bool full = vertexCount + added > MESHLET_VERTICES || i - firstIndex == MESHLET_TRIANGLES * 3;
+			bool jumped = added == 3 && i - firstIndex >= MESHLET_TRIANGLES * 3 / 2;
+			if (full || jumped)
+			{
+				a_meshlets.push_back(boundMeshlet(a_vertices, a_indices, firstIndex, i - firstIndex));
+				firstIndex = i;
+				vertexCount = 0;
+				++meshlet;
+			}
+
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				if (counted[a_indices[i + k]] != meshlet)
+				{
+					counted[a_indices[i + k]] = meshlet;
+					++vertexCount;
+				}
+			}
+		}
+
+		if (firstIndex < a_indexCount)
+			a_meshlets.push_back(boundMeshlet(a_vertices, a_indices, firstIndex, a_indexCount - firstIndex));
+	}
+}
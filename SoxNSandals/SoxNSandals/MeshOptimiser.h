@@ -0,0 +1,166 @@
+/**
+	MeshOptimiser.h
+
+	Purpose: MeshOptimiser.h is the header file for the MeshOptimiser
+			class. The MeshOptimiser welds and reorders the vertices and
+			triangles of an imported mesh so the gpu fetches and shades
+			each vertex as few times as it can.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "OBJMesh.h"
+#include <vector>
+
+namespace sns
+{
+	/**
+		The MeshOptimiser class runs the import time passes, in the order
+			optimise calls them: weld merges identical vertices,
+			optimiseVertexCache reorders triangles with Tipsify so their
+			vertices are still in the post-transform cache when reused,
+			and optimiseVertexFetch reorders the vertices into the order
+			the triangles first use them.
+
+		The cache is measured as the average cache miss ratio, the
+			vertices shaded per triangle. 3 is every vertex missing and
+			0.5 is about the best a large regular mesh can reach.
+	*/
+	class MeshOptimiser
+	{
+	public:
+		// The post-transform cache size the triangles are ordered for,
+		//	and measured with.
+		static const unsigned int CACHE_SIZE = 16;
+
+		// The most vertices and triangles buildMeshlets puts in a meshlet.
+		static const unsigned int MESHLET_VERTICES = 64;
+		static const unsigned int MESHLET_TRIANGLES = 124;
+
+		/**
+			What optimise did to a mesh.
+		*/
+		struct Stats
+		{
+			unsigned int verticesBefore;
+			unsigned int verticesAfter;
+			float acmrBefore;
+			float acmrAfter;
+		};
+
+		/**
+			optimise runs every pass over one chunk.
+
+				@param1 a_vertices are the chunk's vertices, replaced by the
+						welded and reordered ones.
+
+				@param2 a_indices are the chunk's triangles, rewritten to match.
+
+				@return the vertex count and cache miss ratio before and after.
+		*/
+		static Stats optimise(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+
+		/**
+			weld merges vertices that are exactly the same.
+
+				@param1 a_vertices are the vertices, left with only one of each.
+
+				@param2 a_indices are the triangles, pointed at the ones kept.
+		*/
+		static void weld(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+
+		/**
+			optimiseVertexCache reorders triangles for the post-transform
+				cache with Tipsify, linear in the triangle count.
+
+				@param1 a_indices are the triangles, reordered in place.
+
+				@param2 a_vertexCount is how many vertices they index.
+		*/
+		static void optimiseVertexCache(std::vector<unsigned int>& a_indices, unsigned int a_vertexCount);
+
+		/**
+			optimiseVertexFetch reorders vertices into the order the
+				triangles first use them, dropping any that are unused.
+
+				@param1 a_vertices are the vertices, reordered.
+
+				@param2 a_indices are the triangles, pointed at the new order.
+		*/
+		static void optimiseVertexFetch(std::vector<aie::OBJMesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+
+		/**
+			calculateACMR simulates a FIFO post-transform cache.
+
+				@param1 a_indices are the triangles.
+
+				@param2 a_vertexCount is how many vertices they index.
+
+				@return the vertices shaded per triangle.
+		*/
+		static float calculateACMR(const std::vector<unsigned int>& a_indices, unsigned int a_vertexCount);
+
+		/**
+			split cuts a chunk into pieces of at most a_maxVertices, walking
+				the triangles in order so that after optimise each piece is
+				a connected patch. Vertices on a cut are copied into both
+				pieces.
+
+				@param1 a_vertices are the chunk's vertices.
+
+				@param2 a_indices are the chunk's triangles.
+
+				@param3 a_maxVertices is the most vertices a piece can have.
+
+				@param4 a_pieceVertices receives each piece's vertices.
+
+				@param5 a_pieceIndices receives each piece's triangles,
+						indexing its own vertices.
+		*/
+		static void split(const std::vector<aie::OBJMesh::Vertex>& a_vertices, const std::vector<unsigned int>& a_indices,
+			unsigned int a_maxVertices, std::vector<std::vector<aie::OBJMesh::Vertex>>& a_pieceVertices,
+			std::vector<std::vector<unsigned int>>& a_pieceIndices);
+
+		/**
+			simplify collapses edges by quadric error until the triangles
+				are down to a target or the next collapse would move the
+				surface further than an error limit. It only ever moves a
+				vertex onto a neighbour, so the result indexes the same
+				vertices. Vertices on a boundary or an attribute seam never
+				move, which keeps the pieces from split joined up.
+
+				@param1 a_vertices are the chunk's vertices.
+
+				@param2 a_indices are the triangles to simplify.
+
+				@param3 a_targetIndexCount is how many indices to aim for.
+
+				@param4 a_maxError is the furthest the surface may move, in
+						the mesh's units.
+
+				@param5 a_result receives the simplified triangles.
+		*/
+		static void simplify(const std::vector<aie::OBJMesh::Vertex>& a_vertices, const std::vector<unsigned int>& a_indices,
+			unsigned int a_targetIndexCount, float a_maxError, std::vector<unsigned int>& a_result);
+
+		/**
+			buildMeshlets cuts triangles into meshlets of at most
+				MESHLET_VERTICES and MESHLET_TRIANGLES, walking them in
+				order so after optimiseVertexCache each is a small
+				connected patch. The triangles aren't moved, a meshlet is
+				a run of the index buffer.
+
+				@param1 a_vertices are the chunk's vertices.
+
+				@param2 a_vertexCount is how many there are.
+
+				@param3 a_indices are the triangles.
+
+				@param4 a_indexCount is how many indices to cut up.
+
+				@param5 a_meshlets receives the meshlets and their bounds.
+		*/
+		static void buildMeshlets(const aie::OBJMesh::Vertex* a_vertices, unsigned int a_vertexCount,
+			const unsigned int* a_indices, unsigned int a_indexCount, std::vector<aie::OBJMesh::Meshlet>& a_meshlets);
+	};
+}
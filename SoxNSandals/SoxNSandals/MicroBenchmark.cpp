@@ -0,0 +1,792 @@
+/**
+	MicroBenchmark.cpp
+
+	Purpose: MicroBenchmark.cpp is the source file for the MicroBenchmark
+			class. The MicroBenchmark times the engine's hot paths one at
+			a time, so the same numbers can be compared between builds.
+
+	@author Nathan Nette
+*/
+#include "MicroBenchmark.h"
+#include "gl_core_4_5.h"
+#include <glfw3.h>
+#include "OBJMesh.h"
+#include "ObjParser.h"
+#include "Texture.h"
+#include "ImageDecoder.h"
+#include "FileSystem.h"
+#include "ParticleEmitter.h"
+#include "Gizmos.h"
+#include "EntitySystems.h"
+#include "GpuTransforms.h"
+#include "Bvh.h"
+#include "LooseOctree.h"
+#include "SweepAndPrune.h"
+#include "Frustum.h"
+#include "Random.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	// Each repetition runs for at least this long.
+	const double MIN_SECONDS = 0.25;
+
+	// The median of this many repetitions is reported.
+	const unsigned int REPETITIONS = 3;
+
+	const float TIME_STEP = 1.0f / 60.0f;
+
+	// Returns how many seconds a_iterations calls of a_body take.
+	double timeIterations(const std::function<void()>& a_body, unsigned long long a_iterations)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned long long i = 0; i < a_iterations; ++i)
+			a_body();
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+namespace sns
+{
+	/**
+		run times every benchmark whose name contains a filter.
+
+			@param1 a_filter picks the benchmarks to run, nullptr runs
+					them all.
+
+			@param2 a_output is the json file to write, or nullptr to
+					only print.
+
+			@return false if the GL context couldn't be created or the
+					results couldn't be written.
+	*/
+	bool MicroBenchmark::run(const char* a_filter, const char* a_output)
+	{
+		if (glfwInit() == false)
+			return false;
+
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		GLFWwindow* window = glfwCreateWindow(64, 64, "SoxNSandals benchmark", nullptr, nullptr);
+		if (window == nullptr)
+		{
+			glfwTerminate();
+			return false;
+		}
+
+		glfwMakeContextCurrent(window);
+		if (ogl_LoadFunctions() == ogl_LOAD_FAILED)
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return false;
+		}
+
+		bool written;
+		{
+			MicroBenchmark benchmark;
+			benchmark.m_filter = a_filter;
+
+			const char* models[] = { "Buddha", "Dragon", "Lucy" };
+			for (const char* model : models)
+			{
+				std::string filename = std::string("../stanford/") + model + ".obj";
+				benchmark.meshLoad(model, filename.c_str());
+				benchmark.meshPick(model, filename.c_str());
+			}
+
+			benchmark.tangents(64);
+			benchmark.tangents(512);
+
+			benchmark.particles(1000);
+			benchmark.particles(10000);
+			benchmark.particles(100000);
+
+			benchmark.entities(1000);
+			benchmark.entities(100000);
+			benchmark.gpuTransforms(100000);
+
+			benchmark.gravity(256);
+			benchmark.gravity(4096);
+
+			benchmark.bvh(1000);
+			benchmark.bvh(100000);
+
+			benchmark.octree(1000);
+			benchmark.octree(100000);
+
+			benchmark.sweepAndPrune(1000);
+			benchmark.sweepAndPrune(100000);
+
+			aie::Gizmos::create(10000, 10000, 100, 100);
+			benchmark.gizmoSphere(8, 8);
+			benchmark.gizmoSphere(32, 32);
+			benchmark.gizmoLines(50000);
+			aie::Gizmos::destroy();
+
+			benchmark.textureLoad("../textures/Crackles.png");
+			benchmark.imageDecode("../textures/Crackles.png");
+			benchmark.imageDecode("../models/Sponza/SingleObjs/textures/sponza_thorn_diff.png");
+
+			written = benchmark.write(a_output);
+		}
+
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return written;
+	}
+
+	/**
+		measure times a benchmark, if the filter picks it. After one
+			call to warm up, the iterations are raised until a run
+			takes MIN_SECONDS, then the median of REPETITIONS runs of
+			that many iterations is kept.
+
+			@param1 a_name is the benchmark's name.
+
+			@param2 a_body is one iteration.
+
+			@param3 a_maxIterations caps the iterations of each
+					repetition, for benchmarks that are slow or can't
+					be repeated indefinitely.
+	*/
+	void MicroBenchmark::measure(const std::string& a_name, const std::function<void()>& a_body,
+		unsigned long long a_maxIterations)
+	{
+		if (m_filter != nullptr && a_name.find(m_filter) == std::string::npos)
+			return;
+
+		a_body();
+
+		unsigned long long iterations = 1;
+		double seconds = timeIterations(a_body, iterations);
+		while (seconds < MIN_SECONDS && iterations < a_maxIterations)
+		{
+			// Aim a little past the minimum, but never grow more than 10x
+			//	at once in case the first iterations were unusually quick.
+			double scale = seconds > 0.0 ? MIN_SECONDS * 1.4 / seconds : 10.0;
+			unsigned long long next = (unsigned long long)(iterations * std::min(std::max(scale, 2.0), 10.0));
+			iterations = std::min(next, a_maxIterations);
+			seconds = timeIterations(a_body, iterations);
+		}
+
+		double repetitions[REPETITIONS];
+		repetitions[0] = seconds;
+		for (unsigned int i = 1; i < REPETITIONS; ++i)
+			repetitions[i] = timeIterations(a_body, iterations);
+		std::sort(repetitions, repetitions + REPETITIONS);
+
+		Result result;
+		result.name = a_name;
+		result.iterations = iterations;
+		result.nanoseconds = repetitions[REPETITIONS / 2] * 1e9 / iterations;
+		m_results.push_back(result);
+
+		printf("%-40s %14.0f ns %10llu iterations\n", a_name.c_str(), result.nanoseconds, iterations);
+	}
+
+	/**
+		write prints the results and writes them as JSON in the layout
+			of Google Benchmark's --benchmark_format=json.
+
+			@param1 a_output is the json file to write, or nullptr to
+					only print.
+
+			@return false if the file couldn't be written.
+	*/
+	bool MicroBenchmark::write(const char* a_output) const
+	{
+		if (a_output == nullptr)
+			return true;
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_output, "w");
+		if (file == nullptr)
+		{
+			printf("Failed to write %s\n", a_output);
+			return false;
+		}
+
+#ifdef _DEBUG
+		const char* buildType = "debug";
+#else
+		const char* buildType = "release";
+#endif
+
+		fprintf(file, "{\n\t\"context\": {\n");
+		fprintf(file, "\t\t\"executable\": \"SoxNSandals\",\n");
+		fprintf(file, "\t\t\"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+		fprintf(file, "\t\t\"library_build_type\": \"%s\"\n\t},\n", buildType);
+		fprintf(file, "\t\"benchmarks\": [");
+
+		// Only wall time is measured, it is written as the cpu time too
+		//	since the comparison tools expect both.
+		for (size_t i = 0; i < m_results.size(); ++i)
+		{
+			const Result& result = m_results[i];
+			fprintf(file, "%s\n\t\t{ \"name\": \"%s\", \"iterations\": %llu, \"real_time\": %.1f, \"cpu_time\": %.1f, \"time_unit\": \"ns\" }",
+				i == 0 ? "" : ",", result.name.c_str(), result.iterations, result.nanoseconds, result.nanoseconds);
+		}
+		fprintf(file, "\n\t]\n}\n");
+
+		bool written = ferror(file) == 0;
+		fclose(file);
+		if (!written)
+			printf("Failed to write %s\n", a_output);
+		return written;
+	}
+
+	/**
+		meshLoad times OBJMesh::load of a model without its textures,
+			both parsing the obj and mapping the binary cache it writes.
+
+			@param1 a_name is the model's name in the results.
+
+			@param2 a_filename is the obj.
+	*/
+	void MicroBenchmark::meshLoad(const char* a_name, const char* a_filename)
+	{
+		std::string cache = std::string(a_filename) + aie::OBJMesh::getCacheExtension();
+		std::string name = std::string("OBJMesh::load/") + a_name;
+
+		// The parse on its own, without optimising or writing the cache.
+		measure(name + "/parse", [&]()
+		{
+			ObjParser parser;
+			parser.parse(a_filename);
+		});
+
+		// Removing the cache makes every load parse the obj and write it again.
+		measure(name + "/obj", [&]()
+		{
+			std::remove(cache.c_str());
+			aie::OBJMesh mesh;
+			mesh.load(a_filename, false);
+		}, 1);
+
+		measure(name + "/cache", [&]()
+		{
+			aie::OBJMesh mesh;
+			mesh.load(a_filename, false);
+		});
+
+		measure(name + "/packed", [&]()
+		{
+			aie::OBJMesh mesh;
+			mesh.setVertexFormat(aie::OBJMesh::PACKED_VERTEX);
+			mesh.load(a_filename, false);
+		});
+
+		// What the packed layout saves on the gpu, once per model.
+		if (m_filter != nullptr && (name + "/packed").find(m_filter) == std::string::npos)
+			return;
+
+		aie::OBJMesh full;
+		aie::OBJMesh packed;
+		packed.setVertexFormat(aie::OBJMesh::PACKED_VERTEX);
+		if (full.load(a_filename, false) && packed.load(a_filename, false))
+		{
+			printf("%-40s %14.1f MB full %10.1f MB packed\n", name.c_str(),
+				full.getGPUBytes() / (1024.0 * 1024.0), packed.getGPUBytes() / (1024.0 * 1024.0));
+		}
+	}
+
+	/**
+		meshPick times OBJMesh::intersectRay against every triangle of a
+			model, with rays from all around it towards its middle.
+
+			@param1 a_name is the model's name in the results.
+
+			@param2 a_filename is the obj.
+	*/
+	void MicroBenchmark::meshPick(const char* a_name, const char* a_filename)
+	{
+		std::string name = std::string("OBJMesh::intersectRay/") + a_name;
+		if (m_filter != nullptr && name.find(m_filter) == std::string::npos)
+			return;
+
+		aie::OBJMesh mesh;
+		mesh.setPickable(true);
+		if (mesh.load(a_filename, false) == false)
+			return;
+
+		const BoxList& bounds = mesh.getChunkBounds();
+		glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+		for (unsigned int i = 0; i < bounds.size(); ++i)
+		{
+			glm::vec3 centre(bounds.centreX[i], bounds.centreY[i], bounds.centreZ[i]);
+			glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+			min = glm::min(min, centre - extent);
+			max = glm::max(max, centre + extent);
+		}
+		glm::vec3 centre = (min + max) * 0.5f;
+		glm::vec3 size = max - min;
+
+		// Rays from a sphere around the model at points near its middle,
+		//	a different one each iteration, so most hit and some miss.
+		static const unsigned int RAY_COUNT = 256;
+		Random random(11);
+		std::vector<glm::vec3> origins(RAY_COUNT);
+		std::vector<glm::vec3> directions(RAY_COUNT);
+		for (unsigned int i = 0; i < RAY_COUNT; ++i)
+		{
+			glm::vec3 around(random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f));
+			origins[i] = centre + glm::normalize(around + glm::vec3(0, 0, 1e-3f)) * glm::length(size);
+			glm::vec3 target = centre + glm::vec3(random.range(-0.25f, 0.25f), random.range(-0.25f, 0.25f),
+				random.range(-0.25f, 0.25f)) * size;
+			directions[i] = target - origins[i];
+		}
+
+		unsigned int ray = 0;
+		unsigned long long casts = 0, hits = 0;
+		measure(name, [&]()
+		{
+			unsigned int chunk, triangle;
+			float distance;
+			hits += mesh.intersectRay(origins[ray], directions[ray], FLT_MAX, chunk, triangle, distance) ? 1 : 0;
+			ray = (ray + 1) % RAY_COUNT;
+			++casts;
+		});
+
+		if (casts > 0)
+			printf("%-40s %14.1f%% of rays hit\n", name.c_str(), 100.0 * hits / casts);
+	}
+
+	/**
+		tangents times OBJMesh::calculateTangents on a flat grid.
+
+			@param1 a_size is how many vertices along each side.
+	*/
+	void MicroBenchmark::tangents(unsigned int a_size)
+	{
+		std::vector<aie::OBJMesh::Vertex> vertices(a_size * a_size);
+		for (unsigned int y = 0; y < a_size; ++y)
+		{
+			for (unsigned int x = 0; x < a_size; ++x)
+			{
+				aie::OBJMesh::Vertex& vertex = vertices[y * a_size + x];
+				vertex.position = glm::vec4(x, 0, y, 1);
+				vertex.normal = glm::vec4(0, 1, 0, 0);
+				vertex.texcoord = glm::vec2(x, y) / float(a_size - 1);
+			}
+		}
+
+		std::vector<unsigned int> indices;
+		indices.reserve((a_size - 1) * (a_size - 1) * 6);
+		for (unsigned int y = 0; y + 1 < a_size; ++y)
+		{
+			for (unsigned int x = 0; x + 1 < a_size; ++x)
+			{
+				unsigned int corner = y * a_size + x;
+				unsigned int quad[] = { corner, corner + a_size, corner + 1,
+					corner + 1, corner + a_size, corner + a_size + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		measure("OBJMesh::calculateTangents/" + std::to_string(vertices.size()), [&]()
+		{
+			aie::OBJMesh::calculateTangents(vertices, indices);
+		});
+
+		measure("OBJMesh::calculateTangents/" + std::to_string(vertices.size()) + "/mikktspace", [&]()
+		{
+			aie::OBJMesh::calculateTangents(vertices, indices, aie::OBJMesh::MIKKTSPACE_TANGENTS);
+		});
+	}
+
+	/**
+		particles times ParticleEmitter::update with a full emitter.
+
+			@param1 a_count is the emitter's maximum amount of particles.
+	*/
+	void MicroBenchmark::particles(unsigned int a_count)
+	{
+		std::string name = "ParticleEmitter::update/" + std::to_string(a_count);
+		if (m_filter != nullptr && name.find(m_filter) == std::string::npos)
+			return;
+
+		// Emitting a_count a second against lifetimes of 1 to 5 seconds
+		//	keeps the emitter full once it has run for a few seconds.
+		ParticleEmitter emitter;
+		emitter.initialise(a_count, a_count,
+			1.0f, 5.0f,
+			1, 5,
+			1, 0.1f,
+			glm::vec4(1, 0, 0, 1), glm::vec4(1, 1, 0, 1));
+		for (unsigned int i = 0; i < 300; ++i)
+			emitter.update(TIME_STEP);
+
+		measure(name, [&]()
+		{
+			emitter.update(TIME_STEP);
+		});
+	}
+
+	/**
+		entities times the orbit and transform systems over a scene of
+			suns, each with nine planets orbiting it.
+
+			@param1 a_count is how many entities the scene has.
+	*/
+	void MicroBenchmark::entities(unsigned int a_count)
+	{
+		std::string name = "EntitySystems::update/" + std::to_string(a_count);
+		if (m_filter != nullptr && name.find(m_filter) == std::string::npos)
+			return;
+
+		EntityRegistry registry;
+		Entity sun = 0;
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			Entity entity = registry.create();
+			if (i % 10 == 0)
+			{
+				sun = entity;
+				registry.createTransform(entity, glm::mat4(1), entity);
+				continue;
+			}
+
+			float radius = float(i % 10) * 10.0f;
+			registry.createTransform(entity, glm::mat4(1), sun);
+			registry.orbits.add(entity, { radius, 1.0f / radius, float(i) });
+		}
+
+		measure(name, [&]()
+		{
+			EntitySystems::updateOrbits(registry, TIME_STEP);
+			EntitySystems::updateTransforms(registry);
+		});
+	}
+
+	/**
+		gpuTransforms times the orbit system over the same scene as
+			entities, with the world matrices worked out by GpuTransforms
+			instead, waiting for the gpu to finish.
+
+			@param1 a_count is how many entities the scene has.
+	*/
+	void MicroBenchmark::gpuTransforms(unsigned int a_count)
+	{
+		std::string name = "GpuTransforms::update/" + std::to_string(a_count);
+		if (m_filter != nullptr && name.find(m_filter) == std::string::npos)
+			return;
+
+		GpuTransforms transforms;
+		if (transforms.create() == false)
+			return;
+
+		EntityRegistry registry;
+		Entity sun = 0;
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			Entity entity = registry.create();
+			if (i % 10 == 0)
+			{
+				sun = entity;
+				registry.createTransform(entity, glm::mat4(1), entity);
+				continue;
+			}
+
+			float radius = float(i % 10) * 10.0f;
+			registry.createTransform(entity, glm::mat4(1), sun);
+			registry.orbits.add(entity, { radius, 1.0f / radius, float(i) });
+		}
+
+		// The graph's own update never runs, every orbit moves each time
+		//	anyway.
+		measure(name, [&]()
+		{
+			EntitySystems::updateOrbits(registry, TIME_STEP);
+			transforms.update(registry.graph);
+			glFinish();
+		});
+	}
+
+	/**
+		gravity times one step of a GravitySimulation of bodies scattered
+			through a disc. 256 is the most summed directly, more go
+			through the octree.
+
+			@param1 a_count is how many bodies.
+	*/
+	void MicroBenchmark::gravity(unsigned int a_count)
+	{
+		std::string name = "GravitySimulation::step/" + std::to_string(a_count);
+		if (m_filter != nullptr && name.find(m_filter) == std::string::npos)
+			return;
+
+		GravitySimulation simulation;
+		Random random(11);
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			glm::vec3 position(random.range(-300.0f, 300.0f), random.range(-10.0f, 10.0f), random.range(-300.0f, 300.0f));
+			simulation.addBody(position, glm::vec3(0), random.range(1.0f, 10.0f));
+		}
+
+		// One step a call, so every call sums the same amount.
+		simulation.setMaxStep(TIME_STEP);
+		measure(name, [&]()
+		{
+			simulation.step(TIME_STEP);
+		});
+	}
+
+	/**
+		bvh times building a Bvh over boxes scattered like the courtyard's
+			chunks, and each of its queries. The frustum query is timed
+			beside Frustum::cull over the same boxes, which is what it
+			replaces, and refit after a tenth of the boxes have moved.
+
+			@param1 a_count is how many boxes.
+	*/
+	void MicroBenchmark::bvh(unsigned int a_count)
+	{
+		std::string count = "/" + std::to_string(a_count);
+		Random random(7);
+		std::vector<Bvh::Box> boxes(a_count);
+		BoxList list;
+		for (Bvh::Box& box : boxes)
+		{
+			glm::vec3 centre(random.range(-1100.0f, 1100.0f), random.range(0.0f, 600.0f), random.range(-450.0f, 450.0f));
+			glm::vec3 extent(random.range(1.0f, 20.0f), random.range(1.0f, 20.0f), random.range(1.0f, 20.0f));
+			box = { centre - extent, centre + extent };
+			list.add(box.min, box.max);
+		}
+
+		Bvh bvh;
+		measure("Bvh::build" + count, [&]()
+		{
+			bvh.build(boxes.data(), a_count);
+		}, 100);
+		bvh.build(boxes.data(), a_count);
+
+		Frustum frustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 1.0f, 2000.0f) *
+			glm::lookAt(glm::vec3(-900, 150, 0), glm::vec3(0, 150, 0), glm::vec3(0, 1, 0)));
+		std::vector<unsigned int> primitives;
+		measure("Bvh::queryFrustum" + count, [&]()
+		{
+			primitives.clear();
+			bvh.queryFrustum(frustum, primitives);
+		});
+
+		std::vector<unsigned char> visible;
+		measure("Frustum::cull" + count, [&]()
+		{
+			frustum.cull(list, visible);
+		});
+
+		Bvh::Box query = { glm::vec3(-50, 0, -50), glm::vec3(50, 300, 50) };
+		measure("Bvh::queryBox" + count, [&]()
+		{
+			primitives.clear();
+			bvh.queryBox(query, primitives);
+		});
+
+		Bvh::Hit hit;
+		measure("Bvh::intersectRay" + count, [&]()
+		{
+			bvh.intersectRay(glm::vec3(-1200, 150, 10), glm::vec3(1, 0, 0), FLT_MAX, Bvh::IntersectFunction(), hit);
+		});
+
+		// The boxes step back and forth, so every refit grows and shrinks
+		//	the nodes above them.
+		float step = 1.0f;
+		measure("Bvh::refit" + count, [&]()
+		{
+			for (unsigned int i = 0; i < a_count; i += 10)
+			{
+				boxes[i].min.x += step;
+				boxes[i].max.x += step;
+				bvh.update(i, boxes[i]);
+			}
+			bvh.refit();
+			step = -step;
+		});
+	}
+
+	/**
+		octree times moving spheres through a LooseOctree and its
+			queries. The spheres wander a little each frame, as the
+			planets do, so most stay in their cell.
+
+			@param1 a_count is how many spheres.
+	*/
+	void MicroBenchmark::octree(unsigned int a_count)
+	{
+		std::string count = "/" + std::to_string(a_count);
+		Random random(13);
+		std::vector<glm::vec4> spheres(a_count);
+		std::vector<LooseOctree::Handle> handles(a_count);
+
+		LooseOctree octree;
+		octree.create(glm::vec3(-1500, -200, -1500), glm::vec3(1500, 1000, 1500));
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			spheres[i] = glm::vec4(random.range(-1500.0f, 1500.0f), random.range(-200.0f, 1000.0f),
+				random.range(-1500.0f, 1500.0f), random.range(1.0f, 20.0f));
+			handles[i] = octree.insert(glm::vec3(spheres[i]), spheres[i].w, i);
+		}
+
+		// Moves back and forth, so the spheres stay near where they began.
+		float step = 2.0f;
+		measure("LooseOctree::update" + count, [&]()
+		{
+			for (unsigned int i = 0; i < a_count; ++i)
+			{
+				spheres[i].x += step;
+				octree.move(handles[i], glm::vec3(spheres[i]), spheres[i].w);
+			}
+			octree.update();
+			step = -step;
+		});
+
+		Frustum frustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 1.0f, 2000.0f) *
+			glm::lookAt(glm::vec3(-900, 150, 0), glm::vec3(0, 150, 0), glm::vec3(0, 1, 0)));
+		std::vector<uint32_t> users;
+		measure("LooseOctree::queryFrustum" + count, [&]()
+		{
+			users.clear();
+			octree.queryFrustum(&frustum, 1, users);
+		});
+
+		measure("LooseOctree::querySphere" + count, [&]()
+		{
+			users.clear();
+			octree.querySphere(glm::vec3(0, 150, 0), 100.0f, users);
+		});
+	}
+
+	/**
+		sweepAndPrune times finding the overlapping pairs of boxes moving
+			through a SweepAndPrune. Like the octree's spheres they move
+			back and forth, so the order is nearly sorted each update.
+
+			@param1 a_count is how many boxes.
+	*/
+	void MicroBenchmark::sweepAndPrune(unsigned int a_count)
+	{
+		std::string count = "/" + std::to_string(a_count);
+		Random random(17);
+		std::vector<glm::vec3> mins(a_count);
+		std::vector<glm::vec3> maxs(a_count);
+		std::vector<SweepAndPrune::Handle> handles(a_count);
+
+		SweepAndPrune broadphase;
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			mins[i] = glm::vec3(random.range(-1500.0f, 1500.0f), random.range(-200.0f, 1000.0f),
+				random.range(-1500.0f, 1500.0f));
+			maxs[i] = mins[i] + random.range(1.0f, 20.0f);
+			handles[i] = broadphase.insert(mins[i], maxs[i], i);
+		}
+		broadphase.update();
+
+		float step = 2.0f;
+		measure("SweepAndPrune::update" + count, [&]()
+		{
+			for (unsigned int i = 0; i < a_count; ++i)
+			{
+				mins[i].x += step;
+				maxs[i].x += step;
+				broadphase.move(handles[i], mins[i], maxs[i]);
+			}
+			broadphase.update();
+			step = -step;
+		});
+	}
+
+	/**
+		gizmoSphere times tessellating a sphere with Gizmos::addSphere.
+
+			@param1 a_rows is how many rows of quads the sphere has.
+
+			@param2 a_columns is how many columns of quads.
+	*/
+	void MicroBenchmark::gizmoSphere(int a_rows, int a_columns)
+	{
+		measure("Gizmos::addSphere/" + std::to_string(a_rows) + "x" + std::to_string(a_columns), [&]()
+		{
+			aie::Gizmos::addSphere(glm::vec3(0), 1.0f, a_rows, a_columns, glm::vec4(1));
+			aie::Gizmos::clear();
+		});
+	}
+
+	/**
+		gizmoLines times adding lines one at a time with Gizmos::addLine
+			against all at once with Gizmos::addLines.
+
+			@param1 a_count is how many lines.
+	*/
+	void MicroBenchmark::gizmoLines(unsigned int a_count)
+	{
+		// A grid's rows, each line one step along.
+		std::vector<glm::vec3> points(a_count * 2);
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			points[i * 2] = glm::vec3((float)(i % 256), 0, (float)(i / 256));
+			points[i * 2 + 1] = points[i * 2] + glm::vec3(1, 0, 0);
+		}
+
+		std::string count = "/" + std::to_string(a_count);
+		measure("Gizmos::addLine" + count, [&]()
+		{
+			for (unsigned int i = 0; i < a_count; ++i)
+				aie::Gizmos::addLine(points[i * 2], points[i * 2 + 1], glm::vec4(1));
+			aie::Gizmos::clear();
+		});
+		measure("Gizmos::addLines" + count, [&]()
+		{
+			aie::Gizmos::addLines(points.data(), a_count, glm::vec4(1));
+			aie::Gizmos::clear();
+		});
+	}
+
+	/**
+		textureLoad times Texture::load, decoding and uploading a file.
+
+			@param1 a_filename is the image.
+	*/
+	void MicroBenchmark::textureLoad(const char* a_filename)
+	{
+		const char* file = std::strrchr(a_filename, '/');
+		measure(std::string("Texture::load/") + (file != nullptr ? file + 1 : a_filename), [&]()
+		{
+			aie::Texture texture;
+			texture.load(a_filename);
+		});
+	}
+
+	/**
+		imageDecode times each decoder that takes a file decoding it, the
+			file already in memory.
+
+			@param1 a_filename is the image.
+	*/
+	void MicroBenchmark::imageDecode(const char* a_filename)
+	{
+		FileView file;
+		if (FileSystem::instance().open(a_filename, file) == false)
+			return;
+
+		const char* name = std::strrchr(a_filename, '/');
+		name = name != nullptr ? name + 1 : a_filename;
+		for (unsigned int i = 0; i < ImageDecoder::getDecoderCount(); ++i)
+		{
+			const ImageDecoder* decoder = ImageDecoder::getDecoder(i);
+			if (decoder->accepts(file.getData(), file.getSize()) == false)
+				continue;
+			measure(std::string("ImageDecoder/") + decoder->getName() + "/" + name, [&]()
+			{
+				ImageDecoder::Info info;
+				free(decoder->decode(file.getData(), file.getSize(), info));
+			});
+		}
+	}
+}
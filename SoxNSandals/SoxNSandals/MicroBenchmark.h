@@ -0,0 +1,92 @@
+/**
+	MicroBenchmark.h
+
+	Purpose: MicroBenchmark.h is the header file for the MicroBenchmark
+			class. The MicroBenchmark times the engine's hot paths one at
+			a time, so the same numbers can be compared between builds.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The MicroBenchmark class runs each benchmark until it has taken
+			long enough to time reliably, like Google Benchmark does,
+			and writes the results in Google Benchmark's JSON format so
+			its comparison tools can read them.
+
+		A hidden window is opened for its GL context, since most of the
+			timed code creates gl objects.
+	*/
+	class MicroBenchmark
+	{
+	public:
+		/**
+			run times every benchmark whose name contains a filter.
+
+				@param1 a_filter picks the benchmarks to run, nullptr
+						runs them all.
+
+				@param2 a_output is the json file to write, or nullptr
+						to only print.
+
+				@return false if the GL context couldn't be created or
+						the results couldn't be written.
+		*/
+		static bool run(const char* a_filter, const char* a_output);
+
+	private:
+		/**
+			One benchmark's result.
+		*/
+		struct Result
+		{
+			std::string name;
+			unsigned long long iterations;
+			double nanoseconds;
+		};
+
+		/**
+			measure times a benchmark, if the filter picks it.
+
+				@param1 a_name is the benchmark's name.
+
+				@param2 a_body is one iteration.
+
+				@param3 a_maxIterations caps the iterations of each
+						repetition, for benchmarks that are slow or
+						can't be repeated indefinitely.
+		*/
+		void measure(const std::string& a_name, const std::function<void()>& a_body,
+			unsigned long long a_maxIterations = ~0ull);
+
+		/**
+			write writes the results as JSON.
+		*/
+		bool write(const char* a_output) const;
+
+		// The benchmarks.
+		void meshLoad(const char* a_name, const char* a_filename);
+		void meshPick(const char* a_name, const char* a_filename);
+		void tangents(unsigned int a_size);
+		void particles(unsigned int a_count);
+		void entities(unsigned int a_count);
+		void gpuTransforms(unsigned int a_count);
+		void gravity(unsigned int a_count);
+		void bvh(unsigned int a_count);
+		void octree(unsigned int a_count);
+		void sweepAndPrune(unsigned int a_count);
+		void gizmoSphere(int a_rows, int a_columns);
+		void gizmoLines(unsigned int a_count);
+		void textureLoad(const char* a_filename);
+		void imageDecode(const char* a_filename);
+
+		const char* m_filter = nullptr;
+		std::vector<Result> m_results;
+	};
+}
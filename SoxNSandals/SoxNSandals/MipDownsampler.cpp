@@ -0,0 +1,196 @@
+/**
+	MipDownsampler.cpp
+
+	Purpose: MipDownsampler.cpp is the source file for the MipDownsampler
+			class. The MipDownsampler builds the mip levels of a texture
+			the gpu wrote, averaged or keeping the smallest or largest of
+			what is below, in a single compute dispatch.
+
+	@author Nathan Nette
+*/
+#include "MipDownsampler.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	// The base texels across a group's tile, and the levels a group
+	//	builds from it.
+	static const int TILE_SIZE = 64;
+	static const int TILE_LEVELS = 6;
+
+	// The unit the shader reads the base level from.
+	static const unsigned int SOURCE_UNIT = 0;
+
+	/**
+		A format images can be, and its name in a layout qualifier.
+	*/
+	struct ImageFormat
+	{
+		unsigned int format;
+		const char* name;
+	};
+
+	static const ImageFormat IMAGE_FORMATS[] = {
+		{ GL_R32F, "r32f" },
+		{ GL_R16F, "r16f" },
+		{ GL_RG16F, "rg16f" },
+		{ GL_RGBA16F, "rgba16f" },
+		{ GL_RGBA32F, "rgba32f" },
+		{ GL_R11F_G11F_B10F, "r11f_g11f_b10f" },
+		{ GL_R8, "r8" },
+		{ GL_RG8, "rg8" },
+		{ GL_RGBA8, "rgba8" },
+	};
+
+	MipDownsampler::MipDownsampler()
+		: m_counterLayers(0),
+		m_format(0),
+		m_array(false),
+		m_levelImages(TILE_LEVELS)
+	{
+	}
+
+	/**
+		create loads the shader for a format and reduction. The levels
+			are all bound at once when the driver has the image units
+			for them.
+
+			@param1 a_format is the textures' internal format, one that
+					can be an image.
+
+			@param2 a_reduction is what each texel keeps.
+
+			@param3 a_array is whether the textures are arrays.
+
+			@return false without GL 4.3, the shader, or a format images
+					can be, it is left uncreated.
+	*/
+	bool MipDownsampler::create(unsigned int a_format, Reduction a_reduction, bool a_array)
+	{
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("MipDownsampler: compute downsampling needs GL 4.3.\n");
+			return false;
+		}
+
+		const char* name = nullptr;
+		for (const ImageFormat& format : IMAGE_FORMATS)
+		{
+			if (format.format == a_format)
+				name = format.name;
+		}
+		if (name == nullptr)
+		{
+			printf("MipDownsampler: format 0x%x can't be an image.\n", a_format);
+			return false;
+		}
+
+		int computeImages = 0;
+		int imageUnits = 0;
+		glGetIntegerv(GL_MAX_COMPUTE_IMAGE_UNIFORMS, &computeImages);
+		glGetIntegerv(GL_MAX_IMAGE_UNITS, &imageUnits);
+		m_levelImages = computeImages >= MAX_LEVELS && imageUnits >= MAX_LEVELS ? MAX_LEVELS : TILE_LEVELS;
+		m_format = a_format;
+		m_array = a_array;
+
+		std::string defines = std::string("#define REDUCTION ") + std::to_string((int)a_reduction) +
+			"\n#define FORMAT " + name +
+			"\n#define ARRAY " + (a_array ? "1" : "0") +
+			"\n#define LEVEL_IMAGES " + std::to_string(m_levelImages) + "\n";
+		m_shader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/mipDownsample.comp", defines.c_str());
+		if (m_shader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_shader.getLastError());
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		downsample builds every level of a texture below one it has, in
+			as few dispatches as it can. Each builds from the level the
+			one before finished on.
+
+			@param1 a_texture is the texture, of the format created with.
+
+			@param2 a_width is the width of its first level.
+
+			@param3 a_height is the height of its first level.
+
+			@param4 a_levelCount is how many levels it has.
+
+			@param5 a_layers is how many layers an array has.
+
+			@param6 a_baseLevel is the level the others are built from.
+	*/
+	void MipDownsampler::downsample(unsigned int a_texture, int a_width, int a_height, int a_levelCount,
+		int a_layers, int a_baseLevel)
+	{
+		static constexpr aie::UniformHandle SOURCE("Source");
+		static constexpr aie::UniformHandle BASE_LEVEL("BaseLevel");
+		static constexpr aie::UniformHandle BASE_SIZE("BaseSize");
+		static constexpr aie::UniformHandle LEVEL_COUNT("LevelCount");
+
+		if (isCreated() == false || a_baseLevel + 1 >= a_levelCount)
+			return;
+		int layers = m_array ? (a_layers > 1 ? a_layers : 1) : 1;
+
+		// Zeroed once, the last group of each dispatch zeroes its own.
+		if (m_levelImages > TILE_LEVELS && layers > m_counterLayers)
+		{
+			std::vector<uint32_t> zeroes(layers, 0);
+			m_counters.reset();
+			glCreateBuffers(1, m_counters.put());
+			glNamedBufferStorage(m_counters, layers * sizeof(uint32_t), zeroes.data(), 0);
+			GpuMemory::instance().trackBuffer(m_counters, layers * sizeof(uint32_t), GpuMemory::RENDER_TARGETS,
+				"MipDownsampler");
+			m_counterLayers = layers;
+		}
+
+		RenderState& state = RenderState::instance();
+		m_shader.bind();
+		m_shader.bindUniform(SOURCE, (int)SOURCE_UNIT);
+		if (m_array)
+			glBindTextureUnit(SOURCE_UNIT, a_texture);
+		else
+			state.bindTexture(SOURCE_UNIT, a_texture);
+		if (m_counters != 0)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_counters);
+
+		for (int base = a_baseLevel; base + 1 < a_levelCount;)
+		{
+			int width = a_width >> base > 1 ? a_width >> base : 1;
+			int height = a_height >> base > 1 ? a_height >> base : 1;
+
+			// A sixth level wider than a tile is left for the next dispatch.
+			int levels = a_levelCount - 1 - base;
+			int most = width <= MAX_SINGLE_PASS_SIZE && height <= MAX_SINGLE_PASS_SIZE ? m_levelImages : TILE_LEVELS;
+			levels = levels < most ? levels : most;
+
+			// Units past the last level are bound to it, and never written.
+			for (int i = 0; i < m_levelImages; ++i)
+			{
+				int level = base + 1 + (i < levels ? i : levels - 1);
+				glBindImageTexture(i, a_texture, level, m_array ? GL_TRUE : GL_FALSE, 0, GL_READ_WRITE, m_format);
+			}
+
+			m_shader.bindUniform(BASE_LEVEL, base);
+			m_shader.bindUniform(BASE_SIZE, glm::ivec2(width, height));
+			m_shader.bindUniform(LEVEL_COUNT, levels);
+			glDispatchCompute((width + TILE_SIZE - 1) / TILE_SIZE, (height + TILE_SIZE - 1) / TILE_SIZE, layers);
+
+			// The next dispatch reads what this one wrote, and so does
+			//	whatever samples the texture after.
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+			base += levels;
+		}
+
+		if (m_array == false)
+			state.bindTexture(SOURCE_UNIT, 0);
+	}
+}
@@ -0,0 +1,117 @@
+/**
+	MipDownsampler.h
+
+	Purpose: MipDownsampler.h is the header file for the MipDownsampler
+			class. The MipDownsampler builds the mip levels of a texture
+			the gpu wrote, averaged or keeping the smallest or largest of
+			what is below, in a single compute dispatch.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+
+namespace sns
+{
+	/**
+		The MipDownsampler class reduces a texture's levels the way AMD's
+			single pass downsampler does. Each group of the dispatch
+			reduces a 64 by 64 tile of the base level through six levels
+			in shared memory, and the last group to finish reduces the
+			sixth level through six more, so up to MAX_LEVELS levels are
+			built without a barrier between any of them.
+
+		That needs every level bound as an image at once, which not every
+			driver has the units for. Without them the dispatch builds
+			six levels, and a second one builds the rest from the sixth.
+			So does a base larger than MAX_SINGLE_PASS_SIZE, whose sixth
+			level is too large for one group.
+
+		Each create is one image format and reduction, and 2D or array
+			textures, where every layer is reduced on its own. Needs GL
+			4.3, without it create fails and the caller should build the
+			levels as it did.
+	*/
+	class MipDownsampler
+	{
+	public:
+		/**
+			What each texel keeps of the four below it.
+		*/
+		enum Reduction
+		{
+			AVERAGE,
+			MIN,
+			MAX
+		};
+
+		// The most levels a dispatch builds, and the largest base that
+		//	builds all of them in it.
+		static const int MAX_LEVELS = 12;
+		static const int MAX_SINGLE_PASS_SIZE = 4096;
+
+		MipDownsampler();
+
+		MipDownsampler(const MipDownsampler&) = delete;
+		MipDownsampler& operator=(const MipDownsampler&) = delete;
+
+		/**
+			create loads the shader for a format and reduction.
+
+				@param1 a_format is the textures' internal format, one
+						that can be an image.
+
+				@param2 a_reduction is what each texel keeps.
+
+				@param3 a_array is whether the textures are arrays.
+
+				@return false without GL 4.3, the shader, or a format
+						images can be, it is left uncreated.
+		*/
+		bool create(unsigned int a_format, Reduction a_reduction, bool a_array = false);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_shader.getHandle() != 0; }
+
+		/**
+			downsample builds every level of a texture below one it has.
+
+				@param1 a_texture is the texture, of the format created
+						with.
+
+				@param2 a_width is the width of its first level.
+
+				@param3 a_height is the height of its first level.
+
+				@param4 a_levelCount is how many levels it has.
+
+				@param5 a_layers is how many layers an array has.
+
+				@param6 a_baseLevel is the level the others are built
+						from.
+		*/
+		void downsample(unsigned int a_texture, int a_width, int a_height, int a_levelCount,
+			int a_layers = 1, int a_baseLevel = 0);
+
+		/**
+			getLevelsPerDispatch returns how many levels a dispatch can
+				build, MAX_LEVELS when they can all be bound at once.
+		*/
+		int getLevelsPerDispatch() const { return m_levelImages; }
+
+	private:
+		aie::ShaderProgram m_shader;
+
+		// Each layer's count of finished groups, which the last puts
+		//	back to 0.
+		BufferHandle m_counters;
+		int m_counterLayers;
+
+		unsigned int m_format;
+		bool m_array;
+		int m_levelImages;
+	};
+}
@@ -7,42 +7,918 @@
 	@author AIE
 */
 #include "OBJMesh.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "Trace.h"
 #include "gl_core_4_5.h"
+#include <glm/common.hpp>
+#include <glm/exponential.hpp>
 #include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <unordered_map>
+#include "AssetLoader.h"
+#include "FileSystem.h"
+#include "GltfImporter.h"
+#include "JobSystem.h"
+#include "LightmapPacker.h"
+#include "MeshCodec.h"
+#include "MeshOptimiser.h"
+#include "ObjParser.h"
+#include "SoftwareOcclusion.h"
+#include "SurfaceSampler.h"
+#include "TextureCache.h"
+#include "TextureConverter.h"
+#include "TextureStreamer.h"
+#include "TextureUploader.h"
+#include "RenderQueue.h"
+#include "OcclusionQueries.h"
+#include "RenderState.h"
+#include "UniformBlock.h"
+#include "UniformRing.h"
+#include "SamplerCache.h"
+#include "VertexArrays.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 namespace aie {
 
+OBJMesh::OBJMesh()
+	: m_vertexFormat(FULL_VERTEX),
+	m_mergeMaterials(false),
+	m_pickable(false),
+	m_lightmapResolution(0),
+	m_emissionSurface(false),
+	m_lazyTextures(false),
+	m_packScalarMaps(false),
+	m_atlasTextures(false) {
+}
+
 OBJMesh::~OBJMesh() {
-	for (auto& c : m_meshChunks) {
-		glDeleteVertexArrays(1, &c.vao);
-		glDeleteBuffers(1, &c.vbo);
-		glDeleteBuffers(1, &c.ibo);
+	unload();
+}
+
+void OBJMesh::unload() {
+	// the chunks delete their buffers and vertex arrays, the textures go
+	// with their last material, the rest is only cpu memory
+	m_meshChunks.clear();
+	m_materials.clear();
+	m_chunkBounds.clear();
+	m_chunkVisibility.clear();
+	m_rangeBounds.clear();
+	m_rangeFirstIndices.clear();
+	m_rangeIndexCounts.clear();
+	m_rangeVisibility.clear();
+	m_chunkViewMasks.clear();
+	m_meshlets.clear();
+	m_chunkLODs.clear();
+	m_chunkUVDensities.clear();
+	m_pickChunks.clear();
+	m_pickBvh.clear();
+	m_surface.reset();
+	m_materialsSeen.clear();
+	m_instances.reset();
+	m_pendingChunks.clear();
+	m_filename.clear();
+}
+
+// binary mesh cache layout, all blocks padded to 16 bytes:
+//	CacheHeader
+//	dependencies: path as (uint32 length, chars), uint64 size, int64 time
+//	materials: 14 floats, then 7 texture names as (uint32 length, chars)
+//	chunks: CacheChunk, vertices[vertexBytes], indices[indexBytes],
+//	uint32 rangeIndexCounts[rangeCount], vec2 lightmap[lightmapBytes / 8]
+//	a chunk's vertices are CacheVertex[vertexCount] and its indices the
+//	triangles of its levels of detail one after another, each compressed
+//	by the MeshCodec. a merged chunk's ranges and a lightmapped chunk's
+//	texcoords, one per vertex, are left as they are
+static const unsigned int CACHE_MAGIC = 0x4d534e53; // "SNSM"
+static const unsigned int CACHE_VERSION = 9; // 5: compressed quantised chunks, 6: chunks merged by material, 7: lightmaps, 8: dependencies, 9: gltf buffers
+
+// the size a dependency is stamped with while it doesn't exist
+static const unsigned long long MISSING_DEPENDENCY = ~0ull;
+
+// a vertex as the cache keeps it. positions and texcoords stay exact, the
+// unit length normal and tangent lose nothing worth shading in 10 bits each
+struct CacheVertex {
+	glm::vec3		position;
+	unsigned int	normal;		// snorm 10:10:10:2, w 0
+	glm::vec2		texcoord;
+	unsigned int	tangent;	// snorm 10:10:10:2, w the bitangent's sign
+};
+
+struct CacheHeader {
+	unsigned int		magic;
+	unsigned int		version;
+	unsigned long long	sourceSize;
+	long long			sourceTime;
+	unsigned int		flipTextureV;
+	unsigned int		mergeMaterials;
+	unsigned int		lightmapResolution;
+	unsigned int		vertexSize;
+	unsigned int		materialCount;
+	unsigned int		chunkCount;
+	unsigned int		dependencyCount;
+};
+
+// a file besides the source the cache was made from, like an obj's mtl
+// files or a gltf's buffers, stamped as it was so an edit to it re-imports the mesh too
+struct CacheDependency {
+	std::string			path;
+	unsigned long long	size;
+	long long			time;
+};
+
+static CacheDependency stampDependency(const std::string& path) {
+	CacheDependency dependency = { path, MISSING_DEPENDENCY, 0 };
+	if (sns::FileSystem::instance().getFileStamp(path.c_str(), dependency.size, dependency.time) == false) {
+		dependency.size = MISSING_DEPENDENCY;
+		dependency.time = 0;
+	}
+	return dependency;
+}
+
+// where each attrib of the two vertex formats is. the packed positions are
+// three floats, the fourth defaults to 1, and normals and tangents are
+// signed normalised 10 bit xyz with a 2 bit w
+static constexpr sns::VertexLayout FULL_VERTEX_LAYOUT = sns::makeVertexLayout<OBJMesh::Vertex>(
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::Vertex, position, 0, FLOAT4),
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::Vertex, normal, 1, FLOAT4),
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::Vertex, texcoord, 2, FLOAT2),
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::Vertex, tangent, 3, FLOAT4));
+static constexpr sns::VertexLayout PACKED_VERTEX_LAYOUT = sns::makeVertexLayout<OBJMesh::PackedVertex>(
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::PackedVertex, position, 0, FLOAT3),
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::PackedVertex, normal, 1, SNORM_10_10_10_2),
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::PackedVertex, texcoord, 2, HALF2),
+	SNS_VERTEX_ATTRIBUTE(OBJMesh::PackedVertex, tangent, 3, SNORM_10_10_10_2));
+static_assert(sns::isValidLayout(FULL_VERTEX_LAYOUT), "OBJMesh::Vertex layout is invalid");
+static_assert(sns::isValidLayout(PACKED_VERTEX_LAYOUT), "OBJMesh::PackedVertex layout is invalid");
+
+// the transform drawInstanced streams for each instance
+struct InstanceTransform {
+	glm::mat4 transform;
+};
+static constexpr sns::VertexLayout INSTANCE_LAYOUT = sns::makeVertexLayout<InstanceTransform>(
+	SNS_VERTEX_ATTRIBUTE(InstanceTransform, transform, OBJMesh::INSTANCE_ATTRIBUTE, MAT4));
+static_assert(sns::isValidLayout(INSTANCE_LAYOUT), "OBJMesh instance layout is invalid");
+
+// the most vertices a chunk can have and still use 16 bit indices
+static const unsigned int MAX_SHORT_INDEX_VERTICES = 65536;
+
+// the largest texcoord PACKED_VERTEX keeps to within a texel of a 1024 texture
+static const float MAX_PACKED_TEXCOORD = 2.0f;
+
+// each level of detail after the first may move the surface this much
+// further, as a fraction of the chunk's bounds, and has to drop at least
+// a tenth of the triangles of the level before to be kept
+static const float LOD_ERROR = 0.01f;
+static const float LOD_MIN_REDUCTION = 0.9f;
+
+// chunks under this many pixels tall on screen use the second level of
+// detail, each level after is used at half the size of the one before.
+// with LOD_ERROR that keeps the surface within about a pixel
+static const float LOD_PIXELS = 128.0f;
+
+// how far past a switch the size must go before the level changes
+static const float LOD_HYSTERESIS = 0.1f;
+
+float OBJMesh::s_lodScale = 1.0f;
+
+// triangles or vertices a calculateTangents job works through, meshes
+// smaller than this are done on the calling thread
+static const unsigned int TANGENT_JOB_SIZE = 16384;
+
+// calculateTangents scratch, kept between calls on a thread so importing
+// many chunks doesn't allocate for each one
+struct TangentScratch {
+	std::vector<glm::vec4>		directions;		// the sdir and tdir of each triangle
+	std::vector<unsigned int>	firstCorner;	// each vertex's first in corners
+	std::vector<unsigned int>	corners;		// the corners of each vertex, in triangle order
+};
+static thread_local TangentScratch t_tangentScratch;
+
+// runs body over [first, last) ranges of count items as jobs, waiting for
+// them all. a single range runs on the calling thread
+static void parallelRanges(unsigned int count, unsigned int rangeSize,
+						   const std::function<void(unsigned int, unsigned int)>& body) {
+	if (count <= rangeSize) {
+		body(0, count);
+		return;
+	}
+
+	sns::JobSystem& jobs = sns::JobSystem::instance();
+	sns::JobCounter counter;
+	for (unsigned int first = 0; first < count; first += rangeSize) {
+		unsigned int last = count - first < rangeSize ? count : first + rangeSize;
+		jobs.run([&body, first, last]() { body(first, last); }, &counter);
+	}
+	jobs.wait(counter);
+}
+
+struct CacheChunk {
+	int				materialID;
+	unsigned int	vertexCount;
+	unsigned int	indexCount;
+	unsigned int	lodCount;
+	unsigned int	lodIndexCounts[OBJMesh::MAX_LODS];
+	unsigned int	vertexBytes;
+	unsigned int	indexBytes;
+	unsigned int	rangeCount;
+	unsigned int	lightmapBytes;
+};
+
+// a chunk's compressed streams, ranges and lightmap in the mapped cache
+struct CachedChunkView {
+	const unsigned char*	vertices;
+	const unsigned char*	indices;
+	const unsigned int*		ranges;
+	const glm::vec2*		lightmap;
+	CacheChunk				info;
+};
+
+static CacheVertex toCacheVertex(const OBJMesh::Vertex& vertex) {
+	CacheVertex cached;
+	cached.position = glm::vec3(vertex.position);
+	cached.normal = glm::packSnorm3x10_1x2(glm::vec4(glm::vec3(vertex.normal), 0));
+	cached.texcoord = vertex.texcoord;
+	cached.tangent = glm::packSnorm3x10_1x2(glm::vec4(glm::vec3(vertex.tangent), vertex.tangent.w < 0 ? -1.0f : 1.0f));
+	return cached;
+}
+
+static OBJMesh::Vertex fromCacheVertex(const CacheVertex& cached) {
+	OBJMesh::Vertex vertex;
+	vertex.position = glm::vec4(cached.position, 1);
+	vertex.normal = glm::vec4(glm::vec3(glm::unpackSnorm3x10_1x2(cached.normal)), 0);
+	vertex.texcoord = cached.texcoord;
+	vertex.tangent = glm::unpackSnorm3x10_1x2(cached.tangent);
+	return vertex;
+}
+
+static size_t alignCacheOffset(size_t offset) {
+	return (offset + 15) & ~(size_t)15;
+}
+
+static void writePadding(FILE* file, size_t& offset) {
+	static const char zeros[16] = {};
+	size_t aligned = alignCacheOffset(offset);
+	fwrite(zeros, 1, aligned - offset, file);
+	offset = aligned;
+}
+
+static void writeBytes(FILE* file, size_t& offset, const void* data, size_t size) {
+	fwrite(data, 1, size, file);
+	offset += size;
+}
+
+static void writeString(FILE* file, size_t& offset, const std::string& string) {
+	unsigned int length = (unsigned int)string.size();
+	writeBytes(file, offset, &length, sizeof(unsigned int));
+	writeBytes(file, offset, string.data(), length);
+}
+
+static bool readBytes(const sns::FileView& cache, size_t& offset, void* data, size_t size) {
+	if (offset + size > cache.getSize())
+		return false;
+	memcpy(data, cache.getData() + offset, size);
+	offset += size;
+	return true;
+}
+
+static bool readString(const sns::FileView& cache, size_t& offset, std::string& string) {
+	unsigned int length = 0;
+	if (readBytes(cache, offset, &length, sizeof(unsigned int)) == false ||
+		offset + length > cache.getSize())
+		return false;
+	string.assign((const char*)cache.getData() + offset, length);
+	offset += length;
+	return true;
+}
+
+static bool writeMeshCache(const char* cacheFile, const CacheHeader& header,
+						   const std::vector<CacheDependency>& dependencies,
+						   const std::vector<tinyobj::material_t>& materials,
+						   const std::vector<CacheChunk>& chunkInfo,
+						   const std::vector<std::vector<unsigned char>>& vertices,
+						   const std::vector<std::vector<unsigned char>>& indices,
+						   const std::vector<std::vector<unsigned int>>& ranges,
+						   const std::vector<const std::vector<glm::vec2>*>& lightmaps) {
+
+	// write to a temporary file first so a crash never leaves a half written cache
+	std::string tempFile = std::string(cacheFile) + ".tmp";
+	FILE* file = nullptr;
+	fopen_s(&file, tempFile.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	size_t offset = 0;
+	writeBytes(file, offset, &header, sizeof(CacheHeader));
+	writePadding(file, offset);
+
+	for (auto& d : dependencies) {
+		writeString(file, offset, d.path);
+		writeBytes(file, offset, &d.size, sizeof(unsigned long long));
+		writeBytes(file, offset, &d.time, sizeof(long long));
+	}
+	writePadding(file, offset);
+
+	for (auto& m : materials) {
+		writeBytes(file, offset, m.ambient, sizeof(float) * 3);
+		writeBytes(file, offset, m.diffuse, sizeof(float) * 3);
+		writeBytes(file, offset, m.specular, sizeof(float) * 3);
+		writeBytes(file, offset, m.emission, sizeof(float) * 3);
+		writeBytes(file, offset, &m.shininess, sizeof(float));
+		writeBytes(file, offset, &m.dissolve, sizeof(float));
+		writeString(file, offset, m.alpha_texname);
+		writeString(file, offset, m.ambient_texname);
+		writeString(file, offset, m.diffuse_texname);
+		writeString(file, offset, m.specular_texname);
+		writeString(file, offset, m.specular_highlight_texname);
+		writeString(file, offset, m.bump_texname);
+		writeString(file, offset, m.displacement_texname);
+	}
+	writePadding(file, offset);
+
+	for (size_t i = 0; i < chunkInfo.size(); ++i) {
+		writeBytes(file, offset, &chunkInfo[i], sizeof(CacheChunk));
+		writeBytes(file, offset, vertices[i].data(), vertices[i].size());
+		writePadding(file, offset);
+		writeBytes(file, offset, indices[i].data(), indices[i].size());
+		writePadding(file, offset);
+		writeBytes(file, offset, ranges[i].data(), ranges[i].size() * sizeof(unsigned int));
+		writePadding(file, offset);
+		writeBytes(file, offset, lightmaps[i]->data(), chunkInfo[i].lightmapBytes);
+		writePadding(file, offset);
+	}
+
+	bool success = ferror(file) == 0;
+	fclose(file);
+
+	if (success) {
+		remove(cacheFile);
+		success = rename(tempFile.c_str(), cacheFile) == 0;
+	}
+	if (success == false)
+		remove(tempFile.c_str());
+	return success;
+}
+
+static bool readMeshCache(const sns::FileView& cache, unsigned long long sourceSize, long long sourceTime,
+						  bool flipTextureV, bool mergeMaterials, unsigned int lightmapResolution,
+						  std::vector<tinyobj::material_t>& materials,
+						  std::vector<CachedChunkView>& chunks) {
+
+	size_t offset = 0;
+	CacheHeader header;
+	if (readBytes(cache, offset, &header, sizeof(CacheHeader)) == false)
+		return false;
+
+	// stale or foreign caches are ignored and the obj is re-imported
+	if (header.magic != CACHE_MAGIC ||
+		header.version != CACHE_VERSION ||
+		header.sourceSize != sourceSize ||
+		header.sourceTime != sourceTime ||
+		header.flipTextureV != (flipTextureV ? 1u : 0u) ||
+		header.mergeMaterials != (mergeMaterials ? 1u : 0u) ||
+		header.lightmapResolution != lightmapResolution ||
+		header.vertexSize != sizeof(CacheVertex))
+		return false;
+
+	offset = alignCacheOffset(offset);
+
+	// so is one whose other files have changed, appeared or gone since
+	for (unsigned int i = 0; i < header.dependencyCount; ++i) {
+		CacheDependency cached;
+		if (readString(cache, offset, cached.path) == false ||
+			readBytes(cache, offset, &cached.size, sizeof(unsigned long long)) == false ||
+			readBytes(cache, offset, &cached.time, sizeof(long long)) == false)
+			return false;
+		CacheDependency current = stampDependency(cached.path);
+		if (current.size != cached.size || current.time != cached.time)
+			return false;
+	}
+	offset = alignCacheOffset(offset);
+
+	materials.resize(header.materialCount);
+	for (auto& m : materials) {
+		if (readBytes(cache, offset, m.ambient, sizeof(float) * 3) == false ||
+			readBytes(cache, offset, m.diffuse, sizeof(float) * 3) == false ||
+			readBytes(cache, offset, m.specular, sizeof(float) * 3) == false ||
+			readBytes(cache, offset, m.emission, sizeof(float) * 3) == false ||
+			readBytes(cache, offset, &m.shininess, sizeof(float)) == false ||
+			readBytes(cache, offset, &m.dissolve, sizeof(float)) == false ||
+			readString(cache, offset, m.alpha_texname) == false ||
+			readString(cache, offset, m.ambient_texname) == false ||
+			readString(cache, offset, m.diffuse_texname) == false ||
+			readString(cache, offset, m.specular_texname) == false ||
+			readString(cache, offset, m.specular_highlight_texname) == false ||
+			readString(cache, offset, m.bump_texname) == false ||
+			readString(cache, offset, m.displacement_texname) == false)
+			return false;
+	}
+	offset = alignCacheOffset(offset);
+
+	// walk the whole file before anything is uploaded so a truncated cache fails cleanly
+	chunks.resize(header.chunkCount);
+	for (auto& c : chunks) {
+		if (readBytes(cache, offset, &c.info, sizeof(CacheChunk)) == false)
+			return false;
+
+		unsigned int lodIndices = 0;
+		if (c.info.lodCount == 0 || c.info.lodCount > OBJMesh::MAX_LODS)
+			return false;
+		for (unsigned int l = 0; l < c.info.lodCount; ++l)
+			lodIndices += c.info.lodIndexCounts[l];
+		if (lodIndices != c.info.indexCount)
+			return false;
+
+		if (c.info.indexCount % 3 != 0)
+			return false;
+
+		if (offset + c.info.vertexBytes > cache.getSize())
+			return false;
+		c.vertices = cache.getData() + offset;
+		offset = alignCacheOffset(offset + c.info.vertexBytes);
+
+		if (offset + c.info.indexBytes > cache.getSize())
+			return false;
+		c.indices = cache.getData() + offset;
+		offset = alignCacheOffset(offset + c.info.indexBytes);
+
+		// ranges split the full detail level between them
+		size_t rangeBytes = (size_t)c.info.rangeCount * sizeof(unsigned int);
+		if (offset + rangeBytes > cache.getSize())
+			return false;
+		c.ranges = (const unsigned int*)(cache.getData() + offset);
+		offset = alignCacheOffset(offset + rangeBytes);
+		unsigned int rangeIndices = 0;
+		for (unsigned int r = 0; r < c.info.rangeCount; ++r)
+			rangeIndices += c.ranges[r];
+		if (c.info.rangeCount > 0 && rangeIndices != c.info.lodIndexCounts[0])
+			return false;
+
+		// a lightmapped mesh has a texcoord for every vertex
+		size_t lightmapBytes = lightmapResolution > 0 ? (size_t)c.info.vertexCount * sizeof(glm::vec2) : 0;
+		if (c.info.lightmapBytes != lightmapBytes || offset + lightmapBytes > cache.getSize())
+			return false;
+		c.lightmap = (const glm::vec2*)(cache.getData() + offset);
+		offset = alignCacheOffset(offset + lightmapBytes);
 	}
+	return true;
+}
+
+// materials without a texture have an empty name, those get no path at all.
+// a dds made by --convert-textures next to the image is used instead of it
+static std::string texturePath(const std::string& folder, const std::string& name) {
+	if (name.empty())
+		return std::string();
+
+	std::string path = folder + name;
+	std::string compressed = sns::TextureConverter::getCompressedName(path);
+	if (compressed != path && sns::FileSystem::instance().exists(compressed.c_str()))
+		return compressed;
+	return path;
+}
+
+// .gltf and .glb models import through the GltfImporter, anything else is an obj
+static bool hasGltfExtension(const std::string& filename) {
+	std::string extension = filename.substr(filename.find_last_of('.') + 1);
+	for (auto& c : extension)
+		c = (char)tolower((unsigned char)c);
+	return extension == "gltf" || extension == "glb";
+}
+
+// shared textures may be null or still waiting for their upload
+static unsigned int textureHandle(const std::shared_ptr<Texture>& texture) {
+	return texture != nullptr ? texture->getHandle() : 0;
 }
 
 bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */) {
+	return import(filename, loadTextures, flipTextureV) && upload();
+}
 
-	if (m_meshChunks.empty() == false) {
+bool OBJMesh::import(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */) {
+	SNS_TRACE_ZONE("OBJMesh::import");
+
+	if (m_meshChunks.empty() == false || m_pendingChunks.empty() == false) {
 		printf("Mesh already initialised, can't re-initialise!\n");
 		return false;
 	}
 
-	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
-	std::string error = "";
 
 	std::string file = filename;
 	std::string folder = file.substr(0, file.find_last_of('/') + 1);
+	std::string cacheFile = file + getCacheExtension();
+
+	unsigned long long sourceSize = 0;
+	long long sourceTime = 0;
+	sns::FileSystem& fileSystem = sns::FileSystem::instance();
+	bool hasSource = fileSystem.getFileStamp(filename, sourceSize, sourceTime);
+
+	// try the binary cache first. each chunk is decoded as its own job,
+	// and the view is closed once they all are
+	sns::FileView cache;
+	std::vector<CachedChunkView> cachedChunks;
+	bool cached = hasSource &&
+		fileSystem.open(cacheFile.c_str(), cache) &&
+		readMeshCache(cache, sourceSize, sourceTime, flipTextureV, m_mergeMaterials, m_lightmapResolution,
+					  materials, cachedChunks);
+	if (cached) {
+		m_pendingChunks.resize(cachedChunks.size());
+		std::vector<char> decoded(cachedChunks.size(), 0);
+		parallelRanges((unsigned int)cachedChunks.size(), 1, [&](unsigned int first, unsigned int last) {
+			std::vector<CacheVertex> cachedVertices;
+			for (unsigned int i = first; i < last; ++i) {
+				const CachedChunkView& view = cachedChunks[i];
+				ChunkData& chunk = m_pendingChunks[i];
+				cachedVertices.resize(view.info.vertexCount);
+				chunk.indices.resize(view.info.indexCount);
+				if (sns::MeshCodec::decodeVertexBuffer(cachedVertices.data(), view.info.vertexCount, sizeof(CacheVertex),
+													   view.vertices, view.info.vertexBytes) == false ||
+					sns::MeshCodec::decodeIndexBuffer(chunk.indices.data(), view.info.indexCount, sizeof(unsigned int),
+													  view.indices, view.info.indexBytes) == false)
+					continue;
+
+				// a corrupt cache could still name vertices it doesn't have
+				bool inRange = true;
+				for (unsigned int index : chunk.indices)
+					inRange = inRange && index < view.info.vertexCount;
+				if (inRange == false)
+					continue;
+
+				chunk.vertices.resize(view.info.vertexCount);
+				for (unsigned int v = 0; v < view.info.vertexCount; ++v)
+					chunk.vertices[v] = fromCacheVertex(cachedVertices[v]);
+				decoded[i] = 1;
+			}
+		});
+
+		for (size_t i = 0; i < cachedChunks.size(); ++i) {
+			ChunkData& chunk = m_pendingChunks[i];
+			chunk.vertexData = chunk.vertices.data();
+			chunk.indexData = chunk.indices.data();
+			chunk.vertexCount = cachedChunks[i].info.vertexCount;
+			chunk.indexCount = cachedChunks[i].info.indexCount;
+			chunk.materialID = cachedChunks[i].info.materialID;
+			chunk.lodCount = cachedChunks[i].info.lodCount;
+			memcpy(chunk.lodIndexCounts, cachedChunks[i].info.lodIndexCounts, sizeof(cachedChunks[i].info.lodIndexCounts));
+			chunk.rangeIndexCounts.assign(cachedChunks[i].ranges, cachedChunks[i].ranges + cachedChunks[i].info.rangeCount);
+			chunk.lightmapTexcoords.assign(cachedChunks[i].lightmap,
+										   cachedChunks[i].lightmap + cachedChunks[i].info.lightmapBytes / sizeof(glm::vec2));
+			cached = cached && decoded[i] != 0;
+		}
+		if (cached == false)
+			printf("Mesh cache %s is corrupt, re-importing\n", cacheFile.c_str());
+	}
+	cache.close();
+
+	if (cached == false) {
+		m_pendingChunks.clear();
+		materials.clear();
+
+		// the files read besides the source, stamped into the cache
+		std::vector<CacheDependency> dependencies;
+
+		// the geometry is parsed on every core at once, tinyobj is only
+		// still used for the mtl files
+		sns::ObjParser parser;
+		sns::GltfImporter gltf;
+		std::map<std::string, int> materialMap;
+		bool isGltf = hasGltfExtension(file);
+		if (isGltf) {
+			if (gltf.parse(filename, flipTextureV) == false) {
+				printf("%s\n", gltf.getLastError().c_str());
+				return false;
+			}
+			for (auto& path : gltf.getBufferPaths())
+				dependencies.push_back(stampDependency(path));
+
+			// the materials go through the cache as an mtl file's would
+			for (auto& m : gltf.getMaterials()) {
+				tinyobj::material_t material;
+				tinyobj::InitMaterial(material);
+				material.name = m.name;
+				memcpy(material.ambient, &m.ambient[0], sizeof(float) * 3);
+				memcpy(material.diffuse, &m.diffuse[0], sizeof(float) * 3);
+				memcpy(material.specular, &m.specular[0], sizeof(float) * 3);
+				memcpy(material.emission, &m.emissive[0], sizeof(float) * 3);
+				material.shininess = m.specularPower;
+				material.dissolve = m.opacity;
+				material.diffuse_texname = m.diffuseTexture;
+				material.bump_texname = m.normalTexture;
+				if (m.alphaTested)
+					material.alpha_texname = m.diffuseTexture;
+				materialMap[m.name] = (int)materials.size();
+				materials.push_back(material);
+			}
+		}
+		else {
+			if (parser.parse(filename, flipTextureV) == false) {
+				printf("%s\n", parser.getLastError().c_str());
+				return false;
+			}
+
+			// the mtl files are read through the file system too, so they can
+			// be in an archive
+			for (auto& library : parser.getMaterialLibraries()) {
+				std::string path = folder + library;
+				dependencies.push_back(stampDependency(path));
+				sns::FileView mtl;
+				if (fileSystem.open(path.c_str(), mtl) == false) {
+					printf("WARN: Material file [ %s ] not found.\n", path.c_str());
+					continue;
+				}
+				std::istringstream stream(std::string((const char*)mtl.getData(), mtl.getSize()));
+				tinyobj::LoadMtl(materialMap, materials, stream);
+			}
+		}
 
-	bool success = tinyobj::LoadObj(shapes, materials, error,
-									filename, folder.c_str());
+		std::vector<sns::ObjParser::Shape>& shapes = isGltf ? gltf.getShapes() : parser.getShapes();
+
+		// totals of what the optimiser did, reported once for the whole obj
+		unsigned int verticesBefore = 0, verticesAfter = 0;
+		double missesBefore = 0, missesAfter = 0, triangles = 0;
+
+		// copy shapes
+		std::vector<ChunkData>& chunks = m_pendingChunks;
+		chunks.resize(shapes.size());
+		for (size_t c = 0; c < shapes.size(); ++c) {
+
+			auto& s = shapes[c];
+			ChunkData& chunk = chunks[c];
+
+			// the parser has already made the vertices, with V flipped
+			std::vector<Vertex>& vertices = chunk.vertices;
+			vertices.swap(s.vertices);
+
+			bool hasNormal = s.hasNormals;
+			bool hasTexture = s.hasTexcoords;
+
+			// weld, then order the triangles for the vertex cache and the
+			// vertices for fetching. the cache stores the result, so this
+			// only runs the first time an obj is imported
+			sns::MeshOptimiser::Stats stats = sns::MeshOptimiser::optimise(vertices, s.indices);
+			verticesBefore += stats.verticesBefore;
+			verticesAfter += stats.verticesAfter;
+			missesBefore += stats.acmrBefore * (s.indices.size() / 3);
+			missesAfter += stats.acmrAfter * (s.indices.size() / 3);
+			triangles += s.indices.size() / 3;
+
+			// calculate for normal mapping, unless a gltf brought them
+			if (hasNormal && hasTexture && s.hasTangents == false)
+				calculateTangents(vertices, s.indices);
+
+			chunk.indices.swap(s.indices);
+
+			chunk.vertexData = chunk.vertices.data();
+			chunk.indexData = chunk.indices.data();
+			chunk.vertexCount = (unsigned int)chunk.vertices.size();
+			chunk.indexCount = (unsigned int)chunk.indices.size();
+
+			// set chunk material, faces before any usemtl have none
+			auto material = s.material.empty() ? materialMap.end() : materialMap.find(s.material);
+			chunk.materialID = material != materialMap.end() ? material->second : -1;
+			chunk.lodCount = 1;
+			chunk.lodIndexCounts[0] = chunk.indexCount;
+		}
 
-	if (success == false) {
-		printf("%s\n", error.c_str());
-		return false;
+		if (triangles > 0)
+			printf("%s: %u vertices welded to %u, ACMR %.3f to %.3f\n", filename,
+				   verticesBefore, verticesAfter, missesBefore / triangles, missesAfter / triangles);
+
+		// small shapes of a material become ranges of one chunk, before
+		// the split so the pieces of a big shape are left as they are
+		if (m_mergeMaterials)
+			mergeChunksByMaterial(chunks);
+
+		// split the big chunks so every chunk fits 16 bit indices. after
+		// optimising the triangles are in patches, so the pieces are too
+		std::vector<ChunkData> pieces;
+		pieces.reserve(chunks.size());
+		for (auto& c : chunks) {
+			if (c.vertexCount <= MAX_SHORT_INDEX_VERTICES) {
+				pieces.push_back(std::move(c));
+				continue;
+			}
+
+			std::vector<std::vector<Vertex>> pieceVertices;
+			std::vector<std::vector<unsigned int>> pieceIndices;
+			sns::MeshOptimiser::split(c.vertices, c.indices, MAX_SHORT_INDEX_VERTICES, pieceVertices, pieceIndices);
+			for (size_t p = 0; p < pieceVertices.size(); ++p) {
+				ChunkData piece;
+				piece.vertices.swap(pieceVertices[p]);
+				piece.indices.swap(pieceIndices[p]);
+				piece.vertexData = piece.vertices.data();
+				piece.indexData = piece.indices.data();
+				piece.vertexCount = (unsigned int)piece.vertices.size();
+				piece.indexCount = (unsigned int)piece.indices.size();
+				piece.materialID = c.materialID;
+				piece.lodCount = 1;
+				piece.lodIndexCounts[0] = piece.indexCount;
+				pieces.push_back(std::move(piece));
+			}
+		}
+		chunks.swap(pieces);
+
+		// the lightmap unwrap copies the vertices on its seams, so it comes
+		// before the levels of detail, which then keep to the charts. a
+		// chunk the copies push past 16 bits keeps 32 bit indices
+		if (m_lightmapResolution > 0) {
+			sns::LightmapPacker packer(m_lightmapResolution);
+			for (auto& c : chunks)
+				packer.addChunk(c.vertices, c.indices);
+			sns::LightmapPacker::Stats stats = packer.pack();
+			for (size_t i = 0; i < chunks.size(); ++i) {
+				ChunkData& c = chunks[i];
+				packer.getTexcoords((unsigned int)i, c.lightmapTexcoords);
+				c.vertexData = c.vertices.data();
+				c.vertexCount = (unsigned int)c.vertices.size();
+			}
+			printf("%s: lightmap of %u charts, %u vertices split to %u, %.0f%% of %u texels square covered\n", filename,
+				   stats.charts, stats.verticesBefore, stats.verticesAfter, stats.coverage * 100.0f, m_lightmapResolution);
+		}
+
+		// every chunk gets coarser levels of detail over its own vertices.
+		// the vertices are then rounded as the cache keeps them, so this
+		// import draws exactly as the cached ones will
+		for (auto& c : chunks) {
+			buildLODs(c);
+			c.indexData = c.indices.data();
+			c.indexCount = (unsigned int)c.indices.size();
+			for (auto& v : c.vertices)
+				v = fromCacheVertex(toCacheVertex(v));
+		}
+
+		// write the cache so the next launch can skip parsing
+		if (hasSource) {
+			CacheHeader header = {};
+			header.magic = CACHE_MAGIC;
+			header.version = CACHE_VERSION;
+			header.sourceSize = sourceSize;
+			header.sourceTime = sourceTime;
+			header.flipTextureV = flipTextureV ? 1 : 0;
+			header.mergeMaterials = m_mergeMaterials ? 1 : 0;
+			header.lightmapResolution = m_lightmapResolution;
+			header.vertexSize = sizeof(CacheVertex);
+			header.materialCount = (unsigned int)materials.size();
+			header.chunkCount = (unsigned int)chunks.size();
+			header.dependencyCount = (unsigned int)dependencies.size();
+
+			// the chunks are compressed as jobs too
+			std::vector<CacheChunk> chunkInfo(chunks.size());
+			std::vector<std::vector<unsigned char>> vertices(chunks.size());
+			std::vector<std::vector<unsigned char>> indices(chunks.size());
+			std::vector<std::vector<unsigned int>> ranges(chunks.size());
+			std::vector<const std::vector<glm::vec2>*> lightmaps(chunks.size());
+			parallelRanges((unsigned int)chunks.size(), 1, [&](unsigned int first, unsigned int last) {
+				std::vector<CacheVertex> cachedVertices;
+				for (unsigned int i = first; i < last; ++i) {
+					const ChunkData& c = chunks[i];
+					cachedVertices.resize(c.vertexCount);
+					for (unsigned int v = 0; v < c.vertexCount; ++v)
+						cachedVertices[v] = toCacheVertex(c.vertices[v]);
+					sns::MeshCodec::encodeVertexBuffer(vertices[i], cachedVertices.data(), c.vertexCount, sizeof(CacheVertex));
+					sns::MeshCodec::encodeIndexBuffer(indices[i], c.indices.data(), c.indexCount);
+
+					CacheChunk& info = chunkInfo[i];
+					info = {};
+					info.materialID = c.materialID;
+					info.vertexCount = c.vertexCount;
+					info.indexCount = c.indexCount;
+					info.lodCount = c.lodCount;
+					memcpy(info.lodIndexCounts, c.lodIndexCounts, sizeof(info.lodIndexCounts));
+					info.vertexBytes = (unsigned int)vertices[i].size();
+					info.indexBytes = (unsigned int)indices[i].size();
+					info.rangeCount = (unsigned int)c.rangeIndexCounts.size();
+					ranges[i] = c.rangeIndexCounts;
+					info.lightmapBytes = (unsigned int)(c.lightmapTexcoords.size() * sizeof(glm::vec2));
+					lightmaps[i] = &c.lightmapTexcoords;
+				}
+			});
+
+			if (writeMeshCache(cacheFile.c_str(), header, dependencies, materials, chunkInfo, vertices, indices, ranges, lightmaps) == false)
+				printf("Failed to write mesh cache %s\n", cacheFile.c_str());
+		}
+	}
+
+	// bounds for culling, from whichever source the vertices came from
+	for (auto& c : m_pendingChunks) {
+		c.boundsMin = glm::vec3(c.vertexCount > 0 ? c.vertexData[0].position : glm::vec4(0));
+		c.boundsMax = c.boundsMin;
+		for (unsigned int i = 1; i < c.vertexCount; ++i) {
+			glm::vec3 p = glm::vec3(c.vertexData[i].position);
+			c.boundsMin = glm::min(c.boundsMin, p);
+			c.boundsMax = glm::max(c.boundsMax, p);
+		}
+
+		// a range's bounds are of the vertices its triangles use
+		c.rangeBoundsMin.resize(c.rangeIndexCounts.size());
+		c.rangeBoundsMax.resize(c.rangeIndexCounts.size());
+		unsigned int firstIndex = 0;
+		for (size_t r = 0; r < c.rangeIndexCounts.size(); ++r) {
+			glm::vec3 rangeMin(FLT_MAX), rangeMax(-FLT_MAX);
+			for (unsigned int i = firstIndex; i < firstIndex + c.rangeIndexCounts[r]; ++i) {
+				glm::vec3 p = glm::vec3(c.vertexData[c.indexData[i]].position);
+				rangeMin = glm::min(rangeMin, p);
+				rangeMax = glm::max(rangeMax, p);
+			}
+			c.rangeBoundsMin[r] = rangeMin;
+			c.rangeBoundsMax[r] = rangeMax;
+			firstIndex += c.rangeIndexCounts[r];
+		}
+	}
+
+	// texcoord density for texture streaming, from the full detail
+	// triangles. like the bounds it is quick enough not to cache
+	for (auto& c : m_pendingChunks) {
+		double surfaceArea = 0, uvArea = 0;
+		for (unsigned int i = 0; i + 2 < c.lodIndexCounts[0]; i += 3) {
+			const Vertex& v0 = c.vertexData[c.indexData[i]];
+			const Vertex& v1 = c.vertexData[c.indexData[i + 1]];
+			const Vertex& v2 = c.vertexData[c.indexData[i + 2]];
+			surfaceArea += glm::length(glm::cross(glm::vec3(v1.position - v0.position), glm::vec3(v2.position - v0.position)));
+			glm::vec2 u = v1.texcoord - v0.texcoord, v = v2.texcoord - v0.texcoord;
+			uvArea += glm::abs(u.x * v.y - u.y * v.x);
+		}
+		c.uvDensity = surfaceArea > 0 ? (float)glm::sqrt(uvArea / surfaceArea) : 0;
+	}
+
+	// meshlets are cheap enough to cut on every load rather than cache
+	for (auto& c : m_pendingChunks)
+		sns::MeshOptimiser::buildMeshlets(c.vertexData, c.vertexCount, c.indexData, c.lodIndexCounts[0], c.meshlets);
+
+	// the triangles to pick against, before the vertices are packed and
+	// the indices narrowed. each chunk's bvh is built as its own job
+	if (m_pickable) {
+		m_pickChunks.resize(m_pendingChunks.size());
+		parallelRanges((unsigned int)m_pendingChunks.size(), 1, [this](unsigned int first, unsigned int last) {
+			for (unsigned int i = first; i < last; ++i)
+				buildPickChunk(m_pendingChunks[i], m_pickChunks[i]);
+		});
+
+		std::vector<sns::Bvh::Box> boxes;
+		boxes.reserve(m_pendingChunks.size());
+		for (auto& c : m_pendingChunks)
+			boxes.push_back({ c.boundsMin, c.boundsMax });
+		m_pickBvh.build(boxes.data(), (unsigned int)boxes.size());
+	}
+
+	// the emission surface, from the same full detail triangles
+	if (m_emissionSurface) {
+		m_surface = std::make_shared<sns::SurfaceSampler>();
+		for (auto& c : m_pendingChunks)
+			for (unsigned int i = 0; i + 2 < c.lodIndexCounts[0]; i += 3)
+				m_surface->addTriangle(glm::vec3(c.vertexData[c.indexData[i]].position),
+									   glm::vec3(c.vertexData[c.indexData[i + 1]].position),
+									   glm::vec3(c.vertexData[c.indexData[i + 2]].position));
+		m_surface->build();
+	}
+
+	// half floats are a texel apart on a 1024 texture by 2, so tiled
+	// texcoords past that keep the full layout
+	if (m_vertexFormat == PACKED_VERTEX) {
+		bool fits = true;
+		for (auto& c : m_pendingChunks)
+			for (unsigned int i = 0; i < c.vertexCount && fits; ++i)
+				fits = glm::abs(c.vertexData[i].texcoord.x) <= MAX_PACKED_TEXCOORD &&
+					   glm::abs(c.vertexData[i].texcoord.y) <= MAX_PACKED_TEXCOORD;
+
+		if (fits == false) {
+			printf("%s has texcoords too large to pack, keeping full vertices\n", filename);
+			m_vertexFormat = FULL_VERTEX;
+		}
+	}
+
+	// quantise here, on the importing thread, rather than in upload()
+	if (m_vertexFormat == PACKED_VERTEX) {
+		for (auto& c : m_pendingChunks) {
+			c.packedVertices.resize(c.vertexCount);
+			sns::convertVertices(FULL_VERTEX_LAYOUT, c.vertexData, PACKED_VERTEX_LAYOUT,
+								 c.packedVertices.data(), c.vertexCount);
+
+			// the full vertices are only needed for the cache, which is already written
+			std::vector<Vertex>().swap(c.vertices);
+		}
+	}
+
+	// halve the index buffers of chunks that fit 16 bits, every chunk of a
+	// fresh import does
+	for (auto& c : m_pendingChunks) {
+		if (c.vertexCount > MAX_SHORT_INDEX_VERTICES)
+			continue;
+		c.shortIndices.assign(c.indexData, c.indexData + c.indexCount);
+		std::vector<unsigned int>().swap(c.indices);
 	}
 
 	m_filename = filename;
@@ -59,279 +935,1204 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		m_materials[index].specularPower = m.shininess;
 		m_materials[index].opacity = m.dissolve;
 
-		// textures
-		m_materials[index].alphaTexture.load((folder + m.alpha_texname).c_str());
-		m_materials[index].ambientTexture.load((folder + m.ambient_texname).c_str());
-		m_materials[index].diffuseTexture.load((folder + m.diffuse_texname).c_str());
-		m_materials[index].specularTexture.load((folder + m.specular_texname).c_str());
-		m_materials[index].specularHighlightTexture.load((folder + m.specular_highlight_texname).c_str());
-		m_materials[index].normalTexture.load((folder + m.bump_texname).c_str());
-		m_materials[index].displacementTexture.load((folder + m.displacement_texname).c_str());
+		// textures are shared through the cache and only decoded here,
+		// upload() sends them to the gpu. lazy ones are placeholders until seen
+		if (loadTextures) {
+			TextureCache& cache = TextureCache::instance();
+			bool lazy = m_lazyTextures, atlas = m_atlasTextures;
+			Material& material = m_materials[index];
+			material.ambientTexture = cache.acquire(texturePath(folder, m.ambient_texname), Texture::COLOUR, lazy, atlas);
+			material.diffuseTexture = cache.acquire(texturePath(folder, m.diffuse_texname), Texture::COLOUR, lazy, atlas);
+			material.normalTexture = cache.acquire(texturePath(folder, m.bump_texname), Texture::NORMAL_MAP, lazy, atlas);
+
+			// two or more scalar maps are packed from their images, in
+			// the order of the PackedMap bits
+			const std::string* names[4] = { &m.specular_texname, &m.alpha_texname,
+											&m.specular_highlight_texname, &m.displacement_texname };
+			std::string channels[4];
+			unsigned int packed = 0;
+			for (unsigned int c = 0; c < 4; ++c) {
+				if (names[c]->empty() == false) {
+					channels[c] = folder + *names[c];
+					packed |= 1u << c;
+				}
+			}
+			if (m_packScalarMaps && (packed & (packed - 1)) != 0) {
+				material.packedTexture = cache.acquire(Texture::getPackedName(channels, 4), Texture::LINEAR_DATA, lazy, atlas);
+				if (material.packedTexture != nullptr)
+					material.packedMaps = packed;
+			}
+
+			// without them packed they are each their own texture
+			if (material.packedTexture == nullptr) {
+				material.alphaTexture = cache.acquire(texturePath(folder, m.alpha_texname), Texture::LINEAR_DATA, lazy, atlas);
+				material.specularTexture = cache.acquire(texturePath(folder, m.specular_texname), Texture::COLOUR, lazy, atlas);
+				material.specularHighlightTexture = cache.acquire(texturePath(folder, m.specular_highlight_texname), Texture::LINEAR_DATA, lazy, atlas);
+				material.displacementTexture = cache.acquire(texturePath(folder, m.displacement_texname), Texture::LINEAR_DATA, lazy, atlas);
+			}
+		}
 
 		++index;
 	}
 
-	// copy shapes
-	m_meshChunks.reserve(shapes.size());
-	for (auto& s : shapes) {
+	// load obj
+	return true;
+}
+
+bool OBJMesh::uploadBuffers() {
+	SNS_TRACE_ZONE("OBJMesh::uploadBuffers");
 
-		MeshChunk chunk;
+	// the shared vertex array is the main context's, only the buffers
+	// can be made here, and only by handle
+	if (sns::VertexArrays::isSupported() == false)
+		return false;
 
+	for (auto& c : m_pendingChunks) {
+		if (c.vbo != 0)
+			continue;
+		const void* vertices = m_vertexFormat == PACKED_VERTEX ? (const void*)c.packedVertices.data() : c.vertexData;
+		bool shortIndices = c.shortIndices.empty() == false;
+		const void* indices = shortIndices ? (const void*)c.shortIndices.data() : c.indexData;
+		unsigned int indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+		glCreateBuffers(1, &c.vbo);
+		glCreateBuffers(1, &c.ibo);
+		glNamedBufferStorage(c.ibo, c.indexCount * getIndexSize(indexType), indices, 0);
+		glNamedBufferStorage(c.vbo, c.vertexCount * getVertexSize(m_vertexFormat), vertices, 0);
+		if (c.lightmapTexcoords.empty() == false) {
+			glCreateBuffers(1, &c.lightmapVbo);
+			glNamedBufferStorage(c.lightmapVbo, c.lightmapTexcoords.size() * sizeof(glm::vec2), c.lightmapTexcoords.data(), 0);
+		}
+	}
+	return true;
+}
+
+bool OBJMesh::importMapped(const char* filename, bool flipTextureV /* = false */) {
+	SNS_TRACE_ZONE("OBJMesh::importMapped");
+
+	if (m_meshChunks.empty() == false || m_pendingChunks.empty() == false) {
+		printf("Mesh already initialised, can't re-initialise!\n");
+		return false;
+	}
+
+	// everything these need is built from the vertices on the cpu
+	if (sns::VertexArrays::isSupported() == false || m_pickable || m_emissionSurface || m_lightmapResolution > 0)
+		return false;
+
+	// the vertices then the indices, in one buffer only ever written. the
+	// new storage can't be in use, so mapping it needn't wait for the gpu
+	ChunkData chunk;
+	unsigned int staging = 0;
+	size_t vertexBytes = 0, indexBytes = 0;
+	unsigned int indexType = GL_UNSIGNED_INT;
+	auto map = [&](const sns::ObjParser::MappedCounts& counts, sns::ObjParser::MappedTarget& target) {
+		if (counts.vertexCount == 0 || counts.indexCount == 0)
+			return false;
+		target.shortIndices = counts.vertexCount <= MAX_SHORT_INDEX_VERTICES;
+		indexType = target.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		chunk.mappedShortIndices = target.shortIndices;
+		vertexBytes = (size_t)counts.vertexCount * sizeof(Vertex);
+		indexBytes = (size_t)counts.indexCount * getIndexSize(indexType);
+		chunk.vertexCount = counts.vertexCount;
+		chunk.indexCount = counts.indexCount;
+
+		glCreateBuffers(1, &staging);
+		glNamedBufferStorage(staging, vertexBytes + indexBytes, nullptr, GL_MAP_WRITE_BIT | GL_CLIENT_STORAGE_BIT);
+		unsigned char* data = (unsigned char*)glMapNamedBufferRange(staging, 0, vertexBytes + indexBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (data == nullptr)
+			return false;
+		target.vertices = (Vertex*)data;
+		target.indices = data + vertexBytes;
+		return true;
+	};
+
+	sns::ObjParser parser;
+	bool parsed = parser.parseMapped(filename, flipTextureV, map, chunk.boundsMin, chunk.boundsMax);
+	if (staging != 0 && glUnmapNamedBuffer(staging) == GL_FALSE) {
+		printf("%s: the staging buffer was lost while parsing\n", filename);
+		parsed = false;
+	}
+	if (parsed == false) {
+		if (staging != 0)
+			glDeleteBuffers(1, &staging);
+		printf("%s, importing it instead\n", parser.getLastError().c_str());
+		return false;
+	}
+
+	// the staging buffer is deleted once the copies have run
+	glCreateBuffers(1, &chunk.vbo);
+	glCreateBuffers(1, &chunk.ibo);
+	glNamedBufferStorage(chunk.vbo, vertexBytes, nullptr, 0);
+	glNamedBufferStorage(chunk.ibo, indexBytes, nullptr, 0);
+	glCopyNamedBufferSubData(staging, chunk.vbo, 0, 0, vertexBytes);
+	glCopyNamedBufferSubData(staging, chunk.ibo, vertexBytes, 0, indexBytes);
+	glDeleteBuffers(1, &staging);
+
+	chunk.materialID = -1;
+	chunk.lodCount = 1;
+	chunk.lodIndexCounts[0] = chunk.indexCount;
+	chunk.uvDensity = 0;
+	m_pendingChunks.push_back(std::move(chunk));
+	m_vertexFormat = FULL_VERTEX;
+	m_filename = filename;
+	printf("%s: %u vertices parsed straight into a mapped buffer\n", filename, m_pendingChunks[0].vertexCount);
+	return true;
+}
+
+bool OBJMesh::upload(sns::TextureUploader* textureUploader /* = nullptr */) {
+	SNS_TRACE_GL_ZONE("OBJMesh::upload");
+
+	if (m_meshChunks.empty() == false) {
+		printf("Mesh already uploaded!\n");
+		return false;
+	}
+
+	m_meshChunks.reserve(m_pendingChunks.size());
+	m_chunkBounds.clear();
+	m_chunkUVDensities.clear();
+	m_meshlets.clear();
+	m_rangeBounds.clear();
+	m_rangeFirstIndices.clear();
+	m_rangeIndexCounts.clear();
+	for (auto& c : m_pendingChunks) {
+		const void* vertices = m_vertexFormat == PACKED_VERTEX ? (const void*)c.packedVertices.data() : c.vertexData;
+		if (c.shortIndices.empty() == false || c.mappedShortIndices)
+			createChunk(vertices, c.vertexCount, c.shortIndices.data(), GL_UNSIGNED_SHORT, c);
+		else
+			createChunk(vertices, c.vertexCount, c.indexData, GL_UNSIGNED_INT, c);
+		m_chunkBounds.add(c.boundsMin, c.boundsMax);
+		m_chunkUVDensities.push_back(c.uvDensity);
+	}
+
+	// shared textures only upload once, later calls do nothing. a
+	// placeholder is a single texel, not worth the uploader's queue
+	for (auto& m : m_materials) {
+		Texture* textures[] = { m.alphaTexture.get(), m.ambientTexture.get(), m.diffuseTexture.get(),
+								m.specularTexture.get(), m.specularHighlightTexture.get(),
+								m.normalTexture.get(), m.displacementTexture.get(), m.packedTexture.get() };
+		for (auto t : textures) {
+			if (t == nullptr || t->isPendingUpload() == false)
+				continue;
+			if (textureUploader != nullptr && t->isPlaceholder() == false)
+				textureUploader->queue(t);
+			else
+				t->upload();
+		}
+	}
+
+	m_materialsSeen.assign(m_materials.size(), 0);
+
+	// the emission surface keeps its triangles on the cpu as well
+	if (m_surface != nullptr)
+		m_surface->upload();
+
+	// the cpu copies are no longer needed
+	m_pendingChunks.clear();
+	m_pendingChunks.shrink_to_fit();
+	return true;
+}
+
+void OBJMesh::buildLODs(ChunkData& chunk) {
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (const Vertex& v : chunk.vertices) {
+		boundsMin = glm::min(boundsMin, glm::vec3(v.position));
+		boundsMax = glm::max(boundsMax, glm::vec3(v.position));
+	}
+	float size = chunk.vertices.empty() ? 0 : glm::length(boundsMax - boundsMin);
+
+	// each level starts from the one before, aiming for half its triangles
+	std::vector<unsigned int> previous(chunk.indices.begin(), chunk.indices.end());
+	std::vector<unsigned int> lod;
+	float error = size * LOD_ERROR;
+	while (chunk.lodCount < MAX_LODS) {
+		sns::MeshOptimiser::simplify(chunk.vertices, previous, (unsigned int)previous.size() / 2, error, lod);
+		if (lod.empty() || lod.size() > previous.size() * LOD_MIN_REDUCTION)
+			break;
+
+		sns::MeshOptimiser::optimiseVertexCache(lod, (unsigned int)chunk.vertices.size());
+		chunk.indices.insert(chunk.indices.end(), lod.begin(), lod.end());
+		chunk.lodIndexCounts[chunk.lodCount++] = (unsigned int)lod.size();
+		previous.swap(lod);
+		error *= 2;
+	}
+}
+
+void OBJMesh::mergeChunksByMaterial(std::vector<ChunkData>& chunks) {
+
+	// the chunks of each material, materials in the order they first appear
+	std::unordered_map<int, unsigned int> groupOf;
+	std::vector<std::vector<size_t>> groups;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		auto found = groupOf.emplace(chunks[i].materialID, (unsigned int)groups.size());
+		if (found.second)
+			groups.emplace_back();
+		groups[found.first->second].push_back(i);
+	}
+
+	// each chunk joins the last of its material while their vertices fit
+	// 16 bit indices, its indices moved past the vertices already there.
+	// shapes too big for that stay alone
+	std::vector<ChunkData> merged;
+	merged.reserve(chunks.size());
+	for (auto& group : groups) {
+		size_t target = merged.size();
+		for (size_t i : group) {
+			ChunkData& c = chunks[i];
+			if (target < merged.size() && merged[target].vertexCount + c.vertexCount <= MAX_SHORT_INDEX_VERTICES) {
+				ChunkData& t = merged[target];
+				t.vertices.insert(t.vertices.end(), c.vertices.begin(), c.vertices.end());
+				t.indices.reserve(t.indices.size() + c.indexCount);
+				for (unsigned int index : c.indices)
+					t.indices.push_back(t.vertexCount + index);
+				t.rangeIndexCounts.push_back(c.indexCount);
+				t.vertexCount += c.vertexCount;
+				t.indexCount += c.indexCount;
+				continue;
+			}
+
+			target = merged.size();
+			merged.push_back(std::move(c));
+			merged[target].rangeIndexCounts.assign(1, merged[target].indexCount);
+		}
+	}
+
+	// a chunk nothing joined is drawn whole
+	for (auto& c : merged) {
+		if (c.rangeIndexCounts.size() < 2)
+			c.rangeIndexCounts.clear();
+		c.vertexData = c.vertices.data();
+		c.indexData = c.indices.data();
+		c.lodIndexCounts[0] = c.indexCount;
+	}
+	chunks.swap(merged);
+}
+
+void OBJMesh::buildPickChunk(const ChunkData& chunk, PickChunk& pick) {
+
+	pick.positions.resize(chunk.vertexCount);
+	for (unsigned int i = 0; i < chunk.vertexCount; ++i)
+		pick.positions[i] = glm::vec3(chunk.vertexData[i].position);
+	pick.indices.assign(chunk.indexData, chunk.indexData + chunk.lodIndexCounts[0]);
+
+	// the bake reads the normals and texcoords of lightmapped chunks
+	if (chunk.lightmapTexcoords.empty() == false) {
+		pick.normals.resize(chunk.vertexCount);
+		for (unsigned int i = 0; i < chunk.vertexCount; ++i)
+			pick.normals[i] = glm::vec3(chunk.vertexData[i].normal);
+		pick.lightmapTexcoords = chunk.lightmapTexcoords;
+	}
+
+	unsigned int triangleCount = chunk.lodIndexCounts[0] / 3;
+	std::vector<sns::Bvh::Box> boxes(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; ++t) {
+		const glm::vec3& p0 = pick.positions[pick.indices[t * 3]];
+		const glm::vec3& p1 = pick.positions[pick.indices[t * 3 + 1]];
+		const glm::vec3& p2 = pick.positions[pick.indices[t * 3 + 2]];
+		boxes[t].min = glm::min(p0, glm::min(p1, p2));
+		boxes[t].max = glm::max(p0, glm::max(p1, p2));
+	}
+	pick.triangles.build(boxes.data(), triangleCount);
+}
+
+// moller trumbore, how far along the ray it hits either side of the
+// triangle or -1 for a miss
+static float intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+							   const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float maxDistance) {
+	glm::vec3 edge1 = p1 - p0, edge2 = p2 - p0;
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (determinant == 0)
+		return -1;
+
+	float inverse = 1.0f / determinant;
+	glm::vec3 s = origin - p0;
+	float u = glm::dot(s, p) * inverse;
+	if (u < 0 || u > 1)
+		return -1;
+
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(direction, q) * inverse;
+	if (v < 0 || u + v > 1)
+		return -1;
+
+	float t = glm::dot(edge2, q) * inverse;
+	return t >= 0 && t <= maxDistance ? t : -1;
+}
+
+bool OBJMesh::intersectChunk(unsigned int chunk, const glm::vec3& origin, const glm::vec3& direction,
+							 float maxDistance, unsigned int& triangle, float& distance) const {
+	if (chunk >= m_pickChunks.size())
+		return false;
+
+	const PickChunk& pick = m_pickChunks[chunk];
+	sns::Bvh::Hit hit;
+	bool found = pick.triangles.intersectRay(origin, direction, maxDistance,
+		[&](unsigned int t, float closest) {
+			return intersectTriangle(origin, direction, pick.positions[pick.indices[t * 3]],
+									 pick.positions[pick.indices[t * 3 + 1]],
+									 pick.positions[pick.indices[t * 3 + 2]], closest);
+		}, hit);
+	if (found == false)
+		return false;
+
+	triangle = hit.primitive;
+	distance = hit.distance;
+	return true;
+}
+
+bool OBJMesh::intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+						   unsigned int& chunk, unsigned int& triangle, float& distance) const {
+
+	// the chunk bvh finds the chunks, which each test their own triangles
+	// up to the closest hit so far
+	unsigned int closestTriangle = 0;
+	sns::Bvh::Hit hit;
+	bool found = m_pickBvh.intersectRay(origin, direction, maxDistance,
+		[&](unsigned int c, float closest) {
+			unsigned int t;
+			float d;
+			if (intersectChunk(c, origin, direction, closest, t, d) == false)
+				return -1.0f;
+			closestTriangle = t;
+			return d;
+		}, hit);
+	if (found == false)
+		return false;
+
+	chunk = hit.primitive;
+	triangle = closestTriangle;
+	distance = hit.distance;
+	return true;
+}
+
+void OBJMesh::getTriangle(unsigned int chunk, unsigned int triangle, glm::vec3* corners) const {
+	const PickChunk& pick = m_pickChunks[chunk];
+	for (unsigned int i = 0; i < 3; ++i)
+		corners[i] = pick.positions[pick.indices[triangle * 3 + i]];
+}
+
+unsigned int OBJMesh::getTriangleCount(unsigned int chunk) const {
+	return chunk < m_pickChunks.size() ? (unsigned int)m_pickChunks[chunk].indices.size() / 3 : 0;
+}
+
+bool OBJMesh::getLightmapTriangle(unsigned int chunk, unsigned int triangle, glm::vec3* corners,
+								  glm::vec3* normals, glm::vec2* texcoords) const {
+	if (chunk >= m_pickChunks.size() || m_pickChunks[chunk].lightmapTexcoords.empty())
+		return false;
+
+	const PickChunk& pick = m_pickChunks[chunk];
+	for (unsigned int i = 0; i < 3; ++i) {
+		unsigned int index = pick.indices[triangle * 3 + i];
+		corners[i] = pick.positions[index];
+		normals[i] = pick.normals[index];
+		texcoords[i] = pick.lightmapTexcoords[index];
+	}
+	return true;
+}
+
+void OBJMesh::createChunk(const void* vertices, unsigned int vertexCount,
+						  const void* indices, unsigned int indexType, const ChunkData& data) {
+
+	MeshChunk chunk;
+	unsigned int indexCount = data.indexCount;
+	int materialID = data.materialID;
+	bool lightmapped = data.lightmapTexcoords.empty() == false;
+	size_t lightmapBytes = data.lightmapTexcoords.size() * sizeof(glm::vec2);
+
+	if (data.vbo != 0) {
+		// made and filled by uploadBuffers()
+		chunk.vbo.reset(data.vbo);
+		chunk.ibo.reset(data.ibo);
+		chunk.lightmapVbo.reset(data.lightmapVbo);
+	}
+	else if (sns::VertexArrays::isSupported()) {
+		// immutable buffers filled by handle, nothing is bound. the chunk has
+		// no vertex array of its own, its buffers are attached to the shared one
+		glCreateBuffers(1, chunk.vbo.put());
+		glCreateBuffers(1, chunk.ibo.put());
+		glNamedBufferStorage(chunk.ibo, indexCount * getIndexSize(indexType), indices, 0);
+		glNamedBufferStorage(chunk.vbo, vertexCount * getVertexSize(m_vertexFormat), vertices, 0);
+		if (lightmapped) {
+			glCreateBuffers(1, chunk.lightmapVbo.put());
+			glNamedBufferStorage(chunk.lightmapVbo, lightmapBytes, data.lightmapTexcoords.data(), 0);
+		}
+	}
+	else {
 		// generate buffers
-		glGenBuffers(1, &chunk.vbo);
-		glGenBuffers(1, &chunk.ibo);
-		glGenVertexArrays(1, &chunk.vao);
+		glGenBuffers(1, chunk.vbo.put());
+		glGenBuffers(1, chunk.ibo.put());
+		glGenVertexArrays(1, chunk.vao.put());
 
 		// bind vertex array aka a mesh wrapper
-		glBindVertexArray(chunk.vao);
+		sns::RenderState::instance().bindVertexArray(chunk.vao);
 
 		// set the index buffer data
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ibo);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-					 s.mesh.indices.size() * sizeof(unsigned int),
-					 s.mesh.indices.data(), GL_STATIC_DRAW);
-
-		// store index count for rendering
-		chunk.indexCount = (unsigned int)s.mesh.indices.size();
-
-		// create vertex data
-		std::vector<Vertex> vertices;
-		vertices.resize(s.mesh.positions.size() / 3);
-		size_t vertCount = vertices.size();
-
-		bool hasPosition = s.mesh.positions.empty() == false;
-		bool hasNormal = s.mesh.normals.empty() == false;
-		bool hasTexture = s.mesh.texcoords.empty() == false;
-
-		for (size_t i = 0; i < vertCount; ++i) {
-			if (hasPosition)
-				vertices[i].position = glm::vec4(s.mesh.positions[i * 3 + 0], s.mesh.positions[i * 3 + 1], s.mesh.positions[i * 3 + 2], 1);
-			if (hasNormal)
-				vertices[i].normal = glm::vec4(s.mesh.normals[i * 3 + 0], s.mesh.normals[i * 3 + 1], s.mesh.normals[i * 3 + 2], 0);
-
-			// flip the T / V (might not always be needed, depends on how mesh was made)
-			if (hasTexture)
-				vertices[i].texcoord = glm::vec2(s.mesh.texcoords[i * 2 + 0], flipTextureV ? 1.0f - s.mesh.texcoords[i * 2 + 1] : s.mesh.texcoords[i * 2 + 1]);
+					 indexCount * getIndexSize(indexType),
+					 indices, GL_STATIC_DRAW);
+
+		// bind and fill vertex buffer
+		sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * getVertexSize(m_vertexFormat), vertices, GL_STATIC_DRAW);
+
+		setVertexAttributes(0, m_vertexFormat);
+
+		// the lightmap texcoords are a buffer of their own
+		if (lightmapped) {
+			glGenBuffers(1, chunk.lightmapVbo.put());
+			sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, chunk.lightmapVbo);
+			glBufferData(GL_ARRAY_BUFFER, lightmapBytes, data.lightmapTexcoords.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(LIGHTMAP_ATTRIBUTE);
+			glVertexAttribPointer(LIGHTMAP_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), 0);
 		}
 
-		// calculate for normal mapping
-		if (hasNormal && hasTexture)
-			calculateTangents(vertices, s.mesh.indices);
+		// bind 0 for safety
+		sns::RenderState::instance().bindVertexArray(0);
+		sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	sns::GpuMemory::instance().trackBuffer(chunk.vbo, vertexCount * getVertexSize(m_vertexFormat), sns::GpuMemory::MESHES, "OBJMesh");
+	sns::GpuMemory::instance().trackBuffer(chunk.ibo, indexCount * getIndexSize(indexType), sns::GpuMemory::MESHES, "OBJMesh");
+
+	// the shared vertex arrays have nowhere for the lightmap texcoords, so
+	// a lightmapped chunk has its own with every buffer attached
+	if (lightmapped && chunk.vao == 0) {
+		glCreateVertexArrays(1, chunk.vao.put());
+		setVertexArrayFormat(chunk.vao, sns::VertexArrays::VERTEX_BINDING, m_vertexFormat);
+		glVertexArrayVertexBuffer(chunk.vao, sns::VertexArrays::VERTEX_BINDING, chunk.vbo, 0, getVertexSize(m_vertexFormat));
+		glVertexArrayElementBuffer(chunk.vao, chunk.ibo);
+		glEnableVertexArrayAttrib(chunk.vao, LIGHTMAP_ATTRIBUTE);
+		glVertexArrayAttribFormat(chunk.vao, LIGHTMAP_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(chunk.vao, LIGHTMAP_ATTRIBUTE, LIGHTMAP_BINDING);
+		glVertexArrayVertexBuffer(chunk.vao, LIGHTMAP_BINDING, chunk.lightmapVbo, 0, sizeof(glm::vec2));
+	}
+	if (lightmapped)
+		sns::GpuMemory::instance().trackBuffer(chunk.lightmapVbo, lightmapBytes, sns::GpuMemory::MESHES, "OBJMesh");
+
+	// store counts for rendering and copying. indexCount is the full detail
+	// level, the first in the buffer
+	chunk.vertexCount = vertexCount;
+	chunk.indexCount = data.lodIndexCounts[0];
+	chunk.indexType = indexType;
+	chunk.lodCount = data.lodCount;
+	chunk.firstMeshlet = (unsigned int)m_meshlets.size();
+	chunk.meshletCount = (unsigned int)data.meshlets.size();
+	m_meshlets.insert(m_meshlets.end(), data.meshlets.begin(), data.meshlets.end());
+
+	// a merged chunk's ranges, within its full detail level
+	chunk.firstRange = (unsigned int)m_rangeIndexCounts.size();
+	chunk.rangeCount = (unsigned int)data.rangeIndexCounts.size();
+	unsigned int rangeFirst = 0;
+	for (unsigned int r = 0; r < chunk.rangeCount; ++r) {
+		m_rangeBounds.add(data.rangeBoundsMin[r], data.rangeBoundsMax[r]);
+		m_rangeFirstIndices.push_back(rangeFirst);
+		m_rangeIndexCounts.push_back(data.rangeIndexCounts[r]);
+		rangeFirst += data.rangeIndexCounts[r];
+	}
 
-		// bind vertex buffer
-		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+	unsigned int firstIndex = 0;
+	for (unsigned int l = 0; l < data.lodCount; ++l) {
+		chunk.lodFirstIndex[l] = firstIndex;
+		chunk.lodIndexCount[l] = data.lodIndexCounts[l];
+		firstIndex += data.lodIndexCounts[l];
+	}
 
-		// fill vertex buffer
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	// set chunk material
+	chunk.materialID = materialID;
 
-		// enable first element as positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+	m_meshChunks.push_back(std::move(chunk));
+}
 
-		// enable normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 1));
+unsigned int OBJMesh::getVertexSize(VertexFormat format) {
+	return getVertexLayout(format).stride;
+}
 
-		// enable texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2));
+const sns::VertexLayout& OBJMesh::getVertexLayout(VertexFormat format) {
+	return format == PACKED_VERTEX ? PACKED_VERTEX_LAYOUT : FULL_VERTEX_LAYOUT;
+}
 
-		// enable tangents
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2 + sizeof(glm::vec2)));
+OBJMesh::PackedVertex OBJMesh::pack(const Vertex& vertex) {
 
-		// bind 0 for safety
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// the two bit w holds the tangent's sign exactly, the normal's w is 0
+	PackedVertex packed;
+	sns::convertVertices(FULL_VERTEX_LAYOUT, &vertex, PACKED_VERTEX_LAYOUT, &packed, 1);
+	return packed;
+}
 
-		// set chunk material
-		chunk.materialID = s.mesh.material_ids.empty() ? -1 : s.mesh.material_ids[0];
+unsigned int OBJMesh::getIndexSize(unsigned int indexType) {
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+size_t OBJMesh::getGPUBytes() const {
 
-		m_meshChunks.push_back(chunk);
+	size_t bytes = 0;
+	for (const MeshChunk& c : m_meshChunks) {
+		unsigned int indexCount = 0;
+		for (unsigned int l = 0; l < c.lodCount; ++l)
+			indexCount += c.lodIndexCount[l];
+		bytes += (size_t)c.vertexCount * getVertexSize(m_vertexFormat) + (size_t)indexCount * getIndexSize(c.indexType);
+		if (c.lightmapVbo != 0)
+			bytes += (size_t)c.vertexCount * sizeof(glm::vec2);
 	}
-	
-	// load obj
-	return true;
+	return bytes;
 }
 
-void OBJMesh::draw(bool usePatches /* = false */) {
+void OBJMesh::setVertexAttributes(size_t offset /* = 0 */, VertexFormat format /* = FULL_VERTEX */) {
+	sns::setVertexAttributes(getVertexLayout(format), offset);
+}
+
+void OBJMesh::setVertexArrayFormat(unsigned int vao, unsigned int binding, VertexFormat format /* = FULL_VERTEX */) {
+	sns::setVertexArrayFormat(vao, binding, getVertexLayout(format));
+}
+
+// the formats of the vertex arrays chunks share, with and without the
+// instance transforms drawInstanced streams
+static void setInstanceFormat(unsigned int vao) {
+	// a mat4 attribute is four vec4 columns, each stepping once per instance
+	sns::setVertexArrayFormat(vao, sns::VertexArrays::INSTANCE_BINDING, INSTANCE_LAYOUT);
+	glVertexArrayBindingDivisor(vao, sns::VertexArrays::INSTANCE_BINDING, 1);
+}
+
+static void fullVertexFormat(unsigned int vao) {
+	OBJMesh::setVertexArrayFormat(vao, sns::VertexArrays::VERTEX_BINDING, OBJMesh::FULL_VERTEX);
+}
+
+static void packedVertexFormat(unsigned int vao) {
+	OBJMesh::setVertexArrayFormat(vao, sns::VertexArrays::VERTEX_BINDING, OBJMesh::PACKED_VERTEX);
+}
 
-	int program = -1;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+static void instancedFullVertexFormat(unsigned int vao) {
+	fullVertexFormat(vao);
+	setInstanceFormat(vao);
+}
+
+static void instancedPackedVertexFormat(unsigned int vao) {
+	packedVertexFormat(vao);
+	setInstanceFormat(vao);
+}
 
-	if (program == -1) {
-		printf("No shader bound!\n");
+void OBJMesh::bindChunk(const MeshChunk& c, bool instanced) const {
+
+	if (c.vao != 0) {
+		sns::RenderState::instance().bindVertexArray(c.vao);
 		return;
 	}
 
-	// pull uniforms from the shader
-	int kaUniform = glGetUniformLocation(program, "Ka");
-	int kdUniform = glGetUniformLocation(program, "Kd");
-	int ksUniform = glGetUniformLocation(program, "Ks");
-	int keUniform = glGetUniformLocation(program, "Ke");
-	int opacityUniform = glGetUniformLocation(program, "opacity");
-	int specPowUniform = glGetUniformLocation(program, "specularPower");
-
-	int alphaTexUniform = glGetUniformLocation(program, "alphaTexture");
-	int ambientTexUniform = glGetUniformLocation(program, "ambientTexture");
-	int diffuseTexUniform = glGetUniformLocation(program, "diffuseTexture");
-	int specTexUniform = glGetUniformLocation(program, "specularTexture");
-	int specHighlightTexUniform = glGetUniformLocation(program, "specularHighlightTexture");
-	int normalTexUniform = glGetUniformLocation(program, "normalTexture");
-	int dispTexUniform = glGetUniformLocation(program, "displacementTexture");
-
-	// set texture slots (these don't change per material)
-	if (diffuseTexUniform >= 0)
-		glUniform1i(diffuseTexUniform, 0);
-	if (alphaTexUniform >= 0)
-		glUniform1i(alphaTexUniform, 1);
-	if (ambientTexUniform >= 0)
-		glUniform1i(ambientTexUniform, 2);
-	if (specTexUniform >= 0)
-		glUniform1i(specTexUniform, 3);
-	if (specHighlightTexUniform >= 0)
-		glUniform1i(specHighlightTexUniform, 4);
-	if (normalTexUniform >= 0)
-		glUniform1i(normalTexUniform, 5);
-	if (dispTexUniform >= 0)
-		glUniform1i(dispTexUniform, 6);
+	bool packed = m_vertexFormat == PACKED_VERTEX;
+	if (instanced)
+		sns::VertexArrays::instance().bind(packed ? instancedPackedVertexFormat : instancedFullVertexFormat,
+										   c.vbo, getVertexSize(m_vertexFormat), c.ibo,
+										   m_instances->getHandle(), sizeof(glm::mat4));
+	else
+		sns::VertexArrays::instance().bind(packed ? packedVertexFormat : fullVertexFormat,
+										   c.vbo, getVertexSize(m_vertexFormat), c.ibo);
+}
 
-	int currentMaterial = -1;
+// a material as materialData.glsl's std140 block lays it out
+struct MaterialBlock {
+	glm::vec3 ambient;
+	float opacity;
+	glm::vec3 diffuse;
+	float specularPower;
+	glm::vec3 specular;
+	float pad0;
+	glm::vec3 emissive;
+	float pad1;
+};
+
+SNS_STD140_MEMBER(MaterialBlock, ambient, 0);
+SNS_STD140_MEMBER(MaterialBlock, opacity, 12);
+SNS_STD140_MEMBER(MaterialBlock, diffuse, 16);
+SNS_STD140_MEMBER(MaterialBlock, specularPower, 28);
+SNS_STD140_MEMBER(MaterialBlock, specular, 32);
+SNS_STD140_MEMBER(MaterialBlock, emissive, 48);
+SNS_BLOCK_SIZE(MaterialBlock, 64);
+
+static const char* const MATERIAL_BLOCK_NAME = "MaterialData";
+
+// the block last copied into the ring and the ring frame it was, so a
+// material drawn again in the same frame keeps its range
+static MaterialBlock s_materialBlock;
+static unsigned int s_materialBlockFrame = ~0u;
+
+// uniform locations a program uses for materials, looked up on first use
+struct MaterialLayout {
+	// whether the program reads its material from the block, rather than
+	// the loose uniforms below
+	bool block;
+	int ka, kd, ks, ke, opacity, specularPower;
+	int textures[8];
+
+	// where each texture is in its atlas page, see atlas.glsl
+	int textureRects;
+
+	// the values last sent to this program, so unchanged ones are skipped
+	bool hasValues;
+	float values[14];
+	bool hasRects;
+	float rects[8][4];
+};
+
+// texture sampler names, in the order of their bound slots
+static const char* const TEXTURE_UNIFORMS[8] = {
+	"diffuseTexture", "alphaTexture", "ambientTexture", "specularTexture",
+	"specularHighlightTexture", "normalTexture", "displacementTexture", "packedTexture"
+};
+
+static std::unordered_map<unsigned int, MaterialLayout> s_materialLayouts;
+static unsigned int s_materialLayoutDeletions = 0;
+
+static MaterialLayout& getMaterialLayout(unsigned int program) {
+
+	// program handles can be reused once deleted, start over if any were
+	unsigned int deletions = sns::RenderState::instance().getProgramDeletions();
+	if (deletions != s_materialLayoutDeletions) {
+		s_materialLayouts.clear();
+		s_materialLayoutDeletions = deletions;
+	}
+
+	auto it = s_materialLayouts.find(program);
+	if (it != s_materialLayouts.end())
+		return it->second;
+
+	MaterialLayout& layout = s_materialLayouts[program];
+	layout.block = glGetUniformBlockIndex(program, MATERIAL_BLOCK_NAME) != GL_INVALID_INDEX;
+	layout.ka = glGetUniformLocation(program, "Ka");
+	layout.kd = glGetUniformLocation(program, "Kd");
+	layout.ks = glGetUniformLocation(program, "Ks");
+	layout.ke = glGetUniformLocation(program, "Ke");
+	layout.opacity = glGetUniformLocation(program, "opacity");
+	layout.specularPower = glGetUniformLocation(program, "specularPower");
+	layout.textureRects = glGetUniformLocation(program, "textureRects");
+	layout.hasValues = false;
+	layout.hasRects = false;
+
+	// texture slots never change, and uniforms keep their values, so
+	// the samplers only need setting once per program
+	for (int i = 0; i < 8; ++i) {
+		layout.textures[i] = glGetUniformLocation(program, TEXTURE_UNIFORMS[i]);
+		if (layout.textures[i] >= 0)
+			glProgramUniform1i(program, layout.textures[i], i);
+	}
+	return layout;
+}
+
+void OBJMesh::draw(bool usePatches /* = false */) {
+	drawChunks(nullptr, usePatches);
+}
+
+void OBJMesh::draw(const sns::Frustum& frustum, bool usePatches /* = false */) {
+	frustum.cull(m_chunkBounds, m_chunkVisibility);
+	if (m_rangeBounds.size() == 0) {
+		drawChunks(m_chunkVisibility.data(), usePatches);
+		return;
+	}
+
+	// the ranges of every merged chunk are culled together, it is
+	// cheaper than picking out those of the visible chunks
+	frustum.cull(m_rangeBounds, m_rangeVisibility);
+	drawChunks(m_chunkVisibility.data(), usePatches, m_rangeVisibility.data());
+}
+
+void OBJMesh::drawChunks(const unsigned char* visible, bool usePatches, const unsigned char* visibleRanges) {
+	SNS_TRACE_GL_ZONE("OBJMesh::draw");
 
-	// draw the mesh chunks
-	for (auto& c : m_meshChunks) {
+	if (sns::RenderState::instance().getProgram() == 0) {
+		SNS_LOG_WARNING("No shader bound!");
+		return;
+	}
 
-		// bind material
+	// draw the mesh chunks, the material is only bound when it changes
+	int currentMaterial = -1;
+	for (unsigned int i = 0; i < (unsigned int)m_meshChunks.size(); ++i) {
+		if (visible != nullptr && visible[i] == 0)
+			continue;
+
+		const MeshChunk& c = m_meshChunks[i];
 		if (currentMaterial != c.materialID) {
 			currentMaterial = c.materialID;
-			if (kaUniform >= 0)
-				glUniform3fv(kaUniform, 1, &m_materials[currentMaterial].ambient[0]);
-			if (kdUniform >= 0)
-				glUniform3fv(kdUniform, 1, &m_materials[currentMaterial].diffuse[0]);
-			if (ksUniform >= 0)
-				glUniform3fv(ksUniform, 1, &m_materials[currentMaterial].specular[0]);
-			if (keUniform >= 0)
-				glUniform3fv(keUniform, 1, &m_materials[currentMaterial].emissive[0]);
-			if (opacityUniform >= 0)
-				glUniform1f(opacityUniform, m_materials[currentMaterial].opacity);
-			if (specPowUniform >= 0)
-				glUniform1f(specPowUniform, m_materials[currentMaterial].specularPower);
-
-			glActiveTexture(GL_TEXTURE0);
-			if (m_materials[currentMaterial].diffuseTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].diffuseTexture.getHandle());
-			else if (diffuseTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE1);
-			if (m_materials[currentMaterial].alphaTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].alphaTexture.getHandle());
-			else if (alphaTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE2);
-			if (m_materials[currentMaterial].ambientTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].ambientTexture.getHandle());
-			else if (ambientTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE3);
-			if (m_materials[currentMaterial].specularTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularTexture.getHandle());
-			else if (specTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE4);
-			if (m_materials[currentMaterial].specularHighlightTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularHighlightTexture.getHandle());
-			else if (specHighlightTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE5);
-			if (m_materials[currentMaterial].normalTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].normalTexture.getHandle());
-			else if (normalTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE6);
-			if (m_materials[currentMaterial].displacementTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].displacementTexture.getHandle());
-			else if (dispTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
+			bindMaterial(currentMaterial);
 		}
 
 		// bind and draw geometry
-		glBindVertexArray(c.vao);
-		if (usePatches)
-			glDrawElements(GL_PATCHES, c.indexCount, GL_UNSIGNED_INT, 0);
-		else
-			glDrawElements(GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
+		unsigned int lod = getChunkLOD(i);
+		GLenum mode = usePatches ? GL_PATCHES : GL_TRIANGLES;
+		if (visibleRanges != nullptr && lod == 0 && c.rangeCount > 0) {
+			drawRanges(c, mode, visibleRanges + c.firstRange);
+			continue;
+		}
+		bindChunk(c, false);
+		sns::RenderState::instance().countDraw();
+		glDrawElements(mode, c.lodIndexCount[lod], c.indexType,
+					   (void*)((size_t)c.lodFirstIndex[lod] * getIndexSize(c.indexType)));
 	}
 }
 
-void OBJMesh::calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
-	unsigned int vertexCount = (unsigned int)vertices.size();
-	glm::vec4* tan1 = new glm::vec4[vertexCount * 2];
-	glm::vec4* tan2 = tan1 + vertexCount;
-	memset(tan1, 0, vertexCount * sizeof(glm::vec4) * 2);
+void OBJMesh::drawRanges(const MeshChunk& c, unsigned int mode, const unsigned char* visible) {
 
-	unsigned int indexCount = (unsigned int)indices.size();
-	for (unsigned int a = 0; a < indexCount; a += 3) {
-		long i1 = indices[a];
-		long i2 = indices[a + 1];
-		long i3 = indices[a + 2];
+	// neighbouring visible ranges are one run of indices
+	m_drawCounts.clear();
+	m_drawOffsets.clear();
+	unsigned int indexSize = getIndexSize(c.indexType);
+	for (unsigned int r = 0; r < c.rangeCount;) {
+		if (visible[r] == 0) {
+			++r;
+			continue;
+		}
+		unsigned int first = m_rangeFirstIndices[c.firstRange + r];
+		unsigned int count = 0;
+		for (; r < c.rangeCount && visible[r] != 0; ++r)
+			count += m_rangeIndexCounts[c.firstRange + r];
+		m_drawCounts.push_back((int)count);
+		m_drawOffsets.push_back((const void*)((size_t)first * indexSize));
+	}
+	if (m_drawCounts.empty())
+		return;
 
-		const glm::vec4& v1 = vertices[i1].position;
-		const glm::vec4& v2 = vertices[i2].position;
-		const glm::vec4& v3 = vertices[i3].position;
+	bindChunk(c, false);
+	sns::RenderState::instance().countDraw();
+	if (m_drawCounts.size() == 1)
+		glDrawElements(mode, m_drawCounts[0], c.indexType, m_drawOffsets[0]);
+	else
+		glMultiDrawElements(mode, m_drawCounts.data(), c.indexType, m_drawOffsets.data(), (GLsizei)m_drawCounts.size());
+}
 
-		const glm::vec2& w1 = vertices[i1].texcoord;
-		const glm::vec2& w2 = vertices[i2].texcoord;
-		const glm::vec2& w3 = vertices[i3].texcoord;
+void OBJMesh::drawInstanced(const glm::mat4* transforms, unsigned int count, bool usePatches /* = false */) {
+	SNS_TRACE_GL_ZONE("OBJMesh::drawInstanced");
 
-		float x1 = v2.x - v1.x;
-		float x2 = v3.x - v1.x;
-		float y1 = v2.y - v1.y;
-		float y2 = v3.y - v1.y;
-		float z1 = v2.z - v1.z;
-		float z2 = v3.z - v1.z;
+	if (count == 0 || m_meshChunks.empty())
+		return;
 
-		float s1 = w2.x - w1.x;
-		float s2 = w3.x - w1.x;
-		float t1 = w2.y - w1.y;
-		float t2 = w3.y - w1.y;
+	if (sns::RenderState::instance().getProgram() == 0) {
+		SNS_LOG_WARNING("No shader bound!");
+		return;
+	}
 
-		float r = 1.0F / (s1 * t2 - s2 * t1);
-		glm::vec4 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
-					   (t2 * z1 - t1 * z2) * r, 0);
-		glm::vec4 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
-					   (s1 * z2 - s2 * z1) * r, 0);
+	// grow to twice what is needed, so slowly growing counts don't recreate it every frame
+	if (m_instances == nullptr || m_instances->getElementCount() < count)
+		createInstanceBuffer(count * 2);
 
-		tan1[i1] += sdir;
-		tan1[i2] += sdir;
-		tan1[i3] += sdir;
+	glm::mat4* region = (glm::mat4*)m_instances->beginWrite();
+	memcpy(region, transforms, count * sizeof(glm::mat4));
+	unsigned int firstInstance = m_instances->endWrite(count);
 
-		tan2[i1] += tdir;
-		tan2[i2] += tdir;
-		tan2[i3] += tdir;
+	// every copy of a chunk is one draw, the material is only bound when it changes
+	GLenum mode = usePatches ? GL_PATCHES : GL_TRIANGLES;
+	int currentMaterial = -1;
+	for (unsigned int i = 0; i < (unsigned int)m_meshChunks.size(); ++i) {
+		const MeshChunk& c = m_meshChunks[i];
+		if (currentMaterial != c.materialID) {
+			currentMaterial = c.materialID;
+			bindMaterial(currentMaterial);
+		}
+
+		unsigned int lod = getChunkLOD(i);
+		bindChunk(c, true);
+		sns::RenderState::instance().countDraw();
+		glDrawElementsInstancedBaseInstance(mode, c.lodIndexCount[lod], c.indexType,
+											(void*)((size_t)c.lodFirstIndex[lod] * getIndexSize(c.indexType)),
+											count, firstInstance);
 	}
 
-	for (unsigned int a = 0; a < vertexCount; a++) {
-		const glm::vec3& n = glm::vec3(vertices[a].normal);
-		const glm::vec3& t = glm::vec3(tan1[a]);
+	m_instances->fence();
+}
 
-		// Gram-Schmidt orthogonalize
-		vertices[a].tangent = glm::vec4(glm::normalize(t - n * glm::dot(n, t)), 0);
+void OBJMesh::createInstanceBuffer(unsigned int count) {
 
-		// Calculate handedness (direction of bitangent)
-		vertices[a].tangent.w = (glm::dot(glm::cross(glm::vec3(n), glm::vec3(t)), glm::vec3(tan2[a])) < 0.0F) ? 1.0F : -1.0F;
+	if (m_instances == nullptr)
+		m_instances.reset(new sns::StreamingBuffer());
+	m_instances->create(sizeof(glm::mat4), count);
 
-		// calculate bitangent (ignoring for our Vertex, here just for reference)
-		//vertices[a].bitangent = glm::vec4(glm::cross(glm::vec3(vertices[a].normal), glm::vec3(vertices[a].tangent)) * vertices[a].tangent.w, 0);
-		//vertices[a].tangent.w = 0;
+	// a mat4 attribute is four vec4 columns, each stepping once per instance.
+	// chunks drawn through a shared vertex array have the buffer attached there
+	for (const MeshChunk& c : m_meshChunks) {
+		if (c.vao == 0)
+			continue;
+		sns::RenderState::instance().bindVertexArray(c.vao);
+		sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_instances->getHandle());
+		sns::setVertexAttributes(INSTANCE_LAYOUT, 0, 1);
 	}
 
-	delete[] tan1;
+	sns::RenderState::instance().bindVertexArray(0);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OBJMesh::drawChunk(unsigned int chunk, bool usePatches /* = false */, unsigned int lod /* = 0 */) const {
+
+	const MeshChunk& c = m_meshChunks[chunk];
+	bindMaterial(c.materialID);
+
+	if (lod >= c.lodCount)
+		lod = c.lodCount - 1;
+
+	bindChunk(c, false);
+	sns::RenderState::instance().countDraw();
+	glDrawElements(usePatches ? GL_PATCHES : GL_TRIANGLES, c.lodIndexCount[lod], c.indexType,
+				   (void*)((size_t)c.lodFirstIndex[lod] * getIndexSize(c.indexType)));
+}
+
+void OBJMesh::selectLODs(const glm::mat4& projection, const glm::mat4& modelView, float viewportHeight) {
+
+	m_chunkLODs.resize(m_meshChunks.size(), 0);
+
+	// the bounds grow by the largest scale of the model view
+	float scale = glm::max(glm::length(glm::vec3(modelView[0])),
+						   glm::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+	float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+	float lodPixels = LOD_PIXELS * s_lodScale;
+
+	for (unsigned int i = 0; i < (unsigned int)m_meshChunks.size(); ++i) {
+		glm::vec3 centre(m_chunkBounds.centreX[i], m_chunkBounds.centreY[i], m_chunkBounds.centreZ[i]);
+		glm::vec3 extent(m_chunkBounds.extentX[i], m_chunkBounds.extentY[i], m_chunkBounds.extentZ[i]);
+		float radius = glm::length(extent) * scale;
+		float distance = glm::length(glm::vec3(modelView * glm::vec4(centre, 1)));
+
+		// a camera inside the bounds always gets full detail
+		float pixels = distance > radius ? 2 * radius / distance * pixelsPerUnit : FLT_MAX;
+
+		// level l is used below LOD_PIXELS / 2^(l - 1), past the hysteresis band
+		unsigned int lodCount = m_meshChunks[i].lodCount;
+		unsigned int lod = glm::min((unsigned int)m_chunkLODs[i], lodCount - 1);
+		while (lod + 1 < lodCount && pixels < lodPixels / (float)(1 << lod) * (1 - LOD_HYSTERESIS))
+			++lod;
+		while (lod > 0 && pixels > lodPixels / (float)(1 << (lod - 1)) * (1 + LOD_HYSTERESIS))
+			--lod;
+		m_chunkLODs[i] = (unsigned char)lod;
+	}
+}
+
+void OBJMesh::requestTextures(sns::TextureStreamer& streamer, const glm::mat4& projection,
+							  const glm::mat4& modelView, float viewportHeight) const {
+
+	// as in selectLODs(), the model view's largest scale
+	float scale = glm::max(glm::length(glm::vec3(modelView[0])),
+						   glm::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+	float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+
+	for (unsigned int i = 0; i < (unsigned int)m_meshChunks.size(); ++i) {
+		const MeshChunk& c = m_meshChunks[i];
+		if (c.materialID < 0 || m_chunkUVDensities[i] <= 0)
+			continue;
+
+		glm::vec3 centre(m_chunkBounds.centreX[i], m_chunkBounds.centreY[i], m_chunkBounds.centreZ[i]);
+		glm::vec3 extent(m_chunkBounds.extentX[i], m_chunkBounds.extentY[i], m_chunkBounds.extentZ[i]);
+		float radius = glm::length(extent) * scale;
+		float distance = glm::length(glm::vec3(modelView * glm::vec4(centre, 1))) - radius;
+
+		// texcoord units a pixel covers, a camera inside the bounds wants level 0
+		float uvPerPixel = distance > 0 ? m_chunkUVDensities[i] / scale * distance / pixelsPerUnit : 0;
+
+		const Material& material = m_materials[c.materialID];
+		const std::shared_ptr<Texture>* textures[8] = {
+			&material.diffuseTexture, &material.alphaTexture, &material.ambientTexture,
+			&material.specularTexture, &material.specularHighlightTexture,
+			&material.normalTexture, &material.displacementTexture, &material.packedTexture
+		};
+		for (auto texture : textures) {
+			if (*texture == nullptr)
+				continue;
+
+			// a level halves the texels a pixel covers
+			float texels = uvPerPixel * (float)glm::max((*texture)->getWidth(), (*texture)->getHeight());
+			streamer.request(*texture, texels > 1 ? glm::log2(texels) : 0);
+		}
+	}
+}
+
+void OBJMesh::loadSeenTextures(sns::AssetLoader& loader) {
+	if (m_lazyTextures == false)
+		return;
+
+	// 1 for seen, 2 once its textures were sent to the loader
+	for (size_t i = 0; i < m_materials.size() && i < m_materialsSeen.size(); ++i) {
+		if (m_materialsSeen[i] != 1)
+			continue;
+
+		const Material& material = m_materials[i];
+		const std::shared_ptr<Texture>* textures[8] = {
+			&material.diffuseTexture, &material.alphaTexture, &material.ambientTexture,
+			&material.specularTexture, &material.specularHighlightTexture,
+			&material.normalTexture, &material.displacementTexture, &material.packedTexture
+		};
+		for (auto texture : textures)
+			if (*texture != nullptr && (*texture)->isPlaceholder())
+				loader.loadPlaceholder(*texture);
+		m_materialsSeen[i] = 2;
+	}
+}
+
+void OBJMesh::submit(sns::RenderQueue& queue, ShaderProgram* shader, unsigned int object,
+					 const sns::Frustum* frustums /* = nullptr */, bool usePatches /* = false */,
+					 unsigned int frustumCount /* = 1 */,
+					 const sns::SoftwareOcclusion* occlusion /* = nullptr */,
+					 const glm::mat4& model /* = glm::mat4(1) */) const {
+	ShaderProgram* shaders[MATERIAL_VARIANT_Count];
+	for (auto& variant : shaders)
+		variant = shader;
+	submit(queue, shaders, object, frustums, usePatches, frustumCount, occlusion, model);
+}
+
+unsigned int OBJMesh::getMaterialVariant(int materialID) const {
+	if (materialID < 0 || materialID >= (int)m_materials.size())
+		return 0;
+
+	const Material& material = m_materials[materialID];
+	unsigned int variant = 0;
+	if (material.alphaTexture != nullptr || (material.packedMaps & Material::PACKED_ALPHA) != 0)
+		variant |= MATERIAL_ALPHA_TESTED;
+	if (material.normalTexture != nullptr)
+		variant |= MATERIAL_NORMAL_MAPPED;
+	if (material.packedTexture != nullptr)
+		variant |= MATERIAL_PACKED_MAPS;
+	return variant;
+}
+
+void OBJMesh::submit(sns::RenderQueue& queue, ShaderProgram* const* shaders, unsigned int object,
+					 const sns::Frustum* frustums /* = nullptr */, bool usePatches /* = false */,
+					 unsigned int frustumCount /* = 1 */,
+					 const sns::SoftwareOcclusion* occlusion /* = nullptr */,
+					 const glm::mat4& model /* = glm::mat4(1) */) const {
+
+	// a bit per view each chunk is inside, every view without frustums
+	m_chunkViewMasks.assign(m_meshChunks.size(), frustums != nullptr ? 0u : ~0u);
+	for (unsigned int view = 0; frustums != nullptr && view < frustumCount; ++view) {
+		frustums[view].cull(m_chunkBounds, m_chunkVisibility);
+		for (size_t i = 0; i < m_meshChunks.size(); ++i)
+			if (m_chunkVisibility[i] != 0)
+				m_chunkViewMasks[i] |= 1u << view;
+	}
+
+	// the occluders are rendered for the first view only, the others keep
+	// whatever their frustums let through
+	if (occlusion != nullptr && m_chunkBounds.size() == m_meshChunks.size()) {
+		glm::mat4 toClip = occlusion->getProjectionView() * model;
+		for (size_t i = 0; i < m_meshChunks.size(); ++i) {
+			if ((m_chunkViewMasks[i] & 1u) == 0)
+				continue;
+			glm::vec3 centre(m_chunkBounds.centreX[i], m_chunkBounds.centreY[i], m_chunkBounds.centreZ[i]);
+			glm::vec3 extent(m_chunkBounds.extentX[i], m_chunkBounds.extentY[i], m_chunkBounds.extentZ[i]);
+			if (occlusion->isBoxVisible(toClip, centre, extent) == false)
+				m_chunkViewMasks[i] &= ~1u;
+		}
+	}
+
+	for (unsigned int i = 0; i < (unsigned int)m_meshChunks.size(); ++i) {
+		if (m_chunkViewMasks[i] == 0)
+			continue;
+
+		const MeshChunk& c = m_meshChunks[i];
+		ShaderProgram* shader = shaders[getMaterialVariant(c.materialID)];
+		if (shader == nullptr)
+			continue;
+		if (m_lazyTextures && c.materialID >= 0 && m_materialsSeen[c.materialID] == 0)
+			m_materialsSeen[c.materialID] = 1;
+		unsigned int texture = c.materialID >= 0 ? textureHandle(m_materials[c.materialID].diffuseTexture) : 0;
+
+		sns::RenderQueue::Item item;
+		item.key = sns::RenderQueue::makeKey(shader->getHandle(), texture, c.vao);
+		item.shader = shader;
+		item.mesh = this;
+		item.chunk = i;
+		item.object = object;
+		item.usePatches = usePatches;
+		item.lod = getChunkLOD(i);
+		item.viewMask = m_chunkViewMasks[i];
+		item.occlusion = sns::OcclusionQueries::NO_QUERY;
+		queue.submit(item);
+	}
+}
+
+void OBJMesh::bindMaterial(int materialID) const {
+
+	// chunks without a material keep whatever was bound before
+	if (materialID >= 0 && materialID < (int)m_materials.size())
+		bindMaterial(m_materials[materialID]);
+}
+
+void OBJMesh::registerMaterialBlock() {
+	ShaderProgram::setUniformBlockBinding(MATERIAL_BLOCK_NAME, MATERIAL_BLOCK_BINDING);
+}
+
+void OBJMesh::bindMaterial(const Material& material) {
+	sns::RenderState& state = sns::RenderState::instance();
+	MaterialLayout& layout = getMaterialLayout(state.getProgram());
+	sns::UniformRing& ring = sns::UniformRing::instance();
+
+	if (layout.block && ring.isCreated()) {
+
+		// the binding is shared by every program, so the last block bound
+		// this frame serves any of them with the same values
+		MaterialBlock block = {};
+		block.ambient = material.ambient;
+		block.opacity = material.opacity;
+		block.diffuse = material.diffuse;
+		block.specularPower = material.specularPower;
+		block.specular = material.specular;
+		block.emissive = material.emissive;
+		if (s_materialBlockFrame != ring.getFrame() || memcmp(&block, &s_materialBlock, sizeof(block)) != 0) {
+			ring.bind(MATERIAL_BLOCK_BINDING, block);
+			s_materialBlock = block;
+			s_materialBlockFrame = ring.getFrame();
+		}
+	}
+
+	// skip the uniforms if this program already has these values
+	float values[14];
+	memcpy(values, &material.ambient[0], sizeof(float) * 3);
+	memcpy(values + 3, &material.diffuse[0], sizeof(float) * 3);
+	memcpy(values + 6, &material.specular[0], sizeof(float) * 3);
+	memcpy(values + 9, &material.emissive[0], sizeof(float) * 3);
+	values[12] = material.opacity;
+	values[13] = material.specularPower;
+
+	if (layout.block == false && (layout.hasValues == false || memcmp(values, layout.values, sizeof(values)) != 0)) {
+		memcpy(layout.values, values, sizeof(values));
+		layout.hasValues = true;
+
+		if (layout.ka >= 0)
+			glUniform3fv(layout.ka, 1, values);
+		if (layout.kd >= 0)
+			glUniform3fv(layout.kd, 1, values + 3);
+		if (layout.ks >= 0)
+			glUniform3fv(layout.ks, 1, values + 6);
+		if (layout.ke >= 0)
+			glUniform3fv(layout.ke, 1, values + 9);
+		if (layout.opacity >= 0)
+			glUniform1f(layout.opacity, values[12]);
+		if (layout.specularPower >= 0)
+			glUniform1f(layout.specularPower, values[13]);
+	}
+
+	// the render state skips units that already have the texture.
+	// missing textures bind 0 only for samplers the program uses. every
+	// unit samples through the material sampler, so its filtering
+	// changes with the quality rather than with each texture
+	unsigned int sampler = sns::SamplerCache::instance().getMaterialSampler();
+	const std::shared_ptr<Texture>* textures[8] = {
+		&material.diffuseTexture, &material.alphaTexture, &material.ambientTexture,
+		&material.specularTexture, &material.specularHighlightTexture,
+		&material.normalTexture, &material.displacementTexture, &material.packedTexture
+	};
+	for (unsigned int i = 0; i < 8; ++i) {
+		unsigned int handle = textureHandle(*textures[i]);
+		if (handle > 0 || layout.textures[i] >= 0)
+			state.bindTexture(i, handle, sampler);
+	}
+
+	// textures in an atlas page are found there by their rects, those
+	// that aren't are the whole of their texture
+	if (layout.textureRects >= 0) {
+		static const float WHOLE[4] = { 0, 0, 1, 1 };
+		float rects[8][4];
+		for (unsigned int i = 0; i < 8; ++i) {
+			const Texture* texture = textures[i]->get();
+			memcpy(rects[i], texture != nullptr ? texture->getAtlasRect() : WHOLE, sizeof(rects[i]));
+		}
+		if (layout.hasRects == false || memcmp(rects, layout.rects, sizeof(rects)) != 0) {
+			memcpy(layout.rects, rects, sizeof(rects));
+			layout.hasRects = true;
+			glUniform4fv(layout.textureRects, 8, &rects[0][0]);
+		}
+	}
+}
+
+void OBJMesh::calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, TangentMode mode) {
+	unsigned int vertexCount = (unsigned int)vertices.size();
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	TangentScratch& scratch = t_tangentScratch;
+
+	// each triangle's tangent and bitangent directions from its texcoords
+	scratch.directions.resize(triangleCount * 2);
+	glm::vec4* directions = scratch.directions.data();
+	parallelRanges(triangleCount, TANGENT_JOB_SIZE, [&](unsigned int first, unsigned int last) {
+		for (unsigned int f = first; f < last; ++f) {
+			const Vertex& a = vertices[indices[f * 3 + 0]];
+			const Vertex& b = vertices[indices[f * 3 + 1]];
+			const Vertex& c = vertices[indices[f * 3 + 2]];
+
+			glm::vec4 e1 = b.position - a.position;
+			glm::vec4 e2 = c.position - a.position;
+			glm::vec2 w1 = b.texcoord - a.texcoord;
+			glm::vec2 w2 = c.texcoord - a.texcoord;
+
+			float r = 1.0F / (w1.x * w2.y - w2.x * w1.y);
+			glm::vec4 sdir = (e1 * w2.y - e2 * w1.y) * r;
+			glm::vec4 tdir = (e2 * w1.x - e1 * w2.x) * r;
+			directions[f * 2 + 0] = glm::vec4(glm::vec3(sdir), 0);
+			directions[f * 2 + 1] = glm::vec4(glm::vec3(tdir), 0);
+		}
+	});
+
+	// the corners around each vertex, in triangle order so the sums below
+	// add up in the same order as one pass over the triangles would
+	scratch.firstCorner.assign(vertexCount + 1, 0);
+	scratch.corners.resize(indices.size());
+	unsigned int* firstCorner = scratch.firstCorner.data();
+	unsigned int* corners = scratch.corners.data();
+	for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		++firstCorner[indices[i] + 1];
+	for (unsigned int v = 0; v < vertexCount; ++v)
+		firstCorner[v + 1] += firstCorner[v];
+	for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		corners[firstCorner[indices[i]]++] = i;
+	for (unsigned int v = vertexCount; v > 0; --v)
+		firstCorner[v] = firstCorner[v - 1];
+	firstCorner[0] = 0;
+
+	// gather every vertex's triangles and orthogonalise against its normal
+	parallelRanges(vertexCount, TANGENT_JOB_SIZE, [&](unsigned int first, unsigned int last) {
+		for (unsigned int v = first; v < last; ++v) {
+			glm::vec4 n = vertices[v].normal;
+			glm::vec4 tan1(0), tan2(0);
+
+			for (unsigned int i = firstCorner[v]; i < firstCorner[v + 1]; ++i) {
+				unsigned int corner = corners[i];
+				unsigned int f = corner / 3;
+				glm::vec4 sdir = directions[f * 2 + 0];
+				glm::vec4 tdir = directions[f * 2 + 1];
+
+				if (mode == MIKKTSPACE_TANGENTS) {
+					// skip triangles with degenerate texcoords, project onto
+					// this vertex's tangent plane and weight by the angle
+					// of the corner, as mikktspace does
+					if (std::isfinite(glm::dot(sdir, sdir) + glm::dot(tdir, tdir)) == false)
+						continue;
+
+					unsigned int base = f * 3;
+					unsigned int k = corner - base;
+					glm::vec3 p = glm::vec3(vertices[v].position);
+					glm::vec3 e1 = glm::vec3(vertices[indices[base + (k + 1) % 3]].position) - p;
+					glm::vec3 e2 = glm::vec3(vertices[indices[base + (k + 2) % 3]].position) - p;
+					float lengths = glm::length(e1) * glm::length(e2);
+					if (lengths <= 0)
+						continue;
+					float angle = glm::acos(glm::clamp(glm::dot(e1, e2) / lengths, -1.0f, 1.0f));
+
+					sdir -= n * glm::dot(n, sdir);
+					tdir -= n * glm::dot(n, tdir);
+					float sLength = glm::length(sdir), tLength = glm::length(tdir);
+					if (sLength > 0)
+						tan1 += sdir * (angle / sLength);
+					if (tLength > 0)
+						tan2 += tdir * (angle / tLength);
+				}
+				else {
+					tan1 += sdir;
+					tan2 += tdir;
+				}
+			}
+
+			// Gram-Schmidt orthogonalize
+			glm::vec4 t = tan1 - n * glm::dot(n, tan1);
+			glm::vec4 tangent = t * glm::inversesqrt(glm::dot(t, t));
+
+			// Calculate handedness (direction of bitangent)
+			tangent.w = (glm::dot(glm::cross(glm::vec3(n), glm::vec3(tan1)), glm::vec3(tan2)) < 0.0F) ? 1.0F : -1.0F;
+			vertices[v].tangent = tangent;
+		}
+	});
+}
 }
-}
\ No newline at end of file
@@ -11,12 +11,22 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 #include <string>
 #include <vector>
+#include <memory>
 #include "Texture.h"
+#include "Frustum.h"
+#include "Bvh.h"
+#include "GpuHandle.h"
+#include "VertexLayout.h"
+
+namespace sns { class AssetLoader; class RenderQueue; class SoftwareOcclusion; class StreamingBuffer; class SurfaceSampler; class TextureStreamer; class TextureUploader; }
 
 namespace aie {
 
+class ShaderProgram;
+
 // a simple triangle mesh wrapper
 class OBJMesh {
 public:
@@ -31,11 +41,26 @@ public:
 		glm::vec4 tangent;	// added to attrib location 3
 	};
 
+	// a quantised Vertex, 24 bytes instead of 56. the attrib locations are
+	// the same and the shaders read it unchanged, opengl unpacks each part
+	struct PackedVertex {
+		glm::vec3		position;	// attrib location 0, w reads as 1
+		unsigned int	normal;		// attrib location 1, GL_INT_2_10_10_10_REV with w 0
+		unsigned int	texcoord;	// attrib location 2, two half floats
+		unsigned int	tangent;	// attrib location 3, GL_INT_2_10_10_10_REV, w is the bitangent sign
+	};
+
+	// the layout chunks are uploaded in
+	enum VertexFormat : unsigned int {
+		FULL_VERTEX = 0,	// Vertex
+		PACKED_VERTEX,		// PackedVertex
+	};
+
 	// a basic material
 	class Material {
 	public:
 
-		Material() : ambient(1), diffuse(1), specular(0), emissive(0), specularPower(1), opacity(1) {}
+		Material() : ambient(1), diffuse(1), specular(0), emissive(0), specularPower(1), opacity(1), packedMaps(0) {}
 		~Material() {}
 
 		glm::vec3 ambient;
@@ -46,44 +71,531 @@ public:
 		float specularPower;
 		float opacity;
 
-		Texture diffuseTexture;				// bound slot 0
-		Texture alphaTexture;				// bound slot 1
-		Texture ambientTexture;				// bound slot 2
-		Texture specularTexture;			// bound slot 3
-		Texture specularHighlightTexture;	// bound slot 4
-		Texture normalTexture;				// bound slot 5
-		Texture displacementTexture;		// bound slot 6
+		// textures are shared through the TextureCache, null when unused
+		std::shared_ptr<Texture> diffuseTexture;			// bound slot 0
+		std::shared_ptr<Texture> alphaTexture;				// bound slot 1
+		std::shared_ptr<Texture> ambientTexture;			// bound slot 2
+		std::shared_ptr<Texture> specularTexture;			// bound slot 3
+		std::shared_ptr<Texture> specularHighlightTexture;	// bound slot 4
+		std::shared_ptr<Texture> normalTexture;				// bound slot 5
+		std::shared_ptr<Texture> displacementTexture;		// bound slot 6
+
+		// the scalar maps a mesh that packs them puts in the channels of
+		// one texture, see setPackScalarMaps(). the maps packed are null
+		enum PackedMap : unsigned int {
+			PACKED_SPECULAR				= 1,	// red
+			PACKED_ALPHA				= 2,	// green
+			PACKED_SPECULAR_HIGHLIGHT	= 4,	// blue
+			PACKED_DISPLACEMENT			= 8,	// alpha
+		};
+		std::shared_ptr<Texture> packedTexture;				// bound slot 7
+		unsigned int packedMaps;							// PackedMap bits
+	};
+
+	// a run of a chunk's full detail triangles small enough to cull on
+	// its own, see MeshOptimiser::buildMeshlets
+	struct Meshlet {
+		glm::vec4		sphere;		// local space centre and radius
+		glm::vec4		cone;		// the average normal, and the cutoff the view direction's dot must pass to cull
+		unsigned int	firstIndex;	// into the chunk's index buffer
+		unsigned int	indexCount;
+	};
+
+	// the most levels of detail a chunk has, the first is full detail
+	static const unsigned int MAX_LODS = 4;
+
+	// where a lightmapped chunk's second texcoords go, past the instance
+	// transform, the batch material and the object index, and the vertex
+	// buffer binding they are read from
+	static const unsigned int LIGHTMAP_ATTRIBUTE = 10;
+	static const unsigned int LIGHTMAP_BINDING = 2;
+
+	// the gl objects of one chunk, each chunk has a single material.
+	// the index buffer holds every level of detail one after another, all
+	// over the same vertices, indexCount is the first level's. vao is 0
+	// when the chunk is drawn through the vertex array shared by its format,
+	// a lightmapped chunk always has its own, with lightmapVbo attached.
+	// the handles delete the chunk's gl objects, chunks are moved, not copied
+	struct MeshChunk {
+		sns::VertexArrayHandle	vao;
+		sns::BufferHandle		vbo, ibo;
+		sns::BufferHandle		lightmapVbo;	// 0 without a lightmap
+		unsigned int	vertexCount;
+		unsigned int	indexCount;
+		unsigned int	lodCount;
+		unsigned int	lodFirstIndex[MAX_LODS];
+		unsigned int	lodIndexCount[MAX_LODS];
+		unsigned int	indexType;	// GL_UNSIGNED_SHORT when the chunk fits, GL_UNSIGNED_INT otherwise
+		int				materialID;
+		unsigned int	firstMeshlet, meshletCount;	// into getMeshlets()
+		unsigned int	firstRange, rangeCount;		// into getRangeBounds(), none when drawn whole
 	};
 
-	OBJMesh() {}
+	OBJMesh();
 	~OBJMesh();
 
+	// the chunks own their gl objects, a mesh can't be copied
+	OBJMesh(const OBJMesh&) = delete;
+	OBJMesh& operator=(const OBJMesh&) = delete;
+
+	// moving hands over the gl objects, a mesh loaded again elsewhere can
+	// replace this one's in a single assignment on the gl thread
+	OBJMesh(OBJMesh&&) = default;
+	OBJMesh& operator=(OBJMesh&&) = default;
+
 	// will fail if a mesh has already been loaded in to this instance
+	// a binary cache is written next to the obj on first import and
+	// memory-mapped on later loads while the obj is unchanged. it holds
+	// the vertices and indices compressed by the MeshCodec, which later
+	// loads decode on every core. a .gltf
+	// or .glb loads the same way, its static meshes read by the
+	// GltfImporter with the tangents it has kept rather than worked out
 	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false);
 
+	// the two halves of load(). import() parses the obj (or decodes the cache)
+	// and decodes textures without touching opengl, so it is safe to call on
+	// a worker thread. upload() creates the gl buffers and textures and must
+	// be called on the context thread once import() has succeeded. given an
+	// uploader, the textures are queued on it rather than uploaded at once,
+	// and the mesh draws without them until they are in
+	bool import(const char* filename, bool loadTextures = true, bool flipTextureV = false);
+	bool upload(sns::TextureUploader* textureUploader = nullptr);
+
+	// creates and fills the chunks' gl buffers ahead of upload(), on any
+	// thread with a context sharing the main one's, see sns::UploadThread.
+	// upload() then adopts them rather than copy the vertices itself, so
+	// it must only run once the gpu has finished with these. needs gl 4.5,
+	// without it this does nothing and returns false
+	bool uploadBuffers();
+
+	// the other way to import(), for big scans, that never holds the
+	// vertices in memory. the obj is mapped and sns::ObjParser::parseMapped
+	// parses it on every core straight into a mapped staging buffer, which
+	// the gpu then copies into the chunk's own, so upload() adopts them as
+	// it does uploadBuffers()'. only an obj of one material whose every
+	// corner uses the same index for its position, texcoord and normal can
+	// be read this way, anything else returns false having made nothing,
+	// and must be import()ed. there is no cache, welding, tangents, levels
+	// of detail or meshlets, the one chunk is always FULL_VERTEX and no
+	// textures are loaded, nor can the mesh be pickable, lightmapped or
+	// have an emission surface. must be called on a thread with a context
+	// sharing the main one's, and needs gl 4.5
+	bool importMapped(const char* filename, bool flipTextureV = false);
+
+	// frees the gl buffers and everything import() made, dropping the
+	// mesh's references to its textures, so the same instance can be
+	// imported again. must be called on the context thread, and not while
+	// an import() into it is still running
+	void unload();
+
+	// picks the layout upload() creates the chunks in, it must be set before
+	// import(). the cache always holds the same vertices, packing happens in
+	// import() so it stays off the context thread. meshes with texcoords
+	// beyond what half floats hold closely fall back to FULL_VERTEX
+	void setVertexFormat(VertexFormat format) { m_vertexFormat = format; }
+	VertexFormat getVertexFormat() const { return m_vertexFormat; }
+
+	// keeps every chunk's full detail triangles after upload(), with a bvh
+	// over them built in import(), so rays can be tested against the mesh.
+	// like the vertex format it must be set before import()
+	void setPickable(bool pickable) { m_pickable = pickable; }
+	bool isPickable() const { return m_pickable; }
+
+	// builds an alias table over every chunk's full detail triangles in
+	// import(), so particles can spawn spread evenly over the surface, and
+	// uploads it for compute shaders in upload(). like the vertex format it
+	// must be set before import()
+	void setEmissionSurface(bool emission) { m_emissionSurface = emission; }
+	bool hasEmissionSurface() const { return m_emissionSurface; }
+
+	// the table, null until imported or without an emission surface. it is
+	// never changed once uploaded, and an import over this one makes a new
+	// table, so emitters sampling the old one can keep it until told
+	std::shared_ptr<const sns::SurfaceSampler> getSurface() const { return m_surface; }
+
+	// leaves textures no other mesh has loaded as placeholders in import(),
+	// see Texture::setPlaceholder, so they aren't read until a chunk using
+	// their material is first submitted inside a frustum and
+	// loadSeenTextures() is called. like the vertex format it must be set
+	// before import()
+	void setLazyTextures(bool lazy) { m_lazyTextures = lazy; }
+	bool hasLazyTextures() const { return m_lazyTextures; }
+
+	// packs the specular, alpha, specular highlight and displacement maps
+	// of materials with at least two of them into the channels of one
+	// texture, see Texture::getPackedName, so they are one bind and one
+	// sample. the packed maps are always uncompressed. shaders read it as
+	// packedTexture for materials with MATERIAL_PACKED_MAPS. like the
+	// vertex format it must be set before import()
+	void setPackScalarMaps(bool pack) { m_packScalarMaps = pack; }
+	bool isPackingScalarMaps() const { return m_packScalarMaps; }
+
+	// lets the small textures of the materials be packed into pages of
+	// sns::TextureAtlas as they are uploaded, so materials share a bind.
+	// every shader drawing the mesh must then sample its maps through
+	// their textureRects, see atlas.glsl, and the mesh can't be batched,
+	// as the batches copy whole textures. like the vertex format it must
+	// be set before import()
+	void setAtlasTextures(bool atlas) { m_atlasTextures = atlas; }
+	bool isAtlasingTextures() const { return m_atlasTextures; }
+
+	// joins the shapes of an obj that share a material into one chunk, as
+	// many as fit 16 bit indices, so a material is a draw rather than a
+	// draw per shape. each shape stays a range of the chunk's full detail
+	// indices with bounds of its own, and draw(frustum) culls the ranges
+	// of visible chunks and draws what is left with one multi-draw. like
+	// the vertex format it must be set before import()
+	void setMergeMaterials(bool merge) { m_mergeMaterials = merge; }
+	bool isMergingMaterials() const { return m_mergeMaterials; }
+
+	// unwraps every chunk into one square lightmap of this many texels a
+	// side in import(), see sns::LightmapPacker, and draws the texcoords
+	// into it from LIGHTMAP_ATTRIBUTE. the unwrap is cached with the
+	// vertices. 0, the default, leaves the mesh without one. the bake
+	// reads the triangles back, so the mesh must be pickable too, and
+	// like the vertex format it must be set before import()
+	void setLightmapResolution(unsigned int resolution) { m_lightmapResolution = resolution; }
+	unsigned int getLightmapResolution() const { return m_lightmapResolution; }
+
+	// finds the closest triangle a local space ray hits, as the chunk and
+	// that chunk's triangle. the distance is in lengths of direction, so a
+	// ray transformed into the mesh's space keeps its distances. false if
+	// nothing was hit or the mesh isn't pickable
+	bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+					  unsigned int& chunk, unsigned int& triangle, float& distance) const;
+
+	// as above against a single chunk
+	bool intersectChunk(unsigned int chunk, const glm::vec3& origin, const glm::vec3& direction,
+						float maxDistance, unsigned int& triangle, float& distance) const;
+
+	// the local space corners of a pickable chunk's triangle
+	void getTriangle(unsigned int chunk, unsigned int triangle, glm::vec3* corners) const;
+
+	// how many triangles a pickable chunk has, 0 when it isn't
+	unsigned int getTriangleCount(unsigned int chunk) const;
+
+	// as getTriangle() with the corners' normals and lightmap texcoords,
+	// for a pickable mesh with a lightmap. false without one
+	bool getLightmapTriangle(unsigned int chunk, unsigned int triangle, glm::vec3* corners,
+							 glm::vec3* normals, glm::vec2* texcoords) const;
+
+	// bytes per vertex of a layout
+	static unsigned int getVertexSize(VertexFormat format);
+
+	// where each attrib of a layout is and how it is stored
+	static const sns::VertexLayout& getVertexLayout(VertexFormat format);
+
+	// bytes per index of a chunk's index type
+	static unsigned int getIndexSize(unsigned int indexType);
+
+	// quantises a vertex into the packed layout
+	static PackedVertex pack(const Vertex& vertex);
+
+	// bytes of vertex and index buffers the chunks take on the gpu
+	size_t getGPUBytes() const;
+
+	// true once upload() has created the mesh chunks
+	bool isLoaded() const { return m_meshChunks.empty() == false; }
+
+	// extension appended to the obj filename for the binary cache
+	static const char* getCacheExtension() { return ".snsmesh"; }
+
 	// allow option to draw as patches for tessellation
 	void draw(bool usePatches = false);
 
+	// draws only the chunks whose bounds are inside the frustum. the
+	// frustum must be in the mesh's local space, from a projection view model
+	void draw(const sns::Frustum& frustum, bool usePatches = false);
+
+	// draws count copies of the mesh, one instanced draw per chunk. the
+	// transforms are streamed into an instance buffer read as a mat4 at
+	// attrib locations 4 to 7, so the bound program must take its model
+	// matrix from there. meant to be called once a frame per mesh
+	void drawInstanced(const glm::mat4* transforms, unsigned int count, bool usePatches = false);
+
+	// the first of the four attrib locations holding an instance's transform
+	static const unsigned int INSTANCE_ATTRIBUTE = 4;
+
+	// draws a single chunk with its material at a level of detail, for the
+	// render queue. the program it is drawn with must already be bound
+	void drawChunk(unsigned int chunk, bool usePatches = false, unsigned int lod = 0) const;
+
+	// picks every chunk's level of detail from how many pixels tall its
+	// bounds are on screen, halving the detail each time they halve. a
+	// level only changes once the size is a tenth past the switch, so
+	// chunks near one don't flicker between levels. the draws and submit()
+	// use the picked levels, until this is first called they use level 0
+	void selectLODs(const glm::mat4& projection, const glm::mat4& modelView, float viewportHeight);
+
+	// scales how many pixels tall chunks are when selectLODs() drops them
+	// a level, for every mesh. above 1 drops detail nearer the camera for
+	// cheaper frames, below 1 keeps it further away. 1 by default
+	static void setLODScale(float scale) { s_lodScale = scale; }
+	static float getLODScale() { return s_lodScale; }
+
+	// asks the streamer for the mip level each chunk's textures need, from
+	// how many texels of them a pixel covers at the nearest point of the
+	// chunk's bounds. a chunk's texcoord density is worked out while
+	// importing, as the square root of its texcoord area over its surface
+	// area, so it holds for textures tiled across it too
+	void requestTextures(sns::TextureStreamer& streamer, const glm::mat4& projection,
+						 const glm::mat4& modelView, float viewportHeight) const;
+
+	// with lazy textures, has the loader load the placeholders of every
+	// material a chunk has been submitted with since the last call. must
+	// be called on the context thread
+	void loadSeenTextures(sns::AssetLoader& loader);
+
+	// the level of detail selectLODs() picked for a chunk
+	unsigned int getChunkLOD(unsigned int chunk) const {
+		return chunk < m_chunkLODs.size() ? m_chunkLODs[chunk] : 0;
+	}
+
+	// adds a draw item for every chunk. object is the mesh's index in the
+	// sns::ObjectBuffer the queue is drawn with. when frustums in the mesh's local space
+	// are given, one per view, each item is marked with the views it is
+	// inside and chunks outside all of them are left out. when occlusion is
+	// given, chunks it hides from the first view are left out of that view,
+	// model taking the mesh to the world. does nothing until uploaded
+	void submit(sns::RenderQueue& queue, ShaderProgram* shader, unsigned int object,
+				const sns::Frustum* frustums = nullptr, bool usePatches = false,
+				unsigned int frustumCount = 1, const sns::SoftwareOcclusion* occlusion = nullptr,
+				const glm::mat4& model = glm::mat4(1)) const;
+
+	// what a chunk's material needs from the program drawing it, so the
+	// cheapest one that draws it right can be picked
+	enum MaterialVariant : unsigned int {
+		MATERIAL_ALPHA_TESTED	= 1,	// has an alpha map, its holes are cut out
+		MATERIAL_NORMAL_MAPPED	= 2,	// has a normal map
+		MATERIAL_PACKED_MAPS	= 4,	// has its scalar maps in packedTexture
+
+		MATERIAL_VARIANT_Count	= 8,
+	};
+
+	// a material's MaterialVariant bits, 0 for chunks without one
+	unsigned int getMaterialVariant(int materialID) const;
+
+	// as above, drawing each chunk with shaders[its material's variant].
+	// chunks whose program is null are left out
+	void submit(sns::RenderQueue& queue, ShaderProgram* const* shaders, unsigned int object,
+				const sns::Frustum* frustums = nullptr, bool usePatches = false,
+				unsigned int frustumCount = 1, const sns::SoftwareOcclusion* occlusion = nullptr,
+				const glm::mat4& model = glm::mat4(1)) const;
+
+	size_t getChunkCount() const { return m_meshChunks.size(); }
+
+	// a chunk's buffers, so other code can copy or draw its geometry
+	const MeshChunk& getChunk(unsigned int chunk) const { return m_meshChunks[chunk]; }
+
+	// sends a material to the bound program as a chunk's is sent, for
+	// geometry drawn outside a mesh with the same programs
+	static void bindMaterial(const Material& material);
+
+	// the uniform block binding programs declaring materialData.glsl read
+	// their material from, a range of the UniformRing
+	static const unsigned int MATERIAL_BLOCK_BINDING = 1;
+
+	// registers the material block's binding with ShaderProgram, before
+	// any program that declares it links
+	static void registerMaterialBlock();
+
+	// points attrib locations 0 to 3 of the bound vertex array at vertices
+	// of the format in the bound GL_ARRAY_BUFFER, starting at offset
+	static void setVertexAttributes(size_t offset = 0, VertexFormat format = FULL_VERTEX);
+
+	// the direct state access version of setVertexAttributes, points attrib
+	// locations 0 to 3 of vao at vertices of the format in whichever buffer
+	// is given to vertex buffer binding
+	static void setVertexArrayFormat(unsigned int vao, unsigned int binding, VertexFormat format = FULL_VERTEX);
+
+	// local space bounding boxes of the chunks, worked out while importing
+	const sns::BoxList& getChunkBounds() const { return m_chunkBounds; }
+
+	// local space bounding boxes of the shapes merged chunks were made of,
+	// a chunk's from its firstRange
+	const sns::BoxList& getRangeBounds() const { return m_rangeBounds; }
+
+	// every chunk's meshlets, built while importing
+	const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
+
 	// access to the filename that was loaded
 	const std::string& getFilename() const { return m_filename; }
 
 	// material access
 	size_t getMaterialCount() const { return m_materials.size();  }
 	Material& getMaterial(size_t index) { return m_materials[index];  }
+	const Material& getMaterial(size_t index) const { return m_materials[index];  }
+
+	// how calculateTangents weights the triangles around a vertex
+	enum TangentMode : unsigned int {
+		ACCUMULATED_TANGENTS = 0,	// sums them, bigger triangles count for more
+		MIKKTSPACE_TANGENTS,		// projects each onto the vertex's tangent plane and weights it by its corner's angle, as mikktspace does
+	};
+
+	// fills in the tangents of indexed triangles from their texcoords, on
+	// the job system for big meshes. import() calls it for meshes with
+	// normals and texcoords
+	static void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+								  TangentMode mode = ACCUMULATED_TANGENTS);
 
 private:
 
-	void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+	// sends a material's uniforms and textures to the bound program,
+	// skipping anything that program already has
+	void bindMaterial(int materialID) const;
 
-	struct MeshChunk {
-		unsigned int	vao, vbo, ibo;
-		unsigned int	indexCount;
-		int				materialID;
+	struct ChunkData;
+
+	// creates the gl buffers for a chunk and adds it to the mesh
+	void createChunk(const void* vertices, unsigned int vertexCount,
+					 const void* indices, unsigned int indexType, const ChunkData& data);
+
+	// simplifies a chunk's indices into coarser levels of detail and
+	// appends them, for import()
+	static void buildLODs(ChunkData& chunk);
+
+	// joins chunks of a material into as few as fit 16 bit indices,
+	// keeping each one's indices as a range, for import()
+	static void mergeChunksByMaterial(std::vector<ChunkData>& chunks);
+
+	// what intersectChunk() tests, a chunk's full detail triangles and the
+	// bvh over them
+	struct PickChunk {
+		std::vector<glm::vec3>		positions;
+		std::vector<unsigned int>	indices;
+		sns::Bvh					triangles;
+
+		// with a lightmap, what the bake needs of each vertex as well
+		std::vector<glm::vec3>		normals;
+		std::vector<glm::vec2>		lightmapTexcoords;
+	};
+
+	// fills in a chunk's pick data from its imported vertices, for import()
+	static void buildPickChunk(const ChunkData& chunk, PickChunk& pick);
+
+	// draws chunks, skipping those marked 0 in visible when it isn't null.
+	// with visibleRanges, merged chunks at full detail only draw the
+	// ranges marked in it
+	void drawChunks(const unsigned char* visible, bool usePatches, const unsigned char* visibleRanges = nullptr);
+
+	// draws the runs of a merged chunk's ranges marked in visible, its
+	// own slice of the range visibility, with one multi-draw
+	void drawRanges(const MeshChunk& c, unsigned int mode, const unsigned char* visible);
+
+	// makes the instance buffer hold count transforms a frame and
+	// points every chunk's own vertex array at it
+	void createInstanceBuffer(unsigned int count);
+
+	// binds the vertex array a chunk is drawn with, its own or the shared
+	// one of the mesh's format with the chunk's buffers attached
+	void bindChunk(const MeshChunk& c, bool instanced) const;
+
+	// cpu side chunk data built while importing an obj
+	struct ChunkData {
+		std::vector<Vertex>			vertices;
+		std::vector<unsigned int>	indices;
+
+		// vertexData packed by import() when the format is PACKED_VERTEX,
+		// and indexData narrowed when the chunk fits 16 bit indices
+		std::vector<PackedVertex>	packedVertices;
+		std::vector<unsigned short>	shortIndices;
+
+		// the data to upload, pointing into the vectors above
+		const Vertex*				vertexData;
+		const unsigned int*			indexData;
+		unsigned int				vertexCount;
+		unsigned int				indexCount;
+		int							materialID;
+
+		// how the indices split into levels of detail
+		unsigned int				lodCount;
+		unsigned int				lodIndexCounts[MAX_LODS];
+
+		// the full detail indices of each shape merged into the chunk, one
+		// after another, and each one's bounds. empty when not merged
+		std::vector<unsigned int>	rangeIndexCounts;
+		std::vector<glm::vec3>		rangeBoundsMin;
+		std::vector<glm::vec3>		rangeBoundsMax;
+
+		// the full detail triangles cut into meshlets
+		std::vector<Meshlet>		meshlets;
+
+		// a texcoord per vertex into the mesh's lightmap, empty without one
+		std::vector<glm::vec2>		lightmapTexcoords;
+
+		// the buffers made by uploadBuffers(), 0 until then
+		unsigned int				vbo = 0;
+		unsigned int				ibo = 0;
+		unsigned int				lightmapVbo = 0;
+
+		// whether the ibo importMapped() made holds 16 bit indices, as it
+		// leaves shortIndices empty
+		bool						mappedShortIndices = false;
+
+		// local space bounds of the vertices
+		glm::vec3					boundsMin;
+		glm::vec3					boundsMax;
+
+		// texcoord units per local unit of the surface
+		float						uvDensity;
 	};
 
 	std::string				m_filename;
+	VertexFormat			m_vertexFormat;
 	std::vector<MeshChunk>	m_meshChunks;
 	std::vector<Material>	m_materials;
+
+	// a box per chunk for frustum culling, and scratch space for the results
+	sns::BoxList						m_chunkBounds;
+	mutable std::vector<unsigned char>	m_chunkVisibility;
+	mutable std::vector<unsigned int>	m_chunkViewMasks;
+	std::vector<Meshlet>				m_meshlets;
+
+	// with merged materials, a box per range and where its indices are,
+	// and scratch for culling them and gathering their draws
+	bool								m_mergeMaterials;
+	sns::BoxList						m_rangeBounds;
+	std::vector<unsigned int>			m_rangeFirstIndices;
+	std::vector<unsigned int>			m_rangeIndexCounts;
+	mutable std::vector<unsigned char>	m_rangeVisibility;
+	std::vector<int>					m_drawCounts;
+	std::vector<const void*>			m_drawOffsets;
+
+	// each chunk's level of detail from selectLODs()
+	std::vector<unsigned char>			m_chunkLODs;
+
+	// each chunk's texcoord units per local unit, for requestTextures()
+	std::vector<float>					m_chunkUVDensities;
+
+	// when pickable, each chunk's triangles and a bvh over the chunks
+	bool								m_pickable;
+	std::vector<PickChunk>				m_pickChunks;
+	sns::Bvh							m_pickBvh;
+
+	// see setLightmapResolution()
+	unsigned int						m_lightmapResolution;
+
+	// see setEmissionSurface(), the table is shared with the emitters
+	bool											m_emissionSurface;
+	std::shared_ptr<sns::SurfaceSampler>			m_surface;
+
+	// with lazy textures, whether each material has been submitted since
+	// loadSeenTextures() last ran, and whether its textures were loaded
+	bool								m_lazyTextures;
+	mutable std::vector<unsigned char>	m_materialsSeen;
+
+	// see setPackScalarMaps() and setAtlasTextures()
+	bool								m_packScalarMaps;
+	bool								m_atlasTextures;
+
+	// the transforms drawInstanced streams, made on first use
+	std::unique_ptr<sns::StreamingBuffer>	m_instances;
+
+	// data waiting for upload() after import()
+	std::vector<ChunkData>				m_pendingChunks;
+
+	// see setLODScale()
+	static float						s_lodScale;
 };
 
 } // namespace aie
\ No newline at end of file
@@ -0,0 +1,899 @@
+/**
+	ObjParser.cpp
+
+	Purpose: ObjParser.cpp is the source file for the ObjParser class. The
+			ObjParser reads the geometry of an OBJ file on every core at
+			once, straight into the vertices OBJMesh uploads.
+
+	@author Nathan Nette
+*/
+#include "ObjParser.h"
+#include "JobSystem.h"
+#include "FileSystem.h"
+#include <glm/common.hpp>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace sns
+{
+	// How many blocks a file is cut into per thread, so a worker that
+	//	finishes early has more to steal.
+	static const unsigned int BLOCKS_PER_THREAD = 4;
+
+	// What a face index resolves to when it's outside the file, so the
+	//	range check in buildShape catches it.
+	static const int BAD_INDEX = INT_MAX;
+
+	// Exact powers of ten, a double holds all of these exactly.
+	static const double POWERS_OF_TEN[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	/**
+		A run of a block's faces that are all in one shape.
+	*/
+	struct ObjParser::Group
+	{
+		// Whether a usemtl, g or o came before the faces. The first group
+		//	of a block continues the shape the last block ended in.
+		bool startsShape;
+
+		// Whether it was a usemtl, and its name.
+		bool setsMaterial;
+		std::string material;
+
+		// Three ints a corner, its position, texcoord and normal, -1 for
+		//	a texcoord or normal that isn't given.
+		std::vector<int> corners;
+		bool hasTexcoords;
+		bool hasNormals;
+	};
+
+	/**
+		A part of the file ending on a line, parsed by one job.
+	*/
+	struct ObjParser::Block
+	{
+		const char* begin;
+		const char* end;
+
+		unsigned int positionCount;
+		unsigned int texcoordCount;
+		unsigned int normalCount;
+
+		// How many of each attribute the blocks before it have.
+		unsigned int firstPosition;
+		unsigned int firstTexcoord;
+		unsigned int firstNormal;
+
+		std::vector<Group> groups;
+		std::vector<std::string> materialLibraries;
+
+		// For parseMapped, how many triangles its faces make and how many
+		//	the blocks before it do, whether it has a usemtl, whether a
+		//	face couldn't be written, and the bounds of its positions.
+		unsigned int triangleCount;
+		unsigned int firstTriangle;
+		bool hasMaterial;
+		bool failed;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	static bool isSpace(char a_c)
+	{
+		return a_c == ' ' || a_c == '\t';
+	}
+
+	// Skips spaces and tabs, never a line's end.
+	static const char* skipSpace(const char* a_p, const char* a_end)
+	{
+		while (a_p < a_end && isSpace(*a_p))
+			++a_p;
+		return a_p;
+	}
+
+	// Returns the start of the next line.
+	static const char* nextLine(const char* a_p, const char* a_end)
+	{
+		const char* newline = (const char*)memchr(a_p, '\n', a_end - a_p);
+		return newline != nullptr ? newline + 1 : a_end;
+	}
+
+	// Whether a line starts with a keyword followed by a space or its end.
+	static bool isKeyword(const char* a_p, const char* a_end, const char* a_keyword)
+	{
+		size_t length = strlen(a_keyword);
+		if ((size_t)(a_end - a_p) < length || memcmp(a_p, a_keyword, length) != 0)
+			return false;
+		return a_p + length == a_end || isSpace(a_p[length]) || a_p[length] == '\r' || a_p[length] == '\n';
+	}
+
+	// Returns the rest of a line, without the spaces around it.
+	static std::string restOfLine(const char* a_p, const char* a_end)
+	{
+		a_p = skipSpace(a_p, a_end);
+		const char* last = a_p;
+		while (last < a_end && *last != '\n' && *last != '\r')
+			++last;
+		while (last > a_p && isSpace(last[-1]))
+			--last;
+		return std::string(a_p, last);
+	}
+
+	/**
+		parseFloat reads a decimal number, with an optional exponent, as
+			a double and rounds it once. Up to 19 digits are kept, more
+			than enough for what a float holds.
+
+			@return the character after the number, or a_p with a_value 0
+					if there isn't one.
+	*/
+	static const char* parseFloat(const char* a_p, const char* a_end, float& a_value)
+	{
+		const char* p = a_p;
+		bool negative = false;
+		if (p < a_end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		unsigned long long mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any = false;
+		for (; p < a_end && *p >= '0' && *p <= '9'; ++p, any = true)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+			}
+			else
+				++exponent;
+		}
+		if (p < a_end && *p == '.')
+		{
+			for (++p; p < a_end && *p >= '0' && *p <= '9'; ++p, any = true)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += mantissa != 0;
+					--exponent;
+				}
+			}
+		}
+		if (any == false)
+		{
+			a_value = 0;
+			return a_p;
+		}
+
+		if (p < a_end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < a_end && (*e == '-' || *e == '+'))
+				negativeExponent = *e++ == '-';
+			if (e < a_end && *e >= '0' && *e <= '9')
+			{
+				int value = 0;
+				for (; e < a_end && *e >= '0' && *e <= '9'; ++e)
+				{
+					if (value < 10000)
+						value = value * 10 + (*e - '0');
+				}
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		double result = (double)mantissa;
+		if (exponent < 0)
+			result = -exponent <= 22 ? result / POWERS_OF_TEN[-exponent] : result * std::pow(10.0, exponent);
+		else if (exponent > 0)
+			result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * std::pow(10.0, exponent);
+
+		a_value = (float)(negative ? -result : result);
+		return p;
+	}
+
+	/**
+		parseIndex reads a face index and makes it 0 based, counting a
+			negative one back from the attributes read so far.
+
+			@return the character after the index, or a_p with a_index -1
+					if there isn't one.
+	*/
+	static const char* parseIndex(const char* a_p, const char* a_end, unsigned int a_count, int& a_index)
+	{
+		const char* p = a_p;
+		bool negative = false;
+		if (p < a_end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		long long value = 0;
+		const char* digits = p;
+		for (; p < a_end && *p >= '0' && *p <= '9'; ++p)
+		{
+			if (value <= INT_MAX)
+				value = value * 10 + (*p - '0');
+		}
+		if (p == digits)
+		{
+			a_index = -1;
+			return a_p;
+		}
+
+		long long index = negative ? (long long)a_count - value : value - 1;
+		a_index = index >= 0 && index < INT_MAX && value != 0 ? (int)index : BAD_INDEX;
+		return p;
+	}
+
+	ObjParser::ObjParser()
+	{
+	}
+
+	/**
+		parse reads an OBJ file, replacing anything read before.
+
+			@param1 a_filename is the path of the OBJ.
+
+			@param2 a_flipTextureV flips the V texture coordinate.
+
+			@return false if the file can't be read or a face indexes
+					something that isn't there.
+	*/
+	bool ObjParser::parse(const char* a_filename, bool a_flipTextureV)
+	{
+		m_shapes.clear();
+		m_materialLibraries.clear();
+		m_lastError.clear();
+
+		FileView file;
+		if (FileSystem::instance().open(a_filename, file) == false)
+		{
+			m_lastError = std::string("Cannot open file [") + a_filename + "]";
+			return false;
+		}
+
+		std::vector<Block> blocks;
+		cutBlocks((const char*)file.getData(), file.getSize(), blocks);
+
+		// Count the attributes, then give each block its place in the
+		//	shared arrays.
+		runBlocks(blocks, [](Block& a_block) { countBlock(a_block, false); });
+
+		unsigned long long positionCount = 0, texcoordCount = 0, normalCount = 0;
+		for (Block& block : blocks)
+		{
+			block.firstPosition = (unsigned int)positionCount;
+			block.firstTexcoord = (unsigned int)texcoordCount;
+			block.firstNormal = (unsigned int)normalCount;
+			positionCount += block.positionCount;
+			texcoordCount += block.texcoordCount;
+			normalCount += block.normalCount;
+		}
+		if (positionCount >= INT_MAX || texcoordCount >= INT_MAX || normalCount >= INT_MAX)
+		{
+			m_lastError = std::string("Too many vertices in [") + a_filename + "]";
+			return false;
+		}
+
+		m_positions.resize((size_t)positionCount * 3);
+		m_texcoords.resize((size_t)texcoordCount * 2);
+		m_normals.resize((size_t)normalCount * 3);
+
+		runBlocks(blocks, [this](Block& a_block) { parseBlock(a_block); });
+
+		// Join the blocks' groups into shapes. Only usemtl changes the
+		//	material and it always starts a shape, so every group of a
+		//	shape has the same one.
+		std::vector<int> remap(m_positions.size() / 3, -1);
+		std::vector<const Group*> groups;
+		std::string material;
+		bool success = true;
+
+		auto finishShape = [&]()
+		{
+			if (groups.empty() == false && success)
+			{
+				Shape shape;
+				shape.material = material;
+				success = buildShape(groups, a_flipTextureV, remap, shape);
+				if (success)
+					m_shapes.push_back(std::move(shape));
+			}
+			groups.clear();
+		};
+
+		for (const Block& block : blocks)
+		{
+			for (const Group& group : block.groups)
+			{
+				if (group.startsShape)
+					finishShape();
+				if (group.setsMaterial)
+					material = group.material;
+				if (group.corners.empty() == false)
+					groups.push_back(&group);
+			}
+			m_materialLibraries.insert(m_materialLibraries.end(),
+				block.materialLibraries.begin(), block.materialLibraries.end());
+		}
+		finishShape();
+
+		// The attributes have all been copied into the shapes.
+		std::vector<float>().swap(m_positions);
+		std::vector<float>().swap(m_texcoords);
+		std::vector<float>().swap(m_normals);
+
+		if (success == false)
+		{
+			m_shapes.clear();
+			m_lastError = std::string("A face indexes a vertex that isn't in [") + a_filename + "]";
+		}
+		return success;
+	}
+
+	/**
+		parseMapped reads an OBJ file of one shape straight into the
+			caller's memory. The blocks are counted as parse's are, with
+			their triangles too, so each knows where its vertices and
+			triangles go and the second pass writes every line where it
+			belongs, however the blocks are spread over the workers.
+
+			@param1 a_filename is the path of the OBJ.
+
+			@param2 a_flipTextureV flips the V texture coordinate.
+
+			@param3 a_map fills in where to write, given the counts.
+
+			@param4 a_boundsMin is given the smallest position.
+
+			@param5 a_boundsMax is given the largest.
+
+			@return false if the file can't be read or parsed this way.
+	*/
+	bool ObjParser::parseMapped(const char* a_filename, bool a_flipTextureV,
+		const std::function<bool(const MappedCounts&, MappedTarget&)>& a_map,
+		glm::vec3& a_boundsMin, glm::vec3& a_boundsMax)
+	{
+		m_lastError.clear();
+
+		FileView file;
+		if (FileSystem::instance().open(a_filename, file) == false)
+		{
+			m_lastError = std::string("Cannot open file [") + a_filename + "]";
+			return false;
+		}
+
+		std::vector<Block> blocks;
+		cutBlocks((const char*)file.getData(), file.getSize(), blocks);
+		runBlocks(blocks, [](Block& a_block) { countBlock(a_block, true); });
+
+		unsigned long long positionCount = 0, texcoordCount = 0, normalCount = 0, triangleCount = 0;
+		bool hasMaterial = false;
+		for (Block& block : blocks)
+		{
+			block.firstPosition = (unsigned int)positionCount;
+			block.firstTexcoord = (unsigned int)texcoordCount;
+			block.firstNormal = (unsigned int)normalCount;
+			block.firstTriangle = (unsigned int)triangleCount;
+			positionCount += block.positionCount;
+			texcoordCount += block.texcoordCount;
+			normalCount += block.normalCount;
+			triangleCount += block.triangleCount;
+			hasMaterial |= block.hasMaterial;
+		}
+
+		// A vertex for each position only works when there are as many of
+		//	the others, or none.
+		if (hasMaterial || (texcoordCount != 0 && texcoordCount != positionCount) ||
+			(normalCount != 0 && normalCount != positionCount))
+		{
+			m_lastError = std::string("[") + a_filename + "] isn't one shape with a vertex for every position";
+			return false;
+		}
+		if (positionCount >= INT_MAX || triangleCount * 3 >= UINT_MAX)
+		{
+			m_lastError = std::string("Too many vertices in [") + a_filename + "]";
+			return false;
+		}
+
+		MappedCounts counts = {};
+		counts.vertexCount = (unsigned int)positionCount;
+		counts.indexCount = (unsigned int)(triangleCount * 3);
+		counts.hasNormals = normalCount != 0;
+		counts.hasTexcoords = texcoordCount != 0;
+		MappedTarget target = {};
+		if (a_map(counts, target) == false || target.vertices == nullptr || target.indices == nullptr)
+		{
+			m_lastError = std::string("Nowhere to parse [") + a_filename + "] into";
+			return false;
+		}
+
+		runBlocks(blocks, [&target, &counts, a_flipTextureV](Block& a_block)
+		{
+			parseMappedBlock(a_block, target, counts, a_flipTextureV);
+		});
+
+		a_boundsMin = glm::vec3(positionCount > 0 ? FLT_MAX : 0.0f);
+		a_boundsMax = glm::vec3(positionCount > 0 ? -FLT_MAX : 0.0f);
+		for (const Block& block : blocks)
+		{
+			if (block.failed)
+			{
+				m_lastError = std::string("A face of [") + a_filename + "] indexes a vertex that isn't there, " +
+					"or differently for its position, texcoord and normal";
+				return false;
+			}
+			if (block.positionCount > 0)
+			{
+				a_boundsMin = glm::min(a_boundsMin, block.boundsMin);
+				a_boundsMax = glm::max(a_boundsMax, block.boundsMax);
+			}
+		}
+		return true;
+	}
+
+	/**
+		cutBlocks cuts a file into blocks just after a line's end, at least
+			MIN_BLOCK_SIZE each and BLOCKS_PER_THREAD a core at most.
+
+			@param1 a_data is the file.
+
+			@param2 a_size is its size in bytes.
+
+			@param3 a_blocks is given the blocks, in file order.
+	*/
+	void ObjParser::cutBlocks(const char* a_data, size_t a_size, std::vector<Block>& a_blocks)
+	{
+		JobSystem& jobs = JobSystem::instance();
+		size_t blockCount = a_size / MIN_BLOCK_SIZE;
+		size_t maxBlocks = (size_t)(jobs.getWorkerCount() + 1) * BLOCKS_PER_THREAD;
+		blockCount = blockCount < 1 ? 1 : blockCount > maxBlocks ? maxBlocks : blockCount;
+
+		a_blocks.reserve(blockCount);
+		const char* begin = a_data;
+		for (size_t i = 1; i <= blockCount && begin < a_data + a_size; ++i)
+		{
+			const char* end = i == blockCount ? a_data + a_size : nextLine(a_data + a_size * i / blockCount, a_data + a_size);
+			if (end <= begin)
+				continue;
+
+			Block block = {};
+			block.begin = begin;
+			block.end = end;
+			a_blocks.push_back(std::move(block));
+			begin = end;
+		}
+	}
+
+	/**
+		runBlocks runs a pass over every block, as a job each and waiting
+			for them all, or on this thread when there is just the one.
+
+			@param1 a_blocks is the blocks.
+
+			@param2 a_pass is what is run on each.
+	*/
+	void ObjParser::runBlocks(std::vector<Block>& a_blocks, const std::function<void(Block&)>& a_pass)
+	{
+		if (a_blocks.size() == 1)
+		{
+			a_pass(a_blocks[0]);
+			return;
+		}
+
+		JobSystem& jobs = JobSystem::instance();
+		JobCounter counter;
+		for (Block& block : a_blocks)
+			jobs.run([&a_pass, &block]() { a_pass(block); }, &counter);
+		jobs.wait(counter);
+	}
+
+	/**
+		countBlock counts the v, vt and vn lines of a block. For
+			parseMapped it counts the triangles every f line makes too,
+			a fan of its corners, and looks for a usemtl.
+
+			@param1 a_block is the block.
+
+			@param2 a_faces counts the triangles and usemtl as well.
+	*/
+	void ObjParser::countBlock(Block& a_block, bool a_faces)
+	{
+		const char* end = a_block.end;
+		for (const char* p = a_block.begin; p < end; p = nextLine(p, end))
+		{
+			p = skipSpace(p, end);
+			if (a_faces && end - p >= 2 && p[0] == 'f' && isSpace(p[1]))
+			{
+				// Corners are whatever is between the spaces, as
+				//	parseMappedBlock fails any that isn't one.
+				unsigned int corners = 0;
+				const char* q = skipSpace(p + 2, end);
+				while (q < end && *q != '\n' && *q != '\r')
+				{
+					++corners;
+					while (q < end && isSpace(*q) == false && *q != '\n' && *q != '\r')
+						++q;
+					q = skipSpace(q, end);
+				}
+				a_block.triangleCount += corners > 2 ? corners - 2 : 0;
+				continue;
+			}
+			if (a_faces && isKeyword(p, end, "usemtl"))
+			{
+				a_block.hasMaterial = true;
+				continue;
+			}
+			if (end - p < 2 || p[0] != 'v')
+				continue;
+
+			if (isSpace(p[1]))
+				++a_block.positionCount;
+			else if (end - p >= 3 && isSpace(p[2]))
+			{
+				if (p[1] == 't')
+					++a_block.texcoordCount;
+				else if (p[1] == 'n')
+					++a_block.normalCount;
+			}
+		}
+	}
+
+	/**
+		parseBlock parses a block's attributes into the shared arrays, at
+			the place countBlock gave it, and its faces into groups.
+
+			@param1 a_block is the block.
+	*/
+	void ObjParser::parseBlock(Block& a_block)
+	{
+		unsigned int position = a_block.firstPosition;
+		unsigned int texcoord = a_block.firstTexcoord;
+		unsigned int normal = a_block.firstNormal;
+
+		a_block.groups.push_back(Group());
+		Group* group = &a_block.groups.back();
+		group->startsShape = group->setsMaterial = false;
+		group->hasTexcoords = group->hasNormals = false;
+
+		auto startGroup = [&]()
+		{
+			a_block.groups.push_back(Group());
+			group = &a_block.groups.back();
+			group->startsShape = true;
+			group->setsMaterial = false;
+			group->hasTexcoords = group->hasNormals = false;
+		};
+
+		// A polygon's corners, before being cut into triangles.
+		std::vector<int> polygon;
+
+		const char* end = a_block.end;
+		for (const char* p = a_block.begin; p < end; p = nextLine(p, end))
+		{
+			p = skipSpace(p, end);
+			if (p == end || *p == '#' || *p == '\n' || *p == '\r')
+				continue;
+
+			if (p[0] == 'v' && end - p >= 2)
+			{
+				if (isSpace(p[1]))
+				{
+					float* out = &m_positions[(size_t)position++ * 3];
+					const char* q = p + 2;
+					for (int i = 0; i < 3; ++i)
+						q = parseFloat(skipSpace(q, end), end, out[i]);
+					continue;
+				}
+				if (end - p >= 3 && isSpace(p[2]))
+				{
+					if (p[1] == 't')
+					{
+						float* out = &m_texcoords[(size_t)texcoord++ * 2];
+						const char* q = p + 3;
+						for (int i = 0; i < 2; ++i)
+							q = parseFloat(skipSpace(q, end), end, out[i]);
+						continue;
+					}
+					if (p[1] == 'n')
+					{
+						float* out = &m_normals[(size_t)normal++ * 3];
+						const char* q = p + 3;
+						for (int i = 0; i < 3; ++i)
+							q = parseFloat(skipSpace(q, end), end, out[i]);
+						continue;
+					}
+				}
+			}
+
+			if (p[0] == 'f' && end - p >= 2 && isSpace(p[1]))
+			{
+				// v, v/vt, v//vn or v/vt/vn for each corner.
+				polygon.clear();
+				const char* q = skipSpace(p + 2, end);
+				while (q < end && *q != '\n' && *q != '\r')
+				{
+					int v, t = -1, n = -1;
+					const char* next = parseIndex(q, end, position, v);
+					if (next == q)
+						break;
+					q = next;
+					if (q < end && *q == '/')
+					{
+						q = parseIndex(q + 1, end, texcoord, t);
+						if (q < end && *q == '/')
+							q = parseIndex(q + 1, end, normal, n);
+					}
+					polygon.push_back(v);
+					polygon.push_back(t);
+					polygon.push_back(n);
+					group->hasTexcoords |= t != -1;
+					group->hasNormals |= n != -1;
+					q = skipSpace(q, end);
+				}
+
+				// A fan from the first corner.
+				size_t cornerCount = polygon.size() / 3;
+				for (size_t i = 2; i < cornerCount; ++i)
+				{
+					group->corners.insert(group->corners.end(), polygon.begin(), polygon.begin() + 3);
+					group->corners.insert(group->corners.end(), polygon.begin() + (i - 1) * 3, polygon.begin() + (i + 1) * 3);
+				}
+				continue;
+			}
+
+			if (isKeyword(p, end, "usemtl"))
+			{
+				startGroup();
+				group->setsMaterial = true;
+				group->material = restOfLine(p + 6, end);
+			}
+			else if (isKeyword(p, end, "g") || isKeyword(p, end, "o"))
+				startGroup();
+			else if (isKeyword(p, end, "mtllib"))
+				a_block.materialLibraries.push_back(restOfLine(p + 6, end));
+		}
+	}
+
+	/**
+		buildShape makes a vertex for every different index triple of a
+			shape's corners, in the order they're first used. Triples
+			are looked up through the position they use, so no hashing
+			is needed.
+
+			@param1 a_groups are the shape's groups, in file order.
+
+			@param2 a_flipTextureV flips the V texture coordinate.
+
+			@param3 a_remap holds -1 for every position, and is left that
+					way.
+
+			@param4 a_shape receives the vertices and triangles.
+
+			@return false if a corner indexes something that isn't there.
+	*/
+	bool ObjParser::buildShape(const std::vector<const Group*>& a_groups, bool a_flipTextureV,
+		std::vector<int>& a_remap, Shape& a_shape)
+	{
+		typedef aie::OBJMesh::Vertex Vertex;
+
+		size_t cornerCount = 0;
+		a_shape.hasTexcoords = a_shape.hasNormals = a_shape.hasTangents = false;
+		for (const Group* group : a_groups)
+		{
+			cornerCount += group->corners.size() / 3;
+			a_shape.hasTexcoords |= group->hasTexcoords;
+			a_shape.hasNormals |= group->hasNormals;
+		}
+		a_shape.indices.reserve(cornerCount);
+
+		// The triple of each vertex made, and the next made from the
+		//	same position.
+		std::vector<int> triples;
+		std::vector<int> next;
+
+		int positionCount = (int)(m_positions.size() / 3);
+		int texcoordCount = (int)(m_texcoords.size() / 2);
+		int normalCount = (int)(m_normals.size() / 3);
+		bool success = true;
+
+		for (const Group* group : a_groups)
+		{
+			const int* corner = group->corners.data();
+			const int* cornersEnd = corner + group->corners.size();
+			for (; corner < cornersEnd; corner += 3)
+			{
+				int v = corner[0], t = corner[1], n = corner[2];
+				if (v < 0 || v >= positionCount || t >= texcoordCount || n >= normalCount)
+				{
+					success = false;
+					break;
+				}
+
+				int vertex = a_remap[v];
+				while (vertex != -1 && (triples[vertex * 3 + 1] != t || triples[vertex * 3 + 2] != n))
+					vertex = next[vertex];
+
+				if (vertex == -1)
+				{
+					vertex = (int)next.size();
+					triples.insert(triples.end(), corner, corner + 3);
+					next.push_back(a_remap[v]);
+					a_remap[v] = vertex;
+				}
+				a_shape.indices.push_back((unsigned int)vertex);
+			}
+			if (success == false)
+				break;
+		}
+
+		size_t vertexCount = next.size();
+		a_shape.vertices.resize(success ? vertexCount : 0);
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			int v = triples[i * 3], t = triples[i * 3 + 1], n = triples[i * 3 + 2];
+			a_remap[v] = -1;
+			if (success == false)
+				continue;
+
+			Vertex& vertex = a_shape.vertices[i];
+			const float* p = &m_positions[(size_t)v * 3];
+			vertex.position = glm::vec4(p[0], p[1], p[2], 1);
+			vertex.normal = glm::vec4(0);
+			if (n >= 0)
+			{
+				const float* normal = &m_normals[(size_t)n * 3];
+				vertex.normal = glm::vec4(normal[0], normal[1], normal[2], 0);
+			}
+			vertex.texcoord = glm::vec2(0);
+			if (t >= 0)
+			{
+				const float* texcoord = &m_texcoords[(size_t)t * 2];
+				vertex.texcoord = glm::vec2(texcoord[0], a_flipTextureV ? 1.0f - texcoord[1] : texcoord[1]);
+			}
+			vertex.tangent = glm::vec4(0);
+		}
+		return success;
+	}
+
+	/**
+		parseMappedBlock parses a block's lines into a parseMapped target,
+			each v, vt and vn into the parts of the vertex of its index
+			and each face's fan of triangles after the blocks' before.
+			A vertex's parts are written whichever block their lines are
+			in, and every byte of it by one line or another, as the
+			target is often write combined memory that is never read.
+
+			@param1 a_block is the block.
+
+			@param2 a_target is where its lines go.
+
+			@param3 a_counts is what the file has.
+
+			@param4 a_flipTextureV flips the V texture coordinate.
+	*/
+	void ObjParser::parseMappedBlock(Block& a_block, const MappedTarget& a_target, const MappedCounts& a_counts,
+		bool a_flipTextureV)
+	{
+		typedef aie::OBJMesh::Vertex Vertex;
+
+		unsigned int position = a_block.firstPosition;
+		unsigned int texcoord = a_block.firstTexcoord;
+		unsigned int normal = a_block.firstNormal;
+		size_t index = (size_t)a_block.firstTriangle * 3;
+		unsigned short* shortIndices = (unsigned short*)a_target.indices;
+		unsigned int* indices = (unsigned int*)a_target.indices;
+		int vertexCount = (int)a_counts.vertexCount;
+		a_block.boundsMin = glm::vec3(FLT_MAX);
+		a_block.boundsMax = glm::vec3(-FLT_MAX);
+
+		// A polygon's corners, before being cut into triangles.
+		std::vector<int> polygon;
+
+		const char* end = a_block.end;
+		for (const char* p = a_block.begin; p < end && a_block.failed == false; p = nextLine(p, end))
+		{
+			p = skipSpace(p, end);
+			if (p == end || *p == '#' || *p == '\n' || *p == '\r')
+				continue;
+
+			if (p[0] == 'v' && end - p >= 2)
+			{
+				float values[3] = {};
+				if (isSpace(p[1]))
+				{
+					const char* q = p + 2;
+					for (int i = 0; i < 3; ++i)
+						q = parseFloat(skipSpace(q, end), end, values[i]);
+
+					glm::vec3 point(values[0], values[1], values[2]);
+					a_block.boundsMin = glm::min(a_block.boundsMin, point);
+					a_block.boundsMax = glm::max(a_block.boundsMax, point);
+					Vertex& vertex = a_target.vertices[position++];
+					vertex.position = glm::vec4(point, 1);
+					if (a_counts.hasNormals == false)
+						vertex.normal = glm::vec4(0);
+					if (a_counts.hasTexcoords == false)
+						vertex.texcoord = glm::vec2(0);
+					vertex.tangent = glm::vec4(0);
+					continue;
+				}
+				if (end - p >= 3 && isSpace(p[2]))
+				{
+					if (p[1] == 't')
+					{
+						const char* q = p + 3;
+						for (int i = 0; i < 2; ++i)
+							q = parseFloat(skipSpace(q, end), end, values[i]);
+						a_target.vertices[texcoord++].texcoord =
+							glm::vec2(values[0], a_flipTextureV ? 1.0f - values[1] : values[1]);
+						continue;
+					}
+					if (p[1] == 'n')
+					{
+						const char* q = p + 3;
+						for (int i = 0; i < 3; ++i)
+							q = parseFloat(skipSpace(q, end), end, values[i]);
+						a_target.vertices[normal++].normal = glm::vec4(values[0], values[1], values[2], 0);
+						continue;
+					}
+				}
+			}
+
+			if (p[0] == 'f' && end - p >= 2 && isSpace(p[1]))
+			{
+				// Every corner must be whole, as countBlock counted them,
+				//	and name one vertex for all it gives.
+				polygon.clear();
+				const char* q = skipSpace(p + 2, end);
+				while (q < end && *q != '\n' && *q != '\r')
+				{
+					int v, t = -1, n = -1;
+					const char* next = parseIndex(q, end, position, v);
+					if (next == q)
+					{
+						a_block.failed = true;
+						break;
+					}
+					q = next;
+					if (q < end && *q == '/')
+					{
+						q = parseIndex(q + 1, end, texcoord, t);
+						if (q < end && *q == '/')
+							q = parseIndex(q + 1, end, normal, n);
+					}
+					if (v < 0 || v >= vertexCount || (t != -1 && t != v) || (n != -1 && n != v) ||
+						(q < end && isSpace(*q) == false && *q != '\n' && *q != '\r'))
+					{
+						a_block.failed = true;
+						break;
+					}
+					polygon.push_back(v);
+					q = skipSpace(q, end);
+				}
+
+				// A fan from the first corner.
+				for (size_t i = 2; i < polygon.size() && a_block.failed == false; ++i)
+				{
+					int corners[3] = { polygon[0], polygon[i - 1], polygon[i] };
+					for (int corner : corners)
+					{
+						if (a_target.shortIndices)
+							shortIndices[index++] = (unsigned short)corner;
+						else
+							indices[index++] = (unsigned int)corner;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,193 @@
+/**
+	ObjParser.h
+
+	Purpose: ObjParser.h is the header file for the ObjParser class. The
+			ObjParser reads the geometry of an OBJ file on every core at
+			once, straight into the vertices OBJMesh uploads.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "OBJMesh.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The ObjParser class maps an OBJ file and cuts it into blocks on
+			line boundaries, one job each. A first pass counts the v, vt
+			and vn lines of every block, so each block knows where its
+			attributes start and relative indices can be resolved
+			without the blocks before it. A second pass parses the
+			attributes into shared arrays and the faces into index
+			triples, triangulating polygons as fans.
+
+		The blocks are then joined in order into shapes, a new one
+			starting at every usemtl, g and o like tinyobj did. Each
+			shape's corners are merged by their index triple, so a
+			vertex is only made once for every position, texcoord and
+			normal combination used.
+
+		Only geometry is read. The mtllib names are kept so the caller
+			can load the materials, and usemtl is kept by name.
+
+		parseMapped skips the shared arrays and the shapes altogether, for
+			an OBJ of one shape whose every corner uses the same index
+			for its position, texcoord and normal, like a scan. Then the
+			vertex for each position is the one at the same index, so
+			the second pass can parse every line into the caller's
+			vertices and triangles, mapped GPU memory, without a copy of
+			either in between.
+	*/
+	class ObjParser
+	{
+	public:
+		// Files are cut into blocks of at least this many bytes, smaller
+		//	ones aren't worth a job.
+		static const size_t MIN_BLOCK_SIZE = 256 * 1024;
+
+		/**
+			A run of faces with one material.
+		*/
+		struct Shape
+		{
+			std::vector<aie::OBJMesh::Vertex> vertices;
+			std::vector<unsigned int> indices;
+
+			// The usemtl name, empty before the first usemtl.
+			std::string material;
+
+			// Whether any corner had a normal or a texcoord, the rest are 0.
+			bool hasNormals;
+			bool hasTexcoords;
+
+			// Whether the tangents are already there. An OBJ never has
+			//	them, the GltfImporter's shapes can.
+			bool hasTangents;
+		};
+
+		/**
+			What parseMapped found in a file, before anything is parsed.
+		*/
+		struct MappedCounts
+		{
+			unsigned int vertexCount;
+			unsigned int indexCount;
+			bool hasNormals;
+			bool hasTexcoords;
+		};
+
+		/**
+			Where parseMapped writes a file's vertices and triangles.
+		*/
+		struct MappedTarget
+		{
+			aie::OBJMesh::Vertex* vertices;
+
+			// Unsigned shorts when shortIndices is set, unsigned ints
+			//	otherwise.
+			void* indices;
+			bool shortIndices;
+		};
+
+		ObjParser();
+
+		ObjParser(const ObjParser&) = delete;
+		ObjParser& operator=(const ObjParser&) = delete;
+
+		/**
+			parse reads an OBJ file, replacing anything read before.
+
+				@param1 a_filename is the path of the OBJ.
+
+				@param2 a_flipTextureV flips the V texture coordinate.
+
+				@return false if the file can't be read or a face indexes
+						something that isn't there.
+		*/
+		bool parse(const char* a_filename, bool a_flipTextureV = false);
+
+		/**
+			parseMapped reads an OBJ file of one shape straight into the
+				caller's memory, from every core at once. Normals and
+				texcoords the file doesn't have are 0, as are the
+				tangents, and a corner leaving out ones it does have
+				still has its vertex's. Anything read before is left as
+				it was.
+
+				@param1 a_filename is the path of the OBJ.
+
+				@param2 a_flipTextureV flips the V texture coordinate.
+
+				@param3 a_map is given the counts once the file has been
+						counted and fills in where to write them, which
+						must stay valid until parseMapped returns. It
+						returns false to stop without parsing.
+
+				@param4 a_boundsMin is given the smallest position.
+
+				@param5 a_boundsMax is given the largest.
+
+				@return false if the file can't be read, has a usemtl,
+						a corner whose indices differ, or a face that
+						indexes something that isn't there, or a_map
+						returned false. Whatever was written is then
+						only partly parsed.
+		*/
+		bool parseMapped(const char* a_filename, bool a_flipTextureV,
+			const std::function<bool(const MappedCounts&, MappedTarget&)>& a_map,
+			glm::vec3& a_boundsMin, glm::vec3& a_boundsMax);
+
+		/**
+			getShapes returns the shapes with at least one face, in file
+				order. They can be moved out of.
+		*/
+		std::vector<Shape>& getShapes() { return m_shapes; }
+
+		/**
+			getMaterialLibraries returns every mtllib name, in file order.
+		*/
+		const std::vector<std::string>& getMaterialLibraries() const { return m_materialLibraries; }
+
+		/**
+			getLastError returns why parse last failed.
+		*/
+		const std::string& getLastError() const { return m_lastError; }
+
+	private:
+		struct Block;
+		struct Group;
+
+		// Cuts a file into blocks just after a line's end.
+		static void cutBlocks(const char* a_data, size_t a_size, std::vector<Block>& a_blocks);
+
+		// Runs a pass over every block, as a job each when there are more
+		//	than one.
+		static void runBlocks(std::vector<Block>& a_blocks, const std::function<void(Block&)>& a_pass);
+
+		// Counts the attribute lines of a block, and for parseMapped its
+		//	triangles and whether it has a usemtl.
+		static void countBlock(Block& a_block, bool a_faces);
+
+		// Parses a block's attributes and faces.
+		void parseBlock(Block& a_block);
+
+		// Parses a block's lines into a parseMapped target.
+		static void parseMappedBlock(Block& a_block, const MappedTarget& a_target, const MappedCounts& a_counts,
+			bool a_flipTextureV);
+
+		// Merges the corners of a shape's groups into its vertices.
+		bool buildShape(const std::vector<const Group*>& a_groups, bool a_flipTextureV,
+			std::vector<int>& a_remap, Shape& a_shape);
+
+		std::vector<float> m_positions;
+		std::vector<float> m_texcoords;
+		std::vector<float> m_normals;
+
+		std::vector<Shape> m_shapes;
+		std::vector<std::string> m_materialLibraries;
+		std::string m_lastError;
+	};
+}
@@ -0,0 +1,214 @@
+/**
+	ObjectBuffer.cpp
+
+	Purpose: ObjectBuffer.cpp is the source file for the ObjectBuffer
+			class. The ObjectBuffer keeps what the vertex shaders need
+			of each placed object in one storage buffer written only
+			when an object moves, so drawing one picks it by index.
+
+	@author Nathan Nette
+*/
+#include "ObjectBuffer.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "UniformBlock.h"
+#include "gl_core_4_5.h"
+#include <glm/mat3x3.hpp>
+#include <glm/packing.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <algorithm>
+
+namespace sns
+{
+	// Objects are copied into the buffer as they are, so each member must
+	//	be where object.glsl's std430 layout puts it.
+	SNS_STD430_MEMBER(ObjectBuffer::Object, model, 0);
+	SNS_STD430_MEMBER(ObjectBuffer::Object, normalMatrix, 64);
+	SNS_STD430_MEMBER(ObjectBuffer::Object, bounds, 112);
+	SNS_STD430_MEMBER(ObjectBuffer::Object, material, 128);
+	SNS_BLOCK_SIZE(ObjectBuffer::Object, 144);
+
+	ObjectBuffer::ObjectBuffer()
+		: m_dirtyFirst(0),
+		m_dirtyEnd(0),
+		m_buffer(0),
+		m_capacity(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffer.
+	*/
+	ObjectBuffer::~ObjectBuffer()
+	{
+		clear();
+	}
+
+	/**
+		add adds an object, written with the next upload.
+
+			@param1 a_model is its model transform.
+
+			@param2 a_material is its MaterialTable id, or NO_MATERIAL.
+
+			@return its index.
+	*/
+	unsigned int ObjectBuffer::add(const glm::mat4& a_model, unsigned int a_material)
+	{
+		unsigned int index = (unsigned int)m_objects.size();
+		Object object = { a_model, {}, glm::vec4(0), { a_material, 0, 0, 0 } };
+		m_objects.push_back(object);
+		setTransform(index, a_model);
+		return index;
+	}
+
+	/**
+		setTransform moves an object, working out its normal matrix.
+
+			@param1 a_index is the object.
+
+			@param2 a_model is its model transform.
+	*/
+	void ObjectBuffer::setTransform(unsigned int a_index, const glm::mat4& a_model)
+	{
+		Object& object = m_objects[a_index];
+		object.model = a_model;
+
+		glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(a_model));
+		for (unsigned int column = 0; column < 3; ++column)
+			object.normalMatrix[column] = glm::vec4(normalMatrix[column], 0);
+		markDirty(a_index);
+	}
+
+	/**
+		setBounds sets the sphere around an object.
+
+			@param1 a_index is the object.
+
+			@param2 a_bounds is the world centre and radius.
+	*/
+	void ObjectBuffer::setBounds(unsigned int a_index, const glm::vec4& a_bounds)
+	{
+		m_objects[a_index].bounds = a_bounds;
+		markDirty(a_index);
+	}
+
+	/**
+		setLightmapRect sets where an object's lightmap is in the atlas of
+			lightmaps.
+
+			@param1 a_index is the object.
+
+			@param2 a_rect is the scale in xy and the offset in zw.
+	*/
+	void ObjectBuffer::setLightmapRect(unsigned int a_index, const glm::vec4& a_rect)
+	{
+		Object& object = m_objects[a_index];
+		object.material[1] = glm::packUnorm2x16(glm::vec2(a_rect.x, a_rect.y));
+		object.material[2] = glm::packUnorm2x16(glm::vec2(a_rect.z, a_rect.w));
+		markDirty(a_index);
+	}
+
+	/**
+		setVirtualTexture sets the virtual texture an object's diffuse
+			colour is sampled from.
+
+			@param1 a_index is the object.
+
+			@param2 a_texture is the texture's index plus one, 0 for none.
+	*/
+	void ObjectBuffer::setVirtualTexture(unsigned int a_index, unsigned int a_texture)
+	{
+		m_objects[a_index].material[3] = a_texture;
+		markDirty(a_index);
+	}
+
+	/**
+		upload writes the objects changed since the last upload. It does
+			nothing if none have.
+	*/
+	void ObjectBuffer::upload()
+	{
+		if (m_dirtyFirst == m_dirtyEnd)
+			return;
+
+		// Grown past the buffer, it is made again at twice the size and
+		//	written whole.
+		if (m_capacity < m_objects.size())
+		{
+			if (m_buffer != 0)
+			{
+				glDeleteBuffers(1, &m_buffer);
+				RenderState::instance().onBufferDeleted(m_buffer);
+				GpuMemory::instance().releaseBuffer(m_buffer);
+			}
+			m_capacity = (unsigned int)m_objects.size() * 2;
+			glGenBuffers(1, &m_buffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, m_capacity * sizeof(Object), nullptr, GL_DYNAMIC_DRAW);
+			GpuMemory::instance().trackBuffer(m_buffer, m_capacity * sizeof(Object), GpuMemory::MESHES,
+				"ObjectBuffer");
+			m_dirtyFirst = 0;
+			m_dirtyEnd = (unsigned int)m_objects.size();
+		}
+		else
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, m_dirtyFirst * sizeof(Object),
+			(m_dirtyEnd - m_dirtyFirst) * sizeof(Object), &m_objects[m_dirtyFirst]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_dirtyFirst = m_dirtyEnd = 0;
+	}
+
+	/**
+		bind binds the storage buffer to BINDING.
+	*/
+	void ObjectBuffer::bind() const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, m_buffer);
+	}
+
+	/**
+		select picks the object the next draws are of.
+
+			@param1 a_index is the object.
+	*/
+	void ObjectBuffer::select(unsigned int a_index)
+	{
+		glVertexAttribI1ui(OBJECT_ATTRIBUTE, a_index);
+	}
+
+	/**
+		clear deletes the buffer and forgets every object.
+	*/
+	void ObjectBuffer::clear()
+	{
+		if (m_buffer != 0)
+		{
+			glDeleteBuffers(1, &m_buffer);
+			RenderState::instance().onBufferDeleted(m_buffer);
+			GpuMemory::instance().releaseBuffer(m_buffer);
+			m_buffer = 0;
+		}
+		m_objects.clear();
+		m_capacity = 0;
+		m_dirtyFirst = m_dirtyEnd = 0;
+	}
+
+	/**
+		markDirty marks an object to be written with the next upload.
+
+			@param1 a_index is the object.
+	*/
+	void ObjectBuffer::markDirty(unsigned int a_index)
+	{
+		if (m_dirtyFirst == m_dirtyEnd)
+		{
+			m_dirtyFirst = a_index;
+			m_dirtyEnd = a_index + 1;
+			return;
+		}
+		m_dirtyFirst = std::min(m_dirtyFirst, a_index);
+		m_dirtyEnd = std::max(m_dirtyEnd, a_index + 1);
+	}
+}
@@ -0,0 +1,187 @@
+/**
+	ObjectBuffer.h
+
+	Purpose: ObjectBuffer.h is the header file for the ObjectBuffer
+			class. The ObjectBuffer keeps what the vertex shaders need
+			of each placed object, its model and normal matrices, its
+			material and its bounds, in one storage buffer written only
+			when an object moves, so drawing one picks it by index
+			instead of being sent its matrices.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The ObjectBuffer class gives every object added to it an index
+			into a std430 storage buffer, read as
+
+			struct Object
+			{
+				mat4 model;
+				mat3 normalMatrix;	// the inverse transpose of the model's
+									//	upper 3x3, three vec4 columns
+				vec4 bounds;		// the world sphere, w 0 until set
+				uvec4 material;		// x is its MaterialTable id, ~0 if none,
+									//	y and z its lightmap rect's scale
+									//	and offset as unorm 2x16, w its
+								//	virtual texture plus one, 0 if none
+			};
+
+			as object.glsl declares it. The normal matrix is worked out
+			by setTransform, once a move, rather than every draw.
+
+		Objects are picked with select before a draw, which sets the
+			constant value of OBJECT_ATTRIBUTE. No vertex array enables
+			that attribute, so one call picks the object for whichever
+			vertex array is bound, and nothing else is sent per draw.
+			Reading it needs GL 4.3.
+	*/
+	class ObjectBuffer
+	{
+	public:
+		// The shader storage binding the buffer is bound to.
+		static const unsigned int BINDING = 5;
+
+		// The vertex attribute the object's index is read from.
+		static const unsigned int OBJECT_ATTRIBUTE = 9;
+
+		// The material of an object without one.
+		static const unsigned int NO_MATERIAL = ~0u;
+
+		/**
+			An object as the shaders read it, 144 bytes.
+		*/
+		struct Object
+		{
+			glm::mat4 model;
+			glm::vec4 normalMatrix[3];
+			glm::vec4 bounds;
+			unsigned int material[4];
+		};
+
+		ObjectBuffer();
+
+		/**
+			The deconstructor deletes the buffer.
+		*/
+		~ObjectBuffer();
+
+		ObjectBuffer(const ObjectBuffer&) = delete;
+		ObjectBuffer& operator=(const ObjectBuffer&) = delete;
+
+		/**
+			add adds an object, written with the next upload.
+
+				@param1 a_model is its model transform.
+
+				@param2 a_material is its MaterialTable id, or NO_MATERIAL.
+
+				@return its index.
+		*/
+		unsigned int add(const glm::mat4& a_model, unsigned int a_material = NO_MATERIAL);
+
+		/**
+			setTransform moves an object, working out its normal matrix.
+
+				@param1 a_index is the object.
+
+				@param2 a_model is its model transform.
+		*/
+		void setTransform(unsigned int a_index, const glm::mat4& a_model);
+
+		/**
+			setBounds sets the sphere around an object.
+
+				@param1 a_index is the object.
+
+				@param2 a_bounds is the world centre and radius.
+		*/
+		void setBounds(unsigned int a_index, const glm::vec4& a_bounds);
+
+		/**
+			setLightmapRect sets where an object's lightmap is in the
+				atlas of lightmaps, which its mesh's lightmap texcoords are
+				scaled and moved into.
+
+				@param1 a_index is the object.
+
+				@param2 a_rect is the scale in xy and the offset in zw, 0
+						to 1 across the atlas.
+		*/
+		void setLightmapRect(unsigned int a_index, const glm::vec4& a_rect);
+
+		/**
+			setVirtualTexture sets the virtual texture an object's diffuse
+				colour is sampled from, see VirtualTextureCache.
+
+				@param1 a_index is the object.
+
+				@param2 a_texture is the texture's index in the cache plus
+						one, 0 for none.
+		*/
+		void setVirtualTexture(unsigned int a_index, unsigned int a_texture);
+
+		/**
+			upload writes the objects changed since the last upload. It
+				does nothing if none have.
+		*/
+		void upload();
+
+		/**
+			bind binds the storage buffer to BINDING.
+		*/
+		void bind() const;
+
+		/**
+			select picks the object the next draws are of.
+
+				@param1 a_index is the object.
+		*/
+		static void select(unsigned int a_index);
+
+		/**
+			getObject returns an object as it will be uploaded.
+
+				@param1 a_index is the object.
+		*/
+		const Object& getObject(unsigned int a_index) const { return m_objects[a_index]; }
+
+		/**
+			getCount returns how many objects there are.
+		*/
+		unsigned int getCount() const { return (unsigned int)m_objects.size(); }
+
+		/**
+			getHandle returns the storage buffer, which changes when it
+				grows, or 0 before the first upload.
+		*/
+		unsigned int getHandle() const { return m_buffer; }
+
+		/**
+			clear deletes the buffer and forgets every object.
+		*/
+		void clear();
+
+	private:
+		// Marks an object to be written with the next upload.
+		void markDirty(unsigned int a_index);
+
+		std::vector<Object> m_objects;
+
+		// The range of objects changed since the last upload, first to
+		//	one past the last. Empty when m_dirtyFirst is m_dirtyEnd.
+		unsigned int m_dirtyFirst;
+		unsigned int m_dirtyEnd;
+
+		unsigned int m_buffer;
+
+		// How many objects the buffer has room for.
+		unsigned int m_capacity;
+	};
+}
@@ -0,0 +1,229 @@
+/**
+	OcclusionQueries.cpp
+
+	Purpose: OcclusionQueries.cpp is the source file for the
+			OcclusionQueries class. The OcclusionQueries test the
+			bounding boxes of large mesh chunks with hardware occlusion
+			queries, and skip the chunks the last results found hidden.
+
+	@author Nathan Nette
+*/
+#include "OcclusionQueries.h"
+#include "GpuReadback.h"
+#include "OBJMesh.h"
+#include "ObjectBuffer.h"
+#include "RenderQueue.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+#include <cstdio>
+
+namespace sns
+{
+	OcclusionQueries::OcclusionQueries()
+		: m_frame(0),
+		m_vao(0),
+		m_minimumSize(4.0f),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor deletes the queries. The GpuReadback must be
+			destroyed first, so none are still being read.
+	*/
+	OcclusionQueries::~OcclusionQueries()
+	{
+		for (Entry& entry : m_entries)
+			glDeleteQueries(1, &entry.query);
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			RenderState::instance().onVertexArrayDeleted(m_vao);
+		}
+	}
+
+	/**
+		create loads the program the boxes are drawn with.
+
+			@return false without it, the queries are left uncreated.
+	*/
+	bool OcclusionQueries::create()
+	{
+		if (m_boxShader.getHandle() == 0)
+		{
+			m_boxShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/occlusionBox.vert");
+			m_boxShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/occlusionBox.frag");
+			if (m_boxShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_boxShader.getLastError());
+				return false;
+			}
+		}
+
+		// Core profiles can't draw without a vertex array, even one with
+		//	nothing in it.
+		if (m_vao == 0)
+			glGenVertexArrays(1, &m_vao);
+		return true;
+	}
+
+	/**
+		beginFrame starts a frame, before its queues are assigned.
+	*/
+	void OcclusionQueries::beginFrame()
+	{
+		++m_frame;
+		m_frameEntries.clear();
+		m_stats = {};
+	}
+
+	/**
+		assign gives the large chunks of a sorted queue seen from a view
+			their queries, for its draw to test.
+
+			@param1 a_queue is the queue.
+
+			@param2 a_objects are the objects its items are placed by.
+
+			@param3 a_viewMask is the view's bit.
+
+			@param4 a_cameraPosition is the view's camera.
+
+			@param5 a_nearPlane is the distance to the view's near plane.
+	*/
+	void OcclusionQueries::assign(RenderQueue& a_queue, const ObjectBuffer& a_objects, unsigned int a_viewMask,
+		const glm::vec3& a_cameraPosition, float a_nearPlane)
+	{
+		for (RenderQueue::Item& item : a_queue.getItems())
+		{
+			item.occlusion = NO_QUERY;
+			if ((item.viewMask & a_viewMask) == 0)
+				continue;
+
+			// A queue submitted by every pass finds the entry this frame
+			//	already has.
+			unsigned long long key = ((unsigned long long)item.object << 32) | item.chunk;
+			auto found = m_lookup.find(key);
+			if (found != m_lookup.end() && m_entries[found->second].frame == m_frame)
+			{
+				item.occlusion = found->second;
+				continue;
+			}
+
+			// The chunk's local box moved into the world, its extent
+			//	through the absolute of the model's rotation and scale.
+			const BoxList& bounds = item.mesh->getChunkBounds();
+			glm::vec3 centre(bounds.centreX[item.chunk], bounds.centreY[item.chunk], bounds.centreZ[item.chunk]);
+			glm::vec3 extent(bounds.extentX[item.chunk], bounds.extentY[item.chunk], bounds.extentZ[item.chunk]);
+			const glm::mat4& model = a_objects.getObject(item.object).model;
+			glm::vec3 worldCentre = glm::vec3(model * glm::vec4(centre, 1));
+			glm::vec3 worldExtent(0);
+			for (unsigned int axis = 0; axis < 3; ++axis)
+				worldExtent += glm::abs(glm::vec3(model[axis])) * extent[axis];
+			if (glm::length(worldExtent) * 2.0f < m_minimumSize)
+				continue;
+
+			unsigned int index = 0;
+			if (found == m_lookup.end())
+			{
+				Entry entry = {};
+				glGenQueries(1, &entry.query);
+				entry.visible = true;
+				index = (unsigned int)m_entries.size();
+				m_entries.push_back(entry);
+				m_lookup.emplace(key, index);
+			}
+			else
+				index = found->second;
+
+			// The near plane cuts into a box the camera is nearly inside,
+			//	which can leave its query nothing to pass.
+			Entry& entry = m_entries[index];
+			entry.boxMin = worldCentre - worldExtent;
+			entry.boxMax = worldCentre + worldExtent;
+			entry.frame = m_frame;
+			glm::vec3 margin(a_nearPlane * 2.0f);
+			entry.inside = glm::all(glm::greaterThanEqual(a_cameraPosition, entry.boxMin - margin)) &&
+				glm::all(glm::lessThanEqual(a_cameraPosition, entry.boxMax + margin));
+			m_frameEntries.push_back(index);
+			item.occlusion = index;
+			++m_stats.tested;
+		}
+	}
+
+	/**
+		test returns what the queries say of an item's chunk.
+
+			@param1 a_query is the item's query from assign.
+	*/
+	OcclusionQueries::Result OcclusionQueries::test(unsigned int a_query) const
+	{
+		const Entry& entry = m_entries[a_query];
+		if (entry.inside)
+			return Result::VISIBLE;
+		if (entry.pending)
+			return Result::PENDING;
+		return entry.visible ? Result::VISIBLE : Result::OCCLUDED;
+	}
+
+	/**
+		issue draws the boxes of this frame's chunks that are due a query
+			into the bound framebuffer's depth, which must be the view's
+			finished depth. Nothing is written.
+	*/
+	void OcclusionQueries::issue()
+	{
+		if (isCreated() == false || m_frameEntries.empty())
+			return;
+
+		static constexpr aie::UniformHandle BOX_MIN("BoxMin");
+		static constexpr aie::UniformHandle BOX_MAX("BoxMax");
+
+		RenderState& state = RenderState::instance();
+		bool bound = false;
+		for (unsigned int index : m_frameEntries)
+		{
+			// Visible chunks are spread over the interval, so as many
+			//	are queried each frame.
+			Entry& entry = m_entries[index];
+			if (entry.pending || entry.inside ||
+				(entry.visible && (m_frame + index) % VISIBLE_QUERY_INTERVAL != 0))
+				continue;
+
+			if (bound == false)
+			{
+				m_boxShader.bind();
+				state.bindVertexArray(m_vao);
+				state.setColourMask(false);
+				state.setDepthMask(false);
+				state.setDepthTest(true);
+				state.setDepthFunc(state.getNearerDepthFunc());
+				bound = true;
+			}
+
+			m_boxShader.bindUniform(BOX_MIN, entry.boxMin);
+			m_boxShader.bindUniform(BOX_MAX, entry.boxMax);
+			glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, entry.query);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+			glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+			++m_stats.issued;
+
+			// Entries are never removed, so the index outlives the read.
+			entry.pending = true;
+			GpuReadback::instance().readQuery(entry.query, [this, index](unsigned long long a_result)
+			{
+				m_entries[index].visible = a_result != 0;
+				m_entries[index].pending = false;
+			});
+		}
+
+		if (bound)
+		{
+			state.setColourMask(true);
+			state.setDepthMask(true);
+		}
+	}
+}
@@ -0,0 +1,196 @@
+/**
+	OcclusionQueries.h
+
+	Purpose: OcclusionQueries.h is the header file for the
+			OcclusionQueries class. The OcclusionQueries test the
+			bounding boxes of large mesh chunks against the depth of
+			the scene with hardware occlusion queries, and skip the
+			chunks the last results found hidden, without ever waiting
+			for a result.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/vec3.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace sns
+{
+	class ObjectBuffer;
+	class RenderQueue;
+
+	/**
+		The OcclusionQueries class keeps a query and the last result of
+			it for every large chunk of every object, as coherent
+			hierarchical culling does. A frame's draws go by what the
+			queries last said, then the boxes of the chunks are drawn
+			into the finished depth, each inside its query, for the
+			frames after.
+
+		Results are read back through the GpuReadback, so a query isn't
+			issued again until its result is in. Chunks whose query is
+			still out are drawn under glBeginConditionalRender with it,
+			letting the gpu skip them once the result is there, and
+			draw them if it isn't yet.
+
+		Chunks found visible are queried again only every
+			VISIBLE_QUERY_INTERVAL frames, as they mostly stay visible,
+			while hidden ones are queried every frame, so they show
+			again a frame or two after they come into view. A chunk
+			whose box the camera is inside is always drawn.
+	*/
+	class OcclusionQueries
+	{
+	public:
+		// An item that isn't tested.
+		static const unsigned int NO_QUERY = ~0u;
+
+		// How many frames apart the chunks last found visible are queried.
+		static const unsigned int VISIBLE_QUERY_INTERVAL = 4;
+
+		/**
+			What the queries say of a chunk.
+		*/
+		enum class Result
+		{
+			VISIBLE,
+			OCCLUDED,
+
+			// Its query is still out, it is drawn conditionally on it.
+			PENDING,
+		};
+
+		/**
+			Counts from the last frame.
+		*/
+		struct Stats
+		{
+			// The chunks assigned a query.
+			unsigned int tested;
+
+			// The queries issued.
+			unsigned int issued;
+		};
+
+		OcclusionQueries();
+
+		/**
+			The deconstructor deletes the queries. The GpuReadback must
+				be destroyed first, so none are still being read.
+		*/
+		~OcclusionQueries();
+
+		OcclusionQueries(const OcclusionQueries&) = delete;
+		OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+		/**
+			create loads the program the boxes are drawn with.
+
+				@return false without it, the queries are left uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vao != 0; }
+
+		/**
+			setMinimumSize sets how long the diagonal of a chunk's world
+				box must be for it to be tested. Smaller chunks cost
+				more to query than they save. 4 by default.
+
+				@param1 a_size is the length in world units.
+		*/
+		void setMinimumSize(float a_size) { m_minimumSize = a_size; }
+		float getMinimumSize() const { return m_minimumSize; }
+
+		/**
+			beginFrame starts a frame, before its queues are assigned.
+		*/
+		void beginFrame();
+
+		/**
+			assign gives the large chunks of a sorted queue seen from a
+				view their queries, for its draw to test.
+
+				@param1 a_queue is the queue.
+
+				@param2 a_objects are the objects its items are placed by.
+
+				@param3 a_viewMask is the view's bit.
+
+				@param4 a_cameraPosition is the view's camera.
+
+				@param5 a_nearPlane is the distance to the view's near
+						plane.
+		*/
+		void assign(RenderQueue& a_queue, const ObjectBuffer& a_objects, unsigned int a_viewMask,
+			const glm::vec3& a_cameraPosition, float a_nearPlane);
+
+		/**
+			test returns what the queries say of an item's chunk.
+
+				@param1 a_query is the item's query from assign.
+		*/
+		Result test(unsigned int a_query) const;
+
+		/**
+			getQuery returns the GL handle of an item's query, for
+				conditional rendering.
+
+				@param1 a_query is the item's query from assign.
+		*/
+		unsigned int getQuery(unsigned int a_query) const { return m_entries[a_query].query; }
+
+		/**
+			issue draws the boxes of this frame's chunks that are due a
+				query into the bound framebuffer's depth, which must be
+				the view's finished depth. Nothing is written.
+		*/
+		void issue();
+
+		/**
+			getStats returns the counts from the last frame.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		// A chunk of an object, and its query.
+		struct Entry
+		{
+			unsigned int query;
+
+			// Its world box as of the frame it was last assigned.
+			glm::vec3 boxMin;
+			glm::vec3 boxMax;
+			unsigned int frame;
+
+			// What its last query said, and whether one is out.
+			bool visible;
+			bool pending;
+
+			// Whether the camera was inside its box.
+			bool inside;
+		};
+
+		// Every chunk's entry, by its object in the high 32 bits and its
+		//	chunk in the low.
+		std::unordered_map<unsigned long long, unsigned int> m_lookup;
+		std::vector<Entry> m_entries;
+
+		// The entries assigned this frame.
+		std::vector<unsigned int> m_frameEntries;
+		unsigned int m_frame;
+
+		// Draws a box from gl_VertexID alone, with an empty vertex array.
+		aie::ShaderProgram m_boxShader;
+		unsigned int m_vao;
+
+		float m_minimumSize;
+
+		Stats m_stats;
+	};
+}
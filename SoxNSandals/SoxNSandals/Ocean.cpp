@@ -0,0 +1,399 @@
+/**
+	Ocean.cpp
+
+	Purpose: Ocean.cpp is the source file for the Ocean class. The Ocean
+			draws the sea around the scene, its waves worked out each
+			frame by fast Fourier transforms in compute shaders and drawn
+			on a grid tessellated around the camera.
+
+	@author Nathan Nette
+*/
+#include "Ocean.h"
+#include "GpuMemory.h"
+#include "Random.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace sns
+{
+	// The units the shaders read the displacements and slopes from.
+	static const unsigned int DISPLACEMENT_UNIT = 0;
+	static const unsigned int SLOPE_UNIT = 1;
+
+	// Must match local_size in the spectrum and resolve shaders.
+	static const unsigned int TILE_SIZE = 16;
+
+	// The FFT's directions, along each row then down each column.
+	static const int FFT_ROWS = 0;
+	static const int FFT_COLUMNS = 1;
+
+	static const float GRAVITY = 9.81f;
+
+	// How many seconds the sea takes to come back to how it started,
+	//	each wave's speed rounded to a whole number of turns in it.
+	static const float REPEAT_TIME = 600.0f;
+	static const float PI = 3.14159265f;
+
+	// The Phillips spectrum's constant at an amplitude of 1, a sea of
+	//	waves about a metre high in a 10 metre a second wind.
+	static const float PHILLIPS_CONSTANT = 0.0008f;
+
+	// Each cascade keeps the waves longer than this many of the next
+	//	one's texels, so the next one has enough to draw the rest.
+	static const float CASCADE_OVERLAP = 6.0f;
+
+	/**
+		loadCompute loads and links a compute shader.
+
+			@param1 a_shader is the program.
+
+			@param2 a_path is the shader's file.
+
+			@return false if it didn't link.
+	*/
+	static bool loadCompute(aie::ShaderProgram& a_shader, const char* a_path)
+	{
+		if (a_shader.getHandle() != 0)
+			return true;
+
+		a_shader.loadShader(aie::eShaderStage::COMPUTE, a_path);
+		if (a_shader.link() == false)
+		{
+			printf("Shader Error: %s\n", a_shader.getLastError());
+			return false;
+		}
+		return true;
+	}
+
+	Ocean::Ocean()
+		: m_ocean(),
+		m_levelCount(0),
+		m_reach(0),
+		m_time(0),
+		m_triangleSize(16.0f)
+	{
+	}
+
+	/**
+		create loads the shaders, makes the textures and fills each
+			cascade's spectrum from the seed.
+
+			@param1 a_ocean is the scene's ocean.
+
+			@return false without GL 4.5 or the shaders, it is left
+					uncreated.
+	*/
+	bool Ocean::create(const SceneDescription::Ocean& a_ocean)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("Ocean: transforming the waves needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_shader.getHandle() == 0)
+		{
+			m_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/ocean.vert");
+			m_shader.loadShader(aie::eShaderStage::TESSELLATION_CONTROL, "../shaders/ocean.tesc");
+			m_shader.loadShader(aie::eShaderStage::TESSELLATION_EVALUATION, "../shaders/ocean.tese");
+			m_shader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/ocean.frag");
+			if (m_shader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_shader.getLastError());
+				return false;
+			}
+		}
+		if (loadCompute(m_spectrumShader, "../shaders/oceanSpectrum.comp") == false ||
+			loadCompute(m_fftShader, "../shaders/oceanFFT.comp") == false ||
+			loadCompute(m_resolveShader, "../shaders/oceanResolve.comp") == false)
+			return false;
+		if (m_downsampler.isCreated() == false)
+			m_downsampler.create(GL_RGBA16F, MipDownsampler::AVERAGE, true);
+
+		m_ocean = a_ocean;
+		m_ocean.patches = std::max(m_ocean.patches, 1u);
+		m_time = 0;
+
+		// The displacements and slopes are filtered with mips, so the
+		//	ripples fade out into the distance rather than shimmer.
+		unsigned int resolution = m_ocean.resolution;
+		m_levelCount = 1;
+		while ((resolution >> m_levelCount) != 0)
+			++m_levelCount;
+
+		GpuMemory& memory = GpuMemory::instance();
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, m_spectrum.put());
+		glTextureStorage3D(m_spectrum, 1, GL_RGBA32F, resolution, resolution, CASCADE_COUNT);
+		memory.trackTexture(m_spectrum, GpuMemory::getTextureBytes(GL_RGBA32F, resolution, resolution, CASCADE_COUNT),
+			GpuMemory::TEXTURES, "Ocean");
+
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, m_fourier.put());
+		glTextureStorage3D(m_fourier, 1, GL_RGBA32F, resolution, resolution, CASCADE_COUNT * 2);
+		memory.trackTexture(m_fourier, GpuMemory::getTextureBytes(GL_RGBA32F, resolution, resolution, CASCADE_COUNT * 2),
+			GpuMemory::TEXTURES, "Ocean");
+
+		TextureHandle* maps[2] = { &m_displacement, &m_slopes };
+		for (TextureHandle* map : maps)
+		{
+			glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, map->put());
+			glTextureStorage3D(*map, m_levelCount, GL_RGBA16F, resolution, resolution, CASCADE_COUNT);
+			glTextureParameteri(*map, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTextureParameteri(*map, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(*map, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTextureParameteri(*map, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			memory.trackTexture(*map, GpuMemory::getTextureBytes(GL_RGBA16F, resolution, resolution, CASCADE_COUNT,
+				m_levelCount), GpuMemory::TEXTURES, "Ocean");
+		}
+
+		createSpectrum();
+		glCreateVertexArrays(1, m_vao.put());
+		return true;
+	}
+
+	/**
+		destroy deletes the textures and vertex array.
+	*/
+	void Ocean::destroy()
+	{
+		m_vao.reset();
+		m_slopes.reset();
+		m_displacement.reset();
+		m_fourier.reset();
+		m_spectrum.reset();
+		m_levelCount = 0;
+	}
+
+	/**
+		update moves the waves on and transforms them into the
+			displacements and slopes draw reads. Each cascade's waves at
+			this time are two layers of the fourier texture, every
+			field the drawing reads packed two to a complex number, as
+			each one's transform is real. Each FFT is one dispatch, a
+			group a row of every layer, then a group a column.
+
+			@param1 a_deltaTime is the time since the last update.
+	*/
+	void Ocean::update(float a_deltaTime)
+	{
+		static constexpr aie::UniformHandle TIME("Time");
+		static constexpr aie::UniformHandle REPEAT("RepeatTime");
+		static constexpr aie::UniformHandle SIZES("Sizes");
+		static constexpr aie::UniformHandle RESOLUTION("Resolution");
+		static constexpr aie::UniformHandle DIRECTION("Direction");
+		static constexpr aie::UniformHandle CHOPPINESS("Choppiness");
+
+		if (isCreated() == false)
+			return;
+
+		// The time wraps before a float is too coarse to move the
+		//	shortest waves smoothly, where every wave is back where it
+		//	started.
+		m_time = fmodf(m_time + a_deltaTime, REPEAT_TIME);
+
+		int resolution = (int)m_ocean.resolution;
+		unsigned int tiles = m_ocean.resolution / TILE_SIZE;
+
+		m_spectrumShader.bind();
+		m_spectrumShader.bindUniform(TIME, m_time);
+		m_spectrumShader.bindUniform(REPEAT, REPEAT_TIME);
+		m_spectrumShader.bindUniform(SIZES, m_ocean.cascadeSizes);
+		m_spectrumShader.bindUniform(RESOLUTION, resolution);
+		glBindImageTexture(0, m_spectrum, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA32F);
+		glBindImageTexture(1, m_fourier, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		glDispatchCompute(tiles, tiles, CASCADE_COUNT);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		m_fftShader.bind();
+		m_fftShader.bindUniform(RESOLUTION, resolution);
+		glBindImageTexture(0, m_fourier, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA32F);
+		int directions[2] = { FFT_ROWS, FFT_COLUMNS };
+		for (int direction : directions)
+		{
+			m_fftShader.bindUniform(DIRECTION, direction);
+			glDispatchCompute(m_ocean.resolution, 1, CASCADE_COUNT * 2);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+
+		m_resolveShader.bind();
+		m_resolveShader.bindUniform(RESOLUTION, resolution);
+		m_resolveShader.bindUniform(CHOPPINESS, m_ocean.choppiness);
+		glBindImageTexture(0, m_fourier, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA32F);
+		glBindImageTexture(1, m_displacement, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glBindImageTexture(2, m_slopes, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glDispatchCompute(tiles, tiles, CASCADE_COUNT);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+		if (m_downsampler.isCreated())
+		{
+			m_downsampler.downsample(m_displacement, resolution, resolution, m_levelCount, CASCADE_COUNT);
+			m_downsampler.downsample(m_slopes, resolution, resolution, m_levelCount, CASCADE_COUNT);
+		}
+		else
+		{
+			glGenerateTextureMipmap(m_displacement);
+			glGenerateTextureMipmap(m_slopes);
+		}
+	}
+
+	/**
+		draw draws the sea around the camera with its shader, which must
+			already be bound. The grid moves a whole patch at a time,
+			so the vertices don't slide over the waves as the camera
+			moves.
+
+			@param1 a_cameraPosition is where the grid is centred.
+
+			@param2 a_viewportHeight is the height of the viewport in
+					pixels, how large the triangles are is measured
+					against.
+	*/
+	void Ocean::draw(const glm::vec3& a_cameraPosition, int a_viewportHeight)
+	{
+		static constexpr aie::UniformHandle DISPLACEMENT("Displacement");
+		static constexpr aie::UniformHandle SLOPES("Slopes");
+		static constexpr aie::UniformHandle ORIGIN("Origin");
+		static constexpr aie::UniformHandle GRID_SIZE("GridSize");
+		static constexpr aie::UniformHandle SEA_LEVEL("SeaLevel");
+		static constexpr aie::UniformHandle REACH("Reach");
+		static constexpr aie::UniformHandle UNITS_PER_METRE("UnitsPerMetre");
+		static constexpr aie::UniformHandle SIZES("Sizes");
+		static constexpr aie::UniformHandle TEXEL_COUNT("TexelCount");
+		static constexpr aie::UniformHandle PATCHES("Patches");
+		static constexpr aie::UniformHandle VIEWPORT_HEIGHT("ViewportHeight");
+		static constexpr aie::UniformHandle TRIANGLE_SIZE("TriangleSize");
+
+		if (isCreated() == false)
+			return;
+
+		float gridSize = m_ocean.extent * 2.0f;
+		float patchSize = gridSize / m_ocean.patches;
+		glm::vec2 centre = glm::floor(glm::vec2(a_cameraPosition.x, a_cameraPosition.z) / patchSize) * patchSize;
+
+		// Array textures, which the render state doesn't cache.
+		glBindTextureUnit(DISPLACEMENT_UNIT, m_displacement);
+		glBindTextureUnit(SLOPE_UNIT, m_slopes);
+		m_shader.bindUniform(DISPLACEMENT, (int)DISPLACEMENT_UNIT);
+		m_shader.bindUniform(SLOPES, (int)SLOPE_UNIT);
+		m_shader.bindUniform(ORIGIN, centre - glm::vec2(m_ocean.extent));
+		m_shader.bindUniform(GRID_SIZE, gridSize);
+		m_shader.bindUniform(SEA_LEVEL, m_ocean.height);
+		m_shader.bindUniform(REACH, m_reach * m_ocean.unitsPerMetre);
+		m_shader.bindUniform(UNITS_PER_METRE, m_ocean.unitsPerMetre);
+		m_shader.bindUniform(SIZES, m_ocean.cascadeSizes);
+		m_shader.bindUniform(TEXEL_COUNT, (float)m_ocean.resolution);
+		m_shader.bindUniform(PATCHES, (int)m_ocean.patches);
+		m_shader.bindUniform(VIEWPORT_HEIGHT, (float)std::max(a_viewportHeight, 1));
+		m_shader.bindUniform(TRIANGLE_SIZE, m_triangleSize);
+
+		// Four corners a patch, every patch in one draw.
+		RenderState& state = RenderState::instance();
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glPatchParameteri(GL_PATCH_VERTICES, 4);
+		glDrawArrays(GL_PATCHES, 0, m_ocean.patches * m_ocean.patches * 4);
+	}
+
+	/**
+		setTriangleSize sets how many pixels long the edges of the
+			triangles should be.
+
+			@param1 a_pixels is the length, at least 1.
+	*/
+	void Ocean::setTriangleSize(float a_pixels)
+	{
+		m_triangleSize = std::max(a_pixels, 1.0f);
+	}
+
+	/**
+		createSpectrum fills each cascade's starting waves from the
+			Phillips spectrum, each wave a random complex amplitude, as
+			h0 of the wave and the conjugate of h0 of the one going the
+			other way, which the spectrum shader moves on in opposite
+			directions. The waves are scaled by the spacing between
+			them, so a cascade's share of the sea is the same however
+			large its tile is.
+
+			The waves run from the lowest frequency, in the middle of
+			each layer, outwards, and each cascade only keeps the band
+			the next one is too coarse to hold. How far the waves reach
+			is three times their deviation, which the tallest rarely
+			get past.
+	*/
+	void Ocean::createSpectrum()
+	{
+		unsigned int resolution = m_ocean.resolution;
+		unsigned int half = resolution / 2;
+		float windSpeed = std::max(glm::length(m_ocean.wind), 0.01f);
+		glm::vec2 windDirection = m_ocean.wind / windSpeed;
+
+		// The longest wave the wind raises, and the shortest kept, which
+		//	would otherwise alias.
+		float longest = windSpeed * windSpeed / GRAVITY;
+		float shortest = longest / 1000.0f;
+		float constant = PHILLIPS_CONSTANT * std::max(m_ocean.amplitude, 0.0f);
+
+		Random random(m_ocean.seed);
+		std::vector<glm::vec2> waves(resolution * resolution);
+		std::vector<glm::vec4> spectrum(resolution * resolution * CASCADE_COUNT);
+		double variance = 0.0;
+		for (unsigned int c = 0; c < CASCADE_COUNT; ++c)
+		{
+			float size = std::max(m_ocean.cascadeSizes[c], 0.01f);
+			float spacing = 2.0f * PI / size;
+			float lowest = c == 0 ? 0.0f : 2.0f * PI / std::max(m_ocean.cascadeSizes[c - 1], 0.01f) * CASCADE_OVERLAP;
+			float highest = c + 1 < CASCADE_COUNT ?
+				2.0f * PI / std::max(m_ocean.cascadeSizes[c + 1], 0.01f) * CASCADE_OVERLAP : 1e30f;
+
+			for (unsigned int y = 0; y < resolution; ++y)
+			{
+				for (unsigned int x = 0; x < resolution; ++x)
+				{
+					glm::vec2 k(((float)x - half) * spacing, ((float)y - half) * spacing);
+					float length = glm::length(k);
+
+					// Box-Muller, two gaussians from two uniforms, drawn
+					//	for every wave so the seed always picks the same.
+					float radius = std::sqrt(-2.0f * std::log(std::max(random.nextFloat(), 1e-7f)));
+					float angle = 2.0f * PI * random.nextFloat();
+					glm::vec2 gaussian(radius * std::cos(angle), radius * std::sin(angle));
+
+					float phillips = 0.0f;
+					if (length >= lowest && length < highest && length > 0.0f)
+					{
+						float alignment = glm::dot(k / length, windDirection);
+						float kL = length * longest;
+						phillips = constant * std::exp(-1.0f / (kL * kL)) / (length * length * length * length) *
+							alignment * alignment * std::exp(-length * length * shortest * shortest);
+					}
+					waves[y * resolution + x] = gaussian * std::sqrt(phillips * 0.5f) * spacing;
+				}
+			}
+
+			// Each wave beside the one going the other way, which is
+			//	across the middle, the first row and column wrapping
+			//	onto themselves.
+			glm::vec4* layer = spectrum.data() + c * resolution * resolution;
+			for (unsigned int y = 0; y < resolution; ++y)
+			{
+				for (unsigned int x = 0; x < resolution; ++x)
+				{
+					glm::vec2 wave = waves[y * resolution + x];
+					glm::vec2 opposite = waves[((resolution - y) % resolution) * resolution + (resolution - x) % resolution];
+					layer[y * resolution + x] = glm::vec4(wave, opposite.x, -opposite.y);
+					variance += 2.0 * glm::dot(wave, wave);
+				}
+			}
+		}
+
+		glTextureSubImage3D(m_spectrum, 0, 0, 0, 0, resolution, resolution, CASCADE_COUNT, GL_RGBA, GL_FLOAT,
+			spectrum.data());
+
+		float deviation = (float)std::sqrt(variance);
+		m_reach = glm::vec2(deviation * 3.0f, deviation * 3.0f * std::max(m_ocean.choppiness, 0.0f));
+	}
+}
@@ -0,0 +1,157 @@
+/**
+	Ocean.h
+
+	Purpose: Ocean.h is the header file for the Ocean class. The Ocean
+			draws the sea around the scene, its waves worked out each
+			frame by fast Fourier transforms in compute shaders and drawn
+			on a grid tessellated around the camera.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "MipDownsampler.h"
+#include "SceneDescription.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+
+namespace sns
+{
+	/**
+		The Ocean class makes Tessendorf's waves: a Phillips spectrum of
+			random waves, each moving at the speed deep water carries
+			it, summed back into heights by an inverse FFT every frame.
+
+		Each cascade is a tile of its own size, repeating across the sea,
+			and holds only the waves between the next cascade's longest
+			and its own shortest, so together they cover swell to
+			ripples without a wave being counted twice or the tiles
+			repeating where the camera can see it. The FFTs give every
+			texel of each tile its sideways and upward displacement,
+			its slopes and how the choppy waves squeeze the surface,
+			which is where the foam goes.
+
+		The sea is a grid of patches following the camera, drawn as the
+			Terrain is, with each patch's edges cut by how long they are
+			on screen and culled with the highest the waves reach. The
+			tessellation evaluation shader moves each vertex by every
+			cascade, and the fragment shader takes its normal and foam
+			from them, so the detail the vertices miss still shades.
+
+		The textures are made with GL 4.5 and the compute shaders need
+			GL 4.3, without them create fails and there is no ocean.
+	*/
+	class Ocean
+	{
+	public:
+		// How many tiles of waves are added together.
+		static const unsigned int CASCADE_COUNT = 3;
+
+		Ocean();
+
+		Ocean(const Ocean&) = delete;
+		Ocean& operator=(const Ocean&) = delete;
+
+		/**
+			create loads the shaders, makes the textures and fills each
+				cascade's spectrum from the seed.
+
+				@param1 a_ocean is the scene's ocean.
+
+				@return false without GL 4.5 or the shaders, it is left
+						uncreated.
+		*/
+		bool create(const SceneDescription::Ocean& a_ocean);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_spectrum != 0; }
+
+		/**
+			destroy deletes the textures and vertex array.
+		*/
+		void destroy();
+
+		/**
+			update moves the waves on and transforms them into the
+				displacements and slopes draw reads.
+
+				@param1 a_deltaTime is the time since the last update.
+		*/
+		void update(float a_deltaTime);
+
+		/**
+			getShader returns the ocean's program, to bind the frame's
+				lighting to before draw.
+		*/
+		aie::ShaderProgram& getShader() { return m_shader; }
+
+		/**
+			draw draws the sea around the camera with its shader, which
+				must already be bound.
+
+				@param1 a_cameraPosition is where the grid is centred.
+
+				@param2 a_viewportHeight is the height of the viewport in
+						pixels, how large the triangles are is measured
+						against.
+		*/
+		void draw(const glm::vec3& a_cameraPosition, int a_viewportHeight);
+
+		/**
+			setTriangleSize sets how many pixels long the edges of the
+				triangles should be.
+
+				@param1 a_pixels is the length, at least 1.
+		*/
+		void setTriangleSize(float a_pixels);
+
+		/**
+			getTriangleSize returns how many pixels long the edges of the
+				triangles should be.
+		*/
+		float getTriangleSize() const { return m_triangleSize; }
+
+	private:
+		/**
+			createSpectrum fills each cascade's starting waves, and
+				works out how far the waves can reach.
+		*/
+		void createSpectrum();
+
+		aie::ShaderProgram m_shader;
+		aie::ShaderProgram m_spectrumShader;
+		aie::ShaderProgram m_fftShader;
+		aie::ShaderProgram m_resolveShader;
+
+		// Averages the maps' mips every frame, or glGenerateTextureMipmap
+		//	does without it.
+		MipDownsampler m_downsampler;
+		SceneDescription::Ocean m_ocean;
+
+		// Each cascade's waves at time 0, a layer each.
+		TextureHandle m_spectrum;
+
+		// The waves at this time, two layers a cascade, the FFTs turn
+		//	in place.
+		TextureHandle m_fourier;
+
+		// What draw reads, a layer a cascade with mips: the sideways and
+		//	upward displacement and how much x moves along z, then the
+		//	slopes and how much x and z stretch along themselves.
+		TextureHandle m_displacement;
+		TextureHandle m_slopes;
+
+		VertexArrayHandle m_vao;
+
+		unsigned int m_levelCount;
+
+		// The highest the waves reach above and below the sea, and how
+		//	far sideways, in metres.
+		glm::vec2 m_reach;
+
+		float m_time;
+		float m_triangleSize;
+	};
+}
@@ -0,0 +1,173 @@
+/**
+	ParticleBenchmark.cpp
+
+	Purpose: ParticleBenchmark.cpp is the source file for the ParticleBenchmark
+			class. The ParticleBenchmark times the old array of structs
+			particle update against the ParticlePool, without needing a
+			window or GL context.
+
+	@author Nathan Nette
+*/
+#include "ParticleBenchmark.h"
+#include "ParticlePool.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+	// The particle as ParticleEmitter stored it before the ParticlePool.
+	struct LegacyParticle
+	{
+		glm::vec3 position;
+		glm::vec3 velocity;
+		glm::vec4 colour;
+		float size;
+		float lifetime;
+		float lifespan;
+	};
+
+	// The vertex the old update wrote 4 of for every particle.
+	struct LegacyVertex
+	{
+		glm::vec4 position;
+		glm::vec4 colour;
+	};
+
+	// The settings both paths are updated with.
+	const float START_SIZE = 1.0f;
+	const float END_SIZE = 0.1f;
+	const glm::vec4 START_COLOUR(1, 0, 0, 1);
+	const glm::vec4 END_COLOUR(1, 1, 0, 1);
+	const float DELTA_TIME = 1.0f / 60.0f;
+
+	/**
+		legacyUpdate is ParticleEmitter::update as it was before the
+			ParticlePool, minus emitting.
+
+			@return the amount of live particles left.
+	*/
+	unsigned int legacyUpdate(LegacyParticle* a_particles, unsigned int a_count,
+		LegacyVertex* a_vertices, const glm::mat4& a_cameraTransform)
+	{
+		using glm::vec4;
+		unsigned int quad = 0;
+
+		for (unsigned int i = 0; i < a_count; i++)
+		{
+			LegacyParticle* particle = &a_particles[i];
+			particle->lifetime += DELTA_TIME;
+
+			if (particle->lifetime >= particle->lifespan) {
+				*particle = a_particles[a_count - 1];
+				a_count--;
+			}
+			else {
+				particle->position += particle->velocity * DELTA_TIME;
+				particle->size = glm::mix(START_SIZE, END_SIZE,
+					particle->lifetime / particle->lifespan);
+				particle->colour = glm::mix(START_COLOUR, END_COLOUR,
+					particle->lifetime / particle->lifespan);
+
+				float halfSize = particle->size * 0.5f;
+				LegacyVertex* vertex = &a_vertices[quad * 4];
+				vertex[0].position = vec4(halfSize, halfSize, 0, 1);
+				vertex[1].position = vec4(-halfSize, halfSize, 0, 1);
+				vertex[2].position = vec4(-halfSize, -halfSize, 0, 1);
+				vertex[3].position = vec4(halfSize, -halfSize, 0, 1);
+
+				glm::vec3 zAxis = glm::normalize(glm::vec3(a_cameraTransform[3]) - particle->position);
+				glm::vec3 xAxis = glm::cross(glm::vec3(a_cameraTransform[1]), zAxis);
+				glm::vec3 yAxis = glm::cross(zAxis, xAxis);
+				glm::mat4 billboard(vec4(xAxis, 0), vec4(yAxis, 0),
+					vec4(zAxis, 0), vec4(0, 0, 0, 1));
+				for (int c = 0; c < 4; ++c)
+				{
+					vertex[c].position = billboard * vertex[c].position +
+						vec4(particle->position, 0);
+					vertex[c].colour = particle->colour;
+				}
+				++quad;
+			}
+		}
+
+		return a_count;
+	}
+
+	// Returns a random float between a_min and a_max.
+	float randomRange(float a_min, float a_max)
+	{
+		return (rand() / (float)RAND_MAX) * (a_max - a_min) + a_min;
+	}
+}
+
+namespace sns
+{
+	/**
+		run spawns the same particles into both paths, updates them
+			for a number of frames and prints the time each path took.
+
+			@param1 a_particleCount is how many particles to spawn.
+
+			@param2 a_frameCount is how many updates to time.
+	*/
+	void ParticleBenchmark::run(unsigned int a_particleCount, unsigned int a_frameCount)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+
+		// Lifespans are spread around the length of the run, so both
+		//	paths have to kill particles as they go.
+		float runTime = a_frameCount * DELTA_TIME;
+		std::vector<LegacyParticle> legacy(a_particleCount);
+		ParticlePool pool;
+		pool.resize(a_particleCount);
+
+		srand(1);
+		for (auto& particle : legacy)
+		{
+			glm::vec3 direction(randomRange(-1, 1), randomRange(-1, 1), randomRange(-1, 1));
+			particle.position = glm::vec3(0);
+			particle.velocity = glm::normalize(direction) * randomRange(1, 5);
+			particle.colour = START_COLOUR;
+			particle.size = START_SIZE;
+			particle.lifetime = 0;
+			particle.lifespan = randomRange(runTime * 0.5f, runTime * 2.0f);
+			pool.add(particle.position, particle.velocity, particle.lifespan);
+		}
+
+		std::vector<LegacyVertex> vertices(a_particleCount * 4);
+		std::vector<ParticlePool::Instance> instances(a_particleCount);
+		glm::mat4 cameraTransform = glm::inverse(glm::lookAt(glm::vec3(10, 10, 10),
+			glm::vec3(0), glm::vec3(0, 1, 0)));
+
+		unsigned int legacyCount = a_particleCount;
+		Clock::time_point start = Clock::now();
+		for (unsigned int frame = 0; frame < a_frameCount; ++frame)
+			legacyCount = legacyUpdate(legacy.data(), legacyCount, vertices.data(), cameraTransform);
+		double legacyTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		for (unsigned int frame = 0; frame < a_frameCount; ++frame)
+		{
+			pool.integrate(DELTA_TIME);
+			pool.kill();
+			pool.interpolate(START_SIZE, END_SIZE, START_COLOUR, END_COLOUR);
+			pool.writeInstances(instances.data());
+		}
+		double poolTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		printf("Particle update, %u particles over %u frames\n", a_particleCount, a_frameCount);
+		printf("  array of structs:  %8.3f ms/frame, %u alive\n", legacyTime / a_frameCount, legacyCount);
+		printf("  particle pool:     %8.3f ms/frame, %u alive\n", poolTime / a_frameCount, pool.getCount());
+		printf("  speed up:          %8.2fx\n", poolTime > 0 ? legacyTime / poolTime : 0.0);
+		printf("  upload per frame:  %8.2f MB vs %.2f MB\n",
+			legacyCount * 4 * sizeof(LegacyVertex) / (1024.0 * 1024.0),
+			pool.getCount() * sizeof(ParticlePool::Instance) / (1024.0 * 1024.0));
+
+		// The old loop skipped the particle it swapped into a dead slot, so
+		//	that particle aged a frame late and a few more end up alive.
+	}
+}
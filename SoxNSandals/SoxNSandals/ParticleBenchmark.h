@@ -0,0 +1,31 @@
+/**
+	ParticleBenchmark.h
+
+	Purpose: ParticleBenchmark.h is the header file for the ParticleBenchmark
+			class. The ParticleBenchmark times the old array of structs
+			particle update against the ParticlePool, without needing a
+			window or GL context.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+namespace sns
+{
+	/**
+		The ParticleBenchmark class runs both particle updates side by side.
+	*/
+	class ParticleBenchmark
+	{
+	public:
+		/**
+			run spawns the same particles into both paths, updates them
+				for a number of frames and prints the time each path took.
+
+				@param1 a_particleCount is how many particles to spawn.
+
+				@param2 a_frameCount is how many updates to time.
+		*/
+		static void run(unsigned int a_particleCount, unsigned int a_frameCount);
+	};
+}
@@ -8,18 +8,54 @@
 	@author Nathan Nette
 */
 #include "ParticleEmitter.h"
+#include "RadixSort.h"
+#include "RenderState.h"
+#include "SurfaceSampler.h"
+#include "Trace.h"
+#include "VertexArrays.h"
+#include "VertexLayout.h"
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_EMITTER_SSE
+#include <xmmintrin.h>
+#endif
+
+// Position and size, then colour, read once per particle.
+static constexpr sns::VertexLayout INSTANCE_LAYOUT = sns::makeVertexLayout<ParticleEmitter::ParticleInstance>(
+	SNS_VERTEX_ATTRIBUTE(ParticleEmitter::ParticleInstance, positionSize, 0, FLOAT4),
+	SNS_VERTEX_ATTRIBUTE(ParticleEmitter::ParticleInstance, colour, 1, FLOAT4));
+static_assert(sns::isValidLayout(INSTANCE_LAYOUT), "ParticleInstance layout is invalid");
+
+/**
+	instanceVertexFormat sets up the vertex array every emitter
+		shares, reading one instance per particle.
+
+		@param1 a_vao is the vertex array.
+*/
+static void instanceVertexFormat(unsigned int a_vao)
+{
+	unsigned int binding = sns::VertexArrays::VERTEX_BINDING;
+	glVertexArrayBindingDivisor(a_vao, binding, 1);
+	sns::setVertexArrayFormat(a_vao, binding, INSTANCE_LAYOUT);
+}
 
 /**
 	The Particle Emitter constructor assigns the values to 0
 		as default.
 */
 ParticleEmitter::ParticleEmitter()
-	: m_particles(nullptr),
-	m_firstDead(0),
-	m_maxParticles(0),
+	: m_maxParticles(0),
+	m_firstInstance(0),
 	m_position(0, 0, 0),
-	m_vao(0), m_vbo(0), m_ibo(0),
-	m_vertexData(nullptr)
+	m_surfaceTransform(1),
+	m_surfaceNormals(1),
+	m_seed(0),
+	m_emitScale(1),
+	m_liveLimit(0),
+	m_sortPosition(0),
+	m_sortBudget(0),
+	m_forceTime(0)
 {
 }
 
@@ -29,11 +65,6 @@ ParticleEmitter::ParticleEmitter()
 */
 ParticleEmitter::~ParticleEmitter()
 {
-	delete[] m_particles;
-	delete[] m_vertexData;
-	glDeleteVertexArrays(1, &m_vao);
-	glDeleteBuffers(1, &m_vbo);
-	glDeleteBuffers(1, &m_ibo);
 }
 
 /**
@@ -60,17 +91,24 @@ ParticleEmitter::~ParticleEmitter()
 		@param9 a_startColour is the colour of the particle when they spawn.
 
 		@param10 a_endColour is the colour of the particle when they end.
+
+		@param11 a_seed picks the random numbers the particles spawn
+			with, the same seed always spawns the same particles.
 */
 void ParticleEmitter::initialise(unsigned int a_maxParticles,
 	unsigned int a_emitRate,
 	float a_lifetimeMin, float a_lifetimeMax,
 	float a_velocityMin, float a_velocityMax,
 	float a_startSize, float a_endSize,
-	const glm::vec4& a_startColour, const glm::vec4& a_endColour)
+	const glm::vec4& a_startColour, const glm::vec4& a_endColour,
+	unsigned int a_seed)
 {
+	m_seed = a_seed;
+	m_random.seed(a_seed);
 
 	// Set up emit timers.
 	m_emitTimer = 0;
+	m_forceTime = 0;
 	m_emitRate = 1.0f / a_emitRate;
 	// Store all variables passed in.
 	m_startColour = a_startColour;
@@ -82,164 +120,400 @@ void ParticleEmitter::initialise(unsigned int a_maxParticles,
 	m_lifespanMin = a_lifetimeMin;
 	m_lifespanMax = a_lifetimeMax;
 	m_maxParticles = a_maxParticles;
+	m_emitScale = 1;
+	m_liveLimit = a_maxParticles;
 
-	// Create particle array.
-	m_particles = new Particle[m_maxParticles];
-	m_firstDead = 0;
-
-	// Create the array of vertices for the particles:
-	// 4 vertices per particle for a quad
-	// fill be filled during update.
-	m_vertexData = new ParticleVertex[m_maxParticles * 4];
-
-	// Create the index buffer data for the particles:
-	// 6 indices per quad of 2 triangles
-	// fill it now as it never changes.
-	unsigned int* indexData = new unsigned int[m_maxParticles * 6];
-	for (unsigned int i = 0; i < m_maxParticles; ++i) {
-		indexData[i * 6 + 0] = i * 4 + 0;
-		indexData[i * 6 + 1] = i * 4 + 1;
-		indexData[i * 6 + 2] = i * 4 + 2;
-		indexData[i * 6 + 3] = i * 4 + 0;
-		indexData[i * 6 + 4] = i * 4 + 2;
-		indexData[i * 6 + 5] = i * 4 + 3;
-	}
-	// Create opengl buffers.
-	glGenVertexArrays(1, &m_vao);
-	glBindVertexArray(m_vao);
-	glGenBuffers(1, &m_vbo);
-	glGenBuffers(1, &m_ibo);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBufferData(GL_ARRAY_BUFFER, m_maxParticles * 4 *
-		sizeof(ParticleVertex), m_vertexData,
-		GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_maxParticles * 6 *
-		sizeof(unsigned int), indexData, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0); // position
-	glEnableVertexAttribArray(1); // colour
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE,
-		sizeof(ParticleVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE,
-		sizeof(ParticleVertex), ((char*)0) + 16);
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	delete[] indexData;
+	// Let the backend create whatever it simulates and draws with.
+	createBuffers();
 }
 
 /**
-	emit is the function to be called to spawn a new particle.
-		it only runs if there is currently less than the maximum
-		amount. This means that when one dies, a new one spawn
-		straight away.
+	createBuffers makes the particle storage and the opengl buffers
+		the particles are drawn from. The instances are filled on the
+		cpu during update.
 */
-void ParticleEmitter::emit()
+void ParticleEmitter::createBuffers()
 {
-	// Only emit if there is a dead particle to use.
-	if (m_firstDead >= m_maxParticles)
-		return;
-	// Resurrect the first dead particle.
-	Particle& particle = m_particles[m_firstDead++];
-	// Assign its starting position.
-	particle.position = m_position;
-	// Randomise its lifespan.
-	particle.lifetime = 0;
-	particle.lifespan = (rand() / (float)RAND_MAX) *
-		(m_lifespanMax - m_lifespanMin) + m_lifespanMin;
-	// Set starting size and colour.
-	particle.colour = m_startColour;
-	particle.size = m_startSize;
-	// Randomise velocity direction and strength.
-	float velocity = (rand() / (float)RAND_MAX) *
-		(m_velocityMax - m_velocityMin) + m_velocityMin;
-	particle.velocity.x = (rand() / (float)RAND_MAX) * 2 - 1;
-	particle.velocity.y = (rand() / (float)RAND_MAX) * 2 - 1;
-	particle.velocity.z = (rand() / (float)RAND_MAX) * 2 - 1;
-	particle.velocity = glm::normalize(particle.velocity) *
-		velocity;
+	// Create particle storage.
+	m_particles.resize(m_maxParticles);
+
+	// Create the buffer of instances for the particles:
+	// 1 per particle, the shader turns it into a quad
+	// will be filled during update.
+	m_instanceStream.create(sizeof(ParticleInstance), m_maxParticles, "ParticleEmitter");
+
+	m_vao.reset(createVertexArray(m_instanceStream.getHandle()));
+}
+
+/**
+	createVertexArray makes a vertex array that reads particle
+		instances from a buffer. Each instance is drawn as a
+		4 vertex triangle strip. With GL 4.5 every emitter shares
+		one vertex array instead, and none is made.
+
+		@param1 a_instanceBuffer is the buffer holding the instances.
+
+		@return the new vertex array, or 0 if the shared one is used.
+*/
+unsigned int ParticleEmitter::createVertexArray(unsigned int a_instanceBuffer)
+{
+	// There are no per vertex attributes, the shader picks the corner
+	//	of the quad from gl_VertexID, so there is no index buffer either.
+	if (sns::VertexArrays::isSupported())
+		return 0;
+
+	unsigned int vao = 0;
+	glGenVertexArrays(1, &vao);
+	sns::RenderState::instance().bindVertexArray(vao);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, a_instanceBuffer);
+	sns::setVertexAttributes(INSTANCE_LAYOUT, 0, 1);
+	sns::RenderState::instance().bindVertexArray(0);
+	sns::RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+	return vao;
+}
+
+/**
+	restart kills every particle and starts the random numbers over,
+		so the emitter spawns the same particles as when it was first
+		initialised with the seed.
+
+		@param1 a_seed picks the random numbers the particles spawn with.
+*/
+void ParticleEmitter::restart(unsigned int a_seed)
+{
+	m_seed = a_seed;
+	m_random.seed(a_seed);
+	m_particles.clear();
+	m_emitTimer = 0;
+	m_forceTime = 0;
+}
+
+/**
+	emit is the function to be called to spawn new particles.
+		it only spawns as many as there is room for below the
+		maximum amount. This means that when one dies, a new one
+		spawns straight away.
+
+		@param1 a_count is how many particles to spawn.
+*/
+void ParticleEmitter::emit(unsigned int a_count)
+{
+	// Only emit if there are dead particles to use.
+	unsigned int live = m_particles.getCount();
+	unsigned int room = live < m_liveLimit ? m_liveLimit - live : 0;
+	if (a_count > room)
+		a_count = room;
+
+	// Four particles are spawned at a time, each row holds one of
+	//	the random numbers for all four.
+	enum { LIFESPAN, SPEED, DIRECTION_X, DIRECTION_Y, DIRECTION_Z, RANDOM_COUNT };
+	alignas(16) float random[RANDOM_COUNT][4];
+	alignas(16) float velocity[3][4];
+
+	for (unsigned int first = 0; first < a_count; first += 4)
+	{
+		m_random.fill(&random[0][0], RANDOM_COUNT * 4);
+
+#ifdef SNS_EMITTER_SSE
+		// Randomise lifespan, velocity strength and direction.
+		__m128 lifespan = _mm_add_ps(_mm_set1_ps(m_lifespanMin), _mm_mul_ps(
+			_mm_load_ps(random[LIFESPAN]), _mm_set1_ps(m_lifespanMax - m_lifespanMin)));
+		_mm_store_ps(random[LIFESPAN], lifespan);
+
+		__m128 speed = _mm_add_ps(_mm_set1_ps(m_velocityMin), _mm_mul_ps(
+			_mm_load_ps(random[SPEED]), _mm_set1_ps(m_velocityMax - m_velocityMin)));
+
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		__m128 x = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(random[DIRECTION_X]), two), one);
+		__m128 y = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(random[DIRECTION_Y]), two), one);
+		__m128 z = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(random[DIRECTION_Z]), two), one);
+
+		// Normalise the direction, a direction of 0 just spawns still.
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		lengthSquared = _mm_max_ps(lengthSquared, _mm_set1_ps(1e-12f));
+		__m128 scale = _mm_div_ps(speed, _mm_sqrt_ps(lengthSquared));
+
+		_mm_store_ps(velocity[0], _mm_mul_ps(x, scale));
+		_mm_store_ps(velocity[1], _mm_mul_ps(y, scale));
+		_mm_store_ps(velocity[2], _mm_mul_ps(z, scale));
+#else
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			random[LIFESPAN][i] = m_lifespanMin + random[LIFESPAN][i] * (m_lifespanMax - m_lifespanMin);
+			float speed = m_velocityMin + random[SPEED][i] * (m_velocityMax - m_velocityMin);
+
+			float x = random[DIRECTION_X][i] * 2.0f - 1.0f;
+			float y = random[DIRECTION_Y][i] * 2.0f - 1.0f;
+			float z = random[DIRECTION_Z][i] * 2.0f - 1.0f;
+
+			float lengthSquared = glm::max(x * x + y * y + z * z, 1e-12f);
+			float scale = speed / glm::sqrt(lengthSquared);
+
+			velocity[0][i] = x * scale;
+			velocity[1][i] = y * scale;
+			velocity[2][i] = z * scale;
+		}
+#endif
+
+		// Resurrect dead particles at the emitter's position, or on the
+		//	surface. The surface's random numbers are drawn on their own,
+		//	so emitters without one spawn as they always have.
+		unsigned int batch = glm::min(a_count - first, 4u);
+		if (m_surface == nullptr)
+		{
+			for (unsigned int i = 0; i < batch; ++i)
+			{
+				m_particles.add(m_position,
+					glm::vec3(velocity[0][i], velocity[1][i], velocity[2][i]), random[LIFESPAN][i]);
+			}
+			continue;
+		}
+
+		alignas(16) float surface[4][4];
+		m_random.fill(&surface[0][0], 4 * 4);
+		for (unsigned int i = 0; i < batch; ++i)
+		{
+			sns::SurfaceSampler::Sample sample = m_surface->sample(surface[0][i], surface[1][i], surface[2][i],
+				surface[3][i]);
+			glm::vec3 normal = m_surfaceNormals * sample.normal;
+			glm::vec3 direction(velocity[0][i], velocity[1][i], velocity[2][i]);
+			if (glm::dot(direction, normal) < 0.0f)
+				direction = -direction;
+			m_particles.add(glm::vec3(m_surfaceTransform * glm::vec4(sample.position, 1)), direction,
+				random[LIFESPAN][i]);
+		}
+	}
 }
 
 /**
 	update is called every frame. It does all of the necessary
 		math to move every particle and change their colour.
 		Also checks to see how many exist. If there are less
-		than the maximum, call emit.
+		than the maximum, call emit. The quads are made to face
+		the camera by the particle shader, so the camera isn't
+		needed here.
+
+		@param1 a_deltaTime is the time since the last update.
 */
-void ParticleEmitter::update(float a_deltaTime,
-	const glm::mat4& a_cameraTransform)
+void ParticleEmitter::update(float a_deltaTime)
 {
-	using glm::vec3;
-	using glm::vec4;
+	SNS_TRACE_ZONE("ParticleEmitter::update");
+	simulate(a_deltaTime);
 
-	// Spawn particles.
-	m_emitTimer += a_deltaTime;
+	// Pack the particles straight into this frame's region of the stream.
+	auto instances = (ParticleInstance*)m_instanceStream.beginWrite();
+	unsigned int count = m_sortBudget > 0 && m_particles.getCount() <= m_sortBudget
+		? writeSortedInstances(instances, 0.0f, m_sortPosition)
+		: writeInstances(instances);
+	m_firstInstance = m_instanceStream.endWrite(count);
+}
+
+/**
+	simulate emits, moves, kills and colours the particles without
+		touching opengl, so it can run on a worker thread.
 
+		@param1 a_deltaTime is the time since the last update.
+*/
+void ParticleEmitter::simulate(float a_deltaTime)
+{
+	// Spawn particles, every one due this frame in a single batch.
+	m_emitTimer += a_deltaTime * m_emitScale;
+
+	unsigned int spawnCount = 0;
 	while (m_emitTimer > m_emitRate) {
-		emit();
+		++spawnCount;
 		m_emitTimer -= m_emitRate;
 	}
-	unsigned int quad = 0;
+	emit(spawnCount);
 
-	// Update particles and turn live particles into billboard quads.
-	for (unsigned int i = 0; i < m_firstDead; i++)
+	// Push every particle, age and move it, then remove the ones that died.
+	if (m_forces.isActive())
 	{
-		Particle* particle = &m_particles[i];
-		particle->lifetime += a_deltaTime;
+		m_forceTime += a_deltaTime;
+		m_particles.accelerate(m_forces, a_deltaTime, m_forceTime);
+	}
+	m_particles.integrate(a_deltaTime);
+	m_particles.kill();
 
-		if (particle->lifetime >= particle->lifespan) {
-			// Swap last alive with this one.
-			*particle = m_particles[m_firstDead - 1];
-			m_firstDead--;
-		}
+	// Size and colour the survivors.
+	m_particles.interpolate(m_startSize, m_endSize, m_startColour, m_endColour);
+}
 
-		else {
-			// Move particle.
-			particle->position += particle->velocity * a_deltaTime;
-			// Size particle.
-			particle->size = glm::mix(m_startSize, m_endSize,
-				particle->lifetime / particle->lifespan);
-			// Colour particle.
-			particle->colour = glm::mix(m_startColour, m_endColour,
-				particle->lifetime / particle->lifespan);
-			// Make a quad the correct size and colour.
-			float halfSize = particle->size * 0.5f;
-			m_vertexData[quad * 4 + 0].position = glm::vec4(halfSize,
-				halfSize, 0, 1);
-			m_vertexData[quad * 4 + 0].colour = particle->colour;
-			m_vertexData[quad * 4 + 1].position = glm::vec4(-halfSize,
-				halfSize, 0, 1);
-			m_vertexData[quad * 4 + 1].colour = particle->colour;
-			m_vertexData[quad * 4 + 2].position = glm::vec4(-halfSize,
-				-halfSize, 0, 1);
-			m_vertexData[quad * 4 + 2].colour = particle->colour;
-			m_vertexData[quad * 4 + 3].position = glm::vec4(halfSize,
-				-halfSize, 0, 1);
-			m_vertexData[quad * 4 + 3].colour = particle->colour;
-
-			// Create billboard transform.
-			glm::vec3 zAxis = glm::normalize(glm::vec3(a_cameraTransform[3]) - particle->position);
-			glm::vec3 xAxis = glm::cross(glm::vec3(a_cameraTransform[1]), zAxis);
-			glm::vec3 yAxis = glm::cross(zAxis, xAxis);
-			glm::mat4 billboard(vec4(xAxis, 0),
-				glm::vec4(yAxis, 0),
-				glm::vec4(zAxis, 0),
-				glm::vec4(0, 0, 0, 1));
-			m_vertexData[quad * 4 + 0].position = billboard *
-				m_vertexData[quad * 4 + 0].position +
-				glm::vec4(particle->position, 0);
-			m_vertexData[quad * 4 + 1].position = billboard *
-				m_vertexData[quad * 4 + 1].position +
-				glm::vec4(particle->position, 0);
-			m_vertexData[quad * 4 + 2].position = billboard *
-				m_vertexData[quad * 4 + 2].position +
-				glm::vec4(particle->position, 0);
-			m_vertexData[quad * 4 + 3].position = billboard *
-				m_vertexData[quad * 4 + 3].position +
-				glm::vec4(particle->position, 0);
-			++quad;
-		}
+/**
+	prewarm fast-forwards the emitter, in large steps at full detail,
+		so it looks as if it has been running a while. The steps are
+		all the same length, the duration split evenly between them.
+		The detail is put back after, for the next frame to set.
+
+		@param1 a_duration is how long to run it for.
+
+		@param2 a_timeStep is the longest step to take.
+*/
+void ParticleEmitter::prewarm(float a_duration, float a_timeStep)
+{
+	if (a_duration <= 0.0f || a_timeStep <= 0.0f)
+		return;
+
+	float emitScale = m_emitScale;
+	unsigned int liveLimit = m_liveLimit;
+	setDetail(1, m_maxParticles);
+
+	unsigned int stepCount = (unsigned int)glm::ceil(a_duration / a_timeStep);
+	float timeStep = a_duration / stepCount;
+	for (unsigned int step = 0; step < stepCount; ++step)
+		simulate(timeStep);
+
+	setDetail(emitScale, liveLimit);
+}
+
+/**
+	setSurface makes new particles spawn spread evenly over a mesh's
+		surface instead of at the position. Particles already alive
+		are left where they are.
+
+		@param1 a_surface is the surface, or nullptr to spawn at the
+				position again.
+
+		@param2 a_transform takes the surface into world space.
+*/
+void ParticleEmitter::setSurface(std::shared_ptr<const sns::SurfaceSampler> a_surface, const glm::mat4& a_transform)
+{
+	m_surface = a_surface != nullptr && a_surface->getTriangleCount() > 0 ? std::move(a_surface) : nullptr;
+	m_surfaceTransform = a_transform;
+	m_surfaceNormals = glm::transpose(glm::inverse(glm::mat3(a_transform)));
+}
+
+/**
+	setDetail scales the emitter down, for emitters that are far
+		away or over a particle budget. Particles already alive
+		over the new limit live out their lifespan.
+
+		@param1 a_emitScale multiplies the emit rate, 0 stops
+				emitting.
+
+		@param2 a_liveLimit is the most particles alive at once,
+				up to getMaxParticles.
+*/
+void ParticleEmitter::setDetail(float a_emitScale, unsigned int a_liveLimit)
+{
+	m_emitScale = a_emitScale;
+	m_liveLimit = a_liveLimit < m_maxParticles ? a_liveLimit : m_maxParticles;
+}
+
+/**
+	getBounds returns a sphere no particle can leave, from the
+		fastest particle living the longest, pushed the whole
+		time by the most the forces can push it, from anywhere
+		on the surface when there is one.
+
+		@param1 a_centre receives the centre of the sphere.
+
+		@param2 a_radius receives the radius of the sphere.
+*/
+void ParticleEmitter::getBounds(glm::vec3& a_centre, float& a_radius) const
+{
+	float size = m_startSize > m_endSize ? m_startSize : m_endSize;
+	a_centre = m_position;
+	a_radius = m_velocityMax * m_lifespanMax + size * 0.5f;
+
+	// Spawning anywhere on the surface, from the centre of its box out
+	//	to its corners, however the transform turns and scales it.
+	if (m_surface != nullptr)
+	{
+		glm::vec3 halfSize = (m_surface->getMax() - m_surface->getMin()) * 0.5f;
+		float scale = glm::max(glm::length(glm::vec3(m_surfaceTransform[0])),
+			glm::max(glm::length(glm::vec3(m_surfaceTransform[1])), glm::length(glm::vec3(m_surfaceTransform[2]))));
+		a_centre = glm::vec3(m_surfaceTransform * glm::vec4((m_surface->getMin() + m_surface->getMax()) * 0.5f, 1));
+		a_radius += glm::length(halfSize) * scale;
 	}
+	if (m_forces.isActive())
+		a_radius += 0.5f * m_forces.getMaxAcceleration() * m_lifespanMax * m_lifespanMax;
+}
+
+/**
+	writeInstances packs every live particle for the particle shader.
+
+		@param1 a_instances receives one instance per live particle,
+				with room for at least getMaxParticles.
+
+		@param2 a_extrapolate is how many seconds past the last
+				simulate the particles are drawn at.
+
+		@return the amount of instances written.
+*/
+unsigned int ParticleEmitter::writeInstances(ParticleInstance* a_instances, float a_extrapolate) const
+{
+	m_particles.writeInstances(a_instances, a_extrapolate);
+	return m_particles.getCount();
+}
+
+/**
+	writeSortedInstances packs every live particle like
+		writeInstances, furthest from a position first, so blended
+		particles draw over the ones behind them. The particles
+		are radix sorted on their distance.
+
+		@param1 a_instances receives one instance per live particle.
+
+		@param2 a_extrapolate is how many seconds past the last
+				simulate the particles are drawn at.
+
+		@param3 a_position is where they are sorted from, usually
+				the camera, in the emitter's space.
+
+		@return the amount of instances written.
+*/
+unsigned int ParticleEmitter::writeSortedInstances(ParticleInstance* a_instances, float a_extrapolate,
+	const glm::vec3& a_position) const
+{
+	unsigned int count = m_particles.getCount();
+
+	// Each worker keeps its own scratch. The instances are packed there
+	//	and not in a_instances, which is usually write combined memory
+	//	that is slow to read back.
+	thread_local std::vector<ParticleInstance> unsorted;
+	thread_local std::vector<uint32_t> keys, values, scratchKeys, scratchValues;
+	if (unsorted.size() < count)
+	{
+		unsorted.resize(count);
+		keys.resize(count);
+		values.resize(count);
+		scratchKeys.resize(count);
+		scratchValues.resize(count);
+	}
+	m_particles.writeInstances(unsorted.data(), a_extrapolate);
+
+	// Inverted, so the furthest particle has the smallest key.
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		glm::vec3 offset = glm::vec3(unsorted[i].positionSize) - a_position;
+		keys[i] = ~sns::floatToSortable(glm::dot(offset, offset));
+		values[i] = i;
+	}
+	sns::radixSort(keys.data(), values.data(), scratchKeys.data(), scratchValues.data(), count);
+
+	for (unsigned int i = 0; i < count; ++i)
+		a_instances[i] = unsorted[values[i]];
+	return count;
+}
+
+/**
+	bindVertexArray binds the vertex array to draw instances from,
+		attaching the buffer to the shared one if there isn't
+		one of its own.
+
+		@param1 a_vao is the vertex array from createVertexArray.
+
+		@param2 a_instanceBuffer is the buffer holding the instances.
+*/
+void ParticleEmitter::bindVertexArray(unsigned int a_vao, unsigned int a_instanceBuffer)
+{
+	if (a_vao != 0)
+		sns::RenderState::instance().bindVertexArray(a_vao);
+	else
+		sns::VertexArrays::instance().bind(instanceVertexFormat, a_instanceBuffer,
+			sizeof(ParticleInstance), 0);
 }
 
 /**
@@ -247,12 +521,13 @@ void ParticleEmitter::update(float a_deltaTime,
 */
 void ParticleEmitter::draw()
 {
-	// Sync the particle vertex buffer.
-	// Based on how many alive particles there are.
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, m_firstDead * 4 *
-		sizeof(ParticleVertex), m_vertexData);
-	// Draw particles.
-	glBindVertexArray(m_vao);
-	glDrawElements(GL_TRIANGLES, m_firstDead * 6, GL_UNSIGNED_INT, 0);
+	SNS_TRACE_GL_ZONE("ParticleEmitter::draw");
+	// Draw particles, 4 vertices of a strip per particle, starting
+	//	from the region update wrote this frame's instances to.
+	bindVertexArray(m_vao, m_instanceStream.getHandle());
+	sns::RenderState::instance().countDraw();
+	glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4,
+		m_particles.getCount(), m_firstInstance);
+	// Once this draw is done the region can be written again.
+	m_instanceStream.fence();
 }
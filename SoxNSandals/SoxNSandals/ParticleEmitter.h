@@ -9,6 +9,17 @@
 */
 #pragma once
 #include "soxCore.h"
+#include "GpuHandle.h"
+#include "ParticleForces.h"
+#include "ParticlePool.h"
+#include "Random.h"
+#include "StreamingBuffer.h"
+#include <memory>
+
+namespace sns
+{
+	class SurfaceSampler;
+}
 
 /**
 	The Particle Emitter class is used to create a particle system.
@@ -17,6 +28,11 @@
 class ParticleEmitter
 {
 public:
+	// The step prewarm simulates in by default, far longer than a
+	//	frame's but short enough that the particles spawned together
+	//	don't show as rings.
+	static constexpr float PREWARM_TIME_STEP = 1.0f / 15.0f;
+
 	/**
 		The Particle Emitter constructor assigns the values to 0
 			as default.
@@ -30,23 +46,8 @@ public:
 	virtual ~ParticleEmitter();
 
 
-	//---------Particle-------
-	struct Particle
-	{
-		glm::vec3 position;
-		glm::vec3 velocity;
-		glm::vec4 colour;
-		float size;
-		float lifetime;
-		float lifespan;
-	};
-
-	//----Particle Vertex----
-	struct ParticleVertex
-	{
-		glm::vec4 position;
-		glm::vec4 colour;
-	};
+	//---Particle Instance---
+	typedef sns::ParticlePool::Instance ParticleInstance;
 
 	/**
 		initialise creates a new particle effect based on the 
@@ -72,55 +73,271 @@ public:
 			@param9 a_startColour is the colour of the particle when they spawn.
 
 			@param10 a_endColour is the colour of the particle when they end.
+
+			@param11 a_seed picks the random numbers the particles spawn
+				with, the same seed always spawns the same particles.
 	*/
 	void initialise(unsigned int a_maxParticles, 
 		unsigned int a_emitRate,
 		float a_lifetimeMin, float a_lifetimeMax,
 		float a_velocityMin, float a_velocityMax,
 		float a_startSize, float a_endSize,
-		const glm::vec4& a_startColour, const glm::vec4& a_endColour);
+		const glm::vec4& a_startColour, const glm::vec4& a_endColour,
+		unsigned int a_seed = 0);
 
 	/**
-		emit is the function to be called to spawn a new particle.
-			it only runs if there is currently less than the maximum
-			amount. This means that when one dies, a new one spawn 
-			straight away.
+		emit is the function to be called to spawn new particles.
+			it only spawns as many as there is room for below the
+			maximum amount. This means that when one dies, a new one
+			spawns straight away.
+
+			@param1 a_count is how many particles to spawn.
 	*/
-	void emit();
+	void emit(unsigned int a_count = 1);
+
+	/**
+		restart kills every particle and starts the random numbers over,
+			so the emitter spawns the same particles as when it was
+			first initialised with the seed.
+
+			@param1 a_seed picks the random numbers the particles spawn
+				with.
+	*/
+	void restart(unsigned int a_seed);
+
+	/**
+		getSeed returns the seed the random numbers were last started with.
+	*/
+	unsigned int getSeed() const { return m_seed; }
 
 	/**
 		update is called every frame. It does all of the necessary 
 			math to move every particle and change their colour.
 			Also checks to see how many exist. If there are less
-			than the maximum, call emit.
+			than the maximum, call emit. The quads are made to face
+			the camera by the particle shader, so the camera isn't
+			needed here.
+
+			@param1 a_deltaTime is the time since the last update.
 	*/
-	void update(float a_deltaTime, const glm::mat4& a_cameraTransform);
+	virtual void update(float a_deltaTime);
 
 	/**
 		draw is the function that actually renders them to the screen.
 	*/
-	void draw();
+	virtual void draw();
+
+	/**
+		simulate emits, moves, kills and colours the particles without
+			touching opengl, so it can run on a worker thread.
+
+			@param1 a_deltaTime is the time since the last update.
+	*/
+	void simulate(float a_deltaTime);
+
+	/**
+		prewarm fast-forwards the emitter, in large steps at full
+			detail, so it looks as if it has been running a while.
+
+			@param1 a_duration is how long to run it for,
+					getPrewarmDuration to reach its steady state.
+
+			@param2 a_timeStep is the longest step to take.
+	*/
+	virtual void prewarm(float a_duration, float a_timeStep = PREWARM_TIME_STEP);
+
+	/**
+		getPrewarmDuration returns how long the emitter takes to reach
+			its steady state, once the first particles could have
+			lived their whole lifespan.
+	*/
+	float getPrewarmDuration() const { return m_lifespanMax; }
+
+	/**
+		writeInstances packs every live particle for the particle shader.
+
+			@param1 a_instances receives one instance per live particle,
+					with room for at least getMaxParticles.
+
+			@param2 a_extrapolate is how many seconds past the last
+					simulate the particles are drawn at.
+
+			@return the amount of instances written.
+	*/
+	unsigned int writeInstances(ParticleInstance* a_instances, float a_extrapolate = 0.0f) const;
+
+	/**
+		writeSortedInstances packs every live particle like
+			writeInstances, furthest from a position first, so blended
+			particles draw over the ones behind them. The particles
+			are radix sorted on their distance.
+
+			@param1 a_instances receives one instance per live particle.
+
+			@param2 a_extrapolate is how many seconds past the last
+					simulate the particles are drawn at.
+
+			@param3 a_position is where they are sorted from, usually
+					the camera, in the emitter's space.
+
+			@return the amount of instances written.
+	*/
+	unsigned int writeSortedInstances(ParticleInstance* a_instances, float a_extrapolate,
+		const glm::vec3& a_position) const;
+
+	/**
+		setPosition moves where new particles are emitted from.
+
+			@param1 a_position is the new position in world space.
+	*/
+	void setPosition(const glm::vec3& a_position) { m_position = a_position; }
+
+	/**
+		getPosition returns where new particles are emitted from.
+	*/
+	const glm::vec3& getPosition() const { return m_position; }
+
+	/**
+		setSurface makes new particles spawn spread evenly over a mesh's
+			surface instead of at the position, each heading away from
+			the side of the triangle it spawned on.
+
+			@param1 a_surface is the surface, see aie::OBJMesh::getSurface,
+					or nullptr to spawn at the position again.
+
+			@param2 a_transform takes the surface into world space.
+	*/
+	void setSurface(std::shared_ptr<const sns::SurfaceSampler> a_surface, const glm::mat4& a_transform);
+
+	/**
+		setSortPosition sets where update sorts the particles from,
+			usually the camera, in the emitter's space.
+
+			@param1 a_position is the position to sort from.
+	*/
+	void setSortPosition(const glm::vec3& a_position) { m_sortPosition = a_position; }
+
+	/**
+		setSortBudget sets the most particles update sorts. With more
+			live particles than that they are drawn unsorted, and 0,
+			the default, never sorts.
+
+			@param1 a_budget is the most particles to sort.
+	*/
+	void setSortBudget(unsigned int a_budget) { m_sortBudget = a_budget; }
+
+	/**
+		setForces sets what pushes the particles about after they
+			spawn. A vector field in the forces must outlive the
+			emitter or be set again.
+
+			@param1 a_forces are the forces, none by default.
+	*/
+	void setForces(const sns::ParticleForces& a_forces) { m_forces = a_forces; }
+
+	/**
+		getForces returns what pushes the particles about.
+	*/
+	const sns::ParticleForces& getForces() const { return m_forces; }
+
+	/**
+		getParticleCount returns the amount of live particles.
+	*/
+	unsigned int getParticleCount() const { return m_particles.getCount(); }
+
+	/**
+		setDetail scales the emitter down, for emitters that are far
+			away or over a particle budget. Particles already alive
+			over the new limit live out their lifespan.
+
+			@param1 a_emitScale multiplies the emit rate, 0 stops
+					emitting.
+
+			@param2 a_liveLimit is the most particles alive at once,
+					up to getMaxParticles.
+	*/
+	void setDetail(float a_emitScale, unsigned int a_liveLimit);
+
+	/**
+		getBounds returns a sphere no particle can leave, from the
+			fastest particle living the longest, pushed the whole
+			time by the most the forces can push it.
+
+			@param1 a_centre receives the centre of the sphere.
+
+			@param2 a_radius receives the radius of the sphere.
+	*/
+	void getBounds(glm::vec3& a_centre, float& a_radius) const;
+
+	/**
+		getMaxParticles returns the maximum amount of particles.
+	*/
+	unsigned int getMaxParticles() const { return m_maxParticles; }
+
+	/**
+		createVertexArray makes a vertex array that reads particle
+			instances from a buffer. Each instance is drawn as a
+			4 vertex triangle strip. With GL 4.5 every emitter shares
+			one vertex array instead, and none is made.
+
+			@param1 a_instanceBuffer is the buffer holding the instances.
+
+			@return the new vertex array, or 0 if the shared one is used.
+	*/
+	static unsigned int createVertexArray(unsigned int a_instanceBuffer);
+
+	/**
+		bindVertexArray binds the vertex array to draw instances from,
+			attaching the buffer to the shared one if there isn't
+			one of its own.
+
+			@param1 a_vao is the vertex array from createVertexArray.
+
+			@param2 a_instanceBuffer is the buffer holding the instances.
+	*/
+	static void bindVertexArray(unsigned int a_vao, unsigned int a_instanceBuffer);
 
 protected:
-	// A particle pointer. These will be created in an array to form
-	//	the particles.
-	Particle * m_particles;
+	/**
+		createBuffers is called at the end of initialise, once every
+			setting is stored. It makes the particle storage and the
+			opengl buffers the particles are drawn from.
+	*/
+	virtual void createBuffers();
 
-	// An int to store the first dead particle.
-	unsigned int m_firstDead;
+	// The particles, stored as structure of arrays. The live ones
+	//	are packed at the front.
+	sns::ParticlePool m_particles;
 
 	// An int to store the maximum amount of particles that can be spawned.
 	unsigned int m_maxParticles;
 
-	// 3 ints to store the vao, vbo and ibo.
-	unsigned int m_vao, m_vbo, m_ibo;
+	// The vao, deleted with the emitter.
+	sns::VertexArrayHandle m_vao;
+
+	// The instances are written straight into a persistently mapped
+	//	buffer, so the upload never waits for the last frame's draw.
+	sns::StreamingBuffer m_instanceStream;
 
-	// A pointer to particle vertex data.
-	ParticleVertex* m_vertexData;
+	// Where this frame's instances start in the streaming buffer.
+	unsigned int m_firstInstance;
 
 	// A vec3 that stores the position of the emitter.
 	glm::vec3 m_position;
 
+	// The surface particles spawn on instead, if any, and what takes it
+	//	and its normals into world space.
+	std::shared_ptr<const sns::SurfaceSampler> m_surface;
+	glm::mat4 m_surfaceTransform;
+	glm::mat3 m_surfaceNormals;
+
+	// The emitter's own random numbers, so emitters on different
+	//	threads never share state and replays spawn the same particles.
+	sns::Random m_random;
+
+	// The seed m_random was started with.
+	unsigned int m_seed;
+
 	// A float to store how long the emitter has been going for.
 	float m_emitTimer;
 	
@@ -151,6 +368,19 @@ protected:
 	// The colour of a particle when it reaches the end.
 	glm::vec4 m_endColour;
 
+	// What setDetail scaled the emit rate and live particles to.
+	float m_emitScale;
+	unsigned int m_liveLimit;
+
+	// Where update sorts the particles from, and the most it sorts.
+	glm::vec3 m_sortPosition;
+	unsigned int m_sortBudget;
+
+	// What pushes the particles about, and how long they have been
+	//	pushed for, which the curl noise moves on with.
+	sns::ParticleForces m_forces;
+	float m_forceTime;
+
 
 };
 
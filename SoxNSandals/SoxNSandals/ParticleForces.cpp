@@ -0,0 +1,160 @@
+/**
+	ParticleForces.cpp
+
+	Purpose: ParticleForces.cpp is the source file for the ParticleForces
+			struct. The ParticleForces are what pushes an emitter's
+			particles about after they spawn, gravity, drag, points
+			pulling them in, curl noise and a vector field.
+
+	@author Nathan Nette
+*/
+#include "ParticleForces.h"
+#include "VectorField.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace sns
+{
+	constexpr float ParticleForces::CURL_MAX_LENGTH;
+
+	// Each octave of the curl noise is turned about its own axis, the
+	//	first not at all.
+	static const glm::mat3 CURL_ROTATIONS[ParticleForces::CURL_OCTAVES] = {
+		glm::mat3(1),
+		glm::mat3(glm::rotate(glm::mat4(1), 1.1f, glm::normalize(glm::vec3(1, 1, 0)))),
+		glm::mat3(glm::rotate(glm::mat4(1), 2.3f, glm::normalize(glm::vec3(0, 1, 1)))),
+	};
+
+	ParticleForces::ParticleForces()
+		: gravity(0),
+		drag(0),
+		attractors(),
+		attractorCount(0),
+		curlStrength(0),
+		curlScale(1),
+		curlSpeed(0),
+		field(nullptr),
+		fieldStrength(1)
+	{
+	}
+
+	/**
+		isActive returns whether any force is set.
+	*/
+	bool ParticleForces::isActive() const
+	{
+		return gravity != glm::vec3(0) || drag > 0.0f || attractorCount > 0 || curlStrength != 0.0f ||
+			(field != nullptr && fieldStrength != 0.0f);
+	}
+
+	/**
+		addAttractor adds a point pulling particles in.
+
+			@param1 a_position is the point.
+
+			@param2 a_strength is its pull at the point, negative pushes.
+
+			@param3 a_radius is how far out it pulls hardest, above 0.
+
+			@return false if there are already MAX_ATTRACTORS.
+	*/
+	bool ParticleForces::addAttractor(const glm::vec3& a_position, float a_strength, float a_radius)
+	{
+		if (attractorCount >= MAX_ATTRACTORS)
+			return false;
+		attractors[attractorCount++] = { a_position, a_strength, std::max(a_radius, 1e-3f) };
+		return true;
+	}
+
+	/**
+		getMaxAcceleration returns the most the forces can accelerate a
+			particle by, for the emitter's bounds. An attractor pulls
+			hardest at its point.
+
+			@return the acceleration.
+	*/
+	float ParticleForces::getMaxAcceleration() const
+	{
+		float acceleration = glm::length(gravity) + std::abs(curlStrength) * CURL_MAX_LENGTH;
+		for (unsigned int i = 0; i < attractorCount; ++i)
+			acceleration += std::abs(attractors[i].strength);
+		if (field != nullptr)
+			acceleration += std::abs(fieldStrength) * field->getMaxLength();
+		return acceleration;
+	}
+
+	/**
+		getAcceleration returns the forces' acceleration at a position,
+			without the drag. An attractor's pull is its strength times
+			its radius squared over the distance squared plus the
+			radius squared, so it is its strength at the point, half
+			that at the radius and falls off with the square past it.
+
+			@param1 a_position is the position.
+
+			@param2 a_time is how long the emitter has run.
+	*/
+	glm::vec3 ParticleForces::getAcceleration(const glm::vec3& a_position, float a_time) const
+	{
+		glm::vec3 acceleration = gravity;
+		for (unsigned int i = 0; i < attractorCount; ++i)
+		{
+			const Attractor& attractor = attractors[i];
+			glm::vec3 offset = attractor.position - a_position;
+			float distanceSquared = glm::dot(offset, offset);
+			float radiusSquared = attractor.radius * attractor.radius;
+			float pull = attractor.strength * radiusSquared / (distanceSquared + radiusSquared);
+			acceleration += offset * (pull / std::sqrt(std::max(distanceSquared, 1e-12f)));
+		}
+		if (curlStrength != 0.0f)
+			acceleration += getCurlNoise(a_position * curlScale, a_time * curlSpeed) * curlStrength;
+		if (field != nullptr)
+			acceleration += field->sample(a_position) * fieldStrength;
+		return acceleration;
+	}
+
+	/**
+		getCurlNoise returns the curl noise at a position. Each octave's
+			potential is (sin(y + t) cos(z), sin(z + t) cos(x),
+			sin(x + t) cos(y)) at the position turned and scaled, and
+			its curl is turned back.
+
+			@param1 a_position is the position, already scaled.
+
+			@param2 a_phase is how far the noise has moved on.
+	*/
+	glm::vec3 ParticleForces::getCurlNoise(const glm::vec3& a_position, float a_phase)
+	{
+		glm::vec3 curl(0);
+		float frequency = 1.0f;
+		float weight = 1.0f;
+		float weights = 0.0f;
+		for (unsigned int octave = 0; octave < CURL_OCTAVES; ++octave)
+		{
+			glm::vec3 q = CURL_ROTATIONS[octave] * a_position * frequency;
+			glm::vec3 s(std::sin(q.x), std::sin(q.y), std::sin(q.z));
+			glm::vec3 c(std::cos(q.x), std::cos(q.y), std::cos(q.z));
+			glm::vec3 st(std::sin(q.x + a_phase), std::sin(q.y + a_phase), std::sin(q.z + a_phase));
+			glm::vec3 ct(std::cos(q.x + a_phase), std::cos(q.y + a_phase), std::cos(q.z + a_phase));
+			glm::vec3 octaveCurl(-st.x * s.y - ct.z * c.x, -st.y * s.z - ct.x * c.y, -st.z * s.x - ct.y * c.z);
+
+			curl += glm::transpose(CURL_ROTATIONS[octave]) * octaveCurl * weight;
+			weights += weight;
+			frequency *= 2.0f;
+			weight *= 0.5f;
+		}
+		return curl / weights;
+	}
+
+	/**
+		getCurlRotation returns the rotation of an octave of the curl
+			noise.
+
+			@param1 a_octave is the octave, below CURL_OCTAVES.
+	*/
+	const glm::mat3& ParticleForces::getCurlRotation(unsigned int a_octave)
+	{
+		return CURL_ROTATIONS[a_octave];
+	}
+}
@@ -0,0 +1,139 @@
+/**
+	ParticleForces.h
+
+	Purpose: ParticleForces.h is the header file for the ParticleForces
+			struct. The ParticleForces are what pushes an emitter's
+			particles about after they spawn, gravity, drag, points
+			pulling them in, curl noise and a vector field.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+
+namespace sns
+{
+	class VectorField;
+
+	/**
+		The ParticleForces struct holds every force on an emitter's
+			particles, in the emitter's space. Each is an acceleration,
+			so the same forces move particles of any mass alike, and
+			drag then takes a share of the speed away.
+
+		The curl noise is the curl of a vector potential made of a few
+			octaves of sines, each turned a different way so their grid
+			doesn't show. A curl has no divergence, so the particles
+			swirl without bunching up or thinning out, and being
+			analytic it costs nothing to store and is the same on the
+			cpu and in the compute shader.
+
+		Both particle backends read the same struct. The cpu one works
+			four particles at a time with SSE, except for the vector
+			field, which is sampled one particle at a time.
+	*/
+	struct ParticleForces
+	{
+		// Points pulling particles in at once, at most.
+		static const unsigned int MAX_ATTRACTORS = 4;
+
+		// Octaves of the curl noise, each twice as fine and half as
+		//	strong as the one before.
+		static const unsigned int CURL_OCTAVES = 3;
+
+		// The longest the curl noise gets, 2 in each axis of an octave.
+		static constexpr float CURL_MAX_LENGTH = 3.4641f;
+
+		/**
+			A point pulling particles in, or pushing them away with a
+				negative strength. It pulls about evenly within its
+				radius and falls off with the square of the distance
+				past it.
+		*/
+		struct Attractor
+		{
+			glm::vec3 position;
+			float strength;
+			float radius;
+		};
+
+		// What every particle falls with.
+		glm::vec3 gravity;
+
+		// The share of a particle's speed lost each second.
+		float drag;
+
+		Attractor attractors[MAX_ATTRACTORS];
+		unsigned int attractorCount;
+
+		// How hard the curl noise pushes, how many swirls fit in a unit
+		//	and how fast they change.
+		float curlStrength;
+		float curlScale;
+		float curlSpeed;
+
+		// A field to push particles along, not owned, or nullptr, and
+		//	what its vectors are multiplied by.
+		const VectorField* field;
+		float fieldStrength;
+
+		/**
+			The constructor makes no forces at all.
+		*/
+		ParticleForces();
+
+		/**
+			isActive returns whether any force is set.
+		*/
+		bool isActive() const;
+
+		/**
+			addAttractor adds a point pulling particles in.
+
+				@param1 a_position is the point.
+
+				@param2 a_strength is its pull at the point, negative
+						pushes.
+
+				@param3 a_radius is how far out it pulls hardest, above 0.
+
+				@return false if there are already MAX_ATTRACTORS.
+		*/
+		bool addAttractor(const glm::vec3& a_position, float a_strength, float a_radius);
+
+		/**
+			getMaxAcceleration returns the most the forces can accelerate
+				a particle by, for the emitter's bounds.
+		*/
+		float getMaxAcceleration() const;
+
+		/**
+			getAcceleration returns the forces' acceleration at a
+				position, without the drag.
+
+				@param1 a_position is the position.
+
+				@param2 a_time is how long the emitter has run, which the
+						curl noise changes with.
+		*/
+		glm::vec3 getAcceleration(const glm::vec3& a_position, float a_time) const;
+
+		/**
+			getCurlNoise returns the curl noise at a position, no longer
+				than CURL_MAX_LENGTH.
+
+				@param1 a_position is the position, already scaled.
+
+				@param2 a_phase is how far the noise has moved on.
+		*/
+		static glm::vec3 getCurlNoise(const glm::vec3& a_position, float a_phase);
+
+		/**
+			getCurlRotation returns the rotation of an octave of the curl
+				noise.
+
+				@param1 a_octave is the octave, below CURL_OCTAVES.
+		*/
+		static const glm::mat3& getCurlRotation(unsigned int a_octave);
+	};
+}
@@ -0,0 +1,551 @@
+/**
+	ParticlePool.cpp
+
+	Purpose: ParticlePool.cpp is the source file for the ParticlePool class.
+			The ParticlePool stores particles as structure of arrays, so
+			the update can work on four particles at a time with SSE.
+
+	@author Nathan Nette
+*/
+#include "ParticlePool.h"
+#include "BlockPool.h"
+#include "ParticleForces.h"
+#include "VectorField.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_PARTICLE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// The streams of a particle.
+	const unsigned int STREAM_COUNT = 13;
+
+	// Storage comes in STORAGE_CLASS_COUNT power of two capacities from
+	//	MIN_STORAGE particles, anything bigger comes from the heap.
+	const unsigned int MIN_STORAGE = 256;
+	const unsigned int STORAGE_CLASS_COUNT = 12;
+
+	// About how big a slab of storage is, big classes get a slab each.
+	const size_t SLAB_SIZE = 1024 * 1024;
+
+	/**
+		storagePool returns the pool of one size class.
+
+			@param1 a_sizeClass is the class, the capacity is
+					MIN_STORAGE << a_sizeClass.
+	*/
+	sns::BlockPool& storagePool(unsigned int a_sizeClass)
+	{
+		typedef std::unique_ptr<sns::BlockPool> Pool;
+		static const std::vector<Pool> pools = []()
+		{
+			std::vector<Pool> created;
+			for (unsigned int i = 0; i < STORAGE_CLASS_COUNT; ++i)
+			{
+				size_t blockSize = (size_t)(MIN_STORAGE << i) * STREAM_COUNT * sizeof(float);
+				created.emplace_back(new sns::BlockPool(blockSize,
+					(unsigned int)std::max<size_t>(1, SLAB_SIZE / blockSize)));
+			}
+			return created;
+		}();
+		return *pools[a_sizeClass];
+	}
+
+#ifdef SNS_PARTICLE_SSE
+	/**
+		sin4 returns the sine of four angles, to within about a
+			thousandth. The angles are wrapped into -pi to pi, a
+			parabola fits the sine there and a second pass of it takes
+			most of the error out.
+
+			@param1 a_x are the angles.
+	*/
+	__m128 sin4(__m128 a_x)
+	{
+		// Adding and taking away 1.5 * 2^23 rounds to the nearest whole
+		//	number, without needing SSE2 to convert.
+		const __m128 round = _mm_set1_ps(12582912.0f);
+		__m128 turns = _mm_mul_ps(a_x, _mm_set1_ps(0.15915494f));
+		turns = _mm_sub_ps(_mm_add_ps(turns, round), round);
+		__m128 x = _mm_sub_ps(a_x, _mm_mul_ps(turns, _mm_set1_ps(6.2831853f)));
+
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 y = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.2732395f)),
+			_mm_mul_ps(_mm_mul_ps(x, _mm_andnot_ps(signMask, x)), _mm_set1_ps(-0.40528473f)));
+		__m128 correction = _mm_sub_ps(_mm_mul_ps(y, _mm_andnot_ps(signMask, y)), y);
+		return _mm_add_ps(y, _mm_mul_ps(correction, _mm_set1_ps(0.225f)));
+	}
+
+	/**
+		cos4 returns the cosine of four angles, as the sine a quarter
+			turn on.
+
+			@param1 a_x are the angles.
+	*/
+	__m128 cos4(__m128 a_x)
+	{
+		return sin4(_mm_add_ps(a_x, _mm_set1_ps(1.5707963f)));
+	}
+#endif
+}
+
+namespace sns
+{
+	/**
+		The constructor makes an empty pool with no room.
+	*/
+	ParticlePool::ParticlePool()
+		: m_positionX(nullptr), m_positionY(nullptr), m_positionZ(nullptr),
+		m_velocityX(nullptr), m_velocityY(nullptr), m_velocityZ(nullptr),
+		m_lifetime(nullptr), m_lifespan(nullptr),
+		m_size(nullptr),
+		m_colourR(nullptr), m_colourG(nullptr), m_colourB(nullptr), m_colourA(nullptr),
+		m_storage(nullptr),
+		m_sizeClass(0),
+		m_count(0),
+		m_capacity(0)
+	{
+	}
+
+	/**
+		The deconstructor gives the storage back to its pool.
+	*/
+	ParticlePool::~ParticlePool()
+	{
+		release();
+	}
+
+	/**
+		resize sets how many particles fit in the pool and kills
+			every live particle.
+
+			@param1 a_capacity is the maximum amount of particles.
+	*/
+	void ParticlePool::resize(unsigned int a_capacity)
+	{
+		release();
+		m_capacity = a_capacity;
+		m_count = 0;
+		if (a_capacity == 0)
+			return;
+
+		// The smallest class that fits, which is already a multiple of 4.
+		size_t padded = MIN_STORAGE;
+		m_sizeClass = 0;
+		while (padded < a_capacity)
+		{
+			padded *= 2;
+			++m_sizeClass;
+		}
+
+		if (m_sizeClass < STORAGE_CLASS_COUNT)
+			m_storage = (float*)storagePool(m_sizeClass).allocate();
+		else
+			m_storage = new float[padded * STREAM_COUNT];
+
+		float** streams[STREAM_COUNT] = { &m_positionX, &m_positionY, &m_positionZ,
+			&m_velocityX, &m_velocityY, &m_velocityZ,
+			&m_lifetime, &m_lifespan, &m_size,
+			&m_colourR, &m_colourG, &m_colourB, &m_colourA };
+		for (unsigned int i = 0; i < STREAM_COUNT; ++i)
+			*streams[i] = m_storage + i * padded;
+
+		std::fill(m_storage, m_storage + padded * STREAM_COUNT, 0.0f);
+
+		// The padding is read by the SSE loops, so it must never divide by zero.
+		std::fill(m_lifespan, m_lifespan + padded, 1.0f);
+	}
+
+	/**
+		release gives the storage back to its pool.
+	*/
+	void ParticlePool::release()
+	{
+		if (m_storage == nullptr)
+			return;
+
+		if (m_sizeClass < STORAGE_CLASS_COUNT)
+			storagePool(m_sizeClass).free(m_storage);
+		else
+			delete[] m_storage;
+		m_storage = nullptr;
+	}
+
+	/**
+		add spawns a particle at the end of the live particles.
+
+			@param1 a_position is where the particle starts.
+
+			@param2 a_velocity is how fast it moves.
+
+			@param3 a_lifespan is how long it lives for in seconds.
+
+			@return false if the pool is full.
+	*/
+	bool ParticlePool::add(const glm::vec3& a_position, const glm::vec3& a_velocity, float a_lifespan)
+	{
+		if (m_count >= m_capacity)
+			return false;
+
+		unsigned int i = m_count++;
+		m_positionX[i] = a_position.x;
+		m_positionY[i] = a_position.y;
+		m_positionZ[i] = a_position.z;
+		m_velocityX[i] = a_velocity.x;
+		m_velocityY[i] = a_velocity.y;
+		m_velocityZ[i] = a_velocity.z;
+		m_lifetime[i] = 0;
+		m_lifespan[i] = a_lifespan;
+		return true;
+	}
+
+	/**
+		integrate ages every live particle and moves it along its
+			velocity.
+
+			@param1 a_deltaTime is the time since the last update.
+	*/
+	void ParticlePool::integrate(float a_deltaTime)
+	{
+		unsigned int i = 0;
+
+#ifdef SNS_PARTICLE_SSE
+		// The streams are padded, so the last partial group can run with SSE too.
+		unsigned int padded = (m_count + 3) & ~3u;
+		const __m128 dt = _mm_set1_ps(a_deltaTime);
+		for (; i < padded; i += 4)
+		{
+			_mm_storeu_ps(&m_lifetime[i], _mm_add_ps(_mm_loadu_ps(&m_lifetime[i]), dt));
+			_mm_storeu_ps(&m_positionX[i], _mm_add_ps(_mm_loadu_ps(&m_positionX[i]),
+				_mm_mul_ps(_mm_loadu_ps(&m_velocityX[i]), dt)));
+			_mm_storeu_ps(&m_positionY[i], _mm_add_ps(_mm_loadu_ps(&m_positionY[i]),
+				_mm_mul_ps(_mm_loadu_ps(&m_velocityY[i]), dt)));
+			_mm_storeu_ps(&m_positionZ[i], _mm_add_ps(_mm_loadu_ps(&m_positionZ[i]),
+				_mm_mul_ps(_mm_loadu_ps(&m_velocityZ[i]), dt)));
+		}
+#endif
+
+		for (; i < m_count; ++i)
+		{
+			m_lifetime[i] += a_deltaTime;
+			m_positionX[i] += m_velocityX[i] * a_deltaTime;
+			m_positionY[i] += m_velocityY[i] * a_deltaTime;
+			m_positionZ[i] += m_velocityZ[i] * a_deltaTime;
+		}
+	}
+
+	/**
+		accelerate changes every live particle's velocity by the
+			forces on it, then takes the drag off. With SSE the curl
+			noise uses a sine that is close but not exact, and the
+			vector field is sampled one particle at a time after.
+
+			@param1 a_forces are the forces.
+
+			@param2 a_deltaTime is the time since the last update.
+
+			@param3 a_time is how long the emitter has run.
+	*/
+	void ParticlePool::accelerate(const ParticleForces& a_forces, float a_deltaTime, float a_time)
+	{
+		float damping = std::max(0.0f, 1.0f - a_forces.drag * a_deltaTime);
+		unsigned int i = 0;
+
+#ifdef SNS_PARTICLE_SSE
+		unsigned int padded = (m_count + 3) & ~3u;
+		const __m128 dt = _mm_set1_ps(a_deltaTime);
+		const __m128 damp = _mm_set1_ps(damping);
+		const __m128 curlScale = _mm_set1_ps(a_forces.curlScale);
+		const __m128 phase = _mm_set1_ps(a_time * a_forces.curlSpeed);
+		const __m128 minDistance = _mm_set1_ps(1e-12f);
+		bool curl = a_forces.curlStrength != 0.0f;
+		for (; i < padded; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&m_positionX[i]);
+			__m128 y = _mm_loadu_ps(&m_positionY[i]);
+			__m128 z = _mm_loadu_ps(&m_positionZ[i]);
+			__m128 ax = _mm_set1_ps(a_forces.gravity.x);
+			__m128 ay = _mm_set1_ps(a_forces.gravity.y);
+			__m128 az = _mm_set1_ps(a_forces.gravity.z);
+
+			for (unsigned int a = 0; a < a_forces.attractorCount; ++a)
+			{
+				const ParticleForces::Attractor& attractor = a_forces.attractors[a];
+				__m128 ox = _mm_sub_ps(_mm_set1_ps(attractor.position.x), x);
+				__m128 oy = _mm_sub_ps(_mm_set1_ps(attractor.position.y), y);
+				__m128 oz = _mm_sub_ps(_mm_set1_ps(attractor.position.z), z);
+				__m128 distanceSquared = _mm_add_ps(_mm_mul_ps(ox, ox), _mm_add_ps(_mm_mul_ps(oy, oy), _mm_mul_ps(oz, oz)));
+				__m128 radiusSquared = _mm_set1_ps(attractor.radius * attractor.radius);
+				__m128 pull = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(attractor.strength), radiusSquared),
+					_mm_add_ps(distanceSquared, radiusSquared));
+				__m128 scale = _mm_mul_ps(pull, _mm_rsqrt_ps(_mm_max_ps(distanceSquared, minDistance)));
+				ax = _mm_add_ps(ax, _mm_mul_ps(ox, scale));
+				ay = _mm_add_ps(ay, _mm_mul_ps(oy, scale));
+				az = _mm_add_ps(az, _mm_mul_ps(oz, scale));
+			}
+
+			if (curl)
+			{
+				// The same octaves as ParticleForces::getCurlNoise, four
+				//	particles at a time.
+				__m128 px = _mm_mul_ps(x, curlScale);
+				__m128 py = _mm_mul_ps(y, curlScale);
+				__m128 pz = _mm_mul_ps(z, curlScale);
+				__m128 cx = _mm_setzero_ps(), cy = _mm_setzero_ps(), cz = _mm_setzero_ps();
+				float frequency = 1.0f;
+				float weight = 1.0f;
+				float weights = 0.0f;
+				for (unsigned int octave = 0; octave < ParticleForces::CURL_OCTAVES; ++octave)
+				{
+					const glm::mat3& r = ParticleForces::getCurlRotation(octave);
+					__m128 f = _mm_set1_ps(frequency);
+					__m128 qx = _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(r[0][0])),
+						_mm_add_ps(_mm_mul_ps(py, _mm_set1_ps(r[1][0])), _mm_mul_ps(pz, _mm_set1_ps(r[2][0])))));
+					__m128 qy = _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(r[0][1])),
+						_mm_add_ps(_mm_mul_ps(py, _mm_set1_ps(r[1][1])), _mm_mul_ps(pz, _mm_set1_ps(r[2][1])))));
+					__m128 qz = _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(r[0][2])),
+						_mm_add_ps(_mm_mul_ps(py, _mm_set1_ps(r[1][2])), _mm_mul_ps(pz, _mm_set1_ps(r[2][2])))));
+
+					__m128 sy = sin4(qy), sz = sin4(qz), sx = sin4(qx);
+					__m128 cosx = cos4(qx), cosy = cos4(qy), cosz = cos4(qz);
+					__m128 stx = sin4(_mm_add_ps(qx, phase)), sty = sin4(_mm_add_ps(qy, phase));
+					__m128 stz = sin4(_mm_add_ps(qz, phase));
+					__m128 ctx = cos4(_mm_add_ps(qx, phase)), cty = cos4(_mm_add_ps(qy, phase));
+					__m128 ctz = cos4(_mm_add_ps(qz, phase));
+
+					__m128 w = _mm_set1_ps(-weight);
+					__m128 ox = _mm_mul_ps(w, _mm_add_ps(_mm_mul_ps(stx, sy), _mm_mul_ps(ctz, cosx)));
+					__m128 oy = _mm_mul_ps(w, _mm_add_ps(_mm_mul_ps(sty, sz), _mm_mul_ps(ctx, cosy)));
+					__m128 oz = _mm_mul_ps(w, _mm_add_ps(_mm_mul_ps(stz, sx), _mm_mul_ps(cty, cosz)));
+
+					// Turned back by the rotation's transpose.
+					cx = _mm_add_ps(cx, _mm_add_ps(_mm_mul_ps(ox, _mm_set1_ps(r[0][0])),
+						_mm_add_ps(_mm_mul_ps(oy, _mm_set1_ps(r[0][1])), _mm_mul_ps(oz, _mm_set1_ps(r[0][2])))));
+					cy = _mm_add_ps(cy, _mm_add_ps(_mm_mul_ps(ox, _mm_set1_ps(r[1][0])),
+						_mm_add_ps(_mm_mul_ps(oy, _mm_set1_ps(r[1][1])), _mm_mul_ps(oz, _mm_set1_ps(r[1][2])))));
+					cz = _mm_add_ps(cz, _mm_add_ps(_mm_mul_ps(ox, _mm_set1_ps(r[2][0])),
+						_mm_add_ps(_mm_mul_ps(oy, _mm_set1_ps(r[2][1])), _mm_mul_ps(oz, _mm_set1_ps(r[2][2])))));
+
+					weights += weight;
+					frequency *= 2.0f;
+					weight *= 0.5f;
+				}
+
+				__m128 strength = _mm_set1_ps(a_forces.curlStrength / weights);
+				ax = _mm_add_ps(ax, _mm_mul_ps(cx, strength));
+				ay = _mm_add_ps(ay, _mm_mul_ps(cy, strength));
+				az = _mm_add_ps(az, _mm_mul_ps(cz, strength));
+			}
+
+			_mm_storeu_ps(&m_velocityX[i], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&m_velocityX[i]), _mm_mul_ps(ax, dt)), damp));
+			_mm_storeu_ps(&m_velocityY[i], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&m_velocityY[i]), _mm_mul_ps(ay, dt)), damp));
+			_mm_storeu_ps(&m_velocityZ[i], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&m_velocityZ[i]), _mm_mul_ps(az, dt)), damp));
+		}
+
+		// The field is a gather from the grid, so it is left to one
+		//	particle at a time, damped as if it had been added before.
+		if (a_forces.field != nullptr && a_forces.fieldStrength != 0.0f)
+		{
+			float scale = a_forces.fieldStrength * a_deltaTime * damping;
+			for (unsigned int j = 0; j < m_count; ++j)
+			{
+				glm::vec3 push = a_forces.field->sample(glm::vec3(m_positionX[j], m_positionY[j], m_positionZ[j])) * scale;
+				m_velocityX[j] += push.x;
+				m_velocityY[j] += push.y;
+				m_velocityZ[j] += push.z;
+			}
+		}
+#endif
+
+		for (; i < m_count; ++i)
+		{
+			glm::vec3 acceleration = a_forces.getAcceleration(glm::vec3(m_positionX[i], m_positionY[i], m_positionZ[i]), a_time);
+			m_velocityX[i] = (m_velocityX[i] + acceleration.x * a_deltaTime) * damping;
+			m_velocityY[i] = (m_velocityY[i] + acceleration.y * a_deltaTime) * damping;
+			m_velocityZ[i] = (m_velocityZ[i] + acceleration.z * a_deltaTime) * damping;
+		}
+	}
+
+	/**
+		kill removes every particle that has outlived its lifespan.
+
+			@return the amount of particles removed.
+	*/
+	unsigned int ParticlePool::kill()
+	{
+		unsigned int removed = 0;
+		unsigned int i = 0;
+
+		while (i < m_count)
+		{
+#ifdef SNS_PARTICLE_SSE
+			// Most groups of four have nobody dying, skip those in one test.
+			if (i + 4 <= m_count)
+			{
+				__m128 dead = _mm_cmpge_ps(_mm_loadu_ps(&m_lifetime[i]), _mm_loadu_ps(&m_lifespan[i]));
+				if (_mm_movemask_ps(dead) == 0)
+				{
+					i += 4;
+					continue;
+				}
+			}
+#endif
+
+			if (m_lifetime[i] >= m_lifespan[i])
+			{
+				// The last live particle has already been integrated, so it
+				//	can fill the gap and be tested again straight away.
+				move(m_count - 1, i);
+				--m_count;
+				++removed;
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		return removed;
+	}
+
+	/**
+		interpolate sets the size and colour of every live particle
+			from how far through its life it is.
+
+			@param1 a_startSize is the size of a new particle.
+
+			@param2 a_endSize is the size of a particle about to die.
+
+			@param3 a_startColour is the colour of a new particle.
+
+			@param4 a_endColour is the colour of a particle about to die.
+	*/
+	void ParticlePool::interpolate(float a_startSize, float a_endSize,
+		const glm::vec4& a_startColour, const glm::vec4& a_endColour)
+	{
+		float sizeRange = a_endSize - a_startSize;
+		glm::vec4 colourRange = a_endColour - a_startColour;
+		unsigned int i = 0;
+
+#ifdef SNS_PARTICLE_SSE
+		unsigned int padded = (m_count + 3) & ~3u;
+		const __m128 size0 = _mm_set1_ps(a_startSize), sizeD = _mm_set1_ps(sizeRange);
+		const __m128 r0 = _mm_set1_ps(a_startColour.r), rD = _mm_set1_ps(colourRange.r);
+		const __m128 g0 = _mm_set1_ps(a_startColour.g), gD = _mm_set1_ps(colourRange.g);
+		const __m128 b0 = _mm_set1_ps(a_startColour.b), bD = _mm_set1_ps(colourRange.b);
+		const __m128 a0 = _mm_set1_ps(a_startColour.a), aD = _mm_set1_ps(colourRange.a);
+		for (; i < padded; i += 4)
+		{
+			__m128 t = _mm_div_ps(_mm_loadu_ps(&m_lifetime[i]), _mm_loadu_ps(&m_lifespan[i]));
+			_mm_storeu_ps(&m_size[i], _mm_add_ps(size0, _mm_mul_ps(sizeD, t)));
+			_mm_storeu_ps(&m_colourR[i], _mm_add_ps(r0, _mm_mul_ps(rD, t)));
+			_mm_storeu_ps(&m_colourG[i], _mm_add_ps(g0, _mm_mul_ps(gD, t)));
+			_mm_storeu_ps(&m_colourB[i], _mm_add_ps(b0, _mm_mul_ps(bD, t)));
+			_mm_storeu_ps(&m_colourA[i], _mm_add_ps(a0, _mm_mul_ps(aD, t)));
+		}
+#endif
+
+		for (; i < m_count; ++i)
+		{
+			float t = m_lifetime[i] / m_lifespan[i];
+			m_size[i] = a_startSize + sizeRange * t;
+			m_colourR[i] = a_startColour.r + colourRange.r * t;
+			m_colourG[i] = a_startColour.g + colourRange.g * t;
+			m_colourB[i] = a_startColour.b + colourRange.b * t;
+			m_colourA[i] = a_startColour.a + colourRange.a * t;
+		}
+	}
+
+	/**
+		writeInstances packs the centre, size and colour of every
+			live particle for the particle shader.
+
+			@param1 a_instances receives one instance per live particle.
+
+			@param2 a_extrapolate moves each centre along its velocity
+					for this many seconds, for frames drawn between
+					fixed simulation steps.
+	*/
+	void ParticlePool::writeInstances(Instance* a_instances, float a_extrapolate) const
+	{
+		unsigned int i = 0;
+
+#ifdef SNS_PARTICLE_SSE
+		// The instances are only read back by the upload, so when they are
+		//	aligned they skip the cache instead of evicting the particles.
+		bool streaming = ((size_t)a_instances & 15) == 0;
+
+		// The instance buffer only has room for live particles, so stop at
+		//	the last full group and leave the rest to the scalar loop.
+		__m128 extrapolate = _mm_set1_ps(a_extrapolate);
+		for (; i + 4 <= m_count; i += 4)
+		{
+			__m128 x = _mm_add_ps(_mm_loadu_ps(&m_positionX[i]), _mm_mul_ps(_mm_loadu_ps(&m_velocityX[i]), extrapolate));
+			__m128 y = _mm_add_ps(_mm_loadu_ps(&m_positionY[i]), _mm_mul_ps(_mm_loadu_ps(&m_velocityY[i]), extrapolate));
+			__m128 z = _mm_add_ps(_mm_loadu_ps(&m_positionZ[i]), _mm_mul_ps(_mm_loadu_ps(&m_velocityZ[i]), extrapolate));
+			__m128 size = _mm_loadu_ps(&m_size[i]);
+			__m128 r = _mm_loadu_ps(&m_colourR[i]);
+			__m128 g = _mm_loadu_ps(&m_colourG[i]);
+			__m128 b = _mm_loadu_ps(&m_colourB[i]);
+			__m128 a = _mm_loadu_ps(&m_colourA[i]);
+
+			// Turn four particles per register into one particle per register.
+			_MM_TRANSPOSE4_PS(x, y, z, size);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			__m128 positions[4] = { x, y, z, size };
+			__m128 colours[4] = { r, g, b, a };
+
+			Instance* instance = a_instances + i;
+			for (int p = 0; p < 4; ++p)
+			{
+				if (streaming)
+				{
+					_mm_stream_ps(&instance[p].positionSize.x, positions[p]);
+					_mm_stream_ps(&instance[p].colour.x, colours[p]);
+				}
+				else
+				{
+					_mm_storeu_ps(&instance[p].positionSize.x, positions[p]);
+					_mm_storeu_ps(&instance[p].colour.x, colours[p]);
+				}
+			}
+		}
+
+		if (streaming)
+			_mm_sfence();
+#endif
+
+		for (; i < m_count; ++i)
+		{
+			a_instances[i].positionSize = glm::vec4(
+				m_positionX[i] + m_velocityX[i] * a_extrapolate,
+				m_positionY[i] + m_velocityY[i] * a_extrapolate,
+				m_positionZ[i] + m_velocityZ[i] * a_extrapolate, m_size[i]);
+			a_instances[i].colour = glm::vec4(m_colourR[i], m_colourG[i], m_colourB[i], m_colourA[i]);
+		}
+	}
+
+	/**
+		move copies the particle at a_from into the slot at a_to.
+
+			@param1 a_from is the particle to copy.
+
+			@param2 a_to is the slot to overwrite.
+	*/
+	void ParticlePool::move(unsigned int a_from, unsigned int a_to)
+	{
+		m_positionX[a_to] = m_positionX[a_from];
+		m_positionY[a_to] = m_positionY[a_from];
+		m_positionZ[a_to] = m_positionZ[a_from];
+		m_velocityX[a_to] = m_velocityX[a_from];
+		m_velocityY[a_to] = m_velocityY[a_from];
+		m_velocityZ[a_to] = m_velocityZ[a_from];
+		m_lifetime[a_to] = m_lifetime[a_from];
+		m_lifespan[a_to] = m_lifespan[a_from];
+	}
+}
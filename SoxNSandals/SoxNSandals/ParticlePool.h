@@ -0,0 +1,171 @@
+/**
+	ParticlePool.h
+
+	Purpose: ParticlePool.h is the header file for the ParticlePool class.
+			The ParticlePool stores particles as structure of arrays, so
+			the update can work on four particles at a time with SSE.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace sns
+{
+	struct ParticleForces;
+
+	/**
+		The ParticlePool class holds every live particle of an emitter.
+			Live particles are always packed at the front, dead ones are
+			swapped with the last live particle.
+
+		Every stream lives in one block of storage. Blocks come from
+			pools of power of two sizes shared by every ParticlePool,
+			so emitters spawned and destroyed over and over reuse the
+			storage of the ones before them.
+	*/
+	class ParticlePool
+	{
+	public:
+		/**
+			One particle as the particle shader reads it. The shader
+				expands it into a quad facing the camera.
+		*/
+		struct Instance
+		{
+			// xyz is the centre, w is the size.
+			glm::vec4 positionSize;
+			glm::vec4 colour;
+		};
+
+		/**
+			The constructor makes an empty pool with no room.
+		*/
+		ParticlePool();
+
+		/**
+			The deconstructor gives the storage back to its pool.
+		*/
+		~ParticlePool();
+
+		ParticlePool(const ParticlePool&) = delete;
+		ParticlePool& operator=(const ParticlePool&) = delete;
+
+		/**
+			resize sets how many particles fit in the pool and kills
+				every live particle.
+
+				@param1 a_capacity is the maximum amount of particles.
+		*/
+		void resize(unsigned int a_capacity);
+
+		/**
+			clear kills every live particle.
+		*/
+		void clear() { m_count = 0; }
+
+		/**
+			add spawns a particle at the end of the live particles.
+
+				@param1 a_position is where the particle starts.
+
+				@param2 a_velocity is how fast it moves.
+
+				@param3 a_lifespan is how long it lives for in seconds.
+
+				@return false if the pool is full.
+		*/
+		bool add(const glm::vec3& a_position, const glm::vec3& a_velocity, float a_lifespan);
+
+		/**
+			integrate ages every live particle and moves it along its
+				velocity.
+
+				@param1 a_deltaTime is the time since the last update.
+		*/
+		void integrate(float a_deltaTime);
+
+		/**
+			accelerate changes every live particle's velocity by the
+				forces on it, then takes the drag off. It runs before
+				integrate.
+
+				@param1 a_forces are the forces.
+
+				@param2 a_deltaTime is the time since the last update.
+
+				@param3 a_time is how long the emitter has run.
+		*/
+		void accelerate(const ParticleForces& a_forces, float a_deltaTime, float a_time);
+
+		/**
+			kill removes every particle that has outlived its lifespan.
+
+				@return the amount of particles removed.
+		*/
+		unsigned int kill();
+
+		/**
+			interpolate sets the size and colour of every live particle
+				from how far through its life it is.
+
+				@param1 a_startSize is the size of a new particle.
+
+				@param2 a_endSize is the size of a particle about to die.
+
+				@param3 a_startColour is the colour of a new particle.
+
+				@param4 a_endColour is the colour of a particle about to die.
+		*/
+		void interpolate(float a_startSize, float a_endSize,
+			const glm::vec4& a_startColour, const glm::vec4& a_endColour);
+
+		/**
+			writeInstances packs the centre, size and colour of every
+				live particle for the particle shader.
+
+				@param1 a_instances receives one instance per live particle.
+
+				@param2 a_extrapolate moves each centre along its velocity
+						for this many seconds, for frames drawn between
+						fixed simulation steps.
+		*/
+		void writeInstances(Instance* a_instances, float a_extrapolate = 0.0f) const;
+
+		/**
+			getCount returns the amount of live particles.
+		*/
+		unsigned int getCount() const { return m_count; }
+
+		/**
+			getCapacity returns the maximum amount of particles.
+		*/
+		unsigned int getCapacity() const { return m_capacity; }
+
+	private:
+		// Moves the particle at a_from into the slot at a_to.
+		void move(unsigned int a_from, unsigned int a_to);
+
+		// Gives the storage back to its pool.
+		void release();
+
+		// Each stream is padded to a multiple of 4, so the SSE loops never
+		//	need a tail for the streams they only read and write in place.
+		float *m_positionX, *m_positionY, *m_positionZ;
+		float *m_velocityX, *m_velocityY, *m_velocityZ;
+		float *m_lifetime, *m_lifespan;
+		float *m_size;
+		float *m_colourR, *m_colourG, *m_colourB, *m_colourA;
+
+		// The block every stream is in, and the size class it came from.
+		float* m_storage;
+		unsigned int m_sizeClass;
+
+		// The amount of live particles.
+		unsigned int m_count;
+
+		// The maximum amount of particles.
+		unsigned int m_capacity;
+	};
+}
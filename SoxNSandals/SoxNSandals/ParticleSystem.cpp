@@ -0,0 +1,577 @@
+/**
+	ParticleSystem.cpp
+
+	Purpose: ParticleSystem.cpp is the source file for the ParticleSystem
+			class. The ParticleSystem owns every emitter in a scene and
+			updates them in parallel on the job system.
+
+	@author Nathan Nette
+*/
+#include "ParticleSystem.h"
+#include "BlockPool.h"
+#include "Profiler.h"
+#include "RenderState.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// How long each pre-warm job fast-forwards its emitter for, so one
+	//	is never long enough to hold up a frame that picks it up while
+	//	waiting for its own jobs.
+	const float PREWARM_JOB_TIME = 0.25f;
+
+	/**
+		An emitter drawn by the ParticleSystem. It only needs its particle
+			storage, the system owns the buffers it is drawn from.
+	*/
+	class SystemEmitter : public ParticleEmitter
+	{
+	public:
+		virtual void update(float a_deltaTime) override { simulate(a_deltaTime); }
+		virtual void draw() override {}
+
+	protected:
+		virtual void createBuffers() override { m_particles.resize(m_maxParticles); }
+	};
+
+	/**
+		emitterPool returns the pool every system's emitters are made in,
+			so spawning and destroying them doesn't go to the heap.
+	*/
+	sns::BlockPool& emitterPool()
+	{
+		static sns::BlockPool pool(sizeof(SystemEmitter), 64);
+		return pool;
+	}
+
+	/**
+		runPrewarm starts a job that fast-forwards an emitter a little,
+			then starts the next before it finishes, until the whole
+			duration has been run. The counter never reaches zero in
+			between.
+
+			@param1 a_emitter is the emitter.
+
+			@param2 a_counter counts the jobs.
+
+			@param3 a_remaining is how long is left to run it for.
+	*/
+	void runPrewarm(ParticleEmitter* a_emitter, sns::JobCounter* a_counter, float a_remaining)
+	{
+		sns::JobSystem::instance().run([a_emitter, a_counter, a_remaining]()
+		{
+			SNS_PROFILE_SCOPE("Particle prewarm");
+			float duration = std::min(a_remaining, PREWARM_JOB_TIME);
+			a_emitter->prewarm(duration);
+			if (a_remaining > duration)
+				runPrewarm(a_emitter, a_counter, a_remaining - duration);
+		}, a_counter);
+	}
+}
+
+namespace sns
+{
+	ParticleSystem::ParticleSystem()
+		: m_vao(0),
+		m_region(nullptr),
+		m_capacity(0),
+		m_firstInstance(0),
+		m_writing(false),
+		m_cameraPosition(0),
+		m_projectionScale(0),
+		m_sortBudget(0),
+		m_particleBudget(0)
+	{
+	}
+
+	/**
+		The deconstructor waits for running jobs and deletes every
+			emitter.
+	*/
+	ParticleSystem::~ParticleSystem()
+	{
+		wait();
+		finishPrewarm();
+		for (auto& entry : m_emitters)
+			emitterPool().destroy(entry.emitter);
+		glDeleteVertexArrays(1, &m_vao);
+		RenderState::instance().onVertexArrayDeleted(m_vao);
+	}
+
+	/**
+		createEmitter adds an emitter updated on the job system.
+			The parameters are the same as ParticleEmitter::initialise.
+			Must not be called between update and draw.
+
+			@return the emitter, owned by the system.
+	*/
+	ParticleEmitter* ParticleSystem::createEmitter(unsigned int a_maxParticles,
+		unsigned int a_emitRate,
+		float a_lifetimeMin, float a_lifetimeMax,
+		float a_velocityMin, float a_velocityMax,
+		float a_startSize, float a_endSize,
+		const glm::vec4& a_startColour, const glm::vec4& a_endColour,
+		unsigned int a_seed)
+	{
+		// The jobs hold indices into m_emitters.
+		wait();
+
+		ParticleEmitter* emitter = emitterPool().create<SystemEmitter>();
+		emitter->initialise(a_maxParticles, a_emitRate,
+			a_lifetimeMin, a_lifetimeMax,
+			a_velocityMin, a_velocityMax,
+			a_startSize, a_endSize,
+			a_startColour, a_endColour,
+			a_seed);
+
+		// The new slice goes after every other one, the stream grows
+		//	to fit it on the next update.
+		m_emitters.push_back({ emitter, m_capacity, nullptr });
+		m_counts.push_back(0);
+		m_capacity += a_maxParticles;
+		return emitter;
+	}
+
+	/**
+		destroyEmitter deletes an emitter made by createEmitter. Must
+			not be called between update and draw, or while a snapshot
+			is waiting to be drawn, since the slices after it move.
+
+			@param1 a_emitter is the emitter to delete.
+	*/
+	void ParticleSystem::destroyEmitter(ParticleEmitter* a_emitter)
+	{
+		wait();
+
+		for (size_t i = 0; i < m_emitters.size(); ++i)
+		{
+			if (m_emitters[i].emitter != a_emitter)
+				continue;
+			if (m_emitters[i].warming != nullptr)
+				JobSystem::instance().wait(*m_emitters[i].warming);
+
+			// The slices after it move down, so the stream doesn't grow
+			//	as emitters come and go.
+			unsigned int maxParticles = a_emitter->getMaxParticles();
+			for (size_t j = i + 1; j < m_emitters.size(); ++j)
+				m_emitters[j].offset -= maxParticles;
+			m_capacity -= maxParticles;
+
+			emitterPool().destroy(a_emitter);
+			m_emitters.erase(m_emitters.begin() + i);
+			m_counts.erase(m_counts.begin() + i);
+			return;
+		}
+	}
+
+	/**
+		prewarm fast-forwards an emitter on the job system, in jobs that
+			each run it a little, hiding it until they are all done.
+			Each frame's update leaves it alone until then. Pre-warming
+			again while it is warming adds to what is left.
+
+			@param1 a_emitter is an emitter made by createEmitter.
+
+			@param2 a_duration is how long to run it for, 0 for its
+					getPrewarmDuration.
+	*/
+	void ParticleSystem::prewarm(ParticleEmitter* a_emitter, float a_duration)
+	{
+		if (a_duration <= 0.0f)
+			a_duration = a_emitter->getPrewarmDuration();
+
+		// The frames' jobs must be done with it before it is handed to
+		//	the pre-warm jobs.
+		wait();
+		for (Entry& entry : m_emitters)
+		{
+			if (entry.emitter != a_emitter)
+				continue;
+			if (entry.warming == nullptr)
+				entry.warming.reset(new JobCounter());
+			runPrewarm(a_emitter, entry.warming.get(), a_duration);
+			return;
+		}
+	}
+
+	/**
+		isWarming returns whether an emitter is still being pre-warmed.
+
+			@param1 a_emitter is an emitter made by createEmitter.
+	*/
+	bool ParticleSystem::isWarming(const ParticleEmitter* a_emitter) const
+	{
+		for (const Entry& entry : m_emitters)
+		{
+			if (entry.emitter == a_emitter)
+				return entry.warming != nullptr && entry.warming->isDone() == false;
+		}
+		return false;
+	}
+
+	/**
+		finishPrewarm blocks until every emitter is warm, helping to run
+			the jobs in the meantime.
+	*/
+	void ParticleSystem::finishPrewarm()
+	{
+		for (Entry& entry : m_emitters)
+		{
+			if (entry.warming != nullptr)
+			{
+				JobSystem::instance().wait(*entry.warming);
+				entry.warming.reset();
+			}
+		}
+	}
+
+	/**
+		update starts a job per emitter and returns without waiting.
+			Each job simulates its emitter a number of fixed steps,
+			then writes where the particles are at the frame's time.
+
+			@param1 a_timeStep is the length of one step.
+
+			@param2 a_stepCount is how many steps to simulate, 0 only
+					writes the particles again.
+
+			@param3 a_extrapolate is how far the frame is past the last
+					step, in seconds.
+	*/
+	void ParticleSystem::update(float a_timeStep, unsigned int a_stepCount, float a_extrapolate)
+	{
+		if (m_emitters.empty())
+			return;
+
+		// Updating twice without a draw rewrites the same region.
+		wait();
+		if (m_writing == false)
+		{
+			if (m_stream.getElementCount() < m_capacity)
+				createStream();
+			m_region = (ParticleEmitter::ParticleInstance*)m_stream.beginWrite();
+			m_writing = true;
+		}
+		applyDetail();
+		launch(m_region, m_counts.data(), a_timeStep, a_stepCount, a_extrapolate);
+	}
+
+	/**
+		simulate runs the same jobs as update, but writes the particles
+			into a snapshot instead of the stream and waits for them.
+			It doesn't touch opengl, so a simulation thread can fill one
+			snapshot while another is drawn.
+
+			@param1 a_timeStep is the length of one step.
+
+			@param2 a_stepCount is how many steps to simulate.
+
+			@param3 a_extrapolate is how far the frame is past the last
+					step, in seconds.
+
+			@param4 a_snapshot receives every emitter's particles.
+
+			@param5 a_arena is where the snapshot's arrays are allocated,
+					and must outlive drawing it.
+	*/
+	void ParticleSystem::simulate(float a_timeStep, unsigned int a_stepCount, float a_extrapolate,
+		Snapshot& a_snapshot, FrameArena& a_arena)
+	{
+		a_snapshot.instances = a_arena.allocateArray<ParticleEmitter::ParticleInstance>(m_capacity);
+		a_snapshot.counts = a_arena.allocateArray<unsigned int>(m_emitters.size());
+		a_snapshot.emitterCount = (unsigned int)m_emitters.size();
+		a_snapshot.culledCount = 0;
+		if (m_emitters.empty())
+			return;
+
+		wait();
+		a_snapshot.culledCount = applyDetail();
+		launch(a_snapshot.instances, a_snapshot.counts, a_timeStep, a_stepCount, a_extrapolate);
+		wait();
+	}
+
+	/**
+		wait blocks until every job started by update has finished,
+			helping to run jobs in the meantime.
+	*/
+	void ParticleSystem::wait()
+	{
+		JobSystem::instance().wait(m_counter);
+	}
+
+	/**
+		draw waits for the jobs, then draws each emitter's slice.
+			The particle shader must already be bound.
+	*/
+	void ParticleSystem::draw()
+	{
+		{
+			SNS_PROFILE_SCOPE("Particle wait");
+			wait();
+		}
+		if (m_writing == false)
+			return;
+
+		m_firstInstance = m_stream.endWrite(m_capacity);
+
+		drawSlices(m_counts.data());
+		m_writing = false;
+	}
+
+	/**
+		draw copies a snapshot from simulate into the stream and draws
+			it. The particle shader must already be bound, and it can't
+			be used between update and draw.
+
+			@param1 a_snapshot is the particles to draw.
+	*/
+	void ParticleSystem::draw(const Snapshot& a_snapshot)
+	{
+		if (m_writing || a_snapshot.emitterCount != m_emitters.size())
+			return;
+
+		if (m_stream.getElementCount() < m_capacity)
+			createStream();
+
+		// Only the live particles of each slice are copied.
+		auto region = (ParticleEmitter::ParticleInstance*)m_stream.beginWrite();
+		for (size_t i = 0; i < m_emitters.size(); ++i)
+		{
+			unsigned int offset = m_emitters[i].offset;
+			std::memcpy(region + offset, a_snapshot.instances + offset,
+				a_snapshot.counts[i] * sizeof(ParticleEmitter::ParticleInstance));
+		}
+		m_firstInstance = m_stream.endWrite(m_capacity);
+
+		m_counts.assign(a_snapshot.counts, a_snapshot.counts + a_snapshot.emitterCount);
+		drawSlices(m_counts.data());
+	}
+
+	/**
+		redraw draws what the last draw copied into the stream again, for
+			another view of the same frame.
+	*/
+	void ParticleSystem::redraw()
+	{
+		if (m_counts.size() == m_emitters.size())
+			drawSlices(m_counts.data());
+	}
+
+	/**
+		getParticleCount returns the amount of live particles across
+			every emitter, as of the last draw.
+	*/
+	unsigned int ParticleSystem::getParticleCount() const
+	{
+		unsigned int count = 0;
+		for (unsigned int emitterCount : m_counts)
+			count += emitterCount;
+		return count;
+	}
+
+	/**
+		setCamera sets the view the next update or simulate culls and
+			sorts the emitters for. Emitters outside it stop emitting
+			and aren't drawn, and the smaller an emitter is on screen
+			the fewer particles it emits.
+
+			@param1 a_projectionViewModel is the camera's projection view
+					times the emitters' transform.
+
+			@param2 a_position is the camera in the emitters' space.
+
+			@param3 a_projectionScale is how much the projection scales
+					the height of the view, projection[1][1]. 0 turns
+					the scaling off.
+	*/
+	void ParticleSystem::setCamera(const glm::mat4& a_projectionViewModel, const glm::vec3& a_position,
+		float a_projectionScale)
+	{
+		m_frustum.setMatrix(a_projectionViewModel);
+		m_cameraPosition = a_position;
+		m_projectionScale = a_projectionScale;
+	}
+
+	/**
+		applyDetail culls the emitters against the view, then scales
+			each one's emit rate and live particles by its size on
+			screen and the particle budget. No jobs may be running.
+
+			@return how many emitters were culled.
+	*/
+	unsigned int ParticleSystem::applyDetail()
+	{
+		// An emitter this tall on screen, as a fraction of the height,
+		//	gets all its particles, and none get less than MIN_DETAIL.
+		const float FULL_DETAIL_HEIGHT = 0.25f;
+		const float MIN_DETAIL = 1.0f / 16.0f;
+
+		m_visible.resize(m_emitters.size());
+		m_detail.resize(m_emitters.size());
+
+		unsigned int culled = 0;
+		float wanted = 0;
+		for (size_t i = 0; i < m_emitters.size(); ++i)
+		{
+			// Warming emitters belong to their jobs, and aren't drawn.
+			if (updateWarming(m_emitters[i]))
+			{
+				m_visible[i] = 0;
+				m_detail[i] = 0;
+				continue;
+			}
+
+			ParticleEmitter* emitter = m_emitters[i].emitter;
+			glm::vec3 centre;
+			float radius;
+			emitter->getBounds(centre, radius);
+
+			m_visible[i] = m_frustum.isBoxVisible(centre, glm::vec3(radius)) ? 1 : 0;
+			if (m_visible[i] == 0)
+			{
+				m_detail[i] = 0;
+				++culled;
+				continue;
+			}
+
+			// The height of the bounds over the height of the view,
+			//	which is the whole view once the camera is inside them.
+			float detail = 1;
+			if (m_projectionScale > 0)
+			{
+				float distance = std::max(glm::length(centre - m_cameraPosition), radius);
+				float height = radius * m_projectionScale / distance;
+				detail = glm::clamp(height / FULL_DETAIL_HEIGHT, MIN_DETAIL, 1.0f);
+			}
+			m_detail[i] = detail;
+			wanted += detail * emitter->getMaxParticles();
+		}
+
+		// Over the budget, every emitter gives up the same share.
+		float budgetScale = 1;
+		if (m_particleBudget > 0 && wanted > m_particleBudget)
+			budgetScale = m_particleBudget / wanted;
+
+		for (size_t i = 0; i < m_emitters.size(); ++i)
+		{
+			if (m_emitters[i].warming != nullptr)
+				continue;
+
+			ParticleEmitter* emitter = m_emitters[i].emitter;
+			float detail = m_detail[i] * budgetScale;
+			emitter->setDetail(detail, (unsigned int)(detail * emitter->getMaxParticles() + 0.5f));
+		}
+		return culled;
+	}
+
+	/**
+		launch starts a job per emitter. Each simulates its emitter,
+			then writes its particles to its slice of a region.
+
+			@param1 a_region is where the slices start.
+
+			@param2 a_counts receives how many particles each emitter wrote.
+
+			@param3 a_timeStep is the length of one step.
+
+			@param4 a_stepCount is how many steps to simulate.
+
+			@param5 a_extrapolate is how far the frame is past the last step.
+	*/
+	void ParticleSystem::launch(ParticleEmitter::ParticleInstance* a_region, unsigned int* a_counts,
+		float a_timeStep, unsigned int a_stepCount, float a_extrapolate)
+	{
+		JobSystem& jobs = JobSystem::instance();
+		unsigned int sortBudget = m_sortBudget;
+		glm::vec3 sortPosition = m_cameraPosition;
+		for (size_t i = 0; i < m_emitters.size(); ++i)
+		{
+			// applyDetail has just checked which are still warming.
+			if (m_emitters[i].warming != nullptr)
+			{
+				a_counts[i] = 0;
+				continue;
+			}
+
+			// The budget is handed out on the counts before this update's
+			//	steps, which are close enough to the counts after.
+			bool visible = m_visible[i] != 0;
+			unsigned int particleCount = m_emitters[i].emitter->getParticleCount();
+			bool sorted = visible && particleCount > 1 && particleCount <= sortBudget;
+			if (sorted)
+				sortBudget -= particleCount;
+
+			jobs.run([this, i, a_region, a_counts, a_timeStep, a_stepCount, a_extrapolate,
+				visible, sorted, sortPosition]()
+			{
+				SNS_PROFILE_SCOPE("Particle simulate");
+				Entry& entry = m_emitters[i];
+				for (unsigned int step = 0; step < a_stepCount; ++step)
+					entry.emitter->simulate(a_timeStep);
+
+				// Culled emitters still age their particles, so they
+				//	don't come back into view frozen.
+				if (visible == false)
+					a_counts[i] = 0;
+				else if (sorted)
+					a_counts[i] = entry.emitter->writeSortedInstances(a_region + entry.offset, a_extrapolate, sortPosition);
+				else
+					a_counts[i] = entry.emitter->writeInstances(a_region + entry.offset, a_extrapolate);
+			}, &m_counter);
+		}
+	}
+
+	/**
+		updateWarming returns whether an entry is still warming. Once its
+			jobs are done the counter is waited on, which returns
+			straight away, so the last job is finished with it before
+			it is deleted.
+
+			@param1 a_entry is the entry.
+	*/
+	bool ParticleSystem::updateWarming(Entry& a_entry)
+	{
+		if (a_entry.warming == nullptr)
+			return false;
+		if (a_entry.warming->isDone() == false)
+			return true;
+
+		JobSystem::instance().wait(*a_entry.warming);
+		a_entry.warming.reset();
+		return false;
+	}
+
+	/**
+		drawSlices draws each emitter's slice of the region last written
+			to the stream, then fences it.
+
+			@param1 a_counts is how many particles each slice holds.
+	*/
+	void ParticleSystem::drawSlices(const unsigned int* a_counts)
+	{
+		ParticleEmitter::bindVertexArray(m_vao, m_stream.getHandle());
+		for (size_t i = 0; i < m_emitters.size(); ++i)
+		{
+			if (a_counts[i] > 0)
+			{
+				RenderState::instance().countDraw();
+				glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4,
+					a_counts[i], m_firstInstance + m_emitters[i].offset);
+			}
+		}
+
+		m_stream.fence();
+	}
+
+	/**
+		createStream makes the stream big enough for every emitter's slice.
+	*/
+	void ParticleSystem::createStream()
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		RenderState::instance().onVertexArrayDeleted(m_vao);
+		m_stream.create(sizeof(ParticleEmitter::ParticleInstance), m_capacity, "ParticleSystem");
+		m_vao = ParticleEmitter::createVertexArray(m_stream.getHandle());
+	}
+}
@@ -0,0 +1,309 @@
+/**
+	ParticleSystem.h
+
+	Purpose: ParticleSystem.h is the header file for the ParticleSystem
+			class. The ParticleSystem owns every emitter in a scene and
+			updates them in parallel on the job system.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "FrameArena.h"
+#include "Frustum.h"
+#include "ParticleEmitter.h"
+#include "StreamingBuffer.h"
+#include "JobSystem.h"
+#include <memory>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The ParticleSystem class updates many emitters at once. Each
+			emitter is simulated as its own job and writes its particles
+			into its own slice of one shared streaming buffer, so the
+			tasks never touch each other's memory.
+
+		update starts the jobs and returns straight away, and draw
+			waits for them, so anything drawn in between overlaps with
+			the particle work.
+
+		An emitter can be pre-warmed as it is spawned, fast-forwarded by
+			jobs of their own over the next few frames. It isn't
+			simulated or drawn until it is warm, so it appears already
+			running, and the frame that spawns it doesn't wait.
+	*/
+	class ParticleSystem
+	{
+	public:
+		/**
+			The particles of every emitter at one moment, filled by
+				simulate and drawn by draw. Each emitter's particles
+				start at the same offset as its slice of the stream.
+				Both arrays are in the arena simulate was given.
+		*/
+		struct Snapshot
+		{
+			ParticleEmitter::ParticleInstance* instances = nullptr;
+			unsigned int* counts = nullptr;
+			unsigned int emitterCount = 0;
+
+			// How many emitters were outside the view.
+			unsigned int culledCount = 0;
+		};
+
+		ParticleSystem();
+
+		/**
+			The deconstructor waits for running jobs and deletes every
+				emitter.
+		*/
+		~ParticleSystem();
+
+		ParticleSystem(const ParticleSystem&) = delete;
+		ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+		/**
+			createEmitter adds an emitter updated on the job system.
+				The parameters are the same as ParticleEmitter::initialise.
+				Must not be called between update and draw.
+
+				@return the emitter, owned by the system.
+		*/
+		ParticleEmitter* createEmitter(unsigned int a_maxParticles,
+			unsigned int a_emitRate,
+			float a_lifetimeMin, float a_lifetimeMax,
+			float a_velocityMin, float a_velocityMax,
+			float a_startSize, float a_endSize,
+			const glm::vec4& a_startColour, const glm::vec4& a_endColour,
+			unsigned int a_seed = 0);
+
+		/**
+			destroyEmitter deletes an emitter made by createEmitter. Must
+				not be called between update and draw, or while a
+				snapshot is waiting to be drawn, since the slices after
+				it move.
+
+				@param1 a_emitter is the emitter to delete.
+		*/
+		void destroyEmitter(ParticleEmitter* a_emitter);
+
+		/**
+			prewarm fast-forwards an emitter on the job system, hiding it
+				until it is done. Must not be called between update and
+				draw.
+
+				@param1 a_emitter is an emitter made by createEmitter.
+
+				@param2 a_duration is how long to run it for, 0 for its
+						getPrewarmDuration.
+		*/
+		void prewarm(ParticleEmitter* a_emitter, float a_duration = 0.0f);
+
+		/**
+			isWarming returns whether an emitter is still being
+				pre-warmed.
+
+				@param1 a_emitter is an emitter made by createEmitter.
+		*/
+		bool isWarming(const ParticleEmitter* a_emitter) const;
+
+		/**
+			finishPrewarm blocks until every emitter is warm, helping to
+				run the jobs in the meantime. For changing the emitters
+				from outside, such as restarting them.
+		*/
+		void finishPrewarm();
+
+		/**
+			update starts a job per emitter and returns without waiting.
+				Each job simulates its emitter a number of fixed steps,
+				then writes where the particles are at the frame's time.
+
+				@param1 a_timeStep is the length of one step.
+
+				@param2 a_stepCount is how many steps to simulate, 0 only
+						writes the particles again.
+
+				@param3 a_extrapolate is how far the frame is past the
+						last step, in seconds.
+		*/
+		void update(float a_timeStep, unsigned int a_stepCount = 1, float a_extrapolate = 0.0f);
+
+		/**
+			simulate runs the same jobs as update, but writes the
+				particles into a snapshot instead of the stream and
+				waits for them. It doesn't touch opengl, so it can run
+				on a simulation thread.
+
+				@param1 a_timeStep is the length of one step.
+
+				@param2 a_stepCount is how many steps to simulate.
+
+				@param3 a_extrapolate is how far the frame is past the
+						last step, in seconds.
+
+				@param4 a_snapshot receives every emitter's particles.
+
+				@param5 a_arena is where the snapshot's arrays are
+						allocated, and must outlive drawing it.
+		*/
+		void simulate(float a_timeStep, unsigned int a_stepCount, float a_extrapolate,
+			Snapshot& a_snapshot, FrameArena& a_arena);
+
+		/**
+			wait blocks until every job started by update has finished,
+				helping to run jobs in the meantime.
+		*/
+		void wait();
+
+		/**
+			draw waits for the jobs, then draws each emitter's slice.
+				The particle shader must already be bound.
+		*/
+		void draw();
+
+		/**
+			draw copies a snapshot from simulate into the stream and
+				draws it. The particle shader must already be bound,
+				and it can't be used between update and draw.
+
+				@param1 a_snapshot is the particles to draw.
+		*/
+		void draw(const Snapshot& a_snapshot);
+
+		/**
+			redraw draws what the last draw copied into the stream
+				again, for another view of the same frame.
+		*/
+		void redraw();
+
+		/**
+			getParticleCount returns the amount of live particles across
+				every emitter, as of the last draw.
+		*/
+		unsigned int getParticleCount() const;
+
+		/**
+			getEmitterCount returns the amount of emitters.
+		*/
+		unsigned int getEmitterCount() const { return (unsigned int)m_emitters.size(); }
+
+		/**
+			getEmitter returns an emitter, in the order they were created.
+
+				@param1 a_index is the emitter, from 0.
+		*/
+		ParticleEmitter* getEmitter(unsigned int a_index) const { return m_emitters[a_index].emitter; }
+
+		/**
+			setCamera sets the view the next update or simulate culls
+				and sorts the emitters for. Emitters outside it stop
+				emitting and aren't drawn, and the smaller an emitter
+				is on screen the fewer particles it emits.
+
+				@param1 a_projectionViewModel is the camera's projection
+						view times the emitters' transform.
+
+				@param2 a_position is the camera in the emitters' space.
+
+				@param3 a_projectionScale is how much the projection
+						scales the height of the view, projection[1][1].
+						0 turns the scaling off.
+		*/
+		void setCamera(const glm::mat4& a_projectionViewModel, const glm::vec3& a_position,
+			float a_projectionScale);
+
+		/**
+			setParticleBudget sets the most particles alive across every
+				emitter. Once the emitters want more than that, they are
+				all scaled down by the same amount. 0, the default, is
+				no limit.
+
+				@param1 a_budget is the most particles alive at once.
+		*/
+		void setParticleBudget(unsigned int a_budget) { m_particleBudget = a_budget; }
+
+		/**
+			setSortBudget sets the most particles sorted each update.
+				Emitters are given the budget in the order they were
+				created, and the ones it runs out before are drawn
+				unsorted. 0, the default, never sorts.
+
+				@param1 a_budget is the most particles to sort.
+		*/
+		void setSortBudget(unsigned int a_budget) { m_sortBudget = a_budget; }
+
+	private:
+		/**
+			One emitter and where its slice of the stream starts. While
+				it is pre-warmed, warming counts its job.
+		*/
+		struct Entry
+		{
+			ParticleEmitter* emitter;
+			unsigned int offset;
+			std::unique_ptr<JobCounter> warming;
+		};
+
+		// Whether an entry is still warming, forgetting its counter
+		//	once it is done.
+		bool updateWarming(Entry& a_entry);
+
+		// Culls the emitters and scales them for their size on screen
+		//	and the particle budget, returning how many were culled.
+		unsigned int applyDetail();
+
+		// Starts a job per emitter, writing its particles to its slice.
+		void launch(ParticleEmitter::ParticleInstance* a_region, unsigned int* a_counts,
+			float a_timeStep, unsigned int a_stepCount, float a_extrapolate);
+
+		// Draws each emitter's slice of the region last written.
+		void drawSlices(const unsigned int* a_counts);
+
+		// Makes the stream big enough for every emitter's slice.
+		void createStream();
+
+		// Every emitter, in the order they were created.
+		std::vector<Entry> m_emitters;
+
+		// How many particles each emitter has in the region last drawn.
+		std::vector<unsigned int> m_counts;
+
+		// The instances of every emitter, one slice after another.
+		StreamingBuffer m_stream;
+
+		// Reads the stream as particle instances.
+		unsigned int m_vao;
+
+		// The region of the stream update is writing to.
+		ParticleEmitter::ParticleInstance* m_region;
+
+		// The total of every emitter's maximum, what the stream holds.
+		unsigned int m_capacity;
+
+		// Where this frame's region starts in the stream.
+		unsigned int m_firstInstance;
+
+		// Whether update has written a region that draw hasn't drawn.
+		bool m_writing;
+
+		// The view from setCamera, and where the particles are sorted from.
+		Frustum m_frustum;
+		glm::vec3 m_cameraPosition;
+		float m_projectionScale;
+
+		// The most particles sorted, and alive, each update.
+		unsigned int m_sortBudget;
+		unsigned int m_particleBudget;
+
+		// Whether each emitter was in the view, and how much of its
+		//	detail it wanted, as of the last applyDetail.
+		std::vector<unsigned char> m_visible;
+		std::vector<float> m_detail;
+
+		// Counts the jobs still running, so wait doesn't depend on
+		//	anything else the job system is running.
+		JobCounter m_counter;
+	};
+}
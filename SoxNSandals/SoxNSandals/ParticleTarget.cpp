@@ -0,0 +1,263 @@
+/**
+	ParticleTarget.cpp
+
+	Purpose: ParticleTarget.cpp is the source file for the ParticleTarget
+			class. The ParticleTarget draws particles into a smaller
+			render target and blends them back over the scene, so
+			effects with a lot of overdraw cost a fraction of the fill.
+
+	@author Nathan Nette
+*/
+#include "ParticleTarget.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	// The units the upsample shader reads the target from, after the
+	//	scene's depth.
+	static const unsigned int COLOUR_UNIT = ParticleTarget::SCENE_DEPTH_UNIT + 1;
+	static const unsigned int DEPTH_UNIT = ParticleTarget::SCENE_DEPTH_UNIT + 2;
+
+	ParticleTarget::ParticleTarget()
+		: m_sceneDepthFramebuffer(0),
+		m_sceneDepthTexture(0),
+		m_framebuffer(0),
+		m_colourTexture(0),
+		m_depthTexture(0),
+		m_vao(0),
+		m_width(0),
+		m_height(0),
+		m_divisor(1),
+		m_renderWidth(0),
+		m_renderHeight(0),
+		m_targetWidth(0),
+		m_targetHeight(0),
+		m_depthRange(0),
+		m_previousFramebuffer(0),
+		m_previousViewport()
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffers and textures.
+	*/
+	ParticleTarget::~ParticleTarget()
+	{
+		destroy();
+	}
+
+	// Makes a render target, read only with texelFetch.
+	static unsigned int createTarget(unsigned int a_format, int a_width, int a_height)
+	{
+		unsigned int texture = 0;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, a_format, a_width, a_height);
+		GpuMemory::instance().trackTexture(texture, GpuMemory::getTextureBytes(a_format, a_width, a_height),
+			GpuMemory::RENDER_TARGETS, "ParticleTarget");
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		return texture;
+	}
+
+	/**
+		create makes the targets and loads the upsample shader.
+
+			@param1 a_width is the width of the window.
+
+			@param2 a_height is the height of the window.
+
+			@param3 a_divisor is how many times smaller the target is on
+					each side, usually 1, 2 or 4.
+
+			@return false without GL 4.5 or the shader, the target is
+					left uncreated.
+	*/
+	bool ParticleTarget::create(int a_width, int a_height, int a_divisor)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("ParticleTarget: the particle target needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_upsampleShader.getHandle() == 0)
+		{
+			m_upsampleShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleUpsample.vert");
+			m_upsampleShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/particleUpsample.frag");
+			if (m_upsampleShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_upsampleShader.getLastError());
+				return false;
+			}
+		}
+
+		m_width = a_width > 1 ? a_width : 1;
+		m_height = a_height > 1 ? a_height : 1;
+		m_divisor = a_divisor > 1 ? a_divisor : 1;
+		int targetWidth = (m_width + m_divisor - 1) / m_divisor;
+		int targetHeight = (m_height + m_divisor - 1) / m_divisor;
+
+		// The depth matches the scene's, so it can be blitted out of it.
+		//	Half floats, so many faint particles add up without banding.
+		m_colourTexture = createTarget(GL_RGBA16F, targetWidth, targetHeight);
+		m_depthTexture = createTarget(RenderState::instance().getDepthFormat(), targetWidth, targetHeight);
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_colourTexture, 0);
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_depthTexture, 0);
+		if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("ParticleTarget: the particle target isn't complete.\n");
+			destroy();
+			return false;
+		}
+
+		glCreateVertexArrays(1, &m_vao);
+		return true;
+	}
+
+	/**
+		begin copies the scene's depth under the viewport, then binds and
+			clears the target.
+			The particles are drawn after it with depth writes off.
+
+			@param1 a_projection is the camera's projection, used to turn
+					depth back into a distance.
+
+			@param2 a_sceneDepthFramebuffer draws into a_sceneDepthTexture.
+
+			@param3 a_sceneDepthTexture is where the scene's depth is
+					copied, the window's size and
+					RenderState::getDepthFormat, until end.
+	*/
+	void ParticleTarget::begin(const glm::mat4& a_projection, unsigned int a_sceneDepthFramebuffer,
+		unsigned int a_sceneDepthTexture)
+	{
+		m_sceneDepthFramebuffer = a_sceneDepthFramebuffer;
+		m_sceneDepthTexture = a_sceneDepthTexture;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+
+		// With a GL projection the distance is [3][2] / (ndc z + [2][2]).
+		//	Reversed depth is already ndc z, GL's usual depth is moved back
+		//	to -1 to 1 and the signs flipped, so the bottom is positive.
+		if (RenderState::instance().isReverseZ())
+			m_depthRange = glm::vec3(a_projection[3][2], 1.0f, a_projection[2][2]);
+		else
+			m_depthRange = glm::vec3(-a_projection[3][2], -2.0f, 1.0f - a_projection[2][2]);
+
+		// Depth only blits with GL_NEAREST, which picks one of the pixels
+		//	under each texel. The upsample sorts out the edges.
+		m_renderWidth = std::min(std::max(m_previousViewport[2], 1), m_width);
+		m_renderHeight = std::min(std::max(m_previousViewport[3], 1), m_height);
+		m_targetWidth = (m_renderWidth + m_divisor - 1) / m_divisor;
+		m_targetHeight = (m_renderHeight + m_divisor - 1) / m_divisor;
+		glBlitNamedFramebuffer(m_previousFramebuffer, m_sceneDepthFramebuffer, 0, 0, m_renderWidth, m_renderHeight,
+			0, 0, m_renderWidth, m_renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBlitNamedFramebuffer(m_sceneDepthFramebuffer, m_framebuffer, 0, 0, m_renderWidth, m_renderHeight,
+			0, 0, m_targetWidth, m_targetHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glViewport(0, 0, m_targetWidth, m_targetHeight);
+
+		// Premultiplied, so clear is nothing drawn over the scene.
+		const float clearColour[4] = { 0, 0, 0, 0 };
+		glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, 0, clearColour);
+	}
+
+	/**
+		bind sets the particle shader's soft particle uniforms and binds
+			the scene's depth for it.
+
+			@param1 a_shader is the particle shader, already bound.
+
+			@param2 a_softDistance is how far in front of the scene a
+					particle fades out over, in world units.
+	*/
+	void ParticleTarget::bind(aie::ShaderProgram& a_shader, float a_softDistance) const
+	{
+		static constexpr aie::UniformHandle SCENE_DEPTH("SceneDepth");
+		static constexpr aie::UniformHandle SOFT_DISTANCE("SoftDistance");
+		static constexpr aie::UniformHandle TARGET_SCALE("TargetScale");
+		static constexpr aie::UniformHandle DEPTH_RANGE("DepthRange");
+
+		RenderState::instance().bindTexture(SCENE_DEPTH_UNIT, m_sceneDepthTexture);
+		a_shader.bindUniform(SCENE_DEPTH, (int)SCENE_DEPTH_UNIT);
+		a_shader.bindUniform(SOFT_DISTANCE, a_softDistance);
+		a_shader.bindUniform(TARGET_SCALE, (float)m_divisor);
+		a_shader.bindUniform(DEPTH_RANGE, m_depthRange);
+	}
+
+	/**
+		end puts back the framebuffer and viewport begin replaced and
+			blends the particles over it.
+	*/
+	void ParticleTarget::end()
+	{
+		static constexpr aie::UniformHandle SCENE_DEPTH("SceneDepth");
+		static constexpr aie::UniformHandle PARTICLES("Particles");
+		static constexpr aie::UniformHandle PARTICLE_DEPTH("ParticleDepth");
+		static constexpr aie::UniformHandle DIVISOR("Divisor");
+		static constexpr aie::UniformHandle DEPTH_RANGE("DepthRange");
+		static constexpr aie::UniformHandle LAST_TEXEL("LastTexel");
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+		glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+
+		RenderState& state = RenderState::instance();
+		state.bindTexture(SCENE_DEPTH_UNIT, m_sceneDepthTexture);
+		state.bindTexture(COLOUR_UNIT, m_colourTexture);
+		state.bindTexture(DEPTH_UNIT, m_depthTexture);
+
+		m_upsampleShader.bind();
+		m_upsampleShader.bindUniform(SCENE_DEPTH, (int)SCENE_DEPTH_UNIT);
+		m_upsampleShader.bindUniform(PARTICLES, (int)COLOUR_UNIT);
+		m_upsampleShader.bindUniform(PARTICLE_DEPTH, (int)DEPTH_UNIT);
+		m_upsampleShader.bindUniform(DIVISOR, m_divisor);
+		m_upsampleShader.bindUniform(DEPTH_RANGE, m_depthRange);
+		m_upsampleShader.bindUniform(LAST_TEXEL, glm::vec2(m_targetWidth - 1, m_targetHeight - 1));
+
+		// One triangle over the whole window. The particles were depth
+		//	tested into the target, so nothing is tested again, and the
+		//	test goes back on for whatever draws next.
+		state.setDepthTest(false);
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		state.setDepthTest(true);
+	}
+
+	/**
+		destroy deletes the framebuffers and textures.
+	*/
+	void ParticleTarget::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		unsigned int* textures[2] = { &m_colourTexture, &m_depthTexture };
+		for (unsigned int* texture : textures)
+		{
+			if (*texture != 0)
+			{
+				glDeleteTextures(1, texture);
+				state.onTextureDeleted(*texture);
+				GpuMemory::instance().releaseTexture(*texture);
+				*texture = 0;
+			}
+		}
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_sceneDepthFramebuffer = m_framebuffer = 0;
+		m_sceneDepthTexture = 0;
+
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			state.onVertexArrayDeleted(m_vao);
+			m_vao = 0;
+		}
+		m_width = m_height = 0;
+	}
+}
@@ -0,0 +1,154 @@
+/**
+	ParticleTarget.h
+
+	Purpose: ParticleTarget.h is the header file for the ParticleTarget
+			class. The ParticleTarget draws particles into a smaller
+			render target and blends them back over the scene, so
+			effects with a lot of overdraw cost a fraction of the fill.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+namespace sns
+{
+	/**
+		The ParticleTarget class owns a colour and depth target at a
+			fraction of the window's size. begin copies the scene's
+			depth into a target it is given at the window's size and
+			then into its own, so the particles are still hidden behind
+			the scene, and end upsamples what was drawn back over the
+			framebuffer.
+
+		The upsample weights the four target texels around each pixel
+			by how close their depth is to the pixel's, so particles
+			don't bleed over the edges of what is in front of them.
+
+		The particles are drawn premultiplied by alpha, blended with
+			GL_ONE and GL_ONE_MINUS_SRC_ALPHA, and also read the full
+			size depth to fade out where they meet the scene. That
+			fade works at a divisor of 1 too.
+
+		Only as much of the framebuffer as the viewport bound at begin
+			covers is copied and drawn over, so a scene drawn into part
+			of a bigger target has particles at its own size.
+
+		Everything needs GL 4.5, without it create fails and particles
+			should be drawn straight into the framebuffer.
+	*/
+	class ParticleTarget
+	{
+	public:
+		// The unit the particle shader reads the scene's depth from.
+		static const unsigned int SCENE_DEPTH_UNIT = 12;
+
+		ParticleTarget();
+
+		/**
+			The deconstructor deletes the framebuffers and textures.
+		*/
+		~ParticleTarget();
+
+		ParticleTarget(const ParticleTarget&) = delete;
+		ParticleTarget& operator=(const ParticleTarget&) = delete;
+
+		/**
+			create makes the targets and loads the upsample shader.
+
+				@param1 a_width is the width of the window.
+
+				@param2 a_height is the height of the window.
+
+				@param3 a_divisor is how many times smaller the target
+						is on each side, usually 1, 2 or 4.
+
+				@return false without GL 4.5 or the shader, the target
+						is left uncreated.
+		*/
+		bool create(int a_width, int a_height, int a_divisor);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_colourTexture != 0; }
+
+		/**
+			begin copies the scene's depth under the viewport, then binds
+				and clears the target. The particles are drawn after it
+				with depth writes off.
+
+				@param1 a_projection is the camera's projection, used to
+						turn depth back into a distance.
+
+				@param2 a_sceneDepthFramebuffer draws into
+						a_sceneDepthTexture.
+
+				@param3 a_sceneDepthTexture is where the scene's depth is
+						copied, the window's size and
+						RenderState::getDepthFormat, until end.
+		*/
+		void begin(const glm::mat4& a_projection, unsigned int a_sceneDepthFramebuffer,
+			unsigned int a_sceneDepthTexture);
+
+		/**
+			bind sets the particle shader's soft particle uniforms and
+				binds the scene's depth for it.
+
+				@param1 a_shader is the particle shader, already bound.
+
+				@param2 a_softDistance is how far in front of the scene a
+						particle fades out over, in world units.
+		*/
+		void bind(aie::ShaderProgram& a_shader, float a_softDistance) const;
+
+		/**
+			end puts back the framebuffer and viewport begin replaced and
+				blends the particles over it.
+		*/
+		void end();
+
+		/**
+			getDivisor returns how many times smaller the target is.
+		*/
+		int getDivisor() const { return m_divisor; }
+
+	private:
+		// Deletes the framebuffers and textures.
+		void destroy();
+
+		// Blends the target back over the framebuffer.
+		aie::ShaderProgram m_upsampleShader;
+
+		// The scene's depth at the window's size, given to begin.
+		unsigned int m_sceneDepthFramebuffer;
+		unsigned int m_sceneDepthTexture;
+
+		// The particles, and the scene's depth at the target's size.
+		unsigned int m_framebuffer;
+		unsigned int m_colourTexture;
+		unsigned int m_depthTexture;
+
+		// An empty vertex array for the upsample's full screen triangle.
+		unsigned int m_vao;
+
+		int m_width;
+		int m_height;
+		int m_divisor;
+
+		// How much of the window and of the target this frame covers.
+		int m_renderWidth;
+		int m_renderHeight;
+		int m_targetWidth;
+		int m_targetHeight;
+
+		// The projection's terms that turn depth into distance.
+		glm::vec3 m_depthRange;
+
+		// The framebuffer and viewport bound before begin.
+		int m_previousFramebuffer;
+		int m_previousViewport[4];
+	};
+}
@@ -0,0 +1,467 @@
+/**
+	PlanetRenderer.cpp
+
+	Purpose: PlanetRenderer.cpp is the source file for the
+			PlanetRenderer class. The PlanetRenderer draws planets as cube
+			spheres, each face a quadtree of patches split finer the
+			nearer the camera is, so a planet can be flown to from orbit
+			down to its ground.
+
+	@author Nathan Nette
+*/
+#include "PlanetRenderer.h"
+#include "Frustum.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// Each face's normal and the two directions across it, u cross v
+	//	being the normal, as the vertex shader has them. The faces are
+	//	+X, -X, +Y, -Y, +Z then -Z.
+	static const glm::vec3 FACE_NORMALS[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 },
+		{ 0, 0, 1 }, { 0, 0, -1 } };
+	static const glm::vec3 FACE_US[6] = { { 0, 0, -1 }, { 0, 0, 1 }, { 1, 0, 0 }, { 1, 0, 0 }, { 1, 0, 0 },
+		{ -1, 0, 0 } };
+	static const glm::vec3 FACE_VS[6] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 },
+		{ 0, 1, 0 } };
+
+	// How far a patch's ground can be from its centre on the sphere, in
+	//	its own sizes, a little over half its diagonal.
+	static const float BOUND_SCALE = 0.71f;
+
+	PlanetRenderer::PlanetRenderer()
+		: m_variantFirst(),
+		m_variantCount(),
+		m_frustum(nullptr),
+		m_cameraPosition(0),
+		m_detail(3.0f),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffers and vertex array.
+	*/
+	PlanetRenderer::~PlanetRenderer()
+	{
+		destroy();
+	}
+
+	/**
+		create loads the shader and builds the patch mesh.
+
+			@return false without GL 4.5 or the shader, it is left
+					uncreated.
+	*/
+	bool PlanetRenderer::create()
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("PlanetRenderer: drawing the planets needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_shader.getHandle() == 0)
+		{
+			m_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/planet.vert");
+			m_shader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/planet.frag");
+			if (m_shader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_shader.getLastError());
+				return false;
+			}
+		}
+
+		createIndices();
+		m_instances.create(sizeof(Instance), MAX_PATCHES, "PlanetRenderer");
+
+		// The instances are the only vertex buffer, the grid is made from
+		//	the vertex index.
+		glCreateVertexArrays(1, m_vao.put());
+		for (unsigned int attribute = 0; attribute < 4; ++attribute)
+		{
+			glEnableVertexArrayAttrib(m_vao, attribute);
+			glVertexArrayAttribFormat(m_vao, attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * attribute);
+			glVertexArrayAttribBinding(m_vao, attribute, 0);
+		}
+		glVertexArrayBindingDivisor(m_vao, 0, 1);
+		glVertexArrayVertexBuffer(m_vao, 0, m_instances.getHandle(), 0, sizeof(Instance));
+		glVertexArrayElementBuffer(m_vao, m_indices);
+		return true;
+	}
+
+	/**
+		destroy deletes the buffers and vertex array.
+	*/
+	void PlanetRenderer::destroy()
+	{
+		m_vao.reset();
+		m_indices.reset();
+		m_instances.destroy();
+	}
+
+	/**
+		addPlanet adds a planet to draw until the next clear.
+
+			@param1 a_centre is its centre.
+
+			@param2 a_radius is its radius at sea level.
+
+			@param3 a_colour is its colour.
+
+			@param4 a_height is how far the noise lifts and sinks its
+					ground, as a share of its radius.
+
+			@param5 a_seed picks its hills.
+	*/
+	void PlanetRenderer::addPlanet(const glm::vec3& a_centre, float a_radius, const glm::vec4& a_colour,
+		float a_height, float a_seed)
+	{
+		m_planets.push_back({ a_centre, a_radius, a_colour, glm::clamp(a_height, 0.0f, 0.5f), a_seed });
+	}
+
+	/**
+		draw splits and culls every planet's patches for a view and draws
+			them with the planets' shader.
+
+			@param1 a_cullProjectionView is the view the patches are
+					culled against.
+
+			@param2 a_cameraPosition is where the patches are split by
+					their distance from.
+
+			@param3 a_sunPosition is what lights the planets.
+	*/
+	void PlanetRenderer::draw(const glm::mat4& a_cullProjectionView, const glm::vec3& a_cameraPosition,
+		const glm::vec3& a_sunPosition)
+	{
+		static constexpr aie::UniformHandle SUN_POSITION("SunPosition");
+
+		m_stats = {};
+		if (isCreated() == false || m_planets.empty())
+			return;
+
+		Frustum frustum(a_cullProjectionView);
+		m_frustum = &frustum;
+		m_cameraPosition = a_cameraPosition;
+		for (auto& variant : m_variants)
+			variant.clear();
+		for (auto& planet : m_planets)
+		{
+			for (unsigned int face = 0; face < 6; ++face)
+				addPatch(planet, { face, 0, 0, 0 });
+		}
+		m_frustum = nullptr;
+		if (m_stats.patches == 0)
+			return;
+
+		// The patches are written grouped by the index list they use, so
+		//	each group is one draw.
+		Instance* region = (Instance*)m_instances.beginWrite();
+		unsigned int written = 0;
+		unsigned int variantFirst[16];
+		for (unsigned int variant = 0; variant < 16; ++variant)
+		{
+			variantFirst[variant] = written;
+			if (m_variants[variant].empty() == false)
+				memcpy(region + written, m_variants[variant].data(), m_variants[variant].size() * sizeof(Instance));
+			written += (unsigned int)m_variants[variant].size();
+		}
+		unsigned int firstInstance = m_instances.endWrite(written);
+
+		m_shader.bind();
+		m_shader.bindUniform(SUN_POSITION, a_sunPosition);
+
+		RenderState& state = RenderState::instance();
+		state.bindVertexArray(m_vao);
+		for (unsigned int variant = 0; variant < 16; ++variant)
+		{
+			if (m_variants[variant].empty())
+				continue;
+
+			state.countDraw();
+			glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_variantCount[variant], GL_UNSIGNED_SHORT,
+				(void*)(m_variantFirst[variant] * sizeof(uint16_t)), (int)m_variants[variant].size(),
+				firstInstance + variantFirst[variant]);
+			++m_stats.draws;
+		}
+		m_instances.fence();
+	}
+
+	/**
+		createIndices builds the 16 index lists into one buffer. Each is
+			the grid's inside as quads, then a strip along each edge
+			between its outer vertices and the ring inside them, with
+			every other outer vertex skipped on the coarse edges. The
+			strips meet on the diagonals of the corner quads whichever
+			way each edge is, so any mix of edges fits together.
+	*/
+	void PlanetRenderer::createIndices()
+	{
+		std::vector<uint16_t> indices;
+		const int last = (int)GRID;
+
+		// Adds a triangle of grid points, turned to go anticlockwise in u
+		//	and v, which is anticlockwise seen from outside the planet.
+		auto triangle = [&indices](glm::ivec2 a_a, glm::ivec2 a_b, glm::ivec2 a_c)
+		{
+			int cross = (a_b.x - a_a.x) * (a_c.y - a_a.y) - (a_b.y - a_a.y) * (a_c.x - a_a.x);
+			if (cross < 0)
+				std::swap(a_b, a_c);
+			for (const glm::ivec2& point : { a_a, a_b, a_c })
+				indices.push_back((uint16_t)(point.y * (GRID + 1) + point.x));
+		};
+
+		for (unsigned int variant = 0; variant < 16; ++variant)
+		{
+			m_variantFirst[variant] = (unsigned int)indices.size();
+
+			for (int y = 1; y < last - 1; ++y)
+			{
+				for (int x = 1; x < last - 1; ++x)
+				{
+					triangle({ x, y }, { x + 1, y }, { x + 1, y + 1 });
+					triangle({ x, y }, { x + 1, y + 1 }, { x, y + 1 });
+				}
+			}
+
+			for (unsigned int edge = 0; edge < 4; ++edge)
+			{
+				// The k-th vertex along the edge, and along the ring one in.
+				auto outer = [edge, last](int a_k)
+				{
+					switch (edge)
+					{
+					case 0: return glm::ivec2(0, a_k);
+					case 1: return glm::ivec2(last, a_k);
+					case 2: return glm::ivec2(a_k, 0);
+					default: return glm::ivec2(a_k, last);
+					}
+				};
+				auto inner = [edge, last](int a_k)
+				{
+					switch (edge)
+					{
+					case 0: return glm::ivec2(1, a_k);
+					case 1: return glm::ivec2(last - 1, a_k);
+					case 2: return glm::ivec2(a_k, 1);
+					default: return glm::ivec2(a_k, last - 1);
+					}
+				};
+
+				if ((variant & (1u << edge)) != 0)
+				{
+					for (int k = 0; k < last; k += 2)
+						triangle(outer(k), outer(k + 2), inner(k + 1));
+					for (int k = 2; k < last; k += 2)
+					{
+						triangle(outer(k), inner(k + 1), inner(k));
+						triangle(outer(k), inner(k), inner(k - 1));
+					}
+				}
+				else
+				{
+					triangle(outer(0), outer(1), inner(1));
+					for (int k = 1; k < last - 1; ++k)
+					{
+						triangle(outer(k), outer(k + 1), inner(k + 1));
+						triangle(outer(k), inner(k + 1), inner(k));
+					}
+					triangle(outer(last - 1), outer(last), inner(last - 1));
+				}
+			}
+
+			m_variantCount[variant] = (unsigned int)indices.size() - m_variantFirst[variant];
+		}
+
+		unsigned long long bytes = indices.size() * sizeof(uint16_t);
+		glCreateBuffers(1, m_indices.put());
+		glNamedBufferStorage(m_indices, bytes, indices.data(), 0);
+		GpuMemory::instance().trackBuffer(m_indices, bytes, GpuMemory::MESHES, "PlanetRenderer");
+	}
+
+	/**
+		addPatch splits and culls a patch and those beneath it, adding the
+			ones to draw to the lists of the index lists they use.
+
+			@param1 a_planet is the planet.
+
+			@param2 a_patch is the patch.
+	*/
+	void PlanetRenderer::addPatch(const Planet& a_planet, const Patch& a_patch)
+	{
+		float size = 2.0f / (float)(1u << a_patch.level);
+		float u = -1.0f + a_patch.x * size;
+		float v = -1.0f + a_patch.y * size;
+		glm::vec3 centre = a_planet.centre + getDirection(a_patch.face, u + size * 0.5f, v + size * 0.5f) *
+			a_planet.radius;
+		float bound = (BOUND_SCALE * size + a_planet.height) * a_planet.radius;
+
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			const glm::vec4& plane = m_frustum->getPlane(i);
+			if (glm::dot(glm::vec3(plane), centre) + plane.w < -bound)
+			{
+				++m_stats.culled;
+				return;
+			}
+		}
+
+		// Culled if its corners, the middles of its edges and its centre,
+		//	all at their highest, are hidden by the planet at its lowest.
+		bool hidden = true;
+		float highest = a_planet.radius * (1.0f + a_planet.height);
+		for (unsigned int i = 0; i < 9 && hidden; ++i)
+		{
+			glm::vec3 direction = getDirection(a_patch.face, u + (i % 3) * size * 0.5f, v + (i / 3) * size * 0.5f);
+			hidden = isBehindHorizon(a_planet, a_planet.centre + direction * highest);
+		}
+		if (hidden)
+		{
+			++m_stats.culled;
+			return;
+		}
+
+		if (shouldSplit(a_planet, a_patch))
+		{
+			for (unsigned int child = 0; child < 4; ++child)
+			{
+				addPatch(a_planet, { a_patch.face, a_patch.level + 1, a_patch.x * 2 + (child & 1),
+					a_patch.y * 2 + (child >> 1) });
+			}
+			return;
+		}
+
+		if (m_stats.patches >= MAX_PATCHES)
+			return;
+
+		Instance instance;
+		instance.patch = glm::vec4(u, v, size, (float)a_patch.face);
+		instance.planet = glm::vec4(a_planet.centre, a_planet.radius);
+		instance.colour = a_planet.colour;
+		instance.surface = glm::vec4(a_planet.height, a_planet.seed, 0, 0);
+		m_variants[getCoarseEdges(a_planet, a_patch)].push_back(instance);
+		++m_stats.patches;
+	}
+
+	/**
+		shouldSplit returns whether a patch is near enough the camera to
+			split. As the distance a patch splits at doubles as it does,
+			the neighbours of a patch are never more than a level apart.
+
+			@param1 a_planet is the planet.
+
+			@param2 a_patch is the patch.
+	*/
+	bool PlanetRenderer::shouldSplit(const Planet& a_planet, const Patch& a_patch) const
+	{
+		if (a_patch.level >= MAX_LEVEL)
+			return false;
+
+		float size = 2.0f / (float)(1u << a_patch.level);
+		float u = -1.0f + (a_patch.x + 0.5f) * size;
+		float v = -1.0f + (a_patch.y + 0.5f) * size;
+		glm::vec3 centre = a_planet.centre + getDirection(a_patch.face, u, v) * a_planet.radius;
+		float bound = (BOUND_SCALE * size + a_planet.height) * a_planet.radius;
+		float distance = std::max(glm::length(m_cameraPosition - centre) - bound, 0.0f);
+		return distance < m_detail * size * a_planet.radius;
+	}
+
+	/**
+		getCoarseEdges returns which of a patch's edges have a coarser
+			neighbour. Across each edge is where the neighbour's centre
+			would be at the patch's level, which is there only if the
+			patch a level up around that point splits. Past the face's
+			edge the point is pushed back onto the face it is over.
+
+			@param1 a_planet is the planet.
+
+			@param2 a_patch is the patch.
+
+			@return a bit an edge in the order -u, +u, -v, +v.
+	*/
+	unsigned int PlanetRenderer::getCoarseEdges(const Planet& a_planet, const Patch& a_patch) const
+	{
+		if (a_patch.level == 0)
+			return 0;
+
+		static const glm::vec2 STEPS[4] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+		float size = 2.0f / (float)(1u << a_patch.level);
+		unsigned int cells = 1u << (a_patch.level - 1);
+		unsigned int edges = 0;
+		for (unsigned int edge = 0; edge < 4; ++edge)
+		{
+			unsigned int face = a_patch.face;
+			float u = -1.0f + (a_patch.x + 0.5f + STEPS[edge].x) * size;
+			float v = -1.0f + (a_patch.y + 0.5f + STEPS[edge].y) * size;
+			if (std::fabs(u) > 1.0f || std::fabs(v) > 1.0f)
+			{
+				glm::vec3 point = FACE_NORMALS[face] + FACE_US[face] * u + FACE_VS[face] * v;
+				glm::vec3 magnitude = glm::abs(point);
+				unsigned int axis = magnitude.x > magnitude.y ? (magnitude.x > magnitude.z ? 0 : 2) :
+					(magnitude.y > magnitude.z ? 1 : 2);
+				face = axis * 2 + (point[axis] < 0.0f ? 1 : 0);
+				point /= magnitude[axis];
+				u = glm::dot(point, FACE_US[face]);
+				v = glm::dot(point, FACE_VS[face]);
+			}
+
+			Patch parent;
+			parent.face = face;
+			parent.level = a_patch.level - 1;
+			parent.x = std::min((unsigned int)std::max((u + 1.0f) * 0.5f * cells, 0.0f), cells - 1);
+			parent.y = std::min((unsigned int)std::max((v + 1.0f) * 0.5f * cells, 0.0f), cells - 1);
+			if (shouldSplit(a_planet, parent) == false)
+				edges |= 1u << edge;
+		}
+		return edges;
+	}
+
+	/**
+		isBehindHorizon returns whether a point is behind the planet from
+			the camera, treating the planet as a sphere at its lowest
+			ground. The point is hidden if it is further than the
+			horizon and inside the cone the sphere shadows.
+
+			@param1 a_planet is the planet.
+
+			@param2 a_point is the point.
+	*/
+	bool PlanetRenderer::isBehindHorizon(const Planet& a_planet, const glm::vec3& a_point) const
+	{
+		// In units of the sphere's radius, from its centre.
+		float occluder = a_planet.radius * (1.0f - a_planet.height);
+		glm::vec3 camera = (m_cameraPosition - a_planet.centre) / occluder;
+		float horizonSquared = glm::dot(camera, camera) - 1.0f;
+		if (horizonSquared <= 0.0f)
+			return false;
+
+		glm::vec3 toPoint = (a_point - a_planet.centre) / occluder - camera;
+		float along = -glm::dot(toPoint, camera);
+		return along > horizonSquared && along * along / glm::dot(toPoint, toPoint) > horizonSquared;
+	}
+
+	/**
+		getDirection returns where a face's u and v are on the unit
+			sphere.
+
+			@param1 a_face is the face.
+
+			@param2 a_u is across the face, from -1 to 1.
+
+			@param3 a_v is up the face, from -1 to 1.
+	*/
+	glm::vec3 PlanetRenderer::getDirection(unsigned int a_face, float a_u, float a_v)
+	{
+		return glm::normalize(FACE_NORMALS[a_face] + FACE_US[a_face] * a_u + FACE_VS[a_face] * a_v);
+	}
+}
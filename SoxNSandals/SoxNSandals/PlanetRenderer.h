@@ -0,0 +1,253 @@
+/**
+	PlanetRenderer.h
+
+	Purpose: PlanetRenderer.h is the header file for the PlanetRenderer
+			class. The PlanetRenderer draws planets as cube spheres, each
+			face a quadtree of patches split finer the nearer the camera
+			is, so a planet can be flown to from orbit down to its
+			ground.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace sns
+{
+	class Frustum;
+
+	/**
+		The PlanetRenderer class draws every planet it is given this frame
+			out of one patch mesh, a GRID by GRID grid of quads with no
+			vertex buffer, each vertex's place in the grid made from its
+			index.
+
+		A planet is a cube with each face split into a quadtree of
+			patches, pushed out onto a sphere. From each face's root a
+			patch is split into four while the camera is nearer to it
+			than its size times the detail, so the patches are about the
+			same size on screen at any height. Patches outside the
+			view, or behind the planet's horizon, are culled with
+			everything beneath them.
+
+		Where a patch's neighbour is a level coarser, every other vertex
+			of their shared edge would sit part way along the
+			neighbour's, leaving cracks, so that edge is drawn with half
+			the vertices. There is one index list for each of the 16
+			ways a patch's edges can be coarse, all in one index buffer,
+			and every patch using the same one is drawn in one
+			instanced draw.
+
+		The vertex shader lifts each vertex by octaves of noise along its
+			direction from the centre, so the detail is made on the gpu
+			at whatever resolution the patch is, and the patches'
+			bounds allow for the most it can lift.
+
+		Instancing from offsets needs GL 4.2 and the buffers are made with
+			GL 4.5, without it create fails. The planets are lit by the
+			sun, but don't cast shadows.
+	*/
+	class PlanetRenderer
+	{
+	public:
+		// The quads along each side of a patch, a power of 2.
+		static const unsigned int GRID = 32;
+
+		// How many times a face's root can be split.
+		static const unsigned int MAX_LEVEL = 12;
+
+		// The most patches drawn in a view.
+		static const unsigned int MAX_PATCHES = 4096;
+
+		/**
+			What the last draw did.
+		*/
+		struct Stats
+		{
+			unsigned int patches;
+			unsigned int culled;
+			unsigned int draws;
+		};
+
+		PlanetRenderer();
+
+		/**
+			The deconstructor deletes the buffers and vertex array.
+		*/
+		~PlanetRenderer();
+
+		PlanetRenderer(const PlanetRenderer&) = delete;
+		PlanetRenderer& operator=(const PlanetRenderer&) = delete;
+
+		/**
+			create loads the shader and builds the patch mesh.
+
+				@return false without GL 4.5 or the shader, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vao != 0; }
+
+		/**
+			destroy deletes the buffers and vertex array.
+		*/
+		void destroy();
+
+		/**
+			getShader returns the planets' program.
+		*/
+		aie::ShaderProgram& getShader() { return m_shader; }
+
+		/**
+			clear forgets every planet, before they are added for a new
+				frame.
+		*/
+		void clear() { m_planets.clear(); }
+
+		/**
+			addPlanet adds a planet to draw until the next clear.
+
+				@param1 a_centre is its centre.
+
+				@param2 a_radius is its radius at sea level.
+
+				@param3 a_colour is its colour.
+
+				@param4 a_height is how far the noise lifts and sinks its
+						ground, as a share of its radius.
+
+				@param5 a_seed picks its hills.
+		*/
+		void addPlanet(const glm::vec3& a_centre, float a_radius, const glm::vec4& a_colour, float a_height,
+			float a_seed);
+
+		/**
+			draw splits and culls every planet's patches for a view and
+				draws them with the planets' shader.
+
+				@param1 a_cullProjectionView is the view the patches are
+						culled against.
+
+				@param2 a_cameraPosition is where the patches are split
+						by their distance from.
+
+				@param3 a_sunPosition is what lights the planets.
+		*/
+		void draw(const glm::mat4& a_cullProjectionView, const glm::vec3& a_cameraPosition,
+			const glm::vec3& a_sunPosition);
+
+		/**
+			setDetail sets how many of a patch's own sizes away the camera
+				must be for it not to be split, 3 by default. Larger is
+				finer.
+
+				@param1 a_detail is the distance, at least 0.5.
+		*/
+		void setDetail(float a_detail) { m_detail = glm::max(a_detail, 0.5f); }
+
+		/**
+			getDetail returns how many of a patch's own sizes away the
+				camera must be for it not to be split.
+		*/
+		float getDetail() const { return m_detail; }
+
+		/**
+			getStats returns what the last draw did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		/**
+			A planet to draw.
+		*/
+		struct Planet
+		{
+			glm::vec3 centre;
+			float radius;
+			glm::vec4 colour;
+			float height;
+			float seed;
+		};
+
+		/**
+			A patch to draw, as the vertex shader reads it.
+		*/
+		struct Instance
+		{
+			// The face's u and v at the patch's first corner, from -1
+			//	to 1, the patch's size in them, and the face.
+			glm::vec4 patch;
+
+			// The planet's centre and radius.
+			glm::vec4 planet;
+
+			glm::vec4 colour;
+
+			// The planet's height, its seed, then nothing.
+			glm::vec4 surface;
+		};
+
+		/**
+			A patch of one face, at a level of its quadtree.
+		*/
+		struct Patch
+		{
+			unsigned int face;
+			unsigned int level;
+			unsigned int x;
+			unsigned int y;
+		};
+
+		// Builds the 16 index lists into one buffer.
+		void createIndices();
+
+		// Splits and culls a patch and those beneath it, adding the ones
+		//	to draw to m_variants.
+		void addPatch(const Planet& a_planet, const Patch& a_patch);
+
+		// Returns whether a patch is near enough the camera to split.
+		bool shouldSplit(const Planet& a_planet, const Patch& a_patch) const;
+
+		// Returns which of a patch's edges have a coarser neighbour, a
+		//	bit an edge in the order -u, +u, -v, +v.
+		unsigned int getCoarseEdges(const Planet& a_planet, const Patch& a_patch) const;
+
+		// Returns whether a point, at the most the planet lifts it, is
+		//	behind the planet from the camera.
+		bool isBehindHorizon(const Planet& a_planet, const glm::vec3& a_point) const;
+
+		// Returns where a face's u and v are on the unit sphere.
+		static glm::vec3 getDirection(unsigned int a_face, float a_u, float a_v);
+
+		aie::ShaderProgram m_shader;
+		VertexArrayHandle m_vao;
+		BufferHandle m_indices;
+		StreamingBuffer m_instances;
+
+		// Where each index list starts in the index buffer and how many
+		//	indices it has.
+		unsigned int m_variantFirst[16];
+		unsigned int m_variantCount[16];
+
+		std::vector<Planet> m_planets;
+
+		// The patches of this view using each index list. Kept to save
+		//	allocating them again.
+		std::vector<Instance> m_variants[16];
+
+		// The view the patches are being split and culled for.
+		const Frustum* m_frustum;
+		glm::vec3 m_cameraPosition;
+
+		float m_detail;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,517 @@
+/**
+	PointCloud.cpp
+
+	Purpose: PointCloud.cpp is the source file for the PointCloud class.
+			The PointCloud draws clouds of millions of points from an
+			octree of ever denser samples of them, streaming in only
+			the nodes the camera needs and rasterising their points
+			with compute shaders.
+
+	@author Nathan Nette
+*/
+#include "PointCloud.h"
+#include "Frustum.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <queue>
+#include <utility>
+
+namespace sns
+{
+	// Must match local_size_x in the raster shader.
+	static const unsigned int RASTER_GROUP_SIZE = 256;
+
+	// The storage buffers the raster shaders read.
+	static const unsigned int POINT_BINDING = 0;
+	static const unsigned int NODE_BINDING = 1;
+
+	// The units the resolve shader reads the colours and depths from.
+	static const unsigned int COLOUR_UNIT = 0;
+	static const unsigned int DEPTH_UNIT = 1;
+
+	PointCloud::PointCloud()
+		: m_pool(0),
+		m_drawBuffer(0),
+		m_drawCapacity(0),
+		m_depthKeys(0),
+		m_colours(0),
+		m_depths(0),
+		m_width(0),
+		m_height(0),
+		m_vao(0),
+		m_frame(0),
+		m_pointBudget(4000000),
+		m_pointSpacing(2.0f),
+		m_uploadBudget(16),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffers and images.
+	*/
+	PointCloud::~PointCloud()
+	{
+		RenderState& state = RenderState::instance();
+		GpuMemory& memory = GpuMemory::instance();
+		for (unsigned int* buffer : { &m_pool, &m_drawBuffer })
+		{
+			if (*buffer == 0)
+				continue;
+			glDeleteBuffers(1, buffer);
+			state.onBufferDeleted(*buffer);
+			memory.releaseBuffer(*buffer);
+		}
+		destroyImages();
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			state.onVertexArrayDeleted(m_vao);
+		}
+	}
+
+	/**
+		build builds the octree over points, replacing what was there.
+			It makes no GL calls.
+
+			@param1 a_points are the points, which are moved from.
+
+			@return how many points were dropped by nodes at MAX_DEPTH.
+	*/
+	unsigned int PointCloud::build(std::vector<Point>& a_points)
+	{
+		m_nodes.clear();
+		m_points.clear();
+		if (a_points.empty())
+			return 0;
+
+		// The root is the cube around every point, so each child is an
+		//	eighth of its parent.
+		glm::vec3 boundsMin = a_points[0].position;
+		glm::vec3 boundsMax = boundsMin;
+		for (const Point& point : a_points)
+		{
+			boundsMin = glm::min(boundsMin, point.position);
+			boundsMax = glm::max(boundsMax, point.position);
+		}
+		glm::vec3 extent = boundsMax - boundsMin;
+		float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-4f));
+
+		Node root = {};
+		root.boundsMin = boundsMin;
+		root.size = size * 1.0001f;
+		for (int& child : root.children)
+			child = -1;
+		root.slot = -1;
+		m_nodes.push_back(root);
+
+		m_points.reserve(a_points.size());
+		unsigned int dropped = 0;
+		buildNode(0, a_points, 0, dropped);
+		std::vector<Point>().swap(a_points);
+		return dropped;
+	}
+
+	/**
+		buildNode samples a node's points for it and builds its children
+			from the rest.
+
+			@param1 a_node is the node's index.
+
+			@param2 a_points are the points in its cube, which are
+					emptied.
+
+			@param3 a_depth is how deep it is.
+
+			@param4 a_dropped is added to for points dropped at MAX_DEPTH.
+	*/
+	void PointCloud::buildNode(unsigned int a_node, std::vector<Point>& a_points, unsigned int a_depth,
+		unsigned int& a_dropped)
+	{
+		// References into m_nodes don't survive the children being added.
+		glm::vec3 boundsMin = m_nodes[a_node].boundsMin;
+		float size = m_nodes[a_node].size;
+		m_nodes[a_node].firstPoint = (unsigned int)m_points.size();
+
+		if (a_points.size() <= NODE_CAPACITY || a_depth == MAX_DEPTH)
+		{
+			unsigned int count = (unsigned int)std::min<size_t>(a_points.size(), NODE_CAPACITY);
+			m_points.insert(m_points.end(), a_points.begin(), a_points.begin() + count);
+			m_nodes[a_node].pointCount = count;
+			a_dropped += (unsigned int)a_points.size() - count;
+			std::vector<Point>().swap(a_points);
+			return;
+		}
+
+		// The first point in each cell of the grid stays, so the node is
+		//	an even sample however dense the scan is in places.
+		std::vector<bool> taken(SAMPLE_GRID * SAMPLE_GRID * SAMPLE_GRID, false);
+		std::vector<Point> children[8];
+		float cellScale = SAMPLE_GRID / size;
+		glm::vec3 centre = boundsMin + size * 0.5f;
+		unsigned int count = 0;
+		for (const Point& point : a_points)
+		{
+			glm::uvec3 cell = glm::min(glm::uvec3(glm::max((point.position - boundsMin) * cellScale, 0.0f)),
+				glm::uvec3(SAMPLE_GRID - 1));
+			unsigned int index = (cell.z * SAMPLE_GRID + cell.y) * SAMPLE_GRID + cell.x;
+			if (count < NODE_CAPACITY && taken[index] == false)
+			{
+				taken[index] = true;
+				m_points.push_back(point);
+				++count;
+				continue;
+			}
+
+			unsigned int octant = (point.position.x >= centre.x ? 1 : 0) |
+				(point.position.y >= centre.y ? 2 : 0) | (point.position.z >= centre.z ? 4 : 0);
+			children[octant].push_back(point);
+		}
+		m_nodes[a_node].pointCount = count;
+		std::vector<Point>().swap(a_points);
+
+		for (unsigned int octant = 0; octant < 8; ++octant)
+		{
+			if (children[octant].empty())
+				continue;
+
+			Node child = {};
+			child.size = size * 0.5f;
+			child.boundsMin = boundsMin + glm::vec3(octant & 1 ? child.size : 0, octant & 2 ? child.size : 0,
+				octant & 4 ? child.size : 0);
+			for (int& grandchild : child.children)
+				grandchild = -1;
+			child.slot = -1;
+
+			unsigned int index = (unsigned int)m_nodes.size();
+			m_nodes[a_node].children[octant] = (int)index;
+			m_nodes.push_back(child);
+			buildNode(index, children[octant], a_depth + 1, a_dropped);
+		}
+	}
+
+	/**
+		create makes the node slots and loads the shaders.
+
+			@param1 a_slotCount is how many nodes are kept on the gpu at
+					once.
+
+			@return false without GL 4.5 or the shaders, it is left
+					uncreated.
+	*/
+	bool PointCloud::create(unsigned int a_slotCount)
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("PointCloud: point clouds need GL 4.5.\n");
+			return false;
+		}
+
+		// The depth pass and the colour pass are one shader, built twice.
+		if (m_depthShader.getHandle() == 0)
+		{
+			m_depthShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/pointCloudRaster.comp", "#define COLOUR_PASS 0\n");
+			if (m_depthShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_depthShader.getLastError());
+				return false;
+			}
+		}
+		if (m_colourShader.getHandle() == 0)
+		{
+			m_colourShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/pointCloudRaster.comp", "#define COLOUR_PASS 1\n");
+			if (m_colourShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_colourShader.getLastError());
+				return false;
+			}
+		}
+		if (m_resolveShader.getHandle() == 0)
+		{
+			m_resolveShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleUpsample.vert");
+			m_resolveShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/pointCloudResolve.frag");
+			if (m_resolveShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_resolveShader.getLastError());
+				return false;
+			}
+		}
+
+		// Written a node at a time as they stream in, never read back.
+		size_t bytes = (size_t)a_slotCount * NODE_CAPACITY * sizeof(Point);
+		glCreateBuffers(1, &m_pool);
+		glNamedBufferStorage(m_pool, bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		GpuMemory::instance().trackBuffer(m_pool, bytes, GpuMemory::STREAMING, "PointCloud");
+		m_slotNodes.assign(a_slotCount, -1);
+
+		// Core profiles can't draw without a vertex array, even one with
+		//	nothing in it.
+		glGenVertexArrays(1, &m_vao);
+		return true;
+	}
+
+	/**
+		update picks the nodes to draw from a view and streams in those
+			that aren't resident.
+
+			@param1 a_projection is the view's projection.
+
+			@param2 a_view is the view's camera matrix.
+
+			@param3 a_viewportHeight is how many pixels tall it is.
+	*/
+	void PointCloud::update(const glm::mat4& a_projection, const glm::mat4& a_view, float a_viewportHeight)
+	{
+		++m_frame;
+		m_stats = {};
+		m_drawNodes.clear();
+		if (isCreated() == false || m_nodes.empty())
+			return;
+
+		Frustum frustum(a_projection * a_view);
+		glm::vec3 cameraPosition(glm::inverse(a_view)[3]);
+
+		// How many pixels a world unit one unit away is on screen.
+		float pixelScale = a_projection[1][1] * a_viewportHeight * 0.5f;
+
+		// Nodes larger on screen come first, and a node's children are
+		//	only considered once it is on the gpu, so holes in the cloud
+		//	are never left where an ancestor could have been drawn.
+		std::priority_queue<std::pair<float, unsigned int>> open;
+		open.push({ 0.0f, 0 });
+		unsigned int uploads = 0;
+		unsigned long long points = 0;
+		while (open.empty() == false)
+		{
+			unsigned int index = open.top().second;
+			open.pop();
+			Node& node = m_nodes[index];
+
+			glm::vec3 extent(node.size * 0.5f);
+			glm::vec3 centre = node.boundsMin + extent;
+			if (frustum.isBoxVisible(centre, extent) == false)
+				continue;
+			++m_stats.nodesVisible;
+			if (points + node.pointCount > m_pointBudget)
+				break;
+
+			node.lastPicked = m_frame;
+			if (node.slot < 0)
+			{
+				if (uploads >= m_uploadBudget || makeResident(index) == false)
+					continue;
+				++uploads;
+			}
+
+			DrawNode drawNode = { (unsigned int)node.slot * NODE_CAPACITY, node.pointCount, { 0, 0 } };
+			m_drawNodes.push_back(drawNode);
+			points += node.pointCount;
+
+			// The node's points are about a grid cell apart, its children
+			//	fill in between them.
+			float distance = std::max(glm::distance(cameraPosition, centre) - glm::length(extent), 1e-3f);
+			float spacing = node.size / SAMPLE_GRID * pixelScale / distance;
+			if (spacing <= m_pointSpacing)
+				continue;
+			for (int child : node.children)
+			{
+				if (child < 0)
+					continue;
+				const Node& childNode = m_nodes[child];
+				glm::vec3 childCentre = childNode.boundsMin + childNode.size * 0.5f;
+				float childDistance = std::max(glm::distance(cameraPosition, childCentre), 1e-3f);
+				open.push({ childNode.size / childDistance, (unsigned int)child });
+			}
+		}
+		m_stats.nodesDrawn = (unsigned int)m_drawNodes.size();
+		m_stats.pointsDrawn = points;
+	}
+
+	/**
+		makeResident writes a node's points into a slot, taking the slot
+			of the node picked longest ago if none are free.
+
+			@param1 a_node is the node's index.
+
+			@return false if every slot is held by a node picked this
+					frame.
+	*/
+	bool PointCloud::makeResident(unsigned int a_node)
+	{
+		int best = -1;
+		unsigned int oldest = m_frame;
+		for (unsigned int slot = 0; slot < (unsigned int)m_slotNodes.size(); ++slot)
+		{
+			int holder = m_slotNodes[slot];
+			if (holder < 0)
+			{
+				best = (int)slot;
+				break;
+			}
+			if (m_nodes[holder].lastPicked < oldest)
+			{
+				oldest = m_nodes[holder].lastPicked;
+				best = (int)slot;
+			}
+		}
+		if (best < 0)
+			return false;
+
+		if (m_slotNodes[best] >= 0)
+			m_nodes[m_slotNodes[best]].slot = -1;
+		m_slotNodes[best] = (int)a_node;
+
+		Node& node = m_nodes[a_node];
+		node.slot = best;
+		glNamedBufferSubData(m_pool, (size_t)best * NODE_CAPACITY * sizeof(Point), node.pointCount * sizeof(Point),
+			m_points.data() + node.firstPoint);
+		++m_stats.nodesUploaded;
+		return true;
+	}
+
+	/**
+		draw rasterises the picked nodes into the bound framebuffer.
+
+			@param1 a_projectionView is the view's projection view.
+
+			@param2 a_width is the width of the viewport.
+
+			@param3 a_height is the height of the viewport.
+	*/
+	void PointCloud::draw(const glm::mat4& a_projectionView, int a_width, int a_height)
+	{
+		if (isCreated() == false || m_drawNodes.empty() || a_width <= 0 || a_height <= 0)
+			return;
+
+		static constexpr aie::UniformHandle PROJECTION_VIEW("ProjectionView");
+		static constexpr aie::UniformHandle VIEWPORT_SIZE("ViewportSize");
+		static constexpr aie::UniformHandle REVERSE_Z("ReverseZ");
+		static constexpr aie::UniformHandle COLOURS("Colours");
+		static constexpr aie::UniformHandle DEPTHS("Depths");
+		static constexpr aie::UniformHandle VIEWPORT_ORIGIN("ViewportOrigin");
+
+		resizeImages(a_width, a_height);
+
+		// The list of nodes grows with the most ever drawn at once.
+		unsigned int count = (unsigned int)m_drawNodes.size();
+		RenderState& state = RenderState::instance();
+		if (count > m_drawCapacity)
+		{
+			if (m_drawBuffer != 0)
+			{
+				glDeleteBuffers(1, &m_drawBuffer);
+				state.onBufferDeleted(m_drawBuffer);
+				GpuMemory::instance().releaseBuffer(m_drawBuffer);
+			}
+			m_drawCapacity = std::max(count, m_drawCapacity * 2);
+			glCreateBuffers(1, &m_drawBuffer);
+			glNamedBufferStorage(m_drawBuffer, m_drawCapacity * sizeof(DrawNode), nullptr, GL_DYNAMIC_STORAGE_BIT);
+			GpuMemory::instance().trackBuffer(m_drawBuffer, m_drawCapacity * sizeof(DrawNode), GpuMemory::STREAMING,
+				"PointCloud");
+		}
+		glNamedBufferSubData(m_drawBuffer, 0, count * sizeof(DrawNode), m_drawNodes.data());
+
+		// Nothing is nearer than the furthest key, and an empty colour
+		//	has no alpha.
+		unsigned int farKey = ~0u;
+		unsigned int empty = 0;
+		glClearTexImage(m_depthKeys, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &farKey);
+		glClearTexImage(m_colours, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &empty);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_BINDING, m_pool);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, m_drawBuffer);
+		glBindImageTexture(0, m_depthKeys, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+		glBindImageTexture(1, m_colours, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+		glBindImageTexture(2, m_depths, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		// Each group runs over part of one node, a row of groups a node.
+		unsigned int groups = (NODE_CAPACITY + RASTER_GROUP_SIZE - 1) / RASTER_GROUP_SIZE;
+		glm::vec2 viewportSize((float)a_width, (float)a_height);
+		for (aie::ShaderProgram* shader : { &m_depthShader, &m_colourShader })
+		{
+			shader->bind();
+			shader->bindUniform(PROJECTION_VIEW, a_projectionView);
+			shader->bindUniform(VIEWPORT_SIZE, viewportSize);
+			shader->bindUniform(REVERSE_Z, state.isReverseZ() ? 1 : 0);
+			glDispatchCompute(groups, count, 1);
+
+			// The colour pass reads the finished keys, the resolve the
+			//	finished colours.
+			glMemoryBarrier(shader == &m_depthShader ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT : GL_TEXTURE_FETCH_BARRIER_BIT);
+		}
+
+		// Pixels no point reached are discarded, the rest depth tested
+		//	against the scene.
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		m_resolveShader.bind();
+		m_resolveShader.bindUniform(COLOURS, (int)COLOUR_UNIT);
+		m_resolveShader.bindUniform(DEPTHS, (int)DEPTH_UNIT);
+		m_resolveShader.bindUniform(VIEWPORT_ORIGIN, glm::ivec2(viewport[0], viewport[1]));
+		state.bindTexture(COLOUR_UNIT, m_colours);
+		state.bindTexture(DEPTH_UNIT, m_depths);
+		state.bindVertexArray(m_vao);
+		state.setDepthTest(true);
+		state.setDepthMask(true);
+		state.setDepthFunc(state.getNearerDepthFunc());
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		state.countDraw();
+		state.bindTexture(COLOUR_UNIT, 0);
+		state.bindTexture(DEPTH_UNIT, 0);
+	}
+
+	/**
+		resizeImages makes the images at a size if they aren't already.
+
+			@param1 a_width is the width in pixels.
+
+			@param2 a_height is the height in pixels.
+	*/
+	void PointCloud::resizeImages(int a_width, int a_height)
+	{
+		if (a_width == m_width && a_height == m_height)
+			return;
+		destroyImages();
+
+		// Only ever read with texelFetch, so no filtering is needed for
+		//	them to be complete.
+		GpuMemory& memory = GpuMemory::instance();
+		const unsigned int FORMATS[3] = { GL_R32UI, GL_R32UI, GL_R32F };
+		unsigned int* images[3] = { &m_depthKeys, &m_colours, &m_depths };
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, images[i]);
+			glTextureStorage2D(*images[i], 1, FORMATS[i], a_width, a_height);
+			glTextureParameteri(*images[i], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTextureParameteri(*images[i], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			memory.trackTexture(*images[i], GpuMemory::getTextureBytes(FORMATS[i], a_width, a_height),
+				GpuMemory::RENDER_TARGETS, "PointCloud");
+		}
+		m_width = a_width;
+		m_height = a_height;
+	}
+
+	/**
+		destroyImages deletes the images.
+	*/
+	void PointCloud::destroyImages()
+	{
+		RenderState& state = RenderState::instance();
+		for (unsigned int* image : { &m_depthKeys, &m_colours, &m_depths })
+		{
+			if (*image == 0)
+				continue;
+			glDeleteTextures(1, image);
+			state.onTextureDeleted(*image);
+			GpuMemory::instance().releaseTexture(*image);
+			*image = 0;
+		}
+		m_width = m_height = 0;
+	}
+}
@@ -0,0 +1,252 @@
+/**
+	PointCloud.h
+
+	Purpose: PointCloud.h is the header file for the PointCloud class.
+			The PointCloud draws clouds of millions of points, like
+			scans, from an octree of ever denser samples of them. Only
+			the nodes the camera needs are streamed to the gpu, and
+			their points are rasterised by compute shaders rather than
+			drawn as GL_POINTS.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The PointCloud class builds an octree over its points as Potree
+			does. Each node keeps an even sample of the points in its
+			cube, at most one in each cell of a SAMPLE_GRID cells wide
+			grid over it, and hands the rest to its children. Drawing a
+			node and its ancestors draws its cube at the node's density,
+			and no point is in two nodes.
+
+		Each frame update picks nodes from the root down, larger on
+			screen first, until the point budget is spent. A node is
+			only split while its points are further apart on screen than
+			setPointSpacing allows. Picked nodes not on the gpu are
+			written into the slots of one storage buffer, a few a frame,
+			and the slots of nodes not picked for the longest are taken
+			for them. Until a node is in, its ancestors stand in for it.
+
+		draw rasterises the resident picked nodes in two compute passes
+			into images the size of the viewport. The first keeps the
+			nearest depth of each pixel with imageAtomicMin, the second
+			writes the colour and depth of the points that match it, and
+			a full screen pass then writes them into the bound
+			framebuffer, depth tested against what is already there.
+			Without 64 bit atomics in GL 4.5 the depth and colour can't
+			be written together by one atomic, so two passes stand in
+			for it.
+
+		build is cpu only and can run on any thread. Everything else
+			must be called on the context thread, and needs
+			GL 4.5.
+	*/
+	class PointCloud
+	{
+	public:
+		// The most points a node holds.
+		static const unsigned int NODE_CAPACITY = 16384;
+
+		// How many cells across the grid a node samples its points with.
+		static const unsigned int SAMPLE_GRID = 64;
+
+		// How deep the octree goes. A node this deep keeps at most
+		//	NODE_CAPACITY points and drops the rest.
+		static const unsigned int MAX_DEPTH = 12;
+
+		/**
+			A point as the shaders read it, 16 bytes.
+		*/
+		struct Point
+		{
+			glm::vec3 position;
+
+			// RGBA8, red in the low byte.
+			uint32_t colour;
+		};
+
+		/**
+			Counts from the last update and draw.
+		*/
+		struct Stats
+		{
+			unsigned int nodesVisible;
+			unsigned int nodesDrawn;
+			unsigned int nodesUploaded;
+			unsigned long long pointsDrawn;
+		};
+
+		PointCloud();
+
+		/**
+			The deconstructor deletes the buffers and images.
+		*/
+		~PointCloud();
+
+		PointCloud(const PointCloud&) = delete;
+		PointCloud& operator=(const PointCloud&) = delete;
+
+		/**
+			build builds the octree over points, replacing what was there.
+				It makes no GL calls.
+
+				@param1 a_points are the points, which are moved from.
+
+				@return how many points were dropped by nodes at MAX_DEPTH.
+		*/
+		unsigned int build(std::vector<Point>& a_points);
+
+		/**
+			create makes the node slots and loads the shaders.
+
+				@param1 a_slotCount is how many nodes are kept on the gpu
+						at once.
+
+				@return false without GL 4.5 or the shaders, it is left
+						uncreated.
+		*/
+		bool create(unsigned int a_slotCount = 1024);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_pool != 0; }
+
+		/**
+			setPointBudget sets how many points update picks at most.
+				4 million by default.
+		*/
+		void setPointBudget(unsigned int a_budget) { m_pointBudget = a_budget; }
+		unsigned int getPointBudget() const { return m_pointBudget; }
+
+		/**
+			setPointSpacing sets how many pixels apart a node's points
+				may be on screen before its children are picked too.
+				2 by default.
+		*/
+		void setPointSpacing(float a_pixels) { m_pointSpacing = a_pixels; }
+
+		/**
+			setUploadBudget sets how many nodes are written to the gpu a
+				frame. 16 by default.
+		*/
+		void setUploadBudget(unsigned int a_nodes) { m_uploadBudget = a_nodes; }
+
+		/**
+			update picks the nodes to draw from a view and streams in
+				those that aren't resident.
+
+				@param1 a_projection is the view's projection.
+
+				@param2 a_view is the view's camera matrix.
+
+				@param3 a_viewportHeight is how many pixels tall it is.
+		*/
+		void update(const glm::mat4& a_projection, const glm::mat4& a_view, float a_viewportHeight);
+
+		/**
+			draw rasterises the picked nodes into the bound framebuffer.
+
+				@param1 a_projectionView is the view's projection view.
+
+				@param2 a_width is the width of the viewport.
+
+				@param3 a_height is the height of the viewport.
+		*/
+		void draw(const glm::mat4& a_projectionView, int a_width, int a_height);
+
+		/**
+			getNodeCount returns how many nodes the octree has.
+		*/
+		unsigned int getNodeCount() const { return (unsigned int)m_nodes.size(); }
+
+		/**
+			getPointCount returns how many points the octree holds.
+		*/
+		unsigned int getPointCount() const { return (unsigned int)m_points.size(); }
+
+		/**
+			getStats returns the counts from the last update and draw.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		// A node of the octree, its points a run of m_points.
+		struct Node
+		{
+			glm::vec3 boundsMin;
+			float size;
+			unsigned int firstPoint;
+			unsigned int pointCount;
+			int children[8];
+
+			// Its slot in the pool, -1 when it isn't resident, and the
+			//	frame it was last picked.
+			int slot;
+			unsigned int lastPicked;
+		};
+
+		// A run of a slot's points as the raster shaders read it.
+		struct DrawNode
+		{
+			unsigned int firstPoint;
+			unsigned int pointCount;
+			unsigned int padding[2];
+		};
+
+		// Splits a node's points, sampling some for it and building its
+		//	children from the rest.
+		void buildNode(unsigned int a_node, std::vector<Point>& a_points, unsigned int a_depth,
+			unsigned int& a_dropped);
+
+		// Writes a node's points into a slot, taking the slot of the
+		//	node picked longest ago if none are free.
+		bool makeResident(unsigned int a_node);
+
+		// Makes the images at a size if they aren't already.
+		void resizeImages(int a_width, int a_height);
+
+		// Deletes the images.
+		void destroyImages();
+
+		std::vector<Node> m_nodes;
+		std::vector<Point> m_points;
+
+		// The pool of node slots, and which node has each, -1 for none.
+		unsigned int m_pool;
+		std::vector<int> m_slotNodes;
+
+		// The picked resident nodes, for the raster shaders.
+		unsigned int m_drawBuffer;
+		unsigned int m_drawCapacity;
+		std::vector<DrawNode> m_drawNodes;
+
+		// The nearest depth of each pixel as uint bits, and the colour
+		//	and depth of the point that has it.
+		unsigned int m_depthKeys;
+		unsigned int m_colours;
+		unsigned int m_depths;
+		int m_width;
+		int m_height;
+
+		aie::ShaderProgram m_depthShader;
+		aie::ShaderProgram m_colourShader;
+		aie::ShaderProgram m_resolveShader;
+		unsigned int m_vao;
+
+		unsigned int m_frame;
+		unsigned int m_pointBudget;
+		float m_pointSpacing;
+		unsigned int m_uploadBudget;
+
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,202 @@
+/**
+	PostProcess.cpp
+
+	Purpose: PostProcess.cpp is the source file for the PostProcess
+			class. The PostProcess takes the scene from the high dynamic
+			range it is lit in to the window in one full screen pass,
+			which adds its bloom, exposes, tonemaps, grades and
+			anti-aliases it together.
+
+	@author Nathan Nette
+*/
+#include "PostProcess.h"
+#include "RenderState.h"
+#include "SamplerCache.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// The units the pass reads the scene and its bloom from.
+	static const unsigned int SCENE_UNIT = 0;
+	static const unsigned int BLOOM_UNIT = 1;
+
+	PostProcess::PostProcess()
+		: m_sampler(0),
+		m_vao(0),
+		m_bloomBuilt(false),
+		m_settings({ 1.0f, 1.0f, 1.0f, glm::vec3(1.0f), true, true, 1.0f, 0.1f })
+	{
+	}
+
+	/**
+		The deconstructor deletes the vertex array. The sampler belongs
+			to the SamplerCache.
+	*/
+	PostProcess::~PostProcess()
+	{
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			RenderState::instance().onVertexArrayDeleted(m_vao);
+		}
+	}
+
+	/**
+		create loads the shader and the bloom's.
+
+			@return false without GL 4.5 or the shader, it is left
+					uncreated. Without the bloom's it is drawn without
+					the glow.
+	*/
+	bool PostProcess::create()
+	{
+		if (m_vao != 0)
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("PostProcess: post processing needs GL 4.5.\n");
+			return false;
+		}
+
+		m_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleUpsample.vert");
+		m_shader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/postProcess.frag");
+		if (m_shader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_shader.getLastError());
+			return false;
+		}
+
+		// Clamped, so FXAA's taps at the edge of what was drawn don't
+		//	reach past it.
+		m_sampler = SamplerCache::instance().get({ GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, false });
+
+		m_bloom.create();
+		glCreateVertexArrays(1, &m_vao);
+		return true;
+	}
+
+	/**
+		draw takes the bottom left of a texture to the whole of the
+			framebuffer bound, under the viewport bound.
+
+			@param1 a_source is the texture, in linear high dynamic range.
+
+			@param2 a_sourceSize is how much of it, in texels, was drawn
+					into.
+
+			@param3 a_textureSize is its size.
+
+			@param4 a_newFrame is whether the texture was drawn since the
+					last draw, and the bloom is built from it again.
+	*/
+	void PostProcess::draw(unsigned int a_source, const glm::vec2& a_sourceSize, const glm::vec2& a_textureSize,
+		bool a_newFrame)
+	{
+		static constexpr aie::UniformHandle SCENE("Scene");
+		static constexpr aie::UniformHandle VIEWPORT("Viewport");
+		static constexpr aie::UniformHandle SOURCE_SCALE("SourceScale");
+		static constexpr aie::UniformHandle SOURCE_MAX("SourceMax");
+		static constexpr aie::UniformHandle TEXEL_SIZE("TexelSize");
+		static constexpr aie::UniformHandle EXPOSURE("Exposure");
+		static constexpr aie::UniformHandle SATURATION("Saturation");
+		static constexpr aie::UniformHandle CONTRAST("Contrast");
+		static constexpr aie::UniformHandle TINT("Tint");
+		static constexpr aie::UniformHandle FXAA("Fxaa");
+		static constexpr aie::UniformHandle BLOOM("Bloom");
+		static constexpr aie::UniformHandle BLOOM_INTENSITY("BloomIntensity");
+		static constexpr aie::UniformHandle BLOOM_SCALE("BloomScale");
+
+		int viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+
+		// A window pixel to the source's texture coordinates, kept half a
+		//	texel inside what was drawn so filtering doesn't read past it.
+		glm::vec2 texelSize = 1.0f / a_textureSize;
+		glm::vec2 sourceScale = a_sourceSize * texelSize / glm::vec2(viewport[2], viewport[3]);
+		glm::vec2 sourceMax = (a_sourceSize - 0.5f) * texelSize;
+
+		// A reused frame keeps the glow of the last one drawn, which is
+		//	the same.
+		bool bloom = m_settings.bloom && m_bloom.isCreated();
+		if (bloom && (a_newFrame || m_bloomBuilt == false))
+		{
+			m_bloom.build(a_source, a_sourceSize, a_textureSize, m_settings.exposure, m_settings.bloomThreshold);
+			m_bloomBuilt = true;
+		}
+		else if (bloom == false)
+			m_bloomBuilt = false;
+		bloom = bloom && m_bloom.getTexture() != 0;
+
+		// Every level is added into the glow, so it is averaged back out.
+		float bloomIntensity = bloom ? m_settings.bloomIntensity / (float)m_bloom.getLevelCount() : 0.0f;
+
+		RenderState& state = RenderState::instance();
+		state.bindTexture(SCENE_UNIT, a_source, m_sampler);
+		state.bindTexture(BLOOM_UNIT, bloom ? m_bloom.getTexture() : 0, m_sampler);
+
+		m_shader.bind();
+		m_shader.bindUniform(SCENE, (int)SCENE_UNIT);
+		m_shader.bindUniform(VIEWPORT, glm::vec2(viewport[0], viewport[1]));
+		m_shader.bindUniform(SOURCE_SCALE, sourceScale);
+		m_shader.bindUniform(SOURCE_MAX, sourceMax);
+		m_shader.bindUniform(TEXEL_SIZE, texelSize);
+		m_shader.bindUniform(EXPOSURE, m_settings.exposure);
+		m_shader.bindUniform(SATURATION, m_settings.saturation);
+		m_shader.bindUniform(CONTRAST, m_settings.contrast);
+		m_shader.bindUniform(TINT, m_settings.tint);
+		m_shader.bindUniform(FXAA, m_settings.fxaa ? 1 : 0);
+		m_shader.bindUniform(BLOOM, (int)BLOOM_UNIT);
+		m_shader.bindUniform(BLOOM_INTENSITY, bloomIntensity);
+		m_shader.bindUniform(BLOOM_SCALE, a_textureSize / a_sourceSize);
+
+		// Every pixel is written, nothing is tested.
+		state.setDepthTest(false);
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		state.setDepthTest(true);
+	}
+
+	/**
+		getAntiAliasingName returns a mode's name, as the benchmark is
+			given it.
+
+			@param1 a_mode is the mode.
+	*/
+	const char* PostProcess::getAntiAliasingName(AntiAliasing a_mode)
+	{
+		switch (a_mode)
+		{
+		case AntiAliasing::NONE: return "none";
+		case AntiAliasing::FXAA: return "fxaa";
+		case AntiAliasing::MSAA: return "msaa";
+		case AntiAliasing::TAA: return "taa";
+		case AntiAliasing::COUNT: break;
+		}
+		return "unknown";
+	}
+
+	/**
+		findAntiAliasing finds a mode from its name.
+
+			@param1 a_name is the name.
+
+			@param2 a_mode is set to the mode.
+
+			@return false if no mode has the name.
+	*/
+	bool PostProcess::findAntiAliasing(const char* a_name, AntiAliasing& a_mode)
+	{
+		for (int i = 0; i < (int)AntiAliasing::COUNT; ++i)
+		{
+			if (strcmp(a_name, getAntiAliasingName((AntiAliasing)i)) == 0)
+			{
+				a_mode = (AntiAliasing)i;
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,178 @@
+/**
+	PostProcess.h
+
+	Purpose: PostProcess.h is the header file for the PostProcess class.
+			The PostProcess takes the scene from the high dynamic range
+			it is lit in to the window in one full screen pass, which
+			adds its bloom, exposes, tonemaps, grades and anti-aliases
+			it together.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Bloom.h"
+#include "Shader.h"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace sns
+{
+	/**
+		How the scene's edges are anti-aliased.
+	*/
+	enum class AntiAliasing
+	{
+		// Not at all.
+		NONE,
+
+		// By the post process, from the colours around each pixel.
+		FXAA,
+
+		// By drawing the scene with four samples a pixel, and resolving
+		//	only its colour once it is drawn.
+		MSAA,
+
+		// By jittering the scene each frame and blending it into the
+		//	reprojected history, see TemporalUpsampler.
+		TAA,
+
+		COUNT
+	};
+
+	/**
+		The PostProcess class draws a floating point colour texture over
+			the framebuffer bound in a single pass. Each pixel is
+			exposed, tonemapped with a filmic curve and graded, then
+			FXAA smooths the edges it finds in the graded colour.
+
+		FXAA reads the texels around a pixel, so they are exposed and
+			tonemapped where they are read instead of in a pass of
+			their own. That costs a few more instructions a tap, but
+			the scene is only read once and nothing between passes is
+			written and read back, which is where a chain of passes
+			spends its time.
+
+		A Bloom blurs the scene's brightest parts before the pass, and
+			the pass adds it to the scene as it exposes it. It is only
+			built again for a newly drawn frame, a reused one adds the
+			glow it already has.
+
+		The source is read with linear filtering, so a scene drawn
+			smaller than the window is stretched over it by this pass
+			as well.
+
+		Needs GL 4.5, without it create fails and the scene should be
+			copied out as it is.
+	*/
+	class PostProcess
+	{
+	public:
+		/**
+			How the scene is taken to the window.
+		*/
+		struct Settings
+		{
+			// What the scene is multiplied by before it is tonemapped.
+			float exposure;
+
+			// Grading after the tonemap, 1 leaves the colour as it is.
+			float saturation;
+			float contrast;
+			glm::vec3 tint;
+
+			// Whether FXAA smooths the edges.
+			bool fxaa;
+
+			// Whether the scene glows, how bright the exposed scene is
+			//	before it does, and how much of the glow is added.
+			bool bloom;
+			float bloomThreshold;
+			float bloomIntensity;
+		};
+
+		PostProcess();
+
+		/**
+			The deconstructor deletes the vertex array.
+		*/
+		~PostProcess();
+
+		PostProcess(const PostProcess&) = delete;
+		PostProcess& operator=(const PostProcess&) = delete;
+
+		/**
+			create loads the shader and the bloom's.
+
+				@return false without GL 4.5 or the shader, it is left
+						uncreated. Without the bloom's it is drawn
+						without the glow.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vao != 0; }
+
+		/**
+			draw takes the bottom left of a texture to the whole of the
+				framebuffer bound, under the viewport bound.
+
+				@param1 a_source is the texture, in linear high dynamic
+						range.
+
+				@param2 a_sourceSize is how much of it, in texels, was
+						drawn into.
+
+				@param3 a_textureSize is its size.
+
+				@param4 a_newFrame is whether the texture was drawn
+						since the last draw, and the bloom is built
+						from it again.
+		*/
+		void draw(unsigned int a_source, const glm::vec2& a_sourceSize, const glm::vec2& a_textureSize,
+			bool a_newFrame = true);
+
+		/**
+			getAntiAliasingName returns a mode's name, as the benchmark
+				is given it.
+
+				@param1 a_mode is the mode.
+		*/
+		static const char* getAntiAliasingName(AntiAliasing a_mode);
+
+		/**
+			findAntiAliasing finds a mode from its name.
+
+				@param1 a_name is the name.
+
+				@param2 a_mode is set to the mode.
+
+				@return false if no mode has the name.
+		*/
+		static bool findAntiAliasing(const char* a_name, AntiAliasing& a_mode);
+
+		/**
+			getSettings returns how the scene is taken to the window.
+		*/
+		Settings& getSettings() { return m_settings; }
+		const Settings& getSettings() const { return m_settings; }
+
+	private:
+		aie::ShaderProgram m_shader;
+
+		// Reads the source with linear filtering, whatever its own
+		//	filtering is.
+		unsigned int m_sampler;
+
+		// An empty vertex array for the full screen triangle.
+		unsigned int m_vao;
+
+		Bloom m_bloom;
+
+		// Whether m_bloom holds the glow of the last frame drawn.
+		bool m_bloomBuilt;
+
+		Settings m_settings;
+	};
+}
@@ -0,0 +1,342 @@
+/**
+	Primitives.cpp
+
+	Purpose: Primitives.cpp is the source file for the Primitives class.
+			Primitives builds planes, spheres, cylinders, tori and boxes
+			as indexed meshes, and keeps those made so every request for
+			the same shape shares one set of buffers.
+
+	@author Nathan Nette
+*/
+#include "Primitives.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace
+{
+	Mesh::Vertex makeVertex(const glm::vec3& a_position, const glm::vec3& a_normal, const glm::vec2& a_texCoord)
+	{
+		Mesh::Vertex vertex;
+		vertex.position = glm::vec4(a_position, 1);
+		vertex.normal = glm::vec4(a_normal, 0);
+		vertex.texCoord = a_texCoord;
+		return vertex;
+	}
+
+	// Adds the two triangles of a quad whose corners go counter-clockwise.
+	void addQuad(std::vector<unsigned int>& a_indices, unsigned int a_0, unsigned int a_1, unsigned int a_2,
+		unsigned int a_3)
+	{
+		unsigned int quad[] = { a_0, a_1, a_2, a_0, a_2, a_3 };
+		a_indices.insert(a_indices.end(), quad, quad + 6);
+	}
+}
+
+namespace sns
+{
+	/**
+		instance returns the process wide cache.
+	*/
+	Primitives& Primitives::instance()
+	{
+		static Primitives primitives;
+		return primitives;
+	}
+
+	/**
+		getPlane returns the plane cut into a grid of quads.
+
+			@param1 a_columns is how many quads across X, at least 1.
+
+			@param2 a_rows is how many quads across Z, at least 1.
+	*/
+	std::shared_ptr<Mesh> Primitives::getPlane(unsigned int a_columns, unsigned int a_rows)
+	{
+		return acquire({ PLANE, std::max(a_columns, 1u), std::max(a_rows, 1u), 0.0f });
+	}
+
+	/**
+		getSphere returns the sphere.
+
+			@param1 a_rows is how many bands there are from pole to pole,
+					at least 2.
+
+			@param2 a_columns is how many segments there are around it, at
+					least 3.
+	*/
+	std::shared_ptr<Mesh> Primitives::getSphere(unsigned int a_rows, unsigned int a_columns)
+	{
+		return acquire({ SPHERE, std::max(a_rows, 2u), std::max(a_columns, 3u), 0.0f });
+	}
+
+	/**
+		getCylinder returns the cylinder, capped at both ends.
+
+			@param1 a_segments is how many faces there are around it, at
+					least 3.
+	*/
+	std::shared_ptr<Mesh> Primitives::getCylinder(unsigned int a_segments)
+	{
+		return acquire({ CYLINDER, std::max(a_segments, 3u), 0, 0.0f });
+	}
+
+	/**
+		getTorus returns the torus around Y.
+
+			@param1 a_tubeRadius is the radius of its tube, under 1.
+
+			@param2 a_rings is how many segments there are around Y, at
+					least 3.
+
+			@param3 a_sides is how many there are around the tube, at least
+					3.
+	*/
+	std::shared_ptr<Mesh> Primitives::getTorus(float a_tubeRadius, unsigned int a_rings, unsigned int a_sides)
+	{
+		return acquire({ TORUS, std::max(a_rings, 3u), std::max(a_sides, 3u), a_tubeRadius });
+	}
+
+	/**
+		getBox returns the box, each face with its own vertices.
+	*/
+	std::shared_ptr<Mesh> Primitives::getBox()
+	{
+		return acquire({ BOX, 0, 0, 0.0f });
+	}
+
+	/**
+		prune drops the entries whose meshes have all been released.
+	*/
+	void Primitives::prune()
+	{
+		for (auto it = m_meshes.begin(); it != m_meshes.end();)
+		{
+			if (it->second.expired())
+				it = m_meshes.erase(it);
+			else
+				++it;
+		}
+	}
+
+	void Primitives::buildPlane(unsigned int a_columns, unsigned int a_rows,
+		std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		a_vertices.clear();
+		a_indices.clear();
+
+		// V runs with Z as the quad's does, 1 at the +Z edge
+		for (unsigned int row = 0; row <= a_rows; ++row)
+		{
+			for (unsigned int column = 0; column <= a_columns; ++column)
+			{
+				glm::vec2 texCoord((float)column / a_columns, (float)row / a_rows);
+				a_vertices.push_back(makeVertex(glm::vec3(texCoord.x - 0.5f, 0, texCoord.y - 0.5f),
+					glm::vec3(0, 1, 0), texCoord));
+			}
+		}
+
+		for (unsigned int row = 0; row < a_rows; ++row)
+		{
+			for (unsigned int column = 0; column < a_columns; ++column)
+			{
+				unsigned int corner = row * (a_columns + 1) + column;
+				addQuad(a_indices, corner + a_columns + 1, corner + a_columns + 2, corner + 1, corner);
+			}
+		}
+	}
+
+	void Primitives::buildSphere(unsigned int a_rows, unsigned int a_columns,
+		std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		a_vertices.clear();
+		a_indices.clear();
+		const float pi = glm::pi<float>();
+
+		// rows run up from the south pole, the seam's column is doubled so
+		//	U can reach 1
+		for (unsigned int row = 0; row <= a_rows; ++row)
+		{
+			float latitude = pi * row / a_rows - pi * 0.5f;
+			for (unsigned int column = 0; column <= a_columns; ++column)
+			{
+				float longitude = 2 * pi * column / a_columns;
+				glm::vec3 position(cosf(latitude) * sinf(longitude), sinf(latitude), cosf(latitude) * cosf(longitude));
+
+				// on a unit sphere the position is the normal
+				a_vertices.push_back(makeVertex(position, position,
+					glm::vec2((float)column / a_columns, 1.0f - (float)row / a_rows)));
+			}
+		}
+
+		// the triangles that would meet at a pole are left out
+		for (unsigned int row = 0; row < a_rows; ++row)
+		{
+			for (unsigned int column = 0; column < a_columns; ++column)
+			{
+				unsigned int i00 = row * (a_columns + 1) + column;
+				unsigned int i01 = i00 + 1;
+				unsigned int i10 = i00 + a_columns + 1;
+				unsigned int i11 = i10 + 1;
+
+				if (row != 0)
+				{
+					unsigned int triangle[] = { i00, i01, i11 };
+					a_indices.insert(a_indices.end(), triangle, triangle + 3);
+				}
+				if (row + 1 != a_rows)
+				{
+					unsigned int triangle[] = { i00, i11, i10 };
+					a_indices.insert(a_indices.end(), triangle, triangle + 3);
+				}
+			}
+		}
+	}
+
+	void Primitives::buildCylinder(unsigned int a_segments,
+		std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		a_vertices.clear();
+		a_indices.clear();
+		const float pi = glm::pi<float>();
+		const glm::vec3 up(0, 1, 0);
+
+		// the side, a bottom and top vertex each segment with the seam doubled
+		for (unsigned int i = 0; i <= a_segments; ++i)
+		{
+			float angle = 2 * pi * i / a_segments;
+			glm::vec3 normal(sinf(angle), 0, cosf(angle));
+			float u = (float)i / a_segments;
+			a_vertices.push_back(makeVertex(normal - up, normal, glm::vec2(u, 1)));
+			a_vertices.push_back(makeVertex(normal + up, normal, glm::vec2(u, 0)));
+		}
+		for (unsigned int i = 0; i < a_segments; ++i)
+			addQuad(a_indices, i * 2, i * 2 + 2, i * 2 + 3, i * 2 + 1);
+
+		// the caps have their own vertices for their flat normals, each a
+		//	fan around its centre
+		for (int cap = -1; cap <= 1; cap += 2)
+		{
+			glm::vec3 normal = up * (float)cap;
+			unsigned int centre = (unsigned int)a_vertices.size();
+			a_vertices.push_back(makeVertex(normal, normal, glm::vec2(0.5f)));
+
+			for (unsigned int i = 0; i < a_segments; ++i)
+			{
+				float angle = 2 * pi * i / a_segments;
+				glm::vec3 direction(sinf(angle), 0, cosf(angle));
+				a_vertices.push_back(makeVertex(direction + normal, normal,
+					glm::vec2(0.5f + 0.5f * direction.x, 0.5f + 0.5f * direction.z * -cap)));
+			}
+
+			for (unsigned int i = 0; i < a_segments; ++i)
+			{
+				unsigned int current = centre + 1 + i;
+				unsigned int next = centre + 1 + (i + 1) % a_segments;
+				unsigned int triangle[] = { centre, cap > 0 ? current : next, cap > 0 ? next : current };
+				a_indices.insert(a_indices.end(), triangle, triangle + 3);
+			}
+		}
+	}
+
+	void Primitives::buildTorus(float a_tubeRadius, unsigned int a_rings, unsigned int a_sides,
+		std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		a_vertices.clear();
+		a_indices.clear();
+		const float pi = glm::pi<float>();
+
+		// each ring is a circle of the tube around its centre on the unit
+		//	circle, both seams doubled
+		for (unsigned int ring = 0; ring <= a_rings; ++ring)
+		{
+			float ringAngle = 2 * pi * ring / a_rings;
+			glm::vec3 outward(sinf(ringAngle), 0, cosf(ringAngle));
+			for (unsigned int side = 0; side <= a_sides; ++side)
+			{
+				float sideAngle = 2 * pi * side / a_sides;
+				glm::vec3 normal = outward * cosf(sideAngle) + glm::vec3(0, sinf(sideAngle), 0);
+				a_vertices.push_back(makeVertex(outward + normal * a_tubeRadius, normal,
+					glm::vec2((float)ring / a_rings, (float)side / a_sides)));
+			}
+		}
+
+		for (unsigned int ring = 0; ring < a_rings; ++ring)
+		{
+			for (unsigned int side = 0; side < a_sides; ++side)
+			{
+				unsigned int corner = ring * (a_sides + 1) + side;
+				addQuad(a_indices, corner, corner + a_sides + 1, corner + a_sides + 2, corner + 1);
+			}
+		}
+	}
+
+	void Primitives::buildBox(std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices)
+	{
+		a_vertices.clear();
+		a_indices.clear();
+
+		// a face either side of each axis, its corners counter-clockwise
+		//	from the normal's side
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (int sign = -1; sign <= 1; sign += 2)
+			{
+				glm::vec3 normal(0), u(0), v(0);
+				normal[axis] = (float)sign;
+				u[(axis + 1) % 3] = 1;
+				v[(axis + 2) % 3] = 1;
+				if (sign < 0)
+					std::swap(u, v);
+
+				unsigned int first = (unsigned int)a_vertices.size();
+				a_vertices.push_back(makeVertex(normal - u - v, normal, glm::vec2(0, 1)));
+				a_vertices.push_back(makeVertex(normal + u - v, normal, glm::vec2(1, 1)));
+				a_vertices.push_back(makeVertex(normal + u + v, normal, glm::vec2(1, 0)));
+				a_vertices.push_back(makeVertex(normal - u + v, normal, glm::vec2(0, 0)));
+				addQuad(a_indices, first, first + 1, first + 2, first + 3);
+			}
+		}
+	}
+
+	bool Primitives::Key::operator<(const Key& a_other) const
+	{
+		return std::tie(shape, first, second, radius) <
+			std::tie(a_other.shape, a_other.first, a_other.second, a_other.radius);
+	}
+
+	std::shared_ptr<Mesh> Primitives::acquire(const Key& a_key)
+	{
+		std::weak_ptr<Mesh>& entry = m_meshes[a_key];
+		std::shared_ptr<Mesh> mesh = entry.lock();
+		if (mesh != nullptr)
+			return mesh;
+
+		std::vector<Mesh::Vertex> vertices;
+		std::vector<unsigned int> indices;
+		switch (a_key.shape)
+		{
+		case PLANE:
+			buildPlane(a_key.first, a_key.second, vertices, indices);
+			break;
+		case SPHERE:
+			buildSphere(a_key.first, a_key.second, vertices, indices);
+			break;
+		case CYLINDER:
+			buildCylinder(a_key.first, vertices, indices);
+			break;
+		case TORUS:
+			buildTorus(a_key.radius, a_key.first, a_key.second, vertices, indices);
+			break;
+		case BOX:
+			buildBox(vertices, indices);
+			break;
+		}
+
+		mesh = std::make_shared<Mesh>();
+		mesh->initialise((unsigned int)vertices.size(), vertices.data(), (unsigned int)indices.size(), indices.data());
+		entry = mesh;
+		return mesh;
+	}
+}
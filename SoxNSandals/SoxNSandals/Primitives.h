@@ -0,0 +1,137 @@
+/**
+	Primitives.h
+
+	Purpose: Primitives.h is the header file for the Primitives class.
+			Primitives builds planes, spheres, cylinders, tori and boxes
+			as indexed meshes, and keeps those made so every request for
+			the same shape shares one set of buffers.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Mesh.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The Primitives class builds each shape once for a set of
+			parameters. The build functions only fill vectors, so they
+			can run anywhere, the get functions initialise a Mesh and
+			must be called on the context thread.
+
+		Every shape is built counter-clockwise, facing out, and at unit
+			size to be scaled by its transform. The plane is the quad's
+			square from -0.5 to 0.5 in XZ, facing up. The sphere, torus
+			and cylinder have a radius of 1 and the cylinder and box
+			reach from -1 to 1, as the gizmos' primitives do.
+	*/
+	class Primitives
+	{
+	public:
+		/**
+			instance returns the process wide cache.
+		*/
+		static Primitives& instance();
+
+		Primitives(const Primitives&) = delete;
+		Primitives& operator=(const Primitives&) = delete;
+
+		/**
+			getPlane returns the plane cut into a grid of quads.
+
+				@param1 a_columns is how many quads across X, at least 1.
+
+				@param2 a_rows is how many quads across Z, at least 1.
+		*/
+		std::shared_ptr<Mesh> getPlane(unsigned int a_columns, unsigned int a_rows);
+
+		/**
+			getSphere returns the sphere.
+
+				@param1 a_rows is how many bands there are from pole to
+						pole, at least 2.
+
+				@param2 a_columns is how many segments there are around
+						it, at least 3.
+		*/
+		std::shared_ptr<Mesh> getSphere(unsigned int a_rows, unsigned int a_columns);
+
+		/**
+			getCylinder returns the cylinder, capped at both ends.
+
+				@param1 a_segments is how many faces there are around it,
+						at least 3.
+		*/
+		std::shared_ptr<Mesh> getCylinder(unsigned int a_segments);
+
+		/**
+			getTorus returns the torus around Y.
+
+				@param1 a_tubeRadius is the radius of its tube, under 1.
+
+				@param2 a_rings is how many segments there are around Y,
+						at least 3.
+
+				@param3 a_sides is how many there are around the tube, at
+						least 3.
+		*/
+		std::shared_ptr<Mesh> getTorus(float a_tubeRadius, unsigned int a_rings, unsigned int a_sides);
+
+		/**
+			getBox returns the box, each face with its own vertices.
+		*/
+		std::shared_ptr<Mesh> getBox();
+
+		/**
+			prune drops the entries whose meshes have all been released.
+		*/
+		void prune();
+
+		/**
+			The build functions replace what is in the vectors with a
+				shape's vertices and triangles, as the get functions of
+				the same name take it.
+		*/
+		static void buildPlane(unsigned int a_columns, unsigned int a_rows,
+			std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+		static void buildSphere(unsigned int a_rows, unsigned int a_columns,
+			std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+		static void buildCylinder(unsigned int a_segments,
+			std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+		static void buildTorus(float a_tubeRadius, unsigned int a_rings, unsigned int a_sides,
+			std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+		static void buildBox(std::vector<Mesh::Vertex>& a_vertices, std::vector<unsigned int>& a_indices);
+
+	private:
+		Primitives() {}
+
+		enum Shape
+		{
+			PLANE,
+			SPHERE,
+			CYLINDER,
+			TORUS,
+			BOX
+		};
+
+		// a shape and the parameters it was built with, those it doesn't
+		//	take are 0
+		struct Key
+		{
+			Shape shape;
+			unsigned int first;
+			unsigned int second;
+			float radius;
+
+			bool operator<(const Key& a_other) const;
+		};
+
+		// returns the mesh for a key, building it if it isn't alive
+		std::shared_ptr<Mesh> acquire(const Key& a_key);
+
+		std::map<Key, std::weak_ptr<Mesh>> m_meshes;
+	};
+}
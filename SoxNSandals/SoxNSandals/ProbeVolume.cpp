@@ -0,0 +1,310 @@
+/**
+	ProbeVolume.cpp
+
+	Purpose: ProbeVolume.cpp is the source file for the ProbeVolume
+			class. The ProbeVolume traces a few of its irradiance probes
+			and a face of a reflection probe each frame, so what moves
+			through the static scene is lit by it without a frame that
+			refreshes them all.
+
+	@author Nathan Nette
+*/
+#include "ProbeVolume.h"
+#include "GpuMemory.h"
+#include "SamplerCache.h"
+#include "TraceScene.h"
+#include "gl_core_4_5.h"
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	// The irradiance probes' image and the reflection probes', as the
+	//	shaders bind them.
+	static const unsigned int IRRADIANCE_IMAGE = 0;
+	static const unsigned int REFLECTION_IMAGE = 1;
+
+	// Premultiplied harmonics only need half floats.
+	static const unsigned int PROBE_FORMAT = GL_RGBA16F;
+
+	// Must match local_size in probeReflection.comp.
+	static const unsigned int REFLECTION_GROUP_SIZE = 8;
+
+	ProbeVolume::ProbeVolume()
+		: m_min(0.0f),
+		m_spacing(1.0f),
+		m_counts(0),
+		m_probeCount(0),
+		m_reflectionCount(0),
+		m_reflectionLevels(1),
+		m_irradianceSampler(0),
+		m_reflectionSampler(0),
+		m_nextProbe(0),
+		m_nextFace(0),
+		m_round(0),
+		m_updated(0),
+		m_cleared(false),
+		m_skyColour(0.0f)
+	{
+	}
+
+	/**
+		The deconstructor lets the handles delete the textures. The
+			samplers belong to the SamplerCache.
+	*/
+	ProbeVolume::~ProbeVolume()
+	{
+	}
+
+	/**
+		create spreads the irradiance probes evenly from corner to corner
+			of the box, as near a_spacing apart as a whole number of them
+			allows, and makes the textures and programs.
+
+			@param1 a_min is the box's lowest corner.
+
+			@param2 a_max is its highest corner.
+
+			@param3 a_spacing is about how far apart the irradiance probes
+					are.
+
+			@param4 a_reflections are where the reflection probes are.
+
+			@param5 a_reflectionCount is how many there are.
+
+			@return false without GL 4.5 or the programs, it is left
+					uncreated.
+	*/
+	bool ProbeVolume::create(const glm::vec3& a_min, const glm::vec3& a_max, float a_spacing,
+		const glm::vec3* a_reflections, unsigned int a_reflectionCount)
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("ProbeVolume: tracing probes needs GL 4.5.\n");
+			return false;
+		}
+
+		m_irradianceShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/probeIrradiance.comp");
+		m_reflectionShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/probeReflection.comp");
+		aie::ShaderProgram* programs[] = { &m_irradianceShader, &m_reflectionShader };
+		for (aie::ShaderProgram* program : programs)
+		{
+			if (program->link() == false)
+			{
+				printf("Shader Error: %s\n", program->getLastError());
+				return false;
+			}
+		}
+
+		glm::vec3 extent = glm::max(a_max - a_min, glm::vec3(1e-3f));
+		for (unsigned int axis = 0; axis < 3; ++axis)
+		{
+			unsigned int count = (unsigned int)std::lround(extent[axis] / std::max(a_spacing, 1e-3f)) + 1;
+			m_counts[axis] = std::min(std::max(count, 2u), MAX_AXIS_PROBES);
+		}
+		m_min = a_min;
+		m_spacing = extent / glm::vec3(m_counts - glm::uvec3(1));
+
+		// The red, green and blue blocks one above the other.
+		GpuMemory& memory = GpuMemory::instance();
+		glCreateTextures(GL_TEXTURE_3D, 1, m_irradiance.put());
+		glTextureStorage3D(m_irradiance, 1, PROBE_FORMAT, m_counts.x, m_counts.y, m_counts.z * 3);
+		memory.trackTexture(m_irradiance, GpuMemory::getTextureBytes(PROBE_FORMAT, m_counts.x, m_counts.y, m_counts.z * 3),
+			GpuMemory::LIGHTING, "ProbeVolume");
+		m_irradianceSampler = SamplerCache::instance().get({ GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, false });
+
+		m_reflectionCount = std::min(a_reflectionCount, MAX_REFLECTION_PROBES);
+		for (unsigned int i = 0; i < m_reflectionCount; ++i)
+			m_reflectionPositions[i] = glm::vec4(a_reflections[i], 0.0f);
+		if (m_reflectionCount > 0)
+		{
+			m_reflectionLevels = 1;
+			while ((REFLECTION_RESOLUTION >> m_reflectionLevels) != 0)
+				++m_reflectionLevels;
+			glCreateTextures(GL_TEXTURE_CUBE_MAP_ARRAY, 1, m_reflections.put());
+			glTextureStorage3D(m_reflections, m_reflectionLevels, PROBE_FORMAT, REFLECTION_RESOLUTION,
+				REFLECTION_RESOLUTION, m_reflectionCount * 6);
+			memory.trackTexture(m_reflections, GpuMemory::getTextureBytes(PROBE_FORMAT, REFLECTION_RESOLUTION,
+				REFLECTION_RESOLUTION, m_reflectionCount * 6, m_reflectionLevels), GpuMemory::LIGHTING, "ProbeVolume");
+			m_reflectionSampler = SamplerCache::instance().get({ GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE,
+				GL_CLAMP_TO_EDGE, false });
+		}
+
+		m_probeCount = m_counts.x * m_counts.y * m_counts.z;
+		m_nextProbe = 0;
+		m_nextFace = 0;
+		m_round = 0;
+		m_cleared = false;
+		printf("ProbeVolume: %u x %u x %u irradiance probes, %u reflection probes\n", m_counts.x, m_counts.y,
+			m_counts.z, m_reflectionCount);
+		return true;
+	}
+
+	/**
+		reset starts every probe again from the open sky on the next
+			update.
+	*/
+	void ProbeVolume::reset()
+	{
+		m_cleared = false;
+	}
+
+	/**
+		clearProbes fills every irradiance probe with the light of an
+			open sky, only a constant band, and every reflection probe
+			with the sky itself, as they are before anything is traced.
+
+			@param1 a_skyColour is the sky's colour.
+	*/
+	void ProbeVolume::clearProbes(const glm::vec3& a_skyColour)
+	{
+		for (unsigned int channel = 0; channel < 3; ++channel)
+		{
+			float value[4] = { a_skyColour[channel], 0.0f, 0.0f, 0.0f };
+			glClearTexSubImage(m_irradiance, 0, 0, 0, m_counts.z * channel, m_counts.x, m_counts.y, m_counts.z,
+				GL_RGBA, GL_FLOAT, value);
+		}
+		if (m_reflectionCount > 0)
+		{
+			float sky[4] = { a_skyColour.r, a_skyColour.g, a_skyColour.b, 1.0f };
+			for (unsigned int level = 0; level < m_reflectionLevels; ++level)
+				glClearTexImage(m_reflections, level, GL_RGBA, GL_FLOAT, sky);
+		}
+		m_skyColour = a_skyColour;
+		m_cleared = true;
+	}
+
+	/**
+		update traces the next PROBES_PER_UPDATE irradiance probes, going
+			round to the first after the last, and the next face of the
+			next reflection probe. A reflection probe's mips are filtered
+			once its sixth face is traced. The probes start again from
+			the sky whenever its colour changes.
+
+			@param1 a_scene is what the rays are traced through.
+
+			@param2 a_sunDirection is the way the sun's light travels.
+
+			@param3 a_sunColour is the colour it lights a surface facing it.
+
+			@param4 a_skyColour is the colour the sky lights a surface open
+					to all of it.
+	*/
+	void ProbeVolume::update(const TraceScene& a_scene, const glm::vec3& a_sunDirection, const glm::vec3& a_sunColour,
+		const glm::vec3& a_skyColour)
+	{
+		static constexpr aie::UniformHandle FIRST_PROBE("FirstProbe");
+		static constexpr aie::UniformHandle PROBE_TOTAL("ProbeTotal");
+		static constexpr aie::UniformHandle PROBE_COUNTS("ProbeCounts");
+		static constexpr aie::UniformHandle PROBE_MIN("ProbeMin");
+		static constexpr aie::UniformHandle PROBE_SPACING("ProbeSpacing");
+		static constexpr aie::UniformHandle SEED("Seed");
+		static constexpr aie::UniformHandle HYSTERESIS_UNIFORM("Hysteresis");
+		static constexpr aie::UniformHandle SUN_DIRECTION("SunDirection");
+		static constexpr aie::UniformHandle SUN_COLOUR("SunColour");
+		static constexpr aie::UniformHandle SKY_COLOUR("SkyColour");
+		static constexpr aie::UniformHandle RAY_BIAS("RayBias");
+		static constexpr aie::UniformHandle PROBE_POSITION("ProbePosition");
+		static constexpr aie::UniformHandle PROBE_LAYER("ProbeLayer");
+		static constexpr aie::UniformHandle FACE("Face");
+
+		m_updated = 0;
+		if (isCreated() == false || a_scene.isEmpty())
+			return;
+		if (m_cleared == false || a_skyColour != m_skyColour)
+			clearProbes(a_skyColour);
+
+		// Both programs are given the way to the sun, not the way its
+		//	light goes, and read the irradiance probes through the same
+		//	image.
+		a_scene.bind();
+		glBindImageTexture(IRRADIANCE_IMAGE, m_irradiance, 0, GL_TRUE, 0, GL_READ_WRITE, PROBE_FORMAT);
+		aie::ShaderProgram* programs[] = { &m_irradianceShader, &m_reflectionShader };
+		for (aie::ShaderProgram* program : programs)
+		{
+			program->bind();
+			program->bindUniform(PROBE_COUNTS, glm::vec3(m_counts));
+			program->bindUniform(PROBE_MIN, m_min);
+			program->bindUniform(PROBE_SPACING, m_spacing);
+			program->bindUniform(SEED, (int)m_round);
+			program->bindUniform(SUN_DIRECTION, -glm::normalize(a_sunDirection));
+			program->bindUniform(SUN_COLOUR, a_sunColour);
+			program->bindUniform(SKY_COLOUR, a_skyColour);
+			program->bindUniform(RAY_BIAS, a_scene.getRayBias());
+		}
+
+		// A workgroup a probe.
+		unsigned int probes = std::min(PROBES_PER_UPDATE, m_probeCount);
+		m_irradianceShader.bind();
+		m_irradianceShader.bindUniform(FIRST_PROBE, (int)m_nextProbe);
+		m_irradianceShader.bindUniform(PROBE_TOTAL, (int)m_probeCount);
+		m_irradianceShader.bindUniform(HYSTERESIS_UNIFORM, HYSTERESIS);
+		glDispatchCompute(probes, 1, 1);
+		m_updated = probes;
+		m_nextProbe += probes;
+		if (m_nextProbe >= m_probeCount)
+			m_nextProbe -= m_probeCount;
+		++m_round;
+
+		// The reflection faces read the irradiance just written.
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		if (m_reflectionCount > 0)
+		{
+			unsigned int probe = m_nextFace / 6;
+			unsigned int face = m_nextFace % 6;
+			m_reflectionShader.bind();
+			m_reflectionShader.bindUniform(PROBE_POSITION, glm::vec3(m_reflectionPositions[probe]));
+			m_reflectionShader.bindUniform(PROBE_LAYER, (int)probe);
+			m_reflectionShader.bindUniform(FACE, (int)face);
+			glBindImageTexture(REFLECTION_IMAGE, m_reflections, 0, GL_TRUE, 0, GL_WRITE_ONLY, PROBE_FORMAT);
+			unsigned int groups = (REFLECTION_RESOLUTION + REFLECTION_GROUP_SIZE - 1) / REFLECTION_GROUP_SIZE;
+			glDispatchCompute(groups, groups, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+			if (face == 5)
+				glGenerateTextureMipmap(m_reflections);
+			m_nextFace = (m_nextFace + 1) % (m_reflectionCount * 6);
+		}
+	}
+
+	/**
+		bind binds the probes to their units and points a program's
+			samplers at them. The samplers are pointed at their units
+			even without probes, as a 3D or cube sampler left on a
+			material's unit can't be drawn with.
+
+			@param1 a_program is the program, which must be bound.
+	*/
+	void ProbeVolume::bind(aie::ShaderProgram& a_program) const
+	{
+		static constexpr aie::UniformHandle PROBE_IRRADIANCE("ProbeIrradiance");
+		static constexpr aie::UniformHandle REFLECTION_PROBES("ReflectionProbes");
+		static constexpr aie::UniformHandle PROBE_COUNTS("ProbeCounts");
+		static constexpr aie::UniformHandle PROBE_MIN("ProbeMin");
+		static constexpr aie::UniformHandle PROBE_SPACING("ProbeSpacing");
+		static constexpr aie::UniformHandle REFLECTION_PROBE_POSITIONS("ReflectionProbePositions");
+		static constexpr aie::UniformHandle REFLECTION_PROBE_COUNT("ReflectionProbeCount");
+		static constexpr aie::UniformHandle REFLECTION_LEVELS("ReflectionLevels");
+
+		if (a_program.bindUniform(PROBE_IRRADIANCE, (int)IRRADIANCE_UNIT) == false)
+			return;
+		a_program.bindUniform(REFLECTION_PROBES, (int)REFLECTION_UNIT);
+		if (isCreated() == false)
+			return;
+
+		glBindTextureUnit(IRRADIANCE_UNIT, m_irradiance);
+		glBindSampler(IRRADIANCE_UNIT, m_irradianceSampler);
+		glBindTextureUnit(REFLECTION_UNIT, m_reflections);
+		glBindSampler(REFLECTION_UNIT, m_reflectionSampler);
+		a_program.bindUniform(PROBE_COUNTS, glm::vec3(m_counts));
+		a_program.bindUniform(PROBE_MIN, m_min);
+		a_program.bindUniform(PROBE_SPACING, m_spacing);
+		a_program.bindUniform(REFLECTION_PROBE_POSITIONS, (int)MAX_REFLECTION_PROBES, m_reflectionPositions);
+		a_program.bindUniform(REFLECTION_PROBE_COUNT, (int)m_reflectionCount);
+		a_program.bindUniform(REFLECTION_LEVELS, (float)m_reflectionLevels);
+	}
+}
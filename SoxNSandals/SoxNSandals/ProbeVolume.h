@@ -0,0 +1,192 @@
+/**
+	ProbeVolume.h
+
+	Purpose: ProbeVolume.h is the header file for the ProbeVolume class.
+			The ProbeVolume lights what moves through the static scene
+			from a grid of irradiance probes and a few reflection
+			probes, traced a few at a time each frame on the gpu.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace sns
+{
+	class TraceScene;
+
+	/**
+		The ProbeVolume class spreads irradiance probes through a box,
+			evenly from corner to corner, and places up to
+			MAX_REFLECTION_PROBES reflection probes where it is told.
+
+		Each irradiance probe holds the light arriving at it from every
+			way but the sun's, whose direct light the lit shaders add
+			themselves, as the first two bands of spherical harmonics.
+			They are premultiplied so the light on a normal, in the
+			units the lightmap and lights are, is one dot product a
+			colour channel. Each channel is a block of a 3D texture,
+			stacked along z, so the lit shaders read it filtered
+			between the probes.
+
+		Each update traces RAYS_PER_PROBE rays from the next
+			PROBES_PER_UPDATE irradiance probes through a TraceScene,
+			turned a little further each round, and blends what they
+			bring back into what the probes held by HYSTERESIS. A ray
+			that hits brings the surface's emission and its albedo
+			times the sun there, through a shadow ray, and the probes'
+			own light there from their last update, so the bounces add
+			up over the rounds. A ray that leaves the scene sees the
+			sky.
+
+		Each update also traces one face of the next reflection probe's
+			cube the same way, a ray a texel, and filters its mips once
+			all six faces are done, so the lit shaders read blurrier
+			reflections for rougher materials. Its lit programs read
+			the probe nearest each fragment.
+
+		So nothing ever has to be refreshed at once, a scene that changes
+			is traced into the probes over the next rounds. Needs GL
+			4.5, without it create fails and nothing reads the probes.
+	*/
+	class ProbeVolume
+	{
+	public:
+		// The most probes along each side of the box.
+		static const unsigned int MAX_AXIS_PROBES = 32;
+
+		// The irradiance probes each update traces, and the rays each,
+		//	must match probeIrradiance.comp.
+		static const unsigned int PROBES_PER_UPDATE = 64;
+		static const unsigned int RAYS_PER_PROBE = 128;
+
+		// How much of what a probe held is kept through each update.
+		static constexpr float HYSTERESIS = 0.9f;
+
+		// Must match probes.glsl.
+		static const unsigned int MAX_REFLECTION_PROBES = 8;
+
+		// The width of each face of a reflection probe.
+		static const unsigned int REFLECTION_RESOLUTION = 64;
+
+		// The texture units the lit shaders read the probes from, clear
+		//	of every unit another pass binds.
+		static const unsigned int IRRADIANCE_UNIT = 22;
+		static const unsigned int REFLECTION_UNIT = 23;
+
+		ProbeVolume();
+		~ProbeVolume();
+
+		ProbeVolume(const ProbeVolume&) = delete;
+		ProbeVolume& operator=(const ProbeVolume&) = delete;
+
+		/**
+			create spreads the probes and makes their textures and the
+				programs that trace them.
+
+				@param1 a_min is the box's lowest corner.
+
+				@param2 a_max is its highest corner.
+
+				@param3 a_spacing is about how far apart the irradiance
+						probes are, there are at least two and at most
+						MAX_AXIS_PROBES along each side.
+
+				@param4 a_reflections are where the reflection probes are.
+
+				@param5 a_reflectionCount is how many there are, up to
+						MAX_REFLECTION_PROBES.
+
+				@return false without GL 4.5 or the programs, it is left
+						uncreated.
+		*/
+		bool create(const glm::vec3& a_min, const glm::vec3& a_max, float a_spacing,
+			const glm::vec3* a_reflections, unsigned int a_reflectionCount);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_probeCount != 0; }
+
+		/**
+			update traces the next irradiance probes and the next face of
+				a reflection probe.
+
+				@param1 a_scene is what the rays are traced through, built.
+
+				@param2 a_sunDirection is the way the sun's light travels,
+						as the lights' direction is.
+
+				@param3 a_sunColour is the colour it lights a surface facing
+						it.
+
+				@param4 a_skyColour is the colour the sky lights a surface
+						open to all of it.
+		*/
+		void update(const TraceScene& a_scene, const glm::vec3& a_sunDirection, const glm::vec3& a_sunColour,
+			const glm::vec3& a_skyColour);
+
+		/**
+			reset starts every probe again from the open sky, for a scene
+				that changed so much its old light would be wrong for
+				many rounds.
+		*/
+		void reset();
+
+		/**
+			getProbeCount returns how many irradiance probes there are.
+		*/
+		unsigned int getProbeCount() const { return m_probeCount; }
+
+		/**
+			getUpdatedCount returns how many irradiance probes the last
+				update traced.
+		*/
+		unsigned int getUpdatedCount() const { return m_updated; }
+
+		/**
+			bind binds the probes to their units and points a program's
+				samplers at them, if it has them.
+
+				@param1 a_program is the program, which must be bound.
+		*/
+		void bind(aie::ShaderProgram& a_program) const;
+
+	private:
+		// Fills the probes with the open sky.
+		void clearProbes(const glm::vec3& a_skyColour);
+
+		aie::ShaderProgram m_irradianceShader;
+		aie::ShaderProgram m_reflectionShader;
+
+		// The irradiance probes, where the first one is, how far apart
+		//	they are and how many are along each side.
+		TextureHandle m_irradiance;
+		glm::vec3 m_min;
+		glm::vec3 m_spacing;
+		glm::uvec3 m_counts;
+		unsigned int m_probeCount;
+
+		// The reflection probes, a cube of the array each.
+		TextureHandle m_reflections;
+		glm::vec4 m_reflectionPositions[MAX_REFLECTION_PROBES];
+		unsigned int m_reflectionCount;
+		unsigned int m_reflectionLevels;
+
+		unsigned int m_irradianceSampler;
+		unsigned int m_reflectionSampler;
+
+		// The next irradiance probe and reflection face to trace, the
+		//	round the rays are turned for, and what the probes were
+		//	last cleared to.
+		unsigned int m_nextProbe;
+		unsigned int m_nextFace;
+		unsigned int m_round;
+		unsigned int m_updated;
+		bool m_cleared;
+		glm::vec3 m_skyColour;
+	};
+}
@@ -0,0 +1,474 @@
+/**
+	Profiler.cpp
+
+	Purpose: Profiler.cpp is the source file for the Profiler class. The
+			Profiler records how long named parts of each frame take on
+			the cpu and the gpu, keeps the last frames and can write them
+			out as a Chrome trace.
+
+	@author Nathan Nette
+*/
+#include "Profiler.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+	// Deeper scopes than this are still timed, just not as nested.
+	const unsigned int MAX_SCOPE_DEPTH = 32;
+
+	struct OpenScope
+	{
+		const char* name;
+		double start;
+	};
+
+	thread_local OpenScope t_scopes[MAX_SCOPE_DEPTH];
+	thread_local unsigned int t_depth = 0;
+	thread_local unsigned int t_threadId = ~0u;
+
+	std::atomic<unsigned int> s_threadCount(0);
+
+	const std::chrono::high_resolution_clock::time_point s_start = std::chrono::high_resolution_clock::now();
+}
+
+namespace sns
+{
+	std::atomic<bool> Profiler::s_enabled(false);
+	std::mutex Profiler::s_mutex;
+	std::vector<Profiler::Frame> Profiler::s_history;
+	Profiler::Frame Profiler::s_current;
+	unsigned long long Profiler::s_frameNumber = 0;
+	bool Profiler::s_recording = false;
+	Profiler::QueryFrame Profiler::s_queryFrames[GPU_LATENCY + 1];
+	unsigned int Profiler::s_gpuDepth = 0;
+
+	/**
+		setEnabled turns recording on or off. Only call it between
+			frames.
+
+			@param1 a_enabled is whether scopes are recorded.
+	*/
+	void Profiler::setEnabled(bool a_enabled)
+	{
+		s_enabled.store(a_enabled, std::memory_order_relaxed);
+	}
+
+	/**
+		beginFrame starts a new frame. Before a frame's query pool is
+			used again the queries it holds from GPU_LATENCY + 1 frames
+			ago are read into that frame's history.
+	*/
+	void Profiler::beginFrame()
+	{
+		if (!isEnabled())
+			return;
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if (s_history.empty())
+			s_history.resize(HISTORY_SIZE);
+
+		// Frame numbers start at 1, so 0 marks an empty history slot.
+		++s_frameNumber;
+
+		QueryFrame& queries = s_queryFrames[s_frameNumber % (GPU_LATENCY + 1)];
+		collectQueries(queries);
+		queries.frameNumber = s_frameNumber;
+
+		s_current.number = s_frameNumber;
+		s_current.start = now();
+		s_current.duration = 0.0;
+		s_current.events.clear();
+		s_current.counters.clear();
+		s_recording = true;
+	}
+
+	/**
+		endFrame finishes the frame started by beginFrame and moves it
+			into the history.
+	*/
+	void Profiler::endFrame()
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if (!s_recording)
+			return;
+
+		s_current.duration = now() - s_current.start;
+		s_recording = false;
+
+		// Swapping keeps the capacity of both event lists, so the
+		//	history stops allocating once it has filled.
+		Frame& slot = s_history[s_current.number % HISTORY_SIZE];
+		std::swap(slot, s_current);
+	}
+
+	/**
+		beginScope starts timing a scope on the calling thread.
+
+			@param1 a_name is the scope's name, it must outlive the profiler.
+	*/
+	void Profiler::beginScope(const char* a_name)
+	{
+		if (t_depth < MAX_SCOPE_DEPTH)
+		{
+			t_scopes[t_depth].name = a_name;
+			t_scopes[t_depth].start = now();
+		}
+		++t_depth;
+	}
+
+	/**
+		endScope finishes the scope the calling thread started last and
+			adds it to the frame being recorded.
+	*/
+	void Profiler::endScope()
+	{
+		double end = now();
+		--t_depth;
+		if (t_depth >= MAX_SCOPE_DEPTH)
+			return;
+
+		Event event;
+		event.name = t_scopes[t_depth].name;
+		event.start = t_scopes[t_depth].start;
+		event.duration = end - event.start;
+		event.depth = t_depth;
+		event.thread = threadId();
+		event.draws = 0;
+		event.stateChanges = 0;
+		event.primitives = 0;
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if (s_recording)
+			s_current.events.push_back(event);
+	}
+
+	/**
+		beginGpuScope starts a GL_TIME_ELAPSED query and a
+			GL_PRIMITIVES_GENERATED query from this frame's pool, making
+			more as the pool runs out. The RenderState's counts are kept
+			in the event, and endGpuScope takes them back off.
+
+			@param1 a_name is the scope's name, it must outlive the profiler.
+	*/
+	void Profiler::beginGpuScope(const char* a_name)
+	{
+		if (s_gpuDepth++ > 0 || !s_recording)
+			return;
+
+		QueryFrame& queries = s_queryFrames[s_frameNumber % (GPU_LATENCY + 1)];
+		if (queries.used == queries.queries.size())
+		{
+			unsigned int query[2] = {};
+			glGenQueries(2, query);
+			queries.queries.push_back(query[0]);
+			queries.primitiveQueries.push_back(query[1]);
+		}
+
+		const RenderState::Stats& stats = RenderState::instance().getStats();
+		Event event;
+		event.name = a_name;
+		event.start = now();
+		event.duration = 0.0;
+		event.depth = 0;
+		event.thread = GPU_THREAD;
+		event.draws = stats.draws;
+		event.stateChanges = stats.sent;
+		event.primitives = 0;
+		queries.events.push_back(event);
+
+		glBeginQuery(GL_PRIMITIVES_GENERATED, queries.primitiveQueries[queries.used]);
+		glBeginQuery(GL_TIME_ELAPSED, queries.queries[queries.used++]);
+	}
+
+	/**
+		endGpuScope ends the query started by beginGpuScope.
+	*/
+	void Profiler::endGpuScope()
+	{
+		if (--s_gpuDepth > 0 || !s_recording)
+			return;
+
+		glEndQuery(GL_TIME_ELAPSED);
+		glEndQuery(GL_PRIMITIVES_GENERATED);
+
+		QueryFrame& queries = s_queryFrames[s_frameNumber % (GPU_LATENCY + 1)];
+		const RenderState::Stats& stats = RenderState::instance().getStats();
+		Event& event = queries.events.back();
+		event.draws = stats.draws - event.draws;
+		event.stateChanges = stats.sent - event.stateChanges;
+	}
+
+	/**
+		addGpuEvent records a gpu scope timed some other way than
+			beginGpuScope into the frame being recorded. It lands in
+			whichever frame is recording when it arrives, as the gpu
+			scopes land GPU_LATENCY frames late.
+
+			@param1 a_name is the scope's name, it must outlive the profiler.
+
+			@param2 a_start is when it started, on now's clock.
+
+			@param3 a_duration is how long it took, in microseconds.
+
+			@param4 a_thread is the gpu track it goes on.
+	*/
+	void Profiler::addGpuEvent(const char* a_name, double a_start, double a_duration, unsigned int a_thread)
+	{
+		Event event;
+		event.name = a_name;
+		event.start = a_start;
+		event.duration = a_duration;
+		event.depth = 0;
+		event.thread = a_thread;
+		event.draws = 0;
+		event.stateChanges = 0;
+		event.primitives = 0;
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if (s_recording)
+			s_current.events.push_back(event);
+	}
+
+	/**
+		setCounter records a value for the frame being recorded,
+			replacing any the counter already had this frame.
+
+			@param1 a_name is the counter's name, it must outlive the profiler.
+
+			@param2 a_value is its value.
+	*/
+	void Profiler::setCounter(const char* a_name, double a_value)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if (!s_recording)
+			return;
+
+		for (Counter& counter : s_current.counters)
+		{
+			if (std::strcmp(counter.name, a_name) == 0)
+			{
+				counter.value = a_value;
+				return;
+			}
+		}
+		s_current.counters.push_back({ a_name, a_value });
+	}
+
+	/**
+		getFrame returns a frame from the history. The frame is only
+			valid until the next endFrame.
+
+			@param1 a_age is how many frames ago, 0 is the last frame
+					endFrame finished.
+
+			@return the frame, or nullptr if it isn't in the history.
+	*/
+	const Profiler::Frame* Profiler::getFrame(unsigned int a_age)
+	{
+		if (s_history.empty())
+			return nullptr;
+
+		// While recording s_frameNumber hasn't finished yet.
+		unsigned long long last = s_recording ? s_frameNumber - 1 : s_frameNumber;
+		if (a_age >= HISTORY_SIZE || a_age >= last)
+			return nullptr;
+
+		const Frame& frame = s_history[(last - a_age) % HISTORY_SIZE];
+		return frame.number == last - a_age ? &frame : nullptr;
+	}
+
+	/**
+		getAverage returns the average time a scope took per frame
+			across the history, in milliseconds.
+
+			@param1 a_name is the scope's name.
+
+			@param2 a_gpu picks the gpu scopes instead of the cpu ones.
+	*/
+	double Profiler::getAverage(const char* a_name, bool a_gpu)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+
+		double total = 0.0;
+		unsigned int frameCount = 0;
+		for (const Frame& frame : s_history)
+		{
+			if (frame.number == 0)
+				continue;
+
+			++frameCount;
+			for (const Event& event : frame.events)
+			{
+				if (isGpuThread(event.thread) == a_gpu && std::strcmp(event.name, a_name) == 0)
+					total += event.duration;
+			}
+		}
+
+		return frameCount == 0 ? 0.0 : total / frameCount * 0.001;
+	}
+
+	/**
+		writeChromeTrace writes the history as a Chrome trace. Cpu scopes
+			go in process 0 with a track per thread, gpu scopes in
+			process 1, with the async compute context's on a second
+			track, and every frame is a scope of its own around
+			the cpu scopes of the first thread. Counters are graphed
+			in process 0, set at the start of their frame.
+
+			@param1 a_path is the json file to write.
+
+			@return false if the file couldn't be written.
+	*/
+	bool Profiler::writeChromeTrace(const char* a_path)
+	{
+		FILE* file = nullptr;
+		fopen_s(&file, a_path, "w");
+		if (file == nullptr)
+		{
+			printf("Failed to write %s\n", a_path);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+
+		fprintf(file, "{\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+		fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}},\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Async compute\"}},\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"Video encode\"}}");
+
+		// The history is a ring, so start after the newest frame.
+		unsigned int eventCount = 0;
+		for (unsigned int i = 1; i <= HISTORY_SIZE && !s_history.empty(); ++i)
+		{
+			const Frame& frame = s_history[(s_frameNumber + i) % HISTORY_SIZE];
+			if (frame.number == 0)
+				continue;
+
+			fprintf(file, ",\n{\"name\":\"Frame %llu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+				frame.number, frame.start, frame.duration);
+
+			for (const Event& event : frame.events)
+			{
+				bool gpu = isGpuThread(event.thread);
+				unsigned int track = event.thread == ASYNC_COMPUTE_THREAD ? 1 : event.thread == VIDEO_ENCODE_THREAD ? 2 :
+					gpu ? 0 : event.thread;
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+					event.name, gpu ? 1 : 0, track, event.start, event.duration);
+				if (gpu)
+					fprintf(file, ",\"args\":{\"draws\":%u,\"state changes\":%u,\"primitives\":%llu}",
+						event.draws, event.stateChanges, event.primitives);
+				fprintf(file, "}");
+				++eventCount;
+			}
+
+			for (const Counter& counter : frame.counters)
+			{
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+					counter.name, frame.start, counter.value);
+				++eventCount;
+			}
+		}
+
+		fprintf(file, "\n]}\n");
+		bool written = ferror(file) == 0;
+		fclose(file);
+
+		if (!written)
+		{
+			printf("Failed to write %s\n", a_path);
+			return false;
+		}
+
+		printf("Wrote %u profiler events to %s\n", eventCount, a_path);
+		return true;
+	}
+
+	/**
+		destroy deletes the gpu queries. Must be called while the GL
+			context still exists.
+	*/
+	void Profiler::destroy()
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (QueryFrame& queries : s_queryFrames)
+		{
+			if (!queries.queries.empty())
+			{
+				glDeleteQueries((GLsizei)queries.queries.size(), queries.queries.data());
+				glDeleteQueries((GLsizei)queries.primitiveQueries.size(), queries.primitiveQueries.data());
+			}
+
+			queries.queries.clear();
+			queries.primitiveQueries.clear();
+			queries.events.clear();
+			queries.used = 0;
+		}
+	}
+
+	/**
+		now returns the microseconds since the profiler started.
+	*/
+	double Profiler::now()
+	{
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - s_start;
+		return elapsed.count();
+	}
+
+	/**
+		threadId returns the id of the calling thread. Ids are handed
+			out in the order threads first record a scope.
+	*/
+	unsigned int Profiler::threadId()
+	{
+		if (t_threadId == ~0u)
+			t_threadId = s_threadCount.fetch_add(1, std::memory_order_relaxed);
+		return t_threadId;
+	}
+
+	/**
+		collectQueries reads the queries of a frame into its history and
+			empties the pool for reuse. Queries finish in order, so if the
+			last one isn't available yet the frame is dropped rather than
+			waiting on the gpu.
+
+			@param1 a_queries is the pool of the frame to read.
+	*/
+	void Profiler::collectQueries(QueryFrame& a_queries)
+	{
+		if (a_queries.used == 0)
+			return;
+
+		GLuint available = GL_FALSE;
+		GLuint primitivesAvailable = GL_FALSE;
+		glGetQueryObjectuiv(a_queries.queries[a_queries.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		glGetQueryObjectuiv(a_queries.primitiveQueries[a_queries.used - 1], GL_QUERY_RESULT_AVAILABLE, &primitivesAvailable);
+		available = available == GL_TRUE && primitivesAvailable == GL_TRUE ? GL_TRUE : GL_FALSE;
+
+		Frame& frame = s_history[a_queries.frameNumber % HISTORY_SIZE];
+		if (available == GL_TRUE && frame.number == a_queries.frameNumber)
+		{
+			for (unsigned int i = 0; i < a_queries.used; ++i)
+			{
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(a_queries.queries[i], GL_QUERY_RESULT, &nanoseconds);
+
+				GLuint64 primitives = 0;
+				glGetQueryObjectui64v(a_queries.primitiveQueries[i], GL_QUERY_RESULT, &primitives);
+
+				Event event = a_queries.events[i];
+				event.duration = nanoseconds * 0.001;
+				event.primitives = primitives;
+				frame.events.push_back(event);
+			}
+		}
+
+		a_queries.used = 0;
+		a_queries.events.clear();
+	}
+}
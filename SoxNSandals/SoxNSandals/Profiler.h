@@ -0,0 +1,316 @@
+/**
+	Profiler.h
+
+	Purpose: Profiler.h is the header file for the Profiler class. The
+			Profiler records how long named parts of each frame take on
+			the cpu and the gpu, keeps the last frames and can write them
+			out as a Chrome trace.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Trace.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Times the rest of the enclosing block on the cpu. It is a trace zone too.
+#define SNS_PROFILE_SCOPE(name) SNS_TRACE_ZONE(name); \
+	sns::ProfileScope SNS_PROFILE_JOIN(profileScope, __LINE__)(name)
+
+// Times the gl commands issued in the rest of the enclosing block on the gpu.
+//	GL_TIME_ELAPSED queries can't overlap, so gpu scopes must not nest. It
+//	is a trace gl zone too.
+#define SNS_PROFILE_GPU_SCOPE(name) SNS_TRACE_GL_ZONE(name); \
+	sns::GpuProfileScope SNS_PROFILE_JOIN(gpuProfileScope, __LINE__)(name)
+
+#define SNS_PROFILE_JOIN(a, b) SNS_PROFILE_JOIN_EXPAND(a, b)
+#define SNS_PROFILE_JOIN_EXPAND(a, b) a##b
+
+namespace sns
+{
+	/**
+		The Profiler class collects the scopes of each frame between
+			beginFrame and endFrame. Cpu scopes can be recorded on any
+			thread. Gpu scopes are timed with GL_TIME_ELAPSED queries,
+			which are read GPU_LATENCY frames later so reading them
+			never waits on the gpu.
+
+		While disabled a scope only loads one flag, so scopes can be
+			left in code that runs every frame.
+	*/
+	class Profiler
+	{
+	public:
+		// How many frames of scopes are kept.
+		static const unsigned int HISTORY_SIZE = 120;
+
+		// How many frames old a gpu query is before it is read.
+		static const unsigned int GPU_LATENCY = 3;
+
+		/**
+			One timed scope. Names must outlive the profiler, string
+				literals are expected.
+		*/
+		struct Event
+		{
+			const char* name;
+
+			// Microseconds since the profiler started. Gpu scopes only
+			//	know their duration, so they start where the cpu issued them.
+			double start;
+			double duration;
+
+			// How many scopes this one is inside, on its thread.
+			unsigned int depth;
+
+			// The recording thread, numbered in the order threads first
+			//	record a scope. Gpu scopes are all on GPU_THREAD.
+			unsigned int thread;
+
+			// What a gpu scope drew, the draw calls and state calls the
+			//	RenderState counted while it was open and the primitives
+			//	the gpu generated. Cpu scopes leave them 0.
+			unsigned int draws;
+			unsigned int stateChanges;
+			unsigned long long primitives;
+		};
+
+		// The thread id gpu scopes are given.
+		static const unsigned int GPU_THREAD = ~0u;
+
+		// The thread id of the AsyncCompute context's gpu scopes, a gpu
+		//	track of their own beside GPU_THREAD's.
+		static const unsigned int ASYNC_COMPUTE_THREAD = ~1u;
+
+		// The thread id of the VideoEncoder's frames, from being handed
+		//	to the hardware encoder to their bitstream being ready.
+		static const unsigned int VIDEO_ENCODE_THREAD = ~2u;
+
+		/**
+			isGpuThread returns whether a thread id is one of the gpu
+				tracks.
+		*/
+		static bool isGpuThread(unsigned int a_thread) { return a_thread >= VIDEO_ENCODE_THREAD; }
+
+		/**
+			A named value set during a frame, such as how many things
+				were culled. Names must outlive the profiler.
+		*/
+		struct Counter
+		{
+			const char* name;
+			double value;
+		};
+
+		/**
+			Every scope and counter of one frame.
+		*/
+		struct Frame
+		{
+			unsigned long long number = 0;
+			double start = 0.0;
+			double duration = 0.0;
+			std::vector<Event> events;
+			std::vector<Counter> counters;
+		};
+
+		/**
+			setEnabled turns recording on or off. Only call it between
+				frames.
+		*/
+		static void setEnabled(bool a_enabled);
+
+		/**
+			isEnabled returns whether scopes are being recorded.
+		*/
+		static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+		/**
+			beginFrame starts a new frame, and collects the gpu times of
+				the frame GPU_LATENCY frames ago.
+		*/
+		static void beginFrame();
+
+		/**
+			endFrame finishes the frame started by beginFrame.
+		*/
+		static void endFrame();
+
+		/**
+			beginScope starts timing a scope on the calling thread.
+				Use SNS_PROFILE_SCOPE rather than calling it directly.
+		*/
+		static void beginScope(const char* a_name);
+
+		/**
+			endScope finishes the scope the calling thread started last.
+		*/
+		static void endScope();
+
+		/**
+			beginGpuScope starts a GL_TIME_ELAPSED query, and a
+				GL_PRIMITIVES_GENERATED one beside it. Only the thread
+				with the GL context may call it.
+		*/
+		static void beginGpuScope(const char* a_name);
+
+		/**
+			endGpuScope ends the query started by beginGpuScope.
+		*/
+		static void endGpuScope();
+
+		/**
+			addGpuEvent records a gpu scope timed some other way than
+				beginGpuScope, like the timestamps of another context,
+				into the frame being recorded. Can be called from any
+				thread.
+
+				@param1 a_name is the scope's name, a string literal.
+
+				@param2 a_start is when it started, on now's clock.
+
+				@param3 a_duration is how long it took, in microseconds.
+
+				@param4 a_thread is the gpu track it goes on.
+		*/
+		static void addGpuEvent(const char* a_name, double a_start, double a_duration, unsigned int a_thread);
+
+		/**
+			setCounter records a value for the frame being recorded,
+				replacing any the counter already had this frame.
+
+				@param1 a_name is the counter's name, a string literal.
+
+				@param2 a_value is its value.
+		*/
+		static void setCounter(const char* a_name, double a_value);
+
+		/**
+			getFrame returns a frame from the history.
+
+				@param1 a_age is how many frames ago, 0 is the last frame
+						endFrame finished.
+
+				@return the frame, or nullptr if it isn't in the history.
+		*/
+		static const Frame* getFrame(unsigned int a_age);
+
+		/**
+			getAverage returns the average time a scope took per frame
+				across the history, in milliseconds.
+
+				@param1 a_name is the scope's name.
+
+				@param2 a_gpu picks the gpu scopes instead of the cpu ones.
+		*/
+		static double getAverage(const char* a_name, bool a_gpu = false);
+
+		/**
+			writeChromeTrace writes the history as a Chrome trace, which
+				chrome://tracing and most trace viewers can open.
+
+				@param1 a_path is the json file to write.
+
+				@return false if the file couldn't be written.
+		*/
+		static bool writeChromeTrace(const char* a_path);
+
+		/**
+			destroy deletes the gpu queries. Must be called while the GL
+				context still exists.
+		*/
+		static void destroy();
+
+		/**
+			now returns the microseconds since the profiler started, the
+				clock every event is placed on.
+		*/
+		static double now();
+
+	private:
+		// The gpu queries issued during one frame, a time and a primitive
+		//	count for each scope.
+		struct QueryFrame
+		{
+			unsigned long long frameNumber = 0;
+			unsigned int used = 0;
+			std::vector<unsigned int> queries;
+			std::vector<unsigned int> primitiveQueries;
+			std::vector<Event> events;
+		};
+
+		// Returns the id of the calling thread.
+		static unsigned int threadId();
+
+		// Reads the finished queries of a frame into its history.
+		static void collectQueries(QueryFrame& a_queries);
+
+		// Loaded by every scope, so it is kept apart from the rest.
+		static std::atomic<bool> s_enabled;
+
+		// Guards the frame being recorded, scopes end on any thread.
+		static std::mutex s_mutex;
+
+		static std::vector<Frame> s_history;
+		static Frame s_current;
+		static unsigned long long s_frameNumber;
+		static bool s_recording;
+
+		static QueryFrame s_queryFrames[GPU_LATENCY + 1];
+		// Gpu scopes inside a gpu scope are ignored, this counts them.
+		static unsigned int s_gpuDepth;
+	};
+
+	/**
+		The ProfileScope class times its own lifetime, see SNS_PROFILE_SCOPE.
+	*/
+	class ProfileScope
+	{
+	public:
+		explicit ProfileScope(const char* a_name) : m_active(Profiler::isEnabled())
+		{
+			if (m_active)
+				Profiler::beginScope(a_name);
+		}
+
+		~ProfileScope()
+		{
+			if (m_active)
+				Profiler::endScope();
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		bool m_active;
+	};
+
+	/**
+		The GpuProfileScope class times the gl commands issued during its
+			lifetime, see SNS_PROFILE_GPU_SCOPE.
+	*/
+	class GpuProfileScope
+	{
+	public:
+		explicit GpuProfileScope(const char* a_name) : m_active(Profiler::isEnabled())
+		{
+			if (m_active)
+				Profiler::beginGpuScope(a_name);
+		}
+
+		~GpuProfileScope()
+		{
+			if (m_active)
+				Profiler::endGpuScope();
+		}
+
+		GpuProfileScope(const GpuProfileScope&) = delete;
+		GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+	private:
+		bool m_active;
+	};
+}
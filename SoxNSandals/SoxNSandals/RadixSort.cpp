@@ -0,0 +1,193 @@
+/**
+	RadixSort.cpp
+
+	Purpose: RadixSort.cpp is the source file for the radix sort functions.
+			They sort 32 or 64 bit keys and a value per key in linear
+			time, for sorts that run every frame over many items.
+
+	@author Nathan Nette
+*/
+#include "RadixSort.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace sns
+{
+	// The keys a parallelRadixSort job counts and scatters.
+	static const unsigned int SORT_BLOCK_SIZE = 8192;
+
+	/**
+		radixSort sorts keys from smallest to largest, moving each value
+			with its key. Equal keys keep their order.
+
+			@param1 a_keys are the keys, sorted on return.
+
+			@param2 a_values are the values, moved with their keys.
+
+			@param3 a_scratchKeys has room for a_count keys.
+
+			@param4 a_scratchValues has room for a_count values.
+
+			@param5 a_count is how many keys there are.
+	*/
+	void radixSort(uint32_t* a_keys, uint32_t* a_values,
+		uint32_t* a_scratchKeys, uint32_t* a_scratchValues, unsigned int a_count)
+	{
+		if (a_count < 2)
+			return;
+
+		// Every pass's histogram is counted in one read of the keys.
+		unsigned int histograms[4][256] = {};
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			uint32_t key = a_keys[i];
+			++histograms[0][key & 0xff];
+			++histograms[1][(key >> 8) & 0xff];
+			++histograms[2][(key >> 16) & 0xff];
+			++histograms[3][key >> 24];
+		}
+
+		uint32_t* keys = a_keys;
+		uint32_t* values = a_values;
+		uint32_t* scratchKeys = a_scratchKeys;
+		uint32_t* scratchValues = a_scratchValues;
+
+		for (unsigned int pass = 0; pass < 4; ++pass)
+		{
+			unsigned int shift = pass * 8;
+			unsigned int* histogram = histograms[pass];
+
+			// If every key has the same byte the pass wouldn't move anything.
+			if (histogram[(keys[0] >> shift) & 0xff] == a_count)
+				continue;
+
+			unsigned int offset = 0;
+			for (unsigned int digit = 0; digit < 256; ++digit)
+			{
+				unsigned int count = histogram[digit];
+				histogram[digit] = offset;
+				offset += count;
+			}
+
+			for (unsigned int i = 0; i < a_count; ++i)
+			{
+				unsigned int destination = histogram[(keys[i] >> shift) & 0xff]++;
+				scratchKeys[destination] = keys[i];
+				scratchValues[destination] = values[i];
+			}
+
+			std::swap(keys, scratchKeys);
+			std::swap(values, scratchValues);
+		}
+
+		// An odd amount of passes leaves the result in the scratch arrays.
+		if (keys != a_keys)
+		{
+			std::memcpy(a_keys, keys, a_count * sizeof(uint32_t));
+			std::memcpy(a_values, values, a_count * sizeof(uint32_t));
+		}
+	}
+
+	/**
+		parallelRadixSort sorts 64 bit keys from smallest to largest on
+			jobs, moving each value with its key. Equal keys keep their
+			order.
+
+			@param1 a_keys are the keys, sorted on return.
+
+			@param2 a_values are the values, moved with their keys.
+
+			@param3 a_scratchKeys has room for a_count keys.
+
+			@param4 a_scratchValues has room for a_count values.
+
+			@param5 a_count is how many keys there are.
+	*/
+	void parallelRadixSort(uint64_t* a_keys, uint32_t* a_values,
+		uint64_t* a_scratchKeys, uint32_t* a_scratchValues, unsigned int a_count)
+	{
+		if (a_count < 2)
+			return;
+
+		// A pass is skipped where every key has the same byte.
+		uint64_t differing = 0;
+		for (unsigned int i = 1; i < a_count; ++i)
+			differing |= a_keys[i] ^ a_keys[0];
+
+		unsigned int blockCount = (a_count + SORT_BLOCK_SIZE - 1) / SORT_BLOCK_SIZE;
+		std::vector<unsigned int> histograms(blockCount * 256);
+		JobSystem& jobs = JobSystem::instance();
+		auto forEachBlock = [&jobs, blockCount](const std::function<void(unsigned int)>& a_body)
+		{
+			if (blockCount < 2)
+			{
+				a_body(0);
+				return;
+			}
+			JobCounter counter;
+			for (unsigned int block = 0; block < blockCount; ++block)
+				jobs.run([&a_body, block]() { a_body(block); }, &counter);
+			jobs.wait(counter);
+		};
+
+		uint64_t* keys = a_keys;
+		uint32_t* values = a_values;
+		uint64_t* scratchKeys = a_scratchKeys;
+		uint32_t* scratchValues = a_scratchValues;
+
+		for (unsigned int shift = 0; shift < 64; shift += 8)
+		{
+			if (((differing >> shift) & 0xff) == 0)
+				continue;
+
+			// A block's digits move as the passes go, so each pass counts
+			//	its blocks again.
+			forEachBlock([&, shift](unsigned int a_block)
+			{
+				unsigned int* histogram = &histograms[a_block * 256];
+				std::fill(histogram, histogram + 256, 0u);
+				unsigned int last = std::min(a_count, (a_block + 1) * SORT_BLOCK_SIZE);
+				for (unsigned int i = a_block * SORT_BLOCK_SIZE; i < last; ++i)
+					++histogram[(keys[i] >> shift) & 0xff];
+			});
+
+			// Each block's run of a digit goes after the runs of the lower
+			//	digits and of the same digit in earlier blocks, which keeps
+			//	equal keys in order.
+			unsigned int offset = 0;
+			for (unsigned int digit = 0; digit < 256; ++digit)
+			{
+				for (unsigned int block = 0; block < blockCount; ++block)
+				{
+					unsigned int count = histograms[block * 256 + digit];
+					histograms[block * 256 + digit] = offset;
+					offset += count;
+				}
+			}
+
+			forEachBlock([&, shift](unsigned int a_block)
+			{
+				unsigned int* histogram = &histograms[a_block * 256];
+				unsigned int last = std::min(a_count, (a_block + 1) * SORT_BLOCK_SIZE);
+				for (unsigned int i = a_block * SORT_BLOCK_SIZE; i < last; ++i)
+				{
+					unsigned int destination = histogram[(keys[i] >> shift) & 0xff]++;
+					scratchKeys[destination] = keys[i];
+					scratchValues[destination] = values[i];
+				}
+			});
+
+			std::swap(keys, scratchKeys);
+			std::swap(values, scratchValues);
+		}
+
+		// An odd amount of passes leaves the result in the scratch arrays.
+		if (keys != a_keys)
+		{
+			std::memcpy(a_keys, keys, a_count * sizeof(uint64_t));
+			std::memcpy(a_values, values, a_count * sizeof(uint32_t));
+		}
+	}
+}
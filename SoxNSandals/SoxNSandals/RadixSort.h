@@ -0,0 +1,65 @@
+/**
+	RadixSort.h
+
+	Purpose: RadixSort.h is the header file for the radix sort functions.
+			They sort 32 or 64 bit keys and a value per key in linear
+			time, for sorts that run every frame over many items.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace sns
+{
+	/**
+		radixSort sorts keys from smallest to largest, moving each value
+			with its key. Equal keys keep their order. It takes four
+			passes of 8 bits, skipping any pass where every key has the
+			same byte.
+
+			@param1 a_keys are the keys, sorted on return.
+
+			@param2 a_values are the values, moved with their keys.
+
+			@param3 a_scratchKeys has room for a_count keys.
+
+			@param4 a_scratchValues has room for a_count values.
+
+			@param5 a_count is how many keys there are.
+	*/
+	void radixSort(uint32_t* a_keys, uint32_t* a_values,
+		uint32_t* a_scratchKeys, uint32_t* a_scratchValues, unsigned int a_count);
+
+	/**
+		parallelRadixSort sorts 64 bit keys as radixSort does, in eight
+			passes of 8 bits. Each pass counts and scatters blocks of
+			keys as jobs on the JobSystem, so it is for sorts of more
+			keys than a thread gets through quickly. Fewer keys than
+			two blocks are sorted on the calling thread.
+
+			@param1 a_keys are the keys, sorted on return.
+
+			@param2 a_values are the values, moved with their keys.
+
+			@param3 a_scratchKeys has room for a_count keys.
+
+			@param4 a_scratchValues has room for a_count values.
+
+			@param5 a_count is how many keys there are.
+	*/
+	void parallelRadixSort(uint64_t* a_keys, uint32_t* a_values,
+		uint64_t* a_scratchKeys, uint32_t* a_scratchValues, unsigned int a_count);
+
+	/**
+		floatToSortable turns a float into a key that sorts in the
+			same order as the float, negative numbers included.
+	*/
+	inline uint32_t floatToSortable(float a_value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &a_value, sizeof(bits));
+		return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+	}
+}
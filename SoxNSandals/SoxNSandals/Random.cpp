@@ -0,0 +1,167 @@
+/**
+	Random.cpp
+
+	Purpose: Random.cpp is the source file for the Random class. The Random
+			class is a small, fast random number generator that each
+			object can own, instead of sharing the global state of rand.
+
+	@author Nathan Nette
+*/
+#include "Random.h"
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SNS_RANDOM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Spreads the seed out into state words, as the xoshiro authors suggest.
+	uint64_t splitMix64(uint64_t& a_state)
+	{
+		uint64_t z = (a_state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+#ifndef SNS_RANDOM_SSE
+	// The top 23 bits become the mantissa of a float in [1, 2).
+	float toFloat(uint32_t a_bits)
+	{
+		uint32_t bits = (a_bits >> 9) | 0x3f800000u;
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value - 1.0f;
+	}
+#endif
+}
+
+namespace sns
+{
+	/**
+		The constructor seeds the generator with 0.
+	*/
+	Random::Random()
+	{
+		seed(0);
+	}
+
+	/**
+		The constructor seeds the generator.
+
+			@param1 a_seed picks the sequence of numbers.
+	*/
+	Random::Random(uint64_t a_seed)
+	{
+		seed(a_seed);
+	}
+
+	/**
+		seed restarts the generator at the start of a sequence.
+
+			@param1 a_seed picks the sequence of numbers.
+	*/
+	void Random::seed(uint64_t a_seed)
+	{
+		uint64_t state = a_seed;
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			for (unsigned int word = 0; word < 4; word += 2)
+			{
+				uint64_t value = splitMix64(state);
+				m_state[word][lane] = (uint32_t)value;
+				m_state[word + 1][lane] = (uint32_t)(value >> 32);
+			}
+		}
+		m_bufferedUsed = 4;
+	}
+
+	/**
+		next4 steps every lane once.
+
+			@param1 a_values receives four floats in [0, 1). Must be
+					16 byte aligned.
+	*/
+	void Random::next4(float* a_values)
+	{
+		fill(a_values, 4);
+	}
+
+	/**
+		fill writes a batch of floats in [0, 1), four at a time.
+
+			@param1 a_values receives the floats. Must be 16 byte aligned.
+
+			@param2 a_count is how many to write, rounded up to a
+					multiple of 4, so a_values needs room for that many.
+	*/
+	void Random::fill(float* a_values, unsigned int a_count)
+	{
+#ifdef SNS_RANDOM_SSE
+		__m128i s0 = _mm_load_si128((const __m128i*)m_state[0]);
+		__m128i s1 = _mm_load_si128((const __m128i*)m_state[1]);
+		__m128i s2 = _mm_load_si128((const __m128i*)m_state[2]);
+		__m128i s3 = _mm_load_si128((const __m128i*)m_state[3]);
+		const __m128i one = _mm_set1_epi32(0x3f800000);
+
+		for (unsigned int i = 0; i < a_count; i += 4)
+		{
+			__m128i result = _mm_add_epi32(s0, s3);
+			__m128i t = _mm_slli_epi32(s1, 9);
+			s2 = _mm_xor_si128(s2, s0);
+			s3 = _mm_xor_si128(s3, s1);
+			s1 = _mm_xor_si128(s1, s2);
+			s0 = _mm_xor_si128(s0, s3);
+			s2 = _mm_xor_si128(s2, t);
+			s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+			__m128i bits = _mm_or_si128(_mm_srli_epi32(result, 9), one);
+			_mm_store_ps(a_values + i, _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.0f)));
+		}
+
+		_mm_store_si128((__m128i*)m_state[0], s0);
+		_mm_store_si128((__m128i*)m_state[1], s1);
+		_mm_store_si128((__m128i*)m_state[2], s2);
+		_mm_store_si128((__m128i*)m_state[3], s3);
+#else
+		for (unsigned int i = 0; i < a_count; i += 4)
+		{
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				uint32_t& s0 = m_state[0][lane];
+				uint32_t& s1 = m_state[1][lane];
+				uint32_t& s2 = m_state[2][lane];
+				uint32_t& s3 = m_state[3][lane];
+
+				uint32_t result = s0 + s3;
+				uint32_t t = s1 << 9;
+				s2 ^= s0;
+				s3 ^= s1;
+				s1 ^= s2;
+				s0 ^= s3;
+				s2 ^= t;
+				s3 = (s3 << 11) | (s3 >> 21);
+
+				a_values[i + lane] = toFloat(result);
+			}
+		}
+#endif
+	}
+
+	/**
+		nextFloat returns one float in [0, 1). It hands out the
+			numbers of a step one at a time, next4 and fill start a
+			step of their own.
+	*/
+	float Random::nextFloat()
+	{
+		if (m_bufferedUsed == 4)
+		{
+			fill(m_buffered, 4);
+			m_bufferedUsed = 0;
+		}
+		return m_buffered[m_bufferedUsed++];
+	}
+}
@@ -0,0 +1,81 @@
+/**
+	Random.h
+
+	Purpose: Random.h is the header file for the Random class. The Random
+			class is a small, fast random number generator that each
+			object can own, instead of sharing the global state of rand.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstdint>
+
+namespace sns
+{
+	/**
+		The Random class runs four xoshiro128+ generators side by side,
+			one per SSE lane, so four numbers come out of every step.
+			The same seed always gives the same numbers, with or without
+			SSE, so anything driven by it replays exactly.
+	*/
+	class Random
+	{
+	public:
+		/**
+			The constructor seeds the generator with 0.
+		*/
+		Random();
+
+		/**
+			The constructor seeds the generator.
+
+				@param1 a_seed picks the sequence of numbers.
+		*/
+		explicit Random(uint64_t a_seed);
+
+		/**
+			seed restarts the generator at the start of a sequence.
+
+				@param1 a_seed picks the sequence of numbers.
+		*/
+		void seed(uint64_t a_seed);
+
+		/**
+			next4 steps every lane once.
+
+				@param1 a_values receives four floats in [0, 1). Must be
+						16 byte aligned.
+		*/
+		void next4(float* a_values);
+
+		/**
+			fill writes a batch of floats in [0, 1), four at a time.
+
+				@param1 a_values receives the floats. Must be 16 byte aligned.
+
+				@param2 a_count is how many to write, rounded up to a
+						multiple of 4, so a_values needs room for that many.
+		*/
+		void fill(float* a_values, unsigned int a_count);
+
+		/**
+			nextFloat returns one float in [0, 1). It hands out the
+				numbers of a step one at a time, next4 and fill start a
+				step of their own.
+		*/
+		float nextFloat();
+
+		/**
+			range returns a float between a_min and a_max.
+		*/
+		float range(float a_min, float a_max) { return a_min + nextFloat() * (a_max - a_min); }
+
+	private:
+		// Every word of state for each lane, m_state[word][lane].
+		alignas(16) uint32_t m_state[4][4];
+
+		// The step nextFloat is handing out and how many it has used.
+		alignas(16) float m_buffered[4];
+		unsigned int m_bufferedUsed;
+	};
+}
@@ -0,0 +1,249 @@
+/**
+	RegressionGate.cpp
+
+	Purpose: RegressionGate.cpp is the source file for the RegressionGate
+			class. The RegressionGate compares the benchmark scenes'
+			results against a stored baseline, so a build that got
+			slower fails instead of being noticed later.
+
+	@author Nathan Nette
+*/
+#include "RegressionGate.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char* const SCENE_NAMES[(int)sns::BenchmarkScene::COUNT] =
+	{
+		"sponza", "stanford", "particles", "gizmos"
+	};
+
+	/**
+		What each scene is measured by, and how far over its baseline it
+			may be. The 99th percentiles are noisier than the averages,
+			and draw calls only move when the scene or its culling does.
+	*/
+	struct MetricDefinition
+	{
+		const char* name;
+		sns::BenchmarkReport::Value value;
+		bool p99;
+		double tolerance;
+	};
+
+	const MetricDefinition METRICS[] =
+	{
+		{ "frameMs.avg", sns::BenchmarkReport::FRAME_MILLISECONDS, false, 10.0 },
+		{ "frameMs.p99", sns::BenchmarkReport::FRAME_MILLISECONDS, true, 20.0 },
+		{ "gpuMs.avg", sns::BenchmarkReport::GPU_MILLISECONDS, false, 10.0 },
+		{ "gpuMs.p99", sns::BenchmarkReport::GPU_MILLISECONDS, true, 20.0 },
+		{ "drawCalls.avg", sns::BenchmarkReport::DRAW_CALLS, false, 5.0 },
+
+		// The steady state frame should allocate nothing, so a baseline
+		//	of 0 fails on any allocation.
+		{ "heapAllocs.avg", sns::BenchmarkReport::HEAP_ALLOCATIONS, false, 10.0 }
+	};
+}
+
+namespace sns
+{
+	/**
+		getSceneName returns the name a scene is given on the command line
+			and in the baseline.
+
+			@param1 a_scene is the scene.
+	*/
+	const char* RegressionGate::getSceneName(BenchmarkScene a_scene)
+	{
+		return a_scene < BenchmarkScene::COUNT ? SCENE_NAMES[(int)a_scene] : "unknown";
+	}
+
+	/**
+		findScene finds a scene by its name.
+
+			@param1 a_name is the name.
+
+			@param2 a_scene receives the scene.
+
+			@return false if no scene has that name.
+	*/
+	bool RegressionGate::findScene(const char* a_name, BenchmarkScene& a_scene)
+	{
+		for (int i = 0; i < (int)BenchmarkScene::COUNT; ++i)
+		{
+			if (strcmp(a_name, SCENE_NAMES[i]) == 0)
+			{
+				a_scene = (BenchmarkScene)i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+		loadBaseline reads a baseline file.
+
+			@param1 a_filename is the baseline.
+
+			@return false if it couldn't be read.
+	*/
+	bool RegressionGate::loadBaseline(const char* a_filename)
+	{
+		FILE* file = nullptr;
+		fopen_s(&file, a_filename, "r");
+		if (file == nullptr)
+		{
+			printf("Failed to read baseline %s\n", a_filename);
+			return false;
+		}
+
+		m_baseline.clear();
+		char line[256];
+		unsigned int lineNumber = 0;
+		while (fgets(line, sizeof(line), file) != nullptr)
+		{
+			++lineNumber;
+			if (line[0] == '#')
+				continue;
+
+			char scene[64];
+			char name[64];
+			Metric metric;
+			int read = sscanf_s(line, "%63s %63s %lf %lf", scene, (unsigned int)sizeof(scene),
+				name, (unsigned int)sizeof(name), &metric.value, &metric.tolerance);
+
+			if (read == 4)
+			{
+				metric.scene = scene;
+				metric.name = name;
+				m_baseline.push_back(metric);
+			}
+			else if (read > 0)
+				printf("%s(%u): expected a scene, a metric, a value and a tolerance\n", a_filename, lineNumber);
+		}
+		fclose(file);
+		return true;
+	}
+
+	/**
+		addResult adds a scene's results from this run.
+
+			@param1 a_scene is the scene.
+
+			@param2 a_report is its benchmark.
+	*/
+	void RegressionGate::addResult(BenchmarkScene a_scene, const BenchmarkReport& a_report)
+	{
+		if (a_report.getFrameCount() == 0)
+			return;
+
+		for (const MetricDefinition& definition : METRICS)
+		{
+			BenchmarkReport::Summary summary = a_report.getSummary(definition.value);
+			Metric metric;
+			metric.scene = getSceneName(a_scene);
+			metric.name = definition.name;
+			metric.value = definition.p99 ? summary.p99 : summary.average;
+			metric.tolerance = definition.tolerance;
+			m_results.push_back(metric);
+		}
+	}
+
+	/**
+		compare prints every metric of this run beside its baseline. A
+			scene in the baseline with no results is a regression, a
+			metric missing from the baseline is only printed.
+
+			@return how many metrics regressed.
+	*/
+	unsigned int RegressionGate::compare() const
+	{
+		unsigned int regressions = 0;
+		printf("Regression gate: %u metrics against %u in the baseline\n",
+			(unsigned int)m_results.size(), (unsigned int)m_baseline.size());
+		for (const Metric& result : m_results)
+		{
+			const Metric* baseline = find(m_baseline, result.scene, result.name);
+			if (baseline == nullptr)
+			{
+				printf("  %-10s %-14s %10.3f  no baseline\n", result.scene.c_str(), result.name.c_str(), result.value);
+				continue;
+			}
+
+			double limit = baseline->value * (1.0 + baseline->tolerance / 100.0);
+			double change = baseline->value != 0.0 ? (result.value / baseline->value - 1.0) * 100.0 : 0.0;
+			bool regressed = result.value > limit;
+			printf("  %-10s %-14s %10.3f  baseline %10.3f  %+6.1f%% of %.0f%%%s\n", result.scene.c_str(),
+				result.name.c_str(), result.value, baseline->value, change, baseline->tolerance,
+				regressed ? "  REGRESSED" : "");
+			if (regressed)
+				++regressions;
+		}
+
+		// A scene that didn't run can't have passed.
+		for (const Metric& baseline : m_baseline)
+		{
+			if (find(m_results, baseline.scene, baseline.name) == nullptr)
+			{
+				printf("  %-10s %-14s missing from this run  REGRESSED\n", baseline.scene.c_str(), baseline.name.c_str());
+				++regressions;
+			}
+		}
+
+		printf("Regression gate %s, %u regressed\n", regressions == 0 ? "passed" : "failed", regressions);
+		return regressions;
+	}
+
+	/**
+		writeBaseline writes this run's results as a new baseline, each
+			metric with its default tolerance, or the one the loaded
+			baseline gave it, so tuned tolerances survive an update.
+
+			@param1 a_filename is the baseline to write.
+
+			@return false if it couldn't be written.
+	*/
+	bool RegressionGate::writeBaseline(const char* a_filename) const
+	{
+		FILE* file = nullptr;
+		fopen_s(&file, a_filename, "w");
+		if (file == nullptr)
+		{
+			printf("Failed to write baseline %s\n", a_filename);
+			return false;
+		}
+
+		fprintf(file, "# scene metric value tolerance%%\n");
+		for (const Metric& result : m_results)
+		{
+			const Metric* baseline = find(m_baseline, result.scene, result.name);
+			fprintf(file, "%s %s %.4f %.1f\n", result.scene.c_str(), result.name.c_str(), result.value,
+				baseline != nullptr ? baseline->tolerance : result.tolerance);
+		}
+
+		bool written = ferror(file) == 0;
+		fclose(file);
+		if (written)
+			printf("Wrote baseline %s\n", a_filename);
+		else
+			printf("Failed to write baseline %s\n", a_filename);
+		return written;
+	}
+
+	/**
+		find finds a metric in a list.
+
+			@return the metric, or nullptr if it isn't there.
+	*/
+	const RegressionGate::Metric* RegressionGate::find(const std::vector<Metric>& a_metrics,
+		const std::string& a_scene, const std::string& a_name)
+	{
+		for (const Metric& metric : a_metrics)
+		{
+			if (metric.scene == a_scene && metric.name == a_name)
+				return &metric;
+		}
+		return nullptr;
+	}
+}
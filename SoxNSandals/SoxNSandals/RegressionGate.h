@@ -0,0 +1,130 @@
+/**
+	RegressionGate.h
+
+	Purpose: RegressionGate.h is the header file for the RegressionGate
+			class. The RegressionGate compares the benchmark scenes'
+			results against a stored baseline, so a build that got
+			slower fails instead of being noticed later.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "BenchmarkReport.h"
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The scenes the benchmark can time. Each is the courtyard with
+			something added that stresses one part of the engine, and
+			all of them fly the same path.
+	*/
+	enum class BenchmarkScene
+	{
+		// The courtyard as it is.
+		SPONZA,
+
+		// Copies of the four Stanford scans in rows across the courtyard.
+		STANFORD,
+
+		// Ten particle emitters along the courtyard.
+		PARTICLES,
+
+		// Thousands of gizmos added every frame.
+		GIZMOS,
+
+		COUNT
+	};
+
+	/**
+		The RegressionGate class holds a baseline of every scene's
+			metrics, each with how far over it a result may be, and
+			the results of this run.
+
+		A baseline is a text file with one metric a line: the scene's
+			name, the metric's name, its value and the tolerance as a
+			percentage over the value, such as
+			"sponza frameMs.p99 8.25 20". Empty lines and lines
+			starting with # are skipped. Every metric is better lower.
+	*/
+	class RegressionGate
+	{
+	public:
+		/**
+			getSceneName returns the name a scene is given on the command
+				line and in the baseline.
+
+				@param1 a_scene is the scene.
+		*/
+		static const char* getSceneName(BenchmarkScene a_scene);
+
+		/**
+			findScene finds a scene by its name.
+
+				@param1 a_name is the name.
+
+				@param2 a_scene receives the scene.
+
+				@return false if no scene has that name.
+		*/
+		static bool findScene(const char* a_name, BenchmarkScene& a_scene);
+
+		/**
+			loadBaseline reads a baseline file.
+
+				@param1 a_filename is the baseline.
+
+				@return false if it couldn't be read.
+		*/
+		bool loadBaseline(const char* a_filename);
+
+		/**
+			addResult adds a scene's results from this run.
+
+				@param1 a_scene is the scene.
+
+				@param2 a_report is its benchmark.
+		*/
+		void addResult(BenchmarkScene a_scene, const BenchmarkReport& a_report);
+
+		/**
+			compare prints every metric of this run beside its baseline.
+				A scene in the baseline with no results is a regression,
+				a metric missing from the baseline is only printed.
+
+				@return how many metrics regressed.
+		*/
+		unsigned int compare() const;
+
+		/**
+			writeBaseline writes this run's results as a new baseline,
+				each metric with its default tolerance, or the one the
+				loaded baseline gave it.
+
+				@param1 a_filename is the baseline to write.
+
+				@return false if it couldn't be written.
+		*/
+		bool writeBaseline(const char* a_filename) const;
+
+	private:
+		/**
+			One metric of one scene.
+		*/
+		struct Metric
+		{
+			std::string scene;
+			std::string name;
+			double value;
+			double tolerance;
+		};
+
+		// Finds a metric in a list, or nullptr.
+		static const Metric* find(const std::vector<Metric>& a_metrics, const std::string& a_scene,
+			const std::string& a_name);
+
+		std::vector<Metric> m_baseline;
+		std::vector<Metric> m_results;
+	};
+}
@@ -0,0 +1,504 @@
+/**
+	RenderGraph.cpp
+
+	Purpose: RenderGraph.cpp is the source file for the RenderGraph
+			class. The RenderGraph is a frame's passes and what each
+			reads and writes, declared up front, so passes nothing uses
+			are skipped and the targets only used within the frame
+			share the same textures.
+
+	@author Nathan Nette
+*/
+#include "RenderGraph.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+
+namespace sns
+{
+	const RenderGraph::Resource RenderGraph::NO_RESOURCE;
+
+	// Returns whether a format is depth, and whether it has stencil too.
+	static bool isDepthFormat(unsigned int a_format, bool* a_stencil)
+	{
+		switch (a_format)
+		{
+		case GL_DEPTH24_STENCIL8:
+		case GL_DEPTH32F_STENCIL8:
+			*a_stencil = true;
+			return true;
+		case GL_DEPTH_COMPONENT16:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+		case GL_DEPTH_COMPONENT32F:
+			*a_stencil = false;
+			return true;
+		default:
+			*a_stencil = false;
+			return false;
+		}
+	}
+
+	/**
+		read declares that the pass reads a resource.
+
+			@param1 a_resource is the resource.
+	*/
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(Resource a_resource)
+	{
+		if (a_resource != NO_RESOURCE)
+			m_graph.m_passes[m_pass].accesses.push_back({ a_resource, false, false });
+		return *this;
+	}
+
+	/**
+		write declares that the pass writes a resource.
+
+			@param1 a_resource is the resource.
+
+			@param2 a_clear clears a transient to zero, or to the far
+					depth, before the pass, if it is the first pass to
+					write it.
+	*/
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(Resource a_resource, bool a_clear)
+	{
+		if (a_resource != NO_RESOURCE)
+			m_graph.m_passes[m_pass].accesses.push_back({ a_resource, true, a_clear });
+		return *this;
+	}
+
+	/**
+		keep runs the pass whatever uses what it writes, for passes whose
+			work is seen some other way.
+	*/
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::keep()
+	{
+		m_graph.m_passes[m_pass].kept = true;
+		return *this;
+	}
+
+	RenderGraph::RenderGraph()
+		: m_passCount(0),
+		m_executes(0),
+		m_stats({})
+	{
+	}
+
+	/**
+		The deconstructor deletes the pool, see destroy.
+	*/
+	RenderGraph::~RenderGraph()
+	{
+		destroy();
+	}
+
+	/**
+		createTexture declares a transient texture.
+
+			@param1 a_name is what it is called, a string literal.
+
+			@param2 a_desc is its format and size.
+
+			@return the resource.
+	*/
+	RenderGraph::Resource RenderGraph::createTexture(const char* a_name, const TextureDesc& a_desc)
+	{
+		ResourceNode resource = {};
+		resource.name = a_name;
+		resource.desc = a_desc;
+		resource.desc.width = a_desc.width > 1 ? a_desc.width : 1;
+		resource.desc.height = a_desc.height > 1 ? a_desc.height : 1;
+		resource.imported = false;
+		resource.pooled = NO_RESOURCE;
+		m_resources.push_back(resource);
+		return (Resource)m_resources.size() - 1;
+	}
+
+	/**
+		importResource declares something that outlives the graph.
+
+			@param1 a_name is what it is called, a string literal.
+
+			@param2 a_texture is its texture, for getTexture, or 0.
+
+			@param3 a_framebuffer draws into it, for getFramebuffer, or 0.
+
+			@return the resource.
+	*/
+	RenderGraph::Resource RenderGraph::importResource(const char* a_name, unsigned int a_texture,
+		unsigned int a_framebuffer)
+	{
+		ResourceNode resource = {};
+		resource.name = a_name;
+		resource.imported = true;
+		resource.texture = a_texture;
+		resource.framebuffer = a_framebuffer;
+		resource.pooled = NO_RESOURCE;
+		m_resources.push_back(resource);
+		return (Resource)m_resources.size() - 1;
+	}
+
+	/**
+		addPass adds a pass, run by execute if it isn't culled.
+
+			@param1 a_name is what it is called, a string literal.
+
+			@param2 a_execute draws the pass, and can only be given its
+					transients' textures while it runs.
+
+			@return what declares what it reads and writes.
+	*/
+	RenderGraph::PassBuilder RenderGraph::addPass(const char* a_name, std::function<void()> a_execute)
+	{
+		if (m_passCount == m_passes.size())
+			m_passes.emplace_back();
+
+		PassNode& pass = m_passes[m_passCount];
+		pass.name = a_name;
+		pass.execute = std::move(a_execute);
+		pass.accesses.clear();
+		pass.writers = 0;
+		pass.kept = false;
+		pass.culled = false;
+		return PassBuilder(*this, m_passCount++);
+	}
+
+	/**
+		cull culls every pass nothing that runs needs. A pass is needed
+			while a resource it writes is imported or read by a pass
+			that runs, so culling a pass can leave what it read unread,
+			and those resources' writers are looked at again.
+	*/
+	void RenderGraph::cull()
+	{
+		for (unsigned int p = 0; p < m_passCount; ++p)
+		{
+			PassNode& pass = m_passes[p];
+			for (const Access& access : pass.accesses)
+			{
+				ResourceNode& resource = m_resources[access.resource];
+				if (access.write)
+				{
+					++pass.writers;
+					if (resource.imported)
+						pass.kept = true;
+				}
+				else
+					++resource.readers;
+			}
+		}
+
+		// Every transient nothing reads, its writers then lose a reason to
+		//	run.
+		m_unread.clear();
+		for (Resource r = 0; r < (Resource)m_resources.size(); ++r)
+		{
+			if (m_resources[r].imported == false && m_resources[r].readers == 0)
+				m_unread.push_back(r);
+		}
+
+		// And passes that write nothing at all.
+		for (unsigned int p = 0; p < m_passCount; ++p)
+		{
+			PassNode& pass = m_passes[p];
+			if (pass.writers == 0 && pass.kept == false)
+			{
+				pass.culled = true;
+				for (const Access& access : pass.accesses)
+				{
+					if (access.write == false && --m_resources[access.resource].readers == 0 &&
+						m_resources[access.resource].imported == false)
+						m_unread.push_back(access.resource);
+				}
+			}
+		}
+
+		while (m_unread.empty() == false)
+		{
+			Resource unread = m_unread.back();
+			m_unread.pop_back();
+			for (unsigned int p = 0; p < m_passCount; ++p)
+			{
+				PassNode& pass = m_passes[p];
+				if (pass.culled)
+					continue;
+
+				bool wrote = false;
+				for (const Access& access : pass.accesses)
+				{
+					if (access.write && access.resource == unread)
+					{
+						--pass.writers;
+						wrote = true;
+					}
+				}
+				if (wrote == false || pass.writers > 0 || pass.kept)
+					continue;
+
+				pass.culled = true;
+				for (const Access& access : pass.accesses)
+				{
+					if (access.write == false && --m_resources[access.resource].readers == 0 &&
+						m_resources[access.resource].imported == false)
+						m_unread.push_back(access.resource);
+				}
+			}
+		}
+	}
+
+	/**
+		execute culls the passes, runs the rest with their transients'
+			textures, and clears the graph for the next passes.
+	*/
+	void RenderGraph::execute()
+	{
+		++m_executes;
+		m_stats.passes = 0;
+		m_stats.culled = 0;
+		m_stats.transients = 0;
+		m_stats.clears = 0;
+		m_stats.transientBytes = 0;
+
+		cull();
+
+		// Each resource's first and last pass that runs.
+		for (ResourceNode& resource : m_resources)
+		{
+			resource.firstPass = NO_RESOURCE;
+			resource.lastPass = 0;
+		}
+		for (unsigned int p = 0; p < m_passCount; ++p)
+		{
+			if (m_passes[p].culled)
+			{
+				++m_stats.culled;
+				continue;
+			}
+
+			++m_stats.passes;
+			for (const Access& access : m_passes[p].accesses)
+			{
+				ResourceNode& resource = m_resources[access.resource];
+				if (resource.firstPass == NO_RESOURCE)
+					resource.firstPass = p;
+				resource.lastPass = p;
+			}
+		}
+
+		for (unsigned int p = 0; p < m_passCount; ++p)
+		{
+			PassNode& pass = m_passes[p];
+			if (pass.culled)
+				continue;
+
+			// Transients are given their textures as their first pass
+			//	starts, and cleared if it asks.
+			for (const Access& access : pass.accesses)
+			{
+				ResourceNode& resource = m_resources[access.resource];
+				if (resource.imported)
+					continue;
+
+				if (resource.firstPass == p && resource.pooled == NO_RESOURCE)
+				{
+					acquire(resource);
+					++m_stats.transients;
+					m_stats.transientBytes += m_pool[resource.pooled].bytes;
+				}
+				if (access.write && resource.written == false)
+				{
+					if (access.clear)
+					{
+						clear(resource);
+						++m_stats.clears;
+					}
+					resource.written = true;
+				}
+			}
+
+			pass.execute();
+
+			// And give them back once their last has finished, for the
+			//	next pass's.
+			for (const Access& access : pass.accesses)
+			{
+				ResourceNode& resource = m_resources[access.resource];
+				if (resource.imported == false && resource.lastPass == p && resource.pooled != NO_RESOURCE)
+				{
+					m_pool[resource.pooled].inUse = false;
+					resource.pooled = NO_RESOURCE;
+					resource.texture = 0;
+					resource.framebuffer = 0;
+				}
+			}
+		}
+
+		// Textures no graph has needed in a while are deleted.
+		for (size_t t = 0; t < m_pool.size();)
+		{
+			if (m_executes - m_pool[t].lastUsed > KEPT_EXECUTES)
+			{
+				release(m_pool[t]);
+				m_pool[t] = m_pool.back();
+				m_pool.pop_back();
+			}
+			else
+				++t;
+		}
+
+		m_stats.textures = (unsigned int)m_pool.size();
+		m_stats.textureBytes = 0;
+		for (const PooledTexture& texture : m_pool)
+			m_stats.textureBytes += texture.bytes;
+
+		// The passes' functions are let go of now, as what they captured
+		//	may not outlive the frame.
+		for (unsigned int p = 0; p < m_passCount; ++p)
+			m_passes[p].execute = nullptr;
+		m_passCount = 0;
+		m_resources.clear();
+	}
+
+	/**
+		acquire gives a transient a free texture of the pool with its
+			format and size, or makes one.
+
+			@param1 a_resource is the transient.
+	*/
+	void RenderGraph::acquire(ResourceNode& a_resource)
+	{
+		unsigned int found = NO_RESOURCE;
+		for (unsigned int t = 0; t < (unsigned int)m_pool.size(); ++t)
+		{
+			const PooledTexture& texture = m_pool[t];
+			if (texture.inUse == false && texture.desc.format == a_resource.desc.format &&
+				texture.desc.width == a_resource.desc.width && texture.desc.height == a_resource.desc.height)
+			{
+				found = t;
+				break;
+			}
+		}
+
+		if (found == NO_RESOURCE)
+		{
+			PooledTexture texture = {};
+			texture.desc = a_resource.desc;
+			texture.bytes = GpuMemory::getTextureBytes(texture.desc.format, texture.desc.width, texture.desc.height);
+			glCreateTextures(GL_TEXTURE_2D, 1, &texture.texture);
+			glTextureStorage2D(texture.texture, 1, texture.desc.format, texture.desc.width, texture.desc.height);
+			glTextureParameteri(texture.texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTextureParameteri(texture.texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTextureParameteri(texture.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(texture.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GpuMemory::instance().trackTexture(texture.texture, texture.bytes, GpuMemory::RENDER_TARGETS, "RenderGraph");
+
+			bool stencil = false;
+			glCreateFramebuffers(1, &texture.framebuffer);
+			if (isDepthFormat(texture.desc.format, &stencil))
+			{
+				glNamedFramebufferTexture(texture.framebuffer, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+					texture.texture, 0);
+				glNamedFramebufferDrawBuffer(texture.framebuffer, GL_NONE);
+				glNamedFramebufferReadBuffer(texture.framebuffer, GL_NONE);
+			}
+			else
+				glNamedFramebufferTexture(texture.framebuffer, GL_COLOR_ATTACHMENT0, texture.texture, 0);
+
+			if (glCheckNamedFramebufferStatus(texture.framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				printf("RenderGraph: %s's framebuffer isn't complete.\n", a_resource.name);
+
+			m_pool.push_back(texture);
+			found = (unsigned int)m_pool.size() - 1;
+		}
+
+		PooledTexture& texture = m_pool[found];
+		texture.inUse = true;
+		texture.lastUsed = m_executes;
+		a_resource.pooled = found;
+		a_resource.texture = texture.texture;
+		a_resource.framebuffer = texture.framebuffer;
+	}
+
+	/**
+		clear clears a transient's texture to zero, or a depth one's depth
+			to the far depth, with depth writes on while it does.
+
+			@param1 a_resource is the transient, with its texture.
+	*/
+	void RenderGraph::clear(const ResourceNode& a_resource)
+	{
+		bool stencil = false;
+		if (isDepthFormat(a_resource.desc.format, &stencil))
+		{
+			RenderState& state = RenderState::instance();
+			bool depthMask = state.getDepthMask();
+			state.setDepthMask(true);
+			float depth = state.isReverseZ() ? 0.0f : 1.0f;
+			glClearNamedFramebufferfv(a_resource.framebuffer, GL_DEPTH, 0, &depth);
+			state.setDepthMask(depthMask);
+		}
+		else
+		{
+			const float colour[4] = { 0, 0, 0, 0 };
+			glClearNamedFramebufferfv(a_resource.framebuffer, GL_COLOR, 0, colour);
+		}
+	}
+
+	/**
+		getTexture returns a resource's texture, for a transient only
+			while a pass that uses it runs.
+
+			@param1 a_resource is the resource.
+	*/
+	unsigned int RenderGraph::getTexture(Resource a_resource) const
+	{
+		return a_resource < m_resources.size() ? m_resources[a_resource].texture : 0;
+	}
+
+	/**
+		getFramebuffer returns a framebuffer drawing into a resource's
+			texture alone, for a transient only while a pass that uses it
+			runs.
+
+			@param1 a_resource is the resource.
+	*/
+	unsigned int RenderGraph::getFramebuffer(Resource a_resource) const
+	{
+		return a_resource < m_resources.size() ? m_resources[a_resource].framebuffer : 0;
+	}
+
+	/**
+		release deletes a pooled texture and its framebuffer.
+
+			@param1 a_texture is the pooled texture.
+	*/
+	void RenderGraph::release(PooledTexture& a_texture)
+	{
+		if (a_texture.texture != 0)
+		{
+			glDeleteTextures(1, &a_texture.texture);
+			RenderState::instance().onTextureDeleted(a_texture.texture);
+			GpuMemory::instance().releaseTexture(a_texture.texture);
+			a_texture.texture = 0;
+		}
+		if (a_texture.framebuffer != 0)
+		{
+			glDeleteFramebuffers(1, &a_texture.framebuffer);
+			a_texture.framebuffer = 0;
+		}
+	}
+
+	/**
+		destroy deletes the pool's textures and framebuffers.
+	*/
+	void RenderGraph::destroy()
+	{
+		for (PooledTexture& texture : m_pool)
+			release(texture);
+		m_pool.clear();
+		m_passCount = 0;
+		m_resources.clear();
+		m_stats = {};
+	}
+}
@@ -0,0 +1,284 @@
+/**
+	RenderGraph.h
+
+	Purpose: RenderGraph.h is the header file for the RenderGraph class.
+			The RenderGraph is a frame's passes and what each reads and
+			writes, declared up front, so passes nothing uses are
+			skipped and the targets only used within the frame share
+			the same textures.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <functional>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The RenderGraph class is rebuilt each time it is drawn. Passes are
+			added with what they read and write, then execute culls and
+			runs them and forgets them for the next.
+
+		A resource is either imported, something that outlives the graph
+			like the framebuffer the scene is drawn into or a target a
+			class owns, or transient, a texture the graph gives out only
+			for the passes that use it. Imported resources don't need a
+			texture, one with none only orders the passes around it.
+
+		A pass that writes an imported resource, or is kept, always runs.
+			Any other is culled when nothing that runs reads what it
+			writes, and so on back, so a pass whose only output is a
+			transient nobody reads costs nothing.
+
+		Passes run in the order they were added, already one where reads
+			come after the writes they read, as each pass only sees
+			what was declared before it.
+
+		A transient has a texture from the first pass that uses it to the
+			last, then gives it back. A transient declared later with the
+			same format and size whose passes all come after takes the
+			same texture, GL having no way to place textures of other
+			formats in the same memory. The textures stay in a pool
+			between executes and are only deleted once KEPT_EXECUTES go
+			by without one being needed.
+
+		A transient's texels are whatever its texture last held unless
+			the first pass that writes it asks for it cleared, so a pass
+			that draws over all of it doesn't pay for a clear.
+
+		Needs GL 4.5 for the transients' textures and framebuffers.
+	*/
+	class RenderGraph
+	{
+	public:
+		typedef unsigned int Resource;
+		static const Resource NO_RESOURCE = ~0u;
+
+		// How many executes a pooled texture is kept through unused.
+		static const unsigned int KEPT_EXECUTES = 240;
+
+		/**
+			What a transient texture is, 2D with one level.
+		*/
+		struct TextureDesc
+		{
+			unsigned int format;
+			int width;
+			int height;
+		};
+
+		/**
+			What the last execute did.
+		*/
+		struct Stats
+		{
+			unsigned int passes;
+			unsigned int culled;
+			unsigned int transients;
+			unsigned int clears;
+
+			// The pool's textures, and what the transients would have
+			//	taken each with their own.
+			unsigned int textures;
+			unsigned long long textureBytes;
+			unsigned long long transientBytes;
+		};
+
+		/**
+			A PassBuilder declares what the pass it was returned for reads
+				and writes.
+		*/
+		class PassBuilder
+		{
+		public:
+			PassBuilder(RenderGraph& a_graph, unsigned int a_pass) : m_graph(a_graph), m_pass(a_pass) {}
+
+			/**
+				read declares that the pass reads a resource.
+
+					@param1 a_resource is the resource.
+			*/
+			PassBuilder& read(Resource a_resource);
+
+			/**
+				write declares that the pass writes a resource.
+
+					@param1 a_resource is the resource.
+
+					@param2 a_clear clears a transient to zero, or to the
+							far depth, before the pass, if it is the first
+							pass to write it.
+			*/
+			PassBuilder& write(Resource a_resource, bool a_clear = false);
+
+			/**
+				keep runs the pass whatever uses what it writes, for
+					passes whose work is seen some other way.
+			*/
+			PassBuilder& keep();
+
+		private:
+			RenderGraph& m_graph;
+			unsigned int m_pass;
+		};
+
+		RenderGraph();
+
+		/**
+			The deconstructor deletes the pool, see destroy.
+		*/
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		/**
+			createTexture declares a transient texture.
+
+				@param1 a_name is what it is called, a string literal.
+
+				@param2 a_desc is its format and size.
+
+				@return the resource.
+		*/
+		Resource createTexture(const char* a_name, const TextureDesc& a_desc);
+
+		/**
+			importResource declares something that outlives the graph.
+
+				@param1 a_name is what it is called, a string literal.
+
+				@param2 a_texture is its texture, for getTexture, or 0.
+
+				@param3 a_framebuffer draws into it, for getFramebuffer,
+						or 0.
+
+				@return the resource.
+		*/
+		Resource importResource(const char* a_name, unsigned int a_texture = 0, unsigned int a_framebuffer = 0);
+
+		/**
+			addPass adds a pass, run by execute if it isn't culled.
+
+				@param1 a_name is what it is called, a string literal.
+
+				@param2 a_execute draws the pass, and can only be given
+						its transients' textures while it runs.
+
+				@return what declares what it reads and writes.
+		*/
+		PassBuilder addPass(const char* a_name, std::function<void()> a_execute);
+
+		/**
+			execute culls the passes, runs the rest with their transients'
+				textures, and clears the graph for the next passes.
+		*/
+		void execute();
+
+		/**
+			getTexture returns a resource's texture, for a transient only
+				while a pass that uses it runs.
+
+				@param1 a_resource is the resource.
+		*/
+		unsigned int getTexture(Resource a_resource) const;
+
+		/**
+			getFramebuffer returns a framebuffer drawing into a resource's
+				texture alone, at its depth attachment for depth formats
+				and its first colour one otherwise, for a transient only
+				while a pass that uses it runs.
+
+				@param1 a_resource is the resource.
+		*/
+		unsigned int getFramebuffer(Resource a_resource) const;
+
+		/**
+			getStats returns what the last execute did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+		/**
+			destroy deletes the pool's textures and framebuffers.
+		*/
+		void destroy();
+
+	private:
+		struct ResourceNode
+		{
+			const char* name;
+			TextureDesc desc;
+			bool imported;
+			unsigned int texture;
+			unsigned int framebuffer;
+
+			// How many passes that run read it, and its texture in the
+			//	pool while it has one.
+			unsigned int readers;
+			unsigned int pooled;
+
+			// The first and last passes that run using it, and whether
+			//	one has written it yet.
+			unsigned int firstPass;
+			unsigned int lastPass;
+			bool written;
+		};
+
+		struct Access
+		{
+			Resource resource;
+			bool write;
+			bool clear;
+		};
+
+		struct PassNode
+		{
+			const char* name;
+			std::function<void()> execute;
+			std::vector<Access> accesses;
+
+			// How many of its writes something that runs still reads.
+			unsigned int writers;
+			bool kept;
+			bool culled;
+		};
+
+		struct PooledTexture
+		{
+			TextureDesc desc;
+			unsigned int texture;
+			unsigned int framebuffer;
+			unsigned long long bytes;
+			unsigned long long lastUsed;
+			bool inUse;
+		};
+
+		// Culls every pass nothing that runs needs.
+		void cull();
+
+		// Gives a transient a texture of the pool, making one if none is
+		//	free.
+		void acquire(ResourceNode& a_resource);
+
+		// Clears a transient's texture.
+		void clear(const ResourceNode& a_resource);
+
+		// Deletes a pooled texture and its framebuffer.
+		void release(PooledTexture& a_texture);
+
+		// The passes and resources added since the last execute. Only the
+		//	first m_passCount passes are, the rest are kept so their
+		//	vectors don't allocate again.
+		std::vector<PassNode> m_passes;
+		unsigned int m_passCount;
+		std::vector<ResourceNode> m_resources;
+
+		// Scratch space for culling.
+		std::vector<Resource> m_unread;
+
+		std::vector<PooledTexture> m_pool;
+		unsigned long long m_executes;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,271 @@
+/**
+	RenderQueue.cpp
+
+	Purpose: RenderQueue.cpp is the source file for the RenderQueue class.
+			Meshes submit draw items to the RenderQueue during the frame,
+			which are sorted by their key before being drawn.
+
+	@author Nathan Nette
+*/
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "OBJMesh.h"
+#include "ObjectBuffer.h"
+#include "OcclusionQueries.h"
+#include "RadixSort.h"
+#include "Shader.h"
+
+namespace sns
+{
+	// The sorted items each job records into a command list of its own.
+	//	Fewer are recorded on the calling thread.
+	static const unsigned int RECORD_BLOCK_SIZE = 2048;
+
+	/**
+		makeKey packs the state an item needs into a sort key.
+
+			@param1 a_program is the GL handle of the program.
+
+			@param2 a_texture is the GL handle of the item's first texture.
+
+			@param3 a_vertexArray is the GL handle of the item's VAO.
+
+			@return the sort key.
+	*/
+	unsigned long long RenderQueue::makeKey(unsigned int a_program, unsigned int a_texture,
+		unsigned int a_vertexArray)
+	{
+		// 16 bits of program, 24 of texture and 24 of vertex array. Handles
+		//	are small counters, so the low bits keep them apart.
+		return ((unsigned long long)(a_program & 0xffff) << 48) |
+			((unsigned long long)(a_texture & 0xffffff) << 24) |
+			(unsigned long long)(a_vertexArray & 0xffffff);
+	}
+
+	/**
+		submit adds an item to the frame.
+
+			@param1 a_item is the draw to add.
+	*/
+	void RenderQueue::submit(const Item& a_item)
+	{
+		m_items.push_back(a_item);
+	}
+
+	/**
+		merge moves the items of other queues to the end of this one, in
+			their order. They are left empty.
+
+			@param1 a_lists are the queues, filled by jobs.
+
+			@param2 a_count is how many there are.
+	*/
+	void RenderQueue::merge(RenderQueue* a_lists, unsigned int a_count)
+	{
+		size_t total = m_items.size();
+		for (unsigned int i = 0; i < a_count; ++i)
+			total += a_lists[i].m_items.size();
+		m_items.reserve(total);
+
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			m_items.insert(m_items.end(), a_lists[i].m_items.begin(), a_lists[i].m_items.end());
+			a_lists[i].clear();
+		}
+	}
+
+	/**
+		execute sorts the items and draws them, then clears the queue.
+
+			@param1 a_objects are the objects the items are placed by.
+	*/
+	void RenderQueue::execute(const ObjectBuffer& a_objects)
+	{
+		sort();
+		draw(a_objects);
+		clear();
+	}
+
+	/**
+		sort sorts the items, once for every view draw is called for.
+	*/
+	void RenderQueue::sort()
+	{
+		unsigned int count = (unsigned int)m_items.size();
+		if (count < 2)
+			return;
+
+		// Only the keys and their items' indices are moved by the sort.
+		m_keys.resize(count);
+		m_order.resize(count);
+		m_scratchKeys.resize(count);
+		m_scratchOrder.resize(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			m_keys[i] = m_items[i].key;
+			m_order[i] = i;
+		}
+		parallelRadixSort(m_keys.data(), m_order.data(), m_scratchKeys.data(), m_scratchOrder.data(), count);
+
+		m_sortedItems.resize(count);
+		for (unsigned int i = 0; i < count; ++i)
+			m_sortedItems[i] = m_items[m_order[i]];
+		m_items.swap(m_sortedItems);
+	}
+
+	/**
+		draw draws the sorted items seen from some views, keeping them
+			for the next.
+
+			@param1 a_objects are the objects the items are placed by.
+
+			@param2 a_viewMask is the views' bits, items seen from none
+					of them are skipped.
+
+			@param3 a_occlusion are the queries assigned the items, for
+					a single view, or null not to test them.
+	*/
+	void RenderQueue::draw(const ObjectBuffer& a_objects, unsigned int a_viewMask,
+		const OcclusionQueries* a_occlusion)
+	{
+		unsigned int count = (unsigned int)m_items.size();
+		unsigned int blockCount = (count + RECORD_BLOCK_SIZE - 1) / RECORD_BLOCK_SIZE;
+		if (blockCount < 1)
+			blockCount = 1;
+		if (m_commandLists.size() < blockCount)
+			m_commandLists.resize(blockCount);
+		m_blockStats.resize(blockCount);
+
+		// Each block starts with nothing bound, so it records its own
+		//	first program and object. The lists only touch GL once they
+		//	are executed, here, in order.
+		if (blockCount < 2)
+			record(0, count, a_viewMask, a_occlusion, m_commandLists[0], m_blockStats[0]);
+		else
+		{
+			JobSystem& jobs = JobSystem::instance();
+			JobCounter counter;
+			for (unsigned int block = 0; block < blockCount; ++block)
+			{
+				jobs.run([this, block, count, a_viewMask, a_occlusion]()
+				{
+					unsigned int first = block * RECORD_BLOCK_SIZE;
+					unsigned int last = first + RECORD_BLOCK_SIZE < count ? first + RECORD_BLOCK_SIZE : count;
+					record(first, last, a_viewMask, a_occlusion, m_commandLists[block], m_blockStats[block]);
+				}, &counter);
+			}
+			jobs.wait(counter);
+		}
+
+		m_stats = {};
+		a_objects.bind();
+		for (unsigned int block = 0; block < blockCount; ++block)
+		{
+			m_commandLists[block].execute();
+			const Stats& stats = m_blockStats[block];
+			m_stats.items += stats.items;
+			m_stats.programChanges += stats.programChanges;
+			m_stats.textureChanges += stats.textureChanges;
+			m_stats.vertexArrayChanges += stats.vertexArrayChanges;
+			m_stats.occluded += stats.occluded;
+			m_stats.conditional += stats.conditional;
+		}
+	}
+
+	/**
+		record records some of the sorted items into a command list,
+			without touching GL, so blocks of them can be recorded at
+			once.
+
+			@param1 a_first is the first item.
+
+			@param2 a_last is one past the last.
+
+			@param3 a_viewMask is the views' bits.
+
+			@param4 a_occlusion are the queries assigned the items, or
+					null.
+
+			@param5 a_list is the list to record into, which is cleared
+					first.
+
+			@param6 a_stats are set to the block's counts.
+	*/
+	void RenderQueue::record(unsigned int a_first, unsigned int a_last, unsigned int a_viewMask,
+		const OcclusionQueries* a_occlusion, CommandList& a_list, Stats& a_stats) const
+	{
+		a_list.clear();
+		a_stats = {};
+
+		aie::ShaderProgram* currentShader = nullptr;
+		unsigned int currentObject = ~0u;
+		unsigned long long currentTexture = ~0ull;
+		unsigned long long currentVertexArray = ~0ull;
+
+		for (unsigned int i = a_first; i < a_last; ++i)
+		{
+			const Item& item = m_items[i];
+			if ((item.viewMask & a_viewMask) == 0)
+				continue;
+
+			// Chunks last found hidden are skipped before any state is
+			//	changed for them.
+			OcclusionQueries::Result occlusion = OcclusionQueries::Result::VISIBLE;
+			if (a_occlusion != nullptr && item.occlusion != OcclusionQueries::NO_QUERY)
+				occlusion = a_occlusion->test(item.occlusion);
+			if (occlusion == OcclusionQueries::Result::OCCLUDED)
+			{
+				++a_stats.occluded;
+				continue;
+			}
+			++a_stats.items;
+
+			if (item.shader != currentShader)
+			{
+				currentShader = item.shader;
+				a_list.bindProgram(currentShader);
+				++a_stats.programChanges;
+			}
+
+			// The object's index is context state, so it outlasts program
+			//	changes and only needs sending when it changes.
+			if (item.object != currentObject)
+			{
+				currentObject = item.object;
+				a_list.selectObject(currentObject);
+			}
+
+			unsigned long long texture = (item.key >> 24) & 0xffffff;
+			if (texture != currentTexture)
+			{
+				currentTexture = texture;
+				++a_stats.textureChanges;
+			}
+
+			unsigned long long vertexArray = item.key & 0xffffff;
+			if (vertexArray != currentVertexArray)
+			{
+				currentVertexArray = vertexArray;
+				++a_stats.vertexArrayChanges;
+			}
+
+			// The gpu skips it if the query is in by the time it gets
+			//	here, and draws it if not.
+			unsigned int query = 0;
+			if (occlusion == OcclusionQueries::Result::PENDING)
+			{
+				++a_stats.conditional;
+				query = a_occlusion->getQuery(item.occlusion);
+			}
+			a_list.drawChunk(item.mesh, item.chunk, item.usePatches, item.lod, query);
+		}
+	}
+
+	/**
+		clear throws away the items without drawing.
+	*/
+	void RenderQueue::clear()
+	{
+		m_items.clear();
+	}
+}
@@ -0,0 +1,201 @@
+/**
+	RenderQueue.h
+
+	Purpose: RenderQueue.h is the header file for the RenderQueue class.
+			Meshes submit draw items to the RenderQueue during the frame.
+			The items are sorted by a 64 bit key before any GL calls are
+			made, so that draws sharing a program, textures or vertex
+			array are issued together.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "CommandList.h"
+#include <cstdint>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+	class ShaderProgram;
+}
+
+namespace sns
+{
+	class ObjectBuffer;
+	class OcclusionQueries;
+
+	/**
+		The RenderQueue class collects, sorts and draws a frame's meshes.
+
+		A frame drawn from several views submits once, marking each item
+			with the views it is seen from, then sorts once and draws
+			each view's items from the same queue.
+
+		Items are placed by their object in an ObjectBuffer, so between
+			draws of different objects only the object's index is sent.
+
+		A queue can be filled by several jobs at once, each submitting
+			to a queue of its own used only as a list, which merge
+			then moves into this one. sort is a radix sort of the keys,
+			run over blocks of them on the job system when there are
+			many. draw records blocks of the sorted items into
+			CommandLists on the job system the same way, so only the
+			GL calls of executing them are left to the render thread.
+	*/
+	class RenderQueue
+	{
+	public:
+		/**
+			A single draw, one chunk of one mesh.
+		*/
+		struct Item
+		{
+			// Sort key from makeKey. Lower keys are drawn first.
+			unsigned long long key;
+
+			// The program to draw with.
+			aie::ShaderProgram* shader;
+
+			// The mesh and its chunk to draw.
+			const aie::OBJMesh* mesh;
+			unsigned int chunk;
+
+			// The ObjectBuffer index it is placed by.
+			unsigned int object;
+
+			// Draws with GL_PATCHES for tessellation.
+			bool usePatches;
+
+			// The chunk's level of detail, 0 for full detail.
+			unsigned int lod;
+
+			// A bit for each view the item is seen from.
+			unsigned int viewMask;
+
+			// Its chunk's query in the OcclusionQueries it is drawn
+			//	with, given by their assign.
+			unsigned int occlusion;
+		};
+
+		/**
+			Counts from the last execute, showing how well the sort batched
+				the draws.
+		*/
+		struct Stats
+		{
+			unsigned int items;
+			unsigned int programChanges;
+			unsigned int textureChanges;
+			unsigned int vertexArrayChanges;
+
+			// Items skipped as occluded, and drawn conditionally on a
+			//	query still out, by the OcclusionQueries.
+			unsigned int occluded;
+			unsigned int conditional;
+		};
+
+		/**
+			makeKey packs the state an item needs into a sort key. The
+				program is the most significant, then the first texture,
+				then the vertex array, so the most expensive changes
+				happen the least.
+
+				@param1 a_program is the GL handle of the program.
+
+				@param2 a_texture is the GL handle of the item's first texture.
+
+				@param3 a_vertexArray is the GL handle of the item's VAO.
+
+				@return the sort key.
+		*/
+		static unsigned long long makeKey(unsigned int a_program, unsigned int a_texture,
+			unsigned int a_vertexArray);
+
+		/**
+			submit adds an item to the frame.
+
+				@param1 a_item is the draw to add.
+		*/
+		void submit(const Item& a_item);
+
+		/**
+			merge moves the items of other queues to the end of this one,
+				in their order. They are left empty.
+
+				@param1 a_lists are the queues, filled by jobs.
+
+				@param2 a_count is how many there are.
+		*/
+		void merge(RenderQueue* a_lists, unsigned int a_count);
+
+		/**
+			execute sorts the items and draws them, then clears the queue.
+
+				@param1 a_objects are the objects the items are placed by.
+		*/
+		void execute(const ObjectBuffer& a_objects);
+
+		/**
+			sort sorts the items, once for every view draw is called for.
+				Equal keys keep the order they were submitted in.
+		*/
+		void sort();
+
+		/**
+			draw draws the sorted items seen from some views, keeping
+				them for the next.
+
+				@param1 a_objects are the objects the items are placed by.
+						The view's projection view is FrameData's.
+
+				@param2 a_viewMask is the views' bits, items seen from
+						none of them are skipped.
+
+				@param3 a_occlusion are the queries assigned the items,
+						for a single view, or null not to test them.
+		*/
+		void draw(const ObjectBuffer& a_objects, unsigned int a_viewMask = ~0u,
+			const OcclusionQueries* a_occlusion = nullptr);
+
+		/**
+			clear throws away the items without drawing.
+		*/
+		void clear();
+
+		/**
+			getItems returns the items, sorted once sort has run.
+		*/
+		std::vector<Item>& getItems() { return m_items; }
+
+		/**
+			getStats returns the counts from the last execute.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		// Records the items from a_first to before a_last into a list,
+		//	with their counts, without touching GL.
+		void record(unsigned int a_first, unsigned int a_last, unsigned int a_viewMask,
+			const OcclusionQueries* a_occlusion, CommandList& a_list, Stats& a_stats) const;
+
+		// The frame's draws, in submission order until execute sorts them.
+		std::vector<Item> m_items;
+
+		// The radix sort's keys and item indices and its scratch, and the
+		//	items gathered in sorted order, kept between frames.
+		std::vector<uint64_t> m_keys;
+		std::vector<uint32_t> m_order;
+		std::vector<uint64_t> m_scratchKeys;
+		std::vector<uint32_t> m_scratchOrder;
+		std::vector<Item> m_sortedItems;
+
+		// A command list and the counts of each block draw records, kept
+		//	between frames.
+		std::vector<CommandList> m_commandLists;
+		std::vector<Stats> m_blockStats;
+
+		// Counts from the last execute.
+		Stats m_stats = {};
+	};
+}
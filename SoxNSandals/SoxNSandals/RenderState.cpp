@@ -0,0 +1,470 @@
+/**
+	RenderState.cpp
+
+	Purpose: RenderState.cpp is the source file for the RenderState class.
+			The RenderState class remembers what is bound in OpenGL so
+			that binds which wouldn't change anything can be skipped.
+
+	@author Nathan Nette
+*/
+#include "RenderState.h"
+#include "VertexArrays.h"
+#include "gl_core_4_5.h"
+
+namespace sns
+{
+	// Marks state that hasn't been seen yet, so the first bind is always sent.
+	static const unsigned int UNKNOWN = ~0u;
+
+	/**
+		instance returns the render state of the GL context.
+	*/
+	RenderState& RenderState::instance()
+	{
+		static RenderState state;
+		return state;
+	}
+
+	/**
+		The constructor starts from the state of a new context, so GL
+			never has to be asked what is bound.
+	*/
+	RenderState::RenderState() : m_programDeletions(0), m_reverseZ(false), m_stats()
+	{
+		reset();
+	}
+
+	/**
+		useProgram binds a shader program if it isn't already bound.
+
+			@param1 a_program is the GL handle of the program.
+	*/
+	void RenderState::useProgram(unsigned int a_program)
+	{
+		if (m_program == a_program)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glUseProgram(a_program);
+		m_program = a_program;
+		++m_stats.sent;
+	}
+
+	/**
+		getProgram returns the bound program.
+	*/
+	unsigned int RenderState::getProgram()
+	{
+		if (m_program == UNKNOWN)
+		{
+			int program = 0;
+			glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+			m_program = (unsigned int)program;
+			++m_stats.queries;
+		}
+		return m_program;
+	}
+
+	/**
+		bindTexture binds a 2D texture and a sampler to a texture unit
+			if they aren't already bound there.
+
+			@param1 a_unit is the texture unit, starting from 0.
+
+			@param2 a_texture is the GL handle of the texture, or 0.
+
+			@param3 a_sampler is the GL handle of a sampler, or 0 to
+					sample with the texture's own state.
+	*/
+	void RenderState::bindTexture(unsigned int a_unit, unsigned int a_texture, unsigned int a_sampler)
+	{
+		// Samplers are bound by unit, the active one doesn't matter.
+		if (a_unit >= MAX_TEXTURE_UNITS || m_samplers[a_unit] != a_sampler)
+		{
+			glBindSampler(a_unit, a_sampler);
+			if (a_unit < MAX_TEXTURE_UNITS)
+				m_samplers[a_unit] = a_sampler;
+			++m_stats.sent;
+		}
+
+		if (a_unit < MAX_TEXTURE_UNITS && m_textures[a_unit] == a_texture)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		if (m_activeUnit != a_unit)
+		{
+			glActiveTexture(GL_TEXTURE0 + a_unit);
+			m_activeUnit = a_unit;
+			++m_stats.sent;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, a_texture);
+		if (a_unit < MAX_TEXTURE_UNITS)
+			m_textures[a_unit] = a_texture;
+		++m_stats.sent;
+	}
+
+	/**
+		bindVertexArray binds a vertex array if it isn't already bound.
+
+			@param1 a_vao is the GL handle of the vertex array, or 0.
+	*/
+	void RenderState::bindVertexArray(unsigned int a_vao)
+	{
+		if (m_vertexArray == a_vao)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glBindVertexArray(a_vao);
+		m_vertexArray = a_vao;
+		++m_stats.sent;
+	}
+
+	/**
+		bindBuffer binds a buffer to a target if it isn't already bound
+			there. Only the array and draw indirect buffers are tracked.
+
+			@param1 a_target is the buffer target, such as GL_ARRAY_BUFFER.
+
+			@param2 a_buffer is the GL handle of the buffer, or 0.
+	*/
+	void RenderState::bindBuffer(unsigned int a_target, unsigned int a_buffer)
+	{
+		unsigned int* bound = a_target == GL_ARRAY_BUFFER ? &m_arrayBuffer :
+			a_target == GL_DRAW_INDIRECT_BUFFER ? &m_indirectBuffer : nullptr;
+		if (bound != nullptr && *bound == a_buffer)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glBindBuffer(a_target, a_buffer);
+		if (bound != nullptr)
+			*bound = a_buffer;
+		++m_stats.sent;
+	}
+
+	/**
+		setBlend turns blending on or off if it isn't already.
+
+			@param1 a_enabled is whether GL_BLEND is enabled.
+	*/
+	void RenderState::setBlend(bool a_enabled)
+	{
+		if (m_blend == (unsigned int)a_enabled)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		if (a_enabled)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+		m_blend = a_enabled;
+		++m_stats.sent;
+	}
+
+	/**
+		isBlendEnabled returns whether blending is on.
+	*/
+	bool RenderState::isBlendEnabled()
+	{
+		if (m_blend == UNKNOWN)
+		{
+			m_blend = glIsEnabled(GL_BLEND) == GL_TRUE;
+			++m_stats.queries;
+		}
+		return m_blend == 1;
+	}
+
+	/**
+		setBlendFunc sets the blend factors if they aren't already set.
+
+			@param1 a_source is the source factor, such as GL_SRC_ALPHA.
+
+			@param2 a_destination is the destination factor.
+	*/
+	void RenderState::setBlendFunc(unsigned int a_source, unsigned int a_destination)
+	{
+		if (m_blendSource == a_source && m_blendDestination == a_destination)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glBlendFunc(a_source, a_destination);
+		m_blendSource = a_source;
+		m_blendDestination = a_destination;
+		++m_stats.sent;
+	}
+
+	/**
+		getBlendFunc returns the blend factors.
+
+			@param1 a_source receives the source factor.
+
+			@param2 a_destination receives the destination factor.
+	*/
+	void RenderState::getBlendFunc(unsigned int& a_source, unsigned int& a_destination)
+	{
+		if (m_blendSource == UNKNOWN || m_blendDestination == UNKNOWN)
+		{
+			int source = 0, destination = 0;
+			glGetIntegerv(GL_BLEND_SRC_RGB, &source);
+			glGetIntegerv(GL_BLEND_DST_RGB, &destination);
+			m_blendSource = (unsigned int)source;
+			m_blendDestination = (unsigned int)destination;
+			++m_stats.queries;
+		}
+		a_source = m_blendSource;
+		a_destination = m_blendDestination;
+	}
+
+	/**
+		setDepthMask turns depth writes on or off if they aren't already.
+
+			@param1 a_write is whether depth is written.
+	*/
+	void RenderState::setDepthMask(bool a_write)
+	{
+		if (m_depthMask == (unsigned int)a_write)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glDepthMask(a_write ? GL_TRUE : GL_FALSE);
+		m_depthMask = a_write;
+		++m_stats.sent;
+	}
+
+	/**
+		getDepthMask returns whether depth is written.
+	*/
+	bool RenderState::getDepthMask()
+	{
+		if (m_depthMask == UNKNOWN)
+		{
+			GLboolean mask = GL_TRUE;
+			glGetBooleanv(GL_DEPTH_WRITEMASK, &mask);
+			m_depthMask = mask == GL_TRUE;
+			++m_stats.queries;
+		}
+		return m_depthMask == 1;
+	}
+
+	/**
+		setDepthTest turns the depth test on or off if it isn't already.
+
+			@param1 a_enabled is whether GL_DEPTH_TEST is enabled.
+	*/
+	void RenderState::setDepthTest(bool a_enabled)
+	{
+		if (m_depthTest == (unsigned int)a_enabled)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		if (a_enabled)
+			glEnable(GL_DEPTH_TEST);
+		else
+			glDisable(GL_DEPTH_TEST);
+		m_depthTest = a_enabled;
+		++m_stats.sent;
+	}
+
+	/**
+		setDepthFunc sets the depth comparison if it isn't already set.
+
+			@param1 a_function is the comparison, such as GL_LESS.
+	*/
+	void RenderState::setDepthFunc(unsigned int a_function)
+	{
+		if (m_depthFunc == a_function)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glDepthFunc(a_function);
+		m_depthFunc = a_function;
+		++m_stats.sent;
+	}
+
+	/**
+		setColourMask turns colour writes on or off for every channel if
+			they aren't already.
+
+			@param1 a_write is whether colour is written.
+	*/
+	void RenderState::setColourMask(bool a_write)
+	{
+		if (m_colourMask == (unsigned int)a_write)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		GLboolean write = a_write ? GL_TRUE : GL_FALSE;
+		glColorMask(write, write, write, write);
+		m_colourMask = a_write;
+		++m_stats.sent;
+	}
+
+	/**
+		setReverseZ switches between GL's usual depth and reversed depth,
+			and sets the clip control, the depth clear value and the
+			depth comparison to match.
+
+			@param1 a_reverse is whether depth is reversed.
+	*/
+	void RenderState::setReverseZ(bool a_reverse)
+	{
+		m_reverseZ = a_reverse;
+		glClipControl(GL_LOWER_LEFT, a_reverse ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+		glClearDepth(getFarDepth());
+		setDepthFunc(getNearerDepthFunc());
+	}
+
+	/**
+		getNearerDepthFunc returns the comparison that passes what is
+			nearer, GL_LESS or GL_GREATER when depth is reversed.
+	*/
+	unsigned int RenderState::getNearerDepthFunc() const
+	{
+		return m_reverseZ ? GL_GREATER : GL_LESS;
+	}
+
+	/**
+		getDepthFormat returns the format scene depth targets should be
+			made with.
+	*/
+	unsigned int RenderState::getDepthFormat() const
+	{
+		return m_reverseZ ? GL_DEPTH32F_STENCIL8 : GL_DEPTH24_STENCIL8;
+	}
+
+	/**
+		onTextureDeleted forgets a deleted texture on every unit.
+
+			@param1 a_texture is the GL handle of the texture.
+	*/
+	void RenderState::onTextureDeleted(unsigned int a_texture)
+	{
+		// GL binds 0 in place of a deleted texture.
+		for (auto& texture : m_textures)
+			if (texture == a_texture)
+				texture = 0;
+	}
+
+	/**
+		onSamplerDeleted forgets a deleted sampler on every unit.
+
+			@param1 a_sampler is the GL handle of the sampler.
+	*/
+	void RenderState::onSamplerDeleted(unsigned int a_sampler)
+	{
+		// GL binds 0 in place of a deleted sampler too.
+		for (auto& sampler : m_samplers)
+			if (sampler == a_sampler)
+				sampler = 0;
+	}
+
+	/**
+		onBufferDeleted forgets a deleted buffer on every tracked target.
+
+			@param1 a_buffer is the GL handle of the buffer.
+	*/
+	void RenderState::onBufferDeleted(unsigned int a_buffer)
+	{
+		// GL binds 0 in place of a deleted buffer.
+		if (m_arrayBuffer == a_buffer)
+			m_arrayBuffer = 0;
+		if (m_indirectBuffer == a_buffer)
+			m_indirectBuffer = 0;
+
+		// The handle can be reused, so the shared vertex arrays must not
+		//	think it is still attached.
+		VertexArrays::instance().onBufferDeleted(a_buffer);
+	}
+
+	/**
+		onVertexArrayDeleted forgets a deleted vertex array.
+
+			@param1 a_vao is the GL handle of the vertex array.
+	*/
+	void RenderState::onVertexArrayDeleted(unsigned int a_vao)
+	{
+		if (m_vertexArray == a_vao)
+			m_vertexArray = 0;
+	}
+
+	/**
+		onProgramDeleted forgets a deleted program.
+
+			@param1 a_program is the GL handle of the program.
+	*/
+	void RenderState::onProgramDeleted(unsigned int a_program)
+	{
+		// A bound program stays in use until something else is bound,
+		//	so the binding is unknown from here on.
+		if (m_program == a_program)
+			m_program = UNKNOWN;
+		++m_programDeletions;
+	}
+
+	/**
+		invalidate forgets everything.
+	*/
+	void RenderState::invalidate()
+	{
+		m_program = UNKNOWN;
+		m_activeUnit = UNKNOWN;
+		for (auto& texture : m_textures)
+			texture = UNKNOWN;
+		for (auto& sampler : m_samplers)
+			sampler = UNKNOWN;
+		m_blend = UNKNOWN;
+		m_blendSource = UNKNOWN;
+		m_blendDestination = UNKNOWN;
+		m_depthMask = UNKNOWN;
+		m_vertexArray = UNKNOWN;
+		m_arrayBuffer = UNKNOWN;
+		m_indirectBuffer = UNKNOWN;
+		m_depthTest = UNKNOWN;
+		m_depthFunc = UNKNOWN;
+		m_colourMask = UNKNOWN;
+	}
+
+	/**
+		reset sets the shadow copy to the state a new context starts with,
+			without sending anything.
+	*/
+	void RenderState::reset()
+	{
+		m_program = 0;
+		m_activeUnit = 0;
+		for (auto& texture : m_textures)
+			texture = 0;
+		for (auto& sampler : m_samplers)
+			sampler = 0;
+		m_blend = 0;
+		m_blendSource = GL_ONE;
+		m_blendDestination = GL_ZERO;
+		m_depthMask = 1;
+		m_vertexArray = 0;
+		m_arrayBuffer = 0;
+		m_indirectBuffer = 0;
+		m_depthTest = 0;
+		m_depthFunc = GL_LESS;
+		m_colourMask = 1;
+	}
+}
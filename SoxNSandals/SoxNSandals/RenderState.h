@@ -0,0 +1,340 @@
+/**
+	RenderState.h
+
+	Purpose: RenderState.h is the header file for the RenderState class.
+			The RenderState class remembers what is bound in OpenGL so
+			that binds which wouldn't change anything can be skipped
+			before they reach the driver, and state can be read back
+			without asking the driver.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+namespace sns
+{
+	/**
+		The RenderState class shadows the bound program, the 2D
+			textures and samplers bound to each texture unit, the
+			vertex array, the array and draw indirect buffers,
+			blending, the depth test and write mask and the colour
+			mask. Anything that changes these must go through it, or
+			call invalidate afterwards, otherwise the shadow copy goes
+			out of date.
+
+		It starts from the state a new context has, so as long as
+			everything goes through it the driver is never asked what
+			is bound. Queries only happen after invalidate, and are
+			counted so any that sneak in show up.
+	*/
+	class RenderState
+	{
+	public:
+		// The amount of texture units that are tracked. Binds to higher
+		//	units are always sent.
+		static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+		/**
+			Counts of the calls that were sent or skipped since the last
+				resetStats.
+		*/
+		struct Stats
+		{
+			unsigned int sent;
+			unsigned int skipped;
+
+			// How many times state had to be read back from the driver.
+			unsigned int queries;
+
+			// The draw calls counted with countDraw, a multi-draw is one.
+			unsigned int draws;
+		};
+
+		/**
+			instance returns the render state of the GL context.
+		*/
+		static RenderState& instance();
+
+		/**
+			useProgram binds a shader program if it isn't already bound.
+
+				@param1 a_program is the GL handle of the program.
+		*/
+		void useProgram(unsigned int a_program);
+
+		/**
+			getProgram returns the bound program. GL is only asked when
+				the binding isn't known, such as after invalidate.
+		*/
+		unsigned int getProgram();
+
+		/**
+			bindTexture binds a 2D texture and a sampler to a texture
+				unit if they aren't already bound there. A sampler
+				overrides the texture's filtering and wrapping, so binds
+				that don't give one put the texture's own back.
+
+				@param1 a_unit is the texture unit, starting from 0.
+
+				@param2 a_texture is the GL handle of the texture, or 0.
+
+				@param3 a_sampler is the GL handle of a sampler, see
+						SamplerCache, or 0 for none.
+		*/
+		void bindTexture(unsigned int a_unit, unsigned int a_texture, unsigned int a_sampler = 0);
+
+		/**
+			bindVertexArray binds a vertex array if it isn't already bound.
+
+				@param1 a_vao is the GL handle of the vertex array, or 0.
+		*/
+		void bindVertexArray(unsigned int a_vao);
+
+		/**
+			bindBuffer binds a buffer to a target if it isn't already
+				bound there. Only GL_ARRAY_BUFFER and GL_DRAW_INDIRECT_BUFFER
+				are tracked, binds to other targets are always sent. The
+				element array buffer belongs to the vertex array, so it
+				isn't tracked either.
+
+				@param1 a_target is the buffer target, such as GL_ARRAY_BUFFER.
+
+				@param2 a_buffer is the GL handle of the buffer, or 0.
+		*/
+		void bindBuffer(unsigned int a_target, unsigned int a_buffer);
+
+		/**
+			setBlend turns blending on or off if it isn't already.
+
+				@param1 a_enabled is whether GL_BLEND is enabled.
+		*/
+		void setBlend(bool a_enabled);
+
+		/**
+			isBlendEnabled returns whether blending is on. GL is only
+				asked when it isn't known.
+		*/
+		bool isBlendEnabled();
+
+		/**
+			setBlendFunc sets the blend factors if they aren't already set.
+
+				@param1 a_source is the source factor, such as GL_SRC_ALPHA.
+
+				@param2 a_destination is the destination factor.
+		*/
+		void setBlendFunc(unsigned int a_source, unsigned int a_destination);
+
+		/**
+			getBlendFunc returns the blend factors. GL is only asked
+				when they aren't known.
+
+				@param1 a_source receives the source factor.
+
+				@param2 a_destination receives the destination factor.
+		*/
+		void getBlendFunc(unsigned int& a_source, unsigned int& a_destination);
+
+		/**
+			setDepthMask turns depth writes on or off if they aren't already.
+
+				@param1 a_write is whether depth is written.
+		*/
+		void setDepthMask(bool a_write);
+
+		/**
+			getDepthMask returns whether depth is written. GL is only
+				asked when it isn't known.
+		*/
+		bool getDepthMask();
+
+		/**
+			setDepthTest turns the depth test on or off if it isn't already.
+
+				@param1 a_enabled is whether GL_DEPTH_TEST is enabled.
+		*/
+		void setDepthTest(bool a_enabled);
+
+		/**
+			setDepthFunc sets the depth comparison if it isn't already set.
+
+				@param1 a_function is the comparison, such as GL_LESS.
+		*/
+		void setDepthFunc(unsigned int a_function);
+
+		/**
+			setColourMask turns colour writes on or off for every channel
+				if they aren't already.
+
+				@param1 a_write is whether colour is written.
+		*/
+		void setColourMask(bool a_write);
+
+		/**
+			setReverseZ switches between GL's usual depth, -1 to 1 in clip
+				space and stored 0 near to 1 far, and reversed depth, 0
+				to 1 in clip space and stored 1 near to 0 far. Float
+				depth is most precise near 0, so reversed it is spread
+				evenly from the near plane out. It sets the clip control,
+				the depth clear value and the depth comparison to match.
+
+			Needs GL 4.5. Depth targets should be made after it, with
+				getDepthFormat.
+
+				@param1 a_reverse is whether depth is reversed.
+		*/
+		void setReverseZ(bool a_reverse);
+
+		/**
+			isReverseZ returns whether depth is reversed.
+		*/
+		bool isReverseZ() const { return m_reverseZ; }
+
+		/**
+			getNearerDepthFunc returns the comparison that passes what
+				is nearer, GL_LESS or GL_GREATER when depth is reversed.
+		*/
+		unsigned int getNearerDepthFunc() const;
+
+		/**
+			getFarDepth returns the depth furthest away, what depth is
+				cleared to.
+		*/
+		float getFarDepth() const { return m_reverseZ ? 0.0f : 1.0f; }
+
+		/**
+			getDepthFormat returns the format scene depth targets should
+				be made with, a float one when depth is reversed or one
+				that matches the window's when it isn't, so they can be
+				blitted to and from it.
+		*/
+		unsigned int getDepthFormat() const;
+
+		/**
+			onTextureDeleted must be called when a texture is deleted,
+				since GL unbinds it from every unit.
+
+				@param1 a_texture is the GL handle of the texture.
+		*/
+		void onTextureDeleted(unsigned int a_texture);
+
+		/**
+			onSamplerDeleted must be called when a sampler is deleted,
+				since GL unbinds it from every unit.
+
+				@param1 a_sampler is the GL handle of the sampler.
+		*/
+		void onSamplerDeleted(unsigned int a_sampler);
+
+		/**
+			onBufferDeleted must be called when a buffer is deleted,
+				since GL unbinds it from every target. It tells the
+				VertexArrays too.
+
+				@param1 a_buffer is the GL handle of the buffer.
+		*/
+		void onBufferDeleted(unsigned int a_buffer);
+
+		/**
+			onVertexArrayDeleted must be called when a vertex array is
+				deleted, since GL binds 0 in its place.
+
+				@param1 a_vao is the GL handle of the vertex array.
+		*/
+		void onVertexArrayDeleted(unsigned int a_vao);
+
+		/**
+			onProgramDeleted must be called when a program is deleted.
+				Handles can be reused, so anything cached per program
+				should be thrown away when getProgramDeletions changes.
+
+				@param1 a_program is the GL handle of the program.
+		*/
+		void onProgramDeleted(unsigned int a_program);
+
+		/**
+			getProgramDeletions returns how many programs have been deleted.
+		*/
+		unsigned int getProgramDeletions() const { return m_programDeletions; }
+
+		/**
+			invalidate forgets everything, for when GL has been used directly.
+		*/
+		void invalidate();
+
+		/**
+			reset sets the shadow copy to the state a new context starts
+				with, without sending anything.
+		*/
+		void reset();
+
+		/**
+			getStats returns how many calls were sent and skipped.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+		/**
+			countDraw counts a draw call, so passes can report how many
+				they made. Call it beside each glDraw.
+		*/
+		void countDraw() { ++m_stats.draws; }
+
+		/**
+			resetStats sets the counts back to zero, usually once a frame.
+		*/
+		void resetStats() { m_stats = {}; }
+
+	private:
+
+		RenderState();
+
+		RenderState(const RenderState&) = delete;
+		RenderState& operator=(const RenderState&) = delete;
+
+		// The bound program. ~0 means unknown.
+		unsigned int m_program;
+
+		// The active texture unit. ~0 means unknown.
+		unsigned int m_activeUnit;
+
+		// The texture bound to each unit. ~0 means unknown.
+		unsigned int m_textures[MAX_TEXTURE_UNITS];
+
+		// The sampler bound to each unit. ~0 means unknown.
+		unsigned int m_samplers[MAX_TEXTURE_UNITS];
+
+		// Whether GL_BLEND is enabled, 0 or 1. ~0 means unknown.
+		unsigned int m_blend;
+
+		// The blend factors. ~0 means unknown.
+		unsigned int m_blendSource;
+		unsigned int m_blendDestination;
+
+		// Whether depth is written, 0 or 1. ~0 means unknown.
+		unsigned int m_depthMask;
+
+		// The bound vertex array, array buffer and draw indirect buffer.
+		//	~0 means unknown.
+		unsigned int m_vertexArray;
+		unsigned int m_arrayBuffer;
+		unsigned int m_indirectBuffer;
+
+		// Whether GL_DEPTH_TEST is enabled, 0 or 1, and the depth
+		//	comparison. ~0 means unknown.
+		unsigned int m_depthTest;
+		unsigned int m_depthFunc;
+
+		// Whether colour is written, 0 or 1. ~0 means unknown.
+		unsigned int m_colourMask;
+
+		// How many programs have been deleted.
+		unsigned int m_programDeletions;
+
+		// Whether depth is reversed. This is set rather than shadowed,
+		//	so invalidate and reset leave it alone.
+		bool m_reverseZ;
+
+		// Calls sent and skipped.
+		Stats m_stats;
+	};
+}
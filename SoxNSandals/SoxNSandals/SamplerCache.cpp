@@ -0,0 +1,116 @@
+/**
+	SamplerCache.cpp
+
+	Purpose: SamplerCache.cpp is the source file for the SamplerCache
+			class. The SamplerCache keeps one GL sampler object for
+			each way textures are filtered and wrapped, so how they
+			are sampled is set once for everything drawn with it
+			rather than baked into every texture.
+
+	@author Nathan Nette
+*/
+#include "SamplerCache.h"
+#include "RenderState.h"
+#include "Texture.h"
+#include "gl_core_4_5.h"
+
+// core in gl 4.6, before that an extension every desktop driver exposes
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+
+namespace sns
+{
+	SamplerCache& SamplerCache::instance()
+	{
+		static SamplerCache cache;
+		return cache;
+	}
+
+	SamplerCache::SamplerCache()
+	{
+	}
+
+	/**
+		get returns the sampler for a description, making it if no
+			sampler has it yet.
+
+			@param1 a_description is how it samples.
+
+			@return the GL handle of the sampler.
+	*/
+	unsigned int SamplerCache::get(const Description& a_description)
+	{
+		for (const Entry& entry : m_entries)
+		{
+			if (entry.description == a_description)
+				return entry.sampler;
+		}
+
+		unsigned int sampler = 0;
+		glGenSamplers(1, &sampler);
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, a_description.minFilter);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, a_description.magFilter);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, a_description.wrapS);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, a_description.wrapT);
+		m_entries.push_back({ a_description, sampler, 1.0f });
+		if (a_description.anisotropic)
+			applyAnisotropy(m_entries.back());
+		return sampler;
+	}
+
+	/**
+		getMaterialSampler returns the sampler the meshes' materials are
+			drawn with, trilinear, anisotropic and repeating.
+	*/
+	unsigned int SamplerCache::getMaterialSampler()
+	{
+		static const Description MATERIAL = { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT, true };
+		return get(MATERIAL);
+	}
+
+	/**
+		setAnisotropy sets the anisotropic filtering of the anisotropic
+			samplers, and of textures uploaded after it.
+
+			@param1 a_anisotropy is how many samples, 1 for none.
+	*/
+	void SamplerCache::setAnisotropy(float a_anisotropy)
+	{
+		aie::Texture::setAnisotropy(a_anisotropy);
+		for (Entry& entry : m_entries)
+		{
+			if (entry.description.anisotropic)
+				applyAnisotropy(entry);
+		}
+	}
+
+	/**
+		destroy deletes every sampler, before the context is.
+	*/
+	void SamplerCache::destroy()
+	{
+		for (const Entry& entry : m_entries)
+		{
+			glDeleteSamplers(1, &entry.sampler);
+			RenderState::instance().onSamplerDeleted(entry.sampler);
+		}
+		m_entries.clear();
+	}
+
+	/**
+		applyAnisotropy sets a sampler's anisotropy to what the textures
+			use, limited to what the driver supports. One that never had
+			any is left alone, as drivers without it don't take the
+			parameter.
+
+			@param1 a_entry is the sampler.
+	*/
+	void SamplerCache::applyAnisotropy(Entry& a_entry)
+	{
+		float anisotropy = aie::Texture::getAnisotropy();
+		if (anisotropy > 1.0f || a_entry.anisotropy > 1.0f)
+			glSamplerParameterf(a_entry.sampler, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+		a_entry.anisotropy = anisotropy;
+	}
+}
@@ -0,0 +1,116 @@
+/**
+	SamplerCache.h
+
+	Purpose: SamplerCache.h is the header file for the SamplerCache
+			class. The SamplerCache keeps one GL sampler object for
+			each way textures are filtered and wrapped, so how they
+			are sampled is set once for everything drawn with it
+			rather than baked into every texture.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <vector>
+
+namespace sns
+{
+	/**
+		The SamplerCache class makes a sampler object the first time a
+			Description is asked for and hands back the same one every
+			time after. There are only ever a few of them, so they are
+			found by going through the list.
+
+		Samplers that are anisotropic follow setAnisotropy. Changing it
+			changes those samplers in place, so everything drawn with
+			them is filtered the new way from the next draw on, without
+			touching a texture.
+
+		A sampler bound to a unit overrides the filtering and wrapping
+			of whatever texture is bound there, so they are bound
+			through RenderState::bindTexture, which binds 0, the
+			texture's own state, for anyone who doesn't ask for one.
+			Everything but setAnisotropy before a context exists must
+			be called on the context thread.
+	*/
+	class SamplerCache
+	{
+	public:
+		/**
+			How a sampler filters and wraps.
+		*/
+		struct Description
+		{
+			unsigned int minFilter;
+			unsigned int magFilter;
+			unsigned int wrapS;
+			unsigned int wrapT;
+
+			// Whether it takes the anisotropy from setAnisotropy. Only
+			//	worth it with a mipmapped min filter.
+			bool anisotropic;
+
+			bool operator==(const Description& a_other) const
+			{
+				return minFilter == a_other.minFilter && magFilter == a_other.magFilter &&
+					wrapS == a_other.wrapS && wrapT == a_other.wrapT && anisotropic == a_other.anisotropic;
+			}
+		};
+
+		static SamplerCache& instance();
+
+		SamplerCache(const SamplerCache&) = delete;
+		SamplerCache& operator=(const SamplerCache&) = delete;
+
+		/**
+			get returns the sampler for a description, making it if no
+				sampler has it yet.
+
+				@param1 a_description is how it samples.
+
+				@return the GL handle of the sampler.
+		*/
+		unsigned int get(const Description& a_description);
+
+		/**
+			getMaterialSampler returns the sampler the meshes' materials
+				are drawn with, trilinear, anisotropic and repeating.
+		*/
+		unsigned int getMaterialSampler();
+
+		/**
+			setAnisotropy sets the anisotropic filtering of the
+				anisotropic samplers, and of textures uploaded after it,
+				see aie::Texture::setAnisotropy.
+
+				@param1 a_anisotropy is how many samples, 1 for none.
+		*/
+		void setAnisotropy(float a_anisotropy);
+
+		/**
+			getSamplerCount returns how many samplers have been made.
+		*/
+		unsigned int getSamplerCount() const { return (unsigned int)m_entries.size(); }
+
+		/**
+			destroy deletes every sampler, before the context is.
+		*/
+		void destroy();
+
+	private:
+		SamplerCache();
+
+		struct Entry
+		{
+			Description description;
+			unsigned int sampler;
+
+			// The anisotropy it was last given.
+			float anisotropy;
+		};
+
+		// Sets a sampler's anisotropy to what the textures use.
+		static void applyAnisotropy(Entry& a_entry);
+
+		std::vector<Entry> m_entries;
+	};
+}
@@ -0,0 +1,794 @@
+/**
+	SceneDescription.cpp
+
+	Purpose: SceneDescription.cpp is the source file for the
+			SceneDescription class. The SceneDescription is what a scene
+			is made of, read from a file instead of written into the
+			Application, so content is added without recompiling.
+
+	@author Nathan Nette
+*/
+#include "SceneDescription.h"
+#include "FileSystem.h"
+#include "Json.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+	using sns::JsonValue;
+	using sns::JsonReader;
+
+	// Reading a member that isn't there, or is the wrong type, gives the
+	//	default, so a scene only has to say what isn't usual.
+	float getNumber(const JsonValue& a_object, const char* a_name, float a_default)
+	{
+		const JsonValue* value = a_object.find(a_name);
+		return value != nullptr && value->type == JsonValue::NUMBER ? (float)value->number : a_default;
+	}
+
+	bool getBool(const JsonValue& a_object, const char* a_name, bool a_default)
+	{
+		const JsonValue* value = a_object.find(a_name);
+		return value != nullptr && value->type == JsonValue::BOOLEAN ? value->boolean : a_default;
+	}
+
+	std::string getString(const JsonValue& a_object, const char* a_name)
+	{
+		const JsonValue* value = a_object.find(a_name);
+		return value != nullptr && value->type == JsonValue::STRING ? value->string : std::string();
+	}
+
+	// Reads an array of numbers into the first count floats.
+	void getFloats(const JsonValue& a_object, const char* a_name, float* a_floats, unsigned int a_count)
+	{
+		const JsonValue* value = a_object.find(a_name);
+		if (value == nullptr || value->type != JsonValue::ARRAY)
+			return;
+		for (unsigned int i = 0; i < a_count && i < value->items.size(); ++i)
+		{
+			if (value->items[i].type == JsonValue::NUMBER)
+				a_floats[i] = (float)value->items[i].number;
+		}
+	}
+
+	template <typename Vector>
+	Vector getVector(const JsonValue& a_object, const char* a_name, const Vector& a_default)
+	{
+		Vector vector = a_default;
+		getFloats(a_object, a_name, &vector[0], (unsigned int)Vector::length());
+		return vector;
+	}
+
+	/**
+		An object's transform is either its 16 numbers, column by column,
+			or a position, a rotation as degrees around x, y and z, turned
+			around y first, and a scale that is one number or three.
+	*/
+	glm::mat4 getTransform(const JsonValue& a_object)
+	{
+		glm::mat4 transform(1);
+		const JsonValue* matrix = a_object.find("transform");
+		if (matrix != nullptr)
+		{
+			getFloats(a_object, "transform", &transform[0][0], 16);
+			return transform;
+		}
+
+		glm::vec3 rotation = glm::radians(getVector(a_object, "rotation", glm::vec3(0)));
+		glm::vec3 scale(getNumber(a_object, "scale", 1.0f));
+		scale = getVector(a_object, "scale", scale);
+
+		transform = glm::translate(transform, getVector(a_object, "position", glm::vec3(0)));
+		transform = glm::rotate(transform, rotation.y, glm::vec3(0, 1, 0));
+		transform = glm::rotate(transform, rotation.x, glm::vec3(1, 0, 0));
+		transform = glm::rotate(transform, rotation.z, glm::vec3(0, 0, 1));
+		return glm::scale(transform, scale);
+	}
+
+	/**
+		A mesh in the compiled form, its name, file and virtual texture as
+			offsets into the strings.
+	*/
+	struct CompiledMesh
+	{
+		uint32_t material;
+		uint32_t name;
+		uint32_t filename;
+		uint32_t lightmapResolution;
+		uint32_t virtualTexture;
+	};
+
+	/**
+		A character in the compiled form, its file and clips as offsets
+			into the strings.
+	*/
+	struct CompiledCharacter
+	{
+		uint32_t filename;
+		uint32_t clip;
+		uint32_t blendClip;
+		float blend;
+		float speed;
+		glm::mat4 transform;
+	};
+
+	/**
+		A layer of foliage in the compiled form, its files as offsets
+			into the strings.
+	*/
+	struct CompiledFoliage
+	{
+		uint32_t filename;
+		uint32_t densityMap;
+		glm::vec3 position;
+		float size;
+		float innerRadius;
+		glm::vec2 scale;
+		float fadeStart;
+		float fadeEnd;
+		float drawDistance;
+		uint32_t count;
+		uint32_t seed;
+	};
+
+	/**
+		A crowd in the compiled form, its file and clip as offsets into
+			the strings.
+	*/
+	struct CompiledCrowd
+	{
+		uint32_t filename;
+		uint32_t clip;
+		glm::vec3 position;
+		float size;
+		glm::vec2 scale;
+		glm::vec2 speed;
+		float drawDistance;
+		uint32_t frames;
+		uint32_t count;
+		uint32_t seed;
+	};
+
+	/**
+		A decal in the compiled form, its texture as an offset into the
+			strings.
+	*/
+	struct CompiledDecal
+	{
+		uint32_t texture;
+		float opacity;
+		glm::mat4 transform;
+	};
+
+	/**
+		The terrain in the compiled form, its heightmap as an offset into
+			the strings.
+	*/
+	struct CompiledTerrain
+	{
+		uint32_t heightmap;
+		glm::vec3 position;
+		float size;
+		float height;
+		float flatRadius;
+		uint32_t patches;
+		uint32_t seed;
+	};
+}
+
+namespace sns
+{
+	SceneDescription::SceneDescription()
+	{
+		clear();
+	}
+
+	/**
+		clear empties the scene.
+	*/
+	void SceneDescription::clear()
+	{
+		m_meshes.clear();
+		m_objects.clear();
+		m_lights.clear();
+		m_emitters.clear();
+		m_cells.clear();
+		m_characters.clear();
+		m_foliage.clear();
+		m_crowds.clear();
+		m_decals.clear();
+		m_streaming.budgetMB = 256.0f;
+		m_streaming.loadDistance = 500.0f;
+		m_streaming.unloadDistance = 600.0f;
+		m_lightScatter = {};
+		m_sun.diffuse = glm::vec3(1);
+		m_sun.specular = glm::vec3(1);
+		m_sun.ambient = glm::vec3(0.25f);
+		m_terrain = Terrain();
+		m_ocean = Ocean();
+		m_probes = Probes();
+	}
+
+	/**
+		load reads a scene, compiled if the file starts with MAGIC and
+			JSON otherwise.
+
+			@param1 a_filename is the scene file.
+
+			@return false if it couldn't be read, any error is printed.
+	*/
+	bool SceneDescription::load(const char* a_filename)
+	{
+		clear();
+
+		FileView file;
+		if (FileSystem::instance().open(a_filename, file) == false)
+		{
+			printf("Failed to read scene %s\n", a_filename);
+			return false;
+		}
+
+		uint32_t magic = 0;
+		if (file.getSize() >= sizeof(magic))
+			memcpy(&magic, file.getData(), sizeof(magic));
+
+		bool read = magic == MAGIC ?
+			readCompiled(file.getData(), file.getSize()) :
+			readJson((const char*)file.getData(), file.getSize(), a_filename);
+		if (read == false)
+		{
+			clear();
+			return false;
+		}
+
+		printf("Scene %s: %u meshes, %u objects, %u lights, %u emitters, %u cells, %u characters, %u foliage layers, %u crowds, %u decals\n",
+			a_filename,
+			(unsigned int)m_meshes.size(), (unsigned int)m_objects.size(),
+			(unsigned int)m_lights.size() + m_lightScatter.count, (unsigned int)m_emitters.size(),
+			(unsigned int)m_cells.size(), (unsigned int)m_characters.size(), (unsigned int)m_foliage.size(),
+			(unsigned int)m_crowds.size(), (unsigned int)m_decals.size());
+		return true;
+	}
+
+	/**
+		write writes the scene in its compiled form: the header, then each
+			list as it is held, then the strings.
+
+			@param1 a_filename is the file to write.
+
+			@return false if it couldn't be written.
+	*/
+	bool SceneDescription::write(const char* a_filename) const
+	{
+		std::vector<CompiledMesh> meshes;
+		std::vector<char> strings;
+		auto addString = [&strings](const std::string& a_string)
+		{
+			uint32_t offset = (uint32_t)strings.size();
+			strings.insert(strings.end(), a_string.c_str(), a_string.c_str() + a_string.size() + 1);
+			return offset;
+		};
+		for (const Mesh& mesh : m_meshes)
+			meshes.push_back({ mesh.material, addString(mesh.name), addString(mesh.filename), mesh.lightmapResolution,
+				addString(mesh.virtualTexture) });
+		std::vector<CompiledCharacter> characters;
+		for (const Character& character : m_characters)
+		{
+			characters.push_back({ addString(character.filename), addString(character.clip),
+				addString(character.blendClip), character.blend, character.speed, character.transform });
+		}
+		std::vector<CompiledFoliage> foliage;
+		for (const Foliage& layer : m_foliage)
+		{
+			foliage.push_back({ addString(layer.filename), addString(layer.densityMap), layer.position, layer.size,
+				layer.innerRadius, layer.scale, layer.fadeStart, layer.fadeEnd, layer.drawDistance, layer.count,
+				layer.seed });
+		}
+		std::vector<CompiledCrowd> crowds;
+		for (const Crowd& crowd : m_crowds)
+		{
+			crowds.push_back({ addString(crowd.filename), addString(crowd.clip), crowd.position, crowd.size,
+				crowd.scale, crowd.speed, crowd.drawDistance, crowd.frames, crowd.count, crowd.seed });
+		}
+		std::vector<CompiledDecal> decals;
+		for (const Decal& decal : m_decals)
+			decals.push_back({ addString(decal.texture), decal.opacity, decal.transform });
+		CompiledTerrain terrain = { addString(m_terrain.heightmap), m_terrain.position, m_terrain.size,
+			m_terrain.height, m_terrain.flatRadius, m_terrain.patches, m_terrain.seed };
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_filename, "wb");
+		if (file == nullptr)
+		{
+			printf("Failed to write scene %s\n", a_filename);
+			return false;
+		}
+
+		Header header = { MAGIC, VERSION, (uint32_t)m_meshes.size(), (uint32_t)m_objects.size(),
+			(uint32_t)m_lights.size(), (uint32_t)m_emitters.size(), (uint32_t)m_cells.size(),
+			(uint32_t)characters.size(), (uint32_t)foliage.size(), (uint32_t)crowds.size(),
+			(uint32_t)decals.size(), (uint32_t)strings.size() };
+		bool written = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+			fwrite(meshes.data(), sizeof(CompiledMesh), meshes.size(), file) == meshes.size() &&
+			fwrite(m_objects.data(), sizeof(Object), m_objects.size(), file) == m_objects.size() &&
+			fwrite(m_lights.data(), sizeof(Light), m_lights.size(), file) == m_lights.size() &&
+			fwrite(m_emitters.data(), sizeof(Emitter), m_emitters.size(), file) == m_emitters.size() &&
+			fwrite(m_cells.data(), sizeof(Cell), m_cells.size(), file) == m_cells.size() &&
+			fwrite(characters.data(), sizeof(CompiledCharacter), characters.size(), file) == characters.size() &&
+			fwrite(foliage.data(), sizeof(CompiledFoliage), foliage.size(), file) == foliage.size() &&
+			fwrite(crowds.data(), sizeof(CompiledCrowd), crowds.size(), file) == crowds.size() &&
+			fwrite(decals.data(), sizeof(CompiledDecal), decals.size(), file) == decals.size() &&
+			fwrite(&m_streaming, sizeof(Streaming), 1, file) == 1 &&
+			fwrite(&m_lightScatter, sizeof(LightScatter), 1, file) == 1 &&
+			fwrite(&m_sun, sizeof(Sun), 1, file) == 1 &&
+			fwrite(&terrain, sizeof(CompiledTerrain), 1, file) == 1 &&
+			fwrite(&m_ocean, sizeof(Ocean), 1, file) == 1 &&
+			fwrite(&m_probes, sizeof(Probes), 1, file) == 1 &&
+			fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+		fclose(file);
+
+		if (written == false)
+		{
+			printf("Failed to write scene %s\n", a_filename);
+			return false;
+		}
+		printf("Compiled scene %s\n", a_filename);
+		return true;
+	}
+
+	/**
+		readCompiled reads the compiled form. Every list is copied out as
+			it is, so a scene of thousands of objects loads in one pass
+			over the file.
+
+			@param1 a_data is the file.
+
+			@param2 a_size is its size in bytes.
+	*/
+	bool SceneDescription::readCompiled(const unsigned char* a_data, size_t a_size)
+	{
+		Header header = {};
+		if (a_size >= sizeof(Header))
+			memcpy(&header, a_data, sizeof(Header));
+
+		size_t size = sizeof(Header) + header.meshCount * sizeof(CompiledMesh) +
+			header.objectCount * sizeof(Object) + header.lightCount * sizeof(Light) +
+			header.emitterCount * sizeof(Emitter) + header.cellCount * sizeof(Cell) +
+			header.characterCount * sizeof(CompiledCharacter) + header.foliageCount * sizeof(CompiledFoliage) +
+			header.crowdCount * sizeof(CompiledCrowd) + header.decalCount * sizeof(CompiledDecal) + sizeof(Streaming) + sizeof(LightScatter) + sizeof(Sun) + sizeof(CompiledTerrain) + sizeof(Ocean) +
+			sizeof(Probes) +
+			header.stringBytes;
+		if (header.version != VERSION || a_size < size || header.stringBytes == 0)
+		{
+			printf("Scene isn't a version %u compiled scene\n", VERSION);
+			return false;
+		}
+
+		const unsigned char* data = a_data + sizeof(Header);
+		auto copy = [&data](void* a_destination, size_t a_bytes)
+		{
+			memcpy(a_destination, data, a_bytes);
+			data += a_bytes;
+		};
+
+		std::vector<CompiledMesh> meshes(header.meshCount);
+		m_objects.resize(header.objectCount);
+		m_lights.resize(header.lightCount);
+		m_emitters.resize(header.emitterCount);
+		m_cells.resize(header.cellCount);
+		std::vector<CompiledCharacter> characters(header.characterCount);
+		std::vector<CompiledFoliage> foliage(header.foliageCount);
+		std::vector<CompiledCrowd> crowds(header.crowdCount);
+		std::vector<CompiledDecal> decals(header.decalCount);
+		copy(meshes.data(), meshes.size() * sizeof(CompiledMesh));
+		copy(m_objects.data(), m_objects.size() * sizeof(Object));
+		copy(m_lights.data(), m_lights.size() * sizeof(Light));
+		copy(m_emitters.data(), m_emitters.size() * sizeof(Emitter));
+		copy(m_cells.data(), m_cells.size() * sizeof(Cell));
+		copy(characters.data(), characters.size() * sizeof(CompiledCharacter));
+		copy(foliage.data(), foliage.size() * sizeof(CompiledFoliage));
+		copy(crowds.data(), crowds.size() * sizeof(CompiledCrowd));
+		copy(decals.data(), decals.size() * sizeof(CompiledDecal));
+		copy(&m_streaming, sizeof(Streaming));
+		copy(&m_lightScatter, sizeof(LightScatter));
+		copy(&m_sun, sizeof(Sun));
+		CompiledTerrain terrain;
+		copy(&terrain, sizeof(CompiledTerrain));
+		copy(&m_ocean, sizeof(Ocean));
+		copy(&m_probes, sizeof(Probes));
+		if (m_probes.reflectionCount > MAX_REFLECTION_PROBES)
+			return false;
+
+		// The strings end with a 0, so one past the end can't be read.
+		const char* strings = (const char*)data;
+		if (strings[header.stringBytes - 1] != 0 || terrain.heightmap >= header.stringBytes)
+			return false;
+		m_terrain.heightmap = strings + terrain.heightmap;
+		m_terrain.position = terrain.position;
+		m_terrain.size = terrain.size;
+		m_terrain.height = terrain.height;
+		m_terrain.flatRadius = terrain.flatRadius;
+		m_terrain.patches = terrain.patches;
+		m_terrain.seed = terrain.seed;
+		for (const CompiledMesh& compiled : meshes)
+		{
+			if (compiled.name >= header.stringBytes || compiled.filename >= header.stringBytes ||
+				compiled.virtualTexture >= header.stringBytes)
+				return false;
+			m_meshes.push_back({ strings + compiled.name, strings + compiled.filename, compiled.material,
+				compiled.lightmapResolution, strings + compiled.virtualTexture });
+		}
+		for (const CompiledCharacter& compiled : characters)
+		{
+			if (compiled.filename >= header.stringBytes || compiled.clip >= header.stringBytes ||
+				compiled.blendClip >= header.stringBytes)
+				return false;
+			m_characters.push_back({ strings + compiled.filename, strings + compiled.clip,
+				strings + compiled.blendClip, compiled.blend, compiled.speed, compiled.transform });
+		}
+		for (const CompiledFoliage& compiled : foliage)
+		{
+			if (compiled.filename >= header.stringBytes || compiled.densityMap >= header.stringBytes)
+				return false;
+			m_foliage.push_back({ strings + compiled.filename, strings + compiled.densityMap, compiled.position,
+				compiled.size, compiled.innerRadius, compiled.scale, compiled.fadeStart, compiled.fadeEnd,
+				compiled.drawDistance, compiled.count, compiled.seed });
+		}
+		for (const CompiledCrowd& compiled : crowds)
+		{
+			if (compiled.filename >= header.stringBytes || compiled.clip >= header.stringBytes)
+				return false;
+			m_crowds.push_back({ strings + compiled.filename, strings + compiled.clip, compiled.position,
+				compiled.size, compiled.scale, compiled.speed, compiled.drawDistance, compiled.frames,
+				compiled.count, compiled.seed });
+		}
+		for (const CompiledDecal& compiled : decals)
+		{
+			if (compiled.texture >= header.stringBytes)
+				return false;
+			m_decals.push_back({ strings + compiled.texture, compiled.opacity, compiled.transform });
+		}
+
+		for (const Object& object : m_objects)
+		{
+			if (object.mesh >= m_meshes.size() || (object.cell != NO_CELL && object.cell >= m_cells.size()))
+				return false;
+		}
+		return true;
+	}
+
+	/**
+		readJson reads the authoring form. Objects name their mesh and
+			cell, which are turned into their indices here.
+
+			@param1 a_text is the file.
+
+			@param2 a_size is its size in bytes.
+
+			@param3 a_filename is the file's name, for errors.
+	*/
+	bool SceneDescription::readJson(const char* a_text, size_t a_size, const char* a_filename)
+	{
+		JsonValue root;
+		JsonReader reader(a_text, a_size);
+		if (reader.read(root) == false)
+		{
+			printf("%s(%u): %s\n", a_filename, reader.getLine(), reader.getError().c_str());
+			return false;
+		}
+		if (root.type != JsonValue::OBJECT)
+		{
+			printf("%s: a scene is an object\n", a_filename);
+			return false;
+		}
+
+		const JsonValue* sun = root.find("sun");
+		if (sun != nullptr)
+		{
+			m_sun.diffuse = getVector(*sun, "diffuse", m_sun.diffuse);
+			m_sun.specular = getVector(*sun, "specular", m_sun.specular);
+			m_sun.ambient = getVector(*sun, "ambient", m_sun.ambient);
+		}
+
+		const JsonValue* meshes = root.find("meshes");
+		for (size_t i = 0; meshes != nullptr && i < meshes->items.size(); ++i)
+		{
+			const JsonValue& value = meshes->items[i];
+			Mesh mesh;
+			mesh.name = getString(value, "name");
+			mesh.filename = getString(value, "file");
+			mesh.material = 0;
+			mesh.lightmapResolution = (uint32_t)getNumber(value, "lightmap", 0.0f);
+			mesh.virtualTexture = getString(value, "virtualTexture");
+			if (mesh.filename.empty())
+			{
+				printf("%s: mesh %u has no file\n", a_filename, (unsigned int)i);
+				return false;
+			}
+
+			const JsonValue* material = value.find("material");
+			if (material != nullptr)
+			{
+				if (getBool(*material, "diffuseMap", false))
+					mesh.material |= MATERIAL_DIFFUSE_MAP;
+				if (getBool(*material, "normalMap", false))
+					mesh.material |= MATERIAL_NORMAL_MAP;
+				if (getBool(*material, "alphaTested", false))
+					mesh.material |= MATERIAL_ALPHA_TESTED;
+				mesh.material |= (uint32_t)getNumber(*material, "lights", 0.0f) << MATERIAL_LIGHT_COUNT_SHIFT;
+			}
+			m_meshes.push_back(mesh);
+		}
+
+		// The cells are read before the objects, which name them.
+		std::vector<std::string> cellNames;
+		const JsonValue* cells = root.find("cells");
+		for (size_t i = 0; cells != nullptr && i < cells->items.size(); ++i)
+		{
+			const JsonValue& value = cells->items[i];
+			Cell cell;
+			cell.min = getVector(value, "min", glm::vec3(0));
+			cell.max = getVector(value, "max", glm::vec3(0));
+			cellNames.push_back(getString(value, "name"));
+			m_cells.push_back(cell);
+		}
+
+		const JsonValue* streaming = root.find("streaming");
+		if (streaming != nullptr)
+		{
+			m_streaming.budgetMB = getNumber(*streaming, "budgetMB", m_streaming.budgetMB);
+			m_streaming.loadDistance = getNumber(*streaming, "loadDistance", m_streaming.loadDistance);
+			m_streaming.unloadDistance = glm::max(getNumber(*streaming, "unloadDistance",
+				m_streaming.loadDistance * 1.2f), m_streaming.loadDistance);
+		}
+
+		const JsonValue* objects = root.find("objects");
+		for (size_t i = 0; objects != nullptr && i < objects->items.size(); ++i)
+		{
+			const JsonValue& value = objects->items[i];
+			std::string name = getString(value, "mesh");
+
+			Object object;
+			object.mesh = (uint32_t)m_meshes.size();
+			for (size_t j = 0; j < m_meshes.size(); ++j)
+			{
+				if (m_meshes[j].name == name)
+					object.mesh = (uint32_t)j;
+			}
+			if (object.mesh == m_meshes.size())
+			{
+				printf("%s: object %u places mesh \"%s\", which isn't in the scene\n", a_filename,
+					(unsigned int)i, name.c_str());
+				return false;
+			}
+
+			object.cell = NO_CELL;
+			std::string cell = getString(value, "cell");
+			if (cell.empty() == false)
+			{
+				for (size_t j = 0; j < cellNames.size(); ++j)
+				{
+					if (cellNames[j] == cell)
+						object.cell = (uint32_t)j;
+				}
+				if (object.cell == NO_CELL)
+				{
+					printf("%s: object %u is in cell \"%s\", which isn't in the scene\n", a_filename,
+						(unsigned int)i, cell.c_str());
+					return false;
+				}
+			}
+
+			object.flags = getBool(value, "occluder", false) ? OBJECT_OCCLUDER : 0;
+			if (getBool(value, "cloth", false))
+				object.flags |= OBJECT_CLOTH;
+			if (getBool(value, "transparent", false))
+				object.flags |= OBJECT_TRANSPARENT;
+			object.transform = getTransform(value);
+			m_objects.push_back(object);
+		}
+
+		const JsonValue* lights = root.find("lights");
+		for (size_t i = 0; lights != nullptr && i < lights->items.size(); ++i)
+		{
+			const JsonValue& value = lights->items[i];
+			Light light;
+			light.position = getVector(value, "position", glm::vec3(0));
+			light.range = getNumber(value, "range", 200.0f);
+			light.colour = getVector(value, "colour", glm::vec3(1));
+			light.direction = glm::normalize(getVector(value, "direction", glm::vec3(0, -1, 0)));
+			float angle = getNumber(value, "spotAngle", 0.0f);
+			light.cosine = angle > 0.0f ? glm::cos(glm::radians(angle)) : -1.0f;
+			m_lights.push_back(light);
+		}
+
+		const JsonValue* decals = root.find("decals");
+		for (size_t i = 0; decals != nullptr && i < decals->items.size(); ++i)
+		{
+			const JsonValue& value = decals->items[i];
+			Decal decal;
+			decal.texture = getString(value, "texture");
+			decal.opacity = getNumber(value, "opacity", 1.0f);
+			decal.transform = getTransform(value);
+			if (decal.texture.empty())
+			{
+				printf("%s: decal %u has no texture\n", a_filename, (unsigned int)i);
+				return false;
+			}
+			m_decals.push_back(decal);
+		}
+
+		const JsonValue* scatter = root.find("scatteredLights");
+		if (scatter != nullptr)
+		{
+			m_lightScatter.count = (uint32_t)getNumber(*scatter, "count", 0.0f);
+			m_lightScatter.seed = (uint32_t)getNumber(*scatter, "seed", 0.0f);
+			m_lightScatter.spotEvery = (uint32_t)getNumber(*scatter, "spotEvery", 0.0f);
+			m_lightScatter.min = getVector(*scatter, "min", glm::vec3(0));
+			m_lightScatter.max = getVector(*scatter, "max", glm::vec3(0));
+			m_lightScatter.range = getVector(*scatter, "range", glm::vec2(200.0f));
+			m_lightScatter.colour = getVector(*scatter, "colour", glm::vec2(1.0f));
+			m_lightScatter.spotAngle = getVector(*scatter, "spotAngle", glm::vec2(30.0f));
+		}
+
+		const JsonValue* emitters = root.find("emitters");
+		for (size_t i = 0; emitters != nullptr && i < emitters->items.size(); ++i)
+		{
+			const JsonValue& value = emitters->items[i];
+			Emitter emitter;
+			emitter.position = getVector(value, "position", glm::vec3(0));
+			emitter.maxParticles = (uint32_t)getNumber(value, "maxParticles", 1000.0f);
+			emitter.emitRate = (uint32_t)getNumber(value, "emitRate", 500.0f);
+			emitter.seed = (uint32_t)getNumber(value, "seed", 0.0f);
+			emitter.lifetime = getVector(value, "lifetime", glm::vec2(0.1f, 1.0f));
+			emitter.velocity = getVector(value, "velocity", glm::vec2(1.0f, 5.0f));
+			emitter.size = getVector(value, "size", glm::vec2(1.0f, 0.1f));
+			emitter.startColour = getVector(value, "startColour", glm::vec4(1, 0, 0, 1));
+			emitter.endColour = getVector(value, "endColour", glm::vec4(1, 1, 0, 1));
+			emitter.gravity = getVector(value, "gravity", glm::vec3(0));
+			emitter.drag = getNumber(value, "drag", 0.0f);
+			emitter.curlNoise = getVector(value, "curlNoise", glm::vec3(0, 1, 0));
+			emitter.prewarm = getNumber(value, "prewarm", 0.0f);
+			m_emitters.push_back(emitter);
+		}
+
+		const JsonValue* characters = root.find("characters");
+		for (size_t i = 0; characters != nullptr && i < characters->items.size(); ++i)
+		{
+			const JsonValue& value = characters->items[i];
+			Character character;
+			character.filename = getString(value, "file");
+			character.clip = getString(value, "clip");
+			character.blendClip = getString(value, "blendClip");
+			character.blend = getNumber(value, "blend", 0.0f);
+			character.speed = getNumber(value, "speed", 1.0f);
+			character.transform = getTransform(value);
+			if (character.filename.empty())
+			{
+				printf("%s: character %u has no file\n", a_filename, (unsigned int)i);
+				return false;
+			}
+			m_characters.push_back(character);
+		}
+
+		const JsonValue* foliage = root.find("foliage");
+		for (size_t i = 0; foliage != nullptr && i < foliage->items.size(); ++i)
+		{
+			const JsonValue& value = foliage->items[i];
+			Foliage layer;
+			layer.filename = getString(value, "file");
+			layer.densityMap = getString(value, "densityMap");
+			layer.position = getVector(value, "position", glm::vec3(0));
+			layer.size = getNumber(value, "size", 2000.0f);
+			layer.innerRadius = getNumber(value, "innerRadius", 0.0f);
+			layer.scale = glm::vec2(getNumber(value, "scale", 1.0f));
+			layer.scale = getVector(value, "scale", layer.scale);
+			layer.fadeStart = getNumber(value, "fadeStart", 600.0f);
+			layer.fadeEnd = getNumber(value, "fadeEnd", 800.0f);
+			layer.drawDistance = getNumber(value, "drawDistance", 3000.0f);
+			layer.count = (uint32_t)getNumber(value, "count", 1000.0f);
+			layer.seed = (uint32_t)getNumber(value, "seed", 0.0f);
+			if (layer.filename.empty() || layer.size <= 0.0f || layer.fadeEnd < layer.fadeStart)
+			{
+				printf("%s: foliage layer %u needs a file, a size and to fade out after it fades in\n", a_filename,
+					(unsigned int)i);
+				return false;
+			}
+			m_foliage.push_back(layer);
+		}
+
+		const JsonValue* crowds = root.find("crowds");
+		for (size_t i = 0; crowds != nullptr && i < crowds->items.size(); ++i)
+		{
+			const JsonValue& value = crowds->items[i];
+			Crowd crowd;
+			crowd.filename = getString(value, "file");
+			crowd.clip = getString(value, "clip");
+			crowd.position = getVector(value, "position", glm::vec3(0));
+			crowd.size = getNumber(value, "size", 2000.0f);
+			crowd.scale = glm::vec2(getNumber(value, "scale", 1.0f));
+			crowd.scale = getVector(value, "scale", crowd.scale);
+			crowd.speed = glm::vec2(getNumber(value, "speed", 1.0f));
+			crowd.speed = getVector(value, "speed", crowd.speed);
+			crowd.drawDistance = getNumber(value, "drawDistance", 5000.0f);
+			crowd.frames = (uint32_t)getNumber(value, "frames", 32.0f);
+			crowd.count = (uint32_t)getNumber(value, "count", 1000.0f);
+			crowd.seed = (uint32_t)getNumber(value, "seed", 0.0f);
+			if (crowd.filename.empty() || crowd.size <= 0.0f || crowd.frames < 2)
+			{
+				printf("%s: crowd %u needs a file, a size and at least 2 frames\n", a_filename, (unsigned int)i);
+				return false;
+			}
+			m_crowds.push_back(crowd);
+		}
+
+		const JsonValue* terrain = root.find("terrain");
+		if (terrain != nullptr)
+		{
+			m_terrain.heightmap = getString(*terrain, "heightmap");
+			m_terrain.position = getVector(*terrain, "position", glm::vec3(0));
+			m_terrain.size = getNumber(*terrain, "size", 4000.0f);
+			m_terrain.height = getNumber(*terrain, "height", 400.0f);
+			m_terrain.flatRadius = getNumber(*terrain, "flatRadius", 0.0f);
+			m_terrain.patches = (uint32_t)getNumber(*terrain, "patches", 64.0f);
+			m_terrain.seed = (uint32_t)getNumber(*terrain, "seed", 0.0f);
+			if (m_terrain.size <= 0.0f || m_terrain.patches == 0)
+			{
+				printf("%s: the terrain needs a size and patches\n", a_filename);
+				return false;
+			}
+		}
+
+		const JsonValue* ocean = root.find("ocean");
+		if (ocean != nullptr)
+		{
+			m_ocean.height = getNumber(*ocean, "height", 0.0f);
+			m_ocean.extent = getNumber(*ocean, "extent", 20000.0f);
+			m_ocean.unitsPerMetre = getNumber(*ocean, "unitsPerMetre", 100.0f);
+			m_ocean.wind = getVector(*ocean, "wind", glm::vec2(10, 4));
+			m_ocean.amplitude = getNumber(*ocean, "amplitude", 1.0f);
+			m_ocean.choppiness = getNumber(*ocean, "choppiness", 1.0f);
+			m_ocean.cascadeSizes = getVector(*ocean, "cascadeSizes", glm::vec3(250, 37, 5));
+			m_ocean.resolution = (uint32_t)getNumber(*ocean, "resolution", 256.0f);
+			m_ocean.patches = (uint32_t)getNumber(*ocean, "patches", 32.0f);
+			m_ocean.seed = (uint32_t)getNumber(*ocean, "seed", 0.0f);
+			bool powerOfTwo = m_ocean.resolution >= 16 && m_ocean.resolution <= 512 &&
+				(m_ocean.resolution & (m_ocean.resolution - 1)) == 0;
+			if (m_ocean.extent <= 0.0f || m_ocean.unitsPerMetre <= 0.0f || m_ocean.patches == 0 || powerOfTwo == false)
+			{
+				printf("%s: the ocean needs an extent, a scale, patches and a resolution of a power of two from 16 to 512\n",
+					a_filename);
+				return false;
+			}
+		}
+
+		const JsonValue* probes = root.find("probes");
+		if (probes != nullptr)
+		{
+			m_probes.min = getVector(*probes, "min", glm::vec3(0));
+			m_probes.max = getVector(*probes, "max", glm::vec3(0));
+			m_probes.spacing = getNumber(*probes, "spacing", 100.0f);
+			if (m_probes.spacing <= 0.0f || glm::any(glm::lessThanEqual(m_probes.max, m_probes.min)))
+			{
+				printf("%s: the probes need a spacing and a box with a min below its max\n", a_filename);
+				return false;
+			}
+
+			const JsonValue* reflections = probes->find("reflections");
+			for (size_t i = 0; reflections != nullptr && i < reflections->items.size(); ++i)
+			{
+				if (m_probes.reflectionCount == MAX_REFLECTION_PROBES)
+				{
+					printf("%s: only the first %u reflection probes are kept\n", a_filename, MAX_REFLECTION_PROBES);
+					break;
+				}
+				m_probes.reflections[m_probes.reflectionCount++] = getVector(reflections->items[i], "position", glm::vec3(0));
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,465 @@
+/**
+	SceneDescription.h
+
+	Purpose: SceneDescription.h is the header file for the SceneDescription
+			class. The SceneDescription is what a scene is made of, read
+			from a file instead of written into the Application, so
+			content is added without recompiling.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The SceneDescription class lists a scene's meshes, the objects
+			placed from them, its lights and its particle emitters. An
+			object is only a mesh and a transform, so a mesh placed a
+			thousand times is loaded once.
+
+		A scene is authored as JSON, such as
+			{ "meshes": [ { "name": "floor", "file": "floor.obj",
+			"material": { "diffuseMap": true } } ], "objects":
+			[ { "mesh": "floor", "position": [0, 0, 0] } ] }, and
+			compiled to a binary form that loads without parsing.
+			load reads either.
+
+		Characters are placed the same way as objects, but are skinned
+			glTF models rather than meshes, and aren't streamed. A crowd
+			is thousands of copies of one of them, scattered over a
+			square and playing one baked clip, see Crowd.
+
+		A scene can have one terrain, a heightfield around the objects
+			drawn by the Terrain, and layers of foliage scattered over
+			it, drawn by the Foliage.
+
+		A scene too large to be resident at once is split into cells,
+			named boxes its objects say they are in with "cell", which
+			the SceneStreamer loads and unloads around the camera.
+			Objects in no cell are always loaded.
+
+		A mesh with "lightmap", the width of its lightmap in texels, is
+			unwrapped as it is imported and its objects baked by the
+			Lightmapper, unless they are streamed.
+
+		A mesh with "virtualTexture", the path of a page file written by
+			--build-virtual-texture, has its diffuse colour streamed from
+			it by the VirtualTextureCache instead of its diffuse map.
+
+		A scene can have probes, a box of irradiance probes and a few
+			reflection probes lighting what moves through it, see
+			ProbeVolume.
+	*/
+	class SceneDescription
+	{
+	public:
+		static const unsigned int MAGIC = 0x53534e53; // "SNSS"
+		static const unsigned int VERSION = 13; // 2: cells and streaming, 3: characters, 4: terrain, 5: foliage, 6: emitter forces, 7: emitter pre-warm, 8: ocean, 9: crowds, 10: lightmaps, 11: probes, 12: decals, 13: virtual textures
+
+		// What a mesh's materials are drawn with, as Mesh::material.
+		static const uint32_t MATERIAL_DIFFUSE_MAP = 1 << 0;
+		static const uint32_t MATERIAL_NORMAL_MAP = 1 << 1;
+		static const uint32_t MATERIAL_ALPHA_TESTED = 1 << 2;
+
+		// How many directional lights it is lit by, over the shift.
+		static const uint32_t MATERIAL_LIGHT_COUNT_SHIFT = 3;
+
+		// What an object is, as Object::flags.
+		static const uint32_t OBJECT_OCCLUDER = 1 << 0;
+		static const uint32_t OBJECT_CLOTH = 1 << 1;
+		static const uint32_t OBJECT_TRANSPARENT = 1 << 2;
+
+		// The cell of an object that is always loaded.
+		static const uint32_t NO_CELL = 0xffffffff;
+
+		// The most reflection probes a scene has.
+		static const uint32_t MAX_REFLECTION_PROBES = 8;
+
+		/**
+			A mesh the scene loads once, and how its materials are drawn.
+		*/
+		struct Mesh
+		{
+			std::string name;
+			std::string filename;
+			uint32_t material;
+
+			// The width of its baked lightmap, 0 for none.
+			uint32_t lightmapResolution;
+
+			// The page file of its virtual texture, empty for none.
+			std::string virtualTexture;
+		};
+
+		/**
+			A mesh placed in the scene.
+		*/
+		struct Object
+		{
+			uint32_t mesh;
+			uint32_t flags;
+
+			// The cell it is streamed with, or NO_CELL.
+			uint32_t cell;
+			glm::mat4 transform;
+		};
+
+		/**
+			A box of the world whose objects are loaded and unloaded
+				together.
+		*/
+		struct Cell
+		{
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+
+		/**
+			How the cells are streamed. A cell starts loading once the
+				camera is within loadDistance of it and unloads past
+				unloadDistance, further so a camera on the edge doesn't
+				load and unload it every frame. The cells resident at
+				once are kept within budgetMB.
+		*/
+		struct Streaming
+		{
+			float budgetMB;
+			float loadDistance;
+			float unloadDistance;
+		};
+
+		/**
+			A point light, or a spot light where cosine isn't -1.
+		*/
+		struct Light
+		{
+			glm::vec3 position;
+			float range;
+			glm::vec3 colour;
+			glm::vec3 direction;
+
+			// The cosine of the spot's half angle, -1 all the way round.
+			float cosine;
+		};
+
+		/**
+			Lights placed at random from a fixed seed, so the same ones
+				are placed every run. Every spotEvery'th is a spot with
+				twice the range pointing down.
+		*/
+		struct LightScatter
+		{
+			uint32_t count;
+			uint32_t seed;
+			uint32_t spotEvery;
+			glm::vec3 min;
+			glm::vec3 max;
+			glm::vec2 range;
+			glm::vec2 colour;
+			glm::vec2 spotAngle;
+		};
+
+		/**
+			A particle emitter, with the values ParticleEmitter::initialise
+				takes, and the ParticleForces pushing its particles
+				about. curlNoise is the curl noise's strength, scale and
+				speed. prewarm is how long it is fast-forwarded before
+				it is shown, below 0 for its longest lifespan and 0 to
+				start empty.
+		*/
+		struct Emitter
+		{
+			glm::vec3 position;
+			uint32_t maxParticles;
+			uint32_t emitRate;
+			uint32_t seed;
+			glm::vec2 lifetime;
+			glm::vec2 velocity;
+			glm::vec2 size;
+			glm::vec4 startColour;
+			glm::vec4 endColour;
+			glm::vec3 gravity;
+			float drag;
+			glm::vec3 curlNoise;
+			float prewarm;
+		};
+
+		/**
+			A skinned character, a glTF model playing one of its clips,
+				or blending a second into it, see Animator.
+		*/
+		struct Character
+		{
+			std::string filename;
+			std::string clip;
+			std::string blendClip;
+			float blend;
+			float speed;
+			glm::mat4 transform;
+		};
+
+		/**
+			A crowd, copies of a skinned character scattered over a
+				square centred on position and each playing its clip
+				from a point of its own, see Crowd. They stand on the
+				terrain, or at position's height without one.
+		*/
+		struct Crowd
+		{
+			std::string filename;
+			std::string clip;
+			glm::vec3 position;
+			float size;
+
+			// The smallest and largest scale and speed a copy is given.
+			glm::vec2 scale;
+			glm::vec2 speed;
+
+			// How far away copies aren't drawn at all.
+			float drawDistance;
+
+			// How many frames of the clip are baked, and how many copies
+			//	there are.
+			uint32_t frames;
+			uint32_t count;
+			uint32_t seed;
+		};
+
+		/**
+			The heightfield under the scene, see Terrain. It is square,
+				centred on position, which is the height of its lowest
+				ground. Without a heightmap one is generated from the
+				seed, flat within flatRadius of the centre so the objects
+				there stand on level ground.
+		*/
+		struct Terrain
+		{
+			std::string heightmap;
+			glm::vec3 position;
+
+			// How wide it is, 0 for no terrain, and how high its highest
+			//	point can be above position.
+			float size;
+			float height;
+			float flatRadius;
+
+			// How many patches it is drawn as, across each side.
+			uint32_t patches;
+			uint32_t seed;
+		};
+
+		/**
+			The sea around the scene, see Ocean. Its waves are worked out
+				in metres and drawn scaled by unitsPerMetre, tiles of
+				each cascade's size repeating across it from the camera
+				out to extent.
+		*/
+		struct Ocean
+		{
+			// The height of the sea at rest, and how far from the camera
+			//	it is drawn, 0 for no ocean.
+			float height;
+			float extent;
+			float unitsPerMetre;
+
+			// The wind's direction, its speed in metres a second as its
+			//	length, and how tall and sharp it makes the waves.
+			glm::vec2 wind;
+			float amplitude;
+			float choppiness;
+
+			// How many metres across each cascade's tile is, largest
+			//	first, and how many waves each side of it has.
+			glm::vec3 cascadeSizes;
+			uint32_t resolution;
+
+			// How many patches it is drawn as, across each side.
+			uint32_t patches;
+			uint32_t seed;
+		};
+
+		/**
+			A layer of foliage, copies of one mesh scattered over a
+				square centred on position, see Foliage. They stand on
+				the terrain, or at position's height without one. The
+				density map's brightness is how likely a copy is kept
+				where it lands, everywhere without one, and none land
+				within innerRadius of the centre.
+		*/
+		struct Foliage
+		{
+			std::string filename;
+			std::string densityMap;
+			glm::vec3 position;
+			float size;
+			float innerRadius;
+
+			// The smallest and largest scale a copy is given.
+			glm::vec2 scale;
+
+			// How far away copies start and finish turning into their
+			//	impostors, and how far away they aren't drawn at all.
+			float fadeStart;
+			float fadeEnd;
+			float drawDistance;
+
+			// How many copies are tried, fewer are kept under a density
+			//	map.
+			uint32_t count;
+			uint32_t seed;
+		};
+
+		/**
+			The probes lighting what moves through the scene, see
+				ProbeVolume. The irradiance probes are spread through the
+				box from min to max about spacing apart, and the
+				reflection probes are at the first reflectionCount of
+				reflections.
+		*/
+		struct Probes
+		{
+			// The box, and how far apart its probes are, 0 for none.
+			glm::vec3 min;
+			glm::vec3 max;
+			float spacing;
+
+			uint32_t reflectionCount;
+			glm::vec3 reflections[MAX_REFLECTION_PROBES];
+		};
+
+		/**
+			A decal projecting a texture onto the scene, see
+				LightClusters::makeDecal. Its box is placed as a mesh is,
+				from -0.5 to 0.5 on each side, and projected along its z.
+		*/
+		struct Decal
+		{
+			std::string texture;
+			float opacity;
+			glm::mat4 transform;
+		};
+
+		/**
+			The directional light and the ambient light with it.
+		*/
+		struct Sun
+		{
+			glm::vec3 diffuse;
+			glm::vec3 specular;
+			glm::vec3 ambient;
+		};
+
+		SceneDescription();
+
+		/**
+			load reads a scene, compiled if the file starts with MAGIC
+				and JSON otherwise. It is read through the FileSystem,
+				so it can be in an archive.
+
+				@param1 a_filename is the scene file.
+
+				@return false if it couldn't be read, any error is
+						printed.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			write writes the scene in its compiled form.
+
+				@param1 a_filename is the file to write.
+
+				@return false if it couldn't be written.
+		*/
+		bool write(const char* a_filename) const;
+
+		/**
+			clear empties the scene.
+		*/
+		void clear();
+
+		const std::vector<Mesh>& getMeshes() const { return m_meshes; }
+		const std::vector<Object>& getObjects() const { return m_objects; }
+		const std::vector<Light>& getLights() const { return m_lights; }
+		const std::vector<Emitter>& getEmitters() const { return m_emitters; }
+		const std::vector<Cell>& getCells() const { return m_cells; }
+		const std::vector<Character>& getCharacters() const { return m_characters; }
+		const std::vector<Foliage>& getFoliage() const { return m_foliage; }
+		const std::vector<Crowd>& getCrowds() const { return m_crowds; }
+		const std::vector<Decal>& getDecals() const { return m_decals; }
+		const Streaming& getStreaming() const { return m_streaming; }
+		const Sun& getSun() const { return m_sun; }
+
+		/**
+			getTerrain returns the terrain, with a size of 0 if there
+				isn't one.
+		*/
+		const Terrain& getTerrain() const { return m_terrain; }
+
+		/**
+			getOcean returns the ocean, with an extent of 0 if there
+				isn't one.
+		*/
+		const Ocean& getOcean() const { return m_ocean; }
+
+		/**
+			getProbes returns the probes, with a spacing of 0 if there
+				aren't any.
+		*/
+		const Probes& getProbes() const { return m_probes; }
+
+		/**
+			getLightScatter returns the lights to scatter, with a count of
+				0 if there are none.
+		*/
+		const LightScatter& getLightScatter() const { return m_lightScatter; }
+
+	private:
+		/**
+			The start of a compiled file. The meshes' names and files,
+				the characters' files and clips, the foliage's files,
+				the crowds' files and clips, the decals' textures and the
+				terrain's heightmap follow everything else, each ended
+				with a 0.
+		*/
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t meshCount;
+			uint32_t objectCount;
+			uint32_t lightCount;
+			uint32_t emitterCount;
+			uint32_t cellCount;
+			uint32_t characterCount;
+			uint32_t foliageCount;
+			uint32_t crowdCount;
+			uint32_t decalCount;
+			uint32_t stringBytes;
+		};
+
+		// Reads each form, from the whole of the file.
+		bool readCompiled(const unsigned char* a_data, size_t a_size);
+		bool readJson(const char* a_text, size_t a_size, const char* a_filename);
+
+		std::vector<Mesh> m_meshes;
+		std::vector<Object> m_objects;
+		std::vector<Light> m_lights;
+		std::vector<Emitter> m_emitters;
+		std::vector<Cell> m_cells;
+		std::vector<Character> m_characters;
+		std::vector<Foliage> m_foliage;
+		std::vector<Crowd> m_crowds;
+		std::vector<Decal> m_decals;
+		Streaming m_streaming;
+		LightScatter m_lightScatter;
+		Sun m_sun;
+		Terrain m_terrain;
+		Ocean m_ocean;
+		Probes m_probes;
+	};
+}
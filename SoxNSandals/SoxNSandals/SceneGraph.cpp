@@ -0,0 +1,141 @@
+/**
+	SceneGraph.cpp
+
+	Purpose: SceneGraph.cpp is the source file for the SceneGraph class.
+			The SceneGraph holds a hierarchy of transforms in flat arrays
+			and keeps every node's world matrix up to date, recomputing
+			only the nodes that moved and the ones beneath them.
+
+	@author Nathan Nette
+*/
+#include "SceneGraph.h"
+#include "MatrixBatch.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sns
+{
+	const SceneGraph::Node SceneGraph::NO_PARENT;
+
+	SceneGraph::SceneGraph()
+		: m_firstDirty(0),
+		m_structureVersion(0)
+	{
+	}
+
+	/**
+		create adds a node beneath a parent.
+
+			@param1 a_local is the node's matrix relative to its parent.
+
+			@param2 a_parent is an existing node, or NO_PARENT.
+
+			@return the new node.
+	*/
+	SceneGraph::Node SceneGraph::create(const glm::mat4& a_local, Node a_parent)
+	{
+		Node node = getNodeCount();
+
+		m_parents.push_back(a_parent < node ? a_parent : NO_PARENT);
+		m_locals.push_back(a_local);
+		m_worlds.push_back(a_local);
+		m_dirty.push_back(1);
+		++m_structureVersion;
+
+		m_firstDirty = std::min(m_firstDirty.load(), node);
+		return node;
+	}
+
+	/**
+		setLocal moves a node relative to its parent. Its world matrix,
+			and its children's, change on the next update. Several
+			threads may move different nodes at once, but not during
+			create or update.
+
+			@param1 a_node is the node to move.
+
+			@param2 a_local is its new local matrix.
+	*/
+	void SceneGraph::setLocal(Node a_node, const glm::mat4& a_local)
+	{
+		m_locals[a_node] = a_local;
+		m_dirty[a_node] = 1;
+
+		// Usually the first dirty node is already before this one, and
+		//	this is only a load.
+		Node first = m_firstDirty.load(std::memory_order_relaxed);
+		while (a_node < first && m_firstDirty.compare_exchange_weak(first, a_node, std::memory_order_relaxed) == false)
+		{
+		}
+	}
+
+	/**
+		update recomputes the world matrix of every dirty node and every
+			node beneath one. Parents come before their children, so a
+			parent is always up to date by the time its children are.
+			Siblings created one after another are multiplied by their
+			parent's world matrix as a batch.
+
+			@return how many nodes were recomputed.
+	*/
+	unsigned int SceneGraph::update()
+	{
+		Node count = getNodeCount();
+		Node firstDirty = m_firstDirty.load();
+		if (firstDirty >= count)
+			return 0;
+
+		unsigned int updated = 0;
+		for (Node node = firstDirty; node < count;)
+		{
+			Node parent = m_parents[node];
+			if (parent == NO_PARENT)
+			{
+				if (m_dirty[node] != 0)
+				{
+					m_worlds[node] = m_locals[node];
+					++updated;
+				}
+				++node;
+				continue;
+			}
+
+			bool parentDirty = m_dirty[parent] != 0;
+			if (parentDirty == false && m_dirty[node] == 0)
+			{
+				++node;
+				continue;
+			}
+
+			// The siblings after it that need recomputing too, all of
+			//	them if the parent moved or just the dirty ones if not.
+			Node end = node + 1;
+			while (end < count && m_parents[end] == parent && (parentDirty || m_dirty[end] != 0))
+			{
+				++end;
+			}
+
+			multiplyMatrices(m_worlds[parent], &m_locals[node], &m_worlds[node], end - node);
+			std::memset(m_dirty.data() + node, 1, end - node);
+			updated += end - node;
+			node = end;
+		}
+
+		std::memset(m_dirty.data() + firstDirty, 0, count - firstDirty);
+		m_firstDirty = count;
+		return updated;
+	}
+
+	/**
+		clear removes every node.
+	*/
+	void SceneGraph::clear()
+	{
+		m_parents.clear();
+		m_locals.clear();
+		m_worlds.clear();
+		m_dirty.clear();
+		m_firstDirty = 0;
+		++m_structureVersion;
+	}
+}
@@ -0,0 +1,115 @@
+/**
+	SceneGraph.h
+
+	Purpose: SceneGraph.h is the header file for the SceneGraph class.
+			The SceneGraph holds a hierarchy of transforms in flat arrays
+			and keeps every node's world matrix up to date, recomputing
+			only the nodes that moved and the ones beneath them.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <atomic>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The SceneGraph class stores every node's parent, local matrix and
+			world matrix in arrays of their own. A node's parent must
+			already exist when it is created, so parents always come
+			before their children and one pass from front to back
+			updates the whole hierarchy.
+
+		setLocal only marks a node dirty. update then recomputes the
+			dirty nodes and everything beneath them, starting from the
+			first dirty node, and leaves the rest alone.
+	*/
+	class SceneGraph
+	{
+	public:
+		typedef unsigned int Node;
+
+		// The parent of a node at the top of the hierarchy.
+		static const Node NO_PARENT = ~0u;
+
+		SceneGraph();
+
+		/**
+			create adds a node beneath a parent.
+
+				@param1 a_local is the node's matrix relative to its parent.
+
+				@param2 a_parent is an existing node, or NO_PARENT.
+
+				@return the new node.
+		*/
+		Node create(const glm::mat4& a_local, Node a_parent = NO_PARENT);
+
+		/**
+			setLocal moves a node relative to its parent. Its world
+				matrix, and its children's, change on the next update.
+				Several threads may move different nodes at once, but
+				not during create or update.
+
+				@param1 a_node is the node to move.
+
+				@param2 a_local is its new local matrix.
+		*/
+		void setLocal(Node a_node, const glm::mat4& a_local);
+
+		/**
+			update recomputes the world matrix of every dirty node and
+				every node beneath one.
+
+				@return how many nodes were recomputed.
+		*/
+		unsigned int update();
+
+		/**
+			clear removes every node.
+		*/
+		void clear();
+
+		const glm::mat4& getLocal(Node a_node) const { return m_locals[a_node]; }
+
+		/**
+			getWorld returns a node's world matrix as of the last update.
+		*/
+		const glm::mat4& getWorld(Node a_node) const { return m_worlds[a_node]; }
+
+		Node getParent(Node a_node) const { return m_parents[a_node]; }
+
+		unsigned int getNodeCount() const { return (unsigned int)m_parents.size(); }
+
+		/**
+			getFirstDirty returns the first node moved since the last
+				update, or getNodeCount if none has. Every node from it
+				on may need recomputing.
+		*/
+		Node getFirstDirty() const { return m_firstDirty.load(); }
+
+		/**
+			getStructureVersion returns a number that changes whenever a
+				node is created or the graph is cleared, so copies of
+				the hierarchy know to rebuild.
+		*/
+		unsigned int getStructureVersion() const { return m_structureVersion; }
+
+	private:
+		std::vector<Node> m_parents;
+		std::vector<glm::mat4> m_locals;
+		std::vector<glm::mat4> m_worlds;
+
+		// Which nodes changed since the last update. During update it
+		//	also marks the recomputed ones, so their children follow.
+		std::vector<unsigned char> m_dirty;
+
+		// The first dirty node, update starts from it. getNodeCount
+		//	when nothing is dirty.
+		std::atomic<Node> m_firstDirty;
+
+		unsigned int m_structureVersion;
+	};
+}
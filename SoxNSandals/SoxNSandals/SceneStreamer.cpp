@@ -0,0 +1,289 @@
+/**
+	SceneStreamer.cpp
+
+	Purpose: SceneStreamer.cpp is the source file for the SceneStreamer
+			class. The SceneStreamer loads the cells of a scene near the
+			camera through the AssetLoader and unloads the ones it has
+			left, so a scene larger than memory can be flown through.
+
+	@author Nathan Nette
+*/
+#include "SceneStreamer.h"
+#include "FileSystem.h"
+#include "OBJMesh.h"
+#include <algorithm>
+
+namespace
+{
+	// Calls a function with every texture of a mesh's materials.
+	template <typename Function>
+	void forEachTexture(const aie::OBJMesh& a_mesh, Function a_function)
+	{
+		for (size_t i = 0; i < a_mesh.getMaterialCount(); ++i)
+		{
+			const aie::OBJMesh::Material& material = a_mesh.getMaterial(i);
+			const aie::Texture* textures[] = { material.diffuseTexture.get(), material.alphaTexture.get(),
+				material.ambientTexture.get(), material.specularTexture.get(), material.specularHighlightTexture.get(),
+				material.normalTexture.get(), material.displacementTexture.get(), material.packedTexture.get() };
+			for (const aie::Texture* texture : textures)
+			{
+				if (texture != nullptr)
+					a_function(*texture);
+			}
+		}
+	}
+}
+
+namespace sns
+{
+	SceneStreamer::SceneStreamer()
+		: m_scene(nullptr), m_stats()
+	{
+	}
+
+	/**
+		create makes a mesh for every streamed mesh of a scene and works
+			out which cells hold each. A mesh also placed by an object in
+			no cell is always loaded, so it isn't streamed.
+
+			@param1 a_scene is the scene, which must stay alive while the
+					streamer is used.
+	*/
+	void SceneStreamer::create(const SceneDescription& a_scene)
+	{
+		m_scene = &a_scene;
+		m_meshes.clear();
+		m_cells.clear();
+		m_stats = {};
+
+		const std::vector<SceneDescription::Mesh>& meshes = a_scene.getMeshes();
+		const std::vector<SceneDescription::Object>& objects = a_scene.getObjects();
+		std::vector<bool> streamed(meshes.size(), false);
+		std::vector<bool> resident(meshes.size(), false);
+		for (const SceneDescription::Object& object : objects)
+		{
+			if (object.cell == SceneDescription::NO_CELL)
+				resident[object.mesh] = true;
+			else
+				streamed[object.mesh] = true;
+		}
+
+		m_meshOf.assign(meshes.size(), NO_MESH);
+		for (unsigned int i = 0; i < (unsigned int)meshes.size(); ++i)
+		{
+			if (streamed[i] == false || resident[i])
+				continue;
+
+			// The binary cache is about the size the mesh will be on the
+			//	gpu, the obj is only used before the first import.
+			unsigned long long size = 0;
+			long long time = 0;
+			std::string cache = meshes[i].filename + aie::OBJMesh::getCacheExtension();
+			if (FileSystem::instance().getFileStamp(cache.c_str(), size, time) == false)
+				FileSystem::instance().getFileStamp(meshes[i].filename.c_str(), size, time);
+
+			m_meshOf[i] = (unsigned int)m_meshes.size();
+			Mesh mesh;
+			mesh.sceneMesh = i;
+			mesh.mesh.reset(new aie::OBJMesh());
+
+			// Cells load around the camera before they are in view, their
+			//	textures wait until they are seen.
+			mesh.mesh->setLazyTextures(true);
+			mesh.state = State::UNLOADED;
+			mesh.references = 0;
+			mesh.bytes = (size_t)size;
+			m_meshes.push_back(std::move(mesh));
+		}
+
+		for (const SceneDescription::Cell& description : a_scene.getCells())
+			m_cells.push_back({ description.min, description.max, {}, false });
+		for (const SceneDescription::Object& object : objects)
+		{
+			unsigned int mesh = m_meshOf[object.mesh];
+			if (object.cell == SceneDescription::NO_CELL || mesh == NO_MESH)
+				continue;
+			std::vector<unsigned int>& cellMeshes = m_cells[object.cell].meshes;
+			if (std::find(cellMeshes.begin(), cellMeshes.end(), mesh) == cellMeshes.end())
+				cellMeshes.push_back(mesh);
+		}
+		m_counted.assign(m_meshes.size(), 0);
+	}
+
+	/**
+		getMesh returns the mesh a scene mesh is streamed into.
+
+			@param1 a_mesh is the mesh's index in the scene.
+
+			@return the mesh, or nullptr if the mesh isn't streamed.
+	*/
+	aie::OBJMesh* SceneStreamer::getMesh(unsigned int a_mesh) const
+	{
+		if (a_mesh >= m_meshOf.size() || m_meshOf[a_mesh] == NO_MESH)
+			return nullptr;
+		return m_meshes[m_meshOf[a_mesh]].mesh.get();
+	}
+
+	/**
+		update picks the cells to be resident, then loads and unloads the
+			meshes to match.
+
+		A cell is a candidate within the load distance, or within the
+			unload distance if it was already wanted. Its priority is its
+			distance from the camera, doubled for a cell right behind it,
+			and the candidates are wanted nearest first until the next
+			doesn't fit the budget. The nearest is always wanted, so the
+			camera's own cell is drawn however small the budget.
+
+			@param1 a_loader loads the meshes.
+
+			@param2 a_position is the camera's position.
+
+			@param3 a_direction is the way it looks, unit length.
+
+			@return whether a mesh was loaded or unloaded since the last
+					update.
+	*/
+	bool SceneStreamer::update(AssetLoader& a_loader, const glm::vec3& a_position, const glm::vec3& a_direction)
+	{
+		m_stats.loads = 0;
+		m_stats.unloads = 0;
+		if (m_scene == nullptr || m_cells.empty())
+			return false;
+
+		// Meshes whose loads finished since the last update.
+		bool changed = false;
+		for (Mesh& mesh : m_meshes)
+		{
+			if (mesh.state != State::LOADING || mesh.handle.isReady() == false)
+				continue;
+			mesh.state = mesh.handle.succeeded() ? State::LOADED : State::FAILED;
+			changed = true;
+		}
+
+		const SceneDescription::Streaming& streaming = m_scene->getStreaming();
+		m_candidates.clear();
+		for (unsigned int i = 0; i < (unsigned int)m_cells.size(); ++i)
+		{
+			const Cell& cell = m_cells[i];
+			glm::vec3 closest = glm::clamp(a_position, cell.min, cell.max);
+			float distance = glm::length(closest - a_position);
+			if (distance > (cell.wanted ? streaming.unloadDistance : streaming.loadDistance))
+				continue;
+
+			// The direction to the cell's centre, from 1 ahead to 2 behind.
+			glm::vec3 toCentre = (cell.min + cell.max) * 0.5f - a_position;
+			float length = glm::length(toCentre);
+			float facing = length > 0.0f ? glm::dot(toCentre / length, a_direction) : 1.0f;
+			m_candidates.push_back({ i, distance * (1.5f - 0.5f * facing) });
+		}
+		std::sort(m_candidates.begin(), m_candidates.end(),
+			[](const Candidate& a_left, const Candidate& a_right) { return a_left.priority < a_right.priority; });
+
+		// A mesh held by two wanted cells only counts once.
+		size_t budget = (size_t)(streaming.budgetMB * 1024.0f * 1024.0f);
+		size_t wantedBytes = 0;
+		std::fill(m_counted.begin(), m_counted.end(), 0);
+		for (Cell& cell : m_cells)
+			cell.wanted = false;
+		for (const Candidate& candidate : m_candidates)
+		{
+			Cell& cell = m_cells[candidate.cell];
+			size_t bytes = 0;
+			for (unsigned int mesh : cell.meshes)
+			{
+				if (m_counted[mesh] == 0)
+					bytes += m_meshes[mesh].bytes;
+			}
+			if (wantedBytes > 0 && wantedBytes + bytes > budget)
+				continue;
+
+			cell.wanted = true;
+			wantedBytes += bytes;
+			for (unsigned int mesh : cell.meshes)
+				m_counted[mesh] = 1;
+		}
+
+		for (Mesh& mesh : m_meshes)
+			mesh.references = 0;
+		m_stats.residentCells = 0;
+		m_stats.loadingCells = 0;
+		for (const Cell& cell : m_cells)
+		{
+			if (cell.wanted == false)
+				continue;
+			bool loaded = true;
+			for (unsigned int mesh : cell.meshes)
+			{
+				++m_meshes[mesh].references;
+				loaded = loaded && m_meshes[mesh].state != State::UNLOADED && m_meshes[mesh].state != State::LOADING;
+			}
+			if (loaded)
+				++m_stats.residentCells;
+			else
+				++m_stats.loadingCells;
+		}
+
+		// A mesh still loading is only unloaded once its load is done,
+		//	the loader's worker may still be writing into it, and its
+		//	textures once the texture uploader has finished with them.
+		const std::vector<SceneDescription::Mesh>& descriptions = m_scene->getMeshes();
+		m_stats.residentBytes = 0;
+		for (Mesh& mesh : m_meshes)
+		{
+			if (mesh.references > 0 && mesh.state == State::UNLOADED)
+			{
+				mesh.handle = a_loader.loadMesh(mesh.mesh.get(), descriptions[mesh.sceneMesh].filename.c_str(), true, true);
+				mesh.state = State::LOADING;
+				++m_stats.loads;
+			}
+			else if (mesh.references == 0 && mesh.state == State::LOADED && isUploading(*mesh.mesh) == false)
+			{
+				mesh.mesh->unload();
+				mesh.state = State::UNLOADED;
+				++m_stats.unloads;
+				changed = true;
+			}
+
+			// Textures finish uploading and stream levels in after the
+			//	mesh has loaded, so it is measured again every update.
+			if (mesh.state == State::LOADED)
+			{
+				mesh.bytes = measure(*mesh.mesh);
+				m_stats.residentBytes += mesh.bytes;
+			}
+			else if (mesh.state == State::FAILED)
+				mesh.bytes = 0;
+		}
+		return changed;
+	}
+
+	/**
+		measure returns how many bytes a loaded mesh's buffers and the
+			levels of its textures on the gpu take.
+
+			@param1 a_mesh is the mesh.
+	*/
+	size_t SceneStreamer::measure(const aie::OBJMesh& a_mesh)
+	{
+		size_t bytes = a_mesh.getGPUBytes();
+		forEachTexture(a_mesh, [&bytes](const aie::Texture& a_texture) { bytes += a_texture.getGPUBytes(); });
+		return bytes;
+	}
+
+	/**
+		isUploading returns whether any of a mesh's textures is still
+			queued on the texture uploader, which holds it by pointer.
+
+			@param1 a_mesh is the mesh.
+	*/
+	bool SceneStreamer::isUploading(const aie::OBJMesh& a_mesh)
+	{
+		bool uploading = false;
+		forEachTexture(a_mesh, [&uploading](const aie::Texture& a_texture)
+		{
+			uploading = uploading || a_texture.isPendingUpload();
+		});
+		return uploading;
+	}
+}
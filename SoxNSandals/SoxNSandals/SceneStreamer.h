@@ -0,0 +1,177 @@
+/**
+	SceneStreamer.h
+
+	Purpose: SceneStreamer.h is the header file for the SceneStreamer
+			class. The SceneStreamer loads the cells of a scene near the
+			camera through the AssetLoader and unloads the ones it has
+			left, so a scene larger than memory can be flown through.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "AssetLoader.h"
+#include "SceneDescription.h"
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	/**
+		The SceneStreamer class owns a mesh for every mesh of a scene
+			description that only objects in cells place. The objects
+			are drawn from these meshes, which stay where they are while
+			their contents come and go, so each is drawn once it has
+			loaded and skipped while it isn't, as any loading mesh is.
+
+		Once a frame, update ranks the cells near the camera by how far
+			away they are, those behind the camera counting as further,
+			and wants the nearest for as many as fit the budget. A mesh
+			is loaded while any wanted cell holds it, and unloaded once
+			none do and it has finished loading.
+
+		A mesh's bytes are guessed from the size of its file until it
+			has loaded, then are its buffers and textures on the gpu. A
+			texture shared between meshes is counted for each, so the
+			budget errs on the side of holding less.
+	*/
+	class SceneStreamer
+	{
+	public:
+		/**
+			What the streamer did in the last update.
+		*/
+		struct Stats
+		{
+			// Cells wanted with every mesh loaded, and still loading.
+			unsigned int residentCells;
+			unsigned int loadingCells;
+
+			// Meshes that started loading, and that were unloaded.
+			unsigned int loads;
+			unsigned int unloads;
+
+			// Bytes of the meshes that are loaded.
+			size_t residentBytes;
+		};
+
+		SceneStreamer();
+
+		/**
+			create makes a mesh for every streamed mesh of a scene and
+				works out which cells hold each. Nothing is loaded until
+				update.
+
+				@param1 a_scene is the scene, which must stay alive while
+						the streamer is used.
+		*/
+		void create(const SceneDescription& a_scene);
+
+		/**
+			getMesh returns the mesh a scene mesh is streamed into.
+
+				@param1 a_mesh is the mesh's index in the scene.
+
+				@return the mesh, or nullptr if the mesh isn't streamed.
+		*/
+		aie::OBJMesh* getMesh(unsigned int a_mesh) const;
+
+		/**
+			update picks the cells to be resident from where the camera
+				is and where it looks, then starts loading the meshes
+				they need and unloads the rest. It must be called on the
+				GL thread, after the loader's uploads.
+
+				@param1 a_loader loads the meshes.
+
+				@param2 a_position is the camera's position.
+
+				@param3 a_direction is the way it looks, unit length.
+
+				@return whether a mesh was loaded or unloaded since the
+						last update, so what is built from the loaded
+						meshes needs building again.
+		*/
+		bool update(AssetLoader& a_loader, const glm::vec3& a_position, const glm::vec3& a_direction);
+
+		/**
+			isCreated returns whether the scene has any cells to stream.
+		*/
+		bool isCreated() const { return m_cells.empty() == false; }
+
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		/**
+			Where a streamed mesh is in loading.
+		*/
+		enum class State
+		{
+			UNLOADED,
+			LOADING,
+			LOADED,
+			FAILED
+		};
+
+		/**
+			A streamed mesh, how many of the wanted cells hold it and its
+				bytes, guessed or measured.
+		*/
+		struct Mesh
+		{
+			unsigned int sceneMesh;
+			std::unique_ptr<aie::OBJMesh> mesh;
+			AssetHandle handle;
+			State state;
+			unsigned int references;
+			size_t bytes;
+		};
+
+		/**
+			A cell, its bounds, the streamed meshes its objects place, and
+				whether it was wanted last update.
+		*/
+		struct Cell
+		{
+			glm::vec3 min;
+			glm::vec3 max;
+			std::vector<unsigned int> meshes;
+			bool wanted;
+		};
+
+		/**
+			A cell close enough to be wanted, and how far away it
+				counts as.
+		*/
+		struct Candidate
+		{
+			unsigned int cell;
+			float priority;
+		};
+
+		// Measures a loaded mesh's buffers and textures.
+		static size_t measure(const aie::OBJMesh& a_mesh);
+
+		// Whether a mesh's textures are still being uploaded.
+		static bool isUploading(const aie::OBJMesh& a_mesh);
+
+		const SceneDescription* m_scene;
+		std::vector<Mesh> m_meshes;
+		std::vector<Cell> m_cells;
+
+		// Each scene mesh's index in m_meshes, or NO_MESH.
+		static const unsigned int NO_MESH = 0xffffffff;
+		std::vector<unsigned int> m_meshOf;
+
+		// Scratch space for update, kept so it doesn't allocate.
+		std::vector<Candidate> m_candidates;
+		std::vector<unsigned char> m_counted;
+
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,278 @@
+/**
+	SceneTarget.cpp
+
+	Purpose: SceneTarget.cpp is the source file for the SceneTarget
+			class. The SceneTarget is a window sized framebuffer the
+			scene is drawn into instead of the window's, for when the
+			window's depth isn't the format the scene needs or the
+			scene is drawn smaller than the window.
+
+	@author Nathan Nette
+*/
+#include "SceneTarget.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	SceneTarget::SceneTarget()
+		: m_framebuffer(0),
+		m_colourTexture(0),
+		m_depthTexture(0),
+		m_samples(1),
+		m_multisampleFramebuffer(0),
+		m_multisampleColour(0),
+		m_multisampleDepth(0),
+		m_width(0),
+		m_height(0),
+		m_scale(1.0f),
+		m_renderWidth(0),
+		m_renderHeight(0),
+		m_previousFramebuffer(0),
+		m_previousViewport()
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffer and textures.
+	*/
+	SceneTarget::~SceneTarget()
+	{
+		destroy();
+	}
+
+	// Makes a render target, read only by blits and texelFetch.
+	static unsigned int createTarget(unsigned int a_format, int a_width, int a_height)
+	{
+		unsigned int texture = 0;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, a_format, a_width, a_height);
+		GpuMemory::instance().trackTexture(texture, GpuMemory::getTextureBytes(a_format, a_width, a_height),
+			GpuMemory::RENDER_TARGETS, "SceneTarget");
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		return texture;
+	}
+
+	/**
+		create makes the framebuffer.
+
+			@param1 a_width is the width of the window.
+
+			@param2 a_height is the height of the window.
+
+			@return false without GL 4.5, the target is left uncreated.
+	*/
+	bool SceneTarget::create(int a_width, int a_height)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("SceneTarget: the scene target needs GL 4.5.\n");
+			return false;
+		}
+
+		m_width = a_width > 1 ? a_width : 1;
+		m_height = a_height > 1 ? a_height : 1;
+		setScale(m_scale);
+
+		// The colour is lit in high dynamic range and tonemapped on the
+		//	way out. Three small floats are half the bandwidth of half
+		//	floats, and nothing needs the scene's alpha.
+		m_colourTexture = createTarget(GL_R11F_G11F_B10F, m_width, m_height);
+		m_depthTexture = createTarget(RenderState::instance().getDepthFormat(), m_width, m_height);
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_colourTexture, 0);
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_depthTexture, 0);
+
+		if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("SceneTarget: the scene target isn't complete.\n");
+			destroy();
+			return false;
+		}
+
+		// A new size needs new samples as well.
+		int samples = m_samples;
+		m_samples = 1;
+		setSamples(samples);
+		return true;
+	}
+
+	// Makes a multisampled render target, only ever resolved by blits.
+	static unsigned int createMultisampleTarget(unsigned int a_format, int a_width, int a_height, int a_samples)
+	{
+		unsigned int texture = 0;
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &texture);
+		glTextureStorage2DMultisample(texture, a_samples, a_format, a_width, a_height, GL_TRUE);
+		GpuMemory::instance().trackTexture(texture, GpuMemory::getTextureBytes(a_format, a_width, a_height) * a_samples,
+			GpuMemory::RENDER_TARGETS, "SceneTarget");
+		return texture;
+	}
+
+	/**
+		setSamples makes the multisampled targets the scene is drawn
+			into, or deletes them.
+
+			@param1 a_samples is how many samples a pixel has, 1 for none.
+
+			@return false if the targets couldn't be made, the scene is
+					left drawn without samples.
+	*/
+	bool SceneTarget::setSamples(int a_samples)
+	{
+		a_samples = a_samples > 1 ? a_samples : 1;
+		if (a_samples == m_samples && (a_samples == 1 || m_multisampleFramebuffer != 0))
+			return true;
+		destroySamples();
+		m_samples = 1;
+		if (a_samples == 1 || isCreated() == false)
+			return a_samples == 1;
+
+		int maxSamples = 1;
+		glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+		if (a_samples > maxSamples)
+		{
+			printf("SceneTarget: %d samples is more than the %d there can be.\n", a_samples, maxSamples);
+			return false;
+		}
+
+		m_multisampleColour = createMultisampleTarget(GL_R11F_G11F_B10F, m_width, m_height, a_samples);
+		m_multisampleDepth = createMultisampleTarget(RenderState::instance().getDepthFormat(), m_width, m_height,
+			a_samples);
+		glCreateFramebuffers(1, &m_multisampleFramebuffer);
+		glNamedFramebufferTexture(m_multisampleFramebuffer, GL_COLOR_ATTACHMENT0, m_multisampleColour, 0);
+		glNamedFramebufferTexture(m_multisampleFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_multisampleDepth, 0);
+		if (glCheckNamedFramebufferStatus(m_multisampleFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("SceneTarget: the multisampled scene target isn't complete.\n");
+			destroySamples();
+			return false;
+		}
+		m_samples = a_samples;
+		return true;
+	}
+
+	/**
+		setScale sets how much of the width and height of the target the
+			scene is drawn into, from the next begin.
+
+			@param1 a_scale is the scale, up to 1.
+	*/
+	void SceneTarget::setScale(float a_scale)
+	{
+		m_scale = a_scale < 1.0f ? (a_scale > 0.0f ? a_scale : 1.0f) : 1.0f;
+		m_renderWidth = std::max((int)(m_width * m_scale + 0.5f), 1);
+		m_renderHeight = std::max((int)(m_height * m_scale + 0.5f), 1);
+	}
+
+	/**
+		begin binds the framebuffer and sets the viewport to the part of
+			it the scene is drawn into.
+	*/
+	void SceneTarget::begin()
+	{
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_samples > 1 ? m_multisampleFramebuffer : m_framebuffer);
+		glViewport(0, 0, m_renderWidth, m_renderHeight);
+	}
+
+	/**
+		end resolves the samples, if there are any, then copies the
+			colour to the framebuffer bound before begin, scaled up to
+			the target's size, and binds that and the viewport again.
+
+			@param1 a_copy is false to only bind them again.
+	*/
+	void SceneTarget::end(bool a_copy /* = true */)
+	{
+		// A resolve can't scale, so it is only of what was drawn. Neither
+		//	target is needed after it, and the driver can skip keeping
+		//	them.
+		if (m_samples > 1)
+		{
+			glBlitNamedFramebuffer(m_multisampleFramebuffer, m_framebuffer, 0, 0, m_renderWidth, m_renderHeight,
+				0, 0, m_renderWidth, m_renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			const unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_DEPTH_STENCIL_ATTACHMENT };
+			glInvalidateNamedFramebufferData(m_multisampleFramebuffer, 2, attachments);
+		}
+		if (a_copy)
+			copyOut(m_previousFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+		glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+	}
+
+	/**
+		present copies the colour to the bound framebuffer again as end
+			did, without anything being drawn into it.
+	*/
+	void SceneTarget::present()
+	{
+		int framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+		copyOut(framebuffer);
+	}
+
+	/**
+		copyOut copies the colour over a framebuffer the target's size.
+
+			@param1 a_framebuffer is the framebuffer.
+	*/
+	void SceneTarget::copyOut(int a_framebuffer) const
+	{
+		// Nearest is an exact copy at full size.
+		bool scaled = m_renderWidth != m_width || m_renderHeight != m_height;
+		glBlitNamedFramebuffer(m_framebuffer, a_framebuffer, 0, 0, m_renderWidth, m_renderHeight,
+			0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+	}
+
+	/**
+		destroy deletes the framebuffer and textures.
+	*/
+	void SceneTarget::destroy()
+	{
+		destroySamples();
+		RenderState& state = RenderState::instance();
+		unsigned int* textures[2] = { &m_colourTexture, &m_depthTexture };
+		for (unsigned int* texture : textures)
+		{
+			if (*texture != 0)
+			{
+				glDeleteTextures(1, texture);
+				state.onTextureDeleted(*texture);
+				GpuMemory::instance().releaseTexture(*texture);
+				*texture = 0;
+			}
+		}
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+		m_width = m_height = 0;
+		m_renderWidth = m_renderHeight = 0;
+	}
+
+	/**
+		destroySamples deletes the multisampled framebuffer and textures.
+			The number of samples is kept, for create to make them again.
+	*/
+	void SceneTarget::destroySamples()
+	{
+		RenderState& state = RenderState::instance();
+		unsigned int* textures[2] = { &m_multisampleColour, &m_multisampleDepth };
+		for (unsigned int* texture : textures)
+		{
+			if (*texture != 0)
+			{
+				glDeleteTextures(1, texture);
+				state.onTextureDeleted(*texture);
+				GpuMemory::instance().releaseTexture(*texture);
+				*texture = 0;
+			}
+		}
+		glDeleteFramebuffers(1, &m_multisampleFramebuffer);
+		m_multisampleFramebuffer = 0;
+	}
+}
@@ -0,0 +1,183 @@
+/**
+	SceneTarget.h
+
+	Purpose: SceneTarget.h is the header file for the SceneTarget class.
+			The SceneTarget is a window sized framebuffer the scene is
+			drawn into instead of the window's, for when the window's
+			depth isn't the format the scene needs or the scene is
+			drawn smaller than the window.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+namespace sns
+{
+	/**
+		The SceneTarget class owns a colour and depth target the size of
+			the window. The window's depth can't be asked for as float,
+			which reversed depth needs to be any more precise, so the
+			scene is drawn here between begin and end and end copies the
+			colour out to the window.
+
+		The colour is floating point, R11F_G11F_B10F, so the lights add up
+			past 1 and are tonemapped by PostProcess on the way to the
+			window. Copied out as it is, it is only clamped.
+
+		The depth is made with RenderState::getDepthFormat, so anything
+			else that copies the scene's depth, such as the deferred
+			renderer and the particle target, matches it.
+
+		Needs GL 4.5, without it create fails and the scene should be
+			drawn straight into the window.
+
+		With setScale below 1 the scene is drawn into the bottom left of
+			the target at that scale, and end stretches it over the
+			window with linear filtering. The target is never made
+			again for a new scale, so changing it every frame is free.
+			Everything that copies the scene's depth or colour takes its
+			size from the viewport begin sets.
+
+		With setSamples above 1 the scene is drawn into multisampled
+			colour and depth instead, and end resolves only the colour,
+			into the same texture as without. The multisampled targets
+			are invalidated once resolved, so nothing of them is kept
+			between frames, and the depth is only resolved by what
+			copies it, such as the particle target. getDepthTexture
+			isn't drawn into while multisampled.
+	*/
+	class SceneTarget
+	{
+	public:
+		SceneTarget();
+
+		/**
+			The deconstructor deletes the framebuffer and textures.
+		*/
+		~SceneTarget();
+
+		SceneTarget(const SceneTarget&) = delete;
+		SceneTarget& operator=(const SceneTarget&) = delete;
+
+		/**
+			create makes the framebuffer.
+
+				@param1 a_width is the width of the window.
+
+				@param2 a_height is the height of the window.
+
+				@return false without GL 4.5, the target is left
+						uncreated.
+		*/
+		bool create(int a_width, int a_height);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_framebuffer != 0; }
+
+		/**
+			setScale sets how much of the width and height of the target
+				the scene is drawn into, from the next begin.
+
+				@param1 a_scale is the scale, up to 1.
+		*/
+		void setScale(float a_scale);
+
+		/**
+			setSamples makes the multisampled targets the scene is drawn
+				into, or deletes them.
+
+				@param1 a_samples is how many samples a pixel has, 1 for
+						none.
+
+				@return false if the targets couldn't be made, the scene
+						is left drawn without samples.
+		*/
+		bool setSamples(int a_samples);
+
+		/**
+			getSamples returns how many samples a pixel has.
+		*/
+		int getSamples() const { return m_samples; }
+
+		/**
+			getScale returns how much of the width and height of the
+				target the scene is drawn into.
+		*/
+		float getScale() const { return m_scale; }
+
+		/**
+			getRenderWidth returns how wide the scene is drawn.
+		*/
+		int getRenderWidth() const { return m_renderWidth; }
+
+		/**
+			getRenderHeight returns how high the scene is drawn.
+		*/
+		int getRenderHeight() const { return m_renderHeight; }
+
+		/**
+			getColourTexture and getDepthTexture return what the scene
+				is drawn into.
+		*/
+		unsigned int getColourTexture() const { return m_colourTexture; }
+		unsigned int getDepthTexture() const { return m_depthTexture; }
+
+		/**
+			begin binds the framebuffer and sets the viewport to the
+				part of it the scene is drawn into. It isn't cleared,
+				the frame's clear after it clears it instead of the
+				window.
+		*/
+		void begin();
+
+		/**
+			end resolves the samples, if there are any, then copies the
+				colour to the framebuffer bound before begin, scaled up
+				to the target's size, and binds that and the viewport
+				again.
+
+				@param1 a_copy is false to only bind them again, for
+						something else to copy the scene out.
+		*/
+		void end(bool a_copy = true);
+
+		/**
+			present copies the colour to the bound framebuffer again as
+				end did, without anything being drawn into it, to show
+				the last frame again.
+		*/
+		void present();
+
+	private:
+		// Deletes the framebuffer and textures, or the multisampled ones.
+		void destroy();
+		void destroySamples();
+
+		// Copies the colour over a framebuffer the target's size.
+		void copyOut(int a_framebuffer) const;
+
+		unsigned int m_framebuffer;
+		unsigned int m_colourTexture;
+		unsigned int m_depthTexture;
+
+		// What the scene is drawn into with more than one sample.
+		int m_samples;
+		unsigned int m_multisampleFramebuffer;
+		unsigned int m_multisampleColour;
+		unsigned int m_multisampleDepth;
+
+		int m_width;
+		int m_height;
+
+		// The part of the target the scene is drawn into.
+		float m_scale;
+		int m_renderWidth;
+		int m_renderHeight;
+
+		// The framebuffer and viewport bound before begin.
+		int m_previousFramebuffer;
+		int m_previousViewport[4];
+	};
+}
@@ -0,0 +1,369 @@
+/**
+	ScreenSpaceReflections.cpp
+
+	Purpose: ScreenSpaceReflections.cpp is the source file for the
+			ScreenSpaceReflections class. The ScreenSpaceReflections
+			reflects the lit scene in its glossy surfaces by tracing
+			through its own depth, at half the size and blended over
+			frames, so the floor and the metal catch what is around
+			them for a small part of the frame.
+
+	@author Nathan Nette
+*/
+#include "ScreenSpaceReflections.h"
+#include "DeferredRenderer.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "SamplerCache.h"
+#include "Sky.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	// Must match local_size in the shaders.
+	static const int GROUP_SIZE = 8;
+
+	// The units the passes read from, and the image each writes.
+	static const unsigned int DEPTH_UNIT = 0;
+	static const unsigned int NORMAL_UNIT = 1;
+	static const unsigned int SPECULAR_UNIT = 2;
+	static const unsigned int PYRAMID_UNIT = 3;
+	static const unsigned int LIT_UNIT = 4;
+	static const unsigned int SKY_UNIT = 4;
+	static const unsigned int TRACE_UNIT = 5;
+	static const unsigned int HISTORY_UNIT = 6;
+	static const unsigned int DESTINATION_IMAGE = 0;
+
+	// What the reflections are kept in, and the depth.
+	static const unsigned int FORMAT = GL_RGBA16F;
+	static const unsigned int DEPTH_FORMAT = GL_R32F;
+
+	// How far behind a surface, as a part of its view depth, a ray can
+	//	pass and still have hit it.
+	static const float THICKNESS = 0.05f;
+
+	/**
+		What a quality traces, and how much of the history it keeps.
+	*/
+	struct Tier
+	{
+		const char* name;
+		int iterations;
+		int levels;
+		float history;
+	};
+
+	static const Tier TIERS[(int)ReflectionQuality::COUNT] =
+	{
+		{ "off", 0, 0, 0.0f },
+		{ "low", 24, 4, 0.8f },
+		{ "medium", 48, 6, 0.9f },
+		{ "high", 96, ScreenSpaceReflections::MAX_LEVELS, 0.95f },
+	};
+
+	// The pixel of each four traced each frame, the opposite corner
+	//	after the first so two frames already cover both diagonals.
+	static const glm::vec2 OFFSETS[4] = { glm::vec2(0, 0), glm::vec2(1, 1), glm::vec2(1, 0), glm::vec2(0, 1) };
+
+	ScreenSpaceReflections::ScreenSpaceReflections()
+		: m_width(0),
+		m_height(0),
+		m_levelCount(0),
+		m_current(0),
+		m_previousProjectionView(1.0f),
+		m_previousRenderSize(0.0f),
+		m_hasHistory(false),
+		m_frame(0),
+		m_sampler(0),
+		m_quality(ReflectionQuality::MEDIUM)
+	{
+	}
+
+	/**
+		create makes the half sized textures and loads the shaders. The
+			pyramid keeps the nearest depth, which is the largest when
+			depth is reversed.
+
+			@param1 a_width is the width of the g-buffer.
+
+			@param2 a_height is the height of the g-buffer.
+
+			@return false without GL 4.3 or the shaders, it is left
+					uncreated.
+	*/
+	bool ScreenSpaceReflections::create(int a_width, int a_height)
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("ScreenSpaceReflections: screen space reflections need GL 4.3.\n");
+			return false;
+		}
+		if (m_downsampler.create(DEPTH_FORMAT,
+			RenderState::instance().isReverseZ() ? MipDownsampler::MAX : MipDownsampler::MIN) == false)
+			return false;
+
+		m_depthShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/reflectionDepth.comp");
+		m_traceShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/reflectionTrace.comp");
+		m_temporalShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/reflectionTemporal.comp");
+		m_compositeShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/reflectionComposite.comp");
+		aie::ShaderProgram* programs[] = { &m_depthShader, &m_traceShader, &m_temporalShader, &m_compositeShader };
+		for (aie::ShaderProgram* program : programs)
+		{
+			if (program->link() == false)
+			{
+				printf("Shader Error: %s\n", program->getLastError());
+				return false;
+			}
+		}
+
+		m_width = (a_width > 1 ? a_width + 1 : 2) / 2;
+		m_height = (a_height > 1 ? a_height + 1 : 2) / 2;
+		m_levelCount = 1;
+		for (int size = m_width > m_height ? m_width : m_height; size > 1 && m_levelCount < MAX_LEVELS; size /= 2)
+			++m_levelCount;
+
+		// The pyramid is only read with texelFetch, at its own levels.
+		GpuMemory& memory = GpuMemory::instance();
+		glCreateTextures(GL_TEXTURE_2D, 1, m_pyramid.put());
+		glTextureStorage2D(m_pyramid, m_levelCount, DEPTH_FORMAT, m_width, m_height);
+		glTextureParameteri(m_pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(m_pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		memory.trackTexture(m_pyramid, GpuMemory::getTextureBytes(DEPTH_FORMAT, m_width, m_height, 1, m_levelCount),
+			GpuMemory::RENDER_TARGETS, "ScreenSpaceReflections");
+
+		TextureHandle* textures[3] = { &m_trace, &m_history[0], &m_history[1] };
+		for (TextureHandle* texture : textures)
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, texture->put());
+			glTextureStorage2D(*texture, 1, FORMAT, m_width, m_height);
+			memory.trackTexture(*texture, GpuMemory::getTextureBytes(FORMAT, m_width, m_height),
+				GpuMemory::RENDER_TARGETS, "ScreenSpaceReflections");
+		}
+		m_sampler = SamplerCache::instance().get({ GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, false });
+		m_hasHistory = false;
+		return true;
+	}
+
+	/**
+		apply traces the reflections of a lit g-buffer and adds them into
+			its lit scene, before it is presented. The pyramid is built
+			from the g-buffer's depth, each texel of the half sized trace
+			is traced from one of its pixels, blended into the history,
+			and the history is added to every pixel of the lit scene.
+
+			@param1 a_scene is the deferred renderer, lit this frame.
+
+			@param2 a_sky is the sky the reflections fall back to.
+
+			@param3 a_sunColour is the colour the sun lights the scene,
+					which lights the sky.
+
+			@param4 a_view is the camera's view.
+
+			@param5 a_projection is the camera's projection.
+
+			@param6 a_nearPlane is the camera's near plane.
+
+			@param7 a_reproject is whether last frame's reflections were
+					for this camera, and can be blended in.
+	*/
+	void ScreenSpaceReflections::apply(const DeferredRenderer& a_scene, const Sky& a_sky, const glm::vec3& a_sunColour,
+		const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, bool a_reproject)
+	{
+		static constexpr aie::UniformHandle GBUFFER_DEPTH("GBufferDepth");
+		static constexpr aie::UniformHandle GBUFFER_NORMAL("GBufferNormal");
+		static constexpr aie::UniformHandle GBUFFER_SPECULAR("GBufferSpecular");
+		static constexpr aie::UniformHandle DEPTH_PYRAMID("DepthPyramid");
+		static constexpr aie::UniformHandle LIT("Lit");
+		static constexpr aie::UniformHandle TRACE("Trace");
+		static constexpr aie::UniformHandle HISTORY("History");
+		static constexpr aie::UniformHandle REFLECTIONS("Reflections");
+		static constexpr aie::UniformHandle PROJECTION("Projection");
+		static constexpr aie::UniformHandle INVERSE_PROJECTION("InverseProjection");
+		static constexpr aie::UniformHandle VIEW("View");
+		static constexpr aie::UniformHandle INVERSE_VIEW("InverseView");
+		static constexpr aie::UniformHandle PREVIOUS_PROJECTION_VIEW("PreviousProjectionView");
+		static constexpr aie::UniformHandle DEPTH_TO_NDC("DepthToNdc");
+		static constexpr aie::UniformHandle FAR_DEPTH("FarDepth");
+		static constexpr aie::UniformHandle REVERSE_Z("ReverseZ");
+		static constexpr aie::UniformHandle RENDER_SIZE("RenderSize");
+		static constexpr aie::UniformHandle PREVIOUS_RENDER_SIZE("PreviousRenderSize");
+		static constexpr aie::UniformHandle TEXTURE_SIZE("TextureSize");
+		static constexpr aie::UniformHandle LIT_SCALE("LitScale");
+		static constexpr aie::UniformHandle REFLECTION_SCALE("ReflectionScale");
+		static constexpr aie::UniformHandle OFFSET("Offset");
+		static constexpr aie::UniformHandle MAX_ITERATIONS("MaxIterations");
+		static constexpr aie::UniformHandle MAX_LEVEL("MaxLevel");
+		static constexpr aie::UniformHandle THICKNESS_SCALE("Thickness");
+		static constexpr aie::UniformHandle NEAR_PLANE("Near");
+		static constexpr aie::UniformHandle HISTORY_WEIGHT("HistoryWeight");
+		static constexpr aie::UniformHandle INTENSITY("Intensity");
+		static constexpr aie::UniformHandle SKY_FALLBACK("SkyFallback");
+
+		if (isEnabled() == false || a_scene.isCreated() == false)
+			return;
+		const Tier& tier = TIERS[(int)m_quality];
+
+		glm::vec2 renderSize((float)a_scene.getRenderWidth(), (float)a_scene.getRenderHeight());
+		glm::vec2 sceneSize((float)a_scene.getWidth(), (float)a_scene.getHeight());
+		glm::vec2 textureSize((float)m_width, (float)m_height);
+		int width = (a_scene.getRenderWidth() + 1) / 2;
+		int height = (a_scene.getRenderHeight() + 1) / 2;
+		int groupsX = (width + GROUP_SIZE - 1) / GROUP_SIZE;
+		int groupsY = (height + GROUP_SIZE - 1) / GROUP_SIZE;
+
+		RenderState& state = RenderState::instance();
+		glm::vec2 depthToNdc = state.isReverseZ() ? glm::vec2(1, 0) : glm::vec2(2, -1);
+		glm::mat4 inverseProjection = glm::inverse(a_projection);
+		glm::mat4 inverseView = glm::inverse(a_view);
+
+		// The lighting pass wrote the lit scene as an image.
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		state.bindTexture(DEPTH_UNIT, a_scene.getDepthTexture());
+		state.bindTexture(NORMAL_UNIT, a_scene.getNormalTexture());
+		state.bindTexture(SPECULAR_UNIT, a_scene.getSpecularTexture());
+
+		m_depthShader.bind();
+		m_depthShader.bindUniform(GBUFFER_DEPTH, (int)DEPTH_UNIT);
+		m_depthShader.bindUniform(RENDER_SIZE, renderSize);
+		m_depthShader.bindUniform(REVERSE_Z, state.isReverseZ() ? 1 : 0);
+		m_depthShader.bindUniform(FAR_DEPTH, state.getFarDepth());
+		glBindImageTexture(DESTINATION_IMAGE, m_pyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, DEPTH_FORMAT);
+		glDispatchCompute(groupsX, groupsY, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		m_downsampler.downsample(m_pyramid, m_width, m_height, m_levelCount);
+
+		m_traceShader.bind();
+		m_traceShader.bindUniform(GBUFFER_DEPTH, (int)DEPTH_UNIT);
+		m_traceShader.bindUniform(GBUFFER_NORMAL, (int)NORMAL_UNIT);
+		m_traceShader.bindUniform(GBUFFER_SPECULAR, (int)SPECULAR_UNIT);
+		m_traceShader.bindUniform(DEPTH_PYRAMID, (int)PYRAMID_UNIT);
+		m_traceShader.bindUniform(LIT, (int)LIT_UNIT);
+		m_traceShader.bindUniform(PROJECTION, a_projection);
+		m_traceShader.bindUniform(INVERSE_PROJECTION, inverseProjection);
+		m_traceShader.bindUniform(VIEW, a_view);
+		m_traceShader.bindUniform(DEPTH_TO_NDC, depthToNdc);
+		m_traceShader.bindUniform(FAR_DEPTH, state.getFarDepth());
+		m_traceShader.bindUniform(REVERSE_Z, state.isReverseZ() ? 1 : 0);
+		m_traceShader.bindUniform(RENDER_SIZE, renderSize);
+		m_traceShader.bindUniform(LIT_SCALE, renderSize / sceneSize);
+		m_traceShader.bindUniform(OFFSET, OFFSETS[m_frame++ % 4]);
+		m_traceShader.bindUniform(MAX_ITERATIONS, tier.iterations);
+		m_traceShader.bindUniform(MAX_LEVEL, (tier.levels < m_levelCount ? tier.levels : m_levelCount) - 1);
+		m_traceShader.bindUniform(THICKNESS_SCALE, THICKNESS);
+		m_traceShader.bindUniform(NEAR_PLANE, a_nearPlane);
+		state.bindTexture(PYRAMID_UNIT, m_pyramid);
+		state.bindTexture(LIT_UNIT, a_scene.getLitTexture(), m_sampler);
+		glBindImageTexture(DESTINATION_IMAGE, m_trace, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute(groupsX, groupsY, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		// The history is read where it was written last frame, and this
+		//	frame's blend goes in the other texture.
+		unsigned int previous = m_current;
+		m_current = 1 - m_current;
+		bool reproject = a_reproject && m_hasHistory;
+		m_temporalShader.bind();
+		m_temporalShader.bindUniform(TRACE, (int)TRACE_UNIT);
+		m_temporalShader.bindUniform(HISTORY, (int)HISTORY_UNIT);
+		m_temporalShader.bindUniform(DEPTH_PYRAMID, (int)PYRAMID_UNIT);
+		m_temporalShader.bindUniform(INVERSE_PROJECTION, inverseProjection);
+		m_temporalShader.bindUniform(INVERSE_VIEW, inverseView);
+		m_temporalShader.bindUniform(PREVIOUS_PROJECTION_VIEW, m_previousProjectionView);
+		m_temporalShader.bindUniform(DEPTH_TO_NDC, depthToNdc);
+		m_temporalShader.bindUniform(FAR_DEPTH, state.getFarDepth());
+		m_temporalShader.bindUniform(RENDER_SIZE, renderSize);
+		m_temporalShader.bindUniform(PREVIOUS_RENDER_SIZE, m_previousRenderSize);
+		m_temporalShader.bindUniform(TEXTURE_SIZE, textureSize);
+		m_temporalShader.bindUniform(HISTORY_WEIGHT, reproject ? tier.history : 0.0f);
+		state.bindTexture(TRACE_UNIT, m_trace);
+		state.bindTexture(HISTORY_UNIT, m_history[previous], m_sampler);
+		glBindImageTexture(DESTINATION_IMAGE, m_history[m_current], 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute(groupsX, groupsY, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		m_compositeShader.bind();
+		m_compositeShader.bindUniform(GBUFFER_DEPTH, (int)DEPTH_UNIT);
+		m_compositeShader.bindUniform(GBUFFER_NORMAL, (int)NORMAL_UNIT);
+		m_compositeShader.bindUniform(GBUFFER_SPECULAR, (int)SPECULAR_UNIT);
+		m_compositeShader.bindUniform(REFLECTIONS, (int)TRACE_UNIT);
+		m_compositeShader.bindUniform(INVERSE_PROJECTION, inverseProjection);
+		m_compositeShader.bindUniform(INVERSE_VIEW, inverseView);
+		m_compositeShader.bindUniform(DEPTH_TO_NDC, depthToNdc);
+		m_compositeShader.bindUniform(FAR_DEPTH, state.getFarDepth());
+		m_compositeShader.bindUniform(RENDER_SIZE, renderSize);
+		m_compositeShader.bindUniform(REFLECTION_SCALE, renderSize * 0.5f / textureSize);
+		m_compositeShader.bindUniform(INTENSITY, 1.0f);
+		state.bindTexture(LIT_UNIT, 0);
+		bool sky = a_sky.bind(m_compositeShader, SKY_UNIT, a_sunColour);
+		m_compositeShader.bindUniform(SKY_FALLBACK, sky ? 1 : 0);
+		state.bindTexture(TRACE_UNIT, m_history[m_current], m_sampler);
+		glBindImageTexture(DESTINATION_IMAGE, a_scene.getLitTexture(), 0, GL_FALSE, 0, GL_READ_WRITE, FORMAT);
+		glDispatchCompute((a_scene.getRenderWidth() + GROUP_SIZE - 1) / GROUP_SIZE,
+			(a_scene.getRenderHeight() + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+		// present blits the result.
+		glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+		m_previousProjectionView = a_projection * a_view;
+		m_previousRenderSize = renderSize;
+		m_hasHistory = true;
+
+		// Materials bind these units next, the render state must not
+		//	think any of these are still on them.
+		unsigned int units[] = { DEPTH_UNIT, NORMAL_UNIT, SPECULAR_UNIT, PYRAMID_UNIT, SKY_UNIT, TRACE_UNIT,
+			HISTORY_UNIT };
+		for (unsigned int unit : units)
+			state.bindTexture(unit, 0);
+	}
+
+	/**
+		setQuality sets how much the reflections may cost. A new quality
+			starts from no history.
+
+			@param1 a_quality is the quality, OFF for none.
+	*/
+	void ScreenSpaceReflections::setQuality(ReflectionQuality a_quality)
+	{
+		if (a_quality != m_quality)
+			m_hasHistory = false;
+		m_quality = a_quality;
+	}
+
+	/**
+		getQualityName returns a quality's name, as configs give it.
+
+			@param1 a_quality is the quality.
+	*/
+	const char* ScreenSpaceReflections::getQualityName(ReflectionQuality a_quality)
+	{
+		return TIERS[(int)a_quality].name;
+	}
+
+	/**
+		findQuality finds a quality from its name.
+
+			@param1 a_name is the name, "off", "low", "medium" or "high".
+
+			@param2 a_quality is set to the quality.
+
+			@return false if no quality has the name.
+	*/
+	bool ScreenSpaceReflections::findQuality(const char* a_name, ReflectionQuality& a_quality)
+	{
+		for (int i = 0; i < (int)ReflectionQuality::COUNT; ++i)
+		{
+			if (strcmp(a_name, TIERS[i].name) == 0)
+			{
+				a_quality = (ReflectionQuality)i;
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,197 @@
+/**
+	ScreenSpaceReflections.h
+
+	Purpose: ScreenSpaceReflections.h is the header file for the
+			ScreenSpaceReflections class. The ScreenSpaceReflections
+			reflects the lit scene in its glossy surfaces by tracing
+			through its own depth, at half the size and blended over
+			frames, so the floor and the metal catch what is around
+			them for a small part of the frame.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "MipDownsampler.h"
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace sns
+{
+	class DeferredRenderer;
+	class Sky;
+
+	/**
+		How much the reflections may cost.
+	*/
+	enum class ReflectionQuality
+	{
+		// None are traced, and a run started without them makes nothing
+		//	for them.
+		OFF,
+
+		// Short rays through a shallow pyramid, and a history that
+		//	forgets quickly.
+		LOW,
+
+		// Between the two.
+		MEDIUM,
+
+		// Long rays through the whole pyramid, and a history that keeps
+		//	more.
+		HIGH,
+
+		COUNT
+	};
+
+	/**
+		The ScreenSpaceReflections class traces a reflection for every
+			four pixels of a DeferredRenderer's g-buffer, between its
+			light and present, and adds them into its lit scene.
+
+		The g-buffer's depth is kept at half its size as a pyramid, each
+			texel the nearest of those under it. Each ray is stepped
+			through it in screen space, where depth is linear along the
+			ray, climbing to coarser levels through open space and back
+			down where it may be behind something, until it hits the
+			depth at the finest level or leaves the screen. What the lit
+			scene holds where it hit is what is reflected, less trusted
+			towards the screen's edges and the last steps.
+
+		Each frame traces a different one of the four pixels under each
+			texel, and blends what it found into the history, reprojected
+			from where the surface was last frame and clamped to what was
+			traced around it, so the four are filled in over frames and
+			the noise of the hits averages out. Where the trace wasn't
+			trusted the Sky fills in, the way the ray would have gone on,
+			until there are reflection probes to fall back to.
+
+		Only the deferred path has the normals and gloss to trace from,
+			so forward shaded frames aren't reflected. Needs GL 4.3,
+			without it create fails and nothing is reflected.
+	*/
+	class ScreenSpaceReflections
+	{
+	public:
+		// The most levels of the depth pyramid, the coarsest of which a
+		//	ray steps 128 texels at a time through.
+		static const int MAX_LEVELS = 8;
+
+		ScreenSpaceReflections();
+
+		ScreenSpaceReflections(const ScreenSpaceReflections&) = delete;
+		ScreenSpaceReflections& operator=(const ScreenSpaceReflections&) = delete;
+
+		/**
+			create makes the half sized textures and loads the shaders.
+
+				@param1 a_width is the width of the g-buffer.
+
+				@param2 a_height is the height of the g-buffer.
+
+				@return false without GL 4.3 or the shaders, it is left
+						uncreated.
+		*/
+		bool create(int a_width, int a_height);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_trace != 0; }
+
+		/**
+			apply traces the reflections of a lit g-buffer and adds them
+				into its lit scene, before it is presented.
+
+				@param1 a_scene is the deferred renderer, lit this frame.
+
+				@param2 a_sky is the sky the reflections fall back to.
+
+				@param3 a_sunColour is the colour the sun lights the
+						scene, which lights the sky.
+
+				@param4 a_view is the camera's view.
+
+				@param5 a_projection is the camera's projection.
+
+				@param6 a_nearPlane is the camera's near plane.
+
+				@param7 a_reproject is whether last frame's reflections
+						were for this camera, and can be blended in.
+		*/
+		void apply(const DeferredRenderer& a_scene, const Sky& a_sky, const glm::vec3& a_sunColour,
+			const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, bool a_reproject);
+
+		/**
+			setQuality sets how much the reflections may cost. A new
+				quality starts from no history.
+
+				@param1 a_quality is the quality, OFF for none.
+		*/
+		void setQuality(ReflectionQuality a_quality);
+
+		/**
+			getQuality returns how much the reflections may cost.
+		*/
+		ReflectionQuality getQuality() const { return m_quality; }
+
+		/**
+			isEnabled returns whether there are reflections, and they are
+				created.
+		*/
+		bool isEnabled() const { return m_quality != ReflectionQuality::OFF && isCreated(); }
+
+		/**
+			getQualityName returns a quality's name, as configs give it.
+
+				@param1 a_quality is the quality.
+		*/
+		static const char* getQualityName(ReflectionQuality a_quality);
+
+		/**
+			findQuality finds a quality from its name.
+
+				@param1 a_name is the name, "off", "low", "medium" or
+						"high".
+
+				@param2 a_quality is set to the quality.
+
+				@return false if no quality has the name.
+		*/
+		static bool findQuality(const char* a_name, ReflectionQuality& a_quality);
+
+	private:
+		aie::ShaderProgram m_depthShader;
+		aie::ShaderProgram m_traceShader;
+		aie::ShaderProgram m_temporalShader;
+		aie::ShaderProgram m_compositeShader;
+		MipDownsampler m_downsampler;
+
+		// The nearest depth, what this frame traced, and the blend of the
+		//	traces this frame's and last frame's in turn, all half sized.
+		TextureHandle m_pyramid;
+		TextureHandle m_trace;
+		TextureHandle m_history[2];
+		int m_width;
+		int m_height;
+		int m_levelCount;
+		unsigned int m_current;
+
+		// The camera and the part of the g-buffer last frame's history
+		//	was for, and whether there is one.
+		glm::mat4 m_previousProjectionView;
+		glm::vec2 m_previousRenderSize;
+		bool m_hasHistory;
+
+		// Which of the four pixels this frame traces.
+		unsigned int m_frame;
+
+		// Filtered and clamped, the history and the lit scene are read
+		//	between texels.
+		unsigned int m_sampler;
+
+		ReflectionQuality m_quality;
+	};
+}
@@ -0,0 +1,478 @@
+/**
+	SdfFont.cpp
+
+	Purpose: SdfFont.cpp is the source file for the SdfFont class. The
+			SdfFont is a font whose glyphs are stored as signed distance
+			fields, built offline from a sheet of glyphs and drawn
+			through a SpriteBatch, so text stays sharp at any size.
+
+	@author Nathan Nette
+*/
+#include "SdfFont.h"
+#include "FileSystem.h"
+#include "GpuMemory.h"
+#include "ImageDecoder.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace sns
+{
+	// What stands in for no distance yet in the distance transform.
+	static const float FAR_AWAY = 1e20f;
+
+	// How far out and in from a glyph's edge its field reaches, as a
+	//	part of the sheet's line.
+	static const float SPREAD = 0.125f;
+
+	// The space between fitted glyphs, and a space's advance when the
+	//	sheet's is blank, as a part of a line.
+	static const float GLYPH_SPACING = 0.08f;
+	static const float SPACE_ADVANCE = 0.3f;
+
+	/**
+		distanceTransform1D finds, for every sample of a row, the least of
+			the squared distance to each other sample plus that sample's
+			value, after Felzenszwalb and Huttenlocher. It is the lower
+			envelope of the parabolas rooted at each sample.
+
+			@param1 a_values is the row, 0 where the distance is to and
+					FAR_AWAY elsewhere, or the last pass's distances.
+
+			@param2 a_distances is given the squared distances.
+
+			@param3 a_count is the row's length.
+
+			@param4 a_roots is scratch for a_count of the envelope's
+					parabolas.
+
+			@param5 a_bounds is scratch for a_count + 1 of where each
+					parabola is lowest from.
+	*/
+	static void distanceTransform1D(const float* a_values, float* a_distances, int a_count, int* a_roots,
+		float* a_bounds)
+	{
+		int k = 0;
+		a_roots[0] = 0;
+		a_bounds[0] = -FAR_AWAY;
+		a_bounds[1] = FAR_AWAY;
+		for (int q = 1; q < a_count; ++q)
+		{
+			float s = 0.0f;
+			for (;;)
+			{
+				int p = a_roots[k];
+				s = ((a_values[q] + q * q) - (a_values[p] + p * p)) / (2.0f * q - 2.0f * p);
+				if (s > a_bounds[k] || k == 0)
+					break;
+				--k;
+			}
+			++k;
+			a_roots[k] = q;
+			a_bounds[k] = s;
+			a_bounds[k + 1] = FAR_AWAY;
+		}
+
+		k = 0;
+		for (int q = 0; q < a_count; ++q)
+		{
+			while (a_bounds[k + 1] < q)
+				++k;
+			int p = a_roots[k];
+			a_distances[q] = (float)((q - p) * (q - p)) + a_values[p];
+		}
+	}
+
+	/**
+		distanceTransform finds every texel's squared distance to the
+			nearest texel marked, down the columns and then along the
+			rows.
+
+			@param1 a_grid is 0 where texels are marked and FAR_AWAY
+					elsewhere, and is given the squared distances.
+
+			@param2 a_width is the grid's width.
+
+			@param3 a_height is its height.
+	*/
+	static void distanceTransform(std::vector<float>& a_grid, int a_width, int a_height)
+	{
+		int longest = std::max(a_width, a_height);
+		std::vector<float> line(longest);
+		std::vector<float> distances(longest);
+		std::vector<int> roots(longest);
+		std::vector<float> bounds(longest + 1);
+		for (int x = 0; x < a_width; ++x)
+		{
+			for (int y = 0; y < a_height; ++y)
+				line[y] = a_grid[(size_t)y * a_width + x];
+			distanceTransform1D(line.data(), distances.data(), a_height, roots.data(), bounds.data());
+			for (int y = 0; y < a_height; ++y)
+				a_grid[(size_t)y * a_width + x] = distances[y];
+		}
+		for (int y = 0; y < a_height; ++y)
+		{
+			float* row = &a_grid[(size_t)y * a_width];
+			memcpy(line.data(), row, a_width * sizeof(float));
+			distanceTransform1D(line.data(), row, a_width, roots.data(), bounds.data());
+		}
+	}
+
+	SdfFont::SdfFont()
+		: m_header(),
+		m_glyphs(),
+		m_texture(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the atlas, see destroy.
+	*/
+	SdfFont::~SdfFont()
+	{
+		destroy();
+	}
+
+	/**
+		build makes a font file of a sheet of glyphs. Each glyph's cell is
+			given a border as wide as the field's spread, its exact
+			distance to the edge found inside and out, and that resampled
+			to the atlas's size, so the atlas can be far smaller than the
+			sheet. A fitted glyph's quad is only as wide as its ink and
+			the spread either side.
+
+			@param1 a_image is the sheet, any format the ImageDecoder
+					reads.
+
+			@param2 a_output is the path of the font file to write.
+
+			@param3 a_glyphSize is how many atlas texels high a line is.
+
+			@param4 a_monospace gives every glyph its whole cell and the
+					same advance, instead of fitting them to their ink.
+
+			@return false if the sheet can't be read or the file written.
+	*/
+	bool SdfFont::build(const char* a_image, const char* a_output, unsigned int a_glyphSize, bool a_monospace)
+	{
+		FileView view;
+		if (FileSystem::instance().open(a_image, view) == false)
+		{
+			printf("SdfFont: %s can't be opened.\n", a_image);
+			return false;
+		}
+		ImageDecoder::Info info;
+		unsigned char* pixels = ImageDecoder::decodeImage(view.getData(), view.getSize(), info);
+		view.close();
+		if (pixels == nullptr)
+		{
+			printf("SdfFont: %s can't be decoded.\n", a_image);
+			return false;
+		}
+
+		int cellWidth = (int)(info.width / SHEET_COLUMNS);
+		int cellHeight = (int)(info.height / SHEET_ROWS);
+		if (cellWidth == 0 || cellHeight == 0 || a_glyphSize == 0)
+		{
+			printf("SdfFont: %s is too small for %ux%u glyphs.\n", a_image, SHEET_COLUMNS, SHEET_ROWS);
+			free(pixels);
+			return false;
+		}
+
+		// Inked where it is opaque if there is alpha, or bright if not.
+		std::vector<unsigned char> ink((size_t)info.width * info.height);
+		for (size_t i = 0; i < ink.size(); ++i)
+		{
+			const unsigned char* pixel = pixels + i * info.channels;
+			unsigned char coverage = info.channels == 2 || info.channels == 4 ? pixel[info.channels - 1] : pixel[0];
+			ink[i] = coverage >= 128 ? 1 : 0;
+		}
+		free(pixels);
+
+		int spread = std::max(1, (int)std::ceil(cellHeight * SPREAD));
+		float scale = (float)a_glyphSize / cellHeight;
+		int paddedWidth = cellWidth + spread * 2;
+		int paddedHeight = cellHeight + spread * 2;
+		int outputWidth = (int)std::ceil(paddedWidth * scale);
+		int outputHeight = (int)std::ceil(paddedHeight * scale);
+
+		Header header = {};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.width = outputWidth * SHEET_COLUMNS;
+		header.height = outputHeight * SHEET_ROWS;
+		header.channels = 1;
+		header.distanceRange = spread * 2.0f * scale;
+		header.lineHeight = 1.0f;
+
+		std::vector<unsigned char> texels((size_t)header.width * header.height);
+		std::vector<Glyph> glyphs(GLYPH_COUNT);
+		std::vector<float> outside((size_t)paddedWidth * paddedHeight);
+		std::vector<float> inside(outside.size());
+		for (unsigned int g = 0; g < GLYPH_COUNT; ++g)
+		{
+			int column = (int)(g % SHEET_COLUMNS);
+			int row = (int)(g / SHEET_COLUMNS);
+			int inkLeft = cellWidth;
+			int inkRight = 0;
+			for (int y = 0; y < paddedHeight; ++y)
+			{
+				for (int x = 0; x < paddedWidth; ++x)
+				{
+					int cellX = x - spread;
+					int cellY = y - spread;
+					bool inked = cellX >= 0 && cellX < cellWidth && cellY >= 0 && cellY < cellHeight &&
+						ink[(size_t)(row * cellHeight + cellY) * info.width + column * cellWidth + cellX] != 0;
+					outside[(size_t)y * paddedWidth + x] = inked ? 0.0f : FAR_AWAY;
+					inside[(size_t)y * paddedWidth + x] = inked ? FAR_AWAY : 0.0f;
+					if (inked)
+					{
+						inkLeft = std::min(inkLeft, cellX);
+						inkRight = std::max(inkRight, cellX + 1);
+					}
+				}
+			}
+
+			// How far each texel is from the nearest inked texel, and the
+			//	inked ones from the nearest blank one.
+			distanceTransform(outside, paddedWidth, paddedHeight);
+			distanceTransform(inside, paddedWidth, paddedHeight);
+
+			// The atlas holds the sheet's top row of cells at its top, and
+			//	its rows from the bottom.
+			int atlasX = column * outputWidth;
+			int atlasY = (int)(SHEET_ROWS - 1 - row) * outputHeight;
+			for (int ty = 0; ty < outputHeight; ++ty)
+			{
+				float fy = (outputHeight - 1 - ty + 0.5f) / scale - 0.5f;
+				int y = std::min(std::max((int)std::floor(fy + 0.5f), 0), paddedHeight - 1);
+				for (int tx = 0; tx < outputWidth; ++tx)
+				{
+					float fx = (tx + 0.5f) / scale - 0.5f;
+					int x = std::min(std::max((int)std::floor(fx + 0.5f), 0), paddedWidth - 1);
+					size_t index = (size_t)y * paddedWidth + x;
+
+					// Half a texel either side of the edge, which lies
+					//	between an inked texel and a blank one.
+					float distance = outside[index] > 0.0f ? 0.5f - std::sqrt(outside[index]) :
+						std::sqrt(inside[index]) - 0.5f;
+					float value = std::min(std::max(0.5f + distance / (spread * 2.0f), 0.0f), 1.0f);
+					texels[(size_t)(atlasY + ty) * header.width + atlasX + tx] = (unsigned char)(value * 255.0f + 0.5f);
+				}
+			}
+
+			Glyph& glyph = glyphs[g];
+			glyph = {};
+			bool blank = inkRight <= inkLeft;
+			if (a_monospace)
+			{
+				inkLeft = 0;
+				inkRight = cellWidth;
+			}
+			if (blank)
+			{
+				glyph.advance = a_monospace ? (float)cellWidth / cellHeight : SPACE_ADVANCE;
+				continue;
+			}
+
+			// The quad covers the ink and the spread either side, the pen
+			//	a half space before the ink when fitted.
+			float bearing = a_monospace ? 0.0f : GLYPH_SPACING * 0.5f;
+			float inkWidth = (float)(inkRight - inkLeft) / cellHeight;
+			float border = (float)spread / cellHeight;
+			glyph.advance = a_monospace ? (float)cellWidth / cellHeight : inkWidth + GLYPH_SPACING;
+			glyph.bounds = glm::vec4(bearing - border, -1.0f - border, bearing + inkWidth + border, border);
+			glyph.texCoords = glm::vec4(
+				(atlasX + inkLeft * scale) / header.width,
+				(atlasY + outputHeight - paddedHeight * scale) / header.height,
+				(atlasX + (inkRight + spread * 2) * scale) / header.width,
+				(float)(atlasY + outputHeight) / header.height);
+		}
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_output, "wb");
+		if (file == nullptr)
+		{
+			printf("SdfFont: %s can't be written.\n", a_output);
+			return false;
+		}
+		bool written = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+			fwrite(glyphs.data(), sizeof(Glyph), glyphs.size(), file) == glyphs.size() &&
+			fwrite(texels.data(), 1, texels.size(), file) == texels.size();
+		fclose(file);
+		if (written == false)
+		{
+			printf("SdfFont: %s can't be written.\n", a_output);
+			return false;
+		}
+		printf("Built %s, a %ux%u atlas of %u glyphs %u texels high\n", a_output, header.width, header.height,
+			GLYPH_COUNT, a_glyphSize);
+		return true;
+	}
+
+	/**
+		load reads a font file through the FileSystem and makes its atlas,
+			filtered linearly without mipmaps, as the field is what is
+			filtered and mipmaps would blur its edge.
+
+			@param1 a_filename is the path of the font file.
+
+			@return false if it can't be read or isn't one.
+	*/
+	bool SdfFont::load(const char* a_filename)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("SdfFont: fonts need GL 4.5.\n");
+			return false;
+		}
+
+		FileView view;
+		if (FileSystem::instance().open(a_filename, view) == false)
+		{
+			printf("SdfFont: %s can't be opened.\n", a_filename);
+			return false;
+		}
+		const unsigned char* data = view.getData();
+		size_t size = view.getSize();
+		Header header = {};
+		if (size >= sizeof(Header))
+			memcpy(&header, data, sizeof(Header));
+		size_t glyphBytes = sizeof(Glyph) * GLYPH_COUNT;
+		if (size < sizeof(Header) || header.magic != MAGIC || header.version != VERSION ||
+			(header.channels != 1 && header.channels != 3) || header.width == 0 || header.height == 0 ||
+			size < sizeof(Header) + glyphBytes + (size_t)header.width * header.height * header.channels)
+		{
+			printf("SdfFont: %s isn't a version %u font file.\n", a_filename, VERSION);
+			return false;
+		}
+		m_header = header;
+		memcpy(m_glyphs, data + sizeof(Header), glyphBytes);
+
+		bool grey = header.channels == 1;
+		unsigned int format = grey ? GL_R8 : GL_RGB8;
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+		glTextureStorage2D(m_texture, 1, format, header.width, header.height);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(m_texture, 0, 0, 0, header.width, header.height, grey ? GL_RED : GL_RGB,
+			GL_UNSIGNED_BYTE, data + sizeof(Header) + glyphBytes);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (grey)
+		{
+			const int SWIZZLE[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+			glTextureParameteriv(m_texture, GL_TEXTURE_SWIZZLE_RGBA, SWIZZLE);
+		}
+		GpuMemory::instance().trackTexture(m_texture, GpuMemory::getTextureBytes(format, header.width, header.height),
+			GpuMemory::TEXTURES, "SdfFont");
+		return true;
+	}
+
+	/**
+		destroy deletes the atlas.
+	*/
+	void SdfFont::destroy()
+	{
+		if (m_texture == 0)
+			return;
+
+		glDeleteTextures(1, &m_texture);
+		RenderState::instance().onTextureDeleted(m_texture);
+		GpuMemory::instance().releaseTexture(m_texture);
+		m_texture = 0;
+	}
+
+	/**
+		addText adds a sprite for every character of a string to a batch,
+			each a quad of its glyph's bounds at the pen.
+
+			@param1 a_batch is the batch to add them to.
+
+			@param2 a_position is the top left of the first line.
+
+			@param3 a_text is the text.
+
+			@param4 a_size is how big a line is.
+
+			@param5 a_colour is the text's colour.
+
+			@param6 a_layer is the batch's layer.
+
+			@param7 a_advance moves the pen that far for every character
+					instead of the font's advances, 0 to use the font's.
+	*/
+	void SdfFont::addText(SpriteBatch& a_batch, const glm::vec2& a_position, const char* a_text, float a_size,
+		const glm::vec4& a_colour, unsigned int a_layer, float a_advance) const
+	{
+		if (isLoaded() == false)
+			return;
+
+		glm::vec2 pen = a_position;
+		for (const char* c = a_text; *c != '\0'; ++c)
+		{
+			if (*c == '\n')
+			{
+				pen = glm::vec2(a_position.x, pen.y - m_header.lineHeight * a_size);
+				continue;
+			}
+
+			const Glyph& glyph = getGlyph(*c);
+			if (glyph.bounds.z > glyph.bounds.x)
+			{
+				glm::vec2 bottomLeft = pen + glm::vec2(glyph.bounds.x, glyph.bounds.y) * a_size;
+				glm::vec2 topRight = pen + glm::vec2(glyph.bounds.z, glyph.bounds.w) * a_size;
+				a_batch.addGlyph(m_texture, (bottomLeft + topRight) * 0.5f, topRight - bottomLeft, a_colour,
+					glyph.texCoords, m_header.distanceRange, a_layer);
+			}
+			pen.x += a_advance > 0.0f ? a_advance : glyph.advance * a_size;
+		}
+	}
+
+	/**
+		measure returns how wide the longest line of a string is, and how
+			high all of its lines are.
+
+			@param1 a_text is the text.
+
+			@param2 a_size is how big a line is.
+	*/
+	glm::vec2 SdfFont::measure(const char* a_text, float a_size) const
+	{
+		float width = 0.0f;
+		float longest = 0.0f;
+		unsigned int lines = 1;
+		for (const char* c = a_text; *c != '\0'; ++c)
+		{
+			if (*c == '\n')
+			{
+				width = 0.0f;
+				++lines;
+				continue;
+			}
+			width += getGlyph(*c).advance * a_size;
+			longest = std::max(longest, width);
+		}
+		return glm::vec2(longest, lines * m_header.lineHeight * a_size);
+	}
+
+	/**
+		getGlyph returns a character's glyph, a space's for any the font
+			lacks.
+
+			@param1 a_character is the character.
+	*/
+	const SdfFont::Glyph& SdfFont::getGlyph(char a_character) const
+	{
+		unsigned int index = (unsigned char)a_character - FIRST_CHARACTER;
+		return m_glyphs[index < GLYPH_COUNT ? index : 0];
+	}
+}
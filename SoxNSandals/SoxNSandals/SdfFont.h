@@ -0,0 +1,192 @@
+/**
+	SdfFont.h
+
+	Purpose: SdfFont.h is the header file for the SdfFont class. The
+			SdfFont is a font whose glyphs are stored as signed distance
+			fields, built offline from a sheet of glyphs and drawn
+			through a SpriteBatch, so text stays sharp at any size.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SpriteBatch.h"
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+namespace sns
+{
+	/**
+		The SdfFont class keeps a font's atlas, each glyph's distance to
+			its edge, 0.5 on it and more inside, and where every glyph
+			is in the atlas and how far it moves the pen. addText adds a
+			sprite a character to a SpriteBatch, all of one texture, so
+			however much text there is it draws in a draw or two.
+
+		A font file holds the first GLYPH_COUNT characters from ' ' up.
+			Its atlas is one channel, a plain signed distance field, or
+			three, a multi-channel one as msdfgen makes, which keeps
+			corners sharp. The sprites' shader reads both the same way,
+			the median of the three channels, as a one channel atlas is
+			swizzled to red in all three.
+
+		Sizes are of a line, in whatever units the batch is drawn in,
+			and the text is placed by the top left of its first line.
+	*/
+	class SdfFont
+	{
+	public:
+		// "SNSF", and the version of the layout below.
+		static const unsigned int MAGIC = 0x46534e53;
+		static const unsigned int VERSION = 1;
+
+		// The characters a font has, from FIRST_CHARACTER.
+		static const unsigned int FIRST_CHARACTER = 32;
+		static const unsigned int GLYPH_COUNT = 96;
+
+		// A sheet build reads is this many glyphs across and down.
+		static const unsigned int SHEET_COLUMNS = 16;
+		static const unsigned int SHEET_ROWS = 6;
+
+		/**
+			A font file starts with the header, then GLYPH_COUNT glyphs,
+				then the atlas's texels, its bottom row first.
+		*/
+		struct Header
+		{
+			unsigned int magic;
+			unsigned int version;
+			unsigned int width;
+			unsigned int height;
+
+			// 1 for a signed distance field, 3 for a multi-channel one.
+			unsigned int channels;
+
+			// How many atlas texels the distance from 0 to 1 covers.
+			float distanceRange;
+
+			// How far apart lines are, in units of the size text is
+			//	drawn at.
+			float lineHeight;
+			unsigned int padding;
+		};
+
+		/**
+			A glyph, where its quad goes from the pen and where it is in
+				the atlas. The quad is from the pen's position, x to the
+				right and y up from the top of the line, in units of the
+				size text is drawn at.
+		*/
+		struct Glyph
+		{
+			float advance;
+
+			// Left, bottom, right and top. A glyph with no quad, like a
+			//	space, has them all 0.
+			glm::vec4 bounds;
+
+			// Its rectangle of the atlas, the bottom left in xy and the
+			//	top right in zw.
+			glm::vec4 texCoords;
+		};
+
+		SdfFont();
+
+		/**
+			The deconstructor deletes the atlas, see destroy.
+		*/
+		~SdfFont();
+
+		SdfFont(const SdfFont&) = delete;
+		SdfFont& operator=(const SdfFont&) = delete;
+
+		/**
+			build makes a font file of a sheet of glyphs, SHEET_COLUMNS
+				across and SHEET_ROWS down from ' ' at the top left, each
+				the same size, white or opaque where they are inked.
+
+				@param1 a_image is the sheet, any format the ImageDecoder
+						reads.
+
+				@param2 a_output is the path of the font file to write.
+
+				@param3 a_glyphSize is how many atlas texels high a line
+						is.
+
+				@param4 a_monospace gives every glyph its whole cell and
+						the same advance, instead of fitting them to their
+						ink.
+
+				@return false if the sheet can't be read or the file
+						written.
+		*/
+		static bool build(const char* a_image, const char* a_output, unsigned int a_glyphSize = 32,
+			bool a_monospace = false);
+
+		/**
+			load reads a font file through the FileSystem and makes its
+				atlas. Needs GL 4.5 for the texture.
+
+				@param1 a_filename is the path of the font file.
+
+				@return false if it can't be read or isn't one.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			isLoaded returns whether load succeeded.
+		*/
+		bool isLoaded() const { return m_texture != 0; }
+
+		/**
+			destroy deletes the atlas.
+		*/
+		void destroy();
+
+		/**
+			addText adds a sprite for every character of a string to a
+				batch. A '\n' starts a new line, and characters the font
+				doesn't have are drawn as spaces.
+
+				@param1 a_batch is the batch to add them to.
+
+				@param2 a_position is the top left of the first line.
+
+				@param3 a_text is the text.
+
+				@param4 a_size is how big a line is.
+
+				@param5 a_colour is the text's colour.
+
+				@param6 a_layer is the batch's layer.
+
+				@param7 a_advance moves the pen that far for every
+						character instead of the font's advances, for
+						columns that line up, 0 to use the font's.
+		*/
+		void addText(SpriteBatch& a_batch, const glm::vec2& a_position, const char* a_text, float a_size,
+			const glm::vec4& a_colour, unsigned int a_layer = 0, float a_advance = 0.0f) const;
+
+		/**
+			measure returns how wide the longest line of a string is, and
+				how high all of its lines are.
+
+				@param1 a_text is the text.
+
+				@param2 a_size is how big a line is.
+		*/
+		glm::vec2 measure(const char* a_text, float a_size) const;
+
+		/**
+			getLineHeight returns how far apart lines are at a size of 1.
+		*/
+		float getLineHeight() const { return m_header.lineHeight; }
+
+	private:
+		// Returns a character's glyph, a space's for any the font lacks.
+		const Glyph& getGlyph(char a_character) const;
+
+		Header m_header;
+		Glyph m_glyphs[GLYPH_COUNT];
+		unsigned int m_texture;
+	};
+}
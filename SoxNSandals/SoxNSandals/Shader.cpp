@@ -10,62 +10,361 @@
 #include <cstdio>
 #include <cassert>
 #include "gl_core_4_5.h"
+#include <glfw3.h>
+#include "RenderState.h"
+#include "FileSystem.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
 
 namespace aie {
 
-Shader::~Shader() {
-	glDeleteShader(m_handle);
+ShaderProgram::LookupStats ShaderProgram::s_lookupStats = {};
+std::vector<ShaderProgram::UniformBlockBinding> ShaderProgram::s_uniformBlockBindings;
+
+// compiled stages by the hash of their source, so programs loading the
+// same file share one compile
+static std::unordered_map<unsigned long long, std::weak_ptr<Shader>> s_compiledShaders;
+
+// program binary cache file layout:
+//   magic, version, driver string length, driver string
+//   then per program: key, binary format, binary length, binary
+static const unsigned int PROGRAM_CACHE_MAGIC = 0x50534e53; // "SNSP"
+static const unsigned int PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramBinary {
+	unsigned int		format;
+	std::vector<char>	data;
+};
+
+static std::string s_binaryCacheFile = "../shaders/programs.snscache";
+static std::unordered_map<unsigned long long, ProgramBinary> s_programBinaries;
+static bool s_programBinariesLoaded = false;
+
+// while linkAll() runs the file is only written once, after the last
+static bool s_programBinarySaveDeferred = false;
+static bool s_programBinariesChanged = false;
+
+// the same values in KHR_ and ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR	0x91B0
+#define GL_COMPLETION_STATUS_KHR			0x91B1
+#endif
+
+// NV_mesh_shader's stages
+#ifndef GL_MESH_SHADER_NV
+#define GL_MESH_SHADER_NV					0x9559
+#define GL_TASK_SHADER_NV					0x955A
+#endif
+
+typedef void (CODEGEN_FUNCPTR* MaxShaderCompilerThreadsFunction)(GLuint count);
+
+// the vendor, renderer and version, a binary only loads on the same driver
+static std::string getDriverString() {
+	std::string driver;
+	const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : names) {
+		const char* string = (const char*)glGetString(name);
+		driver += string != nullptr ? string : "";
+		driver += '\n';
+	}
+	return driver;
 }
 
-bool Shader::loadShader(unsigned int stage, const char* filename) {
-	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+// programs can only be saved when the driver has a binary format
+static bool canCacheBinaries() {
+	static int formats = -1;
+	if (formats < 0)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
 
-	m_stage = stage;
+// reads the cache file once, dropping it if another driver wrote it
+static void loadProgramBinaries() {
+	if (s_programBinariesLoaded)
+		return;
+	s_programBinariesLoaded = true;
 
-	switch (stage) {
-	case eShaderStage::VERTEX:	m_handle = glCreateShader(GL_VERTEX_SHADER);	break;
-	case eShaderStage::TESSELLATION_EVALUATION:	m_handle = glCreateShader(GL_TESS_EVALUATION_SHADER);	break;
-	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
-	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
-	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
-	default:	break;
-	};
-	
-	// open file
 	FILE* file = nullptr;
-	fopen_s(&file, filename, "rb");
-	fseek(file, 0, SEEK_END);
-	unsigned int size = ftell(file);
-	char* source = new char[size + 1];
-	fseek(file, 0, SEEK_SET);
-	fread_s(source, size + 1, sizeof(char), size, file);
+	fopen_s(&file, s_binaryCacheFile.c_str(), "rb");
+	if (file == nullptr)
+		return;
+
+	unsigned int header[3] = {};
+	bool valid = fread(header, sizeof(header), 1, file) == 1 &&
+		header[0] == PROGRAM_CACHE_MAGIC && header[1] == PROGRAM_CACHE_VERSION;
+
+	std::string driver(valid ? header[2] : 0, 0);
+	valid = valid && (driver.empty() || fread(&driver[0], driver.size(), 1, file) == 1) &&
+		driver == getDriverString();
+
+	while (valid) {
+		unsigned long long key = 0;
+		unsigned int info[2] = {};
+		if (fread(&key, sizeof(key), 1, file) != 1 || fread(info, sizeof(info), 1, file) != 1)
+			break;
+
+		ProgramBinary binary;
+		binary.format = info[0];
+		binary.data.resize(info[1]);
+		if (binary.data.empty() || fread(binary.data.data(), binary.data.size(), 1, file) != 1)
+			break;
+		s_programBinaries[key] = std::move(binary);
+	}
 	fclose(file);
-	source[size] = 0;
+}
 
-	glShaderSource(m_handle, 1, (const char**)&source, 0);
-	glCompileShader(m_handle);
+// rewrites the cache file with every binary held
+static void saveProgramBinaries() {
+	s_programBinariesChanged = false;
+	FILE* file = nullptr;
+	fopen_s(&file, s_binaryCacheFile.c_str(), "wb");
+	if (file == nullptr)
+		return;
 
-	delete[] source;
+	std::string driver = getDriverString();
+	unsigned int header[3] = { PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, (unsigned int)driver.size() };
+	fwrite(header, sizeof(header), 1, file);
+	fwrite(driver.data(), driver.size(), 1, file);
+	for (auto& b : s_programBinaries) {
+		unsigned int info[2] = { b.second.format, (unsigned int)b.second.data.size() };
+		fwrite(&b.first, sizeof(b.first), 1, file);
+		fwrite(info, sizeof(info), 1, file);
+		fwrite(b.second.data.data(), b.second.data.size(), 1, file);
+	}
+	fclose(file);
+}
 
-	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+// fnv-1a over a stage's number and source, continuing from hash. the pieces
+// hash as the one string they make, so a source keeps its key however it's cut
+static unsigned long long hashSource(unsigned long long hash, unsigned int stage, const ShaderSource& source) {
+	hash ^= stage + 1;
+	hash *= 1099511628211ull;
+	for (size_t i = 0; i < source.strings.size(); ++i) {
+		for (int j = 0; j < source.lengths[i]; ++j) {
+			hash ^= (unsigned char)source.strings[i][j];
+			hash *= 1099511628211ull;
+		}
+	}
+	return hash;
+}
 
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
-		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
+static const unsigned long long SOURCE_HASH_BASIS = 14695981039346656037ull;
+
+// a shader file, kept mapped and cut around its include lines. each file
+// is read and searched once, and again only when its stamp changes
+struct SourceFile {
+	struct Part {
+		size_t			offset;
+		size_t			length;
+
+		// the path of the file included, relative to this one's folder,
+		// empty for text. lines after it carry on from nextLine
+		std::string		include;
+		unsigned int	nextLine;
+	};
+
+	sns::FileView		view;
+	unsigned long long	size;
+	long long			modifiedTime;
+	std::vector<Part>	parts;
+};
+
+static std::unordered_map<std::string, std::shared_ptr<SourceFile>> s_sourceFiles;
+
+static std::shared_ptr<SourceFile> openSourceFile(const std::string& filename) {
+
+	sns::FileSystem& fileSystem = sns::FileSystem::instance();
+	unsigned long long size = 0;
+	long long modifiedTime = 0;
+	if (fileSystem.getFileStamp(filename.c_str(), size, modifiedTime) == false)
+		return nullptr;
+
+	std::string key = sns::FileSystem::canonicalise(filename);
+	auto cached = s_sourceFiles.find(key);
+	if (cached != s_sourceFiles.end() && cached->second->size == size && cached->second->modifiedTime == modifiedTime)
+		return cached->second;
+
+	std::shared_ptr<SourceFile> file = std::make_shared<SourceFile>();
+	if (fileSystem.open(filename.c_str(), file->view) == false)
+		return nullptr;
+	file->size = size;
+	file->modifiedTime = modifiedTime;
+
+	std::string folder = filename.substr(0, filename.find_last_of("/\\") + 1);
+	const char* data = (const char*)file->view.getData();
+	size_t length = file->view.getSize();
+	size_t textStart = 0;
+	unsigned int line = 1;
+	for (size_t lineStart = 0; lineStart < length; ++line) {
+		size_t lineEnd = lineStart;
+		while (lineEnd < length && data[lineEnd] != '\n')
+			++lineEnd;
+
+		size_t p = lineStart;
+		while (p < lineEnd && (data[p] == ' ' || data[p] == '\t'))
+			++p;
+		if (lineEnd - p > 8 && memcmp(data + p, "#include", 8) == 0) {
+			const char* open = std::find(data + p + 8, data + lineEnd, '"');
+			const char* close = open < data + lineEnd ? std::find(open + 1, data + lineEnd, '"') : open;
+			if (close < data + lineEnd) {
+				if (lineStart > textStart)
+					file->parts.push_back({ textStart, lineStart - textStart, std::string(), 0 });
+				file->parts.push_back({ 0, 0, folder + std::string(open + 1, close), line + 1 });
+				textStart = std::min(lineEnd + 1, length);
+			}
+		}
+		lineStart = lineEnd + 1;
+	}
+	if (textStart < length)
+		file->parts.push_back({ textStart, length - textStart, std::string(), 0 });
+
+	s_sourceFiles[key] = file;
+	return file;
+}
+
+bool ShaderSource::load(const char* filename, std::string& error, const char* defines /* = nullptr */) {
+	strings.clear();
+	lengths.clear();
+	files.assign(1, filename);
+	m_keep.clear();
+	if (include(filename, 0, error) == false)
 		return false;
+	if (defines == nullptr || *defines == 0 || strings.empty())
+		return true;
+
+	// #version has to come first, so the first piece is cut after its line
+	// and the defines go between. without one they go at the very start
+	const char* text = strings[0];
+	size_t length = (size_t)lengths[0];
+	const char* found = std::search(text, text + length, "#version", "#version" + 8);
+	size_t cut = 0;
+	unsigned int nextLine = 1;
+	if (found < text + length) {
+		cut = std::find(found, text + length, '\n') - text;
+		cut = std::min(cut + 1, length);
+		nextLine = 1 + (unsigned int)std::count(text, text + cut, '\n');
 	}
 
+	std::string inserted = std::string("\n") + defines + "\n#line " + std::to_string(nextLine) + " 0\n";
+	if (cut == length)
+		insertText(1, inserted);
+	else if (cut == 0)
+		insertText(0, inserted);
+	else {
+		strings.insert(strings.begin() + 1, text + cut);
+		lengths.insert(lengths.begin() + 1, (int)(length - cut));
+		lengths[0] = (int)cut;
+		insertText(1, inserted);
+	}
 	return true;
 }
 
+void ShaderSource::insertText(size_t index, const std::string& text) {
+	std::shared_ptr<std::string> copy = std::make_shared<std::string>(text);
+	strings.insert(strings.begin() + index, copy->c_str());
+	lengths.insert(lengths.begin() + index, (int)copy->size());
+	m_keep.push_back(copy);
+}
+
+bool ShaderSource::include(const std::string& filename, unsigned int fileIndex, std::string& error) {
+
+	std::shared_ptr<SourceFile> file = openSourceFile(filename);
+	if (file == nullptr) {
+		error = "Cannot open shader " + filename;
+		return false;
+	}
+	m_keep.push_back(file);
+
+	// #line keeps errors pointing at the file and line they're in
+	auto addLine = [this](unsigned int line, unsigned int index) {
+		insertText(strings.size(), "\n#line " + std::to_string(line) + " " + std::to_string(index) + "\n");
+	};
+
+	const char* data = (const char*)file->view.getData();
+	for (auto& part : file->parts) {
+		if (part.include.empty()) {
+			strings.push_back(data + part.offset);
+			lengths.push_back((int)part.length);
+			continue;
+		}
+
+		// included once, the first time it's asked for
+		std::string key = sns::FileSystem::canonicalise(part.include);
+		bool included = false;
+		for (auto& f : files)
+			included = included || sns::FileSystem::canonicalise(f) == key;
+
+		if (included == false) {
+			unsigned int index = (unsigned int)files.size();
+			files.push_back(part.include);
+			addLine(1, index);
+			if (include(part.include, index, error) == false) {
+				error += ", included by " + filename;
+				return false;
+			}
+		}
+		addLine(part.nextLine, fileIndex);
+	}
+	return true;
+}
+
+void ShaderSource::set(const char* string) {
+	std::shared_ptr<std::string> text = std::make_shared<std::string>(string);
+	strings.assign(1, text->c_str());
+	lengths.assign(1, (int)text->size());
+	files.clear();
+	m_keep.assign(1, text);
+}
+
+std::string ShaderSource::toString() const {
+	std::string text;
+	for (size_t i = 0; i < strings.size(); ++i)
+		text.append(strings[i], lengths[i]);
+	return text;
+}
+
+Shader::~Shader() {
+	glDeleteShader(m_handle);
+}
+
+const ShaderSource& Shader::getSource() const {
+	static const ShaderSource none;
+	return m_source != nullptr ? *m_source : none;
+}
+
+bool Shader::loadShader(unsigned int stage, const char* filename) {
+	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+
+	// from an archive or the disk, the pieces are handed to gl as they are
+	std::shared_ptr<ShaderSource> source = std::make_shared<ShaderSource>();
+	std::string error;
+	if (source->load(filename, error) == false) {
+		delete[] m_lastError;
+		m_lastError = new char[error.size() + 1];
+		memcpy(m_lastError, error.c_str(), error.size() + 1);
+		return false;
+	}
+	return createShader(stage, source);
+}
+
 bool Shader::createShader(unsigned int stage, const char* string) {
+	std::shared_ptr<ShaderSource> source = std::make_shared<ShaderSource>();
+	source->set(string);
+	return createShader(stage, source);
+}
+
+bool Shader::createShader(unsigned int stage, const std::shared_ptr<const ShaderSource>& source) {
+	beginCompile(stage, source);
+	return checkCompile();
+}
+
+void Shader::beginCompile(unsigned int stage, const std::shared_ptr<const ShaderSource>& source) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 
 	m_stage = stage;
+	m_compileStatus = -1;
 
 	switch (stage) {
 	case eShaderStage::VERTEX:	m_handle = glCreateShader(GL_VERTEX_SHADER);	break;
@@ -73,20 +372,40 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
 	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
 	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
+	case eShaderStage::COMPUTE:	m_handle = glCreateShader(GL_COMPUTE_SHADER);	break;
+	case eShaderStage::TASK:	m_handle = glCreateShader(GL_TASK_SHADER_NV);	break;
+	case eShaderStage::MESH:	m_handle = glCreateShader(GL_MESH_SHADER_NV);	break;
 	default:	break;
 	};
 
-	glShaderSource(m_handle, 1, (const char**)&string, 0);
+	m_source = source;
+	glShaderSource(m_handle, (int)source->strings.size(), source->strings.data(), source->lengths.data());
 	glCompileShader(m_handle);
-	
-	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
+}
+
+bool Shader::isCompileComplete() const {
+	if (m_compileStatus >= 0 || ShaderProgram::hasParallelCompile() == false)
+		return true;
+	int complete = GL_TRUE;
+	glGetShaderiv(m_handle, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+bool Shader::checkCompile() {
+	// the status is only asked for once, shared stages are checked by every
+	// program using them
+	if (m_compileStatus >= 0)
+		return m_compileStatus == GL_TRUE;
+
+	m_compileStatus = GL_TRUE;
+	glGetShaderiv(m_handle, GL_COMPILE_STATUS, &m_compileStatus);
+	if (m_compileStatus == GL_FALSE) {
 		int infoLogLength = 0;
 		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
 
 		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
+		m_lastError = new char[infoLogLength + 1];
+		m_lastError[0] = 0;
 		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
 		return false;
 	}
@@ -96,19 +415,70 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 
 ShaderProgram::~ShaderProgram() {
 	delete[] m_lastError;
-	glDeleteProgram(m_program);
+	if (m_pendingProgram != 0)
+		glDeleteProgram(m_pendingProgram);
 }
 
-bool ShaderProgram::loadShader(unsigned int stage, const char* filename) {
+bool ShaderProgram::loadShader(unsigned int stage, const char* filename, const char* defines /* = nullptr */) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->loadShader(stage, filename);
+	m_shaders[stage] = nullptr;
+	m_sources[stage] = nullptr;
+	m_filenames[stage] = filename;
+	m_defines[stage] = defines != nullptr ? defines : "";
+
+	// includes are put together here, files already read for another
+	// program are used again without touching the disk
+	std::shared_ptr<ShaderSource> source = std::make_shared<ShaderSource>();
+	std::string error;
+	if (source->load(filename, error, m_defines[stage].c_str()) == false) {
+		setLastError(error.c_str());
+		return false;
+	}
+	m_sources[stage] = source;
+	return true;
 }
 
 bool ShaderProgram::createShader(unsigned int stage, const char* string) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->createShader(stage, string);
+	m_shaders[stage] = nullptr;
+	std::shared_ptr<ShaderSource> source = std::make_shared<ShaderSource>();
+	source->set(string);
+	m_sources[stage] = source;
+	m_filenames[stage].clear();
+	m_defines[stage].clear();
+	return true;
+}
+
+bool ShaderProgram::reload() {
+	for (unsigned int i = 0; i < eShaderStage::SHADER_STAGE_Count; ++i) {
+		if (m_filenames[i].empty())
+			continue;
+		std::string filename = m_filenames[i];
+		std::string defines = m_defines[i];
+		if (loadShader(i, filename.c_str(), defines.c_str()) == false)
+			return false;
+	}
+	return link();
+}
+
+const std::vector<std::string>& ShaderProgram::getFiles(unsigned int stage) const {
+	static const std::vector<std::string> none;
+	if (m_sources[stage] != nullptr)
+		return m_sources[stage]->files;
+	return m_shaders[stage] != nullptr ? m_shaders[stage]->getSource().files : none;
+}
+
+void ShaderProgram::setBinaryCacheFile(const char* filename) {
+	s_binaryCacheFile = filename;
+	s_programBinaries.clear();
+	s_programBinariesLoaded = false;
+}
+
+void ShaderProgram::setLastError(const char* error) {
+	delete[] m_lastError;
+	size_t length = strlen(error);
+	m_lastError = new char[length + 1];
+	memcpy(m_lastError, error, length + 1);
 }
 
 void ShaderProgram::attachShader(const std::shared_ptr<Shader>& shader) {
@@ -117,205 +487,458 @@ void ShaderProgram::attachShader(const std::shared_ptr<Shader>& shader) {
 }
 
 bool ShaderProgram::link() {
-	m_program = glCreateProgram();
+	beginLink();
+	return finishLink();
+}
+
+void ShaderProgram::beginLink() {
+	// a link already started and not finished is dropped
+	if (m_pendingProgram != 0)
+		glDeleteProgram(m_pendingProgram);
+
+	// the program's key covers every stage, in stage order
+	unsigned long long key = SOURCE_HASH_BASIS;
+	for (unsigned int i = 0; i < eShaderStage::SHADER_STAGE_Count; ++i) {
+		if (m_shaders[i] != nullptr)
+			key = hashSource(key, i, m_shaders[i]->getSource());
+		else if (m_sources[i] != nullptr)
+			key = hashSource(key, i, *m_sources[i]);
+	}
+
+	unsigned int program = glCreateProgram();
+	m_pendingProgram = program;
+	m_pendingKey = key;
+	m_pendingFromBinary = false;
+
+	// a binary from a run before, or from another program linked from the
+	// same sources, skips compiling. it can still be refused if the driver
+	// changed without its strings changing
+	bool cacheable = canCacheBinaries();
+	if (cacheable) {
+		loadProgramBinaries();
+		auto binary = s_programBinaries.find(key);
+		if (binary != s_programBinaries.end()) {
+			glProgramBinary(program, binary->second.format, binary->second.data.data(), (int)binary->second.data.size());
+			int success = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+			m_pendingFromBinary = success == GL_TRUE;
+			if (m_pendingFromBinary)
+				return;
+			s_programBinaries.erase(binary);
+		}
+	}
+
+	// start compiling the stages only loaded so far, sharing the compile of
+	// any other program's identical stage. whether they worked is only
+	// asked in finishLink(), so the driver can get on with several at once
+	hasParallelCompile();
+	for (unsigned int i = 0; i < eShaderStage::SHADER_STAGE_Count; ++i) {
+		if (m_shaders[i] != nullptr || m_sources[i] == nullptr)
+			continue;
+
+		unsigned long long stageKey = hashSource(SOURCE_HASH_BASIS, i, *m_sources[i]);
+		auto compiled = s_compiledShaders.find(stageKey);
+		if (compiled != s_compiledShaders.end())
+			m_shaders[i] = compiled->second.lock();
+		if (m_shaders[i] != nullptr)
+			continue;
+
+		m_shaders[i] = std::make_shared<Shader>();
+		m_shaders[i]->beginCompile(i, m_sources[i]);
+		s_compiledShaders[stageKey] = m_shaders[i];
+	}
+
 	for (auto& s : m_shaders)
 		if (s != nullptr)
-			glAttachShader(m_program, s->getHandle());
-	glLinkProgram(m_program);
+			glAttachShader(program, s->getHandle());
+	if (cacheable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+}
 
-	int success = GL_TRUE;
-	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
+bool ShaderProgram::isLinkComplete() const {
+	if (m_pendingProgram == 0 || m_pendingFromBinary || hasParallelCompile() == false)
+		return true;
+	int complete = GL_TRUE;
+	glGetProgramiv(m_pendingProgram, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
 
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength + 1];
-		glGetProgramInfoLog(m_program, infoLogLength, 0, m_lastError);
-		return false;
+bool ShaderProgram::finishLink() {
+	if (m_pendingProgram == 0)
+		beginLink();
+	unsigned int program = m_pendingProgram;
+	m_pendingProgram = 0;
+
+	if (m_pendingFromBinary == false) {
+		// a stage that didn't compile says why better than the link does.
+		// it's dropped so the next link compiles it again
+		for (unsigned int i = 0; i < eShaderStage::SHADER_STAGE_Count; ++i) {
+			if (m_shaders[i] == nullptr || m_shaders[i]->checkCompile())
+				continue;
+
+			setLastError(m_shaders[i]->getLastError());
+			auto compiled = s_compiledShaders.find(hashSource(SOURCE_HASH_BASIS, i, m_shaders[i]->getSource()));
+			if (compiled != s_compiledShaders.end() && compiled->second.lock() == m_shaders[i])
+				s_compiledShaders.erase(compiled);
+			m_shaders[i] = nullptr;
+			glDeleteProgram(program);
+			return false;
+		}
+
+		int success = GL_TRUE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (success == GL_FALSE) {
+			int infoLogLength = 0;
+			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+			delete[] m_lastError;
+			m_lastError = new char[infoLogLength + 1];
+			m_lastError[0] = 0;
+			glGetProgramInfoLog(program, infoLogLength, 0, m_lastError);
+			glDeleteProgram(program);
+			return false;
+		}
+
+		if (canCacheBinaries()) {
+			int length = 0;
+			glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length > 0) {
+				ProgramBinary& binary = s_programBinaries[m_pendingKey];
+				binary.data.resize(length);
+				glGetProgramBinary(program, length, nullptr, &binary.format, binary.data.data());
+				s_programBinariesChanged = true;
+				if (s_programBinarySaveDeferred == false)
+					saveProgramBinaries();
+			}
+		}
 	}
+
+	// a failed link keeps the program from before, a good one replaces it
+	m_program.reset(program);
+
+	reflectUniforms();
+	bindUniformBlocks();
 	return true;
 }
 
+bool ShaderProgram::linkAll(ShaderProgram* const* programs, unsigned int count) {
+	for (unsigned int i = 0; i < count; ++i)
+		programs[i]->beginLink();
+
+	// each is finished as soon as the driver has it done, so reflecting it
+	// overlaps compiling the others. when none are done yet the oldest is
+	// waited on. the binary cache is written once at the end
+	bool deferred = s_programBinarySaveDeferred;
+	s_programBinarySaveDeferred = true;
+	std::vector<ShaderProgram*> pending(programs, programs + count);
+	bool success = true;
+	while (pending.empty() == false) {
+		size_t finished = pending.size();
+		for (size_t i = 0; i < pending.size() && finished == pending.size(); ++i)
+			if (pending[i]->isLinkComplete())
+				finished = i;
+		if (finished == pending.size())
+			finished = 0;
+
+		success = pending[finished]->finishLink() && success;
+		pending.erase(pending.begin() + finished);
+	}
+
+	s_programBinarySaveDeferred = deferred;
+	if (deferred == false && s_programBinariesChanged)
+		saveProgramBinaries();
+	return success;
+}
+
+bool ShaderProgram::hasParallelCompile() {
+	static int supported = -1;
+	if (supported < 0) {
+		supported = glfwExtensionSupported("GL_KHR_parallel_shader_compile") ||
+			glfwExtensionSupported("GL_ARB_parallel_shader_compile") ? 1 : 0;
+
+		// as many threads as the driver likes, it defaults to that but
+		// some only start using them once asked
+		MaxShaderCompilerThreadsFunction maxThreads = nullptr;
+		if (supported == 1) {
+			maxThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+			if (maxThreads == nullptr)
+				maxThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		}
+		if (maxThreads != nullptr)
+			maxThreads(0xffffffffu);
+	}
+	return supported == 1;
+}
+
+bool ShaderProgram::hasMeshShaders() {
+	static int supported = -1;
+	if (supported < 0)
+		supported = glfwExtensionSupported("GL_NV_mesh_shader") ? 1 : 0;
+	return supported == 1;
+}
+
+void ShaderProgram::setUniformBlockBinding(const char* name, unsigned int binding) {
+	for (auto& b : s_uniformBlockBindings) {
+		if (b.name == name) {
+			b.binding = binding;
+			return;
+		}
+	}
+	s_uniformBlockBindings.push_back({ name, binding });
+}
+
+bool ShaderProgram::hasUniformBlock(const char* name) const {
+	return std::find(m_uniformBlocks.begin(), m_uniformBlocks.end(), name) != m_uniformBlocks.end();
+}
+
+void ShaderProgram::bindUniformBlocks() {
+	m_uniformBlocks.clear();
+
+	int count = 0, maxLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	std::vector<char> buffer(maxLength + 1);
+
+	for (int i = 0; i < count; ++i) {
+		int length = 0;
+		glGetActiveUniformBlockName(m_program, i, (int)buffer.size(), &length, buffer.data());
+		m_uniformBlocks.push_back(std::string(buffer.data(), length));
+
+		for (auto& b : s_uniformBlockBindings)
+			if (b.name == m_uniformBlocks.back())
+				glUniformBlockBinding(m_program, i, b.binding);
+	}
+}
+
+void ShaderProgram::reflectUniforms() {
+	m_uniforms.clear();
+
+	int count = 0, maxLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> buffer(maxLength + 1);
+
+	for (int i = 0; i < count; ++i) {
+		int length = 0, size = 0;
+		unsigned int type = 0;
+		glGetActiveUniform(m_program, i, (int)buffer.size(), &length, &size, &type, buffer.data());
+		std::string name(buffer.data(), length);
+
+		// uniforms inside blocks have no location
+		int location = glGetUniformLocation(m_program, name.c_str());
+		++s_lookupStats.glQueries;
+		if (location < 0)
+			continue;
+
+		// arrays are reported as "name[0]", register "name" and every element
+		size_t bracket = name.find("[0]");
+		if (bracket != std::string::npos && bracket + 3 == name.size()) {
+			std::string base = name.substr(0, bracket);
+			m_uniforms.push_back({ hashUniformName(base.c_str()), location, base });
+			for (int e = 0; e < size; ++e) {
+				std::string element = base + "[" + std::to_string(e) + "]";
+				int elementLocation = e == 0 ? location : glGetUniformLocation(m_program, element.c_str());
+				if (e > 0)
+					++s_lookupStats.glQueries;
+				m_uniforms.push_back({ hashUniformName(element.c_str()), elementLocation, element });
+			}
+		}
+		else
+			m_uniforms.push_back({ hashUniformName(name.c_str()), location, name });
+	}
+
+	std::sort(m_uniforms.begin(), m_uniforms.end(),
+			  [](const Uniform& a, const Uniform& b) { return a.hash < b.hash; });
+}
+
 void ShaderProgram::bind() {
 	assert(m_program > 0 && "Invalid shader program");
-	glUseProgram(m_program);
+	sns::RenderState::instance().useProgram(m_program);
 }
 
-int ShaderProgram::getUniform(const char* name) {
-	return glGetUniformLocation(m_program, name);
+int ShaderProgram::getUniform(const UniformHandle& uniform) const {
+	++s_lookupStats.tableLookups;
+
+	// the name is compared as well in case two uniforms share a hash
+	auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), uniform.hash,
+							   [](const Uniform& u, unsigned int hash) { return u.hash < hash; });
+	for (; it != m_uniforms.end() && it->hash == uniform.hash; ++it)
+		if (strcmp(it->name.c_str(), uniform.name) == 0)
+			return it->location;
+	return -1;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform1i(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, float value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, float value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform1f(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec2& value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, const glm::vec2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform2f(i, value.x, value.y);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec3& value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, const glm::vec3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform3f(i, value.x, value.y, value.z);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec4& value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, const glm::vec4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform4f(i, value.x, value.y, value.z, value.w);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat2& value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, const glm::mat2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniformMatrix2fv(i, 1, GL_FALSE, &value[0][0]);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat3& value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, const glm::mat3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniformMatrix3fv(i, 1, GL_FALSE, &value[0][0]);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat4& value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, const glm::mat4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniformMatrix4fv(i, 1, GL_FALSE, &value[0][0]);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, int* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, int* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform1iv(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, float* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, float* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform1fv(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec2* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, const glm::vec2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform2fv(i, count, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec3* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, const glm::vec3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform3fv(i, count, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec4* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, const glm::vec4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniform4fv(i, count, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat2* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, const glm::mat2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniformMatrix2fv(i, count, GL_FALSE, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat3* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, const glm::mat3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniformMatrix3fv(i, count, GL_FALSE, (float*)value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat4* value) {
+bool ShaderProgram::bindUniform(const UniformHandle& uniform, int count, const glm::mat4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(uniform);
 	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+		SNS_LOG_WARNING("Shader uniform [%s] not found! Is it being used?", uniform.name);
 		return false;
 	}
 	glUniformMatrix4fv(i, count, GL_FALSE, (float*)value);
@@ -8,6 +8,7 @@
 */
 #pragma once
 
+#include "GpuHandle.h"
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
@@ -15,9 +16,31 @@
 #include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace aie {
 
+// fnv-1a hash of a uniform name, usable at compile time
+constexpr unsigned int hashUniformName(const char* name) {
+	unsigned int hash = 2166136261u;
+	while (*name != 0) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// a uniform name with its hash worked out up front. declare these as
+// static constexpr to hash at compile time, string literals passed to
+// bindUniform() convert to one implicitly
+struct UniformHandle {
+	constexpr UniformHandle(const char* name) : name(name), hash(hashUniformName(name)) {}
+
+	const char*		name;
+	unsigned int	hash;
+};
+
 // simplified render pipeline shader stages
 enum eShaderStage : unsigned int {
 	UNDEFINED = 0,
@@ -27,58 +50,180 @@ enum eShaderStage : unsigned int {
 	TESSELLATION_CONTROL,
 	GEOMETRY,
 	FRAGMENT,
+	COMPUTE,
+
+	// NV_mesh_shader's, only loaded when hasMeshShaders() is true
+	TASK,
+	MESH,
 
 	SHADER_STAGE_Count,
 };
 
+// a stage's source as pieces pointing into the files it was put together
+// from, so it reaches gl without being copied into one string. a file's
+// #include "name" lines, relative to it, are replaced by the file named
+// there, each file only once. pieces stay valid for as long as the source
+// lives, even after its files are read again for a reload
+struct ShaderSource {
+	std::vector<const char*>	strings;
+	std::vector<int>			lengths;
+
+	// the file loaded first then everything it includes. compile errors
+	// give a piece's position as the index of its file here and its line
+	std::vector<std::string>	files;
+
+	// loads a file and its includes through the file system, false with
+	// why in error if any of them can't be read. defines, "#define NAME 1"
+	// lines, are put straight after the #version line
+	bool load(const char* filename, std::string& error, const char* defines = nullptr);
+
+	// a single piece holding a copy of string
+	void set(const char* string);
+
+	// the source put back together, for printing
+	std::string toString() const;
+
+	ShaderSource() = default;
+	ShaderSource(const ShaderSource&) = delete;
+	ShaderSource& operator=(const ShaderSource&) = delete;
+
+private:
+
+	bool include(const std::string& filename, unsigned int fileIndex, std::string& error);
+
+	// adds a piece holding a copy of text before the piece at index
+	void insertText(size_t index, const std::string& text);
+
+	// the files and text the pieces point at
+	std::vector<std::shared_ptr<const void>>	m_keep;
+};
+
 // individual sharable shader stages
 class Shader {
 public:
 
-	Shader() : m_stage(0), m_handle(0), m_lastError(nullptr) {}
+	Shader() : m_stage(0), m_handle(0), m_compileStatus(-1), m_lastError(nullptr) {}
 	Shader(unsigned int stage, const char* filename)
-		: m_stage(0), m_handle(0), m_lastError(nullptr) {
+		: m_stage(0), m_handle(0), m_compileStatus(-1), m_lastError(nullptr) {
 		loadShader(stage, filename);
 	}
 	~Shader();
 
 	bool loadShader(unsigned int stage, const char* filename);
 	bool createShader(unsigned int stage, const char* string);
+	bool createShader(unsigned int stage, const std::shared_ptr<const ShaderSource>& source);
+
+	// createShader() in two halves. beginCompile() hands the source to gl
+	// without waiting, so with KHR_parallel_shader_compile the driver
+	// compiles it on its own threads. checkCompile() waits for it and says
+	// whether it worked, isCompileComplete() is true once it won't wait
+	void beginCompile(unsigned int stage, const std::shared_ptr<const ShaderSource>& source);
+	bool isCompileComplete() const;
+	bool checkCompile();
 
 	unsigned int getStage() const { return m_stage; }
 	unsigned int getHandle() const { return m_handle; }
 
+	// the source it was compiled from, part of a program's binary cache key.
+	// empty if it hasn't been
+	const ShaderSource& getSource() const;
+
 	const char* getLastError() const { return m_lastError; }
 
 protected:
 
 	unsigned int	m_stage;
 	unsigned int	m_handle;
+	std::shared_ptr<const ShaderSource>	m_source;
+
+	// GL_TRUE or GL_FALSE once checked, -1 before
+	int				m_compileStatus;
 	char*			m_lastError;
 };
 
-// combines shaders together into a single program for the GPU
+// combines shaders together into a single program for the GPU.
+// loadShader() and createShader() only keep the source. link() loads the
+// program's binary when one was saved for the same sources, by this run or
+// one before, and otherwise compiles, sharing the compile of stages other
+// programs have the same source for
 class ShaderProgram {
 public:
 
-	ShaderProgram() : m_program(0), m_lastError(nullptr) {
+	ShaderProgram() : m_pendingProgram(0), m_pendingKey(0), m_pendingFromBinary(false), m_lastError(nullptr) {
 		m_shaders[0] = m_shaders[1] = m_shaders[2] = m_shaders[3] = m_shaders[4] = 0;
 	}
 	~ShaderProgram();
 
-	bool loadShader(unsigned int stage, const char* filename);
+	bool loadShader(unsigned int stage, const char* filename, const char* defines = nullptr);
 	bool createShader(unsigned int stage, const char* string);
 	void attachShader(const std::shared_ptr<Shader>& shader);
 
 	bool link();
 
+	// link() in two halves, so many programs can compile at once.
+	// beginLink() starts compiling and linking without waiting, finishLink()
+	// waits for it and returns what link() would. isLinkComplete() is true
+	// once finishLink() won't wait
+	void beginLink();
+	bool isLinkComplete() const;
+	bool finishLink();
+
+	// links every program, starting all of them before waiting on any and
+	// finishing each as the driver completes it. false if any failed, which
+	// are the ones still without a handle if they never linked before
+	static bool linkAll(ShaderProgram* const* programs, unsigned int count);
+
+	// true if the driver compiles on its own threads, through
+	// KHR_parallel_shader_compile. asks it to use as many as it likes
+	static bool hasParallelCompile();
+
+	// true if the driver has NV_mesh_shader, so programs can be linked
+	// from TASK and MESH stages instead of a vertex shader
+	static bool hasMeshShaders();
+
+	// reads every stage loaded from a file again and links. on failure the
+	// program linked before is kept and getLastError() says why
+	bool reload();
+
+	// the file a stage was loaded from, empty if it wasn't
+	const std::string& getFilename(unsigned int stage) const { return m_filenames[stage]; }
+
+	// the defines a stage was loaded with
+	const std::string& getDefines(unsigned int stage) const { return m_defines[stage]; }
+
+	// the files a stage's source was put together from, the one it was
+	// loaded from first. empty before it is loaded
+	const std::vector<std::string>& getFiles(unsigned int stage) const;
+
+	// the file linked program binaries are kept in between runs. they're
+	// only reused on the driver that made them, anything else compiles
+	// from source and replaces the file
+	static void setBinaryCacheFile(const char* filename);
+
 	const char* getLastError() const { return m_lastError; }
 
 	void bind();
 
 	unsigned int getHandle() const { return m_program; }
 
-	int getUniform(const char* name);
+	// looks up the location reflected at link(), -1 if the uniform isn't active
+	int getUniform(const UniformHandle& uniform) const;
+
+	// counts name lookups across every program, reset once a frame. only the
+	// link() reflection should ever need to ask opengl for a location
+	struct LookupStats {
+		unsigned int	tableLookups;
+		unsigned int	glQueries;
+	};
+	static const LookupStats& getLookupStats() { return s_lookupStats; }
+	static void resetLookupStats() { s_lookupStats = {}; }
+
+	// registers a binding point for a uniform block name. every program
+	// that declares the block is bound to it when it links
+	static void setUniformBlockBinding(const char* name, unsigned int binding);
+
+	// true if the linked program declares the uniform block
+	bool hasUniformBlock(const char* name) const;
 
 	void bindUniform(int ID, int value);
 	void bindUniform(int ID, float value);
@@ -98,29 +243,69 @@ public:
 	void bindUniform(int ID, int count, const glm::mat4* value);
 
 	// these calls should be avoided, but wraps up opengl a little
-	bool bindUniform(const char* name, int value);
-	bool bindUniform(const char* name, float value);
-	bool bindUniform(const char* name, const glm::vec2& value);
-	bool bindUniform(const char* name, const glm::vec3& value);
-	bool bindUniform(const char* name, const glm::vec4& value);
-	bool bindUniform(const char* name, const glm::mat2& value);
-	bool bindUniform(const char* name, const glm::mat3& value);
-	bool bindUniform(const char* name, const glm::mat4& value);
-	bool bindUniform(const char* name, int count, int* value);
-	bool bindUniform(const char* name, int count, float* value);
-	bool bindUniform(const char* name, int count, const glm::vec2* value);
-	bool bindUniform(const char* name, int count, const glm::vec3* value);
-	bool bindUniform(const char* name, int count, const glm::vec4* value);
-	bool bindUniform(const char* name, int count, const glm::mat2* value);
-	bool bindUniform(const char* name, int count, const glm::mat3* value);
-	bool bindUniform(const char* name, int count, const glm::mat4* value);
+	bool bindUniform(const UniformHandle& uniform, int value);
+	bool bindUniform(const UniformHandle& uniform, float value);
+	bool bindUniform(const UniformHandle& uniform, const glm::vec2& value);
+	bool bindUniform(const UniformHandle& uniform, const glm::vec3& value);
+	bool bindUniform(const UniformHandle& uniform, const glm::vec4& value);
+	bool bindUniform(const UniformHandle& uniform, const glm::mat2& value);
+	bool bindUniform(const UniformHandle& uniform, const glm::mat3& value);
+	bool bindUniform(const UniformHandle& uniform, const glm::mat4& value);
+	bool bindUniform(const UniformHandle& uniform, int count, int* value);
+	bool bindUniform(const UniformHandle& uniform, int count, float* value);
+	bool bindUniform(const UniformHandle& uniform, int count, const glm::vec2* value);
+	bool bindUniform(const UniformHandle& uniform, int count, const glm::vec3* value);
+	bool bindUniform(const UniformHandle& uniform, int count, const glm::vec4* value);
+	bool bindUniform(const UniformHandle& uniform, int count, const glm::mat2* value);
+	bool bindUniform(const UniformHandle& uniform, int count, const glm::mat3* value);
+	bool bindUniform(const UniformHandle& uniform, int count, const glm::mat4* value);
 
 private:
 
-	unsigned int	m_program;
+	// fills m_uniforms with every active uniform, and each element of arrays
+	void reflectUniforms();
+
+	// binds the program's uniform blocks to their registered binding points
+	void bindUniformBlocks();
+
+	// replaces m_lastError with a copy of error
+	void setLastError(const char* error);
+
+	struct UniformBlockBinding {
+		std::string		name;
+		unsigned int	binding;
+	};
+
+	struct Uniform {
+		unsigned int	hash;
+		int				location;
+		std::string		name;
+	};
+
+	sns::ProgramHandle	m_program;
+
+	// the program beginLink() started, its binary cache key, and whether
+	// it was loaded from the cache instead of compiled
+	unsigned int		m_pendingProgram;
+	unsigned long long	m_pendingKey;
+	bool				m_pendingFromBinary;
+
+	// active uniforms sorted by hash
+	std::vector<Uniform>	m_uniforms;
+
+	// names of the active uniform blocks
+	std::vector<std::string>	m_uniformBlocks;
+
+	static std::vector<UniformBlockBinding>	s_uniformBlockBindings;
+	static LookupStats		s_lookupStats;
 
 	std::shared_ptr<Shader> m_shaders[eShaderStage::SHADER_STAGE_Count];
 
+	// stages loaded without being compiled yet, and the files and defines
+	// they're from
+	std::shared_ptr<const ShaderSource>	m_sources[eShaderStage::SHADER_STAGE_Count];
+	std::string				m_filenames[eShaderStage::SHADER_STAGE_Count];
+	std::string				m_defines[eShaderStage::SHADER_STAGE_Count];
 	char*			m_lastError;
 };
 
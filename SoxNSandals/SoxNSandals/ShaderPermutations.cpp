@@ -0,0 +1,250 @@
+/**
+	ShaderPermutations.cpp
+
+	Purpose: ShaderPermutations.cpp is the source file for the
+			ShaderPermutations class. The ShaderPermutations class
+			compiles one shader source into a program per set of
+			features it is asked for.
+
+	@author Nathan Nette
+*/
+#include "ShaderPermutations.h"
+#include <cstdio>
+
+namespace sns
+{
+	/**
+		create sets the source the permutations are compiled from.
+
+			@param1 a_vertexFilename is the vertex shader's file.
+
+			@param2 a_fragmentFilename is the fragment shader's file, or
+					nullptr for none.
+
+			@param3 a_features are the features.
+
+			@param4 a_featureCount is how many there are.
+	*/
+	void ShaderPermutations::create(const char* a_vertexFilename, const char* a_fragmentFilename,
+		const Feature* a_features, unsigned int a_featureCount)
+	{
+		m_vertexFilename = a_vertexFilename;
+		m_fragmentFilename = a_fragmentFilename != nullptr ? a_fragmentFilename : "";
+		m_features = a_features;
+		m_featureCount = a_featureCount;
+		m_programs.clear();
+		m_lastError.clear();
+	}
+
+	/**
+		get returns the program for a key, compiling it the first time.
+
+			@param1 a_key is the features' values.
+
+			@return the program, or nullptr if it didn't compile.
+	*/
+	aie::ShaderProgram* ShaderPermutations::get(unsigned int a_key)
+	{
+		unsigned int key = mask(a_key);
+		auto found = m_programs.find(key);
+		if (found != m_programs.end())
+			return found->second.get();
+
+		std::unique_ptr<aie::ShaderProgram> program = load(key);
+		if (program != nullptr && program->link() == false)
+			program = fail(key, *program);
+
+		aie::ShaderProgram* result = program.get();
+		m_programs[key] = std::move(program);
+		return result;
+	}
+
+	/**
+		prepare compiles the programs for keys now.
+
+			@param1 a_keys are the keys.
+
+			@param2 a_count is how many there are.
+
+			@return how many of them compiled.
+	*/
+	unsigned int ShaderPermutations::prepare(const unsigned int* a_keys, unsigned int a_count)
+	{
+		// Every new program is linked at once, so a driver with its own
+		//	compile threads gets through them side by side.
+		std::vector<unsigned int> keys;
+		std::vector<aie::ShaderProgram*> programs;
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			unsigned int key = mask(a_keys[i]);
+			if (m_programs.find(key) != m_programs.end())
+				continue;
+
+			std::unique_ptr<aie::ShaderProgram> program = load(key);
+			if (program != nullptr)
+			{
+				keys.push_back(key);
+				programs.push_back(program.get());
+			}
+			m_programs[key] = std::move(program);
+		}
+		aie::ShaderProgram::linkAll(programs.data(), (unsigned int)programs.size());
+
+		for (size_t i = 0; i < programs.size(); ++i)
+		{
+			if (programs[i]->getHandle() == 0)
+				m_programs[keys[i]] = fail(keys[i], *programs[i]);
+		}
+
+		unsigned int compiled = 0;
+		for (unsigned int i = 0; i < a_count; ++i)
+		{
+			if (m_programs[mask(a_keys[i])] != nullptr)
+				++compiled;
+		}
+		return compiled;
+	}
+
+	/**
+		reload reads the files again and relinks every program.
+
+			@return false if any of them failed.
+	*/
+	bool ShaderPermutations::reload()
+	{
+		// Keys that failed before are tried again, the edit may be what
+		//	fixes them.
+		bool success = true;
+		std::vector<unsigned int> failed;
+		for (auto& permutation : m_programs)
+		{
+			if (permutation.second == nullptr)
+				failed.push_back(permutation.first);
+			else if (permutation.second->reload() == false)
+			{
+				m_lastError = permutation.second->getLastError();
+				success = false;
+			}
+		}
+
+		for (unsigned int key : failed)
+		{
+			m_programs.erase(key);
+			if (get(key) == nullptr)
+				success = false;
+		}
+		return success;
+	}
+
+	/**
+		forEach calls a function for every program that compiled.
+
+			@param1 a_function is the function.
+	*/
+	void ShaderPermutations::forEach(const std::function<void(aie::ShaderProgram&)>& a_function)
+	{
+		for (auto& permutation : m_programs)
+		{
+			if (permutation.second != nullptr)
+				a_function(*permutation.second);
+		}
+	}
+
+	/**
+		makeDefines returns the defines a key is compiled with.
+
+			@param1 a_key is the key.
+	*/
+	std::string ShaderPermutations::makeDefines(unsigned int a_key) const
+	{
+		std::string defines;
+		for (unsigned int i = 0; i < m_featureCount; ++i)
+		{
+			const Feature& feature = m_features[i];
+			unsigned int value = (a_key >> feature.shift) & ((1u << feature.bits) - 1);
+			defines += "#define ";
+			defines += feature.name;
+			defines += " " + std::to_string(value) + "\n";
+		}
+		return defines;
+	}
+
+	/**
+		getFiles lists the files the permutations are compiled from.
+
+			@param1 a_files is set to the files.
+	*/
+	void ShaderPermutations::getFiles(std::vector<std::string>& a_files) const
+	{
+		// Every permutation includes the same files, unless a feature
+		//	includes one of its own, so all of them are listed.
+		a_files.clear();
+		a_files.push_back(m_vertexFilename);
+		if (m_fragmentFilename.empty() == false)
+			a_files.push_back(m_fragmentFilename);
+		for (auto& permutation : m_programs)
+		{
+			if (permutation.second == nullptr)
+				continue;
+			for (unsigned int stage = 0; stage < aie::eShaderStage::SHADER_STAGE_Count; ++stage)
+			{
+				for (auto& name : permutation.second->getFiles(stage))
+				{
+					bool listed = false;
+					for (auto& listedName : a_files)
+						listed = listed || listedName == name;
+					if (listed == false)
+						a_files.push_back(name);
+				}
+			}
+		}
+	}
+
+	/**
+		load makes a program for a key with its sources loaded, ready to
+			link.
+
+			@param1 a_key is the key.
+
+			@return the program, or nullptr if a file couldn't be read.
+	*/
+	std::unique_ptr<aie::ShaderProgram> ShaderPermutations::load(unsigned int a_key)
+	{
+		std::string defines = makeDefines(a_key);
+		std::unique_ptr<aie::ShaderProgram> program(new aie::ShaderProgram());
+		bool loaded = program->loadShader(aie::eShaderStage::VERTEX, m_vertexFilename.c_str(), defines.c_str());
+		if (loaded && m_fragmentFilename.empty() == false)
+			loaded = program->loadShader(aie::eShaderStage::FRAGMENT, m_fragmentFilename.c_str(), defines.c_str());
+
+		if (loaded == false)
+			return fail(a_key, *program);
+		return program;
+	}
+
+	/**
+		fail keeps and prints why a key's program didn't compile.
+
+			@param1 a_key is the key.
+
+			@param2 a_program is its program.
+
+			@return nullptr, to keep for the key.
+	*/
+	std::unique_ptr<aie::ShaderProgram> ShaderPermutations::fail(unsigned int a_key, const aie::ShaderProgram& a_program)
+	{
+		m_lastError = a_program.getLastError() != nullptr ? a_program.getLastError() : "";
+		printf("Shader Error: %s permutation %#x\n%s\n", m_vertexFilename.c_str(), a_key, m_lastError.c_str());
+		return nullptr;
+	}
+
+	/**
+		mask returns a key with the bits outside every feature cleared.
+	*/
+	unsigned int ShaderPermutations::mask(unsigned int a_key) const
+	{
+		unsigned int bits = 0;
+		for (unsigned int i = 0; i < m_featureCount; ++i)
+			bits |= ((1u << m_features[i].bits) - 1) << m_features[i].shift;
+		return a_key & bits;
+	}
+}
@@ -0,0 +1,168 @@
+/**
+	ShaderPermutations.h
+
+	Purpose: ShaderPermutations.h is the header file for the
+			ShaderPermutations class. The ShaderPermutations class
+			compiles one shader source into a program per set of
+			features it is asked for, so each draw only pays for what
+			its material uses.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The ShaderPermutations class keeps a program for every key of
+			features it has been asked for. Each feature is a field of
+			bits in the key, and is compiled in as "#define NAME value"
+			after the source's #version line, so the source picks what
+			it does with #if.
+
+		Programs are compiled the first time their key is asked for, or
+			all at once with prepare, which starts every compile before
+			waiting on any. Their sources and binaries are
+			cached by hash like any other program's, so permutations
+			that come out the same share a compile and runs after the
+			first load them.
+	*/
+	class ShaderPermutations
+	{
+	public:
+		/**
+			A feature, as its define's name and where its value is in
+				the key.
+		*/
+		struct Feature
+		{
+			const char* name;
+			unsigned int shift;
+			unsigned int bits;
+		};
+
+		ShaderPermutations() = default;
+
+		ShaderPermutations(const ShaderPermutations&) = delete;
+		ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+		/**
+			create sets the source the permutations are compiled from.
+				Programs compiled before are dropped.
+
+				@param1 a_vertexFilename is the vertex shader's file.
+
+				@param2 a_fragmentFilename is the fragment shader's file,
+						or nullptr for a program with no fragment stage.
+
+				@param3 a_features are the features, which must outlive
+						the permutations.
+
+				@param4 a_featureCount is how many there are.
+		*/
+		void create(const char* a_vertexFilename, const char* a_fragmentFilename,
+			const Feature* a_features, unsigned int a_featureCount);
+
+		/**
+			get returns the program for a key, compiling it if it hasn't
+				been asked for before.
+
+				@param1 a_key is the features' values, bits outside every
+						feature are ignored.
+
+				@return the program, or nullptr if it didn't compile.
+		*/
+		aie::ShaderProgram* get(unsigned int a_key);
+
+		/**
+			prepare compiles the programs for keys now, so drawing doesn't
+				wait for them later.
+
+				@param1 a_keys are the keys.
+
+				@param2 a_count is how many there are.
+
+				@return how many of them compiled.
+		*/
+		unsigned int prepare(const unsigned int* a_keys, unsigned int a_count);
+
+		/**
+			reload reads the files again and relinks every program. A
+				program that fails keeps the one it had.
+
+				@return false if any of them failed, getLastError says why.
+		*/
+		bool reload();
+
+		/**
+			forEach calls a function for every program that compiled, in
+				no particular order.
+
+				@param1 a_function is the function.
+		*/
+		void forEach(const std::function<void(aie::ShaderProgram&)>& a_function);
+
+		/**
+			makeDefines returns the defines a key is compiled with, a line
+				for each feature.
+
+				@param1 a_key is the key.
+		*/
+		std::string makeDefines(unsigned int a_key) const;
+
+		/**
+			getFiles lists the files the permutations are compiled from,
+				with everything they include.
+
+				@param1 a_files is set to the files.
+		*/
+		void getFiles(std::vector<std::string>& a_files) const;
+
+		/**
+			getLastError returns why the last program to fail didn't
+				compile or link.
+		*/
+		const char* getLastError() const { return m_lastError.c_str(); }
+
+		/**
+			getCount returns how many keys have been compiled, along with
+				any that failed.
+		*/
+		unsigned int getCount() const { return (unsigned int)m_programs.size(); }
+
+	private:
+		/**
+			load makes a program for a key with its sources loaded,
+				ready to link, or nullptr if a file couldn't be read.
+		*/
+		std::unique_ptr<aie::ShaderProgram> load(unsigned int a_key);
+
+		/**
+			fail keeps and prints why a key's program didn't compile, and
+				returns nullptr to keep for the key.
+		*/
+		std::unique_ptr<aie::ShaderProgram> fail(unsigned int a_key, const aie::ShaderProgram& a_program);
+
+		/**
+			mask returns a key with the bits outside every feature cleared.
+		*/
+		unsigned int mask(unsigned int a_key) const;
+
+		std::string m_vertexFilename;
+		std::string m_fragmentFilename;
+		const Feature* m_features = nullptr;
+		unsigned int m_featureCount = 0;
+
+		// Every key asked for, those that failed to compile without a
+		//	program so they aren't tried again each frame.
+		std::unordered_map<unsigned int, std::unique_ptr<aie::ShaderProgram>> m_programs;
+
+		std::string m_lastError;
+	};
+}
@@ -0,0 +1,222 @@
+/**
+	ShaderWatcher.cpp
+
+	Purpose: ShaderWatcher.cpp is the source file for the ShaderWatcher
+			class. The ShaderWatcher recompiles shader programs whose
+			files change while the application runs, so shaders can be
+			tuned without restarting.
+
+	@author Nathan Nette
+*/
+#include "ShaderWatcher.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <cstdio>
+
+namespace sns
+{
+	/**
+		The deconstructor stops the thread.
+	*/
+	ShaderWatcher::~ShaderWatcher()
+	{
+		stop();
+	}
+
+	/**
+		watch adds a program, before start. The program must outlive
+			the watcher, and only its stages loaded from files are
+			watched.
+
+			@param1 a_program is the program.
+
+			@param2 a_onReload is called after it relinks, to set the
+					uniforms that are only set once again.
+	*/
+	void ShaderWatcher::watch(aie::ShaderProgram& a_program, ReloadFunction a_onReload)
+	{
+		Entry entry;
+		entry.program = &a_program;
+		entry.permutations = nullptr;
+		entry.onReload = a_onReload;
+		entry.changed = false;
+		gatherFiles(entry, entry.files);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entries.push_back(std::move(entry));
+	}
+
+	/**
+		watch adds a shader's permutations, before start.
+
+			@param1 a_permutations are the permutations.
+
+			@param2 a_onReload is called after they relink.
+	*/
+	void ShaderWatcher::watch(ShaderPermutations& a_permutations, ReloadFunction a_onReload)
+	{
+		Entry entry;
+		entry.program = nullptr;
+		entry.permutations = &a_permutations;
+		entry.onReload = a_onReload;
+		entry.changed = false;
+		gatherFiles(entry, entry.files);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entries.push_back(std::move(entry));
+	}
+
+	/**
+		start starts checking the files.
+	*/
+	void ShaderWatcher::start()
+	{
+		if (m_thread.joinable())
+			return;
+
+		m_stopping = false;
+		m_thread = std::thread(&ShaderWatcher::run, this);
+	}
+
+	/**
+		stop stops checking the files and waits for the thread.
+	*/
+	void ShaderWatcher::stop()
+	{
+		if (m_thread.joinable() == false)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_stopCondition.notify_all();
+		m_thread.join();
+	}
+
+	/**
+		update relinks every program with a changed file. It must be
+			called on the gl context thread, once a frame.
+
+			@return how many programs were relinked.
+	*/
+	unsigned int ShaderWatcher::update()
+	{
+		std::vector<Entry*> changed;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (Entry& entry : m_entries)
+			{
+				if (entry.changed)
+					changed.push_back(&entry);
+				entry.changed = false;
+			}
+		}
+
+		// Entries are only added before start, so they stay valid unlocked.
+		unsigned int reloaded = 0;
+		for (Entry* entry : changed)
+		{
+			std::string name;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (entry->files.empty() == false)
+					name = entry->files[0].name;
+			}
+			bool success = entry->program != nullptr ? entry->program->reload() : entry->permutations->reload();
+			if (success == false)
+			{
+				printf("Shader Error: %s kept its last program.\n%s\n", name.c_str(),
+					entry->program != nullptr ? entry->program->getLastError() : entry->permutations->getLastError());
+				continue;
+			}
+
+			// Its includes could have changed with it.
+			std::vector<File> files;
+			gatherFiles(*entry, files);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				entry->files.swap(files);
+			}
+
+			printf("Reloaded %s\n", entry->files.empty() ? "" : entry->files[0].name.c_str());
+			if (entry->onReload)
+				entry->onReload();
+			++reloaded;
+		}
+		return reloaded;
+	}
+
+	/**
+		gatherFiles lists an entry's files with their stamps now, every
+			stage's file and everything it includes, each once.
+
+			@param1 a_entry is the program or permutations.
+
+			@param2 a_files is set to its files.
+	*/
+	void ShaderWatcher::gatherFiles(const Entry& a_entry, std::vector<File>& a_files)
+	{
+		a_files.clear();
+		if (a_entry.permutations != nullptr)
+		{
+			std::vector<std::string> names;
+			a_entry.permutations->getFiles(names);
+			for (auto& name : names)
+			{
+				File file = { name, 0, 0 };
+				MappedFile::getFileStamp(name.c_str(), file.size, file.modifiedTime);
+				a_files.push_back(file);
+			}
+			return;
+		}
+
+		for (unsigned int stage = 0; stage < aie::eShaderStage::SHADER_STAGE_Count; ++stage)
+		{
+			for (auto& name : a_entry.program->getFiles(stage))
+			{
+				bool listed = false;
+				for (auto& listedFile : a_files)
+					listed = listed || listedFile.name == name;
+				if (listed)
+					continue;
+
+				File file = { name, 0, 0 };
+				MappedFile::getFileStamp(name.c_str(), file.size, file.modifiedTime);
+				a_files.push_back(file);
+			}
+		}
+	}
+
+	/**
+		run checks every file's size and modified time until stopped,
+			marking the programs of any that changed.
+	*/
+	void ShaderWatcher::run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_stopping == false)
+		{
+			for (Entry& entry : m_entries)
+			{
+				for (File& file : entry.files)
+				{
+					unsigned long long size = 0;
+					long long modifiedTime = 0;
+					if (MappedFile::getFileStamp(file.name.c_str(), size, modifiedTime) == false)
+						continue;
+
+					if (size != file.size || modifiedTime != file.modifiedTime)
+					{
+						file.size = size;
+						file.modifiedTime = modifiedTime;
+						entry.changed = true;
+					}
+				}
+			}
+
+			m_stopCondition.wait_for(lock, std::chrono::milliseconds(POLL_MILLISECONDS),
+				[this]() { return m_stopping; });
+		}
+	}
+}
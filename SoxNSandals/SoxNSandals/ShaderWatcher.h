@@ -0,0 +1,130 @@
+/**
+	ShaderWatcher.h
+
+	Purpose: ShaderWatcher.h is the header file for the ShaderWatcher
+			class. The ShaderWatcher recompiles shader programs whose
+			files change while the application runs, so shaders can be
+			tuned without restarting.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include "ShaderPermutations.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The ShaderWatcher class keeps the files of every program it is
+			given, with the files they include, and a thread checks their modified times a few times
+			a second. Compiling needs the gl context, so the thread only
+			marks programs as changed and update relinks them at the
+			start of a frame.
+
+		ShaderProgram::reload keeps the old program when the new one
+			doesn't compile or link, so a mistake leaves the last good
+			shader drawing and prints the error instead.
+	*/
+	class ShaderWatcher
+	{
+	public:
+		typedef std::function<void()> ReloadFunction;
+
+		// How long the thread sleeps between checks, in milliseconds.
+		static const unsigned int POLL_MILLISECONDS = 250;
+
+		ShaderWatcher() = default;
+
+		/**
+			The deconstructor stops the thread.
+		*/
+		~ShaderWatcher();
+
+		ShaderWatcher(const ShaderWatcher&) = delete;
+		ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+		/**
+			watch adds a program, before start. The program must outlive
+				the watcher, and only its stages loaded from files are
+				watched.
+
+				@param1 a_program is the program.
+
+				@param2 a_onReload is called after it relinks, to set the
+						uniforms that are only set once again.
+		*/
+		void watch(aie::ShaderProgram& a_program, ReloadFunction a_onReload = ReloadFunction());
+
+		/**
+			watch adds a shader's permutations, before start. Every
+				permutation is relinked when one of their files changes,
+				including those compiled after start.
+
+				@param1 a_permutations are the permutations, which must
+						outlive the watcher.
+
+				@param2 a_onReload is called after they relink.
+		*/
+		void watch(ShaderPermutations& a_permutations, ReloadFunction a_onReload = ReloadFunction());
+
+		/**
+			start starts checking the files.
+		*/
+		void start();
+
+		/**
+			stop stops checking the files and waits for the thread.
+		*/
+		void stop();
+
+		/**
+			update relinks every program with a changed file. It must be
+				called on the gl context thread, once a frame.
+
+				@return how many programs were relinked.
+		*/
+		unsigned int update();
+
+	private:
+		/**
+			A watched file and the size and time it had last check.
+		*/
+		struct File
+		{
+			std::string name;
+			unsigned long long size;
+			long long modifiedTime;
+		};
+
+		/**
+			A watched program, or a shader's permutations.
+		*/
+		struct Entry
+		{
+			aie::ShaderProgram* program;
+			ShaderPermutations* permutations;
+			ReloadFunction onReload;
+			std::vector<File> files;
+			bool changed;
+		};
+
+		// Lists an entry's files, including their includes.
+		static void gatherFiles(const Entry& a_entry, std::vector<File>& a_files);
+
+		// The thread, checking the files until stopped.
+		void run();
+
+		std::vector<Entry> m_entries;
+		std::thread m_thread;
+
+		std::mutex m_mutex;
+		std::condition_variable m_stopCondition;
+		bool m_stopping = false;
+	};
+}
@@ -0,0 +1,526 @@
+/**
+	ShadowAtlas.cpp
+
+	Purpose: ShadowAtlas.cpp is the source file for the ShadowAtlas class.
+			The ShadowAtlas shadows the clustered point and spot lights
+			from tiles of one depth texture, each sized by how much of
+			the screen its light covers, and only draws a tile again
+			when its light or something moving near it has changed.
+
+	@author Nathan Nette
+*/
+#include "ShadowAtlas.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	// The slope scaled and constant offsets casters are drawn with, as
+	//	ShadowCascades draws them.
+	static const float OFFSET_FACTOR = 2.0f;
+	static const float OFFSET_UNITS = 4.0f;
+
+	// What the shaders take off a fragment's depth in its tile as well.
+	static const float DEPTH_BIAS = 0.00005f;
+
+	// The fewest pixels across a light's sphere must be to be shadowed.
+	static const float MIN_COVERAGE = 16.0f;
+
+	// How far past its width a light's sphere must grow, or under half
+	//	its width shrink, before its tiles are resized.
+	static const float GROW_MARGIN = 1.25f;
+	static const float SHRINK_MARGIN = 0.8f;
+
+	// How much nearer than its range a light's faces start.
+	static const float NEAR_SCALE = 0.01f;
+
+	// The way each face of a point light looks and which way is up for
+	//	it, the cube map faces' in their order.
+	static const glm::vec3 FACE_DIRECTIONS[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+		glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+	static const glm::vec3 FACE_UPS[6] = { glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+		glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+
+	/**
+		mortonDecode splits the bits of an index along a Morton curve
+			into its x and y.
+
+			@param1 a_index is the index.
+	*/
+	static glm::uvec2 mortonDecode(unsigned int a_index)
+	{
+		glm::uvec2 position(0);
+		for (unsigned int bit = 0; bit < 16; ++bit)
+		{
+			position.x |= ((a_index >> (bit * 2)) & 1u) << bit;
+			position.y |= ((a_index >> (bit * 2 + 1)) & 1u) << bit;
+		}
+		return position;
+	}
+
+	ShadowAtlas::ShadowAtlas()
+		: m_resolution(DEFAULT_RESOLUTION),
+		m_framebuffer(0),
+		m_staticDraws(0),
+		m_dynamicDraws(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffer. The handles delete the
+			textures and buffer.
+	*/
+	ShadowAtlas::~ShadowAtlas()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the cached and the drawn atlas, depth textures that
+			compare as they are sampled, and the buffer of slots.
+
+			@param1 a_resolution is the width and height of the atlas.
+
+			@return false without GL 4.3.
+	*/
+	bool ShadowAtlas::create(unsigned int a_resolution)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("ShadowAtlas: shadowed point and spot lights need GL 4.3.\n");
+			return false;
+		}
+		m_resolution = a_resolution < MAX_TILE ? MAX_TILE : a_resolution;
+
+		GpuMemory& memory = GpuMemory::instance();
+		TextureHandle* textures[2] = { &m_staticTexture, &m_texture };
+		for (TextureHandle* texture : textures)
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, texture->put());
+			glTextureStorage2D(*texture, 1, GL_DEPTH_COMPONENT32F, m_resolution, m_resolution);
+			memory.trackTexture(*texture, GpuMemory::getTextureBytes(GL_DEPTH_COMPONENT32F, m_resolution, m_resolution),
+				GpuMemory::RENDER_TARGETS, "ShadowAtlas");
+			glTextureParameteri(*texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(*texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTextureParameteri(*texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		}
+
+		unsigned int bytes = MAX_SHADOWED_LIGHTS * TEXELS_PER_LIGHT * sizeof(glm::vec4);
+		glCreateBuffers(1, m_slotBuffer.put());
+		glNamedBufferStorage(m_slotBuffer, bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		memory.trackBuffer(m_slotBuffer, bytes, GpuMemory::LIGHTING, "ShadowAtlas");
+		glCreateTextures(GL_TEXTURE_BUFFER, 1, m_slotTexture.put());
+		glTextureBuffer(m_slotTexture, GL_RGBA32F, m_slotBuffer);
+
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferDrawBuffer(m_framebuffer, GL_NONE);
+		glNamedFramebufferReadBuffer(m_framebuffer, GL_NONE);
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_staticTexture, 0);
+		if (glCheckNamedFramebufferStatus(m_framebuffer, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("ShadowAtlas: the depth framebuffer isn't complete.\n");
+			destroy();
+			return false;
+		}
+
+		// Nothing has been drawn, outside of a tile is lit.
+		const float farDepth = 1.0f;
+		glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_texture, 0);
+		glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+		return true;
+	}
+
+	/**
+		invalidate makes the next update draw the static casters of every
+			tile again.
+	*/
+	void ShadowAtlas::invalidate()
+	{
+		for (Slot& slot : m_slots)
+			slot.cached = false;
+	}
+
+	/**
+		update picks the lights to shadow, packs their tiles and draws
+			those that are out of date.
+
+		The lights covering the most of the screen are given tiles first,
+			the width of their sphere on screen rounded up to a power of
+			two, or the width they had if it hasn't changed by much.
+			While they don't fit the widest are halved, and then the
+			least covering left out. Tiles are then placed largest first
+			along a Morton curve, so each lands on a multiple of its own
+			width, and a light whose tiles haven't moved keeps its cache.
+
+			@param1 a_lights is the lights, their colour's w set to their
+					slot plus one, or 0 for none.
+
+			@param2 a_view is the camera's view.
+
+			@param3 a_projection is the camera's perspective projection.
+
+			@param4 a_viewportHeight is the height the camera is drawn at,
+					in pixels.
+
+			@param5 a_movedCasters is a world sphere around each dynamic
+					caster that moved since the last update.
+
+			@param6 a_staticCasters draws what never moves, only into the
+					tiles whose cache is out of date.
+
+			@param7 a_dynamicCasters draws what moves, into the tiles a
+					moved caster reaches, or is empty if nothing does.
+	*/
+	void ShadowAtlas::update(std::vector<LightClusters::Light>& a_lights, const glm::mat4& a_view,
+		const glm::mat4& a_projection, int a_viewportHeight, const std::vector<glm::vec4>& a_movedCasters,
+		const CasterFunction& a_staticCasters, const CasterFunction& a_dynamicCasters)
+	{
+		m_staticDraws = 0;
+		m_dynamicDraws = 0;
+		for (LightClusters::Light& light : a_lights)
+			light.colour.w = 0.0f;
+		if (isCreated() == false)
+			return;
+
+		// How wide each light's sphere is on screen, or the whole screen
+		//	from inside it. Lights wholly behind the camera aren't seen.
+		unsigned int lightCount = (unsigned int)std::min(a_lights.size(), (size_t)LightClusters::MAX_LIGHTS);
+		float pixels = a_projection[1][1] * a_viewportHeight;
+		m_requests.clear();
+		for (unsigned int i = 0; i < lightCount; ++i)
+		{
+			const glm::vec4& positionRange = a_lights[i].positionRange;
+			glm::vec3 centre = glm::vec3(a_view * glm::vec4(glm::vec3(positionRange), 1.0f));
+			float radius = positionRange.w;
+			if (centre.z - radius > 0.0f)
+				continue;
+
+			float squared = glm::dot(centre, centre) - radius * radius;
+			float coverage = squared <= 0.0f ? (float)a_viewportHeight : radius / std::sqrt(squared) * pixels;
+			if (coverage >= MIN_COVERAGE)
+				m_requests.push_back({ i, coverage, 0 });
+		}
+		std::sort(m_requests.begin(), m_requests.end(),
+			[](const Request& a_first, const Request& a_second) { return a_first.coverage > a_second.coverage; });
+		if (m_requests.size() > MAX_SHADOWED_LIGHTS)
+			m_requests.resize(MAX_SHADOWED_LIGHTS);
+
+		std::vector<Slot> previous;
+		previous.swap(m_slots);
+		auto findPrevious = [&previous](unsigned int a_light) -> const Slot*
+		{
+			for (const Slot& slot : previous)
+			{
+				if (slot.light == a_light)
+					return &slot;
+			}
+			return nullptr;
+		};
+
+		unsigned int area = 0;
+		for (Request& request : m_requests)
+		{
+			unsigned int size = MIN_TILE;
+			while (size < MAX_TILE && (float)size < request.coverage)
+				size *= 2;
+			const Slot* slot = findPrevious(request.light);
+			if (slot != nullptr && request.coverage > slot->size * 0.5f * SHRINK_MARGIN &&
+				request.coverage <= slot->size * GROW_MARGIN)
+			{
+				size = slot->size;
+			}
+			request.size = size;
+
+			unsigned int faces = a_lights[request.light].spot.w > -1.0f ? 1 : 6;
+			area += faces * (size / MIN_TILE) * (size / MIN_TILE);
+		}
+
+		// Halving the widest first, down to the narrowest, then leaving
+		//	out the least covering.
+		unsigned int capacity = (m_resolution / MIN_TILE) * (m_resolution / MIN_TILE);
+		while (area > capacity && m_requests.empty() == false)
+		{
+			Request* widest = &m_requests.back();
+			for (Request& request : m_requests)
+			{
+				if (request.size > widest->size)
+					widest = &request;
+			}
+
+			unsigned int faces = a_lights[widest->light].spot.w > -1.0f ? 1 : 6;
+			unsigned int units = (widest->size / MIN_TILE) * (widest->size / MIN_TILE);
+			if (widest->size > MIN_TILE)
+			{
+				widest->size /= 2;
+				area -= faces * (units - units / 4);
+			}
+			else
+			{
+				faces = a_lights[m_requests.back().light].spot.w > -1.0f ? 1 : 6;
+				area -= faces;
+				m_requests.pop_back();
+			}
+		}
+
+		// Each tile is placed after every wider one, in the order their
+		//	lights cover the screen, so the same lights and widths are
+		//	always packed the same.
+		for (const Request& request : m_requests)
+		{
+			const LightClusters::Light& light = a_lights[request.light];
+			Slot slot;
+			slot.light = request.light;
+			slot.positionRange = light.positionRange;
+			slot.spot = light.spot;
+			slot.size = request.size;
+			slot.faceCount = light.spot.w > -1.0f ? 1 : 6;
+			slot.cached = false;
+			slot.dynamic = false;
+			m_slots.push_back(slot);
+		}
+		unsigned int offset = 0;
+		for (unsigned int size = MAX_TILE; size >= MIN_TILE; size /= 2)
+		{
+			unsigned int units = (size / MIN_TILE) * (size / MIN_TILE);
+			for (Slot& slot : m_slots)
+			{
+				if (slot.size != size)
+					continue;
+				for (unsigned int face = 0; face < slot.faceCount; ++face)
+				{
+					slot.origins[face] = mortonDecode(offset) * MIN_TILE;
+					offset += units;
+				}
+			}
+		}
+
+		for (unsigned int i = 0; i < (unsigned int)m_slots.size(); ++i)
+		{
+			Slot& slot = m_slots[i];
+			fit(slot);
+			a_lights[slot.light].colour.w = (float)(i + 1);
+
+			const Slot* last = findPrevious(slot.light);
+			if (last != nullptr)
+			{
+				slot.dynamic = last->dynamic;
+				slot.cached = last->cached && last->positionRange == slot.positionRange && last->spot == slot.spot &&
+					last->size == slot.size && std::equal(slot.origins, slot.origins + slot.faceCount, last->origins);
+			}
+		}
+
+		int previousFramebuffer = 0;
+		int previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+		RenderState& state = RenderState::instance();
+		bool depthMask = state.getDepthMask();
+		state.setDepthMask(true);
+		state.setDepthFunc(GL_LESS);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glEnable(GL_SCISSOR_TEST);
+		glPolygonOffset(OFFSET_FACTOR, OFFSET_UNITS);
+
+		for (Slot& slot : m_slots)
+		{
+			// A light moved casters reach, or reached last update, has its
+			//	tiles made again, so they show where the casters are now.
+			bool reached = false;
+			for (const glm::vec4& caster : a_movedCasters)
+			{
+				float reach = slot.positionRange.w + caster.w;
+				glm::vec3 offset = glm::vec3(caster) - glm::vec3(slot.positionRange);
+				if (glm::dot(offset, offset) < reach * reach)
+				{
+					reached = true;
+					break;
+				}
+			}
+			bool redraw = slot.cached == false || reached || slot.dynamic;
+			slot.dynamic = reached;
+
+			for (unsigned int face = 0; face < slot.faceCount; ++face)
+			{
+				if (slot.cached == false)
+				{
+					drawFace(m_staticTexture, slot, face, true, a_staticCasters);
+					++m_staticDraws;
+				}
+				if (redraw)
+				{
+					glCopyImageSubData(m_staticTexture, GL_TEXTURE_2D, 0, slot.origins[face].x, slot.origins[face].y, 0,
+						m_texture, GL_TEXTURE_2D, 0, slot.origins[face].x, slot.origins[face].y, 0,
+						slot.size, slot.size, 1);
+					if (reached && a_dynamicCasters)
+						drawFace(m_texture, slot, face, false, a_dynamicCasters);
+					++m_dynamicDraws;
+				}
+			}
+			slot.cached = true;
+		}
+
+		glDisable(GL_SCISSOR_TEST);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		state.setDepthMask(depthMask);
+		state.setDepthFunc(state.getNearerDepthFunc());
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		upload();
+	}
+
+	/**
+		fit finds a slot's projection views for its light. A spot light's
+			face looks down its cone, as wide as the cone is, and a point
+			light's six look along each axis a quarter turn wide.
+
+			@param1 a_slot is the slot, given its light.
+	*/
+	void ShadowAtlas::fit(Slot& a_slot) const
+	{
+		glm::vec3 position = glm::vec3(a_slot.positionRange);
+		float range = a_slot.positionRange.w;
+		float nearPlane = range * NEAR_SCALE;
+		if (a_slot.faceCount == 1)
+		{
+			glm::vec3 direction = glm::normalize(glm::vec3(a_slot.spot));
+			glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+			float angle = std::acos(glm::clamp(a_slot.spot.w, -1.0f, 1.0f)) * 2.0f;
+			angle = glm::clamp(angle, glm::radians(1.0f), glm::radians(170.0f));
+			a_slot.projectionViews[0] = glm::perspective(angle, 1.0f, nearPlane, range) *
+				glm::lookAt(position, position + direction, up);
+		}
+		else
+		{
+			glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, range);
+			for (unsigned int face = 0; face < 6; ++face)
+			{
+				a_slot.projectionViews[face] = projection *
+					glm::lookAt(position, position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+			}
+		}
+	}
+
+	/**
+		drawFace draws casters into one face of a slot, over its tile and
+			no further.
+
+			@param1 a_texture is the atlas drawn into.
+
+			@param2 a_slot is the slot.
+
+			@param3 a_face is the face.
+
+			@param4 a_clear is whether to clear the tile first.
+
+			@param5 a_casters draws the casters.
+	*/
+	void ShadowAtlas::drawFace(unsigned int a_texture, const Slot& a_slot, unsigned int a_face, bool a_clear,
+		const CasterFunction& a_casters)
+	{
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, a_texture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		const glm::uvec2& origin = a_slot.origins[a_face];
+		glViewport(origin.x, origin.y, a_slot.size, a_slot.size);
+		glScissor(origin.x, origin.y, a_slot.size, a_slot.size);
+
+		// Cleared to 1 whatever the scene's depth clears to, the atlas is
+		//	never reversed.
+		const float farDepth = 1.0f;
+		if (a_clear)
+			glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+		if (!a_casters)
+			return;
+
+		// With reversed depth, clip z goes from 0 to 1, so the casters are
+		//	drawn with z moved into it, as ShadowCascades draws them. What
+		//	the atlas stores is the same either way.
+		if (RenderState::instance().isReverseZ())
+		{
+			const glm::mat4 zeroToOne(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0.5f, 0, 0, 0, 0.5f, 1);
+			a_casters(zeroToOne * a_slot.projectionViews[a_face]);
+		}
+		else
+		{
+			a_casters(a_slot.projectionViews[a_face]);
+		}
+	}
+
+	/**
+		upload writes every slot's matrices, from world space into its
+			tiles from 0 to 1 in x, y and depth, and its parameters.
+	*/
+	void ShadowAtlas::upload()
+	{
+		if (m_slots.empty())
+			return;
+
+		m_texels.assign(m_slots.size() * TEXELS_PER_LIGHT * 4, 0.0f);
+		for (unsigned int i = 0; i < (unsigned int)m_slots.size(); ++i)
+		{
+			const Slot& slot = m_slots[i];
+			float* texels = m_texels.data() + i * TEXELS_PER_LIGHT * 4;
+			float scale = slot.size / (float)m_resolution;
+			for (unsigned int face = 0; face < slot.faceCount; ++face)
+			{
+				glm::vec2 corner = glm::vec2(slot.origins[face]) / (float)m_resolution;
+				const glm::mat4 bias(0.5f * scale, 0, 0, 0, 0, 0.5f * scale, 0, 0, 0, 0, 0.5f, 0,
+					corner.x + 0.5f * scale, corner.y + 0.5f * scale, 0.5f, 1);
+				glm::mat4 matrix = bias * slot.projectionViews[face];
+				std::copy(&matrix[0][0], &matrix[0][0] + 16, texels + face * 16);
+			}
+			float* parameters = texels + (TEXELS_PER_LIGHT - 1) * 4;
+			parameters[0] = (float)slot.faceCount;
+			parameters[1] = DEPTH_BIAS;
+		}
+		glNamedBufferSubData(m_slotBuffer, 0, m_texels.size() * sizeof(float), m_texels.data());
+	}
+
+	/**
+		bind binds the atlas and its slots to their texture units, and
+			points a program's samplers at them if it has them.
+
+			@param1 a_program is the program, which must be bound.
+	*/
+	void ShadowAtlas::bind(aie::ShaderProgram& a_program) const
+	{
+		static constexpr aie::UniformHandle SHADOW_ATLAS("ShadowAtlas");
+		static constexpr aie::UniformHandle SHADOW_ATLAS_SLOTS("ShadowAtlasSlots");
+
+		// The samplers are pointed at their units even without the atlas,
+		//	as a shadow sampler left on a material's unit can't be drawn
+		//	with.
+		if (isCreated())
+		{
+			glBindTextureUnit(ATLAS_UNIT, m_texture);
+			glBindTextureUnit(SLOT_UNIT, m_slotTexture);
+		}
+		a_program.bindUniform(SHADOW_ATLAS, (int)ATLAS_UNIT);
+		a_program.bindUniform(SHADOW_ATLAS_SLOTS, (int)SLOT_UNIT);
+	}
+
+	/**
+		destroy deletes the framebuffer, textures and buffer.
+	*/
+	void ShadowAtlas::destroy()
+	{
+		if (m_framebuffer != 0)
+			glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+		m_slotTexture.reset();
+		m_slotBuffer.reset();
+		m_staticTexture.reset();
+		m_texture.reset();
+		m_slots.clear();
+	}
+}
@@ -0,0 +1,238 @@
+/**
+	ShadowAtlas.h
+
+	Purpose: ShadowAtlas.h is the header file for the ShadowAtlas class.
+			The ShadowAtlas shadows the clustered point and spot lights
+			from tiles of one depth texture, each sized by how much of
+			the screen its light covers, and only draws a tile again
+			when its light or something moving near it has changed.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "LightClusters.h"
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <functional>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The ShadowAtlas class gives the point and spot lights nearest to
+			covering the screen square tiles of one atlas, a power of two
+			wide each. A spot light is a single perspective tile down its
+			cone, a point light a tile for each face of a cube around it.
+			How wide a light's tiles are follows how wide its sphere is
+			on screen, between MIN_TILE and MAX_TILE, and is shrunk for
+			every light when they don't all fit. Lights left without
+			room aren't shadowed.
+
+		The tiles are packed largest first in Morton order, which leaves
+			no gaps between tiles that are powers of two. A light keeps
+			its width until its sphere grows or shrinks well past it, so
+			the packing, and the tiles, stay where they are while the
+			camera moves.
+
+		Like ShadowCascades, the static casters are drawn into a cache of
+			the whole atlas, and a tile is only drawn into it again when
+			its light moves or changes, when its tile moves, or when
+			invalidate is called. Each tile of the atlas shaders read is
+			the cached tile copied over, with the dynamic casters drawn
+			on top, and is only made again when its cache was or a
+			moving caster's sphere touches its light, that frame or the
+			one before, so what moved out of its reach is taken out.
+
+		The lights find their tiles through their colour's w, which is
+			set to their slot plus one, 0 for none. A slot is
+			TEXELS_PER_LIGHT RGBA32F texels of a texture buffer, the
+			world to tile matrix of each face and then the light's
+			parameters. Needs GL 4.3, without it create fails and the
+			lights aren't shadowed.
+	*/
+	class ShadowAtlas
+	{
+	public:
+		// The width and height of the atlas unless create is given another.
+		static const unsigned int DEFAULT_RESOLUTION = 4096;
+
+		// The narrowest and widest tiles a face is given.
+		static const unsigned int MIN_TILE = 64;
+		static const unsigned int MAX_TILE = 1024;
+
+		// The most lights shadowed at once.
+		static const unsigned int MAX_SHADOWED_LIGHTS = 64;
+
+		// Must match the shaders, six matrices and the parameters.
+		static const unsigned int TEXELS_PER_LIGHT = 25;
+
+		// The texture units fragment shaders read the atlas and its
+		//	slots from, clear of the units every other pass uses.
+		static const unsigned int ATLAS_UNIT = 19;
+		static const unsigned int SLOT_UNIT = 20;
+
+		/**
+			Draws casters with the bound depth framebuffer, seen from a
+				light through one face's projection view.
+		*/
+		typedef std::function<void(const glm::mat4& a_projectionView)> CasterFunction;
+
+		ShadowAtlas();
+
+		/**
+			The deconstructor deletes the framebuffer.
+		*/
+		~ShadowAtlas();
+
+		ShadowAtlas(const ShadowAtlas&) = delete;
+		ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+		/**
+			create makes the cached and the drawn atlas, and the buffer of
+				slots.
+
+				@param1 a_resolution is the width and height of the atlas.
+
+				@return false without GL 4.3.
+		*/
+		bool create(unsigned int a_resolution = DEFAULT_RESOLUTION);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_texture != 0; }
+
+		/**
+			invalidate makes the next update draw the static casters of
+				every tile again, for when they were added or moved.
+		*/
+		void invalidate();
+
+		/**
+			update picks the lights to shadow, packs their tiles and draws
+				those that are out of date. It must run before the lights
+				are uploaded, as it sets their colour's w.
+
+				@param1 a_lights is the lights, their colour's w set to
+						their slot plus one, or 0 for none.
+
+				@param2 a_view is the camera's view.
+
+				@param3 a_projection is the camera's perspective projection.
+
+				@param4 a_viewportHeight is the height the camera is drawn
+						at, in pixels.
+
+				@param5 a_movedCasters is a world sphere around each dynamic
+						caster that moved since the last update.
+
+				@param6 a_staticCasters draws what never moves, only into
+						the tiles whose cache is out of date.
+
+				@param7 a_dynamicCasters draws what moves, into the tiles a
+						moved caster reaches, or is empty if nothing does.
+		*/
+		void update(std::vector<LightClusters::Light>& a_lights, const glm::mat4& a_view,
+			const glm::mat4& a_projection, int a_viewportHeight, const std::vector<glm::vec4>& a_movedCasters,
+			const CasterFunction& a_staticCasters, const CasterFunction& a_dynamicCasters);
+
+		/**
+			getShadowedCount returns how many lights the last update gave
+				tiles.
+		*/
+		unsigned int getShadowedCount() const { return (unsigned int)m_slots.size(); }
+
+		/**
+			getStaticDraws returns how many faces had their static casters
+				drawn by the last update, 0 while the cache held.
+		*/
+		unsigned int getStaticDraws() const { return m_staticDraws; }
+
+		/**
+			getDynamicDraws returns how many faces had their tile made
+				again by the last update.
+		*/
+		unsigned int getDynamicDraws() const { return m_dynamicDraws; }
+
+		/**
+			bind binds the atlas and its slots to their texture units, and
+				points a program's samplers at them if it has them.
+
+				@param1 a_program is the program, which must be bound.
+		*/
+		void bind(aie::ShaderProgram& a_program) const;
+
+	private:
+		/**
+			A shadowed light and where its faces are.
+		*/
+		struct Slot
+		{
+			// The light's index, and what it was when its faces were
+			//	drawn.
+			unsigned int light;
+			glm::vec4 positionRange;
+			glm::vec4 spot;
+
+			// How wide each face's tile is, how many faces there are,
+			//	each one's corner in the atlas and its projection view.
+			unsigned int size;
+			unsigned int faceCount;
+			glm::uvec2 origins[6];
+			glm::mat4 projectionViews[6];
+
+			// Whether the cached static casters are still what the faces
+			//	see, and whether a moved caster was in reach last update.
+			bool cached;
+			bool dynamic;
+		};
+
+		/**
+			A light wanting a tile, and how much it wants one.
+		*/
+		struct Request
+		{
+			unsigned int light;
+			float coverage;
+			unsigned int size;
+		};
+
+		// Deletes the framebuffer.
+		void destroy();
+
+		// Finds a slot's projection views for its light.
+		void fit(Slot& a_slot) const;
+
+		// Draws casters into one face of a slot, in the bound atlas.
+		void drawFace(unsigned int a_texture, const Slot& a_slot, unsigned int a_face, bool a_clear,
+			const CasterFunction& a_casters);
+
+		// Writes every slot's matrices and parameters to the buffer.
+		void upload();
+
+		unsigned int m_resolution;
+
+		// The slots of the last update, in order, and what each light
+		//	wanted.
+		std::vector<Slot> m_slots;
+		std::vector<Request> m_requests;
+		std::vector<float> m_texels;
+
+		unsigned int m_framebuffer;
+
+		// The static casters' depth, and the atlas the shaders read, the
+		//	static depth with the dynamic casters drawn over it.
+		TextureHandle m_staticTexture;
+		TextureHandle m_texture;
+
+		// The slots, and the texture buffer they are read through.
+		BufferHandle m_slotBuffer;
+		TextureHandle m_slotTexture;
+
+		unsigned int m_staticDraws;
+		unsigned int m_dynamicDraws;
+	};
+}
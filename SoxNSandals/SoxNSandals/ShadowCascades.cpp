@@ -0,0 +1,354 @@
+/**
+	ShadowCascades.cpp
+
+	Purpose: ShadowCascades.cpp is the source file for the ShadowCascades
+			class. The ShadowCascades are the shadow maps of the frame's
+			directional light, split by distance from the camera so
+			near shadows get as many texels as far ones.
+
+	@author Nathan Nette
+*/
+#include "ShadowCascades.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	// The slope scaled and constant offsets casters are drawn with, so a
+	//	surface doesn't shadow itself.
+	static const float OFFSET_FACTOR = 2.0f;
+	static const float OFFSET_UNITS = 4.0f;
+
+	// What the shaders take off a fragment's depth in the map as well.
+	static const float DEPTH_BIAS = 0.0002f;
+
+	ShadowCascades::ShadowCascades()
+		: m_cascades(),
+		m_shadowDistance(0.0f),
+		m_casterDistance(0.0f),
+		m_resolution(DEFAULT_RESOLUTION),
+		m_lightDirection(0.0f),
+		m_lightView(1.0f),
+		m_framebuffer(0),
+		m_staticTexture(0),
+		m_texture(0),
+		m_dynamic(false),
+		m_updated(false),
+		m_staticDraws(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffer and textures.
+	*/
+	ShadowCascades::~ShadowCascades()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the cached and the drawn maps, depth textures with a
+			layer per cascade that compare as they are sampled.
+
+			@param1 a_shadowDistance is how far from the camera there are
+					shadows. The camera's far plane is used if it is nearer.
+
+			@param2 a_casterDistance is how far towards the light from a
+					cascade casters are still drawn.
+
+			@param3 a_resolution is the width and height of every
+					cascade's map.
+
+			@return false without GL 4.3.
+	*/
+	bool ShadowCascades::create(float a_shadowDistance, float a_casterDistance, unsigned int a_resolution)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("ShadowCascades: cached shadows need GL 4.3.\n");
+			return false;
+		}
+
+		m_shadowDistance = a_shadowDistance;
+		m_casterDistance = a_casterDistance;
+		m_resolution = a_resolution;
+
+		// Outside of a map is lit.
+		const float border[4] = { 1, 1, 1, 1 };
+		unsigned int* textures[2] = { &m_staticTexture, &m_texture };
+		for (unsigned int* texture : textures)
+		{
+			glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, texture);
+			glTextureStorage3D(*texture, 1, GL_DEPTH_COMPONENT32F, m_resolution, m_resolution, CASCADE_COUNT);
+			GpuMemory::instance().trackTexture(*texture, GpuMemory::getTextureBytes(GL_DEPTH_COMPONENT32F,
+				m_resolution, m_resolution, CASCADE_COUNT), GpuMemory::RENDER_TARGETS, "ShadowCascades");
+			glTextureParameteri(*texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+			glTextureParameterfv(*texture, GL_TEXTURE_BORDER_COLOR, border);
+			glTextureParameteri(*texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTextureParameteri(*texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		}
+
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferDrawBuffer(m_framebuffer, GL_NONE);
+		glNamedFramebufferReadBuffer(m_framebuffer, GL_NONE);
+		glNamedFramebufferTextureLayer(m_framebuffer, GL_DEPTH_ATTACHMENT, m_staticTexture, 0, 0);
+		if (glCheckNamedFramebufferStatus(m_framebuffer, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("ShadowCascades: the depth framebuffer isn't complete.\n");
+			destroy();
+			return false;
+		}
+
+		invalidate();
+		return true;
+	}
+
+	/**
+		invalidate makes the next update draw the static casters of every
+			cascade again.
+	*/
+	void ShadowCascades::invalidate()
+	{
+		for (Cascade& cascade : m_cascades)
+			cascade.cached = false;
+	}
+
+	/**
+		update fits the cascades to the camera and draws their maps. Each
+			slice's sphere is found in the light's view, and its cache is
+			kept while the sphere is still inside the box it was drawn
+			for. A box drawn again is moved a whole texel at a time, so
+			its texels land where the old ones did and edges don't
+			crawl as it moves.
+
+			@param1 a_lightDirection is the direction the light shines.
+
+			@param2 a_view is the camera's view.
+
+			@param3 a_projection is the camera's perspective projection.
+
+			@param4 a_nearPlane is the near plane it was made with.
+
+			@param5 a_farPlane is the far plane it was made with, there
+					are no shadows past it.
+
+			@param6 a_staticCasters draws what never moves, only into the
+					cascades whose cache is out of date.
+
+			@param7 a_dynamicCasters draws what moves, into every cascade
+					each frame, or is empty if nothing does.
+	*/
+	void ShadowCascades::update(const glm::vec3& a_lightDirection, const glm::mat4& a_view, const glm::mat4& a_projection,
+		float a_nearPlane, float a_farPlane, const CasterFunction& a_staticCasters, const CasterFunction& a_dynamicCasters)
+	{
+		m_staticDraws = 0;
+		if (isCreated() == false)
+			return;
+
+		// The light moving turns every cached box.
+		glm::vec3 direction = glm::normalize(a_lightDirection);
+		if (direction != m_lightDirection)
+		{
+			m_lightDirection = direction;
+			glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+			m_lightView = glm::lookAt(glm::vec3(0), direction, up);
+			invalidate();
+		}
+
+		// The planes are passed in, since a reversed projection has no
+		//	far plane. The projection gives how far out a slice's
+		//	corners are for each unit of depth.
+		float nearPlane = a_nearPlane;
+		float farPlane = a_farPlane;
+		float shadowDistance = m_shadowDistance < farPlane ? m_shadowDistance : farPlane;
+		float tanX = 1.0f / a_projection[0][0];
+		float tanY = 1.0f / a_projection[1][1];
+		float spread = tanX * tanX + tanY * tanY;
+		glm::mat4 inverseView = glm::inverse(a_view);
+
+		float sliceNear = nearPlane;
+		for (unsigned int i = 0; i < CASCADE_COUNT; ++i)
+		{
+			Cascade& cascade = m_cascades[i];
+
+			float t = (i + 1) / (float)CASCADE_COUNT;
+			float even = nearPlane + (shadowDistance - nearPlane) * t;
+			float exponential = nearPlane * std::pow(shadowDistance / nearPlane, t);
+			float sliceFar = even + (exponential - even) * SPLIT_BLEND;
+
+			// The smallest sphere around the slice is centred on the view
+			//	axis, as far from its near corners as its far ones.
+			float centreDepth = (sliceNear + sliceFar) * (1.0f + spread) * 0.5f;
+			if (centreDepth > sliceFar)
+				centreDepth = sliceFar;
+			float toNear = (centreDepth - sliceNear) * (centreDepth - sliceNear) + sliceNear * sliceNear * spread;
+			float toFar = (sliceFar - centreDepth) * (sliceFar - centreDepth) + sliceFar * sliceFar * spread;
+			float radius = std::sqrt(toNear > toFar ? toNear : toFar);
+
+			glm::vec3 centre = glm::vec3(m_lightView * (inverseView * glm::vec4(0, 0, -centreDepth, 1)));
+			sliceNear = sliceFar;
+
+			// A different camera projection changes the slice's size.
+			if (cascade.cached && std::abs(radius - cascade.radius) < radius * 0.001f)
+			{
+				glm::vec3 offset = glm::abs(centre - cascade.centre);
+				float room = cascade.halfSize - radius;
+				if (offset.x <= room && offset.y <= room && offset.z <= room)
+				{
+					cascade.split = sliceFar;
+					continue;
+				}
+			}
+
+			cascade.split = sliceFar;
+			cascade.radius = radius;
+			cascade.halfSize = radius * (1.0f + CACHE_MARGIN);
+
+			float texel = cascade.halfSize * 2.0f / m_resolution;
+			cascade.centre = glm::vec3(std::floor(centre.x / texel) * texel, std::floor(centre.y / texel) * texel, centre.z);
+
+			// The light looks down -z, so casters up to m_casterDistance
+			//	in front of the box are in it too.
+			float depth = -cascade.centre.z;
+			glm::mat4 projection = glm::ortho(cascade.centre.x - cascade.halfSize, cascade.centre.x + cascade.halfSize,
+				cascade.centre.y - cascade.halfSize, cascade.centre.y + cascade.halfSize,
+				depth - cascade.halfSize - m_casterDistance, depth + cascade.halfSize);
+			cascade.projectionView = projection * m_lightView;
+
+			const glm::mat4 bias(0.5f, 0, 0, 0, 0, 0.5f, 0, 0, 0, 0, 0.5f, 0, 0.5f, 0.5f, 0.5f, 1);
+			cascade.shadowMatrix = bias * cascade.projectionView;
+
+			// With reversed depth, clip z goes from 0 to 1, so the casters
+			//	are drawn with z moved into it. What the maps store is
+			//	the same either way, and the maps aren't reversed.
+			if (RenderState::instance().isReverseZ())
+			{
+				const glm::mat4 zeroToOne(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0.5f, 0, 0, 0, 0.5f, 1);
+				cascade.projectionView = zeroToOne * cascade.projectionView;
+			}
+			cascade.cached = false;
+		}
+
+		int previousFramebuffer = 0;
+		int previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+		RenderState& state = RenderState::instance();
+		bool depthMask = state.getDepthMask();
+		state.setDepthMask(true);
+		state.setDepthFunc(GL_LESS);
+		glViewport(0, 0, m_resolution, m_resolution);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(OFFSET_FACTOR, OFFSET_UNITS);
+
+		for (unsigned int i = 0; i < CASCADE_COUNT; ++i)
+		{
+			if (m_cascades[i].cached)
+				continue;
+
+			drawCasters(m_staticTexture, i, true, a_staticCasters);
+			m_cascades[i].cached = true;
+			++m_staticDraws;
+		}
+
+		// The drawn maps start as the cache, the few dynamic casters are
+		//	all that is drawn each frame.
+		m_dynamic = (bool)a_dynamicCasters;
+		if (m_dynamic)
+		{
+			glCopyImageSubData(m_staticTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+				m_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, m_resolution, m_resolution, CASCADE_COUNT);
+			for (unsigned int i = 0; i < CASCADE_COUNT; ++i)
+				drawCasters(m_texture, i, false, a_dynamicCasters);
+		}
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		state.setDepthMask(depthMask);
+		state.setDepthFunc(state.getNearerDepthFunc());
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		m_updated = true;
+	}
+
+	/**
+		drawCasters draws casters into one layer of a map.
+
+			@param1 a_texture is the map.
+
+			@param2 a_cascade is the layer and cascade to draw.
+
+			@param3 a_clear is whether to clear the layer first.
+
+			@param4 a_casters draws the casters.
+	*/
+	void ShadowCascades::drawCasters(unsigned int a_texture, unsigned int a_cascade, bool a_clear,
+		const CasterFunction& a_casters)
+	{
+		glNamedFramebufferTextureLayer(m_framebuffer, GL_DEPTH_ATTACHMENT, a_texture, 0, a_cascade);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		// Cleared to 1 whatever the scene's depth clears to, the maps
+		//	are never reversed.
+		const float farDepth = 1.0f;
+		if (a_clear)
+			glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+		if (a_casters)
+			a_casters(m_cascades[a_cascade].projectionView);
+	}
+
+	/**
+		getSplits returns the view depth each cascade reaches to.
+	*/
+	glm::vec4 ShadowCascades::getSplits() const
+	{
+		return glm::vec4(m_cascades[0].split, m_cascades[1].split, m_cascades[2].split, m_cascades[3].split);
+	}
+
+	/**
+		getParameters returns what the shaders sample with, the size of a
+			texel, the depth bias, and whether there are shadows yet.
+	*/
+	glm::vec4 ShadowCascades::getParameters() const
+	{
+		return glm::vec4(1.0f / m_resolution, DEPTH_BIAS, 0.0f, m_updated ? 1.0f : 0.0f);
+	}
+
+	/**
+		bind binds the maps to their texture unit, and points a program's
+			sampler at it if it has one.
+
+			@param1 a_program is the program, which must be bound.
+	*/
+	void ShadowCascades::bind(aie::ShaderProgram& a_program) const
+	{
+		static constexpr aie::UniformHandle SHADOW_CASCADES("ShadowCascades");
+
+		// The sampler is pointed at its unit even without shadows, as a
+		//	shadow sampler left on a material's unit can't be drawn with.
+		if (isCreated())
+			glBindTextureUnit(SHADOW_UNIT, m_dynamic ? m_texture : m_staticTexture);
+		a_program.bindUniform(SHADOW_CASCADES, (int)SHADOW_UNIT);
+	}
+
+	/**
+		destroy deletes the framebuffer and textures.
+	*/
+	void ShadowCascades::destroy()
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteTextures(1, &m_staticTexture);
+		glDeleteTextures(1, &m_texture);
+		GpuMemory::instance().releaseTexture(m_staticTexture);
+		GpuMemory::instance().releaseTexture(m_texture);
+		m_framebuffer = m_staticTexture = m_texture = 0;
+		m_updated = false;
+	}
+}
@@ -0,0 +1,228 @@
+/**
+	ShadowCascades.h
+
+	Purpose: ShadowCascades.h is the header file for the ShadowCascades
+			class. The ShadowCascades are the shadow maps of the frame's
+			directional light, split by distance from the camera so
+			near shadows get as many texels as far ones.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <functional>
+
+namespace sns
+{
+	/**
+		The ShadowCascades class splits the camera's view into
+			CASCADE_COUNT slices of depth, spaced between even and
+			exponential, and fits an orthographic shadow map from the
+			light to each. A slice is fitted with its bounding sphere,
+			so its map keeps the same size however the camera turns.
+
+		Static casters are drawn into a cached copy of every cascade,
+			which reaches CACHE_MARGIN further than its slice needs.
+			It is only drawn again when the light moves, when invalidate
+			is called, or when the camera moves its slice outside of
+			it. Every frame the cache is copied into the maps shaders
+			read and only the dynamic casters are drawn over it.
+
+		Copying the cached depth needs GL 4.3, without it create fails
+			and shaders see no shadows.
+	*/
+	class ShadowCascades
+	{
+	public:
+		// Must match the size of ShadowMatrices in the shaders.
+		static const unsigned int CASCADE_COUNT = 4;
+
+		// The width and height of every cascade's map unless create is
+		//	given another.
+		static const unsigned int DEFAULT_RESOLUTION = 2048;
+
+		// The texture unit fragment shaders read the maps from, clear of
+		//	the units materials and LightClusters use.
+		static const unsigned int SHADOW_UNIT = 11;
+
+		// How much further than its slice a cached cascade reaches, as a
+		//	fraction of the slice's radius.
+		static constexpr float CACHE_MARGIN = 0.25f;
+
+		// How much of the way from even to exponential the slices are
+		//	spaced.
+		static constexpr float SPLIT_BLEND = 0.75f;
+
+		/**
+			Draws casters with the bound depth framebuffer, seen from the
+				light through a cascade's projection view.
+		*/
+		typedef std::function<void(const glm::mat4& a_projectionView)> CasterFunction;
+
+		ShadowCascades();
+
+		/**
+			The deconstructor deletes the framebuffer and textures.
+		*/
+		~ShadowCascades();
+
+		ShadowCascades(const ShadowCascades&) = delete;
+		ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+		/**
+			create makes the cached and the drawn maps.
+
+				@param1 a_shadowDistance is how far from the camera there
+						are shadows, past it everything is lit. The
+						camera's far plane is used if it is nearer.
+
+				@param2 a_casterDistance is how far towards the light from
+						a cascade casters are still drawn.
+
+				@param3 a_resolution is the width and height of every
+						cascade's map.
+
+				@return false without GL 4.3.
+		*/
+		bool create(float a_shadowDistance, float a_casterDistance,
+			unsigned int a_resolution = DEFAULT_RESOLUTION);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_texture != 0; }
+
+		/**
+			invalidate makes the next update draw the static casters of
+				every cascade again, for when they were added or moved.
+		*/
+		void invalidate();
+
+		/**
+			update fits the cascades to the camera and draws their maps.
+
+				@param1 a_lightDirection is the direction the light shines.
+
+				@param2 a_view is the camera's view.
+
+				@param3 a_projection is the camera's perspective projection.
+
+				@param4 a_nearPlane is the near plane it was made with.
+
+				@param5 a_farPlane is the far plane it was made with, there
+						are no shadows past it.
+
+				@param6 a_staticCasters draws what never moves, only into
+						the cascades whose cache is out of date.
+
+				@param7 a_dynamicCasters draws what moves, into every
+						cascade each frame, or is empty if nothing does.
+		*/
+		void update(const glm::vec3& a_lightDirection, const glm::mat4& a_view, const glm::mat4& a_projection,
+			float a_nearPlane, float a_farPlane, const CasterFunction& a_staticCasters, const CasterFunction& a_dynamicCasters);
+
+		/**
+			getMatrix returns what a world position is multiplied by to
+				find where it is in a cascade's map, from 0 to 1 in x, y
+				and depth.
+
+				@param1 a_cascade is the cascade.
+		*/
+		const glm::mat4& getMatrix(unsigned int a_cascade) const { return m_cascades[a_cascade].shadowMatrix; }
+
+		/**
+			getProjectionView returns the light's projection view a
+				cascade was last drawn with, for culling its casters.
+
+				@param1 a_cascade is the cascade.
+		*/
+		const glm::mat4& getProjectionView(unsigned int a_cascade) const { return m_cascades[a_cascade].projectionView; }
+
+		/**
+			getSplits returns the view depth each cascade reaches to.
+		*/
+		glm::vec4 getSplits() const;
+
+		/**
+			getParameters returns what the shaders sample with. x is the
+				size of a texel in the maps, y the depth bias, and w is
+				1 once update has run and 0 before.
+		*/
+		glm::vec4 getParameters() const;
+
+		/**
+			getStaticDraws returns how many cascades had their static
+				casters drawn by the last update, 0 while the cache held.
+		*/
+		unsigned int getStaticDraws() const { return m_staticDraws; }
+
+		/**
+			bind binds the maps to their texture unit, and points a
+				program's sampler at it if it has one.
+
+				@param1 a_program is the program, which must be bound.
+		*/
+		void bind(aie::ShaderProgram& a_program) const;
+
+	private:
+		/**
+			A cascade and the light space box its cache was drawn for.
+		*/
+		struct Cascade
+		{
+			// The view depth the slice reaches to.
+			float split;
+
+			// The radius of the slice's bounding sphere, and half the
+			//	width of the box the cache covers.
+			float radius;
+			float halfSize;
+
+			// The centre of the box in the light's view.
+			glm::vec3 centre;
+
+			// The light's projection view for the box, and the same
+			//	biased into 0 to 1 for the shaders.
+			glm::mat4 projectionView;
+			glm::mat4 shadowMatrix;
+
+			// Whether the cached static casters are still what the box sees.
+			bool cached;
+		};
+
+		// Deletes the framebuffer and textures.
+		void destroy();
+
+		// Draws casters into one layer of a map.
+		void drawCasters(unsigned int a_texture, unsigned int a_cascade, bool a_clear,
+			const CasterFunction& a_casters);
+
+		Cascade m_cascades[CASCADE_COUNT];
+
+		float m_shadowDistance;
+		float m_casterDistance;
+		unsigned int m_resolution;
+
+		// The direction the cascades were fitted for, and the light's
+		//	rotation, which every cascade's box is in.
+		glm::vec3 m_lightDirection;
+		glm::mat4 m_lightView;
+
+		unsigned int m_framebuffer;
+
+		// The static casters' depth, and the maps the shaders read, the
+		//	static depth with the dynamic casters drawn over it.
+		unsigned int m_staticTexture;
+		unsigned int m_texture;
+
+		// Whether the last update drew any dynamic casters into m_texture,
+		//	without them the shaders read m_staticTexture.
+		bool m_dynamic;
+
+		bool m_updated;
+		unsigned int m_staticDraws;
+	};
+}
@@ -0,0 +1,130 @@
+/**
+	SharedContext.cpp
+
+	Purpose: SharedContext.cpp is the source file for the SharedContext
+			class. The SharedContext is a window whose context shares
+			objects with the main one, kept current on a thread of its
+			own that runs work whenever there is some.
+
+	@author Nathan Nette
+*/
+#include "SharedContext.h"
+#include "gl_core_4_5.h"
+#include <glfw3.h>
+#include <utility>
+
+namespace sns
+{
+	SharedContext::SharedContext()
+		: m_window(nullptr),
+		m_mutex(nullptr),
+		m_stopping(false)
+	{
+	}
+
+	/**
+		The deconstructor stops the thread, see destroy.
+	*/
+	SharedContext::~SharedContext()
+	{
+		destroy();
+	}
+
+	/**
+		create opens the window and starts the thread.
+
+			@param1 a_shared is the window whose context is shared.
+
+			@param2 a_title is the window's title.
+
+			@param3 a_width is the width of the window in pixels.
+
+			@param4 a_height is its height.
+
+			@param5 a_visible shows the window rather than hiding it.
+
+			@param6 a_mutex is the owner's mutex.
+
+			@param7 a_loop is what the thread runs.
+
+			@return false if the window can't be opened.
+	*/
+	bool SharedContext::create(GLFWwindow* a_shared, const char* a_title, int a_width, int a_height, bool a_visible,
+		std::mutex& a_mutex, Loop a_loop)
+	{
+		if (isCreated())
+			return true;
+
+		glfwWindowHint(GLFW_VISIBLE, a_visible ? GLFW_TRUE : GLFW_FALSE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		m_window = glfwCreateWindow(a_width, a_height, a_title, nullptr, a_shared);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+		if (m_window == nullptr)
+			return false;
+
+		m_mutex = &a_mutex;
+		m_loop = std::move(a_loop);
+		m_stopping = false;
+		m_thread = std::thread(&SharedContext::run, this);
+		return true;
+	}
+
+	/**
+		stop makes the loop finish and waits for the thread.
+	*/
+	void SharedContext::stop()
+	{
+		if (m_thread.joinable() == false)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(*m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	/**
+		destroy stops the thread and closes the window.
+	*/
+	void SharedContext::destroy()
+	{
+		if (isCreated() == false)
+			return;
+
+		stop();
+		m_loop = Loop();
+		glfwDestroyWindow(m_window);
+		m_window = nullptr;
+	}
+
+	/**
+		run makes the context current and steps the loop whenever it is
+			ready, until stop.
+	*/
+	void SharedContext::run()
+	{
+		// The functions were loaded for the main context. Both are made
+		//	by the same driver with the same pixel format, so they are
+		//	the same.
+		glfwMakeContextCurrent(m_window);
+		if (m_loop.begin != nullptr)
+			m_loop.begin();
+
+		std::unique_lock<std::mutex> lock(*m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [this]() { return m_stopping || m_loop.isReady(); });
+			if (m_stopping)
+				break;
+			m_loop.step(lock);
+		}
+		lock.unlock();
+
+		if (m_loop.end != nullptr)
+			m_loop.end();
+		glfwMakeContextCurrent(nullptr);
+	}
+}
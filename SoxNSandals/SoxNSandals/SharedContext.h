@@ -0,0 +1,136 @@
+/**
+	SharedContext.h
+
+	Purpose: SharedContext.h is the header file for the SharedContext
+			class. The SharedContext is a window whose context shares
+			objects with the main one, kept current on a thread of its
+			own that runs work whenever there is some.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct GLFWwindow;
+
+namespace sns
+{
+	/**
+		The SharedContext class owns a window whose context shares objects
+			with the main one, and the thread that keeps it current. It
+			is what the UploadThread, AsyncCompute and SharedWindow are
+			each built on.
+
+		The thread sleeps on its owner's mutex until the owner has
+			something for it, or it is stopped. The owner's state stays
+			its own, guarded by its own mutex, and the loop only asks
+			it whether there is work and to do it.
+
+		A window is the only way GLFW makes a context, so a hidden one
+			makes a context alone. A shown one isn't resizable, as only
+			the main thread can ask GLFW its size.
+	*/
+	class SharedContext
+	{
+	public:
+		/**
+			What the thread runs. begin and end are run with the context
+				current before and after the loop, isReady and step
+				with the owner's mutex locked. step can unlock it while
+				it works, but must lock it again before it returns.
+		*/
+		struct Loop
+		{
+			std::function<void()> begin;
+			std::function<bool()> isReady;
+			std::function<void(std::unique_lock<std::mutex>&)> step;
+			std::function<void()> end;
+		};
+
+		SharedContext();
+
+		/**
+			The deconstructor stops the thread, see destroy.
+		*/
+		~SharedContext();
+
+		SharedContext(const SharedContext&) = delete;
+		SharedContext& operator=(const SharedContext&) = delete;
+
+		/**
+			create opens the window and starts the thread. Must be called
+				on the main thread with a_shared's context current.
+
+				@param1 a_shared is the window whose context is shared.
+
+				@param2 a_title is the window's title.
+
+				@param3 a_width is the width of the window in pixels.
+
+				@param4 a_height is its height.
+
+				@param5 a_visible shows the window rather than hiding it.
+
+				@param6 a_mutex is the owner's mutex, guarding what the
+						loop reads, for as long as the thread runs.
+
+				@param7 a_loop is what the thread runs. isReady and step
+						are required.
+
+				@return false if the window can't be opened.
+		*/
+		bool create(GLFWwindow* a_shared, const char* a_title, int a_width, int a_height, bool a_visible,
+			std::mutex& a_mutex, Loop a_loop);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_window != nullptr; }
+
+		/**
+			getWindow returns the window, or nullptr before create.
+		*/
+		GLFWwindow* getWindow() const { return m_window; }
+
+		/**
+			wake tells the thread its owner may have work for it. Called
+				after the owner's mutex is unlocked.
+		*/
+		void wake() { m_wake.notify_one(); }
+
+		/**
+			isStopping returns whether stop has been called, with the
+				owner's mutex locked.
+		*/
+		bool isStopping() const { return m_stopping; }
+
+		/**
+			stop makes the loop finish, without the step it would have
+				run next, and waits for the thread to release the
+				context. The window stays open until destroy.
+		*/
+		void stop();
+
+		/**
+			destroy stops the thread and closes the window. Must be
+				called on the main thread before GLFW is terminated.
+		*/
+		void destroy();
+
+	private:
+		// What the thread runs, the loop until stop.
+		void run();
+
+		GLFWwindow* m_window;
+		std::thread m_thread;
+		std::mutex* m_mutex;
+		std::condition_variable m_wake;
+		Loop m_loop;
+
+		// Guarded by the owner's mutex.
+		bool m_stopping;
+	};
+}
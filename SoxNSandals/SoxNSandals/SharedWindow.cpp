@@ -0,0 +1,281 @@
+/**
+	SharedWindow.cpp
+
+	Purpose: SharedWindow.cpp is the source file for the SharedWindow
+			class. The SharedWindow is a window of its own beside the
+			main one, like a control panel, drawn with the main
+			context's meshes, textures and programs and presented on
+			a thread of its own.
+
+	@author Nathan Nette
+*/
+#include "SharedWindow.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "Trace.h"
+#include "gl_core_4_5.h"
+#include <glfw3.h>
+#include <cstdio>
+#include <utility>
+
+namespace sns
+{
+	SharedWindow::SharedWindow()
+		: m_width(0),
+		m_height(0),
+		m_vsync(true),
+		m_textures(),
+		m_framebuffers(),
+		m_readFramebuffers(),
+		m_drawing(0),
+		m_newest(1),
+		m_shown(2),
+		m_fresh(false),
+		m_drawn(),
+		m_blitted(),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor stops the thread, see destroy.
+	*/
+	SharedWindow::~SharedWindow()
+	{
+		destroy();
+	}
+
+	/**
+		create opens the window, makes its frames' textures, cleared to
+			black until something is drawn in them, and starts the
+			thread.
+
+			@param1 a_shared is the window whose context is shared.
+
+			@param2 a_title is the window's title.
+
+			@param3 a_width is the width of the window in pixels.
+
+			@param4 a_height is its height.
+
+			@param5 a_vsync waits for the window's monitor to refresh before
+					each swap.
+
+			@return false without GL 4.5 or if the window can't be opened.
+	*/
+	bool SharedWindow::create(GLFWwindow* a_shared, const char* a_title, int a_width, int a_height, bool a_vsync)
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("SharedWindow: sharing a window's frames needs GL 4.5.\n");
+			return false;
+		}
+
+		m_width = a_width;
+		m_height = a_height;
+		m_vsync = a_vsync;
+		glCreateTextures(GL_TEXTURE_2D, TEXTURE_COUNT, m_textures);
+		glCreateFramebuffers(TEXTURE_COUNT, m_framebuffers);
+		const float black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		for (unsigned int i = 0; i < TEXTURE_COUNT; ++i)
+		{
+			glTextureStorage2D(m_textures[i], 1, GL_RGBA8, m_width, m_height);
+			GpuMemory::instance().trackTexture(m_textures[i], GpuMemory::getTextureBytes(GL_RGBA8, m_width, m_height),
+				GpuMemory::RENDER_TARGETS, "SharedWindow");
+			glNamedFramebufferTexture(m_framebuffers[i], GL_COLOR_ATTACHMENT0, m_textures[i], 0);
+			glNamedFramebufferDrawBuffer(m_framebuffers[i], GL_COLOR_ATTACHMENT0);
+			glClearNamedFramebufferfv(m_framebuffers[i], GL_COLOR, 0, black);
+		}
+
+		m_drawing = 0;
+		m_newest = 1;
+		m_shown = 2;
+		m_fresh = false;
+		m_stats = {};
+
+		// The textures are made first, as the thread makes its
+		//	framebuffers of them as soon as it starts.
+		SharedContext::Loop loop;
+		loop.begin = [this]() { beginPresenting(); };
+		loop.isReady = [this]() { return m_fresh; };
+		loop.step = [this](std::unique_lock<std::mutex>& a_lock) { present(a_lock); };
+		loop.end = [this]() { endPresenting(); };
+		if (m_context.create(a_shared, a_title, a_width, a_height, true, m_mutex, std::move(loop)) == false)
+		{
+			printf("SharedWindow: the window couldn't be opened.\n");
+			deleteTextures();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		shouldClose returns whether the window has been asked to close.
+	*/
+	bool SharedWindow::shouldClose() const
+	{
+		return isCreated() && glfwWindowShouldClose(m_context.getWindow()) != 0;
+	}
+
+	/**
+		begin binds the framebuffer of the window's next frame and sets the
+			viewport to all of it. The frame's commands wait on the gpu
+			for the last blit of its texture, the cpu doesn't.
+	*/
+	void SharedWindow::begin()
+	{
+		GLsync blitted;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			blitted = (GLsync)m_blitted[m_drawing];
+			m_blitted[m_drawing] = nullptr;
+		}
+		if (blitted != nullptr)
+		{
+			glWaitSync(blitted, 0, GL_TIMEOUT_IGNORED);
+			glDeleteSync(blitted);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[m_drawing]);
+		glViewport(0, 0, m_width, m_height);
+	}
+
+	/**
+		end fences the frame drawn since begin and makes it the newest. A
+			newest frame the thread hadn't shown yet is dropped, and its
+			texture drawn into next. The fence is flushed here, as a wait
+			on the window's context can only flush its own commands.
+	*/
+	void SharedWindow::end()
+	{
+		GLsync drawn = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		GLsync dropped = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_fresh)
+			{
+				dropped = (GLsync)m_drawn[m_newest];
+				m_drawn[m_newest] = nullptr;
+				++m_stats.dropped;
+			}
+			std::swap(m_drawing, m_newest);
+			m_drawn[m_newest] = drawn;
+			m_fresh = true;
+			++m_stats.drawn;
+		}
+		m_context.wake();
+
+		// The fences are shared, so it can be deleted from here.
+		if (dropped != nullptr)
+			glDeleteSync(dropped);
+	}
+
+	/**
+		getStats returns what the window has done since it was made.
+	*/
+	SharedWindow::Stats SharedWindow::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	/**
+		destroy stops the thread, deletes the textures and closes the
+			window.
+	*/
+	void SharedWindow::destroy()
+	{
+		if (isCreated() == false)
+			return;
+
+		m_context.stop();
+		deleteTextures();
+		m_context.destroy();
+	}
+
+	/**
+		deleteTextures deletes the frames' fences, textures and the main
+			context's framebuffers of them.
+	*/
+	void SharedWindow::deleteTextures()
+	{
+		for (unsigned int i = 0; i < TEXTURE_COUNT; ++i)
+		{
+			if (m_drawn[i] != nullptr)
+				glDeleteSync((GLsync)m_drawn[i]);
+			if (m_blitted[i] != nullptr)
+				glDeleteSync((GLsync)m_blitted[i]);
+			m_drawn[i] = m_blitted[i] = nullptr;
+
+			RenderState::instance().onTextureDeleted(m_textures[i]);
+			GpuMemory::instance().releaseTexture(m_textures[i]);
+		}
+		glDeleteFramebuffers(TEXTURE_COUNT, m_framebuffers);
+		glDeleteTextures(TEXTURE_COUNT, m_textures);
+		for (unsigned int i = 0; i < TEXTURE_COUNT; ++i)
+			m_framebuffers[i] = m_textures[i] = 0;
+	}
+
+	/**
+		beginPresenting sets the window's vsync and makes its context's
+			framebuffers, as they only belong to the context they were
+			made on.
+	*/
+	void SharedWindow::beginPresenting()
+	{
+		glfwSwapInterval(m_vsync ? 1 : 0);
+
+		glCreateFramebuffers(TEXTURE_COUNT, m_readFramebuffers);
+		for (unsigned int i = 0; i < TEXTURE_COUNT; ++i)
+		{
+			glNamedFramebufferTexture(m_readFramebuffers[i], GL_COLOR_ATTACHMENT0, m_textures[i], 0);
+			glNamedFramebufferReadBuffer(m_readFramebuffers[i], GL_COLOR_ATTACHMENT0);
+		}
+	}
+
+	/**
+		present shows the newest frame. Its blit waits on the gpu for it
+			to be drawn, and the swap for the window's vsync, while
+			nothing is locked.
+
+			@param1 a_lock is the mutex's lock, held before and after.
+	*/
+	void SharedWindow::present(std::unique_lock<std::mutex>& a_lock)
+	{
+		std::swap(m_shown, m_newest);
+		m_fresh = false;
+		unsigned int shown = m_shown;
+		GLsync drawn = (GLsync)m_drawn[shown];
+		m_drawn[shown] = nullptr;
+		a_lock.unlock();
+
+		GLsync blitted;
+		{
+			SNS_TRACE_ZONE("SharedWindow::present");
+			glWaitSync(drawn, 0, GL_TIMEOUT_IGNORED);
+			glDeleteSync(drawn);
+			glBlitNamedFramebuffer(m_readFramebuffers[shown], 0, 0, 0, m_width, m_height, 0, 0, m_width, m_height,
+				GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			blitted = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glfwSwapBuffers(m_context.getWindow());
+		}
+
+		a_lock.lock();
+		m_blitted[shown] = blitted;
+		++m_stats.presented;
+	}
+
+	/**
+		endPresenting deletes the window's context's framebuffers.
+	*/
+	void SharedWindow::endPresenting()
+	{
+		glDeleteFramebuffers(TEXTURE_COUNT, m_readFramebuffers);
+		for (unsigned int i = 0; i < TEXTURE_COUNT; ++i)
+			m_readFramebuffers[i] = 0;
+	}
+}
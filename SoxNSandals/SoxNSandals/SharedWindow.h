@@ -0,0 +1,181 @@
+/**
+	SharedWindow.h
+
+	Purpose: SharedWindow.h is the header file for the SharedWindow
+			class. The SharedWindow is a window of its own beside the
+			main one, like a control panel, drawn with the main
+			context's meshes, textures and programs and presented on
+			a thread of its own.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SharedContext.h"
+#include <mutex>
+
+struct GLFWwindow;
+
+namespace sns
+{
+	/**
+		The SharedWindow class owns a shown SharedContext, like the
+			AsyncCompute's hidden one, whose thread keeps a context
+			sharing objects with the main one current. The context thread draws the window's
+			frames with everything it already has, and the window's
+			thread only copies each to its window and swaps, so waiting
+			on the window's vsync never holds up the main one's, nor the
+			other way around.
+
+		Vertex arrays, framebuffers and the RenderState only belong to
+			the main context, so the window isn't drawn on its own. Its
+			frames are drawn on the context thread between begin and end
+			into one of three textures, which the contexts share. The
+			thread blits the newest to its window, and a frame drawn
+			before the last was shown is dropped for the next one rather
+			than waited for.
+
+		Both directions are synchronised on the gpu with fences. end fences
+			the frame for the blit to wait for, and the blit is fenced in
+			turn for the next frame drawn into the same texture, so only
+			the slower window's frames are dropped and neither blocks the
+			cpu.
+
+		The window isn't resizable, as only the main thread can ask GLFW
+			its size. Its input isn't read, only whether it is closed.
+	*/
+	class SharedWindow
+	{
+	public:
+		// The window's frames in flight, the one drawn, the newest and
+		//	the one shown.
+		static const unsigned int TEXTURE_COUNT = 3;
+
+		/**
+			What the window has done since it was made.
+		*/
+		struct Stats
+		{
+			unsigned long long drawn;
+			unsigned long long presented;
+			unsigned long long dropped;
+		};
+
+		SharedWindow();
+
+		/**
+			The deconstructor stops the thread, see destroy.
+		*/
+		~SharedWindow();
+
+		SharedWindow(const SharedWindow&) = delete;
+		SharedWindow& operator=(const SharedWindow&) = delete;
+
+		/**
+			create opens the window, makes its frames' textures and starts
+				the thread. Must be called on the main thread with
+				a_shared's context current.
+
+				@param1 a_shared is the window whose context is shared.
+
+				@param2 a_title is the window's title.
+
+				@param3 a_width is the width of the window in pixels.
+
+				@param4 a_height is its height.
+
+				@param5 a_vsync waits for the window's monitor to refresh
+						before each swap.
+
+				@return false without GL 4.5 or if the window can't be
+						opened.
+		*/
+		bool create(GLFWwindow* a_shared, const char* a_title, int a_width, int a_height, bool a_vsync);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_context.isCreated(); }
+
+		/**
+			shouldClose returns whether the window has been asked to close,
+				after which it can be destroyed.
+		*/
+		bool shouldClose() const;
+
+		/**
+			begin binds the framebuffer of the window's next frame to be
+				drawn into, and sets the viewport to all of it. Only on
+				the context thread.
+		*/
+		void begin();
+
+		/**
+			end fences the frame drawn since begin and hands it to the
+				window's thread to be shown. Only on the context thread.
+		*/
+		void end();
+
+		/**
+			getWidth returns the width of the window in pixels.
+		*/
+		int getWidth() const { return m_width; }
+
+		/**
+			getHeight returns the height of the window in pixels.
+		*/
+		int getHeight() const { return m_height; }
+
+		/**
+			getStats returns what the window has done since it was made.
+		*/
+		Stats getStats() const;
+
+		/**
+			destroy stops the thread, deletes the textures and closes the
+				window. Must be called on the main thread, with the main
+				context current, before GLFW is terminated.
+		*/
+		void destroy();
+
+	private:
+		// What the thread runs, making its framebuffers, showing each
+		//	newest frame with the mutex locked, and deleting them.
+		void beginPresenting();
+		void present(std::unique_lock<std::mutex>& a_lock);
+		void endPresenting();
+
+		// Deletes the frames' fences and textures.
+		void deleteTextures();
+
+		SharedContext m_context;
+		int m_width;
+		int m_height;
+		bool m_vsync;
+
+		// The frames' textures, and the main context's framebuffers for
+		//	drawing into them.
+		unsigned int m_textures[TEXTURE_COUNT];
+		unsigned int m_framebuffers[TEXTURE_COUNT];
+
+		// The window's context's framebuffers for blitting from them, only
+		//	touched by its thread.
+		unsigned int m_readFramebuffers[TEXTURE_COUNT];
+
+		// Guards everything below.
+		mutable std::mutex m_mutex;
+
+		// Which texture is drawn, the newest and shown, and whether the
+		//	newest hasn't been shown yet.
+		unsigned int m_drawing;
+		unsigned int m_newest;
+		unsigned int m_shown;
+		bool m_fresh;
+
+		// The GLsync of each texture's frame, for the blit to wait on,
+		//	and of its last blit, for the next frame drawn into it.
+		void* m_drawn[TEXTURE_COUNT];
+		void* m_blitted[TEXTURE_COUNT];
+
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,410 @@
+/**
+	Skeleton.cpp
+
+	Purpose: Skeleton.cpp is the source file for the Skeleton and Pose
+			classes. The Skeleton is the hierarchy of joints a skinned
+			mesh is bound to, and a Pose is a local transform for each
+			of them, laid out so four joints are worked on at once.
+
+	@author Nathan Nette
+*/
+#include "Skeleton.h"
+#include "GltfFile.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_POSE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	glm::mat4 makeMatrix(const glm::vec3& a_translation, const glm::quat& a_rotation, const glm::vec3& a_scale)
+	{
+		return glm::scale(glm::translate(glm::mat4(1), a_translation) * glm::mat4_cast(a_rotation), a_scale);
+	}
+}
+
+namespace sns
+{
+	Pose::Pose()
+		: m_jointCount(0),
+		m_paddedCount(0)
+	{
+	}
+
+	/**
+		resize makes room for a number of joints. The padding joints past
+			it are the identity, so they blend into it.
+
+			@param1 a_jointCount is how many joints there are.
+	*/
+	void Pose::resize(unsigned int a_jointCount)
+	{
+		m_jointCount = a_jointCount;
+		m_paddedCount = (a_jointCount + 3) & ~3u;
+		m_data.assign(STREAM_COUNT * m_paddedCount, 0.0f);
+		for (unsigned int i = 0; i < m_paddedCount; ++i)
+			setJoint(i, glm::vec3(0), glm::quat(), glm::vec3(1));
+	}
+
+	/**
+		setJoint sets one joint's transform.
+
+			@param1 a_joint is the joint.
+
+			@param2 a_translation is its translation.
+
+			@param3 a_rotation is its rotation.
+
+			@param4 a_scale is its scale.
+	*/
+	void Pose::setJoint(unsigned int a_joint, const glm::vec3& a_translation, const glm::quat& a_rotation,
+		const glm::vec3& a_scale)
+	{
+		float values[STREAM_COUNT] = { a_translation.x, a_translation.y, a_translation.z,
+			a_rotation.x, a_rotation.y, a_rotation.z, a_rotation.w, a_scale.x, a_scale.y, a_scale.z };
+		for (unsigned int i = 0; i < STREAM_COUNT; ++i)
+			m_data[i * m_paddedCount + a_joint] = values[i];
+	}
+
+	/**
+		blend blends between two poses of the same size, normalising the
+			rotations' linear blend.
+
+			@param1 a_from is the pose at weight 0.
+
+			@param2 a_to is the pose at weight 1.
+
+			@param3 a_weights are PART_COUNT streams of getPaddedCount
+					weights, how far towards a_to each joint's
+					translation, rotation and scale is blended.
+
+			@param4 a_result is set to the blend, and may be either pose.
+	*/
+	void Pose::blend(const Pose& a_from, const Pose& a_to, const float* a_weights, Pose& a_result)
+	{
+		if (a_result.m_jointCount != a_from.m_jointCount)
+			a_result.resize(a_from.m_jointCount);
+
+		unsigned int padded = a_from.m_paddedCount;
+		const float* from = a_from.m_data.data();
+		const float* to = a_to.m_data.data();
+		float* result = a_result.m_data.data();
+		const float* translationWeights = a_weights + TRANSLATION * padded;
+		const float* rotationWeights = a_weights + ROTATION * padded;
+		const float* scaleWeights = a_weights + SCALE * padded;
+		unsigned int i = 0;
+
+#ifdef SNS_POSE_SSE
+		// The streams are padded, so every joint is in a group of four.
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		for (; i < padded; i += 4)
+		{
+			__m128 weight = _mm_loadu_ps(translationWeights + i);
+			for (unsigned int s = TRANSLATION_X; s <= TRANSLATION_Z; ++s)
+			{
+				__m128 a = _mm_loadu_ps(from + s * padded + i);
+				__m128 b = _mm_loadu_ps(to + s * padded + i);
+				_mm_storeu_ps(result + s * padded + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), weight)));
+			}
+
+			weight = _mm_loadu_ps(scaleWeights + i);
+			for (unsigned int s = SCALE_X; s <= SCALE_Z; ++s)
+			{
+				__m128 a = _mm_loadu_ps(from + s * padded + i);
+				__m128 b = _mm_loadu_ps(to + s * padded + i);
+				_mm_storeu_ps(result + s * padded + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), weight)));
+			}
+
+			// The rotation towards is flipped when it is on the other side
+			//	of the sphere, so the blend takes the short way round.
+			__m128 a[4], b[4];
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				a[c] = _mm_loadu_ps(from + (ROTATION_X + c) * padded + i);
+				b[c] = _mm_loadu_ps(to + (ROTATION_X + c) * padded + i);
+			}
+			__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+				_mm_add_ps(_mm_mul_ps(a[2], b[2]), _mm_mul_ps(a[3], b[3])));
+			__m128 flip = _mm_and_ps(dot, signBit);
+
+			weight = _mm_loadu_ps(rotationWeights + i);
+			__m128 r[4];
+			__m128 length = _mm_setzero_ps();
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				r[c] = _mm_add_ps(a[c], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(b[c], flip), a[c]), weight));
+				length = _mm_add_ps(length, _mm_mul_ps(r[c], r[c]));
+			}
+			__m128 scale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length));
+			for (unsigned int c = 0; c < 4; ++c)
+				_mm_storeu_ps(result + (ROTATION_X + c) * padded + i, _mm_mul_ps(r[c], scale));
+		}
+#endif
+
+		for (; i < padded; ++i)
+		{
+			for (unsigned int s = TRANSLATION_X; s <= TRANSLATION_Z; ++s)
+				result[s * padded + i] = from[s * padded + i] + (to[s * padded + i] - from[s * padded + i]) * translationWeights[i];
+			for (unsigned int s = SCALE_X; s <= SCALE_Z; ++s)
+				result[s * padded + i] = from[s * padded + i] + (to[s * padded + i] - from[s * padded + i]) * scaleWeights[i];
+
+			float dot = 0.0f;
+			for (unsigned int s = ROTATION_X; s <= ROTATION_W; ++s)
+				dot += from[s * padded + i] * to[s * padded + i];
+			float flip = dot < 0.0f ? -1.0f : 1.0f;
+
+			float r[4];
+			float length = 0.0f;
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				float a = from[(ROTATION_X + c) * padded + i];
+				r[c] = a + (to[(ROTATION_X + c) * padded + i] * flip - a) * rotationWeights[i];
+				length += r[c] * r[c];
+			}
+			float scale = 1.0f / std::sqrt(length);
+			for (unsigned int c = 0; c < 4; ++c)
+				result[(ROTATION_X + c) * padded + i] = r[c] * scale;
+		}
+	}
+
+	/**
+		getMatrices turns every joint's transform into a matrix, each
+			rotation's axes scaled and then translated.
+
+			@param1 a_matrices is where they are written, room for
+					getPaddedCount matrices.
+	*/
+	void Pose::getMatrices(glm::mat4* a_matrices) const
+	{
+		const float* data = m_data.data();
+		unsigned int padded = m_paddedCount;
+		unsigned int i = 0;
+
+#ifdef SNS_POSE_SSE
+		// The matrices of four joints are worked out side by side, then
+		//	written out one joint at a time.
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		for (; i < padded; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(data + ROTATION_X * padded + i);
+			__m128 y = _mm_loadu_ps(data + ROTATION_Y * padded + i);
+			__m128 z = _mm_loadu_ps(data + ROTATION_Z * padded + i);
+			__m128 w = _mm_loadu_ps(data + ROTATION_W * padded + i);
+			__m128 sx = _mm_loadu_ps(data + SCALE_X * padded + i);
+			__m128 sy = _mm_loadu_ps(data + SCALE_Y * padded + i);
+			__m128 sz = _mm_loadu_ps(data + SCALE_Z * padded + i);
+
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+			// Column by column, as glm keeps them.
+			float columns[12][4];
+			_mm_storeu_ps(columns[0], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx));
+			_mm_storeu_ps(columns[1], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx));
+			_mm_storeu_ps(columns[2], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx));
+			_mm_storeu_ps(columns[3], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy));
+			_mm_storeu_ps(columns[4], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy));
+			_mm_storeu_ps(columns[5], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy));
+			_mm_storeu_ps(columns[6], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz));
+			_mm_storeu_ps(columns[7], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz));
+			_mm_storeu_ps(columns[8], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz));
+			_mm_storeu_ps(columns[9], _mm_loadu_ps(data + TRANSLATION_X * padded + i));
+			_mm_storeu_ps(columns[10], _mm_loadu_ps(data + TRANSLATION_Y * padded + i));
+			_mm_storeu_ps(columns[11], _mm_loadu_ps(data + TRANSLATION_Z * padded + i));
+
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				glm::mat4& matrix = a_matrices[i + lane];
+				for (unsigned int c = 0; c < 4; ++c)
+				{
+					matrix[c] = glm::vec4(columns[c * 3][lane], columns[c * 3 + 1][lane], columns[c * 3 + 2][lane],
+						c == 3 ? 1.0f : 0.0f);
+				}
+			}
+		}
+#endif
+
+		for (; i < padded; ++i)
+		{
+			glm::quat rotation(data[ROTATION_W * padded + i], data[ROTATION_X * padded + i],
+				data[ROTATION_Y * padded + i], data[ROTATION_Z * padded + i]);
+			a_matrices[i] = makeMatrix(
+				glm::vec3(data[TRANSLATION_X * padded + i], data[TRANSLATION_Y * padded + i], data[TRANSLATION_Z * padded + i]),
+				rotation, glm::vec3(data[SCALE_X * padded + i], data[SCALE_Y * padded + i], data[SCALE_Z * padded + i]));
+		}
+	}
+
+	Skeleton::Skeleton()
+	{
+	}
+
+	/**
+		load reads a skin from a model: its joints, the nodes above them
+			and the matrices they were bound with.
+
+			@param1 a_file is the model.
+
+			@param2 a_skin is the skin's index.
+
+			@return false if it isn't a skin that can be read, any error
+					is printed.
+	*/
+	bool Skeleton::load(const GltfFile& a_file, int a_skin)
+	{
+		m_parents.clear();
+		m_nodes.clear();
+		m_order.clear();
+		m_inverseBinds.clear();
+		m_roots.clear();
+
+		const JsonValue* skin = a_file.getItem("skins", a_skin);
+		const JsonValue* joints = skin != nullptr ? skin->find("joints") : nullptr;
+		if (joints == nullptr || joints->items.empty() || joints->items.size() > MAX_JOINTS)
+		{
+			printf("%s: skin %d has no joints or more than %u\n", a_file.getFilename().c_str(), a_skin, MAX_JOINTS);
+			return false;
+		}
+		unsigned int jointCount = (unsigned int)joints->items.size();
+
+		// Every node's parent, from the children each lists.
+		unsigned int nodeCount = a_file.getCount("nodes");
+		std::vector<int> nodeParents(nodeCount, -1);
+		for (unsigned int i = 0; i < nodeCount; ++i)
+		{
+			const JsonValue* children = a_file.getItem("nodes", i)->find("children");
+			for (size_t c = 0; children != nullptr && c < children->items.size(); ++c)
+			{
+				int child = (int)children->items[c].number;
+				if (child >= 0 && (unsigned int)child < nodeCount)
+					nodeParents[child] = (int)i;
+			}
+		}
+
+		for (unsigned int i = 0; i < jointCount; ++i)
+		{
+			int node = (int)joints->items[i].number;
+			if (node < 0 || (unsigned int)node >= nodeCount)
+			{
+				printf("%s: skin %d has a joint that isn't a node\n", a_file.getFilename().c_str(), a_skin);
+				return false;
+			}
+			m_nodes.push_back(node);
+		}
+
+		// Each joint's parent is the nearest node above it in the skin,
+		//	the nodes passed on the way there are folded into its root.
+		m_restPose.resize(jointCount);
+		m_roots.assign(jointCount, glm::mat4(1));
+		std::vector<unsigned int> depths(jointCount, 0);
+		for (unsigned int i = 0; i < jointCount; ++i)
+		{
+			glm::vec3 translation, scale;
+			glm::quat rotation;
+			GltfFile::readNodeTransform(*a_file.getItem("nodes", m_nodes[i]), translation, rotation, scale);
+			m_restPose.setJoint(i, translation, rotation, scale);
+			m_parents.push_back(-1);
+
+			for (int node = nodeParents[m_nodes[i]]; node >= 0; node = nodeParents[node])
+			{
+				int joint = findJoint(node);
+				if (joint >= 0)
+				{
+					if (m_parents[i] < 0)
+						m_parents[i] = joint;
+					++depths[i];
+				}
+				else if (m_parents[i] < 0)
+				{
+					GltfFile::readNodeTransform(*a_file.getItem("nodes", node), translation, rotation, scale);
+					m_roots[i] = makeMatrix(translation, rotation, scale) * m_roots[i];
+				}
+			}
+		}
+
+		// Sorting by how many joints are above each puts every parent
+		//	before its children.
+		for (unsigned int i = 0; i < jointCount; ++i)
+			m_order.push_back(i);
+		std::stable_sort(m_order.begin(), m_order.end(),
+			[&depths](unsigned int a_left, unsigned int a_right) { return depths[a_left] < depths[a_right]; });
+
+		// Without inverse bind matrices the joints were bound where the
+		//	rest pose puts them, so they are the identity.
+		m_inverseBinds.assign(jointCount, glm::mat4(1));
+		const JsonValue* inverseBinds = skin->find("inverseBindMatrices");
+		if (inverseBinds != nullptr)
+		{
+			int accessor = (int)inverseBinds->number;
+			if (a_file.getAccessorCount(accessor) < jointCount ||
+				a_file.readFloats(accessor, 16, &m_inverseBinds[0][0][0]) == false)
+			{
+				printf("%s: skin %d's inverse bind matrices can't be read\n", a_file.getFilename().c_str(), a_skin);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+		findJoint finds which joint a model's node is.
+
+			@param1 a_node is the node's index.
+
+			@return the joint, or -1 if the node isn't one.
+	*/
+	int Skeleton::findJoint(int a_node) const
+	{
+		for (unsigned int i = 0; i < m_nodes.size(); ++i)
+		{
+			if (m_nodes[i] == a_node)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	/**
+		getSkinMatrices works out the matrices that move each joint's
+			vertices from where they were bound to where a pose puts
+			them, as the first three rows of each.
+
+			@param1 a_pose is the pose.
+
+			@param2 a_scratch is room for getPaddedCount matrices twice
+					over, reused between calls.
+
+			@param3 a_rows is where the matrices are written, 12 floats a
+					joint.
+	*/
+	void Skeleton::getSkinMatrices(const Pose& a_pose, std::vector<glm::mat4>& a_scratch, float* a_rows) const
+	{
+		unsigned int padded = a_pose.getPaddedCount();
+		a_scratch.resize(padded * 2);
+		glm::mat4* locals = a_scratch.data();
+		glm::mat4* models = locals + padded;
+		a_pose.getMatrices(locals);
+
+		for (unsigned int joint : m_order)
+		{
+			int parent = m_parents[joint];
+			models[joint] = (parent >= 0 ? models[parent] : m_roots[joint]) * locals[joint];
+		}
+
+		for (unsigned int joint = 0; joint < getJointCount(); ++joint)
+		{
+			glm::mat4 skin = models[joint] * m_inverseBinds[joint];
+			float* rows = a_rows + joint * 12;
+			for (unsigned int r = 0; r < 3; ++r)
+			{
+				for (unsigned int c = 0; c < 4; ++c)
+					rows[r * 4 + c] = skin[c][r];
+			}
+		}
+	}
+}
@@ -0,0 +1,213 @@
+/**
+	Skeleton.h
+
+	Purpose: Skeleton.h is the header file for the Skeleton and Pose
+			classes. The Skeleton is the hierarchy of joints a skinned
+			mesh is bound to, and a Pose is a local transform for each
+			of them, laid out so four joints are worked on at once.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	class GltfFile;
+
+	/**
+		The Pose class holds every joint's translation, rotation and scale
+			relative to its parent. Each component has its own stream,
+			padded to a multiple of four joints, so blending poses and
+			turning them into matrices is done four joints at a time
+			with SSE, the same way the particle pool integrates.
+	*/
+	class Pose
+	{
+	public:
+		// The streams, the translation's x to z, the rotation's x to w
+		//	and the scale's x to z.
+		enum Stream
+		{
+			TRANSLATION_X, TRANSLATION_Y, TRANSLATION_Z,
+			ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W,
+			SCALE_X, SCALE_Y, SCALE_Z,
+			STREAM_COUNT
+		};
+
+		// The parts blend weights are given for, see blend.
+		enum Part
+		{
+			TRANSLATION,
+			ROTATION,
+			SCALE,
+			PART_COUNT
+		};
+
+		Pose();
+
+		/**
+			resize makes room for a number of joints. The padding joints
+				past it are the identity, so they blend into it.
+
+				@param1 a_jointCount is how many joints there are.
+		*/
+		void resize(unsigned int a_jointCount);
+
+		/**
+			getJointCount returns how many joints there are.
+		*/
+		unsigned int getJointCount() const { return m_jointCount; }
+
+		/**
+			getPaddedCount returns how many joints each stream has room
+				for, a multiple of four.
+		*/
+		unsigned int getPaddedCount() const { return m_paddedCount; }
+
+		/**
+			getStream returns one component of every joint.
+
+				@param1 a_stream is the component.
+		*/
+		float* getStream(Stream a_stream) { return m_data.data() + a_stream * m_paddedCount; }
+		const float* getStream(Stream a_stream) const { return m_data.data() + a_stream * m_paddedCount; }
+
+		/**
+			setJoint sets one joint's transform.
+
+				@param1 a_joint is the joint.
+
+				@param2 a_translation is its translation.
+
+				@param3 a_rotation is its rotation.
+
+				@param4 a_scale is its scale.
+		*/
+		void setJoint(unsigned int a_joint, const glm::vec3& a_translation, const glm::quat& a_rotation,
+			const glm::vec3& a_scale);
+
+		/**
+			blend blends between two poses of the same size, normalising
+				the rotations' linear blend, which is close to their
+				spherical one for the small angles between nearby
+				poses and much cheaper.
+
+				@param1 a_from is the pose at weight 0.
+
+				@param2 a_to is the pose at weight 1.
+
+				@param3 a_weights are PART_COUNT streams of getPaddedCount
+						weights, how far towards a_to each joint's
+						translation, rotation and scale is blended.
+
+				@param4 a_result is set to the blend, and may be either
+						pose.
+		*/
+		static void blend(const Pose& a_from, const Pose& a_to, const float* a_weights, Pose& a_result);
+
+		/**
+			getMatrices turns every joint's transform into a matrix.
+
+				@param1 a_matrices is where they are written, room for
+						getPaddedCount matrices.
+		*/
+		void getMatrices(glm::mat4* a_matrices) const;
+
+	private:
+		unsigned int m_jointCount;
+		unsigned int m_paddedCount;
+		std::vector<float> m_data;
+	};
+
+	/**
+		The Skeleton class is one of a glTF model's skins, the joints its
+			vertices are weighted to and the rest pose they were bound
+			in. Joints are numbered as the skin lists them, which is how
+			the vertices refer to them, and are put together in an
+			order that puts each parent before its children.
+
+		A joint whose parent isn't in the skin takes the rest transform
+			of the nodes above it instead, so a skeleton under a node
+			that places or scales it keeps that.
+	*/
+	class Skeleton
+	{
+	public:
+		// How many joints a skin can have, the skinning shader's limit.
+		static const unsigned int MAX_JOINTS = 256;
+
+		Skeleton();
+
+		Skeleton(const Skeleton&) = delete;
+		Skeleton& operator=(const Skeleton&) = delete;
+
+		/**
+			load reads a skin from a model.
+
+				@param1 a_file is the model.
+
+				@param2 a_skin is the skin's index.
+
+				@return false if it isn't a skin that can be read, any
+						error is printed.
+		*/
+		bool load(const GltfFile& a_file, int a_skin);
+
+		/**
+			getJointCount returns how many joints there are.
+		*/
+		unsigned int getJointCount() const { return (unsigned int)m_parents.size(); }
+
+		/**
+			findJoint finds which joint a model's node is.
+
+				@param1 a_node is the node's index.
+
+				@return the joint, or -1 if the node isn't one.
+		*/
+		int findJoint(int a_node) const;
+
+		/**
+			getRestPose returns the pose the nodes are in when nothing
+				animates them.
+		*/
+		const Pose& getRestPose() const { return m_restPose; }
+
+		/**
+			getSkinMatrices works out the matrices that move each joint's
+				vertices from where they were bound to where a pose puts
+				them, as the first three rows of each, which is all an
+				affine matrix needs.
+
+				@param1 a_pose is the pose.
+
+				@param2 a_scratch is room for getPaddedCount matrices
+						twice over, reused between calls.
+
+				@param3 a_rows is where the matrices are written, 12
+						floats a joint.
+		*/
+		void getSkinMatrices(const Pose& a_pose, std::vector<glm::mat4>& a_scratch, float* a_rows) const;
+
+	private:
+		// Each joint's parent joint, or -1 when its parent isn't in the
+		//	skin, and the node it is.
+		std::vector<int> m_parents;
+		std::vector<int> m_nodes;
+
+		// The joints, every parent before its children.
+		std::vector<unsigned int> m_order;
+
+		// What each joint's vertices are moved by to be relative to it,
+		//	and for joints without a parent joint the nodes above them.
+		std::vector<glm::mat4> m_inverseBinds;
+		std::vector<glm::mat4> m_roots;
+
+		Pose m_restPose;
+	};
+}
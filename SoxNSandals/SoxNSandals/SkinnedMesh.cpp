@@ -0,0 +1,273 @@
+/**
+	SkinnedMesh.cpp
+
+	Purpose: SkinnedMesh.cpp is the source file for the SkinnedMesh
+			class. The SkinnedMesh is a glTF model's skinned mesh, with
+			the skeleton it is bound to and the animations that move
+			it, uploaded once however many characters are drawn with it.
+
+	@author Nathan Nette
+*/
+#include "SkinnedMesh.h"
+#include "GltfFile.h"
+#include "GltfImporter.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+
+namespace
+{
+	// The compute shader reads the vertices as words, 20 of them each.
+	static_assert(sizeof(sns::SkinnedMesh::Vertex) == 80, "the skinning shader reads 80 byte vertices");
+
+	int getAttribute(const sns::JsonValue& a_attributes, const char* a_name)
+	{
+		const sns::JsonValue* value = a_attributes.find(a_name);
+		return value != nullptr && value->type == sns::JsonValue::NUMBER ? (int)value->number : -1;
+	}
+
+	float getNumber(const sns::JsonValue* a_object, const char* a_name, float a_default)
+	{
+		const sns::JsonValue* value = a_object != nullptr ? a_object->find(a_name) : nullptr;
+		return value != nullptr && value->type == sns::JsonValue::NUMBER ? (float)value->number : a_default;
+	}
+}
+
+namespace sns
+{
+	SkinnedMesh::SkinnedMesh()
+		: m_vertexCount(0),
+		m_sourceBuffer(0),
+		m_indexBuffer(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffers.
+	*/
+	SkinnedMesh::~SkinnedMesh()
+	{
+		unsigned int buffers[] = { m_sourceBuffer, m_indexBuffer };
+		for (unsigned int buffer : buffers)
+		{
+			if (buffer == 0)
+				continue;
+			glDeleteBuffers(1, &buffer);
+			RenderState::instance().onBufferDeleted(buffer);
+			GpuMemory::instance().releaseBuffer(buffer);
+		}
+	}
+
+	/**
+		load reads the mesh, skeleton and animations from a model and
+			uploads the mesh.
+
+			@param1 a_filename is the model, a .gltf or .glb.
+
+			@return false if it has no skinned mesh that can be read, any
+					error is printed.
+	*/
+	bool SkinnedMesh::load(const char* a_filename)
+	{
+		if (isLoaded())
+			return false;
+
+		GltfFile file;
+		if (file.load(a_filename) == false)
+			return false;
+		m_filename = a_filename;
+
+		// The first node that is both skinned and a mesh.
+		const JsonValue* mesh = nullptr;
+		int skin = -1;
+		for (unsigned int i = 0; i < file.getCount("nodes") && mesh == nullptr; ++i)
+		{
+			const JsonValue* node = file.getItem("nodes", i);
+			const JsonValue* nodeMesh = node->find("mesh");
+			const JsonValue* nodeSkin = node->find("skin");
+			if (nodeMesh != nullptr && nodeSkin != nullptr)
+			{
+				mesh = file.getItem("meshes", (int)nodeMesh->number);
+				skin = (int)nodeSkin->number;
+			}
+		}
+		const JsonValue* primitives = mesh != nullptr ? mesh->find("primitives") : nullptr;
+		if (primitives == nullptr)
+		{
+			printf("%s has no skinned mesh\n", a_filename);
+			return false;
+		}
+		if (m_skeleton.load(file, skin) == false)
+			return false;
+
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		for (const JsonValue& primitive : primitives->items)
+		{
+			if (readPrimitive(file, primitive, vertices, indices) == false)
+				return false;
+		}
+		if (indices.empty())
+		{
+			printf("%s's skinned mesh has no triangles\n", a_filename);
+			return false;
+		}
+
+		m_clips.resize(file.getCount("animations"));
+		for (unsigned int i = 0; i < m_clips.size(); ++i)
+		{
+			if (m_clips[i].load(file, i, m_skeleton) == false)
+				return false;
+		}
+
+		m_vertexCount = (unsigned int)vertices.size();
+		glCreateBuffers(1, &m_sourceBuffer);
+		glNamedBufferStorage(m_sourceBuffer, vertices.size() * sizeof(Vertex), vertices.data(), 0);
+		glCreateBuffers(1, &m_indexBuffer);
+		glNamedBufferStorage(m_indexBuffer, indices.size() * sizeof(unsigned int), indices.data(), 0);
+
+		GpuMemory& memory = GpuMemory::instance();
+		memory.trackBuffer(m_sourceBuffer, vertices.size() * sizeof(Vertex), GpuMemory::MESHES, "SkinnedMesh");
+		memory.trackBuffer(m_indexBuffer, indices.size() * sizeof(unsigned int), GpuMemory::MESHES, "SkinnedMesh");
+
+		printf("Skinned mesh %s: %u vertices, %u joints, %u animations\n", a_filename, m_vertexCount,
+			m_skeleton.getJointCount(), (unsigned int)m_clips.size());
+		return true;
+	}
+
+	/**
+		findClip finds an animation by its name.
+
+			@param1 a_name is the name.
+
+			@return its index, or -1 if there isn't one.
+	*/
+	int SkinnedMesh::findClip(const std::string& a_name) const
+	{
+		for (unsigned int i = 0; i < m_clips.size(); ++i)
+		{
+			if (m_clips[i].getName() == a_name)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	/**
+		readPrimitive reads one triangle primitive onto the end of the
+			vertices and indices. Primitives that aren't triangles are
+			skipped, as are ones that aren't skinned.
+
+			@param1 a_file is the model.
+
+			@param2 a_primitive is the primitive.
+
+			@param3 a_vertices are the mesh's vertices so far.
+
+			@param4 a_indices are its indices so far.
+	*/
+	bool SkinnedMesh::readPrimitive(const GltfFile& a_file, const JsonValue& a_primitive, std::vector<Vertex>& a_vertices,
+		std::vector<unsigned int>& a_indices)
+	{
+		const JsonValue* attributes = a_primitive.find("attributes");
+		int position = attributes != nullptr ? getAttribute(*attributes, "POSITION") : -1;
+		int joints = attributes != nullptr ? getAttribute(*attributes, "JOINTS_0") : -1;
+		int weights = attributes != nullptr ? getAttribute(*attributes, "WEIGHTS_0") : -1;
+		if ((int)getNumber(&a_primitive, "mode", 4.0f) != 4 || position < 0 || joints < 0 || weights < 0)
+			return true;
+
+		// Each attribute is read into its own array, then interleaved.
+		unsigned int count = a_file.getAccessorCount(position);
+		if (count == 0)
+			return true;
+		std::vector<glm::vec4> positions(count, glm::vec4(0, 0, 0, 1));
+		std::vector<glm::vec4> normals(count, glm::vec4(0, 1, 0, 0));
+		std::vector<glm::vec2> texcoords(count, glm::vec2(0));
+		std::vector<glm::vec4> tangents(count, glm::vec4(0));
+		std::vector<glm::uvec4> jointIndices(count, glm::uvec4(0));
+		std::vector<glm::vec4> jointWeights(count, glm::vec4(0));
+
+		int normal = getAttribute(*attributes, "NORMAL");
+		int texcoord = getAttribute(*attributes, "TEXCOORD_0");
+		int tangent = getAttribute(*attributes, "TANGENT");
+		auto matches = [&a_file, count](int a_accessor) { return a_accessor < 0 || a_file.getAccessorCount(a_accessor) == count; };
+		bool read = matches(normal) && matches(texcoord) && matches(tangent) && matches(joints) && matches(weights) &&
+			a_file.readFloats(position, 3, &positions[0][0]) &&
+			(normal < 0 || a_file.readFloats(normal, 3, &normals[0][0])) &&
+			(texcoord < 0 || a_file.readFloats(texcoord, 2, &texcoords[0][0])) &&
+			(tangent < 0 || a_file.readFloats(tangent, 4, &tangents[0][0])) &&
+			a_file.readUnsigned(joints, 4, &jointIndices[0][0]) &&
+			a_file.readFloats(weights, 4, &jointWeights[0][0]);
+
+		unsigned int firstVertex = (unsigned int)a_vertices.size();
+		std::vector<unsigned int> indices;
+		const JsonValue* indexAccessor = a_primitive.find("indices");
+		if (read && indexAccessor != nullptr)
+		{
+			indices.resize(a_file.getAccessorCount((int)indexAccessor->number));
+			read = indices.empty() == false && a_file.readUnsigned((int)indexAccessor->number, 1, indices.data());
+		}
+		else if (read)
+		{
+			for (unsigned int i = 0; i < count; ++i)
+				indices.push_back(i);
+		}
+		if (read == false)
+		{
+			printf("%s: a skinned primitive can't be read\n", a_file.getFilename().c_str());
+			return false;
+		}
+
+		// OBJMesh fills in the tangents, from the texcoords, of meshes
+		//	without them.
+		std::vector<aie::OBJMesh::Vertex> plain(count);
+		for (unsigned int i = 0; i < count; ++i)
+			plain[i] = { positions[i], normals[i], texcoords[i], tangents[i] };
+		if (tangent < 0 && texcoord >= 0)
+			aie::OBJMesh::calculateTangents(plain, indices);
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			Vertex vertex;
+			static_cast<aie::OBJMesh::Vertex&>(vertex) = plain[i];
+
+			// Exporters don't always normalise the weights, and a joint
+			//	past the skeleton is left with no weight.
+			float total = 0.0f;
+			for (unsigned int j = 0; j < 4; ++j)
+			{
+				if (jointIndices[i][j] >= m_skeleton.getJointCount())
+				{
+					jointIndices[i][j] = 0;
+					jointWeights[i][j] = 0.0f;
+				}
+				total += jointWeights[i][j];
+			}
+			for (unsigned int j = 0; j < 4; ++j)
+			{
+				vertex.joints[j] = (unsigned short)jointIndices[i][j];
+				vertex.weights[j] = total > 0.0f ? jointWeights[i][j] / total : (j == 0 ? 1.0f : 0.0f);
+			}
+			a_vertices.push_back(vertex);
+		}
+
+		Primitive draw;
+		draw.firstIndex = (unsigned int)a_indices.size();
+		draw.indexCount = (unsigned int)indices.size();
+		for (unsigned int index : indices)
+			a_indices.push_back(firstVertex + (index < count ? index : 0));
+
+		// The metallic roughness material is turned into the lit shaders'
+		//	phong one, as static glTF meshes are.
+		const JsonValue* material = a_primitive.find("material");
+		GltfImporter::Material colours;
+		GltfImporter::readMaterial(a_file, material != nullptr ? (int)material->number : -1, colours);
+		draw.material.ambient = colours.ambient;
+		draw.material.diffuse = colours.diffuse;
+		draw.material.specular = colours.specular;
+		draw.material.emissive = colours.emissive;
+		draw.material.specularPower = colours.specularPower;
+		m_primitives.push_back(draw);
+		return true;
+	}
+}
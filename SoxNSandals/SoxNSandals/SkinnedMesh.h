@@ -0,0 +1,122 @@
+/**
+	SkinnedMesh.h
+
+	Purpose: SkinnedMesh.h is the header file for the SkinnedMesh class.
+			The SkinnedMesh is a glTF model's skinned mesh, with the
+			skeleton it is bound to and the animations that move it,
+			uploaded once however many characters are drawn with it.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "OBJMesh.h"
+#include "Skeleton.h"
+#include "AnimationClip.h"
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	class GltfFile;
+	struct JsonValue;
+
+	/**
+		The SkinnedMesh class reads the first node of a glTF model that
+			has both a mesh and a skin. Every triangle primitive of the
+			mesh goes into one vertex and index buffer, with the range of
+			indices and the colour of each primitive kept to draw it by.
+
+		The vertices are never drawn as they are. The Animator skins
+			them into a buffer of OBJMesh::Vertex for each character,
+			which the shadow and lit shaders draw like any other mesh.
+			So the source buffer is a shader storage buffer, read by
+			the skinning shader as 20 words a vertex.
+
+		Materials keep only their colours, their textures aren't read.
+	*/
+	class SkinnedMesh
+	{
+	public:
+		/**
+			A vertex as OBJMesh has them, with the four joints it is
+				weighted to, numbered as the skeleton numbers them, and
+				their weights, which add up to 1.
+		*/
+		struct Vertex : aie::OBJMesh::Vertex
+		{
+			unsigned short joints[4];
+			float weights[4];
+		};
+
+		/**
+			A primitive's indices, and its material as the lit shaders
+				take it.
+		*/
+		struct Primitive
+		{
+			unsigned int firstIndex;
+			unsigned int indexCount;
+			aie::OBJMesh::Material material;
+		};
+
+		SkinnedMesh();
+
+		/**
+			The deconstructor deletes the buffers.
+		*/
+		~SkinnedMesh();
+
+		SkinnedMesh(const SkinnedMesh&) = delete;
+		SkinnedMesh& operator=(const SkinnedMesh&) = delete;
+
+		/**
+			load reads the mesh, skeleton and animations from a model and
+				uploads the mesh. Missing tangents are worked out from
+				the texcoords, as OBJMesh does.
+
+				@param1 a_filename is the model, a .gltf or .glb.
+
+				@return false if it has no skinned mesh that can be read,
+						any error is printed.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			isLoaded returns whether load succeeded.
+		*/
+		bool isLoaded() const { return m_sourceBuffer != 0; }
+
+		/**
+			findClip finds an animation by its name.
+
+				@param1 a_name is the name.
+
+				@return its index, or -1 if there isn't one.
+		*/
+		int findClip(const std::string& a_name) const;
+
+		const Skeleton& getSkeleton() const { return m_skeleton; }
+		const std::vector<AnimationClip>& getClips() const { return m_clips; }
+		const std::vector<Primitive>& getPrimitives() const { return m_primitives; }
+		const std::string& getFilename() const { return m_filename; }
+
+		unsigned int getVertexCount() const { return m_vertexCount; }
+		unsigned int getSourceBuffer() const { return m_sourceBuffer; }
+		unsigned int getIndexBuffer() const { return m_indexBuffer; }
+
+	private:
+		// Reads one triangle primitive onto the end of the vertices and
+		//	indices.
+		bool readPrimitive(const GltfFile& a_file, const JsonValue& a_primitive, std::vector<Vertex>& a_vertices,
+			std::vector<unsigned int>& a_indices);
+
+		std::string m_filename;
+		Skeleton m_skeleton;
+		std::vector<AnimationClip> m_clips;
+		std::vector<Primitive> m_primitives;
+
+		unsigned int m_vertexCount;
+		unsigned int m_sourceBuffer;
+		unsigned int m_indexBuffer;
+	};
+}
@@ -0,0 +1,252 @@
+/**
+	Sky.cpp
+
+	Purpose: Sky.cpp is the source file for the Sky class. The Sky draws
+			the atmosphere behind the scene as the sun lights it, through
+			tables of how it scatters that are only built again when the
+			sun moves, for one filtered read a pixel.
+
+	@author Nathan Nette
+*/
+#include "Sky.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "SamplerCache.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cstdio>
+
+namespace sns
+{
+	// Must match local_size in the shaders.
+	static const int GROUP_SIZE = 8;
+
+	// Must match sky.glsl.
+	static const int TRANSMITTANCE_WIDTH = 256;
+	static const int TRANSMITTANCE_HEIGHT = 64;
+	static const int MULTI_SCATTERING_SIZE = 32;
+	static const int SKY_VIEW_WIDTH = 192;
+	static const int SKY_VIEW_HEIGHT = 108;
+
+	// The units the tables are read from, and the image each is written.
+	static const unsigned int TRANSMITTANCE_UNIT = 0;
+	static const unsigned int TABLE_UNIT = 1;
+	static const unsigned int DESTINATION_IMAGE = 0;
+
+	// Light through the air, which only needs to blend.
+	static const unsigned int FORMAT = GL_RGBA16F;
+
+	Sky::Sky()
+		: m_sunDirection(0.0f),
+		m_skyViewBuilt(false),
+		m_sampler(0),
+		m_vao(0),
+		m_enabled(true),
+		m_settings({ 15.0f, 100.0f })
+	{
+	}
+
+	/**
+		The deconstructor deletes the vertex array. The sampler belongs
+			to the SamplerCache.
+	*/
+	Sky::~Sky()
+	{
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			RenderState::instance().onVertexArrayDeleted(m_vao);
+		}
+	}
+
+	/**
+		create makes the tables, loads the shaders and builds the
+			transmittance and multiple scattering tables. The multiple
+			scattering is read from the transmittance, so it is built
+			after.
+
+			@return false without GL 4.3 or the shaders, it is left
+					uncreated.
+	*/
+	bool Sky::create()
+	{
+		static constexpr aie::UniformHandle TRANSMITTANCE_TABLE("TransmittanceTable");
+
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("Sky: the sky needs GL 4.3.\n");
+			return false;
+		}
+
+		m_transmittanceShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/skyTransmittance.comp");
+		m_multiScatteringShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/skyMultiScattering.comp");
+		m_skyViewShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/skyView.comp");
+		m_drawShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/sky.vert");
+		m_drawShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/sky.frag");
+		aie::ShaderProgram* programs[] = { &m_transmittanceShader, &m_multiScatteringShader, &m_skyViewShader,
+			&m_drawShader };
+		for (aie::ShaderProgram* program : programs)
+		{
+			if (program->link() == false)
+			{
+				printf("Shader Error: %s\n", program->getLastError());
+				return false;
+			}
+		}
+
+		GpuMemory& memory = GpuMemory::instance();
+		struct Table { TextureHandle* texture; int width; int height; };
+		Table tables[] = {
+			{ &m_transmittance, TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT },
+			{ &m_multiScattering, MULTI_SCATTERING_SIZE, MULTI_SCATTERING_SIZE },
+			{ &m_skyView, SKY_VIEW_WIDTH, SKY_VIEW_HEIGHT },
+		};
+		for (const Table& table : tables)
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, table.texture->put());
+			glTextureStorage2D(*table.texture, 1, FORMAT, table.width, table.height);
+			memory.trackTexture(*table.texture, GpuMemory::getTextureBytes(FORMAT, table.width, table.height),
+				GpuMemory::LIGHTING, "Sky");
+		}
+		m_sampler = SamplerCache::instance().get({ GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, false });
+
+		RenderState& state = RenderState::instance();
+		m_transmittanceShader.bind();
+		glBindImageTexture(DESTINATION_IMAGE, m_transmittance, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute((TRANSMITTANCE_WIDTH + GROUP_SIZE - 1) / GROUP_SIZE,
+			(TRANSMITTANCE_HEIGHT + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		m_multiScatteringShader.bind();
+		m_multiScatteringShader.bindUniform(TRANSMITTANCE_TABLE, (int)TRANSMITTANCE_UNIT);
+		state.bindTexture(TRANSMITTANCE_UNIT, m_transmittance, m_sampler);
+		glBindImageTexture(DESTINATION_IMAGE, m_multiScattering, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute((MULTI_SCATTERING_SIZE + GROUP_SIZE - 1) / GROUP_SIZE,
+			(MULTI_SCATTERING_SIZE + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		state.bindTexture(TRANSMITTANCE_UNIT, 0);
+
+		glCreateVertexArrays(1, &m_vao);
+		m_skyViewBuilt = false;
+		return true;
+	}
+
+	/**
+		update builds the sky view table again if the sun has moved
+			since it was last built. The table is around from the sun,
+			so only how far up it is matters to it.
+
+			@param1 a_sunDirection is the way to the sun, y up.
+	*/
+	void Sky::update(const glm::vec3& a_sunDirection)
+	{
+		static constexpr aie::UniformHandle TRANSMITTANCE_TABLE("TransmittanceTable");
+		static constexpr aie::UniformHandle MULTI_SCATTERING_TABLE("MultiScatteringTable");
+		static constexpr aie::UniformHandle SUN_MU("SunMu");
+
+		if (isEnabled() == false)
+			return;
+		glm::vec3 direction = glm::normalize(a_sunDirection);
+		if (m_skyViewBuilt && direction == m_sunDirection)
+			return;
+		m_sunDirection = direction;
+		m_skyViewBuilt = true;
+
+		RenderState& state = RenderState::instance();
+		m_skyViewShader.bind();
+		m_skyViewShader.bindUniform(TRANSMITTANCE_TABLE, (int)TRANSMITTANCE_UNIT);
+		m_skyViewShader.bindUniform(MULTI_SCATTERING_TABLE, (int)TABLE_UNIT);
+		m_skyViewShader.bindUniform(SUN_MU, direction.y);
+		state.bindTexture(TRANSMITTANCE_UNIT, m_transmittance, m_sampler);
+		state.bindTexture(TABLE_UNIT, m_multiScattering, m_sampler);
+		glBindImageTexture(DESTINATION_IMAGE, m_skyView, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute((SKY_VIEW_WIDTH + GROUP_SIZE - 1) / GROUP_SIZE, (SKY_VIEW_HEIGHT + GROUP_SIZE - 1) / GROUP_SIZE,
+			1);
+
+		// The draws read it as a texture.
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		state.bindTexture(TRANSMITTANCE_UNIT, 0);
+		state.bindTexture(TABLE_UNIT, 0);
+	}
+
+	/**
+		draw draws the sky behind what the bound framebuffer has been
+			drawn, over the viewport bound. The triangle is at the far
+			depth, so it only passes where the depth is still cleared.
+
+			@param1 a_view is the camera's view.
+
+			@param2 a_projection is the camera's projection.
+
+			@param3 a_sunColour is the colour the sun lights the scene.
+	*/
+	void Sky::draw(const glm::mat4& a_view, const glm::mat4& a_projection, const glm::vec3& a_sunColour)
+	{
+		static constexpr aie::UniformHandle FAR_DEPTH("FarDepth");
+		static constexpr aie::UniformHandle SKY_VIEW_TABLE("SkyViewTable");
+		static constexpr aie::UniformHandle TRANSMITTANCE_TABLE("TransmittanceTable");
+		static constexpr aie::UniformHandle INVERSE_PROJECTION("InverseProjection");
+		static constexpr aie::UniformHandle INVERSE_VIEW("InverseView");
+		static constexpr aie::UniformHandle SUN_DIRECTION("SunDirection");
+		static constexpr aie::UniformHandle SUN_COLOUR("SunColour");
+		static constexpr aie::UniformHandle SUN_DISC_RADIANCE("SunDiscRadiance");
+
+		if (isEnabled() == false || m_skyViewBuilt == false)
+			return;
+
+		RenderState& state = RenderState::instance();
+		state.bindTexture(TRANSMITTANCE_UNIT, m_transmittance, m_sampler);
+		state.bindTexture(TABLE_UNIT, m_skyView, m_sampler);
+
+		m_drawShader.bind();
+		m_drawShader.bindUniform(FAR_DEPTH, state.getFarDepth());
+		m_drawShader.bindUniform(SKY_VIEW_TABLE, (int)TABLE_UNIT);
+		m_drawShader.bindUniform(TRANSMITTANCE_TABLE, (int)TRANSMITTANCE_UNIT);
+		m_drawShader.bindUniform(INVERSE_PROJECTION, glm::inverse(a_projection));
+		m_drawShader.bindUniform(INVERSE_VIEW, glm::inverse(a_view));
+		m_drawShader.bindUniform(SUN_DIRECTION, m_sunDirection);
+		m_drawShader.bindUniform(SUN_COLOUR, a_sunColour * m_settings.intensity);
+		m_drawShader.bindUniform(SUN_DISC_RADIANCE, m_settings.sunDisc);
+
+		// Only where the depth is still the far depth, which the
+		//	triangle is at.
+		state.setDepthMask(false);
+		state.setDepthFunc(state.isReverseZ() ? GL_GEQUAL : GL_LEQUAL);
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		state.setDepthFunc(state.getNearerDepthFunc());
+		state.setDepthMask(true);
+	}
+
+	/**
+		bind binds the sky view table for a program that reflects the
+			sky, and points it at the table and the sun. It is lit the
+			same as it is drawn.
+
+			@param1 a_program is the program, which must be bound.
+
+			@param2 a_unit is the texture unit.
+
+			@param3 a_sunColour is the colour the sun lights the scene.
+
+			@return false when the sky isn't drawn, and there is none to
+					reflect.
+	*/
+	bool Sky::bind(aie::ShaderProgram& a_program, unsigned int a_unit, const glm::vec3& a_sunColour) const
+	{
+		static constexpr aie::UniformHandle SKY_VIEW_TABLE("SkyViewTable");
+		static constexpr aie::UniformHandle SUN_DIRECTION("SunDirection");
+		static constexpr aie::UniformHandle SUN_COLOUR("SunColour");
+
+		if (isEnabled() == false || m_skyViewBuilt == false)
+			return false;
+		RenderState::instance().bindTexture(a_unit, m_skyView, m_sampler);
+		a_program.bindUniform(SKY_VIEW_TABLE, (int)a_unit);
+		a_program.bindUniform(SUN_DIRECTION, m_sunDirection);
+		a_program.bindUniform(SUN_COLOUR, a_sunColour * m_settings.intensity);
+		return true;
+	}
+}
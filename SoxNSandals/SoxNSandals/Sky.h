@@ -0,0 +1,159 @@
+/**
+	Sky.h
+
+	Purpose: Sky.h is the header file for the Sky class. The Sky draws
+			the atmosphere behind the scene as the sun lights it, through
+			tables of how it scatters that are only built again when the
+			sun moves, for one filtered read a pixel.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+namespace sns
+{
+	/**
+		The Sky class draws an earth's atmosphere the way Hillaire does,
+			from three tables built in compute.
+
+		The transmittance table is how much light gets through the air
+			from any height to the top of the atmosphere at any angle,
+			and the multiple scattering table is how much more light
+			every order of scattering past the first adds at any height
+			under a sun at any angle. Neither depends on where the sun
+			is, so both are built once, when the sky is created.
+
+		The sky view table is the light scattered towards the camera from
+			every way it can look, marched through the atmosphere with
+			both of the others, for where the sun is. It is built again
+			only when the sun moves. Drawing the sky is then a full
+			screen triangle at the far depth, where nothing else was
+			drawn, reading the table once a pixel with the sun's disc
+			added over it.
+
+		The camera is always a little above the ground for it, as the
+			scenes are far smaller than the atmosphere. Needs GL 4.3,
+			without it create fails and the background is the clear
+			colour.
+	*/
+	class Sky
+	{
+	public:
+		/**
+			How bright the sky is drawn.
+		*/
+		struct Settings
+		{
+			// What the sun's colour is multiplied by to light the sky,
+			//	as a sun lighting the scene by 1 lights the air by far
+			//	less than it does a wall.
+			float intensity;
+
+			// How much brighter the sun's disc is than the sky would be
+			//	lit by it. The real sun is thousands of times brighter,
+			//	which would wash out the bloom.
+			float sunDisc;
+		};
+
+		Sky();
+		~Sky();
+
+		Sky(const Sky&) = delete;
+		Sky& operator=(const Sky&) = delete;
+
+		/**
+			create makes the tables, loads the shaders and builds the
+				transmittance and multiple scattering tables.
+
+				@return false without GL 4.3 or the shaders, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vao != 0; }
+
+		/**
+			update builds the sky view table again if the sun has moved
+				since it was last built.
+
+				@param1 a_sunDirection is the way to the sun, y up.
+		*/
+		void update(const glm::vec3& a_sunDirection);
+
+		/**
+			draw draws the sky behind what the bound framebuffer has been
+				drawn, over the viewport bound. It is tested against the
+				depth and doesn't write it.
+
+				@param1 a_view is the camera's view.
+
+				@param2 a_projection is the camera's projection.
+
+				@param3 a_sunColour is the colour the sun lights the scene.
+		*/
+		void draw(const glm::mat4& a_view, const glm::mat4& a_projection, const glm::vec3& a_sunColour);
+
+		/**
+			bind binds the sky view table for a program that reflects the
+				sky, and points it at the table and the sun.
+
+				@param1 a_program is the program, which must be bound.
+
+				@param2 a_unit is the texture unit.
+
+				@param3 a_sunColour is the colour the sun lights the scene.
+
+				@return false when the sky isn't drawn, and there is none
+						to reflect.
+		*/
+		bool bind(aie::ShaderProgram& a_program, unsigned int a_unit, const glm::vec3& a_sunColour) const;
+
+		/**
+			setEnabled sets whether the sky is drawn, or the background
+				left the clear colour.
+
+				@param1 a_enabled is whether the sky is drawn.
+		*/
+		void setEnabled(bool a_enabled) { m_enabled = a_enabled; }
+
+		/**
+			isEnabled returns whether the sky is drawn, and it is created.
+		*/
+		bool isEnabled() const { return m_enabled && isCreated(); }
+
+		/**
+			getSettings returns how bright the sky is drawn.
+		*/
+		Settings& getSettings() { return m_settings; }
+		const Settings& getSettings() const { return m_settings; }
+
+	private:
+		aie::ShaderProgram m_transmittanceShader;
+		aie::ShaderProgram m_multiScatteringShader;
+		aie::ShaderProgram m_skyViewShader;
+		aie::ShaderProgram m_drawShader;
+
+		TextureHandle m_transmittance;
+		TextureHandle m_multiScattering;
+		TextureHandle m_skyView;
+
+		// The sun the sky view table was built for, and whether it has
+		//	been.
+		glm::vec3 m_sunDirection;
+		bool m_skyViewBuilt;
+
+		// Filtered and clamped, every table is read between its texels.
+		unsigned int m_sampler;
+		unsigned int m_vao;
+
+		bool m_enabled;
+		Settings m_settings;
+	};
+}
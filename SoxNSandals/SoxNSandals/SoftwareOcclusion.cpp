@@ -0,0 +1,474 @@
+/**
+	SoftwareOcclusion.cpp
+
+	Purpose: SoftwareOcclusion.cpp is the source file for the
+			SoftwareOcclusion class. The SoftwareOcclusion draws a few
+			large occluders into a small depth buffer on the cpu, so
+			chunks hidden behind them are left out before anything is
+			sent to the gpu.
+
+	@author Nathan Nette
+*/
+#include "SoftwareOcclusion.h"
+#include "JobSystem.h"
+#include "OBJMesh.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace sns
+{
+	static_assert(SoftwareOcclusion::WIDTH % 4 == 0, "rows are written four pixels at a time");
+	static_assert(SoftwareOcclusion::HEIGHT % SoftwareOcclusion::BAND_ROWS == 0, "bands divide the buffer");
+	static_assert(SoftwareOcclusion::BAND_ROWS % SoftwareOcclusion::TILE_SIZE == 0, "tiles sit in one band");
+	static_assert(SoftwareOcclusion::WIDTH % SoftwareOcclusion::TILE_SIZE == 0, "tiles divide the rows");
+
+	// Triangles with less than this much area in pixels cover no pixel
+	//	centres worth writing.
+	static const float MIN_SCREEN_AREA = 0.01f;
+
+	SoftwareOcclusion::SoftwareOcclusion()
+		: m_occluderCount(0),
+		m_depth(WIDTH * HEIGHT, 0.0f),
+		m_tileDepth(),
+		m_projectionView(1),
+		m_rendered(false),
+		m_triangleCount(0),
+		m_tested(0),
+		m_occluded(0)
+	{
+	}
+
+	/**
+		clearOccluders forgets every occluder.
+	*/
+	void SoftwareOcclusion::clearOccluders()
+	{
+		m_corners.clear();
+		m_areas.clear();
+		m_occluderCount = 0;
+		m_rendered = false;
+	}
+
+	/**
+		addOccluder adds a pickable mesh's triangles as occluders, keeping
+			only the MAX_TRIANGLES largest of every mesh added. Large
+			triangles hide the most for what they cost to rasterise, and
+			the small ones of detailed meshes would mostly be too small
+			to cover a pixel.
+
+			@param1 a_mesh is the mesh, which must be pickable.
+
+			@param2 a_model is where it is in the world.
+	*/
+	void SoftwareOcclusion::addOccluder(const aie::OBJMesh& a_mesh, const glm::mat4& a_model)
+	{
+		++m_occluderCount;
+		m_rendered = false;
+		for (unsigned int chunk = 0; chunk < (unsigned int)a_mesh.getChunkCount(); ++chunk)
+		{
+			unsigned int triangles = a_mesh.getTriangleCount(chunk);
+			for (unsigned int triangle = 0; triangle < triangles; ++triangle)
+			{
+				glm::vec3 corners[3];
+				a_mesh.getTriangle(chunk, triangle, corners);
+				for (glm::vec3& corner : corners)
+					corner = glm::vec3(a_model * glm::vec4(corner, 1));
+
+				float area = glm::length(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+				if (area <= 0.0f)
+					continue;
+				m_corners.insert(m_corners.end(), corners, corners + 3);
+				m_areas.push_back(area);
+			}
+		}
+
+		if (m_areas.size() <= MAX_TRIANGLES)
+			return;
+
+		std::vector<unsigned int> order(m_areas.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::nth_element(order.begin(), order.begin() + MAX_TRIANGLES, order.end(),
+			[this](unsigned int a_a, unsigned int a_b) { return m_areas[a_a] > m_areas[a_b]; });
+		order.resize(MAX_TRIANGLES);
+
+		std::vector<glm::vec3> corners;
+		std::vector<float> areas;
+		corners.reserve(MAX_TRIANGLES * 3);
+		areas.reserve(MAX_TRIANGLES);
+		for (unsigned int triangle : order)
+		{
+			corners.insert(corners.end(), m_corners.begin() + triangle * 3, m_corners.begin() + triangle * 3 + 3);
+			areas.push_back(m_areas[triangle]);
+		}
+		m_corners.swap(corners);
+		m_areas.swap(areas);
+	}
+
+	/**
+		render rasterises the occluders for a view, on the job system, and
+			waits for it to finish. The triangles are set up a share a
+			job, then each band is rasterised by a job of its own.
+
+			@param1 a_projectionView is the view.
+	*/
+	void SoftwareOcclusion::render(const glm::mat4& a_projectionView)
+	{
+		SNS_PROFILE_SCOPE("SoftwareOcclusion::render");
+		JobSystem& jobs = JobSystem::instance();
+		m_tested = 0;
+		m_occluded = 0;
+		m_projectionView = a_projectionView;
+
+		unsigned int triangles = (unsigned int)m_areas.size();
+		unsigned int share = (triangles + BANDS - 1) / BANDS;
+		JobCounter setup;
+		for (unsigned int job = 0; job < BANDS; ++job)
+		{
+			unsigned int first = std::min(job * share, triangles);
+			unsigned int last = std::min(first + share, triangles);
+			jobs.run([this, job, first, last, a_projectionView]()
+			{
+				std::vector<ScreenTriangle>& screenTriangles = m_screenTriangles[job];
+				screenTriangles.clear();
+				for (unsigned int triangle = first; triangle < last; ++triangle)
+				{
+					glm::vec4 clip[3];
+					for (unsigned int i = 0; i < 3; ++i)
+						clip[i] = a_projectionView * glm::vec4(m_corners[triangle * 3 + i], 1);
+					setupTriangle(clip, screenTriangles);
+				}
+			}, &setup);
+		}
+		jobs.wait(setup);
+
+		m_triangleCount = 0;
+		for (const std::vector<ScreenTriangle>& screenTriangles : m_screenTriangles)
+			m_triangleCount += (unsigned int)screenTriangles.size();
+
+		JobCounter bands;
+		for (unsigned int band = 0; band < BANDS; ++band)
+			jobs.run([this, band]() { rasteriseBand(band); }, &bands);
+		jobs.wait(bands);
+
+		m_rendered = true;
+	}
+
+	/**
+		setupTriangle clips an occluder against the near plane and adds
+			what is left to a list. Triangles wholly outside a side of
+			the view are left out.
+
+			@param1 a_clip are the triangle's corners in clip space.
+
+			@param2 a_triangles is the list.
+	*/
+	void SoftwareOcclusion::setupTriangle(const glm::vec4* a_clip, std::vector<ScreenTriangle>& a_triangles)
+	{
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			if (a_clip[0][axis] > a_clip[0].w && a_clip[1][axis] > a_clip[1].w && a_clip[2][axis] > a_clip[2].w)
+				return;
+			if (a_clip[0][axis] < -a_clip[0].w && a_clip[1][axis] < -a_clip[1].w && a_clip[2][axis] < -a_clip[2].w)
+				return;
+		}
+
+		float distances[3];
+		unsigned int inside = 0;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			distances[i] = a_clip[i].z + a_clip[i].w;
+			inside += distances[i] >= 0.0f ? 1 : 0;
+		}
+		if (inside == 0)
+			return;
+		if (inside == 3)
+		{
+			addScreenTriangle(a_clip[0], a_clip[1], a_clip[2], a_triangles);
+			return;
+		}
+
+		// Cutting a corner or two off leaves three or four corners.
+		glm::vec4 polygon[4];
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			unsigned int next = (i + 1) % 3;
+			if (distances[i] >= 0.0f)
+				polygon[count++] = a_clip[i];
+			if ((distances[i] >= 0.0f) != (distances[next] >= 0.0f))
+			{
+				float t = distances[i] / (distances[i] - distances[next]);
+				polygon[count++] = a_clip[i] + (a_clip[next] - a_clip[i]) * t;
+			}
+		}
+		for (unsigned int i = 2; i < count; ++i)
+			addScreenTriangle(polygon[0], polygon[i - 1], polygon[i], a_triangles);
+	}
+
+	/**
+		addScreenTriangle takes a triangle inside the near plane to pixels
+			and adds it to a list, wound so its edges' functions are
+			positive inside.
+
+			@param1 a_a is its first corner in clip space.
+
+			@param2 a_b is its second corner.
+
+			@param3 a_c is its third corner.
+
+			@param4 a_triangles is the list.
+	*/
+	void SoftwareOcclusion::addScreenTriangle(const glm::vec4& a_a, const glm::vec4& a_b, const glm::vec4& a_c,
+		std::vector<ScreenTriangle>& a_triangles)
+	{
+		const glm::vec4* clip[3] = { &a_a, &a_b, &a_c };
+		glm::vec2 corners[3];
+		float depths[3];
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			depths[i] = 1.0f / clip[i]->w;
+			corners[i] = (glm::vec2(*clip[i]) * depths[i] * 0.5f + 0.5f) * glm::vec2(WIDTH, HEIGHT);
+		}
+
+		glm::vec2 ab = corners[1] - corners[0];
+		glm::vec2 ac = corners[2] - corners[0];
+		float area = ab.x * ac.y - ab.y * ac.x;
+		if (std::abs(area) < MIN_SCREEN_AREA)
+			return;
+
+		// Occluders are seen from both sides.
+		if (area < 0.0f)
+		{
+			std::swap(corners[1], corners[2]);
+			std::swap(depths[1], depths[2]);
+			std::swap(ab, ac);
+			area = -area;
+		}
+
+		glm::vec2 low = glm::min(corners[0], glm::min(corners[1], corners[2]));
+		glm::vec2 high = glm::max(corners[0], glm::max(corners[1], corners[2]));
+
+		ScreenTriangle triangle;
+		triangle.minX = std::max((int)std::floor(low.x), 0);
+		triangle.minY = std::max((int)std::floor(low.y), 0);
+		triangle.maxX = std::min((int)std::floor(high.x), (int)WIDTH - 1);
+		triangle.maxY = std::min((int)std::floor(high.y), (int)HEIGHT - 1);
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+			return;
+
+		// 1 / w is linear across the screen, so it is a plane through the
+		//	three corners.
+		float db = depths[1] - depths[0];
+		float dc = depths[2] - depths[0];
+		triangle.depthX = (db * ac.y - dc * ab.y) / area;
+		triangle.depthY = (dc * ab.x - db * ac.x) / area;
+		triangle.depth = depths[0] - triangle.depthX * corners[0].x - triangle.depthY * corners[0].y;
+		for (unsigned int i = 0; i < 3; ++i)
+			triangle.corners[i] = corners[i];
+		a_triangles.push_back(triangle);
+	}
+
+	/**
+		rasteriseBand rasterises every triangle overlapping a band, then
+			finds the band's tiles' farthest depths.
+
+			@param1 a_band is the band.
+	*/
+	void SoftwareOcclusion::rasteriseBand(unsigned int a_band)
+	{
+		int bandMin = (int)(a_band * BAND_ROWS);
+		int bandMax = bandMin + (int)BAND_ROWS - 1;
+		float* depth = m_depth.data();
+		std::fill(depth + bandMin * WIDTH, depth + (bandMax + 1) * WIDTH, 0.0f);
+
+		for (const std::vector<ScreenTriangle>& screenTriangles : m_screenTriangles)
+		{
+			for (const ScreenTriangle& triangle : screenTriangles)
+			{
+				int minY = std::max(triangle.minY, bandMin);
+				int maxY = std::min(triangle.maxY, bandMax);
+				if (minY > maxY)
+					continue;
+
+				// Each edge as e = x * edgeX + y * edgeY + edge, positive
+				//	inside.
+				float edgeX[3], edgeY[3], edge[3];
+				for (unsigned int i = 0; i < 3; ++i)
+				{
+					const glm::vec2& a = triangle.corners[i];
+					const glm::vec2& b = triangle.corners[(i + 1) % 3];
+					edgeX[i] = a.y - b.y;
+					edgeY[i] = b.x - a.x;
+					edge[i] = -(edgeX[i] * a.x + edgeY[i] * a.y);
+				}
+
+				// Rows are walked four pixels at a time from a multiple of
+				//	four, the lanes past the triangle fail its edges.
+				int minX = triangle.minX & ~3;
+				for (int y = minY; y <= maxY; ++y)
+				{
+					float* row = depth + y * WIDTH;
+					float centreY = y + 0.5f;
+#ifdef SNS_OCCLUSION_SSE
+					__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+					__m128 x = _mm_add_ps(_mm_set1_ps((float)minX), offsets);
+					__m128 step = _mm_set1_ps(4.0f);
+					__m128 zero = _mm_setzero_ps();
+					__m128 rowEdge[3], stepX[3];
+					for (unsigned int i = 0; i < 3; ++i)
+					{
+						rowEdge[i] = _mm_set1_ps(edgeY[i] * centreY + edge[i]);
+						stepX[i] = _mm_set1_ps(edgeX[i]);
+					}
+					__m128 rowDepth = _mm_set1_ps(triangle.depthY * centreY + triangle.depth);
+					__m128 depthX = _mm_set1_ps(triangle.depthX);
+
+					for (int pixel = minX; pixel <= triangle.maxX; pixel += 4)
+					{
+						__m128 e0 = _mm_add_ps(_mm_mul_ps(x, stepX[0]), rowEdge[0]);
+						__m128 e1 = _mm_add_ps(_mm_mul_ps(x, stepX[1]), rowEdge[1]);
+						__m128 e2 = _mm_add_ps(_mm_mul_ps(x, stepX[2]), rowEdge[2]);
+						__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+							_mm_cmpge_ps(e2, zero));
+						if (_mm_movemask_ps(inside) != 0)
+						{
+							__m128 z = _mm_add_ps(_mm_mul_ps(x, depthX), rowDepth);
+							__m128 old = _mm_loadu_ps(row + pixel);
+							__m128 nearest = _mm_max_ps(old, z);
+							_mm_storeu_ps(row + pixel, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+						}
+						x = _mm_add_ps(x, step);
+					}
+#else
+					for (int pixel = minX; pixel <= triangle.maxX; ++pixel)
+					{
+						float centreX = pixel + 0.5f;
+						bool inside = true;
+						for (unsigned int i = 0; i < 3; ++i)
+							inside = inside && centreX * edgeX[i] + centreY * edgeY[i] + edge[i] >= 0.0f;
+						if (inside)
+						{
+							float z = centreX * triangle.depthX + centreY * triangle.depthY + triangle.depth;
+							row[pixel] = std::max(row[pixel], z);
+						}
+					}
+#endif
+				}
+			}
+		}
+
+		for (int tileY = bandMin / (int)TILE_SIZE; tileY <= bandMax / (int)TILE_SIZE; ++tileY)
+		{
+			for (unsigned int tileX = 0; tileX < TILES_X; ++tileX)
+			{
+				float farthest = FLT_MAX;
+				for (unsigned int y = tileY * TILE_SIZE; y < (tileY + 1) * TILE_SIZE; ++y)
+				{
+					const float* row = depth + y * WIDTH + tileX * TILE_SIZE;
+					farthest = std::min(farthest, *std::min_element(row, row + TILE_SIZE));
+				}
+				m_tileDepth[tileY * TILES_X + tileX] = farthest;
+			}
+		}
+	}
+
+	/**
+		isBoxVisible returns whether any of a box might be seen past the
+			occluders. 1 / w across the box is largest at one of its
+			corners, so the box is hidden where an occluder is nearer
+			than that at every pixel its corners' rectangle covers.
+
+			@param1 a_toClip takes the box's space to the rendered view's
+					clip space.
+
+			@param2 a_centre is the box's centre.
+
+			@param3 a_extent is half the box's size.
+
+			@return true when it might be seen, or nothing is rendered.
+	*/
+	bool SoftwareOcclusion::isBoxVisible(const glm::mat4& a_toClip, const glm::vec3& a_centre,
+		const glm::vec3& a_extent) const
+	{
+		if (m_rendered == false)
+			return true;
+		++m_tested;
+
+		glm::vec4 centre = a_toClip * glm::vec4(a_centre, 1);
+		glm::vec4 axes[3] = { a_toClip[0] * a_extent.x, a_toClip[1] * a_extent.y, a_toClip[2] * a_extent.z };
+
+		glm::vec2 low(FLT_MAX);
+		glm::vec2 high(-FLT_MAX);
+		float nearest = 0.0f;
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			glm::vec4 corner = centre + ((i & 1) ? axes[0] : -axes[0]) + ((i & 2) ? axes[1] : -axes[1]) +
+				((i & 4) ? axes[2] : -axes[2]);
+
+			// Crossing the near plane it would cover the whole screen.
+			if (corner.z < -corner.w || corner.w <= 0.0f)
+				return true;
+
+			float inverseW = 1.0f / corner.w;
+			glm::vec2 screen = (glm::vec2(corner) * inverseW * 0.5f + 0.5f) * glm::vec2(WIDTH, HEIGHT);
+			low = glm::min(low, screen);
+			high = glm::max(high, screen);
+			nearest = std::max(nearest, inverseW);
+		}
+
+		int minX = std::max((int)std::floor(low.x), 0);
+		int minY = std::max((int)std::floor(low.y), 0);
+		int maxX = std::min((int)std::floor(high.x), (int)WIDTH - 1);
+		int maxY = std::min((int)std::floor(high.y), (int)HEIGHT - 1);
+		if (minX > maxX || minY > maxY)
+			return true;
+
+		for (int tileY = minY / (int)TILE_SIZE; tileY <= maxY / (int)TILE_SIZE; ++tileY)
+		{
+			for (int tileX = minX / (int)TILE_SIZE; tileX <= maxX / (int)TILE_SIZE; ++tileX)
+			{
+				if (m_tileDepth[tileY * TILES_X + tileX] >= nearest)
+					continue;
+
+				// Part of the tile is farther, so the pixels the box covers
+				//	are looked at.
+				int rowMin = std::max(minY, tileY * (int)TILE_SIZE);
+				int rowMax = std::min(maxY, (tileY + 1) * (int)TILE_SIZE - 1);
+				int columnMin = std::max(minX, tileX * (int)TILE_SIZE);
+				int columnMax = std::min(maxX, (tileX + 1) * (int)TILE_SIZE - 1);
+				for (int y = rowMin; y <= rowMax; ++y)
+				{
+					const float* row = m_depth.data() + y * WIDTH;
+					for (int x = columnMin; x <= columnMax; ++x)
+					{
+						if (row[x] < nearest)
+							return true;
+					}
+				}
+			}
+		}
+
+		++m_occluded;
+		return false;
+	}
+
+	/**
+		getStats returns what the last render and the tests since did.
+	*/
+	SoftwareOcclusion::Stats SoftwareOcclusion::getStats() const
+	{
+		Stats stats;
+		stats.triangles = m_triangleCount;
+		stats.tested = m_tested.load();
+		stats.occluded = m_occluded.load();
+		return stats;
+	}
+}
@@ -0,0 +1,181 @@
+/**
+	SoftwareOcclusion.h
+
+	Purpose: SoftwareOcclusion.h is the header file for the
+			SoftwareOcclusion class. The SoftwareOcclusion draws a few
+			large occluders into a small depth buffer on the cpu, so
+			chunks hidden behind them are left out before anything is
+			sent to the gpu.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <atomic>
+#include <vector>
+
+namespace aie { class OBJMesh; }
+
+namespace sns
+{
+	/**
+		The SoftwareOcclusion class keeps the largest triangles of the
+			meshes it is given as occluders, in world space, and each
+			frame rasterises them for a view into a WIDTH by HEIGHT
+			buffer of 1 / w, the nearest kept at every pixel.
+
+		The buffer is split into bands of BAND_ROWS rows, each rasterised
+			by its own job, so no two jobs write the same pixel. Four
+			pixels of a row are tested against a triangle's edges and
+			written at once with SSE. Each band then keeps the farthest
+			depth of every TILE_SIZE square, so most boxes are answered
+			by a few tiles rather than every pixel they cover.
+
+		A box is hidden when every pixel it covers has an occluder nearer
+			than the box's nearest corner. Anything crossing the near
+			plane, or not yet tested against a rendered buffer, is
+			visible, so the test only ever leaves out what can't be
+			seen.
+	*/
+	class SoftwareOcclusion
+	{
+	public:
+		// The size of the depth buffer in pixels.
+		static const unsigned int WIDTH = 320;
+		static const unsigned int HEIGHT = 192;
+
+		// The rows a job rasterises, and the size of the tiles the
+		//	farthest depth is kept for. Both divide the buffer evenly.
+		static const unsigned int BAND_ROWS = 16;
+		static const unsigned int TILE_SIZE = 16;
+
+		// The most triangles kept as occluders.
+		static const unsigned int MAX_TRIANGLES = 8192;
+
+		/**
+			What the last render and the tests since did.
+		*/
+		struct Stats
+		{
+			unsigned int triangles;
+			unsigned int tested;
+			unsigned int occluded;
+		};
+
+		SoftwareOcclusion();
+
+		SoftwareOcclusion(const SoftwareOcclusion&) = delete;
+		SoftwareOcclusion& operator=(const SoftwareOcclusion&) = delete;
+
+		/**
+			clearOccluders forgets every occluder.
+		*/
+		void clearOccluders();
+
+		/**
+			addOccluder adds a pickable mesh's triangles as occluders,
+				keeping only the MAX_TRIANGLES largest of every mesh
+				added.
+
+				@param1 a_mesh is the mesh, which must be pickable.
+
+				@param2 a_model is where it is in the world.
+		*/
+		void addOccluder(const aie::OBJMesh& a_mesh, const glm::mat4& a_model);
+
+		/**
+			getOccluderCount returns how many meshes have been added since
+				the last clearOccluders.
+		*/
+		unsigned int getOccluderCount() const { return m_occluderCount; }
+
+		/**
+			render rasterises the occluders for a view, on the job system,
+				and waits for it to finish.
+
+				@param1 a_projectionView is the view.
+		*/
+		void render(const glm::mat4& a_projectionView);
+
+		/**
+			getProjectionView returns the view last rendered for, boxes
+				are taken to its clip space to be tested.
+		*/
+		const glm::mat4& getProjectionView() const { return m_projectionView; }
+
+		/**
+			invalidate makes every box visible until the next render.
+		*/
+		void invalidate() { m_rendered = false; }
+
+		/**
+			isBoxVisible returns whether any of a box might be seen past
+				the occluders. It can be called from any thread after
+				render.
+
+				@param1 a_toClip takes the box's space to the rendered
+						view's clip space.
+
+				@param2 a_centre is the box's centre.
+
+				@param3 a_extent is half the box's size.
+		*/
+		bool isBoxVisible(const glm::mat4& a_toClip, const glm::vec3& a_centre, const glm::vec3& a_extent) const;
+
+		/**
+			getStats returns what the last render and the tests since did.
+		*/
+		Stats getStats() const;
+
+	private:
+		static const unsigned int TILES_X = WIDTH / TILE_SIZE;
+		static const unsigned int TILES_Y = HEIGHT / TILE_SIZE;
+		static const unsigned int BANDS = HEIGHT / BAND_ROWS;
+
+		/**
+			A triangle ready to rasterise, in pixels, with 1 / w as a
+				plane across the screen.
+		*/
+		struct ScreenTriangle
+		{
+			glm::vec2 corners[3];
+			float depth;
+			float depthX;
+			float depthY;
+			int minX, minY, maxX, maxY;
+		};
+
+		// Clips an occluder against the near plane and adds what is left
+		//	to a list.
+		static void setupTriangle(const glm::vec4* a_clip, std::vector<ScreenTriangle>& a_triangles);
+
+		// Takes a triangle inside the near plane to pixels and adds it to
+		//	a list.
+		static void addScreenTriangle(const glm::vec4& a_a, const glm::vec4& a_b, const glm::vec4& a_c,
+			std::vector<ScreenTriangle>& a_triangles);
+
+		// Rasterises every triangle overlapping a band, then finds the
+		//	band's tiles' farthest depths.
+		void rasteriseBand(unsigned int a_band);
+
+		// The occluders' corners, three a triangle, and each one's area.
+		std::vector<glm::vec3> m_corners;
+		std::vector<float> m_areas;
+		unsigned int m_occluderCount;
+
+		// The triangles set up by each job of this render.
+		std::vector<ScreenTriangle> m_screenTriangles[BANDS];
+
+		// 1 / w of the nearest occluder at each pixel, and the farthest of
+		//	each tile. 0 is nothing.
+		std::vector<float> m_depth;
+		float m_tileDepth[TILES_X * TILES_Y];
+
+		glm::mat4 m_projectionView;
+		bool m_rendered;
+
+		unsigned int m_triangleCount;
+		mutable std::atomic<unsigned int> m_tested;
+		mutable std::atomic<unsigned int> m_occluded;
+	};
+}
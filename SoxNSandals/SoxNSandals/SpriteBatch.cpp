@@ -0,0 +1,266 @@
+/**
+	SpriteBatch.cpp
+
+	Purpose: SpriteBatch.cpp is the source file for the SpriteBatch
+			class. The SpriteBatch draws the textured and tinted 2D
+			quads added to it each frame, a draw per texture rather
+			than a draw per quad.
+
+	@author Nathan Nette
+*/
+#include "SpriteBatch.h"
+#include "GpuMemory.h"
+#include "RadixSort.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/packing.hpp>
+#include <cstddef>
+#include <cstdio>
+
+namespace sns
+{
+	// The unit the sprites' textures are bound to.
+	static const unsigned int SPRITE_UNIT = 0;
+
+	SpriteBatch::SpriteBatch()
+		: m_lastTexture(0),
+		m_lastSlot(~0u),
+		m_vao(0),
+		m_whiteTexture(0),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor deletes the white texture and vertex array.
+	*/
+	SpriteBatch::~SpriteBatch()
+	{
+		RenderState& state = RenderState::instance();
+		if (m_whiteTexture != 0)
+		{
+			glDeleteTextures(1, &m_whiteTexture);
+			state.onTextureDeleted(m_whiteTexture);
+			GpuMemory::instance().releaseTexture(m_whiteTexture);
+		}
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			state.onVertexArrayDeleted(m_vao);
+		}
+	}
+
+	/**
+		create loads the program and makes the white texture.
+
+			@return false without GL 4.5 or the program, it is left
+					uncreated.
+	*/
+	bool SpriteBatch::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("SpriteBatch: sprites need GL 4.5.\n");
+			return false;
+		}
+
+		if (m_shader.getHandle() == 0)
+		{
+			m_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/sprite.vert");
+			m_shader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/sprite.frag");
+			if (m_shader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_shader.getLastError());
+				return false;
+			}
+		}
+
+		uint32_t white = 0xffffffff;
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_whiteTexture);
+		glTextureStorage2D(m_whiteTexture, 1, GL_RGBA8, 1, 1);
+		glTextureSubImage2D(m_whiteTexture, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+		glTextureParameteri(m_whiteTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_whiteTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GpuMemory::instance().trackTexture(m_whiteTexture, GpuMemory::getTextureBytes(GL_RGBA8, 1, 1),
+			GpuMemory::TEXTURES, "SpriteBatch");
+
+		// The quad's corners come from gl_VertexID, so the only vertex
+		//	buffer is the sprites.
+		glCreateVertexArrays(1, &m_vao);
+		struct Attribute
+		{
+			unsigned int size;
+			unsigned int type;
+			bool normalised;
+			size_t offset;
+		};
+		const Attribute ATTRIBUTES[4] =
+		{
+			{ 4, GL_FLOAT, false, offsetof(Sprite, centre) },
+			{ 4, GL_FLOAT, false, offsetof(Sprite, texCoords) },
+			{ 4, GL_UNSIGNED_BYTE, true, offsetof(Sprite, colour) },
+			{ 2, GL_FLOAT, false, offsetof(Sprite, rotation) },
+		};
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			glEnableVertexArrayAttrib(m_vao, i);
+			glVertexArrayAttribFormat(m_vao, i, ATTRIBUTES[i].size, ATTRIBUTES[i].type,
+				ATTRIBUTES[i].normalised ? GL_TRUE : GL_FALSE, (unsigned int)ATTRIBUTES[i].offset);
+			glVertexArrayAttribBinding(m_vao, i, 0);
+		}
+		glVertexArrayBindingDivisor(m_vao, 0, 1);
+		return true;
+	}
+
+	/**
+		add adds a sprite to the next draw.
+
+			@param1 a_texture is the GL handle of the texture, 0 for white.
+
+			@param2 a_centre is the centre of the quad.
+
+			@param3 a_size is its width and height.
+
+			@param4 a_colour is the tint the texture is multiplied by.
+
+			@param5 a_texCoords are the texture's rectangle, the bottom
+					left in xy and the top right in zw.
+
+			@param6 a_rotation turns the quad anticlockwise about its
+					centre, in radians.
+
+			@param7 a_layer is the layer, below LAYER_COUNT.
+	*/
+	void SpriteBatch::add(unsigned int a_texture, const glm::vec2& a_centre, const glm::vec2& a_size,
+		const glm::vec4& a_colour, const glm::vec4& a_texCoords, float a_rotation, unsigned int a_layer)
+	{
+		if (a_texture != m_lastTexture || m_lastSlot == ~0u)
+		{
+			auto found = m_textureSlots.find(a_texture);
+			if (found == m_textureSlots.end())
+			{
+				found = m_textureSlots.emplace(a_texture, (unsigned int)m_textures.size()).first;
+				m_textures.push_back(a_texture);
+			}
+			m_lastTexture = a_texture;
+			m_lastSlot = found->second;
+		}
+
+		Sprite sprite = { a_centre, a_size, a_texCoords, glm::packUnorm4x8(a_colour), a_rotation, 0.0f, 0.0f };
+		m_sprites.push_back(sprite);
+		unsigned int layer = a_layer < LAYER_COUNT ? a_layer : LAYER_COUNT - 1;
+		m_keys.push_back((uint32_t)layer << 24 | m_lastSlot);
+	}
+
+	/**
+		draw draws the sprites added since the last draw, each run of one
+			texture with one instanced draw, then clears them.
+
+			@param1 a_projection places them.
+	*/
+	void SpriteBatch::draw(const glm::mat4& a_projection)
+	{
+		static constexpr aie::UniformHandle PROJECTION("Projection");
+		static constexpr aie::UniformHandle SPRITE_TEXTURE("SpriteTexture");
+
+		m_stats = {};
+		unsigned int count = (unsigned int)m_sprites.size();
+		if (isCreated() == false || count == 0)
+		{
+			clear();
+			return;
+		}
+
+		// Sorted stably, so sprites of one texture in one layer keep the
+		//	order they were added in. Layers and textures are few, so
+		//	most of the sort's passes are skipped.
+		m_order.resize(count);
+		m_scratchKeys.resize(count);
+		m_scratchOrder.resize(count);
+		for (unsigned int i = 0; i < count; ++i)
+			m_order[i] = i;
+		radixSort(m_keys.data(), m_order.data(), m_scratchKeys.data(), m_scratchOrder.data(), count);
+
+		// Grown by doubling, so a busy frame doesn't remake it every frame.
+		if (m_stream.getElementCount() < count)
+		{
+			unsigned int capacity = DEFAULT_CAPACITY;
+			while (capacity < count)
+				capacity *= 2;
+			m_stream.create(sizeof(Sprite), capacity, "SpriteBatch");
+			glVertexArrayVertexBuffer(m_vao, 0, m_stream.getHandle(), 0, sizeof(Sprite));
+		}
+		Sprite* region = (Sprite*)m_stream.beginWrite();
+		for (unsigned int i = 0; i < count; ++i)
+			region[i] = m_sprites[m_order[i]];
+		unsigned int firstInstance = m_stream.endWrite(count);
+
+		RenderState& state = RenderState::instance();
+		unsigned int program = state.getProgram();
+		bool blendEnabled = state.isBlendEnabled();
+		bool depthMask = state.getDepthMask();
+		unsigned int source, destination;
+		state.getBlendFunc(source, destination);
+
+		m_shader.bind();
+		m_shader.bindUniform(PROJECTION, a_projection);
+		m_shader.bindUniform(SPRITE_TEXTURE, (int)SPRITE_UNIT);
+		state.bindVertexArray(m_vao);
+		state.setBlend(true);
+		state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		state.setDepthMask(false);
+
+		// Runs of one texture in neighbouring layers are drawn together,
+		//	nothing of another texture can be between them.
+		for (unsigned int first = 0; first < count;)
+		{
+			unsigned int slot = m_keys[first] & 0xffffff;
+			unsigned int last = first + 1;
+			while (last < count && (m_keys[last] & 0xffffff) == slot)
+				++last;
+
+			unsigned int texture = m_textures[slot];
+			state.bindTexture(SPRITE_UNIT, texture != 0 ? texture : m_whiteTexture);
+			state.countDraw();
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, last - first, firstInstance + first);
+			++m_stats.draws;
+			first = last;
+		}
+		m_stream.fence();
+		m_stats.sprites = count;
+
+		state.setDepthMask(depthMask);
+		state.setBlendFunc(source, destination);
+		state.setBlend(blendEnabled);
+		state.useProgram(program);
+		clear();
+	}
+
+	/**
+		draw draws the sprites a pixel to a unit, the origin at the
+			bottom left, then clears them.
+
+			@param1 a_width is the width of the target in pixels.
+
+			@param2 a_height is its height.
+	*/
+	void SpriteBatch::draw(float a_width, float a_height)
+	{
+		draw(glm::ortho(0.0f, a_width, 0.0f, a_height));
+	}
+
+	/**
+		clear throws away the sprites added since the last draw.
+	*/
+	void SpriteBatch::clear()
+	{
+		m_sprites.clear();
+		m_keys.clear();
+		m_textures.clear();
+		m_textureSlots.clear();
+		m_lastSlot = ~0u;
+	}
+}
@@ -0,0 +1,236 @@
+/**
+	SpriteBatch.h
+
+	Purpose: SpriteBatch.h is the header file for the SpriteBatch class.
+			The SpriteBatch draws the textured and tinted 2D quads
+			added to it each frame, like hud text and signs, a draw
+			per texture rather than a draw per quad.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include "StreamingBuffer.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The SpriteBatch class keeps the sprites added since the last
+			draw, each a quad of a texture's rectangle, tinted and turned
+			about its centre. draw sorts them by layer and then by
+			texture, writes them all into a StreamingBuffer as instances
+			and draws each run of one texture with an instanced draw of
+			the four corners of a quad.
+
+		Layers are drawn from 0 up, so a higher layer is always over a
+			lower one. Within a layer the sprites of one texture keep
+			the order they were added in, but those of different
+			textures are drawn a texture at a time, so sprites that
+			overlap and differ in texture belong in different layers.
+
+		addGlyph adds a sprite whose texture is a signed distance field,
+			which is drawn as the shape inside its 0.5 edge, antialiased
+			over a pixel at whatever size it is drawn, see SdfFont.
+
+		Texture 0 is a white texel, for untextured quads. Sprites are
+			blended by alpha without writing depth. The depth test is
+			left as it is, so to draw over everything turn it off
+			first, as for Gizmos::draw2D. Everything must be called on
+			the context thread.
+	*/
+	class SpriteBatch
+	{
+	public:
+		// How many layers there are.
+		static const unsigned int LAYER_COUNT = 256;
+
+		// How many sprites the stream holds until more is needed.
+		static const unsigned int DEFAULT_CAPACITY = 4096;
+
+		/**
+			Counts from the last draw.
+		*/
+		struct Stats
+		{
+			unsigned int sprites;
+			unsigned int draws;
+		};
+
+		SpriteBatch();
+
+		/**
+			The deconstructor deletes the white texture and vertex array.
+		*/
+		~SpriteBatch();
+
+		SpriteBatch(const SpriteBatch&) = delete;
+		SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+		/**
+			create loads the program and makes the white texture.
+
+				@return false without GL 4.5 or the program, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vao != 0; }
+
+		/**
+			add adds a sprite to the next draw.
+
+				@param1 a_texture is the GL handle of the texture, 0 for
+						white.
+
+				@param2 a_centre is the centre of the quad.
+
+				@param3 a_size is its width and height.
+
+				@param4 a_colour is the tint the texture is multiplied by.
+
+				@param5 a_texCoords are the texture's rectangle, the bottom
+						left in xy and the top right in zw.
+
+				@param6 a_rotation turns the quad anticlockwise about its
+						centre, in radians.
+
+				@param7 a_layer is the layer, below LAYER_COUNT.
+		*/
+		void add(unsigned int a_texture, const glm::vec2& a_centre, const glm::vec2& a_size,
+			const glm::vec4& a_colour = glm::vec4(1), const glm::vec4& a_texCoords = glm::vec4(0, 0, 1, 1),
+			float a_rotation = 0.0f, unsigned int a_layer = 0);
+
+		/**
+			addGlyph adds a sprite of a distance field, its texture's
+				median channel the distance to the edge, to the next
+				draw. It is drawn in its colour where the distance is
+				over 0.5.
+
+				@param1 a_texture is the GL handle of the distance field.
+
+				@param2 a_centre is the centre of the quad.
+
+				@param3 a_size is its width and height.
+
+				@param4 a_colour is its colour.
+
+				@param5 a_texCoords are the texture's rectangle, the bottom
+						left in xy and the top right in zw.
+
+				@param6 a_distanceRange is how many texels of the texture
+						the distance from 0 to 1 covers.
+
+				@param7 a_layer is the layer, below LAYER_COUNT.
+		*/
+		void addGlyph(unsigned int a_texture, const glm::vec2& a_centre, const glm::vec2& a_size,
+			const glm::vec4& a_colour, const glm::vec4& a_texCoords, float a_distanceRange, unsigned int a_layer = 0)
+		{
+			add(a_texture, a_centre, a_size, a_colour, a_texCoords, 0.0f, a_layer);
+			m_sprites.back().distanceRange = a_distanceRange;
+		}
+
+		/**
+			addRect adds an untextured quad.
+
+				@param1 a_centre is the centre of the quad.
+
+				@param2 a_size is its width and height.
+
+				@param3 a_colour is its colour.
+
+				@param4 a_layer is the layer, below LAYER_COUNT.
+		*/
+		void addRect(const glm::vec2& a_centre, const glm::vec2& a_size, const glm::vec4& a_colour,
+			unsigned int a_layer = 0)
+		{
+			add(0, a_centre, a_size, a_colour, glm::vec4(0, 0, 1, 1), 0.0f, a_layer);
+		}
+
+		/**
+			draw draws the sprites added since the last draw, then
+				clears them.
+
+				@param1 a_projection places them, such as an orthographic
+						projection for the screen.
+		*/
+		void draw(const glm::mat4& a_projection);
+
+		/**
+			draw draws the sprites a pixel to a unit, the origin at the
+				bottom left, then clears them.
+
+				@param1 a_width is the width of the target in pixels.
+
+				@param2 a_height is its height.
+		*/
+		void draw(float a_width, float a_height);
+
+		/**
+			clear throws away the sprites added since the last draw.
+		*/
+		void clear();
+
+		/**
+			getSpriteCount returns how many sprites have been added since
+				the last draw.
+		*/
+		unsigned int getSpriteCount() const { return (unsigned int)m_sprites.size(); }
+
+		/**
+			getStats returns the counts from the last draw.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		// A sprite as the vertex shader reads it, an instance a sprite, 48
+		//	bytes.
+		struct Sprite
+		{
+			glm::vec2 centre;
+			glm::vec2 size;
+			glm::vec4 texCoords;
+
+			// RGBA8, red in the low byte.
+			uint32_t colour;
+			float rotation;
+
+			// Above 0 for a distance field, see addGlyph.
+			float distanceRange;
+			float padding;
+		};
+
+		// The textures used since the last draw, in the order they were
+		//	first used, and each one's index in that list. The last
+		//	looked up is kept, as sprites mostly come a texture at a time.
+		std::vector<unsigned int> m_textures;
+		std::unordered_map<unsigned int, unsigned int> m_textureSlots;
+		unsigned int m_lastTexture;
+		unsigned int m_lastSlot;
+
+		// The sprites, and each one's layer in the high byte of its key
+		//	and its texture's slot in the rest.
+		std::vector<Sprite> m_sprites;
+		std::vector<uint32_t> m_keys;
+
+		// Scratch for the sort, kept so drawing doesn't allocate.
+		std::vector<uint32_t> m_order;
+		std::vector<uint32_t> m_scratchKeys;
+		std::vector<uint32_t> m_scratchOrder;
+
+		StreamingBuffer m_stream;
+		unsigned int m_vao;
+		unsigned int m_whiteTexture;
+		aie::ShaderProgram m_shader;
+
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,195 @@
+/**
+	StartupTimeline.cpp
+
+	Purpose: StartupTimeline.cpp is the source file for the StartupTimeline
+			class. The StartupTimeline records how long each phase of
+			starting up takes, on whichever thread it runs, and when each
+			mesh was asked for, imported and ready, and prints them once
+			the scene has loaded.
+
+	@author Nathan Nette
+*/
+#include "StartupTimeline.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	// What beginPhase returns while not recording.
+	static const unsigned int NO_PHASE = ~0u;
+
+	StartupTimeline& StartupTimeline::instance()
+	{
+		static StartupTimeline timeline;
+		return timeline;
+	}
+
+	StartupTimeline::StartupTimeline()
+		: m_recording(false),
+		m_start(std::chrono::steady_clock::now()),
+		m_mark(NO_PHASE),
+		m_firstFrame(-1.0)
+	{
+	}
+
+	/**
+		start starts recording, from now. The calling thread is the main
+			thread.
+	*/
+	void StartupTimeline::start()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_start = std::chrono::steady_clock::now();
+		m_phases.clear();
+		m_assets.clear();
+		m_threads.assign(1, std::this_thread::get_id());
+		m_mark = NO_PHASE;
+		m_firstFrame = -1.0;
+		m_recording = true;
+	}
+
+	/**
+		now returns the milliseconds since start.
+	*/
+	double StartupTimeline::now() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+	}
+
+	/**
+		mark ends the main thread's phase and starts the next.
+
+			@param1 a_name is the next phase's name, or nullptr to only end
+					the last.
+	*/
+	void StartupTimeline::mark(const char* a_name)
+	{
+		if (isRecording() == false)
+			return;
+
+		double time = now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_mark != NO_PHASE)
+			m_phases[m_mark].duration = time - m_phases[m_mark].start;
+		m_mark = NO_PHASE;
+
+		if (a_name != nullptr)
+		{
+			m_mark = (unsigned int)m_phases.size();
+			m_phases.push_back({ a_name, time, 0.0, 0 });
+		}
+	}
+
+	/**
+		beginPhase starts a phase on the calling thread.
+
+			@param1 a_name is its name, a string literal.
+
+			@return the phase, for endPhase, or ~0 if not recording.
+	*/
+	unsigned int StartupTimeline::beginPhase(const char* a_name)
+	{
+		if (isRecording() == false)
+			return NO_PHASE;
+
+		double time = now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_phases.push_back({ a_name, time, 0.0, getThread() });
+		return (unsigned int)m_phases.size() - 1;
+	}
+
+	/**
+		endPhase ends a phase.
+
+			@param1 a_phase is what beginPhase returned.
+	*/
+	void StartupTimeline::endPhase(unsigned int a_phase)
+	{
+		double time = now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (a_phase < m_phases.size())
+			m_phases[a_phase].duration = time - m_phases[a_phase].start;
+	}
+
+	/**
+		addAsset records an asset that has loaded.
+
+			@param1 a_name is its file.
+
+			@param2 a_requested is when it was asked for.
+
+			@param3 a_imported is when its import finished.
+
+			@param4 a_ready is when it was ready to draw.
+	*/
+	void StartupTimeline::addAsset(const std::string& a_name, double a_requested, double a_imported, double a_ready)
+	{
+		if (isRecording() == false)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_assets.push_back({ a_name, a_requested, a_imported, a_ready });
+	}
+
+	/**
+		markFirstFrame notes the first frame being presented, if it hasn't
+			been yet.
+	*/
+	void StartupTimeline::markFirstFrame()
+	{
+		if (isRecording() && hasFirstFrame() == false)
+			m_firstFrame = now();
+	}
+
+	/**
+		finish prints the timeline and stops recording.
+	*/
+	void StartupTimeline::finish()
+	{
+		if (m_recording.exchange(false) == false)
+			return;
+
+		double end = now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Phases are recorded as they start, but assets as they finish.
+		std::stable_sort(m_assets.begin(), m_assets.end(), [](const Asset& a_a, const Asset& a_b)
+		{
+			return a_a.requested < a_b.requested;
+		});
+
+		printf("Startup: first frame at %.1f ms, loaded at %.1f ms\n", m_firstFrame, end);
+		printf("  %-28s %10s %10s %7s\n", "phase", "start ms", "ms", "thread");
+		for (const Phase& phase : m_phases)
+			printf("  %-28s %10.1f %10.1f %7u\n", phase.name, phase.start, phase.duration, phase.thread);
+
+		if (m_assets.empty())
+			return;
+
+		printf("  %-40s %10s %10s %10s\n", "asset", "asked ms", "import ms", "ready ms");
+		for (const Asset& asset : m_assets)
+		{
+			// Only the file name, the folders are the same for most.
+			size_t slash = asset.name.find_last_of("/\\");
+			const char* name = asset.name.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+			printf("  %-40s %10.1f %10.1f %10.1f\n", name, asset.requested, asset.imported - asset.requested,
+				asset.ready);
+		}
+	}
+
+	/**
+		getThread returns the calling thread's number. m_mutex must be
+			locked.
+	*/
+	unsigned int StartupTimeline::getThread()
+	{
+		std::thread::id id = std::this_thread::get_id();
+		for (unsigned int i = 0; i < (unsigned int)m_threads.size(); ++i)
+		{
+			if (m_threads[i] == id)
+				return i;
+		}
+		m_threads.push_back(id);
+		return (unsigned int)m_threads.size() - 1;
+	}
+}
@@ -0,0 +1,187 @@
+/**
+	StartupTimeline.h
+
+	Purpose: StartupTimeline.h is the header file for the StartupTimeline
+			class. The StartupTimeline records how long each phase of
+			starting up takes, on whichever thread it runs, and when each
+			mesh was asked for, imported and ready, and prints them once
+			the scene has loaded.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the rest of the enclosing block as a startup phase, on any
+//	thread. It is a trace zone too.
+#define SNS_STARTUP_PHASE(name) SNS_TRACE_ZONE(name); \
+	sns::StartupPhase SNS_STARTUP_JOIN(startupPhase, __LINE__)(name)
+
+#define SNS_STARTUP_JOIN(a, b) SNS_STARTUP_JOIN_EXPAND(a, b)
+#define SNS_STARTUP_JOIN_EXPAND(a, b) a##b
+
+namespace sns
+{
+	/**
+		The StartupTimeline class records from start until finish.
+
+		The main thread's phases run one after another, each mark ending
+			the last and starting the next. Phases that run beside them,
+			on workers, are scoped with SNS_STARTUP_PHASE. Meshes loaded
+			through the AssetLoader meanwhile are recorded as assets.
+
+		markFirstFrame notes when the first frame was presented, and
+			finish prints every phase and asset in the order they
+			started, then stops recording.
+	*/
+	class StartupTimeline
+	{
+	public:
+		/**
+			One phase. Names must be string literals.
+		*/
+		struct Phase
+		{
+			const char* name;
+
+			// Milliseconds since start.
+			double start;
+			double duration;
+
+			// 0 for the main thread, then numbered as threads first
+			//	record a phase.
+			unsigned int thread;
+		};
+
+		/**
+			One loaded asset, its times in milliseconds since start.
+		*/
+		struct Asset
+		{
+			std::string name;
+			double requested;
+			double imported;
+			double ready;
+		};
+
+		static StartupTimeline& instance();
+
+		StartupTimeline(const StartupTimeline&) = delete;
+		StartupTimeline& operator=(const StartupTimeline&) = delete;
+
+		/**
+			start starts recording, from now. The calling thread is the
+				main thread.
+		*/
+		void start();
+
+		/**
+			isRecording returns whether start has been called and finish
+				hasn't.
+		*/
+		bool isRecording() const { return m_recording.load(std::memory_order_relaxed); }
+
+		/**
+			now returns the milliseconds since start.
+		*/
+		double now() const;
+
+		/**
+			mark ends the main thread's phase and starts the next.
+
+				@param1 a_name is the next phase's name, a string literal,
+						or nullptr to only end the last.
+		*/
+		void mark(const char* a_name);
+
+		/**
+			beginPhase starts a phase on the calling thread. Use
+				SNS_STARTUP_PHASE rather than calling it directly.
+
+				@param1 a_name is its name, a string literal.
+
+				@return the phase, for endPhase, or ~0 if not recording.
+		*/
+		unsigned int beginPhase(const char* a_name);
+
+		/**
+			endPhase ends a phase.
+
+				@param1 a_phase is what beginPhase returned.
+		*/
+		void endPhase(unsigned int a_phase);
+
+		/**
+			addAsset records an asset that has loaded.
+
+				@param1 a_name is its file.
+
+				@param2 a_requested is when it was asked for, from now.
+
+				@param3 a_imported is when its import finished.
+
+				@param4 a_ready is when it was ready to draw.
+		*/
+		void addAsset(const std::string& a_name, double a_requested, double a_imported, double a_ready);
+
+		/**
+			markFirstFrame notes the first frame being presented, if it
+				hasn't been yet.
+		*/
+		void markFirstFrame();
+
+		/**
+			hasFirstFrame returns whether markFirstFrame has been called.
+		*/
+		bool hasFirstFrame() const { return m_firstFrame >= 0.0; }
+
+		/**
+			finish prints the timeline and stops recording.
+		*/
+		void finish();
+
+	private:
+		StartupTimeline();
+
+		// Returns the calling thread's number. m_mutex must be locked.
+		unsigned int getThread();
+
+		std::atomic<bool> m_recording;
+		std::chrono::steady_clock::time_point m_start;
+
+		// Guards everything below.
+		std::mutex m_mutex;
+
+		std::vector<Phase> m_phases;
+		std::vector<Asset> m_assets;
+		std::vector<std::thread::id> m_threads;
+
+		// The main thread's phase, or ~0.
+		unsigned int m_mark;
+
+		double m_firstFrame;
+	};
+
+	/**
+		The StartupPhase class records a phase while it exists, see
+			SNS_STARTUP_PHASE.
+	*/
+	class StartupPhase
+	{
+	public:
+		explicit StartupPhase(const char* a_name) : m_phase(StartupTimeline::instance().beginPhase(a_name)) {}
+		~StartupPhase() { StartupTimeline::instance().endPhase(m_phase); }
+
+		StartupPhase(const StartupPhase&) = delete;
+		StartupPhase& operator=(const StartupPhase&) = delete;
+
+	private:
+		unsigned int m_phase;
+	};
+}
@@ -0,0 +1,190 @@
+/**
+	StreamingBuffer.cpp
+
+	Purpose: StreamingBuffer.cpp is the source file for the StreamingBuffer
+			class. The StreamingBuffer is a vertex buffer that is written
+			every frame without waiting for the gpu to finish reading
+			what was written the frame before.
+
+	@author Nathan Nette
+*/
+#include "StreamingBuffer.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include <chrono>
+
+namespace sns
+{
+	StreamingBuffer::Stats StreamingBuffer::s_stats = {};
+
+	/**
+		The constructor makes an empty buffer, call create before use.
+	*/
+	StreamingBuffer::StreamingBuffer()
+		: m_buffer(0),
+		m_mapped(nullptr),
+		m_region(0),
+		m_elementSize(0),
+		m_elementCount(0)
+	{
+		for (auto& fence : m_fences)
+			fence = nullptr;
+	}
+
+	/**
+		The deconstructor unmaps and deletes the buffer.
+	*/
+	StreamingBuffer::~StreamingBuffer()
+	{
+		destroy();
+	}
+
+	/**
+		create makes a buffer holding REGION_COUNT regions. Without
+			GL 4.4 it falls back to an ordinary buffer written with
+			glBufferSubData.
+
+			@param1 a_elementSize is the size of one element in bytes.
+
+			@param2 a_elementCount is how many elements fit in a region.
+
+			@param3 a_owner is who the GpuMemory counts the buffer against.
+	*/
+	void StreamingBuffer::create(unsigned int a_elementSize, unsigned int a_elementCount, const char* a_owner)
+	{
+		destroy();
+
+		m_elementSize = a_elementSize;
+		m_elementCount = a_elementCount;
+		GLsizeiptr size = (GLsizeiptr)a_elementSize * a_elementCount * REGION_COUNT;
+
+		glGenBuffers(1, &m_buffer);
+		RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+		if (ogl_IsVersionGEQ(4, 4))
+		{
+			// Coherent, so writes are seen by the gpu without flushing.
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+			m_mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+		}
+
+		if (m_mapped == nullptr)
+		{
+			glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			m_staging.resize((size_t)a_elementSize * a_elementCount);
+		}
+
+		RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+		GpuMemory::instance().trackBuffer(m_buffer, size, GpuMemory::STREAMING, a_owner);
+	}
+
+	/**
+		destroy unmaps and deletes the buffer and its fences.
+	*/
+	void StreamingBuffer::destroy()
+	{
+		for (auto& fence : m_fences)
+		{
+			if (fence != nullptr)
+				glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		if (m_mapped != nullptr)
+		{
+			RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+			m_mapped = nullptr;
+		}
+
+		glDeleteBuffers(1, &m_buffer);
+		RenderState::instance().onBufferDeleted(m_buffer);
+		GpuMemory::instance().releaseBuffer(m_buffer);
+		m_buffer = 0;
+		m_staging.clear();
+		m_region = 0;
+	}
+
+	/**
+		beginWrite waits until the gpu is done with the next region.
+
+			@return where to write up to getElementCount elements.
+	*/
+	void* StreamingBuffer::beginWrite()
+	{
+		++s_stats.writes;
+
+		GLsync& fence = m_fences[m_region];
+		if (fence != nullptr)
+		{
+			// Usually the fence passed a couple of frames ago, so check
+			//	without waiting first and only count it if we have to block.
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				++s_stats.stalls;
+				auto start = std::chrono::high_resolution_clock::now();
+				do
+				{
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				} while (result == GL_TIMEOUT_EXPIRED);
+				s_stats.stallMilliseconds += std::chrono::duration<double, std::milli>(
+					std::chrono::high_resolution_clock::now() - start).count();
+			}
+
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		if (m_mapped != nullptr)
+			return m_mapped + (size_t)m_region * m_elementSize * m_elementCount;
+		return m_staging.data();
+	}
+
+	/**
+		endWrite finishes writing the region.
+
+			@param1 a_elementCount is how many elements were written.
+
+			@return the index of the first element in the buffer, to
+					pass as the first vertex or base instance.
+	*/
+	unsigned int StreamingBuffer::endWrite(unsigned int a_elementCount)
+	{
+		unsigned int first = m_region * m_elementCount;
+
+		if (m_mapped == nullptr && a_elementCount > 0)
+		{
+			RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)first * m_elementSize,
+				(GLsizeiptr)a_elementCount * m_elementSize, m_staging.data());
+			RenderState::instance().bindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		return first;
+	}
+
+	/**
+		fence marks the region as in use by the draws issued since
+			endWrite and moves on to the next one.
+	*/
+	void StreamingBuffer::fence()
+	{
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_region = (m_region + 1) % REGION_COUNT;
+	}
+
+	/**
+		refence moves the fence of the region last fenced after the draws
+			issued since, for a region more than one pass reads.
+	*/
+	void StreamingBuffer::refence()
+	{
+		GLsync& fence = m_fences[(m_region + REGION_COUNT - 1) % REGION_COUNT];
+		if (fence != nullptr)
+			glDeleteSync(fence);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
@@ -0,0 +1,151 @@
+/**
+	StreamingBuffer.h
+
+	Purpose: StreamingBuffer.h is the header file for the StreamingBuffer
+			class. The StreamingBuffer is a vertex buffer that is written
+			every frame without waiting for the gpu to finish reading
+			what was written the frame before.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "gl_core_4_5.h"
+#include <vector>
+
+namespace sns
+{
+	/**
+		The StreamingBuffer class splits one persistently mapped buffer
+			into regions and writes each frame into the next one. A fence
+			is placed after the draws that read a region, and the region
+			is only written again once that fence has passed.
+
+		Every frame goes beginWrite, endWrite, the draws, then fence.
+	*/
+	class StreamingBuffer
+	{
+	public:
+		// How many frames can be in flight before a write has to wait.
+		static const unsigned int REGION_COUNT = 3;
+
+		/**
+			Counts across every streaming buffer since the last resetStats.
+		*/
+		struct Stats
+		{
+			// Regions handed out by beginWrite.
+			unsigned int writes;
+
+			// Writes that had to wait for the gpu to finish with a region.
+			unsigned int stalls;
+
+			// Time spent waiting in those stalls.
+			double stallMilliseconds;
+		};
+
+		/**
+			The constructor makes an empty buffer, call create before use.
+		*/
+		StreamingBuffer();
+
+		/**
+			The deconstructor unmaps and deletes the buffer.
+		*/
+		~StreamingBuffer();
+
+		/**
+			create makes a buffer holding REGION_COUNT regions. Without
+				GL 4.4 it falls back to an ordinary buffer written with
+				glBufferSubData.
+
+				@param1 a_elementSize is the size of one element in bytes.
+
+				@param2 a_elementCount is how many elements fit in a region.
+
+				@param3 a_owner is who the GpuMemory counts the buffer
+						against, a string literal.
+		*/
+		void create(unsigned int a_elementSize, unsigned int a_elementCount, const char* a_owner = "StreamingBuffer");
+
+		/**
+			destroy unmaps and deletes the buffer and its fences.
+		*/
+		void destroy();
+
+		/**
+			beginWrite waits until the gpu is done with the next region.
+
+				@return where to write up to getElementCount elements.
+		*/
+		void* beginWrite();
+
+		/**
+			endWrite finishes writing the region.
+
+				@param1 a_elementCount is how many elements were written.
+
+				@return the index of the first element in the buffer, to
+						pass as the first vertex or base instance.
+		*/
+		unsigned int endWrite(unsigned int a_elementCount);
+
+		/**
+			fence marks the region as in use by the draws issued since
+				endWrite and moves on to the next one.
+		*/
+		void fence();
+
+		/**
+			refence moves the fence of the region last fenced after the
+				draws issued since, for a region more than one pass reads.
+		*/
+		void refence();
+
+		/**
+			getHandle returns the opengl buffer to bind as a vertex buffer.
+		*/
+		unsigned int getHandle() const { return m_buffer; }
+
+		/**
+			getElementCount returns how many elements fit in a region.
+		*/
+		unsigned int getElementCount() const { return m_elementCount; }
+
+		/**
+			isPersistent returns false if the buffer fell back to
+				glBufferSubData.
+		*/
+		bool isPersistent() const { return m_mapped != nullptr; }
+
+		/**
+			getStats returns the counts since the last resetStats.
+		*/
+		static const Stats& getStats() { return s_stats; }
+
+		/**
+			resetStats sets every count back to 0.
+		*/
+		static void resetStats() { s_stats = {}; }
+
+	private:
+		// The opengl buffer holding every region.
+		unsigned int m_buffer;
+
+		// The persistent mapping of the whole buffer.
+		char* m_mapped;
+
+		// Holds the writes until endWrite without GL 4.4.
+		std::vector<char> m_staging;
+
+		// The fence placed after the last draw of each region.
+		GLsync m_fences[REGION_COUNT];
+
+		// The region being written.
+		unsigned int m_region;
+
+		unsigned int m_elementSize;
+		unsigned int m_elementCount;
+
+		static Stats s_stats;
+	};
+}
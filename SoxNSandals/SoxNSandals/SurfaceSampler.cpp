@@ -0,0 +1,147 @@
+/**
+	SurfaceSampler.cpp
+
+	Purpose: SurfaceSampler.cpp is the source file for the SurfaceSampler
+			class. The SurfaceSampler picks points spread evenly over a
+			mesh's surface, for particles to spawn from.
+
+	@author Nathan Nette
+*/
+#include "SurfaceSampler.h"
+#include "GpuMemory.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace sns
+{
+	SurfaceSampler::SurfaceSampler()
+		: m_area(0),
+		m_min(FLT_MAX),
+		m_max(-FLT_MAX)
+	{
+	}
+
+	/**
+		addTriangle adds a triangle to be built into the table. Until
+			build, a's w holds the triangle's area.
+
+			@param1 a_a is its first corner.
+
+			@param2 a_b is its second corner.
+
+			@param3 a_c is its third.
+	*/
+	void SurfaceSampler::addTriangle(const glm::vec3& a_a, const glm::vec3& a_b, const glm::vec3& a_c)
+	{
+		glm::vec3 cross = glm::cross(a_b - a_a, a_c - a_a);
+		float doubleArea = glm::length(cross);
+		if (doubleArea <= 0.0f)
+			return;
+
+		m_triangles.push_back({ glm::vec4(a_a, doubleArea * 0.5f), glm::vec4(a_b, 0), glm::vec4(a_c, 0),
+			glm::vec4(cross / doubleArea, 0) });
+		m_min = glm::min(m_min, glm::min(a_a, glm::min(a_b, a_c)));
+		m_max = glm::max(m_max, glm::max(a_a, glm::max(a_b, a_c)));
+	}
+
+	/**
+		build builds the alias table with Vose's method. Each triangle's
+			area is scaled so the average is 1, then every column under
+			1 is filled up to it from one over, which is left with less
+			and goes back on the list it now belongs to. Doubles keep
+			the running areas from drifting over many triangles.
+	*/
+	void SurfaceSampler::build()
+	{
+		unsigned int count = (unsigned int)m_triangles.size();
+		double total = 0.0;
+		for (const Triangle& triangle : m_triangles)
+			total += triangle.a.w;
+		m_area = (float)total;
+		if (count == 0)
+			return;
+
+		std::vector<double> scaled(count);
+		std::vector<unsigned int> small;
+		std::vector<unsigned int> large;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			scaled[i] = m_triangles[i].a.w * count / total;
+			(scaled[i] < 1.0 ? small : large).push_back(i);
+		}
+
+		while (small.empty() == false && large.empty() == false)
+		{
+			unsigned int less = small.back();
+			small.pop_back();
+			unsigned int more = large.back();
+
+			m_triangles[less].a.w = (float)scaled[less];
+			m_triangles[less].b.w = (float)more;
+			scaled[more] -= 1.0 - scaled[less];
+			if (scaled[more] < 1.0)
+			{
+				large.pop_back();
+				small.push_back(more);
+			}
+		}
+
+		// What is left is 1 but for rounding, and always kept.
+		small.insert(small.end(), large.begin(), large.end());
+		for (unsigned int i : small)
+		{
+			m_triangles[i].a.w = 1.0f;
+			m_triangles[i].b.w = (float)i;
+		}
+	}
+
+	/**
+		upload copies the triangles into a buffer for the compute shader,
+			once built.
+
+			@return false without GL 4.5 or any triangles.
+	*/
+	bool SurfaceSampler::upload()
+	{
+		m_buffer.reset();
+		if (ogl_IsVersionGEQ(4, 5) == 0 || m_triangles.empty())
+			return false;
+
+		unsigned long long bytes = (unsigned long long)m_triangles.size() * sizeof(Triangle);
+		glCreateBuffers(1, m_buffer.put());
+		glNamedBufferStorage(m_buffer, bytes, m_triangles.data(), 0);
+		GpuMemory::instance().trackBuffer(m_buffer, bytes, GpuMemory::PARTICLES, "SurfaceSampler");
+		return true;
+	}
+
+	/**
+		sample picks a point from four random numbers, each from 0 to 1.
+			The square root spreads the point evenly over the triangle,
+			rather than bunched at its first corner.
+
+			@param1 a_column picks the column of the table.
+
+			@param2 a_coin picks between it and its alias.
+
+			@param3 a_u and a_v pick the point on the triangle.
+	*/
+	SurfaceSampler::Sample SurfaceSampler::sample(float a_column, float a_coin, float a_u, float a_v) const
+	{
+		if (m_triangles.empty())
+			return { glm::vec3(0), glm::vec3(0, 1, 0) };
+
+		unsigned int count = (unsigned int)m_triangles.size();
+		unsigned int column = std::min((unsigned int)(a_column * count), count - 1);
+		const Triangle& kept = m_triangles[column];
+		const Triangle& triangle = a_coin < kept.a.w ? kept : m_triangles[(unsigned int)kept.b.w];
+
+		float root = std::sqrt(a_u);
+		float b = root * (1.0f - a_v);
+		float c = root * a_v;
+		glm::vec3 position = glm::vec3(triangle.a) * (1.0f - root) + glm::vec3(triangle.b) * b +
+			glm::vec3(triangle.c) * c;
+		return { position, glm::vec3(triangle.normal) };
+	}
+}
@@ -0,0 +1,128 @@
+/**
+	SurfaceSampler.h
+
+	Purpose: SurfaceSampler.h is the header file for the SurfaceSampler
+			class. The SurfaceSampler picks points spread evenly over a
+			mesh's surface, for particles to spawn from.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The SurfaceSampler class picks a triangle with a chance as big as
+			its share of the surface, then a point spread evenly over
+			it. The triangles are picked from an alias table, built once
+			in linear time, so every pick costs the same however many
+			triangles there are: a column is picked at random, and kept
+			or swapped for its alias by one more random number.
+
+		Each triangle is stored with its column of the table, as the
+			compute shader reads them, so the cpu and the gpu sample
+			the same table from the same array. Once built it is never
+			changed, and can be sampled from any number of threads.
+	*/
+	class SurfaceSampler
+	{
+	public:
+		/**
+			A triangle and its column of the alias table. a's w is the
+				chance the column keeps this triangle, b's w the
+				triangle it is swapped for otherwise, as a float.
+		*/
+		struct Triangle
+		{
+			glm::vec4 a;
+			glm::vec4 b;
+			glm::vec4 c;
+
+			// The face's normal, w unused.
+			glm::vec4 normal;
+		};
+
+		/**
+			A point on the surface.
+		*/
+		struct Sample
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+		};
+
+		SurfaceSampler();
+
+		SurfaceSampler(const SurfaceSampler&) = delete;
+		SurfaceSampler& operator=(const SurfaceSampler&) = delete;
+
+		/**
+			addTriangle adds a triangle to be built into the table.
+				Triangles with no area are left out.
+
+				@param1 a_a is its first corner.
+
+				@param2 a_b is its second corner.
+
+				@param3 a_c is its third, wound counter-clockwise from
+						the side the normal faces.
+		*/
+		void addTriangle(const glm::vec3& a_a, const glm::vec3& a_b, const glm::vec3& a_c);
+
+		/**
+			build builds the alias table over the triangles added.
+		*/
+		void build();
+
+		/**
+			upload copies the triangles into a buffer for the compute
+				shader, once built.
+
+				@return false without GL 4.5 or any triangles.
+		*/
+		bool upload();
+
+		/**
+			sample picks a point from four random numbers, each from 0
+				to 1.
+
+				@param1 a_column picks the column of the table.
+
+				@param2 a_coin picks between it and its alias.
+
+				@param3 a_u and a_v pick the point on the triangle.
+		*/
+		Sample sample(float a_column, float a_coin, float a_u, float a_v) const;
+
+		/**
+			getTriangleCount returns how many triangles the table is over.
+		*/
+		unsigned int getTriangleCount() const { return (unsigned int)m_triangles.size(); }
+
+		/**
+			getArea returns the area of the surface.
+		*/
+		float getArea() const { return m_area; }
+
+		/**
+			getMin and getMax return the box the surface is in.
+		*/
+		const glm::vec3& getMin() const { return m_min; }
+		const glm::vec3& getMax() const { return m_max; }
+
+		/**
+			getBuffer returns the buffer of triangles, 0 before upload.
+		*/
+		unsigned int getBuffer() const { return m_buffer; }
+
+	private:
+		std::vector<Triangle> m_triangles;
+		float m_area;
+		glm::vec3 m_min;
+		glm::vec3 m_max;
+		BufferHandle m_buffer;
+	};
+}
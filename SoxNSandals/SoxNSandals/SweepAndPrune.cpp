@@ -0,0 +1,341 @@
+/**
+	SweepAndPrune.cpp
+
+	Purpose: SweepAndPrune.cpp is the source file for the SweepAndPrune
+			class. The SweepAndPrune finds every pair of boxes that
+			overlap, the broadphase of collision, so a narrowphase only
+			tests the few pairs that might touch.
+
+	@author Nathan Nette
+*/
+#include "SweepAndPrune.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define SNS_SWEEP_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace sns
+{
+	// Another axis must spread the centres this much more than the one
+	//	swept along before it is changed to, so boxes spread about
+	//	evenly don't sort from scratch every frame.
+	static const double AXIS_HYSTERESIS = 1.2;
+
+	// More boxes inserted than this share of those already sorted are
+	//	sorted from scratch rather than moved into place one by one.
+	static const unsigned int INSERTED_SHARE = 4;
+
+	// Boxes read past the end of the sorted arrays.
+	static const unsigned int PADDING = 4;
+
+	SweepAndPrune::SweepAndPrune()
+		: m_boxCount(0),
+		m_axis(0)
+	{
+	}
+
+	/**
+		clear removes every box.
+	*/
+	void SweepAndPrune::clear()
+	{
+		for (unsigned int axis = 0; axis < 3; ++axis)
+		{
+			m_min[axis].clear();
+			m_max[axis].clear();
+		}
+		m_users.clear();
+		m_alive.clear();
+		m_freeHandles.clear();
+		m_removed.clear();
+		m_order.clear();
+		m_inserted.clear();
+		m_pairs.clear();
+		m_boxCount = 0;
+	}
+
+	/**
+		insert adds a box.
+
+			@param1 a_min is its lower corner.
+
+			@param2 a_max is its upper corner.
+
+			@param3 a_user is what pairs name it by.
+
+			@return its handle.
+	*/
+	SweepAndPrune::Handle SweepAndPrune::insert(const glm::vec3& a_min, const glm::vec3& a_max, uint32_t a_user)
+	{
+		Handle handle;
+		if (m_freeHandles.empty() == false)
+		{
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+		}
+		else
+		{
+			handle = (Handle)m_users.size();
+			for (unsigned int axis = 0; axis < 3; ++axis)
+			{
+				m_min[axis].emplace_back();
+				m_max[axis].emplace_back();
+			}
+			m_users.emplace_back();
+			m_alive.emplace_back();
+		}
+
+		move(handle, a_min, a_max);
+		m_users[handle] = a_user;
+		m_alive[handle] = 1;
+		m_inserted.push_back(handle);
+		++m_boxCount;
+		return handle;
+	}
+
+	/**
+		remove takes a box out. Its handle may be given to an insert after
+			the next update, which drops it from the order.
+
+			@param1 a_handle is the box.
+	*/
+	void SweepAndPrune::remove(Handle a_handle)
+	{
+		if (a_handle >= m_alive.size() || m_alive[a_handle] == 0)
+			return;
+
+		m_alive[a_handle] = 0;
+		m_removed.push_back(a_handle);
+		--m_boxCount;
+	}
+
+	/**
+		move changes a box. Different boxes can be moved at once from
+			different threads.
+
+			@param1 a_handle is the box.
+
+			@param2 a_min is its new lower corner.
+
+			@param3 a_max is its new upper corner.
+	*/
+	void SweepAndPrune::move(Handle a_handle, const glm::vec3& a_min, const glm::vec3& a_max)
+	{
+		for (unsigned int axis = 0; axis < 3; ++axis)
+		{
+			m_min[axis][a_handle] = a_min[axis];
+			m_max[axis][a_handle] = a_max[axis];
+		}
+	}
+
+	/**
+		update sorts the boxes again and finds every overlapping pair,
+			sweeping on the job system when there are more boxes than a
+			job sweeps.
+
+			@return how many pairs were found.
+	*/
+	unsigned int SweepAndPrune::update()
+	{
+		SNS_PROFILE_SCOPE("SweepAndPrune::update");
+
+		auto isRemoved = [this](Handle a_handle) { return m_alive[a_handle] == 0; };
+		m_order.erase(std::remove_if(m_order.begin(), m_order.end(), isRemoved), m_order.end());
+		m_inserted.erase(std::remove_if(m_inserted.begin(), m_inserted.end(), isRemoved), m_inserted.end());
+		m_freeHandles.insert(m_freeHandles.end(), m_removed.begin(), m_removed.end());
+		m_removed.clear();
+
+		unsigned int axis = findAxis();
+		bool fromScratch = axis != m_axis || m_inserted.size() * INSERTED_SHARE > m_order.size();
+		m_order.insert(m_order.end(), m_inserted.begin(), m_inserted.end());
+		m_inserted.clear();
+		m_axis = axis;
+		sort(fromScratch);
+
+		m_pairs.clear();
+		unsigned int count = (unsigned int)m_order.size();
+		if (count <= JOB_BOXES)
+		{
+			sweep(0, count, m_pairs);
+			return (unsigned int)m_pairs.size();
+		}
+
+		JobSystem& jobs = JobSystem::instance();
+		JobCounter counter;
+		unsigned int jobCount = (count + JOB_BOXES - 1) / JOB_BOXES;
+		if (m_jobPairs.size() < jobCount)
+			m_jobPairs.resize(jobCount);
+		for (unsigned int job = 0; job < jobCount; ++job)
+		{
+			unsigned int first = job * JOB_BOXES;
+			unsigned int last = std::min(first + JOB_BOXES, count);
+			std::vector<Pair>* pairs = &m_jobPairs[job];
+			jobs.run([this, first, last, pairs]()
+			{
+				pairs->clear();
+				sweep(first, last, *pairs);
+			}, &counter);
+		}
+		jobs.wait(counter);
+
+		for (unsigned int job = 0; job < jobCount; ++job)
+			m_pairs.insert(m_pairs.end(), m_jobPairs[job].begin(), m_jobPairs[job].end());
+		return (unsigned int)m_pairs.size();
+	}
+
+	/**
+		findAxis finds the axis the live boxes' centres are most spread
+			along, keeping the one swept last unless another is clearly
+			better.
+
+			@return the axis.
+	*/
+	unsigned int SweepAndPrune::findAxis() const
+	{
+		double sum[3] = {};
+		double squares[3] = {};
+		unsigned int count = 0;
+		for (Handle handle = 0; handle < (Handle)m_alive.size(); ++handle)
+		{
+			if (m_alive[handle] == 0)
+				continue;
+			for (unsigned int axis = 0; axis < 3; ++axis)
+			{
+				double centre = 0.5 * ((double)m_min[axis][handle] + m_max[axis][handle]);
+				sum[axis] += centre;
+				squares[axis] += centre * centre;
+			}
+			++count;
+		}
+		if (count == 0)
+			return m_axis;
+
+		double variance[3];
+		for (unsigned int axis = 0; axis < 3; ++axis)
+			variance[axis] = squares[axis] / count - (sum[axis] / count) * (sum[axis] / count);
+
+		unsigned int best = m_axis;
+		for (unsigned int axis = 0; axis < 3; ++axis)
+		{
+			if (variance[axis] > variance[best] && variance[axis] > variance[m_axis] * AXIS_HYSTERESIS)
+				best = axis;
+		}
+		return best;
+	}
+
+	/**
+		sort sorts the order by the axis' lower sides and copies the boxes
+			into it, the swept axis first and the other two after.
+
+			@param1 a_fromScratch is whether to sort the whole order, rather
+					than move each box back into place from where it was.
+	*/
+	void SweepAndPrune::sort(bool a_fromScratch)
+	{
+		const std::vector<float>& key = m_min[m_axis];
+		if (a_fromScratch)
+		{
+			std::sort(m_order.begin(), m_order.end(),
+				[&key](Handle a_a, Handle a_b) { return key[a_a] < key[a_b]; });
+		}
+		else
+		{
+			for (size_t i = 1; i < m_order.size(); ++i)
+			{
+				Handle handle = m_order[i];
+				float value = key[handle];
+				size_t j = i;
+				for (; j > 0 && key[m_order[j - 1]] > value; --j)
+					m_order[j] = m_order[j - 1];
+				m_order[j] = handle;
+			}
+		}
+
+		size_t count = m_order.size();
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			unsigned int axis = (m_axis + i) % 3;
+			m_sortedMin[i].resize(count + PADDING);
+			m_sortedMax[i].resize(count + PADDING);
+			for (size_t j = 0; j < count; ++j)
+			{
+				m_sortedMin[i][j] = m_min[axis][m_order[j]];
+				m_sortedMax[i][j] = m_max[axis][m_order[j]];
+			}
+
+			// Starting after everything, the padding never overlaps.
+			std::fill(m_sortedMin[i].begin() + count, m_sortedMin[i].end(), FLT_MAX);
+			std::fill(m_sortedMax[i].begin() + count, m_sortedMax[i].end(), -FLT_MAX);
+		}
+		m_sortedUsers.resize(count);
+		for (size_t j = 0; j < count; ++j)
+			m_sortedUsers[j] = m_users[m_order[j]];
+	}
+
+	/**
+		sweep tests each of a run of the sorted boxes against those after
+			it, until one starts past its end along the axis. Those
+			after start no earlier than it, so only the other two axes
+			are tested for overlap.
+
+			@param1 a_first is the first box of the run.
+
+			@param2 a_last is the box after the run.
+
+			@param3 a_pairs has the overlapping pairs added.
+	*/
+	void SweepAndPrune::sweep(unsigned int a_first, unsigned int a_last, std::vector<Pair>& a_pairs) const
+	{
+		const float* minA = m_sortedMin[0].data();
+		const float* minB = m_sortedMin[1].data();
+		const float* maxB = m_sortedMax[1].data();
+		const float* minC = m_sortedMin[2].data();
+		const float* maxC = m_sortedMax[2].data();
+		for (unsigned int i = a_first; i < a_last; ++i)
+		{
+#ifdef SNS_SWEEP_SSE
+			__m128 endA = _mm_set1_ps(m_sortedMax[0][i]);
+			__m128 lowB = _mm_set1_ps(minB[i]);
+			__m128 highB = _mm_set1_ps(maxB[i]);
+			__m128 lowC = _mm_set1_ps(minC[i]);
+			__m128 highC = _mm_set1_ps(maxC[i]);
+
+			// The padding starts past every end, so a run of four always
+			//	stops by the end of the arrays.
+			for (unsigned int j = i + 1;; j += 4)
+			{
+				__m128 started = _mm_cmple_ps(_mm_loadu_ps(minA + j), endA);
+				int startedMask = _mm_movemask_ps(started);
+				if (startedMask == 0)
+					break;
+
+				__m128 overlapB = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minB + j), highB),
+					_mm_cmpge_ps(_mm_loadu_ps(maxB + j), lowB));
+				__m128 overlapC = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minC + j), highC),
+					_mm_cmpge_ps(_mm_loadu_ps(maxC + j), lowC));
+				int overlaps = _mm_movemask_ps(_mm_and_ps(started, _mm_and_ps(overlapB, overlapC)));
+				for (unsigned int lane = 0; overlaps != 0; ++lane, overlaps >>= 1)
+				{
+					if ((overlaps & 1) != 0)
+						a_pairs.push_back({ m_sortedUsers[i], m_sortedUsers[j + lane] });
+				}
+
+				if (startedMask != 0xf)
+					break;
+			}
+#else
+			float endA = m_sortedMax[0][i];
+			for (unsigned int j = i + 1; minA[j] <= endA; ++j)
+			{
+				if (minB[j] <= maxB[i] && maxB[j] >= minB[i] && minC[j] <= maxC[i] && maxC[j] >= minC[i])
+					a_pairs.push_back({ m_sortedUsers[i], m_sortedUsers[j] });
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,165 @@
+/**
+	SweepAndPrune.h
+
+	Purpose: SweepAndPrune.h is the header file for the SweepAndPrune
+			class. The SweepAndPrune finds every pair of boxes that
+			overlap, the broadphase of collision, so a narrowphase only
+			tests the few pairs that might touch.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The SweepAndPrune class keeps boxes sorted by their lower side
+			along one axis. Sweeping along it, each box only has to be
+			tested against those after it that start before it ends,
+			the rest are pruned without a test.
+
+		The axis is the one the boxes' centres are most spread along,
+			picked again each update. Boxes move little between frames,
+			so the order is kept and fixed with an insertion sort,
+			which is about linear on a list that is nearly sorted. Only
+			a change of axis sorts from scratch.
+
+		The boxes are kept as separate arrays of each side, and copied in
+			sorted order before the sweep, so the boxes after one are
+			tested four at a time with SSE. The sweep is split into
+			runs of boxes, each swept by a job into its own list, and
+			the lists are joined in order, so the pairs come out the
+			same whatever thread ran what.
+
+		Like the LooseOctree, moving a box only writes that box, so boxes
+			can be moved from many jobs at once, and update sees them
+			all.
+	*/
+	class SweepAndPrune
+	{
+	public:
+		typedef uint32_t Handle;
+		static const Handle NO_HANDLE = 0xffffffff;
+
+		// How many boxes one job sweeps along.
+		static const unsigned int JOB_BOXES = 2048;
+
+		/**
+			Two overlapping boxes, by their user values, the first
+				sorted before the second along the axis.
+		*/
+		struct Pair
+		{
+			uint32_t first;
+			uint32_t second;
+		};
+
+		SweepAndPrune();
+
+		SweepAndPrune(const SweepAndPrune&) = delete;
+		SweepAndPrune& operator=(const SweepAndPrune&) = delete;
+
+		/**
+			clear removes every box.
+		*/
+		void clear();
+
+		/**
+			insert adds a box.
+
+				@param1 a_min is its lower corner.
+
+				@param2 a_max is its upper corner.
+
+				@param3 a_user is what pairs name it by.
+
+				@return its handle.
+		*/
+		Handle insert(const glm::vec3& a_min, const glm::vec3& a_max, uint32_t a_user);
+
+		/**
+			remove takes a box out. Its handle may be given to an insert
+				after the next update.
+
+				@param1 a_handle is the box.
+		*/
+		void remove(Handle a_handle);
+
+		/**
+			move changes a box. Different boxes can be moved at once from
+				different threads.
+
+				@param1 a_handle is the box.
+
+				@param2 a_min is its new lower corner.
+
+				@param3 a_max is its new upper corner.
+		*/
+		void move(Handle a_handle, const glm::vec3& a_min, const glm::vec3& a_max);
+
+		/**
+			update sorts the boxes again and finds every overlapping pair,
+				sweeping on the job system when there are more boxes than
+				a job sweeps.
+
+				@return how many pairs were found.
+		*/
+		unsigned int update();
+
+		/**
+			getPairs returns the pairs the last update found.
+		*/
+		const std::vector<Pair>& getPairs() const { return m_pairs; }
+
+		/**
+			getBoxCount returns how many boxes there are.
+		*/
+		unsigned int getBoxCount() const { return m_boxCount; }
+
+		/**
+			getAxis returns the axis the last update swept along, 0 to 2.
+		*/
+		unsigned int getAxis() const { return m_axis; }
+
+	private:
+		// Finds the axis the centres are most spread along.
+		unsigned int findAxis() const;
+
+		// Sorts the order by the axis' lower sides and copies the boxes
+		//	into it.
+		void sort(bool a_fromScratch);
+
+		// Sweeps a run of the sorted boxes, adding their pairs to a list.
+		void sweep(unsigned int a_first, unsigned int a_last, std::vector<Pair>& a_pairs) const;
+
+		// Each box's sides, by handle, and whether it is still in. The
+		//	handles removed since the last update are only freed once
+		//	it has dropped them from the order.
+		std::vector<float> m_min[3];
+		std::vector<float> m_max[3];
+		std::vector<uint32_t> m_users;
+		std::vector<uint8_t> m_alive;
+		std::vector<Handle> m_freeHandles;
+		std::vector<Handle> m_removed;
+		unsigned int m_boxCount;
+
+		// Every live box by its lower side along the axis, and the boxes
+		//	inserted since the last update.
+		std::vector<Handle> m_order;
+		std::vector<Handle> m_inserted;
+		unsigned int m_axis;
+
+		// The boxes copied in order, the swept axis first, each array
+		//	padded with boxes that overlap nothing so four can always be
+		//	read.
+		std::vector<float> m_sortedMin[3];
+		std::vector<float> m_sortedMax[3];
+		std::vector<uint32_t> m_sortedUsers;
+
+		std::vector<std::vector<Pair>> m_jobPairs;
+		std::vector<Pair> m_pairs;
+	};
+}
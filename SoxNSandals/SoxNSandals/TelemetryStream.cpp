@@ -0,0 +1,557 @@
+/**
+	TelemetryStream.cpp
+
+	Purpose: TelemetryStream.cpp is the source file for the
+			TelemetryStream class. The TelemetryStream sends what the
+			Profiler recorded of each frame, with the gpu memory the
+			engine has allocated, over a socket to a collector, so
+			machines nobody is watching can be watched from somewhere
+			else.
+
+	@author Nathan Nette
+*/
+#include "TelemetryStream.h"
+#include "GpuMemory.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace sns
+{
+#ifdef _WIN32
+	static const intptr_t NO_SOCKET = (intptr_t)INVALID_SOCKET;
+	static const int SEND_FLAGS = 0;
+#else
+	static const intptr_t NO_SOCKET = -1;
+
+	// A collector going away shouldn't raise SIGPIPE.
+	static const int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+	// How long a connection is waited for, and how long a send may block
+	//	before the collector is given up on.
+	static const int CONNECT_TIMEOUT_MILLISECONDS = 2000;
+	static const int SEND_TIMEOUT_MILLISECONDS = 2000;
+
+	// How long to wait after failing to connect, doubling each time up to
+	//	the most.
+	static const unsigned int RETRY_MILLISECONDS = 1000;
+	static const unsigned int MAX_RETRY_MILLISECONDS = 30000;
+
+	static const char MAGIC[] = { 'S', 'N', 'S', 'T' };
+
+	/**
+		writeVarint appends an unsigned number as a LEB128 varint, seven
+			bits a byte with the top bit set on every byte but the last.
+
+			@param1 a_output is what it is appended to.
+
+			@param2 a_value is the number.
+	*/
+	static void writeVarint(std::vector<unsigned char>& a_output, unsigned long long a_value)
+	{
+		while (a_value >= 0x80)
+		{
+			a_output.push_back((unsigned char)(a_value | 0x80));
+			a_value >>= 7;
+		}
+		a_output.push_back((unsigned char)a_value);
+	}
+
+	/**
+		writeFloat appends a number as a little endian 32 bit float.
+
+			@param1 a_output is what it is appended to.
+
+			@param2 a_value is the number.
+	*/
+	static void writeFloat(std::vector<unsigned char>& a_output, double a_value)
+	{
+		float value = (float)a_value;
+		unsigned int bits = 0;
+		memcpy(&bits, &value, sizeof(bits));
+		for (int i = 0; i < 4; ++i)
+			a_output.push_back((unsigned char)(bits >> (i * 8)));
+	}
+
+	/**
+		writeString appends a string as its varint length and its bytes.
+
+			@param1 a_output is what it is appended to.
+
+			@param2 a_value is the string.
+	*/
+	static void writeString(std::vector<unsigned char>& a_output, const std::string& a_value)
+	{
+		writeVarint(a_output, a_value.size());
+		a_output.insert(a_output.end(), a_value.begin(), a_value.end());
+	}
+
+	/**
+		closeSocket closes a socket.
+
+			@param1 a_socket is the socket.
+	*/
+	static void closeSocket(intptr_t a_socket)
+	{
+#ifdef _WIN32
+		closesocket((SOCKET)a_socket);
+#else
+		close((int)a_socket);
+#endif
+	}
+
+	/**
+		setBlocking makes a socket's calls wait or return at once.
+
+			@param1 a_socket is the socket.
+
+			@param2 a_blocking is whether they wait.
+	*/
+	static void setBlocking(intptr_t a_socket, bool a_blocking)
+	{
+#ifdef _WIN32
+		u_long nonBlocking = a_blocking ? 0 : 1;
+		ioctlsocket((SOCKET)a_socket, FIONBIO, &nonBlocking);
+#else
+		int flags = fcntl((int)a_socket, F_GETFL, 0);
+		fcntl((int)a_socket, F_SETFL, a_blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+#endif
+	}
+
+	TelemetryStream::TelemetryStream()
+		: m_socket(NO_SOCKET),
+		m_lastFrame(0),
+		m_namesSent(0),
+		m_queuedBytes(0),
+		m_unreportedDrops(0),
+		m_stopping(false),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor sends what it can and disconnects, see destroy.
+	*/
+	TelemetryStream::~TelemetryStream()
+	{
+		destroy();
+	}
+
+	/**
+		create starts the thread that connects to the collector, and turns
+			the Profiler on, as nothing is recorded to send without it.
+
+			@param1 a_address is the collector's "host:port".
+
+			@return false if the address has no port.
+	*/
+	bool TelemetryStream::create(const char* a_address)
+	{
+		destroy();
+		const char* colon = strrchr(a_address, ':');
+		if (colon == nullptr || colon == a_address || colon[1] == '\0')
+		{
+			printf("TelemetryStream: %s isn't a host:port.\n", a_address);
+			return false;
+		}
+		m_host.assign(a_address, colon);
+		m_port = colon + 1;
+
+#ifdef _WIN32
+		WSADATA data;
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+		{
+			printf("TelemetryStream: Winsock couldn't be started.\n");
+			return false;
+		}
+#endif
+
+		Profiler::setEnabled(true);
+		m_stopping = false;
+		m_stats = {};
+		m_thread = std::thread(&TelemetryStream::run, this);
+		printf("Streaming telemetry to %s\n", a_address);
+		return true;
+	}
+
+	/**
+		submit totals a frame's scopes by name and track, and queues them
+			with its counters and the gpu memory allocated as a FRAME
+			record. If that is more than MAX_QUEUED_BYTES waiting the
+			oldest records are dropped.
+
+			@param1 a_frame is the frame, nullptr or one already submitted
+					does nothing.
+	*/
+	void TelemetryStream::submit(const Profiler::Frame* a_frame)
+	{
+		// The same frame is found again while the profiler is off.
+		if (isCreated() == false || a_frame == nullptr || a_frame->number <= m_lastFrame)
+			return;
+		m_lastFrame = a_frame->number;
+
+		SNS_PROFILE_SCOPE("Telemetry");
+		m_scopes.clear();
+		m_scopeIndices.clear();
+		for (const Profiler::Event& event : a_frame->events)
+		{
+			unsigned int track = event.thread == Profiler::GPU_THREAD ? 0 :
+				event.thread == Profiler::ASYNC_COMPUTE_THREAD ? 1 :
+				event.thread == Profiler::VIDEO_ENCODE_THREAD ? 2 : event.thread + 3;
+			unsigned int name = findName(event.name);
+			unsigned long long key = (unsigned long long)name << 32 | track;
+			auto found = m_scopeIndices.find(key);
+			if (found == m_scopeIndices.end())
+			{
+				m_scopeIndices.emplace(key, (unsigned int)m_scopes.size());
+				m_scopes.push_back({ name, track, event.duration * 0.001, 1 });
+			}
+			else
+			{
+				m_scopes[found->second].milliseconds += event.duration * 0.001;
+				++m_scopes[found->second].calls;
+			}
+		}
+
+		std::vector<unsigned char> record;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_buffers.empty() == false)
+			{
+				record = std::move(m_buffers.back());
+				m_buffers.pop_back();
+			}
+		}
+		record.clear();
+		record.push_back(FRAME);
+		writeVarint(record, a_frame->number);
+		writeFloat(record, a_frame->duration * 0.001);
+		writeVarint(record, m_scopes.size());
+		for (const Scope& scope : m_scopes)
+		{
+			writeVarint(record, scope.name);
+			writeVarint(record, scope.track);
+			writeFloat(record, scope.milliseconds);
+			writeVarint(record, scope.calls);
+		}
+		writeVarint(record, a_frame->counters.size());
+		for (const Profiler::Counter& counter : a_frame->counters)
+		{
+			writeVarint(record, findName(counter.name));
+			writeFloat(record, counter.value);
+		}
+		const GpuMemory& memory = GpuMemory::instance();
+		writeVarint(record, GpuMemory::CATEGORY_COUNT);
+		for (unsigned int i = 0; i < GpuMemory::CATEGORY_COUNT; ++i)
+			writeVarint(record, memory.getCategoryTotal((GpuMemory::Category)i) / 1024);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queuedBytes += record.size();
+		m_queue.push_back(std::move(record));
+		while (m_queuedBytes > MAX_QUEUED_BYTES && m_queue.size() > 1)
+		{
+			m_queuedBytes -= m_queue.front().size();
+			m_buffers.push_back(std::move(m_queue.front()));
+			m_queue.pop_front();
+			++m_stats.framesDropped;
+			++m_unreportedDrops;
+		}
+	}
+
+	/**
+		findName returns a name's id, giving it the next one the first
+			time it is seen. Names are string literals, so they are
+			looked up by their address.
+
+			@param1 a_name is the name.
+	*/
+	unsigned int TelemetryStream::findName(const char* a_name)
+	{
+		auto found = m_nameIds.find(a_name);
+		if (found != m_nameIds.end())
+			return found->second;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		unsigned int id = (unsigned int)m_names.size();
+		m_names.push_back(a_name);
+		m_nameIds.emplace(a_name, id);
+		return id;
+	}
+
+	/**
+		run sends a batch every BATCH_MILLISECONDS while connected, and
+			tries to connect again less and less often while it isn't.
+			Once destroy stops it, what is queued is sent if it is
+			connected.
+	*/
+	void TelemetryStream::run()
+	{
+		unsigned int wait = 0;
+		unsigned int retry = RETRY_MILLISECONDS;
+		for (;;)
+		{
+			bool stopping = false;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait_for(lock, std::chrono::milliseconds(wait), [this]() { return m_stopping; });
+				stopping = m_stopping;
+			}
+
+			if (m_socket == NO_SOCKET)
+			{
+				if (stopping)
+					break;
+				if (connect() == false)
+				{
+					wait = retry;
+					retry = std::min(retry * 2, MAX_RETRY_MILLISECONDS);
+					continue;
+				}
+				retry = RETRY_MILLISECONDS;
+			}
+
+			wait = BATCH_MILLISECONDS;
+			if (sendBatch() == false)
+			{
+				printf("TelemetryStream: lost the collector at %s:%s.\n", m_host.c_str(), m_port.c_str());
+				disconnect();
+				wait = RETRY_MILLISECONDS;
+			}
+			if (stopping)
+				break;
+		}
+		disconnect();
+	}
+
+	/**
+		connect connects to the collector and says hello. The connection
+			waits at most CONNECT_TIMEOUT_MILLISECONDS, so destroy isn't
+			held up by a collector that is gone, and sends that block
+			longer than SEND_TIMEOUT_MILLISECONDS fail.
+
+			@return false if it couldn't.
+	*/
+	bool TelemetryStream::connect()
+	{
+		addrinfo hints = {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		addrinfo* addresses = nullptr;
+		if (getaddrinfo(m_host.c_str(), m_port.c_str(), &hints, &addresses) != 0)
+			return false;
+
+		for (addrinfo* address = addresses; address != nullptr && m_socket == NO_SOCKET; address = address->ai_next)
+		{
+			intptr_t socket = (intptr_t)::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+			if (socket == NO_SOCKET)
+				continue;
+
+			setBlocking(socket, false);
+			::connect(socket, address->ai_addr, (int)address->ai_addrlen);
+			fd_set writable;
+			FD_ZERO(&writable);
+			FD_SET(socket, &writable);
+			timeval timeout = { CONNECT_TIMEOUT_MILLISECONDS / 1000, (CONNECT_TIMEOUT_MILLISECONDS % 1000) * 1000 };
+			int error = 0;
+			socklen_t errorSize = sizeof(error);
+			if (select((int)socket + 1, nullptr, &writable, nullptr, &timeout) == 1 &&
+				getsockopt(socket, SOL_SOCKET, SO_ERROR, (char*)&error, &errorSize) == 0 && error == 0)
+			{
+				m_socket = socket;
+			}
+			else
+				closeSocket(socket);
+		}
+		freeaddrinfo(addresses);
+		if (m_socket == NO_SOCKET)
+			return false;
+
+		setBlocking(m_socket, true);
+		int noDelay = 1;
+		setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+#ifdef _WIN32
+		DWORD sendTimeout = SEND_TIMEOUT_MILLISECONDS;
+#else
+		timeval sendTimeout = { SEND_TIMEOUT_MILLISECONDS / 1000, (SEND_TIMEOUT_MILLISECONDS % 1000) * 1000 };
+#endif
+		setsockopt(m_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&sendTimeout, sizeof(sendTimeout));
+
+		char machine[256] = {};
+		gethostname(machine, sizeof(machine) - 1);
+		std::vector<unsigned char> hello(MAGIC, MAGIC + sizeof(MAGIC));
+		hello.push_back(VERSION);
+		writeString(hello, machine);
+		if (sendAll(hello.data(), hello.size()) == false)
+		{
+			disconnect();
+			return false;
+		}
+
+		// The collector has none of the names on a new connection.
+		m_namesSent = 0;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_stats.connects;
+		m_stats.connected = true;
+		printf("TelemetryStream: connected to %s:%s\n", m_host.c_str(), m_port.c_str());
+		return true;
+	}
+
+	/**
+		sendBatch sends one packet of every name the collector doesn't
+			have yet, how many frames were dropped since it was last
+			told and every record queued. Records that fail to send are
+			counted as dropped.
+
+			@return false if the socket failed.
+	*/
+	bool TelemetryStream::sendBatch()
+	{
+		std::deque<std::vector<unsigned char>> records;
+		unsigned int namesEnd = 0;
+		unsigned long long drops = 0;
+
+		// A varint's worth of length is unknown until the end, so the
+		//	packet's length is a fixed 32 bits.
+		m_packet.assign(4, 0);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			namesEnd = (unsigned int)m_names.size();
+			if (namesEnd > m_namesSent)
+			{
+				m_packet.push_back(NAMES);
+				writeVarint(m_packet, m_namesSent);
+				writeVarint(m_packet, namesEnd - m_namesSent);
+				for (unsigned int i = m_namesSent; i < namesEnd; ++i)
+					writeString(m_packet, m_names[i]);
+			}
+			drops = m_unreportedDrops;
+			m_unreportedDrops = 0;
+			records.swap(m_queue);
+			m_queuedBytes = 0;
+		}
+		if (drops > 0)
+		{
+			m_packet.push_back(DROPPED);
+			writeVarint(m_packet, drops);
+		}
+		for (const std::vector<unsigned char>& record : records)
+			m_packet.insert(m_packet.end(), record.begin(), record.end());
+
+		bool sent = true;
+		if (m_packet.size() > 4)
+		{
+			unsigned int length = (unsigned int)(m_packet.size() - 4);
+			for (int i = 0; i < 4; ++i)
+				m_packet[i] = (unsigned char)(length >> (i * 8));
+			sent = sendAll(m_packet.data(), m_packet.size());
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (sent)
+		{
+			m_namesSent = namesEnd;
+			m_stats.framesSent += records.size();
+			m_stats.bytesSent += m_packet.size() > 4 ? m_packet.size() : 0;
+		}
+		else
+		{
+			m_stats.framesDropped += records.size();
+			m_unreportedDrops += drops + records.size();
+		}
+		for (std::vector<unsigned char>& record : records)
+			m_buffers.push_back(std::move(record));
+		return sent;
+	}
+
+	/**
+		sendAll sends all of a buffer, however many sends it takes.
+
+			@param1 a_data is the bytes.
+
+			@param2 a_size is how many.
+
+			@return false if the socket failed or timed out.
+	*/
+	bool TelemetryStream::sendAll(const unsigned char* a_data, size_t a_size)
+	{
+		while (a_size > 0)
+		{
+			int sent = (int)send(m_socket, (const char*)a_data, (int)std::min(a_size, (size_t)(1 << 30)), SEND_FLAGS);
+			if (sent <= 0)
+				return false;
+			a_data += sent;
+			a_size -= sent;
+		}
+		return true;
+	}
+
+	/**
+		disconnect closes the socket, if there is one.
+	*/
+	void TelemetryStream::disconnect()
+	{
+		if (m_socket == NO_SOCKET)
+			return;
+
+		closeSocket(m_socket);
+		m_socket = NO_SOCKET;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.connected = false;
+	}
+
+	/**
+		destroy sends what is queued if it is connected, then disconnects
+			and stops the thread.
+	*/
+	void TelemetryStream::destroy()
+	{
+		if (m_thread.joinable() == false)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+#ifdef _WIN32
+		WSACleanup();
+#endif
+
+		m_lastFrame = 0;
+		m_nameIds.clear();
+		m_names.clear();
+		m_queue.clear();
+		m_buffers.clear();
+		m_queuedBytes = 0;
+		m_unreportedDrops = 0;
+	}
+
+	/**
+		getStats returns what has been sent.
+	*/
+	TelemetryStream::Stats TelemetryStream::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+}
@@ -0,0 +1,194 @@
+/**
+	TelemetryStream.h
+
+	Purpose: TelemetryStream.h is the header file for the TelemetryStream
+			class. The TelemetryStream sends what the Profiler recorded of
+			each frame, with the gpu memory the engine has allocated, over
+			a socket to a collector, so machines nobody is watching can
+			be watched from somewhere else.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Profiler.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The TelemetryStream class turns each frame the Profiler finished
+			into a compact record on the context thread, and a thread of
+			its own connects to the collector and sends whatever records
+			are queued every BATCH_MILLISECONDS. Records wait while the
+			collector can't be reached, at most MAX_QUEUED_BYTES of them,
+			the oldest dropped to make room, so it never holds more than
+			that whatever happens to the network.
+
+		The stream is sent over TCP, everything little endian, unsigned
+			numbers as LEB128 varints and times as 32 bit floats. On
+			connecting the stream sends
+				"SNST", a byte of VERSION and the machine's name, a varint
+				length then its bytes,
+			then packets, each a 32 bit length and the records in it:
+				NAMES, the first id and how many, then each name, a
+					varint length and its bytes. Names are given ids the
+					first time a frame has them and sent again on every
+					connection before the records that use them.
+				FRAME, the frame number, its milliseconds, how many
+					scopes, then each scope's name id, track, total
+					milliseconds and how many times it ran, how many
+					counters then each's name id and value, and how many
+					gpu memory categories then each's kilobytes.
+				DROPPED, how many frames were dropped since the last
+					DROPPED, for whatever gap the collector sees.
+			A scope's track is 0 for the gpu, 1 for async compute, 2 for
+				the video encoder and the cpu thread's number plus 3.
+	*/
+	class TelemetryStream
+	{
+	public:
+		static const unsigned char VERSION = 1;
+
+		// The record types.
+		static const unsigned char NAMES = 1;
+		static const unsigned char FRAME = 2;
+		static const unsigned char DROPPED = 3;
+
+		// How long records are batched before they are sent.
+		static const unsigned int BATCH_MILLISECONDS = 250;
+
+		// How many bytes of records wait to be sent at most.
+		static const size_t MAX_QUEUED_BYTES = 512 * 1024;
+
+		/**
+			What has been sent so far.
+		*/
+		struct Stats
+		{
+			unsigned long long framesSent;
+			unsigned long long bytesSent;
+			unsigned long long framesDropped;
+			unsigned int connects;
+			bool connected;
+		};
+
+		TelemetryStream();
+
+		/**
+			The deconstructor sends what it can and disconnects, see
+				destroy.
+		*/
+		~TelemetryStream();
+
+		TelemetryStream(const TelemetryStream&) = delete;
+		TelemetryStream& operator=(const TelemetryStream&) = delete;
+
+		/**
+			create starts the thread that connects to the collector, and
+				turns the Profiler on. It keeps trying to connect for as
+				long as the stream exists.
+
+				@param1 a_address is the collector's "host:port".
+
+				@return false if the address has no port.
+		*/
+		bool create(const char* a_address);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_thread.joinable(); }
+
+		/**
+			submit queues a frame of the Profiler's. Called on the
+				context thread once its gpu scopes have been read, see
+				Profiler::GPU_LATENCY.
+
+				@param1 a_frame is the frame, nullptr or one already
+						submitted does nothing.
+		*/
+		void submit(const Profiler::Frame* a_frame);
+
+		/**
+			destroy sends what is queued if it is connected, then
+				disconnects and stops the thread.
+		*/
+		void destroy();
+
+		/**
+			getStats returns what has been sent.
+		*/
+		Stats getStats() const;
+
+	private:
+		// One scope's total in a frame, by its name and track.
+		struct Scope
+		{
+			unsigned int name;
+			unsigned int track;
+			double milliseconds;
+			unsigned int calls;
+		};
+
+		// Returns a name's id, giving it one the first time.
+		unsigned int findName(const char* a_name);
+
+		// What the thread runs, connecting and sending until destroy.
+		void run();
+
+		// Connects to m_host at m_port, with a timeout.
+		bool connect();
+
+		// Sends everything queued as one packet, false if the socket
+		//	failed.
+		bool sendBatch();
+
+		// Sends all of a buffer, false if the socket failed.
+		bool sendAll(const unsigned char* a_data, size_t a_size);
+
+		// Closes the socket, if there is one.
+		void disconnect();
+
+		std::string m_host;
+		std::string m_port;
+
+		// The socket, a SOCKET on Windows and a descriptor elsewhere.
+		intptr_t m_socket;
+
+		std::thread m_thread;
+
+		// Used only on the context thread, to build records without
+		//	allocating once they have grown.
+		std::unordered_map<const char*, unsigned int> m_nameIds;
+		std::unordered_map<unsigned long long, unsigned int> m_scopeIndices;
+		std::vector<Scope> m_scopes;
+		unsigned long long m_lastFrame;
+
+		// Used only on the thread, the names the collector has on this
+		//	connection.
+		unsigned int m_namesSent;
+		std::vector<unsigned char> m_packet;
+
+		// Guards everything below.
+		mutable std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::vector<std::string> m_names;
+		std::deque<std::vector<unsigned char>> m_queue;
+		size_t m_queuedBytes;
+
+		// Record buffers to be written into again.
+		std::vector<std::vector<unsigned char>> m_buffers;
+
+		// Frames dropped since the collector was last told.
+		unsigned long long m_unreportedDrops;
+		bool m_stopping;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,299 @@
+/**
+	TemporalUpsampler.cpp
+
+	Purpose: TemporalUpsampler.cpp is the source file for the
+			TemporalUpsampler class. The TemporalUpsampler builds a
+			window sized frame out of scenes drawn at half the width
+			and height, each from a different sub-pixel offset, so
+			every pixel is shaded once every four frames instead of
+			every frame.
+
+	@author Nathan Nette
+*/
+#include "TemporalUpsampler.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glm/matrix.hpp>
+#include <cstdio>
+
+namespace sns
+{
+	// The units the resolve reads the scene and the history from.
+	static const unsigned int COLOUR_UNIT = 0;
+	static const unsigned int DEPTH_UNIT = 1;
+	static const unsigned int HISTORY_UNIT = 2;
+
+	// Where each frame's sample is in its texel, in texels from the
+	//	centre. At half size these are the centres of the four window
+	//	pixels under the texel, taken corner to opposite corner.
+	static const glm::vec2 SAMPLES[TemporalUpsampler::SAMPLE_COUNT] =
+	{
+		glm::vec2(-0.25f, -0.25f),
+		glm::vec2(0.25f, 0.25f),
+		glm::vec2(0.25f, -0.25f),
+		glm::vec2(-0.25f, 0.25f)
+	};
+
+	// How much of each frame's sample a pixel takes when the scene is
+	//	drawn at the window's size, the rest is its history.
+	static const float ANTI_ALIASING_BLEND = 0.1f;
+
+	TemporalUpsampler::TemporalUpsampler()
+		: m_framebuffers(),
+		m_textures(),
+		m_current(0),
+		m_vao(0),
+		m_width(0),
+		m_height(0),
+		m_frame(0),
+		m_stillFrames(0),
+		m_previousProjectionView(1),
+		m_historyValid(false)
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffers and textures.
+	*/
+	TemporalUpsampler::~TemporalUpsampler()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the history and loads the resolve shader.
+
+			@param1 a_width is the width of the window.
+
+			@param2 a_height is the height of the window.
+
+			@return false without GL 4.5 or the shader, it is left
+					uncreated.
+	*/
+	bool TemporalUpsampler::create(int a_width, int a_height)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("TemporalUpsampler: temporal upsampling needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_resolveShader.getHandle() == 0)
+		{
+			// The same full screen triangle the particle upsample draws.
+			m_resolveShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleUpsample.vert");
+			m_resolveShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/temporalResolve.frag");
+			if (m_resolveShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_resolveShader.getLastError());
+				return false;
+			}
+		}
+
+		m_width = a_width > 1 ? a_width : 1;
+		m_height = a_height > 1 ? a_height : 1;
+
+		// The history is in high dynamic range as the scene is, and is
+		//	read filtered where a pixel reprojects between texels.
+		bool complete = true;
+		for (unsigned int i = 0; i < 2; ++i)
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, &m_textures[i]);
+			glTextureStorage2D(m_textures[i], 1, GL_R11F_G11F_B10F, m_width, m_height);
+			GpuMemory::instance().trackTexture(m_textures[i],
+				GpuMemory::getTextureBytes(GL_R11F_G11F_B10F, m_width, m_height),
+				GpuMemory::RENDER_TARGETS, "TemporalUpsampler");
+			glTextureParameteri(m_textures[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(m_textures[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(m_textures[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(m_textures[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glCreateFramebuffers(1, &m_framebuffers[i]);
+			glNamedFramebufferTexture(m_framebuffers[i], GL_COLOR_ATTACHMENT0, m_textures[i], 0);
+			complete = complete && glCheckNamedFramebufferStatus(m_framebuffers[i], GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		}
+
+		if (complete == false)
+		{
+			printf("TemporalUpsampler: the history isn't complete.\n");
+			destroy();
+			return false;
+		}
+
+		glCreateVertexArrays(1, &m_vao);
+		reset();
+		return true;
+	}
+
+	/**
+		getJitter returns this frame's sample offset, in ndc, for a scene
+			drawn at a size.
+
+			@param1 a_renderWidth is the width the scene is drawn at.
+
+			@param2 a_renderHeight is the height it is drawn at.
+	*/
+	glm::vec2 TemporalUpsampler::getJitter(int a_renderWidth, int a_renderHeight) const
+	{
+		glm::vec2 size(a_renderWidth > 1 ? a_renderWidth : 1, a_renderHeight > 1 ? a_renderHeight : 1);
+		return SAMPLES[m_frame % SAMPLE_COUNT] * 2.0f / size;
+	}
+
+	/**
+		jitterProjection moves a projection's image by an offset in ndc.
+			It is the offset's translation applied after the projection,
+			which moves x and y by the offset times w, so perspective
+			and orthographic projections both move by it on screen.
+
+			@param1 a_projection is the projection.
+
+			@param2 a_jitter is the offset.
+	*/
+	void TemporalUpsampler::jitterProjection(glm::mat4& a_projection, const glm::vec2& a_jitter)
+	{
+		for (unsigned int column = 0; column < 4; ++column)
+		{
+			a_projection[column][0] += a_jitter.x * a_projection[column][3];
+			a_projection[column][1] += a_jitter.y * a_projection[column][3];
+		}
+	}
+
+	/**
+		resolve rebuilds the window sized frame from the scene drawn this
+			frame and the history, and moves on to the next sample.
+
+			@param1 a_colour is the scene's colour texture.
+
+			@param2 a_depth is its depth texture.
+
+			@param3 a_renderWidth is how wide the scene was drawn.
+
+			@param4 a_renderHeight is how high it was drawn.
+
+			@param5 a_projectionView is the camera's projection view,
+					without the jitter.
+
+			@param6 a_sceneStill is whether nothing in the scene has moved
+					since last frame.
+	*/
+	void TemporalUpsampler::resolve(unsigned int a_colour, unsigned int a_depth, int a_renderWidth, int a_renderHeight,
+		const glm::mat4& a_projectionView, bool a_sceneStill)
+	{
+		static constexpr aie::UniformHandle COLOUR("Colour");
+		static constexpr aie::UniformHandle DEPTH("Depth");
+		static constexpr aie::UniformHandle HISTORY("History");
+		static constexpr aie::UniformHandle HISTORY_VALID("HistoryValid");
+		static constexpr aie::UniformHandle RENDER_SIZE("RenderSize");
+		static constexpr aie::UniformHandle WINDOW_SIZE("WindowSize");
+		static constexpr aie::UniformHandle SAMPLE("Sample");
+		static constexpr aie::UniformHandle DEPTH_TO_NDC("DepthToNdc");
+		static constexpr aie::UniformHandle REPROJECTION("Reprojection");
+		static constexpr aie::UniformHandle CLAMP_HISTORY("ClampHistory");
+		static constexpr aie::UniformHandle BLEND("Blend");
+
+		int previousFramebuffer = 0;
+		int previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+		if (m_historyValid && a_sceneStill && a_projectionView == m_previousProjectionView)
+			++m_stillFrames;
+		else
+			m_stillFrames = 0;
+
+		// Window ndc this frame to clip space last frame.
+		glm::mat4 reprojection = m_previousProjectionView * glm::inverse(a_projectionView);
+
+		unsigned int previous = m_current;
+		m_current ^= 1;
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[m_current]);
+		glViewport(0, 0, m_width, m_height);
+
+		RenderState& state = RenderState::instance();
+		state.bindTexture(COLOUR_UNIT, a_colour);
+		state.bindTexture(DEPTH_UNIT, a_depth);
+		state.bindTexture(HISTORY_UNIT, m_textures[previous]);
+
+		m_resolveShader.bind();
+		m_resolveShader.bindUniform(COLOUR, (int)COLOUR_UNIT);
+		m_resolveShader.bindUniform(DEPTH, (int)DEPTH_UNIT);
+		m_resolveShader.bindUniform(HISTORY, (int)HISTORY_UNIT);
+		m_resolveShader.bindUniform(HISTORY_VALID, m_historyValid ? 1 : 0);
+		m_resolveShader.bindUniform(RENDER_SIZE, glm::vec2(a_renderWidth, a_renderHeight));
+		m_resolveShader.bindUniform(WINDOW_SIZE, glm::vec2(m_width, m_height));
+		m_resolveShader.bindUniform(SAMPLE, SAMPLES[m_frame % SAMPLE_COUNT]);
+		m_resolveShader.bindUniform(DEPTH_TO_NDC, state.isReverseZ() ? glm::vec2(1, 0) : glm::vec2(2, -1));
+		m_resolveShader.bindUniform(REPROJECTION, reprojection);
+		m_resolveShader.bindUniform(CLAMP_HISTORY, m_stillFrames == 0 ? 1 : 0);
+		bool antiAliasing = a_renderWidth == m_width && a_renderHeight == m_height;
+		m_resolveShader.bindUniform(BLEND, antiAliasing ? ANTI_ALIASING_BLEND : 1.0f);
+
+		// Every pixel is written, nothing is tested.
+		state.setDepthTest(false);
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		state.setDepthTest(true);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+		m_previousProjectionView = a_projectionView;
+		m_historyValid = true;
+		++m_frame;
+	}
+
+	/**
+		present copies the last resolved frame to the framebuffer bound
+			again.
+	*/
+	void TemporalUpsampler::present()
+	{
+		if (m_historyValid)
+			copyOut(m_current);
+	}
+
+	/**
+		copyOut copies a history to the framebuffer bound, which is the
+			window's size.
+
+			@param1 a_history is which of the two.
+	*/
+	void TemporalUpsampler::copyOut(unsigned int a_history)
+	{
+		int framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+		glBlitNamedFramebuffer(m_framebuffers[a_history], framebuffer, 0, 0, m_width, m_height,
+			0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+
+	/**
+		destroy deletes the framebuffers and textures.
+	*/
+	void TemporalUpsampler::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		for (unsigned int i = 0; i < 2; ++i)
+		{
+			if (m_textures[i] != 0)
+			{
+				glDeleteTextures(1, &m_textures[i]);
+				state.onTextureDeleted(m_textures[i]);
+				GpuMemory::instance().releaseTexture(m_textures[i]);
+				m_textures[i] = 0;
+			}
+			glDeleteFramebuffers(1, &m_framebuffers[i]);
+			m_framebuffers[i] = 0;
+		}
+
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			state.onVertexArrayDeleted(m_vao);
+			m_vao = 0;
+		}
+		m_historyValid = false;
+	}
+}
@@ -0,0 +1,181 @@
+/**
+	TemporalUpsampler.h
+
+	Purpose: TemporalUpsampler.h is the header file for the
+			TemporalUpsampler class. The TemporalUpsampler builds a
+			window sized frame out of scenes drawn at half the width
+			and height, each from a different sub-pixel offset, so
+			every pixel is shaded once every four frames instead of
+			every frame.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+
+namespace sns
+{
+	/**
+		The TemporalUpsampler class keeps the last frame at the window's
+			size as history. Each frame the scene is drawn smaller with
+			its projection moved by getJitter, so a texel's sample
+			lands on a different one of the window pixels under it each
+			frame, cycling through SAMPLE_COUNT of them.
+
+		resolve then rebuilds the window's pixels. The pixels this
+			frame's samples landed on take them as they are. The rest
+			are found in the last frame by reprojecting their depth
+			with the camera's movement, and the history is clamped to
+			the colours of the samples around them, so what was hidden
+			last frame doesn't leave a trail. With the camera and the
+			scene both still nothing is clamped, and after SAMPLE_COUNT
+			frames the history is exactly the full size frame.
+
+		With the scene drawn at the window's size instead, every pixel
+			has a sample every frame and the resolve is temporal anti-
+			aliasing. Each pixel blends a little of its sample into
+			its reprojected history, so the jittered samples average
+			over the edges.
+
+		The history is drawn into at the window's size, in high dynamic
+			range as the scene target is, and post processed out of
+			getTexture, so it can be shown again without drawing.
+
+		Everything needs GL 4.5, without it create fails and the scene
+			should be drawn at its full size.
+	*/
+	class TemporalUpsampler
+	{
+	public:
+		// How many frames every pixel of the window is shaded over.
+		static const unsigned int SAMPLE_COUNT = 4;
+
+		// How much of the window's width and height the scene is drawn at.
+		static constexpr float SCALE = 0.5f;
+
+		TemporalUpsampler();
+
+		/**
+			The deconstructor deletes the framebuffers and textures.
+		*/
+		~TemporalUpsampler();
+
+		TemporalUpsampler(const TemporalUpsampler&) = delete;
+		TemporalUpsampler& operator=(const TemporalUpsampler&) = delete;
+
+		/**
+			create makes the history and loads the resolve shader.
+
+				@param1 a_width is the width of the window.
+
+				@param2 a_height is the height of the window.
+
+				@return false without GL 4.5 or the shader, it is left
+						uncreated.
+		*/
+		bool create(int a_width, int a_height);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_framebuffers[0] != 0; }
+
+		/**
+			getJitter returns this frame's sample offset, in ndc, for a
+				scene drawn at a size.
+
+				@param1 a_renderWidth is the width the scene is drawn at.
+
+				@param2 a_renderHeight is the height it is drawn at.
+		*/
+		glm::vec2 getJitter(int a_renderWidth, int a_renderHeight) const;
+
+		/**
+			jitterProjection moves a projection's image by an offset in
+				ndc, without changing its depth.
+
+				@param1 a_projection is the projection.
+
+				@param2 a_jitter is the offset.
+		*/
+		static void jitterProjection(glm::mat4& a_projection, const glm::vec2& a_jitter);
+
+		/**
+			resolve rebuilds the window sized frame from the scene drawn
+				this frame and the history, then moves on to the next
+				sample. present or getTexture shows it.
+
+				@param1 a_colour is the scene's colour texture.
+
+				@param2 a_depth is its depth texture.
+
+				@param3 a_renderWidth is how wide the scene was drawn.
+
+				@param4 a_renderHeight is how high it was drawn.
+
+				@param5 a_projectionView is the camera's projection view,
+						without the jitter.
+
+				@param6 a_sceneStill is whether nothing in the scene has
+						moved since last frame.
+		*/
+		void resolve(unsigned int a_colour, unsigned int a_depth, int a_renderWidth, int a_renderHeight,
+			const glm::mat4& a_projectionView, bool a_sceneStill);
+
+		/**
+			present copies the last resolved frame to the framebuffer
+				bound, as it is.
+		*/
+		void present();
+
+		/**
+			getTexture returns the last resolved frame, at the window's
+				size.
+		*/
+		unsigned int getTexture() const { return m_textures[m_current]; }
+
+		/**
+			reset forgets the history, so the next frame is only what it
+				draws.
+		*/
+		void reset() { m_historyValid = false; m_stillFrames = 0; }
+
+		/**
+			isConverged returns whether the camera has held still for
+				every sample, so the history is the full size frame.
+		*/
+		bool isConverged() const { return m_historyValid && m_stillFrames >= SAMPLE_COUNT; }
+
+	private:
+		// Deletes the framebuffers and textures.
+		void destroy();
+
+		// Copies a history to the framebuffer bound.
+		void copyOut(unsigned int a_history);
+
+		aie::ShaderProgram m_resolveShader;
+
+		// Two histories, the one drawn last frame is read while the other
+		//	is drawn.
+		unsigned int m_framebuffers[2];
+		unsigned int m_textures[2];
+		unsigned int m_current;
+
+		// An empty vertex array for the resolve's full screen triangle.
+		unsigned int m_vao;
+
+		int m_width;
+		int m_height;
+
+		// Which sample this frame is, and the frames since the camera or
+		//	the scene last moved.
+		unsigned int m_frame;
+		unsigned int m_stillFrames;
+
+		// Last frame's projection view, without the jitter.
+		glm::mat4 m_previousProjectionView;
+		bool m_historyValid;
+	};
+}
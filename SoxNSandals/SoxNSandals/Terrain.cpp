@@ -0,0 +1,421 @@
+/**
+	Terrain.cpp
+
+	Purpose: Terrain.cpp is the source file for the Terrain class. The
+			Terrain draws the scene's heightfield as a grid of patches,
+			tessellated on the gpu so the triangles stay about the same
+			size on screen however far away the ground is.
+
+	@author Nathan Nette
+*/
+#include "Terrain.h"
+#include "FileSystem.h"
+#include "GpuMemory.h"
+#include "JobSystem.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include "stb_image.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	// The units the heights and the patches' bounds are read from.
+	static const unsigned int HEIGHT_UNIT = 0;
+	static const unsigned int BOUNDS_UNIT = 1;
+
+	// How many octaves of noise a generated heightmap adds up.
+	static const unsigned int OCTAVES = 8;
+
+	// How many rows of a generated heightmap each job makes.
+	static const unsigned int ROWS_PER_JOB = 64;
+
+	Terrain::Terrain()
+		: m_terrain(),
+		m_resolution(0),
+		m_heightTexture(0),
+		m_boundsTexture(0),
+		m_vao(0),
+		m_triangleSize(16.0f)
+	{
+	}
+
+	/**
+		The deconstructor deletes the textures and vertex array.
+	*/
+	Terrain::~Terrain()
+	{
+		destroy();
+	}
+
+	/**
+		create loads or generates the heightmap and loads the shader.
+
+			@param1 a_terrain is the scene's terrain.
+
+			@return false without GL 4.5, the shader or a heightmap that
+					can be read, it is left uncreated.
+	*/
+	bool Terrain::create(const SceneDescription::Terrain& a_terrain)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("Terrain: tessellating the terrain needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_shader.getHandle() == 0)
+		{
+			m_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/terrain.vert");
+			m_shader.loadShader(aie::eShaderStage::TESSELLATION_CONTROL, "../shaders/terrain.tesc");
+			m_shader.loadShader(aie::eShaderStage::TESSELLATION_EVALUATION, "../shaders/terrain.tese");
+			m_shader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/terrain.frag");
+			if (m_shader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_shader.getLastError());
+				return false;
+			}
+		}
+
+		m_terrain = a_terrain;
+		m_terrain.patches = std::max(m_terrain.patches, 1u);
+		if (m_terrain.heightmap.empty())
+			generateHeightmap(m_terrain.seed, m_terrain.flatRadius);
+		else if (loadHeightmap(m_terrain.heightmap) == false)
+		{
+			printf("Terrain: couldn't read the heightmap %s.\n", m_terrain.heightmap.c_str());
+			return false;
+		}
+
+		createTextures();
+		glCreateVertexArrays(1, &m_vao);
+		return true;
+	}
+
+	/**
+		destroy deletes the textures and vertex array.
+	*/
+	void Terrain::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		unsigned int* textures[2] = { &m_heightTexture, &m_boundsTexture };
+		for (unsigned int* texture : textures)
+		{
+			if (*texture != 0)
+			{
+				glDeleteTextures(1, texture);
+				state.onTextureDeleted(*texture);
+				GpuMemory::instance().releaseTexture(*texture);
+				*texture = 0;
+			}
+		}
+
+		if (m_vao != 0)
+		{
+			glDeleteVertexArrays(1, &m_vao);
+			state.onVertexArrayDeleted(m_vao);
+			m_vao = 0;
+		}
+		m_heights.clear();
+		m_resolution = 0;
+	}
+
+	/**
+		draw draws the terrain with its shader, which must already be
+			bound.
+
+			@param1 a_viewportHeight is the height of the viewport in
+					pixels, how large the triangles are is measured
+					against.
+	*/
+	void Terrain::draw(int a_viewportHeight)
+	{
+		static constexpr aie::UniformHandle HEIGHTMAP("Heightmap");
+		static constexpr aie::UniformHandle PATCH_BOUNDS("PatchBounds");
+		static constexpr aie::UniformHandle ORIGIN("Origin");
+		static constexpr aie::UniformHandle SCALE("Scale");
+		static constexpr aie::UniformHandle PATCHES("Patches");
+		static constexpr aie::UniformHandle VIEWPORT_HEIGHT("ViewportHeight");
+		static constexpr aie::UniformHandle TRIANGLE_SIZE("TriangleSize");
+		static constexpr aie::UniformHandle TEXEL_SIZE("TexelSize");
+
+		if (isCreated() == false)
+			return;
+
+		RenderState& state = RenderState::instance();
+		state.bindTexture(HEIGHT_UNIT, m_heightTexture);
+		state.bindTexture(BOUNDS_UNIT, m_boundsTexture);
+		m_shader.bindUniform(HEIGHTMAP, (int)HEIGHT_UNIT);
+		m_shader.bindUniform(PATCH_BOUNDS, (int)BOUNDS_UNIT);
+		m_shader.bindUniform(ORIGIN, m_terrain.position - glm::vec3(m_terrain.size, 0, m_terrain.size) * 0.5f);
+		m_shader.bindUniform(SCALE, glm::vec2(m_terrain.size, m_terrain.height));
+		m_shader.bindUniform(PATCHES, (int)m_terrain.patches);
+		m_shader.bindUniform(VIEWPORT_HEIGHT, (float)std::max(a_viewportHeight, 1));
+		m_shader.bindUniform(TRIANGLE_SIZE, m_triangleSize);
+		m_shader.bindUniform(TEXEL_SIZE, glm::vec2(1.0f / (float)m_resolution));
+
+		// Four corners a patch, every patch in one draw.
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glPatchParameteri(GL_PATCH_VERTICES, 4);
+		glDrawArrays(GL_PATCHES, 0, m_terrain.patches * m_terrain.patches * 4);
+	}
+
+	/**
+		getHeight returns the height of the ground, between the
+			heightmap's texels as the gpu filters it.
+
+			@param1 a_x is the world position along X.
+
+			@param2 a_z is the world position along Z.
+
+			@return the world height, or the terrain's position outside
+					it.
+	*/
+	float Terrain::getHeight(float a_x, float a_z) const
+	{
+		if (m_resolution == 0)
+			return m_terrain.position.y;
+
+		float u = (a_x - m_terrain.position.x) / m_terrain.size + 0.5f;
+		float v = (a_z - m_terrain.position.z) / m_terrain.size + 0.5f;
+		if (u < 0 || u > 1 || v < 0 || v > 1)
+			return m_terrain.position.y;
+
+		// Texel centres are half a texel in, and the edges clamp.
+		float x = u * m_resolution - 0.5f;
+		float y = v * m_resolution - 0.5f;
+		int last = (int)m_resolution - 1;
+		int x0 = std::min(std::max((int)floorf(x), 0), last);
+		int y0 = std::min(std::max((int)floorf(y), 0), last);
+		int x1 = std::min(x0 + 1, last);
+		int y1 = std::min(y0 + 1, last);
+		float fx = glm::clamp(x - (float)x0, 0.0f, 1.0f);
+		float fy = glm::clamp(y - (float)y0, 0.0f, 1.0f);
+
+		auto height = [this](int a_column, int a_row) { return (float)m_heights[a_row * m_resolution + a_column]; };
+		float top = glm::mix(height(x0, y0), height(x1, y0), fx);
+		float bottom = glm::mix(height(x0, y1), height(x1, y1), fx);
+		return m_terrain.position.y + glm::mix(top, bottom, fy) / 65535.0f * m_terrain.height;
+	}
+
+	/**
+		setTriangleSize sets how many pixels long the edges of the
+			triangles should be.
+
+			@param1 a_pixels is the length, at least 1.
+	*/
+	void Terrain::setTriangleSize(float a_pixels)
+	{
+		m_triangleSize = std::max(a_pixels, 1.0f);
+	}
+
+	/**
+		loadHeightmap reads the heights of a file.
+
+			@param1 a_filename is the file.
+
+			@return false if it can't be read or isn't square.
+	*/
+	bool Terrain::loadHeightmap(const std::string& a_filename)
+	{
+		FileView file;
+		if (FileSystem::instance().open(a_filename.c_str(), file) == false)
+			return false;
+
+		std::string extension = a_filename.substr(std::min(a_filename.find_last_of('.'), a_filename.size()));
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+		// Raw heights have no header, only their size says how wide.
+		if (extension == ".r16" || extension == ".raw")
+		{
+			size_t count = file.getSize() / 2;
+			unsigned int resolution = (unsigned int)sqrt((double)count);
+			if (resolution < 2 || (size_t)resolution * resolution != count)
+				return false;
+
+			m_resolution = resolution;
+			m_heights.resize(count);
+			const unsigned char* data = file.getData();
+			for (size_t i = 0; i < count; ++i)
+				m_heights[i] = (uint16_t)(data[i * 2] | (data[i * 2 + 1] << 8));
+			return true;
+		}
+
+		// Images are 8 bit, stretched over the whole range.
+		int width = 0, height = 0, channels = 0;
+		unsigned char* pixels = stbi_load_from_memory(file.getData(), (int)file.getSize(), &width, &height,
+			&channels, STBI_grey);
+		if (pixels == nullptr)
+			return false;
+		if (width != height || width < 2)
+		{
+			stbi_image_free(pixels);
+			return false;
+		}
+
+		m_resolution = (unsigned int)width;
+		m_heights.resize((size_t)width * height);
+		for (size_t i = 0; i < m_heights.size(); ++i)
+			m_heights[i] = (uint16_t)(pixels[i] * 257);
+		stbi_image_free(pixels);
+		return true;
+	}
+
+	// A hash of a lattice point and the seed, 0 to 1.
+	static float latticeValue(int a_x, int a_y, uint32_t a_seed)
+	{
+		uint32_t hash = (uint32_t)a_x * 0x8da6b343u ^ (uint32_t)a_y * 0xd8163841u ^ a_seed * 0xcb1ab31fu;
+		hash ^= hash >> 15;
+		hash *= 0x2c1b3c6du;
+		hash ^= hash >> 12;
+		hash *= 0x297a2d39u;
+		hash ^= hash >> 15;
+		return (float)(hash & 0xffffff) / (float)0xffffff;
+	}
+
+	// Value noise, the lattice blended smoothly between its points.
+	static float valueNoise(float a_x, float a_y, uint32_t a_seed)
+	{
+		int x0 = (int)floorf(a_x);
+		int y0 = (int)floorf(a_y);
+		float fx = a_x - (float)x0;
+		float fy = a_y - (float)y0;
+		fx = fx * fx * (3 - 2 * fx);
+		fy = fy * fy * (3 - 2 * fy);
+
+		float top = glm::mix(latticeValue(x0, y0, a_seed), latticeValue(x0 + 1, y0, a_seed), fx);
+		float bottom = glm::mix(latticeValue(x0, y0 + 1, a_seed), latticeValue(x0 + 1, y0 + 1, a_seed), fx);
+		return glm::mix(top, bottom, fy);
+	}
+
+	/**
+		generateHeightmap makes up the heights from a seed.
+
+			@param1 a_seed picks the hills.
+
+			@param2 a_flatRadius is how far from the centre it is kept
+					flat, in world units.
+	*/
+	void Terrain::generateHeightmap(uint32_t a_seed, float a_flatRadius)
+	{
+		m_resolution = GENERATED_RESOLUTION;
+		std::vector<float> heights(m_resolution * m_resolution);
+
+		// Octaves of noise, each twice as fine and half as high as the
+		//	one before, the rows shared out between jobs.
+		JobSystem& jobs = JobSystem::instance();
+		JobCounter counter;
+		for (unsigned int first = 0; first < m_resolution; first += ROWS_PER_JOB)
+		{
+			jobs.run([this, &heights, first, a_seed]()
+			{
+				unsigned int last = std::min(first + ROWS_PER_JOB, m_resolution);
+				for (unsigned int row = first; row < last; ++row)
+				{
+					for (unsigned int column = 0; column < m_resolution; ++column)
+					{
+						float x = (float)column / m_resolution * 4.0f;
+						float y = (float)row / m_resolution * 4.0f;
+						float amplitude = 1.0f, total = 0.0f;
+						for (unsigned int octave = 0; octave < OCTAVES; ++octave)
+						{
+							total += valueNoise(x, y, a_seed + octave) * amplitude;
+							x *= 2.0f;
+							y *= 2.0f;
+							amplitude *= 0.5f;
+						}
+						heights[row * m_resolution + column] = total;
+					}
+				}
+			}, &counter);
+		}
+		jobs.wait(counter);
+
+		float lowest = *std::min_element(heights.begin(), heights.end());
+		float highest = *std::max_element(heights.begin(), heights.end());
+		float range = std::max(highest - lowest, 0.0001f);
+
+		// Fade to flat ground from the flat radius out to twice it.
+		float texelSize = m_terrain.size / m_resolution;
+		m_heights.resize(heights.size());
+		for (unsigned int row = 0; row < m_resolution; ++row)
+		{
+			for (unsigned int column = 0; column < m_resolution; ++column)
+			{
+				glm::vec2 offset((column + 0.5f) * texelSize - m_terrain.size * 0.5f,
+					(row + 0.5f) * texelSize - m_terrain.size * 0.5f);
+				float mask = a_flatRadius > 0 ? glm::smoothstep(a_flatRadius, a_flatRadius * 2, glm::length(offset)) : 1.0f;
+				float height = (heights[row * m_resolution + column] - lowest) / range * mask;
+				m_heights[row * m_resolution + column] = (uint16_t)(height * 65535.0f + 0.5f);
+			}
+		}
+	}
+
+	/**
+		createTextures uploads the heights and each patch's bounds.
+	*/
+	void Terrain::createTextures()
+	{
+		GpuMemory& memory = GpuMemory::instance();
+
+		// The heights are filtered with mips for the normals far away,
+		//	the tessellation only reads the first level.
+		unsigned int levels = 1;
+		while ((m_resolution >> levels) != 0)
+			++levels;
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_heightTexture);
+		glTextureStorage2D(m_heightTexture, levels, GL_R16, m_resolution, m_resolution);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+		glTextureSubImage2D(m_heightTexture, 0, 0, 0, m_resolution, m_resolution, GL_RED, GL_UNSIGNED_SHORT,
+			m_heights.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateTextureMipmap(m_heightTexture);
+		glTextureParameteri(m_heightTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(m_heightTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_heightTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_heightTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		memory.trackTexture(m_heightTexture, GpuMemory::getTextureBytes(GL_R16, m_resolution, m_resolution, 1, levels),
+			GpuMemory::TEXTURES, "Terrain");
+
+		// Each patch's lowest and highest height, over every texel its
+		//	filtering reaches.
+		unsigned int patches = m_terrain.patches;
+		std::vector<glm::vec2> bounds(patches * patches);
+		int last = (int)m_resolution - 1;
+		for (unsigned int patchRow = 0; patchRow < patches; ++patchRow)
+		{
+			int firstRow = std::max((int)floorf((float)patchRow / patches * m_resolution - 0.5f), 0);
+			int lastRow = std::min((int)ceilf((float)(patchRow + 1) / patches * m_resolution - 0.5f), last);
+			for (unsigned int patchColumn = 0; patchColumn < patches; ++patchColumn)
+			{
+				int firstColumn = std::max((int)floorf((float)patchColumn / patches * m_resolution - 0.5f), 0);
+				int lastColumn = std::min((int)ceilf((float)(patchColumn + 1) / patches * m_resolution - 0.5f), last);
+
+				uint16_t lowest = 0xffff, highest = 0;
+				for (int row = firstRow; row <= lastRow; ++row)
+				{
+					for (int column = firstColumn; column <= lastColumn; ++column)
+					{
+						uint16_t height = m_heights[row * m_resolution + column];
+						lowest = std::min(lowest, height);
+						highest = std::max(highest, height);
+					}
+				}
+				bounds[patchRow * patches + patchColumn] = glm::vec2(lowest, highest) / 65535.0f;
+			}
+		}
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_boundsTexture);
+		glTextureStorage2D(m_boundsTexture, 1, GL_RG32F, patches, patches);
+		glTextureSubImage2D(m_boundsTexture, 0, 0, 0, patches, patches, GL_RG, GL_FLOAT, bounds.data());
+		glTextureParameteri(m_boundsTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_boundsTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		memory.trackTexture(m_boundsTexture, GpuMemory::getTextureBytes(GL_RG32F, patches, patches),
+			GpuMemory::TEXTURES, "Terrain");
+	}
+}
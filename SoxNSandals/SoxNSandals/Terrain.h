@@ -0,0 +1,161 @@
+/**
+	Terrain.h
+
+	Purpose: Terrain.h is the header file for the Terrain class. The
+			Terrain draws the scene's heightfield as a grid of patches,
+			tessellated on the gpu so the triangles stay about the same
+			size on screen however far away the ground is.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SceneDescription.h"
+#include "Shader.h"
+#include <cstdint>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The Terrain class holds a square heightmap and draws it as
+			patches by patches quads, with no vertex buffer, each
+			patch's corners made from its vertex index.
+
+		The tessellation control shader culls each patch against the
+			view with the lowest and highest heights in it, kept in a
+			texture a texel a patch. The patches that are left have
+			each edge cut by how long it is on screen, up to 64 times,
+			so the triangles drawn are bounded by the pixels the
+			terrain covers rather than by how large it is. Neighbours
+			cut their shared edge the same, so there are no cracks.
+
+		The heightmap is read from a .r16 or .raw file, square little
+			endian 16 bit heights, or from any image the textures load
+			as 8 bit grey. Without one it is generated from the
+			seed.
+
+		Tessellation needs GL 4.0 and the textures are made with GL 4.5,
+			without it create fails and there is no terrain. The
+			terrain is lit and shadowed by the first light, but doesn't
+			cast shadows itself.
+	*/
+	class Terrain
+	{
+	public:
+		// The size of a generated heightmap, along each side.
+		static const unsigned int GENERATED_RESOLUTION = 1024;
+
+		Terrain();
+
+		/**
+			The deconstructor deletes the textures and vertex array.
+		*/
+		~Terrain();
+
+		Terrain(const Terrain&) = delete;
+		Terrain& operator=(const Terrain&) = delete;
+
+		/**
+			create loads or generates the heightmap and loads the
+				shader.
+
+				@param1 a_terrain is the scene's terrain.
+
+				@return false without GL 4.5, the shader or a heightmap
+						that can be read, it is left uncreated.
+		*/
+		bool create(const SceneDescription::Terrain& a_terrain);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vao != 0; }
+
+		/**
+			destroy deletes the textures and vertex array.
+		*/
+		void destroy();
+
+		/**
+			getShader returns the terrain's program, to bind the frame's
+				lighting to before draw.
+		*/
+		aie::ShaderProgram& getShader() { return m_shader; }
+
+		/**
+			draw draws the terrain with its shader, which must already
+				be bound.
+
+				@param1 a_viewportHeight is the height of the viewport in
+						pixels, how large the triangles are is measured
+						against.
+		*/
+		void draw(int a_viewportHeight);
+
+		/**
+			getHeight returns the height of the ground, between the
+				heightmap's texels as the gpu filters it.
+
+				@param1 a_x is the world position along X.
+
+				@param2 a_z is the world position along Z.
+
+				@return the world height, or the terrain's position
+						outside it.
+		*/
+		float getHeight(float a_x, float a_z) const;
+
+		/**
+			setTriangleSize sets how many pixels long the edges of the
+				triangles should be.
+
+				@param1 a_pixels is the length, at least 1.
+		*/
+		void setTriangleSize(float a_pixels);
+
+		/**
+			getTriangleSize returns how many pixels long the edges of the
+				triangles should be.
+		*/
+		float getTriangleSize() const { return m_triangleSize; }
+
+	private:
+		/**
+			loadHeightmap reads the heights of a file.
+
+				@param1 a_filename is the file.
+
+				@return false if it can't be read or isn't square.
+		*/
+		bool loadHeightmap(const std::string& a_filename);
+
+		/**
+			generateHeightmap makes up the heights from a seed.
+
+				@param1 a_seed picks the hills.
+
+				@param2 a_flatRadius is how far from the centre it is kept
+						flat, in world units.
+		*/
+		void generateHeightmap(uint32_t a_seed, float a_flatRadius);
+
+		/**
+			createTextures uploads the heights and each patch's bounds.
+		*/
+		void createTextures();
+
+		aie::ShaderProgram m_shader;
+		SceneDescription::Terrain m_terrain;
+
+		// The heights, 0 to 65535 from the lowest to the highest, row
+		//	by row along Z.
+		std::vector<uint16_t> m_heights;
+		unsigned int m_resolution;
+
+		unsigned int m_heightTexture;
+		unsigned int m_boundsTexture;
+		unsigned int m_vao;
+
+		float m_triangleSize;
+	};
+}
@@ -8,19 +8,187 @@
 */
 #include "gl_core_4_5.h"
 #include "Texture.h"
+#include "FileSystem.h"
+#include "GpuMemory.h"
+#include "ImageDecoder.h"
+#include "RenderState.h"
+#include "TextureAtlas.h"
+#include "Trace.h"
+#include <glfw3.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <xmmintrin.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 namespace aie {
 
+// s3tc isn't part of core gl but every desktop driver exposes it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT		0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT	0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	0x83F3
+#endif
+// core in gl 4.6, before that an extension every desktop driver exposes
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY		0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY	0x84FF
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT		0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT	0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT	0x8C4F
+#endif
+
+static bool hasExtension(const char* filename, const char* extension) {
+	size_t length = strlen(filename), extLength = strlen(extension);
+	if (length < extLength)
+		return false;
+	for (size_t i = 0; i < extLength; ++i)
+		if (tolower((unsigned char)filename[length - extLength + i]) != extension[i])
+			return false;
+	return true;
+}
+
+static unsigned int readU32(const unsigned char* data) {
+	unsigned int value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static unsigned long long readU64(const unsigned char* data) {
+	unsigned long long value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+// bytes for one mip level of a block compressed format, or 0 if not supported
+static size_t compressedLevelSize(unsigned int glFormat, unsigned int width, unsigned int height) {
+	size_t blockBytes = 0;
+	switch (glFormat) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		blockBytes = 8;
+		break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		blockBytes = 16;
+		break;
+	default:	return 0;
+	};
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+// channel count reported through getFormat() for a compressed format
+static unsigned int compressedChannels(unsigned int glFormat) {
+	switch (glFormat) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		return Texture::RGB;
+	case GL_COMPRESSED_RG_RGTC2:
+		return Texture::RG;
+	default:	return Texture::RGBA;
+	};
+}
+
+// the layout of uncompressed pixels handed to gl, one byte a channel
+static unsigned int pixelFormat(unsigned int format) {
+	switch (format) {
+	case Texture::RED:	return GL_RED;
+	case Texture::RG:	return GL_RG;
+	case Texture::RGB:	return GL_RGB;
+	default:	return GL_RGBA;
+	};
+}
+
+// the width or height of a mip level
+static unsigned int levelDimension(unsigned int size, unsigned int level) {
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+// gl 4.5 makes textures with immutable storage and edits them by handle,
+// older contexts bind them to unit 0 and specify each level instead
+static bool hasDirectStateAccess() {
+	return ogl_IsVersionGEQ(4, 5) != 0;
+}
+
+// sets a parameter of a 2D texture, which must be bound to the active unit
+// when it wasn't made with direct state access
+static void setParameter(unsigned int texture, bool directStateAccess, unsigned int name, int value) {
+	if (directStateAccess)
+		glTextureParameteri(texture, name, value);
+	else
+		glTexParameteri(GL_TEXTURE_2D, name, value);
+}
+
+static void setParameterf(unsigned int texture, bool directStateAccess, unsigned int name, float value) {
+	if (directStateAccess)
+		glTextureParameterf(texture, name, value);
+	else
+		glTexParameterf(GL_TEXTURE_2D, name, value);
+}
+
+// srgb to linear for each byte, and back from linear in 4096 steps, which
+// is fine enough that no two dark bytes share a step
+struct GammaTables {
+	float toLinear[256];
+	unsigned char toSRGB[4096];
+
+	GammaTables() {
+		for (int i = 0; i < 256; ++i) {
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; ++i) {
+			float c = i / 4095.0f;
+			c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			toSRGB[i] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const GammaTables& gammaTables() {
+	static const GammaTables tables;
+	return tables;
+}
+
+float Texture::s_anisotropy = 8.0f;
+
+// what starts the name of an image packed from others, see getPackedName()
+static const char PACKED_PREFIX[] = "packed:";
+
 Texture::Texture() 
 	: m_filename("none"),
 	m_width(0),
 	m_height(0),
 	m_glHandle(0),
 	m_format(0),
-	m_loadedPixels(nullptr) {
+	m_loadedPixels(nullptr),
+	m_pendingUpload(false),
+	m_residency(GPU_ONLY),
+	m_gpuBytes(0),
+	m_levelCount(0),
+	m_streamed(false),
+	m_residentLevel(0),
+	m_stagingHandle(0),
+	m_stagingLevel(0),
+	m_content(COLOUR),
+	m_placeholder(false),
+	m_atlasCandidate(false),
+	m_inAtlas(false),
+	m_atlasRect{ 0, 0, 1, 1 },
+	m_compressedFormat(0) {
 }
 
 Texture::Texture(const char * filename)
@@ -29,7 +197,21 @@ Texture::Texture(const char * filename)
 	m_height(0),
 	m_glHandle(0),
 	m_format(0),
-	m_loadedPixels(nullptr) {
+	m_loadedPixels(nullptr),
+	m_pendingUpload(false),
+	m_residency(GPU_ONLY),
+	m_gpuBytes(0),
+	m_levelCount(0),
+	m_streamed(false),
+	m_residentLevel(0),
+	m_stagingHandle(0),
+	m_stagingLevel(0),
+	m_content(COLOUR),
+	m_placeholder(false),
+	m_atlasCandidate(false),
+	m_inAtlas(false),
+	m_atlasRect{ 0, 0, 1, 1 },
+	m_compressedFormat(0) {
 
 	load(filename);
 }
@@ -38,112 +220,794 @@ Texture::Texture(unsigned int width, unsigned int height, Format format, unsigne
 	: m_filename("none"),
 	m_width(width),
 	m_height(height),
+	m_glHandle(0),
 	m_format(format),
-	m_loadedPixels(nullptr) {
+	m_loadedPixels(nullptr),
+	m_pendingUpload(false),
+	m_residency(GPU_ONLY),
+	m_gpuBytes(0),
+	m_levelCount(0),
+	m_streamed(false),
+	m_residentLevel(0),
+	m_stagingHandle(0),
+	m_stagingLevel(0),
+	m_content(COLOUR),
+	m_placeholder(false),
+	m_atlasCandidate(false),
+	m_inAtlas(false),
+	m_atlasRect{ 0, 0, 1, 1 },
+	m_compressedFormat(0) {
 
 	create(width, height, format, pixels);
 }
 
 Texture::~Texture() {
-	if (m_glHandle != 0)
-		glDeleteTextures(1, &m_glHandle);
-	if (m_loadedPixels != nullptr)
-		stbi_image_free(m_loadedPixels);
+	releaseHandle();
+	if (m_stagingHandle != 0) {
+		glDeleteTextures(1, &m_stagingHandle);
+		sns::GpuMemory::instance().releaseTexture(m_stagingHandle);
+	}
+	freePixels();
 }
 
 bool Texture::load(const char* filename) {
+	return decode(filename) && upload();
+}
 
-	if (m_glHandle != 0) {
-		glDeleteTextures(1, &m_glHandle);
-		m_glHandle = 0;
-		m_width = 0;
-		m_height = 0;
-		m_filename = "none";
+bool Texture::decode(const char* filename) {
+	SNS_TRACE_ZONE("Texture::decode");
+
+	freePixels();
+	m_pendingUpload = false;
+	m_residentLevel = 0;
+	m_compressedFormat = 0;
+	m_compressedLevelSizes.clear();
+
+	if (strncmp(filename, PACKED_PREFIX, sizeof(PACKED_PREFIX) - 1) == 0)
+		return decodePacked(filename);
+
+	// block compressed containers are read as-is with their prebuilt mips
+	bool isDDS = hasExtension(filename, ".dds");
+	if (isDDS || hasExtension(filename, ".ktx2")) {
+		sns::FileView file;
+		if (sns::FileSystem::instance().open(filename, file) == false)
+			return false;
+
+		bool success = isDDS ? decodeDDS(file.getData(), file.getSize())
+							 : decodeKTX2(file.getData(), file.getSize());
+		if (success == false) {
+			printf("Unsupported compressed texture %s\n", filename);
+			freePixels();
+			m_compressedFormat = 0;
+			m_compressedLevelSizes.clear();
+			return false;
+		}
+
+		m_filename = filename;
+		m_pendingUpload = true;
+		return true;
+	}
+
+	// images are decoded straight from the archive or the mapped file
+	sns::FileView file;
+	if (sns::FileSystem::instance().open(filename, file) == false)
+		return false;
+
+	// by whichever decoder takes the file's signature, the channels are
+	// the formats' numbers
+	sns::ImageDecoder::Info info = {};
+	m_loadedPixels = sns::ImageDecoder::decodeImage(file.getData(), file.getSize(), info);
+
+	if (m_loadedPixels == nullptr)
+		return false;
+
+	m_format = info.channels;
+	m_width = info.width;
+	m_height = info.height;
+	m_filename = filename;
+	m_pendingUpload = true;
+
+	// every level is uploaded from the cpu, so they're made here off the context thread
+	buildMipChain();
+	return true;
+}
+
+std::string Texture::getPackedName(const std::string* channels, unsigned int count) {
+	std::string name = PACKED_PREFIX;
+	for (unsigned int i = 0; i < count && i < 4; ++i) {
+		if (i > 0)
+			name += '|';
+		if (channels[i].empty() == false)
+			name += sns::FileSystem::canonicalise(channels[i]);
+	}
+	return name;
+}
+
+bool Texture::decodePacked(const char* filename) {
+	SNS_TRACE_ZONE("Texture::decodePacked");
+
+	// the sources are only read for their pixels, without mips of their own
+	struct Source {
+		unsigned char*			pixels;
+		sns::ImageDecoder::Info	info;
+	};
+	Source sources[4] = {};
+	std::string names = filename + sizeof(PACKED_PREFIX) - 1;
+	bool success = true;
+	unsigned int width = 0, height = 0;
+	size_t start = 0;
+	for (unsigned int i = 0; i < 4 && start <= names.size() && success; ++i) {
+		size_t end = names.find('|', start);
+		std::string name = names.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		start = end == std::string::npos ? names.size() + 1 : end + 1;
+		if (name.empty())
+			continue;
+
+		sns::FileView file;
+		Source& source = sources[i];
+		if (sns::FileSystem::instance().open(name.c_str(), file))
+			source.pixels = sns::ImageDecoder::decodeImage(file.getData(), file.getSize(), source.info);
+		success = source.pixels != nullptr;
+		if (success == false)
+			printf("Can't pack %s into a texture\n", name.c_str());
+		width = std::max(width, source.info.width);
+		height = std::max(height, source.info.height);
+	}
+
+	// each channel is sampled from the nearest texel of its source
+	if (success && width > 0 && height > 0) {
+		m_loadedPixels = (unsigned char*)STBI_MALLOC((size_t)width * height * 4);
+		for (unsigned int y = 0; y < height; ++y) {
+			unsigned char* row = m_loadedPixels + (size_t)y * width * 4;
+			for (unsigned int c = 0; c < 4; ++c) {
+				const Source& source = sources[c];
+				if (source.pixels == nullptr) {
+					for (unsigned int x = 0; x < width; ++x)
+						row[x * 4 + c] = 0;
+					continue;
+				}
+
+				unsigned int sy = y * source.info.height / height;
+				unsigned int comp = source.info.channels;
+				for (unsigned int x = 0; x < width; ++x) {
+					unsigned int sx = x * source.info.width / width;
+					const unsigned char* texel = source.pixels + ((size_t)sy * source.info.width + sx) * comp;
+					if (comp == RG || comp == RGBA)
+						row[x * 4 + c] = texel[comp - 1];
+					else if (comp == RGB)
+						row[x * 4 + c] = (unsigned char)((texel[0] + texel[1] + texel[2] + 1) / 3);
+					else
+						row[x * 4 + c] = texel[0];
+				}
+			}
+		}
+	}
+	for (auto& source : sources)
+		if (source.pixels != nullptr)
+			stbi_image_free(source.pixels);
+	if (m_loadedPixels == nullptr)
+		return false;
+
+	m_format = RGBA;
+	m_width = width;
+	m_height = height;
+	m_filename = filename;
+	m_pendingUpload = true;
+	buildMipChain();
+	return true;
+}
+
+bool Texture::upload() {
+	SNS_TRACE_GL_ZONE("Texture::upload");
+
+	// a staged upload is reading the pixels this would free
+	if (m_pendingUpload == false || m_stagingHandle != 0)
+		return false;
+	releaseHandle();
+
+	// the mip chain is uploaded level by level, nothing is generated on the
+	// fly. streamed textures start with only the smallest levels
+	m_levelCount = countLevels();
+	if (m_compressedFormat == 0 && m_mipChain.empty() && m_levelCount > 1)
+		buildMipChain();
+
+	// small ones that asked for it are copied into an atlas page instead,
+	// which is counted as the atlas's
+	if (m_atlasCandidate && sns::TextureAtlas::instance().add(*this, m_glHandle, m_atlasRect)) {
+		m_inAtlas = true;
+		m_pendingUpload = false;
+		m_gpuBytes = 0;
+		freePixels();
+		return true;
+	}
+	m_pendingUpload = false;
+	createLevels(m_streamed ? getBaseLevel() : 0, 0, 0);
+
+	// the gpu has its own copy now, streamed textures keep theirs for setResidentLevel()
+	if (m_residency == GPU_ONLY && m_streamed == false)
+		freePixels();
+	return true;
+}
+
+void Texture::setPlaceholder(const char* filename, Content content) {
+
+	freePixels();
+	m_compressedFormat = 0;
+	m_compressedLevelSizes.clear();
+
+	// freed with the decoded pixels, stb_image allocates them with malloc
+	static const unsigned char texels[][4] = {
+		{ 255, 255, 255, 255 },	// COLOUR
+		{ 255, 255, 255, 255 },	// LINEAR_DATA
+		{ 128, 128, 255, 255 },	// NORMAL_MAP
+	};
+	m_loadedPixels = (unsigned char*)malloc(4);
+	memcpy(m_loadedPixels, texels[content], 4);
+
+	m_width = 1;
+	m_height = 1;
+	m_format = RGBA;
+	m_content = content;
+	m_filename = filename;
+	m_pendingUpload = true;
+	m_placeholder = true;
+}
+
+bool Texture::adopt(Texture& decoded) {
+
+	if (m_stagingHandle != 0)
+		return false;
+
+	freePixels();
+	m_width = decoded.m_width;
+	m_height = decoded.m_height;
+	m_format = decoded.m_format;
+	m_loadedPixels = decoded.m_loadedPixels;
+	m_mipChain.swap(decoded.m_mipChain);
+	m_compressedFormat = decoded.m_compressedFormat;
+	m_compressedData.swap(decoded.m_compressedData);
+	m_compressedLevelSizes.swap(decoded.m_compressedLevelSizes);
+	m_pendingUpload = decoded.m_pendingUpload;
+	m_placeholder = false;
+
+	decoded.m_loadedPixels = nullptr;
+	decoded.m_compressedFormat = 0;
+	decoded.m_pendingUpload = false;
+	decoded.freePixels();
+	return true;
+}
+
+bool Texture::beginStagedUpload(unsigned int& firstLevel, unsigned int& lastLevel) {
+
+	if (m_pendingUpload == false || m_stagingHandle != 0 || hasDirectStateAccess() == false)
+		return false;
+
+	// upload() puts those going into the atlas there, it has no staging
+	if (m_atlasCandidate && sns::TextureAtlas::instance().canAdd(*this))
+		return false;
+
+	// the levels upload() would fill
+	m_levelCount = countLevels();
+	if (m_compressedFormat == 0 && m_mipChain.empty() && m_levelCount > 1)
+		buildMipChain();
+	firstLevel = m_streamed ? getBaseLevel() : 0;
+	lastLevel = m_levelCount - 1;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_stagingHandle);
+	glTextureStorage2D(m_stagingHandle, m_levelCount - firstLevel, getInternalFormat(),
+					   levelDimension(m_width, firstLevel), levelDimension(m_height, firstLevel));
+	m_stagingLevel = firstLevel;
+
+	// the staging texture is counted while both it and the old one exist
+	size_t stagingBytes = 0;
+	for (unsigned int i = firstLevel; i < m_levelCount; ++i)
+		stagingBytes += getLevelBytes(i);
+	sns::GpuMemory::instance().trackTexture(m_stagingHandle, stagingBytes, sns::GpuMemory::TEXTURES, "Texture");
+	return true;
+}
+
+void Texture::endStagedUpload() {
+
+	if (m_stagingHandle == 0)
+		return;
+
+	setSampling(m_stagingHandle, true, m_levelCount - m_stagingLevel);
+
+	releaseHandle();
+	m_glHandle = m_stagingHandle;
+	m_residentLevel = m_stagingLevel;
+	m_stagingHandle = 0;
+	m_pendingUpload = false;
+
+	m_gpuBytes = 0;
+	for (unsigned int i = m_residentLevel; i < m_levelCount; ++i)
+		m_gpuBytes += getLevelBytes(i);
+
+	if (m_residency == GPU_ONLY && m_streamed == false)
+		freePixels();
+}
+
+void Texture::setResidency(Residency residency) {
+	m_residency = residency;
+
+	// pixels still waiting for upload() are needed until then, and streamed
+	// textures upload from them for as long as they live
+	if (m_residency == GPU_ONLY && m_pendingUpload == false && m_streamed == false)
+		freePixels();
+}
+
+size_t Texture::getCPUBytes() const {
+	if (m_compressedFormat != 0)
+		return m_compressedData.size();
+	return (m_loadedPixels != nullptr ? (size_t)m_width * m_height * m_format : 0) + m_mipChain.size();
+}
+
+bool Texture::setResidentLevel(unsigned int level) {
+
+	if (m_streamed == false || m_glHandle == 0 || m_pendingUpload)
+		return false;
+
+	if (level >= m_levelCount)
+		level = m_levelCount - 1;
+	if (level == m_residentLevel)
+		return false;
+
+	createLevels(level, m_glHandle, m_residentLevel);
+	return true;
+}
+
+unsigned int Texture::getBaseLevel() const {
+	unsigned int level = 0;
+	while (level + 1 < m_levelCount && (levelDimension(m_width, level) > STREAM_BASE_SIZE ||
+										levelDimension(m_height, level) > STREAM_BASE_SIZE))
+		++level;
+	return level;
+}
+
+size_t Texture::getLevelBytes(unsigned int level) const {
+	if (m_compressedFormat != 0)
+		return level < m_compressedLevelSizes.size() ? m_compressedLevelSizes[level] : 0;
+	return (size_t)levelDimension(m_width, level) * levelDimension(m_height, level) * m_format;
+}
+
+const unsigned char* Texture::getLevelData(unsigned int level) const {
+
+	if (m_compressedFormat != 0) {
+		size_t offset = 0;
+		for (unsigned int i = 0; i < level; ++i)
+			offset += m_compressedLevelSizes[i];
+		return m_compressedData.data() + offset;
 	}
 
-	int x = 0, y = 0, comp = 0;
-	m_loadedPixels = stbi_load(filename, &x, &y, &comp, STBI_default);
+	if (level == 0)
+		return m_loadedPixels;
+
+	size_t offset = 0;
+	for (unsigned int i = 1; i < level; ++i)
+		offset += getLevelBytes(i);
+	return m_mipChain.data() + offset;
+}
+
+void Texture::buildMipChain() {
+
+	std::vector<unsigned char>().swap(m_mipChain);
+	if (m_loadedPixels == nullptr)
+		return;
+
+	// sized once so every level lands straight after the last
+	size_t total = 0;
+	for (unsigned int level = 1; levelDimension(m_width, level - 1) > 1 || levelDimension(m_height, level - 1) > 1; ++level)
+		total += (size_t)levelDimension(m_width, level) * levelDimension(m_height, level) * m_format;
+	m_mipChain.resize(total);
+	if (total == 0)
+		return;
+
+	// colour is averaged as light, so dark and bright texels don't blend
+	// to something too dark. alpha and data channels are left as they are
+	const GammaTables& gamma = gammaTables();
+	unsigned int colourChannels = m_content == COLOUR && m_format >= RGB ? 3 : 0;
+	bool normals = m_content == NORMAL_MAP && m_format >= RGB;
+
+	// levels are filtered from the float level above rather than its bytes,
+	// so rounding doesn't build up down the chain
+	unsigned int w = m_width, h = m_height;
+	std::vector<float> source((size_t)w * h * m_format), target, rows(w * m_format);
+	for (size_t i = 0; i < source.size(); ++i)
+		source[i] = (i % m_format) < colourChannels ? gamma.toLinear[m_loadedPixels[i]] : m_loadedPixels[i] / 255.0f;
+
+	// each level averages 2x2 texels of the one above, clamped at odd edges
+	__m128 half = _mm_set1_ps(0.5f);
+	unsigned char* bytes = m_mipChain.data();
+	while (w > 1 || h > 1) {
+		unsigned int nw = w > 1 ? w / 2 : 1, nh = h > 1 ? h / 2 : 1;
+		size_t rowFloats = (size_t)w * m_format;
+		target.resize((size_t)nw * nh * m_format);
+		for (unsigned int y = 0; y < nh; ++y) {
+
+			// the two rows are averaged four floats at a time, then their
+			// pairs of texels
+			const float* row0 = source.data() + std::min(y * 2, h - 1) * rowFloats;
+			const float* row1 = source.data() + std::min(y * 2 + 1, h - 1) * rowFloats;
+			size_t i = 0;
+			for (; i + 4 <= rowFloats; i += 4)
+				_mm_storeu_ps(rows.data() + i, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(row0 + i), _mm_loadu_ps(row1 + i)), half));
+			for (; i < rowFloats; ++i)
+				rows[i] = (row0[i] + row1[i]) * 0.5f;
+
+			float* out = target.data() + (size_t)y * nw * m_format;
+			for (unsigned int x = 0; x < nw; ++x) {
+				size_t x0 = std::min(x * 2, w - 1) * m_format, x1 = std::min(x * 2 + 1, w - 1) * m_format;
+				for (unsigned int c = 0; c < m_format; ++c)
+					out[x * m_format + c] = (rows[x0 + c] + rows[x1 + c]) * 0.5f;
+
+				// averaged normals are shorter than one, which would dim lighting
+				if (normals) {
+					float* n = out + x * m_format;
+					float nx = n[0] * 2.0f - 1.0f, ny = n[1] * 2.0f - 1.0f, nz = n[2] * 2.0f - 1.0f;
+					float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+					if (length > 0.0001f) {
+						n[0] = nx / length * 0.5f + 0.5f;
+						n[1] = ny / length * 0.5f + 0.5f;
+						n[2] = nz / length * 0.5f + 0.5f;
+					}
+				}
+			}
+		}
+
+		for (size_t i = 0; i < target.size(); ++i) {
+			float value = std::min(std::max(target[i], 0.0f), 1.0f);
+			bytes[i] = (i % m_format) < colourChannels ? gamma.toSRGB[(int)(value * 4095.0f + 0.5f)]
+													   : (unsigned char)(value * 255.0f + 0.5f);
+		}
+		bytes += target.size();
+		source.swap(target);
+		w = nw;
+		h = nh;
+	}
+}
+
+void Texture::createLevels(unsigned int first, unsigned int previous, unsigned int previousFirst) {
+
+	bool dsa = hasDirectStateAccess();
+	unsigned int count = m_levelCount - first;
+	unsigned int handle = 0;
+	if (dsa) {
+		glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+		glTextureStorage2D(handle, count, getInternalFormat(),
+						   levelDimension(m_width, first), levelDimension(m_height, first));
+	}
+	else {
+		glGenTextures(1, &handle);
+		sns::RenderState::instance().bindTexture(0, handle);
+	}
+
+	// rows of the small levels aren't four byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	m_gpuBytes = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		unsigned int level = first + i;
+		unsigned int w = levelDimension(m_width, level), h = levelDimension(m_height, level);
+		int bytes = (int)getLevelBytes(level);
+		const unsigned char* data = getLevelData(level);
+
+		// levels the old texture had are copied without leaving the gpu
+		if (dsa && previous != 0 && level >= previousFirst)
+			glCopyImageSubData(previous, GL_TEXTURE_2D, level - previousFirst, 0, 0, 0,
+							   handle, GL_TEXTURE_2D, i, 0, 0, 0, w, h, 1);
+		else if (m_compressedFormat != 0 && dsa)
+			glCompressedTextureSubImage2D(handle, i, 0, 0, w, h, m_compressedFormat, bytes, data);
+		else if (m_compressedFormat != 0)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, m_compressedFormat, w, h, 0, bytes, data);
+		else if (dsa)
+			glTextureSubImage2D(handle, i, 0, 0, w, h, pixelFormat(m_format), GL_UNSIGNED_BYTE, data);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, pixelFormat(m_format), w, h, 0, pixelFormat(m_format), GL_UNSIGNED_BYTE, data);
+		m_gpuBytes += bytes;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	setSampling(handle, dsa, count);
+	if (dsa == false)
+		sns::RenderState::instance().bindTexture(0, 0);
+
+	if (previous != 0) {
+		glDeleteTextures(1, &previous);
+		sns::RenderState::instance().onTextureDeleted(previous);
+		sns::GpuMemory::instance().releaseTexture(previous);
+	}
+	m_glHandle = handle;
+	sns::GpuMemory::instance().trackTexture(handle, m_gpuBytes, sns::GpuMemory::TEXTURES, "Texture");
+	m_residentLevel = first;
+}
+
+void Texture::setSampling(unsigned int texture, bool directStateAccess, unsigned int count) const {
+	setParameter(texture, directStateAccess, GL_TEXTURE_MAX_LEVEL, count - 1);
+	setParameter(texture, directStateAccess, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	setParameter(texture, directStateAccess, GL_TEXTURE_MIN_FILTER, count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	if (count > 1 && getAnisotropy() > 1.0f)
+		setParameterf(texture, directStateAccess, GL_TEXTURE_MAX_ANISOTROPY, getAnisotropy());
+
+	// two channel normal maps have no blue, so sample it as 1.
+	// lit.frag rebuilds z from x and y
+	if (m_compressedFormat == GL_COMPRESSED_RG_RGTC2)
+		setParameter(texture, directStateAccess, GL_TEXTURE_SWIZZLE_B, GL_ONE);
+}
+
+float Texture::getAnisotropy() {
+
+	// asked once, the driver's limit doesn't change
+	static float supported = 0.0f;
+	if (supported == 0.0f) {
+		supported = 1.0f;
+		if (ogl_IsVersionGEQ(4, 6) || glfwExtensionSupported("GL_ARB_texture_filter_anisotropic") ||
+			glfwExtensionSupported("GL_EXT_texture_filter_anisotropic"))
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &supported);
+	}
+	return std::max(1.0f, std::min(s_anisotropy, supported));
+}
+
+unsigned int Texture::countLevels() const {
+	if (m_compressedFormat != 0)
+		return (unsigned int)m_compressedLevelSizes.size();
+
+	// down to 1x1
+	unsigned int count = 1;
+	while (levelDimension(m_width, count - 1) > 1 || levelDimension(m_height, count - 1) > 1)
+		++count;
+	return count;
+}
+
+unsigned int Texture::getPixelFormat() const {
+	return pixelFormat(m_format);
+}
+
+void Texture::releaseHandle() {
+	if (m_inAtlas) {
+		// the page is the atlas's, only the rectangle is this texture's
+		sns::TextureAtlas::instance().release(this);
+		m_inAtlas = false;
+		m_atlasRect[0] = m_atlasRect[1] = 0.0f;
+		m_atlasRect[2] = m_atlasRect[3] = 1.0f;
+	}
+	else if (m_glHandle != 0) {
+		glDeleteTextures(1, &m_glHandle);
+		sns::RenderState::instance().onTextureDeleted(m_glHandle);
+		sns::GpuMemory::instance().releaseTexture(m_glHandle);
+	}
+	m_glHandle = 0;
+}
 
+void Texture::freePixels() {
 	if (m_loadedPixels != nullptr) {
-		glGenTextures(1, &m_glHandle);
-		glBindTexture(GL_TEXTURE_2D, m_glHandle);
-		switch (comp) {
-		case STBI_grey:
-			m_format = RED;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, x, y,
-						 0, GL_RED, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_grey_alpha:
-			m_format = RG;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, x, y,
-						 0, GL_RG, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb:
-			m_format = RGB;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y,
-						 0, GL_RGB, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb_alpha:
-			m_format = RGBA;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y,
-						 0, GL_RGBA, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
+		stbi_image_free(m_loadedPixels);
+		m_loadedPixels = nullptr;
+	}
+	std::vector<unsigned char>().swap(m_compressedData);
+	std::vector<unsigned char>().swap(m_mipChain);
+}
+
+bool Texture::decodeDDS(const unsigned char* data, size_t size) {
+
+	// "DDS " followed by the 124 byte header
+	if (size < 128 || memcmp(data, "DDS ", 4) != 0)
+		return false;
+
+	const unsigned char* header = data + 4;
+	unsigned int height = readU32(header + 8);
+	unsigned int width = readU32(header + 12);
+	unsigned int flags = readU32(header + 4);
+	unsigned int levelCount = (flags & 0x20000) ? readU32(header + 24) : 1;
+	unsigned int pixelFlags = readU32(header + 76);
+	const unsigned char* fourCC = header + 80;
+	size_t offset = 128;
+
+	if ((pixelFlags & 0x4) == 0)	// DDPF_FOURCC, only compressed files are supported
+		return false;
+
+	unsigned int glFormat = 0;
+	if (memcmp(fourCC, "DXT1", 4) == 0)
+		glFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	else if (memcmp(fourCC, "DXT5", 4) == 0)
+		glFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	else if (memcmp(fourCC, "ATI2", 4) == 0 || memcmp(fourCC, "BC5U", 4) == 0)
+		glFormat = GL_COMPRESSED_RG_RGTC2;
+	else if (memcmp(fourCC, "DX10", 4) == 0) {
+		// the dx10 header follows with a dxgi format
+		if (size < 148)
+			return false;
+		switch (readU32(data + 128)) {
+		case 71:	glFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;		break;
+		case 72:	glFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;	break;
+		case 77:	glFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;		break;
+		case 78:	glFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;	break;
+		case 83:	glFormat = GL_COMPRESSED_RG_RGTC2;					break;
+		case 98:	glFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;			break;
+		case 99:	glFormat = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;		break;
 		default:	break;
 		};
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		m_width = (unsigned int)x;
-		m_height = (unsigned int)y;
-		m_filename = filename;
-		return true;
+		offset = 148;
 	}
-	return false;
+
+	if (glFormat == 0 || width == 0 || height == 0)
+		return false;
+	if (levelCount == 0)
+		levelCount = 1;
+
+	// levels are stored largest first, one after another
+	size_t total = 0;
+	unsigned int w = width, h = height;
+	for (unsigned int i = 0; i < levelCount; ++i) {
+		size_t levelSize = compressedLevelSize(glFormat, w, h);
+		if (offset + total + levelSize > size)
+			return false;
+		m_compressedLevelSizes.push_back((unsigned int)levelSize);
+		total += levelSize;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+
+	m_compressedData.assign(data + offset, data + offset + total);
+	m_compressedFormat = glFormat;
+	m_width = width;
+	m_height = height;
+	m_format = compressedChannels(glFormat);
+	return true;
 }
 
-void Texture::create(unsigned int width, unsigned int height, Format format, unsigned char* pixels) {
+bool Texture::decodeKTX2(const unsigned char* data, size_t size) {
+
+	static const unsigned char identifier[12] = {
+		0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+	};
+
+	// identifier, 9 header fields, then the 32 byte index
+	if (size < 80 || memcmp(data, identifier, 12) != 0)
+		return false;
+
+	unsigned int vkFormat = readU32(data + 12);
+	unsigned int width = readU32(data + 20);
+	unsigned int height = readU32(data + 24);
+	unsigned int depth = readU32(data + 28);
+	unsigned int layerCount = readU32(data + 32);
+	unsigned int faceCount = readU32(data + 36);
+	unsigned int levelCount = readU32(data + 40);
+	unsigned int supercompression = readU32(data + 44);
+
+	// only plain 2d textures without supercompression
+	if (depth > 1 || layerCount > 1 || faceCount != 1 || supercompression != 0)
+		return false;
+
+	unsigned int glFormat = 0;
+	switch (vkFormat) {
+	case 131:	glFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;			break;
+	case 132:	glFormat = GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;		break;
+	case 133:	glFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;		break;
+	case 134:	glFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;	break;
+	case 137:	glFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;		break;
+	case 138:	glFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;	break;
+	case 141:	glFormat = GL_COMPRESSED_RG_RGTC2;					break;
+	case 145:	glFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;			break;
+	case 146:	glFormat = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;		break;
+	default:	break;
+	};
+
+	if (glFormat == 0 || width == 0 || height == 0)
+		return false;
+	if (levelCount == 0)
+		levelCount = 1;
+
+	// the level index follows the header, level 0 is the largest
+	const unsigned char* levelIndex = data + 80;
+	if (80 + (size_t)levelCount * 24 > size)
+		return false;
+
+	unsigned int w = width, h = height;
+	for (unsigned int i = 0; i < levelCount; ++i) {
+		unsigned long long offset = readU64(levelIndex + i * 24);
+		unsigned long long length = readU64(levelIndex + i * 24 + 8);
+		if (length != compressedLevelSize(glFormat, w, h) || offset + length > size)
+			return false;
+
+		m_compressedData.insert(m_compressedData.end(), data + offset, data + offset + length);
+		m_compressedLevelSizes.push_back((unsigned int)length);
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+
+	m_compressedFormat = glFormat;
+	m_width = width;
+	m_height = height;
+	m_format = compressedChannels(glFormat);
+	return true;
+}
+
+void Texture::create(unsigned int width, unsigned int height, Format format, unsigned char* pixels,
+					 bool mipmaps, Content content) {
 
 	if (m_glHandle != 0) {
-		glDeleteTextures(1, &m_glHandle);
-		m_glHandle = 0;
+		releaseHandle();
 		m_filename = "none";
 	}
 
+	// the pixels passed in belong to the caller, so nothing is kept on the cpu
+	freePixels();
+	m_pendingUpload = false;
+	m_streamed = false;
+	m_residentLevel = 0;
+	m_compressedFormat = 0;
+	m_compressedLevelSizes.clear();
+
 	m_width = width;
 	m_height = height;
 	m_format = format;
+	m_content = content;
+	bool dsa = hasDirectStateAccess();
+
+	if (mipmaps && pixels != nullptr && getInternalFormat() != 0) {
+		// the caller's pixels are only borrowed to build the chain from
+		m_loadedPixels = pixels;
+		m_levelCount = countLevels();
+		buildMipChain();
+		createLevels(0, 0, 0);
+		m_loadedPixels = nullptr;
+		std::vector<unsigned char>().swap(m_mipChain);
+
+		if (dsa == false)
+			sns::RenderState::instance().bindTexture(0, m_glHandle);
+		setParameter(m_glHandle, dsa, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		setParameter(m_glHandle, dsa, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		if (dsa == false)
+			sns::RenderState::instance().bindTexture(0, 0);
+		return;
+	}
 
-	glGenTextures(1, &m_glHandle);
-	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	// create() has always stored RGBA for formats it doesn't know
+	unsigned int internalFormat = getInternalFormat() != 0 ? getInternalFormat() : GL_RGBA8;
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	if (dsa) {
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_glHandle);
+		glTextureStorage2D(m_glHandle, 1, internalFormat, m_width, m_height);
+		if (pixels != nullptr)
+			glTextureSubImage2D(m_glHandle, 0, 0, 0, m_width, m_height,
+								pixelFormat(m_format), GL_UNSIGNED_BYTE, pixels);
+	}
+	else {
+		glGenTextures(1, &m_glHandle);
+		sns::RenderState::instance().bindTexture(0, m_glHandle);
+		glTexImage2D(GL_TEXTURE_2D, 0, pixelFormat(m_format), m_width, m_height,
+					 0, pixelFormat(m_format), GL_UNSIGNED_BYTE, pixels);
+	}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	setParameter(m_glHandle, dsa, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	setParameter(m_glHandle, dsa, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	setParameter(m_glHandle, dsa, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	setParameter(m_glHandle, dsa, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	if (dsa == false)
+		sns::RenderState::instance().bindTexture(0, 0);
+	m_gpuBytes = (size_t)m_width * m_height * m_format;
+	m_levelCount = 1;
+	sns::GpuMemory::instance().trackTexture(m_glHandle, m_gpuBytes, sns::GpuMemory::TEXTURES, "Texture");
+}
 
+unsigned int Texture::getInternalFormat() const {
+
+	if (m_compressedFormat != 0)
+		return m_compressedFormat;
+
+	// uncompressed textures are stored as eight bits a channel, sized for immutable storage
 	switch (m_format) {
-	case RED:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
-		break;
-	case RG:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, m_width, m_height, 0, GL_RG, GL_UNSIGNED_BYTE, pixels);
-		break;
-	case RGB:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-		break;
-	case RGBA:
-	default:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	case RED:	return GL_R8;
+	case RG:	return GL_RG8;
+	case RGB:	return GL_RGB8;
+	case RGBA:	return GL_RGBA8;
+	default:	return 0;
 	};
-
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::bind(unsigned int slot) const {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	sns::RenderState::instance().bindTexture(slot, m_glHandle);
 }
 
 } // namespace aie
\ No newline at end of file
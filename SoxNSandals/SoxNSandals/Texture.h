@@ -9,6 +9,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace aie {
 
@@ -23,16 +24,151 @@ public:
 		RGBA
 	};
 
+	// what happens to the decoded pixels once they are on the gpu
+	enum Residency : unsigned int {
+		GPU_ONLY,		// pixels are freed after upload, getPixels() returns nullptr
+		KEEP_CPU_COPY,	// pixels stay in memory for readback through getPixels()
+	};
+
+	// what an image holds, which decides how its mip chain is filtered
+	enum Content : unsigned int {
+		COLOUR,			// srgb colour, averaged as linear light. alpha, and images of one or two channels, are averaged as they are
+		LINEAR_DATA,	// masks, heights and other data, averaged as they are
+		NORMAL_MAP,		// tangent space normals, averaged then renormalised
+	};
+
 	Texture();
 	Texture(const char* filename);
 	Texture(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
 	virtual ~Texture();
 
-	// load a jpg, bmp, png or tga
+	// the texture deletes its gl handle and pixels, it can't be copied.
+	// the handle stays a plain name, an atlased texture's is its page's
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	// load a jpg, bmp, png or tga, or a block compressed dds or ktx2
 	bool load(const char* filename);
 
-	// creates a texture that can be filled in with pixels
-	void create(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
+	// decodes a jpg, bmp, png or tga into cpu memory without touching opengl,
+	// or reads the mip chain of a BC1, BC3, BC5 or BC7 dds / ktx2 file,
+	// so it can be called from a worker thread. images have their mip chain
+	// box filtered here too, by their content. upload() must be called on
+	// the context thread afterwards to create the texture
+	bool decode(const char* filename);
+
+	// the name of an image packed from up to four others, each giving one
+	// channel of it in order. a file with alpha gives its alpha, a colour
+	// one the average of its colour and a grey one its grey, an empty
+	// name leaves its channel 0. the channels are sampled at the size of
+	// the largest. decode() takes the name as it would a file's, so
+	// packed images are shared, streamed and stood in for like any other.
+	// compressed files can't be packed
+	static std::string getPackedName(const std::string* channels, unsigned int count);
+
+	// uploads every level from a previous decode() and creates the opengl
+	// texture, nothing is generated by the driver
+	bool upload();
+
+	// COLOUR by default, set before decode()
+	void setContent(Content content) { m_content = content; }
+	Content getContent() const { return m_content; }
+
+	// the anisotropic filtering every mipmapped texture is given as it is
+	// uploaded, 8 by default and 1 for none. getAnisotropy() returns what
+	// is used, limited to what the driver supports, so needs a context
+	static void setAnisotropy(float anisotropy) { s_anisotropy = anisotropy; }
+	static float getAnisotropy();
+
+	// true if decode() has pixels waiting for upload()
+	bool isPendingUpload() const { return m_pendingUpload; }
+
+	// stands a single texel in for a file without reading it, white or a
+	// flat normal by content so materials draw their own colours, until
+	// adopt() is given the file decoded. upload() it as if it were decoded
+	void setPlaceholder(const char* filename, Content content);
+	bool isPlaceholder() const { return m_placeholder; }
+
+	// takes the levels another texture decoded, and not yet uploaded, in
+	// place of this one's, leaving it empty. the handle stays the
+	// placeholder's until upload() or a staged upload replaces it, so
+	// everything sharing the texture draws the file from then on. returns
+	// false while a staged upload runs
+	bool adopt(Texture& decoded);
+
+	// the two halves of a staged upload, for sns::TextureUploader. with
+	// gl 4.5, beginStagedUpload() makes the storage upload() would without
+	// putting it in use, and gives the levels that are to be copied into
+	// getStagingHandle(). endStagedUpload() puts the texture in use. begin returns false when nothing is
+	// pending or there is no direct state access, and upload() is
+	// needed instead. upload() does nothing while a staged upload runs
+	bool beginStagedUpload(unsigned int& firstLevel, unsigned int& lastLevel);
+	void endStagedUpload();
+	unsigned int getStagingHandle() const { return m_stagingHandle; }
+
+	// asks upload() to copy the texture into a page of sns::TextureAtlas
+	// when small enough, its handle then being the page's. only for
+	// textures every user samples through getAtlasRect(), see atlas.glsl.
+	// set before upload()
+	void setAtlasCandidate(bool candidate) { m_atlasCandidate = candidate; }
+	bool isAtlasCandidate() const { return m_atlasCandidate; }
+
+	// true if the texture is in an atlas page. its rectangle there is the
+	// bottom left corner then the size in uvs, the whole texture if not
+	bool isInAtlas() const { return m_inAtlas; }
+	const float* getAtlasRect() const { return m_atlasRect; }
+
+	// true if the texture came from a block compressed file. compressed
+	// textures have no pixels for getPixels(), only their blocks
+	bool isCompressed() const { return m_compressedFormat != 0; }
+
+	// textures are GPU_ONLY by default. set KEEP_CPU_COPY before upload() to
+	// keep the pixels; switching back to GPU_ONLY frees them if already uploaded
+	void setResidency(Residency residency);
+	Residency getResidency() const { return m_residency; }
+
+	// memory accounting, in bytes. the gpu size includes the mipmap chain,
+	// only the resident levels of it when streamed
+	size_t getCPUBytes() const;
+	size_t getGPUBytes() const { return m_gpuBytes; }
+
+	// streamed textures keep their whole mip chain on the cpu, whatever the
+	// residency, and upload() only puts the levels from getBaseLevel() on
+	// the gpu. setResidentLevel() brings finer levels in and drops them
+	// again. set before decode()
+	void setStreamed(bool streamed) { m_streamed = streamed; }
+	bool isStreamed() const { return m_streamed; }
+
+	// recreates the gpu texture holding only the levels from level on, 0
+	// for all of them. the levels it already had are copied on the gpu and
+	// the rest uploaded. returns false if nothing changed or the texture
+	// isn't streamed. the handle changes, so this is best done before
+	// anything is drawn with it in a frame
+	bool setResidentLevel(unsigned int level);
+	unsigned int getResidentLevel() const { return m_residentLevel; }
+
+	// the first level no larger than STREAM_BASE_SIZE, which streamed
+	// textures are uploaded from and never drop below
+	unsigned int getBaseLevel() const;
+
+	// the gpu bytes of one level of the mip chain
+	size_t getLevelBytes(unsigned int level) const;
+
+	// a level of the cpu mip chain, from the compressed chain, the decoded
+	// pixels or the levels built from them. null once freed
+	const unsigned char* getLevelData(unsigned int level) const;
+
+	// the gl layout of uncompressed pixels, GL_RED to GL_RGBA
+	unsigned int getPixelFormat() const;
+
+	// the widest a streamed texture's base level can be
+	static const unsigned int STREAM_BASE_SIZE = 64;
+
+	// creates a texture that can be filled in with pixels. with mipmaps the
+	// pixels given are filtered into a mip chain by content, as decode()
+	// does, and the texture is sampled through it rather than nearest
+	void create(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr,
+				bool mipmaps = false, Content content = COLOUR);
 
 	// returns the filename or "none" if not loaded from a file
 	const std::string& getFilename() const { return m_filename; }
@@ -46,16 +182,74 @@ public:
 	unsigned int getWidth() const { return m_width; }
 	unsigned int getHeight() const { return m_height; }
 	unsigned int getFormat() const { return m_format; }
+
+	// the sized opengl format the texture is stored as, and how many mip
+	// levels it has. textures matching in both, and in size, can be copied
+	// into the same texture array
+	unsigned int getInternalFormat() const;
+	unsigned int getLevelCount() const { return m_levelCount; }
 	const unsigned char* getPixels() const { return m_loadedPixels; }
 
 protected:
 
+	void freePixels();
+
+	// deletes the texture, or gives back its rectangle of an atlas page
+	void releaseHandle();
+
+	// how many levels the decoded image or compressed chain has
+	unsigned int countLevels() const;
+
+	// sets the filters and swizzle of a texture with count levels
+	void setSampling(unsigned int texture, bool directStateAccess, unsigned int count) const;
+
+	// box filters the decoded pixels down to 1x1 into m_mipChain, in linear
+	// light for colour and renormalised for normal maps
+	void buildMipChain();
+
+	// makes the gpu texture from the levels from first on, copying those
+	// the previous texture had from its previousFirst on, then deletes it
+	void createLevels(unsigned int first, unsigned int previous, unsigned int previousFirst);
+
+	// container parsers for decode(), these fill in the compressed mip chain
+	bool decodeDDS(const unsigned char* data, size_t size);
+	bool decodeKTX2(const unsigned char* data, size_t size);
+
+	// decodes the images of a getPackedName() name and packs them
+	bool decodePacked(const char* filename);
+
 	std::string		m_filename;
 	unsigned int	m_width;
 	unsigned int	m_height;
 	unsigned int	m_glHandle;
 	unsigned int	m_format;
 	unsigned char*	m_loadedPixels;
+	bool			m_pendingUpload;
+	Residency		m_residency;
+	size_t			m_gpuBytes;
+	unsigned int	m_levelCount;
+
+	// levels 1 and on of an image are packed one after another
+	bool						m_streamed;
+	unsigned int				m_residentLevel;
+	std::vector<unsigned char>	m_mipChain;
+
+	// the texture a staged upload fills, and the level its first level is
+	unsigned int				m_stagingHandle;
+	unsigned int				m_stagingLevel;
+
+	Content						m_content;
+	bool						m_placeholder;
+	static float				s_anisotropy;
+
+	bool						m_atlasCandidate;
+	bool						m_inAtlas;
+	float						m_atlasRect[4];
+
+	// block compressed mip chain, levels are packed one after another
+	unsigned int				m_compressedFormat;
+	std::vector<unsigned char>	m_compressedData;
+	std::vector<unsigned int>	m_compressedLevelSizes;
 };
 
 } // namespace aie
\ No newline at end of file
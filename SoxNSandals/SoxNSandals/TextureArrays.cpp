@@ -0,0 +1,165 @@
+/**
+	TextureArrays.cpp
+
+	Purpose: TextureArrays.cpp is the source file for the TextureArrays
+			class. The TextureArrays copy many textures into a few
+			texture arrays, so a shader picks a texture by its layer
+			instead of the texture being bound.
+
+	@author Nathan Nette
+*/
+#include "TextureArrays.h"
+#include "GpuMemory.h"
+#include "Texture.h"
+#include "gl_core_4_5.h"
+
+// Core in GL 4.6, Texture.cpp has the same.
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+
+namespace sns
+{
+	TextureArrays::TextureArrays()
+	{
+	}
+
+	/**
+		The deconstructor deletes the arrays.
+	*/
+	TextureArrays::~TextureArrays()
+	{
+		destroy();
+	}
+
+	/**
+		add gives a texture a layer. Adding a texture again returns the
+			layer it already has.
+
+			@param1 a_texture is an uploaded texture, or null.
+
+			@return the array and layer it will be copied into, -1 in
+					both for null or a texture in an atlas page.
+	*/
+	TextureArrays::Location TextureArrays::add(aie::Texture* a_texture)
+	{
+		// A page holds many textures, copying it would copy them all.
+		if (a_texture == nullptr || a_texture->getHandle() == 0 || a_texture->isInAtlas())
+			return { -1, -1 };
+
+		auto found = m_locations.find(a_texture);
+		if (found != m_locations.end())
+			return found->second;
+
+		// The last array of a kind is the only one that can have room.
+		unsigned int format = a_texture->getInternalFormat();
+		int array = -1;
+		for (int i = (int)m_arrays.size() - 1; i >= 0; --i)
+		{
+			const Array& candidate = m_arrays[i];
+			if (candidate.width == a_texture->getWidth() && candidate.height == a_texture->getHeight() &&
+				candidate.format == format && candidate.levels == a_texture->getLevelCount())
+			{
+				if (candidate.textures.size() < MAX_LAYERS)
+					array = i;
+				break;
+			}
+		}
+
+		if (array < 0)
+		{
+			array = (int)m_arrays.size();
+			m_arrays.push_back({ a_texture->getWidth(), a_texture->getHeight(), format,
+				a_texture->getLevelCount(), {}, 0 });
+		}
+
+		Location location = { array, (int)m_arrays[array].textures.size() };
+		m_arrays[array].textures.push_back(a_texture);
+		m_locations[a_texture] = location;
+		return location;
+	}
+
+	/**
+		build creates the arrays and copies every added texture into
+			its layer. Streamed textures are made fully resident for the
+			copy, then put back how they were.
+	*/
+	void TextureArrays::build()
+	{
+		destroy();
+		for (Array& array : m_arrays)
+		{
+			glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array.handle);
+			glTextureStorage3D(array.handle, array.levels, array.format,
+				array.width, array.height, (int)array.textures.size());
+			GpuMemory::instance().trackTexture(array.handle, GpuMemory::getTextureBytes(array.format, array.width,
+				array.height, (unsigned int)array.textures.size(), array.levels), GpuMemory::TEXTURES, "TextureArrays");
+			glTextureParameteri(array.handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(array.handle, GL_TEXTURE_MIN_FILTER,
+				array.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			if (array.levels > 1 && aie::Texture::getAnisotropy() > 1.0f)
+				glTextureParameterf(array.handle, GL_TEXTURE_MAX_ANISOTROPY, aie::Texture::getAnisotropy());
+
+			// Matches the swizzle Texture gives two channel normal maps.
+			if (array.format == GL_COMPRESSED_RG_RGTC2)
+				glTextureParameteri(array.handle, GL_TEXTURE_SWIZZLE_B, GL_ONE);
+
+			// Every level of every texture, copied on the gpu.
+			for (unsigned int layer = 0; layer < (unsigned int)array.textures.size(); ++layer)
+			{
+				aie::Texture* texture = array.textures[layer];
+				unsigned int residentLevel = texture->getResidentLevel();
+				texture->setResidentLevel(0);
+
+				unsigned int width = array.width;
+				unsigned int height = array.height;
+				for (unsigned int level = 0; level < array.levels; ++level)
+				{
+					glCopyImageSubData(texture->getHandle(), GL_TEXTURE_2D, level, 0, 0, 0,
+						array.handle, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1);
+					width = width > 1 ? width / 2 : 1;
+					height = height > 1 ? height / 2 : 1;
+				}
+
+				// The array has its own copy, the streamer can bring the
+				//	levels back if the texture is drawn on its own too.
+				texture->setResidentLevel(residentLevel);
+			}
+		}
+	}
+
+	/**
+		bind binds one of the arrays to a texture unit.
+
+			@param1 a_array is the array from a Location.
+
+			@param2 a_unit is the texture unit, starting from 0.
+	*/
+	void TextureArrays::bind(unsigned int a_array, unsigned int a_unit) const
+	{
+		glBindTextureUnit(a_unit, m_arrays[a_array].handle);
+	}
+
+	/**
+		clear deletes the arrays and forgets every texture.
+	*/
+	void TextureArrays::clear()
+	{
+		destroy();
+		m_arrays.clear();
+		m_locations.clear();
+	}
+
+	/**
+		destroy deletes the gl arrays but keeps the layers.
+	*/
+	void TextureArrays::destroy()
+	{
+		for (Array& array : m_arrays)
+		{
+			glDeleteTextures(1, &array.handle);
+			GpuMemory::instance().releaseTexture(array.handle);
+			array.handle = 0;
+		}
+	}
+}
@@ -0,0 +1,112 @@
+/**
+	TextureArrays.h
+
+	Purpose: TextureArrays.h is the header file for the TextureArrays
+			class. The TextureArrays copy many textures into a few
+			texture arrays, so a shader picks a texture by its layer
+			instead of the texture being bound.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+namespace aie
+{
+	class Texture;
+}
+
+namespace sns
+{
+	/**
+		The TextureArrays class sorts the textures added to it by size,
+			format and mip count. Textures matching in all three share
+			a GL_TEXTURE_2D_ARRAY, each in its own layer, and build
+			copies them in on the gpu with glCopyImageSubData.
+
+		The arrays are bound with glBindTextureUnit, which leaves the
+			GL_TEXTURE_2D bindings the RenderState keeps track of alone.
+	*/
+	class TextureArrays
+	{
+	public:
+		// The fewest layers an array can have in GL 4.x. Arrays holding
+		//	this many are followed by another of the same kind.
+		static const unsigned int MAX_LAYERS = 256;
+
+		/**
+			Where a texture ended up, -1 in both for no texture.
+		*/
+		struct Location
+		{
+			int array;
+			int layer;
+		};
+
+		TextureArrays();
+
+		/**
+			The deconstructor deletes the arrays.
+		*/
+		~TextureArrays();
+
+		TextureArrays(const TextureArrays&) = delete;
+		TextureArrays& operator=(const TextureArrays&) = delete;
+
+		/**
+			add gives a texture a layer. Adding a texture again returns the
+				layer it already has.
+
+				@param1 a_texture is an uploaded texture, or null.
+
+				@return the array and layer it will be copied into, -1
+						in both for null or a texture in an atlas page.
+		*/
+		Location add(aie::Texture* a_texture);
+
+		/**
+			build creates the arrays and copies every added texture into
+				its layer. Streamed textures are made fully resident for
+				the copy, then put back how they were.
+		*/
+		void build();
+
+		/**
+			bind binds one of the arrays to a texture unit.
+
+				@param1 a_array is the array from a Location.
+
+				@param2 a_unit is the texture unit, starting from 0.
+		*/
+		void bind(unsigned int a_array, unsigned int a_unit) const;
+
+		/**
+			getArrayCount returns how many arrays the textures needed.
+		*/
+		unsigned int getArrayCount() const { return (unsigned int)m_arrays.size(); }
+
+		/**
+			clear deletes the arrays and forgets every texture.
+		*/
+		void clear();
+
+	private:
+		// Textures sharing a size, format and mip count, in layer order.
+		struct Array
+		{
+			unsigned int width;
+			unsigned int height;
+			unsigned int format;
+			unsigned int levels;
+			std::vector<aie::Texture*> textures;
+			unsigned int handle;
+		};
+
+		// Deletes the gl arrays but keeps the layers.
+		void destroy();
+
+		std::vector<Array> m_arrays;
+		std::unordered_map<const aie::Texture*, Location> m_locations;
+	};
+}
@@ -0,0 +1,224 @@
+/**
+	TextureAtlas.cpp
+
+	Purpose: TextureAtlas.cpp is the source file for the TextureAtlas
+			class. The TextureAtlas packs small textures into a few
+			shared pages, so the materials using them bind one texture
+			between them instead of one each.
+
+	@author Nathan Nette
+*/
+#include "TextureAtlas.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "Texture.h"
+#include "gl_core_4_5.h"
+
+namespace sns
+{
+	// The grid textures are placed on, the size of a texel of the last
+	//	level.
+	static const unsigned int GRID = 1 << (TextureAtlas::LEVEL_COUNT - 1);
+
+	TextureAtlas& TextureAtlas::instance()
+	{
+		static TextureAtlas atlas;
+		return atlas;
+	}
+
+	TextureAtlas::TextureAtlas()
+		: m_maxSize(128)
+	{
+	}
+
+	/**
+		canAdd returns whether add would take a texture, going by its size
+			and format alone.
+
+			@param1 a_texture is a decoded texture pending upload.
+	*/
+	bool TextureAtlas::canAdd(const aie::Texture& a_texture) const
+	{
+		unsigned int width = a_texture.getWidth(), height = a_texture.getHeight();
+		if (a_texture.isPendingUpload() == false || a_texture.isCompressed() || a_texture.isStreamed() ||
+			a_texture.isPlaceholder() || a_texture.getResidency() != aie::Texture::GPU_ONLY)
+		{
+			return false;
+		}
+		return width <= m_maxSize && height <= m_maxSize && width >= GRID && height >= GRID &&
+			width % GRID == 0 && height % GRID == 0 && ogl_IsVersionGEQ(4, 5) != 0;
+	}
+
+	/**
+		add copies a texture's levels into a page.
+
+			@param1 a_texture is a decoded texture pending upload.
+
+			@param2 a_page is set to the GL handle of its page.
+
+			@param3 a_rect is set to where it is in the page, the bottom
+					left corner in the first two and the size in the last
+					two, in UVs.
+
+			@return false if it can't be packed, it is left as it was.
+	*/
+	bool TextureAtlas::add(const aie::Texture& a_texture, unsigned int& a_page, float a_rect[4])
+	{
+		if (canAdd(a_texture) == false)
+			return false;
+		release(&a_texture);
+
+		// Its levels below the first are filtered from its own pixels, so
+		//	it needs as many as the pages have.
+		for (unsigned int level = 1; level < LEVEL_COUNT; ++level)
+		{
+			if (a_texture.getLevelData(level) == nullptr)
+				return false;
+		}
+
+		Slot slot = allocate(a_texture.getWidth() + PADDING * 2, a_texture.getHeight() + PADDING * 2);
+		copy(a_texture, slot);
+		m_slots[&a_texture] = slot;
+
+		a_page = m_pages[slot.page].texture;
+		a_rect[0] = (float)(slot.x + PADDING) / PAGE_SIZE;
+		a_rect[1] = (float)(slot.y + PADDING) / PAGE_SIZE;
+		a_rect[2] = (float)a_texture.getWidth() / PAGE_SIZE;
+		a_rect[3] = (float)a_texture.getHeight() / PAGE_SIZE;
+		return true;
+	}
+
+	/**
+		release gives back the rectangle of a texture, doing nothing if it
+			has none.
+
+			@param1 a_texture is the texture.
+	*/
+	void TextureAtlas::release(const aie::Texture* a_texture)
+	{
+		auto found = m_slots.find(a_texture);
+		if (found == m_slots.end())
+			return;
+		m_freeSlots.push_back(found->second);
+		m_slots.erase(found);
+	}
+
+	/**
+		destroy deletes every page, before the context is.
+	*/
+	void TextureAtlas::destroy()
+	{
+		RenderState& state = RenderState::instance();
+		for (const Page& page : m_pages)
+		{
+			glDeleteTextures(1, &page.texture);
+			state.onTextureDeleted(page.texture);
+			GpuMemory::instance().releaseTexture(page.texture);
+		}
+		m_pages.clear();
+		m_freeSlots.clear();
+		m_slots.clear();
+	}
+
+	/**
+		allocate finds room for a slot, in a slot given back, on a shelf
+			or on a new shelf, making a page if none has room.
+
+			@param1 a_width is the width in texels, a multiple of GRID.
+
+			@param2 a_height is its height.
+
+			@return the slot.
+	*/
+	TextureAtlas::Slot TextureAtlas::allocate(unsigned int a_width, unsigned int a_height)
+	{
+		// The first given back that it fits, ahead of new room, so pages
+		//	don't grow as textures come and go.
+		for (size_t i = 0; i < m_freeSlots.size(); ++i)
+		{
+			Slot slot = m_freeSlots[i];
+			if (slot.width >= a_width && slot.height >= a_height)
+			{
+				m_freeSlots[i] = m_freeSlots.back();
+				m_freeSlots.pop_back();
+				return slot;
+			}
+		}
+
+		// A shelf as tall and no more than twice as tall, so short
+		//	textures don't take the tall shelves.
+		for (unsigned int p = 0; p < (unsigned int)m_pages.size(); ++p)
+		{
+			Page& page = m_pages[p];
+			for (Shelf& shelf : page.shelves)
+			{
+				if (shelf.height >= a_height && shelf.height <= a_height * 2 &&
+					PAGE_SIZE - shelf.used >= a_width)
+				{
+					Slot slot = { p, shelf.used, shelf.y, a_width, shelf.height };
+					shelf.used += a_width;
+					return slot;
+				}
+			}
+			if (PAGE_SIZE - page.top >= a_height)
+			{
+				page.shelves.push_back({ page.top, a_height, a_width });
+				page.top += a_height;
+				return { p, 0, page.shelves.back().y, a_width, a_height };
+			}
+		}
+
+		Page page = {};
+		glCreateTextures(GL_TEXTURE_2D, 1, &page.texture);
+		glTextureStorage2D(page.texture, LEVEL_COUNT, GL_RGBA8, PAGE_SIZE, PAGE_SIZE);
+		glTextureParameteri(page.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(page.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		GpuMemory::instance().trackTexture(page.texture,
+			GpuMemory::getTextureBytes(GL_RGBA8, PAGE_SIZE, PAGE_SIZE, 1, LEVEL_COUNT), GpuMemory::TEXTURES,
+			"TextureAtlas");
+		page.shelves.push_back({ 0, a_height, a_width });
+		page.top = a_height;
+		m_pages.push_back(page);
+		return { (unsigned int)m_pages.size() - 1, 0, 0, a_width, a_height };
+	}
+
+	/**
+		copy copies each level of a texture into its slot, surrounded by
+			the texels of its opposite edges, as RGBA. Missing channels
+			are 0 and a missing alpha 1, as GL samples them.
+
+			@param1 a_texture is the texture.
+
+			@param2 a_slot is where it goes.
+	*/
+	void TextureAtlas::copy(const aie::Texture& a_texture, const Slot& a_slot)
+	{
+		unsigned int channels = a_texture.getFormat();
+		unsigned int page = m_pages[a_slot.page].texture;
+		for (unsigned int level = 0; level < LEVEL_COUNT; ++level)
+		{
+			unsigned int width = a_texture.getWidth() >> level, height = a_texture.getHeight() >> level;
+			unsigned int padding = PADDING >> level;
+			unsigned int paddedWidth = width + padding * 2, paddedHeight = height + padding * 2;
+			const unsigned char* source = a_texture.getLevelData(level);
+
+			m_scratch.resize((size_t)paddedWidth * paddedHeight * 4);
+			unsigned char* texel = m_scratch.data();
+			for (unsigned int y = 0; y < paddedHeight; ++y)
+			{
+				unsigned int sy = (y + height - padding) % height;
+				for (unsigned int x = 0; x < paddedWidth; ++x, texel += 4)
+				{
+					unsigned int sx = (x + width - padding) % width;
+					const unsigned char* from = source + ((size_t)sy * width + sx) * channels;
+					texel[0] = from[0];
+					texel[1] = channels > 1 ? from[1] : 0;
+					texel[2] = channels > 2 ? from[2] : 0;
+					texel[3] = channels > 3 ? from[3] : 255;
+				}
+			}
+			glTextureSubImage2D(page, level, a_slot.x >> level, a_slot.y >> level, paddedWidth, paddedHeight,
+				GL_RGBA, GL_UNSIGNED_BYTE, m_scratch.data());
+		}
+	}
+}
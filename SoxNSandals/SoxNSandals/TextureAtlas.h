@@ -0,0 +1,167 @@
+/**
+	TextureAtlas.h
+
+	Purpose: TextureAtlas.h is the header file for the TextureAtlas
+			class. The TextureAtlas packs small textures into a few
+			shared pages, so the materials using them bind one texture
+			between them instead of one each.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+namespace aie
+{
+	class Texture;
+}
+
+namespace sns
+{
+	/**
+		The TextureAtlas class copies the textures given to it into
+			PAGE_SIZE pages of RGBA8, each page a row of shelves that
+			fill from the left. Textures are placed with PADDING texels
+			of border all around, copied from their opposite edges, so
+			a shader wrapping its UVs inside the texture's rectangle
+			filters across the edge as GL_REPEAT would.
+
+		Pages only have LEVEL_COUNT levels. Textures are placed on a
+			grid of 2^(LEVEL_COUNT - 1) texels and their sides must be
+			multiples of it, so even on the last level no texel of
+			theirs mixes with another's and their border is a texel
+			wide. Each level is copied from the texture's own mip
+			chain, filtered by its content.
+
+		aie::Texture::upload gives the atlas the textures that asked
+			for it, see aie::Texture::setAtlasCandidate, and the
+			texture's handle becomes its page. Shaders find the texture
+			in the page by aie::Texture::getAtlasRect, see atlas.glsl.
+			A texture's rectangle is given back when it is deleted or
+			uploaded again, and reused by the next texture it fits.
+			Everything but canAdd must be called on the context thread.
+	*/
+	class TextureAtlas
+	{
+	public:
+		// The width and height of a page.
+		static const unsigned int PAGE_SIZE = 1024;
+
+		// The border around each texture, on the first level.
+		static const unsigned int PADDING = 8;
+
+		// How many levels a page has.
+		static const unsigned int LEVEL_COUNT = 4;
+
+		static TextureAtlas& instance();
+
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		/**
+			setMaxSize sets the widest and tallest a texture can be and
+				still be packed, 128 by default. Only textures added
+				after it are affected.
+
+				@param1 a_size is the size in texels, 0 to pack nothing.
+		*/
+		void setMaxSize(unsigned int a_size) { m_maxSize = a_size; }
+		unsigned int getMaxSize() const { return m_maxSize; }
+
+		/**
+			canAdd returns whether add would take a texture, going by its
+				size and format alone.
+
+				@param1 a_texture is a decoded texture pending upload.
+		*/
+		bool canAdd(const aie::Texture& a_texture) const;
+
+		/**
+			add copies a texture's levels into a page.
+
+				@param1 a_texture is a decoded texture pending upload.
+
+				@param2 a_page is set to the GL handle of its page.
+
+				@param3 a_rect is set to where it is in the page, the
+						bottom left corner in the first two and the
+						size in the last two, in UVs.
+
+				@return false if it can't be packed, it is left as it was.
+		*/
+		bool add(const aie::Texture& a_texture, unsigned int& a_page, float a_rect[4]);
+
+		/**
+			release gives back the rectangle of a texture, doing nothing
+				if it has none.
+
+				@param1 a_texture is the texture.
+		*/
+		void release(const aie::Texture* a_texture);
+
+		/**
+			getPageCount returns how many pages have been made.
+		*/
+		unsigned int getPageCount() const { return (unsigned int)m_pages.size(); }
+
+		/**
+			getTextureCount returns how many textures are in the pages.
+		*/
+		unsigned int getTextureCount() const { return (unsigned int)m_slots.size(); }
+
+		/**
+			destroy deletes every page, before the context is.
+		*/
+		void destroy();
+
+	private:
+		TextureAtlas();
+
+		// A rectangle of a page, in texels, the border included.
+		struct Slot
+		{
+			unsigned int page;
+			unsigned int x;
+			unsigned int y;
+			unsigned int width;
+			unsigned int height;
+		};
+
+		// A row of slots filled from the left.
+		struct Shelf
+		{
+			unsigned int y;
+			unsigned int height;
+			unsigned int used;
+		};
+
+		struct Page
+		{
+			unsigned int texture;
+			std::vector<Shelf> shelves;
+
+			// How far up the shelves reach.
+			unsigned int top;
+		};
+
+		// Finds room for a slot of a size, making a page if none has it.
+		Slot allocate(unsigned int a_width, unsigned int a_height);
+
+		// Copies a texture's levels, with their borders, into a slot.
+		void copy(const aie::Texture& a_texture, const Slot& a_slot);
+
+		std::vector<Page> m_pages;
+
+		// Slots given back, reused before the shelves grow.
+		std::vector<Slot> m_freeSlots;
+
+		std::unordered_map<const aie::Texture*, Slot> m_slots;
+
+		// Scratch for a level with its border, kept so adding doesn't
+		//	allocate each time.
+		std::vector<unsigned char> m_scratch;
+
+		unsigned int m_maxSize;
+	};
+}
@@ -0,0 +1,171 @@
+/**
+	TextureCache.cpp
+
+	Purpose: TextureCache.cpp is the source file for the TextureCache class.
+			The TextureCache makes sure every image file is only decoded
+			and uploaded once, no matter how many materials use it.
+
+	@author Nathan Nette
+*/
+#include "TextureCache.h"
+#include "Texture.h"
+#include "FileSystem.h"
+#include <cstdio>
+
+namespace aie {
+
+TextureCache& TextureCache::instance() {
+	static TextureCache cache;
+	return cache;
+}
+
+TextureCache::TextureCache()
+	: m_streaming(false) {
+	m_stats = {};
+}
+
+TextureCache::~TextureCache() {
+}
+
+std::string TextureCache::canonicalise(const std::string& filename) {
+	// the same keys the file system finds archived files by
+	return sns::FileSystem::canonicalise(filename);
+}
+
+std::shared_ptr<Texture> TextureCache::acquire(const std::string& filename, Texture::Content content,
+											   bool placeholder /* = false */, bool atlas /* = false */) {
+
+	// materials without a texture pass just the folder, skip those straight away
+	if (filename.empty() || filename.back() == '/' || filename.back() == '\\')
+		return nullptr;
+
+	std::string key = canonicalise(filename);
+
+	std::shared_ptr<Texture> texture;
+	std::shared_future<bool> decoded;
+	std::promise<bool> decodePromise;
+	bool isOwner = false;
+	bool streaming = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(key);
+		if (it != m_entries.end() && (placeholder || it->second.placeholder == false) &&
+			(atlas || it->second.atlas == false))
+			texture = it->second.texture.lock();
+
+		if (texture != nullptr) {
+			decoded = it->second.decoded;
+			++m_stats.hits;
+		}
+		else {
+			// first request (or every user released it), this thread decodes
+			texture = std::make_shared<Texture>();
+			decoded = decodePromise.get_future().share();
+			m_entries[key] = { texture, decoded, placeholder, atlas };
+			++m_stats.misses;
+			isOwner = true;
+			streaming = m_streaming;
+		}
+	}
+
+	if (isOwner)
+		texture->setAtlasCandidate(atlas);
+	if (isOwner && placeholder) {
+		texture->setStreamed(streaming);
+		texture->setPlaceholder(filename.c_str(), content);
+		decodePromise.set_value(true);
+		return texture;
+	}
+	if (isOwner) {
+		texture->setStreamed(streaming);
+		texture->setContent(content);
+		bool success = texture->decode(filename.c_str());
+		decodePromise.set_value(success);
+
+		if (success == false) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			++m_stats.failures;
+		}
+		return success ? texture : nullptr;
+	}
+
+	// another thread may still be decoding this file
+	if (decoded.get() == false)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.bytesSaved += (unsigned long long)texture->getWidth() * texture->getHeight() * texture->getFormat();
+	return texture;
+}
+
+void TextureCache::placeholderLoaded(const Texture* texture) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(canonicalise(texture->getFilename()));
+	if (it != m_entries.end() && it->second.texture.lock().get() == texture)
+		it->second.placeholder = false;
+}
+
+void TextureCache::prune() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto it = m_entries.begin(); it != m_entries.end();) {
+		if (it->second.texture.expired())
+			it = m_entries.erase(it);
+		else
+			++it;
+	}
+}
+
+void TextureCache::getFilenames(std::vector<std::string>& filenames) const {
+	filenames.clear();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& entry : m_entries) {
+		if (entry.second.texture.expired() == false)
+			filenames.push_back(entry.first);
+	}
+}
+
+std::shared_ptr<Texture> TextureCache::find(const std::string& filename) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(canonicalise(filename));
+	return it != m_entries.end() ? it->second.texture.lock() : nullptr;
+}
+
+void TextureCache::setStreaming(bool streaming) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_streaming = streaming;
+}
+
+TextureCache::Stats TextureCache::getStats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void TextureCache::getMemoryUsage(size_t& cpuBytes, size_t& gpuBytes) const {
+	cpuBytes = 0;
+	gpuBytes = 0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& entry : m_entries) {
+		std::shared_ptr<Texture> texture = entry.second.texture.lock();
+		if (texture != nullptr) {
+			cpuBytes += texture->getCPUBytes();
+			gpuBytes += texture->getGPUBytes();
+		}
+	}
+}
+
+void TextureCache::printReport() const {
+	Stats stats = getStats();
+	printf("Texture cache: %u hits, %u misses, %u failed, %.2f MB saved\n",
+		   stats.hits, stats.misses, stats.failures,
+		   stats.bytesSaved / (1024.0 * 1024.0));
+
+	size_t cpuBytes = 0, gpuBytes = 0;
+	getMemoryUsage(cpuBytes, gpuBytes);
+	printf("Texture memory: %.2f MB cpu, %.2f MB gpu\n",
+		   cpuBytes / (1024.0 * 1024.0), gpuBytes / (1024.0 * 1024.0));
+}
+
+} // namespace aie
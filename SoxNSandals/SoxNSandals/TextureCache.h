@@ -0,0 +1,101 @@
+/**
+	TextureCache.h
+
+	Purpose: TextureCache.h is the header file for the TextureCache class.
+			The TextureCache makes sure every image file is only decoded
+			and uploaded once, no matter how many materials use it.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+#include "Texture.h"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace aie {
+
+// a process-wide cache of textures keyed by canonical file path.
+// textures are shared between everyone that requests the same file and
+// are freed once the last shared_ptr to them is released
+class TextureCache {
+public:
+
+	struct Stats {
+		unsigned int		hits;
+		unsigned int		misses;
+		unsigned int		failures;
+		unsigned long long	bytesSaved;	// decoded bytes not duplicated thanks to hits
+	};
+
+	static TextureCache& instance();
+
+	// returns the texture for a file, decoding it if it isn't already cached.
+	// the texture may still need upload() on the gl thread. thread-safe, and
+	// concurrent requests for the same file wait on a single decode.
+	// empty names or paths to a folder return nullptr without touching the disk.
+	// content decides how the mip chain is filtered, the first request for a
+	// file decides it for everyone sharing the texture.
+	// with placeholder a file that isn't cached gets a placeholder without
+	// being read, see Texture::setPlaceholder, shared like any other until
+	// it is loaded and placeholderLoaded() called. a request without it
+	// decodes the file again rather than share a placeholder.
+	// with atlas a small file may be packed into an atlas page as it is
+	// uploaded, see Texture::setAtlasCandidate, for users that sample it
+	// through its atlas rect. a request without it never shares one of those
+	std::shared_ptr<Texture> acquire(const std::string& filename, Texture::Content content = Texture::COLOUR,
+									 bool placeholder = false, bool atlas = false);
+
+	// a placeholder adopted the file it stood in for, later requests
+	// share it. call on the thread that adopted it
+	void placeholderLoaded(const Texture* texture);
+
+	// drops entries whose textures have all been released
+	void prune();
+
+	// lists the files of every texture still alive, by their keys.
+	// thread-safe, and holds none of the textures
+	void getFilenames(std::vector<std::string>& filenames) const;
+
+	// returns the texture of a file if it is still alive, nullptr if not.
+	// the texture is only released on the calling thread if every other
+	// user let go of it meanwhile, so call it on the gl thread
+	std::shared_ptr<Texture> find(const std::string& filename) const;
+
+	// textures decoded after this is turned on are streamed, see
+	// Texture::setStreamed. off by default
+	void setStreaming(bool streaming);
+
+	Stats getStats() const;
+
+	// adds up the memory used by every texture still alive in the cache
+	void getMemoryUsage(size_t& cpuBytes, size_t& gpuBytes) const;
+
+	void printReport() const;
+
+	// normalises slashes and removes "." and ".." so equal files share a key
+	static std::string canonicalise(const std::string& filename);
+
+private:
+
+	TextureCache();
+	~TextureCache();
+
+	struct Entry {
+		std::weak_ptr<Texture>		texture;
+		std::shared_future<bool>	decoded;
+		bool						placeholder;
+		bool						atlas;
+	};
+
+	mutable std::mutex						m_mutex;
+	std::unordered_map<std::string, Entry>	m_entries;
+	Stats									m_stats;
+	bool									m_streaming;
+};
+
+} // namespace aie
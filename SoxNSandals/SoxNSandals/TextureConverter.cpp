@@ -0,0 +1,453 @@
+/**
+	TextureConverter.cpp
+
+	Purpose: TextureConverter.cpp is the source file for the TextureConverter
+			class. The TextureConverter is an offline tool that turns
+			png, jpg and tga images into block compressed dds files with
+			a full mip chain.
+
+	@author Nathan Nette
+*/
+#include "TextureConverter.h"
+#include "tiny_obj_loader.h"
+#include "stb_image.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+namespace sns
+{
+	/**
+		An RGBA8 image used while building the mip chain.
+	*/
+	struct Image
+	{
+		unsigned int width;
+		unsigned int height;
+		std::vector<unsigned char> pixels;
+	};
+
+	/**
+		packColour565 rounds an 8 bit colour down to 5:6:5.
+	*/
+	static unsigned short packColour565(const float* a_colour)
+	{
+		int r = (int)(a_colour[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)(a_colour[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)(a_colour[2] * 31.0f / 255.0f + 0.5f);
+		r = r < 0 ? 0 : (r > 31 ? 31 : r);
+		g = g < 0 ? 0 : (g > 63 ? 63 : g);
+		b = b < 0 ? 0 : (b > 31 ? 31 : b);
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	/**
+		unpackColour565 expands a 5:6:5 colour back to 8 bits a channel.
+	*/
+	static void unpackColour565(unsigned short a_packed, float* a_colour)
+	{
+		a_colour[0] = (float)(((a_packed >> 11) & 31) * 255 / 31);
+		a_colour[1] = (float)(((a_packed >> 5) & 63) * 255 / 63);
+		a_colour[2] = (float)((a_packed & 31) * 255 / 31);
+	}
+
+	/**
+		encodeColourBlock writes an 8 byte BC1 colour block. The end
+			points are the corners of the colours' bounding box, pulled
+			in slightly to reduce the error of the in-between colours.
+
+			@param1 a_block is 16 RGBA8 pixels.
+
+			@param2 a_output receives the 8 bytes.
+	*/
+	static void encodeColourBlock(const unsigned char* a_block, unsigned char* a_output)
+	{
+		float minColour[3] = { 255.0f, 255.0f, 255.0f };
+		float maxColour[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				float value = a_block[i * 4 + c];
+				minColour[c] = value < minColour[c] ? value : minColour[c];
+				maxColour[c] = value > maxColour[c] ? value : maxColour[c];
+			}
+		}
+
+		// Inset the box by 1/16th of its size.
+		for (int c = 0; c < 3; ++c)
+		{
+			float inset = (maxColour[c] - minColour[c]) / 16.0f;
+			minColour[c] += inset;
+			maxColour[c] -= inset;
+		}
+
+		unsigned short colour0 = packColour565(maxColour);
+		unsigned short colour1 = packColour565(minColour);
+		unsigned int indices = 0;
+
+		// Colour0 must be the larger value to stay in four colour mode.
+		if (colour0 < colour1)
+		{
+			unsigned short swap = colour0;
+			colour0 = colour1;
+			colour1 = swap;
+		}
+
+		if (colour0 != colour1)
+		{
+			float palette[4][3];
+			unpackColour565(colour0, palette[0]);
+			unpackColour565(colour1, palette[1]);
+			for (int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+			}
+
+			for (int i = 0; i < 16; ++i)
+			{
+				int best = 0;
+				float bestError = 1e30f;
+				for (int p = 0; p < 4; ++p)
+				{
+					float error = 0.0f;
+					for (int c = 0; c < 3; ++c)
+					{
+						float difference = a_block[i * 4 + c] - palette[p][c];
+						error += difference * difference;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (unsigned int)best << (i * 2);
+			}
+		}
+
+		memcpy(a_output, &colour0, 2);
+		memcpy(a_output + 2, &colour1, 2);
+		memcpy(a_output + 4, &indices, 4);
+	}
+
+	/**
+		encodeChannelBlock writes an 8 byte BC4 block for one channel.
+			This is the alpha of BC3 and each half of BC5.
+
+			@param1 a_block is 16 RGBA8 pixels.
+
+			@param2 a_channel is which channel to encode.
+
+			@param3 a_output receives the 8 bytes.
+	*/
+	static void encodeChannelBlock(const unsigned char* a_block, int a_channel, unsigned char* a_output)
+	{
+		int minValue = 255, maxValue = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int value = a_block[i * 4 + a_channel];
+			minValue = value < minValue ? value : minValue;
+			maxValue = value > maxValue ? value : maxValue;
+		}
+
+		// The eight value mode needs the first end point to be larger.
+		unsigned long long indices = 0;
+		if (maxValue != minValue)
+		{
+			float palette[8];
+			palette[0] = (float)maxValue;
+			palette[1] = (float)minValue;
+			for (int p = 1; p < 7; ++p)
+				palette[p + 1] = ((7 - p) * palette[0] + p * palette[1]) / 7.0f;
+
+			for (int i = 0; i < 16; ++i)
+			{
+				int best = 0;
+				float bestError = 1e30f;
+				for (int p = 0; p < 8; ++p)
+				{
+					float error = fabsf(a_block[i * 4 + a_channel] - palette[p]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (unsigned long long)best << (i * 3);
+			}
+		}
+
+		a_output[0] = (unsigned char)maxValue;
+		a_output[1] = (unsigned char)minValue;
+		for (int i = 0; i < 6; ++i)
+			a_output[2 + i] = (unsigned char)(indices >> (i * 8));
+	}
+
+	/**
+		encodeLevel block compresses one image of the mip chain.
+
+			@param1 a_image is the RGBA8 image.
+
+			@param2 a_fourCC is the block format.
+
+			@param3 a_output has the blocks appended to it.
+	*/
+	static void encodeLevel(const Image& a_image, const char* a_fourCC, std::vector<unsigned char>& a_output)
+	{
+		bool isBC1 = strcmp(a_fourCC, "DXT1") == 0;
+		bool isBC5 = strcmp(a_fourCC, "ATI2") == 0;
+		unsigned char block[16 * 4];
+		unsigned char encoded[16];
+
+		for (unsigned int by = 0; by < a_image.height; by += 4)
+		{
+			for (unsigned int bx = 0; bx < a_image.width; bx += 4)
+			{
+				// Gather the 4x4 block, repeating the edge for small mips.
+				for (unsigned int y = 0; y < 4; ++y)
+				{
+					for (unsigned int x = 0; x < 4; ++x)
+					{
+						unsigned int px = bx + x < a_image.width ? bx + x : a_image.width - 1;
+						unsigned int py = by + y < a_image.height ? by + y : a_image.height - 1;
+						memcpy(&block[(y * 4 + x) * 4], &a_image.pixels[(py * a_image.width + px) * 4], 4);
+					}
+				}
+
+				if (isBC1)
+				{
+					encodeColourBlock(block, encoded);
+					a_output.insert(a_output.end(), encoded, encoded + 8);
+				}
+				else if (isBC5)
+				{
+					encodeChannelBlock(block, 0, encoded);
+					encodeChannelBlock(block, 1, encoded + 8);
+					a_output.insert(a_output.end(), encoded, encoded + 16);
+				}
+				else
+				{
+					encodeChannelBlock(block, 3, encoded);
+					encodeColourBlock(block, encoded + 8);
+					a_output.insert(a_output.end(), encoded, encoded + 16);
+				}
+			}
+		}
+	}
+
+	/**
+		downsample halves an image with a box filter. Normal maps are
+			renormalised so the smaller mips don't flatten out.
+
+			@param1 a_image is the image to halve.
+
+			@param2 a_isNormalMap renormalises the result.
+
+			@return the next mip level.
+	*/
+	static Image downsample(const Image& a_image, bool a_isNormalMap)
+	{
+		Image result;
+		result.width = a_image.width > 1 ? a_image.width / 2 : 1;
+		result.height = a_image.height > 1 ? a_image.height / 2 : 1;
+		result.pixels.resize(result.width * result.height * 4);
+
+		for (unsigned int y = 0; y < result.height; ++y)
+		{
+			for (unsigned int x = 0; x < result.width; ++x)
+			{
+				unsigned int x0 = x * 2, y0 = y * 2;
+				unsigned int x1 = x0 + 1 < a_image.width ? x0 + 1 : x0;
+				unsigned int y1 = y0 + 1 < a_image.height ? y0 + 1 : y0;
+
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int c = 0; c < 4; ++c)
+				{
+					sum[c] += a_image.pixels[(y0 * a_image.width + x0) * 4 + c];
+					sum[c] += a_image.pixels[(y0 * a_image.width + x1) * 4 + c];
+					sum[c] += a_image.pixels[(y1 * a_image.width + x0) * 4 + c];
+					sum[c] += a_image.pixels[(y1 * a_image.width + x1) * 4 + c];
+					sum[c] *= 0.25f;
+				}
+
+				if (a_isNormalMap)
+				{
+					float n[3];
+					for (int c = 0; c < 3; ++c)
+						n[c] = sum[c] / 127.5f - 1.0f;
+					float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length > 0.0f)
+						for (int c = 0; c < 3; ++c)
+							sum[c] = (n[c] / length + 1.0f) * 127.5f;
+				}
+
+				for (int c = 0; c < 4; ++c)
+					result.pixels[(y * result.width + x) * 4 + c] = (unsigned char)(sum[c] + 0.5f);
+			}
+		}
+		return result;
+	}
+
+	/**
+		convert encodes an image and writes it out as a dds file.
+
+			@param1 a_input is the path of the source image.
+
+			@param2 a_output is the path of the dds to write.
+
+			@param3 a_mode picks the block format.
+
+			@return true if the dds was written.
+	*/
+	bool TextureConverter::convert(const char* a_input, const char* a_output, Mode a_mode)
+	{
+		int width = 0, height = 0, channels = 0;
+		unsigned char* pixels = stbi_load(a_input, &width, &height, &channels, STBI_rgb_alpha);
+		if (pixels == nullptr)
+		{
+			printf("Failed to read %s\n", a_input);
+			return false;
+		}
+
+		Image image;
+		image.width = (unsigned int)width;
+		image.height = (unsigned int)height;
+		image.pixels.assign(pixels, pixels + width * height * 4);
+		stbi_image_free(pixels);
+
+		// Pick BC3 only when the alpha is actually used.
+		const char* fourCC = "DXT1";
+		if (a_mode == NORMAL_MAP)
+			fourCC = "ATI2";
+		else
+		{
+			for (size_t i = 3; i < image.pixels.size(); i += 4)
+			{
+				if (image.pixels[i] != 255)
+				{
+					fourCC = "DXT5";
+					break;
+				}
+			}
+		}
+
+		// Encode every level down to 1x1.
+		std::vector<unsigned char> data;
+		unsigned int levelCount = 0;
+		for (;;)
+		{
+			encodeLevel(image, fourCC, data);
+			++levelCount;
+			if (image.width == 1 && image.height == 1)
+				break;
+			image = downsample(image, a_mode == NORMAL_MAP);
+		}
+
+		// The 124 byte header, see DDS_HEADER in the DirectX docs.
+		unsigned int header[31] = {};
+		header[0] = 124;
+		header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;	// caps, height, width, pixel format, mip count, linear size
+		header[2] = (unsigned int)height;
+		header[3] = (unsigned int)width;
+		header[4] = (unsigned int)(((width + 3) / 4) * ((height + 3) / 4) * (strcmp(fourCC, "DXT1") == 0 ? 8 : 16));
+		header[6] = levelCount;
+		header[18] = 32;		// pixel format size
+		header[19] = 0x4;		// DDPF_FOURCC
+		memcpy(&header[20], fourCC, 4);
+		header[26] = 0x1000 | 0x400000 | 0x8;	// texture, mipmap, complex
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_output, "wb");
+		if (file == nullptr)
+		{
+			printf("Failed to write %s\n", a_output);
+			return false;
+		}
+
+		bool success = fwrite("DDS ", 1, 4, file) == 4 &&
+			fwrite(header, sizeof(header), 1, file) == 1 &&
+			fwrite(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+
+		if (success == false)
+		{
+			printf("Failed to write %s\n", a_output);
+			remove(a_output);
+			return false;
+		}
+
+		printf("Converted %s (%s, %u mips)\n", a_input, fourCC, levelCount);
+		return true;
+	}
+
+	/**
+		convertMaterials converts every texture used by the materials
+			of an OBJ.
+
+			@param1 a_objFile is the path of the OBJ.
+
+			@return the amount of textures that failed to convert.
+	*/
+	int TextureConverter::convertMaterials(const char* a_objFile)
+	{
+		std::string file = a_objFile;
+		std::string folder = file.substr(0, file.find_last_of('/') + 1);
+
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string error = "";
+		if (tinyobj::LoadObj(shapes, materials, error, a_objFile, folder.c_str()) == false)
+		{
+			printf("%s\n", error.c_str());
+			return 1;
+		}
+
+		// Images are often shared between materials, only convert them once.
+		std::set<std::string> colourTextures, normalTextures;
+		for (auto& m : materials)
+		{
+			const std::string* names[] = { &m.alpha_texname, &m.ambient_texname, &m.diffuse_texname,
+				&m.specular_texname, &m.specular_highlight_texname, &m.displacement_texname };
+			for (auto name : names)
+				if (name->empty() == false)
+					colourTextures.insert(*name);
+			if (m.bump_texname.empty() == false)
+				normalTextures.insert(m.bump_texname);
+		}
+
+		int failures = 0;
+		for (auto& name : colourTextures)
+		{
+			std::string input = folder + name;
+			if (convert(input.c_str(), getCompressedName(input).c_str(), AUTO) == false)
+				++failures;
+		}
+		for (auto& name : normalTextures)
+		{
+			std::string input = folder + name;
+			if (convert(input.c_str(), getCompressedName(input).c_str(), NORMAL_MAP) == false)
+				++failures;
+		}
+		return failures;
+	}
+
+	/**
+		getCompressedName swaps the extension of an image for ".dds".
+
+			@param1 a_filename is the path of the source image.
+
+			@return the path the converted file is written to.
+	*/
+	std::string TextureConverter::getCompressedName(const std::string& a_filename)
+	{
+		size_t dot = a_filename.find_last_of('.');
+		size_t slash = a_filename.find_last_of("/\\");
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			return a_filename + ".dds";
+		return a_filename.substr(0, dot) + ".dds";
+	}
+}
@@ -0,0 +1,68 @@
+/**
+	TextureConverter.h
+
+	Purpose: TextureConverter.h is the header file for the TextureConverter
+			class. The TextureConverter is an offline tool that turns
+			png, jpg and tga images into block compressed dds files with
+			a full mip chain, so they can be uploaded without decoding
+			or generating mipmaps at load time.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <string>
+
+namespace sns
+{
+	/**
+		The TextureConverter class encodes images as BC1, BC3 or BC5.
+	*/
+	class TextureConverter
+	{
+	public:
+		/**
+			Mode picks which block format an image is encoded as.
+		*/
+		enum Mode
+		{
+			// BC1 for opaque images, BC3 if any pixel has alpha.
+			AUTO,
+
+			// BC5, two channels holding the X and Y of a normal map.
+			NORMAL_MAP,
+		};
+
+		/**
+			convert encodes an image and writes it out as a dds file.
+
+				@param1 a_input is the path of the source image.
+
+				@param2 a_output is the path of the dds to write.
+
+				@param3 a_mode picks the block format.
+
+				@return true if the dds was written.
+		*/
+		static bool convert(const char* a_input, const char* a_output, Mode a_mode);
+
+		/**
+			convertMaterials converts every texture used by the materials
+				of an OBJ. Bump maps are encoded as normal maps and the dds
+				files are written next to the source images.
+
+				@param1 a_objFile is the path of the OBJ.
+
+				@return the amount of textures that failed to convert.
+		*/
+		static int convertMaterials(const char* a_objFile);
+
+		/**
+			getCompressedName swaps the extension of an image for ".dds".
+
+				@param1 a_filename is the path of the source image.
+
+				@return the path the converted file is written to.
+		*/
+		static std::string getCompressedName(const std::string& a_filename);
+	};
+}
@@ -0,0 +1,222 @@
+/**
+	TextureStreamer.cpp
+
+	Purpose: TextureStreamer.cpp is the source file for the TextureStreamer
+			class. The TextureStreamer decides how many levels of each
+			streamed texture are on the gpu, from how finely it is seen,
+			and keeps them all inside a budget of video memory.
+
+	@author Nathan Nette
+*/
+#include "TextureStreamer.h"
+#include "Texture.h"
+#include <algorithm>
+
+namespace sns
+{
+	TextureStreamer::TextureStreamer()
+		: m_entries(),
+		m_frame(0),
+		m_budget(DEFAULT_BUDGET),
+		m_uploadBudget(DEFAULT_UPLOAD_BUDGET),
+		m_plans(),
+		m_loads(),
+		m_evictions(),
+		m_nextEviction(0),
+		m_stats()
+	{
+	}
+
+	/**
+		setBudget sets how many bytes of video memory the streamed
+			textures can take between them.
+
+			@param1 a_bytes is the budget, DEFAULT_BUDGET for 0.
+	*/
+	void TextureStreamer::setBudget(size_t a_bytes)
+	{
+		m_budget = a_bytes;
+		if (m_budget == 0)
+			m_budget = DEFAULT_BUDGET;
+	}
+
+	/**
+		request asks for a texture's levels from one on to be on the gpu
+			this frame. The finest asked for wins.
+
+			@param1 a_texture is the texture, anything but a streamed one
+					is ignored.
+
+			@param2 a_level is the level wanted, fractions are rounded down
+					to the finer level.
+	*/
+	void TextureStreamer::request(const std::shared_ptr<aie::Texture>& a_texture, float a_level)
+	{
+		if (a_texture == nullptr || a_texture->isStreamed() == false)
+			return;
+
+		// Past 31 levels is past any texture's last one.
+		unsigned int level = a_level > 0.0f ? (unsigned int)std::min(a_level, 31.0f) : 0;
+
+		// New, or a new texture where a released one was.
+		Entry& entry = m_entries[a_texture.get()];
+		if (entry.texture.lock() != a_texture)
+		{
+			entry.texture = a_texture;
+			entry.wanted = level;
+			entry.lastRequest = m_frame;
+			return;
+		}
+
+		if (entry.lastRequest != m_frame)
+			entry.wanted = level;
+		else
+			entry.wanted = std::min(entry.wanted, level);
+		entry.lastRequest = m_frame;
+	}
+
+	/**
+		update moves levels in and out for the requests made since it last
+			ran, and starts a new frame of them.
+	*/
+	void TextureStreamer::update()
+	{
+		m_stats = {};
+		size_t residentBytes = 0;
+		for (auto it = m_entries.begin(); it != m_entries.end();)
+		{
+			std::shared_ptr<aie::Texture> texture = it->second.texture.lock();
+			if (texture == nullptr)
+			{
+				it = m_entries.erase(it);
+				continue;
+			}
+
+			const Entry& entry = it->second;
+			++it;
+			if (texture->getHandle() == 0 || texture->isPendingUpload())
+				continue;
+
+			// Those not asked for last frame only need their base level.
+			unsigned int baseLevel = texture->getBaseLevel();
+			Plan plan;
+			plan.lastRequest = entry.lastRequest;
+			plan.goal = entry.lastRequest == m_frame ? std::min(entry.wanted, baseLevel) : baseLevel;
+			plan.target = texture->getResidentLevel();
+			residentBytes += texture->getGPUBytes();
+			plan.texture = std::move(texture);
+			m_plans.push_back(std::move(plan));
+		}
+
+		for (Plan& plan : m_plans)
+		{
+			if (plan.target > plan.goal)
+				m_loads.push_back(&plan);
+			else if (plan.target < plan.goal)
+				m_evictions.push_back(&plan);
+		}
+
+		// The blurriest are loaded first, and levels are given up first by
+		//	those asked for the longest ago, then by those with the most
+		//	to spare.
+		std::sort(m_loads.begin(), m_loads.end(), [](const Plan* a, const Plan* b)
+		{
+			return a->target - a->goal > b->target - b->goal;
+		});
+		std::sort(m_evictions.begin(), m_evictions.end(), [](const Plan* a, const Plan* b)
+		{
+			if (a->lastRequest != b->lastRequest)
+				return a->lastRequest < b->lastRequest;
+			return a->goal - a->target > b->goal - b->target;
+		});
+		m_nextEviction = 0;
+
+		// A level for each in turn, so one large texture can't hold the
+		//	rest back.
+		size_t uploadedBytes = 0;
+		bool loading = true;
+		while (loading)
+		{
+			loading = false;
+			for (Plan* plan : m_loads)
+			{
+				if (plan->target <= plan->goal)
+					continue;
+
+				size_t bytes = plan->texture->getLevelBytes(plan->target - 1);
+				if (uploadedBytes > 0 && uploadedBytes + bytes > m_uploadBudget)
+				{
+					loading = false;
+					break;
+				}
+
+				while (residentBytes + bytes > m_budget && evictNext(residentBytes))
+				{
+				}
+				if (residentBytes + bytes > m_budget)
+				{
+					++m_stats.starved;
+					plan->goal = plan->target;
+					continue;
+				}
+
+				--plan->target;
+				residentBytes += bytes;
+				uploadedBytes += bytes;
+				loading = true;
+			}
+		}
+
+		// Over without loading anything, when the budget has been lowered.
+		while (residentBytes > m_budget && evictNext(residentBytes))
+		{
+		}
+
+		for (Plan& plan : m_plans)
+		{
+			unsigned int level = plan.texture->getResidentLevel();
+			if (plan.target == level)
+				continue;
+
+			if (plan.target < level)
+				++m_stats.loads;
+			else
+				++m_stats.evictions;
+			plan.texture->setResidentLevel(plan.target);
+		}
+
+		m_stats.residentBytes = residentBytes;
+		m_stats.uploadedBytes = uploadedBytes;
+		m_stats.textures = (unsigned int)m_plans.size();
+
+		// Let go of the textures, so released ones can be deleted.
+		m_plans.clear();
+		m_loads.clear();
+		m_evictions.clear();
+		++m_frame;
+	}
+
+	/**
+		evictNext drops a level from the next of the plans with more than
+			they need.
+
+			@param1 a_residentBytes has the level's bytes taken off it.
+
+			@return false once none are left.
+	*/
+	bool TextureStreamer::evictNext(size_t& a_residentBytes)
+	{
+		while (m_nextEviction < m_evictions.size())
+		{
+			Plan* plan = m_evictions[m_nextEviction];
+			if (plan->target < plan->goal)
+			{
+				a_residentBytes -= plan->texture->getLevelBytes(plan->target);
+				++plan->target;
+				return true;
+			}
+			++m_nextEviction;
+		}
+		return false;
+	}
+}
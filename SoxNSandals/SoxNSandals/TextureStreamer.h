@@ -0,0 +1,159 @@
+/**
+	TextureStreamer.h
+
+	Purpose: TextureStreamer.h is the header file for the TextureStreamer
+			class. The TextureStreamer decides how many levels of each
+			streamed texture are on the gpu, from how finely it is seen,
+			and keeps them all inside a budget of video memory.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace aie
+{
+	class Texture;
+}
+
+namespace sns
+{
+	/**
+		The TextureStreamer class is told each frame which mip level every
+			drawn texture needs, by request. Once a frame, update brings
+			the wanted levels in one at a time, the blurriest
+			textures first, and only so many bytes of them a frame so
+			streaming doesn't stall it.
+
+		When a level doesn't fit the budget, levels finer than their
+			textures need are dropped to make room, those asked for the
+			longest ago first. Textures only ever drop to their base
+			level, see aie::Texture::getBaseLevel, so something can
+			always be drawn. Only streamed textures are handled, the
+			rest are left as they are.
+	*/
+	class TextureStreamer
+	{
+	public:
+		// What the budget is until it is set, a gigabyte.
+		static const size_t DEFAULT_BUDGET = (size_t)1024 * 1024 * 1024;
+
+		// What update uploads at most in a frame, 8 megabytes.
+		static const size_t DEFAULT_UPLOAD_BUDGET = (size_t)8 * 1024 * 1024;
+
+		/**
+			What the streamer did in the last update.
+		*/
+		struct Stats
+		{
+			// Bytes on the gpu of every texture it knows of.
+			size_t residentBytes;
+			size_t uploadedBytes;
+			unsigned int textures;
+
+			// Textures that gained levels, and that lost them.
+			unsigned int loads;
+			unsigned int evictions;
+
+			// Textures that wanted more but didn't fit the budget.
+			unsigned int starved;
+		};
+
+		TextureStreamer();
+
+		/**
+			setBudget sets how many bytes of video memory the streamed
+				textures can take between them.
+
+				@param1 a_bytes is the budget, DEFAULT_BUDGET for 0.
+		*/
+		void setBudget(size_t a_bytes);
+
+		/**
+			getBudget returns how many bytes the streamed textures can
+				take.
+		*/
+		size_t getBudget() const { return m_budget; }
+
+		/**
+			setUploadBudget sets how many bytes update uploads in a frame.
+				At least one level is always uploaded when any is wanted.
+
+				@param1 a_bytes is the budget.
+		*/
+		void setUploadBudget(size_t a_bytes) { m_uploadBudget = a_bytes; }
+
+		/**
+			request asks for a texture's levels from one on to be on the
+				gpu this frame. The finest asked for wins.
+
+				@param1 a_texture is the texture, anything but a streamed
+						one is ignored.
+
+				@param2 a_level is the level wanted, fractions are rounded
+						down to the finer level.
+		*/
+		void request(const std::shared_ptr<aie::Texture>& a_texture, float a_level);
+
+		/**
+			update moves levels in and out for the requests made since it
+				last ran, and starts a new frame of them. Call it before
+				anything is drawn in a frame, as textures that change get
+				new handles.
+		*/
+		void update();
+
+		/**
+			getStats returns what the last update did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		/**
+			A texture the streamer has been asked for.
+		*/
+		struct Entry
+		{
+			std::weak_ptr<aie::Texture> texture;
+
+			// The finest level asked for in the frame it was last asked
+			//	for in.
+			unsigned int wanted;
+			unsigned int lastRequest;
+		};
+
+		/**
+			A texture being planned for in update.
+		*/
+		struct Plan
+		{
+			std::shared_ptr<aie::Texture> texture;
+			unsigned int lastRequest;
+
+			// The level it should be at, and the one it is heading to.
+			unsigned int goal;
+			unsigned int target;
+		};
+
+		// Drops a level from the next of the plans with more than they
+		//	need, returns false once none are left.
+		bool evictNext(size_t& a_residentBytes);
+
+		std::unordered_map<const aie::Texture*, Entry> m_entries;
+		unsigned int m_frame;
+
+		size_t m_budget;
+		size_t m_uploadBudget;
+
+		// Kept between updates for their memory. The plans wanting finer
+		//	levels, and those that can give some up, point into m_plans.
+		std::vector<Plan> m_plans;
+		std::vector<Plan*> m_loads;
+		std::vector<Plan*> m_evictions;
+		size_t m_nextEviction;
+
+		Stats m_stats;
+	};
+}
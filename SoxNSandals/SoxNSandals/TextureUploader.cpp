@@ -0,0 +1,212 @@
+/**
+	TextureUploader.cpp
+
+	Purpose: TextureUploader.cpp is the source file for the TextureUploader
+			class. The TextureUploader copies decoded textures to the gpu
+			through a ring of pixel buffers, a few megabytes a frame, so
+			loading them doesn't stall the frame.
+
+	@author Nathan Nette
+*/
+#include "TextureUploader.h"
+#include "Texture.h"
+#include "RenderState.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sns
+{
+	// Where each band starts in the region is rounded up to this, which
+	//	suits every pixel format and block size.
+	static const unsigned int BAND_ALIGNMENT = 16;
+
+	TextureUploader::TextureUploader()
+		: m_ring(),
+		m_frameBytes(DEFAULT_FRAME_BYTES),
+		m_jobs(),
+		m_copies(),
+		m_finished(),
+		m_stats()
+	{
+	}
+
+	/**
+		setFrameBytes sets how many bytes process copies a frame.
+
+			@param1 a_bytes is the budget, at least MIN_FRAME_BYTES.
+	*/
+	void TextureUploader::setFrameBytes(unsigned int a_bytes)
+	{
+		m_frameBytes = a_bytes;
+		if (m_frameBytes < MIN_FRAME_BYTES)
+			m_frameBytes = MIN_FRAME_BYTES;
+		m_frameBytes -= m_frameBytes % BAND_ALIGNMENT;
+	}
+
+	/**
+		queue adds a decoded texture to be uploaded.
+
+			@param1 a_texture is a texture with an upload pending.
+
+			@param2 a_onUploaded is called with whether it uploaded, once
+					it is in use, or nullptr.
+	*/
+	void TextureUploader::queue(aie::Texture* a_texture, std::function<void(bool)> a_onUploaded)
+	{
+		// Textures the cache shares are queued by every mesh using them.
+		for (Job& job : m_jobs)
+		{
+			if (job.texture == a_texture)
+			{
+				if (a_onUploaded != nullptr)
+					job.callbacks.push_back(std::move(a_onUploaded));
+				return;
+			}
+		}
+
+		Job job = {};
+		job.texture = a_texture;
+		if (a_onUploaded != nullptr)
+			job.callbacks.push_back(std::move(a_onUploaded));
+		m_jobs.push_back(std::move(job));
+	}
+
+	/**
+		process copies as much of the queued textures as fits the frame's
+			budget and puts those that are complete in use.
+
+			@return how many textures were finished.
+	*/
+	unsigned int TextureUploader::process()
+	{
+		m_stats = {};
+		if (m_jobs.empty())
+			return 0;
+
+		if (m_ring.getHandle() == 0)
+			m_ring.create(1, m_frameBytes, "TextureUploader");
+
+		char* region = (char*)m_ring.beginWrite();
+		unsigned int used = 0;
+		while (m_jobs.empty() == false)
+		{
+			Job& job = m_jobs.front();
+			if (job.started == false)
+			{
+				// Already in, or nothing to stage it with.
+				if (job.texture->beginStagedUpload(job.firstLevel, job.lastLevel) == false)
+				{
+					job.succeeded = job.texture->upload();
+					m_finished.push_back(std::move(job));
+					m_jobs.pop_front();
+					continue;
+				}
+				job.started = true;
+				job.level = job.firstLevel;
+				job.row = 0;
+			}
+
+			if (stage(job, region, used) == false)
+				break;
+
+			job.succeeded = true;
+			m_finished.push_back(std::move(job));
+			m_jobs.pop_front();
+		}
+		unsigned int first = m_ring.endWrite(used);
+
+		// The bands are read from the buffer, their offsets in it stand
+		//	in for pointers.
+		if (m_copies.empty() == false)
+		{
+			RenderState::instance().bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_ring.getHandle());
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			for (const Copy& copy : m_copies)
+			{
+				const void* offset = (const void*)(size_t)(first + copy.offset);
+				if (copy.compressed)
+					glCompressedTextureSubImage2D(copy.texture, copy.level, 0, copy.y, copy.width, copy.height,
+						copy.format, copy.bytes, offset);
+				else
+					glTextureSubImage2D(copy.texture, copy.level, 0, copy.y, copy.width, copy.height,
+						copy.format, GL_UNSIGNED_BYTE, offset);
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			RenderState::instance().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			m_copies.clear();
+		}
+		m_ring.fence();
+
+		// Put in use after the copies are queued, so draws read them.
+		unsigned int finished = (unsigned int)m_finished.size();
+		for (Job& job : m_finished)
+		{
+			if (job.started)
+				job.texture->endStagedUpload();
+			for (auto& callback : job.callbacks)
+				callback(job.succeeded);
+		}
+		m_finished.clear();
+
+		m_stats.uploadedBytes = used;
+		m_stats.textures = finished;
+		m_stats.pending = getPendingCount();
+		return finished;
+	}
+
+	/**
+		stage copies as much of a started job as fits the region.
+
+			@param1 a_job is the job, it is moved on past what was copied.
+
+			@param2 a_region is the region being written.
+
+			@param3 a_used is how much of the region is written, and has
+					what was copied added.
+
+			@return false once the region is full, before the job is.
+	*/
+	bool TextureUploader::stage(Job& a_job, char* a_region, unsigned int& a_used)
+	{
+		aie::Texture* texture = a_job.texture;
+		bool compressed = texture->isCompressed();
+		unsigned int format = compressed ? texture->getInternalFormat() : texture->getPixelFormat();
+		unsigned int blockSize = compressed ? 4 : 1;
+
+		for (; a_job.level <= a_job.lastLevel; ++a_job.level, a_job.row = 0)
+		{
+			unsigned int width = std::max(texture->getWidth() >> a_job.level, 1u);
+			unsigned int height = std::max(texture->getHeight() >> a_job.level, 1u);
+			unsigned int rows = (height + blockSize - 1) / blockSize;
+			unsigned int rowBytes = (unsigned int)(texture->getLevelBytes(a_job.level) / rows);
+			const unsigned char* data = texture->getLevelData(a_job.level);
+
+			while (a_job.row < rows)
+			{
+				unsigned int fit = a_used < m_frameBytes ? (m_frameBytes - a_used) / rowBytes : 0;
+				if (fit == 0)
+					return false;
+
+				unsigned int count = std::min(fit, rows - a_job.row);
+				unsigned int bytes = count * rowBytes;
+				memcpy(a_region + a_used, data + (size_t)a_job.row * rowBytes, bytes);
+
+				Copy copy;
+				copy.texture = texture->getStagingHandle();
+				copy.level = a_job.level - a_job.firstLevel;
+				copy.y = a_job.row * blockSize;
+				copy.width = width;
+				copy.height = std::min(count * blockSize, height - copy.y);
+				copy.offset = a_used;
+				copy.bytes = bytes;
+				copy.format = format;
+				copy.compressed = compressed;
+				m_copies.push_back(copy);
+
+				a_used += (bytes + BAND_ALIGNMENT - 1) / BAND_ALIGNMENT * BAND_ALIGNMENT;
+				a_job.row += count;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,163 @@
+/**
+	TextureUploader.h
+
+	Purpose: TextureUploader.h is the header file for the TextureUploader
+			class. The TextureUploader copies decoded textures to the gpu
+			through a ring of pixel buffers, a few megabytes a frame, so
+			loading them doesn't stall the frame.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "StreamingBuffer.h"
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace aie
+{
+	class Texture;
+}
+
+namespace sns
+{
+	/**
+		The TextureUploader class copies the levels of queued textures into
+			a StreamingBuffer bound as GL_PIXEL_UNPACK_BUFFER, up to a
+			region of it a frame, and has glTextureSubImage2D read them
+			from there. The gpu copies them in while the frame goes on,
+			and the region's fence keeps it from being written again
+			until it has.
+
+		Levels too large for what is left of a frame are split into bands
+			of rows, or of 4x4 blocks when compressed, and carry on the
+			next frame. A texture is only put in use once all of it is
+			in, until then it keeps whatever it had before.
+
+		Without GL 4.5 textures can't be staged, and upload all at once.
+			Everything is done on the GL thread.
+	*/
+	class TextureUploader
+	{
+	public:
+		// What a frame can upload until it is set, 8 megabytes.
+		static const unsigned int DEFAULT_FRAME_BYTES = 8 * 1024 * 1024;
+
+		// The least a frame can upload, a row of a 16384 wide RGBA level.
+		static const unsigned int MIN_FRAME_BYTES = 16384 * 4;
+
+		/**
+			What the last process did.
+		*/
+		struct Stats
+		{
+			unsigned int uploadedBytes;
+			unsigned int textures;
+
+			// Textures still queued or part way through.
+			unsigned int pending;
+		};
+
+		TextureUploader();
+
+		TextureUploader(const TextureUploader&) = delete;
+		TextureUploader& operator=(const TextureUploader&) = delete;
+
+		/**
+			setFrameBytes sets how many bytes process copies a frame. It
+				must be set before the first process, which makes a ring
+				of StreamingBuffer::REGION_COUNT times this.
+
+				@param1 a_bytes is the budget, at least MIN_FRAME_BYTES.
+		*/
+		void setFrameBytes(unsigned int a_bytes);
+
+		/**
+			getFrameBytes returns how many bytes process copies a frame.
+		*/
+		unsigned int getFrameBytes() const { return m_frameBytes; }
+
+		/**
+			queue adds a decoded texture to be uploaded. Queueing one that
+				is already queued only adds the callback.
+
+				@param1 a_texture is a texture with an upload pending. It
+						must stay alive until the callback.
+
+				@param2 a_onUploaded is called with whether it uploaded,
+						once it is in use, or nullptr.
+		*/
+		void queue(aie::Texture* a_texture, std::function<void(bool)> a_onUploaded = nullptr);
+
+		/**
+			process copies as much of the queued textures as fits the
+				frame's budget and puts those that are complete in use.
+				Call it once a frame.
+
+				@return how many textures were finished.
+		*/
+		unsigned int process();
+
+		/**
+			getPendingCount returns how many textures are queued or part
+				way through.
+		*/
+		unsigned int getPendingCount() const { return (unsigned int)m_jobs.size(); }
+
+		/**
+			getStats returns what the last process did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		/**
+			A queued texture and how far through it the uploads are.
+		*/
+		struct Job
+		{
+			aie::Texture* texture;
+			std::vector<std::function<void(bool)>> callbacks;
+			bool started;
+			bool succeeded;
+
+			// The levels to copy, the one being copied and the next row
+			//	or row of blocks of it.
+			unsigned int firstLevel;
+			unsigned int lastLevel;
+			unsigned int level;
+			unsigned int row;
+		};
+
+		/**
+			A band of a level copied into the region, for glTextureSubImage2D
+				once the region is written.
+		*/
+		struct Copy
+		{
+			unsigned int texture;
+			unsigned int level;
+			unsigned int y;
+			unsigned int width;
+			unsigned int height;
+			unsigned int offset;
+			unsigned int bytes;
+			unsigned int format;
+			bool compressed;
+		};
+
+		// Copies as much of a started job as fits the region, returns
+		//	false once the region is full.
+		bool stage(Job& a_job, char* a_region, unsigned int& a_used);
+
+		StreamingBuffer m_ring;
+		unsigned int m_frameBytes;
+
+		std::deque<Job> m_jobs;
+
+		// Kept between frames for their memory.
+		std::vector<Copy> m_copies;
+		std::vector<Job> m_finished;
+
+		Stats m_stats;
+	};
+}
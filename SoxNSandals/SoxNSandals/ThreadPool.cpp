@@ -0,0 +1,108 @@
+/**
+	ThreadPool.cpp
+
+	Purpose: ThreadPool.cpp is the source file for the ThreadPool class.
+			The ThreadPool class owns a group of worker threads that
+			run tasks in the background.
+
+	@author Nathan Nette
+*/
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace sns
+{
+	/**
+		The constructor starts the worker threads.
+
+			@param1 a_threadCount is how many workers to create. 0 uses
+					one less than the number of cores.
+	*/
+	ThreadPool::ThreadPool(unsigned int a_threadCount)
+		: m_activeTasks(0),
+		m_stopping(false)
+	{
+		if (a_threadCount == 0)
+		{
+			unsigned int cores = std::thread::hardware_concurrency();
+			a_threadCount = cores > 1 ? cores - 1 : 1;
+		}
+
+		m_threads.reserve(a_threadCount);
+		for (unsigned int i = 0; i < a_threadCount; ++i)
+			m_threads.emplace_back(&ThreadPool::workerLoop, this);
+	}
+
+	/**
+		The deconstructor throws away any tasks that haven't started
+			and waits for running tasks to finish.
+	*/
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+			m_tasks.clear();
+		}
+		m_taskCondition.notify_all();
+
+		for (auto& thread : m_threads)
+			thread.join();
+	}
+
+	/**
+		enqueue adds a task to be run on a worker thread.
+
+			@param1 a_task is the function to run.
+	*/
+	void ThreadPool::enqueue(std::function<void()> a_task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(std::move(a_task));
+		}
+		m_taskCondition.notify_one();
+	}
+
+	/**
+		waitIdle blocks until every queued task has finished.
+	*/
+	void ThreadPool::waitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idleCondition.wait(lock, [this]() { return m_tasks.empty() && m_activeTasks == 0; });
+	}
+
+	/**
+		workerLoop is what each worker thread runs. It waits for
+			tasks and runs them until the pool is destroyed.
+	*/
+	void ThreadPool::workerLoop()
+	{
+		SNS_TRACE_THREAD("Thread pool worker");
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_taskCondition.wait(lock, [this]() { return m_stopping || m_tasks.empty() == false; });
+
+				if (m_stopping)
+					return;
+
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+				++m_activeTasks;
+			}
+
+			task();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				--m_activeTasks;
+				if (m_tasks.empty() && m_activeTasks == 0)
+					m_idleCondition.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,92 @@
+/**
+	ThreadPool.h
+
+	Purpose: ThreadPool.h is the header file for the ThreadPool class.
+			The ThreadPool class owns a group of worker threads that
+			run tasks in the background, so slow work like file parsing
+			and image decoding doesn't block the main thread.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The ThreadPool class runs tasks on a fixed number of worker threads.
+			Tasks are run in the order they are added.
+	*/
+	class ThreadPool
+	{
+	public:
+		/**
+			The constructor starts the worker threads.
+
+				@param1 a_threadCount is how many workers to create. 0 uses
+						one less than the number of cores, so the main
+						thread keeps a core to itself.
+		*/
+		ThreadPool(unsigned int a_threadCount = 0);
+
+		/**
+			The deconstructor throws away any tasks that haven't started
+				and waits for running tasks to finish.
+		*/
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/**
+			enqueue adds a task to be run on a worker thread.
+
+				@param1 a_task is the function to run.
+		*/
+		void enqueue(std::function<void()> a_task);
+
+		/**
+			waitIdle blocks until every queued task has finished.
+		*/
+		void waitIdle();
+
+		/**
+			getThreadCount returns how many worker threads there are.
+		*/
+		unsigned int getThreadCount() const { return (unsigned int)m_threads.size(); }
+
+	private:
+
+		/**
+			workerLoop is what each worker thread runs. It waits for
+				tasks and runs them until the pool is destroyed.
+		*/
+		void workerLoop();
+
+		// The worker threads.
+		std::vector<std::thread> m_threads;
+
+		// Tasks waiting to be run.
+		std::deque<std::function<void()>> m_tasks;
+
+		// Guards the task queue and counters.
+		std::mutex m_mutex;
+
+		// Wakes workers when a task is added.
+		std::condition_variable m_taskCondition;
+
+		// Wakes waitIdle when the last task finishes.
+		std::condition_variable m_idleCondition;
+
+		// How many tasks are currently running.
+		unsigned int m_activeTasks;
+
+		// Set when the pool is shutting down.
+		bool m_stopping;
+	};
+}
@@ -0,0 +1,83 @@
+/**
+	Trace.h
+
+	Purpose: Trace.h holds the tracing macros. They mark the zones of the
+			engine's hot paths for an external profiler, Tracy or Optick,
+			when one is linked, and compile to nothing when not.
+
+	@author Nathan Nette
+*/
+#pragma once
+
+/*
+	Tracing is turned on for one profiler by defining it for the whole
+		project:
+
+		SNS_TRACE_TRACY		Tracy. TRACY_ENABLE must be defined with it and
+							TracyClient.cpp built into the project.
+		SNS_TRACE_OPTICK	Optick, with OptickCore linked. It has no GL
+							backend, so gl zones are cpu zones only.
+
+	Release builds leave them out anyway, unless SNS_TRACE_RELEASE is
+		defined too, so a release build with a profiler is a choice and
+		never an accident.
+
+	The zones are separate from the Profiler's scopes, which are always
+		built and run only with --profile. Every profiler scope is a zone
+		too, see Profiler.h, so the passes show up either way.
+
+	Zone names must be string literals, as both profilers keep the
+		pointer.
+*/
+#if defined(NDEBUG) && !defined(SNS_TRACE_RELEASE)
+#undef SNS_TRACE_TRACY
+#undef SNS_TRACE_OPTICK
+#endif
+
+#if defined(SNS_TRACE_TRACY)
+
+#include "gl_core_4_5.h"
+#include <tracy/Tracy.hpp>
+#include <tracy/TracyOpenGL.hpp>
+
+// Times the rest of the enclosing block on the cpu.
+#define SNS_TRACE_ZONE(name) ZoneScopedN(name)
+
+// Times the rest of the enclosing block on the cpu, and the gl commands it
+//	issues on the gpu. Unlike the Profiler's gpu scopes, these can nest.
+#define SNS_TRACE_GL_ZONE(name) ZoneScopedN(name); TracyGpuZone(name)
+
+// Starts a new frame, at the top of the function a frame runs in. Optick
+//	times the frame as a zone, so it must be in that function's block.
+#define SNS_TRACE_FRAME() FrameMark
+
+// Names the calling thread, at the top of a thread's function.
+#define SNS_TRACE_THREAD(name) tracy::SetThreadName(name)
+
+// Starts gl zones, once the context's functions are loaded.
+#define SNS_TRACE_GL_CONTEXT() TracyGpuContext
+
+// Reads back finished gl zones, once a frame after the swap.
+#define SNS_TRACE_GL_COLLECT() TracyGpuCollect
+
+#elif defined(SNS_TRACE_OPTICK)
+
+#include <optick.h>
+
+#define SNS_TRACE_ZONE(name) OPTICK_EVENT(name)
+#define SNS_TRACE_GL_ZONE(name) OPTICK_EVENT(name)
+#define SNS_TRACE_FRAME() OPTICK_FRAME("Main")
+#define SNS_TRACE_THREAD(name) OPTICK_THREAD(name)
+#define SNS_TRACE_GL_CONTEXT() ((void)0)
+#define SNS_TRACE_GL_COLLECT() ((void)0)
+
+#else
+
+#define SNS_TRACE_ZONE(name) ((void)0)
+#define SNS_TRACE_GL_ZONE(name) ((void)0)
+#define SNS_TRACE_FRAME() ((void)0)
+#define SNS_TRACE_THREAD(name) ((void)0)
+#define SNS_TRACE_GL_CONTEXT() ((void)0)
+#define SNS_TRACE_GL_COLLECT() ((void)0)
+
+#endif
@@ -0,0 +1,228 @@
+/**
+	TraceScene.cpp
+
+	Purpose: TraceScene.cpp is the source file for the TraceScene class.
+			The TraceScene uploads the static scene's triangles and a Bvh
+			over them for compute shaders to trace rays through.
+
+	@author Nathan Nette
+*/
+#include "TraceScene.h"
+#include "Bvh.h"
+#include "GpuMemory.h"
+#include "OBJMesh.h"
+#include "gl_core_4_5.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+
+namespace sns
+{
+	// How far along its normal a ray starts from a surface, of the
+	//	scene's size.
+	static const float RAY_BIAS = 1e-4f;
+
+	/**
+		A world triangle as the shaders read it, a corner and the edges
+			from it, its material in the corner's w.
+	*/
+	struct TraceTriangle
+	{
+		glm::vec4 corner;
+		glm::vec4 edge1;
+		glm::vec4 edge2;
+	};
+
+	/**
+		A material as the shaders read it.
+	*/
+	struct TraceMaterial
+	{
+		glm::vec4 albedo;
+		glm::vec4 emission;
+	};
+
+	/**
+		hashBytes adds bytes to an FNV-1a hash.
+
+			@param1 a_hash is the hash so far.
+
+			@param2 a_data is the bytes.
+
+			@param3 a_size is how many there are.
+	*/
+	static unsigned int hashBytes(unsigned int a_hash, const void* a_data, size_t a_size)
+	{
+		const unsigned char* bytes = (const unsigned char*)a_data;
+		for (size_t i = 0; i < a_size; ++i)
+		{
+			a_hash ^= bytes[i];
+			a_hash *= 16777619u;
+		}
+		return a_hash;
+	}
+
+	TraceScene::TraceScene()
+		: m_triangleCount(0),
+		m_key(0),
+		m_rayBias(RAY_BIAS),
+		m_min(0.0f),
+		m_max(0.0f),
+		m_built(false)
+	{
+	}
+
+	TraceScene::~TraceScene()
+	{
+	}
+
+	/**
+		clear forgets every mesh and lets the buffers go.
+	*/
+	void TraceScene::clear()
+	{
+		m_placements.clear();
+		m_nodes.reset();
+		m_triangles.reset();
+		m_materials.reset();
+		m_triangleCount = 0;
+		m_key = 0;
+		m_min = glm::vec3(0.0f);
+		m_max = glm::vec3(0.0f);
+		m_built = false;
+	}
+
+	/**
+		add places a mesh in the scene, until the next clear.
+
+			@param1 a_mesh is the mesh, which must be pickable.
+
+			@param2 a_transform is where it is placed.
+	*/
+	void TraceScene::add(const aie::OBJMesh& a_mesh, const glm::mat4& a_transform)
+	{
+		Placement placement = { &a_mesh, a_transform };
+		m_placements.push_back(placement);
+	}
+
+	/**
+		build gathers every placed mesh's world triangles, each material
+			of each mesh once with its flat colours, and uploads them in
+			the order a Bvh over them leaves them in, with its nodes.
+
+			@return false without GL 4.5 or any triangles.
+	*/
+	bool TraceScene::build()
+	{
+		m_nodes.reset();
+		m_triangles.reset();
+		m_materials.reset();
+		m_triangleCount = 0;
+		m_built = true;
+		if (ogl_IsVersionGEQ(4, 5) == false)
+			return false;
+
+		std::vector<TraceTriangle> triangles;
+		std::vector<Bvh::Box> boxes;
+		std::vector<TraceMaterial> materials;
+		std::map<std::pair<const aie::OBJMesh*, int>, unsigned int> materialIndices;
+		glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+
+		for (const Placement& placement : m_placements)
+		{
+			const aie::OBJMesh& mesh = *placement.mesh;
+			for (unsigned int c = 0; c < (unsigned int)mesh.getChunkCount(); ++c)
+			{
+				int materialID = mesh.getChunk(c).materialID;
+				auto found = materialIndices.find(std::make_pair(&mesh, materialID));
+				if (found == materialIndices.end())
+				{
+					TraceMaterial material = { glm::vec4(0.5f, 0.5f, 0.5f, 1.0f), glm::vec4(0.0f) };
+					if (materialID >= 0 && materialID < (int)mesh.getMaterialCount())
+					{
+						const aie::OBJMesh::Material& source = mesh.getMaterial(materialID);
+						material.albedo = glm::vec4(source.diffuse, 1.0f);
+						material.emission = glm::vec4(source.emissive, 0.0f);
+					}
+					found = materialIndices.emplace(std::make_pair(&mesh, materialID), (unsigned int)materials.size()).first;
+					materials.push_back(material);
+				}
+				float materialBits;
+				memcpy(&materialBits, &found->second, sizeof(float));
+
+				for (unsigned int t = 0; t < mesh.getTriangleCount(c); ++t)
+				{
+					glm::vec3 corners[3];
+					mesh.getTriangle(c, t, corners);
+					glm::vec3 world[3];
+					for (unsigned int i = 0; i < 3; ++i)
+						world[i] = glm::vec3(placement.transform * glm::vec4(corners[i], 1.0f));
+
+					TraceTriangle triangle = { glm::vec4(world[0], materialBits), glm::vec4(world[1] - world[0], 0.0f),
+						glm::vec4(world[2] - world[0], 0.0f) };
+					triangles.push_back(triangle);
+					Bvh::Box box = { glm::min(world[0], glm::min(world[1], world[2])),
+						glm::max(world[0], glm::max(world[1], world[2])) };
+					boxes.push_back(box);
+					sceneMin = glm::min(sceneMin, box.min);
+					sceneMax = glm::max(sceneMax, box.max);
+				}
+			}
+		}
+
+		if (triangles.empty())
+		{
+			m_key = 0;
+			m_min = glm::vec3(0.0f);
+			m_max = glm::vec3(0.0f);
+			return false;
+		}
+
+		// The triangles go in the order the leaves index them.
+		Bvh bvh;
+		bvh.build(boxes.data(), (unsigned int)boxes.size());
+		const std::vector<uint32_t>& leafOrder = bvh.getLeafPrimitives();
+		std::vector<TraceTriangle> ordered(leafOrder.size());
+		for (size_t i = 0; i < leafOrder.size(); ++i)
+			ordered[i] = triangles[leafOrder[i]];
+
+		m_key = hashBytes(2166136261u, ordered.data(), ordered.size() * sizeof(TraceTriangle));
+		m_key = hashBytes(m_key, materials.data(), materials.size() * sizeof(TraceMaterial));
+		m_min = sceneMin;
+		m_max = sceneMax;
+		m_rayBias = std::max(glm::length(sceneMax - sceneMin) * RAY_BIAS, RAY_BIAS);
+		m_triangleCount = (unsigned int)ordered.size();
+
+		struct Upload { BufferHandle* buffer; const void* data; size_t bytes; };
+		Upload uploads[] = {
+			{ &m_triangles, ordered.data(), ordered.size() * sizeof(TraceTriangle) },
+			{ &m_nodes, bvh.getNodes().data(), bvh.getNodes().size() * sizeof(Bvh::Node) },
+			{ &m_materials, materials.data(), materials.size() * sizeof(TraceMaterial) },
+		};
+		GpuMemory& memory = GpuMemory::instance();
+		for (const Upload& upload : uploads)
+		{
+			glCreateBuffers(1, upload.buffer->put());
+			glNamedBufferStorage(*upload.buffer, upload.bytes, upload.data, 0);
+			memory.trackBuffer(*upload.buffer, upload.bytes, GpuMemory::LIGHTING, "TraceScene");
+		}
+
+		printf("TraceScene: %u triangles from %u meshes\n", m_triangleCount, (unsigned int)m_placements.size());
+		return true;
+	}
+
+	/**
+		bind binds the nodes, triangles and materials to their shader
+			storage bindings.
+	*/
+	void TraceScene::bind() const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, m_nodes);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRIANGLE_BINDING, m_triangles);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, m_materials);
+	}
+}
@@ -0,0 +1,137 @@
+/**
+	TraceScene.h
+
+	Purpose: TraceScene.h is the header file for the TraceScene class.
+			The TraceScene uploads the triangles of the static scene with
+			a Bvh over them, for compute shaders to trace rays through
+			with sceneTrace.glsl.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace aie
+{
+	class OBJMesh;
+}
+
+namespace sns
+{
+	/**
+		The TraceScene class gathers the world triangles of every mesh
+			added to it, each of which must be pickable, with the flat
+			diffuse and emissive colours of their materials. build
+			orders them as the leaves of a Bvh over them index them and
+			uploads them with its nodes as they are, so a shader walks
+			the same tree the cpu built.
+
+		Both the Lightmapper and the ProbeVolume trace through one, so
+			the lightmaps and the probes see the same scene. Its key is
+			a hash of every triangle and material, telling a bake of
+			this scene from one of another. Needs GL 4.5.
+	*/
+	class TraceScene
+	{
+	public:
+		// The buffers bind binds, must match sceneTrace.glsl.
+		static const unsigned int NODE_BINDING = 1;
+		static const unsigned int TRIANGLE_BINDING = 2;
+		static const unsigned int MATERIAL_BINDING = 3;
+
+		TraceScene();
+		~TraceScene();
+
+		TraceScene(const TraceScene&) = delete;
+		TraceScene& operator=(const TraceScene&) = delete;
+
+		/**
+			clear forgets every mesh and lets the buffers go, for a scene
+				that changed.
+		*/
+		void clear();
+
+		/**
+			add places a mesh in the scene, until the next clear. Its
+				triangles are copied when it is built, so it only has to
+				stay loaded until then.
+
+				@param1 a_mesh is the mesh, which must be pickable.
+
+				@param2 a_transform is where it is placed.
+		*/
+		void add(const aie::OBJMesh& a_mesh, const glm::mat4& a_transform);
+
+		/**
+			build gathers and uploads the added meshes' triangles.
+
+				@return false without GL 4.5 or any triangles, it is
+						built, but empty.
+		*/
+		bool build();
+
+		/**
+			isBuilt returns whether build has run since the last clear.
+		*/
+		bool isBuilt() const { return m_built; }
+
+		/**
+			isEmpty returns whether there is nothing to trace.
+		*/
+		bool isEmpty() const { return m_triangleCount == 0; }
+
+		/**
+			getKey returns a hash of the triangles and materials built.
+		*/
+		unsigned int getKey() const { return m_key; }
+
+		/**
+			getRayBias returns how far off a surface a ray should start,
+				for the scene's size.
+		*/
+		float getRayBias() const { return m_rayBias; }
+
+		/**
+			getMin and getMax return the corners of the box around every
+				triangle built.
+		*/
+		const glm::vec3& getMin() const { return m_min; }
+		const glm::vec3& getMax() const { return m_max; }
+
+		/**
+			getTriangleCount returns how many triangles were built.
+		*/
+		unsigned int getTriangleCount() const { return m_triangleCount; }
+
+		/**
+			bind binds the nodes, triangles and materials to their
+				shader storage bindings.
+		*/
+		void bind() const;
+
+	private:
+		/**
+			A placed mesh.
+		*/
+		struct Placement
+		{
+			const aie::OBJMesh* mesh;
+			glm::mat4 transform;
+		};
+
+		std::vector<Placement> m_placements;
+
+		BufferHandle m_nodes;
+		BufferHandle m_triangles;
+		BufferHandle m_materials;
+		unsigned int m_triangleCount;
+		unsigned int m_key;
+		float m_rayBias;
+		glm::vec3 m_min;
+		glm::vec3 m_max;
+		bool m_built;
+	};
+}
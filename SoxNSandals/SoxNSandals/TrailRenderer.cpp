@@ -0,0 +1,231 @@
+/**
+	TrailRenderer.cpp
+
+	Purpose: TrailRenderer.cpp is the source file for the TrailRenderer
+			class. The TrailRenderer draws ribbons behind things that
+			move, such as sparks, tracers or the planets, from where
+			they have been over the last few records.
+
+	@author Nathan Nette
+*/
+#include "TrailRenderer.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace sns
+{
+	TrailRenderer::TrailRenderer()
+		: m_maxTrails(0),
+		m_history(0),
+		m_head(0),
+		m_recorded(0),
+		m_width(1.0f, 0.0f),
+		m_frontColour(1),
+		m_backColour(1, 1, 1, 0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the buffers and vertex array.
+	*/
+	TrailRenderer::~TrailRenderer()
+	{
+		destroy();
+	}
+
+	/**
+		create loads the shader and makes the ring buffer, with no trails
+			in it.
+
+			@param1 a_maxTrails is how many trails there are.
+
+			@param2 a_history is how many points each keeps, 2 to
+					MAX_HISTORY.
+
+			@return false without GL 4.5 or the shader, it is left
+					uncreated.
+	*/
+	bool TrailRenderer::create(unsigned int a_maxTrails, unsigned int a_history)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("TrailRenderer: drawing trails needs GL 4.5.\n");
+			return false;
+		}
+		if (a_maxTrails == 0)
+			return false;
+
+		if (m_shader.getHandle() == 0)
+		{
+			m_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/trail.vert");
+			m_shader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/trail.frag");
+			if (m_shader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_shader.getLastError());
+				return false;
+			}
+		}
+
+		m_maxTrails = a_maxTrails;
+		m_history = glm::clamp(a_history, 2u, MAX_HISTORY);
+		m_recordTimes.assign(m_history, 0.0f);
+		m_segmentAges.assign(m_history, 0.0f);
+		m_upload.resize(m_maxTrails);
+		clear();
+
+		unsigned long long bytes = (unsigned long long)m_maxTrails * m_history * sizeof(glm::vec4);
+		glCreateBuffers(1, m_points.put());
+		glNamedBufferStorage(m_points, bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		GpuMemory::instance().trackBuffer(m_points, bytes, GpuMemory::PARTICLES, "TrailRenderer");
+
+		// The vertices are made from their index, the vertex array only
+		//	has to be bound.
+		glCreateVertexArrays(1, m_vao.put());
+		return true;
+	}
+
+	/**
+		destroy deletes the buffers and vertex array.
+	*/
+	void TrailRenderer::destroy()
+	{
+		m_vao.reset();
+		m_points.reset();
+		m_maxTrails = 0;
+		m_history = 0;
+		m_recorded = 0;
+	}
+
+	/**
+		clear forgets every point, so every trail starts over. The slots
+			are only read once they have been recorded into again.
+	*/
+	void TrailRenderer::clear()
+	{
+		m_head = 0;
+		m_recorded = 0;
+	}
+
+	/**
+		record adds a point to the front of every trail, all of them in
+			one upload of the slot.
+
+			@param1 a_points are each trail's point, xyz its position and
+					w how long it had been going, below 0 for no trail.
+
+			@param2 a_count is how many points, trails past them are left
+					without one.
+
+			@param3 a_time is when they were recorded.
+
+			@param4 a_advance is whether to add them as a new slot, or
+					move the front points to them.
+	*/
+	void TrailRenderer::record(const glm::vec4* a_points, unsigned int a_count, float a_time, bool a_advance)
+	{
+		if (isCreated() == false)
+			return;
+
+		unsigned int first = beginRecord(a_time, a_advance);
+		a_count = std::min(a_count, m_maxTrails);
+		memcpy(m_upload.data(), a_points, a_count * sizeof(glm::vec4));
+		std::fill(m_upload.begin() + a_count, m_upload.end(), glm::vec4(0, 0, 0, -1));
+		glNamedBufferSubData(m_points, first * sizeof(glm::vec4), m_maxTrails * sizeof(glm::vec4), m_upload.data());
+	}
+
+	/**
+		beginRecord moves on to the next slot for a compute shader to
+			write into. The first record always moves on, there is no
+			front to write again.
+
+			@param1 a_time is when it is recorded.
+
+			@param2 a_advance is whether to move on from the front slot
+					or write it again.
+
+			@return the first point of the slot in the buffer.
+	*/
+	unsigned int TrailRenderer::beginRecord(float a_time, bool a_advance)
+	{
+		if (a_advance || m_recorded == 0)
+		{
+			m_head = (m_head + 1) % m_history;
+			m_recorded = std::min(m_recorded + 1, m_history);
+		}
+		m_recordTimes[m_head] = a_time;
+		return m_head * m_maxTrails;
+	}
+
+	/**
+		setColour sets the ribbons' colours, not premultiplied.
+
+			@param1 a_front is the colour at their front.
+
+			@param2 a_back is the colour at their oldest point.
+	*/
+	void TrailRenderer::setColour(const glm::vec4& a_front, const glm::vec4& a_back)
+	{
+		m_frontColour = a_front;
+		m_backColour = a_back;
+	}
+
+	/**
+		draw draws every trail, blended over the scene with the depth
+			tested but not written, as the particles are. Each trail is
+			an instance of a strip with two vertices a point.
+
+			@param1 a_projectionView is the view's projection and view.
+
+			@param2 a_cameraPosition is where the ribbons face.
+	*/
+	void TrailRenderer::draw(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition)
+	{
+		static constexpr aie::UniformHandle PROJECTION_VIEW("ProjectionView");
+		static constexpr aie::UniformHandle CAMERA_POSITION("CameraPosition");
+		static constexpr aie::UniformHandle TRAIL_COUNT("TrailCount");
+		static constexpr aie::UniformHandle HISTORY("History");
+		static constexpr aie::UniformHandle HEAD("Head");
+		static constexpr aie::UniformHandle RECORDED("Recorded");
+		static constexpr aie::UniformHandle SEGMENT_AGES("SegmentAges");
+		static constexpr aie::UniformHandle WIDTH("Width");
+		static constexpr aie::UniformHandle FRONT_COLOUR("FrontColour");
+		static constexpr aie::UniformHandle BACK_COLOUR("BackColour");
+
+		if (isCreated() == false || m_recorded < 2)
+			return;
+
+		// How long ago each point was recorded, which the shader checks
+		//	against its trail's age to find where the trail started.
+		float front = m_recordTimes[m_head];
+		for (unsigned int segment = 0; segment < m_recorded; ++segment)
+			m_segmentAges[segment] = front - m_recordTimes[(m_head + m_history - segment) % m_history];
+
+		m_shader.bind();
+		m_shader.bindUniform(PROJECTION_VIEW, a_projectionView);
+		m_shader.bindUniform(CAMERA_POSITION, a_cameraPosition);
+		m_shader.bindUniform(TRAIL_COUNT, (int)m_maxTrails);
+		m_shader.bindUniform(HISTORY, (int)m_history);
+		m_shader.bindUniform(HEAD, (int)m_head);
+		m_shader.bindUniform(RECORDED, (int)m_recorded);
+		m_shader.bindUniform(SEGMENT_AGES, (int)m_recorded, m_segmentAges.data());
+		m_shader.bindUniform(WIDTH, m_width);
+		m_shader.bindUniform(FRONT_COLOUR, m_frontColour);
+		m_shader.bindUniform(BACK_COLOUR, m_backColour);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_BINDING, m_points);
+
+		RenderState& state = RenderState::instance();
+		state.setBlend(true);
+		state.setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		state.setDepthMask(false);
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, m_recorded * 2, m_maxTrails);
+		state.setDepthMask(true);
+		state.setBlend(false);
+	}
+}
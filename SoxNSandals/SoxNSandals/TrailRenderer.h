@@ -0,0 +1,193 @@
+/**
+	TrailRenderer.h
+
+	Purpose: TrailRenderer.h is the header file for the TrailRenderer
+			class. The TrailRenderer draws ribbons behind things that
+			move, such as sparks, tracers or the planets, from where
+			they have been over the last few records.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The TrailRenderer class keeps the history of every trail in one
+			ring buffer on the gpu, a slot of points for each record,
+			every trail's point side by side in it. A record writes one
+			point a trail into the next slot, over the oldest, so the
+			trails are never rebuilt on the cpu, and a compute shader can
+			write the slot itself, as the GPUParticleEmitter does.
+
+		Each trail is drawn as one instanced triangle strip with no vertex
+			buffer. The vertex shader finds its point from the vertex
+			index, and pushes it out to either side, across both the
+			trail and the direction to the camera, so the ribbon faces
+			the camera along its length.
+
+		A point's w is how long its trail had been going when it was
+			recorded, or below 0 for no trail. Points recorded before
+			that trail started belong to whatever was in the slot
+			before, such as a particle that has died, so the ribbon
+			stops at the oldest point of its own, and a new trail never
+			joins onto an old one.
+
+		The buffers are made with GL 4.5 and the shader reads them with
+			GL 4.3, without them create fails.
+	*/
+	class TrailRenderer
+	{
+	public:
+		// The most points a trail's history holds.
+		static const unsigned int MAX_HISTORY = 64;
+
+		// The buffer binding the points are read and written at.
+		static const unsigned int POINT_BINDING = 4;
+
+		TrailRenderer();
+
+		/**
+			The deconstructor deletes the buffers and vertex array.
+		*/
+		~TrailRenderer();
+
+		TrailRenderer(const TrailRenderer&) = delete;
+		TrailRenderer& operator=(const TrailRenderer&) = delete;
+
+		/**
+			create loads the shader and makes the ring buffer, with no
+				trails in it.
+
+				@param1 a_maxTrails is how many trails there are.
+
+				@param2 a_history is how many points each keeps, 2 to
+						MAX_HISTORY.
+
+				@return false without GL 4.5 or the shader, it is left
+						uncreated.
+		*/
+		bool create(unsigned int a_maxTrails, unsigned int a_history);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vao != 0; }
+
+		/**
+			destroy deletes the buffers and vertex array.
+		*/
+		void destroy();
+
+		/**
+			clear forgets every point, so every trail starts over.
+		*/
+		void clear();
+
+		/**
+			record adds a point to the front of every trail.
+
+				@param1 a_points are each trail's point, xyz its position
+						and w how long it had been going, below 0 for
+						no trail.
+
+				@param2 a_count is how many points, trails past them are
+						left without one.
+
+				@param3 a_time is when they were recorded, in seconds on
+						any clock that only goes forward.
+
+				@param4 a_advance is whether to add them as a new slot,
+						or move the front points to them. Recording now
+						and then, and moving the front every frame,
+						keeps a trail long and smooth.
+		*/
+		void record(const glm::vec4* a_points, unsigned int a_count, float a_time, bool a_advance = true);
+
+		/**
+			beginRecord moves on to the next slot for a compute shader to
+				write into, as record does.
+
+				@param1 a_time is when it is recorded.
+
+				@param2 a_advance is whether to move on from the front
+						slot or write it again.
+
+				@return the first point of the slot in the buffer, the
+						trail's index is added to it.
+		*/
+		unsigned int beginRecord(float a_time, bool a_advance = true);
+
+		/**
+			draw draws every trail, blended over the scene. The ribbons
+				narrow and fade from front to back.
+
+				@param1 a_projectionView is the view's projection and
+						view.
+
+				@param2 a_cameraPosition is where the ribbons face.
+		*/
+		void draw(const glm::mat4& a_projectionView, const glm::vec3& a_cameraPosition);
+
+		/**
+			setWidth sets how wide the ribbons are.
+
+				@param1 a_front is the width at their front.
+
+				@param2 a_back is the width at their oldest point.
+		*/
+		void setWidth(float a_front, float a_back) { m_width = glm::vec2(a_front, a_back); }
+
+		/**
+			setColour sets the ribbons' colours, not premultiplied.
+
+				@param1 a_front is the colour at their front.
+
+				@param2 a_back is the colour at their oldest point.
+		*/
+		void setColour(const glm::vec4& a_front, const glm::vec4& a_back);
+
+		/**
+			getBuffer returns the ring buffer of points.
+		*/
+		unsigned int getBuffer() const { return m_points; }
+
+		/**
+			getMaxTrails returns how many trails there are.
+		*/
+		unsigned int getMaxTrails() const { return m_maxTrails; }
+
+		/**
+			getHistory returns how many points each trail keeps.
+		*/
+		unsigned int getHistory() const { return m_history; }
+
+	private:
+		aie::ShaderProgram m_shader;
+		VertexArrayHandle m_vao;
+		BufferHandle m_points;
+
+		unsigned int m_maxTrails;
+		unsigned int m_history;
+
+		// The slot last recorded into and how many have been.
+		unsigned int m_head;
+		unsigned int m_recorded;
+
+		// When each slot was recorded, and how long before the front one
+		//	each of the recorded slots was, front first, for the shader.
+		std::vector<float> m_recordTimes;
+		std::vector<float> m_segmentAges;
+
+		// The cpu's points, to write into the buffer.
+		std::vector<glm::vec4> m_upload;
+
+		glm::vec2 m_width;
+		glm::vec4 m_frontColour;
+		glm::vec4 m_backColour;
+	};
+}
@@ -0,0 +1,327 @@
+/**
+	TransparencyTarget.cpp
+
+	Purpose: TransparencyTarget.cpp is the source file for the
+			TransparencyTarget class. The TransparencyTarget blends
+			transparent surfaces over the scene in the right order
+			whatever order they are drawn in, so they needn't be sorted.
+
+	@author Nathan Nette
+*/
+#include "TransparencyTarget.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace sns
+{
+	// The units the weighted resolve reads the targets from, past the
+	//	particle target's.
+	static const unsigned int ACCUMULATION_UNIT = 12;
+	static const unsigned int REVEALAGE_UNIT = 13;
+
+	// Where transparency.glsl and the list resolve find the heads and
+	//	nodes.
+	static const unsigned int HEAD_IMAGE = 2;
+	static const unsigned int NODE_BINDING = 6;
+
+	// The node buffer starts with the count and capacity, padded to the
+	//	16 bytes of a node.
+	static const unsigned int NODE_HEADER_BYTES = 16;
+	static const unsigned int NODE_BYTES = 16;
+
+	// A list's end, and what every head is cleared to.
+	static const uint32_t NO_NODE = 0xffffffff;
+
+	/**
+		loadResolve loads and links a full screen resolve shader.
+
+			@param1 a_shader is the program.
+
+			@param2 a_path is the fragment shader's file.
+
+			@return false if it didn't link.
+	*/
+	static bool loadResolve(aie::ShaderProgram& a_shader, const char* a_path)
+	{
+		if (a_shader.getHandle() != 0)
+			return true;
+
+		a_shader.loadShader(aie::eShaderStage::VERTEX, "../shaders/particleUpsample.vert");
+		a_shader.loadShader(aie::eShaderStage::FRAGMENT, a_path);
+		if (a_shader.link() == false)
+		{
+			printf("Shader Error: %s\n", a_shader.getLastError());
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		createTarget makes a render target, read only with texelFetch.
+
+			@param1 a_texture is the handle to make it into.
+
+			@param2 a_format is its format.
+
+			@param3 a_width is its width.
+
+			@param4 a_height is its height.
+	*/
+	static void createTarget(TextureHandle& a_texture, unsigned int a_format, int a_width, int a_height)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, a_texture.put());
+		glTextureStorage2D(a_texture, 1, a_format, a_width, a_height);
+		GpuMemory::instance().trackTexture(a_texture, GpuMemory::getTextureBytes(a_format, a_width, a_height),
+			GpuMemory::RENDER_TARGETS, "TransparencyTarget");
+		glTextureParameteri(a_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(a_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	TransparencyTarget::TransparencyTarget()
+		: m_framebuffer(0),
+		m_nodeCapacity(0),
+		m_width(0),
+		m_height(0),
+		m_unitsPerMetre(100.0f),
+		m_method(WEIGHTED),
+		m_previousFramebuffer(0),
+		m_previousBlendSource(GL_ONE),
+		m_previousBlendDestination(GL_ZERO),
+		m_previousBlend(false)
+	{
+	}
+
+	/**
+		The deconstructor deletes the framebuffers, textures and buffer.
+	*/
+	TransparencyTarget::~TransparencyTarget()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the weighted targets and loads the resolve shaders.
+			The revealage is only a product of transparencies, so one
+			channel of half floats holds it.
+
+			@param1 a_width is the width of the window.
+
+			@param2 a_height is the height of the window.
+
+			@return false without GL 4.5 or the shaders, the target is
+					left uncreated.
+	*/
+	bool TransparencyTarget::create(int a_width, int a_height)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("TransparencyTarget: order independent transparency needs GL 4.5.\n");
+			return false;
+		}
+
+		if (loadResolve(m_weightedShader, "../shaders/transparencyWeighted.frag") == false ||
+			loadResolve(m_listShader, "../shaders/transparencyLists.frag") == false)
+			return false;
+
+		m_width = a_width > 1 ? a_width : 1;
+		m_height = a_height > 1 ? a_height : 1;
+
+		// Half floats, so the weighted sums neither band nor overflow.
+		createTarget(m_accumulation, GL_RGBA16F, m_width, m_height);
+		createTarget(m_revealage, GL_R16F, m_width, m_height);
+		createTarget(m_depth, RenderState::instance().getDepthFormat(), m_width, m_height);
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_accumulation, 0);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT1, m_revealage, 0);
+		glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_depth, 0);
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glNamedFramebufferDrawBuffers(m_framebuffer, 2, drawBuffers);
+		if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("TransparencyTarget: the weighted targets aren't complete.\n");
+			destroy();
+			return false;
+		}
+
+		glCreateVertexArrays(1, m_vao.put());
+		return true;
+	}
+
+	/**
+		createLists makes the heads and the nodes.
+
+			@return false if they couldn't be made.
+	*/
+	bool TransparencyTarget::createLists()
+	{
+		if (m_nodes != 0)
+			return true;
+
+		m_nodeCapacity = (unsigned int)m_width * (unsigned int)m_height * AVERAGE_LAYERS;
+		GpuMemory& memory = GpuMemory::instance();
+		glCreateTextures(GL_TEXTURE_2D, 1, m_heads.put());
+		glTextureStorage2D(m_heads, 1, GL_R32UI, m_width, m_height);
+		memory.trackTexture(m_heads, GpuMemory::getTextureBytes(GL_R32UI, m_width, m_height),
+			GpuMemory::RENDER_TARGETS, "TransparencyTarget");
+
+		size_t bytes = NODE_HEADER_BYTES + (size_t)m_nodeCapacity * NODE_BYTES;
+		glCreateBuffers(1, m_nodes.put());
+		glNamedBufferStorage(m_nodes, bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		memory.trackBuffer(m_nodes, bytes, GpuMemory::RENDER_TARGETS, "TransparencyTarget");
+		return glGetError() == GL_NO_ERROR;
+	}
+
+	/**
+		begin starts drawing transparent surfaces under the viewport.
+			The weighted method binds its targets over a copy of the
+			scene's depth, adding up the colours and multiplying the
+			revealage. The lists are drawn into the scene's framebuffer
+			with colour writes off, once the heads are cleared and the
+			count set back to 0.
+
+			@param1 a_method is how they are put in order.
+	*/
+	void TransparencyTarget::begin(Method a_method)
+	{
+		RenderState& state = RenderState::instance();
+		m_method = a_method == LINKED_LISTS && createLists() ? LINKED_LISTS : WEIGHTED;
+		m_previousBlend = state.isBlendEnabled();
+		state.getBlendFunc(m_previousBlendSource, m_previousBlendDestination);
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+		state.setDepthMask(false);
+
+		if (m_method == LINKED_LISTS)
+		{
+			const uint32_t header[2] = { 0, m_nodeCapacity };
+			glNamedBufferSubData(m_nodes, 0, sizeof(header), header);
+			glClearTexImage(m_heads, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &NO_NODE);
+			state.setColourMask(false);
+			state.setBlend(false);
+			return;
+		}
+
+		int viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		int right = std::min(viewport[0] + viewport[2], m_width);
+		int top = std::min(viewport[1] + viewport[3], m_height);
+		glBlitNamedFramebuffer(m_previousFramebuffer, m_framebuffer, viewport[0], viewport[1], right, top,
+			viewport[0], viewport[1], right, top, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		const float nothing[4] = { 0, 0, 0, 0 };
+		const float revealed[4] = { 1, 1, 1, 1 };
+		glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, 0, nothing);
+		glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, 1, revealed);
+
+		// Each target blends its own way, which the render state doesn't
+		//	cache, and end sets both back.
+		state.setBlend(true);
+		glBlendFunci(0, GL_ONE, GL_ONE);
+		glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	}
+
+	/**
+		bind points a program drawing between begin and end at the
+			target, through transparency.glsl.
+
+			@param1 a_shader is the program, already bound.
+	*/
+	void TransparencyTarget::bind(aie::ShaderProgram& a_shader) const
+	{
+		static constexpr aie::UniformHandle METHOD("TransparencyMethod");
+		static constexpr aie::UniformHandle UNITS_PER_METRE("TransparencyUnitsPerMetre");
+
+		a_shader.bindUniform(METHOD, (int)m_method);
+		a_shader.bindUniform(UNITS_PER_METRE, m_unitsPerMetre);
+		if (m_method == LINKED_LISTS)
+		{
+			glBindImageTexture(HEAD_IMAGE, m_heads, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, m_nodes);
+		}
+	}
+
+	/**
+		end puts back the framebuffer and state begin replaced and blends
+			what was drawn over it, with one triangle over the window.
+			Everything was depth tested as it was drawn, so nothing is
+			tested again.
+	*/
+	void TransparencyTarget::end()
+	{
+		static constexpr aie::UniformHandle ACCUMULATION("Accumulation");
+		static constexpr aie::UniformHandle REVEALAGE("Revealage");
+
+		RenderState& state = RenderState::instance();
+		aie::ShaderProgram* resolve = &m_listShader;
+		if (m_method == LINKED_LISTS)
+		{
+			state.setColourMask(true);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+			glBindImageTexture(HEAD_IMAGE, m_heads, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, m_nodes);
+			state.setBlend(true);
+			state.setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			resolve->bind();
+		}
+		else
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+			glBlendFunc(m_previousBlendSource, m_previousBlendDestination);
+			state.bindTexture(ACCUMULATION_UNIT, m_accumulation);
+			state.bindTexture(REVEALAGE_UNIT, m_revealage);
+			resolve = &m_weightedShader;
+			resolve->bind();
+			resolve->bindUniform(ACCUMULATION, (int)ACCUMULATION_UNIT);
+			resolve->bindUniform(REVEALAGE, (int)REVEALAGE_UNIT);
+			state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+
+		state.setDepthTest(false);
+		state.bindVertexArray(m_vao);
+		state.countDraw();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		state.setDepthTest(true);
+
+		state.setDepthMask(true);
+		state.setBlendFunc(m_previousBlendSource, m_previousBlendDestination);
+		state.setBlend(m_previousBlend);
+	}
+
+	/**
+		getMethodName returns a method's name, to print.
+
+			@param1 a_method is the method.
+	*/
+	const char* TransparencyTarget::getMethodName(Method a_method)
+	{
+		switch (a_method)
+		{
+		case WEIGHTED:
+			return "weighted blended";
+		case LINKED_LISTS:
+			return "per-pixel linked lists";
+		default:
+			return "unknown";
+		}
+	}
+
+	/**
+		destroy deletes the framebuffers, textures and buffer.
+	*/
+	void TransparencyTarget::destroy()
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+		m_accumulation.reset();
+		m_revealage.reset();
+		m_depth.reset();
+		m_heads.reset();
+		m_nodes.reset();
+		m_vao.reset();
+		m_nodeCapacity = 0;
+	}
+}
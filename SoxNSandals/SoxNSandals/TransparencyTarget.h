@@ -0,0 +1,174 @@
+/**
+	TransparencyTarget.h
+
+	Purpose: TransparencyTarget.h is the header file for the
+			TransparencyTarget class. The TransparencyTarget blends
+			transparent surfaces over the scene in the right order
+			whatever order they are drawn in, so they needn't be sorted.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "Shader.h"
+
+namespace sns
+{
+	/**
+		The TransparencyTarget class draws order independent transparency
+			two ways, picked at each begin.
+
+		Weighted blended is one pass into two targets: every fragment
+			adds its premultiplied colour, weighted to favour what is
+			nearer, into an accumulation target, and multiplies its
+			transparency into a revealage target. end divides the sum
+			back out and blends it over the scene by how much the
+			revealage hides it. It costs little more than blending, but
+			only approximates the order, so layers of very different
+			colours mix.
+
+		Per-pixel linked lists are exact. Every fragment is appended to a
+			buffer of nodes and linked in front of the pixel's list,
+			whose head is in an image the size of the window. end sorts
+			each pixel's list by distance, up to MAX_LAYERS of the
+			nearest, and blends them back to front. The nodes are shared
+			by every pixel, AVERAGE_LAYERS a pixel, and fragments past
+			the end of them are dropped. They are made the first time
+			the lists are drawn, as they are large.
+
+		Shaders draw into it through transparency.glsl, calling
+			writeTransparent in place of writing their colour, with
+			depth writes off. The scene's depth is copied for the
+			weighted targets, as the ParticleTarget does, and the lists
+			are drawn straight into the scene's framebuffer with colour
+			writes off, so both are hidden behind the scene.
+
+		Only the part of the window under the viewport bound at begin is
+			drawn over, so each view of a layout can be drawn in turn.
+			Everything needs GL 4.5, without it create fails and
+			transparent surfaces should be drawn as they were.
+	*/
+	class TransparencyTarget
+	{
+	public:
+		/**
+			How the transparent surfaces are put in order.
+		*/
+		enum Method
+		{
+			WEIGHTED,
+			LINKED_LISTS,
+			METHOD_COUNT
+		};
+
+		// The most of a pixel's nearest fragments a list is sorted down
+		//	to, and how many nodes there are for each pixel.
+		static const unsigned int MAX_LAYERS = 16;
+		static const unsigned int AVERAGE_LAYERS = 4;
+
+		TransparencyTarget();
+
+		/**
+			The deconstructor deletes the framebuffers, textures and
+				buffer.
+		*/
+		~TransparencyTarget();
+
+		TransparencyTarget(const TransparencyTarget&) = delete;
+		TransparencyTarget& operator=(const TransparencyTarget&) = delete;
+
+		/**
+			create makes the weighted targets and loads the resolve
+				shaders.
+
+				@param1 a_width is the width of the window.
+
+				@param2 a_height is the height of the window.
+
+				@return false without GL 4.5 or the shaders, the target
+						is left uncreated.
+		*/
+		bool create(int a_width, int a_height);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_accumulation != 0; }
+
+		/**
+			begin starts drawing transparent surfaces under the
+				viewport, with depth writes off and blending set for
+				the method.
+
+				@param1 a_method is how they are put in order.
+		*/
+		void begin(Method a_method);
+
+		/**
+			bind points a program drawing between begin and end at the
+				target, through transparency.glsl.
+
+				@param1 a_shader is the program, already bound.
+		*/
+		void bind(aie::ShaderProgram& a_shader) const;
+
+		/**
+			end puts back the framebuffer and state begin replaced and
+				blends what was drawn over it.
+		*/
+		void end();
+
+		/**
+			setUnitsPerMetre sets how many world units a metre is, which
+				the weighted method's weights are worked out in, 100 by
+				default.
+
+				@param1 a_units is the scale, above 0.
+		*/
+		void setUnitsPerMetre(float a_units) { m_unitsPerMetre = a_units > 0.0f ? a_units : 1.0f; }
+
+		/**
+			getMethodName returns a method's name, to print.
+
+				@param1 a_method is the method.
+		*/
+		static const char* getMethodName(Method a_method);
+
+	private:
+		// Deletes the framebuffers, textures and buffer.
+		void destroy();
+
+		// Makes the heads and nodes, returning false if they couldn't be.
+		bool createLists();
+
+		// Blends each method's results over the scene.
+		aie::ShaderProgram m_weightedShader;
+		aie::ShaderProgram m_listShader;
+
+		// The weighted sums and revealage, and the scene's depth copied
+		//	under the viewport to test them against.
+		unsigned int m_framebuffer;
+		TextureHandle m_depth;
+		TextureHandle m_accumulation;
+		TextureHandle m_revealage;
+
+		// Each pixel's first node, and the count, capacity and nodes.
+		TextureHandle m_heads;
+		BufferHandle m_nodes;
+		unsigned int m_nodeCapacity;
+
+		// An empty vertex array for the resolve's full screen triangle.
+		VertexArrayHandle m_vao;
+
+		int m_width;
+		int m_height;
+		float m_unitsPerMetre;
+
+		// What begin was given and what it replaced.
+		Method m_method;
+		int m_previousFramebuffer;
+		unsigned int m_previousBlendSource;
+		unsigned int m_previousBlendDestination;
+		bool m_previousBlend;
+	};
+}
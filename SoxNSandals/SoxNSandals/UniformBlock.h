@@ -0,0 +1,144 @@
+/**
+	UniformBlock.h
+
+	Purpose: UniformBlock.h is the header file for the uniform block
+			layout checks. They check at compile time that a C++ struct
+			puts each member where std140 or std430 puts it in GLSL, so
+			a struct can be copied into a block in one go.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <cstddef>
+
+namespace sns
+{
+	/**
+		The two block layouts. They differ only in arrays, whose
+			elements std140 puts 16 bytes apart at least.
+	*/
+	enum class BlockLayout
+	{
+		STD140,
+		STD430
+	};
+
+	/**
+		The BlockMember struct is how GLSL lays out a member of a C++
+			type in a block. Scalars and vectors of 4 byte floats and
+			integers, mat4s, arrays of them and structs of vec4s are
+			laid out the same in C++. Any other type is taken to be
+			a struct, 16 byte aligned, and is valid if its size is a
+			multiple of 16.
+
+		glm::mat3 and bool are left out, as GLSL lays them out wider
+			than C++ does.
+	*/
+	template<typename T>
+	struct BlockMember
+	{
+		static const bool VALID = sizeof(T) % 16 == 0;
+		static const unsigned int ALIGNMENT = 16;
+	};
+
+	template<> struct BlockMember<float> { static const bool VALID = true; static const unsigned int ALIGNMENT = 4; };
+	template<> struct BlockMember<int> { static const bool VALID = true; static const unsigned int ALIGNMENT = 4; };
+	template<> struct BlockMember<unsigned int> { static const bool VALID = true; static const unsigned int ALIGNMENT = 4; };
+	template<> struct BlockMember<glm::vec2> { static const bool VALID = true; static const unsigned int ALIGNMENT = 8; };
+	template<> struct BlockMember<glm::ivec2> { static const bool VALID = true; static const unsigned int ALIGNMENT = 8; };
+	template<> struct BlockMember<glm::uvec2> { static const bool VALID = true; static const unsigned int ALIGNMENT = 8; };
+	template<> struct BlockMember<glm::vec3> { static const bool VALID = true; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<glm::ivec3> { static const bool VALID = true; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<glm::uvec3> { static const bool VALID = true; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<glm::vec4> { static const bool VALID = true; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<glm::ivec4> { static const bool VALID = true; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<glm::uvec4> { static const bool VALID = true; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<glm::mat4> { static const bool VALID = true; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<glm::mat3> { static const bool VALID = false; static const unsigned int ALIGNMENT = 16; };
+	template<> struct BlockMember<bool> { static const bool VALID = false; static const unsigned int ALIGNMENT = 4; };
+
+	/**
+		The BlockAlignment struct's VALUE is what the offset of a member
+			of a type in a block is a multiple of.
+	*/
+	template<BlockLayout L, typename T>
+	struct BlockAlignment
+	{
+		static const unsigned int VALUE = BlockMember<T>::ALIGNMENT;
+	};
+
+	template<BlockLayout L, typename T, size_t N>
+	struct BlockAlignment<L, T[N]>
+	{
+		static const unsigned int VALUE = L == BlockLayout::STD140 && BlockMember<T>::ALIGNMENT < 16 ?
+			16 : BlockMember<T>::ALIGNMENT;
+	};
+
+	/**
+		The BlockCheck struct's isValid returns whether a member of a type
+			at an offset is where a block of a layout puts it, and can be
+			copied to it as is. An array's elements must be as far apart
+			in C++ as GLSL puts them.
+
+			@param1 a_offset is the member's offset in the struct.
+
+			@param2 a_expected is its offset in the GLSL block.
+	*/
+	template<BlockLayout L, typename T>
+	struct BlockCheck
+	{
+		static constexpr bool isValid(size_t a_offset, size_t a_expected)
+		{
+			return BlockMember<T>::VALID && a_offset == a_expected &&
+				a_offset % BlockAlignment<L, T>::VALUE == 0;
+		}
+	};
+
+	template<BlockLayout L, typename T, size_t N>
+	struct BlockCheck<L, T[N]>
+	{
+		static constexpr bool isValid(size_t a_offset, size_t a_expected)
+		{
+			return BlockMember<T>::VALID && a_offset == a_expected &&
+				a_offset % BlockAlignment<L, T[N]>::VALUE == 0 &&
+				sizeof(T) % BlockAlignment<L, T[N]>::VALUE == 0;
+		}
+	};
+}
+
+/**
+	SNS_STD140_MEMBER fails to compile unless a member of a struct is at
+		the offset std140 puts it, and is laid out as GLSL lays it out.
+
+		@param1 a_type is the struct.
+
+		@param2 a_member is the member.
+
+		@param3 a_offset is its offset in the GLSL block, in bytes.
+*/
+#define SNS_STD140_MEMBER(a_type, a_member, a_offset) \
+	static_assert(sns::BlockCheck<sns::BlockLayout::STD140, decltype(a_type::a_member)>::isValid( \
+		offsetof(a_type, a_member), a_offset), #a_type "::" #a_member " is not where std140 puts it")
+
+/**
+	SNS_STD430_MEMBER is SNS_STD140_MEMBER for std430 blocks.
+*/
+#define SNS_STD430_MEMBER(a_type, a_member, a_offset) \
+	static_assert(sns::BlockCheck<sns::BlockLayout::STD430, decltype(a_type::a_member)>::isValid( \
+		offsetof(a_type, a_member), a_offset), #a_type "::" #a_member " is not where std430 puts it")
+
+/**
+	SNS_BLOCK_SIZE fails to compile unless a struct is the size of its
+		block. A block bound at an offset, or in an array, must be a
+		multiple of 16 bytes.
+
+		@param1 a_type is the struct.
+
+		@param2 a_size is the size of the GLSL block, in bytes.
+*/
+#define SNS_BLOCK_SIZE(a_type, a_size) \
+	static_assert(sizeof(a_type) == (a_size) && (a_size) % 16 == 0, #a_type " is not the size of its block")
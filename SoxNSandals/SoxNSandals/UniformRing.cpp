@@ -0,0 +1,212 @@
+/**
+	UniformRing.cpp
+
+	Purpose: UniformRing.cpp is the source file for the UniformRing
+			class. The UniformRing hands out ranges of one uniform
+			buffer for blocks written every draw or every frame, so a
+			block is uploaded with a copy instead of a uniform call
+			for each of its members.
+
+	@author Nathan Nette
+*/
+#include "UniformRing.h"
+#include "GpuMemory.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstring>
+
+namespace sns
+{
+	UniformRing& UniformRing::instance()
+	{
+		static UniformRing ring;
+		return ring;
+	}
+
+	UniformRing::UniformRing()
+		: m_buffer(0),
+		m_mapped(nullptr),
+		m_regionSize(0),
+		m_alignment(256),
+		m_region(0),
+		m_used(0),
+		m_frame(0),
+		m_stats()
+	{
+		for (void*& fence : m_fences)
+			fence = nullptr;
+	}
+
+	/**
+		create makes the buffer. Does nothing if it already exists.
+
+			@param1 a_regionSize is how many bytes a frame starts with.
+	*/
+	void UniformRing::create(unsigned int a_regionSize)
+	{
+		if (isCreated())
+			return;
+
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment > 0)
+			m_alignment = (unsigned int)alignment;
+		allocate(a_regionSize);
+	}
+
+	/**
+		destroy deletes the buffer and its fences, before the context is.
+	*/
+	void UniformRing::destroy()
+	{
+		if (isCreated() == false)
+			return;
+
+		release(false);
+		for (unsigned int buffer : m_retired)
+		{
+			glDeleteBuffers(1, &buffer);
+			RenderState::instance().onBufferDeleted(buffer);
+		}
+		m_retired.clear();
+	}
+
+	/**
+		bind copies a block into the frame's region and binds it.
+
+			@param1 a_binding is the uniform block binding point.
+
+			@param2 a_data is the block.
+
+			@param3 a_size is its size in bytes.
+	*/
+	void UniformRing::bind(unsigned int a_binding, const void* a_data, unsigned int a_size)
+	{
+		unsigned int offset = (m_used + m_alignment - 1) / m_alignment * m_alignment;
+		if (offset + a_size > m_regionSize)
+		{
+			// The draws issued with the old buffer still read it, it is
+			//	only deleted with the frame.
+			unsigned int size = m_regionSize * 2 > a_size ? m_regionSize * 2 : a_size;
+			release(true);
+			allocate(size);
+			offset = 0;
+		}
+
+		GLintptr start = (GLintptr)m_region * m_regionSize + offset;
+		if (m_mapped != nullptr)
+			memcpy(m_mapped + start, a_data, a_size);
+		else
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, start, a_size, a_data);
+		}
+		glBindBufferRange(GL_UNIFORM_BUFFER, a_binding, m_buffer, start, a_size);
+
+		m_used = offset + a_size;
+		++m_stats.blocks;
+		m_stats.bytes += a_size;
+	}
+
+	/**
+		nextFrame fences the frame's region and waits until the GPU is done
+			with the next one.
+	*/
+	void UniformRing::nextFrame()
+	{
+		++m_frame;
+		if (isCreated() == false)
+			return;
+
+		for (unsigned int buffer : m_retired)
+		{
+			glDeleteBuffers(1, &buffer);
+			RenderState::instance().onBufferDeleted(buffer);
+		}
+		m_retired.clear();
+
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_region = (m_region + 1) % REGION_COUNT;
+		m_used = 0;
+
+		GLsync fence = (GLsync)m_fences[m_region];
+		if (fence == nullptr)
+			return;
+
+		// The fence usually passed frames ago, it is only counted if it
+		//	has to be waited for.
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			++m_stats.stalls;
+			do
+			{
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		m_fences[m_region] = nullptr;
+	}
+
+	/**
+		allocate makes a buffer of REGION_COUNT regions, mapped for good
+			with GL 4.4.
+
+			@param1 a_regionSize is the size of a region in bytes.
+	*/
+	void UniformRing::allocate(unsigned int a_regionSize)
+	{
+		m_regionSize = (a_regionSize + m_alignment - 1) / m_alignment * m_alignment;
+		GLsizeiptr size = (GLsizeiptr)m_regionSize * REGION_COUNT;
+
+		glGenBuffers(1, &m_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		if (ogl_IsVersionGEQ(4, 4))
+		{
+			// Coherent, so writes are seen by the gpu without flushing.
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+			m_mapped = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+		}
+		if (m_mapped == nullptr)
+			glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		GpuMemory::instance().trackBuffer(m_buffer, size, GpuMemory::UNIFORMS, "UniformRing");
+		m_used = 0;
+	}
+
+	/**
+		release unmaps and deletes the buffer and its fences.
+
+			@param1 a_retire keeps the buffer until the next frame, as
+					draws already issued read it.
+	*/
+	void UniformRing::release(bool a_retire)
+	{
+		for (void*& fence : m_fences)
+		{
+			if (fence != nullptr)
+				glDeleteSync((GLsync)fence);
+			fence = nullptr;
+		}
+
+		if (m_mapped != nullptr)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			m_mapped = nullptr;
+		}
+
+		GpuMemory::instance().releaseBuffer(m_buffer);
+		if (a_retire)
+			m_retired.push_back(m_buffer);
+		else
+		{
+			glDeleteBuffers(1, &m_buffer);
+			RenderState::instance().onBufferDeleted(m_buffer);
+		}
+		m_buffer = 0;
+	}
+}
@@ -0,0 +1,162 @@
+/**
+	UniformRing.h
+
+	Purpose: UniformRing.h is the header file for the UniformRing
+			class. The UniformRing hands out ranges of one uniform
+			buffer for blocks written every draw or every frame, so a
+			block is uploaded with a copy instead of a uniform call
+			for each of its members.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <type_traits>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The UniformRing class splits one persistently mapped uniform
+			buffer into a region a frame, like the StreamingBuffer, and
+			gives out ranges of the frame's region one after another.
+			bind copies a block into the next range and binds that range
+			to the block's binding point, leaving earlier ranges as they
+			were for the draws already issued with them.
+
+		nextFrame fences the region and moves to the next, waiting for
+			the GPU to finish with it, so a range is only valid for the
+			draws of the frame it was bound in. A frame that runs out
+			of room moves to a buffer twice the size, keeping the old
+			one until the next frame.
+
+		Without GL 4.4 ranges are written with glBufferSubData. Every
+			block must be a multiple of 16 bytes, see UniformBlock.h.
+	*/
+	class UniformRing
+	{
+	public:
+		// How many frames can be in flight before nextFrame waits.
+		static const unsigned int REGION_COUNT = 3;
+
+		/**
+			Counts since the last resetStats.
+		*/
+		struct Stats
+		{
+			unsigned int blocks;
+			unsigned int bytes;
+
+			// Frames that had to wait for the GPU to finish with a region.
+			unsigned int stalls;
+		};
+
+		/**
+			instance returns the ring of the GL context.
+		*/
+		static UniformRing& instance();
+
+		UniformRing(const UniformRing&) = delete;
+		UniformRing& operator=(const UniformRing&) = delete;
+
+		/**
+			create makes the buffer. Does nothing if it already exists.
+
+				@param1 a_regionSize is how many bytes a frame starts with.
+		*/
+		void create(unsigned int a_regionSize = 256 * 1024);
+
+		/**
+			isCreated returns whether create has been called.
+		*/
+		bool isCreated() const { return m_buffer != 0; }
+
+		/**
+			destroy deletes the buffer and its fences, before the context
+				is.
+		*/
+		void destroy();
+
+		/**
+			bind copies a block into the frame's region and binds it.
+
+				@param1 a_binding is the uniform block binding point.
+
+				@param2 a_block is the block, laid out as the GLSL block.
+		*/
+		template<typename T>
+		void bind(unsigned int a_binding, const T& a_block)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Uniform blocks are copied as bytes");
+			static_assert(sizeof(T) % 16 == 0, "Uniform blocks are a multiple of 16 bytes");
+			bind(a_binding, &a_block, (unsigned int)sizeof(T));
+		}
+
+		/**
+			bind copies a block into the frame's region and binds it.
+
+				@param1 a_binding is the uniform block binding point.
+
+				@param2 a_data is the block.
+
+				@param3 a_size is its size in bytes.
+		*/
+		void bind(unsigned int a_binding, const void* a_data, unsigned int a_size);
+
+		/**
+			nextFrame fences the frame's region and waits until the GPU
+				is done with the next one. Called once a frame, after its
+				last draw.
+		*/
+		void nextFrame();
+
+		/**
+			getFrame returns how many times nextFrame has been called, so
+				a block bound this frame can be told from an older one.
+		*/
+		unsigned int getFrame() const { return m_frame; }
+
+		/**
+			getStats returns the counts since the last resetStats.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+		/**
+			resetStats sets every count back to 0.
+		*/
+		void resetStats() { m_stats = {}; }
+
+	private:
+		UniformRing();
+
+		// Makes a buffer of REGION_COUNT regions of a size.
+		void allocate(unsigned int a_regionSize);
+
+		// Unmaps and deletes the buffer, keeping it bound until the next
+		//	frame if a_retire is true.
+		void release(bool a_retire);
+
+		// The GL handle of the buffer.
+		unsigned int m_buffer;
+
+		// The persistent mapping of the whole buffer, or null.
+		char* m_mapped;
+
+		unsigned int m_regionSize;
+
+		// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+		unsigned int m_alignment;
+
+		// The region being written and how much of it is used.
+		unsigned int m_region;
+		unsigned int m_used;
+
+		// The GLsync placed after the last draw of each region.
+		void* m_fences[REGION_COUNT];
+
+		// Buffers outgrown this frame, deleted by nextFrame.
+		std::vector<unsigned int> m_retired;
+
+		unsigned int m_frame;
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,162 @@
+/**
+	UploadThread.cpp
+
+	Purpose: UploadThread.cpp is the source file for the UploadThread
+			class. The UploadThread creates and fills GL buffers on a
+			thread and context of its own, so big uploads don't hold up
+			the frame on the context thread.
+
+	@author Nathan Nette
+*/
+#include "UploadThread.h"
+#include "Trace.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+#include <utility>
+
+namespace sns
+{
+	UploadThread::UploadThread()
+		: m_running(0)
+	{
+	}
+
+	/**
+		The deconstructor stops the thread, see destroy.
+	*/
+	UploadThread::~UploadThread()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the shared context and starts the thread.
+
+			@param1 a_shared is the window whose context is shared.
+
+			@return false if the context can't be made.
+	*/
+	bool UploadThread::create(GLFWwindow* a_shared)
+	{
+		if (isCreated())
+			return true;
+
+		SharedContext::Loop loop;
+		loop.isReady = [this]() { return m_jobs.empty() == false; };
+		loop.step = [this](std::unique_lock<std::mutex>& a_lock) { step(a_lock); };
+		if (m_context.create(a_shared, "SoxNSandals uploads", 1, 1, false, m_mutex, std::move(loop)) == false)
+		{
+			printf("UploadThread: the shared context couldn't be made.\n");
+			return false;
+		}
+		return true;
+	}
+
+	/**
+		queue adds work to run on the upload thread.
+
+			@param1 a_work makes and fills GL objects.
+
+			@param2 a_onComplete is run by process once the GPU has
+					finished the work.
+	*/
+	void UploadThread::queue(std::function<void()> a_work, std::function<void()> a_onComplete)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back({ std::move(a_work), std::move(a_onComplete) });
+		}
+		m_context.wake();
+	}
+
+	/**
+		process runs the completions of the work the GPU has finished,
+			without waiting for any.
+
+			@return how many completions were run.
+	*/
+	unsigned int UploadThread::process()
+	{
+		unsigned int count = 0;
+		for (;;)
+		{
+			Finished finished;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_finished.empty())
+					break;
+
+				// The thread flushed after each fence, so there is
+				//	nothing to flush here.
+				GLenum result = glClientWaitSync((GLsync)m_finished.front().fence, 0, 0);
+				if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+					break;
+				finished = std::move(m_finished.front());
+				m_finished.pop_front();
+			}
+
+			glDeleteSync((GLsync)finished.fence);
+			if (finished.onComplete != nullptr)
+				finished.onComplete();
+			++count;
+		}
+		return count;
+	}
+
+	/**
+		getPendingCount returns how much queued work hasn't had its
+			completion run.
+	*/
+	unsigned int UploadThread::getPendingCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return (unsigned int)(m_jobs.size() + m_finished.size()) + m_running;
+	}
+
+	/**
+		destroy stops the thread and deletes the context.
+	*/
+	void UploadThread::destroy()
+	{
+		if (isCreated() == false)
+			return;
+
+		m_context.stop();
+
+		// The fences are shared, so they can be deleted from here.
+		for (const Finished& finished : m_finished)
+			glDeleteSync((GLsync)finished.fence);
+		m_finished.clear();
+		m_jobs.clear();
+
+		m_context.destroy();
+	}
+
+	/**
+		step runs the next piece of work on the shared context, with the
+			mutex unlocked, and fences it.
+
+			@param1 a_lock is the mutex's lock, held before and after.
+	*/
+	void UploadThread::step(std::unique_lock<std::mutex>& a_lock)
+	{
+		Job job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		++m_running;
+		a_lock.unlock();
+
+		{
+			SNS_TRACE_ZONE("UploadThread::work");
+			job.work();
+		}
+
+		// Flushed here, as a wait on the main context can only flush
+		//	the main context's commands.
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		a_lock.lock();
+		m_finished.push_back({ fence, std::move(job.onComplete) });
+		--m_running;
+	}
+}
@@ -0,0 +1,131 @@
+/**
+	UploadThread.h
+
+	Purpose: UploadThread.h is the header file for the UploadThread
+			class. The UploadThread creates and fills GL buffers on a
+			thread and context of its own, so big uploads don't hold up
+			the frame on the context thread.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "SharedContext.h"
+#include <deque>
+#include <functional>
+#include <mutex>
+
+struct GLFWwindow;
+
+namespace sns
+{
+	/**
+		The UploadThread class owns a hidden SharedContext, whose thread
+			keeps a context sharing objects with the main one current.
+			Work queued on it runs on that thread in order,
+			and is followed by a fence.
+
+		process polls the fences on the context thread and runs the
+			completion of each piece of work whose fence has signalled,
+			so nothing the work made is used before the GPU has
+			finished copying into it. Fences of one context signal in
+			order, so completions run in the order the work was queued.
+
+		Buffers, textures, samplers, programs and fences are shared
+			between the contexts. Vertex arrays and framebuffers are
+			not, so the work must leave them to the completion. Work
+			runs without the RenderState, which only knows the main
+			context, and must not track memory in GpuMemory, which is
+			only used on the context thread.
+	*/
+	class UploadThread
+	{
+	public:
+		UploadThread();
+
+		/**
+			The deconstructor stops the thread, see destroy.
+		*/
+		~UploadThread();
+
+		UploadThread(const UploadThread&) = delete;
+		UploadThread& operator=(const UploadThread&) = delete;
+
+		/**
+			create makes the shared context and starts the thread. Must
+				be called on the main thread, as GLFW makes windows
+				there, with a_shared's context current.
+
+				@param1 a_shared is the window whose context is shared.
+
+				@return false if the context can't be made.
+		*/
+		bool create(GLFWwindow* a_shared);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_context.isCreated(); }
+
+		/**
+			queue adds work to run on the upload thread. Can be called
+				from any thread.
+
+				@param1 a_work makes and fills GL objects.
+
+				@param2 a_onComplete is run by process, on the context
+						thread, once the GPU has finished the work.
+		*/
+		void queue(std::function<void()> a_work, std::function<void()> a_onComplete);
+
+		/**
+			process runs the completions of the work the GPU has
+				finished, without waiting for any. Must be called on the
+				context thread.
+
+				@return how many completions were run.
+		*/
+		unsigned int process();
+
+		/**
+			getPendingCount returns how much queued work hasn't had its
+				completion run.
+		*/
+		unsigned int getPendingCount() const;
+
+		/**
+			destroy stops the thread and deletes the context. Work that
+				hasn't run, and completions that haven't, are thrown
+				away. Must be called on the main thread before GLFW is
+				terminated.
+		*/
+		void destroy();
+
+	private:
+		struct Job
+		{
+			std::function<void()> work;
+			std::function<void()> onComplete;
+		};
+
+		struct Finished
+		{
+			// The GLsync put in after the work.
+			void* fence;
+			std::function<void()> onComplete;
+		};
+
+		// What the thread runs for each piece of work, with the mutex
+		//	locked.
+		void step(std::unique_lock<std::mutex>& a_lock);
+
+		SharedContext m_context;
+
+		// Guards everything below.
+		mutable std::mutex m_mutex;
+		std::deque<Job> m_jobs;
+		std::deque<Finished> m_finished;
+
+		// Work taken off m_jobs that hasn't reached m_finished.
+		unsigned int m_running;
+	};
+}
@@ -0,0 +1,123 @@
+/**
+	VectorField.cpp
+
+	Purpose: VectorField.cpp is the source file for the VectorField class.
+			The VectorField is a grid of vectors over a box, such as a
+			wind or a swirl baked in a tool, that particles are pushed
+			along.
+
+	@author Nathan Nette
+*/
+#include "VectorField.h"
+#include "GpuMemory.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace sns
+{
+	VectorField::VectorField()
+		: m_size(0),
+		m_min(0),
+		m_max(0),
+		m_maxLength(0)
+	{
+	}
+
+	/**
+		create makes the field from a grid of vectors. The texture is
+			half floats, plenty for a direction and a strength.
+
+			@param1 a_size is how many vectors along each axis, at least 2.
+
+			@param2 a_vectors are the vectors, x changing fastest.
+
+			@param3 a_min is the box's lower corner, in the space of the
+					particles it pushes.
+
+			@param4 a_max is its upper corner.
+
+			@return false if the sizes don't match, it is left uncreated.
+	*/
+	bool VectorField::create(const glm::ivec3& a_size, const std::vector<glm::vec3>& a_vectors, const glm::vec3& a_min,
+		const glm::vec3& a_max)
+	{
+		destroy();
+		if (glm::any(glm::lessThan(a_size, glm::ivec3(2))) ||
+			a_vectors.size() != (size_t)a_size.x * a_size.y * a_size.z)
+		{
+			printf("VectorField: %u vectors don't fill a %dx%dx%d grid.\n", (unsigned int)a_vectors.size(),
+				a_size.x, a_size.y, a_size.z);
+			return false;
+		}
+
+		m_vectors = a_vectors;
+		m_size = a_size;
+		m_min = a_min;
+		m_max = a_max;
+		m_maxLength = 0.0f;
+		for (const glm::vec3& vector : m_vectors)
+			m_maxLength = std::max(m_maxLength, glm::length(vector));
+
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+			return true;
+
+		glCreateTextures(GL_TEXTURE_3D, 1, m_texture.put());
+		glTextureStorage3D(m_texture, 1, GL_RGB16F, a_size.x, a_size.y, a_size.z);
+		glTextureSubImage3D(m_texture, 0, 0, 0, 0, a_size.x, a_size.y, a_size.z, GL_RGB, GL_FLOAT,
+			glm::value_ptr(m_vectors[0]));
+		glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		GpuMemory::instance().trackTexture(m_texture, (unsigned long long)m_vectors.size() * 6,
+			GpuMemory::PARTICLES, "VectorField");
+		return true;
+	}
+
+	/**
+		destroy deletes the texture and the vectors.
+	*/
+	void VectorField::destroy()
+	{
+		m_texture.reset();
+		m_vectors.clear();
+		m_size = glm::ivec3(0);
+		m_maxLength = 0.0f;
+	}
+
+	/**
+		sample returns the field at a position, trilinearly filtered
+			between the texel centres as the texture unit filters it.
+
+			@param1 a_position is the position.
+	*/
+	glm::vec3 VectorField::sample(const glm::vec3& a_position) const
+	{
+		if (isCreated() == false)
+			return glm::vec3(0);
+
+		glm::vec3 texel = (a_position - m_min) / (m_max - m_min) * glm::vec3(m_size) - 0.5f;
+		texel = glm::clamp(texel, glm::vec3(0), glm::vec3(m_size - 1));
+		glm::ivec3 low = glm::min(glm::ivec3(texel), m_size - 2);
+		glm::vec3 t = texel - glm::vec3(low);
+
+		auto at = [this](int a_x, int a_y, int a_z)
+		{
+			return m_vectors[((size_t)a_z * m_size.y + a_y) * m_size.x + a_x];
+		};
+
+		glm::vec3 result(0);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			glm::ivec3 offset(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+			glm::vec3 weights = glm::mix(1.0f - t, t, glm::vec3(offset));
+			glm::ivec3 index = low + offset;
+			result += at(index.x, index.y, index.z) * (weights.x * weights.y * weights.z);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,97 @@
+/**
+	VectorField.h
+
+	Purpose: VectorField.h is the header file for the VectorField class.
+			The VectorField is a grid of vectors over a box, such as a
+			wind or a swirl baked in a tool, that particles are pushed
+			along.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The VectorField class keeps its vectors twice, in a 3D texture the
+			compute particles sample with the texture unit's own
+			filtering, and on the cpu for the cpu particles, sampled the
+			same way between the texel centres. Outside its box the
+			nearest edge is used.
+
+		The texture is made with GL 4.5, without it only the cpu copy is
+			kept and getTexture is 0.
+	*/
+	class VectorField
+	{
+	public:
+		VectorField();
+
+		VectorField(const VectorField&) = delete;
+		VectorField& operator=(const VectorField&) = delete;
+
+		/**
+			create makes the field from a grid of vectors.
+
+				@param1 a_size is how many vectors along each axis, at
+						least 2.
+
+				@param2 a_vectors are the vectors, x changing fastest.
+
+				@param3 a_min is the box's lower corner, in the space of
+						the particles it pushes.
+
+				@param4 a_max is its upper corner.
+
+				@return false if the sizes don't match, it is left
+						uncreated.
+		*/
+		bool create(const glm::ivec3& a_size, const std::vector<glm::vec3>& a_vectors, const glm::vec3& a_min,
+			const glm::vec3& a_max);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_vectors.empty() == false; }
+
+		/**
+			destroy deletes the texture and the vectors.
+		*/
+		void destroy();
+
+		/**
+			sample returns the field at a position, trilinearly filtered.
+
+				@param1 a_position is the position.
+		*/
+		glm::vec3 sample(const glm::vec3& a_position) const;
+
+		/**
+			getTexture returns the 3D texture, 0 without one.
+		*/
+		unsigned int getTexture() const { return m_texture; }
+
+		/**
+			getMin and getMax return the box the field is over.
+		*/
+		const glm::vec3& getMin() const { return m_min; }
+		const glm::vec3& getMax() const { return m_max; }
+
+		/**
+			getMaxLength returns the longest vector in the field.
+		*/
+		float getMaxLength() const { return m_maxLength; }
+
+	private:
+		TextureHandle m_texture;
+
+		std::vector<glm::vec3> m_vectors;
+		glm::ivec3 m_size;
+		glm::vec3 m_min;
+		glm::vec3 m_max;
+		float m_maxLength;
+	};
+}
@@ -0,0 +1,155 @@
+/**
+	VertexArrays.cpp
+
+	Purpose: VertexArrays.cpp is the source file for the VertexArrays
+			class. The VertexArrays class keeps one vertex array per
+			vertex format, so meshes of the same format share it and
+			switching between them only changes the buffers attached.
+
+	@author Nathan Nette
+*/
+#include "VertexArrays.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+
+namespace sns
+{
+	/**
+		instance returns the vertex arrays of the GL context.
+	*/
+	VertexArrays& VertexArrays::instance()
+	{
+		static VertexArrays vertexArrays;
+		return vertexArrays;
+	}
+
+	/**
+		isSupported returns whether the context can share vertex arrays.
+	*/
+	bool VertexArrays::isSupported()
+	{
+		return ogl_IsVersionGEQ(4, 5) != 0;
+	}
+
+	/**
+		bind binds the vertex array of a format, with a mesh's buffers
+			attached to it.
+
+			@param1 a_format sets up the format's vertex array, the
+					first time it is bound.
+
+			@param2 a_vertexBuffer is the buffer of vertices.
+
+			@param3 a_stride is the size of a vertex in bytes.
+
+			@param4 a_indexBuffer is the buffer of indices, or 0.
+
+			@param5 a_instanceBuffer is the buffer of instances, or 0
+					for a format without them.
+
+			@param6 a_instanceStride is the size of an instance in bytes.
+	*/
+	void VertexArrays::bind(FormatFunction a_format, unsigned int a_vertexBuffer, unsigned int a_stride,
+		unsigned int a_indexBuffer, unsigned int a_instanceBuffer, unsigned int a_instanceStride)
+	{
+		Entry* entry = nullptr;
+		for (Entry& existing : m_entries)
+		{
+			if (existing.format == a_format)
+			{
+				entry = &existing;
+				break;
+			}
+		}
+
+		if (entry == nullptr)
+		{
+			Entry created = { a_format, 0, 0, 0, 0, 0, 0 };
+			glCreateVertexArrays(1, &created.vao);
+			a_format(created.vao);
+			m_entries.push_back(created);
+			entry = &m_entries.back();
+		}
+
+		RenderState::instance().bindVertexArray(entry->vao);
+		attach(entry->vao, VERTEX_BINDING, entry->vertexBuffer, entry->stride, a_vertexBuffer, a_stride);
+		if (a_instanceBuffer != 0)
+			attach(entry->vao, INSTANCE_BINDING, entry->instanceBuffer, entry->instanceStride,
+				a_instanceBuffer, a_instanceStride);
+
+		if (entry->indexBuffer == a_indexBuffer)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glVertexArrayElementBuffer(entry->vao, a_indexBuffer);
+		entry->indexBuffer = a_indexBuffer;
+		++m_stats.attached;
+	}
+
+	/**
+		attach attaches a buffer to a binding unless it already is.
+
+			@param1 a_vao is the vertex array.
+
+			@param2 a_binding is the vertex buffer binding.
+
+			@param3 a_attached is the buffer attached there, which is updated.
+
+			@param4 a_attachedStride is its stride, which is updated.
+
+			@param5 a_buffer is the buffer to attach.
+
+			@param6 a_stride is the size of an element of it in bytes.
+	*/
+	void VertexArrays::attach(unsigned int a_vao, unsigned int a_binding, unsigned int& a_attached,
+		unsigned int& a_attachedStride, unsigned int a_buffer, unsigned int a_stride)
+	{
+		if (a_attached == a_buffer && a_attachedStride == a_stride)
+		{
+			++m_stats.skipped;
+			return;
+		}
+
+		glVertexArrayVertexBuffer(a_vao, a_binding, a_buffer, 0, a_stride);
+		a_attached = a_buffer;
+		a_attachedStride = a_stride;
+		++m_stats.attached;
+	}
+
+	/**
+		onBufferDeleted must be called when a buffer that may be
+			attached is deleted, since its handle can be reused.
+
+			@param1 a_buffer is the GL handle of the buffer.
+	*/
+	void VertexArrays::onBufferDeleted(unsigned int a_buffer)
+	{
+		if (a_buffer == 0)
+			return;
+
+		for (Entry& entry : m_entries)
+		{
+			if (entry.vertexBuffer == a_buffer)
+				entry.vertexBuffer = 0;
+			if (entry.indexBuffer == a_buffer)
+				entry.indexBuffer = 0;
+			if (entry.instanceBuffer == a_buffer)
+				entry.instanceBuffer = 0;
+		}
+	}
+
+	/**
+		destroy deletes every vertex array, before the context is.
+	*/
+	void VertexArrays::destroy()
+	{
+		for (Entry& entry : m_entries)
+		{
+			glDeleteVertexArrays(1, &entry.vao);
+			RenderState::instance().onVertexArrayDeleted(entry.vao);
+		}
+		m_entries.clear();
+	}
+}
@@ -0,0 +1,136 @@
+/**
+	VertexArrays.h
+
+	Purpose: VertexArrays.h is the header file for the VertexArrays
+			class. The VertexArrays class keeps one vertex array per
+			vertex format, so meshes of the same format share it and
+			switching between them only changes the buffers attached.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <vector>
+
+namespace sns
+{
+	/**
+		The VertexArrays class makes a vertex array the first time a
+			format is bound, and keeps it for every mesh of that
+			format. A format is a function that sets up the attribute
+			formats of a new vertex array, reading its vertices from
+			VERTEX_BINDING and any instances from INSTANCE_BINDING.
+
+		It remembers which buffers are attached to each vertex array,
+			so drawing the same mesh twice in a row attaches nothing.
+			Attaching is done by handle, so it needs GL 4.5. Without it
+			meshes keep a vertex array each.
+	*/
+	class VertexArrays
+	{
+	public:
+		// The vertex buffer binding vertices are read from.
+		static const unsigned int VERTEX_BINDING = 0;
+
+		// The vertex buffer binding instances are read from.
+		static const unsigned int INSTANCE_BINDING = 1;
+
+		/**
+			Sets up the attribute formats of a new vertex array.
+		*/
+		typedef void (*FormatFunction)(unsigned int a_vao);
+
+		/**
+			Counts of the buffers that were attached or already attached
+				since the last resetStats.
+		*/
+		struct Stats
+		{
+			unsigned int attached;
+			unsigned int skipped;
+		};
+
+		/**
+			instance returns the vertex arrays of the GL context.
+		*/
+		static VertexArrays& instance();
+
+		/**
+			isSupported returns whether the context can share vertex arrays.
+		*/
+		static bool isSupported();
+
+		/**
+			bind binds the vertex array of a format, with a mesh's buffers
+				attached to it.
+
+				@param1 a_format sets up the format's vertex array, the
+						first time it is bound.
+
+				@param2 a_vertexBuffer is the buffer of vertices.
+
+				@param3 a_stride is the size of a vertex in bytes.
+
+				@param4 a_indexBuffer is the buffer of indices, or 0.
+
+				@param5 a_instanceBuffer is the buffer of instances, or 0
+						for a format without them.
+
+				@param6 a_instanceStride is the size of an instance in bytes.
+		*/
+		void bind(FormatFunction a_format, unsigned int a_vertexBuffer, unsigned int a_stride,
+			unsigned int a_indexBuffer, unsigned int a_instanceBuffer = 0, unsigned int a_instanceStride = 0);
+
+		/**
+			onBufferDeleted must be called when a buffer that may be
+				attached is deleted, since its handle can be reused.
+
+				@param1 a_buffer is the GL handle of the buffer.
+		*/
+		void onBufferDeleted(unsigned int a_buffer);
+
+		/**
+			destroy deletes every vertex array, before the context is.
+		*/
+		void destroy();
+
+		/**
+			getStats returns how many buffers were attached and skipped.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+		/**
+			resetStats sets the counts back to zero, usually once a frame.
+		*/
+		void resetStats() { m_stats = {}; }
+
+	private:
+		/**
+			A format's vertex array and what is attached to it.
+		*/
+		struct Entry
+		{
+			FormatFunction format;
+			unsigned int vao;
+			unsigned int vertexBuffer;
+			unsigned int stride;
+			unsigned int indexBuffer;
+			unsigned int instanceBuffer;
+			unsigned int instanceStride;
+		};
+
+		VertexArrays() : m_stats() {}
+
+		VertexArrays(const VertexArrays&) = delete;
+		VertexArrays& operator=(const VertexArrays&) = delete;
+
+		// Attaches a buffer to a binding unless it already is.
+		void attach(unsigned int a_vao, unsigned int a_binding, unsigned int& a_attached,
+			unsigned int& a_attachedStride, unsigned int a_buffer, unsigned int a_stride);
+
+		// There are only a handful of formats, so they are searched in order.
+		std::vector<Entry> m_entries;
+
+		// Buffers attached and skipped.
+		Stats m_stats;
+	};
+}
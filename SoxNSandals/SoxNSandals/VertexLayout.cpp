@@ -0,0 +1,244 @@
+/**
+	VertexLayout.cpp
+
+	Purpose: VertexLayout.cpp is the source file for the VertexLayout
+			struct. A VertexLayout describes where each attribute of a
+			vertex struct is and how it is stored, so vertex arrays,
+			shader declarations and conversions between formats are
+			all made from the one description.
+
+	@author Nathan Nette
+*/
+#include "VertexLayout.h"
+#include "gl_core_4_5.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+
+namespace sns
+{
+	namespace
+	{
+		/**
+			The GL description of a format, as glVertexAttribPointer and
+				glVertexArrayAttribFormat take it.
+		*/
+		struct GLFormat
+		{
+			int size;
+			unsigned int type;
+			unsigned char normalised;
+			bool integer;
+			const char* glslType;
+		};
+
+		GLFormat getGLFormat(AttributeFormat a_format)
+		{
+			switch (a_format)
+			{
+			case AttributeFormat::FLOAT:			return { 1, GL_FLOAT, GL_FALSE, false, "float" };
+			case AttributeFormat::FLOAT2:			return { 2, GL_FLOAT, GL_FALSE, false, "vec2" };
+			case AttributeFormat::FLOAT3:			return { 3, GL_FLOAT, GL_FALSE, false, "vec3" };
+			case AttributeFormat::HALF2:			return { 2, GL_HALF_FLOAT, GL_FALSE, false, "vec2" };
+			case AttributeFormat::SNORM_10_10_10_2:	return { 4, GL_INT_2_10_10_10_REV, GL_TRUE, false, "vec4" };
+			case AttributeFormat::UINT:				return { 1, GL_UNSIGNED_INT, GL_FALSE, true, "uint" };
+			case AttributeFormat::MAT4:				return { 4, GL_FLOAT, GL_FALSE, false, "mat4" };
+			default:								return { 4, GL_FLOAT, GL_FALSE, false, "vec4" };
+			}
+		}
+
+		const VertexAttribute* findAttribute(const VertexLayout& a_layout, unsigned int a_location)
+		{
+			for (unsigned int i = 0; i < a_layout.attributeCount; ++i)
+			{
+				if (a_layout.attributes[i].location == a_location)
+					return &a_layout.attributes[i];
+			}
+			return nullptr;
+		}
+
+		// Reads an attribute of a float format as a vec4, the missing
+		//	components 0.
+		glm::vec4 readFloats(AttributeFormat a_format, const unsigned char* a_data)
+		{
+			glm::vec4 value(0);
+			switch (a_format)
+			{
+			case AttributeFormat::HALF2:
+			{
+				unsigned int packed;
+				memcpy(&packed, a_data, sizeof(packed));
+				glm::vec2 halves = glm::unpackHalf2x16(packed);
+				value.x = halves.x;
+				value.y = halves.y;
+				break;
+			}
+			case AttributeFormat::SNORM_10_10_10_2:
+			{
+				unsigned int packed;
+				memcpy(&packed, a_data, sizeof(packed));
+				value = glm::unpackSnorm3x10_1x2(packed);
+				break;
+			}
+			default:
+				memcpy(&value, a_data, getFormatSize(a_format));
+				break;
+			}
+			return value;
+		}
+	}
+
+	/**
+		setVertexArrayFormat sets up the attributes of a vertex array to
+			read vertices of a layout from a binding, by handle.
+
+			@param1 a_vao is the vertex array.
+
+			@param2 a_binding is the vertex buffer binding.
+
+			@param3 a_layout is the layout.
+	*/
+	void setVertexArrayFormat(unsigned int a_vao, unsigned int a_binding, const VertexLayout& a_layout)
+	{
+		for (unsigned int i = 0; i < a_layout.attributeCount; ++i)
+		{
+			const VertexAttribute& attribute = a_layout.attributes[i];
+			GLFormat format = getGLFormat(attribute.format);
+			for (unsigned int l = 0; l < getFormatLocations(attribute.format); ++l)
+			{
+				unsigned int location = attribute.location + l;
+				unsigned int offset = attribute.offset + l * getFormatSize(AttributeFormat::FLOAT4);
+				glEnableVertexArrayAttrib(a_vao, location);
+				if (format.integer)
+					glVertexArrayAttribIFormat(a_vao, location, format.size, format.type, offset);
+				else
+					glVertexArrayAttribFormat(a_vao, location, format.size, format.type, format.normalised, offset);
+				glVertexArrayAttribBinding(a_vao, location, a_binding);
+			}
+		}
+	}
+
+	/**
+		setVertexAttributes points the attributes of the bound vertex array
+			at vertices of a layout in the bound array buffer.
+
+			@param1 a_layout is the layout.
+
+			@param2 a_offset is where the vertices start in the buffer.
+
+			@param3 a_divisor is how many instances each vertex is used for,
+					0 for one a vertex.
+	*/
+	void setVertexAttributes(const VertexLayout& a_layout, size_t a_offset, unsigned int a_divisor)
+	{
+		for (unsigned int i = 0; i < a_layout.attributeCount; ++i)
+		{
+			const VertexAttribute& attribute = a_layout.attributes[i];
+			GLFormat format = getGLFormat(attribute.format);
+			for (unsigned int l = 0; l < getFormatLocations(attribute.format); ++l)
+			{
+				unsigned int location = attribute.location + l;
+				const void* pointer = (const void*)(a_offset + attribute.offset + l * getFormatSize(AttributeFormat::FLOAT4));
+				glEnableVertexAttribArray(location);
+				if (format.integer)
+					glVertexAttribIPointer(location, format.size, format.type, a_layout.stride, pointer);
+				else
+					glVertexAttribPointer(location, format.size, format.type, format.normalised, a_layout.stride, pointer);
+				if (a_divisor != 0)
+					glVertexAttribDivisor(location, a_divisor);
+			}
+		}
+	}
+
+	/**
+		writeDeclarations appends the GLSL inputs of a layout's attributes,
+			one line each, named by their members.
+
+			@param1 a_layout is the layout.
+
+			@param2 a_source is what they are appended to.
+	*/
+	void writeDeclarations(const VertexLayout& a_layout, std::string& a_source)
+	{
+		for (unsigned int i = 0; i < a_layout.attributeCount; ++i)
+		{
+			const VertexAttribute& attribute = a_layout.attributes[i];
+			a_source += "layout(location = ";
+			a_source += std::to_string(attribute.location);
+			a_source += ") in ";
+			a_source += getGLFormat(attribute.format).glslType;
+			a_source += " ";
+			a_source += attribute.name;
+			a_source += ";\n";
+		}
+	}
+
+	/**
+		convertVertices converts vertices of one layout to another.
+
+			@param1 a_from is the layout of the source.
+
+			@param2 a_source is the vertices to convert.
+
+			@param3 a_to is the layout of the destination.
+
+			@param4 a_destination is where they are written.
+
+			@param5 a_count is how many vertices there are.
+	*/
+	void convertVertices(const VertexLayout& a_from, const void* a_source,
+		const VertexLayout& a_to, void* a_destination, size_t a_count)
+	{
+		// An attribute at a time, so each loop converts one format to
+		//	another without choosing how for every vertex.
+		for (unsigned int i = 0; i < a_to.attributeCount; ++i)
+		{
+			const VertexAttribute& to = a_to.attributes[i];
+			const VertexAttribute* from = findAttribute(a_from, to.location);
+			unsigned int size = getFormatSize(to.format);
+			const unsigned char* source = (const unsigned char*)a_source + (from != nullptr ? from->offset : 0);
+			unsigned char* destination = (unsigned char*)a_destination + to.offset;
+
+			bool copyOnly = to.format == AttributeFormat::UINT || to.format == AttributeFormat::MAT4;
+			if (from == nullptr || (from->format != to.format && (copyOnly ||
+				from->format == AttributeFormat::UINT || from->format == AttributeFormat::MAT4)))
+			{
+				for (size_t v = 0; v < a_count; ++v, destination += a_to.stride)
+					memset(destination, 0, size);
+				continue;
+			}
+
+			if (from->format == to.format)
+			{
+				for (size_t v = 0; v < a_count; ++v, source += a_from.stride, destination += a_to.stride)
+					memcpy(destination, source, size);
+				continue;
+			}
+
+			switch (to.format)
+			{
+			case AttributeFormat::HALF2:
+				for (size_t v = 0; v < a_count; ++v, source += a_from.stride, destination += a_to.stride)
+				{
+					unsigned int packed = glm::packHalf2x16(glm::vec2(readFloats(from->format, source)));
+					memcpy(destination, &packed, sizeof(packed));
+				}
+				break;
+			case AttributeFormat::SNORM_10_10_10_2:
+				for (size_t v = 0; v < a_count; ++v, source += a_from.stride, destination += a_to.stride)
+				{
+					unsigned int packed = glm::packSnorm3x10_1x2(readFloats(from->format, source));
+					memcpy(destination, &packed, sizeof(packed));
+				}
+				break;
+			default:
+				for (size_t v = 0; v < a_count; ++v, source += a_from.stride, destination += a_to.stride)
+				{
+					glm::vec4 value = readFloats(from->format, source);
+					memcpy(destination, &value, size);
+				}
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,222 @@
+/**
+	VertexLayout.h
+
+	Purpose: VertexLayout.h is the header file for the VertexLayout
+			struct. A VertexLayout describes where each attribute of a
+			vertex struct is and how it is stored, so vertex arrays,
+			shader declarations and conversions between formats are
+			all made from the one description.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace sns
+{
+	/**
+		How an attribute is stored in a vertex. Every format other than
+			UINT is read by shaders as floats.
+	*/
+	enum class AttributeFormat : unsigned int
+	{
+		FLOAT,
+		FLOAT2,
+		FLOAT3,
+		FLOAT4,
+
+		// Two half floats in 32 bits.
+		HALF2,
+
+		// Signed normalised 10 bit xyz and a 2 bit w in 32 bits, read
+		//	as a vec4.
+		SNORM_10_10_10_2,
+
+		// An integer, read with glVertexAttribIPointer.
+		UINT,
+
+		// Four FLOAT4 columns at consecutive locations, from the
+		//	attribute's.
+		MAT4
+	};
+
+	/**
+		getFormatSize returns how many bytes an attribute of a format
+			takes.
+
+			@param1 a_format is the format.
+	*/
+	constexpr unsigned int getFormatSize(AttributeFormat a_format)
+	{
+		return a_format == AttributeFormat::FLOAT ? 4 :
+			a_format == AttributeFormat::FLOAT2 ? 8 :
+			a_format == AttributeFormat::FLOAT3 ? 12 :
+			a_format == AttributeFormat::FLOAT4 ? 16 :
+			a_format == AttributeFormat::MAT4 ? 64 : 4;
+	}
+
+	/**
+		getFormatLocations returns how many attribute locations an
+			attribute of a format takes.
+
+			@param1 a_format is the format.
+	*/
+	constexpr unsigned int getFormatLocations(AttributeFormat a_format)
+	{
+		return a_format == AttributeFormat::MAT4 ? 4 : 1;
+	}
+
+	/**
+		One attribute of a vertex, see SNS_VERTEX_ATTRIBUTE.
+	*/
+	struct VertexAttribute
+	{
+		unsigned int location;
+		AttributeFormat format;
+
+		// From the start of a vertex, in bytes.
+		unsigned int offset;
+
+		// The name of the member, for shader declarations.
+		const char* name;
+	};
+
+	/**
+		The VertexLayout struct is every attribute of a vertex struct
+			and its size. Layouts are made with makeVertexLayout and
+			SNS_VERTEX_ATTRIBUTE as constexpr values, and checked with
+			isValidLayout in a static_assert, so a layout that overruns
+			its struct, overlaps attributes or puts two at a location
+			doesn't compile.
+
+		setVertexArrayFormat and setVertexAttributes point a vertex
+			array at vertices of a layout, writeDeclarations writes the
+			GLSL inputs that read them and convertVertices converts
+			vertices between two layouts, by location.
+	*/
+	struct VertexLayout
+	{
+		static const unsigned int MAX_ATTRIBUTES = 8;
+
+		// The size of a vertex in bytes.
+		unsigned int stride;
+
+		unsigned int attributeCount;
+		VertexAttribute attributes[MAX_ATTRIBUTES];
+	};
+
+	/**
+		makeVertexLayout makes the layout of a vertex struct.
+
+			@param1 a_attributes are its attributes, each made with
+					SNS_VERTEX_ATTRIBUTE.
+	*/
+	template<typename V, typename... A>
+	constexpr VertexLayout makeVertexLayout(A... a_attributes)
+	{
+		static_assert(sizeof...(A) <= VertexLayout::MAX_ATTRIBUTES, "Too many vertex attributes");
+		return { (unsigned int)sizeof(V), (unsigned int)sizeof...(A), { a_attributes... } };
+	}
+
+	/**
+		isValidLayout returns whether every attribute of a layout is
+			within its stride, no two overlap and no two share a
+			location.
+
+			@param1 a_layout is the layout.
+	*/
+	constexpr bool isValidLayout(const VertexLayout& a_layout)
+	{
+		for (unsigned int i = 0; i < a_layout.attributeCount; ++i)
+		{
+			const VertexAttribute& a = a_layout.attributes[i];
+			if (a.offset + getFormatSize(a.format) > a_layout.stride)
+				return false;
+
+			for (unsigned int j = i + 1; j < a_layout.attributeCount; ++j)
+			{
+				const VertexAttribute& b = a_layout.attributes[j];
+				if (a.offset < b.offset + getFormatSize(b.format) && b.offset < a.offset + getFormatSize(a.format))
+					return false;
+				if (a.location < b.location + getFormatLocations(b.format) &&
+					b.location < a.location + getFormatLocations(a.format))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/**
+		setVertexArrayFormat sets up the attributes of a vertex array
+			to read vertices of a layout from a binding, by handle.
+
+			@param1 a_vao is the vertex array.
+
+			@param2 a_binding is the vertex buffer binding.
+
+			@param3 a_layout is the layout.
+	*/
+	void setVertexArrayFormat(unsigned int a_vao, unsigned int a_binding, const VertexLayout& a_layout);
+
+	/**
+		setVertexAttributes points the attributes of the bound vertex
+			array at vertices of a layout in the bound array buffer.
+
+			@param1 a_layout is the layout.
+
+			@param2 a_offset is where the vertices start in the buffer.
+
+			@param3 a_divisor is how many instances each vertex is used
+					for, 0 for one a vertex.
+	*/
+	void setVertexAttributes(const VertexLayout& a_layout, size_t a_offset = 0, unsigned int a_divisor = 0);
+
+	/**
+		writeDeclarations appends the GLSL inputs of a layout's
+			attributes, one line each, named by their members.
+
+			@param1 a_layout is the layout.
+
+			@param2 a_source is what they are appended to.
+	*/
+	void writeDeclarations(const VertexLayout& a_layout, std::string& a_source);
+
+	/**
+		convertVertices converts vertices of one layout to another. Each
+			attribute is read from the attribute of the source at its
+			location, and written as 0 if there is none. Components
+			the source lacks are 0, and a SNORM_10_10_10_2 w is rounded
+			to -1, 0 or 1. UINT and MAT4 attributes are only copied from
+			the same format.
+
+			@param1 a_from is the layout of the source.
+
+			@param2 a_source is the vertices to convert.
+
+			@param3 a_to is the layout of the destination.
+
+			@param4 a_destination is where they are written.
+
+			@param5 a_count is how many vertices there are.
+	*/
+	void convertVertices(const VertexLayout& a_from, const void* a_source,
+		const VertexLayout& a_to, void* a_destination, size_t a_count);
+}
+
+/**
+	SNS_VERTEX_ATTRIBUTE describes a member of a vertex struct as an
+		attribute.
+
+		@param1 a_type is the vertex struct.
+
+		@param2 a_member is the member.
+
+		@param3 a_location is its attribute location.
+
+		@param4 a_format is how it is stored, an sns::AttributeFormat.
+*/
+#define SNS_VERTEX_ATTRIBUTE(a_type, a_member, a_location, a_format) \
+	sns::VertexAttribute{ a_location, sns::AttributeFormat::a_format, (unsigned int)offsetof(a_type, a_member), #a_member }
@@ -0,0 +1,476 @@
+/**
+	VideoEncoder.cpp
+
+	Purpose: VideoEncoder.cpp is the source file for the VideoEncoder
+			class. The VideoEncoder hands each finished frame to the
+			gpu's hardware video encoder without it leaving the gpu, and
+			writes the H.264 it makes to a file or pipe.
+
+	@author Nathan Nette
+*/
+#include "VideoEncoder.h"
+#include "GpuMemory.h"
+#include "Profiler.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <algorithm>
+
+// After gl_core_4_5, which stands in for the GL header cudaGL.h would
+//	otherwise include.
+#if defined(SNS_VIDEO_NVENC)
+#include <cuda.h>
+#include <cudaGL.h>
+#include <nvEncodeAPI.h>
+#include <windows.h>
+#endif
+
+namespace sns
+{
+#if defined(SNS_VIDEO_NVENC)
+	// The encoder's entry point, which its dll is the only place to find.
+	typedef NVENCSTATUS (NVENCAPI* CreateInstanceFunction)(NV_ENCODE_API_FUNCTION_LIST*);
+
+	/**
+		nvenc returns the function table of the encoder.
+
+			@param1 a_functions is the VideoEncoder's m_functions.
+	*/
+	static NV_ENCODE_API_FUNCTION_LIST& nvenc(void* a_functions)
+	{
+		return *(NV_ENCODE_API_FUNCTION_LIST*)a_functions;
+	}
+#endif
+
+	VideoEncoder::VideoEncoder()
+		: m_encoder(nullptr),
+		m_functions(nullptr),
+		m_cudaContext(nullptr),
+		m_resource(nullptr),
+		m_pitch(0),
+		m_texture(0),
+		m_framebuffer(0),
+		m_width(0),
+		m_height(0),
+		m_output(nullptr),
+		m_slots(),
+		m_nextSlot(0),
+		m_stopping(false),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor finishes the stream, see destroy.
+	*/
+	VideoEncoder::~VideoEncoder()
+	{
+		destroy();
+	}
+
+	/**
+		create opens a CUDA context on the gpu the GL context is on, and an
+			NVENC session on that, then makes the ring's frames and the
+			texture frames are turned the right way up in.
+
+			@param1 a_width is the width of the frames, even.
+
+			@param2 a_height is their height, even.
+
+			@param3 a_output is the file or pipe to write the stream to.
+
+			@param4 a_settings is how it is encoded.
+
+			@return false if it was built without SNS_VIDEO_NVENC, the gpu
+					has no encoder or the file can't be opened.
+	*/
+	bool VideoEncoder::create(int a_width, int a_height, const char* a_output, const Settings& a_settings)
+	{
+		destroy();
+#if defined(SNS_VIDEO_NVENC)
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("VideoEncoder: encoding frames needs GL 4.5.\n");
+			return false;
+		}
+
+		// The encoder's dll comes with the driver, not the SDK.
+		HMODULE library = LoadLibraryA(sizeof(void*) == 8 ? "nvEncodeAPI64.dll" : "nvEncodeAPI.dll");
+		CreateInstanceFunction createInstance = library != nullptr ?
+			(CreateInstanceFunction)GetProcAddress(library, "NvEncodeAPICreateInstance") : nullptr;
+		if (createInstance == nullptr)
+		{
+			printf("VideoEncoder: the driver has no NVENC.\n");
+			return false;
+		}
+		NV_ENCODE_API_FUNCTION_LIST* functions = new NV_ENCODE_API_FUNCTION_LIST();
+		functions->version = NV_ENCODE_API_FUNCTION_LIST_VER;
+		m_functions = functions;
+		if (createInstance(functions) != NV_ENC_SUCCESS)
+		{
+			printf("VideoEncoder: NVENC's functions couldn't be loaded.\n");
+			destroy();
+			return false;
+		}
+
+		// The device the GL context renders on, so the frames never
+		//	cross between gpus.
+		CUdevice device = 0;
+		unsigned int deviceCount = 0;
+		CUcontext context = nullptr;
+		if (cuInit(0) != CUDA_SUCCESS || cuGLGetDevices(&deviceCount, &device, 1, CU_GL_DEVICE_LIST_ALL) != CUDA_SUCCESS ||
+			deviceCount == 0 || cuCtxCreate(&context, 0, device) != CUDA_SUCCESS)
+		{
+			printf("VideoEncoder: the GL context isn't on a CUDA device.\n");
+			destroy();
+			return false;
+		}
+		m_cudaContext = context;
+
+		m_width = a_width;
+		m_height = a_height;
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+		glTextureStorage2D(m_texture, 1, GL_RGBA8, m_width, m_height);
+		GpuMemory::instance().trackTexture(m_texture, GpuMemory::getTextureBytes(GL_RGBA8, m_width, m_height),
+			GpuMemory::RENDER_TARGETS, "VideoEncoder");
+		glCreateFramebuffers(1, &m_framebuffer);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_texture, 0);
+		glNamedFramebufferDrawBuffer(m_framebuffer, GL_COLOR_ATTACHMENT0);
+
+		CUgraphicsResource resource = nullptr;
+		CUdeviceptr frames[RING_SIZE] = {};
+		bool allocated = cuGraphicsGLRegisterImage(&resource, m_texture, GL_TEXTURE_2D,
+			CU_GRAPHICS_REGISTER_FLAGS_READ_ONLY) == CUDA_SUCCESS;
+		m_resource = resource;
+		for (unsigned int i = 0; i < RING_SIZE && allocated; ++i)
+		{
+			allocated = cuMemAllocPitch(&frames[i], &m_pitch, (size_t)m_width * 4, m_height, 16) == CUDA_SUCCESS;
+			m_slots[i].frame = frames[i];
+		}
+		cuCtxPopCurrent(nullptr);
+		if (allocated == false)
+		{
+			printf("VideoEncoder: the frames couldn't be made in CUDA.\n");
+			destroy();
+			return false;
+		}
+
+		NV_ENC_OPEN_ENCODE_SESSION_EX_PARAMS session = {};
+		session.version = NV_ENC_OPEN_ENCODE_SESSION_EX_PARAMS_VER;
+		session.device = context;
+		session.deviceType = NV_ENC_DEVICE_TYPE_CUDA;
+		session.apiVersion = NVENCAPI_VERSION;
+		if (functions->nvEncOpenEncodeSessionEx(&session, &m_encoder) != NV_ENC_SUCCESS)
+		{
+			printf("VideoEncoder: the gpu has no encoder free.\n");
+			m_encoder = nullptr;
+			destroy();
+			return false;
+		}
+
+		// The preset's config, with the rate control and structure the
+		//	settings ask for.
+		NV_ENC_TUNING_INFO tuning = a_settings.lowLatency ? NV_ENC_TUNING_INFO_ULTRA_LOW_LATENCY :
+			NV_ENC_TUNING_INFO_HIGH_QUALITY;
+		NV_ENC_PRESET_CONFIG preset = {};
+		preset.version = NV_ENC_PRESET_CONFIG_VER;
+		preset.presetCfg.version = NV_ENC_CONFIG_VER;
+		functions->nvEncGetEncodePresetConfigEx(m_encoder, NV_ENC_CODEC_H264_GUID, NV_ENC_PRESET_P4_GUID, tuning, &preset);
+		NV_ENC_CONFIG config = preset.presetCfg;
+		unsigned int bitrate = a_settings.bitrate * 1000;
+		config.gopLength = a_settings.gopLength;
+		config.frameIntervalP = 1;
+		config.rcParams.rateControlMode = NV_ENC_PARAMS_RC_CBR;
+		config.rcParams.averageBitRate = bitrate;
+		config.rcParams.maxBitRate = bitrate;
+		config.rcParams.vbvBufferSize = a_settings.lowLatency ? bitrate / std::max(1u, a_settings.frameRate) : bitrate;
+		config.rcParams.vbvInitialDelay = config.rcParams.vbvBufferSize;
+		config.encodeCodecConfig.h264Config.idrPeriod = a_settings.gopLength;
+		config.encodeCodecConfig.h264Config.repeatSPSPPS = 1;
+
+		NV_ENC_INITIALIZE_PARAMS initialize = {};
+		initialize.version = NV_ENC_INITIALIZE_PARAMS_VER;
+		initialize.encodeGUID = NV_ENC_CODEC_H264_GUID;
+		initialize.presetGUID = NV_ENC_PRESET_P4_GUID;
+		initialize.tuningInfo = tuning;
+		initialize.encodeWidth = m_width;
+		initialize.encodeHeight = m_height;
+		initialize.darWidth = m_width;
+		initialize.darHeight = m_height;
+		initialize.maxEncodeWidth = m_width;
+		initialize.maxEncodeHeight = m_height;
+		initialize.frameRateNum = a_settings.frameRate;
+		initialize.frameRateDen = 1;
+		initialize.enablePTD = 1;
+		initialize.encodeConfig = &config;
+		if (functions->nvEncInitializeEncoder(m_encoder, &initialize) != NV_ENC_SUCCESS)
+		{
+			printf("VideoEncoder: the encoder doesn't take %ix%i H.264 at %u kbps.\n", m_width, m_height,
+				a_settings.bitrate);
+			destroy();
+			return false;
+		}
+
+		for (unsigned int i = 0; i < RING_SIZE; ++i)
+		{
+			NV_ENC_REGISTER_RESOURCE registration = {};
+			registration.version = NV_ENC_REGISTER_RESOURCE_VER;
+			registration.resourceType = NV_ENC_INPUT_RESOURCE_TYPE_CUDADEVICEPTR;
+			registration.resourceToRegister = (void*)m_slots[i].frame;
+			registration.width = m_width;
+			registration.height = m_height;
+			registration.pitch = (uint32_t)m_pitch;
+			registration.bufferFormat = NV_ENC_BUFFER_FORMAT_ABGR;
+			registration.bufferUsage = NV_ENC_INPUT_IMAGE;
+			NV_ENC_CREATE_BITSTREAM_BUFFER bitstream = {};
+			bitstream.version = NV_ENC_CREATE_BITSTREAM_BUFFER_VER;
+			if (functions->nvEncRegisterResource(m_encoder, &registration) != NV_ENC_SUCCESS ||
+				functions->nvEncCreateBitstreamBuffer(m_encoder, &bitstream) != NV_ENC_SUCCESS)
+			{
+				printf("VideoEncoder: the ring's frames couldn't be registered.\n");
+				destroy();
+				return false;
+			}
+			m_slots[i].registered = registration.registeredResource;
+			m_slots[i].bitstream = bitstream.bitstreamBuffer;
+		}
+
+		fopen_s(&m_output, a_output, "wb");
+		if (m_output == nullptr)
+		{
+			printf("VideoEncoder: %s couldn't be opened.\n", a_output);
+			destroy();
+			return false;
+		}
+
+		m_nextSlot = 0;
+		m_stopping = false;
+		m_stats = {};
+		m_thread = std::thread(&VideoEncoder::run, this);
+		printf("Encoding %ix%i H.264 at %u kbps%s into %s\n", m_width, m_height, a_settings.bitrate,
+			a_settings.lowLatency ? ", low latency," : "", a_output);
+		return true;
+#else
+		(void)a_width;
+		(void)a_height;
+		(void)a_settings;
+		printf("VideoEncoder: built without SNS_VIDEO_NVENC, %s isn't encoded.\n", a_output);
+		return false;
+#endif
+	}
+
+	/**
+		encode turns a framebuffer's colour the right way up into the
+			interop texture, copies it into the next frame of the ring
+			on the gpu and gives it to the encoder. Mapping the texture
+			into CUDA waits on the gpu for the GL commands before it,
+			not on the cpu.
+
+			@param1 a_framebuffer is the framebuffer whose colour is the
+					frame, 0 for the window's.
+	*/
+	void VideoEncoder::encode(unsigned int a_framebuffer)
+	{
+		if (isCreated() == false)
+			return;
+#if defined(SNS_VIDEO_NVENC)
+		SNS_PROFILE_SCOPE("Video encode submit");
+		unsigned int index = m_nextSlot;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_slots[index].busy)
+				++m_stats.stalls;
+			m_freed.wait(lock, [this, index]() { return m_slots[index].busy == false; });
+			m_slots[index].busy = true;
+		}
+		m_nextSlot = (m_nextSlot + 1) % RING_SIZE;
+		Slot& slot = m_slots[index];
+
+		glBlitNamedFramebuffer(a_framebuffer, m_framebuffer, 0, 0, m_width, m_height, 0, m_height, m_width, 0,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		cuCtxPushCurrent((CUcontext)m_cudaContext);
+		CUgraphicsResource resource = (CUgraphicsResource)m_resource;
+		CUarray array = nullptr;
+		cuGraphicsMapResources(1, &resource, 0);
+		cuGraphicsSubResourceGetMappedArray(&array, resource, 0, 0);
+		CUDA_MEMCPY2D copy = {};
+		copy.srcMemoryType = CU_MEMORYTYPE_ARRAY;
+		copy.srcArray = array;
+		copy.dstMemoryType = CU_MEMORYTYPE_DEVICE;
+		copy.dstDevice = (CUdeviceptr)slot.frame;
+		copy.dstPitch = m_pitch;
+		copy.WidthInBytes = (size_t)m_width * 4;
+		copy.Height = m_height;
+		cuMemcpy2D(&copy);
+		cuGraphicsUnmapResources(1, &resource, 0);
+		cuCtxPopCurrent(nullptr);
+
+		NV_ENCODE_API_FUNCTION_LIST& functions = nvenc(m_functions);
+		NV_ENC_MAP_INPUT_RESOURCE map = {};
+		map.version = NV_ENC_MAP_INPUT_RESOURCE_VER;
+		map.registeredResource = slot.registered;
+		functions.nvEncMapInputResource(m_encoder, &map);
+		slot.mapped = map.mappedResource;
+
+		NV_ENC_PIC_PARAMS picture = {};
+		picture.version = NV_ENC_PIC_PARAMS_VER;
+		picture.inputWidth = m_width;
+		picture.inputHeight = m_height;
+		picture.inputPitch = (uint32_t)m_pitch;
+		picture.inputBuffer = map.mappedResource;
+		picture.bufferFmt = map.mappedBufferFmt;
+		picture.outputBitstream = slot.bitstream;
+		picture.pictureStruct = NV_ENC_PIC_STRUCT_FRAME;
+		picture.inputTimeStamp = m_stats.frames;
+		slot.submitted = Profiler::now();
+
+		// Without B-frames every picture has its bitstream once it is
+		//	encoded, none waits for the next.
+		bool encoded = functions.nvEncEncodePicture(m_encoder, &picture) == NV_ENC_SUCCESS;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (encoded)
+				m_encoding.push_back(index);
+			else
+			{
+				functions.nvEncUnmapInputResource(m_encoder, slot.mapped);
+				slot.busy = false;
+			}
+		}
+		if (encoded)
+			m_wake.notify_one();
+#else
+		(void)a_framebuffer;
+#endif
+	}
+
+	/**
+		run waits for each frame's bitstream in the order they were given,
+			writes it and hands the frame back to encode. Locking a
+			bitstream blocks until the encoder is done with it.
+	*/
+	void VideoEncoder::run()
+	{
+#if defined(SNS_VIDEO_NVENC)
+		NV_ENCODE_API_FUNCTION_LIST& functions = nvenc(m_functions);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [this]() { return m_stopping || m_encoding.empty() == false; });
+			if (m_encoding.empty())
+				break;
+
+			unsigned int index = m_encoding.front();
+			m_encoding.pop_front();
+			Slot& slot = m_slots[index];
+			lock.unlock();
+
+			NV_ENC_LOCK_BITSTREAM bitstream = {};
+			bitstream.version = NV_ENC_LOCK_BITSTREAM_VER;
+			bitstream.outputBitstream = slot.bitstream;
+			size_t bytes = 0;
+			if (functions.nvEncLockBitstream(m_encoder, &bitstream) == NV_ENC_SUCCESS)
+			{
+				bytes = fwrite(bitstream.bitstreamBufferPtr, 1, bitstream.bitstreamSizeInBytes, m_output);
+				functions.nvEncUnlockBitstream(m_encoder, slot.bitstream);
+			}
+			functions.nvEncUnmapInputResource(m_encoder, slot.mapped);
+
+			double end = Profiler::now();
+			if (Profiler::isEnabled())
+				Profiler::addGpuEvent("Video encode", slot.submitted, end - slot.submitted, Profiler::VIDEO_ENCODE_THREAD);
+
+			lock.lock();
+			slot.busy = false;
+			++m_stats.frames;
+			m_stats.bytes += bytes;
+			m_stats.lastMilliseconds = (end - slot.submitted) * 0.001;
+			m_freed.notify_all();
+		}
+#endif
+	}
+
+	/**
+		destroy writes every frame given, ends the stream and closes the
+			encoder, the CUDA context and the file.
+	*/
+	void VideoEncoder::destroy()
+	{
+#if defined(SNS_VIDEO_NVENC)
+		if (m_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+			}
+			m_wake.notify_one();
+			m_thread.join();
+		}
+
+		if (m_functions != nullptr)
+		{
+			NV_ENCODE_API_FUNCTION_LIST& functions = nvenc(m_functions);
+			if (m_encoder != nullptr)
+			{
+				// The end of the stream flushes whatever the encoder held.
+				NV_ENC_PIC_PARAMS end = {};
+				end.version = NV_ENC_PIC_PARAMS_VER;
+				end.encodePicFlags = NV_ENC_PIC_FLAG_EOS;
+				functions.nvEncEncodePicture(m_encoder, &end);
+				for (Slot& slot : m_slots)
+				{
+					if (slot.bitstream != nullptr)
+						functions.nvEncDestroyBitstreamBuffer(m_encoder, slot.bitstream);
+					if (slot.registered != nullptr)
+						functions.nvEncUnregisterResource(m_encoder, slot.registered);
+				}
+				functions.nvEncDestroyEncoder(m_encoder);
+			}
+			delete (NV_ENCODE_API_FUNCTION_LIST*)m_functions;
+		}
+
+		if (m_cudaContext != nullptr)
+		{
+			cuCtxPushCurrent((CUcontext)m_cudaContext);
+			for (Slot& slot : m_slots)
+			{
+				if (slot.frame != 0)
+					cuMemFree((CUdeviceptr)slot.frame);
+			}
+			if (m_resource != nullptr)
+				cuGraphicsUnregisterResource((CUgraphicsResource)m_resource);
+			cuCtxPopCurrent(nullptr);
+			cuCtxDestroy((CUcontext)m_cudaContext);
+		}
+#endif
+		if (m_texture != 0)
+		{
+			glDeleteTextures(1, &m_texture);
+			RenderState::instance().onTextureDeleted(m_texture);
+			GpuMemory::instance().releaseTexture(m_texture);
+		}
+		if (m_framebuffer != 0)
+			glDeleteFramebuffers(1, &m_framebuffer);
+		if (m_output != nullptr)
+			fclose(m_output);
+
+		m_encoder = nullptr;
+		m_functions = nullptr;
+		m_cudaContext = nullptr;
+		m_resource = nullptr;
+		m_texture = m_framebuffer = 0;
+		m_output = nullptr;
+		m_encoding.clear();
+		for (Slot& slot : m_slots)
+			slot = {};
+	}
+
+	/**
+		getStats returns what has been encoded.
+	*/
+	VideoEncoder::Stats VideoEncoder::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+}
@@ -0,0 +1,197 @@
+/**
+	VideoEncoder.h
+
+	Purpose: VideoEncoder.h is the header file for the VideoEncoder class.
+			The VideoEncoder hands each finished frame to the gpu's
+			hardware video encoder without it leaving the gpu, and
+			writes the H.264 it makes to a file or pipe.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+	The encoder is NVENC, through the NVIDIA Video Codec SDK, and is only
+		built when SNS_VIDEO_NVENC is defined for the whole project, with
+		the SDK's nvEncodeAPI.h and the CUDA toolkit's include directory
+		on the include path and cuda.lib linked. NVENC only takes GL
+		textures on Linux, so frames go through CUDA's GL interop
+		instead, which is still a copy on the gpu. Without it create
+		fails and says why.
+*/
+
+namespace sns
+{
+	/**
+		The VideoEncoder class copies a framebuffer's colour, turned the
+			right way up, into a texture CUDA has registered, then from
+			it into one of RING_SIZE frames of device memory registered
+			with NVENC, all on the gpu. The encoder is given the frame
+			and a thread of the VideoEncoder's waits for its bitstream,
+			writes it out and hands the frame back, so the context
+			thread never waits for the encoder unless every frame of the
+			ring is still being encoded.
+
+		The stream is H.264 Annex B with no B-frames, its parameter sets
+			repeated at every IDR, so a player can join it at any of
+			them. It can be written to a named pipe that a streaming
+			tool reads from, like ffmpeg's -f h264 -i.
+
+		Each frame's time from being given to the encoder until its
+			bitstream was ready goes on the Profiler's
+			VIDEO_ENCODE_THREAD track.
+	*/
+	class VideoEncoder
+	{
+	public:
+		// Frames being encoded at once at most.
+		static const unsigned int RING_SIZE = 3;
+
+		/**
+			How the stream is encoded.
+		*/
+		struct Settings
+		{
+			// The average bitrate, in kilobits a second.
+			unsigned int bitrate = 8000;
+			unsigned int frameRate = 60;
+
+			// Frames from one IDR to the next, how long a player joining
+			//	waits at most.
+			unsigned int gopLength = 120;
+
+			// A frame's worth of rate control buffer and the encoder's
+			//	lowest latency tuning, each frame's bits out as soon as
+			//	it is encoded. Otherwise a second's worth, for quality.
+			bool lowLatency = true;
+		};
+
+		/**
+			What has been encoded so far.
+		*/
+		struct Stats
+		{
+			unsigned int frames;
+			unsigned long long bytes;
+
+			// Frames that waited for the ring to have one free.
+			unsigned int stalls;
+
+			// The last frame's time in the encoder.
+			double lastMilliseconds;
+		};
+
+		VideoEncoder();
+
+		/**
+			The deconstructor finishes the stream, see destroy.
+		*/
+		~VideoEncoder();
+
+		VideoEncoder(const VideoEncoder&) = delete;
+		VideoEncoder& operator=(const VideoEncoder&) = delete;
+
+		/**
+			create opens the encoder on the gpu the GL context is on, and
+				the file the stream is written to.
+
+				@param1 a_width is the width of the frames, even.
+
+				@param2 a_height is their height, even.
+
+				@param3 a_output is the file or pipe to write the stream to.
+
+				@param4 a_settings is how it is encoded.
+
+				@return false if it was built without SNS_VIDEO_NVENC, the
+						gpu has no encoder or the file can't be opened.
+		*/
+		bool create(int a_width, int a_height, const char* a_output, const Settings& a_settings);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_encoder != nullptr; }
+
+		/**
+			encode gives the encoder a frame. Called on the context
+				thread, once the frame is finished and before it is
+				presented.
+
+				@param1 a_framebuffer is the framebuffer whose colour is
+						the frame, 0 for the window's.
+		*/
+		void encode(unsigned int a_framebuffer);
+
+		/**
+			destroy ends the stream, waiting for every frame given to be
+				written, and closes the encoder and file.
+		*/
+		void destroy();
+
+		/**
+			getStats returns what has been encoded.
+		*/
+		Stats getStats() const;
+
+	private:
+		/**
+			A frame of the ring, the device memory the encoder reads and
+				the bitstream it writes, as their NVENC and CUDA handles.
+		*/
+		struct Slot
+		{
+			unsigned long long frame;
+			void* registered;
+			void* mapped;
+			void* bitstream;
+
+			// When it was given to the encoder, on the Profiler's clock.
+			double submitted;
+			bool busy;
+		};
+
+		// What the thread runs, writing each frame's bitstream in turn
+		//	until destroy.
+		void run();
+
+		// The NVENC session, and its function table.
+		void* m_encoder;
+		void* m_functions;
+
+		// The CUDA context, the GL interop resource of m_texture and
+		//	the pitch of a slot's frame.
+		void* m_cudaContext;
+		void* m_resource;
+		size_t m_pitch;
+
+		// Where the frame is turned the right way up for NVENC, which
+		//	wants the top row first.
+		unsigned int m_texture;
+		unsigned int m_framebuffer;
+		int m_width;
+		int m_height;
+
+		FILE* m_output;
+		Slot m_slots[RING_SIZE];
+		unsigned int m_nextSlot;
+
+		std::thread m_thread;
+
+		// Guards everything below, and the slots' busy.
+		mutable std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_freed;
+
+		// Slots given to the encoder, in the order they were.
+		std::deque<unsigned int> m_encoding;
+		bool m_stopping;
+		Stats m_stats;
+	};
+}
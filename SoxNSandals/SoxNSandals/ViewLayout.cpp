@@ -0,0 +1,228 @@
+/**
+	ViewLayout.cpp
+
+	Purpose: ViewLayout.cpp is the source file for the ViewLayout class.
+			The ViewLayout splits the window into a view per monitor,
+			each turned from the camera so that together they make one
+			view around it.
+
+	@author Nathan Nette
+*/
+#include "ViewLayout.h"
+#include "gl_core_4_5.h"
+#include <glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace sns
+{
+	// The widest a bounding projection can be, in radians. Nearer 180
+	//	degrees its sides are too close to parallel to cull anything.
+	static const float MAX_BOUNDING_ANGLE = glm::radians(160.0f);
+
+	ViewLayout::ViewLayout()
+		: m_views(),
+		m_viewCount(0)
+	{
+	}
+
+	/**
+		getDesktopBounds returns the part of the desktop the monitors
+			cover together.
+
+			@param1 a_monitors are the monitors.
+
+			@param2 a_count is how many there are.
+
+			@return x, y, width and height, y down as GLFW has it.
+	*/
+	glm::ivec4 ViewLayout::getDesktopBounds(GLFWmonitor** a_monitors, int a_count)
+	{
+		glm::ivec2 low(INT_MAX);
+		glm::ivec2 high(INT_MIN);
+		for (int i = 0; i < a_count; ++i)
+		{
+			const GLFWvidmode* mode = glfwGetVideoMode(a_monitors[i]);
+			if (mode == nullptr)
+				continue;
+
+			glm::ivec2 position;
+			glfwGetMonitorPos(a_monitors[i], &position.x, &position.y);
+			low = glm::min(low, position);
+			high = glm::max(high, position + glm::ivec2(mode->width, mode->height));
+		}
+		if (high.x <= low.x || high.y <= low.y)
+			return glm::ivec4(0);
+		return glm::ivec4(low, high - low);
+	}
+
+	/**
+		create lays out the views.
+
+			@param1 a_monitors are the monitors the window covers, or
+					nullptr for one view of the whole window.
+
+			@param2 a_count is how many there are.
+
+			@param3 a_windowResolution is the window's size.
+	*/
+	void ViewLayout::create(GLFWmonitor** a_monitors, int a_count, const glm::ivec2& a_windowResolution)
+	{
+		struct Monitor
+		{
+			glm::ivec2 position;
+			glm::ivec2 size;
+		};
+		Monitor monitors[MAX_VIEWS];
+		unsigned int count = 0;
+		for (int i = 0; a_monitors != nullptr && i < a_count && count < MAX_VIEWS; ++i)
+		{
+			const GLFWvidmode* mode = glfwGetVideoMode(a_monitors[i]);
+			if (mode == nullptr)
+				continue;
+
+			glfwGetMonitorPos(a_monitors[i], &monitors[count].position.x, &monitors[count].position.y);
+			monitors[count].size = glm::ivec2(mode->width, mode->height);
+			++count;
+		}
+
+		glm::ivec4 bounds = count > 1 ? getDesktopBounds(a_monitors, a_count) : glm::ivec4(0);
+		if (bounds.z == 0)
+		{
+			m_views[0].viewport = glm::ivec4(0, 0, a_windowResolution);
+			m_views[0].aspect = (float)a_windowResolution.x / std::max(a_windowResolution.y, 1);
+			m_viewCount = 1;
+			return;
+		}
+
+		// Left to right, so the views turn the same way the monitors sit.
+		std::sort(monitors, monitors + count,
+			[](const Monitor& a, const Monitor& b) { return a.position.x < b.position.x; });
+
+		glm::vec2 scale = glm::vec2(a_windowResolution) / glm::vec2(bounds.z, bounds.w);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			glm::ivec2 low(glm::vec2(monitors[i].position - glm::ivec2(bounds)) * scale + 0.5f);
+			glm::ivec2 high(glm::vec2(monitors[i].position + monitors[i].size - glm::ivec2(bounds)) * scale + 0.5f);
+
+			// The desktop's y is down, GL's is up.
+			m_views[i].viewport = glm::ivec4(low.x, a_windowResolution.y - high.y, high - low);
+			m_views[i].aspect = (float)monitors[i].size.x / monitors[i].size.y;
+		}
+		m_viewCount = count;
+	}
+
+	/**
+		getViewport returns a view's viewport in a target the window is
+			drawn into at a scale.
+
+			@param1 a_view is its index.
+
+			@param2 a_scale is how much of the window's width and height
+					the target draws.
+	*/
+	glm::ivec4 ViewLayout::getViewport(unsigned int a_view, float a_scale) const
+	{
+		glm::ivec4 viewport = m_views[a_view].viewport;
+		if (a_scale >= 1.0f)
+			return viewport;
+
+		// Scaled by edges, so neighbouring views still meet.
+		glm::ivec2 low(glm::vec2(viewport.x, viewport.y) * a_scale + 0.5f);
+		glm::ivec2 high(glm::vec2(viewport.x + viewport.z, viewport.y + viewport.w) * a_scale + 0.5f);
+		return glm::ivec4(low, glm::max(high - low, glm::ivec2(1)));
+	}
+
+	/**
+		makeCamera turns the camera for a view.
+
+			@param1 a_view is its index.
+
+			@param2 a_cameraView is the camera's view.
+
+			@param3 a_cameraProjection is the camera's projection, for the
+					whole window.
+
+			@param4 a_outView is set to the view's view.
+
+			@param5 a_outProjection is set to the view's projection.
+	*/
+	void ViewLayout::makeCamera(unsigned int a_view, const glm::mat4& a_cameraView, const glm::mat4& a_cameraProjection,
+		glm::mat4& a_outView, glm::mat4& a_outProjection) const
+	{
+		a_outView = a_cameraView;
+		a_outProjection = a_cameraProjection;
+		if (m_viewCount < 2)
+			return;
+
+		float yaws[MAX_VIEWS];
+		float total = 0.0f;
+		getYaws(a_cameraProjection, yaws, total);
+
+		// Turning the camera left by the yaw turns the world right.
+		a_outView = glm::rotate(glm::mat4(1), -yaws[a_view], glm::vec3(0, 1, 0)) * a_cameraView;
+
+		// [0][0] is [1][1] over the aspect ratio for GL's projection and
+		//	the reversed one alike.
+		a_outProjection[0][0] = a_cameraProjection[1][1] / m_views[a_view].aspect;
+	}
+
+	/**
+		makeBoundingProjection returns a projection whose frustum holds
+			every view's, for culling what is shared between them.
+
+			@param1 a_cameraProjection is the camera's projection, for the
+					whole window.
+	*/
+	glm::mat4 ViewLayout::makeBoundingProjection(const glm::mat4& a_cameraProjection) const
+	{
+		if (m_viewCount < 2)
+			return a_cameraProjection;
+
+		float yaws[MAX_VIEWS];
+		float total = 0.0f;
+		getYaws(a_cameraProjection, yaws, total);
+
+		// The views sit evenly either side of the camera, so the bounds
+		//	of them all are as tall as each and as wide as all of them.
+		glm::mat4 projection = a_cameraProjection;
+		projection[0][0] = 1.0f / std::tan(std::min(total, MAX_BOUNDING_ANGLE) * 0.5f);
+		return projection;
+	}
+
+	/**
+		getYaws works out where each view's middle points, from the
+			projection's vertical field of view.
+
+			@param1 a_cameraProjection is the camera's projection.
+
+			@param2 a_yaws is set to each view's angle, radians to the left
+					of the camera.
+
+			@param3 a_totalAngle is set to how wide the views are all
+					together.
+	*/
+	void ViewLayout::getYaws(const glm::mat4& a_cameraProjection, float* a_yaws, float& a_totalAngle) const
+	{
+		// The tangent of half the vertical field of view.
+		float tangent = 1.0f / a_cameraProjection[1][1];
+
+		float halves[MAX_VIEWS];
+		a_totalAngle = 0.0f;
+		for (unsigned int i = 0; i < m_viewCount; ++i)
+		{
+			halves[i] = std::atan(tangent * m_views[i].aspect);
+			a_totalAngle += halves[i] * 2.0f;
+		}
+
+		// From the left edge of them all, across each view to its middle.
+		float left = a_totalAngle * 0.5f;
+		for (unsigned int i = 0; i < m_viewCount; ++i)
+		{
+			a_yaws[i] = left - halves[i];
+			left -= halves[i] * 2.0f;
+		}
+	}
+}
@@ -0,0 +1,139 @@
+/**
+	ViewLayout.h
+
+	Purpose: ViewLayout.h is the header file for the ViewLayout class.
+			The ViewLayout splits the window into a view per monitor,
+			each turned from the camera so that together they make one
+			view around it.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+struct GLFWmonitor;
+
+namespace sns
+{
+	/**
+		The ViewLayout class lays a viewport over each monitor a window
+			spread across them covers, left to right, and turns each
+			view's camera about its up axis by the angle its monitor
+			sits at, so the views meet at their edges. Each keeps the
+			camera's vertical field of view and takes its monitor's
+			aspect, so none is stretched.
+
+		Views are numbered so each is a bit of RenderQueue::Item's view
+			mask, at most MAX_VIEWS of them. With one monitor, or made
+			without any, there is one view of the whole window and the
+			camera is used as it is.
+	*/
+	class ViewLayout
+	{
+	public:
+		// As many as the bits of a view mask there are to spare.
+		static const unsigned int MAX_VIEWS = 8;
+
+		/**
+			A view's part of the window.
+		*/
+		struct View
+		{
+			// x, y, width and height in window pixels, y up as GL has
+			//	it.
+			glm::ivec4 viewport;
+
+			// Its width over its height.
+			float aspect;
+		};
+
+		ViewLayout();
+
+		/**
+			getDesktopBounds returns the part of the desktop the monitors
+				cover together, as for glfwSetWindowPos and
+				glfwSetWindowSize.
+
+				@param1 a_monitors are the monitors.
+
+				@param2 a_count is how many there are.
+
+				@return x, y, width and height, y down as GLFW has it.
+		*/
+		static glm::ivec4 getDesktopBounds(GLFWmonitor** a_monitors, int a_count);
+
+		/**
+			create lays out the views.
+
+				@param1 a_monitors are the monitors the window covers, or
+						nullptr for one view of the whole window.
+
+				@param2 a_count is how many there are.
+
+				@param3 a_windowResolution is the window's size. Views
+						are scaled from the monitors' desktop positions
+						to fit it, if it isn't the size they cover.
+		*/
+		void create(GLFWmonitor** a_monitors, int a_count, const glm::ivec2& a_windowResolution);
+
+		/**
+			getViewCount returns how many views there are.
+		*/
+		unsigned int getViewCount() const { return m_viewCount; }
+
+		/**
+			getView returns a view.
+
+				@param1 a_view is its index.
+		*/
+		const View& getView(unsigned int a_view) const { return m_views[a_view]; }
+
+		/**
+			getViewport returns a view's viewport in a target the window
+				is drawn into at a scale.
+
+				@param1 a_view is its index.
+
+				@param2 a_scale is how much of the window's width and
+						height the target draws.
+		*/
+		glm::ivec4 getViewport(unsigned int a_view, float a_scale) const;
+
+		/**
+			makeCamera turns the camera for a view.
+
+				@param1 a_view is its index.
+
+				@param2 a_cameraView is the camera's view.
+
+				@param3 a_cameraProjection is the camera's projection, for
+						the whole window.
+
+				@param4 a_outView is set to the view's view.
+
+				@param5 a_outProjection is set to the view's projection.
+		*/
+		void makeCamera(unsigned int a_view, const glm::mat4& a_cameraView, const glm::mat4& a_cameraProjection,
+			glm::mat4& a_outView, glm::mat4& a_outProjection) const;
+
+		/**
+			makeBoundingProjection returns a projection whose frustum
+				holds every view's, for culling what is shared between
+				them. It can't be wider than 160 degrees, views past
+				that are only partly inside it.
+
+				@param1 a_cameraProjection is the camera's projection, for
+						the whole window.
+		*/
+		glm::mat4 makeBoundingProjection(const glm::mat4& a_cameraProjection) const;
+
+	private:
+		// Works out where each view's middle points, from the projection's
+		//	vertical field of view. Radians to the left of the camera.
+		void getYaws(const glm::mat4& a_cameraProjection, float* a_yaws, float& a_totalAngle) const;
+
+		View m_views[MAX_VIEWS];
+		unsigned int m_viewCount;
+	};
+}
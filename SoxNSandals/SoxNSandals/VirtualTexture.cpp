@@ -0,0 +1,420 @@
+/**
+	VirtualTexture.cpp
+
+	Purpose: VirtualTexture.cpp is the source file for the VirtualTexture
+			class. A VirtualTexture is an image too large to be on the
+			gpu whole, split into pages that are loaded as they are seen
+			and found through a page table.
+
+	@author Nathan Nette
+*/
+#include "VirtualTexture.h"
+#include "GpuMemory.h"
+#include "ImageDecoder.h"
+#include "Lz4.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace sns
+{
+	/**
+		An RGBA8 level of the image while it is cut into pages.
+	*/
+	struct PageLevel
+	{
+		unsigned int width;
+		unsigned int height;
+		std::vector<unsigned char> texels;
+	};
+
+	/**
+		nextPowerOfTwo rounds a count up to a power of two.
+
+			@param1 a_count is the count, at least 1.
+	*/
+	static unsigned int nextPowerOfTwo(unsigned int a_count)
+	{
+		unsigned int power = 1;
+		while (power < a_count)
+			power *= 2;
+		return power;
+	}
+
+	/**
+		downsampleLevel makes the next level of the mip chain, each texel
+			the average of the up to four above it.
+
+			@param1 a_level is the level above.
+
+			@param2 a_next is set to the level below it.
+	*/
+	static void downsampleLevel(const PageLevel& a_level, PageLevel& a_next)
+	{
+		a_next.width = a_level.width > 1 ? (a_level.width + 1) / 2 : 1;
+		a_next.height = a_level.height > 1 ? (a_level.height + 1) / 2 : 1;
+		a_next.texels.resize((size_t)a_next.width * a_next.height * 4);
+		for (unsigned int y = 0; y < a_next.height; ++y)
+		{
+			unsigned int y0 = y * 2 < a_level.height ? y * 2 : a_level.height - 1;
+			unsigned int y1 = y0 + 1 < a_level.height ? y0 + 1 : y0;
+			for (unsigned int x = 0; x < a_next.width; ++x)
+			{
+				unsigned int x0 = x * 2 < a_level.width ? x * 2 : a_level.width - 1;
+				unsigned int x1 = x0 + 1 < a_level.width ? x0 + 1 : x0;
+				const unsigned char* texels = a_level.texels.data();
+				size_t rows[2] = { (size_t)y0 * a_level.width, (size_t)y1 * a_level.width };
+				for (unsigned int c = 0; c < 4; ++c)
+				{
+					unsigned int sum = texels[(rows[0] + x0) * 4 + c] + texels[(rows[0] + x1) * 4 + c] +
+						texels[(rows[1] + x0) * 4 + c] + texels[(rows[1] + x1) * 4 + c];
+					a_next.texels[((size_t)y * a_next.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	/**
+		build cuts an image into a page file. Every level of its mip chain
+			is a box filter of the one above, and pages that save an
+			eighth or more are compressed as LZ4 blocks.
+
+			@param1 a_image is the path of the image, in any format the
+					ImageDecoder reads.
+
+			@param2 a_output is the path of the page file to write.
+
+			@return false if the image can't be read or the file written.
+	*/
+	bool VirtualTexture::build(const char* a_image, const char* a_output)
+	{
+		FileView view;
+		if (FileSystem::instance().open(a_image, view) == false)
+		{
+			printf("VirtualTexture: %s can't be opened.\n", a_image);
+			return false;
+		}
+		ImageDecoder::Info info;
+		unsigned char* pixels = ImageDecoder::decodeImage(view.getData(), view.getSize(), info);
+		view.close();
+		if (pixels == nullptr)
+		{
+			printf("VirtualTexture: %s can't be decoded.\n", a_image);
+			return false;
+		}
+
+		// Every channel count is widened to RGBA, as the cache is.
+		PageLevel level;
+		level.width = info.width;
+		level.height = info.height;
+		level.texels.resize((size_t)info.width * info.height * 4);
+		for (size_t i = 0; i < (size_t)info.width * info.height; ++i)
+		{
+			const unsigned char* source = pixels + i * info.channels;
+			unsigned char* texel = &level.texels[i * 4];
+			bool grey = info.channels < 3;
+			texel[0] = source[0];
+			texel[1] = grey ? source[0] : source[1];
+			texel[2] = grey ? source[0] : source[2];
+			texel[3] = info.channels == 2 ? source[1] : (info.channels == 4 ? source[3] : 255);
+		}
+		free(pixels);
+
+		Header header = {};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.width = info.width;
+		header.height = info.height;
+		header.pagesX = nextPowerOfTwo((info.width + PAGE_CONTENT - 1) / PAGE_CONTENT);
+		header.pagesY = nextPowerOfTwo((info.height + PAGE_CONTENT - 1) / PAGE_CONTENT);
+		header.levelCount = 1;
+		while ((header.pagesX >> (header.levelCount - 1)) > 1 || (header.pagesY >> (header.levelCount - 1)) > 1)
+			++header.levelCount;
+		if (header.levelCount > MAX_LEVELS)
+		{
+			printf("VirtualTexture: %s is over %u levels of pages.\n", a_image, MAX_LEVELS);
+			return false;
+		}
+		for (unsigned int i = 0; i < header.levelCount; ++i)
+		{
+			unsigned int pagesX = header.pagesX >> i > 0 ? header.pagesX >> i : 1;
+			unsigned int pagesY = header.pagesY >> i > 0 ? header.pagesY >> i : 1;
+			header.pageCount += pagesX * pagesY;
+		}
+
+		FILE* file = nullptr;
+		fopen_s(&file, a_output, "wb");
+		if (file == nullptr)
+		{
+			printf("VirtualTexture: %s can't be written.\n", a_output);
+			return false;
+		}
+
+		// The entries are written again once the pages are, with where
+		//	they went.
+		std::vector<PageEntry> entries(header.pageCount);
+		bool written = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+			fwrite(entries.data(), sizeof(PageEntry), entries.size(), file) == entries.size();
+		unsigned long long offset = sizeof(Header) + entries.size() * sizeof(PageEntry);
+
+		std::vector<unsigned char> page(PAGE_BYTES);
+		std::vector<unsigned char> compressed;
+		unsigned int index = 0;
+		unsigned int storedPages = 0;
+		for (unsigned int i = 0; i < header.levelCount && written; ++i)
+		{
+			unsigned int pagesX = header.pagesX >> i > 0 ? header.pagesX >> i : 1;
+			unsigned int pagesY = header.pagesY >> i > 0 ? header.pagesY >> i : 1;
+			for (unsigned int y = 0; y < pagesY && written; ++y)
+			{
+				for (unsigned int x = 0; x < pagesX && written; ++x, ++index)
+				{
+					if (x * PAGE_CONTENT >= level.width || y * PAGE_CONTENT >= level.height)
+						continue;
+
+					// The border repeats the edge of the image, where there
+					//	are no pages beside it.
+					for (unsigned int row = 0; row < PAGE_SIZE; ++row)
+					{
+						int sourceRow = (int)(y * PAGE_CONTENT + row) - (int)PAGE_BORDER;
+						sourceRow = sourceRow < 0 ? 0 : (sourceRow >= (int)level.height ? level.height - 1 : sourceRow);
+						for (unsigned int column = 0; column < PAGE_SIZE; ++column)
+						{
+							int sourceColumn = (int)(x * PAGE_CONTENT + column) - (int)PAGE_BORDER;
+							sourceColumn = sourceColumn < 0 ? 0 :
+								(sourceColumn >= (int)level.width ? level.width - 1 : sourceColumn);
+							memcpy(&page[(row * PAGE_SIZE + column) * 4],
+								&level.texels[((size_t)sourceRow * level.width + sourceColumn) * 4], 4);
+						}
+					}
+
+					Lz4::compress(page.data(), PAGE_BYTES, compressed);
+					PageEntry& entry = entries[index];
+					entry.offset = offset;
+					entry.compressed = compressed.size() <= PAGE_BYTES - PAGE_BYTES / 8 ? 1 : 0;
+					entry.storedSize = entry.compressed != 0 ? (unsigned int)compressed.size() : PAGE_BYTES;
+					const unsigned char* stored = entry.compressed != 0 ? compressed.data() : page.data();
+					written = fwrite(stored, 1, entry.storedSize, file) == entry.storedSize;
+					offset += entry.storedSize;
+					++storedPages;
+				}
+			}
+
+			if (i + 1 < header.levelCount)
+			{
+				PageLevel next;
+				downsampleLevel(level, next);
+				level = std::move(next);
+			}
+		}
+
+		written = written && fseek(file, sizeof(Header), SEEK_SET) == 0 &&
+			fwrite(entries.data(), sizeof(PageEntry), entries.size(), file) == entries.size();
+		written = fclose(file) == 0 && written;
+		if (written == false)
+		{
+			printf("VirtualTexture: %s couldn't be written.\n", a_output);
+			return false;
+		}
+		printf("VirtualTexture: %s has %u levels, %u of %u pages stored in %.1f MB\n", a_output,
+			header.levelCount, storedPages, header.pageCount, offset / (1024.0 * 1024.0));
+		return true;
+	}
+
+	VirtualTexture::VirtualTexture()
+		: m_header(),
+		m_entries(nullptr),
+		m_tableDirty(false),
+		m_pageTable(0)
+	{
+	}
+
+	/**
+		The deconstructor deletes the page table, see destroy.
+	*/
+	VirtualTexture::~VirtualTexture()
+	{
+		destroy();
+	}
+
+	/**
+		load opens a page file through the FileSystem, keeping it open for
+			its pages, and makes the page table. Nothing is resident yet.
+
+			@param1 a_filename is the path of the page file.
+
+			@return false if it can't be read or isn't one.
+	*/
+	bool VirtualTexture::load(const char* a_filename)
+	{
+		destroy();
+		if (FileSystem::instance().open(a_filename, m_file) == false)
+		{
+			printf("VirtualTexture: %s can't be opened.\n", a_filename);
+			return false;
+		}
+
+		const unsigned char* data = m_file.getData();
+		size_t size = m_file.getSize();
+		if (size >= sizeof(Header))
+			memcpy(&m_header, data, sizeof(Header));
+		if (size < sizeof(Header) || m_header.magic != MAGIC || m_header.version != VERSION ||
+			m_header.levelCount == 0 || m_header.levelCount > MAX_LEVELS ||
+			size < sizeof(Header) + (size_t)m_header.pageCount * sizeof(PageEntry))
+		{
+			printf("VirtualTexture: %s isn't a version %u page file.\n", a_filename, VERSION);
+			m_file.close();
+			return false;
+		}
+
+		// The levels must add up to the entries, and every page be inside
+		//	the file, so reading one never goes past it.
+		m_entries = (const PageEntry*)(data + sizeof(Header));
+		m_levelOffsets.resize(m_header.levelCount);
+		unsigned int pageCount = 0;
+		for (unsigned int i = 0; i < m_header.levelCount; ++i)
+		{
+			m_levelOffsets[i] = pageCount;
+			pageCount += getPagesX(i) * getPagesY(i);
+		}
+		bool valid = pageCount == m_header.pageCount;
+		for (unsigned int i = 0; i < m_header.pageCount && valid; ++i)
+			valid = m_entries[i].offset + m_entries[i].storedSize <= size;
+		if (valid == false)
+		{
+			printf("VirtualTexture: %s is damaged.\n", a_filename);
+			m_file.close();
+			m_entries = nullptr;
+			return false;
+		}
+
+		m_filename = a_filename;
+		m_pages.assign(m_header.pageCount, { NO_SLOT, false });
+		m_table.assign(m_header.pageCount, 0);
+		m_tableDirty = true;
+
+		// Looked up with texelFetch, at the level wanted, so no filtering.
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_pageTable);
+		glTextureStorage2D(m_pageTable, m_header.levelCount, GL_RGBA8UI, m_header.pagesX, m_header.pagesY);
+		glTextureParameteri(m_pageTable, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(m_pageTable, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GpuMemory::instance().trackTexture(m_pageTable, GpuMemory::getTextureBytes(GL_RGBA8UI, m_header.pagesX,
+			m_header.pagesY, 1, m_header.levelCount), GpuMemory::TEXTURES, "VirtualTexture");
+		return true;
+	}
+
+	/**
+		destroy deletes the page table and lets go of the file.
+	*/
+	void VirtualTexture::destroy()
+	{
+		if (m_pageTable != 0)
+		{
+			glDeleteTextures(1, &m_pageTable);
+			RenderState::instance().onTextureDeleted(m_pageTable);
+			GpuMemory::instance().releaseTexture(m_pageTable);
+			m_pageTable = 0;
+		}
+		m_file.close();
+		m_entries = nullptr;
+		m_header = {};
+		m_levelOffsets.clear();
+		m_pages.clear();
+		m_table.clear();
+		m_tableDirty = false;
+	}
+
+	/**
+		readPage copies a page's texels out of the file, decompressing it
+			if it was. Only reads the mapping, so any thread can.
+
+			@param1 a_page is the page's index.
+
+			@param2 a_texels is PAGE_BYTES written with its RGBA8 texels.
+
+			@return false if it isn't stored or is damaged.
+	*/
+	bool VirtualTexture::readPage(unsigned int a_page, unsigned char* a_texels) const
+	{
+		const PageEntry& entry = m_entries[a_page];
+		if (entry.storedSize == 0)
+			return false;
+
+		const unsigned char* stored = m_file.getData() + entry.offset;
+		if (entry.compressed != 0)
+			return Lz4::decompress(stored, entry.storedSize, a_texels, PAGE_BYTES);
+		if (entry.storedSize != PAGE_BYTES)
+			return false;
+		memcpy(a_texels, stored, PAGE_BYTES);
+		return true;
+	}
+
+	/**
+		setSlot makes a page resident in a slot, or not, for the page table
+			to be rebuilt with.
+
+			@param1 a_page is the page's index.
+
+			@param2 a_slot is its slot, or NO_SLOT.
+	*/
+	void VirtualTexture::setSlot(unsigned int a_page, unsigned int a_slot)
+	{
+		m_pages[a_page].slot = a_slot;
+		m_tableDirty = true;
+	}
+
+	/**
+		updatePageTable rebuilds and uploads the page table, if any page's
+			slot changed since it was last. Levels are built from the
+			single page down, so a page that isn't resident copies its
+			parent's texel, which is already its nearest resident page.
+
+			@param1 a_slotsPerSide is how many slots the cache has in each
+					direction.
+	*/
+	void VirtualTexture::updatePageTable(unsigned int a_slotsPerSide)
+	{
+		if (m_tableDirty == false || isLoaded() == false)
+			return;
+
+		for (unsigned int level = m_header.levelCount; level-- > 0;)
+		{
+			unsigned int pagesX = getPagesX(level);
+			unsigned int pagesY = getPagesY(level);
+			for (unsigned int y = 0; y < pagesY; ++y)
+			{
+				for (unsigned int x = 0; x < pagesX; ++x)
+				{
+					unsigned int page = getPageIndex(level, x, y);
+					unsigned int slot = m_pages[page].slot;
+
+					// The slot's column and row, the page's level and 255
+					//	for something to draw, 0 before anything is.
+					unsigned int texel = 0;
+					if (slot != NO_SLOT)
+						texel = (slot % a_slotsPerSide) | (slot / a_slotsPerSide) << 8 | level << 16 | 0xffu << 24;
+					else if (level + 1 < m_header.levelCount)
+						texel = m_table[getPageIndex(level + 1, x / 2, y / 2)];
+					m_table[page] = texel;
+				}
+			}
+			glTextureSubImage2D(m_pageTable, level, 0, 0, pagesX, pagesY, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+				&m_table[m_levelOffsets[level]]);
+		}
+		m_tableDirty = false;
+	}
+
+	/**
+		getSizes returns the fraction of the first level the image covers
+			in xy, and its pages in zw.
+	*/
+	glm::vec4 VirtualTexture::getSizes() const
+	{
+		float width = (float)(m_header.pagesX * PAGE_CONTENT);
+		float height = (float)(m_header.pagesY * PAGE_CONTENT);
+		return glm::vec4(m_header.width / width, m_header.height / height, (float)m_header.pagesX,
+			(float)m_header.pagesY);
+	}
+}
@@ -0,0 +1,288 @@
+/**
+	VirtualTexture.h
+
+	Purpose: VirtualTexture.h is the header file for the VirtualTexture
+			class. A VirtualTexture is an image too large to be on the
+			gpu whole, split into pages that are loaded as they are seen
+			and found through a page table.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "FileSystem.h"
+#include <glm/vec4.hpp>
+#include <string>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The VirtualTexture class reads a page file, written offline by
+			build, and keeps which of its pages are in a
+			VirtualTextureCache's slots and the page table the shaders
+			find them by.
+
+		Every level of the image's mip chain is cut into pages of
+			PAGE_CONTENT texels a side, stored PAGE_SIZE a side with a
+			border of PAGE_BORDER from around them, so a page filters
+			like the whole image at its edges. The first level's page
+			counts are powers of two, so each level has exactly half
+			the pages of the one above in each direction and a page's
+			parent is at half its coordinates. The image is the corner
+			of that, uvScale of it, the pages past its edge are never
+			stored.
+
+		The page table has a texel for every page of every level, its
+			own mips. A texel holds the slot of the page itself when it
+			is resident, or of the nearest resident page above it, and
+			that page's level, so a lookup always finds something to
+			draw. Only the main thread touches the table and residency.
+			Pages themselves can be read on any thread, see readPage.
+	*/
+	class VirtualTexture
+	{
+	public:
+		// "SNSV", and the version of the layout below.
+		static const unsigned int MAGIC = 0x56534e53;
+		static const unsigned int VERSION = 1;
+
+		// A stored page's side in texels, its border, and the texels of
+		//	the image it covers a side.
+		static const unsigned int PAGE_SIZE = 128;
+		static const unsigned int PAGE_BORDER = 4;
+		static const unsigned int PAGE_CONTENT = PAGE_SIZE - PAGE_BORDER * 2;
+
+		// An RGBA8 page decompressed.
+		static const unsigned int PAGE_BYTES = PAGE_SIZE * PAGE_SIZE * 4;
+
+		// The page table's texels only have four bits for the level, and
+		//	the feedback twelve for each coordinate.
+		static const unsigned int MAX_LEVELS = 13;
+
+		// The slot of a page that isn't resident.
+		static const unsigned int NO_SLOT = 0xffffffff;
+
+		/**
+			A page file starts with the header, then an entry for every
+				page, level by level and row by row within a level,
+				then the pages.
+		*/
+		struct Header
+		{
+			unsigned int magic;
+			unsigned int version;
+
+			// The image's size in texels.
+			unsigned int width;
+			unsigned int height;
+
+			// The first level's pages in each direction, powers of two.
+			unsigned int pagesX;
+			unsigned int pagesY;
+			unsigned int levelCount;
+			unsigned int pageCount;
+		};
+
+		/**
+			Where a page is in the file.
+		*/
+		struct PageEntry
+		{
+			// From the start of the file, and how many bytes it takes
+			//	there, 0 for a page past the image's edge.
+			unsigned long long offset;
+			unsigned int storedSize;
+
+			// Set when it is an LZ4 block.
+			unsigned int compressed;
+		};
+
+		/**
+			Where a page is on the gpu.
+		*/
+		struct Page
+		{
+			// Its VirtualTextureCache slot, or NO_SLOT.
+			unsigned int slot;
+
+			// Queued to be loaded, or being.
+			bool loading;
+		};
+
+		/**
+			build cuts an image into a page file. Every level of its mip
+				chain is a box filter of the one above, and pages that
+				save an eighth or more are compressed as LZ4 blocks.
+
+				@param1 a_image is the path of the image, in any format
+						the ImageDecoder reads.
+
+				@param2 a_output is the path of the page file to write.
+
+				@return false if the image can't be read or the file
+						written.
+		*/
+		static bool build(const char* a_image, const char* a_output);
+
+		VirtualTexture();
+
+		/**
+			The deconstructor deletes the page table, see destroy.
+		*/
+		~VirtualTexture();
+
+		// A VirtualTexture owns its file's view and a GL texture.
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+		/**
+			load opens a page file through the FileSystem, keeping it open
+				for its pages, and makes the page table. Nothing is
+				resident yet.
+
+				@param1 a_filename is the path of the page file.
+
+				@return false if it can't be read or isn't one.
+		*/
+		bool load(const char* a_filename);
+
+		/**
+			destroy deletes the page table and lets go of the file.
+		*/
+		void destroy();
+
+		/**
+			isLoaded returns whether load succeeded.
+		*/
+		bool isLoaded() const { return m_pageTable != 0; }
+
+		/**
+			readPage copies a page's texels out of the file, decompressing
+				it if it was. Any thread can read pages at once.
+
+				@param1 a_page is the page's index.
+
+				@param2 a_texels is PAGE_BYTES written with its RGBA8
+						texels, its rows in the image's order.
+
+				@return false if it isn't stored or is damaged.
+		*/
+		bool readPage(unsigned int a_page, unsigned char* a_texels) const;
+
+		/**
+			getPageIndex returns a page's index.
+
+				@param1 a_level is its level.
+
+				@param2 a_x is its column, below getPagesX(a_level).
+
+				@param3 a_y is its row, below getPagesY(a_level).
+		*/
+		unsigned int getPageIndex(unsigned int a_level, unsigned int a_x, unsigned int a_y) const
+		{
+			return m_levelOffsets[a_level] + a_y * getPagesX(a_level) + a_x;
+		}
+
+		/**
+			getPagesX and getPagesY return how many pages a level has in
+				each direction.
+
+				@param1 a_level is the level.
+		*/
+		unsigned int getPagesX(unsigned int a_level) const
+		{
+			return m_header.pagesX >> a_level > 0 ? m_header.pagesX >> a_level : 1;
+		}
+		unsigned int getPagesY(unsigned int a_level) const
+		{
+			return m_header.pagesY >> a_level > 0 ? m_header.pagesY >> a_level : 1;
+		}
+
+		/**
+			getLevelCount returns how many levels it has, the last being
+				a single page.
+		*/
+		unsigned int getLevelCount() const { return m_header.levelCount; }
+
+		/**
+			getPageCount returns how many pages every level has together.
+		*/
+		unsigned int getPageCount() const { return m_header.pageCount; }
+
+		/**
+			isStored returns whether a page has texels, rather than being
+				past the image's edge.
+
+				@param1 a_page is the page's index.
+		*/
+		bool isStored(unsigned int a_page) const { return m_entries[a_page].storedSize > 0; }
+
+		/**
+			getPage returns where a page is on the gpu.
+
+				@param1 a_page is the page's index.
+		*/
+		const Page& getPage(unsigned int a_page) const { return m_pages[a_page]; }
+
+		/**
+			setLoading marks a page as queued to be loaded, or no longer.
+
+				@param1 a_page is the page's index.
+
+				@param2 a_loading is whether it is.
+		*/
+		void setLoading(unsigned int a_page, bool a_loading) { m_pages[a_page].loading = a_loading; }
+
+		/**
+			setSlot makes a page resident in a slot, or not, for the page
+				table to be rebuilt with.
+
+				@param1 a_page is the page's index.
+
+				@param2 a_slot is its slot, or NO_SLOT.
+		*/
+		void setSlot(unsigned int a_page, unsigned int a_slot);
+
+		/**
+			updatePageTable rebuilds and uploads the page table, if any
+				page's slot changed since it was last.
+
+				@param1 a_slotsPerSide is how many slots the cache has in
+						each direction, a slot being its row times that
+						plus its column.
+		*/
+		void updatePageTable(unsigned int a_slotsPerSide);
+
+		/**
+			getPageTable returns the GL handle of the page table.
+		*/
+		unsigned int getPageTable() const { return m_pageTable; }
+
+		/**
+			getSizes returns the fraction of the first level the image
+				covers in xy, and its pages in zw, as the shaders take
+				them.
+		*/
+		glm::vec4 getSizes() const;
+
+		/**
+			getFilename returns the path it was loaded from.
+		*/
+		const std::string& getFilename() const { return m_filename; }
+
+	private:
+		std::string m_filename;
+		FileView m_file;
+		Header m_header;
+		const PageEntry* m_entries;
+
+		// The index of each level's first page.
+		std::vector<unsigned int> m_levelOffsets;
+		std::vector<Page> m_pages;
+
+		// Every level's texels, one after another as the pages are.
+		std::vector<unsigned int> m_table;
+		bool m_tableDirty;
+		unsigned int m_pageTable;
+	};
+}
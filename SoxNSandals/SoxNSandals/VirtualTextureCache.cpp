@@ -0,0 +1,594 @@
+/**
+	VirtualTextureCache.cpp
+
+	Purpose: VirtualTextureCache.cpp is the source file for the
+			VirtualTextureCache class. The VirtualTextureCache keeps the
+			pages of every VirtualTexture that have been seen in one
+			texture of a fixed size, loading them on a thread of its own
+			from what a low resolution feedback pass says is drawn.
+
+	@author Nathan Nette
+*/
+#include "VirtualTextureCache.h"
+#include "GpuMemory.h"
+#include "GpuReadback.h"
+#include "RenderState.h"
+#include "gl_core_4_5.h"
+#include <glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// ARB_sparse_texture, which gl_core_4_5 doesn't have.
+#ifndef GL_TEXTURE_SPARSE_ARB
+#define GL_TEXTURE_SPARSE_ARB				0x91A6
+#define GL_VIRTUAL_PAGE_SIZE_INDEX_ARB		0x91A7
+#define GL_NUM_VIRTUAL_PAGE_SIZES_ARB		0x91A8
+#define GL_VIRTUAL_PAGE_SIZE_X_ARB			0x9195
+#define GL_VIRTUAL_PAGE_SIZE_Y_ARB			0x9196
+#endif
+
+namespace sns
+{
+	// The most page sizes a driver is asked for.
+	static const int MAX_SPARSE_PAGE_SIZES = 8;
+
+	// glTexPageCommitmentARB, which gl_core_4_5 doesn't load.
+	typedef void (CODEGEN_FUNCPTR* TexPageCommitmentFunction)(GLenum target, GLint level, GLint xoffset,
+		GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLboolean commit);
+	static TexPageCommitmentFunction s_texPageCommitment = nullptr;
+
+	VirtualTextureCache::VirtualTextureCache()
+		: m_cache(0),
+		m_slotsPerSide(0),
+		m_sparse(false),
+		m_feedbackFramebuffer(0),
+		m_feedbackTexture(0),
+		m_feedbackDepth(0),
+		m_feedbackWidth(0),
+		m_feedbackHeight(0),
+		m_feedbackPending(false),
+		m_frame(0),
+		m_previousFramebuffer(0),
+		m_previousViewport(),
+		m_stopping(false),
+		m_stats()
+	{
+	}
+
+	/**
+		The deconstructor stops the thread and deletes the textures, see
+			destroy.
+	*/
+	VirtualTextureCache::~VirtualTextureCache()
+	{
+		destroy();
+	}
+
+	/**
+		create makes the cache and feedback target, loads the feedback
+			shader and starts the loader thread. The cache is sparse when
+			the driver has a page size the slots are a multiple of.
+
+			@param1 a_width is the width of the view the feedback is drawn
+					for.
+
+			@param2 a_height is its height.
+
+			@param3 a_slotsPerSide is how many slots the cache has in each
+					direction, at most 256.
+
+			@return false without GL 4.5 or the shader, the cache is left
+					uncreated.
+	*/
+	bool VirtualTextureCache::create(int a_width, int a_height, unsigned int a_slotsPerSide)
+	{
+		destroy();
+		if (ogl_IsVersionGEQ(4, 5) == 0)
+		{
+			printf("VirtualTextureCache: virtual texturing needs GL 4.5.\n");
+			return false;
+		}
+
+		if (m_feedbackShader.getHandle() == 0)
+		{
+			m_feedbackShader.loadShader(aie::eShaderStage::VERTEX, "../shaders/lit.vert",
+				"#define VIRTUAL_TEXTURE 1\n");
+			m_feedbackShader.loadShader(aie::eShaderStage::FRAGMENT, "../shaders/virtualFeedback.frag");
+			if (m_feedbackShader.link() == false)
+			{
+				printf("Shader Error: %s\n", m_feedbackShader.getLastError());
+				return false;
+			}
+		}
+
+		// The page table has eight bits for each of a slot's coordinates.
+		m_slotsPerSide = std::max(1u, std::min(a_slotsPerSide, 256u));
+		int size = (int)(m_slotsPerSide * VirtualTexture::PAGE_SIZE);
+
+		m_sparse = false;
+		GLint sparseIndex = 0;
+		if (glfwExtensionSupported("GL_ARB_sparse_texture"))
+		{
+			if (s_texPageCommitment == nullptr)
+				s_texPageCommitment = (TexPageCommitmentFunction)glfwGetProcAddress("glTexPageCommitmentARB");
+
+			GLint sizeCount = 0;
+			glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &sizeCount);
+			sizeCount = std::min(sizeCount, MAX_SPARSE_PAGE_SIZES);
+			GLint pageX[MAX_SPARSE_PAGE_SIZES] = {};
+			GLint pageY[MAX_SPARSE_PAGE_SIZES] = {};
+			if (sizeCount > 0)
+			{
+				glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_X_ARB, sizeCount, pageX);
+				glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_Y_ARB, sizeCount, pageY);
+			}
+			for (GLint i = 0; i < sizeCount && s_texPageCommitment != nullptr && m_sparse == false; ++i)
+			{
+				if (pageX[i] > 0 && pageY[i] > 0 && VirtualTexture::PAGE_SIZE % pageX[i] == 0 &&
+					VirtualTexture::PAGE_SIZE % pageY[i] == 0)
+				{
+					m_sparse = true;
+					sparseIndex = i;
+				}
+			}
+		}
+
+		// Slots are only ever read at their one level, with the borders
+		//	keeping bilinear filtering inside each page.
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_cache);
+		if (m_sparse)
+		{
+			glTextureParameteri(m_cache, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+			glTextureParameteri(m_cache, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, sparseIndex);
+		}
+		glTextureStorage2D(m_cache, 1, GL_RGBA8, size, size);
+		glTextureParameteri(m_cache, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_cache, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_cache, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_cache, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		m_stats.committedBytes = m_sparse ? 0 : GpuMemory::getTextureBytes(GL_RGBA8, size, size);
+		GpuMemory::instance().trackTexture(m_cache, m_stats.committedBytes, GpuMemory::TEXTURES,
+			"VirtualTextureCache");
+
+		m_slots.assign(m_slotsPerSide * m_slotsPerSide,
+			{ NO_TEXTURE, VirtualTexture::NO_SLOT, 0, false, false });
+		m_freeSlots.resize(m_slots.size());
+		for (unsigned int i = 0; i < m_freeSlots.size(); ++i)
+			m_freeSlots[i] = (unsigned int)m_freeSlots.size() - 1 - i;
+
+		// The feedback only needs its own depth to keep the nearest
+		//	surface, it is never blended.
+		m_feedbackWidth = std::max(1, a_width / (int)FEEDBACK_DIVISOR);
+		m_feedbackHeight = std::max(1, a_height / (int)FEEDBACK_DIVISOR);
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_feedbackTexture);
+		glTextureStorage2D(m_feedbackTexture, 1, GL_R32UI, m_feedbackWidth, m_feedbackHeight);
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_feedbackDepth);
+		glTextureStorage2D(m_feedbackDepth, 1, GL_DEPTH_COMPONENT24, m_feedbackWidth, m_feedbackHeight);
+		GpuMemory& memory = GpuMemory::instance();
+		memory.trackTexture(m_feedbackTexture, GpuMemory::getTextureBytes(GL_R32UI, m_feedbackWidth,
+			m_feedbackHeight), GpuMemory::RENDER_TARGETS, "VirtualTextureCache");
+		memory.trackTexture(m_feedbackDepth, GpuMemory::getTextureBytes(GL_DEPTH_COMPONENT24, m_feedbackWidth,
+			m_feedbackHeight), GpuMemory::RENDER_TARGETS, "VirtualTextureCache");
+
+		glCreateFramebuffers(1, &m_feedbackFramebuffer);
+		glNamedFramebufferTexture(m_feedbackFramebuffer, GL_COLOR_ATTACHMENT0, m_feedbackTexture, 0);
+		glNamedFramebufferTexture(m_feedbackFramebuffer, GL_DEPTH_ATTACHMENT, m_feedbackDepth, 0);
+		glNamedFramebufferDrawBuffer(m_feedbackFramebuffer, GL_COLOR_ATTACHMENT0);
+		glNamedFramebufferReadBuffer(m_feedbackFramebuffer, GL_COLOR_ATTACHMENT0);
+		if (glCheckNamedFramebufferStatus(m_feedbackFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("VirtualTextureCache: the feedback framebuffer isn't complete.\n");
+			destroy();
+			return false;
+		}
+
+		m_stats.slots = (unsigned int)m_slots.size();
+		m_stopping = false;
+		m_thread = std::thread(&VirtualTextureCache::run, this);
+		printf("Virtual texturing: %u pages in a %s %ix%i cache\n", m_stats.slots, m_sparse ? "sparse" : "resident",
+			size, size);
+		return true;
+	}
+
+	/**
+		add loads a page file and queues its coarsest page, which is never
+			evicted once it is resident.
+
+			@param1 a_filename is the path of the page file. A file already
+					added is only added once.
+
+			@return its index, or NO_TEXTURE if it can't be loaded or
+					MAX_TEXTURES already are.
+	*/
+	unsigned int VirtualTextureCache::add(const char* a_filename)
+	{
+		if (isCreated() == false)
+			return NO_TEXTURE;
+		for (unsigned int i = 0; i < m_textures.size(); ++i)
+		{
+			if (m_textures[i]->getFilename() == a_filename)
+				return i;
+		}
+		if (m_textures.size() >= MAX_TEXTURES)
+		{
+			printf("VirtualTextureCache: %s is over the %u textures there can be.\n", a_filename, MAX_TEXTURES);
+			return NO_TEXTURE;
+		}
+
+		std::unique_ptr<VirtualTexture> texture(new VirtualTexture());
+		if (texture->load(a_filename) == false)
+			return NO_TEXTURE;
+
+		unsigned int index = (unsigned int)m_textures.size();
+		unsigned int level = texture->getLevelCount() - 1;
+		unsigned int page = texture->getPageIndex(level, 0, 0);
+		texture->setLoading(page, true);
+		m_textures.push_back(std::move(texture));
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back({ index, page, level });
+		}
+		m_wake.notify_one();
+		return index;
+	}
+
+	/**
+		beginFeedback binds and clears the feedback target and binds the
+			feedback shader, unless the last feedback is still being read
+			back.
+
+			@param1 a_viewHeight is the height of the view the meshes are
+					drawn with. The feedback's derivatives are as many times
+					larger as it is smaller, so its levels are biased back.
+
+			@return false if nothing is to be drawn this frame.
+	*/
+	bool VirtualTextureCache::beginFeedback(int a_viewHeight)
+	{
+		static constexpr aie::UniformHandle FEEDBACK_BIAS("FeedbackBias");
+		static const GLuint NOTHING[4] = { 0, 0, 0, 0 };
+
+		if (isCreated() == false || m_textures.empty() || m_feedbackPending)
+			return false;
+
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+		glViewport(0, 0, m_feedbackWidth, m_feedbackHeight);
+		RenderState::instance().setDepthMask(true);
+		glClearBufferuiv(GL_COLOR, 0, NOTHING);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		m_feedbackShader.bind();
+		m_feedbackShader.bindUniform(FEEDBACK_BIAS, -std::log2((float)a_viewHeight / m_feedbackHeight));
+		bind(m_feedbackShader);
+		return true;
+	}
+
+	/**
+		endFeedback reads the feedback back, then puts back the framebuffer
+			and viewport beginFeedback replaced.
+	*/
+	void VirtualTextureCache::endFeedback()
+	{
+		size_t size = (size_t)m_feedbackWidth * m_feedbackHeight * sizeof(unsigned int);
+		m_feedbackPending = true;
+		GpuReadback::instance().readPixels(0, 0, m_feedbackWidth, m_feedbackHeight, GL_RED_INTEGER,
+			GL_UNSIGNED_INT, size, [this](const void* a_data, size_t a_size)
+		{
+			onFeedback(a_data, a_size);
+		});
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+		glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+	}
+
+	/**
+		onFeedback works through a feedback read back. Each texel is 0, or
+			the texture plus one in the top four bits, the level in the
+			next four and the page's row and column in twelve each. The
+			page and every page above it are walked, the resident ones
+			marked as drawn from and the rest wanted.
+
+			@param1 a_data is the feedback's texels.
+
+			@param2 a_size is how many bytes they take.
+	*/
+	void VirtualTextureCache::onFeedback(const void* a_data, size_t a_size)
+	{
+		m_feedbackPending = false;
+		if (isCreated() == false)
+			return;
+
+		const unsigned int* texels = (const unsigned int*)a_data;
+		m_feedback.assign(texels, texels + a_size / sizeof(unsigned int));
+		std::sort(m_feedback.begin(), m_feedback.end());
+		m_feedback.erase(std::unique(m_feedback.begin(), m_feedback.end()), m_feedback.end());
+
+		m_wanted.clear();
+		m_stats.feedbackPages = 0;
+		for (unsigned int texel : m_feedback)
+		{
+			unsigned int index = (texel >> 28) - 1;
+			if (texel == 0 || index >= m_textures.size())
+				continue;
+
+			VirtualTexture& texture = *m_textures[index];
+			unsigned int level = (texel >> 24) & 0xf;
+			unsigned int x = texel & 0xfff;
+			unsigned int y = (texel >> 12) & 0xfff;
+			if (level >= texture.getLevelCount() || x >= texture.getPagesX(level) || y >= texture.getPagesY(level))
+				continue;
+			++m_stats.feedbackPages;
+
+			for (; level < texture.getLevelCount(); ++level, x /= 2, y /= 2)
+			{
+				unsigned int page = texture.getPageIndex(level, x, y);
+				const VirtualTexture::Page& state = texture.getPage(page);
+				if (state.slot != VirtualTexture::NO_SLOT)
+					m_slots[state.slot].lastUsed = m_frame;
+				else if (state.loading == false && texture.isStored(page))
+				{
+					texture.setLoading(page, true);
+					m_wanted.push_back({ index, page, level });
+				}
+			}
+		}
+		queueWanted();
+	}
+
+	/**
+		queueWanted queues the pages onFeedback wanted for the thread, the
+			coarsest first, as they are what the finer ones fall back
+			to. Those past MAX_QUEUED aren't loading after all, and are
+			wanted again by a later feedback.
+	*/
+	void VirtualTextureCache::queueWanted()
+	{
+		std::stable_sort(m_wanted.begin(), m_wanted.end(), [](const Request& a, const Request& b)
+		{
+			return a.level > b.level;
+		});
+
+		size_t queued = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			while (queued < m_wanted.size() && m_requests.size() < MAX_QUEUED)
+				m_requests.push_back(m_wanted[queued++]);
+			m_stats.queuedPages = (unsigned int)m_requests.size();
+		}
+		if (queued > 0)
+			m_wake.notify_one();
+
+		for (size_t i = queued; i < m_wanted.size(); ++i)
+			m_textures[m_wanted[i].texture]->setLoading(m_wanted[i].page, false);
+		m_wanted.clear();
+	}
+
+	/**
+		update uploads the pages the thread has read, evicting those drawn
+			from the longest ago, and rebuilds the page tables that
+			changed.
+	*/
+	void VirtualTextureCache::update()
+	{
+		if (isCreated() == false)
+			return;
+
+		++m_frame;
+		m_stats.uploads = 0;
+		m_stats.evictions = 0;
+		m_stats.starved = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			while (m_loaded.empty() == false && m_uploads.size() < MAX_UPLOADS)
+			{
+				m_uploads.push_back(std::move(m_loaded.front()));
+				m_loaded.pop_front();
+			}
+		}
+
+		for (Loaded& loaded : m_uploads)
+		{
+			VirtualTexture& texture = *m_textures[loaded.request.texture];
+			unsigned int page = loaded.request.page;
+			texture.setLoading(page, false);
+
+			unsigned int slot = loaded.valid ? allocateSlot() : VirtualTexture::NO_SLOT;
+			if (loaded.valid && slot == VirtualTexture::NO_SLOT)
+				++m_stats.starved;
+			if (slot != VirtualTexture::NO_SLOT)
+			{
+				int x = (int)((slot % m_slotsPerSide) * VirtualTexture::PAGE_SIZE);
+				int y = (int)((slot / m_slotsPerSide) * VirtualTexture::PAGE_SIZE);
+
+				// A sparse slot has memory behind it from the first time
+				//	it is filled. Committing goes by the texture bound to the
+				//	active unit, which binding it through the RenderState
+				//	makes the cache's.
+				Slot& state = m_slots[slot];
+				if (m_sparse && state.committed == false)
+				{
+					RenderState::instance().bindTexture(CACHE_UNIT, m_cache);
+					s_texPageCommitment(GL_TEXTURE_2D, 0, x, y, 0, VirtualTexture::PAGE_SIZE,
+						VirtualTexture::PAGE_SIZE, 1, GL_TRUE);
+					state.committed = true;
+					m_stats.committedBytes += VirtualTexture::PAGE_BYTES;
+					GpuMemory::instance().trackTexture(m_cache, m_stats.committedBytes, GpuMemory::TEXTURES,
+						"VirtualTextureCache");
+				}
+				glTextureSubImage2D(m_cache, 0, x, y, VirtualTexture::PAGE_SIZE, VirtualTexture::PAGE_SIZE, GL_RGBA,
+					GL_UNSIGNED_BYTE, loaded.texels.data());
+
+				state.texture = loaded.request.texture;
+				state.page = page;
+				state.lastUsed = m_frame;
+				state.pinned = loaded.request.level + 1 == texture.getLevelCount();
+				texture.setSlot(page, slot);
+				++m_stats.uploads;
+			}
+		}
+
+		// The buffers are read into again.
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (Loaded& loaded : m_uploads)
+				m_buffers.push_back(std::move(loaded.texels));
+		}
+		m_uploads.clear();
+
+		for (auto& texture : m_textures)
+			texture->updatePageTable(m_slotsPerSide);
+		m_stats.residentPages = (unsigned int)(m_slots.size() - m_freeSlots.size());
+	}
+
+	/**
+		allocateSlot finds a free slot, or evicts the page drawn from the
+			longest ago. Pages drawn from since the last feedback and the
+			coarsest pages aren't evicted.
+
+			@return the slot, or NO_SLOT if none can be.
+	*/
+	unsigned int VirtualTextureCache::allocateSlot()
+	{
+		if (m_freeSlots.empty() == false)
+		{
+			unsigned int slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+			return slot;
+		}
+
+		unsigned int oldest = VirtualTexture::NO_SLOT;
+		for (unsigned int i = 0; i < m_slots.size(); ++i)
+		{
+			const Slot& slot = m_slots[i];
+			if (slot.pinned || slot.lastUsed + 1 >= m_frame)
+				continue;
+			if (oldest == VirtualTexture::NO_SLOT || slot.lastUsed < m_slots[oldest].lastUsed)
+				oldest = i;
+		}
+		if (oldest == VirtualTexture::NO_SLOT)
+			return VirtualTexture::NO_SLOT;
+
+		Slot& slot = m_slots[oldest];
+		m_textures[slot.texture]->setSlot(slot.page, VirtualTexture::NO_SLOT);
+		slot.texture = NO_TEXTURE;
+		++m_stats.evictions;
+		return oldest;
+	}
+
+	/**
+		bind binds the cache and page tables to their units, and points a
+			program's samplers at them if it has them. The samplers are
+			pointed at their units even without textures, for the unused
+			ones to be of the right type.
+
+			@param1 a_program is the program, which must be bound.
+	*/
+	void VirtualTextureCache::bind(aie::ShaderProgram& a_program) const
+	{
+		static constexpr aie::UniformHandle VIRTUAL_CACHE("VirtualCache");
+		static constexpr aie::UniformHandle VIRTUAL_CACHE_SLOTS("VirtualCacheSlots");
+		static constexpr aie::UniformHandle VIRTUAL_PAGE_TABLES("VirtualPageTables");
+		static constexpr aie::UniformHandle VIRTUAL_TEXTURE_SIZES("VirtualTextureSizes");
+
+		int units[MAX_TEXTURES];
+		glm::vec4 sizes[MAX_TEXTURES];
+		for (unsigned int i = 0; i < MAX_TEXTURES; ++i)
+		{
+			units[i] = (int)(PAGE_TABLE_UNIT + i);
+			sizes[i] = i < m_textures.size() ? m_textures[i]->getSizes() : glm::vec4(1);
+			if (i < m_textures.size())
+				glBindTextureUnit(PAGE_TABLE_UNIT + i, m_textures[i]->getPageTable());
+		}
+		if (isCreated())
+			glBindTextureUnit(CACHE_UNIT, m_cache);
+		a_program.bindUniform(VIRTUAL_CACHE, (int)CACHE_UNIT);
+		a_program.bindUniform(VIRTUAL_CACHE_SLOTS, (float)m_slotsPerSide);
+		a_program.bindUniform(VIRTUAL_PAGE_TABLES, (int)MAX_TEXTURES, units);
+		a_program.bindUniform(VIRTUAL_TEXTURE_SIZES, (int)MAX_TEXTURES, sizes);
+	}
+
+	/**
+		run reads the queued pages until destroy, into buffers update gives
+			back, and hands them to update.
+	*/
+	void VirtualTextureCache::run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [this]() { return m_stopping || m_requests.empty() == false; });
+			if (m_stopping)
+				break;
+
+			Loaded loaded;
+			loaded.request = m_requests.front();
+			m_requests.pop_front();
+			if (m_buffers.empty() == false)
+			{
+				loaded.texels = std::move(m_buffers.back());
+				m_buffers.pop_back();
+			}
+			lock.unlock();
+
+			// The textures are only added to and removed on the main thread
+			//	while nothing is queued for them, so the pointer is safe
+			//	to read without the lock.
+			loaded.texels.resize(VirtualTexture::PAGE_BYTES);
+			const VirtualTexture& texture = *m_textures[loaded.request.texture];
+			loaded.valid = texture.readPage(loaded.request.page, loaded.texels.data());
+			if (loaded.valid == false)
+				printf("VirtualTextureCache: page %u of %s is damaged.\n", loaded.request.page,
+					texture.getFilename().c_str());
+
+			lock.lock();
+			m_loaded.push_back(std::move(loaded));
+		}
+	}
+
+	/**
+		destroy stops the thread and deletes the textures and the pages.
+	*/
+	void VirtualTextureCache::destroy()
+	{
+		if (m_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+			}
+			m_wake.notify_one();
+			m_thread.join();
+		}
+		m_requests.clear();
+		m_loaded.clear();
+		m_buffers.clear();
+		m_uploads.clear();
+		m_textures.clear();
+
+		RenderState& state = RenderState::instance();
+		GpuMemory& memory = GpuMemory::instance();
+		unsigned int textures[] = { m_cache, m_feedbackTexture, m_feedbackDepth };
+		for (unsigned int texture : textures)
+		{
+			if (texture == 0)
+				continue;
+			glDeleteTextures(1, &texture);
+			state.onTextureDeleted(texture);
+			memory.releaseTexture(texture);
+		}
+		glDeleteFramebuffers(1, &m_feedbackFramebuffer);
+		m_cache = m_feedbackTexture = m_feedbackDepth = m_feedbackFramebuffer = 0;
+		m_slots.clear();
+		m_freeSlots.clear();
+		m_sparse = false;
+
+		// A feedback still being read back is dropped when nothing is
+		//	created, so the next create can draw one.
+		m_feedbackPending = false;
+		m_stats = {};
+	}
+}
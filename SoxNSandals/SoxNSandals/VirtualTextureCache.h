@@ -0,0 +1,293 @@
+/**
+	VirtualTextureCache.h
+
+	Purpose: VirtualTextureCache.h is the header file for the
+			VirtualTextureCache class. The VirtualTextureCache keeps the
+			pages of every VirtualTexture that have been seen in one
+			texture of a fixed size, loading them on a thread of its own
+			from what a low resolution feedback pass says is drawn.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "Shader.h"
+#include "VirtualTexture.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sns
+{
+	/**
+		The VirtualTextureCache class owns the physical cache, a square
+			texture of slots of a page each, which is all
+			the memory the virtual textures take on the gpu whatever
+			their size. Each page is loaded into the slot least recently
+			drawn from, and the coarsest page of each texture is kept
+			for good, so there is always something to fall back to.
+
+		Where ARB_sparse_texture has a page size that slots are a multiple
+			of, the cache is a sparse texture and each slot is committed
+			the first time it is filled, so the footprint is only reached
+			once the cache is full.
+
+		What is drawn is found by the feedback pass, the virtually
+			textured meshes drawn between beginFeedback and endFeedback
+			into an R32UI target FEEDBACK_DIVISOR times smaller than the
+			view, each texel the texture, level and page it needs. It is
+			read back through the GpuReadback, one pass in flight at a
+			time, and every page it names that isn't resident is queued
+			for the loader thread, coarsest first, along with the pages
+			above it. The thread only reads the page files, through
+			VirtualTexture::readPage, and update uploads at most
+			MAX_UPLOADS of what it has read each frame, on the context
+			thread.
+
+		A mesh picks its texture with the w of its ObjectBuffer material,
+			the texture's index plus one, see virtualTexture.glsl.
+	*/
+	class VirtualTextureCache
+	{
+	public:
+		// How many textures can be drawn from at once, the shaders have a
+		//	page table sampler each.
+		static const unsigned int MAX_TEXTURES = 4;
+
+		// What add returns when a texture can't be added.
+		static const unsigned int NO_TEXTURE = 0xffffffff;
+
+		// Slots in each direction until create is told otherwise, 4096
+		//	texels, 64 megabytes.
+		static const unsigned int DEFAULT_SLOTS_PER_SIDE = 32;
+
+		// How much smaller than the view the feedback is drawn.
+		static const unsigned int FEEDBACK_DIVISOR = 8;
+
+		// Pages uploaded a frame at most, a megabyte.
+		static const unsigned int MAX_UPLOADS = 16;
+
+		// Pages waiting for the thread at most, later requests wait for
+		//	the next feedback.
+		static const unsigned int MAX_QUEUED = 64;
+
+		// The cache's texture unit, and the first of the page tables'.
+		static const unsigned int CACHE_UNIT = 26;
+		static const unsigned int PAGE_TABLE_UNIT = 27;
+
+		/**
+			What the cache holds and did in the last update.
+		*/
+		struct Stats
+		{
+			unsigned int residentPages;
+			unsigned int slots;
+
+			// Distinct pages the last feedback named.
+			unsigned int feedbackPages;
+			unsigned int queuedPages;
+			unsigned int uploads;
+			unsigned int evictions;
+
+			// Pages read with every slot drawn from since the feedback.
+			unsigned int starved;
+			unsigned long long committedBytes;
+		};
+
+		VirtualTextureCache();
+
+		/**
+			The deconstructor stops the thread and deletes the textures,
+				see destroy.
+		*/
+		~VirtualTextureCache();
+
+		VirtualTextureCache(const VirtualTextureCache&) = delete;
+		VirtualTextureCache& operator=(const VirtualTextureCache&) = delete;
+
+		/**
+			create makes the cache and feedback target, loads the feedback
+				shader and starts the loader thread.
+
+				@param1 a_width is the width of the view the feedback is
+						drawn for.
+
+				@param2 a_height is its height.
+
+				@param3 a_slotsPerSide is how many slots the cache has in
+						each direction, at most 256.
+
+				@return false without GL 4.5 or the shader, the cache is
+						left uncreated.
+		*/
+		bool create(int a_width, int a_height, unsigned int a_slotsPerSide = DEFAULT_SLOTS_PER_SIDE);
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_cache != 0; }
+
+		/**
+			add loads a page file and queues its coarsest page.
+
+				@param1 a_filename is the path of the page file. A file
+						already added is only added once.
+
+				@return its index, or NO_TEXTURE if it can't be loaded or
+						MAX_TEXTURES already are.
+		*/
+		unsigned int add(const char* a_filename);
+
+		/**
+			getTextureCount returns how many textures have been added.
+		*/
+		unsigned int getTextureCount() const { return (unsigned int)m_textures.size(); }
+
+		/**
+			beginFeedback binds and clears the feedback target and binds
+				the feedback shader, unless the last feedback is still
+				being read back. The meshes are drawn after it with
+				their ObjectBuffer objects selected.
+
+				@param1 a_viewHeight is the height of the view the meshes
+						are drawn with, the level wanted is for it.
+
+				@return false if nothing is to be drawn this frame.
+		*/
+		bool beginFeedback(int a_viewHeight);
+
+		/**
+			endFeedback puts back the framebuffer and viewport and reads
+				the feedback back.
+		*/
+		void endFeedback();
+
+		/**
+			update uploads the pages the thread has read, evicting those
+				drawn from the longest ago, and rebuilds the page tables
+				that changed. Called once a frame, before drawing.
+		*/
+		void update();
+
+		/**
+			bind binds the cache and page tables to their units, and
+				points a program's samplers at them if it has them.
+
+				@param1 a_program is the program, which must be bound.
+		*/
+		void bind(aie::ShaderProgram& a_program) const;
+
+		/**
+			destroy stops the thread and deletes the textures and the
+				pages.
+		*/
+		void destroy();
+
+		/**
+			isSparse returns whether the cache is a sparse texture.
+		*/
+		bool isSparse() const { return m_sparse; }
+
+		/**
+			getStats returns what the cache held and did.
+		*/
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		/**
+			A slot of the cache, free while texture is NO_TEXTURE.
+		*/
+		struct Slot
+		{
+			unsigned int texture;
+			unsigned int page;
+
+			// The frame feedback last said it was drawn from.
+			unsigned int lastUsed;
+
+			// Holds a coarsest page, never evicted.
+			bool pinned;
+
+			// Whether its sparse pages are committed yet.
+			bool committed;
+		};
+
+		/**
+			A page for the thread to read.
+		*/
+		struct Request
+		{
+			unsigned int texture;
+			unsigned int page;
+			unsigned int level;
+		};
+
+		/**
+			A page the thread has read, valid unless it was damaged.
+		*/
+		struct Loaded
+		{
+			Request request;
+			bool valid;
+			std::vector<unsigned char> texels;
+		};
+
+		// What the thread runs, reading pages until destroy.
+		void run();
+
+		// Touches the resident pages a feedback texel falls back to, and
+		//	wants those that aren't.
+		void onFeedback(const void* a_data, size_t a_size);
+
+		// Queues what onFeedback wanted, coarsest first.
+		void queueWanted();
+
+		// Finds a free slot or evicts one, NO_SLOT if every slot was drawn
+		//	from since the last feedback.
+		unsigned int allocateSlot();
+
+		std::vector<std::unique_ptr<VirtualTexture>> m_textures;
+
+		// lit.vert with the virtual texture's index, and virtualFeedback.frag.
+		aie::ShaderProgram m_feedbackShader;
+
+		unsigned int m_cache;
+		unsigned int m_slotsPerSide;
+		bool m_sparse;
+		std::vector<Slot> m_slots;
+		std::vector<unsigned int> m_freeSlots;
+
+		unsigned int m_feedbackFramebuffer;
+		unsigned int m_feedbackTexture;
+		unsigned int m_feedbackDepth;
+		int m_feedbackWidth;
+		int m_feedbackHeight;
+		bool m_feedbackPending;
+		unsigned int m_frame;
+
+		// The framebuffer and viewport bound before beginFeedback.
+		int m_previousFramebuffer;
+		int m_previousViewport[4];
+
+		// Kept between feedbacks for their memory.
+		std::vector<unsigned int> m_feedback;
+		std::vector<Request> m_wanted;
+		std::deque<Loaded> m_uploads;
+
+		std::thread m_thread;
+
+		// Guards everything below.
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::deque<Request> m_requests;
+		std::deque<Loaded> m_loaded;
+
+		// Page buffers to be read into again.
+		std::vector<std::vector<unsigned char>> m_buffers;
+		bool m_stopping;
+
+		Stats m_stats;
+	};
+}
@@ -0,0 +1,236 @@
+/**
+	VolumetricFog.cpp
+
+	Purpose: VolumetricFog.cpp is the source file for the VolumetricFog
+			class. The VolumetricFog lights the air between the camera
+			and the scene in a coarse grid of froxels, so the sun and
+			the clustered lights scatter through it, for the same cost
+			whatever the scene draws.
+
+	@author Nathan Nette
+*/
+#include "VolumetricFog.h"
+#include "GpuMemory.h"
+#include "ShadowAtlas.h"
+#include "ShadowCascades.h"
+#include "gl_core_4_5.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cstdio>
+
+namespace sns
+{
+	// Must match local_size in the shaders.
+	static const unsigned int GROUP_SIZE = 8;
+
+	// The unit the inject pass reads last frame's froxels from, and the
+	//	unit the integrate pass reads this frame's from.
+	static const unsigned int HISTORY_UNIT = 0;
+
+	// Froxels only ever hold light and extinction to blend, half floats
+	//	are plenty.
+	static const unsigned int FORMAT = GL_RGBA16F;
+
+	// How many depths through its froxel each is lit at before they
+	//	repeat.
+	static const unsigned int JITTER_FRAMES = 8;
+
+	VolumetricFog::VolumetricFog()
+		: m_current(0),
+		m_previousProjectionView(1.0f),
+		m_hasHistory(false),
+		m_frame(0),
+		m_enabled(true),
+		m_settings({ 0.001f, 0.003f, 0.0f, glm::vec3(0.9f), 0.3f, 0.9f })
+	{
+	}
+
+	/**
+		create makes the froxel textures and loads the shaders.
+
+			@return false without GL 4.3 or the shaders, it is left
+					uncreated.
+	*/
+	bool VolumetricFog::create()
+	{
+		if (isCreated())
+			return true;
+		if (ogl_IsVersionGEQ(4, 3) == 0)
+		{
+			printf("VolumetricFog: volumetric fog needs GL 4.3.\n");
+			return false;
+		}
+
+		m_injectShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/fogInject.comp");
+		if (m_injectShader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_injectShader.getLastError());
+			return false;
+		}
+		m_integrateShader.loadShader(aie::eShaderStage::COMPUTE, "../shaders/fogIntegrate.comp");
+		if (m_integrateShader.link() == false)
+		{
+			printf("Shader Error: %s\n", m_integrateShader.getLastError());
+			return false;
+		}
+
+		// Filtered between froxels, and clamped so a fragment past the
+		//	last slice reads the last.
+		GpuMemory& memory = GpuMemory::instance();
+		unsigned long long bytes = GpuMemory::getTextureBytes(FORMAT, FROXELS_X, FROXELS_Y, FROXELS_Z);
+		TextureHandle* textures[3] = { &m_froxels[0], &m_froxels[1], &m_integrated };
+		for (TextureHandle* texture : textures)
+		{
+			glCreateTextures(GL_TEXTURE_3D, 1, texture->put());
+			glTextureStorage3D(*texture, 1, FORMAT, FROXELS_X, FROXELS_Y, FROXELS_Z);
+			glTextureParameteri(*texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			memory.trackTexture(*texture, bytes, GpuMemory::LIGHTING, "VolumetricFog");
+		}
+		m_hasHistory = false;
+		return true;
+	}
+
+	/**
+		update lights the froxels for a camera and adds them up. Each
+			froxel is lit at a depth jittered through it and blended
+			with where it was last frame, then each column is added up
+			front to back.
+
+			@param1 a_lights is the clustered lights, binned for the
+					camera.
+
+			@param2 a_shadows is the sun's shadow cascades.
+
+			@param3 a_atlas is the clustered lights' shadows.
+
+			@param4 a_view is the camera's view.
+
+			@param5 a_projection is the camera's perspective projection.
+
+			@param6 a_nearPlane is the near plane the clusters were binned
+					with.
+
+			@param7 a_farPlane is the far plane they were binned with,
+					which the fog reaches to.
+
+			@param8 a_reproject is whether last frame's froxels were lit
+					for this camera, and can be blended in.
+	*/
+	void VolumetricFog::update(const LightClusters& a_lights, const ShadowCascades& a_shadows,
+		const ShadowAtlas& a_atlas, const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, float a_farPlane, bool a_reproject)
+	{
+		static constexpr aie::UniformHandle INVERSE_VIEW("InverseView");
+		static constexpr aie::UniformHandle INVERSE_PROJECTION("InverseProjection");
+		static constexpr aie::UniformHandle PREVIOUS_PROJECTION_VIEW("PreviousProjectionView");
+		static constexpr aie::UniformHandle NEAR_PLANE("Near");
+		static constexpr aie::UniformHandle FAR_PLANE("Far");
+		static constexpr aie::UniformHandle JITTER("Jitter");
+		static constexpr aie::UniformHandle HISTORY("History");
+		static constexpr aie::UniformHandle HISTORY_WEIGHT("HistoryWeight");
+		static constexpr aie::UniformHandle DENSITY("Density");
+		static constexpr aie::UniformHandle HEIGHT_FALLOFF("HeightFalloff");
+		static constexpr aie::UniformHandle BASE_HEIGHT("BaseHeight");
+		static constexpr aie::UniformHandle ALBEDO("Albedo");
+		static constexpr aie::UniformHandle ANISOTROPY("Anisotropy");
+		static constexpr aie::UniformHandle FROXELS("Froxels");
+
+		if (isEnabled() == false)
+			return;
+
+		// The history is read where it was written last frame, and this
+		//	frame's froxels go in the other texture.
+		unsigned int previous = m_current;
+		m_current = 1 - m_current;
+		bool reproject = a_reproject && m_hasHistory;
+
+		// Every depth through the froxel is lit once in JITTER_FRAMES,
+		//	in an order that spreads each few of them out.
+		static const float JITTER_DEPTHS[JITTER_FRAMES] = { 0.5f, 0.25f, 0.75f, 0.125f, 0.625f, 0.375f, 0.875f, 0.0625f };
+		float jitter = JITTER_DEPTHS[m_frame++ % JITTER_FRAMES];
+
+		glm::mat4 projectionView = a_projection * a_view;
+		m_injectShader.bind();
+		m_injectShader.bindUniform(INVERSE_VIEW, glm::inverse(a_view));
+		m_injectShader.bindUniform(INVERSE_PROJECTION, glm::inverse(a_projection));
+		m_injectShader.bindUniform(PREVIOUS_PROJECTION_VIEW, m_previousProjectionView);
+		m_injectShader.bindUniform(NEAR_PLANE, a_nearPlane);
+		m_injectShader.bindUniform(FAR_PLANE, a_farPlane);
+		m_injectShader.bindUniform(JITTER, jitter);
+		m_injectShader.bindUniform(HISTORY, (int)HISTORY_UNIT);
+		m_injectShader.bindUniform(HISTORY_WEIGHT, reproject ? m_settings.history : 0.0f);
+		m_injectShader.bindUniform(DENSITY, m_settings.density);
+		m_injectShader.bindUniform(HEIGHT_FALLOFF, m_settings.heightFalloff);
+		m_injectShader.bindUniform(BASE_HEIGHT, m_settings.baseHeight);
+		m_injectShader.bindUniform(ALBEDO, m_settings.albedo);
+		m_injectShader.bindUniform(ANISOTROPY, m_settings.anisotropy);
+		a_lights.bind(m_injectShader);
+		a_shadows.bind(m_injectShader);
+		a_atlas.bind(m_injectShader);
+		glBindTextureUnit(HISTORY_UNIT, m_froxels[previous]);
+		glBindImageTexture(0, m_froxels[m_current], 0, GL_TRUE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute((FROXELS_X + GROUP_SIZE - 1) / GROUP_SIZE, (FROXELS_Y + GROUP_SIZE - 1) / GROUP_SIZE,
+			FROXELS_Z);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		m_integrateShader.bind();
+		m_integrateShader.bindUniform(INVERSE_PROJECTION, glm::inverse(a_projection));
+		m_integrateShader.bindUniform(NEAR_PLANE, a_nearPlane);
+		m_integrateShader.bindUniform(FAR_PLANE, a_farPlane);
+		m_integrateShader.bindUniform(FROXELS, (int)HISTORY_UNIT);
+		glBindTextureUnit(HISTORY_UNIT, m_froxels[m_current]);
+		glBindImageTexture(0, m_integrated, 0, GL_TRUE, 0, GL_WRITE_ONLY, FORMAT);
+		glDispatchCompute((FROXELS_X + GROUP_SIZE - 1) / GROUP_SIZE, (FROXELS_Y + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+		// The shading passes read it as a texture.
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		m_previousProjectionView = projectionView;
+		m_hasHistory = true;
+	}
+
+	/**
+		getParameters returns what the frame uniforms tell shaders to read
+			the fog with. A cluster slice over CLUSTERS_Z is a texture
+			coordinate through the froxels, and each texel holds the fog
+			to its far side, so the coordinate is moved back half one.
+	*/
+	glm::vec4 VolumetricFog::getParameters() const
+	{
+		if (isEnabled() == false || m_hasHistory == false)
+			return glm::vec4(0.0f);
+		return glm::vec4(1.0f / LightClusters::CLUSTERS_Z, -0.5f / FROXELS_Z, 0.0f, 1.0f);
+	}
+
+	/**
+		bind binds the fog to VOLUME_UNIT, and points a program's sampler
+			at it if it has one.
+
+			@param1 a_program is the program, which must be bound.
+	*/
+	void VolumetricFog::bind(aie::ShaderProgram& a_program) const
+	{
+		static constexpr aie::UniformHandle FOG_VOLUME("FogVolume");
+
+		// The sampler is pointed at its unit even without fog, as a 3D
+		//	sampler left on a material's unit can't be drawn with.
+		if (isCreated())
+			glBindTextureUnit(VOLUME_UNIT, m_integrated);
+		a_program.bindUniform(FOG_VOLUME, (int)VOLUME_UNIT);
+	}
+
+	/**
+		setEnabled sets whether there is fog. Turned back on, the history
+			starts again.
+
+			@param1 a_enabled is whether there is fog.
+	*/
+	void VolumetricFog::setEnabled(bool a_enabled)
+	{
+		if (a_enabled && m_enabled == false)
+			m_hasHistory = false;
+		m_enabled = a_enabled;
+	}
+}
@@ -0,0 +1,196 @@
+/**
+	VolumetricFog.h
+
+	Purpose: VolumetricFog.h is the header file for the VolumetricFog
+			class. The VolumetricFog lights the air between the camera
+			and the scene in a coarse grid of froxels, so the sun and
+			the clustered lights scatter through it, for the same cost
+			whatever the scene draws.
+
+	@author Nathan Nette
+*/
+#pragma once
+#include "GpuHandle.h"
+#include "LightClusters.h"
+#include "Shader.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace sns
+{
+	class ShadowAtlas;
+	class ShadowCascades;
+
+	/**
+		The VolumetricFog class fills a 3D texture of froxels, each a
+			box of the view the way the LightClusters' clusters are, with
+			the light the fog in it scatters towards the camera and how
+			much it hides what is behind it.
+
+		The grid is the clusters' split finer, FROXELS_PER_CLUSTER_XY
+			froxels across and down a cluster and FROXELS_PER_CLUSTER_Z
+			deep, with the same exponential slices. So each froxel is in
+			exactly one cluster, and loops over that cluster's lights
+			without binning them again.
+
+		The first pass finds each froxel's fog and lights it by the
+			sun, shadowed by its cascades, the ambient and the clustered
+			lights, at a depth jittered through the froxel each frame.
+			It is blended with the froxel's own history, reprojected
+			from where the camera was last frame, so the jitter averages
+			out over frames instead of banding. The second pass walks
+			each column front to back, adding up the scattered light
+			and multiplying out the transmittance, so each texel holds
+			all of the fog from the camera to its far side.
+
+		Shaders apply it through lighting.glsl's applyFog, reading it at
+			their depth, which needs the frame uniforms' fog parameters
+			and bind. Needs GL 4.3, without it create fails and nothing
+			is fogged.
+	*/
+	class VolumetricFog
+	{
+	public:
+		// How many froxels across, down and deep a cluster is split into.
+		static const unsigned int FROXELS_PER_CLUSTER_XY = 10;
+		static const unsigned int FROXELS_PER_CLUSTER_Z = 2;
+
+		static const unsigned int FROXELS_X = LightClusters::CLUSTERS_X * FROXELS_PER_CLUSTER_XY;
+		static const unsigned int FROXELS_Y = LightClusters::CLUSTERS_Y * FROXELS_PER_CLUSTER_XY;
+		static const unsigned int FROXELS_Z = LightClusters::CLUSTERS_Z * FROXELS_PER_CLUSTER_Z;
+
+		// The texture unit shaders read the fog from, past the ones
+		//	everything else reserves.
+		static const unsigned int VOLUME_UNIT = 18;
+
+		/**
+			What the fog is like.
+		*/
+		struct Settings
+		{
+			// How much of the light crossing a world unit of fog at the
+			//	base height it takes out.
+			float density;
+
+			// How quickly the fog thins above the base height, per world
+			//	unit. Below it the fog is as thick as at it.
+			float heightFalloff;
+			float baseHeight;
+
+			// How much of what the fog takes out it scatters, rather than
+			//	absorbs.
+			glm::vec3 albedo;
+
+			// How much more of the light goes on forwards than back, from
+			//	-1 to 1, 0 the same every way.
+			float anisotropy;
+
+			// How much of each froxel is kept from last frame, from 0 to
+			//	below 1.
+			float history;
+		};
+
+		VolumetricFog();
+
+		VolumetricFog(const VolumetricFog&) = delete;
+		VolumetricFog& operator=(const VolumetricFog&) = delete;
+
+		/**
+			create makes the froxel textures and loads the shaders.
+
+				@return false without GL 4.3 or the shaders, it is left
+						uncreated.
+		*/
+		bool create();
+
+		/**
+			isCreated returns whether create succeeded.
+		*/
+		bool isCreated() const { return m_integrated != 0; }
+
+		/**
+			update lights the froxels for a camera and adds them up.
+				The clusters must already be binned for it, and the
+				frame uniforms written for its view.
+
+				@param1 a_lights is the clustered lights.
+
+				@param2 a_shadows is the sun's shadow cascades.
+
+				@param3 a_atlas is the clustered lights' shadows.
+
+				@param4 a_view is the camera's view.
+
+				@param5 a_projection is the camera's perspective
+						projection.
+
+				@param6 a_nearPlane is the near plane the clusters were
+						binned with.
+
+				@param7 a_farPlane is the far plane they were binned
+						with, which the fog reaches to.
+
+				@param8 a_reproject is whether last frame's froxels were
+						lit for this camera, and can be blended in.
+		*/
+		void update(const LightClusters& a_lights, const ShadowCascades& a_shadows, const ShadowAtlas& a_atlas,
+			const glm::mat4& a_view, const glm::mat4& a_projection, float a_nearPlane, float a_farPlane, bool a_reproject);
+
+		/**
+			getParameters returns what the frame uniforms tell shaders to
+				read the fog with: x turns a cluster slice into a texture
+				coordinate, y moves it back to the froxel's far side, and
+				w is 0 when there is no fog.
+		*/
+		glm::vec4 getParameters() const;
+
+		/**
+			bind binds the fog to VOLUME_UNIT, and points a program's
+				sampler at it if it has one.
+
+				@param1 a_program is the program, which must be bound.
+		*/
+		void bind(aie::ShaderProgram& a_program) const;
+
+		/**
+			setEnabled sets whether there is fog. Turned back on, the
+				history starts again.
+
+				@param1 a_enabled is whether there is fog.
+		*/
+		void setEnabled(bool a_enabled);
+
+		/**
+			isEnabled returns whether there is fog, and it is created.
+		*/
+		bool isEnabled() const { return m_enabled && isCreated(); }
+
+		/**
+			getSettings returns what the fog is like.
+		*/
+		Settings& getSettings() { return m_settings; }
+		const Settings& getSettings() const { return m_settings; }
+
+	private:
+		aie::ShaderProgram m_injectShader;
+		aie::ShaderProgram m_integrateShader;
+
+		// Each froxel's scattered light and extinction, this frame's and
+		//	last's in turn, and what they add up to from the camera.
+		TextureHandle m_froxels[2];
+		TextureHandle m_integrated;
+		unsigned int m_current;
+
+		// The camera last frame's froxels were lit from, and whether
+		//	they were.
+		glm::mat4 m_previousProjectionView;
+		bool m_hasHistory;
+
+		// Which of the jittered depths this frame lights.
+		unsigned int m_frame;
+
+		bool m_enabled;
+		Settings m_settings;
+	};
+}
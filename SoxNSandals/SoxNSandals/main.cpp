@@ -15,25 +15,440 @@
 #include <ext.hpp>
 #include "soxCore.h"
 #include "Application.h"
+#include "TextureConverter.h"
+#include "AssetPacker.h"
+#include "VirtualTexture.h"
+#include "SdfFont.h"
+#include "FileSystem.h"
+#include "GpuMemory.h"
+#include "ParticleBenchmark.h"
+#include "MicroBenchmark.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+#include "StartupTimeline.h"
+#include "Config.h"
 #include <crtdbg.h>
+#include <cstdlib>
+#include <cstring>
 
 /**
 	main is the beginning and the end of the application.
 		Every bit of the application is called through this
 		function.
+
+		@param1 argc is the amount of command line arguments.
+
+		@param2 argv is the command line arguments. Running with
+				"--convert-textures a.obj b.obj" converts the
+				textures of each OBJ into dds files and exits
+				without opening a window. Running with
+				"--particle-bench [count] [frames]" times the
+				particle update paths and exits. Running with
+				"--micro-bench [filter] [results.json]" times the
+				engine's hot paths whose names contain the filter,
+				all of them for "", and exits. Running with
+				"--profile [trace.json]" records every frame with
+				the profiler and writes the last of them as a
+				Chrome trace once the window closes. Running with
+				"--benchmark [frames] [results.json] [path.txt]"
+				flies the camera along a path instead, and writes
+				the frame times as JSON. Ending it with "--deferred"
+				benchmarks deferred shading, with "--prepass"
+				forward shading with a depth pre-pass, with
+				"--ssao" as well ambient occlusion from the
+				pre-pass, with "--temporal" the scene temporally
+				upsampled, and with
+				"--replay recording" runs the frames of a recording
+				instead of the path, with "--aa mode" anti-aliases
+				with "none", "fxaa", "msaa" or "taa", with
+				"--no-bloom" without the bloom, and with
+				"--scene name" adds what a regression scene adds to
+				the courtyard.
+				Running with
+				"--regression baseline.txt [frames] [--update-baseline]"
+				benchmarks every scene, "sponza", "stanford",
+				"particles" and "gizmos", for 600 frames each unless
+				told otherwise, and exits with 1 if any is slower
+				than the baseline allows, or writes this run as the
+				baseline with --update-baseline. Running with
+				"--render-frames frames directory [path.txt] [encoders]"
+				draws that many frames along a path without showing
+				the window and writes each into the directory as a
+				TGA, encoded on that many threads. Running with
+				"--present mode [rate]" presents with "vsync",
+				"adaptive", "uncapped" or "capped" to the rate,
+				60 if it isn't given. Ending a run with "--monitors"
+				opens the window across every monitor, with a view
+				on each turned to make one view around the camera,
+				and with "--texture-budget megabytes" keeps the
+				streamed scene textures inside that much video
+				memory, a gigabyte if it isn't given, and with
+				"--gpu-budget megabytes" warns when everything the
+				engine has allocated on the gpu goes over that much,
+				and with "--record recording" records every frame
+				from once loading finishes for --replay, and with
+				"--stream file" encodes every frame on the gpu's
+				video encoder into a file or pipe as H.264, at
+				"--stream-bitrate kilobits" a second if given
+				after it, and with "--stream-quality" after it
+				tuned for quality over latency, and with "--idle"
+				sleeps until there is input while nothing on
+				screen changes, and with "--control-panel" draws
+				the hud in a window of its own, and with
+				"--mapped-scans" parses the Stanford scans straight
+				into mapped buffers.
+				Running with
+				"--compile-scene scene.json scene.snsscene" compiles
+				a scene to the binary form that loads without being
+				parsed, and exits. Running with
+				"--build-virtual-texture image.png out.snsvt" cuts
+				an image into the pages of a virtual texture, see
+				sns::VirtualTexture, and exits. Running with
+				"--build-font sheet.png out.snsfont [size] [--monospace]"
+				builds a distance field font of a sheet of glyphs,
+				size texels a line, see sns::SdfFont, and exits.
+				Ending any run that opens a
+				window with "--scene-file scene" draws that scene
+				instead of ../scenes/sponza.json, and with
+				"--telemetry host:port" streams what the profiler
+				records of every frame to a collector, see
+				sns::TelemetryStream, and with "--hud-font
+				font.snsfont" draws the debug hud's text in that
+				font. Running with
+				"--pack-assets archive.snspak [--store] a.obj b.vert"
+				packs the files, and everything each OBJ loads, into
+				an archive and exits, --store leaving them
+				uncompressed. Ending any run with "--archive file"
+				opens assets out of that archive first. Ending any
+				run that opens a window with "--config file" reads
+				its settings from a JSON file, see sns::Config, with
+				"--quality preset" starts from "low", "medium",
+				"high" or "ultra" over the file's costs, and with
+				"--resolution 1920x1080" opens a window that size. A
+				file with a "benchmark" benchmarks without
+				"--benchmark" being given.
 */
-int main()
+int main(int argc, char** argv)
 {
-	// Begin application with the resolution 1280, 720 and with the window name
-	//	SoxNSandals
-	auto app = new Application(glm::vec2(1280, 720), "SoxNSandals");
+	// Offline texture conversion doesn't need a window or GL context.
+	if (argc > 1 && strcmp(argv[1], "--convert-textures") == 0)
+	{
+		int failures = 0;
+		for (int i = 2; i < argc; ++i)
+			failures += sns::TextureConverter::convertMaterials(argv[i]);
+
+		printf("%d textures failed to convert\n", failures);
+		return failures > 0 ? 1 : 0;
+	}
+
+	// Nor does compiling a scene.
+	if (argc > 3 && strcmp(argv[1], "--compile-scene") == 0)
+	{
+		sns::SceneDescription scene;
+		return scene.load(argv[2]) && scene.write(argv[3]) ? 0 : 1;
+	}
+
+	// Or cutting an image into a virtual texture's pages.
+	if (argc > 3 && strcmp(argv[1], "--build-virtual-texture") == 0)
+		return sns::VirtualTexture::build(argv[2], argv[3]) ? 0 : 1;
+	if (argc > 3 && strcmp(argv[1], "--build-font") == 0)
+	{
+		bool monospace = strcmp(argv[argc - 1], "--monospace") == 0;
+		int sizeArgument = monospace ? argc - 1 : argc;
+		unsigned int glyphSize = sizeArgument > 4 ? (unsigned int)atoi(argv[4]) : 32;
+		return sns::SdfFont::build(argv[2], argv[3], glyphSize, monospace) ? 0 : 1;
+	}
+
+	// Packing assets doesn't need one either.
+	if (argc > 2 && strcmp(argv[1], "--pack-assets") == 0)
+	{
+		bool compress = true;
+		std::vector<std::string> files;
+		for (int i = 3; i < argc; ++i)
+		{
+			if (strcmp(argv[i], "--store") == 0)
+				compress = false;
+			else
+				sns::AssetPacker::gatherFiles(argv[i], files);
+		}
+		return sns::AssetPacker::pack(argv[2], files, compress) ? 0 : 1;
+	}
+
+	// So does the particle benchmark, it only times the cpu update.
+	if (argc > 1 && strcmp(argv[1], "--particle-bench") == 0)
+	{
+		unsigned int particles = argc > 2 ? (unsigned int)atoi(argv[2]) : 1000000;
+		unsigned int frames = argc > 3 ? (unsigned int)atoi(argv[3]) : 60;
+		sns::ParticleBenchmark::run(particles, frames);
+		return 0;
+	}
+
+	// The micro benchmarks only need a hidden window for their GL context.
+	if (argc > 1 && strcmp(argv[1], "--micro-bench") == 0)
+	{
+		const char* filter = argc > 2 ? argv[2] : nullptr;
+		const char* output = argc > 3 ? argv[3] : nullptr;
+		return sns::MicroBenchmark::run(filter, output) ? 0 : 1;
+	}
+
+	// Time to the first frame is counted from here, past the tools that
+	//	never open a window.
+	sns::StartupTimeline::instance().start();
+
+	// Archives are mounted before anything can load from them.
+	for (; argc > 2 && strcmp(argv[argc - 2], "--archive") == 0; argc -= 2)
+		sns::FileSystem::instance().mount(argv[argc - 1]);
+
+	// Profiling is off unless asked for, the scopes cost next to nothing then.
+	const char* tracePath = nullptr;
+	if (argc > 1 && strcmp(argv[1], "--profile") == 0)
+	{
+		tracePath = argc > 2 ? argv[2] : "profile.json";
+		sns::Profiler::setEnabled(true);
+	}
+
+	// The settings are read from the file first, the flags change them
+	//	after, whichever order they were given in.
+	const char* configFile = nullptr;
+	const char* quality = nullptr;
+	const char* resolution = nullptr;
+	for (;;)
+	{
+		if (argc > 2 && strcmp(argv[argc - 2], "--config") == 0)
+			configFile = argv[argc - 1];
+		else if (argc > 2 && strcmp(argv[argc - 2], "--quality") == 0)
+			quality = argv[argc - 1];
+		else if (argc > 2 && strcmp(argv[argc - 2], "--resolution") == 0)
+			resolution = argv[argc - 1];
+		else
+			break;
+		argc -= 2;
+	}
+
+	sns::Config config;
+	if (configFile != nullptr)
+		config.load(configFile);
+	if (quality != nullptr)
+	{
+		sns::Quality preset;
+		if (sns::Config::findQuality(quality, preset))
+			config.setQuality(preset);
+		else
+			printf("Unknown quality %s\n", quality);
+	}
+	int width = 0, height = 0;
+	if (resolution != nullptr)
+	{
+		if (sscanf(resolution, "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+			config.resolution = glm::ivec2(width, height);
+		else
+			printf("Unknown resolution %s, it is given as 1920x1080\n", resolution);
+	}
+
+	// Begin application with the configured resolution and with the window
+	//	name SoxNSandals
+	auto app = new Application(glm::vec2(config.resolution), "SoxNSandals");
+	app->setConfig(config);
+
+	// Any mode can draw another scene, and stream its telemetry.
+	for (;;)
+	{
+		if (argc > 2 && strcmp(argv[argc - 2], "--scene-file") == 0)
+			app->setSceneFile(argv[argc - 1]);
+		else if (argc > 2 && strcmp(argv[argc - 2], "--telemetry") == 0)
+			app->setTelemetry(argv[argc - 1]);
+		else if (argc > 2 && strcmp(argv[argc - 2], "--hud-font") == 0)
+			app->setHudFont(argv[argc - 1]);
+		else
+			break;
+		argc -= 2;
+	}
 
 	// Call run inside the application class.
-	app->run();
+	//	The benchmark runs the same application without input.
+	int result = 0;
+	if (argc > 2 && strcmp(argv[1], "--regression") == 0)
+	{
+		bool update = false;
+		if (strcmp(argv[argc - 1], "--update-baseline") == 0)
+		{
+			update = true;
+			--argc;
+		}
+
+		unsigned int frames = argc > 3 ? (unsigned int)atoi(argv[3]) : 600;
+		result = app->regressionGate(argv[2], frames, update) == 0 ? 0 : 1;
+	}
+	else if (argc > 3 && strcmp(argv[1], "--render-frames") == 0)
+	{
+		const char* path = argc > 4 ? argv[4] : nullptr;
+		unsigned int encoders = argc > 5 ? (unsigned int)atoi(argv[5]) : 0;
+		result = app->renderFrames((unsigned int)atoi(argv[2]), argv[3], path, encoders) == 0 ? 0 : 1;
+	}
+	else if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		const char* replay = nullptr;
+		for (;;)
+		{
+			if (argc > 3 && strcmp(argv[argc - 2], "--replay") == 0)
+			{
+				replay = argv[argc - 1];
+				argc -= 2;
+			}
+			else if (argc > 3 && strcmp(argv[argc - 2], "--aa") == 0)
+			{
+				sns::AntiAliasing mode;
+				if (sns::PostProcess::findAntiAliasing(argv[argc - 1], mode))
+					app->setAntiAliasing(mode);
+				else
+					printf("Unknown anti-aliasing %s\n", argv[argc - 1]);
+				argc -= 2;
+			}
+			else if (argc > 3 && strcmp(argv[argc - 2], "--scene") == 0)
+			{
+				sns::BenchmarkScene scene;
+				if (sns::RegressionGate::findScene(argv[argc - 1], scene))
+					app->setBenchmarkScene(scene);
+				else
+					printf("Unknown scene %s\n", argv[argc - 1]);
+				argc -= 2;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 1], "--deferred") == 0)
+			{
+				app->setDeferredShading(true);
+				--argc;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 1], "--prepass") == 0)
+			{
+				app->setDepthPrepass(true);
+				--argc;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 1], "--ssao") == 0)
+			{
+				app->setAmbientOcclusion(true);
+				--argc;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 1], "--temporal") == 0)
+			{
+				app->setTemporalUpsampling(true);
+				--argc;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 1], "--no-bloom") == 0)
+			{
+				app->setBloom(false);
+				--argc;
+			}
+			else if (argc > 2 && strncmp(argv[argc - 1], "--", 2) == 0)
+				--argc;
+			else
+				break;
+		}
+
+		unsigned int frames = argc > 2 ? (unsigned int)atoi(argv[2]) : 1000;
+		const char* output = argc > 3 ? argv[3] : "benchmark.json";
+		const char* path = argc > 4 ? argv[4] : nullptr;
+		result = app->benchmark(frames, output, path, replay) == 0 ? 0 : 1;
+	}
+	else if (config.benchmark.enabled)
+	{
+		const char* path = config.benchmark.path.empty() ? nullptr : config.benchmark.path.c_str();
+		result = app->benchmark(config.benchmark.frames, config.benchmark.output.c_str(), path, nullptr) == 0 ? 0 : 1;
+	}
+	else
+	{
+		// Read from the end, so what follows --stream is read first.
+		sns::VideoEncoder::Settings stream;
+		for (;;)
+		{
+			if (argc > 1 && strcmp(argv[argc - 1], "--monitors") == 0)
+			{
+				app->setMonitorViews(true);
+				--argc;
+			}
+			else if (argc > 1 && strcmp(argv[argc - 1], "--idle") == 0)
+			{
+				app->setIdleWait(true);
+				--argc;
+			}
+			else if (argc > 1 && strcmp(argv[argc - 1], "--control-panel") == 0)
+			{
+				app->setControlPanel(true);
+				--argc;
+			}
+			else if (argc > 1 && strcmp(argv[argc - 1], "--mapped-scans") == 0)
+			{
+				app->setMappedScans(true);
+				--argc;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 2], "--texture-budget") == 0)
+			{
+				app->setTextureBudget((size_t)(atof(argv[argc - 1]) * 1024.0 * 1024.0));
+				argc -= 2;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 2], "--record") == 0)
+			{
+				app->setRecording(argv[argc - 1]);
+				argc -= 2;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 2], "--stream") == 0)
+			{
+				app->setVideoStream(argv[argc - 1], stream);
+				argc -= 2;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 2], "--stream-bitrate") == 0)
+			{
+				stream.bitrate = (unsigned int)atoi(argv[argc - 1]);
+				argc -= 2;
+			}
+			else if (argc > 1 && strcmp(argv[argc - 1], "--stream-quality") == 0)
+			{
+				stream.lowLatency = false;
+				--argc;
+			}
+			else if (argc > 2 && strcmp(argv[argc - 2], "--gpu-budget") == 0)
+			{
+				sns::GpuMemory::instance().setBudget((unsigned long long)(atof(argv[argc - 1]) * 1024.0 * 1024.0));
+				argc -= 2;
+			}
+			else
+				break;
+		}
+
+		if (argc > 2 && strcmp(argv[1], "--present") == 0)
+		{
+			sns::PresentMode mode = sns::PresentMode::VSYNC;
+			if (strcmp(argv[2], "adaptive") == 0)
+				mode = sns::PresentMode::ADAPTIVE;
+			else if (strcmp(argv[2], "uncapped") == 0)
+				mode = sns::PresentMode::UNCAPPED;
+			else if (strcmp(argv[2], "capped") == 0)
+				mode = sns::PresentMode::CAPPED;
+			else if (strcmp(argv[2], "vsync") != 0)
+				printf("Unknown present mode %s, using vsync\n", argv[2]);
+
+			double rate = argc > 3 ? atof(argv[3]) : 60.0;
+			app->setPresentMode(mode, rate > 0.0 ? rate : 60.0);
+		}
+		result = app->run();
+	}
+
+	// Along with the trace, report how busy each job worker was.
+	if (tracePath != nullptr)
+	{
+		sns::Profiler::writeChromeTrace(tracePath);
+
+		sns::JobSystem& jobs = sns::JobSystem::instance();
+		for (unsigned int i = 0; i < jobs.getWorkerCount(); ++i)
+		{
+			sns::JobSystem::WorkerStats stats = jobs.getWorkerStats(i);
+			printf("Job worker %u: %llu jobs, %llu stolen, %.1f%% busy\n",
+				i, stats.jobs, stats.steals, stats.utilisation * 100.0);
+		}
+	}
 
 	// Once the game loop is broken, delete the application.
 	delete app;
 
 	// End the process.
-	return 0;
+	return result;
 }
\ No newline at end of file
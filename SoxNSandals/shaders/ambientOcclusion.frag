@@ -0,0 +1,102 @@
+// Frag Shader
+#version 410
+
+// Estimates how much of the ambient light reaches every other pixel of
+//	the scene, see AmbientOcclusion. Each texel reads the depth at its
+//	pixel and a few around it on a spiral, turned by a different angle
+//	at each texel so the blur after averages the pattern away. A point
+//	in front of the surface and close to it occludes it.
+
+uniform sampler2D Depth;
+
+// Turns depth into distance, x / (depth * y + z), as the particle
+//	target does, and the depth of a pixel nothing was drawn at.
+uniform vec3 DepthRange;
+uniform float ClearDepth;
+
+// Turns ndc and distance into a view space position, (ndc + xy) * zw.
+uniform vec4 NdcToView;
+
+// How much of the depth was drawn into.
+uniform vec2 RenderSize;
+
+// How far around a point is looked at, in world units, and how many
+//	pixels across that is at a distance of 1.
+uniform float Radius;
+uniform float PixelRadius;
+
+// How dark the occlusion gets, 1 as usual.
+uniform float Intensity;
+
+// The occlusion, and the distance of the pixel it is for.
+out vec2 FragColour;
+
+const int SAMPLE_COUNT = 8;
+
+// Turns the spiral just under 7 times over its samples, so none line up.
+const float SPIRAL_TURNS = 7.0;
+
+// The most pixels a sample is taken from away, past which the depth
+//	is read too far apart to be cached.
+const float MAX_PIXEL_RADIUS = 64.0;
+
+vec3 positionAt(ivec2 pixel)
+{
+	float depth = texelFetch(Depth, pixel, 0).r;
+	float distance = DepthRange.x / max(depth * DepthRange.y + DepthRange.z, 1e-7);
+	vec2 ndc = (vec2(pixel) + 0.5) / RenderSize * 2.0 - 1.0;
+	return vec3((ndc + NdcToView.xy) * NdcToView.zw * distance, -distance);
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 pixel = texel * 2;
+	ivec2 last = ivec2(RenderSize) - 1;
+	float depth = texelFetch(Depth, pixel, 0).r;
+	if (depth == ClearDepth)
+	{
+		FragColour = vec2(1.0, 65504.0);
+		return;
+	}
+	vec3 position = positionAt(pixel);
+
+	// The normal from the neighbours on each axis whose depth is
+	//	closest, so it doesn't bend over an edge.
+	vec3 right = positionAt(min(pixel + ivec2(1, 0), last)) - position;
+	vec3 left = position - positionAt(max(pixel - ivec2(1, 0), ivec2(0)));
+	vec3 up = positionAt(min(pixel + ivec2(0, 1), last)) - position;
+	vec3 down = position - positionAt(max(pixel - ivec2(0, 1), ivec2(0)));
+	vec3 dx = abs(right.z) < abs(left.z) ? right : left;
+	vec3 dy = abs(up.z) < abs(down.z) ? up : down;
+	vec3 normal = normalize(cross(dx, dy));
+
+	float distance = -position.z;
+	float pixelRadius = min(PixelRadius / distance, MAX_PIXEL_RADIUS);
+	float radius2 = Radius * Radius;
+	float bias = 0.01 * distance;
+
+	// Hashed from the texel, the same each frame so it doesn't flicker.
+	float angle = float((3 * texel.x ^ texel.y) + texel.x * texel.y) * 10.0;
+
+	float occlusion = 0.0;
+	for (int i = 0; i < SAMPLE_COUNT; ++i)
+	{
+		float along = (float(i) + 0.5) / float(SAMPLE_COUNT);
+		float turn = along * SPIRAL_TURNS * 6.2831853 + angle;
+		vec2 offset = vec2(cos(turn), sin(turn)) * along * pixelRadius;
+		ivec2 samplePixel = clamp(pixel + ivec2(offset), ivec2(0), last);
+
+		vec3 toSample = positionAt(samplePixel) - position;
+		float lengthSquared = dot(toSample, toSample);
+		float facing = dot(toSample, normal);
+
+		// Falls to nothing at the radius, and for points only just above
+		//	the surface, which are the surface itself.
+		float falloff = max(radius2 - lengthSquared, 0.0);
+		occlusion += falloff * falloff * falloff * max((facing - bias) / (lengthSquared + 0.01), 0.0);
+	}
+
+	float scale = Intensity * 5.0 / (radius2 * radius2 * radius2 * float(SAMPLE_COUNT));
+	FragColour = vec2(max(0.0, 1.0 - occlusion * scale), distance);
+}
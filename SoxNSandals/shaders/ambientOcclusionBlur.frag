@@ -0,0 +1,40 @@
+// Frag Shader
+#version 410
+
+// Blurs the estimated occlusion over 4 by 4 texels, see
+//	AmbientOcclusion. Texels whose distance is far from this one's
+//	count less, so the occlusion doesn't spread across edges.
+
+uniform sampler2D Raw;
+
+// The last texel drawn into this frame.
+uniform vec2 LastTexel;
+
+// The occlusion, and the distance it is at.
+out vec2 FragColour;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 last = ivec2(LastTexel);
+	float distance = texelFetch(Raw, texel, 0).g;
+
+	float occlusion = 0.0;
+	float total = 0.0;
+	for (int y = -1; y <= 2; ++y)
+	{
+		for (int x = -1; x <= 2; ++x)
+		{
+			vec2 neighbour = texelFetch(Raw, clamp(texel + ivec2(x, y), ivec2(0), last), 0).rg;
+
+			// Relative, so the same edge counts as far off as it does close.
+			float difference = abs(neighbour.g - distance) / distance;
+			float weight = max(0.0, 1.0 - difference * 20.0);
+			occlusion += neighbour.r * weight;
+			total += weight;
+		}
+	}
+
+	// This texel always weighs 1, so total is never 0.
+	FragColour = vec2(occlusion / total, distance);
+}
@@ -0,0 +1,12 @@
+// material maps that may be in a page of the texture atlas (see TextureAtlas). each unit's rect is
+// where its map is in the page, the corner in xy and the size in zw, (0, 0, 1, 1) for a whole texture.
+// OBJMesh::bindMaterial sets them, programs drawn without it have whole textures
+uniform vec4 textureRects[8] = vec4[8]( vec4(0, 0, 1, 1), vec4(0, 0, 1, 1), vec4(0, 0, 1, 1), vec4(0, 0, 1, 1),
+                                        vec4(0, 0, 1, 1), vec4(0, 0, 1, 1), vec4(0, 0, 1, 1), vec4(0, 0, 1, 1) );
+
+// samples a map as GL_REPEAT would within its rect. the gradients come from the unwrapped uvs,
+// so the wrap doesn't pick the smallest level along its seam
+vec4 sampleMap(sampler2D map, int unit, vec2 uv) {
+vec4 rect = textureRects[unit];
+return textureGrad( map, rect.xy + fract(uv) * rect.zw, dFdx(uv) * rect.zw, dFdy(uv) * rect.zw );
+}
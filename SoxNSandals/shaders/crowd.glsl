@@ -0,0 +1,39 @@
+// a crowd's baked vertex animation (see Crowd), included by the vertex shaders that draw it.
+// each frame is a layer, a vertex's texel its index across rows of the texture's width
+uniform sampler2DArray CrowdPositions;
+uniform sampler2DArray CrowdNormals;
+uniform int CrowdFrames;
+uniform float CrowdTime;
+// SkinnedMesh::Vertex, 20 words, for the texcoord and tangent the frames don't hold
+layout(std430, binding = 0) readonly buffer CrowdSource {
+uint crowdSource[];
+};
+// filled from the crowd's instance buffer, the copy's transform then where it
+// starts in the clip and how many times a second it plays it
+layout( location = 4 ) in mat4 InstanceModel;
+layout( location = 8 ) in vec4 InstanceTiming;
+struct CrowdVertex {
+vec4 position;
+vec3 normal;
+vec2 texCoord;
+vec4 tangent;
+};
+// the vertex in the copy's space, blended between the frames either side of where it is in the clip
+CrowdVertex crowdVertex() {
+float frame = fract(InstanceTiming.x + CrowdTime * InstanceTiming.y) * float(CrowdFrames);
+int first = min(int(frame), CrowdFrames - 1);
+int second = (first + 1) % CrowdFrames;
+float blend = frame - float(first);
+int width = textureSize(CrowdPositions, 0).x;
+ivec2 texel = ivec2(gl_VertexID % width, gl_VertexID / width);
+CrowdVertex result;
+result.position = mix(texelFetch(CrowdPositions, ivec3(texel, first), 0),
+texelFetch(CrowdPositions, ivec3(texel, second), 0), blend);
+result.normal = mix(texelFetch(CrowdNormals, ivec3(texel, first), 0).xyz,
+texelFetch(CrowdNormals, ivec3(texel, second), 0).xyz, blend);
+uint word = uint(gl_VertexID) * 20;
+result.texCoord = uintBitsToFloat(uvec2(crowdSource[word + 8], crowdSource[word + 9]));
+result.tangent = uintBitsToFloat(uvec4(crowdSource[word + 10], crowdSource[word + 11],
+crowdSource[word + 12], crowdSource[word + 13]));
+return result;
+}
@@ -0,0 +1,21 @@
+// the crowd vertex shader, drawn with the lit.frag permutations (see Crowd). each
+// copy's vertices come from its clip's baked frames rather than a vertex buffer
+#version 430
+out vec2 vTexCoord;
+out vec3 vNormal;
+out vec3 vTangent;
+out vec3 vBiTangent;
+out vec4 vPosition;
+#include "frameData.glsl"
+#include "crowd.glsl"
+void main() {
+CrowdVertex crowd = crowdVertex();
+vTexCoord = crowd.texCoord;
+vPosition = InstanceModel * crowd.position;
+// copies are only rotated and uniformly scaled, so the model matrix can
+// transform the normal, the fragment shader normalises it
+vNormal = mat3(InstanceModel) * crowd.normal;
+vTangent = mat3(InstanceModel) * crowd.tangent.xyz;
+vBiTangent = cross(vNormal, vTangent) * crowd.tangent.w;
+gl_Position = ProjectionView * vPosition;
+}
@@ -0,0 +1,11 @@
+// a shadow map vertex shader for crowds (see Crowd), drawn from the light with depthAlpha.frag
+#version 430
+out vec2 vTexCoord;
+#include "crowd.glsl"
+// the light's projection view for the cascade
+uniform mat4 LightProjectionView;
+void main() {
+CrowdVertex crowd = crowdVertex();
+vTexCoord = crowd.texCoord;
+gl_Position = LightProjectionView * (InstanceModel * crowd.position);
+}
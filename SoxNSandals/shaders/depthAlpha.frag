@@ -0,0 +1,12 @@
+// a depth pre-pass fragment shader for alpha tested meshes, it only cuts their holes
+#version 410
+in vec2 vTexCoord;
+
+uniform sampler2D diffuseTexture;
+
+#include "atlas.glsl"
+
+void main() {
+if(sampleMap( diffuseTexture, 0, vTexCoord ).a < 0.5)
+discard;
+}
\ No newline at end of file
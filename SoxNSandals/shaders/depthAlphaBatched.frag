@@ -0,0 +1,12 @@
+// a depth pre-pass fragment shader for alpha tested meshes drawn by a MeshBatch, it only cuts their holes
+#version 410
+in vec2 vTexCoord;
+flat in vec4 vLayers;
+
+uniform sampler2DArray diffuseTexture;
+
+void main() {
+// a missing texture is opaque, like in the shading
+if(vLayers.x >= 0 && texture( diffuseTexture, vec3(vTexCoord, vLayers.x) ).a < 0.5)
+discard;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+// a depth only vertex shader for the occluders of a MeshBatch, drawn into a HiZBuffer
+#version 410
+layout( location = 0 ) in vec4 Position;
+// filled from the batch's instance buffer, picked by each command's base instance
+layout( location = 4 ) in mat4 InstanceModel;
+// per-frame camera and lights, shared by every program (see FrameUniforms)
+struct FrameLight {
+vec4 Ia; // light ambient
+vec4 Id; // light diffuse
+vec4 Is; // light specular
+vec4 LightDirection;
+};
+layout(std140) uniform FrameData {
+mat4 Projection;
+mat4 View;
+mat4 ProjectionView;
+vec4 CameraPosition;
+FrameLight Lights[2];
+};
+void main() {
+gl_Position = ProjectionView * (InstanceModel * Position);
+}
\ No newline at end of file
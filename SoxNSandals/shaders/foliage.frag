@@ -0,0 +1,39 @@
+// the fragment shader of the foliage's meshes (see Foliage). while a copy fades into its impostor
+// the fragments impostor.frag draws are cut out by the same dither, so every pixel is drawn by one
+// or the other and never blended
+#version 430
+in vec2 vTexCoord;
+in vec3 vNormal;
+in vec4 vPosition;
+in float vFade;
+
+out vec4 FragColour;
+
+uniform sampler2D diffuseTexture; // material diffuse texture
+uniform bool DiffuseMapped; // whether there is a texture, the flat diffuse colour alone without one
+uniform vec3 Kd; // material diffuse
+
+#include "frameData.glsl"
+#include "lighting.glsl"
+
+void main() {
+vec4 texDiffuse = DiffuseMapped ? texture(diffuseTexture, vTexCoord) : vec4(1);
+if (texDiffuse.a < 0.5)
+discard;
+
+// interleaved gradient noise, a different threshold at each pixel of a block
+float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+if (dither < vFade)
+discard;
+vec3 diffuseColour = Kd * texDiffuse.rgb;
+
+// leaves are seen from both sides, lit on the side facing the camera
+vec3 N = normalize(gl_FrontFacing ? vNormal : -vNormal);
+vec3 V = normalize(CameraPosition.xyz - vPosition.xyz);
+vec3 L = normalize(Lights[0].LightDirection.xyz);
+float lambertTerm = max(0, dot(N, -L));
+vec3 colour = Lights[0].Ia.xyz * diffuseColour * ambientOcclusion();
+colour += Lights[0].Id.xyz * diffuseColour * lambertTerm * cascadeShadow();
+colour += clusterLighting(N, V, diffuseColour, vec3(0), 1);
+FragColour = vec4(applyFog(colour), 1);
+}
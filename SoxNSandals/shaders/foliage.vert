@@ -0,0 +1,63 @@
+// the foliage's vertex shader (see Foliage), for the copies the cull kept. IMPOSTOR is defined to
+// 0 or 1:
+//   0  draws each copy as its mesh, with foliage.frag
+//   1  draws each copy as a card of its layer's impostor, with impostor.frag
+#version 430
+layout( location = 0 ) in vec4 Position;
+layout( location = 1 ) in vec4 Normal;
+layout( location = 2 ) in vec2 TexCoord;
+out vec2 vTexCoord;
+out float vFade;
+#if IMPOSTOR
+out vec4 vCardPosition;
+flat out mat3 vRotation;
+flat out vec3 vDepthAxis;
+#else
+out vec3 vNormal;
+out vec4 vPosition;
+#endif
+
+#include "frameData.glsl"
+#if IMPOSTOR
+#include "impostor.glsl"
+#endif
+
+// the copy's position and scale, and its turn about y as a cosine and sine
+struct Instance {
+vec4 positionScale;
+vec4 rotation;
+};
+layout(std430, binding = 0) readonly buffer Instances {
+Instance instances[];
+};
+// the copies the cull kept, the meshes' and then the impostors'
+layout(std430, binding = 1) readonly buffer Visible {
+uint visible[];
+};
+uniform int FirstVisible; // where this draw's list starts
+uniform vec2 FadeRange; // how far away copies start and finish turning into their impostors
+
+void main() {
+Instance instance = instances[visible[FirstVisible + gl_InstanceID]];
+vec3 origin = instance.positionScale.xyz;
+float scale = instance.positionScale.w;
+vec2 turn = instance.rotation.xy;
+mat3 rotation = mat3(turn.x, 0, -turn.y, 0, 1, 0, turn.y, 0, turn.x);
+#if IMPOSTOR
+// the card faces the frame nearest the camera as seen from the copy's own space
+vec3 centre = origin + rotation * ImpostorSphere.xyz * scale;
+vec3 view = normalize(transpose(rotation) * (CameraPosition.xyz - centre));
+vec3 frameDirection;
+vec3 position = impostorCorner(IMPOSTOR_CORNERS[gl_VertexID], view, vTexCoord, frameDirection);
+vCardPosition = vec4(origin + rotation * position * scale, 1);
+vRotation = rotation;
+vDepthAxis = rotation * frameDirection * ImpostorSphere.w * scale;
+gl_Position = ProjectionView * vCardPosition;
+#else
+vPosition = vec4(origin + rotation * Position.xyz * scale, 1);
+vNormal = rotation * Normal.xyz;
+vTexCoord = TexCoord;
+gl_Position = ProjectionView * vPosition;
+#endif
+vFade = smoothstep(FadeRange.x, FadeRange.y, distance(origin, CameraPosition.xyz));
+}
@@ -0,0 +1,22 @@
+// per-frame camera and lights, shared by every program (see FrameUniforms)
+struct FrameLight {
+vec4 Ia; // light ambient
+vec4 Id; // light diffuse
+vec4 Is; // light specular
+vec4 LightDirection;
+};
+layout(std140) uniform FrameData {
+mat4 Projection;
+mat4 View;
+mat4 ProjectionView;
+vec4 CameraPosition;
+FrameLight Lights[2];
+vec4 ClusterScale; // pixels and log view depth to a cluster (see LightClusters)
+vec4 ClusterCount; // clusters across, down and deep, w is 0 without them
+mat4 ShadowMatrices[4]; // world to each shadow cascade's map (see ShadowCascades)
+vec4 ShadowSplits; // the view depth each cascade reaches to
+vec4 ShadowParameters; // texel size and depth bias, w is 0 without shadows
+vec4 ViewOrigin; // the pixel the view's viewport starts at, so clusters are found in the view
+vec4 OcclusionParameters; // occlusion texels a pixel is and the last one, w is 0 without it (see AmbientOcclusion)
+vec4 FogParameters; // cluster slice to fog coordinate and offset, w is 0 without fog (see VolumetricFog)
+};
@@ -0,0 +1,71 @@
+// a normal map fragment shader writing the deferred renderer's g-buffer for meshes drawn by a MeshBatch
+#version 410
+in vec2 vTexCoord;
+in vec3 vNormal;
+in vec3 vTangent;
+in vec3 vBiTangent;
+in vec4 vPosition;
+flat in vec4 vAmbient;
+flat in vec4 vDiffuse;
+flat in vec4 vSpecular;
+flat in vec4 vLayers;
+
+uniform sampler2DArray diffuseTexture;
+uniform sampler2DArray specularTexture;
+uniform sampler2DArray normalTexture;
+
+// a missing texture reads as black, like an unbound sampler
+vec4 sampleLayer(sampler2DArray textures, float layer) {
+return layer < 0 ? vec4(0, 0, 0, 1) : texture(textures, vec3(vTexCoord, layer));
+}
+
+// the deferred renderer's targets (see DeferredRenderer)
+layout( location = 0 ) out vec4 Albedo; // diffuse colour, ambient strength
+layout( location = 1 ) out vec2 OctNormal; // world normal, octahedral
+layout( location = 2 ) out vec2 Specular; // specular strength, gloss
+
+// folds the lower half of the octahedron over the upper
+vec2 octWrap(vec2 v) {
+return (1 - abs(v.yx)) * vec2(v.x >= 0 ? 1 : -1, v.y >= 0 ? 1 : -1);
+}
+
+// maps a unit normal onto a square, two channels is plenty
+vec2 encodeNormal(vec3 n) {
+n /= abs(n.x) + abs(n.y) + abs(n.z);
+n.xy = n.z >= 0 ? n.xy : octWrap(n.xy);
+return n.xy * 0.5 + 0.5;
+}
+
+void main() {
+
+vec3 Ka = vAmbient.xyz; // material ambient
+vec3 Kd = vDiffuse.xyz; // material diffuse
+vec3 Ks = vSpecular.xyz; // material specular
+float specularPower = vAmbient.w;
+
+vec3 N = normalize(vNormal);
+vec3 T = normalize(vTangent);
+vec3 B = normalize(vBiTangent);
+
+mat3 TBN = mat3(T,B,N);
+
+vec4 diffuseSample = sampleLayer( diffuseTexture, vLayers.x );
+vec3 texDiffuse = diffuseSample.rgb;
+float alpha = diffuseSample.a;
+if(alpha < 0.5)
+discard;
+vec3 texSpecular = sampleLayer( specularTexture, vLayers.y ).rgb;
+vec3 texNormal = sampleLayer( normalTexture, vLayers.z ).rgb;
+
+// rebuild z from xy so two channel (BC5) normal maps work as well as rgb ones
+vec3 tangentNormal = texNormal * 2 - 1;
+tangentNormal.z = sqrt(max(0, 1 - dot(tangentNormal.xy, tangentNormal.xy)));
+N = normalize(TBN * tangentNormal);
+
+// the lighting pass can't keep the colours of Ka and Ks, only how strong they are
+vec3 luminance = vec3(0.2126, 0.7152, 0.0722);
+Albedo = vec4(Kd * texDiffuse, dot(Ka, luminance));
+OctNormal = encodeNormal(N);
+// powers up to 8192 fit in the gloss channel
+Specular = vec2(dot(Ks * texSpecular, luminance), log2(max(specularPower, 1)) / 13);
+}
\ No newline at end of file
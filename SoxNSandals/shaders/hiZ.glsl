@@ -0,0 +1,53 @@
+// the hierarchical depth occlusion test (see HiZBuffer), included by the shaders that cull
+// against it: the scene batch's cull and task shaders and the foliage's cull. declare the
+// ProjectionView the pyramid was drawn with before including it
+
+// The furthest depth of the occluders under each texel, 0 levels for none.
+uniform sampler2D HiZ;
+uniform int HiZLevels;
+
+// Whether depth is reversed, clip z from 0 to 1 and stored 1 near to 0 far.
+uniform bool ReverseZ;
+
+// Whether a world space sphere is behind the occluders everywhere its
+//	box covers on screen, in ProjectionView. Boxes crossing the near plane
+//	are never hidden.
+bool isOccluded(vec3 centre, float radius)
+{
+	vec2 rectMin = vec2(1.0);
+	vec2 rectMax = vec2(0.0);
+	float nearest = ReverseZ ? 0.0 : 1.0;
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner = centre + radius * vec3((i & 1) == 0 ? -1.0 : 1.0,
+			(i & 2) == 0 ? -1.0 : 1.0, (i & 4) == 0 ? -1.0 : 1.0);
+		vec4 clip = ProjectionView * vec4(corner, 1.0);
+		if (clip.w <= 0.0)
+			return false;
+
+		vec3 ndc = clip.xyz / clip.w;
+		rectMin = min(rectMin, ndc.xy * 0.5 + 0.5);
+		rectMax = max(rectMax, ndc.xy * 0.5 + 0.5);
+		if (ReverseZ)
+			nearest = max(nearest, ndc.z);
+		else
+			nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+	rectMin = clamp(rectMin, 0.0, 1.0);
+	rectMax = clamp(rectMax, 0.0, 1.0);
+
+	// The level where the rectangle spans two texels at most, so its
+	//	four corners' texels cover it.
+	vec2 size = vec2(textureSize(HiZ, 0));
+	vec2 extent = (rectMax - rectMin) * size;
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, HiZLevels - 1);
+
+	ivec2 levelSize = textureSize(HiZ, level);
+	ivec2 texelMin = min(ivec2(rectMin * vec2(levelSize)), levelSize - 1);
+	ivec2 texelMax = min(ivec2(rectMax * vec2(levelSize)), levelSize - 1);
+	vec4 depths = vec4(texelFetch(HiZ, texelMin, level).r, texelFetch(HiZ, ivec2(texelMax.x, texelMin.y), level).r,
+		texelFetch(HiZ, ivec2(texelMin.x, texelMax.y), level).r, texelFetch(HiZ, texelMax, level).r);
+	if (ReverseZ)
+		return nearest < min(min(depths.x, depths.y), min(depths.z, depths.w));
+	return nearest > max(max(depths.x, depths.y), max(depths.z, depths.w));
+}
@@ -0,0 +1,49 @@
+// the fragment shader of an impostor's card (see Impostor), lit by the first light, the clustered
+// lights and the cascades like the meshes around it. the card is pushed back to the depth the
+// atlas holds, so it meets the ground and other meshes where the mesh would. while vFade is under
+// 1 the mesh is drawn too, each cutting out the other's fragments by the same dither as foliage.frag
+#version 430
+in vec2 vTexCoord;
+in vec4 vCardPosition;
+in float vFade;
+flat in mat3 vRotation; // the mesh's turn, from its own space to the world
+flat in vec3 vDepthAxis; // the world offset from the card of the nearest depth the atlas holds
+
+out vec4 FragColour;
+
+uniform sampler2D ImpostorAlbedo; // colour, alpha where the mesh was drawn
+uniform sampler2D ImpostorNormalDepth; // normal in the mesh's space, and depth towards the frame's camera
+uniform bool ReverseZ;
+
+#include "frameData.glsl"
+
+// the lighting reads the fragment's world position from here, the surface rather than the card
+vec4 vPosition;
+
+#include "lighting.glsl"
+
+void main() {
+vec4 albedo = texture(ImpostorAlbedo, vTexCoord);
+if (albedo.a < 0.5)
+discard;
+
+// interleaved gradient noise, a different threshold at each pixel of a block
+float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+if (dither >= vFade)
+discard;
+
+vec4 normalDepth = texture(ImpostorNormalDepth, vTexCoord);
+vPosition = vec4(vCardPosition.xyz + vDepthAxis * (normalDepth.a * 2 - 1), 1);
+vec4 clip = ProjectionView * vPosition;
+float depth = clip.z / clip.w;
+gl_FragDepth = ReverseZ ? depth : depth * 0.5 + 0.5;
+
+vec3 N = normalize(vRotation * (normalDepth.xyz * 2 - 1));
+vec3 V = normalize(CameraPosition.xyz - vPosition.xyz);
+vec3 L = normalize(Lights[0].LightDirection.xyz);
+float lambertTerm = max(0, dot(N, -L));
+vec3 colour = Lights[0].Ia.xyz * albedo.rgb * ambientOcclusion();
+colour += Lights[0].Id.xyz * albedo.rgb * lambertTerm * cascadeShadow();
+colour += clusterLighting(N, V, albedo.rgb, vec3(0), 1);
+FragColour = vec4(applyFog(colour), 1);
+}
@@ -0,0 +1,55 @@
+// octahedral impostors (see Impostor), included by the vertex shaders that draw them. an atlas
+// is ImpostorFrames by ImpostorFrames views of a mesh, each from the direction the centre of its
+// cell decodes to, over the whole sphere or only the upper half. ImpostorBaker works out the
+// same directions and bases on the cpu, the two must be kept the same
+uniform int ImpostorFrames;
+uniform bool ImpostorHemisphere;
+uniform vec4 ImpostorSphere; // the mesh's bounding sphere, in its own space
+
+// where a direction from the mesh falls in the atlas, 0 to 1 across it
+vec2 impostorEncode(vec3 direction) {
+if (ImpostorHemisphere)
+direction.y = max(direction.y, 0);
+float sum = abs(direction.x) + abs(direction.y) + abs(direction.z);
+direction = sum > 0 ? direction / sum : vec3(0, 1, 0);
+if (ImpostorHemisphere)
+return vec2(direction.x + direction.z, direction.x - direction.z) * 0.5 + 0.5;
+vec2 p = direction.xz;
+if (direction.y < 0)
+p = (1 - abs(p.yx)) * vec2(p.x >= 0 ? 1 : -1, p.y >= 0 ? 1 : -1);
+return p * 0.5 + 0.5;
+}
+
+// the direction a point in the atlas was seen from
+vec3 impostorDecode(vec2 coord) {
+vec2 v = coord * 2 - 1;
+if (ImpostorHemisphere) {
+vec2 xz = vec2(v.x + v.y, v.x - v.y) * 0.5;
+return normalize(vec3(xz.x, 1 - abs(xz.x) - abs(xz.y), xz.y));
+}
+vec3 n = vec3(v.x, 1 - abs(v.x) - abs(v.y), v.y);
+if (n.y < 0)
+n.xz = (1 - abs(n.zx)) * vec2(n.x >= 0 ? 1 : -1, n.z >= 0 ? 1 : -1);
+return normalize(n);
+}
+
+// the right and up of a view from a direction, looking back at the mesh
+void impostorBasis(vec3 direction, out vec3 right, out vec3 up) {
+right = abs(direction.y) > 0.999 ? vec3(1, 0, 0) : normalize(cross(vec3(0, 1, 0), direction));
+up = cross(direction, right);
+}
+
+// a corner of the card standing in for the mesh, in the mesh's own space. view is the direction
+// from the centre towards the camera, also in its own space. the card faces the frame nearest
+// it, the frame's direction is returned with where the corner is in the atlas
+vec3 impostorCorner(vec2 corner, vec3 view, out vec2 texCoord, out vec3 frameDirection) {
+vec2 cell = clamp(floor(impostorEncode(view) * ImpostorFrames), vec2(0), vec2(ImpostorFrames - 1));
+texCoord = (cell + corner) / ImpostorFrames;
+frameDirection = impostorDecode((cell + 0.5) / ImpostorFrames);
+vec3 right, up;
+impostorBasis(frameDirection, right, up);
+return ImpostorSphere.xyz + (right * (corner.x * 2 - 1) + up * (corner.y * 2 - 1)) * ImpostorSphere.w;
+}
+
+// the two triangles of a card, their corners from the vertex index
+const vec2 IMPOSTOR_CORNERS[6] = vec2[6](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 0), vec2(1, 1), vec2(0, 1));
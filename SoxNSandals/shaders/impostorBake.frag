@@ -0,0 +1,27 @@
+// writes a mesh's colour, normal and depth into one frame of its impostor's atlas (see
+// ImpostorBaker). the colour is unlit, the impostor is lit where it is drawn
+#version 430
+in vec2 vTexCoord;
+in vec3 vNormal;
+in float vDepth;
+
+layout( location = 0 ) out vec4 Albedo;
+layout( location = 1 ) out vec4 NormalDepth;
+
+uniform sampler2D diffuseTexture; // material diffuse texture
+uniform bool DiffuseMapped; // whether there is a texture, the flat diffuse colour alone without one
+uniform vec3 Kd; // material diffuse
+uniform vec3 Direction; // the direction the frame is seen from
+
+void main() {
+vec4 texDiffuse = DiffuseMapped ? texture(diffuseTexture, vTexCoord) : vec4(1);
+if (texDiffuse.a < 0.5)
+discard;
+
+// leaves are seen from both sides, their normal is kept on the side facing the frame's camera
+vec3 N = normalize(vNormal);
+if (dot(N, Direction) < 0)
+N = -N;
+Albedo = vec4(Kd * texDiffuse.rgb, 1);
+NormalDepth = vec4(N * 0.5 + 0.5, clamp(vDepth, 0, 1));
+}
@@ -0,0 +1,21 @@
+// draws a mesh into one frame of its impostor's atlas (see ImpostorBaker), looking back at its
+// bounding sphere from Direction
+#version 430
+layout( location = 0 ) in vec4 Position;
+layout( location = 1 ) in vec4 Normal;
+layout( location = 2 ) in vec2 TexCoord;
+out vec2 vTexCoord;
+out vec3 vNormal;
+out float vDepth;
+
+uniform mat4 BakeMatrix; // the sphere seen from Direction, onto the frame
+uniform vec4 ImpostorSphere; // the mesh's bounding sphere, in its own space
+uniform vec3 Direction; // the direction the frame is seen from
+
+void main() {
+vTexCoord = TexCoord;
+vNormal = Normal.xyz;
+// 0 at the back of the sphere to 1 at its front, as the impostor pushes its card back
+vDepth = dot(Position.xyz - ImpostorSphere.xyz, Direction) / ImpostorSphere.w * 0.5 + 0.5;
+gl_Position = BakeMatrix * Position;
+}
@@ -0,0 +1,29 @@
+// the vertex shader of instanced impostors (see Impostor::drawInstanced), a card for each copy
+// facing the frame of its atlas nearest the camera. drawn with impostor.frag
+#version 430
+// filled from the impostor's instance buffer, as OBJMesh::drawInstanced fills phongInstanced.vert's
+layout( location = 4 ) in mat4 InstanceModel;
+out vec2 vTexCoord;
+out vec4 vCardPosition;
+out float vFade;
+flat out mat3 vRotation;
+flat out vec3 vDepthAxis;
+
+#include "frameData.glsl"
+#include "impostor.glsl"
+
+void main() {
+mat3 model = mat3(InstanceModel);
+vec3 centre = (InstanceModel * vec4(ImpostorSphere.xyz, 1)).xyz;
+// copies are only turned and uniformly scaled, so the transpose takes a direction back into the
+// mesh's space
+vec3 view = normalize(transpose(model) * (CameraPosition.xyz - centre));
+vec3 frameDirection;
+vec3 position = impostorCorner(IMPOSTOR_CORNERS[gl_VertexID], view, vTexCoord, frameDirection);
+vCardPosition = InstanceModel * vec4(position, 1);
+vRotation = model / length(model[0]);
+vDepthAxis = model * frameDirection * ImpostorSphere.w;
+// the copies swap to their impostors outright, there is nothing to fade from
+vFade = 1;
+gl_Position = ProjectionView * vCardPosition;
+}
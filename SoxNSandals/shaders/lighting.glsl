@@ -0,0 +1,182 @@
+// the first light's shadows, the clustered point and spot lights and their shadows, the clustered
+// decals, the ambient occlusion and the volumetric fog, for fragment shaders with a world space
+// vPosition. include frameData.glsl first
+
+// the clustered point and spot lights and decals binned into each cluster of the view
+uniform samplerBuffer ClusterLights;
+uniform usamplerBuffer ClusterGrid;
+uniform usamplerBuffer ClusterIndices;
+uniform samplerBuffer ClusterDecals;
+
+// the decals' textures, a layer each (see DecalAtlas)
+uniform sampler2DArray DecalAtlas;
+
+// the first light's shadow maps, a layer per cascade
+uniform sampler2DArrayShadow ShadowCascades;
+
+// how much of the first light reaches this fragment, from the cascade its depth is in
+float cascadeShadow() {
+if (ShadowParameters.w == 0)
+return 1;
+float depth = -(View * vPosition).z;
+int cascade = 0;
+while (cascade < 4 && depth > ShadowSplits[cascade])
+++cascade;
+if (cascade == 4)
+return 1;
+vec4 coord = ShadowMatrices[cascade] * vPosition;
+float reference = coord.z - ShadowParameters.y;
+// four filtered compares half a texel apart
+float lit = 0;
+for (int i = 0; i < 4; ++i) {
+vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * ShadowParameters.x;
+lit += texture(ShadowCascades, vec4(coord.xy + offset, cascade, reference));
+}
+return lit * 0.25;
+}
+
+// the point and spot lights' shadows, a tile of the atlas a face, and each shadowed light's slot
+// of a face's world to tile matrix each and then its face count and depth bias (see ShadowAtlas)
+uniform sampler2DShadow ShadowAtlas;
+uniform samplerBuffer ShadowAtlasSlots;
+
+// how much of a clustered light reaches this fragment, from the tile of the face it is in.
+// slot is the light's colour.w, its slot plus one, or 0 when it isn't shadowed
+float atlasShadow(float slot, vec3 fromLight) {
+if (slot < 1)
+return 1;
+int first = (int(slot) - 1) * 25;
+vec4 parameters = texelFetch(ShadowAtlasSlots, first + 24);
+// a point light's faces are the cube map's, picked by the largest axis
+int face = 0;
+if (parameters.x > 1) {
+vec3 axis = abs(fromLight);
+if (axis.x >= axis.y && axis.x >= axis.z)
+face = fromLight.x > 0 ? 0 : 1;
+else if (axis.y >= axis.z)
+face = fromLight.y > 0 ? 2 : 3;
+else
+face = fromLight.z > 0 ? 4 : 5;
+}
+int row = first + face * 4;
+mat4 matrix = mat4(texelFetch(ShadowAtlasSlots, row), texelFetch(ShadowAtlasSlots, row + 1),
+texelFetch(ShadowAtlasSlots, row + 2), texelFetch(ShadowAtlasSlots, row + 3));
+vec4 coord = matrix * vPosition;
+return texture(ShadowAtlas, vec3(coord.xy / coord.w, coord.z / coord.w - parameters.y));
+}
+
+// where the lights of this fragment's cluster start in the index list and how many there are,
+// then the same for its decals
+uvec4 fragmentCluster() {
+float depth = max(-(View * vPosition).z, 0.0001);
+ivec3 cluster = ivec3(ivec2((gl_FragCoord.xy - ViewOrigin.xy) * ClusterScale.xy), int(log(depth) * ClusterScale.z + ClusterScale.w));
+cluster = clamp(cluster, ivec3(0), ivec3(ClusterCount.xyz) - 1);
+return texelFetch(ClusterGrid, (cluster.z * int(ClusterCount.y) + cluster.y) * int(ClusterCount.x) + cluster.x);
+}
+
+// blends the clustered decals covering this fragment over its diffuse colour, in the order they
+// were placed. each fades out as the surface turns side on to the way it is projected, and
+// towards the ends of its box, so it doesn't smear down walls or stop at a hard edge
+vec3 applyDecals(vec3 diffuseColour, vec3 N) {
+if (ClusterCount.w == 0)
+return diffuseColour;
+uvec4 range = fragmentCluster();
+// the position's derivatives, taken before any fragment of the quad leaves the loop, give each
+// decal its mip
+vec3 dx = dFdx(vPosition.xyz);
+vec3 dy = dFdy(vPosition.xyz);
+for (uint i = 0u; i < range.w; ++i) {
+int decal = int(texelFetch(ClusterIndices, int(range.z + i)).r) * 5;
+vec4 row0 = texelFetch(ClusterDecals, decal + 1);
+vec4 row1 = texelFetch(ClusterDecals, decal + 2);
+vec4 row2 = texelFetch(ClusterDecals, decal + 3);
+// the box runs from 0 to 1 along each side, x and y are the texture coordinates
+vec3 box = vec3(dot(row0, vPosition), dot(row1, vPosition), dot(row2, vPosition));
+if (any(lessThan(box, vec3(0))) || any(greaterThan(box, vec3(1))))
+continue;
+vec4 parameters = texelFetch(ClusterDecals, decal + 4);
+vec2 gradientX = vec2(dot(row0.xyz, dx), dot(row1.xyz, dx));
+vec2 gradientY = vec2(dot(row0.xyz, dy), dot(row1.xyz, dy));
+vec4 colour = textureGrad(DecalAtlas, vec3(box.xy, parameters.x), gradientX, gradientY);
+float facing = abs(dot(N, normalize(row2.xyz)));
+float coverage = colour.a * parameters.y * smoothstep(0.2, 0.5, facing) * smoothstep(0, 0.1, min(box.z, 1 - box.z));
+diffuseColour = mix(diffuseColour, colour.rgb, coverage);
+}
+return diffuseColour;
+}
+
+// adds up the clustered lights reaching this fragment
+vec3 clusterLighting(vec3 N, vec3 V, vec3 diffuseColour, vec3 specularColour, float power) {
+if (ClusterCount.w == 0)
+return vec3(0);
+uvec2 range = fragmentCluster().xy;
+vec3 result = vec3(0);
+for (uint i = 0u; i < range.y; ++i) {
+int light = int(texelFetch(ClusterIndices, int(range.x + i)).r) * 3;
+vec4 positionRange = texelFetch(ClusterLights, light);
+vec4 colour = texelFetch(ClusterLights, light + 1);
+vec4 spot = texelFetch(ClusterLights, light + 2);
+vec3 toLight = positionRange.xyz - vPosition.xyz;
+float lightDistance = length(toLight);
+if (lightDistance >= positionRange.w)
+continue;
+vec3 L = toLight / lightDistance;
+// falls to nothing at the light's range
+float falloff = 1 - lightDistance / positionRange.w;
+falloff *= falloff;
+// spot lights fade from a little inside their cone to its edge
+if (spot.w > -1)
+falloff *= smoothstep(spot.w, mix(spot.w, 1, 0.2), dot(-L, spot.xyz));
+falloff *= atlasShadow(colour.a, -toLight);
+float lambertTerm = max(0, dot(N, L));
+float specularTerm = pow(max(0, dot(reflect(-L, N), V)), power);
+result += colour.rgb * falloff * (diffuseColour * lambertTerm + specularColour * specularTerm);
+}
+return result;
+}
+
+// the ambient occlusion at half the size of the view, with the distance of each texel
+uniform sampler2D AmbientOcclusion;
+
+// how much ambient light reaches this fragment, from the four occlusion texels around it
+// weighted by how close their distance is to its own. drawn after the pre-pass, with
+// nothing near it in the occlusion, it isn't occluded
+float ambientOcclusion() {
+if (OcclusionParameters.w == 0)
+return 1;
+float depth = -(View * vPosition).z;
+vec2 position = (gl_FragCoord.xy - ViewOrigin.xy - 0.5) * OcclusionParameters.x;
+ivec2 first = ivec2(floor(position));
+vec2 blend = position - vec2(first);
+ivec2 last = ivec2(OcclusionParameters.yz);
+float occlusion = 0;
+float total = 0;
+float closest = 1;
+for (int i = 0; i < 4; ++i) {
+ivec2 offset = ivec2(i & 1, i >> 1);
+vec2 texel = texelFetch(AmbientOcclusion, clamp(first + offset, ivec2(0), last), 0).rg;
+vec2 bilinear = mix(1.0 - blend, blend, vec2(offset));
+float difference = abs(texel.g - depth) / depth;
+float weight = bilinear.x * bilinear.y / (difference + 0.001);
+occlusion += texel.r * weight;
+total += weight;
+closest = min(closest, difference);
+}
+return closest > 0.05 ? 1 : occlusion / total;
+}
+
+// the volumetric fog from the camera to the far side of each froxel, light scattered towards
+// the camera in rgb and what of the scene shows through in a (see VolumetricFog)
+uniform sampler3D FogVolume;
+
+// fogs a fragment's colour with what the froxels gather between it and the camera. they are
+// the clusters split finer, so the fragment's cluster coordinate finds them
+vec3 applyFog(vec3 colour) {
+if (FogParameters.w == 0)
+return colour;
+float depth = max(-(View * vPosition).z, 0.0001);
+vec2 tile = (gl_FragCoord.xy - ViewOrigin.xy) * ClusterScale.xy / ClusterCount.xy;
+float slice = (log(depth) * ClusterScale.z + ClusterScale.w) * FogParameters.x + FogParameters.y;
+vec4 fog = texture(FogVolume, vec3(tile, slice));
+return colour * fog.a + fog.rgb;
+}
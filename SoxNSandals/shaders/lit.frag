@@ -0,0 +1,165 @@
+// the lit fragment shader, compiled once for each set of features a material
+// needs (see ShaderPermutations). every feature is defined to 0 or its value:
+//   DIFFUSE_MAP       the diffuse and specular colours are textured
+//   NORMAL_MAP        the normal is read from the normal map
+//   ALPHA_TEST        fragments under half the diffuse alpha are cut out
+//   PACKED_MAPS       the specular and alpha maps are the red and green of
+//                     packedTexture (see OBJMesh::setPackScalarMaps)
+//   SHADOWS           the first light is shadowed by its cascades
+//   CLUSTERED_LIGHTS  the view's clustered point and spot lights are added, and its clustered
+//                     decals blended into the diffuse colour
+//   LIGHT_COUNT       how many of the frame's lights it is lit by, 0 is unlit
+//   TRANSPARENT       blended by its opacity and alpha through transparency.glsl, not cut out
+//   LIGHTMAP          the sun and sky are read from the baked lightmap (see Lightmapper)
+//                     rather than lit by the frame's lights, the clustered lights still add
+//   PROBES            the lights' flat ambient is the irradiance probes' light instead, and the
+//                     nearest reflection probe is reflected (see ProbeVolume)
+//   VIRTUAL_TEXTURE   the diffuse colour is the object's virtual texture (see VirtualTextureCache)
+//                     rather than its diffuseTexture
+#version 430
+in vec2 vTexCoord;
+in vec3 vNormal;
+in vec3 vTangent;
+in vec3 vBiTangent;
+in vec4 vPosition;
+#if LIGHTMAP
+in vec2 vLightmapTexCoord;
+uniform sampler2D Lightmap;
+#endif
+#if VIRTUAL_TEXTURE
+flat in uint vVirtualTexture;
+#include "virtualTexture.glsl"
+#endif
+
+#if TRANSPARENT
+#include "transparency.glsl"
+#else
+out vec4 FragColour;
+#endif
+
+uniform sampler2D diffuseTexture;
+uniform sampler2D specularTexture;
+uniform sampler2D normalTexture;
+uniform sampler2D packedTexture;
+
+#include "materialData.glsl"
+#include "atlas.glsl"
+#include "frameData.glsl"
+#include "lighting.glsl"
+#if PROBES
+#include "probes.glsl"
+#endif
+
+void main() {
+
+#if VIRTUAL_TEXTURE
+vec4 texDiffuse = vVirtualTexture > 0u ? sampleVirtualTexture(int(vVirtualTexture) - 1, vTexCoord) : vec4(1);
+#elif DIFFUSE_MAP || ALPHA_TEST
+vec4 texDiffuse = sampleMap( diffuseTexture, 0, vTexCoord );
+#else
+vec4 texDiffuse = vec4(1);
+#endif
+// one sample for every scalar map
+#if PACKED_MAPS
+vec4 texPacked = sampleMap( packedTexture, 7, vTexCoord );
+#endif
+// transparent materials blend by their opacity and alpha map instead of cutting holes
+#if TRANSPARENT && ALPHA_TEST && PACKED_MAPS
+float alpha = opacity * texPacked.g;
+#elif TRANSPARENT
+float alpha = opacity * texDiffuse.a;
+#elif ALPHA_TEST && PACKED_MAPS
+if(texPacked.g < 0.5)
+discard;
+#elif ALPHA_TEST
+if(texDiffuse.a < 0.5)
+discard;
+#endif
+vec4 result;
+
+#if LIGHT_COUNT == 0 && CLUSTERED_LIGHTS == 0
+// unlit, the texture as it is or the flat diffuse colour
+#if DIFFUSE_MAP
+result = texDiffuse;
+#else
+result = vec4(Kd, 1);
+#endif
+#else
+
+#if DIFFUSE_MAP
+vec3 diffuseColour = Kd * texDiffuse.rgb;
+#if PACKED_MAPS
+vec3 specularColour = Ks * texPacked.r;
+#else
+vec3 specularColour = Ks * sampleMap( specularTexture, 3, vTexCoord ).rgb;
+#endif
+#else
+vec3 diffuseColour = Kd;
+vec3 specularColour = Ks;
+#endif
+
+vec3 N = normalize(vNormal);
+#if NORMAL_MAP
+vec3 T = normalize(vTangent);
+vec3 B = normalize(vBiTangent);
+mat3 TBN = mat3(T,B,N);
+
+// rebuild z from xy so two channel (BC5) normal maps work as well as rgb ones
+vec3 tangentNormal = sampleMap( normalTexture, 5, vTexCoord ).rgb * 2 - 1;
+tangentNormal.z = sqrt(max(0, 1 - dot(tangentNormal.xy, tangentNormal.xy)));
+N = normalize(TBN * tangentNormal);
+#endif
+#if CLUSTERED_LIGHTS
+// decals colour the surface itself, so they are lit as it is. they fade by the surface's own
+// normal, not the normal map's
+diffuseColour = applyDecals(diffuseColour, normalize(vNormal));
+#endif
+
+// calculate view vector
+vec3 V = normalize(CameraPosition.xyz - vPosition.xyz);
+float occlusion = ambientOcclusion();
+
+vec3 colour = vec3(0);
+#if LIGHTMAP
+// the baked light is what the diffuse colour is scaled by, shadows and bounces included
+colour += diffuseColour * texture( Lightmap, vLightmapTexCoord ).rgb;
+#else
+#if PROBES
+colour += diffuseColour * probeIrradiance(vPosition.xyz, N) * occlusion;
+colour += specularColour * probeReflection(vPosition.xyz, reflect(-V, N), specularPower) * occlusion;
+#endif
+for (int i = 0; i < LIGHT_COUNT; ++i) {
+vec3 L = normalize(Lights[i].LightDirection.xyz);
+// calculate lambert term and reflection vector
+float lambertTerm = max( 0, dot( N, -L ) );
+vec3 R = reflect( L, N );
+// calculate specular term
+float specularTerm = pow( max( 0, dot( R, V ) ), specularPower );
+#if SHADOWS
+float shadow = i == 0 ? cascadeShadow() : 1.0;
+#else
+float shadow = 1;
+#endif
+// calculate each light property
+#if !PROBES
+colour += Lights[i].Ia.xyz * Ka * occlusion;
+#endif
+colour += Lights[i].Id.xyz * diffuseColour * lambertTerm * shadow;
+colour += Lights[i].Is.xyz * specularColour * specularTerm * shadow;
+}
+#endif
+#if CLUSTERED_LIGHTS
+colour += clusterLighting(N, V, diffuseColour, specularColour, specularPower);
+#endif
+result = vec4(colour, 1);
+#endif
+// the fog between the fragment and the camera, before a transparent one is premultiplied
+result.rgb = applyFog(result.rgb);
+
+#if TRANSPARENT
+// premultiplied, so the weighted sums and lists blend the same way
+writeTransparent(vec4(result.rgb * alpha, alpha));
+#else
+FragColour = result;
+#endif
+}
@@ -0,0 +1,47 @@
+// the lit vertex shader, every permutation of lit.frag is drawn with
+// (see ShaderPermutations). the g-buffer and depth pre-pass draw with it too
+#version 430
+// only the lit permutations define their features, the other passes have no lightmap
+#ifndef LIGHTMAP
+#define LIGHTMAP 0
+#endif
+#ifndef VIRTUAL_TEXTURE
+#define VIRTUAL_TEXTURE 0
+#endif
+layout( location = 0 ) in vec4 Position;
+layout( location = 1 ) in vec4 Normal;
+layout( location = 2 ) in vec2 TexCoord;
+layout( location = 3 ) in vec4 Tangent;
+out vec2 vTexCoord;
+out vec3 vNormal;
+out vec3 vTangent;
+out vec3 vBiTangent;
+out vec4 vPosition;
+#if LIGHTMAP
+// the mesh's own lightmap texcoords (see OBJMesh::setLightmapResolution), moved into the atlas
+layout( location = 10 ) in vec2 LightmapTexCoord;
+out vec2 vLightmapTexCoord;
+#endif
+#if VIRTUAL_TEXTURE
+// the object's virtual texture plus one (see VirtualTextureCache), 0 if it has none
+flat out uint vVirtualTexture;
+#endif
+// the depth pre-pass draws with this shader too, its depth has to match exactly
+invariant gl_Position;
+#include "frameData.glsl"
+#include "object.glsl"
+void main() {
+Object object = objects[ObjectIndex];
+vTexCoord = TexCoord;
+vPosition = object.model * Position;
+vNormal = object.normalMatrix * Normal.xyz;
+vTangent = object.normalMatrix * Tangent.xyz;
+vBiTangent = cross(vNormal, vTangent) * Tangent.w;
+#if LIGHTMAP
+vLightmapTexCoord = LightmapTexCoord * unpackUnorm2x16(object.material.y) + unpackUnorm2x16(object.material.z);
+#endif
+#if VIRTUAL_TEXTURE
+vVirtualTexture = object.material.w;
+#endif
+gl_Position = ProjectionView * vPosition;
+}
@@ -0,0 +1,9 @@
+// the material of the chunk being drawn, a range of the UniformRing bound by OBJMesh::bindMaterial
+layout(std140) uniform MaterialData {
+vec3 Ka; // material ambient
+float opacity;
+vec3 Kd; // material diffuse
+float specularPower;
+vec3 Ks; // material specular
+vec3 Ke; // material emissive
+};
@@ -0,0 +1,6 @@
+// the instances and materials of meshes drawn by a MeshBatch, included by the vertex shaders that
+// draw them. the instance buffer brings each command's model matrix and material id, picked by the
+// command's base instance, and the id picks the material's block (see MaterialTable)
+#include "meshBatchMaterials.glsl"
+layout( location = 4 ) in mat4 InstanceModel;
+layout( location = 8 ) in uint InstanceMaterial;
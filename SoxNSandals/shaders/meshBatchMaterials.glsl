@@ -0,0 +1,11 @@
+// the materials of meshes drawn by a MeshBatch, one block per material id (see MaterialTable).
+// included by meshBatch.glsl and by the mesh shader, which reads the ids itself
+struct Material {
+vec4 ambient; // Ka and specular power
+vec4 diffuse; // Kd and opacity
+vec4 specular; // Ks
+ivec4 layers; // diffuse, specular and normal texture layers, -1 for none
+};
+layout(std430, binding = 4) readonly buffer Materials {
+Material materials[];
+};
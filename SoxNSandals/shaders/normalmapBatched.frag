@@ -0,0 +1,79 @@
+// a normal map fragment shader for meshes drawn by a MeshBatch, textures are layers of arrays
+#version 410
+in vec2 vTexCoord;
+in vec3 vNormal;
+in vec3 vTangent;
+in vec3 vBiTangent;
+in vec4 vPosition;
+flat in vec4 vAmbient;
+flat in vec4 vDiffuse;
+flat in vec4 vSpecular;
+flat in vec4 vLayers;
+
+out vec4 FragColour;
+
+uniform sampler2DArray diffuseTexture;
+uniform sampler2DArray specularTexture;
+uniform sampler2DArray normalTexture;
+
+// a missing texture reads as black, like an unbound sampler
+vec4 sampleLayer(sampler2DArray textures, float layer) {
+return layer < 0 ? vec4(0, 0, 0, 1) : texture(textures, vec3(vTexCoord, layer));
+}
+
+#include "frameData.glsl"
+// which of the frame's lights this program is lit by
+uniform int LightIndex;
+
+#include "lighting.glsl"
+
+void main() {
+
+vec3 Ka = vAmbient.xyz; // material ambient
+vec3 Kd = vDiffuse.xyz; // material diffuse
+vec3 Ks = vSpecular.xyz; // material specular
+float specularPower = vAmbient.w;
+
+vec3 Ia = Lights[LightIndex].Ia.xyz;
+vec3 Id = Lights[LightIndex].Id.xyz;
+vec3 Is = Lights[LightIndex].Is.xyz;
+vec3 LightDirection = Lights[LightIndex].LightDirection.xyz;
+vec3 cameraPosition = CameraPosition.xyz;
+
+vec3 N = normalize(vNormal);
+vec3 T = normalize(vTangent);
+vec3 B = normalize(vBiTangent);
+vec3 L = normalize(LightDirection);
+
+mat3 TBN = mat3(T,B,N);
+
+vec4 diffuseSample = sampleLayer( diffuseTexture, vLayers.x );
+vec3 texDiffuse = diffuseSample.rgb;
+float alpha = diffuseSample.a;
+if(alpha < 0.5)
+discard;
+// decals colour the surface itself, fading by its own normal, not the normal map's
+vec3 albedo = applyDecals(Kd * texDiffuse, N);
+vec3 texSpecular = sampleLayer( specularTexture, vLayers.y ).rgb;
+vec3 texNormal = sampleLayer( normalTexture, vLayers.z ).rgb;
+
+// rebuild z from xy so two channel (BC5) normal maps work as well as rgb ones
+vec3 tangentNormal = texNormal * 2 - 1;
+tangentNormal.z = sqrt(max(0, 1 - dot(tangentNormal.xy, tangentNormal.xy)));
+N = normalize(TBN * tangentNormal);
+
+// calculate lambert term
+float lambertTerm = max( 0, dot( N, -L ) );
+// calculate view vector and reflection vector
+vec3 V = normalize(cameraPosition - vPosition.xyz);
+vec3 R = reflect( L, N );
+// calculate specular term
+float specularTerm = pow( max( 0, dot( R, V ) ), specularPower );
+// calculate each light property
+vec3 ambient = Ia * Ka * ambientOcclusion();
+float shadow = LightIndex == 0 ? cascadeShadow() : 1.0;
+vec3 diffuse = Id * albedo * lambertTerm * shadow;
+vec3 specular = Is * Ks * texSpecular * specularTerm * shadow;
+vec3 clustered = clusterLighting(N, V, albedo, Ks * texSpecular, specularPower);
+FragColour = vec4(applyFog(ambient + diffuse + specular + clustered), 1);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+// a normal map vertex shader for meshes drawn by a MeshBatch, each draw brings its own model matrix and material
+#version 430
+layout( location = 0 ) in vec4 Position;
+layout( location = 1 ) in vec4 Normal;
+layout( location = 2 ) in vec2 TexCoord;
+layout( location = 3 ) in vec4 Tangent;
+#include "meshBatch.glsl"
+out vec2 vTexCoord;
+out vec3 vNormal;
+out vec3 vTangent;
+out vec3 vBiTangent;
+out vec4 vPosition;
+flat out vec4 vAmbient;
+flat out vec4 vDiffuse;
+flat out vec4 vSpecular;
+flat out vec4 vLayers;
+// the depth pre-pass draws with this shader too, its depth has to match exactly
+invariant gl_Position;
+// per-frame camera and lights, shared by every program (see FrameUniforms)
+struct FrameLight {
+vec4 Ia; // light ambient
+vec4 Id; // light diffuse
+vec4 Is; // light specular
+vec4 LightDirection;
+};
+layout(std140) uniform FrameData {
+mat4 Projection;
+mat4 View;
+mat4 ProjectionView;
+vec4 CameraPosition;
+FrameLight Lights[2];
+vec4 ClusterScale; // pixels and log view depth to a cluster (see LightClusters)
+vec4 ClusterCount; // clusters across, down and deep, w is 0 without them
+mat4 ShadowMatrices[4]; // world to each shadow cascade's map (see ShadowCascades)
+vec4 ShadowSplits; // the view depth each cascade reaches to
+vec4 ShadowParameters; // texel size and depth bias, w is 0 without shadows
+vec4 ViewOrigin; // the pixel the view's viewport starts at, so clusters are found in the view
+vec4 OcclusionParameters; // occlusion texels a pixel is and the last one, w is 0 without it (see AmbientOcclusion)
+};
+void main() {
+// batched meshes are only rotated and uniformly scaled, so the model
+// matrix can transform the normal and tangent
+mat3 normalMatrix = mat3(InstanceModel);
+vTexCoord = TexCoord;
+vPosition = InstanceModel * Position;
+vNormal = normalMatrix * Normal.xyz;
+vTangent = normalMatrix * Tangent.xyz;
+vBiTangent = cross(vNormal, vTangent) * Tangent.w;
+Material material = materials[InstanceMaterial];
+vAmbient = material.ambient;
+vDiffuse = material.diffuse;
+vSpecular = material.specular;
+vLayers = vec4(material.layers);
+gl_Position = ProjectionView * vPosition;
+}
\ No newline at end of file
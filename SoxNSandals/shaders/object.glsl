@@ -0,0 +1,14 @@
+// the placed objects (see ObjectBuffer), included by the vertex shaders that draw one at a time.
+// each object's matrices are written once when it moves, and ObjectIndex picks the one being drawn
+struct Object {
+mat4 model;
+mat3 normalMatrix; // the inverse transpose of the model's upper 3x3
+vec4 bounds; // the world sphere, w is 0 until it is known
+uvec4 material; // x is its MaterialTable id, ~0 if it has none, y and z its lightmap rect's scale and offset as unorm 2x16,
+                 // w its virtual texture plus one, 0 if it has none
+};
+layout(std430, binding = 5) readonly buffer Objects {
+Object objects[];
+};
+// a constant attribute no vertex array enables, set before each object's draws
+layout( location = 9 ) in uint ObjectIndex;
@@ -0,0 +1,5 @@
+// an occlusion query's box only counts samples, it writes nothing
+#version 410
+
+void main() {
+}
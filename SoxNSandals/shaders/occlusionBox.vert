@@ -0,0 +1,24 @@
+//Vert Shader
+#version 410
+
+#include "frameData.glsl"
+
+// a world space box drawn for an occlusion query, from gl_VertexID alone
+uniform vec3 BoxMin;
+uniform vec3 BoxMax;
+
+// two triangles a face, wound counter clockwise from outside. a corner's
+// x, y and z are its bits 0, 1 and 2
+const int Corners[36] = int[36](
+0, 4, 6, 0, 6, 2,
+1, 3, 7, 1, 7, 5,
+0, 1, 5, 0, 5, 4,
+2, 6, 7, 2, 7, 3,
+0, 2, 3, 0, 3, 1,
+4, 5, 7, 4, 7, 6);
+
+void main() {
+int corner = Corners[gl_VertexID];
+vec3 bits = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+gl_Position = ProjectionView * vec4(mix(BoxMin, BoxMax, bits), 1);
+}
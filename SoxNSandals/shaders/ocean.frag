@@ -0,0 +1,64 @@
+// the ocean's fragment shader (see Ocean). the normal comes from every cascade's slopes at
+// the water's place at rest, filtered down to the pixel, and the foam from where the choppy
+// waves squeeze the surface. the sky it reflects is made up from the first light, the
+// deep water under it lit by it and shadowed, and the clustered lights are added
+#version 410
+in vec2 vSeaCoord;
+in vec4 vPosition;
+
+out vec4 FragColour;
+
+#include "frameData.glsl"
+#include "lighting.glsl"
+
+uniform sampler2DArray Displacement;
+uniform sampler2DArray Slopes; // along x and z, and how much x and z stretch along themselves
+uniform vec3 Sizes;
+
+const vec3 DEEP_COLOUR = vec3(0.01, 0.05, 0.08);
+const vec3 SCATTER_COLOUR = vec3(0.0, 0.12, 0.1);
+const vec3 FOAM_COLOUR = vec3(0.9, 0.92, 0.95);
+
+void main() {
+vec4 slopes = vec4(0);
+float height = 0;
+float shear = 0;
+for (int i = 0; i < 3; ++i) {
+vec3 coord = vec3(vSeaCoord / Sizes[i], i);
+slopes += texture(Slopes, coord);
+vec4 displacement = texture(Displacement, coord);
+height += displacement.y;
+shear += displacement.w;
+}
+
+// the slopes of the moved surface, the choppy waves narrowing the crests
+vec2 stretch = 1 + slopes.zw;
+vec3 N = normalize(vec3(-slopes.x / max(stretch.x, 0.1), 1, -slopes.y / max(stretch.y, 0.1)));
+// where the surface folds over itself, the jacobian of the move falls under 1
+float jacobian = stretch.x * stretch.y - shear * shear;
+float foam = smoothstep(0.9, 0.3, jacobian);
+
+vec3 V = normalize(CameraPosition.xyz - vPosition.xyz);
+vec3 L = normalize(Lights[0].LightDirection.xyz);
+float shadow = cascadeShadow();
+float lambertTerm = max(0, dot(N, -L));
+
+// schlick's fresnel for water, more of the sky towards the horizon
+float facing = max(dot(N, V), 0);
+float fresnel = 0.02 + 0.98 * pow(1 - facing, 5);
+vec3 R = reflect(-V, N);
+vec3 sky = mix(vec3(0.55, 0.65, 0.75), vec3(0.15, 0.3, 0.55), sqrt(clamp(R.y, 0, 1)));
+sky *= Lights[0].Ia.xyz + Lights[0].Id.xyz * 0.75;
+
+// the crests scatter more light back through them
+vec3 water = DEEP_COLOUR * (Lights[0].Ia.xyz + Lights[0].Id.xyz * lambertTerm * shadow);
+water += SCATTER_COLOUR * Lights[0].Id.xyz * max(height, 0) * (1 - facing);
+
+vec3 H = normalize(V - L);
+vec3 specular = Lights[0].Is.xyz * pow(max(dot(N, H), 0), 512) * 4 * shadow;
+
+vec3 colour = mix(water, sky, fresnel) + specular;
+colour += clusterLighting(N, V, DEEP_COLOUR, vec3(fresnel), 256);
+colour = mix(colour, FOAM_COLOUR * (Lights[0].Ia.xyz + Lights[0].Id.xyz * lambertTerm * shadow), foam);
+FragColour = vec4(applyFog(colour), 1);
+}
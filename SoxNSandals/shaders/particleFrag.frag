@@ -2,9 +2,34 @@
 #version 410
 
 in vec4 vColour;
+in float vDistance;
 out vec4 FragColour;
 
+// The scene's depth, for fading out where particles meet it.
+uniform sampler2D SceneDepth;
+
+// How far in front of the scene a particle fades out over, 0 turns
+//	the fade off.
+uniform float SoftDistance;
+
+// How many window pixels wide a pixel of the render target is.
+uniform float TargetScale;
+
+// Turns depth into distance, x / (depth * y + z), from the projection's
+//	[3][2] and [2][2] (see ParticleTarget). The bottom is never negative,
+//	and is kept off 0 for reversed depth at infinity.
+uniform vec3 DepthRange;
+
 void main()
 {
-	FragColour = vColour;	
-}
\ No newline at end of file
+	float alpha = vColour.a;
+	if (SoftDistance > 0.0)
+	{
+		float depth = texelFetch(SceneDepth, ivec2(gl_FragCoord.xy * TargetScale), 0).r;
+		float sceneDistance = DepthRange.x / max(depth * DepthRange.y + DepthRange.z, 1e-7);
+		alpha *= clamp((sceneDistance - vDistance) / SoftDistance, 0.0, 1.0);
+	}
+
+	// Premultiplied, blended with GL_ONE and GL_ONE_MINUS_SRC_ALPHA.
+	FragColour = vec4(vColour.rgb * alpha, alpha);
+}
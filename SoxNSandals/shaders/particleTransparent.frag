@@ -0,0 +1,16 @@
+// Frag Shader
+#version 430
+
+// Draws particles through order independent transparency (see
+//	TransparencyTarget), at the window's size, so they needn't be
+//	sorted. The scene's depth is the depth buffer here, so they aren't
+//	faded where they meet it.
+
+in vec4 vColour;
+
+#include "transparency.glsl"
+
+void main()
+{
+	writeTransparent(vec4(vColour.rgb * vColour.a, vColour.a));
+}
@@ -0,0 +1,60 @@
+// Frag Shader
+#version 410
+
+// Blends the low resolution particle target back over the window. Each
+//	pixel takes the four target texels around it, weighted by how near
+//	they are and how close their depth is to the pixel's, so particles
+//	stay on their side of an edge in the scene.
+
+uniform sampler2D SceneDepth;
+uniform sampler2D Particles;
+uniform sampler2D ParticleDepth;
+
+// How many window pixels wide a target texel is.
+uniform int Divisor;
+
+// The last texel of the target drawn into this frame, which isn't the
+//	edge of the target when the scene is drawn smaller than it.
+uniform vec2 LastTexel;
+
+// Turns depth into distance, x / (depth * y + z), from the projection's
+//	[3][2] and [2][2] (see ParticleTarget). The bottom is never negative,
+//	and is kept off 0 for reversed depth at infinity.
+uniform vec3 DepthRange;
+
+out vec4 FragColour;
+
+float distanceOf(float depth)
+{
+	return DepthRange.x / max(depth * DepthRange.y + DepthRange.z, 1e-7);
+}
+
+void main()
+{
+	float pixelDistance = distanceOf(texelFetch(SceneDepth, ivec2(gl_FragCoord.xy), 0).r);
+
+	vec2 position = gl_FragCoord.xy / float(Divisor) - 0.5;
+	ivec2 first = ivec2(floor(position));
+	vec2 blend = position - vec2(first);
+	ivec2 last = ivec2(LastTexel);
+
+	vec4 colour = vec4(0);
+	float total = 0.0;
+	for (int i = 0; i < 4; ++i)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(first + offset, ivec2(0), last);
+		vec2 bilinear = mix(1.0 - blend, blend, vec2(offset));
+
+		// Relative, so the same edge counts as far off as it does close.
+		float texelDistance = distanceOf(texelFetch(ParticleDepth, texel, 0).r);
+		float difference = abs(texelDistance - pixelDistance) / pixelDistance;
+		float weight = bilinear.x * bilinear.y / (difference + 0.001);
+
+		colour += texelFetch(Particles, texel, 0) * weight;
+		total += weight;
+	}
+
+	// Premultiplied, blended with GL_ONE and GL_ONE_MINUS_SRC_ALPHA.
+	FragColour = colour / total;
+}
@@ -0,0 +1,8 @@
+//Vert Shader
+#version 410
+
+// one triangle that covers the whole window, from gl_VertexID alone
+void main() {
+vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+gl_Position = vec4(corner * 2.0 - 1.0, 0, 1);
+}
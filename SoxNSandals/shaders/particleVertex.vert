@@ -1,13 +1,39 @@
 //Vert Shader
 #version 410
 
-in vec4 Position;
-in vec4 Colour;
+// one instance per particle, xyz is the centre and w is the size
+layout( location = 0 ) in vec4 Position;
+layout( location = 1 ) in vec4 Colour;
 
 out vec4 vColour;
+// the distance in front of the camera, for soft particles
+out float vDistance;
+
+// per-frame camera and lights, shared by every program (see FrameUniforms)
+struct FrameLight {
+vec4 Ia; // light ambient
+vec4 Id; // light diffuse
+vec4 Is; // light specular
+vec4 LightDirection;
+};
+layout(std140) uniform FrameData {
+mat4 Projection;
+mat4 View;
+mat4 ProjectionView;
+vec4 CameraPosition;
+FrameLight Lights[2];
+};
 
 uniform mat4 ProjectionViewModel;
 void main() {
+// the 4 corners of a triangle strip quad, from -1 to 1
+vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+// the camera's right and up axes are the first two rows of the view matrix
+vec3 right = vec3(View[0][0], View[1][0], View[2][0]);
+vec3 up = vec3(View[0][1], View[1][1], View[2][1]);
+vec3 position = Position.xyz + (right * corner.x + up * corner.y) * (Position.w * 0.5);
 vColour = Colour;
-gl_Position = ProjectionViewModel * Position;
-}
\ No newline at end of file
+gl_Position = ProjectionViewModel * vec4(position, 1);
+// a perspective projection's w is the distance along the view
+vDistance = gl_Position.w;
+}
@@ -6,13 +6,29 @@ uniform vec3 Ka; // ambient material colour
 uniform vec3 Kd; // diffuse material colour
 uniform vec3 Ks; // specular material colour
 uniform float specularPower; // material specular power
-uniform vec3 Ia; // ambient light colour
-uniform vec3 Id; // diffuse light colour
-uniform vec3 Is; // specular light colour
-uniform vec3 LightDirection;
-uniform vec3 cameraPosition;
+// per-frame camera and lights, shared by every program (see FrameUniforms)
+struct FrameLight {
+vec4 Ia; // light ambient
+vec4 Id; // light diffuse
+vec4 Is; // light specular
+vec4 LightDirection;
+};
+layout(std140) uniform FrameData {
+mat4 Projection;
+mat4 View;
+mat4 ProjectionView;
+vec4 CameraPosition;
+FrameLight Lights[2];
+};
+// which of the frame's lights this program is lit by
+uniform int LightIndex;
 out vec4 FragColour;
 void main() {
+vec3 Ia = Lights[LightIndex].Ia.xyz;
+vec3 Id = Lights[LightIndex].Id.xyz;
+vec3 Is = Lights[LightIndex].Is.xyz;
+vec3 LightDirection = Lights[LightIndex].LightDirection.xyz;
+vec3 cameraPosition = CameraPosition.xyz;
 // ensure normal and light direction are normalised
 vec3 N = normalize(vNormal);
 vec3 L = normalize(LightDirection);
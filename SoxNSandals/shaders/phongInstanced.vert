@@ -0,0 +1,29 @@
+// Phong vertex shader for instanced meshes, each instance brings its own model matrix
+#version 410
+layout( location = 0 ) in vec4 Position;
+layout( location = 1 ) in vec4 Normal;
+// filled from the mesh's instance buffer, see OBJMesh::drawInstanced
+layout( location = 4 ) in mat4 InstanceModel;
+out vec4 vPosition;
+out vec3 vNormal;
+// per-frame camera and lights, shared by every program (see FrameUniforms)
+struct FrameLight {
+vec4 Ia; // light ambient
+vec4 Id; // light diffuse
+vec4 Is; // light specular
+vec4 LightDirection;
+};
+layout(std140) uniform FrameData {
+mat4 Projection;
+mat4 View;
+mat4 ProjectionView;
+vec4 CameraPosition;
+FrameLight Lights[2];
+};
+void main() {
+vPosition = InstanceModel * Position;
+// instances are only rotated and uniformly scaled, so the model matrix can
+// transform the normal, the fragment shader normalises it
+vNormal = mat3(InstanceModel) * Normal.xyz;
+gl_Position = ProjectionView * vPosition;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+// the planet surface's fragment shader (see PlanetRenderer). the planet's colour is darkened
+// in its lows and whitened on its highs, and it is lit by the sun, not the scene's lights
+#version 410
+in vec3 vNormal;
+in vec4 vPosition;
+in vec4 vColour;
+in float vHeight;
+
+out vec4 FragColour;
+
+#include "frameData.glsl"
+
+uniform vec3 SunPosition;
+
+void main() {
+vec3 N = normalize(vNormal);
+vec3 L = normalize(SunPosition - vPosition.xyz);
+
+vec3 diffuseColour = mix(vColour.rgb * 0.45, vColour.rgb, smoothstep(-0.3, 0.1, vHeight));
+diffuseColour = mix(diffuseColour, vec3(0.9, 0.9, 0.92), smoothstep(0.35, 0.5, vHeight));
+
+float lambertTerm = max(0, dot(N, L));
+vec3 colour = Lights[0].Ia.xyz * diffuseColour + diffuseColour * lambertTerm;
+FragColour = vec4(colour, 1);
+}
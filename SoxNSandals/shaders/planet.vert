@@ -0,0 +1,81 @@
+// the planet surface's vertex shader (see PlanetRenderer). each instance is a patch of a face
+// of a cube blown out into a sphere, and each vertex a point of its 33 by 33 grid found from
+// its index. the vertex is lifted by noise along its direction from the centre, the same
+// noise the patch's bounds allow for, and its normal comes from the noise either side
+#version 410
+layout(location = 0) in vec4 Patch; // the face's u and v at the patch's corner, its size and the face
+layout(location = 1) in vec4 Planet; // the planet's centre and radius
+layout(location = 2) in vec4 Colour;
+layout(location = 3) in vec4 Surface; // how high the noise lifts, as a share of the radius, and its seed
+
+out vec3 vNormal;
+out vec4 vPosition;
+out vec4 vColour;
+out float vHeight; // the noise, -1 to 1
+
+#include "frameData.glsl"
+
+const int GRID = 32; // quads along each side of a patch
+const int OCTAVES = 9;
+
+// each face's normal and the two directions across it, u cross v being the normal
+const vec3 FACE_NORMALS[6] = vec3[6](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 FACE_US[6] = vec3[6](vec3(0, 0, -1), vec3(0, 0, 1), vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0), vec3(-1, 0, 0));
+const vec3 FACE_VS[6] = vec3[6](vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 0, -1), vec3(0, 0, 1), vec3(0, 1, 0), vec3(0, 1, 0));
+
+float hash(vec3 p) {
+p = fract(p * 0.3183099 + 0.1);
+p *= 17.0;
+return fract(p.x * p.y * p.z * (p.x + p.y + p.z));
+}
+
+// value noise from -1 to 1, smoothly between the lattice's corners
+float noise(vec3 p) {
+vec3 i = floor(p);
+vec3 f = fract(p);
+f = f * f * (3 - 2 * f);
+float a = mix(hash(i), hash(i + vec3(1, 0, 0)), f.x);
+float b = mix(hash(i + vec3(0, 1, 0)), hash(i + vec3(1, 1, 0)), f.x);
+float c = mix(hash(i + vec3(0, 0, 1)), hash(i + vec3(1, 0, 1)), f.x);
+float d = mix(hash(i + vec3(0, 1, 1)), hash(i + vec3(1, 1, 1)), f.x);
+return mix(mix(a, b, f.y), mix(c, d, f.y), f.z) * 2 - 1;
+}
+
+// octaves of noise halving as they double, kept within -1 to 1
+float height(vec3 direction) {
+vec3 p = direction * 2 + Surface.y;
+float sum = 0;
+float amplitude = 0.5;
+for (int i = 0; i < OCTAVES; ++i) {
+sum += noise(p) * amplitude;
+p = p * 2.03 + vec3(1.7, 9.2, 3.1);
+amplitude *= 0.5;
+}
+return sum;
+}
+
+vec3 surfacePoint(vec3 direction, out float noise) {
+noise = height(direction);
+return direction * (1 + Surface.x * noise);
+}
+
+void main() {
+int face = int(Patch.w);
+vec2 grid = vec2(gl_VertexID % (GRID + 1), gl_VertexID / (GRID + 1)) / GRID;
+vec2 coord = Patch.xy + grid * Patch.z;
+vec3 direction = normalize(FACE_NORMALS[face] + FACE_US[face] * coord.x + FACE_VS[face] * coord.y);
+
+// the surface a tenth of a quad either side, on the unit sphere
+float offset = Patch.z / GRID * 0.1;
+vec3 tangentU = normalize(cross(FACE_VS[face], direction));
+vec3 tangentV = normalize(cross(direction, tangentU));
+float unused;
+vec3 point = surfacePoint(direction, vHeight);
+vec3 du = surfacePoint(normalize(direction + tangentU * offset), unused) - surfacePoint(normalize(direction - tangentU * offset), unused);
+vec3 dv = surfacePoint(normalize(direction + tangentV * offset), unused) - surfacePoint(normalize(direction - tangentV * offset), unused);
+
+vNormal = normalize(cross(du, dv));
+vColour = Colour;
+vPosition = vec4(Planet.xyz + point * Planet.w, 1);
+gl_Position = ProjectionView * vPosition;
+}
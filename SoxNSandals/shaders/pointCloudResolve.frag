@@ -0,0 +1,25 @@
+// Frag Shader
+#version 450
+
+// Writes what a PointCloud's raster passes left into the framebuffer,
+//	depth tested against the scene. Pixels no point reached have no alpha
+//	and are discarded.
+
+uniform usampler2D Colours;
+uniform sampler2D Depths;
+
+// The bottom left of the viewport, which the images start at.
+uniform ivec2 ViewportOrigin;
+
+out vec4 FragColour;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy) - ViewportOrigin;
+	uint colour = texelFetch(Colours, pixel, 0).r;
+	if (colour == 0u)
+		discard;
+
+	FragColour = unpackUnorm4x8(colour);
+	gl_FragDepth = texelFetch(Depths, pixel, 0).r;
+}
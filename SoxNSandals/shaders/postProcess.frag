@@ -0,0 +1,110 @@
+// Frag Shader
+#version 410
+
+// Takes the scene from high dynamic range to the window, see
+//	PostProcess. Every texel read is exposed, tonemapped and graded as
+//	it is read, so FXAA works on the colours the window shows without a
+//	pass of their own.
+//
+// The bloom's glow is added before the tonemap. It is blurred far wider
+//	than FXAA reaches, so the pixel's own glow is read once and added to
+//	every tap.
+
+uniform sampler2D Scene;
+uniform sampler2D Bloom;
+
+// The window pixel the viewport starts at, a window pixel to the
+//	scene's texture coordinates, the furthest coordinate FXAA reads and
+//	a texel of the scene.
+uniform vec2 Viewport;
+uniform vec2 SourceScale;
+uniform vec2 SourceMax;
+uniform vec2 TexelSize;
+
+uniform float Exposure;
+uniform float Saturation;
+uniform float Contrast;
+uniform vec3 Tint;
+
+// Whether FXAA smooths the edges.
+uniform int Fxaa;
+
+// How much of the glow is added, 0 without it, and the scene's texture
+//	coordinates to the glow's.
+uniform float BloomIntensity;
+uniform vec2 BloomScale;
+
+out vec4 FragColour;
+
+// FXAA skips pixels whose contrast is under the larger of these, and
+//	searches at most SPAN_MAX texels along an edge.
+const float EDGE_THRESHOLD = 1.0 / 8.0;
+const float EDGE_THRESHOLD_MIN = 1.0 / 24.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+const float SPAN_MAX = 8.0;
+
+const vec3 LUMINANCE = vec3(0.299, 0.587, 0.114);
+
+// Narkowicz's fit of the ACES filmic curve.
+vec3 tonemap(vec3 colour)
+{
+	return clamp(colour * (2.51 * colour + 0.03) / (colour * (2.43 * colour + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 grade(vec3 colour)
+{
+	colour = mix(vec3(dot(colour, LUMINANCE)), colour, Saturation);
+	colour = (colour - 0.5) * Contrast + 0.5;
+	return clamp(colour * Tint, 0.0, 1.0);
+}
+
+// The pixel's glow, already exposed.
+vec3 glow;
+
+// The scene as the window shows it, at a texture coordinate.
+vec3 shown(vec2 coordinate)
+{
+	vec3 scene = texture(Scene, min(coordinate, SourceMax)).rgb;
+	return grade(tonemap(max(scene, 0.0) * Exposure + glow));
+}
+
+void main()
+{
+	vec2 coordinate = (gl_FragCoord.xy - Viewport) * SourceScale;
+	glow = BloomIntensity > 0.0 ? texture(Bloom, coordinate * BloomScale).rgb * BloomIntensity : vec3(0.0);
+	vec3 centre = shown(coordinate);
+	if (Fxaa == 0)
+	{
+		FragColour = vec4(centre, 1);
+		return;
+	}
+
+	// The corners half a texel out, each the average of four texels.
+	float lumaNW = dot(shown(coordinate + vec2(-0.5, 0.5) * TexelSize), LUMINANCE);
+	float lumaNE = dot(shown(coordinate + vec2(0.5, 0.5) * TexelSize), LUMINANCE);
+	float lumaSW = dot(shown(coordinate + vec2(-0.5, -0.5) * TexelSize), LUMINANCE);
+	float lumaSE = dot(shown(coordinate + vec2(0.5, -0.5) * TexelSize), LUMINANCE);
+	float lumaM = dot(centre, LUMINANCE);
+	float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+	float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+	if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+	{
+		FragColour = vec4(centre, 1);
+		return;
+	}
+
+	// Along the edge, the gradient turned a quarter.
+	vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+	float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+	float scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + reduce);
+	direction = clamp(direction * scale, -SPAN_MAX, SPAN_MAX) * TexelSize;
+
+	// Two taps close along it, and two more further out, which are only
+	//	kept if they don't cross into another edge.
+	vec3 inner = 0.5 * (shown(coordinate + direction * (1.0 / 3.0 - 0.5)) +
+		shown(coordinate + direction * (2.0 / 3.0 - 0.5)));
+	vec3 outer = inner * 0.5 + 0.25 * (shown(coordinate - direction * 0.5) + shown(coordinate + direction * 0.5));
+	float lumaOuter = dot(outer, LUMINANCE);
+	FragColour = vec4(lumaOuter < lumaMin || lumaOuter > lumaMax ? inner : outer, 1);
+}
@@ -0,0 +1,52 @@
+// the irradiance probes as ProbeVolume traces them, included after sceneTrace.glsl by the compute
+// shaders that update them. each probe's red, green and blue are blocks of the image stacked along
+// z, each texel the light's constant band in x and its linear band along a normal in yzw, so the
+// light on a normal is dot(texel, vec4(1, normal))
+layout(rgba16f, binding = 0) uniform image3D Irradiance;
+
+// how many probes are along each side, where the first is and how far apart they are
+uniform vec3 ProbeCounts;
+uniform vec3 ProbeMin;
+uniform vec3 ProbeSpacing;
+
+// turns the rays of each round a different way
+uniform int Seed;
+
+// the probes' light on a surface, blended between the eight around it
+vec3 probeLight(vec3 a_position, vec3 a_normal)
+{
+	ivec3 counts = ivec3(ProbeCounts + 0.5);
+	vec3 grid = clamp((a_position - ProbeMin) / ProbeSpacing, vec3(0), ProbeCounts - 1.0);
+	ivec3 low = min(ivec3(grid), counts - 2);
+	vec3 t = grid - vec3(low);
+
+	vec4 red = vec4(0), green = vec4(0), blue = vec4(0);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		ivec3 offset = ivec3(corner & 1, (corner >> 1) & 1, corner >> 2);
+		vec3 weights = mix(1.0 - t, t, vec3(offset));
+		float weight = weights.x * weights.y * weights.z;
+		ivec3 probe = low + offset;
+		red += weight * imageLoad(Irradiance, probe);
+		green += weight * imageLoad(Irradiance, probe + ivec3(0, 0, counts.z));
+		blue += weight * imageLoad(Irradiance, probe + ivec3(0, 0, counts.z * 2));
+	}
+	vec4 n = vec4(1, a_normal);
+	return max(vec3(dot(red, n), dot(green, n), dot(blue, n)), vec3(0));
+}
+
+// what a ray brings back, the sky if it leaves the scene and otherwise the surface's emission and
+// its albedo times the sun and the probes' light where it hits
+vec3 traceRadiance(vec3 a_origin, vec3 a_direction, inout uint a_state)
+{
+	int hit;
+	float hitDistance = trace(a_origin, a_direction, 1e30, false, hit);
+	if (hitDistance < 0.0)
+		return SkyColour;
+
+	Material material = hitMaterial(hit);
+	vec3 position = a_origin + a_direction * hitDistance;
+	vec3 normal = hitNormal(hit, a_direction);
+	vec3 light = sunLight(position, normal, a_state) + probeLight(position + normal * RayBias, normal);
+	return material.emission.rgb + material.albedo.rgb * light;
+}
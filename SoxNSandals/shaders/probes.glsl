@@ -0,0 +1,47 @@
+// the irradiance and reflection probes (see ProbeVolume), for the lit fragment shaders lighting
+// what moves through the static scene. the light on a normal from a texel of the irradiance
+// probes is dot(texel, vec4(1, normal)), its red, green and blue blocks stacked along z
+uniform sampler3D ProbeIrradiance;
+uniform samplerCubeArray ReflectionProbes;
+
+// how many probes are along each side, where the first is and how far apart they are
+uniform vec3 ProbeCounts;
+uniform vec3 ProbeMin;
+uniform vec3 ProbeSpacing;
+
+// must match ProbeVolume
+#define MAX_REFLECTION_PROBES 8
+uniform vec4 ReflectionProbePositions[MAX_REFLECTION_PROBES];
+uniform int ReflectionProbeCount;
+uniform float ReflectionLevels;
+
+// the probes' light on a surface, from a quarter of the way to the next probe along its normal so
+// a probe just behind it doesn't darken it
+vec3 probeIrradiance(vec3 position, vec3 normal) {
+vec3 grid = clamp((position - ProbeMin) / ProbeSpacing + normal * 0.25 + 0.5, vec3(0.5), ProbeCounts - 0.5);
+vec3 uvw = grid / vec3(ProbeCounts.xy, ProbeCounts.z * 3);
+vec4 n = vec4(1, normal);
+vec3 light = vec3(dot(texture(ProbeIrradiance, uvw), n),
+dot(texture(ProbeIrradiance, uvw + vec3(0, 0, 1.0 / 3.0)), n),
+dot(texture(ProbeIrradiance, uvw + vec3(0, 0, 2.0 / 3.0)), n));
+return max(light, vec3(0));
+}
+
+// what the nearest reflection probe sees along a reflected direction, blurrier the lower the
+// specular power
+vec3 probeReflection(vec3 position, vec3 direction, float power) {
+if (ReflectionProbeCount == 0)
+return vec3(0);
+int nearest = 0;
+float nearestDistance = 1e30;
+for (int i = 0; i < ReflectionProbeCount; ++i) {
+vec3 offset = ReflectionProbePositions[i].xyz - position;
+float d = dot(offset, offset);
+if (d < nearestDistance) {
+nearestDistance = d;
+nearest = i;
+}
+}
+float level = (ReflectionLevels - 1) * (1 - clamp(log2(max(power, 1)) / 11, 0, 1));
+return textureLod(ReflectionProbes, vec4(direction, nearest), level).rgb;
+}
@@ -0,0 +1,179 @@
+// the static scene as TraceScene uploads it, included by the compute shaders that trace rays
+// through it. its triangles are walked through the Bvh's nodes of four as they are on the cpu,
+// the leaves indexing the triangles in leaf order. what includes it sets SunDirection,
+// SunColour, SkyColour and RayBias, and traces with trace() and sunLight()
+#define STACK_SIZE 64
+#define PI 3.14159265
+
+// the sun's disc, so its shadows soften with distance
+#define SUN_ANGULAR_RADIUS 0.01
+
+struct Node
+{
+	vec4 minX, minY, minZ;
+	vec4 maxX, maxY, maxZ;
+	ivec4 first;
+	uvec4 count;
+};
+
+struct Triangle
+{
+	// the material in corner's w, as bits
+	vec4 corner;
+	vec4 edge1;
+	vec4 edge2;
+};
+
+struct Material
+{
+	vec4 albedo;
+	vec4 emission;
+};
+
+// must match TraceScene
+layout(std430, binding = 1) readonly buffer Nodes { Node nodes[]; };
+layout(std430, binding = 2) readonly buffer Triangles { Triangle triangles[]; };
+layout(std430, binding = 3) readonly buffer Materials { Material materials[]; };
+
+// the way to the sun, and what it and the sky light with
+uniform vec3 SunDirection;
+uniform vec3 SunColour;
+uniform vec3 SkyColour;
+
+// how far off a surface a ray starts
+uniform float RayBias;
+
+// a pcg hash, as Jarzynski and Olano pick for shaders
+uint pcg(uint a_value)
+{
+	uint state = a_value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float random(inout uint a_state)
+{
+	a_state = pcg(a_state);
+	return float(a_state >> 8) * (1.0 / 16777216.0);
+}
+
+// two unit vectors at right angles to a normal
+void basis(vec3 a_normal, out vec3 a_tangent, out vec3 a_bitangent)
+{
+	a_tangent = normalize(cross(abs(a_normal.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0), a_normal));
+	a_bitangent = cross(a_normal, a_tangent);
+}
+
+// a direction around a normal, as likely as its cosine
+vec3 cosineSample(vec3 a_normal, inout uint a_state)
+{
+	vec3 tangent, bitangent;
+	basis(a_normal, tangent, bitangent);
+	float u = random(a_state);
+	float phi = 2.0 * PI * random(a_state);
+	float r = sqrt(u);
+	return normalize(tangent * (r * cos(phi)) + bitangent * (r * sin(phi)) + a_normal * sqrt(max(0.0, 1.0 - u)));
+}
+
+// how far along a ray it hits a triangle, or a negative for a miss
+float intersectTriangle(vec3 a_origin, vec3 a_direction, Triangle a_triangle, float a_maxDistance)
+{
+	vec3 edge1 = a_triangle.edge1.xyz;
+	vec3 edge2 = a_triangle.edge2.xyz;
+	vec3 p = cross(a_direction, edge2);
+	float determinant = dot(edge1, p);
+	if (determinant == 0.0)
+		return -1.0;
+
+	float inverse = 1.0 / determinant;
+	vec3 s = a_origin - a_triangle.corner.xyz;
+	float u = dot(s, p) * inverse;
+	if (u < 0.0 || u > 1.0)
+		return -1.0;
+	vec3 q = cross(s, edge1);
+	float v = dot(a_direction, q) * inverse;
+	if (v < 0.0 || u + v > 1.0)
+		return -1.0;
+	float t = dot(edge2, q) * inverse;
+	return t >= 0.0 && t <= a_maxDistance ? t : -1.0;
+}
+
+// walks the nodes for the closest triangle a ray hits, or with a_any for any it hits at all.
+// a_triangle is the one hit, and the distance is returned, negative for a miss
+float trace(vec3 a_origin, vec3 a_direction, float a_maxDistance, bool a_any, out int a_triangle)
+{
+	vec3 inverse = 1.0 / mix(a_direction, vec3(1e-8), lessThan(abs(a_direction), vec3(1e-8)));
+	float closest = a_maxDistance;
+	a_triangle = -1;
+
+	int stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		Node node = nodes[stack[--top]];
+		vec4 x0 = (node.minX - a_origin.x) * inverse.x, x1 = (node.maxX - a_origin.x) * inverse.x;
+		vec4 y0 = (node.minY - a_origin.y) * inverse.y, y1 = (node.maxY - a_origin.y) * inverse.y;
+		vec4 z0 = (node.minZ - a_origin.z) * inverse.z, z1 = (node.maxZ - a_origin.z) * inverse.z;
+		vec4 entry = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), vec4(0.0)));
+		vec4 leave = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), vec4(closest)));
+
+		for (int slot = 0; slot < 4; ++slot)
+		{
+			if (node.first[slot] < 0 || entry[slot] > leave[slot])
+				continue;
+
+			// a child node is walked later, a leaf's triangles now
+			if (node.count[slot] == 0u)
+			{
+				if (top < STACK_SIZE)
+					stack[top++] = node.first[slot];
+				continue;
+			}
+			int last = node.first[slot] + int(node.count[slot]);
+			for (int i = node.first[slot]; i < last; ++i)
+			{
+				float t = intersectTriangle(a_origin, a_direction, triangles[i], closest);
+				if (t < 0.0)
+					continue;
+				closest = t;
+				a_triangle = i;
+				if (a_any)
+					return t;
+			}
+		}
+	}
+	return a_triangle >= 0 ? closest : -1.0;
+}
+
+// the sun's light on a surface, through a shadow ray to a point of its disc
+vec3 sunLight(vec3 a_position, vec3 a_normal, inout uint a_state)
+{
+	float cosine = dot(a_normal, SunDirection);
+	if (cosine <= 0.0)
+		return vec3(0);
+
+	vec3 tangent, bitangent;
+	basis(SunDirection, tangent, bitangent);
+	float r = sqrt(random(a_state)) * SUN_ANGULAR_RADIUS;
+	float phi = 2.0 * PI * random(a_state);
+	vec3 direction = normalize(SunDirection + tangent * (r * cos(phi)) + bitangent * (r * sin(phi)));
+
+	int triangle;
+	if (trace(a_position + a_normal * RayBias, direction, 1e30, true, triangle) >= 0.0)
+		return vec3(0);
+	return SunColour * cosine;
+}
+
+// a hit triangle's material, and its face towards where the ray came from
+Material hitMaterial(int a_triangle)
+{
+	return materials[floatBitsToUint(triangles[a_triangle].corner.w)];
+}
+
+vec3 hitNormal(int a_triangle, vec3 a_direction)
+{
+	Triangle triangle = triangles[a_triangle];
+	vec3 normal = normalize(cross(triangle.edge1.xyz, triangle.edge2.xyz));
+	return dot(normal, a_direction) > 0.0 ? -normal : normal;
+}
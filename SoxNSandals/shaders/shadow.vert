@@ -0,0 +1,12 @@
+// a shadow map vertex shader, drawn from the light with depthAlpha.frag so cut out materials cast cut out shadows
+#version 430
+layout( location = 0 ) in vec4 Position;
+layout( location = 2 ) in vec2 TexCoord;
+out vec2 vTexCoord;
+#include "object.glsl"
+// the light's projection view for the cascade
+uniform mat4 LightProjectionView;
+void main() {
+vTexCoord = TexCoord;
+gl_Position = LightProjectionView * (objects[ObjectIndex].model * Position);
+}
\ No newline at end of file
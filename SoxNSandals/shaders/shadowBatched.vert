@@ -0,0 +1,14 @@
+// a shadow map vertex shader for meshes drawn by a MeshBatch, drawn with depthAlphaBatched.frag
+#version 430
+layout( location = 0 ) in vec4 Position;
+layout( location = 2 ) in vec2 TexCoord;
+#include "meshBatch.glsl"
+out vec2 vTexCoord;
+flat out vec4 vLayers;
+// the light's projection view for the cascade
+uniform mat4 LightProjectionView;
+void main() {
+vTexCoord = TexCoord;
+vLayers = vec4(materials[InstanceMaterial].layers);
+gl_Position = LightProjectionView * (InstanceModel * Position);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+// a shadow map vertex shader for instanced meshes, each instance brings its own model matrix
+#version 410
+layout( location = 0 ) in vec4 Position;
+layout( location = 2 ) in vec2 TexCoord;
+// filled from the mesh's instance buffer, see OBJMesh::drawInstanced
+layout( location = 4 ) in mat4 InstanceModel;
+out vec2 vTexCoord;
+// the light's projection view for the cascade
+uniform mat4 LightProjectionView;
+void main() {
+vTexCoord = TexCoord;
+gl_Position = LightProjectionView * (InstanceModel * Position);
+}
\ No newline at end of file
@@ -1,11 +0,0 @@
-// a simple flat colour shader
-#version 410
-
-uniform vec3 Kd;
-
-out vec4 FragColour;
-
-void main()
-{
-    FragColour = vec4(Kd, 1);
-}
\ No newline at end of file
@@ -1,10 +0,0 @@
-// a simple shader
-#version 410
-
-layout( location = 0) in vec4 Position;
-
-uniform mat4 ProjectionViewModel;
-
-void main(){
-    gl_Position = ProjectionViewModel * Position;
-}
\ No newline at end of file
@@ -0,0 +1,52 @@
+// Frag Shader
+#version 410
+
+// Draws the sky behind the scene, see Sky. The way the pixel looks is
+//	turned into the sky view table's coordinates by how far up it is and
+//	how far around from the sun, which is one filtered read. The sun's
+//	disc is added over it, dimmed by the air in front of it.
+
+#include "sky.glsl"
+
+uniform sampler2D SkyViewTable;
+uniform sampler2D TransmittanceTable;
+
+// From the view's clip space back to the way it looks in the world.
+uniform mat4 InverseProjection;
+uniform mat4 InverseView;
+
+// The way to the sun, what it lights the scene by, and how much brighter
+//	its disc is than that.
+uniform vec3 SunDirection;
+uniform vec3 SunColour;
+uniform float SunDiscRadiance;
+
+in vec2 vNdc;
+
+out vec4 FragColour;
+
+// The cosine of the sun's angular radius, a little over a quarter of a
+//	degree, and the edge it fades out over.
+const float SUN_COSINE = 0.99998918;
+const float SUN_EDGE = 0.000004;
+
+void main()
+{
+	vec4 ray = InverseProjection * vec4(vNdc, 0.5, 1.0);
+	vec3 direction = normalize(mat3(InverseView) * (ray.xyz / ray.w));
+
+	// Around from the sun is measured flat, so straight up and down are
+	//	the same from every way.
+	float r = GROUND_RADIUS + CAMERA_HEIGHT;
+	vec2 level = direction.xz;
+	vec2 sunLevel = SunDirection.xz;
+	float levelLength = length(level) * length(sunLevel);
+	float azimuthCosine = levelLength > 1e-6 ? dot(level, sunLevel) / levelLength : 1.0;
+	vec3 sky = texture(SkyViewTable, skyViewCoord(r, direction.y, azimuthCosine)).rgb;
+
+	float disc = smoothstep(SUN_COSINE - SUN_EDGE, SUN_COSINE, dot(direction, SunDirection));
+	if (disc > 0.0)
+		sky += disc * SunDiscRadiance * sunTransmittance(TransmittanceTable, r, direction.y);
+
+	FragColour = vec4(sky * SunColour, 1);
+}
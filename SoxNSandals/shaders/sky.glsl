@@ -0,0 +1,151 @@
+// the atmosphere the sky is drawn through (see Sky), included by the passes that build its
+// tables, the one that draws it and those that reflect it. distances are in kilometres, from
+// the centre of an earth sized planet, with y up at the camera. the constants are Hillaire's,
+// from his 2020 paper
+const float PI = 3.14159265;
+const float GROUND_RADIUS = 6360.0;
+const float TOP_RADIUS = 6460.0;
+
+// scattering and extinction per kilometre at the ground, and how high each halves by e
+const vec3 RAYLEIGH_SCATTERING = vec3(5.802, 13.558, 33.1) * 1e-3;
+const float RAYLEIGH_HEIGHT = 8.0;
+const float MIE_SCATTERING = 3.996e-3;
+const float MIE_EXTINCTION = 4.44e-3;
+const float MIE_HEIGHT = 1.2;
+const float MIE_ANISOTROPY = 0.8;
+
+// ozone only absorbs, in a layer thickest at 25 kilometres and gone 15 either side
+const vec3 OZONE_ABSORPTION = vec3(0.650, 1.881, 0.085) * 1e-3;
+const float OZONE_CENTRE = 25.0;
+const float OZONE_WIDTH = 15.0;
+
+// the table sizes, which Sky makes them
+const vec2 TRANSMITTANCE_SIZE = vec2(256, 64);
+const vec2 MULTI_SCATTERING_SIZE = vec2(32, 32);
+const vec2 SKY_VIEW_SIZE = vec2(192, 108);
+
+// how high above the ground the sky is seen from
+const float CAMERA_HEIGHT = 0.2;
+
+// what the air at a height scatters, each of rayleigh and mie, and takes out in all
+struct Medium {
+vec3 rayleigh;
+float mie;
+vec3 extinction;
+};
+
+Medium sampleMedium(float height) {
+Medium medium;
+float rayleighDensity = exp(-height / RAYLEIGH_HEIGHT);
+float mieDensity = exp(-height / MIE_HEIGHT);
+float ozoneDensity = max(0, 1 - abs(height - OZONE_CENTRE) / OZONE_WIDTH);
+medium.rayleigh = RAYLEIGH_SCATTERING * rayleighDensity;
+medium.mie = MIE_SCATTERING * mieDensity;
+medium.extinction = medium.rayleigh + MIE_EXTINCTION * mieDensity + OZONE_ABSORPTION * ozoneDensity;
+return medium;
+}
+
+float rayleighPhase(float cosine) {
+return 3 / (16 * PI) * (1 + cosine * cosine);
+}
+
+// cornette-shanks, which is henyey-greenstein that also brightens straight back a little
+float miePhase(float cosine) {
+float g = MIE_ANISOTROPY;
+float g2 = g * g;
+float k = 3 / (8 * PI) * (1 - g2) / (2 + g2);
+return k * (1 + cosine * cosine) / pow(max(1 + g2 - 2 * g * cosine, 1e-4), 1.5);
+}
+
+// how far along a ray from a point at a radius, going up by mu, it leaves a sphere, or -1
+// if it misses it or the sphere is behind
+float intersectSphere(float r, float mu, float radius) {
+float b = r * mu;
+float discriminant = b * b - r * r + radius * radius;
+if (discriminant < 0)
+return -1;
+float root = sqrt(discriminant);
+float near = -b - root;
+float far = -b + root;
+if (far < 0)
+return -1;
+return near > 0 ? near : far;
+}
+
+// whether a ray from a radius up by mu hits the ground before the top of the atmosphere
+bool hitsGround(float r, float mu) {
+return mu < 0 && r * r * (mu * mu - 1) + GROUND_RADIUS * GROUND_RADIUS >= 0;
+}
+
+// bruneton's mapping of a radius and mu to the transmittance table, which spends its texels
+// on rays that graze the horizon
+vec2 transmittanceCoord(float r, float mu) {
+float h = sqrt(TOP_RADIUS * TOP_RADIUS - GROUND_RADIUS * GROUND_RADIUS);
+float rho = sqrt(max(r * r - GROUND_RADIUS * GROUND_RADIUS, 0));
+float discriminant = r * r * (mu * mu - 1) + TOP_RADIUS * TOP_RADIUS;
+float d = max(-r * mu + sqrt(max(discriminant, 0)), 0);
+float dMin = TOP_RADIUS - r;
+float dMax = rho + h;
+return vec2((d - dMin) / (dMax - dMin), rho / h);
+}
+
+// and back, the radius in x and mu in y
+vec2 transmittanceRay(vec2 coord) {
+float h = sqrt(TOP_RADIUS * TOP_RADIUS - GROUND_RADIUS * GROUND_RADIUS);
+float rho = h * coord.y;
+float r = sqrt(rho * rho + GROUND_RADIUS * GROUND_RADIUS);
+float dMin = TOP_RADIUS - r;
+float dMax = rho + h;
+float d = dMin + coord.x * (dMax - dMin);
+float mu = d == 0 ? 1 : (h * h - rho * rho - d * d) / (2 * r * d);
+return vec2(r, clamp(mu, -1, 1));
+}
+
+// how much of the sun reaches a radius with it up by mu, none once the ground is in the way
+vec3 sunTransmittance(sampler2D table, float r, float mu) {
+if (hitsGround(r, mu))
+return vec3(0);
+return texture(table, transmittanceCoord(r, mu)).rgb;
+}
+
+// the multiple scattering table is the sun's mu across and the height up
+vec2 multiScatteringCoord(float r, float mu) {
+vec2 coord = vec2(mu * 0.5 + 0.5, (r - GROUND_RADIUS) / (TOP_RADIUS - GROUND_RADIUS));
+return clamp(coord, 0.5 / MULTI_SCATTERING_SIZE, 1 - 0.5 / MULTI_SCATTERING_SIZE);
+}
+
+// the sky view table is around from the sun across, a half turn as the sky is the same either
+// side of it, and down from straight up. the horizon is halfway, and the rows are packed
+// towards it either side, where the sky changes the most
+vec2 skyViewCoord(float r, float viewMu, float azimuthCosine) {
+float horizon = sqrt(max(r * r - GROUND_RADIUS * GROUND_RADIUS, 0));
+float beta = acos(clamp(horizon / r, -1, 1));
+float zenithHorizon = PI - beta;
+float zenith = acos(clamp(viewMu, -1, 1));
+float v;
+if (zenith < zenithHorizon) {
+float c = 1 - sqrt(max(1 - zenith / zenithHorizon, 0));
+v = 0.5 * c;
+} else {
+float c = sqrt((zenith - zenithHorizon) / beta);
+v = 0.5 + 0.5 * c;
+}
+float u = acos(clamp(azimuthCosine, -1, 1)) / PI;
+return vec2(u, v);
+}
+
+// and back, the view's zenith angle in x and its angle around from the sun in y
+vec2 skyViewAngles(float r, vec2 coord) {
+float horizon = sqrt(max(r * r - GROUND_RADIUS * GROUND_RADIUS, 0));
+float beta = acos(clamp(horizon / r, -1, 1));
+float zenithHorizon = PI - beta;
+float zenith;
+if (coord.y < 0.5) {
+float c = 1 - coord.y * 2;
+zenith = zenithHorizon * (1 - c * c);
+} else {
+float c = coord.y * 2 - 1;
+zenith = zenithHorizon + beta * c * c;
+}
+return vec2(zenith, coord.x * PI);
+}
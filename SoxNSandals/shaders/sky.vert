@@ -0,0 +1,15 @@
+// Vert Shader
+#version 410
+
+// One triangle over the whole view, see Sky, at the far depth so it
+//	only covers what nothing else was drawn over.
+uniform float FarDepth;
+
+out vec2 vNdc;
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	vNdc = corner * 2.0 - 1.0;
+	gl_Position = vec4(vNdc, FarDepth, 1);
+}
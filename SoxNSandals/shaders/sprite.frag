@@ -0,0 +1,29 @@
+// a SpriteBatch's sprite, its texture tinted by its colour and blended by alpha, or a distance
+// field glyph in its colour inside the field's edge
+#version 410
+in vec2 vTexCoord;
+in vec4 vColour;
+flat in float vDistanceRange;
+out vec4 FragColour;
+
+uniform sampler2D SpriteTexture;
+
+// the distance of a multi-channel field, which is the same channel three times for a single one
+float median(vec3 v) {
+return max(min(v.r, v.g), min(max(v.r, v.g), v.b));
+}
+
+void main() {
+vec4 texel = texture(SpriteTexture, vTexCoord);
+// the derivatives are taken before branching on the sprite
+vec2 screenTexels = vec2(1.0) / fwidth(vTexCoord);
+if (vDistanceRange <= 0) {
+FragColour = texel * vColour;
+return;
+}
+// how many pixels the field's range covers on screen, so the edge is antialiased over one pixel
+vec2 unitRange = vec2(vDistanceRange) / vec2(textureSize(SpriteTexture, 0));
+float screenRange = max(0.5 * dot(unitRange, screenTexels), 1.0);
+float coverage = clamp(screenRange * (median(texel.rgb) - 0.5) + 0.5, 0.0, 1.0);
+FragColour = vec4(vColour.rgb, vColour.a * coverage);
+}
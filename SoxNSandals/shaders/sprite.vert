@@ -0,0 +1,27 @@
+// the vertex shader of a SpriteBatch's sprites, an instance a sprite and its four corners from
+// gl_VertexID, drawn as a triangle strip with sprite.frag
+#version 410
+// filled from the batch's stream (see SpriteBatch::create)
+layout( location = 0 ) in vec4 CentreSize;
+layout( location = 1 ) in vec4 TexCoords;
+layout( location = 2 ) in vec4 Colour;
+// the rotation, and the distance range of a distance field glyph or 0
+layout( location = 3 ) in vec2 RotationRange;
+out vec2 vTexCoord;
+out vec4 vColour;
+flat out float vDistanceRange;
+
+uniform mat4 Projection;
+
+void main() {
+vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+vec2 offset = (corner - 0.5) * CentreSize.zw;
+// turned anticlockwise about the centre
+float c = cos(RotationRange.x);
+float s = sin(RotationRange.x);
+offset = vec2(offset.x * c - offset.y * s, offset.x * s + offset.y * c);
+vTexCoord = mix(TexCoords.xy, TexCoords.zw, corner);
+vColour = Colour;
+vDistanceRange = RotationRange.y;
+gl_Position = Projection * vec4(CentreSize.xy + offset, 0, 1);
+}
@@ -0,0 +1,91 @@
+// Frag Shader
+#version 410
+
+// Rebuilds a window pixel from the scene drawn at a smaller size, see
+//	TemporalUpsampler. Each texel of the scene was shaded at one point
+//	this frame, Sample texels from its centre. The window pixel that
+//	point is in takes it, every other one reprojects into the history,
+//	clamped to the colours of the texels around it. Drawn at the
+//	window's size, every pixel blends its sample into the history.
+
+uniform sampler2D Colour;
+uniform sampler2D Depth;
+uniform sampler2D History;
+
+// Whether the history holds last frame, it doesn't on the first.
+uniform int HistoryValid;
+
+// How much of the scene target was drawn into, and the window's size.
+uniform vec2 RenderSize;
+uniform vec2 WindowSize;
+
+// Where this frame's sample is in each texel, from its centre.
+uniform vec2 Sample;
+
+// Turns depth into ndc z, as depth * x + y.
+uniform vec2 DepthToNdc;
+
+// From this frame's ndc to last frame's clip space.
+uniform mat4 Reprojection;
+
+// Whether anything moved since last frame. Nothing did, the history is
+//	exactly what was sampled before and is taken as it is.
+uniform int ClampHistory;
+
+// How much of this frame a pixel its sample landed in takes. 1 while
+//	upsampling, less at the window's size, where every pixel gets a
+//	sample every frame and the history smooths its edges instead.
+uniform float Blend;
+
+out vec4 FragColour;
+
+void main()
+{
+	vec2 ratio = RenderSize / WindowSize;
+	ivec2 last = ivec2(RenderSize) - 1;
+	ivec2 texel = clamp(ivec2(gl_FragCoord.xy * ratio), ivec2(0), last);
+	vec4 current = texelFetch(Colour, texel, 0);
+
+	// The window pixel this texel's sample landed in.
+	vec2 samplePixel = (vec2(texel) + 0.5 + Sample) / ratio;
+	bool landed = all(equal(floor(samplePixel), floor(gl_FragCoord.xy)));
+	if (HistoryValid == 0 || (landed && Blend >= 1.0))
+	{
+		FragColour = current;
+		return;
+	}
+
+	// Where the pixel was last frame, from the depth of its texel.
+	float depth = texelFetch(Depth, texel, 0).r;
+	vec4 ndc = vec4(gl_FragCoord.xy / WindowSize * 2.0 - 1.0, depth * DepthToNdc.x + DepthToNdc.y, 1.0);
+	vec4 previous = Reprojection * ndc;
+	vec2 uv = previous.xy / previous.w * 0.5 + 0.5;
+	if (previous.w <= 0.0 || any(lessThan(uv, vec2(0))) || any(greaterThan(uv, vec2(1))))
+	{
+		FragColour = current;
+		return;
+	}
+
+	vec4 history = texture(History, uv);
+	if (ClampHistory == 0)
+	{
+		FragColour = landed ? mix(history, current, Blend) : history;
+		return;
+	}
+
+	// What was hidden last frame reprojects onto whatever hid it, which
+	//	is outside the colours around the pixel now, so is pulled in.
+	vec4 low = current;
+	vec4 high = current;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			vec4 neighbour = texelFetch(Colour, clamp(texel + ivec2(x, y), ivec2(0), last), 0);
+			low = min(low, neighbour);
+			high = max(high, neighbour);
+		}
+	}
+	history = clamp(history, low, high);
+	FragColour = landed ? mix(history, current, Blend) : history;
+}
@@ -0,0 +1,38 @@
+// the terrain's fragment shader (see Terrain). the normal comes from the heightmap around the
+// fragment and the colour from its slope and height, grass on the flat, rock on the steep and
+// snow on the highest. it is lit by the first light, shadowed, and the clustered lights
+#version 410
+in vec2 vTerrainCoord;
+in vec4 vPosition;
+
+out vec4 FragColour;
+
+#include "frameData.glsl"
+#include "lighting.glsl"
+
+uniform sampler2D Heightmap;
+uniform vec2 Scale;
+uniform vec2 TexelSize; // a texel of the heightmap, in coords
+
+void main() {
+// the height changes a texel either side, into a slope along x and z
+float left = texture(Heightmap, vTerrainCoord - vec2(TexelSize.x, 0)).r;
+float right = texture(Heightmap, vTerrainCoord + vec2(TexelSize.x, 0)).r;
+float back = texture(Heightmap, vTerrainCoord - vec2(0, TexelSize.y)).r;
+float front = texture(Heightmap, vTerrainCoord + vec2(0, TexelSize.y)).r;
+vec2 slope = vec2(right - left, front - back) * Scale.y / (2 * TexelSize * Scale.x);
+vec3 N = normalize(vec3(-slope.x, 1, -slope.y));
+
+float height = texture(Heightmap, vTerrainCoord).r;
+float steepness = 1 - N.y;
+vec3 diffuseColour = mix(vec3(0.18, 0.27, 0.1), vec3(0.32, 0.29, 0.26), smoothstep(0.2, 0.4, steepness));
+diffuseColour = mix(diffuseColour, vec3(0.85, 0.87, 0.9), smoothstep(0.7, 0.8, height) * (1 - smoothstep(0.3, 0.5, steepness)));
+
+vec3 V = normalize(CameraPosition.xyz - vPosition.xyz);
+vec3 L = normalize(Lights[0].LightDirection.xyz);
+float lambertTerm = max(0, dot(N, -L));
+vec3 colour = Lights[0].Ia.xyz * diffuseColour * ambientOcclusion();
+colour += Lights[0].Id.xyz * diffuseColour * lambertTerm * cascadeShadow();
+colour += clusterLighting(N, V, diffuseColour, vec3(0), 1);
+FragColour = vec4(applyFog(colour), 1);
+}
@@ -0,0 +1,12 @@
+// the terrain's vertex shader (see Terrain). it is drawn without vertices, each patch is
+// four of them and they are only its corners across the terrain, 0 to 1 from corner to corner
+#version 410
+out vec2 vTerrainCoord;
+uniform int Patches; // patches along each side
+void main() {
+int patchIndex = gl_VertexID / 4;
+int corner = gl_VertexID % 4;
+// the corners go (0,0) (1,0) (1,1) (0,1) around the patch
+ivec2 cell = ivec2(patchIndex % Patches, patchIndex / Patches) + ivec2(corner == 1 || corner == 2, corner >= 2);
+vTerrainCoord = vec2(cell) / float(Patches);
+}
@@ -1,14 +0,0 @@
-#version 410
-
-layout(location = 0) in vec4 Position;
-layout(location = 2) in vec2 TexCoord;
-
-out vec2 vTexCoord;
-
-uniform mat4 ProjectionViewModel;
-
-void main()
-{
-    vTexCoord = TexCoord;
-    gl_Position = ProjectionViewModel * Position;
-}
\ No newline at end of file
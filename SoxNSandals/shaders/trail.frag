@@ -0,0 +1,11 @@
+// Frag Shader
+#version 410
+
+in vec4 vColour;
+out vec4 FragColour;
+
+void main()
+{
+	// Premultiplied, blended with GL_ONE and GL_ONE_MINUS_SRC_ALPHA.
+	FragColour = vec4(vColour.rgb * vColour.a, vColour.a);
+}
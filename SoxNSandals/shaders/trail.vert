@@ -0,0 +1,72 @@
+// the ribbon trails' vertex shader (see TrailRenderer). each instance is a trail and each
+// pair of vertices one of its points, read from the ring buffer of every trail's history
+// and pushed out either side, across the trail and the direction to the camera
+#version 430
+
+// each record's point of every trail side by side, xyz the position and w how long its
+// trail had been going, below 0 for no trail
+layout(std430, binding = 4) buffer Points {
+vec4 points[];
+};
+
+uniform mat4 ProjectionView;
+uniform vec3 CameraPosition;
+
+uniform int TrailCount;
+uniform int History;
+uniform int Head; // the slot recorded last, the front of every trail
+uniform int Recorded;
+// how long before the front each slot was recorded, front first, up to TrailRenderer::MAX_HISTORY
+uniform float SegmentAges[64];
+
+uniform vec2 Width; // at the front and at the oldest point
+uniform vec4 FrontColour;
+uniform vec4 BackColour;
+
+out vec4 vColour;
+
+vec4 getPoint(int segment) {
+int slot = (Head - segment + History) % History;
+return points[slot * TrailCount + gl_InstanceID];
+}
+
+void main() {
+vec4 front = getPoint(0);
+if (front.w < 0.0) {
+// no trail, every vertex in one place draws nothing
+vColour = vec4(0);
+gl_Position = vec4(0, 0, 0, 1);
+return;
+}
+
+// the points recorded since the trail started are no further back than its age, the rest
+// are whatever the slot held before. the ages only grow going back, so the last of its own
+// is found by halving
+int first = 0;
+int last = Recorded - 1;
+while (first < last) {
+int middle = (first + last + 1) / 2;
+if (SegmentAges[middle] <= front.w + 1e-4)
+first = middle;
+else
+last = middle - 1;
+}
+int count = first;
+
+// past the trail's oldest point the strip folds onto it
+int segment = min(gl_VertexID / 2, count);
+vec3 position = getPoint(segment).xyz;
+vec3 before = getPoint(max(segment - 1, 0)).xyz;
+vec3 after = getPoint(min(segment + 1, count)).xyz;
+
+vec3 across = cross(before - after, CameraPosition - position);
+float lengthSquared = dot(across, across);
+across = lengthSquared > 1e-12 ? across * inversesqrt(lengthSquared) : vec3(0);
+
+float t = count > 0 ? float(segment) / float(count) : 0.0;
+float side = (gl_VertexID & 1) == 0 ? -0.5 : 0.5;
+position += across * (mix(Width.x, Width.y, t) * side);
+
+vColour = mix(FrontColour, BackColour, t);
+gl_Position = ProjectionView * vec4(position, 1);
+}
@@ -0,0 +1,53 @@
+// order independent transparency (see TransparencyTarget), included by the fragment shaders that
+// draw transparent surfaces in place of writing their colour. depth is tested before the shader
+// runs, so nothing hidden behind the scene is added to a list
+layout(early_fragment_tests) in;
+
+// the weighted method's targets, the weighted sum of premultiplied colours and the product of
+// every transparency in front of the scene
+layout( location = 0 ) out vec4 TransparentAccumulation;
+layout( location = 1 ) out float TransparentRevealage;
+
+// 0 for weighted blended, 1 for per-pixel linked lists
+uniform int TransparencyMethod;
+// how many world units a metre is, the weights are worked out in metres
+uniform float TransparencyUnitsPerMetre = 100.0;
+
+// each pixel's newest node, or 0xffffffff for none
+layout(r32ui, binding = 2) coherent uniform uimage2D TransparencyHeads;
+// every pixel's nodes in one buffer, the packed premultiplied colour in xy, the distance in z
+// and the next node in w
+layout(std430, binding = 6) coherent buffer TransparencyNodes {
+uint transparencyNodeCount;
+uint transparencyNodeCapacity;
+uint transparencyPadding[2];
+uvec4 transparencyNodes[];
+};
+
+// the view depth, what a perspective projection's w is, so every shader sorts the same way
+float transparentDistance() {
+return 1.0 / gl_FragCoord.w;
+}
+
+void writeTransparent(vec4 premultipliedColour) {
+float viewDistance = transparentDistance();
+if (TransparencyMethod == 1) {
+uint node = atomicAdd(transparencyNodeCount, 1u);
+// past the end the fragment is dropped
+if (node < transparencyNodeCapacity) {
+uint next = imageAtomicExchange(TransparencyHeads, ivec2(gl_FragCoord.xy), node);
+transparencyNodes[node] = uvec4(packHalf2x16(premultipliedColour.rg), packHalf2x16(premultipliedColour.ba),
+                                floatBitsToUint(viewDistance), next);
+}
+// colour writes are off, these go nowhere
+TransparentAccumulation = vec4(0);
+TransparentRevealage = 0.0;
+return;
+}
+// McGuire and Bavoil's weight, nearer surfaces count for more once the colours are summed
+float metres = viewDistance / TransparencyUnitsPerMetre;
+float alpha = premultipliedColour.a;
+float weight = alpha * clamp(10.0 / (1e-5 + pow(metres / 5.0, 2.0) + pow(metres / 200.0, 6.0)), 1e-2, 3e3);
+TransparentAccumulation = premultipliedColour * weight;
+TransparentRevealage = alpha;
+}
@@ -0,0 +1,69 @@
+// Frag Shader
+#version 430
+
+// Blends the per-pixel linked lists over the scene (see
+//	TransparencyTarget). A pixel's list is walked and the nearest
+//	MAX_LAYERS of it kept in order, by insertion, then they are blended
+//	front to back. Anything past those is too far behind them to show.
+
+#define MAX_LAYERS 16
+
+layout(r32ui, binding = 2) readonly uniform uimage2D TransparencyHeads;
+layout(std430, binding = 6) readonly buffer TransparencyNodes
+{
+	uint transparencyNodeCount;
+	uint transparencyNodeCapacity;
+	uint transparencyPadding[2];
+	uvec4 transparencyNodes[];
+};
+
+out vec4 FragColour;
+
+void main()
+{
+	uint node = imageLoad(TransparencyHeads, ivec2(gl_FragCoord.xy)).r;
+	if (node == 0xffffffffu)
+		discard;
+
+	// Nearest first.
+	vec4 colours[MAX_LAYERS];
+	float distances[MAX_LAYERS];
+	int count = 0;
+	while (node != 0xffffffffu)
+	{
+		uvec4 stored = transparencyNodes[node];
+		node = stored.w;
+		vec4 colour = vec4(unpackHalf2x16(stored.x), unpackHalf2x16(stored.y));
+		float nodeDistance = uintBitsToFloat(stored.z);
+
+		// Once full a node only goes in if it is nearer than the last.
+		if (count == MAX_LAYERS)
+		{
+			if (nodeDistance >= distances[MAX_LAYERS - 1])
+				continue;
+			--count;
+		}
+
+		int i = count;
+		while (i > 0 && distances[i - 1] > nodeDistance)
+		{
+			colours[i] = colours[i - 1];
+			distances[i] = distances[i - 1];
+			--i;
+		}
+		colours[i] = colour;
+		distances[i] = nodeDistance;
+		++count;
+	}
+
+	vec3 colour = vec3(0);
+	float transmittance = 1.0;
+	for (int i = 0; i < count; ++i)
+	{
+		colour += transmittance * colours[i].rgb;
+		transmittance *= 1.0 - colours[i].a;
+	}
+
+	// Premultiplied, blended with GL_ONE and GL_ONE_MINUS_SRC_ALPHA.
+	FragColour = vec4(colour, 1.0 - transmittance);
+}
@@ -0,0 +1,25 @@
+// Frag Shader
+#version 410
+
+// Blends the weighted blended transparency targets over the scene (see
+//	TransparencyTarget). The sum is divided by its weights back into an
+//	average colour, and covers the scene by as much as the product of
+//	every transparency doesn't reveal it.
+
+uniform sampler2D Accumulation;
+uniform sampler2D Revealage;
+
+out vec4 FragColour;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float revealage = texelFetch(Revealage, texel, 0).r;
+	if (revealage >= 1.0)
+		discard;
+
+	vec4 accumulation = texelFetch(Accumulation, texel, 0);
+
+	// Blended with GL_SRC_ALPHA and GL_ONE_MINUS_SRC_ALPHA.
+	FragColour = vec4(accumulation.rgb / max(accumulation.a, 1e-5), 1.0 - revealage);
+}
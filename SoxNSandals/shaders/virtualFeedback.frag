@@ -0,0 +1,22 @@
+// the virtual texture feedback pass (see VirtualTextureCache::beginFeedback), drawn with lit.vert
+// into a target smaller than the view. each texel is the texture plus one in the top four bits, the
+// level in the next four and the page's row and column in twelve each, 0 where nothing is
+#version 430
+in vec2 vTexCoord;
+flat in uint vVirtualTexture;
+
+// the feedback's texels are larger than the view's, the levels are biased back by as much
+uniform float FeedbackBias;
+
+out uint Feedback;
+
+#include "virtualTexture.glsl"
+
+void main() {
+if(vVirtualTexture == 0u)
+discard;
+int index = int(vVirtualTexture) - 1;
+int level = int(virtualLevel(index, vTexCoord, FeedbackBias));
+ivec2 page = virtualPage(index, virtualPosition(index, vTexCoord), level);
+Feedback = vVirtualTexture << 28 | uint(level) << 24 | uint(page.y) << 12 | uint(page.x);
+}
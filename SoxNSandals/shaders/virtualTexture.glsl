@@ -0,0 +1,53 @@
+// virtual textures (see VirtualTextureCache), sampled through a page table that says which slot
+// of the cache each page is in. a table texel is the slot's column and row, the level of the page
+// in it and 255, or 0 before anything is resident. the table's levels are the pages' levels, and
+// a page that isn't resident has its nearest resident parent's texel
+uniform usampler2D VirtualPageTables[4];
+uniform sampler2D VirtualCache;
+// the fraction of the first level the image covers in xy, its pages in zw
+uniform vec4 VirtualTextureSizes[4] = vec4[4]( vec4(1), vec4(1), vec4(1), vec4(1) );
+// the cache's slots in each direction
+uniform float VirtualCacheSlots = 1;
+
+// a page's side in the cache, its border and the texels of the image it covers a side
+const float VIRTUAL_PAGE_SIZE = 128;
+const float VIRTUAL_PAGE_BORDER = 4;
+const float VIRTUAL_PAGE_CONTENT = 120;
+
+// where a uv is in the first level's pages, wrapped as GL_REPEAT would
+vec2 virtualPosition(int index, vec2 uv) {
+vec4 sizes = VirtualTextureSizes[index];
+return fract(uv) * sizes.xy * sizes.zw;
+}
+
+// the level a uv wants, from its texels' footprint on screen. the gradients come from the
+// unwrapped uvs, so the wrap doesn't pick the smallest level along its seam
+float virtualLevel(int index, vec2 uv, float bias) {
+vec4 sizes = VirtualTextureSizes[index];
+vec2 scale = sizes.xy * sizes.zw * VIRTUAL_PAGE_CONTENT;
+vec2 dx = dFdx(uv) * scale;
+vec2 dy = dFdy(uv) * scale;
+float level = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + bias;
+return clamp(level, 0, float(textureQueryLevels(VirtualPageTables[index]) - 1));
+}
+
+// the page a position is in at a level
+ivec2 virtualPage(int index, vec2 position, int level) {
+ivec2 pages = textureSize(VirtualPageTables[index], level);
+return min(ivec2(position) >> level, pages - 1);
+}
+
+// samples a virtual texture from the nearest resident page at the level it wants, grey while
+// nothing is resident yet
+vec4 sampleVirtualTexture(int index, vec2 uv) {
+vec2 position = virtualPosition(index, uv);
+int level = int(virtualLevel(index, uv, 0));
+uvec4 entry = texelFetch(VirtualPageTables[index], virtualPage(index, position, level), level);
+if(entry.a == 0u)
+return vec4(0.5, 0.5, 0.5, 1);
+
+// the page found may be a parent, whose texels cover more of the image
+vec2 inPage = fract(position / exp2(float(entry.z)));
+vec2 texel = vec2(entry.xy) * VIRTUAL_PAGE_SIZE + VIRTUAL_PAGE_BORDER + inPage * VIRTUAL_PAGE_CONTENT;
+return textureLod(VirtualCache, texel / (VirtualCacheSlots * VIRTUAL_PAGE_SIZE), 0);
+}